@@ -28,6 +28,14 @@ message(STATUS "ENABLE_GCOV = ${ENABLE_GCOV}")
 option(ENABLE_GPERF "Enable gperftools (for tcmalloc)" ON)
 message(STATUS "ENABLE_GPERF = ${ENABLE_GPERF}")
 
+# Requires libibverbs (rdma-core) on the build host.
+option(ENABLE_RDMA "Enable the rdma network provider" OFF)
+message(STATUS "ENABLE_RDMA = ${ENABLE_RDMA}")
+
+# The logs below this level are compiled out, e.g. LOG_LEVEL_DEBUG removes all dinfo().
+set(LOG_COMPILE_MIN_LEVEL "LOG_LEVEL_INFORMATION" CACHE STRING "the min level of logs compiled")
+message(STATUS "LOG_COMPILE_MIN_LEVEL = ${LOG_COMPILE_MIN_LEVEL}")
+
 # ================================================================== #
 
 
@@ -185,6 +193,15 @@ function(dsn_setup_compiler_flags)
     # We want access to the PRI* print format macros.
     add_definitions(-D__STDC_FORMAT_MACROS)
 
+    add_definitions(-DDSN_LOG_COMPILE_MIN_LEVEL=${LOG_COMPILE_MIN_LEVEL})
+
+    # rapidjson skips the whitespaces and scans the strings by SIMD when parsing in situ,
+    # SSE2 is always available on x86-64. It's defined globally to keep every translation unit
+    # including rapidjson consistent.
+    if(CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64")
+        add_definitions(-DRAPIDJSON_SSE2)
+    endif()
+
     set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -std=c++1y" CACHE STRING "" FORCE)
 
     #  -Wall: Enable all warnings.
@@ -262,15 +279,20 @@ function(dsn_setup_system_libs)
     find_package(DL REQUIRED)
     set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${DL_LIBRARIES})
 
-    # for md5 calculation
+    # for md5 calculation, and the tls network provider
     find_package(OpenSSL REQUIRED)
-    set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${OPENSSL_CRYPTO_LIBRARY})
+    set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${OPENSSL_SSL_LIBRARY} ${OPENSSL_CRYPTO_LIBRARY})
 
     if(ENABLE_GPERF)
         set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} tcmalloc_and_profiler)
         add_definitions(-DDSN_ENABLE_GPERF)
     endif()
 
+    if(ENABLE_RDMA)
+        set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ibverbs)
+        add_definitions(-DDSN_ENABLE_RDMA)
+    endif()
+
     set(DSN_SYSTEM_LIBS
         ${DSN_SYSTEM_LIBS}
         ${CMAKE_THREAD_LIBS_INIT} # the thread library found by FindThreads
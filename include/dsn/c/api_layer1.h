@@ -101,6 +101,10 @@ checkpointing)
   ; is already greater than its timeout value
   rpc_request_dropped_before_execution_when_timeout = false
 
+  ; whether to reply ERR_TIMEOUT to the client when a request is dropped
+  ; before execution for timeout, or drop it silently
+  rpc_request_reply_timeout_when_dropped = false
+
   ; for how long (ms) the request will be resent if no response
   ; is received yet, 0 for disable this feature
   rpc_request_resend_timeout_milliseconds = 0
@@ -131,6 +135,10 @@ dsn_threadpool_code_register.
   ; throttling: whether to enable throttling with virtual queues
   enable_virtual_queue_throttling = false
 
+  ; whether to collect the queue wait time and busy time of each worker,
+  ; which can be queried by remote command thread-pool-stats or http /threadPoolStats
+  enable_worker_stats = false
+
   ; thread pool name
   name = THREAD_POOL_INVALID
 
@@ -257,6 +265,13 @@ extern DSN_API dsn::message_ex *dsn_rpc_call_wait(dsn::rpc_address server,
 /*! one-way RPC from client, no rpc response is expected */
 extern DSN_API void dsn_rpc_call_one_way(dsn::rpc_address server, dsn::message_ex *request);
 
+/*!
+   open the session to the server that the requests like `request` would be sent with, ahead
+   of sending any, so that the connection and negotiation are not on the path of the first
+   requests; the request is not sent, and is released inside
+ */
+extern DSN_API void dsn_rpc_prepare_session(dsn::rpc_address server, dsn::message_ex *request);
+
 /*@}*/
 
 /*@}*/
@@ -267,6 +282,12 @@ __inline uint64_t dsn_now_us() { return dsn_now_ns() / 1000; }
 __inline uint64_t dsn_now_ms() { return dsn_now_ns() / 1000000; }
 __inline uint64_t dsn_now_s() { return dsn_now_ns() / 1000000000; }
 
+// cheaper than dsn_now_ns() but may lag behind it by a few milliseconds, for the uses not needing
+// the precision, e.g. the timeouts
+extern DSN_API uint64_t dsn_now_coarse_ns();
+
+__inline uint64_t dsn_now_coarse_ms() { return dsn_now_coarse_ns() / 1000000; }
+
 /*@}*/
 
 /*@}*/
@@ -60,6 +60,13 @@ typedef enum dsn_log_level_t {
     LOG_LEVEL_INVALID
 } dsn_log_level_t;
 
+// logs with level smaller than this are compiled out, which is set by the cmake option
+// LOG_COMPILE_MIN_LEVEL, e.g. -DLOG_COMPILE_MIN_LEVEL=LOG_LEVEL_DEBUG.
+// the arguments of them are still compiled, so they don't rot.
+#ifndef DSN_LOG_COMPILE_MIN_LEVEL
+#define DSN_LOG_COMPILE_MIN_LEVEL LOG_LEVEL_INFORMATION
+#endif
+
 // logs with level smaller than this start_level will not be logged
 extern DSN_API dsn_log_level_t dsn_log_start_level;
 extern DSN_API dsn_log_level_t dsn_log_get_start_level();
@@ -86,7 +93,7 @@ extern DSN_API void dsn_coredump();
 // __FILENAME__ macro comes from the cmake, in which we calculate a filename without path.
 #define dlog(level, ...)                                                                           \
     do {                                                                                           \
-        if (level >= dsn_log_start_level)                                                          \
+        if (level >= DSN_LOG_COMPILE_MIN_LEVEL && level >= dsn_log_start_level)                    \
             dsn_logf(__FILENAME__, __FUNCTION__, __LINE__, level, __VA_ARGS__);                    \
     } while (false)
 #define dinfo(...) dlog(LOG_LEVEL_INFORMATION, __VA_ARGS__)
@@ -0,0 +1,439 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+// C++20 coroutine support for rDSN tasks, rpc calls and file io.
+//
+// rDSN itself is built with C++14, so this header is available only to the
+// users compiling with C++20 coroutines enabled. It's tested by dsn_coroutine_test,
+// which is built in C++20 if the compiler supports it.
+//
+// Example:
+//
+// ```
+//   dsn::coro::async<error_code> copy_file(disk_file *src, disk_file *dst, char *buf, int size)
+//   {
+//       auto rd = co_await dsn::coro::read(src, buf, size, 0, LPC_AIO_CALLBACK, &_tracker);
+//       if (rd.first != ERR_OK) {
+//           co_return rd.first;
+//       }
+//       auto wr = co_await dsn::coro::write(dst, buf, rd.second, 0, LPC_AIO_CALLBACK, &_tracker);
+//       co_return wr.first;
+//   }
+//
+//   dsn::coro::detached run()
+//   {
+//       co_await dsn::coro::schedule(LPC_COPY, &_tracker, 0, 1_s);
+//       error_code err = co_await copy_file(src, dst, buf, size);
+//       ...
+//   }
+// ```
+//
+// Every awaitable is completed by a rDSN task (a raw_task, rpc_response_task or aio_task)
+// bound to the given task_tracker, and the coroutine is resumed in that task's thread pool.
+// If such task is cancelled (e.g. by task_tracker::cancel_outstanding_tasks), the coroutine
+// will never be resumed, and the whole coroutine chain is destroyed from its outermost
+// `detached` coroutine instead.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/file_io.h>
+#include <dsn/utility/chrono_literals.h>
+
+namespace dsn {
+namespace coro {
+
+namespace detail {
+
+struct promise_base
+{
+    // handle of the coroutine owning this promise
+    std::coroutine_handle<> self;
+    // the coroutine awaiting this one, null for the outermost coroutine
+    std::coroutine_handle<> continuation;
+    promise_base *parent{nullptr};
+
+    promise_base *root()
+    {
+        promise_base *p = this;
+        while (p->parent != nullptr) {
+            p = p->parent;
+        }
+        return p;
+    }
+};
+
+// resumer holds a suspended coroutine until the rDSN task which is in charge of resuming it
+// is executed. If the task is cancelled, its callback (which owns the resumer) is cleared
+// without being called, then the whole coroutine chain is destroyed.
+class resumer
+{
+public:
+    template <typename TPromise>
+    explicit resumer(std::coroutine_handle<TPromise> h) : _handle(h), _promise(&h.promise())
+    {
+    }
+
+    ~resumer()
+    {
+        if (_promise != nullptr) {
+            _promise->root()->self.destroy();
+        }
+    }
+
+    void resume()
+    {
+        _promise = nullptr;
+        _handle.resume();
+    }
+
+    resumer(const resumer &) = delete;
+    resumer &operator=(const resumer &) = delete;
+
+private:
+    std::coroutine_handle<> _handle;
+    promise_base *_promise;
+};
+
+template <typename TPromise>
+std::shared_ptr<resumer> make_resumer(std::coroutine_handle<TPromise> h)
+{
+    return std::make_shared<resumer>(h);
+}
+
+} // namespace detail
+
+template <typename T>
+class async;
+
+namespace detail {
+
+template <typename T>
+struct async_promise_common : promise_base
+{
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template <typename TPromise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> h) noexcept
+        {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct async_promise : async_promise_common<T>
+{
+    std::optional<T> value;
+
+    async<T> get_return_object();
+
+    template <typename U>
+    void return_value(U &&v)
+    {
+        value.emplace(std::forward<U>(v));
+    }
+
+    T take()
+    {
+        if (this->error) {
+            std::rethrow_exception(this->error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct async_promise<void> : async_promise_common<void>
+{
+    async<void> get_return_object();
+
+    void return_void() {}
+
+    void take()
+    {
+        if (this->error) {
+            std::rethrow_exception(this->error);
+        }
+    }
+};
+
+} // namespace detail
+
+// async<T> is a lazily started coroutine, it starts running when it's co_awaited,
+// and the awaiting coroutine is resumed when it finishes.
+template <typename T>
+class async
+{
+public:
+    using promise_type = detail::async_promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit async(handle_type h) : _handle(h) {}
+    async(async &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    async &operator=(async &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~async() { reset(); }
+
+    async(const async &) = delete;
+    async &operator=(const async &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    template <typename TPromise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> h) noexcept
+    {
+        _handle.promise().continuation = h;
+        _handle.promise().parent = &h.promise();
+        return _handle;
+    }
+
+    T await_resume() { return _handle.promise().take(); }
+
+private:
+    void reset()
+    {
+        if (_handle) {
+            _handle.destroy();
+            _handle = nullptr;
+        }
+    }
+
+    handle_type _handle;
+};
+
+namespace detail {
+
+template <typename T>
+async<T> async_promise<T>::get_return_object()
+{
+    auto h = std::coroutine_handle<async_promise<T>>::from_promise(*this);
+    this->self = h;
+    return async<T>(h);
+}
+
+inline async<void> async_promise<void>::get_return_object()
+{
+    auto h = std::coroutine_handle<async_promise<void>>::from_promise(*this);
+    this->self = h;
+    return async<void>(h);
+}
+
+} // namespace detail
+
+// detached is an eagerly started coroutine which nobody waits for, its frame is freed
+// automatically when it finishes. It's the outermost coroutine of a coroutine chain.
+struct detached
+{
+    struct promise_type : detail::promise_base
+    {
+        detached get_return_object()
+        {
+            self = std::coroutine_handle<promise_type>::from_promise(*this);
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// run an async<void> in the background
+inline detached spawn(async<void> a) { co_await std::move(a); }
+
+// co_await schedule(...) resumes the coroutine in a task of the given task code
+// after `delay`, just like tasking::enqueue.
+class schedule_awaiter
+{
+public:
+    schedule_awaiter(task_code code,
+                     task_tracker *tracker,
+                     int hash,
+                     std::chrono::milliseconds delay)
+        : _code(code), _tracker(tracker), _hash(hash), _delay(delay)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    template <typename TPromise>
+    void await_suspend(std::coroutine_handle<TPromise> h)
+    {
+        auto r = detail::make_resumer(h);
+        tasking::enqueue(_code, _tracker, [r]() { r->resume(); }, _hash, _delay);
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    task_code _code;
+    task_tracker *_tracker;
+    int _hash;
+    std::chrono::milliseconds _delay;
+};
+
+inline schedule_awaiter schedule(task_code code,
+                                 task_tracker *tracker = nullptr,
+                                 int hash = 0,
+                                 std::chrono::milliseconds delay = 0_ms)
+{
+    return schedule_awaiter(code, tracker, hash, delay);
+}
+
+// co_await call<TResponse>(...) sends the rpc request and returns <error, response>,
+// the coroutine is resumed in the thread pool of the rpc's response task.
+template <typename TResponse>
+class rpc_call_awaiter
+{
+public:
+    rpc_call_awaiter(rpc_address server,
+                     message_ex *request,
+                     task_tracker *tracker,
+                     int reply_thread_hash)
+        : _server(server), _request(request), _tracker(tracker), _reply_thread_hash(reply_thread_hash)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    template <typename TPromise>
+    void await_suspend(std::coroutine_handle<TPromise> h)
+    {
+        auto r = detail::make_resumer(h);
+        // the awaiter lives in the coroutine frame, which is valid until resumed
+        rpc::call(_server,
+                  _request,
+                  _tracker,
+                  [this, r](error_code err, TResponse &&resp) {
+                      _result.first = err;
+                      _result.second = std::move(resp);
+                      r->resume();
+                  },
+                  _reply_thread_hash);
+    }
+
+    std::pair<error_code, TResponse> await_resume() { return std::move(_result); }
+
+private:
+    rpc_address _server;
+    message_ex *_request;
+    task_tracker *_tracker;
+    int _reply_thread_hash;
+    std::pair<error_code, TResponse> _result;
+};
+
+template <typename TResponse, typename TRequest>
+rpc_call_awaiter<TResponse> call(rpc_address server,
+                                 task_code code,
+                                 TRequest &&req,
+                                 task_tracker *tracker,
+                                 std::chrono::milliseconds timeout = 0_ms,
+                                 int thread_hash = 0,
+                                 uint64_t partition_hash = 0,
+                                 int reply_thread_hash = 0)
+{
+    message_ex *msg = message_ex::create_request(
+        code, static_cast<int>(timeout.count()), thread_hash, partition_hash);
+    marshall(msg, std::forward<TRequest>(req));
+    return rpc_call_awaiter<TResponse>(server, msg, tracker, reply_thread_hash);
+}
+
+// co_await read(...) / write(...) returns <error, transferred size>,
+// the coroutine is resumed in the thread pool of `callback_code`.
+class aio_awaiter
+{
+public:
+    typedef std::function<aio_task_ptr(aio_handler &&)> starter;
+
+    explicit aio_awaiter(starter &&start) : _start(std::move(start)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    template <typename TPromise>
+    void await_suspend(std::coroutine_handle<TPromise> h)
+    {
+        auto r = detail::make_resumer(h);
+        _start([this, r](error_code err, size_t size) {
+            _result.first = err;
+            _result.second = size;
+            r->resume();
+        });
+    }
+
+    std::pair<error_code, size_t> await_resume() { return _result; }
+
+private:
+    starter _start;
+    std::pair<error_code, size_t> _result;
+};
+
+inline aio_awaiter read(disk_file *file,
+                        char *buffer,
+                        int count,
+                        uint64_t offset,
+                        task_code callback_code,
+                        task_tracker *tracker,
+                        int hash = 0)
+{
+    return aio_awaiter([=](aio_handler &&cb) {
+        return file::read(file, buffer, count, offset, callback_code, tracker, std::move(cb), hash);
+    });
+}
+
+inline aio_awaiter write(disk_file *file,
+                         const char *buffer,
+                         int count,
+                         uint64_t offset,
+                         task_code callback_code,
+                         task_tracker *tracker,
+                         int hash = 0)
+{
+    return aio_awaiter([=](aio_handler &&cb) {
+        return file::write(
+            file, buffer, count, offset, callback_code, tracker, std::move(cb), hash);
+    });
+}
+
+} // namespace coro
+} // namespace dsn
+
+#endif
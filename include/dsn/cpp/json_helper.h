@@ -25,6 +25,9 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 #include <map>
 #include <unordered_map>
@@ -230,6 +233,36 @@ typedef rapidjson::GenericValue<rapidjson::UTF8<>> JsonObject;
 typedef rapidjson::Writer<rapidjson::OStreamWrapper> JsonWriter;
 typedef rapidjson::PrettyWriter<rapidjson::OStreamWrapper> PrettyJsonWriter;
 
+// A streambuf writing into a std::string, which can be taken without copying.
+class string_output_buffer : public std::streambuf
+{
+public:
+    std::string release()
+    {
+        _str.resize(pptr() - pbase());
+        setp(nullptr, nullptr);
+        return std::move(_str);
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        size_t used = pptr() - pbase();
+        _str.resize(std::max<size_t>(256, _str.size() * 2));
+        setp(&_str[0], &_str[0] + _str.size());
+        pbump(static_cast<int>(used));
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        return c;
+    }
+
+private:
+    std::string _str;
+};
+
 template <typename>
 class json_forwarder;
 
@@ -584,9 +617,11 @@ public:
     }
     static dsn::blob encode(const T &t)
     {
-        std::ostringstream os;
+        // the json is written into a string which the blob takes without copying
+        string_output_buffer buf;
+        std::ostream os(&buf);
         encode(os, t);
-        return blob::create_from_bytes(os.str());
+        return blob::create_from_bytes(buf.release());
     }
 
     static bool decode(const JsonObject &in, T &t)
@@ -595,8 +630,23 @@ public:
     }
     static bool decode(const dsn::blob &bb, T &t)
     {
-        rapidjson::Document doc;
-        dverify(!doc.Parse(bb.data(), bb.length()).HasParseError());
+        // parse in situ from a null-terminated copy, on which rapidjson skips the whitespaces
+        // by SIMD (RAPIDJSON_SSE2/RAPIDJSON_SSE42) and the strings are referred to in place
+        // rather than copied. the small documents are parsed without any heap allocation.
+        char stack_copy[4096];
+        std::unique_ptr<char[]> heap_copy;
+        char *copy = stack_copy;
+        if (bb.length() >= sizeof(stack_copy)) {
+            heap_copy.reset(new char[bb.length() + 1]);
+            copy = heap_copy.get();
+        }
+        memcpy(copy, bb.data(), bb.length());
+        copy[bb.length()] = '\0';
+
+        char pool[4096];
+        rapidjson::MemoryPoolAllocator<> allocator(pool, sizeof(pool));
+        rapidjson::Document doc(&allocator);
+        dverify(!doc.ParseInsitu(copy).HasParseError());
         return decode(doc, t);
     }
 
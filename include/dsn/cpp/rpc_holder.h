@@ -203,6 +203,25 @@ public:
         dsn_rpc_forward(dsn_request(), addr);
     }
 
+    // Replies the request with `data`, the response already serialized in the format of the
+    // request, e.g. kept in a cache. The holder won't reply again after its lifetime ends.
+    void reply_serialized(const blob &data)
+    {
+        _i->auto_reply = false;
+        if (dsn_unlikely(_mail_box != nullptr)) {
+            binary_reader reader(data);
+            unmarshall(reader,
+                       response(),
+                       (dsn_msg_serialize_format)dsn_request()->header->context.u.serialize_format);
+            _i->reply();
+            return;
+        }
+
+        message_ex *dsn_response = dsn_request()->create_response();
+        dsn_response->write_append(data);
+        dsn_rpc_reply(dsn_response);
+    }
+
     // Returns an rpc_holder that will reply the request after its lifetime ends.
     // By default rpc_holder never replies.
     // SEE: serverlet<T>::register_rpc_handler_with_rpc_holder
@@ -57,6 +57,9 @@ inline void marshall(binary_writer &writer, const ThriftType &value, dsn_msg_ser
     case DSF_THRIFT_BINARY:
         marshall_thrift_binary(writer, value);
         break;
+    case DSF_THRIFT_COMPACT:
+        marshall_thrift_compact(writer, value);
+        break;
     case DSF_THRIFT_JSON:
         marshall_thrift_json(writer, value);
         break;
@@ -72,6 +75,9 @@ inline void unmarshall(binary_reader &reader, ThriftType &value, dsn_msg_seriali
     case DSF_THRIFT_BINARY:
         unmarshall_thrift_binary(reader, value);
         break;
+    case DSF_THRIFT_COMPACT:
+        unmarshall_thrift_compact(reader, value);
+        break;
     case DSF_THRIFT_JSON:
         unmarshall_thrift_json(reader, value);
         break;
@@ -38,9 +38,11 @@
 
 #include <dsn/tool_api.h>
 #include <dsn/cpp/rpc_stream.h>
+#include <dsn/utility/flags.h>
 
 #include <thrift/Thrift.h>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/protocol/TJSONProtocol.h>
 #include <thrift/protocol/TVirtualProtocol.h>
 #include <thrift/transport/TVirtualTransport.h>
@@ -50,6 +52,8 @@
 using namespace ::apache::thrift::transport;
 namespace dsn {
 
+DSN_DECLARE_bool(thrift_zero_copy_blob_decode);
+
 class binary_reader_transport : public TVirtualTransport<binary_reader_transport>
 {
 public:
@@ -71,6 +75,8 @@ public:
         return (uint32_t)l;
     }
 
+    binary_reader &reader() { return _reader; }
+
 private:
     binary_reader &_reader;
 };
@@ -91,10 +97,69 @@ public:
         _writer.write((const char *)buf, static_cast<int>(len));
     }
 
+    binary_writer &writer() { return _writer; }
+
 private:
     binary_writer &_writer;
 };
 
+// The compact protocol prefixes a binary only with its length in varint32 (see
+// TCompactProtocolT::writeBinary), so a blob can be copied from or sliced out of the binary
+// reader/writer directly rather than through a std::string.
+inline uint32_t write_thrift_compact_blob(binary_writer &writer, const blob &value)
+{
+    uint8_t buf[5];
+    uint32_t wsize = 0;
+    uint32_t n = value.length();
+    while (n > 0x7f) {
+        buf[wsize++] = static_cast<uint8_t>((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    buf[wsize++] = static_cast<uint8_t>(n);
+    writer.write((const char *)buf, static_cast<int>(wsize));
+    writer.write(value.data(), static_cast<int>(value.length()));
+    return wsize + value.length();
+}
+
+inline uint32_t read_thrift_compact_blob(binary_reader &reader, /*out*/ blob &value)
+{
+    uint32_t len = 0;
+    uint32_t xfer = 0;
+    for (int shift = 0;; shift += 7) {
+        if (shift >= 35) {
+            throw apache::thrift::protocol::TProtocolException(
+                apache::thrift::protocol::TProtocolException::INVALID_DATA,
+                "Variable-length int over 5 bytes.");
+        }
+        uint8_t byte;
+        if (reader.get_remaining_size() <= 0) {
+            throw TTransportException(TTransportException::END_OF_FILE,
+                                      "no more data to read after end-of-buffer");
+        }
+        reader.read(byte);
+        xfer++;
+        len |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+
+    int32_t size = static_cast<int32_t>(len);
+    if (size < 0) {
+        throw apache::thrift::protocol::TProtocolException(
+            apache::thrift::protocol::TProtocolException::NEGATIVE_SIZE);
+    }
+    if (size > reader.get_remaining_size()) {
+        throw TTransportException(TTransportException::END_OF_FILE,
+                                  "no more data to read after end-of-buffer");
+    }
+    reader.read(value, size);
+    if (!FLAGS_thrift_zero_copy_blob_decode) {
+        value = blob::create_from_bytes(value.data(), value.length());
+    }
+    return xfer + static_cast<uint32_t>(size);
+}
+
 #define DEFINE_THRIFT_BASE_TYPE_SERIALIZATION(TName, TRealName, TTag, TMethod)                     \
     inline uint32_t write_base(::apache::thrift::protocol::TProtocol *proto, const TName &val)     \
     {                                                                                              \
@@ -451,18 +516,69 @@ inline uint32_t task_code::write(apache::thrift::protocol::TProtocol *oprot) con
 
 inline uint32_t blob::read(apache::thrift::protocol::TProtocol *iprot)
 {
-    // for optimization, it is dangerous if the oprot is not a binary proto
-    apache::thrift::protocol::TBinaryProtocol *binary_proto =
-        static_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot);
-    blob_string str(*this);
-    return binary_proto->readString<blob_string>(str);
+    // when decoding from a binary_reader, the blob is made a slice of the buffer being read
+    // rather than a copy, which keeps the whole buffer (e.g. the receive buffer of the rpc
+    // message) alive as long as the blob is
+    if (FLAGS_thrift_zero_copy_blob_decode) {
+        auto binary_proto = dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot);
+        auto trans = binary_proto == nullptr
+                         ? nullptr
+                         : dynamic_cast<binary_reader_transport *>(
+                               binary_proto->getTransport().get());
+        if (trans != nullptr) {
+            int32_t len;
+            uint32_t xfer = binary_proto->readI32(len);
+            if (len < 0) {
+                throw apache::thrift::protocol::TProtocolException(
+                    apache::thrift::protocol::TProtocolException::NEGATIVE_SIZE);
+            }
+            if (len > trans->reader().get_remaining_size()) {
+                throw TTransportException(TTransportException::END_OF_FILE,
+                                          "no more data to read after end-of-buffer");
+            }
+            trans->reader().read(*this, len);
+            return xfer + static_cast<uint32_t>(len);
+        }
+    }
+
+    auto binary_proto = dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot);
+    if (binary_proto != nullptr) {
+        blob_string str(*this);
+        return binary_proto->readString<blob_string>(str);
+    }
+
+    auto compact_proto = dynamic_cast<apache::thrift::protocol::TCompactProtocol *>(iprot);
+    auto compact_trans = compact_proto == nullptr
+                             ? nullptr
+                             : dynamic_cast<binary_reader_transport *>(
+                                   compact_proto->getTransport().get());
+    if (compact_trans != nullptr) {
+        return read_thrift_compact_blob(compact_trans->reader(), *this);
+    }
+
+    // the other protocols (compact, json) read into a std::string at first
+    std::string str;
+    uint32_t xfer = iprot->readBinary(str);
+    *this = blob::create_from_bytes(std::move(str));
+    return xfer;
 }
 
 inline uint32_t blob::write(apache::thrift::protocol::TProtocol *oprot) const
 {
-    apache::thrift::protocol::TBinaryProtocol *binary_proto =
-        static_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot);
-    return binary_proto->writeString<blob_string>(blob_string(const_cast<blob &>(*this)));
+    auto binary_proto = dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot);
+    if (binary_proto != nullptr) {
+        return binary_proto->writeString<blob_string>(blob_string(const_cast<blob &>(*this)));
+    }
+
+    auto compact_proto = dynamic_cast<apache::thrift::protocol::TCompactProtocol *>(oprot);
+    auto compact_trans = compact_proto == nullptr
+                             ? nullptr
+                             : dynamic_cast<binary_writer_transport *>(
+                                   compact_proto->getTransport().get());
+    if (compact_trans != nullptr) {
+        return write_thrift_compact_blob(compact_trans->writer(), *this);
+    }
+    return oprot->writeBinary(to_string());
 }
 
 inline uint32_t error_code::read(apache::thrift::protocol::TProtocol *iprot)
@@ -693,6 +809,17 @@ inline void marshall_thrift_json(binary_writer &writer, const T &val)
     proto.getTransport()->flush();
 }
 
+template <typename T>
+inline void marshall_thrift_compact(binary_writer &writer, const T &val)
+{
+    ::dsn::binary_writer_transport trans(writer);
+    boost::shared_ptr<::dsn::binary_writer_transport> transport(
+        &trans, [](::dsn::binary_writer_transport *) {});
+    ::apache::thrift::protocol::TCompactProtocol proto(transport);
+    marshall_thrift_internal(val, &proto);
+    proto.getTransport()->flush();
+}
+
 template <typename T>
 inline void unmarshall_thrift_binary(binary_reader &reader, T &val)
 {
@@ -703,6 +830,16 @@ inline void unmarshall_thrift_binary(binary_reader &reader, T &val)
     unmarshall_thrift_internal(val, &proto);
 }
 
+template <typename T>
+inline void unmarshall_thrift_compact(binary_reader &reader, T &val)
+{
+    ::dsn::binary_reader_transport trans(reader);
+    boost::shared_ptr<::dsn::binary_reader_transport> transport(
+        &trans, [](::dsn::binary_reader_transport *) {});
+    ::apache::thrift::protocol::TCompactProtocol proto(transport);
+    unmarshall_thrift_internal(val, &proto);
+}
+
 template <typename T>
 inline void unmarshall_thrift_json(binary_reader &reader, T &val)
 {
@@ -220,12 +220,16 @@ struct upload_request
  *  similar to write_response with more errors in err:
  *     ERR_FILE_OPERATION_FAILED: open the local file for read failed.
  *
+ *  md5: the md5 of the uploaded content, which is calculated in the same pass as the local
+ *     file is read for the upload, so that the caller needn't read the file once more for it.
+ *
  * Notice: user can call get_size/get_md5sum to get the metadata of the file
  */
 struct upload_response
 {
     dsn::error_code err;
     uint64_t uploaded_size;
+    std::string md5;
 };
 typedef std::function<void(const upload_response &)> upload_callback;
 typedef future_task<upload_response> upload_future;
@@ -252,6 +256,8 @@ struct download_response
 {
     dsn::error_code err;
     uint64_t downloaded_size;
+    // md5 of the downloaded bytes calculated while writing them, empty if not supported
+    std::string file_md5;
 };
 typedef std::function<void(const download_response &)> download_callback;
 typedef future_task<download_response> download_future;
@@ -58,6 +58,11 @@
  *
  * 4. The lease_periods must be less than the grace_periods, as required by prefect FD.
  *
+ * 5. With [failure_detector].phi_accrual_enabled, master may claim a worker dead once it has
+ *    been silent for longer than lease_seconds, rather than grace_seconds, if the phi of its
+ *    beacon inter-arrival times exceeds the threshold. It is still safe as the worker has
+ *    disconnected itself by then.
+ *
  */
 #pragma once
 
@@ -65,6 +70,7 @@
 #include <dsn/dist/failure_detector/fd.server.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/tool-api/zlocks.h>
+#include <set>
 
 namespace dsn {
 namespace fd {
@@ -87,6 +93,24 @@ public:
     virtual void on_worker_connected(::dsn::rpc_address node) = 0;
 };
 
+// Estimates how likely a node is dead by the time since its last beacon, against the
+// distribution of its beacon inter-arrival times, as in "The phi accrual failure detector".
+// phi = -log10(P(the next beacon arrives later than now)), assuming the inter-arrival times are
+// normally distributed, whose mean and variance are moving averages.
+class phi_accrual_estimator
+{
+public:
+    void add_interval(uint64_t interval_ms);
+    void reset() { _count = 0; }
+    uint32_t count() const { return _count; }
+    double phi(uint64_t elapsed_ms, uint32_t min_std_deviation_ms) const;
+
+private:
+    uint32_t _count = 0;
+    double _mean_ms = 0;
+    double _variance = 0;
+};
+
 class failure_detector : public failure_detector_service,
                          public failure_detector_client,
                          public failure_detector_callback
@@ -135,6 +159,9 @@ public:
 
     virtual bool is_worker_connected(::dsn::rpc_address node) const;
 
+    // the phi of the time since the last beacon of the worker, 0 if it's unknown
+    double get_worker_phi(::dsn::rpc_address node) const;
+
     void add_allow_list(::dsn::rpc_address node);
 
     bool remove_from_allow_list(::dsn::rpc_address node);
@@ -158,7 +185,10 @@ protected:
     void report(::dsn::rpc_address node, bool is_master, bool is_connected);
 
 private:
+    friend class check_records_test;
+
     void check_all_records();
+    bool is_worker_suspected(const phi_accrual_estimator &estimator, uint64_t elapsed_ms) const;
 
 private:
     class master_record
@@ -187,6 +217,7 @@ private:
         ::dsn::rpc_address node;
         uint64_t last_beacon_recv_time;
         bool is_alive;
+        phi_accrual_estimator beacon_intervals;
 
         // workers are always considered *connected* initially which is ok even when workers think
         // master is disconnected
@@ -207,6 +238,9 @@ private:
 
     master_map _masters;
     worker_map _workers;
+    // the alive workers ordered by their last_beacon_recv_time, so that only the ones which may
+    // be dead are visited by check_all_records()
+    std::set<std::pair<uint64_t, ::dsn::rpc_address>> _alive_workers_by_recv_time;
 
     uint32_t _check_interval_milliseconds;
     uint32_t _beacon_interval_milliseconds;
@@ -27,7 +27,7 @@
 
 #define dlog_f(level, ...)                                                                         \
     do {                                                                                           \
-        if (level >= dsn_log_start_level)                                                          \
+        if (level >= DSN_LOG_COMPILE_MIN_LEVEL && level >= dsn_log_start_level)                    \
             dsn_log(                                                                               \
                 __FILENAME__, __FUNCTION__, __LINE__, level, fmt::format(__VA_ARGS__).c_str());    \
     } while (false)
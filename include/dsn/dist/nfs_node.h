@@ -43,6 +43,9 @@ struct remote_copy_request
     std::string dest_dir;
     bool overwrite;
     bool high_priority;
+    // other nodes and dirs holding files identical to those under `source_dir`, the file
+    // chunks are copied from all the sources, and moved to another source if one fails
+    std::vector<std::pair<dsn::rpc_address, std::string>> alternate_sources;
 };
 
 class nfs_node
@@ -50,6 +53,11 @@ class nfs_node
 public:
     static std::unique_ptr<nfs_node> create();
 
+    // a file failed to copy is kept with its progress in "<file><kCopyProgressSuffix>", from
+    // which a later copy of it into the same dest_dir is resumed, the progress is removed once
+    // the copy succeeds
+    static constexpr const char *kCopyProgressSuffix = ".nfs_progress";
+
 public:
     aio_task_ptr copy_remote_directory(rpc_address remote,
                                        const std::string &source_dir,
@@ -70,6 +78,19 @@ public:
                                    task_tracker *tracker,
                                    aio_handler &&callback,
                                    int hash = 0);
+    // same as above, but the files may be copied from the alternate sources as well
+    aio_task_ptr
+    copy_remote_files(rpc_address remote,
+                      const std::string &source_dir,
+                      const std::vector<std::pair<rpc_address, std::string>> &alternate_sources,
+                      const std::vector<std::string> &files, // empty for all
+                      const std::string &dest_dir,
+                      bool overwrite,
+                      bool high_priority,
+                      task_code callback_code,
+                      task_tracker *tracker,
+                      aio_handler &&callback,
+                      int hash = 0);
 
     nfs_node() {}
     virtual ~nfs_node() {}
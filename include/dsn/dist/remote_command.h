@@ -7,6 +7,8 @@
 #include <dsn/utility/errors.h>
 #include <dsn/tool-api/task.h>
 
+#include <vector>
+
 namespace dsn {
 namespace dist {
 namespace cmd {
@@ -18,6 +20,38 @@ task_ptr async_call_remote(rpc_address remote,
                            std::function<void(error_code, const std::string &)> callback,
                            std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
 
+/// The result of a remote command on one of the targets of a fan-out.
+struct remote_command_result
+{
+    rpc_address node;
+    error_code err{ERR_OK};
+    std::string output;
+};
+
+/// Calls a remote command to all the `remotes` in parallel, with at most `concurrency` calls in
+/// flight. Each call times out by itself after `timeout`, so that a slow node doesn't hold up the
+/// others. `callback` is called with the results in the order of `remotes` after all the calls are
+/// done.
+void async_call_remote_fanout(const std::vector<rpc_address> &remotes,
+                              const std::string &cmd,
+                              const std::vector<std::string> &arguments,
+                              uint32_t concurrency,
+                              std::chrono::milliseconds timeout,
+                              std::function<void(std::vector<remote_command_result>)> callback);
+
+/// The blocking version of async_call_remote_fanout.
+std::vector<remote_command_result>
+call_remote_fanout(const std::vector<rpc_address> &remotes,
+                   const std::string &cmd,
+                   const std::vector<std::string> &arguments,
+                   uint32_t concurrency,
+                   std::chrono::milliseconds timeout);
+
+/// Merges the results into a JSON object keyed by the nodes, in which an output of JSON is
+/// embedded as is and the others as strings. A failed node maps to {"error": "<error code>"}.
+std::string merge_remote_command_results(const std::vector<remote_command_result> &results,
+                                         bool pretty = false);
+
 /// Registers the server-side RPC handler of remote commands.
 bool register_remote_command_rpc();
 
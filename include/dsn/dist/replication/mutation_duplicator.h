@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <dsn/utility/compression.h>
 #include <dsn/utility/errors.h>
 #include <dsn/dist/replication/replication_types.h>
 #include <dsn/dist/replication/replica_base.h>
@@ -46,6 +47,22 @@ struct mutation_tuple_cmp
 };
 typedef std::set<mutation_tuple, mutation_tuple_cmp> mutation_tuple_set;
 
+/// \brief A mutation batch can be packed into one blob by encode_mutation_batch, so that the
+/// duplicator ships the batch in one request rather than one request per mutation. The batch is
+/// compressed as a whole, which works much better than compressing the small mutations one by one.
+///
+/// The codec is negotiated with the remote cluster: the remote reports the bitmask of
+/// supported_batch_compressions(), of which negotiate_batch_compression() chooses the codec
+/// configured by `duplication_batch_compression_type` if both sides support it, otherwise none.
+extern uint32_t supported_batch_compressions();
+extern utils::compression_type negotiate_batch_compression(uint32_t remote_compressions);
+
+/// The encoded batch is self-described, which records the codec in use.
+extern blob encode_mutation_batch(const mutation_tuple_set &mutations,
+                                  utils::compression_type type);
+extern error_s decode_mutation_batch(const blob &data,
+                                     /*out*/ std::vector<mutation_tuple> &mutations);
+
 /// \brief This is an interface for handling the mutation logs intended to
 /// be duplicated to remote cluster.
 /// \see dsn::replication::replica_duplicator
@@ -71,10 +88,20 @@ public:
 
     void set_task_environment(pipeline::environment *env) { _env = *env; }
 
+    /// Called by the implementation once the remote reports the codecs it supports.
+    void set_remote_batch_compressions(uint32_t remote_compressions)
+    {
+        _batch_compression = negotiate_batch_compression(remote_compressions);
+    }
+
+    /// The codec of the batches encoded by encode_mutation_batch.
+    utils::compression_type batch_compression() const { return _batch_compression; }
+
 protected:
     friend class replica_duplicator_test;
 
     pipeline::environment _env;
+    utils::compression_type _batch_compression{utils::compression_type::none};
 };
 
 inline std::unique_ptr<mutation_duplicator>
@@ -51,6 +51,23 @@ public:
          std::ostream &output,
          std::function<void(
              int64_t decree, int64_t timestamp, dsn::message_ex **requests, int count)> callback);
+
+    struct scan_options
+    {
+        // the count of the threads replaying the log files, 0 for the count of the cores
+        uint32_t thread_count = 0;
+        // the width of the buckets of the throughput over time
+        uint32_t interval_seconds = 60;
+        // the count of the largest mutations reported
+        uint32_t top_count = 10;
+        bool json = false;
+    };
+
+    // Replays all the log files in `log_dir` in parallel, each file on one thread, and outputs
+    // the summary of the mutations instead of every one of them: the throughput over time,
+    // the size distribution by task code, the write volume per partition and the largest
+    // mutations. Reading the files by mmap ([replication] log_file_mmap_read) speeds it up.
+    bool scan(const std::string &log_dir, const scan_options &options, std::ostream &output);
 };
 }
 }
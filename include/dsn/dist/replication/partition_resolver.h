@@ -32,10 +32,24 @@
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/async_calls.h>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace dsn {
 namespace replication {
 
+template <typename TResponse>
+struct batch_call_result
+{
+    // the error of the request of the partition that the item is batched into
+    error_code err;
+    // the response of that request shared by the items batched together, nullptr if failed
+    std::shared_ptr<TResponse> response;
+    // the index of the item in that request
+    size_t index;
+};
+
 class partition_resolver : public ref_counter
 {
 public:
@@ -62,6 +76,87 @@ public:
         return response_task;
     }
 
+    // send the items of various partitions in batches: the items are grouped by the partitions
+    // that their hashes are resolved to, each group is made into one request by `make_request`
+    // with the items in the given order, and the requests are sent in parallel as `call_op`
+    // does. `callback` is called once when all of them complete, with the results in the order
+    // of `items`; the failure of one partition fails only the items of it.
+    template <typename TItem, typename TRequest, typename TResponse>
+    void call_batch(dsn::task_code code,
+                    std::vector<std::pair<uint64_t, TItem>> &&items,
+                    std::function<TRequest(std::vector<TItem> &&)> &&make_request,
+                    dsn::task_tracker *tracker,
+                    std::function<void(std::vector<batch_call_result<TResponse>> &&)> &&callback,
+                    std::chrono::milliseconds timeout)
+    {
+        struct batch_state
+        {
+            std::vector<std::pair<uint64_t, TItem>> items;
+            std::function<TRequest(std::vector<TItem> &&)> make_request;
+            std::function<void(std::vector<batch_call_result<TResponse>> &&)> callback;
+            std::vector<batch_call_result<TResponse>> results;
+            std::atomic<size_t> pending_count{0};
+        };
+        auto st = std::make_shared<batch_state>();
+        st->items = std::move(items);
+        st->make_request = std::move(make_request);
+        st->callback = std::move(callback);
+        st->results.resize(st->items.size());
+        if (st->items.empty()) {
+            st->callback(std::move(st->results));
+            return;
+        }
+
+        std::vector<uint64_t> hashes;
+        hashes.reserve(st->items.size());
+        for (const auto &item : st->items) {
+            hashes.push_back(item.first);
+        }
+        partition_resolver_ptr r(this);
+        group_by_partition(
+            std::move(hashes),
+            static_cast<int>(timeout.count()),
+            [r, st, code, tracker, timeout](error_code err,
+                                            std::vector<std::vector<size_t>> &&groups) {
+                if (err != ERR_OK) {
+                    for (auto &result : st->results) {
+                        result.err = err;
+                    }
+                    st->callback(std::move(st->results));
+                    return;
+                }
+
+                st->pending_count = groups.size();
+                for (auto &group : groups) {
+                    std::vector<TItem> group_items;
+                    group_items.reserve(group.size());
+                    for (size_t i = 0; i < group.size(); i++) {
+                        group_items.emplace_back(std::move(st->items[group[i]].second));
+                        st->results[group[i]].index = i;
+                    }
+                    uint64_t partition_hash = st->items[group[0]].first;
+                    r->call_op(code,
+                               st->make_request(std::move(group_items)),
+                               tracker,
+                               [st, group](error_code err, TResponse &&resp) {
+                                   std::shared_ptr<TResponse> shared_resp;
+                                   if (err == ERR_OK) {
+                                       shared_resp = std::make_shared<TResponse>(std::move(resp));
+                                   }
+                                   for (size_t idx : group) {
+                                       st->results[idx].err = err;
+                                       st->results[idx].response = shared_resp;
+                                   }
+                                   if (--st->pending_count == 0) {
+                                       st->callback(std::move(st->results));
+                                   }
+                               },
+                               timeout,
+                               partition_hash);
+                }
+            });
+    }
+
     // choosing a proper replica server from meta server or local route cache
     // and send the read/write request.
     // if got reply or error, call the callback.
@@ -69,6 +164,24 @@ public:
     // into "task", you may want to refer to dsn::rpc_response_task for details.
     void call_task(const dsn::rpc_response_task_ptr &task);
 
+    // fetch the configs of all the partitions in one query to meta server if they are not
+    // cached yet, and open the sessions to the primaries that the requests of `code` would be
+    // sent with, so the first requests after the start wait for neither of them.
+    // `callback` (may be empty) is called with the error of the query, once the sessions are
+    // being opened in the background.
+    void prewarm(dsn::task_code code,
+                 std::chrono::milliseconds timeout,
+                 std::function<void(error_code)> &&callback);
+
+    // prewarm the resolvers of `app_names`, `callback` is called once all of them are done
+    // with ERR_OK, or the error of any one of them
+    static void prewarm(const char *cluster_name,
+                        const std::vector<dsn::rpc_address> &meta_list,
+                        const std::vector<std::string> &app_names,
+                        dsn::task_code code,
+                        std::chrono::milliseconds timeout,
+                        std::function<void(error_code)> &&callback);
+
     std::string get_app_name() const { return _app_name; }
 
     dsn::rpc_address get_meta_server() const { return _meta_server; }
@@ -128,6 +241,40 @@ protected:
 
     virtual int get_partition_index(int partition_count, uint64_t partition_hash) = 0;
 
+    /**
+     * \return the partition count of the app, -1 if not known yet.
+     */
+    virtual int get_partition_count() const { return -1; }
+
+    /**
+     * open the sessions to the primaries of the cached partitions for the requests of `code`.
+     */
+    virtual void prepare_sessions(dsn::task_code code) {}
+
+    /**
+     * group the indexes of `hashes` by the partitions they belong to, resolving only one of
+     * them, which gets the partition count known; every hash is a group of its own if the
+     * partition count is still unknown.
+     *
+     * \param callback invoked with the groups, or with the error of the resolving
+     */
+    void group_by_partition(
+        std::vector<uint64_t> &&hashes,
+        int timeout_ms,
+        std::function<void(error_code, std::vector<std::vector<size_t>> &&)> &&callback);
+
+    /**
+     * send the request of `task` to the resolved partition in a way other than sending it to
+     * `result.address` directly, e.g. hedging it to the secondaries.
+     *
+     * \return false if the request should be sent to `result.address` as usual.
+     */
+    virtual bool call_resolved(const dsn::rpc_response_task_ptr &task,
+                               const resolve_result &result)
+    {
+        return false;
+    }
+
     std::string _cluster_name;
     std::string _app_name;
     rpc_address _meta_server;
@@ -57,6 +57,10 @@ public:
     static const std::string REPLICA_ACCESS_CONTROLLER_ALLOWED_USERS;
     static const std::string READ_QPS_THROTTLING;
     static const std::string SPLIT_VALIDATE_PARTITION_HASH;
+    static const std::string WRITE_QPS_QUOTA;
+    static const std::string WRITE_SIZE_QUOTA;
+    static const std::string READ_QPS_QUOTA;
+    static const std::string READ_REPLICA_COUNT;
 };
 
 } // namespace replication
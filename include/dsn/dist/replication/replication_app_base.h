@@ -32,7 +32,10 @@
 #include <dsn/dist/replication/replication_other_types.h>
 #include <dsn/dist/replication/replication.codes.h>
 #include <dsn/dist/replication/replica_base.h>
+#include <dsn/utility/autoref_ptr.h>
 #include <atomic>
+#include <memory>
+#include <vector>
 
 namespace dsn {
 namespace replication {
@@ -78,6 +81,29 @@ public:
     error_code store(const char *file);
 };
 
+//
+// A point-in-time view of the app, taken at a decree by take_checkpoint_snapshot() and
+// persisted as a checkpoint by the replication layer in the background, while the writes
+// to the app go on.
+//
+class checkpoint_snapshot
+{
+public:
+    virtual ~checkpoint_snapshot() = default;
+
+    // the last decree included in the snapshot
+    virtual int64_t decree() const = 0;
+
+    //
+    // persist the snapshot as a checkpoint, and update last_durable_decree internally.
+    // it runs out of the replication thread, concurrently with the writes to the app.
+    //
+    // Postconditions:
+    // * last_durable_decree() >= decree() if ERR_OK is returned
+    //
+    virtual ::dsn::error_code write() = 0;
+};
+
 /// The store engine interface of Pegasus.
 /// Inherited by pegasus::pegasus_server_impl
 /// Inherited by dsn::apps::rrdb_service
@@ -106,6 +132,11 @@ public:
     // Whether this replica is duplicating.
     bool is_duplicating() const;
 
+    // Get the local path of a checkpoint file which was left on the block service when the
+    // partition was restored in the cold-tier mode, downloading it if it's not cached.
+    // Return ERR_OBJECT_NOT_FOUND if the file is not in the cold tier.
+    error_code get_cold_tier_file(const std::string &name, /*out*/ std::string &local_path);
+
     //
     // Open the app.
     //
@@ -126,6 +157,10 @@ public:
 
     ::dsn::error_code apply_checkpoint(chkpt_apply_mode mode, const learn_state &state);
     ::dsn::error_code apply_mutation(const mutation *mu);
+    // apply a contiguous range of mutations in decree order, stops at the first failure.
+    // `applied` is the number of mutations applied successfully.
+    ::dsn::error_code apply_mutations(const std::vector<ref_ptr<mutation>> &mus,
+                                      size_t &applied);
 
     // methods need to implement on storage engine side
     virtual ::dsn::error_code start(int argc, char **argv) = 0;
@@ -149,6 +184,14 @@ public:
     //
     virtual ::dsn::error_code async_checkpoint(bool flush_memtable) = 0;
     //
+    // take a snapshot of the current state for checkpointing, which is called in the
+    // replication thread between the writes, so it must be cheap (e.g. by copy-on-write).
+    // the snapshot is then written by the replication layer in the background.
+    //
+    // Returns nullptr if not supported, and async_checkpoint() is used instead.
+    //
+    virtual std::unique_ptr<checkpoint_snapshot> take_checkpoint_snapshot() { return nullptr; }
+    //
     // prepare an app-specific learning request (on learner, to be sent to learnee
     // and used by method get_checkpoint), so that the learning process is more efficient
     //
@@ -220,6 +263,20 @@ public:
                                           dsn::message_ex **requests,
                                           int request_length);
 
+    //
+    // Same as on_batched_write_requests, but is called when the original client requests of
+    // the mutation are absent (on the non-primary replicas and during log replay), with the
+    // updates of the mutation as they are.
+    //
+    // The base class fakes a received message for each update and calls
+    // on_batched_write_requests. Storage engine may override this function to decode the
+    // updates directly, without the message allocations on every write.
+    //
+    virtual int on_batched_write_updates(int64_t decree,
+                                         uint64_t timestamp,
+                                         const mutation_update **updates,
+                                         int update_length);
+
     // query compact state.
     virtual std::string query_compact_state() const = 0;
 
@@ -243,6 +300,12 @@ public:
 
     virtual ingestion_status::type get_ingestion_status() { return ingestion_status::IS_INVALID; }
 
+    // Whether the app is able to ingest the files of a bulk load in the background, against the
+    // snapshot of the ingestion mutation, while the later mutations keep being applied, see
+    // `ingestion_request.non_blocking_ingestion`. The writes are rejected during the ingestion
+    // otherwise.
+    virtual bool support_non_blocking_ingestion() const { return false; }
+
     virtual void on_detect_hotkey(const detect_hotkey_request &req,
                                   /*out*/ detect_hotkey_response &resp)
     {
@@ -283,6 +346,9 @@ private:
                                        int64_t private_log_offset,
                                        int64_t durable_decree);
     ::dsn::error_code update_init_info_ballot_and_decree(replica *r);
+    // apply `mu` without updating the commit qps, `batched_count` is the count of the
+    // dispatched write requests
+    ::dsn::error_code apply_one_mutation(const mutation *mu, int &batched_count);
 
 protected:
     std::string _dir_data;      // ${replica_dir}/data
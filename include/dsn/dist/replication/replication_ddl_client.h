@@ -61,6 +61,12 @@ public:
                                const std::map<std::string, std::string> &envs,
                                bool is_stateless);
 
+    // create the apps of the options concurrently then wait for all of them to be ready, which
+    // is much faster than creating them one by one. the result of each app is returned in
+    // `results`, and the first error is returned if any of them failed.
+    dsn::error_code create_apps(const std::map<std::string, create_app_options> &apps,
+                                /*out*/ std::map<std::string, dsn::error_code> &results);
+
     // reserve_seconds == 0 means use default value in configuration 'hold_seconds_for_dropped_app'
     dsn::error_code drop_app(const std::string &app_name, int reserve_seconds);
 
@@ -84,6 +90,17 @@ public:
     list_nodes(const dsn::replication::node_status::type status,
                std::map<dsn::rpc_address, dsn::replication::node_status::type> &nodes);
 
+    // runs the remote command on the `nodes` concurrently, or on all the alive nodes if `nodes`
+    // is empty, then prints the outputs merged in JSON, or in a table of node, error and output.
+    // each node times out by itself after `timeout_ms`.
+    dsn::error_code remote_command_fanout(const std::vector<dsn::rpc_address> &nodes,
+                                          const std::string &cmd,
+                                          const std::vector<std::string> &arguments,
+                                          uint32_t concurrency,
+                                          int64_t timeout_ms,
+                                          bool json,
+                                          const std::string &file_name);
+
     dsn::error_code cluster_name(int64_t timeout_ms, std::string &cluster_name);
 
     dsn::error_code cluster_info(const std::string &file_name, bool resolve_ip, bool json);
@@ -99,6 +116,21 @@ public:
                              int32_t &partition_count,
                              std::vector<partition_configuration> &partitions);
 
+    struct app_partitions
+    {
+        dsn::error_code err;
+        int32_t app_id = 0;
+        int32_t partition_count = 0;
+        std::vector<partition_configuration> partitions;
+    };
+
+    // Queries the partition configurations of `app_names` in parallel, with at most
+    // [ddl_client] ddl_client_query_concurrency requests in flight. They share the time budget
+    // of [ddl_client] ddl_client_query_timeout_ms, the queries not done within it fail with
+    // ERR_TIMEOUT. Returns the first error of the apps.
+    dsn::error_code list_apps_partitions(const std::vector<std::string> &app_names,
+                                         /*out*/ std::map<std::string, app_partitions> &results);
+
     dsn::replication::configuration_meta_control_response
     control_meta_function_level(meta_function_level::type level);
 
@@ -131,7 +163,8 @@ public:
                                int32_t old_app_id,
                                const std::string &new_app_name,
                                bool skip_bad_partition,
-                               const std::string &restore_path = "");
+                               const std::string &restore_path = "",
+                               int32_t cold_tier_cache_mb = 0);
 
     dsn::error_code query_restore(int32_t restore_app_id, bool detailed);
 
@@ -170,6 +203,12 @@ public:
     set_app_envs(const std::string &app_name,
                  const std::vector<std::string> &keys,
                  const std::vector<std::string> &values);
+    // set the same envs on the apps concurrently, the result of each app is returned in
+    // `results`, and the first error is returned if any of them failed.
+    dsn::error_code set_apps_envs(const std::vector<std::string> &app_names,
+                                  const std::vector<std::string> &keys,
+                                  const std::vector<std::string> &values,
+                                  /*out*/ std::map<std::string, dsn::error_code> &results);
     dsn::error_code del_app_envs(const std::string &app_name, const std::vector<std::string> &keys);
     // precondition:
     //  -- if clear_all = true, just ignore prefix
@@ -184,10 +223,13 @@ public:
         const std::string &app_name,
         /*out*/ std::map<dsn::rpc_address, error_with<query_disk_info_response>> &resps);
 
+    // the writes are not rejected during the ingestion if `non_blocking_ingestion`, which the app
+    // must support
     error_with<start_bulk_load_response> start_bulk_load(const std::string &app_name,
                                                          const std::string &cluster_name,
                                                          const std::string &file_provider_type,
-                                                         const std::string &remote_root_path);
+                                                         const std::string &remote_root_path,
+                                                         bool non_blocking_ingestion = false);
 
     error_with<control_bulk_load_response>
     control_bulk_load(const std::string &app_name, const bulk_load_control_type::type control_type);
@@ -218,6 +260,11 @@ public:
 private:
     bool static valid_app_char(int c);
 
+    static dsn::error_code parse_partitions(const rpc_response_task_ptr &resp_task,
+                                            int32_t &app_id,
+                                            int32_t &partition_count,
+                                            std::vector<partition_configuration> &partitions);
+
     void end_meta_request(const rpc_response_task_ptr &callback,
                           int retry_times,
                           error_code err,
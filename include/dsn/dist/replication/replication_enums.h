@@ -60,6 +60,7 @@ ENUM_REG(replication::config_type::CT_ADD_SECONDARY_FOR_LB)
 ENUM_REG(replication::config_type::CT_PRIMARY_FORCE_UPDATE_BALLOT)
 ENUM_REG(replication::config_type::CT_DROP_PARTITION)
 ENUM_REG(replication::config_type::CT_REGISTER_CHILD)
+ENUM_REG(replication::config_type::CT_UPDATE_READ_REPLICAS)
 ENUM_END2(replication::config_type::type, config_type)
 
 ENUM_BEGIN2(replication::node_status::type, node_status, replication::node_status::NS_INVALID)
@@ -117,4 +118,11 @@ ENUM_REG(replication::disk_migration_status::MOVING)
 ENUM_REG(replication::disk_migration_status::MOVED)
 ENUM_REG(replication::disk_migration_status::CLOSED)
 ENUM_END2(replication::disk_migration_status::type, disk_migration_status)
+
+ENUM_BEGIN2(replication::background_task_type::type,
+            background_task_type,
+            replication::background_task_type::BT_INVALID)
+ENUM_REG(replication::background_task_type::BT_CHECKPOINT)
+ENUM_REG(replication::background_task_type::BT_MANUAL_COMPACTION)
+ENUM_END2(replication::background_task_type::type, background_task_type)
 } // namespace dsn
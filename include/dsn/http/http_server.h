@@ -48,6 +48,10 @@ struct http_request
     blob body;
     blob full_url;
     http_method method;
+    // the raw Accept-Encoding header, empty if not provided
+    std::string accept_encoding;
+    // whether the connection is kept alive after the response, which is the default of HTTP/1.1
+    bool keep_alive{true};
 };
 
 enum class http_status_code
@@ -0,0 +1,120 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+#include <dsn/perf_counter/perf_counter.h>
+
+namespace dsn {
+
+/// A block of the counters of one partition, registered in dsn::perf_counters as a single entry
+/// rather than counter by counter, so that opening thousands of replicas doesn't take the lock of
+/// the registry for every counter. A counter of the block is named "<name>@<label>" (e.g. the
+/// label is the gpid), which is exported with the label like the other counters.
+///
+/// The block is registered on construction and removed with all its counters on destruction.
+///
+/// Example usage:
+///    class replica {
+///        perf_counter_block _counter_block{"app", "eon.replica", "1.2"};
+///        lazy_perf_counter _counter_reject_count;
+///    };
+///    _counter_reject_count.init(&_counter_block, "recent.reject.count", COUNTER_TYPE_NUMBER);
+///
+class perf_counter_block
+{
+public:
+    perf_counter_block(const char *app, const char *section, std::string label);
+    ~perf_counter_block();
+
+    perf_counter_block(const perf_counter_block &) = delete;
+    perf_counter_block &operator=(const perf_counter_block &) = delete;
+
+    // get the counter "<name>@<label>" of the block, which is created if it doesn't exist
+    perf_counter_ptr get_counter(const char *name, dsn_perf_counter_type_t type);
+
+    const std::string &label() const { return _label; }
+
+private:
+    friend class perf_counters;
+
+    const std::string _app;
+    const std::string _section;
+    const std::string _label;
+    // <name, counter>, protected by the lock of perf_counters
+    std::unordered_map<std::string, perf_counter_ptr> _counters;
+};
+
+/// A counter of a perf_counter_block, which is created on its first non-zero update, so that the
+/// counters never updated, like the throttling ones of most partitions, cost neither memory nor
+/// registration. The block must outlive the counter.
+class lazy_perf_counter
+{
+public:
+    lazy_perf_counter() = default;
+    lazy_perf_counter(const lazy_perf_counter &) = delete;
+    lazy_perf_counter &operator=(const lazy_perf_counter &) = delete;
+
+    void init(perf_counter_block *block, std::string name, dsn_perf_counter_type_t type)
+    {
+        _block = block;
+        _name = std::move(name);
+        _type = type;
+    }
+
+    void increment() { materialize()->increment(); }
+    void add(int64_t val)
+    {
+        if (val != 0) {
+            materialize()->add(val);
+        }
+    }
+    void set(int64_t val)
+    {
+        perf_counter *c = _counter.load(std::memory_order_acquire);
+        if (c == nullptr && val == 0) {
+            return;
+        }
+        (c != nullptr ? c : materialize())->set(val);
+    }
+
+    // nullptr if the counter isn't created yet
+    perf_counter *get() const { return _counter.load(std::memory_order_acquire); }
+
+private:
+    perf_counter *materialize()
+    {
+        perf_counter *c = _counter.load(std::memory_order_acquire);
+        if (c == nullptr) {
+            // the block returns the same counter to the threads racing here
+            c = _block->get_counter(_name.c_str(), _type).get();
+            _counter.store(c, std::memory_order_release);
+        }
+        return c;
+    }
+
+    perf_counter_block *_block{nullptr};
+    std::string _name;
+    dsn_perf_counter_type_t _type{COUNTER_TYPE_NUMBER};
+    std::atomic<perf_counter *> _counter{nullptr};
+};
+
+} // namespace dsn
@@ -30,13 +30,19 @@
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 #include <dsn/perf_counter/perf_counter.h>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <queue>
 #include <functional>
+#include <unordered_set>
 
 namespace dsn {
 
+class perf_counter_block;
+
 /// Registry of all perf counters, users can get/create a specific perf counter
 /// via `get_app_counter` and `get_global_counter`.
 /// To push metrics to some monitoring systems (e.g Prometheus), users can
@@ -80,10 +86,13 @@ public:
         double value{0.0};
         std::string name;
         dsn_perf_counter_type_t type;
+        // the version of the snapshot in which the value was changed last time
+        uint64_t version{0};
 
     private:
         friend class perf_counters;
-        bool updated_recently{false};
+        // the version of the latest snapshot having this counter
+        uint64_t seen_version{0};
     };
 
     ///
@@ -109,10 +118,25 @@ public:
     /// TODO: totally eliminate this stupid snapshot feature with a better metrics library
     /// (a metric library which doesn't have SIDE EFFECT when you visit metric!!!)
     ///
+    /// every snapshot has a version increasing by 1, and the value of a counter is kept with
+    /// the version in which it was changed, so that the collectors of large counter sets can
+    /// read only the counters changed since the last time by iterate_snapshot_since.
+    ///
     typedef std::function<void(const counter_snapshot &)> snapshot_iterator;
     void take_snapshot();
     void iterate_snapshot(const snapshot_iterator &v) const;
 
+    // the version of the latest snapshot, 0 if no snapshot is taken
+    uint64_t snapshot_version() const;
+
+    // visits the counters whose value is changed after the snapshot of `version`, and stores the
+    // names of the ones removed since then into `removed` if it is not nullptr.
+    // returns false if `version` is so old that the removed counters are no longer tracked,
+    // then `removed` is not reliable and the caller should iterate_snapshot instead.
+    bool iterate_snapshot_since(uint64_t version,
+                                const snapshot_iterator &v,
+                                /*out*/ std::vector<std::string> *removed) const;
+
     // if found is not nullptr, then whether a counter was found will be stored in it
     // that is to say:
     //    if (found != nullptr && (*found)[i]==true) {
@@ -134,7 +158,22 @@ public:
         const std::vector<std::string> &args,
         std::function<bool(const std::string &arg, const counter_snapshot &cs)> filter) const;
 
+    // this function appends all counters to `out` in the Prometheus text exposition format,
+    // the app and section of a counter, and the table or partition after '@' in its name are
+    // put into labels. The counters other than percentile ones are read from the snapshot, a
+    // new snapshot is taken if the latest one is older than
+    // [perf_counters] prometheus_snapshot_max_age_seconds.
+    void dump_prometheus(/*out*/ std::string &out);
+
 private:
+    friend class perf_counter_block;
+
+    // called by perf_counter_block
+    void register_block(perf_counter_block *block);
+    void remove_block(perf_counter_block *block);
+    perf_counter_ptr
+    get_block_counter(perf_counter_block *block, const char *name, dsn_perf_counter_type_t type);
+
     // full_name = perf_counter::build_full_name(...);
     perf_counter *new_counter(const char *app,
                               const char *section,
@@ -142,7 +181,9 @@ private:
                               dsn_perf_counter_type_t type,
                               const char *dsptr);
 
-    void get_all_counters(std::vector<perf_counter_ptr> *all) const;
+    // the returned list is cached until a counter is created or removed, so that the frequent
+    // snapshots neither copy all counters nor block the registration for long
+    std::shared_ptr<const std::vector<perf_counter_ptr>> get_all_counters() const;
 
     mutable utils::rw_lock_nr _lock;
     // keep counter as a refptr to make the counter can be safely accessed
@@ -156,9 +197,22 @@ private:
         int user_reference;
     };
     std::unordered_map<std::string, counter_object> _counters;
+    // the counters of the blocks are listed in _all_counters together with _counters
+    std::unordered_set<perf_counter_block *> _blocks;
+    size_t _block_counter_count{0};
+    // protects the building of _all_counters under the read lock of _lock, it is reset under
+    // the write lock
+    mutable std::mutex _all_counters_lock;
+    mutable std::shared_ptr<const std::vector<perf_counter_ptr>> _all_counters;
 
     mutable utils::rw_lock_nr _snapshot_lock;
     std::unordered_map<std::string, counter_snapshot> _snapshots;
+    uint64_t _snapshot_version;
+    // <version, name> of the counters removed from the snapshots, the ones removed in the
+    // snapshots not after _removed_untracked_version are dropped
+    static constexpr uint64_t kMaxRemovedVersions = 64;
+    std::deque<std::pair<uint64_t, std::string>> _removed_snapshots;
+    uint64_t _removed_untracked_version;
 
     // timestamp in seconds when take snapshot of current counters
     int64_t _timestamp;
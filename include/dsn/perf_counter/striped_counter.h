@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dsn {
+
+// A 64-bit sum which is added by many threads concurrently, e.g. by the NUMBER and RATE
+// perf counters on the hottest paths.
+//
+// The sum is spread over stripes, each padded to the cache line size, so that the threads
+// adding to different stripes don't bounce the same cache line. A thread is assigned its
+// stripe round robin the first time it adds, thus up to `kStripeCount` threads never share
+// a stripe, instead of the threads whose ids are nearby sharing the adjacent slots.
+class striped_counter
+{
+public:
+    static constexpr int kStripeCount = 16;
+
+    striped_counter() = default;
+    striped_counter(const striped_counter &) = delete;
+    striped_counter &operator=(const striped_counter &) = delete;
+
+    void add(int64_t val)
+    {
+        _stripes[stripe_index()].value.fetch_add(val, std::memory_order_relaxed);
+    }
+
+    int64_t sum() const
+    {
+        int64_t val = 0;
+        for (const stripe &s : _stripes) {
+            val += s.value.load(std::memory_order_relaxed);
+        }
+        return val;
+    }
+
+    // returns the sum and resets it to zero
+    int64_t fetch_and_reset()
+    {
+        int64_t val = 0;
+        for (stripe &s : _stripes) {
+            val += s.value.exchange(0, std::memory_order_relaxed);
+        }
+        return val;
+    }
+
+    // not atomic to the concurrent adds, which may be lost or kept
+    void set(int64_t val)
+    {
+        for (stripe &s : _stripes) {
+            s.value.store(0, std::memory_order_relaxed);
+        }
+        _stripes[0].value.store(val, std::memory_order_relaxed);
+    }
+
+    // the stripe of the current thread, which is also used by the other striped structures
+    static int stripe_index()
+    {
+        static std::atomic<uint32_t> next_index{0};
+        static thread_local int index =
+            static_cast<int>(next_index.fetch_add(1, std::memory_order_relaxed) % kStripeCount);
+        return index;
+    }
+
+private:
+    struct stripe
+    {
+        std::atomic<int64_t> value{0};
+        char padding[64 - sizeof(std::atomic<int64_t>)];
+    };
+
+    stripe _stripes[kStripeCount];
+};
+
+} // namespace dsn
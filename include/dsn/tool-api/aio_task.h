@@ -83,6 +83,10 @@ public:
     using task::enqueue;
     void enqueue(error_code err, size_t transferred_size);
 
+    // complete the task in the calling thread in place of enqueue(err, transferred_size), the
+    // caller must run in the worker the task would be dispatched to
+    void exec_inline(error_code err, size_t transferred_size);
+
     size_t get_transferred_size() const { return _transferred_size; }
 
     // The ownership of `aio_context` is held by `aio_task`.
@@ -0,0 +1,90 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <sys/types.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/TokenBucket.h>
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+
+// the kinds of background I/O sharing the budget of a disk
+enum class background_io_class
+{
+    learn,          // the files served over nfs to the learners
+    bulk_load,      // the files downloaded by bulk load
+    backup,         // the checkpoint files uploaded by cold backup
+    disk_migration, // the checkpoints copied between the disks of a node
+    count
+};
+
+const char *background_io_class_to_string(background_io_class cls);
+
+// The node-wide limiter of the background I/O, with token buckets of two levels: each disk has
+// a budget of [background_io] disk_rate_mb, and each class on the disk has its own share of
+// [background_io] <class>_rate_mb. The I/O beyond the share of its class borrows the idle
+// budget of the disk if there is any, otherwise it waits for the share. A class without a share
+// waits for the budget of the disk, and the classes are limited by their shares only if the
+// disks have no budget. The rates are read on each call, so they can be updated at runtime,
+// and 0 means unlimited.
+class background_io_limiter : public utils::singleton<background_io_limiter>
+{
+public:
+    // returns how long the I/O of `bytes` of `cls` on the disk should wait before it's issued,
+    // the bytes are accounted as if the I/O is issued after the delay
+    std::chrono::milliseconds acquire(dev_t disk, background_io_class cls, uint64_t bytes);
+    std::chrono::milliseconds
+    acquire(dev_t disk, background_io_class cls, uint64_t bytes, double now_seconds);
+    // same as above, the disk is the one holding `path`
+    std::chrono::milliseconds
+    acquire(const std::string &path, background_io_class cls, uint64_t bytes);
+
+    // acquires and sleeps for the delay, for the I/O issued synchronously in the background
+    // threads
+    void throttle(const std::string &path, background_io_class cls, uint64_t bytes);
+
+private:
+    background_io_limiter();
+    ~background_io_limiter() = default;
+    friend class utils::singleton<background_io_limiter>;
+
+    static constexpr int kClassCount = static_cast<int>(background_io_class::count);
+
+    struct disk_buckets
+    {
+        folly::DynamicTokenBucket total;
+        folly::DynamicTokenBucket classes[kClassCount];
+    };
+    disk_buckets *get_disk_buckets(dev_t disk);
+
+    zlock _lock;
+    std::map<dev_t, std::unique_ptr<disk_buckets>> _disks;
+
+    perf_counter_wrapper _counter_bytes[kClassCount];
+    perf_counter_wrapper _counter_borrowed_bytes[kClassCount];
+    perf_counter_wrapper _counter_throttled_count[kClassCount];
+};
+
+} // namespace dsn
@@ -98,6 +98,12 @@ public:
     //
     virtual void inject_drop_message(message_ex *msg, bool is_send) = 0;
 
+    //
+    // open the session that `request` would be sent with to its to_address, without sending
+    // it, for the networks with sessions
+    //
+    virtual void prepare_session(message_ex *request) {}
+
     //
     // utilities
     //
@@ -168,6 +174,8 @@ public:
     // called upon RPC call, rpc client session is created on demand
     DSN_API virtual void send_message(message_ex *request) override;
 
+    DSN_API virtual void prepare_session(message_ex *request) override;
+
     // called by rpc engine
     DSN_API virtual void inject_drop_message(message_ex *msg, bool is_send) override;
 
@@ -175,9 +183,20 @@ public:
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) = 0;
 
 protected:
-    typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> client_sessions;
-    client_sessions _clients; // to_address => rpc_session
+    // the slot of the client session to send `request` with, see [network]
+    // client_sessions_per_server
+    DSN_API uint32_t get_client_session_slot(message_ex *request) const;
+
+    // the client session that `request` is sent with, which is created and connected on demand
+    rpc_session_ptr get_or_create_client_session(message_ex *request);
+
+protected:
+    // a server may be connected with several sessions, to keep the bulk traffic from blocking
+    // the latency-sensitive requests, a slot is nullptr until it is used
+    typedef std::unordered_map<::dsn::rpc_address, std::vector<rpc_session_ptr>> client_sessions;
+    client_sessions _clients; // to_address => rpc_sessions
     utils::rw_lock_nr _clients_lock;
+    uint32_t _cfg_client_sessions_per_server;
 
     typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> server_sessions;
     server_sessions _servers; // from_address => rpc_session
@@ -196,6 +215,8 @@ namespace security {
 class negotiation;
 }
 
+struct rpc_session_size_stats;
+
 class rpc_client_matcher;
 class rpc_session : public ref_counter
 {
@@ -239,6 +260,9 @@ public:
     bool try_pend_message(message_ex *msg);
     void clear_pending_messages();
 
+    // the lane of _messages which `msg` is queued in
+    static int get_send_lane(message_ex *msg);
+
     /// interfaces for security authentication,
     /// you can ignore them if you don't enable auth
     void set_negotiation_succeed();
@@ -247,6 +271,26 @@ public:
     void set_client_username(const std::string &user_name);
     const std::string &get_client_username() const;
 
+    // The acl decisions of this session, cached by the access controllers. A decision is keyed
+    // by the version of the acl it's made from, which is unique in the process, and stored in
+    // the slot picked by the controller, so a session accessing several tables keeps a decision
+    // for each of them. Returns false if there's no decision of `version`.
+    bool get_acl_decision(uint32_t slot, uint64_t version, /*out*/ bool &allowed) const
+    {
+        uint64_t decision =
+            _acl_decisions[slot % acl_decision_slots].load(std::memory_order_relaxed);
+        if ((decision >> 1) != version) {
+            return false;
+        }
+        allowed = (decision & 1) != 0;
+        return true;
+    }
+    void set_acl_decision(uint32_t slot, uint64_t version, bool allowed)
+    {
+        _acl_decisions[slot % acl_decision_slots].store((version << 1) | (allowed ? 1 : 0),
+                                                        std::memory_order_relaxed);
+    }
+
 public:
     ///
     /// for subclass to implement receiving message
@@ -290,11 +334,12 @@ protected:
     std::vector<message_ex *> _pending_messages;
 
     // messages are sent in batch, firstly all messages are linked together
-    // in a doubly-linked list "_messages".
+    // in the doubly-linked lists "_messages", one lane for each task priority.
     // if no messages are on-the-flying, a batch of messages are fetch from the "_messages"
+    // by weighted round robin of the lanes (see [network] send_lane_weight_*),
     // and put them to _sending_msgs; meanwhile, buffers of these messages are put
     // in _sending_buffers
-    dlink _messages;
+    dlink _messages[TASK_PRIORITY_COUNT];
     int _message_count; // count of _messages
 
     bool _is_sending_next;
@@ -335,6 +380,12 @@ private:
     // _client_username is only valid if it is a server rpc_session.
     // it represents the name of the corresponding client
     std::string _client_username;
+
+    static const int acl_decision_slots = 16;
+    std::atomic<uint64_t> _acl_decisions[acl_decision_slots]{};
+
+    // the bytes and sampled body sizes of the messages, see rpc_size_stats
+    std::unique_ptr<rpc_session_size_stats> _size_stats;
 };
 
 // --------- inline implementation --------------
@@ -63,13 +63,19 @@ typedef union msg_context
 {
     struct
     {
-        uint64_t is_request : 1;           ///< whether the RPC message is a request or response
-        uint64_t is_forwarded : 1;         ///< whether the msg is forwarded or not
-        uint64_t unused : 4;               ///< not used yet
-        uint64_t serialize_format : 4;     ///< dsn_msg_serialize_format
-        uint64_t is_forward_supported : 1; ///< whether support forwarding a message to real leader
-        uint64_t is_backup_request : 1;    ///< whether the RPC is a backup request
-        uint64_t reserved : 52;
+        uint64_t is_request : 1;            ///< whether the RPC message is a request or response
+        uint64_t is_forwarded : 1;          ///< whether the msg is forwarded or not
+        uint64_t compression_type : 2;      ///< dsn::utils::compression_type of the body
+        uint64_t accept_lz4 : 1;            ///< whether the sender can decompress lz4 bodies
+        uint64_t accept_zstd : 1;           ///< whether the sender can decompress zstd bodies
+        uint64_t serialize_format : 4;      ///< dsn_msg_serialize_format
+        uint64_t is_forward_supported : 1;  ///< whether support forwarding a message to real leader
+        uint64_t is_backup_request : 1;     ///< whether the RPC is a backup request
+        uint64_t is_trace_sampled : 1;      ///< whether the RPC belongs to a sampled trace
+        uint64_t parent_span_id : 32;       ///< span of the caller in the trace of trace_id
+        uint64_t read_staleness_bound : 16; ///< max lag of a secondary serving the read, 0 if none
+        uint64_t read_staleness_in_ms : 1;  ///< whether read_staleness_bound is in ms or decrees
+        uint64_t reserved : 2;
     } u;
     uint64_t context; ///< msg_context is of sizeof(uint64_t)
 } msg_context_t;
@@ -87,7 +93,7 @@ typedef struct message_header
     uint32_t body_length;
     uint32_t body_crc32;
     uint64_t id;       // sequence id, used to match request and response
-    uint64_t trace_id; // used for tracking source
+    uint64_t trace_id; // used for tracking source, shared by the rpcs of a sampled trace
     char rpc_name[DSN_MAX_TASK_CODE_NAME_LENGTH];
     fast_code rpc_code; // dsn::task_code
     dsn::gpid gpid;     // global partition id
@@ -148,6 +154,11 @@ public:
     // message_ex(blob bb, bool parse_hdr = true); // read
     DSN_API ~message_ex();
 
+    // the messages are allocated from the per-thread object pools of the tasks when
+    // [core] enable_task_object_pool is true, see task_object_pool
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     //
     // utility routines
     //
@@ -200,6 +211,8 @@ public:
     //
     DSN_API void write_next(void **ptr, size_t *size, size_t min_size);
     DSN_API void write_commit(size_t size);
+    // appends `data` as the next buffer of the body without copying it
+    DSN_API void write_append(const blob &data);
     DSN_API bool read_next(void **ptr, size_t *size);
     bool read_next(blob &data);
     DSN_API void read_commit(size_t size);
@@ -214,6 +227,16 @@ public:
 
     bool is_backup_request() const { return header->context.u.is_backup_request; }
 
+    // allows the read to be served by a secondary which lags behind the primary by at most
+    // `bound` decrees, or `bound` milliseconds if `in_ms` is true. 0 means primary only.
+    void set_read_staleness_bound(uint16_t bound, bool in_ms)
+    {
+        header->context.u.read_staleness_bound = bound;
+        header->context.u.read_staleness_in_ms = in_ms;
+    }
+    uint16_t read_staleness_bound() const { return header->context.u.read_staleness_bound; }
+    bool is_read_staleness_in_ms() const { return header->context.u.read_staleness_in_ms; }
+
 private:
     DSN_API message_ex();
     DSN_API void prepare_buffer_header();
@@ -228,6 +251,9 @@ private:
     int _rw_offset;     // current buffer offset
     bool _rw_committed; // mark if it is in middle state of reading/writing
     bool _is_read;      // is for read(recv) or write(send)
+    // the unused tail of the block holding the header, which is handed out by the first
+    // write_next() of a small body, see [network] message_inline_body_bytes
+    blob _inline_body;
 
 public:
     static uint32_t s_local_hash; // used by fast_rpc_name
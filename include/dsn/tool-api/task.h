@@ -185,6 +185,11 @@ public:
     virtual ~task();
     virtual void enqueue();
 
+    // task objects (including the subclasses) are allocated from the per-thread object pools
+    // when [core] enable_task_object_pool is true
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     //
     // if we successfully change a task's state from ready to cancelled, then return true,
     // otherwise, false is returned.
@@ -317,6 +322,8 @@ private:
 public:
     // used by task queue only
     task *next;
+    // when the task is put into the task queue, set only if enable_worker_stats is on
+    uint64_t enqueue_ts_ns;
 };
 typedef dsn::ref_ptr<dsn::task> task_ptr;
 
@@ -429,22 +436,31 @@ public:
     void exec() override
     {
         if (0 == _enqueue_ts_ns ||
-            dsn_now_ns() - _enqueue_ts_ns <
+            dsn_now_coarse_ns() - _enqueue_ts_ns <
                 static_cast<uint64_t>(_request->header->client.timeout_ms) * 1000000ULL) {
             if (dsn_likely(nullptr != _handler)) {
-                _handler(_request);
+                if (dsn_unlikely(_request->header->context.u.is_trace_sampled)) {
+                    exec_traced();
+                } else {
+                    _handler(_request);
+                }
             }
         } else {
-            dwarn("rpc_request_task(%s) from(%s) stop to execute due to timeout_ms(%d) exceed",
-                  spec().name.c_str(),
-                  _request->header->from_address.to_string(),
-                  _request->header->client.timeout_ms);
+            on_dropped_for_timeout();
         }
     }
 
 protected:
     void clear_non_trivial_on_task_end() override { _handler = nullptr; }
 
+    // called instead of the handler when the request has waited in queue for longer than
+    // its timeout, see task_spec::rpc_request_dropped_before_execution_when_timeout
+    void on_dropped_for_timeout();
+
+    // run the handler in a new span of the trace which the request belongs to, or just run it
+    // if [replication] enable_latency_tracer is off on this node
+    void exec_traced();
+
 protected:
     message_ex *_request;
     rpc_request_handler _handler;
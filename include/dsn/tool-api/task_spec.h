@@ -102,6 +102,35 @@ ENUM_REG(TM_REJECT)
 ENUM_REG(TM_DELAY)
 ENUM_END(throttling_mode_t)
 
+typedef enum rpc_compression_type_t {
+    RCT_NONE,
+    RCT_LZ4,
+    RCT_ZSTD,
+    RCT_COUNT,
+    RCT_INVALID
+} rpc_compression_type_t;
+
+ENUM_BEGIN(rpc_compression_type_t, RCT_INVALID)
+ENUM_REG(RCT_NONE)
+ENUM_REG(RCT_LZ4)
+ENUM_REG(RCT_ZSTD)
+ENUM_END(rpc_compression_type_t)
+
+// the class by which the disk io of a task is scheduled among the others on the same device
+typedef enum disk_io_priority_t {
+    DIO_PRIORITY_HIGH,   // e.g., appending the logs
+    DIO_PRIORITY_NORMAL, // e.g., serving the reads of the clients
+    DIO_PRIORITY_LOW,    // e.g., the background transfers of learning, backup and bulk load
+    DIO_PRIORITY_COUNT,
+    DIO_PRIORITY_INVALID // follows the task priority
+} disk_io_priority_t;
+
+ENUM_BEGIN(disk_io_priority_t, DIO_PRIORITY_INVALID)
+ENUM_REG(DIO_PRIORITY_HIGH)
+ENUM_REG(DIO_PRIORITY_NORMAL)
+ENUM_REG(DIO_PRIORITY_LOW)
+ENUM_END(disk_io_priority_t)
+
 typedef enum dsn_msg_serialize_format {
     DSF_INVALID = 0,
     DSF_THRIFT_BINARY = 1,
@@ -183,15 +212,29 @@ public:
     bool allow_inline;
     bool randomize_timer_delay_if_zero; // to avoid many timers executing at the same time
     network_header_format rpc_call_header_format;
+    // DSF_INVALID for DSF_THRIFT_BINARY, see `get_rpc_msg_payload_serialize_format`
     dsn_msg_serialize_format rpc_msg_payload_serialize_default_format;
     rpc_channel rpc_call_channel;
     bool rpc_message_crc_required;
+    // the codec used to compress the body of the requests, the responses are compressed with
+    // the same codec only when the client has announced that it supports it
+    rpc_compression_type_t rpc_message_compression_type;
+    uint32_t rpc_message_compression_threshold_bytes; // bodies smaller than it are sent as is
+    bool rpc_request_coalescing_enabled; // whether to coalesce the requests to the same server
+    int32_t rpc_call_connection_slot; // < 0 for routing by the priority
+    bool rpc_read_hedging_enabled;    // whether to hedge the idempotent reads to secondaries
+
+    // DIO_PRIORITY_INVALID for following the task priority, see `get_disk_io_priority`
+    disk_io_priority_t disk_io_priority;
 
     int32_t rpc_timeout_milliseconds;
     int32_t rpc_request_resend_timeout_milliseconds;  // 0 for no auto-resend
     throttling_mode_t rpc_request_throttling_mode;    //
     std::vector<int> rpc_request_delays_milliseconds; // see exp_delay for delaying recving
     bool rpc_request_dropped_before_execution_when_timeout;
+    bool rpc_request_reply_timeout_when_dropped;
+    // count of the requests dropped before execution for timeout
+    perf_counter_ptr rpc_request_dropped_counter;
 
     task_rejection_handler rejection_handler;
 
@@ -240,6 +283,19 @@ public:
 public:
     DSN_API static bool init();
     DSN_API void init_profiling(bool profile);
+
+    disk_io_priority_t get_disk_io_priority() const;
+    // the default of a task code which doesn't follow its task priority, used only if the
+    // disk_io_priority is not configured
+    DSN_API static void set_default_disk_io_priority(dsn::task_code code, disk_io_priority_t pri);
+
+    dsn_msg_serialize_format get_rpc_msg_payload_serialize_format() const;
+    // the default of a task code which isn't sent in thrift binary, used only if the
+    // rpc_msg_payload_serialize_default_format is not configured; as the receivers decode by the
+    // format in the header and the responses are in that of the requests, the peers needn't be
+    // told before
+    DSN_API static void set_default_rpc_msg_payload_serialize_format(dsn::task_code code,
+                                                                     dsn_msg_serialize_format fmt);
 };
 
 CONFIG_BEGIN(task_spec)
@@ -280,10 +336,12 @@ CONFIG_FLD_ID(network_header_format,
               "what kind of header format for this kind of rpc calls")
 CONFIG_FLD_ENUM(dsn_msg_serialize_format,
                 rpc_msg_payload_serialize_default_format,
-                DSF_THRIFT_BINARY,
+                DSF_INVALID,
                 DSF_INVALID,
                 false,
-                "what kind of payload serialization format for this kind of msgs")
+                "what kind of payload serialization format for this kind of msgs: "
+                "DSF_THRIFT_BINARY, DSF_THRIFT_COMPACT, DSF_THRIFT_JSON; DSF_THRIFT_BINARY if "
+                "not set")
 CONFIG_FLD_ID(rpc_channel,
               rpc_call_channel,
               RPC_CHANNEL_TCP,
@@ -294,6 +352,44 @@ CONFIG_FLD(bool,
            rpc_message_crc_required,
            false,
            "whether to calculate the crc checksum when send request/response")
+CONFIG_FLD_ENUM(rpc_compression_type_t,
+                rpc_message_compression_type,
+                RCT_NONE,
+                RCT_INVALID,
+                false,
+                "how to compress the body of the rpc messages of this kind: RCT_NONE, RCT_LZ4, "
+                "RCT_ZSTD; only takes effect for the messages in the dsn header format")
+CONFIG_FLD(uint32_t,
+           uint64,
+           rpc_message_compression_threshold_bytes,
+           4096,
+           "the message body will be compressed only when its size is not less than this value")
+CONFIG_FLD(bool,
+           bool,
+           rpc_request_coalescing_enabled,
+           false,
+           "whether to coalesce the requests of this kind to the same server into one frame, the "
+           "servers must support RPC_COALESCED_REQUESTS")
+CONFIG_FLD(int32_t,
+           int64,
+           rpc_call_connection_slot,
+           -1,
+           "which of the [network] client_sessions_per_server sessions to the server the requests "
+           "of this kind are sent with, -1 means to route by the task priority")
+CONFIG_FLD(bool,
+           bool,
+           rpc_read_hedging_enabled,
+           false,
+           "whether to send a backup request of this kind to a secondary when the primary "
+           "doesn't reply in time, only for the idempotent reads through partition_resolver")
+CONFIG_FLD_ENUM(disk_io_priority_t,
+                disk_io_priority,
+                DIO_PRIORITY_INVALID,
+                DIO_PRIORITY_INVALID,
+                false,
+                "the class by which the disk io of this kind is scheduled on a device: "
+                "DIO_PRIORITY_HIGH, DIO_PRIORITY_NORMAL, DIO_PRIORITY_LOW; follows the task "
+                "priority if not set")
 CONFIG_FLD(int32_t,
            uint64,
            rpc_timeout_milliseconds,
@@ -325,6 +421,12 @@ CONFIG_FLD(bool,
            false,
            "whether to drop a request right before execution when its queueing time is already "
            "greater than its timeout value")
+CONFIG_FLD(bool,
+           bool,
+           rpc_request_reply_timeout_when_dropped,
+           false,
+           "whether to reply ERR_TIMEOUT to the client when a request is dropped before execution "
+           "for timeout, or drop it silently")
 CONFIG_END
 
 } // end namespace
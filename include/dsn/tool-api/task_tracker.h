@@ -150,9 +150,16 @@ private:
 //    t.cancel_outstanding_tasks(); <-- right, cancel can apply to any tasks.
 //    tsk2.cancel(true); t.wait_out_standing_tasks(); <-- right, first cancel timer, then wait.
 //
+// 4. trackers used by many threads at a high rate (e.g., replica and mutation log) may use
+//    PER_THREAD_SHARDED, which keeps the tasks in buckets sharded by the creating thread,
+//    so that tracking and untracking a task seldom contend with the other threads.
+//
 class task_tracker
 {
 public:
+    // use a bucket for every hardware thread, see notice 4
+    static const int PER_THREAD_SHARDED = 0;
+
     explicit task_tracker(int task_bucket_count = 1);
     virtual ~task_tracker();
 
@@ -166,11 +173,24 @@ public:
     // return not finished task count
     int cancel_but_not_wait_outstanding_tasks();
 
+    int task_bucket_count() const { return _task_bucket_count; }
+
 private:
     friend class trackable_task;
+
+    // padded to the cache line size, so that threads working on different buckets
+    // don't contend on the same cache line
+    struct bucket
+    {
+        ::dsn::utils::ex_lock_nr_spin lock;
+        dlink tasks;
+        char padding[64 - (sizeof(::dsn::utils::ex_lock_nr_spin) + sizeof(dlink)) % 64];
+    };
+
+    static int get_task_bucket_count(int task_bucket_count);
+
     const int _task_bucket_count;
-    ::dsn::utils::ex_lock_nr_spin *_outstanding_tasks_lock;
-    dlink *_outstanding_tasks;
+    bucket *_buckets;
 };
 
 // ------- inlined implementation ----------
@@ -185,9 +205,9 @@ inline void trackable_task::set_tracker(task_tracker *owner, task *tsk)
         _dl_bucket_id =
             static_cast<int>(::dsn::utils::get_current_tid() % _owner->_task_bucket_count);
         {
-            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-                _owner->_outstanding_tasks_lock[_dl_bucket_id]);
-            _dl.insert_after(&_owner->_outstanding_tasks[_dl_bucket_id]);
+            auto &b = _owner->_buckets[_dl_bucket_id];
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+            _dl.insert_after(&b.tasks);
         }
     }
 }
@@ -219,8 +239,7 @@ inline trackable_task::owner_delete_state trackable_task::owner_delete_prepare()
 inline void trackable_task::owner_delete_commit()
 {
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-            _owner->_outstanding_tasks_lock[_dl_bucket_id]);
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_owner->_buckets[_dl_bucket_id].lock);
         _dl.remove();
     }
 
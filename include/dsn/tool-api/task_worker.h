@@ -40,10 +40,49 @@
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/dlib.h>
 #include <dsn/perf_counter/perf_counter.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <atomic>
+#include <mutex>
 #include <thread>
 
 namespace dsn {
 
+/*!
+ statistics of a task worker during a period of time, collected only when
+ enable_worker_stats of the thread pool is on
+*/
+struct task_worker_stats
+{
+    // bucket 0 counts the tasks which waited in queue for less than 1 microsecond,
+    // and bucket i (i > 0) counts those which waited for [2^(i-1), 2^i) microseconds
+    static const int WAIT_BUCKET_COUNT = 24;
+
+    uint64_t timestamp_ns; // when the period ends
+    uint64_t duration_ns;
+    uint64_t executed_count;
+    uint64_t busy_ns;
+    uint64_t wait_buckets[WAIT_BUCKET_COUNT];
+
+    task_worker_stats() { reset(); }
+
+    DSN_API void reset();
+    DSN_API void merge(const task_worker_stats &other);
+
+    // the queue wait time (in microseconds) under which the given percentage
+    // (0 ~ 100) of tasks fall, which is the upper bound of the bucket
+    DSN_API uint64_t wait_percentile_us(double percentage) const;
+    double tasks_per_second() const
+    {
+        return duration_ns == 0 ? 0.0 : executed_count * 1e9 / duration_ns;
+    }
+    double busy_ratio() const
+    {
+        return duration_ns == 0 ? 0.0 : std::min(1.0, busy_ns * 1.0 / duration_ns);
+    }
+
+    DSN_API static int wait_bucket(uint64_t wait_ns);
+};
+
 /*!
 @addtogroup tool-api-providers
 @{
@@ -83,6 +122,11 @@ public:
     DSN_API const threadpool_spec &pool_spec() const;
     DSN_API static task_worker *current();
 
+    // get the statistics since the last call, only valid when enable_worker_stats is on
+    DSN_API task_worker_stats collect_stats();
+    // get the statistics accumulated since the worker is created, whose duration_ns is 0
+    DSN_API task_worker_stats accumulated_stats() const;
+
 private:
     task_worker_pool *_owner_pool;
     task_queue *_input_queue;
@@ -94,6 +138,18 @@ private:
     utils::notify_event _started;
     int _processed_task_count;
 
+    // the moving average of the execution time of a task, used in the adaptive batch mode
+    uint64_t _avg_task_exec_ns;
+    perf_counter_wrapper _dequeue_batch_size_counter;
+
+    // written only by the worker thread, and read by accumulated_stats()
+    std::atomic<uint64_t> _stat_executed_count;
+    std::atomic<uint64_t> _stat_busy_ns;
+    std::atomic<uint64_t> _stat_wait_buckets[task_worker_stats::WAIT_BUCKET_COUNT];
+    // the accumulated values at the last collect_stats() call
+    std::mutex _stats_lock;
+    task_worker_stats _last_stats;
+
 public:
     DSN_API static void set_name(const char *name);
     DSN_API static void set_priority(worker_priority_t pri);
@@ -102,6 +158,17 @@ public:
 private:
     void run_internal();
 
+    // get the batch size for the next dequeue in the adaptive batch mode
+    int next_adaptive_batch_size();
+    // update the statistics for the adaptive batch mode after a batch is executed
+    void on_batch_executed(int batch_size, uint64_t exec_ns);
+
+    static void add_stat(std::atomic<uint64_t> &stat, uint64_t value)
+    {
+        // only the worker thread updates the stats, so no atomic read-modify-write is needed
+        stat.store(stat.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
 public:
     /*!
     @addtogroup tool-api-hooks
@@ -62,15 +62,28 @@ struct threadpool_spec
     bool worker_share_core;
     uint64_t worker_affinity_mask;
     int dequeue_batch_size;
+    bool adaptive_dequeue_batch;
+    int adaptive_dequeue_batch_max_size;
+    int adaptive_dequeue_batch_target_us;
     bool partitioned; // false by default
     std::string queue_factory_name;
     std::string worker_factory_name;
+    std::string timer_factory_name;
     std::list<std::string> queue_aspects;
     std::list<std::string> worker_aspects;
     int queue_length_throttling_threshold;
     bool enable_virtual_queue_throttling;
     std::string admission_controller_factory_name;
     std::string admission_controller_arguments;
+    int work_stealing_wait_us;
+    bool enable_worker_stats;
+    bool elastic_worker_count;
+    int min_worker_count;
+    int max_worker_count;
+    int elastic_target_wait_us;
+    int elastic_adjust_interval_ms;
+    int numa_node;
+    bool numa_spread;
 
     threadpool_spec(const dsn::threadpool_code &code) : name(code.to_string()), pool_code(code) {}
     threadpool_spec(const threadpool_spec &source) = default;
@@ -88,6 +101,23 @@ CONFIG_FLD(int,
            5,
            "how many tasks (if available) should be returned "
            "for one dequeue call for best batching performance")
+CONFIG_FLD(bool,
+           bool,
+           adaptive_dequeue_batch,
+           false,
+           "whether to tune the dequeue batch size of each worker adaptively according to "
+           "the queue depth and the task execution time, instead of using dequeue_batch_size")
+CONFIG_FLD(int,
+           uint64,
+           adaptive_dequeue_batch_max_size,
+           64,
+           "adaptive dequeue batch: the max tasks returned for one dequeue call")
+CONFIG_FLD(int,
+           uint64,
+           adaptive_dequeue_batch_target_us,
+           1000,
+           "adaptive dequeue batch: the expected execution time (in microseconds) of one batch, "
+           "which bounds the batch size so that a batch doesn't hold on too many tasks")
 CONFIG_FLD_ENUM(worker_priority_t,
                 worker_priority,
                 THREAD_xPRIORITY_NORMAL,
@@ -109,6 +139,9 @@ CONFIG_FLD(bool,
            "for workload hash partitioning for avoiding locking")
 CONFIG_FLD_STRING(queue_factory_name, "", "task queue provider name")
 CONFIG_FLD_STRING(worker_factory_name, "", "task worker provider name")
+CONFIG_FLD_STRING(timer_factory_name,
+                  "",
+                  "timer service provider name, use [core] timer_factory_name if not set")
 CONFIG_FLD_STRING_LIST(queue_aspects, "task queue aspects names, usually for tooling purpose")
 CONFIG_FLD_STRING_LIST(worker_aspects, "task aspects names, usually for tooling purpose")
 CONFIG_FLD(int,
@@ -127,5 +160,54 @@ CONFIG_FLD_STRING(admission_controller_factory_name,
 CONFIG_FLD_STRING(admission_controller_arguments,
                   "",
                   "arguments for the cusotmized admission controller")
+CONFIG_FLD(int,
+           uint64,
+           work_stealing_wait_us,
+           1000,
+           "work stealing: how long (in microseconds) an idle worker waits on its own queue "
+           "before trying to steal from its siblings, only used by work_stealing_task_queue")
+CONFIG_FLD(bool,
+           bool,
+           enable_worker_stats,
+           false,
+           "whether to collect the queue wait time and busy time of each worker, which can "
+           "be queried by the remote command thread-pool-stats")
+CONFIG_FLD(bool,
+           bool,
+           elastic_worker_count,
+           false,
+           "whether to grow and shrink the active workers of a non-partitioned pool between "
+           "min_worker_count and max_worker_count according to the queue wait time and the "
+           "busy ratio of the workers, starting from worker_count. it implies enable_worker_stats")
+CONFIG_FLD(int, uint64, min_worker_count, 1, "elastic worker count: the min active workers")
+CONFIG_FLD(int,
+           uint64,
+           max_worker_count,
+           0,
+           "elastic worker count: the max active workers, 0 for the number of cpus")
+CONFIG_FLD(int,
+           uint64,
+           elastic_target_wait_us,
+           5000,
+           "elastic worker count: the pool grows if the 90th percentile queue wait time is above "
+           "this, and may shrink if it stays below 1/4 of this")
+CONFIG_FLD(int,
+           uint64,
+           elastic_adjust_interval_ms,
+           1000,
+           "elastic worker count: how often the active worker count is adjusted")
+CONFIG_FLD(int,
+           int64,
+           numa_node,
+           -1,
+           "the numa node the workers are bound to, whose memory they allocate from preferably, "
+           "-1 for not bound. it overrides worker_affinity_mask")
+CONFIG_FLD(bool,
+           bool,
+           numa_spread,
+           false,
+           "whether to bind the workers to the numa nodes in blocks, the worker i of n to the node "
+           "i * #node / n, so the tasks of a partition in a partitioned pool, together with the "
+           "memory they allocate, stay on one node. it's ignored if numa_node is set")
 CONFIG_END
 }
@@ -55,6 +55,11 @@ public:
 private:
     DISALLOW_COPY_AND_ASSIGN(zlock);
     ilock *_h;
+    bool _recursive;
+    // set only when the hold time of the current acquisition is sampled by
+    // utils::lock_contention_profiler
+    const void *_hold_site;
+    uint64_t _hold_start_ns;
 };
 
 class rwlock_nr_provider;
@@ -75,6 +80,9 @@ public:
 private:
     DISALLOW_COPY_AND_ASSIGN(zrwlock_nr);
     rwlock_nr_provider *_h;
+    // the same as zlock, only sampled for the write lock
+    const void *_hold_site;
+    uint64_t _hold_start_ns;
 };
 
 class semaphore_provider;
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <dsn/tool_api.h>
+
+/*!
+Latency injector toollet
+
+This toollet slows down the rpc and the disk io by the rules added at runtime, to rehearse
+the gray failures such as a slow secondary or a degraded NIC. A rule matches the tasks of
+one kind, optionally of one task code, one remote address or one disk, and delays them by
+a random distribution, a bandwidth cap, or both:
+
+<PRE>
+
+[core]
+
+toollets = latency_injector
+
+[latency_injector]
+; the rules added on start, separated by ';'
+rules = slow_prepare rpc_request code=RPC_PREPARE delay=normal:20:5
+
+</PRE>
+
+The rules are managed by the remote command `latency-inject`:
+
+    latency-inject add <name> rpc_request|rpc_response|aio [code=<task code>]
+        [addr=<ip>[:<port>]] [disk=<path>] [ratio=<0..1>] [delay=<distribution>]
+        [bandwidth=<MB/s>]
+    latency-inject remove <name>
+    latency-inject clear
+    latency-inject list
+
+- rpc_request delays the handling of the requests received from `addr`
+- rpc_response delays the callbacks of the responses from `addr`
+- aio delays the completions of the disk io on the disk of `disk`
+- the distribution of the delay in ms is one of fixed:<ms>, uniform:<min>:<max>,
+  normal:<mean>:<stddev> or pareto:<min>:<alpha>
+- the bandwidth cap queues the bytes of the matched tasks on a virtual link of that rate
+- `ratio` of the matched tasks are delayed, 1 by default
+
+Only the first matched rule in the order of adding applies to a task.
+*/
+
+namespace dsn {
+namespace tools {
+
+enum class latency_target
+{
+    rpc_request,
+    rpc_response,
+    aio,
+};
+
+class latency_injector : public toollet
+{
+public:
+    explicit latency_injector(const char *name);
+    void install(service_spec &spec) override;
+
+    // adds the rule of `args`, e.g. {"slow_prepare", "rpc_request", "code=RPC_PREPARE",
+    // "delay=fixed:10"}, replacing the one of the same name; returns the error message,
+    // which is empty on success
+    static std::string add_rule(const std::vector<std::string> &args);
+    static bool remove_rule(const std::string &name);
+    static void clear_rules();
+    // one line for each rule, with the count of the tasks it has delayed
+    static std::string list_rules();
+
+    // the delay in ms injected into a task of `target` and `code`, transferring `bytes`
+    // with `remote`, or on the file of `fd` for aio; 0 if no rule matches
+    static uint32_t next_delay_ms(latency_target target,
+                                  task_code code,
+                                  ::dsn::rpc_address remote,
+                                  int fd,
+                                  uint64_t bytes);
+};
+
+} // namespace tools
+} // namespace dsn
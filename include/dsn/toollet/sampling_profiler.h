@@ -0,0 +1,62 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool_api.h>
+
+/*!
+Sampling profiler toollet
+
+This toollet samples the call stacks of the task worker threads by their thread cpu time,
+`sampling_frequency_hz` times per cpu second, and keeps the stacks aggregated by thread pool
+and task code over the last `window_seconds`. It's cheap enough to be always on, so that a
+cpu profile covering a latency incident can be retrieved after the fact, by the http call
+`/pprof/continuous?seconds=60` in the pprof format.
+
+<PRE>
+
+[core]
+
+toollets = sampling_profiler
+
+[sampling_profiler]
+sampling_frequency_hz = 19
+window_seconds = 600
+
+</PRE>
+*/
+
+namespace dsn {
+namespace tools {
+
+class sampling_profiler : public toollet
+{
+public:
+    explicit sampling_profiler(const char *name);
+    void install(service_spec &spec) override;
+
+    // whether the toollet is installed, the stacks are sampled only then
+    static bool installed();
+
+    // the stacks sampled in the last `seconds`, encoded as a pprof profile (profile.proto)
+    // labeled by "thread_pool" and "task_code"
+    static std::string get_profile(uint32_t seconds);
+};
+
+} // namespace tools
+} // namespace dsn
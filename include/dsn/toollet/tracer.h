@@ -47,12 +47,26 @@ Tracer toollet
 This toollet logs all task operations for the specified tasks,
 as configed below.
 
+To trace on the live nodes, the events can be sampled and filtered by the
+partitions of rpcs before anything is formatted, and kept in memory by the
+recent ones of each thread rather than logged, which are dumped as a chrome
+trace by the remote command tracer.dump_chrome_trace.
+
 <PRE>
 
 [core]
 
 toollets = tracer
 
+[tracer]
+; log, or ring which keeps the recent events in memory
+output = ring
+ring_size_per_thread = 16384
+; trace one in every N tasks or rpcs
+sampling_one_in = 100
+; only trace the rpcs of partition 1.0 and all partitions of app 2
+gpids = 1.0,2
+
 [task..default]
 is_trace = true
 
@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
 namespace dsn {
 namespace utils {
@@ -18,15 +20,46 @@ public:
     // Gets current time in nanoseconds.
     virtual uint64_t now_ns() const;
 
+    // Gets current time in nanoseconds cheaply, which may lag behind now_ns() by a few
+    // milliseconds. It's for the uses not needing the precision, e.g. the timeouts.
+    virtual uint64_t coarse_now_ns() const;
+
     // Gets singleton instance. eager singleton, which is thread safe
     static const clock *instance();
 
     // Resets the global clock implementation (not thread-safety)
     static void mock(clock *mock_clock);
 
+    // Resets the global clock implementation by [core] clock_source: "system" for the system
+    // clock, or "tsc" for tsc_clock, which falls back to the system clock if the tsc is not
+    // invariant. Returns false if the source is unknown. (not thread-safety)
+    static bool select(const std::string &source);
+
 private:
     static std::unique_ptr<clock> _clock;
 };
 
+// A clock reading the invariant tsc, which is several times cheaper than the system clock.
+//
+// The tsc rate is calibrated against the system clock at construction. Each thread converts its
+// tsc ticks since a base taken from the system clock, and retakes the base every 100ms, so the
+// time follows the adjustments of the system clock without drifting. The time is monotonic in
+// each thread.
+class tsc_clock : public clock
+{
+public:
+    tsc_clock();
+    virtual ~tsc_clock() = default;
+
+    virtual uint64_t now_ns() const override;
+
+    // whether the cpu has an invariant tsc
+    static bool supported();
+
+private:
+    uint64_t _ns_per_tick_q32; // ns per tick in 32.32 fixed point
+    uint64_t _rebase_ticks;
+};
+
 } // namespace utils
 } // namespace dsn
@@ -0,0 +1,55 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dsn {
+namespace utils {
+
+// Block compression codecs. The codecs are only available when the corresponding library is
+// linked, see compression_supported().
+enum class compression_type : uint8_t
+{
+    none = 0,
+    lz4 = 1,
+    zstd = 2,
+};
+
+const char *compression_type_to_string(compression_type type);
+
+// the reverse of compression_type_to_string, returns false if `name` is unknown
+bool compression_type_from_string(const char *name, /*out*/ compression_type &type);
+
+bool compression_supported(compression_type type);
+
+// the max size of the compressed data of `src_len` bytes
+size_t compress_bound(compression_type type, size_t src_len);
+
+// compress `src` into `dst` whose capacity should be at least compress_bound(),
+// returns the size of the compressed data, or 0 on failure
+size_t compress(compression_type type, const char *src, size_t src_len, char *dst, size_t dst_cap);
+
+// decompress `src` into `dst` whose size must be exactly the size of the original data,
+// returns false if the data is corrupted
+bool decompress(
+    compression_type type, const char *src, size_t src_len, char *dst, size_t dst_len);
+
+} // namespace utils
+} // namespace dsn
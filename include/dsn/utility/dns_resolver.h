@@ -0,0 +1,85 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+/// Resolves the host names to ipv4 addresses in background, and caches the results.
+///
+/// The results are cached for [network] dns_cache_ttl_seconds, and the failures for
+/// dns_negative_cache_ttl_seconds. An expired result is still returned at once, and refreshed in
+/// background; the last good address is kept if the refresh fails. So only the names never seen
+/// before wait for the dns servers, and at most dns_resolve_timeout_ms even if they are slow.
+class dns_resolver
+{
+public:
+    // the ip is in host byte order, 0 if the name can not be resolved
+    typedef std::function<void(uint32_t ip)> resolve_callback;
+
+    static dns_resolver &instance();
+
+    // returns 0 if the name can not be resolved, or the resolution times out
+    uint32_t resolve(const std::string &host);
+
+    // `callback` is called at once if the name is cached, otherwise on the resolver thread
+    void resolve_async(const std::string &host, resolve_callback callback);
+
+    // resolves by the system resolver without the cache
+    static uint32_t resolve_uncached(const char *host);
+
+    // for test
+    void clear_cache();
+
+private:
+    dns_resolver();
+    ~dns_resolver() = delete;
+
+    struct cache_entry
+    {
+        uint32_t ip{0};
+        bool resolved{false};
+        bool resolving{false};
+        uint64_t expire_ms{0};
+        std::vector<resolve_callback> callbacks;
+    };
+
+    // requires _lock held
+    void schedule(const std::string &host, cache_entry &entry);
+
+    void worker_loop();
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::unordered_map<std::string, cache_entry> _cache;
+    std::deque<std::string> _pending_hosts;
+    std::vector<std::thread> _workers;
+};
+
+} // namespace utils
+} // namespace dsn
@@ -123,6 +123,32 @@ bool link_file(const std::string &src, const std::string &target);
 
 error_code md5sum(const std::string &file_path, /*out*/ std::string &result);
 
+// Computes the md5 of every file by up to `parallelism` threads, 0 means
+// [core] filesystem_io_parallelism. results[i] is the md5 of file_paths[i].
+error_code md5sum_files(const std::vector<std::string> &file_paths,
+                        /*out*/ std::vector<std::string> &results,
+                        int parallelism = 0);
+
+// Copies `src` to `dst` which must not exist. If `allow_link`, the file is hard linked, which is
+// only correct for the immutable files, and copied if they are on different filesystems.
+// The copy is a reflink where the filesystem supports it, otherwise by copy_file_range in the
+// kernel, otherwise by reads and writes.
+error_code copy_file(const std::string &src, const std::string &dst, bool allow_link = false);
+
+// Copies the files whose paths are relative to `src_dir` into `dst_dir` by up to `parallelism`
+// threads, 0 means [core] filesystem_io_parallelism, the sub directories are created as needed.
+error_code copy_files(const std::string &src_dir,
+                      const std::vector<std::string> &files,
+                      const std::string &dst_dir,
+                      bool allow_link = false,
+                      int parallelism = 0);
+
+// Copies all the files under `src_dir` recursively into `dst_dir`, see copy_files.
+error_code copy_directory(const std::string &src_dir,
+                          const std::string &dst_dir,
+                          bool allow_link = false,
+                          int parallelism = 0);
+
 // return value:
 //  - <A, B>:
 //          A is represent whether operation encounter some local error
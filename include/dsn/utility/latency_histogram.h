@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace dsn {
+
+// A lock-free log-linear histogram of latencies in nanoseconds, with 16 buckets for every power
+// of two, so that the relative error of the percentiles is within 1/16. It's meant for the
+// benchmarks, where the samples of all threads are added to one histogram.
+class latency_histogram
+{
+public:
+    void add(uint64_t ns)
+    {
+        _buckets[index(ns)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while (ns > max && !_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset()
+    {
+        for (auto &b : _buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        uint64_t sum = 0;
+        for (const auto &b : _buckets) {
+            sum += b.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+    // Returns the lower bound of the bucket which the `p`-th percentile falls into,
+    // 0 if there is no sample.
+    uint64_t percentile(double p) const
+    {
+        uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(total * p / 100.0 + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; ++i) {
+            seen += _buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return lower_bound(i);
+            }
+        }
+        return lower_bound(kBucketCount - 1);
+    }
+
+private:
+    static int index(uint64_t ns)
+    {
+        if (ns < 16) {
+            return static_cast<int>(ns);
+        }
+        int msb = 63 - __builtin_clzll(ns);
+        return ((msb - 3) << 4) + static_cast<int>((ns >> (msb - 4)) & 15);
+    }
+
+    static uint64_t lower_bound(int idx)
+    {
+        if (idx < 16) {
+            return idx;
+        }
+        int msb = (idx >> 4) + 3;
+        return (1ULL << msb) | (static_cast<uint64_t>(idx & 15) << (msb - 4));
+    }
+
+    static const int kBucketCount = 1024;
+    std::atomic<uint64_t> _buckets[kBucketCount] = {};
+    std::atomic<uint64_t> _max{0};
+};
+
+} // namespace dsn
@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+/// Tracks the contention of zlock, zrwlock_nr and ex_lock_nr_spin per call site.
+///
+/// When it is stopped (by default) the locks only pay a relaxed load of a global flag. When
+/// started, each contended acquisition records its wait time to the call site, and one of
+/// every `hold_sample_interval` acquisitions of exclusive locks records its hold time.
+///
+/// Usage:
+///    lock_contention_profiler::start();
+///    ... wait for a while ...
+///    lock_contention_profiler::stop();
+///    auto sites = lock_contention_profiler::top_sites(20);
+///
+/// It's exposed by the http call `/pprof/contention?seconds=10&top=20`.
+class lock_contention_profiler
+{
+public:
+    struct site_stats
+    {
+        const void *site;
+        std::string symbol;
+        uint64_t contended_count;
+        uint64_t total_wait_ns;
+        uint64_t max_wait_ns;
+        uint64_t sampled_hold_count;
+        uint64_t total_sampled_hold_ns;
+        uint64_t max_hold_ns;
+    };
+
+    // clear the collected stats and start tracking
+    static void start(uint32_t hold_sample_interval = 100);
+    static void stop();
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // the call sites sorted by total wait time in descending order
+    static std::vector<site_stats> top_sites(int count);
+    // how many records are dropped because there are too many call sites
+    static uint64_t dropped_count();
+
+    // whether the hold time of the current acquisition should be recorded
+    static bool should_sample_hold();
+    static void record_wait(const void *site, uint64_t wait_ns);
+    static void record_hold(const void *site, uint64_t hold_ns);
+
+    static uint64_t now_ns();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+} // namespace utils
+} // namespace dsn
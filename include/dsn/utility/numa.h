@@ -0,0 +1,46 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+namespace numa {
+
+// The cpus of each numa node, read from /sys/devices/system/node. Returns a single node of all
+// the cpus if the topology is not available.
+const std::vector<std::vector<int>> &node_cpus();
+
+inline int node_count() { return static_cast<int>(node_cpus().size()); }
+
+// The node of the cpu the calling thread is running on, 0 if not available.
+int current_node();
+
+// Binds the calling thread to the cpus of `node`, and makes its memory allocated from `node`
+// preferably. As the pages are placed on the first touch, the memory a bound thread allocates
+// and writes first, e.g. its thread-local caches, is node-local.
+bool bind_current_thread(int node);
+
+// Parses a cpu list like "0-7,16-23".
+std::vector<int> parse_cpu_list(const std::string &list);
+
+} // namespace numa
+} // namespace utils
+} // namespace dsn
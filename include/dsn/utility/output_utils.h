@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 
+#include <dsn/c/api_utilities.h>
 #include <dsn/cpp/json_helper.h>
 
 namespace dsn {
@@ -31,6 +32,7 @@ namespace utils {
 
 class table_printer;
 class multi_table_printer;
+class json_table_writer;
 
 // Keep the same code style with dsn/cpp/json_helper.h
 template <typename Writer>
@@ -157,6 +159,7 @@ private:
 
 private:
     friend class multi_table_printer;
+    friend class json_table_writer;
     template <typename Writer>
     friend void json_encode(Writer &out, const table_printer &tp);
 
@@ -224,5 +227,91 @@ private:
 private:
     std::vector<table_printer> _tps;
 };
+
+/// Writes tables in the same format as multi_table_printer outputs them with kJsonCompact, but
+/// row by row into a string as they are added, so that the large tables needn't be kept in memory
+/// before being output.
+///
+/// Example usage:
+///    std::string out;
+///    json_table_writer writer(out);
+///    writer.start_table("sample_data", {"table_title", "column_name1", "column_name2"});
+///    for (...) {
+///        writer.add_row("row_name_i");
+///        writer.append_data(int_data);
+///        writer.append_data(double_data);
+///    }
+///    writer.end_table();
+///    writer.start_table("sample_data_2");
+///    writer.add_row_name_and_data("row_name_1", int_value);
+///    writer.end_table();
+///    writer.finish();
+///
+class json_table_writer
+{
+public:
+    explicit json_table_writer(std::string &out, int precision = 2);
+
+    // The table is in kMultiColumns mode if `columns` are given, of which the first is the title.
+    void start_table(const std::string &name, std::vector<std::string> columns = {});
+    void end_table();
+    // No more tables can be written after it.
+    void finish();
+
+    // kMultiColumns mode.
+    template <typename T>
+    void add_row(const T &row_name)
+    {
+        dassert(!_columns.empty(), "not in kMultiColumns mode");
+        if (_in_row) {
+            _writer.EndObject();
+        }
+        std::string name = _formatter.to_string(row_name);
+        json::json_encode(_writer, name);
+        _writer.StartObject();
+        json::json_encode(_writer, _columns[0]);
+        json::json_encode(_writer, name);
+        _in_row = true;
+        _column = 1;
+    }
+    template <typename T>
+    void append_data(const T &data)
+    {
+        dassert(_in_row && _column < _columns.size(), "column data exceed");
+        json::json_encode(_writer, _columns[_column++]);
+        json::json_encode(_writer, _formatter.to_string(data));
+    }
+
+    // kSingleColumn mode.
+    template <typename T>
+    void add_row_name_and_data(const std::string &row_name, const T &data)
+    {
+        dassert(_columns.empty(), "not in kSingleColumn mode");
+        // like table_printer, the table without any row is omitted
+        start_table_object();
+        json::json_encode(_writer, row_name);
+        json::json_encode(_writer, _formatter.to_string(data));
+    }
+
+private:
+    struct string_stream
+    {
+        typedef char Ch;
+        void Put(char c) { out.push_back(c); }
+        void Flush() {}
+        std::string &out;
+    };
+
+    void start_table_object();
+
+    string_stream _stream;
+    rapidjson::Writer<string_stream> _writer;
+    table_printer _formatter;
+    std::string _table_name;
+    bool _table_started;
+    std::vector<std::string> _columns;
+    bool _in_row;
+    size_t _column;
+};
 } // namespace utils
 } // namespace dsn
@@ -0,0 +1,60 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/utility/binary_writer.h>
+
+namespace dsn {
+
+// A thread-local cache of the chunks backing the buffers of pooled_binary_writer and the rpc
+// messages, in power-of-two size classes from MIN_CHUNK_SIZE to MAX_CHUNK_SIZE.
+//
+// A chunk goes back to the cache of the thread which releases the last blob referring to it,
+// which is not necessarily the thread which allocated it, and is freed when that cache is full.
+class binary_writer_chunk_pool
+{
+public:
+    static constexpr size_t MIN_CHUNK_SIZE = 256;
+    static constexpr size_t MAX_CHUNK_SIZE = 64 * 1024;
+
+    // Allocates a chunk of at least `size` bytes, the whole chunk is returned, so the blob may
+    // be longer than `size`. The chunks larger than MAX_CHUNK_SIZE are not cached.
+    static blob allocate(size_t size);
+
+    // The count of the chunks cached by the calling thread.
+    static size_t cached_chunk_count();
+};
+
+// A binary_writer whose buffers are drawn from binary_writer_chunk_pool rather than allocated
+// for every writer. Use get_buffers() to hand the buffers over without merging them.
+class pooled_binary_writer : public binary_writer
+{
+public:
+    explicit pooled_binary_writer(int reserved_buffer_size = 0)
+        : binary_writer(reserved_buffer_size)
+    {
+    }
+
+protected:
+    void create_new_buffer(size_t size, /*out*/ blob &bb) override
+    {
+        bb = binary_writer_chunk_pool::allocate(size);
+    }
+};
+
+} // namespace dsn
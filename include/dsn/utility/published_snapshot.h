@@ -0,0 +1,119 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace utils {
+
+/// An immutable object published by the writers and read on hot paths. set() replaces the
+/// whole object with a new version, and get() reads the current one without a lock or any
+/// shared write:
+///
+/// - each published object has a version, which is unique among all the published_snapshot<T>
+///   of the process;
+/// - each thread caches the objects it has read, in a few slots picked by the instance;
+/// - get() loads the current version, and returns the cached object if it has that version.
+///   Only after a change, or if another instance has taken the slot, does the thread copy the
+///   current object under the read lock.
+///
+/// The object returned by get() is valid until the next get() of any published_snapshot<T> on
+/// the same thread, which may replace it in the cache. So don't keep it across another get().
+/// A cached object is kept alive by the thread until its slot is reused, after it's replaced.
+template <typename T>
+class published_snapshot
+{
+public:
+    explicit published_snapshot(std::shared_ptr<const T> value)
+        : _slot(next_slot().fetch_add(1, std::memory_order_relaxed) % cache_slots),
+          _value(std::move(value)),
+          _version(next_version())
+    {
+    }
+
+    published_snapshot(const published_snapshot &) = delete;
+    published_snapshot &operator=(const published_snapshot &) = delete;
+
+    // the current object, and its version if `version` isn't null
+    const T &get(uint64_t *version = nullptr) const
+    {
+        cache_entry &entry = local_cache()[_slot];
+        if (entry.version != _version.load(std::memory_order_acquire)) {
+            auto_read_lock l(_lock);
+            entry.value = _value;
+            entry.version = _version.load(std::memory_order_relaxed);
+        }
+        if (version != nullptr) {
+            *version = entry.version;
+        }
+        return *entry.value;
+    }
+
+    // the version of the current object, never 0
+    uint64_t version() const { return _version.load(std::memory_order_acquire); }
+
+    // publishes `value` with a new version, the old object is released out of the lock if no
+    // thread caches it
+    void set(std::shared_ptr<const T> value)
+    {
+        uint64_t version = next_version();
+        auto_write_lock l(_lock);
+        _value.swap(value);
+        _version.store(version, std::memory_order_release);
+    }
+
+private:
+    static const int cache_slots = 16;
+
+    struct cache_entry
+    {
+        uint64_t version = 0;
+        std::shared_ptr<const T> value;
+    };
+
+    static cache_entry *local_cache()
+    {
+        static thread_local cache_entry entries[cache_slots];
+        return entries;
+    }
+
+    static uint64_t next_version()
+    {
+        static std::atomic<uint64_t> version{1};
+        return version.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static std::atomic<uint64_t> &next_slot()
+    {
+        static std::atomic<uint64_t> slot{0};
+        return slot;
+    }
+
+    const int _slot;
+    mutable rw_lock_nr _lock; // protects _value and the change of _version
+    std::shared_ptr<const T> _value;
+    std::atomic<uint64_t> _version;
+};
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace dsn {
+namespace utils {
+namespace detail {
+
+// An allocator which allocates `extra` bytes behind the object, where the object is the
+// control block of a shared_ptr when used by std::allocate_shared.
+template <typename T>
+struct tail_buffer_allocator
+{
+    using value_type = T;
+
+    tail_buffer_allocator(size_t extra_, char **tail_) : extra(extra_), tail(tail_) {}
+
+    template <typename U>
+    tail_buffer_allocator(const tail_buffer_allocator<U> &other)
+        : extra(other.extra), tail(other.tail)
+    {
+    }
+
+    static size_t head_size(size_t n)
+    {
+        constexpr size_t align = alignof(std::max_align_t);
+        return (n * sizeof(T) + align - 1) / align * align;
+    }
+
+    T *allocate(size_t n)
+    {
+        char *p = static_cast<char *>(::operator new(head_size(n) + extra));
+        *tail = p + head_size(n);
+        return reinterpret_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) { ::operator delete(p); }
+
+    template <typename U>
+    bool operator==(const tail_buffer_allocator<U> &) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const tail_buffer_allocator<U> &) const
+    {
+        return false;
+    }
+
+    size_t extra;
+    char **tail;
+};
+
+} // namespace detail
+
+/// Allocates an uninitialized buffer of `size` bytes along with its reference count in one
+/// allocation, rather than the two of std::shared_ptr<char>(new char[size], ...).
+/// The buffer is aligned to alignof(std::max_align_t).
+inline std::shared_ptr<char> make_shared_buffer(size_t size)
+{
+    char *tail = nullptr;
+    std::shared_ptr<char> holder =
+        std::allocate_shared<char>(detail::tail_buffer_allocator<char>(size, &tail));
+    // share the ownership of the control block, but point to the bytes behind it
+    return std::shared_ptr<char>(holder, tail);
+}
+
+} // namespace utils
+} // namespace dsn
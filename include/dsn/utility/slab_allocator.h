@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+/// A size-classed slab allocator for the small objects allocated and freed at high rates, e.g.
+/// the nodes of the hot containers through slab_stl_allocator.
+///
+/// Each thread allocates from and frees into its own cache without any synchronization. The
+/// caches exchange batches of objects with a depot shared by the threads, so the objects freed
+/// on a thread other than the allocating one (e.g. the rpc requests matched on the network
+/// threads) are batched back. The objects are carved from 64KB slabs that are kept for reuse
+/// rather than returned to the system.
+///
+/// The size must be passed to deallocate(), as the objects carry no header.
+class slab_allocator
+{
+public:
+    static constexpr size_t MAX_SIZE = 1024;
+
+    // Allocates `size` (<= MAX_SIZE) bytes aligned to 16.
+    static void *allocate(size_t size);
+
+    // Frees the object allocated by allocate(size).
+    static void deallocate(void *p, size_t size);
+
+    struct class_stats
+    {
+        size_t object_size;
+        uint64_t slab_bytes;     // the memory carved into the objects of this size
+        uint64_t depot_objects;  // the free objects in the depot, not counting the thread caches
+        uint64_t thread_refills; // the times a thread cache takes a batch or a new slab
+    };
+    static std::vector<class_stats> stats();
+};
+
+/// A C++ allocator backed by slab_allocator, the allocations larger than
+/// slab_allocator::MAX_SIZE (e.g. the bucket arrays of the hash maps) go to the operator new.
+template <typename T>
+class slab_stl_allocator
+{
+public:
+    using value_type = T;
+
+    slab_stl_allocator() noexcept = default;
+
+    template <typename U>
+    slab_stl_allocator(const slab_stl_allocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        size_t size = n * sizeof(T);
+        if (alignof(T) <= 16 && size <= slab_allocator::MAX_SIZE) {
+            return static_cast<T *>(slab_allocator::allocate(size));
+        }
+        return static_cast<T *>(::operator new(size));
+    }
+
+    void deallocate(T *p, size_t n) noexcept
+    {
+        size_t size = n * sizeof(T);
+        if (alignof(T) <= 16 && size <= slab_allocator::MAX_SIZE) {
+            slab_allocator::deallocate(p, size);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const slab_stl_allocator<U> &) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const slab_stl_allocator<U> &) const noexcept
+    {
+        return false;
+    }
+};
+
+} // namespace utils
+} // namespace dsn
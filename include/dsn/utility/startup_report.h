@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+namespace utils {
+
+class table_printer;
+
+/// Records how long each phase of the process start takes, to find out where the restart time
+/// goes. The phases are recorded in the order they finish, and may be nested, e.g. the loading
+/// of replicas is a part of starting the apps.
+///
+/// Once the start completes, all the phases are logged in one line. They are exposed by the http
+/// call `/startupReport` as well, along with the phases recorded after it.
+///
+/// Usage:
+///    {
+///        startup_phase_timer t("load_config");
+///        ... load the config ...
+///    }
+///    ...
+///    startup_report::instance().complete();
+class startup_report : public singleton<startup_report>
+{
+public:
+    struct phase
+    {
+        std::string name;
+        // since the process started
+        uint64_t start_offset_ms;
+        uint64_t duration_ms;
+    };
+
+    // `start_ms` is in the clock of get_current_physical_time_ns()
+    void add_phase(std::string name, uint64_t start_ms, uint64_t duration_ms);
+
+    // mark the start completed and log the phases, only the first call takes effect
+    void complete();
+
+    std::vector<phase> phases() const;
+    // 0 if not completed yet
+    uint64_t total_ms() const;
+
+    void get_report(table_printer &tp) const;
+
+private:
+    startup_report() = default;
+    ~startup_report() = default;
+    friend class singleton<startup_report>;
+
+    mutable std::mutex _lock;
+    std::vector<phase> _phases;
+    uint64_t _total_ms{0};
+};
+
+/// Records the phase named `name` to startup_report when it is destructed.
+class startup_phase_timer
+{
+public:
+    explicit startup_phase_timer(std::string name);
+    ~startup_phase_timer();
+
+private:
+    std::string _name;
+    uint64_t _start_ms;
+};
+
+} // namespace utils
+} // namespace dsn
@@ -6,6 +6,9 @@
 #include <map>
 #include <unordered_set>
 #include <iostream>
+#include <memory>
+
+struct MD5state_st;
 
 namespace dsn {
 namespace utils {
@@ -55,5 +58,21 @@ char *trim_string(char *s);
 
 // calculate the md5 checksum of buffer
 std::string string_md5(const char *buffer, unsigned int length);
+
+// calculate the md5 checksum of a byte stream piece by piece
+class md5_calculator
+{
+public:
+    md5_calculator();
+    ~md5_calculator();
+
+    void update(const char *buffer, size_t length);
+
+    // returns the checksum in hex, update() must not be called after that
+    std::string digest();
+
+private:
+    std::unique_ptr<MD5state_st> _ctx;
+};
 } // namespace utils
 } // namespace dsn
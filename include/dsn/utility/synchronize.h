@@ -27,6 +27,7 @@
 
 #include <dsn/utility/ports.h>
 #include <dsn/utility/utils.h>
+#include <dsn/utility/lock_contention_profiler.h>
 #include <dsn/utility/hpc_locks/benaphore.h>
 #include <dsn/utility/hpc_locks/autoresetevent.h>
 #include <dsn/utility/hpc_locks/rwlock.h>
@@ -57,9 +58,29 @@ private:
 class ex_lock_nr_spin
 {
 public:
-    __inline ex_lock_nr_spin() { _l = 0; }
+    __inline ex_lock_nr_spin() : _hold_site(nullptr), _hold_start_ns(0) { _l = 0; }
 
     __inline void lock()
+    {
+        if (dsn_unlikely(lock_contention_profiler::enabled())) {
+            lock_tracked();
+        } else {
+            lock_untracked();
+        }
+    }
+
+    __inline bool try_lock() { return 0 == _l.exchange(1, std::memory_order_acquire); }
+
+    __inline void unlock()
+    {
+        if (dsn_unlikely(_hold_site != nullptr)) {
+            unlock_tracked();
+        }
+        _l.store(0, std::memory_order_release);
+    }
+
+private:
+    __inline void lock_untracked()
     {
         while (!try_lock()) {
             while (_l.load(std::memory_order_consume) == 1) {
@@ -67,12 +88,15 @@ public:
         }
     }
 
-    __inline bool try_lock() { return 0 == _l.exchange(1, std::memory_order_acquire); }
-
-    __inline void unlock() { _l.store(0, std::memory_order_release); }
+    // not inlined so that the caller of lock() can be got as the call site
+    void lock_tracked();
+    void unlock_tracked();
 
 private:
     std::atomic<int> _l;
+    // set only when the hold time of the current acquisition is sampled
+    const void *_hold_site;
+    uint64_t _hold_start_ns;
 };
 
 class rw_lock_nr
@@ -40,6 +40,7 @@
 
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/utility/string_view.h>
+#include <dsn/utility/shared_buffer.h>
 
 #define TIME_MS_MAX 0xffffffff
 
@@ -72,6 +73,13 @@ std::shared_ptr<T> make_shared_array(size_t size)
     return std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
 }
 
+// the buffers of blobs are put in one allocation with their reference counts
+template <>
+inline std::shared_ptr<char> make_shared_array<char>(size_t size)
+{
+    return make_shared_buffer(size);
+}
+
 // get host name from ip series
 // if can't get a hostname from ip(maybe no hostname or other errors), return false, and
 // hostname_result will be invalid value
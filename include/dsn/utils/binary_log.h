@@ -0,0 +1,116 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/errors.h>
+#include <dsn/utility/string_view.h>
+
+namespace dsn {
+namespace utils {
+
+// The binary log is written by async_logger when [tools.async_logger] binary_format is true.
+// Instead of the formatted text, each record of dlog() holds the id of its format string and
+// its raw arguments, and the formatting is deferred to binary_log_decoder, offline.
+//
+// The file starts with binary_log::kMagic, followed by the records each starting with its
+// type byte:
+//  - format: id, line, file, function, format string. Each one is written into a file before
+//    the events referring to it.
+//  - event:  id, level, timestamp in ns, tid, prefix, arguments
+//  - text:   level, timestamp in ns, tid, line, prefix, file, function, text. It is for the
+//    records formatted already like dlog_f(), and the formats not supported like "%n".
+// The integers are of the native byte order, as the logs are decoded on the same kind of
+// machine, and the strings are prefixed by their uint32 lengths. The arguments are prefixed by
+// their total uint32 length, each is an int64 for the integers and characters, a double for
+// the floats, an uint64 for the pointers and a string for "%s".
+namespace binary_log {
+
+extern const char kMagic[8];
+
+enum record_type : uint8_t
+{
+    kFormat = 1,
+    kEvent = 2,
+    kText = 3,
+};
+
+struct format_info
+{
+    uint32_t id;
+    uint32_t line;
+    std::string file;
+    std::string function;
+    std::string fmt;
+};
+
+void encode_format(const format_info &format, std::string &out);
+
+// the arguments of `fmt` are encoded, false if it has a conversion not supported, in which case
+// `out` is left unchanged
+bool encode_event(uint32_t id,
+                  dsn_log_level_t log_level,
+                  uint64_t ts_ns,
+                  int tid,
+                  const std::string &prefix,
+                  const char *fmt,
+                  va_list args,
+                  std::string &out);
+
+void encode_text(dsn_log_level_t log_level,
+                 uint64_t ts_ns,
+                 int tid,
+                 const std::string &prefix,
+                 const char *file,
+                 const char *function,
+                 int line,
+                 string_view text,
+                 std::string &out);
+
+} // namespace binary_log
+
+// binary_log_decoder decodes the records of a binary log into the lines as simple_logger
+// writes them. It is not thread-safe.
+class binary_log_decoder
+{
+public:
+    explicit binary_log_decoder(bool short_header) : _short_header(short_header) {}
+
+    // decode the record at the beginning of `data`, the format records are kept for the later
+    // events and the others are appended to `out` as lines. Returns the size of the record, or
+    // 0 if the data is incomplete or corrupted.
+    size_t decode(string_view data, std::string &out);
+
+    // get the level of the event or text record at the beginning of `data`
+    static bool peek_level(string_view data, dsn_log_level_t &log_level);
+
+private:
+    bool _short_header;
+    std::vector<binary_log::format_info> _formats;
+};
+
+// decode the binary log file at `path` into `out`
+error_s decode_binary_log_file(const std::string &path, std::ostream &out, bool short_header);
+
+} // namespace utils
+} // namespace dsn
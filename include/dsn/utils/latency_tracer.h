@@ -19,6 +19,10 @@
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace dsn {
 namespace utils {
@@ -65,6 +69,65 @@ namespace utils {
  * "request.tracer" will record the time duration among all trace points.
 **/
 DSN_DECLARE_bool(enable_latency_tracer);
+DSN_DECLARE_double(trace_sample_ratio);
+
+// The context of a distributed trace, which links the spans of a request on different nodes.
+// It's carried by the message_header of the rpc requests (trace_id, context.u.is_trace_sampled
+// and context.u.parent_span_id), the rpc_engine puts the context of the current thread into
+// the requests it sends, and the rpc handler of a sampled request runs with a new span of the
+// trace as the context of the thread.
+struct trace_context
+{
+    uint64_t trace_id = 0;
+    uint32_t span_id = 0;
+    // 0 if the span is the root of the trace
+    uint32_t parent_span_id = 0;
+    bool sampled = false;
+
+    // the context of the current thread, not sampled if there is no trace
+    static const trace_context &current();
+
+    // whether to start a new trace for a request which isn't in any trace
+    static bool should_sample();
+
+    static uint32_t new_span_id();
+};
+
+// Set the context of the current thread in a scope.
+class trace_context_scope
+{
+public:
+    explicit trace_context_scope(const trace_context &context);
+    ~trace_context_scope();
+
+private:
+    trace_context _saved;
+};
+
+struct trace_span
+{
+    trace_context context;
+    std::string name;
+    // the address of the node which the span runs on, empty if unknown
+    std::string node;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
+    // the trace points of the span, <timestamp, name>
+    std::vector<std::pair<uint64_t, std::string>> points;
+};
+
+// The collector of the finished spans of the sampled traces, the default one writes each span
+// as a line of json into the log, which starts with "TRACE_SPAN:".
+class trace_span_exporter
+{
+public:
+    virtual ~trace_span_exporter() = default;
+    virtual void export_span(const trace_span &span) = 0;
+};
+
+// replace the exporter, nullptr to restore the default one
+void set_trace_span_exporter(std::unique_ptr<trace_span_exporter> exporter);
+void export_trace_span(const trace_span &span);
 
 class latency_tracer
 {
@@ -93,17 +156,29 @@ public:
     // stageA[rpc_message]--stageB[rpc_message]--
     void set_sub_tracer(const std::shared_ptr<latency_tracer> &tracer);
 
+    // the category by which the slow_request_recorder keeps the slowest requests, e.g. the task
+    // code of the request, it's the name before '[' by default
+    void set_category(const std::string &category);
+
+    // the span of the tracer, which is a child of the context of the thread which creates the
+    // tracer, the span is exported when the tracer is destructed if it's sampled
+    const trace_context &context() const { return _context; }
+
 private:
     void dump_trace_points(/*out*/ std::string &traces);
 
+    void record_slow_request();
+
     utils::rw_lock_nr _lock;
 
     const std::string _name;
+    std::string _category;
     const uint64_t _threshold;
     bool _is_sub;
     const uint64_t _start_time;
     std::map<int64_t, std::string> _points;
     std::shared_ptr<latency_tracer> _sub_tracer;
+    trace_context _context;
 
     friend class latency_tracer_test;
 };
@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dsn/utility/flags.h>
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+namespace utils {
+
+DSN_DECLARE_uint32(slow_request_recorder_size);
+DSN_DECLARE_uint32(slow_request_window_seconds);
+
+struct slow_request
+{
+    // the name of the root latency_tracer
+    std::string name;
+    uint64_t start_ns = 0;
+    uint64_t latency_ns = 0;
+    // the trace points of the tracer and its sub tracers, <span from the previous point, name>
+    std::vector<std::pair<uint64_t, std::string>> stages;
+};
+
+// The slowest requests of a category (e.g. the task code of a write) in a time window.
+struct slow_request_window
+{
+    std::string category;
+    uint64_t window_start_ms = 0;
+    // sorted by latency in descending order
+    std::vector<slow_request> requests;
+};
+
+/// Keeps the `slow_request_recorder_size` slowest requests of each category in the current and
+/// the previous windows of `slow_request_window_seconds`, recorded by the root latency_tracers
+/// when they are destructed. So the stage breakdown of a slow request can be looked up on the
+/// node after the fact, by the http call `/replica/slow_requests`.
+///
+/// The memory is bounded by kMaxCategories * 2 * slow_request_recorder_size requests. Most
+/// requests are faster than the slowest ones so far, and they are rejected by a relaxed load
+/// without any lock; only the ones to be kept lock their category.
+class slow_request_recorder : public singleton<slow_request_recorder>
+{
+public:
+    static constexpr int kMaxCategories = 64;
+
+    // records the request of `latency_ns` that finished at `end_ns` if it is one of the slowest
+    // in its category, `fill` is called to fill the details of the request only then.
+    // returns whether it is recorded.
+    bool try_record(const std::string &category,
+                    uint64_t end_ns,
+                    uint64_t latency_ns,
+                    const std::function<void(slow_request &)> &fill);
+
+    // the windows of the categories, of all if `category` is empty, the previous window of a
+    // category comes before its current one
+    std::vector<slow_request_window> get_windows(const std::string &category) const;
+
+    // only used by tests
+    void clear();
+
+private:
+    slow_request_recorder();
+    ~slow_request_recorder() = default;
+    friend class singleton<slow_request_recorder>;
+
+    struct category_slot
+    {
+        // 0 if the slot is not used
+        std::atomic<uint64_t> hash{0};
+        // the end of the current window, and the latency to beat in it
+        std::atomic<uint64_t> window_end_ns{0};
+        std::atomic<uint64_t> threshold_ns{0};
+
+        mutable std::mutex lock;
+        std::string category;
+        uint64_t current_start_ns = 0;
+        std::vector<slow_request> current;
+        uint64_t previous_start_ns = 0;
+        std::vector<slow_request> previous;
+    };
+
+    category_slot *find_or_add_slot(const std::string &category);
+
+    std::unique_ptr<category_slot[]> _slots;
+    std::atomic<uint64_t> _dropped_count;
+};
+
+} // namespace utils
+} // namespace dsn
@@ -69,6 +69,10 @@ public:
 
     virtual aio_context *prepare_aio_context(aio_task *) = 0;
 
+    // Whether the batched write tasks can be submitted with their `_unmerged_write_buffers`,
+    // otherwise the buffers are collapsed into a single one before submission.
+    virtual bool support_vectored_write() const { return false; }
+
     void complete_io(aio_task *aio, error_code err, uint32_t bytes);
 
 private:
@@ -54,4 +54,15 @@ void aio_task::enqueue(error_code err, size_t transferred_size)
     task::enqueue(node()->computation()->get_pool(spec().pool_code));
 }
 
+void aio_task::exec_inline(error_code err, size_t transferred_size)
+{
+    set_error_code(err);
+    _transferred_size = transferred_size;
+
+    spec().on_aio_enqueue.execute(this);
+
+    add_ref(); // released in exec_internal
+    exec_internal();
+}
+
 } // namespace dsn
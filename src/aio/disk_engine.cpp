@@ -27,10 +27,14 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/aio_task.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
 
 #include "disk_engine.h"
 #include "runtime/service_engine.h"
 #include "native_linux_aio_provider.h"
+#include "io_uring_aio_provider.h"
+
+#include <sys/stat.h>
 
 using namespace dsn::utils;
 
@@ -39,6 +43,32 @@ DEFINE_TASK_CODE_AIO(LPC_AIO_BATCH_WRITE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFA
 
 const char *native_aio_provider = "dsn::tools::native_aio_provider";
 DSN_REGISTER_COMPONENT_PROVIDER(native_linux_aio_provider, native_aio_provider);
+#ifdef DSN_HAS_IO_URING
+DSN_REGISTER_COMPONENT_PROVIDER(io_uring_aio_provider, "dsn::tools::io_uring_aio_provider");
+#endif
+
+DSN_DEFINE_string("core",
+                  aio_factory_name,
+                  "dsn::tools::native_aio_provider",
+                  "the provider of the disk io, e.g. dsn::tools::io_uring_aio_provider");
+
+DSN_DEFINE_uint32("aio",
+                  disk_io_queue_depth,
+                  0,
+                  "the max count of the io submitted to the provider at a time for each device, "
+                  "the others are queued and submitted by their disk_io_priority, 0 for no limit");
+DSN_DEFINE_uint32("aio",
+                  disk_io_high_priority_deadline_ms,
+                  10,
+                  "the high priority io queued for this long (ms) is submitted to the provider "
+                  "even if disk_io_queue_depth is reached");
+DSN_TAG_VARIABLE(disk_io_high_priority_deadline_ms, FT_MUTABLE);
+DSN_DEFINE_uint32("aio",
+                  disk_io_reserved_queue_depth,
+                  1,
+                  "how many of the disk_io_queue_depth slots of a device are never taken by the "
+                  "low priority io, unless the device is idle");
+DSN_TAG_VARIABLE(disk_io_reserved_queue_depth, FT_MUTABLE);
 
 struct disk_engine_initializer
 {
@@ -49,6 +79,83 @@ struct disk_engine_initializer
 // because service_engine relies on the former to close files.
 static disk_engine_initializer disk_engine_init;
 
+//----------------- disk_io_scheduler ------------------------
+disk_io_scheduler::disk_io_scheduler(uint32_t queue_depth, submitter submit)
+    : _queue_depth(queue_depth), _submit(std::move(submit)), _inflight_count(0)
+{
+}
+
+void disk_io_scheduler::submit(aio_task *aio)
+{
+    if (_queue_depth == 0) {
+        _submit(aio);
+        return;
+    }
+
+    std::vector<aio_task *> ready;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        uint64_t now_ms = dsn_now_ms();
+        _queues[priority_of(aio)].emplace_back(aio, now_ms);
+        while (aio_task *next = pop_next(now_ms)) {
+            ready.push_back(next);
+        }
+    }
+    // submit out of the lock, because the io may complete inline
+    for (aio_task *next : ready) {
+        _submit(next);
+    }
+}
+
+void disk_io_scheduler::on_completed(aio_task *aio)
+{
+    if (_queue_depth == 0) {
+        return;
+    }
+
+    std::vector<aio_task *> ready;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        dassert(_inflight_count > 0,
+                "%s completes without being submitted",
+                aio->spec().name.c_str());
+        --_inflight_count;
+        uint64_t now_ms = dsn_now_ms();
+        while (aio_task *next = pop_next(now_ms)) {
+            ready.push_back(next);
+        }
+    }
+    for (aio_task *next : ready) {
+        _submit(next);
+    }
+}
+
+aio_task *disk_io_scheduler::pop_next(uint64_t now_ms)
+{
+    disk_io_priority_t pri;
+    const auto &high = _queues[DIO_PRIORITY_HIGH];
+    if (!high.empty() &&
+        (_inflight_count < _queue_depth ||
+         now_ms >= high.front().second + FLAGS_disk_io_high_priority_deadline_ms)) {
+        pri = DIO_PRIORITY_HIGH;
+    } else if (_inflight_count >= _queue_depth) {
+        return nullptr;
+    } else if (!_queues[DIO_PRIORITY_NORMAL].empty()) {
+        pri = DIO_PRIORITY_NORMAL;
+    } else if (!_queues[DIO_PRIORITY_LOW].empty() &&
+               (_inflight_count == 0 ||
+                _inflight_count + FLAGS_disk_io_reserved_queue_depth < _queue_depth)) {
+        pri = DIO_PRIORITY_LOW;
+    } else {
+        return nullptr;
+    }
+
+    aio_task *aio = _queues[pri].front().first;
+    _queues[pri].pop_front();
+    ++_inflight_count;
+    return aio;
+}
+
 //----------------- disk_file ------------------------
 aio_task *disk_write_queue::unlink_next_workload(void *plength)
 {
@@ -91,7 +198,10 @@ aio_task *disk_write_queue::unlink_next_workload(void *plength)
     return first;
 }
 
-disk_file::disk_file(dsn_handle_t handle) : _handle(handle) {}
+disk_file::disk_file(dsn_handle_t handle, disk_io_scheduler *scheduler)
+    : _handle(handle), _scheduler(scheduler)
+{
+}
 
 aio_task *disk_file::read(aio_task *tsk)
 {
@@ -149,11 +259,49 @@ aio_task *disk_file::on_write_completed(aio_task *wk, void *ctx, error_code err,
 }
 
 //----------------- disk_engine ------------------------
-disk_engine::disk_engine()
+disk_engine::disk_engine() {}
+
+aio_provider &disk_engine::get_provider()
+{
+    std::call_once(_provider_once, [this]() {
+        aio_provider *provider = utils::factory_store<aio_provider>::create(
+            FLAGS_aio_factory_name, dsn::PROVIDER_TYPE_MAIN, this);
+        if (provider == nullptr) {
+            derror("aio provider %s is not found, use %s instead",
+                   FLAGS_aio_factory_name,
+                   native_aio_provider);
+            provider = utils::factory_store<aio_provider>::create(
+                native_aio_provider, dsn::PROVIDER_TYPE_MAIN, this);
+        }
+        _provider.reset(provider);
+    });
+    return *_provider;
+}
+
+disk_io_scheduler *disk_engine::get_scheduler(dsn_handle_t handle)
+{
+    // the files whose device is unknown share one scheduler
+    dev_t dev = 0;
+    struct stat st;
+    if (::fstat((int)(uintptr_t)handle, &st) == 0) {
+        dev = st.st_dev;
+    } else {
+        dwarn("fstat failed, err = %s", strerror(errno));
+    }
+
+    utils::auto_lock<utils::ex_lock_nr> l(_schedulers_lock);
+    auto &scheduler = _schedulers[dev];
+    if (scheduler == nullptr) {
+        scheduler = make_unique<disk_io_scheduler>(
+            FLAGS_disk_io_queue_depth,
+            [this](aio_task *aio) { get_provider().submit_aio_task(aio); });
+    }
+    return scheduler.get();
+}
+
+void disk_engine::submit(aio_task *aio)
 {
-    aio_provider *provider = utils::factory_store<aio_provider>::create(
-        native_aio_provider, dsn::PROVIDER_TYPE_MAIN, this);
-    _provider.reset(provider);
+    static_cast<disk_file *>(aio->get_aio_context()->file_object)->scheduler()->submit(aio);
 }
 
 class batch_write_io_task : public aio_task
@@ -179,6 +327,15 @@ public:
     aio_task *_tasks;
 };
 
+disk_io_priority_t disk_io_scheduler::priority_of(aio_task *aio)
+{
+    // a batch is scheduled as its first write
+    if (aio->code() == LPC_AIO_BATCH_WRITE) {
+        aio = static_cast<batch_write_io_task *>(aio)->_tasks;
+    }
+    return aio->spec().get_disk_io_priority();
+}
+
 void disk_engine::write(aio_task *aio)
 {
     if (!aio->spec().on_aio_call.execute(task::get_current_task(), aio, true)) {
@@ -206,8 +363,12 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
 
     // no batching
     if (dio->buffer_size == sz) {
-        aio->collapse();
-        _provider->submit_aio_task(aio);
+        // the providers which write the unmerged buffers in one vectored write don't need
+        // to copy them into a single one
+        if (!get_provider().support_vectored_write()) {
+            aio->collapse();
+        }
+        submit(aio);
     }
 
     // batching
@@ -252,6 +413,11 @@ void disk_engine::complete_io(aio_task *aio, error_code err, uint32_t bytes)
               aio->id());
     }
 
+    // the queued io is submitted before the completed one is enqueued, after which it may be
+    // released
+    auto df = (disk_file *)(aio->get_aio_context()->file_object);
+    df->scheduler()->on_completed(aio);
+
     // batching
     if (aio->code() == LPC_AIO_BATCH_WRITE) {
         aio->enqueue(err, (size_t)bytes);
@@ -260,11 +426,10 @@ void disk_engine::complete_io(aio_task *aio, error_code err, uint32_t bytes)
 
     // no batching
     else {
-        auto df = (disk_file *)(aio->get_aio_context()->file_object);
         if (aio->get_aio_context()->type == AIO_Read) {
             auto wk = df->on_read_completed(aio, err, (size_t)bytes);
             if (wk) {
-                _provider->submit_aio_task(wk);
+                submit(wk);
             }
         }
 
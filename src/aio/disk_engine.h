@@ -32,8 +32,46 @@
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/work_queue.h>
 
+#include <deque>
+#include <functional>
+#include <map>
+#include <sys/types.h>
+
 namespace dsn {
 
+// Schedules the disk io submitted to one device by the `disk_io_priority` of their tasks: at
+// most [aio] disk_io_queue_depth of them are submitted to the provider at a time, the others are
+// queued and submitted by their priority as the submitted ones complete. The high priority io
+// that has been queued for [aio] disk_io_high_priority_deadline_ms is submitted even if the
+// depth is reached, and the low priority io never takes the last
+// [aio] disk_io_reserved_queue_depth slots, so that the logs are not appended behind a pile of
+// background io like the reads of the learners.
+class disk_io_scheduler
+{
+public:
+    typedef std::function<void(aio_task *)> submitter;
+
+    // the io is submitted immediately when `queue_depth` is 0
+    disk_io_scheduler(uint32_t queue_depth, submitter submit);
+
+    void submit(aio_task *aio);
+    void on_completed(aio_task *aio);
+
+    static disk_io_priority_t priority_of(aio_task *aio);
+
+private:
+    // pops the next io to submit, nullptr if none
+    aio_task *pop_next(uint64_t now_ms);
+
+    const uint32_t _queue_depth;
+    submitter _submit;
+
+    utils::ex_lock_nr _lock;
+    uint32_t _inflight_count;
+    // with the time (ms) they are queued
+    std::deque<std::pair<aio_task *, uint64_t>> _queues[DIO_PRIORITY_COUNT];
+};
+
 class disk_write_queue : public work_queue<aio_task>
 {
 public:
@@ -52,7 +90,7 @@ private:
 class disk_file
 {
 public:
-    disk_file(dsn_handle_t handle);
+    disk_file(dsn_handle_t handle, disk_io_scheduler *scheduler);
     aio_task *read(aio_task *tsk);
     aio_task *write(aio_task *tsk, void *ctx);
 
@@ -61,9 +99,11 @@ public:
 
     // TODO(wutao1): make it uint64_t
     dsn_handle_t native_handle() const { return _handle; }
+    disk_io_scheduler *scheduler() const { return _scheduler; }
 
 private:
     dsn_handle_t _handle;
+    disk_io_scheduler *_scheduler;
     disk_write_queue _write_queue;
     work_queue<aio_task> _read_queue;
 };
@@ -72,7 +112,12 @@ class disk_engine : public utils::singleton<disk_engine>
 {
 public:
     void write(aio_task *aio);
-    static aio_provider &provider() { return *instance()._provider.get(); }
+    // submits the io to the provider through the scheduler of its device
+    void submit(aio_task *aio);
+    // the scheduler of the device on which the file is, which lives as long as the engine
+    disk_io_scheduler *get_scheduler(dsn_handle_t handle);
+    // the provider is created on the first use, after the flags are loaded
+    static aio_provider &provider() { return instance().get_provider(); }
 
 private:
     // the object of disk_engine must be created by `singleton::instance`
@@ -81,12 +126,18 @@ private:
 
     void process_write(aio_task *wk, uint32_t sz);
     void complete_io(aio_task *aio, error_code err, uint32_t bytes);
+    aio_provider &get_provider();
 
+    std::once_flag _provider_once;
     std::unique_ptr<aio_provider> _provider;
 
+    utils::ex_lock_nr _schedulers_lock;
+    std::map<dev_t, std::unique_ptr<disk_io_scheduler>> _schedulers;
+
     friend class aio_provider;
     friend class batch_write_io_task;
     friend class utils::singleton<disk_engine>;
+    friend class io_uring_aio_provider_test;
 };
 
 } // namespace dsn
@@ -34,7 +34,7 @@ namespace file {
 {
     dsn_handle_t nh = disk_engine::provider().open(file_name, flag, pmode);
     if (nh != DSN_INVALID_FILE_HANDLE) {
-        return new disk_file(nh);
+        return new disk_file(nh, disk_engine::instance().get_scheduler(nh));
     } else {
         return nullptr;
     }
@@ -84,7 +84,7 @@ namespace file {
     }
     auto wk = file->read(cb);
     if (wk) {
-        disk_engine::provider().submit_aio_task(wk);
+        disk_engine::instance().submit(wk);
     }
     return cb;
 }
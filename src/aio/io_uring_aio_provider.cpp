@@ -0,0 +1,282 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "io_uring_aio_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include "runtime/service_engine.h"
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/flags.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("aio",
+                  io_uring_entries,
+                  256,
+                  "the count of the submission queue entries of the io_uring aio provider, "
+                  "which limits the io in flight");
+DSN_DEFINE_bool("aio",
+                io_uring_direct_io,
+                false,
+                "whether the io_uring aio provider bypasses the page cache with O_DIRECT for "
+                "the io whose buffer, offset and length are aligned");
+
+namespace {
+const uint64_t EVENT_USER_DATA = 0;
+const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+bool is_aligned(uint64_t value) { return value % DIRECT_IO_ALIGNMENT == 0; }
+} // anonymous namespace
+
+struct io_uring_aio_provider::request
+{
+    aio_task *aio;
+    std::vector<iovec> iovs;
+};
+
+io_uring_aio_provider::io_uring_aio_provider(disk_engine *disk)
+    : native_linux_aio_provider(disk),
+      _ring_entries(FLAGS_io_uring_entries),
+      _ring_started(false),
+      _event_fd(-1),
+      _event_value(0),
+      _stopping(false)
+{
+    // the tests which use the simulator need sync submission
+    if (service_engine::instance().is_simulator()) {
+        return;
+    }
+
+    int ret = _ring.init(_ring_entries);
+    if (ret < 0) {
+        dwarn("init io_uring failed, fall back to blocking io, err = %s", strerror(-ret));
+        return;
+    }
+    _event_fd = eventfd(0, EFD_CLOEXEC);
+    if (_event_fd < 0) {
+        dwarn("create eventfd failed, fall back to blocking io, err = %s", strerror(errno));
+        return;
+    }
+
+    _ring_started = true;
+    _ring_thread = std::thread([this]() { run(); });
+}
+
+io_uring_aio_provider::~io_uring_aio_provider()
+{
+    if (_ring_started) {
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_lock);
+            _stopping = true;
+        }
+        uint64_t one = 1;
+        ::write(_event_fd, &one, sizeof(one));
+        _ring_thread.join();
+    }
+    if (_event_fd >= 0) {
+        ::close(_event_fd);
+    }
+    for (const auto &kv : _direct_fds) {
+        ::close(kv.second);
+    }
+}
+
+dsn_handle_t io_uring_aio_provider::open(const char *file_name, int flag, int pmode)
+{
+    dsn_handle_t fh = native_linux_aio_provider::open(file_name, flag, pmode);
+    if (fh == DSN_INVALID_FILE_HANDLE || !FLAGS_io_uring_direct_io) {
+        return fh;
+    }
+
+    // the file is created by the buffered open
+    int direct_fd = ::open(file_name, (flag & ~(O_CREAT | O_EXCL | O_TRUNC)) | O_DIRECT);
+    if (direct_fd < 0) {
+        dwarn("open %s with O_DIRECT failed, use buffered io instead, err = %s",
+              file_name,
+              strerror(errno));
+        return fh;
+    }
+    utils::auto_write_lock l(_fds_lock);
+    _direct_fds[(int)(uintptr_t)fh] = direct_fd;
+    return fh;
+}
+
+error_code io_uring_aio_provider::close(dsn_handle_t fh)
+{
+    if (fh != DSN_INVALID_FILE_HANDLE && FLAGS_io_uring_direct_io) {
+        utils::auto_write_lock l(_fds_lock);
+        auto iter = _direct_fds.find((int)(uintptr_t)fh);
+        if (iter != _direct_fds.end()) {
+            ::close(iter->second);
+            _direct_fds.erase(iter);
+        }
+    }
+    return native_linux_aio_provider::close(fh);
+}
+
+int io_uring_aio_provider::get_direct_fd(int fd)
+{
+    utils::auto_read_lock l(_fds_lock);
+    auto iter = _direct_fds.find(fd);
+    return iter == _direct_fds.end() ? -1 : iter->second;
+}
+
+void io_uring_aio_provider::submit_aio_task(aio_task *aio_tsk)
+{
+    if (!_ring_started) {
+        // the blocking io writes the unmerged buffers with pwritev as well
+        native_linux_aio_provider::submit_aio_task(aio_tsk);
+        return;
+    }
+
+    bool wakeup;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        wakeup = _pending.empty();
+        _pending.push_back(aio_tsk);
+    }
+    if (wakeup) {
+        uint64_t one = 1;
+        ::write(_event_fd, &one, sizeof(one));
+    }
+}
+
+void io_uring_aio_provider::read_event()
+{
+    io_uring_sqe *sqe = _ring.get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = _event_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&_event_value);
+    sqe->len = sizeof(_event_value);
+    sqe->user_data = EVENT_USER_DATA;
+}
+
+void io_uring_aio_provider::prepare(request *req, io_uring_sqe *sqe)
+{
+    aio_context *ctx = req->aio->get_aio_context();
+    int fd = (int)(uintptr_t)ctx->file;
+    sqe->off = ctx->file_offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(req);
+
+    if (ctx->type == AIO_Write && ctx->buffer == nullptr) {
+        // a batch of the writes in disk_write_queue
+        for (const dsn_file_buffer_t &buf : req->aio->_unmerged_write_buffers) {
+            req->iovs.push_back({buf.buffer, static_cast<size_t>(buf.size)});
+        }
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(req->iovs.data());
+        sqe->len = static_cast<uint32_t>(req->iovs.size());
+        return;
+    }
+
+    sqe->opcode = (ctx->type == AIO_Read) ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->addr = reinterpret_cast<uint64_t>(ctx->buffer);
+    sqe->len = ctx->buffer_size;
+    sqe->fd = fd;
+    if (FLAGS_io_uring_direct_io && is_aligned(sqe->addr) && is_aligned(sqe->len) &&
+        is_aligned(sqe->off)) {
+        int direct_fd = get_direct_fd(fd);
+        if (direct_fd >= 0) {
+            sqe->fd = direct_fd;
+        }
+    }
+}
+
+void io_uring_aio_provider::complete(request *req, int res)
+{
+    aio_task *aio_tsk = req->aio;
+    delete req;
+
+    error_code err = ERR_OK;
+    uint32_t processed_bytes = 0;
+    if (res < 0) {
+        derror("io_uring %s failed, err = %s",
+               aio_tsk->get_aio_context()->type == AIO_Read ? "read" : "write",
+               strerror(-res));
+        err = ERR_FILE_OPERATION_FAILED;
+    } else if (res == 0 && aio_tsk->get_aio_context()->type == AIO_Read) {
+        err = ERR_HANDLE_EOF;
+    } else {
+        processed_bytes = static_cast<uint32_t>(res);
+    }
+
+    // the tasks created on completion, e.g. the next batch write, belong to the node
+    task::set_tls_dsn_context(aio_tsk->node(), nullptr);
+    complete_io(aio_tsk, err, processed_bytes);
+}
+
+void io_uring_aio_provider::run()
+{
+    // the eventfd read is always in flight
+    unsigned inflight = 0;
+    std::vector<aio_task *> pending;
+    read_event();
+    while (true) {
+        std::vector<aio_task *> queued;
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_lock);
+            if (_stopping && pending.empty() && _pending.empty() && inflight == 0) {
+                break;
+            }
+            queued.swap(_pending);
+        }
+        pending.insert(pending.end(), queued.begin(), queued.end());
+
+        // keep the completions in flight within the completion queue
+        size_t submitted = 0;
+        while (submitted < pending.size() && inflight < _ring_entries - 1) {
+            io_uring_sqe *sqe = _ring.get_sqe();
+            if (sqe == nullptr) {
+                break;
+            }
+            prepare(new request{pending[submitted], {}}, sqe);
+            submitted++;
+            inflight++;
+        }
+        pending.erase(pending.begin(), pending.begin() + submitted);
+
+        int ret = _ring.submit_and_wait(1);
+        if (ret < 0) {
+            derror("io_uring submit failed, err = %s", strerror(-ret));
+        }
+
+        io_uring_cqe *cqe;
+        while ((cqe = _ring.peek_cqe()) != nullptr) {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            _ring.cqe_seen();
+
+            if (user_data == EVENT_USER_DATA) {
+                read_event();
+            } else {
+                inflight--;
+                complete(reinterpret_cast<request *>(user_data), res);
+            }
+        }
+    }
+}
+
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
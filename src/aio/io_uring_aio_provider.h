@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include "runtime/rpc/io_uring_context.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include "native_linux_aio_provider.h"
+
+#include <dsn/utility/synchronize.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace dsn {
+
+// An aio provider which submits the disk io to io_uring, so the io is truly asynchronous
+// and no thread of the disk pools is occupied while it's in flight.
+//
+// A dedicated thread owns the ring. submit_aio_task() queues the tasks and wakes it up with
+// an eventfd, which is read by the ring itself, then all the queued tasks are submitted in
+// one syscall. The batched writes of disk_write_queue are submitted as a single writev of
+// their unmerged buffers.
+//
+// If [aio] io_uring_direct_io is set, a second fd with O_DIRECT is opened for each file,
+// which serves the io whose buffer, offset and length are aligned.
+//
+// It falls back to the blocking io of native_linux_aio_provider if io_uring is unavailable.
+class io_uring_aio_provider : public native_linux_aio_provider
+{
+public:
+    explicit io_uring_aio_provider(disk_engine *disk);
+    ~io_uring_aio_provider() override;
+
+    dsn_handle_t open(const char *file_name, int flag, int pmode) override;
+    error_code close(dsn_handle_t fh) override;
+
+    void submit_aio_task(aio_task *aio) override;
+    bool support_vectored_write() const override { return true; }
+
+private:
+    struct request;
+
+    void run();
+    void read_event();
+    void prepare(request *req, io_uring_sqe *sqe);
+    void complete(request *req, int res);
+    int get_direct_fd(int fd);
+
+private:
+    tools::io_uring_context _ring;
+    unsigned _ring_entries;
+    bool _ring_started;
+    int _event_fd;
+    uint64_t _event_value;
+    std::thread _ring_thread;
+
+    utils::ex_lock_nr _lock; // [
+    std::vector<aio_task *> _pending;
+    bool _stopping;
+    // ]
+
+    utils::rw_lock_nr _fds_lock; // [
+    // the O_DIRECT fd of each file
+    std::unordered_map<int, int> _direct_fds;
+    // ]
+
+    friend class io_uring_aio_provider_test;
+};
+
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
@@ -30,6 +30,11 @@
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/c/api_utilities.h>
 
+#include <sys/uio.h>
+#include <algorithm>
+#include <climits>
+#include <vector>
+
 namespace dsn {
 
 native_linux_aio_provider::native_linux_aio_provider(disk_engine *disk) : aio_provider(disk) {}
@@ -79,6 +84,45 @@ error_code native_linux_aio_provider::write(const aio_context &aio_ctx,
     return ERR_OK;
 }
 
+error_code native_linux_aio_provider::write_vector(aio_task *aio_tsk,
+                                                   /*out*/ uint32_t *processed_bytes)
+{
+    const aio_context *aio_ctx = aio_tsk->get_aio_context();
+    int fd = static_cast<int>((ssize_t)aio_ctx->file);
+    std::vector<iovec> iovs;
+    iovs.reserve(aio_tsk->_unmerged_write_buffers.size());
+    for (const dsn_file_buffer_t &buf : aio_tsk->_unmerged_write_buffers) {
+        iovs.push_back({buf.buffer, static_cast<size_t>(buf.size)});
+    }
+
+    // pwritev accepts at most IOV_MAX buffers, and may write less than requested, in which
+    // case the rest of the buffers are written from where it stopped
+    uint64_t written = 0;
+    size_t index = 0;
+    while (index < iovs.size()) {
+        int count = static_cast<int>(std::min<size_t>(iovs.size() - index, IOV_MAX));
+        ssize_t ret = pwritev(fd, &iovs[index], count, aio_ctx->file_offset + written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERR_FILE_OPERATION_FAILED;
+        }
+        written += ret;
+        size_t left = static_cast<size_t>(ret);
+        while (index < iovs.size() && left >= iovs[index].iov_len) {
+            left -= iovs[index].iov_len;
+            ++index;
+        }
+        if (left > 0) {
+            iovs[index].iov_base = static_cast<char *>(iovs[index].iov_base) + left;
+            iovs[index].iov_len -= left;
+        }
+    }
+    *processed_bytes = static_cast<uint32_t>(written);
+    return ERR_OK;
+}
+
 error_code native_linux_aio_provider::read(const aio_context &aio_ctx,
                                            /*out*/ uint32_t *processed_bytes)
 {
@@ -118,7 +162,11 @@ error_code native_linux_aio_provider::aio_internal(aio_task *aio_tsk)
         err = read(*aio_ctx, &processed_bytes);
         break;
     case AIO_Write:
-        err = write(*aio_ctx, &processed_bytes);
+        if (aio_ctx->buffer == nullptr && !aio_tsk->_unmerged_write_buffers.empty()) {
+            err = write_vector(aio_tsk, &processed_bytes);
+        } else {
+            err = write(*aio_ctx, &processed_bytes);
+        }
         break;
     default:
         return err;
@@ -44,9 +44,14 @@ public:
 
     void submit_aio_task(aio_task *aio) override;
     aio_context *prepare_aio_context(aio_task *tsk) override { return new aio_context; }
+    bool support_vectored_write() const override { return true; }
 
 protected:
     error_code aio_internal(aio_task *aio);
+
+    // write the `_unmerged_write_buffers` of a batched write task with pwritev, which saves
+    // copying them into a single buffer as aio_task::collapse does.
+    error_code write_vector(aio_task *aio, /*out*/ uint32_t *processed_bytes);
 };
 
 } // namespace dsn
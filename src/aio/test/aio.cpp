@@ -29,6 +29,7 @@
 #include <dsn/utility/smart_pointers.h>
 
 #include <gtest/gtest.h>
+#include <climits>
 
 using namespace ::dsn;
 
@@ -127,6 +128,36 @@ TEST(core, aio)
     utils::filesystem::remove_path("tmp");
 }
 
+TEST(core, aio_write_vector_over_iov_max)
+{
+    // more buffers than a single pwritev accepts
+    const int count = IOV_MAX * 2 + 1;
+    std::vector<std::string> contents(count);
+    std::unique_ptr<dsn_file_buffer_t[]> buffers(new dsn_file_buffer_t[count]);
+    std::string expected;
+    for (int i = 0; i < count; i++) {
+        contents[i] = std::to_string(i) + ",";
+        buffers[i].buffer = const_cast<char *>(contents[i].data());
+        buffers[i].size = static_cast<int>(contents[i].size());
+        expected += contents[i];
+    }
+
+    auto fp = file::open("tmp_vector", O_RDWR | O_CREAT | O_BINARY, 0666);
+    auto t = ::dsn::file::write_vector(fp, buffers.get(), count, 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    EXPECT_EQ(ERR_OK, t->error());
+    EXPECT_EQ(expected.size(), t->get_transferred_size());
+
+    std::string actual(expected.size(), '\0');
+    t = ::dsn::file::read(fp, &actual[0], actual.size(), 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    EXPECT_EQ(expected.size(), t->get_transferred_size());
+    EXPECT_EQ(expected, actual);
+
+    EXPECT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_vector");
+}
+
 TEST(core, aio_share)
 {
     auto fp = file::open("tmp", O_WRONLY | O_CREAT | O_BINARY, 0666);
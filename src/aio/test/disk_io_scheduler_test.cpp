@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "aio/disk_engine.h"
+
+#include <dsn/tool-api/file_io.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+DSN_DECLARE_uint32(disk_io_high_priority_deadline_ms);
+DSN_DECLARE_uint32(disk_io_reserved_queue_depth);
+
+DEFINE_TASK_CODE_AIO(LPC_DISK_IO_SCHEDULER_TEST_HIGH, TASK_PRIORITY_HIGH, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_AIO(LPC_DISK_IO_SCHEDULER_TEST_NORMAL, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_AIO(LPC_DISK_IO_SCHEDULER_TEST_LOW, TASK_PRIORITY_LOW, THREAD_POOL_DEFAULT)
+
+class disk_io_scheduler_test : public testing::Test
+{
+public:
+    disk_io_scheduler_test()
+        : _scheduler(4, [this](aio_task *aio) { _submitted.push_back(aio); })
+    {
+    }
+
+    aio_task_ptr create(task_code code)
+    {
+        aio_task_ptr aio = file::create_aio_task(code, nullptr, [](error_code, size_t) {});
+        _tasks.push_back(aio);
+        return aio;
+    }
+
+    // completes the first submitted io
+    void complete_one()
+    {
+        aio_task *aio = _submitted.front();
+        _submitted.erase(_submitted.begin());
+        _scheduler.on_completed(aio);
+    }
+
+    disk_io_scheduler _scheduler;
+    std::vector<aio_task *> _submitted;
+    std::vector<aio_task_ptr> _tasks;
+};
+
+TEST_F(disk_io_scheduler_test, priority_of)
+{
+    ASSERT_EQ(DIO_PRIORITY_HIGH,
+              disk_io_scheduler::priority_of(create(LPC_DISK_IO_SCHEDULER_TEST_HIGH)));
+    ASSERT_EQ(DIO_PRIORITY_NORMAL,
+              disk_io_scheduler::priority_of(create(LPC_DISK_IO_SCHEDULER_TEST_NORMAL)));
+    ASSERT_EQ(DIO_PRIORITY_LOW,
+              disk_io_scheduler::priority_of(create(LPC_DISK_IO_SCHEDULER_TEST_LOW)));
+
+    task_spec::get(LPC_DISK_IO_SCHEDULER_TEST_LOW)->disk_io_priority = DIO_PRIORITY_HIGH;
+    ASSERT_EQ(DIO_PRIORITY_HIGH,
+              disk_io_scheduler::priority_of(create(LPC_DISK_IO_SCHEDULER_TEST_LOW)));
+    // only the default of an unconfigured code is set
+    task_spec::set_default_disk_io_priority(LPC_DISK_IO_SCHEDULER_TEST_LOW, DIO_PRIORITY_NORMAL);
+    ASSERT_EQ(DIO_PRIORITY_HIGH,
+              disk_io_scheduler::priority_of(create(LPC_DISK_IO_SCHEDULER_TEST_LOW)));
+    task_spec::get(LPC_DISK_IO_SCHEDULER_TEST_LOW)->disk_io_priority = DIO_PRIORITY_INVALID;
+}
+
+TEST_F(disk_io_scheduler_test, no_queue_depth)
+{
+    disk_io_scheduler scheduler(0, [this](aio_task *aio) { _submitted.push_back(aio); });
+    for (int i = 0; i < 10; i++) {
+        scheduler.submit(create(LPC_DISK_IO_SCHEDULER_TEST_LOW));
+    }
+    ASSERT_EQ(10, _submitted.size());
+}
+
+TEST_F(disk_io_scheduler_test, submit_by_priority)
+{
+    uint32_t origin_deadline = FLAGS_disk_io_high_priority_deadline_ms;
+    FLAGS_disk_io_high_priority_deadline_ms = 1000000;
+
+    // the low priority io takes at most 3 of the 4 slots
+    std::vector<aio_task *> lows;
+    for (int i = 0; i < 5; i++) {
+        lows.push_back(create(LPC_DISK_IO_SCHEDULER_TEST_LOW));
+        _scheduler.submit(lows.back());
+    }
+    ASSERT_EQ(3, _submitted.size());
+
+    aio_task *high = create(LPC_DISK_IO_SCHEDULER_TEST_HIGH);
+    _scheduler.submit(high);
+    ASSERT_EQ(4, _submitted.size());
+    ASSERT_EQ(high, _submitted.back());
+
+    aio_task *normal = create(LPC_DISK_IO_SCHEDULER_TEST_NORMAL);
+    _scheduler.submit(normal);
+    aio_task *high2 = create(LPC_DISK_IO_SCHEDULER_TEST_HIGH);
+    _scheduler.submit(high2);
+    ASSERT_EQ(4, _submitted.size());
+
+    // the queued io is submitted in the order of the priority
+    complete_one();
+    ASSERT_EQ(high2, _submitted.back());
+    complete_one();
+    ASSERT_EQ(normal, _submitted.back());
+    // the reserved slot is kept from the low priority io
+    complete_one();
+    ASSERT_EQ(3, _submitted.size());
+    complete_one();
+    ASSERT_EQ(lows[3], _submitted.back());
+    complete_one();
+    ASSERT_EQ(lows[4], _submitted.back());
+    while (!_submitted.empty()) {
+        complete_one();
+    }
+
+    FLAGS_disk_io_high_priority_deadline_ms = origin_deadline;
+}
+
+TEST_F(disk_io_scheduler_test, high_priority_deadline)
+{
+    uint32_t origin_deadline = FLAGS_disk_io_high_priority_deadline_ms;
+    FLAGS_disk_io_high_priority_deadline_ms = 0;
+
+    for (int i = 0; i < 4; i++) {
+        _scheduler.submit(create(LPC_DISK_IO_SCHEDULER_TEST_NORMAL));
+    }
+    _scheduler.submit(create(LPC_DISK_IO_SCHEDULER_TEST_NORMAL));
+    ASSERT_EQ(4, _submitted.size());
+
+    // the high priority io exceeds the queue depth once its deadline is reached
+    aio_task *high = create(LPC_DISK_IO_SCHEDULER_TEST_HIGH);
+    _scheduler.submit(high);
+    ASSERT_EQ(5, _submitted.size());
+    ASSERT_EQ(high, _submitted.back());
+
+    // nothing is submitted until the in-flight io are fewer than the depth
+    complete_one();
+    ASSERT_EQ(4, _submitted.size());
+    complete_one();
+    ASSERT_EQ(4, _submitted.size());
+    while (!_submitted.empty()) {
+        complete_one();
+    }
+
+    FLAGS_disk_io_high_priority_deadline_ms = origin_deadline;
+}
+} // namespace dsn
@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "aio/disk_engine.h"
+#include "aio/io_uring_aio_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+DSN_DECLARE_bool(io_uring_direct_io);
+
+DEFINE_TASK_CODE_AIO(LPC_AIO_TEST_IO_URING, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class io_uring_aio_provider_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        disk_engine::instance().get_provider();
+        _origin_provider = std::move(disk_engine::instance()._provider);
+        reset_provider();
+    }
+
+    void TearDown() override { disk_engine::instance()._provider = std::move(_origin_provider); }
+
+    void reset_provider()
+    {
+        disk_engine &engine = disk_engine::instance();
+        engine._provider.reset(new io_uring_aio_provider(&engine));
+    }
+
+    bool ring_started()
+    {
+        return static_cast<io_uring_aio_provider &>(disk_engine::provider())._ring_started;
+    }
+
+    std::unique_ptr<aio_provider> _origin_provider;
+};
+
+TEST_F(io_uring_aio_provider_test, read_write)
+{
+    if (!ring_started()) {
+        return;
+    }
+
+    const char *buffer = "hello, world";
+    int len = (int)strlen(buffer);
+    auto fp = file::open("tmp_io_uring", O_RDWR | O_CREAT | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+
+    // the sequential writes are batched by disk_write_queue
+    std::list<aio_task_ptr> tasks;
+    uint64_t offset = 0;
+    for (int i = 0; i < 100; i++) {
+        tasks.push_back(
+            file::write(fp, buffer, len, offset, LPC_AIO_TEST_IO_URING, nullptr, nullptr));
+        offset += len;
+    }
+    dsn_file_buffer_t buffers[10];
+    for (int i = 0; i < 10; i++) {
+        buffers[i].buffer = reinterpret_cast<void *>(const_cast<char *>(buffer));
+        buffers[i].size = len;
+    }
+    tasks.push_back(
+        file::write_vector(fp, buffers, 10, offset, LPC_AIO_TEST_IO_URING, nullptr, nullptr));
+    offset += 10 * len;
+    for (auto &t : tasks) {
+        t->wait();
+        ASSERT_EQ(ERR_OK, t->error());
+    }
+    ASSERT_EQ(ERR_OK, file::flush(fp));
+
+    char buffer2[64];
+    for (uint64_t read_offset = 0; read_offset < offset; read_offset += len) {
+        auto t = file::read(fp, buffer2, len, read_offset, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+        t->wait();
+        ASSERT_EQ(ERR_OK, t->error());
+        ASSERT_EQ((size_t)len, t->get_transferred_size());
+        ASSERT_EQ(0, memcmp(buffer, buffer2, len));
+    }
+
+    auto t = file::read(fp, buffer2, len, offset, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_HANDLE_EOF, t->error());
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_io_uring");
+}
+
+TEST_F(io_uring_aio_provider_test, direct_io)
+{
+    bool origin_direct_io = FLAGS_io_uring_direct_io;
+    FLAGS_io_uring_direct_io = true;
+    // the fds are opened with the flag set
+    reset_provider();
+    if (!ring_started()) {
+        FLAGS_io_uring_direct_io = origin_direct_io;
+        return;
+    }
+
+    const size_t size = 8192;
+    void *aligned = nullptr;
+    ASSERT_EQ(0, posix_memalign(&aligned, 4096, size));
+    std::unique_ptr<char, decltype(&free)> buffer(static_cast<char *>(aligned), &free);
+    for (size_t i = 0; i < size; i++) {
+        buffer.get()[i] = static_cast<char>('a' + i % 26);
+    }
+
+    auto fp = file::open("tmp_io_uring_direct", O_RDWR | O_CREAT | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+    // aligned, which goes through the O_DIRECT fd if the filesystem supports it
+    auto t = file::write(fp, buffer.get(), size, 0, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    // unaligned, which goes through the page cache
+    t = file::write(fp, "tail", 4, size, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+
+    void *read_aligned = nullptr;
+    ASSERT_EQ(0, posix_memalign(&read_aligned, 4096, size));
+    std::unique_ptr<char, decltype(&free)> read_buffer(static_cast<char *>(read_aligned), &free);
+    t = file::read(fp, read_buffer.get(), size, 0, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    ASSERT_EQ(0, memcmp(buffer.get(), read_buffer.get(), size));
+
+    char tail[4];
+    t = file::read(fp, tail, 4, size, LPC_AIO_TEST_IO_URING, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    ASSERT_EQ(0, memcmp("tail", tail, 4));
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_io_uring_direct");
+    FLAGS_io_uring_direct_io = origin_direct_io;
+}
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
@@ -23,11 +23,39 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DEFINE_uint32("replication",
+                  block_service_ranged_download_min_mb,
+                  0,
+                  "the files of at least this size are downloaded from the block service by "
+                  "ranges concurrently, 0 to disable");
+DSN_DEFINE_uint32("replication",
+                  block_service_download_range_mb,
+                  16,
+                  "the size of a range of the ranged download, which is buffered in memory");
+DSN_DEFINE_uint32("replication",
+                  block_service_download_ranges_per_file,
+                  4,
+                  "the max count of ranges of a file downloaded concurrently");
+DSN_DEFINE_uint32("replication",
+                  block_service_download_ranges_per_node,
+                  16,
+                  "the max count of ranges downloaded concurrently by the node");
+DSN_DEFINE_validator(block_service_download_range_mb,
+                     [](uint32_t value) -> bool { return value > 0 && value <= 1024; });
+DSN_DEFINE_validator(block_service_download_ranges_per_file,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_validator(block_service_download_ranges_per_node,
+                     [](uint32_t value) -> bool { return value > 0; });
+
 block_service_registry::block_service_registry()
 {
     bool ans;
@@ -47,7 +75,8 @@ block_service_registry::block_service_registry()
 block_service_manager::block_service_manager()
     : // we got a instance of block_service_registry each time we create a block_service_manger
       // to make sure that the filesystem providers are registered
-      _registry_holder(block_service_registry::instance())
+      _registry_holder(block_service_registry::instance()),
+      _range_slots(FLAGS_block_service_download_ranges_per_node)
 {
 }
 
@@ -131,6 +160,20 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
                                                 block_filesystem *fs,
                                                 /*out*/ uint64_t &download_file_size)
 {
+    std::string download_file_md5;
+    return download_file(
+        remote_dir, local_dir, file_name, fs, download_file_size, download_file_md5);
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION, THREAD_POOL_REPLICATION_LONG
+error_code block_service_manager::download_file(const std::string &remote_dir,
+                                                const std::string &local_dir,
+                                                const std::string &file_name,
+                                                block_filesystem *fs,
+                                                /*out*/ uint64_t &download_file_size,
+                                                /*out*/ std::string &download_file_md5)
+{
+    download_file_md5.clear();
     // local file exists
     const std::string local_file_name = utils::filesystem::path_combine(local_dir, file_name);
     if (utils::filesystem::file_exists(local_file_name)) {
@@ -151,6 +194,12 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
     }
     block_file_ptr bf = create_resp.file_handle;
 
+    if (FLAGS_block_service_ranged_download_min_mb > 0 &&
+        bf->get_size() >= FLAGS_block_service_ranged_download_min_mb * 1024ULL * 1024ULL) {
+        // the md5 is left empty, which the callers verify by reading the file
+        return download_file_by_ranges(local_file_name, bf.get(), download_file_size);
+    }
+
     download_response resp = download_block_file_sync(local_file_name, bf.get(), &tracker);
     if (resp.err != ERR_OK) {
         // during bulk load process, ERR_OBJECT_NOT_FOUND will be considered as a recoverable
@@ -167,6 +216,93 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
     ddebug_f(
         "download file({}) succeed, file_size = {}", local_file_name.c_str(), resp.downloaded_size);
     download_file_size = resp.downloaded_size;
+    download_file_md5 = resp.file_md5;
+    return ERR_OK;
+}
+
+error_code block_service_manager::download_file_by_ranges(const std::string &local_file_name,
+                                                         block_file *bf,
+                                                         /*out*/ uint64_t &download_file_size)
+{
+    const uint64_t file_size = bf->get_size();
+    const uint64_t range_size = FLAGS_block_service_download_range_mb * 1024ULL * 1024ULL;
+
+    // the ranges are written to a temp file, which is renamed when all of them are done, so
+    // that a failed download never leaves a partial file behind
+    const std::string tmp_file_name = local_file_name + ".downloading";
+    int fd = ::open(tmp_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        derror_f("open file({}) failed, error = {}", tmp_file_name, utils::safe_strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    zlock err_lock;
+    error_code err = ERR_OK;
+    utils::semaphore file_slots(FLAGS_block_service_download_ranges_per_file);
+    task_tracker tracker;
+    for (uint64_t offset = 0; offset < file_size; offset += range_size) {
+        {
+            zauto_lock l(err_lock);
+            if (err != ERR_OK) {
+                break;
+            }
+        }
+
+        file_slots.wait();
+        _range_slots.wait();
+        const uint64_t length = std::min(range_size, file_size - offset);
+        bf->read(read_request{offset, static_cast<int64_t>(length)},
+                 TASK_CODE_EXEC_INLINED,
+                 [&, offset, length](const read_response &resp) {
+                     error_code range_err = resp.err;
+                     if (range_err == ERR_OK && resp.buffer.length() != length) {
+                         derror_f("read range [{}, {}) of file({}) got {} bytes",
+                                  offset,
+                                  offset + length,
+                                  bf->file_name(),
+                                  resp.buffer.length());
+                         range_err = ERR_CORRUPTION;
+                     }
+                     if (range_err == ERR_OK &&
+                         ::pwrite(fd, resp.buffer.data(), length, offset) !=
+                             static_cast<ssize_t>(length)) {
+                         derror_f("write range [{}, {}) of file({}) failed, error = {}",
+                                  offset,
+                                  offset + length,
+                                  tmp_file_name,
+                                  utils::safe_strerror(errno));
+                         range_err = ERR_FILE_OPERATION_FAILED;
+                     }
+                     if (range_err != ERR_OK) {
+                         zauto_lock l(err_lock);
+                         if (err == ERR_OK) {
+                             err = range_err;
+                         }
+                     }
+                     _range_slots.signal();
+                     file_slots.signal();
+                 },
+                 &tracker);
+    }
+    tracker.wait_outstanding_tasks();
+
+    if (err == ERR_OK && ::fsync(fd) != 0) {
+        derror_f("fsync file({}) failed, error = {}", tmp_file_name, utils::safe_strerror(errno));
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+    ::close(fd);
+    if (err == ERR_OK && !utils::filesystem::rename_path(tmp_file_name, local_file_name)) {
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+    if (err != ERR_OK) {
+        derror_f("download file({}) by ranges failed with error({})", local_file_name, err);
+        utils::filesystem::remove_path(tmp_file_name);
+        // see download_file, a missing file on the remote file provider means it's damaged
+        return err == ERR_OBJECT_NOT_FOUND ? ERR_CORRUPTION : err;
+    }
+
+    ddebug_f("download file({}) by ranges succeed, file_size = {}", local_file_name, file_size);
+    download_file_size = file_size;
     return ERR_OK;
 }
 
@@ -20,6 +20,7 @@
 #include <dsn/dist/block_service.h>
 #include <dsn/utility/singleton_store.h>
 #include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/synchronize.h>
 
 namespace dsn {
 namespace dist {
@@ -59,12 +60,30 @@ public:
                              block_filesystem *fs,
                              /*out*/ uint64_t &download_file_size);
 
+    // same as above, and also set download_file_md5 to the md5 of the downloaded file if
+    // the block service calculates it while downloading, otherwise set it to empty
+    error_code download_file(const std::string &remote_dir,
+                             const std::string &local_dir,
+                             const std::string &file_name,
+                             block_filesystem *fs,
+                             /*out*/ uint64_t &download_file_size,
+                             /*out*/ std::string &download_file_md5);
+
 private:
+    // download the file by ranges of block_service_download_range_mb, which are read
+    // concurrently and written at their offsets, the md5 is not calculated
+    error_code download_file_by_ranges(const std::string &local_file_name,
+                                       block_file *bf,
+                                       /*out*/ uint64_t &download_file_size);
+
     block_service_registry &_registry_holder;
 
     mutable zrwlock_nr _fs_lock;
     std::map<std::string, std::unique_ptr<block_filesystem>> _fs_map;
 
+    // the ranges being downloaded on the node, limited by block_service_download_ranges_per_node
+    utils::semaphore _range_slots;
+
     friend class block_service_manager_mock;
 };
 
@@ -25,20 +25,31 @@
 #include <model/fds_object_summary.h>
 #include <model/fds_object_listing.h>
 #include <model/delete_multi_objects_result.h>
+#include <model/init_multipart_upload_result.h>
+#include <model/upload_part_result.h>
+#include <model/upload_part_result_list.h>
 #include <dsn/utility/error_code.h>
 #include <Poco/Net/HTTPResponse.h>
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <memory>
 #include <fstream>
+#include <sstream>
 #include <string.h>
 #include <dsn/utility/defer.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/TokenBucket.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+#include <dsn/utility/strings.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace dsn {
 namespace dist {
@@ -50,6 +61,39 @@ DSN_DEFINE_uint32("replication", fds_read_limit_rate, 100, "read rate limit of f
 
 DSN_DEFINE_uint32("replication", fds_read_batch_size, 100, "read batch size of fds(MB)");
 
+DSN_DEFINE_uint32("replication",
+                  fds_multipart_upload_threshold_mb,
+                  0,
+                  "the files larger than this are uploaded to fds in parts concurrently(MB), "
+                  "0 means never");
+DSN_DEFINE_uint32("replication", fds_multipart_part_size_mb, 64, "part size of fds upload(MB)");
+DSN_DEFINE_validator(fds_multipart_part_size_mb, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  fds_multipart_upload_concurrency,
+                  4,
+                  "the max count of parts of one file uploaded to fds concurrently");
+DSN_DEFINE_validator(fds_multipart_upload_concurrency,
+                     [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("replication",
+                  fds_ranged_download_threshold_mb,
+                  0,
+                  "the files larger than this are downloaded from fds by ranges concurrently(MB), "
+                  "0 means never");
+DSN_DEFINE_uint32("replication", fds_download_part_size_mb, 64, "range size of fds download(MB)");
+DSN_DEFINE_validator(fds_download_part_size_mb, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  fds_download_concurrency,
+                  4,
+                  "the max count of ranges of one file downloaded from fds concurrently");
+DSN_DEFINE_validator(fds_download_concurrency, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("replication",
+                  fds_max_idle_clients,
+                  16,
+                  "the max count of idle fds clients kept for reuse, along with their "
+                  "connections");
+
 class utils
 {
 public:
@@ -74,6 +118,40 @@ public:
     static std::string path_from_fds(const std::string &input, bool is_dir);
 };
 
+// forwards the bytes written to the sink and calculates their md5 meanwhile
+class md5_ostreambuf : public std::streambuf
+{
+public:
+    explicit md5_ostreambuf(std::streambuf *sink) : _sink(sink) {}
+
+    std::string digest() { return _md5.digest(); }
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        std::streamsize written = _sink->sputn(s, n);
+        if (written > 0) {
+            _md5.update(s, static_cast<size_t>(written));
+        }
+        return written;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        char ch = traits_type::to_char_type(c);
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    int sync() override { return _sink->pubsync(); }
+
+private:
+    std::streambuf *_sink;
+    dsn::utils::md5_calculator _md5;
+};
+
 /*static*/
 size_t utils::copy_stream(std::istream &is, std::ostream &os, size_t piece_size)
 {
@@ -140,6 +218,31 @@ fds_service::fds_service()
 
 fds_service::~fds_service() {}
 
+std::shared_ptr<galaxy::fds::GalaxyFDSClient> fds_service::acquire_client()
+{
+    galaxy::fds::GalaxyFDSClient *client = nullptr;
+    {
+        zauto_lock l(_clients_lock);
+        if (!_idle_clients.empty()) {
+            client = _idle_clients.back().release();
+            _idle_clients.pop_back();
+        }
+    }
+    if (client == nullptr) {
+        client = new galaxy::fds::GalaxyFDSClient(_access_key, _secret_key, *_client_config);
+    }
+
+    return std::shared_ptr<galaxy::fds::GalaxyFDSClient>(
+        client, [this](galaxy::fds::GalaxyFDSClient *c) {
+            zauto_lock l(_clients_lock);
+            if (_idle_clients.size() < FLAGS_fds_max_idle_clients) {
+                _idle_clients.emplace_back(c);
+            } else {
+                delete c;
+            }
+        });
+}
+
 /**
  * @brief fds_service::initialize
  * @param args: {httpServer, accessKey, secretKey, bucket}
@@ -147,13 +250,11 @@ fds_service::~fds_service() {}
  */
 error_code fds_service::initialize(const std::vector<std::string> &args)
 {
-    galaxy::fds::FDSClientConfiguration config;
-    config.enableHttps(true);
-    config.setEndpoint(args[0]);
-    const std::string &access_key = args[1];
-    const std::string &secret_key = args[2];
-
-    _client.reset(new galaxy::fds::GalaxyFDSClient(access_key, secret_key, config));
+    _client_config.reset(new galaxy::fds::FDSClientConfiguration());
+    _client_config->enableHttps(true);
+    _client_config->setEndpoint(args[0]);
+    _access_key = args[1];
+    _secret_key = args[2];
     _bucket_name = args[3];
     return dsn::ERR_OK;
 }
@@ -195,9 +296,10 @@ dsn::task_ptr fds_service::list_dir(const ls_request &req,
     auto list_dir_in_background = [this, req, t]() {
         ls_response resp;
         std::string fds_path = utils::path_to_fds(req.dir_name, true);
+        auto client = acquire_client();
         try {
             std::shared_ptr<galaxy::fds::FDSObjectListing> result =
-                _client->listObjects(_bucket_name, fds_path);
+                client->listObjects(_bucket_name, fds_path);
 
             while (true) {
                 const std::vector<galaxy::fds::FDSObjectSummary> &objs = result->objectSummaries();
@@ -226,7 +328,7 @@ dsn::task_ptr fds_service::list_dir(const ls_request &req,
 
                 // list result may be paged
                 if (result->truncated()) {
-                    auto res_temp = _client->listNextBatchOfObjects(*result);
+                    auto res_temp = client->listNextBatchOfObjects(*result);
                     result.swap(res_temp);
                 } else {
                     break;
@@ -243,8 +345,8 @@ dsn::task_ptr fds_service::list_dir(const ls_request &req,
 
         if (resp.err == dsn::ERR_OK && resp.entries->empty()) {
             try {
-                if (_client->doesObjectExist(_bucket_name,
-                                             utils::path_to_fds(req.dir_name, false))) {
+                if (client->doesObjectExist(_bucket_name,
+                                            utils::path_to_fds(req.dir_name, false))) {
                     derror("fds list_dir failed: path not dir, parameter(%s)",
                            req.dir_name.c_str());
                     resp.err = ERR_INVALID_PARAMETERS;
@@ -317,13 +419,14 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
         resp.err = ERR_OK;
         std::string fds_path = utils::path_to_fds(req.path, true);
         bool should_remove_path = false;
+        auto client = acquire_client();
 
         try {
             std::shared_ptr<galaxy::fds::FDSObjectListing> result =
-                _client->listObjects(_bucket_name, fds_path);
+                client->listObjects(_bucket_name, fds_path);
             while (result->objectSummaries().size() <= 0 && result->commonPrefixes().size() <= 0 &&
                    result->truncated()) {
-                result = _client->listNextBatchOfObjects(*result);
+                result = client->listNextBatchOfObjects(*result);
             }
             const std::vector<galaxy::fds::FDSObjectSummary> &objs = result->objectSummaries();
             const std::vector<std::string> &common_prefix = result->commonPrefixes();
@@ -338,7 +441,7 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
                     resp.err = ERR_DIR_NOT_EMPTY;
                 }
             } else {
-                if (_client->doesObjectExist(_bucket_name, utils::path_to_fds(req.path, false))) {
+                if (client->doesObjectExist(_bucket_name, utils::path_to_fds(req.path, false))) {
                     should_remove_path = true;
                 } else {
                     derror("fds remove_path failed: path not found, parameter(%s)",
@@ -358,7 +461,7 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
         if (resp.err == ERR_OK && should_remove_path) {
             fds_path = utils::path_to_fds(req.path, false);
             try {
-                auto deleting = _client->deleteObjects(_bucket_name, fds_path, false);
+                auto deleting = client->deleteObjects(_bucket_name, fds_path, false);
                 if (deleting->countFailedObjects() <= 0) {
                     resp.err = ERR_OK;
                 } else {
@@ -385,6 +488,69 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
     return callback;
 }
 
+error_code fds_service::start_multipart_upload(const std::string &fds_path,
+                                               int64_t file_size,
+                                               std::shared_ptr<fds_multipart_upload> &upload)
+{
+    {
+        zauto_lock l(_multipart_lock);
+        auto iter = _multipart_uploads.find(fds_path);
+        if (iter != _multipart_uploads.end()) {
+            if (iter->second->in_progress) {
+                return ERR_BUSY;
+            }
+            if (iter->second->file_size == file_size) {
+                upload = iter->second;
+                upload->in_progress = true;
+                return ERR_OK;
+            }
+            // the local file has changed since last time
+            _multipart_uploads.erase(iter);
+        }
+    }
+
+    auto new_upload = std::make_shared<fds_multipart_upload>();
+    new_upload->file_size = file_size;
+    new_upload->part_size = static_cast<int64_t>(FLAGS_fds_multipart_part_size_mb) << 20;
+    new_upload->parts.resize((file_size + new_upload->part_size - 1) / new_upload->part_size);
+    new_upload->in_progress = true;
+
+    error_code err = ERR_OK;
+    try {
+        new_upload->upload_id =
+            acquire_client()->initMultipartUpload(_bucket_name, fds_path)->uploadId();
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror_f("fds initMultipartUpload error: remote_file({}), code({}), msg({})",
+                 fds_path,
+                 ex.code(),
+                 ex.what());
+        err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(err, "initMultipartUpload", fds_path.c_str())
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    zauto_lock l(_multipart_lock);
+    _multipart_uploads[fds_path] = new_upload;
+    upload = std::move(new_upload);
+    return ERR_OK;
+}
+
+void fds_service::finish_multipart_upload(const std::string &fds_path, bool done)
+{
+    zauto_lock l(_multipart_lock);
+    auto iter = _multipart_uploads.find(fds_path);
+    if (iter == _multipart_uploads.end()) {
+        return;
+    }
+    if (done) {
+        _multipart_uploads.erase(iter);
+    } else {
+        iter->second->in_progress = false;
+    }
+}
+
 fds_file_object::fds_file_object(fds_service *s,
                                  const std::string &name,
                                  const std::string &fds_path)
@@ -402,7 +568,7 @@ fds_file_object::~fds_file_object() {}
 error_code fds_file_object::get_file_meta()
 {
     error_code err = ERR_OK;
-    galaxy::fds::GalaxyFDSClient *c = _service->get_client();
+    auto c = _service->acquire_client();
     try {
         auto meta = c->getObjectMetadata(_service->get_bucket_name(), _fds_path)->metadata();
 
@@ -492,7 +658,7 @@ error_code fds_file_object::get_content(uint64_t pos,
         }
 
         try {
-            galaxy::fds::GalaxyFDSClient *c = _service->get_client();
+            auto c = _service->acquire_client();
             std::shared_ptr<galaxy::fds::FDSObject> obj;
             obj = c->getObject(_service->get_bucket_name(),
                                _fds_path,
@@ -530,7 +696,7 @@ error_code fds_file_object::put_content(/*in-out*/ std::istream &is,
 {
     error_code err = ERR_OK;
     transfered_bytes = 0;
-    galaxy::fds::GalaxyFDSClient *c = _service->get_client();
+    auto c = _service->acquire_client();
 
     // get tokens from token bucket
     if (!_service->_write_token_bucket->consumeWithBorrowAndWait(to_transfer_bytes)) {
@@ -603,6 +769,13 @@ dsn::task_ptr fds_file_object::upload(const upload_request &req,
         int64_t file_sz = 0;
         dsn::utils::filesystem::file_size(local_file, file_sz);
 
+        if (FLAGS_fds_multipart_upload_threshold_mb > 0 &&
+            file_sz > static_cast<int64_t>(FLAGS_fds_multipart_upload_threshold_mb) << 20) {
+            // `t` is resolved and the ref is released when all the parts are done
+            upload_in_parts(local_file, file_sz, t);
+            return;
+        }
+
         upload_response resp;
         // TODO: we can cache the whole file in buffer, then upload the buffer rather than the
         // ifstream, because if ifstream read file beyond 60s, fds-server will reset the session,
@@ -620,6 +793,8 @@ dsn::task_ptr fds_file_object::upload(const upload_request &req,
         } else {
             resp.err = put_content(is, file_sz, resp.uploaded_size);
             is.close();
+            // calculated by fds from the content received
+            resp.md5 = _md5sum;
         }
 
         t->enqueue_with(resp);
@@ -630,6 +805,192 @@ dsn::task_ptr fds_file_object::upload(const upload_request &req,
     return t;
 }
 
+struct fds_file_object::part_upload_context
+{
+    std::shared_ptr<fds_multipart_upload> upload;
+    std::atomic<size_t> next_part{0};
+    // the md5 is calculated over the parts in order as they are read for the upload, and the
+    // parts read ahead of the previous ones are kept until those are read
+    zlock md5_lock;
+    utils::md5_calculator md5;
+    size_t next_md5_part{0};
+    std::map<size_t, std::string> read_ahead_parts;
+    std::atomic<uint32_t> running_workers{0};
+    std::atomic<bool> failed{false};
+    error_code err{ERR_OK};
+};
+
+void fds_file_object::upload_in_parts(const std::string &local_file,
+                                      int64_t file_size,
+                                      const upload_future_ptr &t)
+{
+    auto ctx = std::make_shared<part_upload_context>();
+    upload_response resp;
+    resp.uploaded_size = 0;
+    resp.err = _service->start_multipart_upload(_fds_path, file_size, ctx->upload);
+    if (resp.err != ERR_OK) {
+        t->enqueue_with(resp);
+        release_ref();
+        return;
+    }
+
+    const auto &parts = ctx->upload->parts;
+    size_t pending_parts = std::count(parts.begin(), parts.end(), nullptr);
+    uint32_t workers = std::max<uint32_t>(
+        1, std::min<size_t>(FLAGS_fds_multipart_upload_concurrency, pending_parts));
+    ddebug_f("start to upload {} in parts: upload_id({}), pending parts({}/{}), workers({})",
+             file_name(),
+             ctx->upload->upload_id,
+             pending_parts,
+             parts.size(),
+             workers);
+    ctx->running_workers.store(workers);
+    for (uint32_t i = 0; i < workers; ++i) {
+        dsn::tasking::enqueue(LPC_FDS_CALL, nullptr, [this, local_file, ctx, t]() {
+            upload_parts(local_file, ctx, t);
+        });
+    }
+}
+
+void fds_file_object::upload_parts(const std::string &local_file,
+                                   const std::shared_ptr<part_upload_context> &ctx,
+                                   const upload_future_ptr &t)
+{
+    fds_multipart_upload &upload = *ctx->upload;
+    std::ifstream is(local_file, std::ios::binary | std::ios::in);
+    std::string buffer;
+    while (!ctx->failed.load()) {
+        size_t index = ctx->next_part.fetch_add(1);
+        if (index >= upload.parts.size()) {
+            break;
+        }
+
+        int64_t offset = index * upload.part_size;
+        buffer.resize(std::min(upload.part_size, upload.file_size - offset));
+        error_code err = ERR_OK;
+        if (!is.is_open() || !is.seekg(offset) || !is.read(&buffer[0], buffer.size())) {
+            derror_f("fds upload failed: read local file({}) at offset({}) failed",
+                     local_file,
+                     offset);
+            err = ERR_FILE_OPERATION_FAILED;
+        } else {
+            update_md5(*ctx, index, buffer);
+            // the parts uploaded by the previous attempt are read for the md5 only
+            if (upload.parts[index] == nullptr) {
+                err = put_part(upload, index, buffer);
+            }
+        }
+        if (err != ERR_OK && !ctx->failed.exchange(true)) {
+            ctx->err = err;
+        }
+    }
+
+    if (ctx->running_workers.fetch_sub(1) > 1) {
+        return;
+    }
+
+    // the last worker completes the upload
+    upload_response resp;
+    resp.uploaded_size = 0;
+    if (ctx->failed.load()) {
+        resp.err = ctx->err;
+    } else {
+        dassert_f(ctx->next_md5_part == upload.parts.size(),
+                  "{} of {} parts are calculated in md5",
+                  ctx->next_md5_part,
+                  upload.parts.size());
+        resp.md5 = ctx->md5.digest();
+        resp.err = complete_multipart_upload(upload, resp.md5, resp.uploaded_size);
+    }
+    // the uploaded parts are kept for the retry unless the object is completed, or the upload
+    // can't be completed with them
+    _service->finish_multipart_upload(_fds_path, !ctx->failed.load());
+    t->enqueue_with(resp);
+    release_ref();
+}
+
+void fds_file_object::update_md5(part_upload_context &ctx,
+                                 size_t index,
+                                 const std::string &buffer)
+{
+    zauto_lock l(ctx.md5_lock);
+    if (index != ctx.next_md5_part) {
+        ctx.read_ahead_parts.emplace(index, buffer);
+        return;
+    }
+    ctx.md5.update(buffer.data(), buffer.size());
+    ++ctx.next_md5_part;
+    for (auto iter = ctx.read_ahead_parts.begin();
+         iter != ctx.read_ahead_parts.end() && iter->first == ctx.next_md5_part;
+         iter = ctx.read_ahead_parts.erase(iter)) {
+        ctx.md5.update(iter->second.data(), iter->second.size());
+        ++ctx.next_md5_part;
+    }
+}
+
+error_code
+fds_file_object::put_part(fds_multipart_upload &upload, size_t index, const std::string &buffer)
+{
+    // shares the write bandwidth of the node with the other uploads
+    if (!_service->_write_token_bucket->consumeWithBorrowAndWait(buffer.size())) {
+        return ERR_BUSY;
+    }
+
+    error_code err = ERR_OK;
+    auto c = _service->acquire_client();
+    try {
+        std::istringstream is(buffer);
+        // part numbers start from 1
+        upload.parts[index] = c->uploadPart(
+            _service->get_bucket_name(), _fds_path, upload.upload_id, index + 1, is);
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror_f("fds uploadPart error: remote_file({}), part({}), code({}), msg({})",
+                 file_name(),
+                 index + 1,
+                 ex.code(),
+                 ex.what());
+        err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(err, "uploadPart", file_name().c_str())
+    return err;
+}
+
+error_code fds_file_object::complete_multipart_upload(fds_multipart_upload &upload,
+                                                      const std::string &md5,
+                                                      uint64_t &transfered_bytes)
+{
+    error_code err = ERR_OK;
+    auto c = _service->acquire_client();
+    try {
+        galaxy::fds::UploadPartResultList results;
+        for (const auto &part : upload.parts) {
+            results.addUploadPartResult(*part);
+        }
+        galaxy::fds::FDSObjectMetadata metadata;
+        metadata.add(fds_service::FILE_LENGTH_CUSTOM_KEY, std::to_string(upload.file_size));
+        // unlike putObject, the md5 of a multipart object isn't computed by fds
+        metadata.add(fds_service::FILE_MD5_KEY, md5);
+        c->completeMultipartUpload(
+            _service->get_bucket_name(), _fds_path, upload.upload_id, &metadata, results);
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror_f("fds completeMultipartUpload error: remote_file({}), code({}), msg({})",
+                 file_name(),
+                 ex.code(),
+                 ex.what());
+        err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(err, "completeMultipartUpload", file_name().c_str())
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    err = get_file_meta();
+    if (err == ERR_OK) {
+        transfered_bytes = _size;
+    }
+    return err;
+}
+
 dsn::task_ptr fds_file_object::read(const read_request &req,
                                     dsn::task_code code,
                                     const read_callback &cb,
@@ -686,12 +1047,28 @@ dsn::task_ptr fds_file_object::download(const download_request &req,
     add_ref();
     auto download_background = [this, req, handle, t]() {
         download_response resp;
+        if (FLAGS_fds_ranged_download_threshold_mb > 0 &&
+            (_has_meta_synced || get_file_meta() == ERR_OK) && req.remote_pos < _size) {
+            uint64_t length = _size - req.remote_pos;
+            if (req.remote_length != -1) {
+                length = std::min<uint64_t>(length, req.remote_length);
+            }
+            if (length > static_cast<uint64_t>(FLAGS_fds_ranged_download_threshold_mb) << 20) {
+                handle->close();
+                // `t` is resolved and the ref is released when all the ranges are done
+                download_in_parts(req.output_local_name, req.remote_pos, length, t);
+                return;
+            }
+        }
+
         uint64_t transfered_size;
-        resp.err =
-            get_content_in_batches(req.remote_pos, req.remote_length, *handle, transfered_size);
+        md5_ostreambuf md5_buf(handle->rdbuf());
+        std::ostream os(&md5_buf);
+        resp.err = get_content_in_batches(req.remote_pos, req.remote_length, os, transfered_size);
         resp.downloaded_size = 0;
-        if (resp.err == ERR_OK && handle->tellp() != -1) {
+        if (resp.err == ERR_OK && os && handle->tellp() != -1) {
             resp.downloaded_size = handle->tellp();
+            resp.file_md5 = md5_buf.digest();
         }
         handle->close();
         if (resp.err != ERR_OK && dsn::utils::filesystem::file_exists(req.output_local_name)) {
@@ -707,6 +1084,125 @@ dsn::task_ptr fds_file_object::download(const download_request &req,
     dsn::tasking::enqueue(LPC_FDS_CALL, nullptr, download_background);
     return t;
 }
+
+struct fds_file_object::part_download_context
+{
+    std::string local_file;
+    int fd{-1};
+    uint64_t start{0};
+    uint64_t length{0};
+    uint64_t part_size{0};
+    size_t part_count{0};
+    std::atomic<size_t> next_part{0};
+    std::atomic<uint32_t> running_workers{0};
+    std::atomic<bool> failed{false};
+    error_code err{ERR_OK};
+};
+
+void fds_file_object::download_in_parts(const std::string &local_file,
+                                        uint64_t start,
+                                        uint64_t length,
+                                        const download_future_ptr &t)
+{
+    auto ctx = std::make_shared<part_download_context>();
+    ctx->local_file = local_file;
+    ctx->start = start;
+    ctx->length = length;
+    ctx->part_size = static_cast<uint64_t>(FLAGS_fds_download_part_size_mb) << 20;
+    ctx->part_count = (length + ctx->part_size - 1) / ctx->part_size;
+    ctx->fd = ::open(local_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (ctx->fd < 0) {
+        derror_f("fds download failed: fail to open localfile({}) when download({}), error({})",
+                 local_file,
+                 _fds_path,
+                 dsn::utils::safe_strerror(errno));
+        download_response resp;
+        resp.err = ERR_FILE_OPERATION_FAILED;
+        resp.downloaded_size = 0;
+        t->enqueue_with(resp);
+        release_ref();
+        return;
+    }
+
+    uint32_t workers = std::min<size_t>(FLAGS_fds_download_concurrency, ctx->part_count);
+    ddebug_f("start to download {} by ranges: length({}), ranges({}), workers({})",
+             file_name(),
+             length,
+             ctx->part_count,
+             workers);
+    ctx->running_workers.store(workers);
+    for (uint32_t i = 0; i < workers; ++i) {
+        dsn::tasking::enqueue(LPC_FDS_CALL, nullptr, [this, ctx, t]() { download_parts(ctx, t); });
+    }
+}
+
+void fds_file_object::download_parts(const std::shared_ptr<part_download_context> &ctx,
+                                     const download_future_ptr &t)
+{
+    std::ostringstream os;
+    while (!ctx->failed.load()) {
+        size_t index = ctx->next_part.fetch_add(1);
+        if (index >= ctx->part_count) {
+            break;
+        }
+
+        uint64_t offset = index * ctx->part_size;
+        uint64_t part_len = std::min(ctx->part_size, ctx->length - offset);
+        // shares the read bandwidth of the node with the other downloads
+        _service->_read_token_bucket->consumeWithBorrowAndWait(part_len);
+
+        os.str("");
+        uint64_t transfered_bytes = 0;
+        error_code err = get_content(ctx->start + offset, part_len, os, transfered_bytes);
+        if (err == ERR_OK && transfered_bytes != part_len) {
+            derror_f("fds download failed: got {} bytes of range [{}, {}) of {}",
+                     transfered_bytes,
+                     ctx->start + offset,
+                     ctx->start + offset + part_len,
+                     _fds_path);
+            err = ERR_FS_INTERNAL;
+        }
+        if (err == ERR_OK) {
+            const std::string data = os.str();
+            if (::pwrite(ctx->fd, data.data(), data.size(), offset) !=
+                static_cast<ssize_t>(data.size())) {
+                derror_f("fds download failed: write localfile({}) at offset({}) failed, "
+                         "error({})",
+                         ctx->local_file,
+                         offset,
+                         dsn::utils::safe_strerror(errno));
+                err = ERR_FILE_OPERATION_FAILED;
+            }
+        }
+        if (err != ERR_OK && !ctx->failed.exchange(true)) {
+            ctx->err = err;
+        }
+    }
+
+    if (ctx->running_workers.fetch_sub(1) > 1) {
+        return;
+    }
+
+    // the last worker finishes the download
+    ::close(ctx->fd);
+    download_response resp;
+    resp.downloaded_size = 0;
+    resp.err = ctx->failed.load() ? ctx->err : ERR_OK;
+    if (resp.err == ERR_OK &&
+        dsn::utils::filesystem::md5sum(ctx->local_file, resp.file_md5) != ERR_OK) {
+        resp.err = ERR_FILE_OPERATION_FAILED;
+    }
+    if (resp.err == ERR_OK) {
+        resp.downloaded_size = ctx->length;
+    } else {
+        derror_f("fail to download file {} from fds, remove localfile {}",
+                 _fds_path,
+                 ctx->local_file);
+        dsn::utils::filesystem::remove_path(ctx->local_file);
+    }
+    t->enqueue_with(resp);
+    release_ref();
+}
 } // namespace block_service
 } // namespace dist
 } // namespace dsn
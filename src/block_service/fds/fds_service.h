@@ -19,6 +19,10 @@
 #define FDS_SERVICE_H
 
 #include <dsn/dist/block_service.h>
+#include <dsn/tool-api/zlocks.h>
+
+#include <unordered_map>
+#include <vector>
 
 namespace folly {
 template <typename Clock>
@@ -29,7 +33,9 @@ using TokenBucket = BasicTokenBucket<std::chrono::steady_clock>;
 
 namespace galaxy {
 namespace fds {
+class FDSClientConfiguration;
 class GalaxyFDSClient;
+class UploadPartResult;
 }
 }
 
@@ -37,6 +43,17 @@ namespace dsn {
 namespace dist {
 namespace block_service {
 
+// A multipart upload of a large file, which continues from the parts left after a failure.
+struct fds_multipart_upload
+{
+    std::string upload_id;
+    int64_t file_size{0};
+    int64_t part_size{0};
+    // the result of each part, nullptr if the part isn't uploaded yet
+    std::vector<std::shared_ptr<galaxy::fds::UploadPartResult>> parts;
+    bool in_progress{false};
+};
+
 class fds_service : public block_filesystem
 {
 public:
@@ -46,7 +63,10 @@ public:
 
 public:
     fds_service();
-    galaxy::fds::GalaxyFDSClient *get_client() { return _client.get(); }
+    // Borrows an idle client, which is given back to the pool when the returned pointer is
+    // released, so that the keep-alive connections of a client are reused by the requests one
+    // after another rather than set up by each of them.
+    std::shared_ptr<galaxy::fds::GalaxyFDSClient> acquire_client();
     const std::string &get_bucket_name() { return _bucket_name; }
 
     virtual ~fds_service() override;
@@ -72,12 +92,27 @@ public:
                                       const remove_path_callback &cb,
                                       dsn::task_tracker *tracker) override;
 
+    // Returns the multipart upload of `fds_path`, an unfinished one of the same file is reused.
+    error_code start_multipart_upload(const std::string &fds_path,
+                                      int64_t file_size,
+                                      /*out*/ std::shared_ptr<fds_multipart_upload> &upload);
+    // The upload is forgotten if `done`, otherwise it can be continued by the next attempt.
+    void finish_multipart_upload(const std::string &fds_path, bool done);
+
 private:
-    std::shared_ptr<galaxy::fds::GalaxyFDSClient> _client;
+    std::string _access_key;
+    std::string _secret_key;
+    std::unique_ptr<galaxy::fds::FDSClientConfiguration> _client_config;
+    zlock _clients_lock;
+    std::vector<std::unique_ptr<galaxy::fds::GalaxyFDSClient>> _idle_clients;
+
     std::string _bucket_name;
     std::unique_ptr<folly::TokenBucket> _read_token_bucket;
     std::unique_ptr<folly::TokenBucket> _write_token_bucket;
 
+    zlock _multipart_lock;
+    std::unordered_map<std::string, std::shared_ptr<fds_multipart_upload>> _multipart_uploads;
+
     friend class fds_file_object;
 };
 
@@ -129,6 +164,31 @@ private:
                            /*int*/ int64_t to_transfer_bytes,
                            /*out*/ uint64_t &transfered_bytes);
 
+    struct part_upload_context;
+    // Uploads `local_file` in parts concurrently, `t` is resolved after all the parts are done.
+    void upload_in_parts(const std::string &local_file,
+                         int64_t file_size,
+                         const upload_future_ptr &t);
+    void upload_parts(const std::string &local_file,
+                      const std::shared_ptr<part_upload_context> &ctx,
+                      const upload_future_ptr &t);
+    // feeds the part of `index` to the md5 of the object
+    void update_md5(part_upload_context &ctx, size_t index, const std::string &buffer);
+    error_code put_part(fds_multipart_upload &upload, size_t index, const std::string &buffer);
+    error_code complete_multipart_upload(fds_multipart_upload &upload,
+                                         const std::string &md5,
+                                         /*out*/ uint64_t &transfered_bytes);
+
+    struct part_download_context;
+    // Downloads `length` bytes from `start` by ranges concurrently, `t` is resolved after all the
+    // ranges are written to the local file.
+    void download_in_parts(const std::string &local_file,
+                           uint64_t start,
+                           uint64_t length,
+                           const download_future_ptr &t);
+    void download_parts(const std::shared_ptr<part_download_context> &ctx,
+                        const download_future_ptr &t);
+
     fds_service *_service;
     std::string _fds_path;
     std::string _md5sum;
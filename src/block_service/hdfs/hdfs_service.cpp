@@ -18,16 +18,18 @@
 #include "hdfs_service.h"
 
 #include <algorithm>
-#include <fstream>
 
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/file_io.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/defer.h>
 #include <dsn/utility/error_code.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/flags.h>
 #include <dsn/utility/safe_strerror_posix.h>
+#include <dsn/utility/strings.h>
 #include <dsn/utility/TokenBucket.h>
 #include <dsn/utility/utils.h>
 
@@ -36,6 +38,9 @@ namespace dist {
 namespace block_service {
 
 DEFINE_TASK_CODE(LPC_HDFS_SERVICE_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_BLOCK_SERVICE)
+// the local file io of the streaming upload and download, which is waited by the hdfs calls in
+// THREAD_POOL_BLOCK_SERVICE, so it must complete in another pool
+DEFINE_TASK_CODE_AIO(LPC_HDFS_LOCAL_FILE_IO, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
 DSN_DEFINE_uint64("replication",
                   hdfs_read_batch_size_bytes,
@@ -52,6 +57,14 @@ DSN_DEFINE_uint64("replication",
                   "hdfs write batch size, the default value is 64MB");
 DSN_TAG_VARIABLE(hdfs_write_batch_size_bytes, FT_MUTABLE);
 
+DSN_DEFINE_uint32("replication",
+                  hdfs_stream_chunk_size_bytes,
+                  4 << 20,
+                  "the chunk size of the streaming upload and download of hdfs files, a transfer "
+                  "buffers two chunks at most");
+DSN_DEFINE_validator(hdfs_stream_chunk_size_bytes,
+                     [](uint32_t value) -> bool { return value > 0 && value <= (1 << 30); });
+
 hdfs_service::hdfs_service() { _read_token_bucket.reset(new folly::DynamicTokenBucket()); }
 
 hdfs_service::~hdfs_service()
@@ -354,22 +367,7 @@ dsn::task_ptr hdfs_file_object::upload(const upload_request &req,
     add_ref();
     auto upload_background = [this, req, t]() {
         upload_response resp;
-        resp.uploaded_size = 0;
-        std::ifstream is(req.input_local_name, std::ios::binary | std::ios::in);
-        if (is.is_open()) {
-            int64_t file_sz = 0;
-            dsn::utils::filesystem::file_size(req.input_local_name, file_sz);
-            std::unique_ptr<char[]> buffer(new char[file_sz]);
-            is.read(buffer.get(), file_sz);
-            is.close();
-            resp.err = write_data_in_batches(buffer.get(), file_sz, resp.uploaded_size);
-        } else {
-            derror_f("HDFS upload failed: open local file {} failed when upload to {}, error: {}",
-                     req.input_local_name,
-                     file_name(),
-                     utils::safe_strerror(errno));
-            resp.err = dsn::ERR_FILE_OPERATION_FAILED;
-        }
+        resp.err = upload_in_chunks(req.input_local_name, resp.uploaded_size, resp.md5);
         t->enqueue_with(resp);
         release_ref();
     };
@@ -378,6 +376,240 @@ dsn::task_ptr hdfs_file_object::upload(const upload_request &req,
     return t;
 }
 
+error_code hdfs_file_object::upload_in_chunks(const std::string &local_name,
+                                              uint64_t &uploaded_size,
+                                              std::string &md5)
+{
+    uploaded_size = 0;
+    int64_t file_sz = 0;
+    disk_file *local_file = nullptr;
+    if (utils::filesystem::file_size(local_name, file_sz)) {
+        local_file = file::open(local_name.c_str(), O_RDONLY | O_BINARY, 0);
+    }
+    if (local_file == nullptr) {
+        derror_f("HDFS upload failed: open local file {} failed when upload to {}, error: {}",
+                 local_name,
+                 file_name(),
+                 utils::safe_strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    auto close_local = dsn::defer([local_file]() { file::close(local_file); });
+
+    hdfsFile write_file =
+        hdfsOpenFile(_service->get_fs(), file_name().c_str(), O_WRONLY | O_CREAT, 0, 0, 0);
+    if (!write_file) {
+        derror_f("Failed to open hdfs file {} for writting, error: {}.",
+                 file_name(),
+                 utils::safe_strerror(errno));
+        return ERR_FS_INTERNAL;
+    }
+
+    const uint64_t chunk_size = FLAGS_hdfs_stream_chunk_size_bytes;
+    const uint64_t total_size = static_cast<uint64_t>(file_sz);
+    std::unique_ptr<char[]> buffers[2] = {std::unique_ptr<char[]>(new char[chunk_size]),
+                                          std::unique_ptr<char[]>(new char[chunk_size])};
+    auto read_chunk = [&](int i, uint64_t offset) {
+        return file::read(local_file,
+                          buffers[i].get(),
+                          static_cast<int>(std::min(chunk_size, total_size - offset)),
+                          offset,
+                          LPC_HDFS_LOCAL_FILE_IO,
+                          nullptr,
+                          nullptr);
+    };
+
+    error_code err = ERR_OK;
+    utils::md5_calculator md5_calc;
+    uint64_t cur_pos = 0;
+    int cur = 0;
+    aio_task_ptr reading = total_size > 0 ? read_chunk(cur, 0) : nullptr;
+    while (cur_pos < total_size) {
+        reading->wait();
+        const uint64_t len = std::min(chunk_size, total_size - cur_pos);
+        if (reading->error() != ERR_OK || reading->get_transferred_size() != len) {
+            derror_f("HDFS upload failed: read local file {} failed at {}, error: {}",
+                     local_name,
+                     cur_pos,
+                     reading->error());
+            reading = nullptr;
+            err = ERR_FILE_OPERATION_FAILED;
+            break;
+        }
+        // read the next chunk while the current one is written
+        reading = cur_pos + len < total_size ? read_chunk(cur ^ 1, cur_pos + len) : nullptr;
+
+        const char *data = buffers[cur].get();
+        md5_calc.update(data, len);
+        uint64_t written = 0;
+        while (written < len) {
+            tSize num_written_bytes = hdfsWrite(_service->get_fs(),
+                                                write_file,
+                                                (void *)(data + written),
+                                                static_cast<tSize>(len - written));
+            if (num_written_bytes == -1) {
+                derror_f("Failed to write hdfs file {}, error: {}.",
+                         file_name(),
+                         utils::safe_strerror(errno));
+                err = ERR_FS_INTERNAL;
+                break;
+            }
+            written += num_written_bytes;
+        }
+        if (err != ERR_OK) {
+            break;
+        }
+        cur_pos += len;
+        cur ^= 1;
+    }
+    if (reading != nullptr) {
+        // the buffer must outlive the read
+        reading->wait();
+    }
+
+    if (err == ERR_OK && hdfsHFlush(_service->get_fs(), write_file) != 0) {
+        derror_f(
+            "Failed to flush hdfs file {}, error: {}.", file_name(), utils::safe_strerror(errno));
+        err = ERR_FS_INTERNAL;
+    }
+    if (hdfsCloseFile(_service->get_fs(), write_file) != 0) {
+        derror_f(
+            "Failed to close hdfs file {}, error: {}", file_name(), utils::safe_strerror(errno));
+        err = ERR_FS_INTERNAL;
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+    uploaded_size = cur_pos;
+    md5 = md5_calc.digest();
+
+    ddebug("start to synchronize meta data after successfully wrote data to hdfs");
+    return get_file_meta();
+}
+
+error_code hdfs_file_object::download_in_chunks(uint64_t start_pos,
+                                                int64_t length,
+                                                const std::string &local_name,
+                                                uint64_t &downloaded_size,
+                                                std::string &file_md5)
+{
+    downloaded_size = 0;
+    // get file meta if it is not synchronized.
+    if (!_has_meta_synced) {
+        error_code err = get_file_meta();
+        if (err != ERR_OK) {
+            derror_f("Failed to read remote file {}", file_name());
+            return err;
+        }
+    }
+
+    disk_file *local_file =
+        file::open(local_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (local_file == nullptr) {
+        derror_f("HDFS download failed: fail to open localfile {} when download {}, error: {}",
+                 local_name,
+                 file_name(),
+                 utils::safe_strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    auto close_local = dsn::defer([local_file]() { file::close(local_file); });
+
+    hdfsFile read_file = hdfsOpenFile(_service->get_fs(), file_name().c_str(), O_RDONLY, 0, 0, 0);
+    if (!read_file) {
+        derror_f("Failed to open hdfs file {} for reading, error: {}.",
+                 file_name(),
+                 utils::safe_strerror(errno));
+        return ERR_FS_INTERNAL;
+    }
+
+    // if length = -1, we should read the whole file.
+    const uint64_t data_length = (length == -1 ? _size - start_pos : length);
+    const uint64_t chunk_size = FLAGS_hdfs_stream_chunk_size_bytes;
+    std::unique_ptr<char[]> buffers[2] = {std::unique_ptr<char[]>(new char[chunk_size]),
+                                          std::unique_ptr<char[]>(new char[chunk_size])};
+    utils::md5_calculator md5;
+    error_code err = ERR_OK;
+    uint64_t cur_pos = 0;
+    int cur = 0;
+    aio_task_ptr writing;
+    while (cur_pos < data_length) {
+        // fill the current chunk while the previous one is written
+        char *dst_buf = buffers[cur].get();
+        const uint64_t len = std::min(chunk_size, data_length - cur_pos);
+        uint64_t read_size = 0;
+        while (read_size < len) {
+            const uint64_t rate = FLAGS_hdfs_read_limit_rate_megabytes << 20;
+            const uint64_t batch = std::min(len - read_size, FLAGS_hdfs_read_batch_size_bytes);
+            // burst size should not be less than consume size
+            _service->_read_token_bucket->consumeWithBorrowAndWait(
+                batch, rate, std::max(2 * rate, batch));
+            tSize num_read_bytes = hdfsPread(_service->get_fs(),
+                                             read_file,
+                                             static_cast<tOffset>(start_pos + cur_pos + read_size),
+                                             (void *)(dst_buf + read_size),
+                                             static_cast<tSize>(batch));
+            if (num_read_bytes <= 0) {
+                derror_f("Failed to read hdfs file {}, error: {}.",
+                         file_name(),
+                         num_read_bytes == 0 ? "unexpected end of file"
+                                             : utils::safe_strerror(errno));
+                err = ERR_FS_INTERNAL;
+                break;
+            }
+            read_size += num_read_bytes;
+        }
+        if (err != ERR_OK) {
+            break;
+        }
+
+        if (writing != nullptr) {
+            writing->wait();
+            if (writing->error() != ERR_OK) {
+                derror_f("HDFS download failed: write localfile {} failed, error: {}",
+                         local_name,
+                         writing->error());
+                writing = nullptr;
+                err = ERR_FILE_OPERATION_FAILED;
+                break;
+            }
+        }
+        md5.update(dst_buf, len);
+        writing = file::write(local_file,
+                              dst_buf,
+                              static_cast<int>(len),
+                              cur_pos,
+                              LPC_HDFS_LOCAL_FILE_IO,
+                              nullptr,
+                              nullptr);
+        cur_pos += len;
+        cur ^= 1;
+    }
+    if (writing != nullptr) {
+        writing->wait();
+        if (err == ERR_OK && writing->error() != ERR_OK) {
+            derror_f("HDFS download failed: write localfile {} failed, error: {}",
+                     local_name,
+                     writing->error());
+            err = ERR_FILE_OPERATION_FAILED;
+        }
+    }
+
+    if (hdfsCloseFile(_service->get_fs(), read_file) != 0) {
+        derror_f(
+            "Failed to close hdfs file {}, error: {}.", file_name(), utils::safe_strerror(errno));
+        err = ERR_FS_INTERNAL;
+    }
+    if (err == ERR_OK && file::flush(local_file) != ERR_OK) {
+        derror_f("HDFS download failed: flush localfile {} failed", local_name);
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+    downloaded_size = cur_pos;
+    file_md5 = md5.digest();
+    return ERR_OK;
+}
+
 error_code hdfs_file_object::read_data_in_batches(uint64_t start_pos,
                                                   int64_t length,
                                                   std::string &read_buffer,
@@ -399,11 +631,11 @@ error_code hdfs_file_object::read_data_in_batches(uint64_t start_pos,
                  utils::safe_strerror(errno));
         return ERR_FS_INTERNAL;
     }
-    std::unique_ptr<char[]> raw_buf(new char[_size]);
-    char *dst_buf = raw_buf.get();
-
     // if length = -1, we should read the whole file.
-    uint64_t data_length = (length == -1 ? _size : length);
+    uint64_t data_length = (length == -1 ? _size - start_pos : length);
+    // only the requested range is buffered, which is a part of the file in the ranged download
+    std::unique_ptr<char[]> raw_buf(new char[data_length]);
+    char *dst_buf = raw_buf.get();
     uint64_t cur_pos = start_pos;
     uint64_t read_size = 0;
     bool read_success = true;
@@ -480,28 +712,11 @@ dsn::task_ptr hdfs_file_object::download(const download_request &req,
     add_ref();
     auto download_background = [this, req, t]() {
         download_response resp;
-        resp.downloaded_size = 0;
-        std::string read_buffer;
-        size_t read_length = 0;
-        resp.err =
-            read_data_in_batches(req.remote_pos, req.remote_length, read_buffer, read_length);
-        if (resp.err == ERR_OK) {
-            std::ofstream out(req.output_local_name,
-                              std::ios::binary | std::ios::out | std::ios::trunc);
-            if (out.is_open()) {
-                out.write(read_buffer.c_str(), read_length);
-                out.close();
-                resp.downloaded_size = read_length;
-            } else {
-                derror_f("HDFS download failed: fail to open localfile {} when download {}, "
-                         "error: {}",
-                         req.output_local_name,
-                         file_name(),
-                         utils::safe_strerror(errno));
-                resp.err = ERR_FILE_OPERATION_FAILED;
-                resp.downloaded_size = 0;
-            }
-        }
+        resp.err = download_in_chunks(req.remote_pos,
+                                      req.remote_length,
+                                      req.output_local_name,
+                                      resp.downloaded_size,
+                                      resp.file_md5);
         t->enqueue_with(resp);
         release_ref();
     };
@@ -102,6 +102,18 @@ private:
                                     std::string &read_buffer,
                                     size_t &read_length);
 
+    // Stream the local file to hdfs, or the hdfs file to the local file, in chunks of
+    // hdfs_stream_chunk_size_bytes: the next chunk is read while the current one is written,
+    // so a transfer never takes more memory than two chunks.
+    error_code upload_in_chunks(const std::string &local_name,
+                                uint64_t &uploaded_size,
+                                std::string &md5);
+    error_code download_in_chunks(uint64_t start_pos,
+                                  int64_t length,
+                                  const std::string &local_name,
+                                  uint64_t &downloaded_size,
+                                  std::string &file_md5);
+
     hdfs_service *_service;
     std::string _md5sum;
     uint64_t _size;
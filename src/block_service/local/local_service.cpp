@@ -22,22 +22,146 @@
 #include <dsn/utility/error_code.h>
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/safe_strerror_posix.h>
 #include <dsn/utility/strings.h>
 #include <dsn/utility/utils.h>
+#include <fcntl.h>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "local_service.h"
 
-static const int max_length = 2048; // max data length read from file each time
+// max data length copied by each system call, which is also the granularity of the sync batch
+static const size_t max_copy_length = 16 << 20;
 
 namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DEFINE_uint64("replication",
+                  local_service_sync_batch_bytes,
+                  0,
+                  "the files written by the local block service are synced every time this "
+                  "many bytes are written and when they are complete, 0 to never sync them");
+
 DEFINE_TASK_CODE(LPC_LOCAL_SERVICE_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_BLOCK_SERVICE)
 
+namespace {
+
+// syncs `fd` when the `unsynced` bytes reach the sync batch, or when `force` and any are left
+bool sync_written_bytes(int fd, uint64_t &unsynced, bool force)
+{
+    if (FLAGS_local_service_sync_batch_bytes == 0 || unsynced == 0 ||
+        (!force && unsynced < FLAGS_local_service_sync_batch_bytes)) {
+        return true;
+    }
+    unsynced = 0;
+    if (::fdatasync(fd) != 0) {
+        derror_f("fdatasync failed, err = {}", utils::safe_strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool write_fully(int fd, const char *data, size_t length, uint64_t &unsynced)
+{
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, std::min(length, max_copy_length));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            derror_f("write failed, err = {}", utils::safe_strerror(errno));
+            return false;
+        }
+        data += n;
+        length -= n;
+        unsynced += n;
+        if (!sync_written_bytes(fd, unsynced, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// copies the rest of `src_fd` to `dst_fd`. copy_file_range moves the data inside the kernel,
+// or even inside the NFS server by server side copy, and sendfile is the fallback where it's
+// not supported, e.g. across file systems on the older kernels. both fall back to plain
+// read/write at last.
+error_code copy_file_data(int src_fd, int dst_fd, /*out*/ int64_t &copied)
+{
+    enum class copy_mode
+    {
+        COPY_FILE_RANGE,
+        SENDFILE,
+        READ_WRITE
+    };
+#ifdef SYS_copy_file_range
+    copy_mode mode = copy_mode::COPY_FILE_RANGE;
+#else
+    copy_mode mode = copy_mode::SENDFILE;
+#endif
+    std::unique_ptr<char[]> buf;
+    uint64_t unsynced = 0;
+    copied = 0;
+    while (true) {
+        ssize_t n = 0;
+        switch (mode) {
+        case copy_mode::COPY_FILE_RANGE:
+#ifdef SYS_copy_file_range
+            n = ::syscall(
+                SYS_copy_file_range, src_fd, nullptr, dst_fd, nullptr, max_copy_length, 0);
+#endif
+            break;
+        case copy_mode::SENDFILE:
+            n = ::sendfile(dst_fd, src_fd, nullptr, max_copy_length);
+            break;
+        case copy_mode::READ_WRITE:
+            if (buf == nullptr) {
+                buf.reset(new char[max_copy_length]);
+            }
+            n = ::read(src_fd, buf.get(), max_copy_length);
+            if (n > 0 && !write_fully(dst_fd, buf.get(), n, unsynced)) {
+                return ERR_FILE_OPERATION_FAILED;
+            }
+            break;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // the offsets of both files are where the failed call started, so the copy goes on
+            // by the fallback
+            if (mode != copy_mode::READ_WRITE &&
+                (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                mode = mode == copy_mode::COPY_FILE_RANGE ? copy_mode::SENDFILE
+                                                          : copy_mode::READ_WRITE;
+                continue;
+            }
+            derror_f("copy file data failed, err = {}", utils::safe_strerror(errno));
+            return ERR_FILE_OPERATION_FAILED;
+        }
+        if (n == 0) {
+            break;
+        }
+        copied += n;
+        if (mode != copy_mode::READ_WRITE) {
+            unsynced += n;
+            if (!sync_written_bytes(dst_fd, unsynced, false)) {
+                return ERR_FILE_OPERATION_FAILED;
+            }
+        }
+    }
+    return sync_written_bytes(dst_fd, unsynced, true) ? ERR_OK : ERR_FILE_OPERATION_FAILED;
+}
+
+} // anonymous namespace
+
 struct file_metadata
 {
     uint64_t size;
@@ -334,13 +458,18 @@ dsn::task_ptr local_file_object::write(const write_request &req,
         if (resp.err == ERR_OK) {
             dinfo("start write file, file = %s", file_name().c_str());
 
-            std::ofstream fout(file_name(), std::ifstream::out | std::ifstream::trunc);
-            if (!fout.is_open()) {
+            int fd = ::open(file_name().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            uint64_t unsynced = 0;
+            if (fd < 0) {
+                resp.err = ERR_FS_INTERNAL;
+            } else if (!write_fully(fd, req.buffer.data(), req.buffer.length(), unsynced) ||
+                       !sync_written_bytes(fd, unsynced, true)) {
+                derror_f("write file({}) failed", file_name());
                 resp.err = ERR_FS_INTERNAL;
+                ::close(fd);
             } else {
-                fout.write(req.buffer.data(), req.buffer.length());
                 resp.written_size = req.buffer.length();
-                fout.close();
+                ::close(fd);
 
                 // Currently we calc the meta data from source data, which save the io bandwidth
                 // a lot, but it is somewhat not correct.
@@ -387,18 +516,36 @@ dsn::task_ptr local_file_object::read(const read_request &req,
                 }
 
                 dinfo("read file(%s), size = %ld", file_name().c_str(), total_sz);
-                std::string buf;
-                buf.resize(total_sz + 1);
-                std::ifstream fin(file_name(), std::ifstream::in);
-                if (!fin.is_open()) {
+                int fd = ::open(file_name().c_str(), O_RDONLY);
+                if (fd < 0) {
                     resp.err = ERR_FS_INTERNAL;
                 } else {
-                    fin.seekg(static_cast<int64_t>(req.remote_pos), fin.beg);
-                    fin.read((char *)buf.c_str(), total_sz);
-                    buf[fin.gcount()] = '\0';
-                    resp.buffer = blob::create_from_bytes(std::move(buf));
+                    // read into the blob directly, which saves the copy through a string
+                    std::shared_ptr<char> buf = utils::make_shared_array<char>(total_sz);
+                    int64_t read_sz = 0;
+                    while (read_sz < total_sz) {
+                        ssize_t n = ::pread(
+                            fd, buf.get() + read_sz, total_sz - read_sz, req.remote_pos + read_sz);
+                        if (n < 0 && errno == EINTR) {
+                            continue;
+                        }
+                        if (n < 0) {
+                            derror_f("read file({}) failed, err = {}",
+                                     file_name(),
+                                     utils::safe_strerror(errno));
+                            resp.err = ERR_FS_INTERNAL;
+                            break;
+                        }
+                        if (n == 0) {
+                            break;
+                        }
+                        read_sz += n;
+                    }
+                    ::close(fd);
+                    if (resp.err == ERR_OK) {
+                        resp.buffer.assign(std::move(buf), 0, static_cast<unsigned int>(read_sz));
+                    }
                 }
-                fin.close();
             }
         }
 
@@ -421,8 +568,8 @@ dsn::task_ptr local_file_object::upload(const upload_request &req,
     auto upload_file_func = [this, req, tsk]() {
         upload_response resp;
         resp.err = ERR_OK;
-        std::ifstream fin(req.input_local_name, std::ios_base::in);
-        if (!fin.is_open()) {
+        int src_fd = ::open(req.input_local_name.c_str(), O_RDONLY);
+        if (src_fd < 0) {
             dwarn("open source file %s for read failed, err(%s)",
                   req.input_local_name.c_str(),
                   utils::safe_strerror(errno).c_str());
@@ -430,45 +577,47 @@ dsn::task_ptr local_file_object::upload(const upload_request &req,
         }
 
         utils::filesystem::create_file(file_name());
-        std::ofstream fout(file_name(), std::ios_base::out | std::ios_base::trunc);
-        if (!fout.is_open()) {
+        int dst_fd = ::open(file_name().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (dst_fd < 0) {
             dwarn("open target file %s for write failed, err(%s)",
                   file_name().c_str(),
                   utils::safe_strerror(errno).c_str());
             resp.err = ERR_FS_INTERNAL;
         }
-
+        auto cleanup = dsn::defer([src_fd, dst_fd]() {
+            if (src_fd >= 0)
+                ::close(src_fd);
+            if (dst_fd >= 0)
+                ::close(dst_fd);
+        });
+
+        int64_t total_sz = 0;
         if (resp.err == ERR_OK) {
             dinfo("start to transfer from src_file(%s) to des_file(%s)",
                   req.input_local_name.c_str(),
                   file_name().c_str());
-            int64_t total_sz = 0;
-            char buf[max_length] = {'\0'};
-            while (!fin.eof()) {
-                fin.read(buf, max_length);
-                total_sz += fin.gcount();
-                fout.write(buf, fin.gcount());
+            if (copy_file_data(src_fd, dst_fd, total_sz) != ERR_OK) {
+                derror("upload file %s to %s failed",
+                       req.input_local_name.c_str(),
+                       file_name().c_str());
+                resp.err = ERR_FS_INTERNAL;
             }
-            dinfo("finish upload file, file = %s, total_size = %d", file_name().c_str(), total_sz);
-            fout.close();
-            fin.close();
+        }
 
+        if (resp.err == ERR_OK) {
+            dinfo("finish upload file, file = %s, total_size = %d", file_name().c_str(), total_sz);
             resp.uploaded_size = static_cast<uint64_t>(total_sz);
 
             // calc the md5sum by source file for simplicity
             _size = total_sz;
             error_code res = utils::filesystem::md5sum(req.input_local_name, _md5_value);
             if (res == dsn::ERR_OK) {
+                resp.md5 = _md5_value;
                 _has_meta_synced = true;
                 store_metadata();
             } else {
                 resp.err = ERR_FS_INTERNAL;
             }
-        } else {
-            if (fin.is_open())
-                fin.close();
-            if (fout.is_open())
-                fout.close();
         }
 
         tsk->enqueue_with(resp);
@@ -507,22 +656,23 @@ dsn::task_ptr local_file_object::download(const download_request &req,
         }
 
         if (resp.err == ERR_OK) {
-            std::ifstream fin(file_name(), std::ifstream::in);
-            if (!fin.is_open()) {
+            int src_fd = ::open(file_name().c_str(), O_RDONLY);
+            if (src_fd < 0) {
                 derror("open block file(%s) failed, err(%s)",
                        file_name().c_str(),
                        utils::safe_strerror(errno).c_str());
                 resp.err = ERR_FS_INTERNAL;
             }
 
-            std::ofstream fout(target_file, std::ios_base::out | std::ios_base::trunc);
-            if (!fout.is_open()) {
-                if (fin.is_open())
-                    fin.close();
-                derror("open target file(%s) failed, err(%s)",
-                       target_file.c_str(),
-                       utils::safe_strerror(errno).c_str());
-                resp.err = ERR_FILE_OPERATION_FAILED;
+            int dst_fd = -1;
+            if (resp.err == ERR_OK) {
+                dst_fd = ::open(target_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                if (dst_fd < 0) {
+                    derror("open target file(%s) failed, err(%s)",
+                           target_file.c_str(),
+                           utils::safe_strerror(errno).c_str());
+                    resp.err = ERR_FILE_OPERATION_FAILED;
+                }
             }
 
             if (resp.err == ERR_OK) {
@@ -530,26 +680,29 @@ dsn::task_ptr local_file_object::download(const download_request &req,
                       file_name().c_str(),
                       target_file.c_str());
                 int64_t total_sz = 0;
-                char buf[max_length] = {'\0'};
-                while (!fin.eof()) {
-                    fin.read(buf, max_length);
-                    total_sz += fin.gcount();
-                    fout.write(buf, fin.gcount());
-                }
+                resp.err = copy_file_data(src_fd, dst_fd, total_sz);
                 dinfo("finish download file(%s), total_size = %d", target_file.c_str(), total_sz);
-                fout.close();
-                fin.close();
-                resp.downloaded_size = static_cast<uint64_t>(total_sz);
-
-                _size = total_sz;
-                if ((resp.err = utils::filesystem::md5sum(target_file, _md5_value)) != ERR_OK) {
-                    dwarn("download %s failed when calculate the md5sum of %s",
-                          file_name().c_str(),
-                          target_file.c_str());
+                // the data isn't passed through the user space, so the md5 is calculated from
+                // the target file, which is mostly in the page cache
+                if (resp.err == ERR_OK &&
+                    utils::filesystem::md5sum(target_file, resp.file_md5) != ERR_OK) {
+                    resp.err = ERR_FILE_OPERATION_FAILED;
+                }
+                if (resp.err != ERR_OK) {
+                    derror("write target file(%s) failed", target_file.c_str());
+                    resp.err = ERR_FILE_OPERATION_FAILED;
                 } else {
+                    resp.downloaded_size = static_cast<uint64_t>(total_sz);
+
+                    _size = total_sz;
+                    _md5_value = resp.file_md5;
                     _has_meta_synced = true;
                 }
             }
+            if (src_fd >= 0)
+                ::close(src_fd);
+            if (dst_fd >= 0)
+                ::close(dst_fd);
         }
 
         tsk->enqueue_with(resp);
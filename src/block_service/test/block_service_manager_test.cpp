@@ -22,12 +22,16 @@
 #include <fstream>
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
 
 namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DECLARE_uint32(block_service_ranged_download_min_mb);
+DSN_DECLARE_uint32(block_service_download_range_mb);
+
 class block_service_manager_test : public ::testing::Test
 {
 public:
@@ -119,6 +123,62 @@ TEST_F(block_service_manager_test, do_download_succeed)
     ASSERT_EQ(download_size, _file_meta.size);
 }
 
+TEST_F(block_service_manager_test, do_download_by_ranges)
+{
+    auto fs = make_unique<local_service>();
+    fs->initialize({LOCAL_DIR});
+    utils::filesystem::create_directory(utils::filesystem::path_combine(LOCAL_DIR, PROVIDER));
+
+    // a file of 2.5 ranges, which makes the last range a partial one
+    std::string source_name = utils::filesystem::path_combine(LOCAL_DIR, "source_file");
+    {
+        std::ofstream source(source_name);
+        for (int i = 0; i < 5 * 1024 * 64; ++i) {
+            source << "abcdefg" << i % 10;
+        }
+    }
+    std::string source_md5;
+    ASSERT_EQ(utils::filesystem::md5sum(source_name, source_md5), ERR_OK);
+    int64_t source_size = 0;
+    ASSERT_TRUE(utils::filesystem::file_size(source_name, source_size));
+
+    block_file_ptr remote_file;
+    fs->create_file(create_file_request{utils::filesystem::path_combine(PROVIDER, FILE_NAME),
+                                        false},
+                    TASK_CODE_EXEC_INLINED,
+                    [&remote_file](const create_file_response &resp) {
+                        ASSERT_EQ(resp.err, ERR_OK);
+                        remote_file = resp.file_handle;
+                    },
+                    nullptr)
+        ->wait();
+    ASSERT_NE(remote_file, nullptr);
+    remote_file
+        ->upload(upload_request{source_name},
+                 TASK_CODE_EXEC_INLINED,
+                 [](const upload_response &resp) { ASSERT_EQ(resp.err, ERR_OK); },
+                 nullptr)
+        ->wait();
+
+    uint32_t old_min_mb = FLAGS_block_service_ranged_download_min_mb;
+    uint32_t old_range_mb = FLAGS_block_service_download_range_mb;
+    FLAGS_block_service_ranged_download_min_mb = 1;
+    FLAGS_block_service_download_range_mb = 1;
+
+    uint64_t download_size = 0;
+    error_code err = _block_service_manager.download_file(
+        PROVIDER, LOCAL_DIR, FILE_NAME, fs.get(), download_size);
+    FLAGS_block_service_ranged_download_min_mb = old_min_mb;
+    FLAGS_block_service_download_range_mb = old_range_mb;
+    ASSERT_EQ(err, ERR_OK);
+    ASSERT_EQ(download_size, source_size);
+    std::string download_md5;
+    ASSERT_EQ(utils::filesystem::md5sum(utils::filesystem::path_combine(LOCAL_DIR, FILE_NAME),
+                                        download_md5),
+              ERR_OK);
+    ASSERT_EQ(download_md5, source_md5);
+}
+
 } // namespace block_service
 } // namespace dist
 } // namespace dsn
@@ -217,6 +217,7 @@ TEST_F(FDSClientTest, test_basic_operation)
             ASSERT_EQ(dsn::ERR_OK, u_resp.err);
             ASSERT_EQ(FDSClientTest::f1.length, cf_resp.file_handle->get_size());
             ASSERT_EQ(FDSClientTest::f1.md5, cf_resp.file_handle->get_md5sum());
+            ASSERT_EQ(FDSClientTest::f1.md5, u_resp.md5);
         }
 
         // create a non-exist file for read
@@ -254,6 +255,7 @@ TEST_F(FDSClientTest, test_basic_operation)
             ASSERT_EQ(dsn::ERR_OK, u_resp.err);
             ASSERT_EQ(FDSClientTest::f2.length, cf_resp.file_handle->get_size());
             ASSERT_EQ(FDSClientTest::f2.md5, cf_resp.file_handle->get_md5sum());
+            ASSERT_EQ(FDSClientTest::f2.md5, u_resp.md5);
 
             // upload an non-exist local file
             cf_resp.file_handle
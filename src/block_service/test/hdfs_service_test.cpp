@@ -120,6 +120,9 @@ TEST_F(HDFSClientTest, test_basic_operation)
         ->wait();
     ASSERT_EQ(dsn::ERR_OK, u_resp.err);
     ASSERT_EQ(test_file_size, cf_resp.file_handle->get_size());
+    std::string local_md5;
+    ASSERT_EQ(dsn::ERR_OK, dsn::utils::filesystem::md5sum(local_test_file, local_md5));
+    ASSERT_EQ(local_md5, u_resp.md5);
 
     // test list directory.
     ls_response l_resp;
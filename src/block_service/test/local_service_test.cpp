@@ -19,6 +19,9 @@
 
 #include <gtest/gtest.h>
 #include <boost/filesystem.hpp>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/strings.h>
 #include <nlohmann/json.hpp>
 
 #include "block_service/local/local_service.h"
@@ -27,6 +30,8 @@ namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DECLARE_uint64(local_service_sync_batch_bytes);
+
 // Simple tests for nlohmann::json serialization, via NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE.
 
 TEST(local_service, store_metadata)
@@ -81,6 +86,68 @@ TEST(local_service, load_metadata)
     }
 }
 
+TEST(local_service, upload_read_download)
+{
+    uint64_t old_sync_batch = FLAGS_local_service_sync_batch_bytes;
+    FLAGS_local_service_sync_batch_bytes = 4096;
+
+    std::string content;
+    for (int i = 0; i < 10000; ++i) {
+        content.append(std::to_string(i));
+    }
+    {
+        std::ofstream ofs("upload_source.txt");
+        ofs << content;
+    }
+
+    dsn::ref_ptr<local_file_object> file(new local_file_object("b.txt"));
+    upload_response upload_resp;
+    file->upload(upload_request{"upload_source.txt"},
+                 TASK_CODE_EXEC_INLINED,
+                 [&upload_resp](const upload_response &resp) { upload_resp = resp; },
+                 nullptr)
+        ->wait();
+    ASSERT_EQ(upload_resp.err, ERR_OK);
+    ASSERT_EQ(upload_resp.uploaded_size, content.size());
+    ASSERT_EQ(utils::string_md5(content.data(), content.size()), upload_resp.md5);
+
+    // read a range in the middle, and the one over the end of the file
+    read_response read_resp;
+    file->read(read_request{100, 1000},
+               TASK_CODE_EXEC_INLINED,
+               [&read_resp](const read_response &resp) { read_resp = resp; },
+               nullptr)
+        ->wait();
+    ASSERT_EQ(read_resp.err, ERR_OK);
+    ASSERT_EQ(read_resp.buffer.to_string(), content.substr(100, 1000));
+    file->read(read_request{content.size() - 10, 100},
+               TASK_CODE_EXEC_INLINED,
+               [&read_resp](const read_response &resp) { read_resp = resp; },
+               nullptr)
+        ->wait();
+    ASSERT_EQ(read_resp.err, ERR_OK);
+    ASSERT_EQ(read_resp.buffer.to_string(), content.substr(content.size() - 10));
+
+    download_response download_resp;
+    file->download(download_request{"download_target.txt", 0, -1},
+                   TASK_CODE_EXEC_INLINED,
+                   [&download_resp](const download_response &resp) { download_resp = resp; },
+                   nullptr)
+        ->wait();
+    ASSERT_EQ(download_resp.err, ERR_OK);
+    ASSERT_EQ(download_resp.downloaded_size, content.size());
+    ASSERT_EQ(download_resp.file_md5, file->get_md5sum());
+    std::string downloaded;
+    ASSERT_EQ(utils::filesystem::read_file("download_target.txt", downloaded), ERR_OK);
+    ASSERT_EQ(downloaded, content);
+
+    FLAGS_local_service_sync_batch_bytes = old_sync_batch;
+    utils::filesystem::remove_path("upload_source.txt");
+    utils::filesystem::remove_path("download_target.txt");
+    utils::filesystem::remove_path("b.txt");
+    utils::filesystem::remove_path(local_service::get_metafile("b.txt"));
+}
+
 } // namespace block_service
 } // namespace dist
 } // namespace dsn
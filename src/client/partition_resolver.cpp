@@ -95,8 +95,9 @@ void partition_resolver::call_task(const rpc_response_task_ptr &t)
     };
     t->replace_callback(std::move(new_callback));
 
+    partition_resolver_ptr r(this);
     resolve(hdr.client.partition_hash,
-            [t](resolve_result &&result) mutable {
+            [t, r](resolve_result &&result) mutable {
                 if (result.err != ERR_OK) {
                     t->enqueue(result.err, nullptr);
                     return;
@@ -113,9 +114,110 @@ void partition_resolver::call_task(const rpc_response_task_ptr &t)
                         hdr.client.thread_hash = result.pid.thread_hash();
                     }
                 }
-                dsn_rpc_call(result.address, t.get());
+                if (!r->call_resolved(t, result)) {
+                    dsn_rpc_call(result.address, t.get());
+                }
             },
             hdr.client.timeout_ms);
 }
+
+void partition_resolver::prewarm(task_code code,
+                                 std::chrono::milliseconds timeout,
+                                 std::function<void(error_code)> &&callback)
+{
+    // resolving any hash gets all the partitions queried if the partition count is unknown
+    partition_resolver_ptr r(this);
+    resolve(0,
+            [ r, code, cb = std::move(callback) ](resolve_result && result) {
+                if (result.err == ERR_OK) {
+                    r->prepare_sessions(code);
+                }
+                if (cb) {
+                    cb(result.err);
+                }
+            },
+            static_cast<int>(timeout.count()));
+}
+
+/*static*/
+void partition_resolver::prewarm(const char *cluster_name,
+                                 const std::vector<rpc_address> &meta_list,
+                                 const std::vector<std::string> &app_names,
+                                 task_code code,
+                                 std::chrono::milliseconds timeout,
+                                 std::function<void(error_code)> &&callback)
+{
+    struct prewarm_context
+    {
+        std::atomic<size_t> pending_count;
+        zlock lock;
+        error_code err;
+        std::function<void(error_code)> callback;
+    };
+    auto ctx = std::make_shared<prewarm_context>();
+    ctx->pending_count = app_names.size();
+    ctx->err = ERR_OK;
+    ctx->callback = std::move(callback);
+    if (app_names.empty()) {
+        if (ctx->callback) {
+            ctx->callback(ERR_OK);
+        }
+        return;
+    }
+
+    for (const auto &app_name : app_names) {
+        get_resolver(cluster_name, meta_list, app_name.c_str())
+            ->prewarm(code, timeout, [ctx](error_code err) {
+                if (err != ERR_OK) {
+                    zauto_lock l(ctx->lock);
+                    ctx->err = err;
+                }
+                if (--ctx->pending_count == 0 && ctx->callback) {
+                    error_code result;
+                    {
+                        zauto_lock l(ctx->lock);
+                        result = ctx->err;
+                    }
+                    ctx->callback(result);
+                }
+            });
+    }
+}
+
+void partition_resolver::group_by_partition(
+    std::vector<uint64_t> &&hashes,
+    int timeout_ms,
+    std::function<void(error_code, std::vector<std::vector<size_t>> &&)> &&callback)
+{
+    partition_resolver_ptr r(this);
+    uint64_t first_hash = hashes[0];
+    resolve(first_hash,
+            [ r, hashes = std::move(hashes), cb = std::move(callback) ](resolve_result && result) {
+                if (result.err != ERR_OK) {
+                    cb(result.err, {});
+                    return;
+                }
+
+                std::vector<std::vector<size_t>> groups;
+                int partition_count = r->get_partition_count();
+                if (partition_count <= 0) {
+                    for (size_t i = 0; i < hashes.size(); i++) {
+                        groups.push_back({i});
+                    }
+                } else {
+                    std::vector<int> group_of_partition(partition_count, -1);
+                    for (size_t i = 0; i < hashes.size(); i++) {
+                        int idx = r->get_partition_index(partition_count, hashes[i]);
+                        if (group_of_partition[idx] == -1) {
+                            group_of_partition[idx] = static_cast<int>(groups.size());
+                            groups.emplace_back();
+                        }
+                        groups[group_of_partition[idx]].push_back(i);
+                    }
+                }
+                cb(ERR_OK, std::move(groups));
+            },
+            timeout_ms);
+}
 } // namespace replication
 } // namespace dsn
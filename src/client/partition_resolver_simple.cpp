@@ -26,18 +26,56 @@
 
 #include <dsn/utility/utils.h>
 #include <dsn/utility/rand.h>
+#include <dsn/utility/flags.h>
 #include <dsn/tool-api/async_calls.h>
+#include <algorithm>
 #include "partition_resolver_simple.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  hedged_read_delay_percentile,
+                  95,
+                  "a hedged read is sent to a secondary when the primary doesn't reply within "
+                  "this percentile of the recent read latencies of the partition");
+DSN_DEFINE_uint32("replication",
+                  hedged_read_min_delay_ms,
+                  2,
+                  "the lower bound of the delay before a hedged read is sent");
+DSN_DEFINE_uint32("replication",
+                  hedged_read_default_delay_ms,
+                  20,
+                  "the delay before a hedged read is sent, when the latencies of the partition "
+                  "are not observed enough");
+DSN_DEFINE_bool("replication",
+                partition_config_watch_enabled,
+                true,
+                "whether the client watches the partition configurations on the meta server "
+                "to learn the changes without waiting for the accesses to fail");
+DSN_DEFINE_uint32("replication",
+                  partition_config_watch_expire_ms,
+                  30000,
+                  "the time a watch of the partition configurations is held by the meta server "
+                  "when nothing changes");
+
 partition_resolver_simple::partition_resolver_simple(rpc_address meta_server, const char *app_name)
     : partition_resolver(meta_server, app_name),
       _app_id(-1),
       _app_partition_count(-1),
-      _app_is_stateful(true)
+      _app_is_stateful(true),
+      _config_cache(std::make_shared<config_table>())
+{
+}
+
+void partition_resolver_simple::update_config_cache(
+    const std::function<void(config_table &)> &update)
 {
+    zauto_lock l(_config_update_lock);
+    // only the updates change _config_cache, which are serialized by _config_update_lock
+    auto table = std::make_shared<config_table>(_config_cache.get());
+    update(*table);
+    _config_cache.set(std::move(table));
 }
 
 void partition_resolver_simple::resolve(uint64_t partition_hash,
@@ -66,6 +104,20 @@ void partition_resolver_simple::resolve(uint64_t partition_hash,
     call(std::move(rc), false);
 }
 
+void partition_resolver_simple::prepare_sessions(task_code code)
+{
+    for (const auto &kv : get_config_cache()) {
+        const partition_configuration &config = kv.second->config;
+        rpc_address target = get_address(config);
+        if (target.is_invalid()) {
+            continue;
+        }
+        // the same thread hash as call_task gives to the requests, which picks the session
+        dsn_rpc_prepare_session(
+            target, dsn::message_ex::create_request(code, 0, config.pid.thread_hash()));
+    }
+}
+
 void partition_resolver_simple::on_access_failure(int partition_index, error_code err)
 {
     if (-1 != partition_index &&
@@ -83,12 +135,10 @@ void partition_resolver_simple::on_access_failure(int partition_index, error_cod
                partition_index,
                err.to_string());
 
-        {
-            zauto_write_lock l(_config_lock);
-            auto it = _config_cache.find(partition_index);
-            if (it != _config_cache.end()) {
-                _config_cache.erase(it);
-            }
+        if (get_config_cache().count(partition_index) > 0) {
+            update_config_cache([partition_index](config_table &table) {
+                table.erase(partition_index);
+            });
         }
     }
 }
@@ -263,52 +313,10 @@ void partition_resolver_simple::query_config_reply(error_code err,
         configuration_query_by_index_response resp;
         unmarshall(response, resp);
         if (resp.err == ERR_OK) {
-            zauto_write_lock l(_config_lock);
-
-            if (_app_id != -1 && _app_id != resp.app_id) {
-                dassert(false,
-                        "app id is changed (mostly the app was removed and created with the same "
-                        "name), local Vs remote: %u vs %u ",
-                        _app_id,
-                        resp.app_id);
-            }
-            if (_app_partition_count != -1 && _app_partition_count != resp.partition_count) {
-                dassert(false,
-                        "partition count is changed (mostly the app was removed and created with "
-                        "the same name), local Vs remote: %u vs %u ",
-                        _app_partition_count,
-                        resp.partition_count);
-            }
-            _app_id = resp.app_id;
-            _app_partition_count = resp.partition_count;
-            _app_is_stateful = resp.is_stateful;
-
-            for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
-                auto &new_config = *it;
-
-                dinfo("%s.client: query config reply, gpid = %d.%d, ballot = %" PRId64
-                      ", primary = %s",
-                      _app_name.c_str(),
-                      new_config.pid.get_app_id(),
-                      new_config.pid.get_partition_index(),
-                      new_config.ballot,
-                      new_config.primary.to_string());
-
-                auto it2 = _config_cache.find(new_config.pid.get_partition_index());
-                if (it2 == _config_cache.end()) {
-                    std::unique_ptr<partition_info> pi(new partition_info);
-                    pi->timeout_count = 0;
-                    pi->config = new_config;
-                    _config_cache.emplace(new_config.pid.get_partition_index(), std::move(pi));
-                } else if (_app_is_stateful && it2->second->config.ballot < new_config.ballot) {
-                    it2->second->timeout_count = 0;
-                    it2->second->config = new_config;
-                } else if (!_app_is_stateful) {
-                    it2->second->timeout_count = 0;
-                    it2->second->config = new_config;
-                } else {
-                    // nothing to do
-                }
+            apply_config_response(resp);
+            if (partition_index == -1 && FLAGS_partition_config_watch_enabled &&
+                !_watching.exchange(true)) {
+                watch_config();
             }
         } else if (resp.err == ERR_OBJECT_NOT_FOUND) {
             derror("%s.client: query config reply, gpid = %d.%d, err = %s",
@@ -356,7 +364,7 @@ void partition_resolver_simple::query_config_reply(error_code err,
     // get all partition update
     else {
         pending_replica_requests reqs;
-        std::deque<request_context_ptr> reqs2;
+        request_queue reqs2;
         {
             zauto_lock l(_requests_lock);
             reqs.swap(_pending_requests);
@@ -385,8 +393,129 @@ void partition_resolver_simple::query_config_reply(error_code err,
     }
 }
 
-void partition_resolver_simple::handle_pending_requests(std::deque<request_context_ptr> &reqs,
-                                                        error_code err)
+bool partition_resolver_simple::apply_config_response(
+    const configuration_query_by_index_response &resp)
+{
+    bool app_changed = false;
+    // the new table is built off the resolve path, which keeps reading the old one
+    update_config_cache([this, &resp, &app_changed](config_table &table) {
+        if ((_app_id != -1 && _app_id != resp.app_id) ||
+            (_app_partition_count != -1 && _app_partition_count != resp.partition_count)) {
+            // the app was removed and created with the same name, or it was split, none of the
+            // cached partitions can be trusted any more
+            dwarn("%s.client: app is changed, reset the config cache, app_id: %d vs %d, "
+                  "partition_count: %d vs %d",
+                  _app_name.c_str(),
+                  _app_id,
+                  resp.app_id,
+                  _app_partition_count,
+                  resp.partition_count);
+            table.clear();
+            app_changed = true;
+        }
+        _app_id = resp.app_id;
+        _app_partition_count = resp.partition_count;
+        _app_is_stateful = resp.is_stateful;
+
+        for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
+            auto &new_config = *it;
+
+            dinfo("%s.client: query config reply, gpid = %d.%d, ballot = %" PRId64
+                  ", primary = %s",
+                  _app_name.c_str(),
+                  new_config.pid.get_app_id(),
+                  new_config.pid.get_partition_index(),
+                  new_config.ballot,
+                  new_config.primary.to_string());
+
+            auto it2 = table.find(new_config.pid.get_partition_index());
+            if (it2 == table.end() || !_app_is_stateful ||
+                it2->second->config.ballot < new_config.ballot) {
+                std::shared_ptr<partition_info> pi(new partition_info);
+                pi->timeout_count = 0;
+                pi->config = new_config;
+                table[new_config.pid.get_partition_index()] = std::move(pi);
+            } else {
+                // nothing to do
+            }
+        }
+    });
+    return !app_changed;
+}
+
+DEFINE_TASK_CODE_RPC(RPC_CM_WATCH_APP_CONFIGURATION, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+void partition_resolver_simple::watch_config()
+{
+    configuration_watch_app_request req;
+    req.app_name = _app_name;
+    req.app_id = _app_id;
+    req.expire_ms = FLAGS_partition_config_watch_expire_ms;
+    // -1 for the partitions not known yet
+    req.known_ballots.assign(_app_partition_count, -1);
+    for (const auto &kv : get_config_cache()) {
+        if (kv.first >= 0 && kv.first < _app_partition_count) {
+            req.known_ballots[kv.first] = kv.second->config.ballot;
+        }
+    }
+
+    // the meta server holds the watch for up to expire_ms
+    auto msg = dsn::message_ex::create_request(RPC_CM_WATCH_APP_CONFIGURATION,
+                                               req.expire_ms + 10000);
+    marshall(msg, req);
+    rpc::call(_meta_server,
+              msg,
+              &_tracker,
+              [this](error_code err, dsn::message_ex *, dsn::message_ex *resp) {
+                  watch_config_reply(err, resp);
+              });
+}
+
+void partition_resolver_simple::watch_config_reply(error_code err, dsn::message_ex *response)
+{
+    if (err == ERR_OK) {
+        configuration_query_by_index_response resp;
+        unmarshall(response, resp);
+        err = resp.err;
+        if (err == ERR_OK) {
+            const int old_app_id = _app_id;
+            if (!apply_config_response(resp) && old_app_id != resp.app_id) {
+                // a recreated app is watched again once all its partitions are queried
+                ddebug("%s.client: stop watching the partition configurations of the removed "
+                       "app %d, the current app is %d",
+                       _app_name.c_str(),
+                       old_app_id,
+                       resp.app_id);
+                _watching.store(false);
+                return;
+            }
+            // the partitions of a split app are watched with the new partition count
+            watch_config();
+            return;
+        }
+    }
+
+    if (err == ERR_HANDLER_NOT_FOUND || err == ERR_OPERATION_DISABLED ||
+        err == ERR_OBJECT_NOT_FOUND || err == ERR_ACL_DENY) {
+        // not watchable, the next query of all partitions tries again
+        ddebug("%s.client: stop watching the partition configurations, err = %s",
+               _app_name.c_str(),
+               err.to_string());
+        _watching.store(false);
+        return;
+    }
+
+    derror("%s.client: watch partition configurations failed, err = %s",
+           _app_name.c_str(),
+           err.to_string());
+    tasking::enqueue(LPC_REPLICATION_DELAY_QUERY_CONFIG,
+                     &_tracker,
+                     [this]() { watch_config(); },
+                     0,
+                     std::chrono::seconds(1));
+}
+
+void partition_resolver_simple::handle_pending_requests(request_queue &reqs, error_code err)
 {
     for (auto &req : reqs) {
         if (err == ERR_OK) {
@@ -425,9 +554,9 @@ error_code partition_resolver_simple::get_address(int partition_index, /*out*/ r
 {
     // partition_configuration config;
     {
-        zauto_read_lock l(_config_lock);
-        auto it = _config_cache.find(partition_index);
-        if (it != _config_cache.end()) {
+        const config_table &table = get_config_cache();
+        auto it = table.find(partition_index);
+        if (it != table.end()) {
             // config = it->second->config;
             addr = get_address(it->second->config);
             if (addr.is_invalid()) {
@@ -441,6 +570,189 @@ error_code partition_resolver_simple::get_address(int partition_index, /*out*/ r
     }
 }
 
+DEFINE_TASK_CODE(LPC_REPLICATION_HEDGED_READ, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+bool partition_resolver_simple::call_resolved(const rpc_response_task_ptr &task,
+                                              const resolve_result &result)
+{
+    message_ex *request = task->get_request();
+    if (_app_is_stateful && request->read_staleness_bound() > 0 && !request->is_backup_request()) {
+        return call_bounded_staleness_read(task, result);
+    }
+
+    if (!task_spec::get(request->local_rpc_code)->rpc_read_hedging_enabled || !_app_is_stateful ||
+        request->is_backup_request()) {
+        return false;
+    }
+
+    int pidx = result.pid.get_partition_index();
+    rpc_address secondary;
+    {
+        const config_table &table = get_config_cache();
+        auto it = table.find(pidx);
+        if (it == table.end() || it->second->config.secondaries.empty()) {
+            return false;
+        }
+        const auto &secondaries = it->second->config.secondaries;
+        secondary = secondaries[rand::next_u32(0, secondaries.size() - 1)];
+    }
+
+    // no time for the hedged read
+    uint64_t delay_us = get_hedge_delay_us(pidx);
+    if (delay_us >= static_cast<uint64_t>(request->header->client.timeout_ms) * 1000) {
+        return false;
+    }
+
+    hedged_read_context_ptr hc(new hedged_read_context());
+    hc->task = task;
+    hc->partition_index = pidx;
+    hc->secondary = secondary;
+
+    zauto_lock l(hc->lock);
+    send_hedged_read(hc, 0, result.address);
+    hc->hedge_timer = tasking::enqueue(LPC_REPLICATION_HEDGED_READ,
+                                       &_tracker,
+                                       [this, hc]() {
+                                           zauto_lock l(hc->lock);
+                                           hc->hedge_timer = nullptr;
+                                           if (!hc->completed) {
+                                               send_hedged_read(hc, 1, hc->secondary);
+                                           }
+                                       },
+                                       0,
+                                       std::chrono::milliseconds((delay_us + 999) / 1000));
+    return true;
+}
+
+// should be called with hc->lock held
+void partition_resolver_simple::send_hedged_read(const hedged_read_context_ptr &hc,
+                                                 int leg,
+                                                 rpc_address addr)
+{
+    // each request has its own header, which is filled by the rpc engine on sending
+    message_ex *request = hc->task->get_request();
+    message_ex *msg = request->copy(true, false);
+    msg->header->context.u.is_backup_request = (leg == 1);
+
+    uint64_t start_us = dsn_now_us();
+    hc->legs[leg] =
+        rpc::call(addr,
+                  msg,
+                  &_tracker,
+                  [this, hc, leg, start_us](
+                      error_code err, dsn::message_ex *req, dsn::message_ex *resp) {
+                      on_hedged_read_reply(hc, leg, start_us, err, resp);
+                  });
+    hc->outstanding++;
+}
+
+void partition_resolver_simple::on_hedged_read_reply(const hedged_read_context_ptr &hc,
+                                                     int leg,
+                                                     uint64_t start_us,
+                                                     error_code err,
+                                                     dsn::message_ex *response)
+{
+    if (err == ERR_OK) {
+        add_read_latency(hc->partition_index, dsn_now_us() - start_us);
+    }
+
+    rpc_response_task_ptr loser;
+    task_ptr hedge_timer;
+    {
+        zauto_lock l(hc->lock);
+        hc->outstanding--;
+        if (hc->completed) {
+            return;
+        }
+        // wait for the other one if it's still possible to succeed
+        if (err != ERR_OK && hc->outstanding > 0) {
+            return;
+        }
+
+        hc->completed = true;
+        loser = std::move(hc->legs[1 - leg]);
+        hedge_timer = std::move(hc->hedge_timer);
+        hc->legs[0] = nullptr;
+        hc->legs[1] = nullptr;
+    }
+
+    if (hedge_timer != nullptr) {
+        hedge_timer->cancel(false);
+    }
+    if (loser != nullptr) {
+        loser->cancel(false);
+    }
+
+    // the failures are handled (e.g. retried) by the callback of the task
+    hc->task->enqueue(err, response);
+}
+
+bool partition_resolver_simple::call_bounded_staleness_read(const rpc_response_task_ptr &task,
+                                                            const resolve_result &result)
+{
+    // spread the reads over the primary and the secondaries evenly
+    rpc_address target = result.address;
+    {
+        const config_table &table = get_config_cache();
+        auto it = table.find(result.pid.get_partition_index());
+        if (it != table.end()) {
+            const auto &secondaries = it->second->config.secondaries;
+            uint32_t i = rand::next_u32(0, secondaries.size());
+            if (i < secondaries.size()) {
+                target = secondaries[i];
+            }
+        }
+    }
+    if (target == result.address) {
+        return false;
+    }
+
+    // each request has its own header, which is filled by the rpc engine on sending
+    message_ex *msg = task->get_request()->copy(true, false);
+    rpc_address primary = result.address;
+    rpc::call(target,
+              msg,
+              &_tracker,
+              [task, primary](error_code err, dsn::message_ex *req, dsn::message_ex *resp) {
+                  // no time left to retry on the primary if it timed out, the failure is
+                  // handled by the callback of the task
+                  if (err == ERR_OK || err == ERR_TIMEOUT) {
+                      task->enqueue(err, resp);
+                      return;
+                  }
+                  // the secondary is out of the staleness bound, or unavailable
+                  dsn_rpc_call(primary, task.get());
+              });
+    return true;
+}
+
+uint64_t partition_resolver_simple::get_hedge_delay_us(int partition_index) const
+{
+    uint64_t delay_us = FLAGS_hedged_read_default_delay_ms * 1000;
+    {
+        zauto_lock l(_latency_lock);
+        auto it = _read_latencies.find(partition_index);
+        if (it != _read_latencies.end() && it->second.count >= latency_window::capacity / 4) {
+            const latency_window &w = it->second;
+            std::vector<uint64_t> samples(w.samples_us, w.samples_us + w.count);
+            size_t pos = std::min(samples.size() - 1,
+                                  samples.size() * FLAGS_hedged_read_delay_percentile / 100);
+            std::nth_element(samples.begin(), samples.begin() + pos, samples.end());
+            delay_us = samples[pos];
+        }
+    }
+    return std::max(delay_us, static_cast<uint64_t>(FLAGS_hedged_read_min_delay_ms) * 1000);
+}
+
+void partition_resolver_simple::add_read_latency(int partition_index, uint64_t latency_us)
+{
+    zauto_lock l(_latency_lock);
+    latency_window &w = _read_latencies[partition_index];
+    w.samples_us[w.next] = latency_us;
+    w.next = (w.next + 1) % latency_window::capacity;
+    w.count = std::min(w.count + 1, latency_window::capacity);
+}
+
 int partition_resolver_simple::get_partition_index(int partition_count, uint64_t partition_hash)
 {
     return partition_hash % static_cast<uint64_t>(partition_count);
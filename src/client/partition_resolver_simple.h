@@ -31,6 +31,10 @@
 #include <dsn/service_api_c.h>
 #include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
 #include <dsn/dist/replication/partition_resolver.h>
+#include <dsn/utility/published_snapshot.h>
+#include <dsn/utility/slab_allocator.h>
+#include <atomic>
+#include <memory>
 
 namespace dsn {
 namespace replication {
@@ -50,7 +54,13 @@ public:
 
     virtual int get_partition_index(int partition_count, uint64_t partition_hash) override;
 
-    int get_partition_count() const { return _app_partition_count; }
+    int get_partition_count() const override { return _app_partition_count; }
+
+protected:
+    bool call_resolved(const dsn::rpc_response_task_ptr &task,
+                       const resolve_result &result) override;
+
+    void prepare_sessions(dsn::task_code code) override;
 
 private:
     struct partition_info
@@ -58,8 +68,17 @@ private:
         int timeout_count;
         ::dsn::partition_configuration config;
     };
-    mutable dsn::zrwlock_nr _config_lock;
-    std::unordered_map<int, std::unique_ptr<partition_info>> _config_cache;
+    // An immutable table of the partition configurations. The updates build a new table from
+    // the current one and publish it, and resolve() reads the table cached by its thread without
+    // any lock or shared write until it changes. The table returned by get_config_cache() is
+    // only valid until the next call on the same thread, see utils::published_snapshot.
+    typedef std::unordered_map<int, std::shared_ptr<const partition_info>> config_table;
+    const config_table &get_config_cache() const { return _config_cache.get(); }
+    // `update` modifies a copy of the current table, which is published afterwards
+    void update_config_cache(const std::function<void(config_table &)> &update);
+
+    dsn::zlock _config_update_lock; // serializes the updates of _config_cache
+    utils::published_snapshot<config_table> _config_cache;
 
     int _app_id;
     int _app_partition_count;
@@ -80,27 +99,59 @@ private:
         // ]
     };
     typedef ref_ptr<request_context> request_context_ptr;
+    // the requests are queued and drained at high rates while the config is being queried
+    typedef std::deque<request_context_ptr, utils::slab_stl_allocator<request_context_ptr>>
+        request_queue;
 
     struct partition_context
     {
         task_ptr query_config_task;
-        std::deque<request_context_ptr> requests;
+        request_queue requests;
     };
 
     typedef std::unordered_map<int, partition_context *> pending_replica_requests;
 
     mutable zlock _requests_lock;
     pending_replica_requests _pending_requests;
-    std::deque<request_context_ptr> _pending_requests_before_partition_count_unknown;
+    request_queue _pending_requests_before_partition_count_unknown;
     task_ptr _query_config_task;
 
     dsn::task_tracker _tracker;
 
+    // the latencies of the recent successful reads of each partition, from which the delay
+    // of the hedged reads is derived
+    struct latency_window
+    {
+        static const int capacity = 64;
+        uint64_t samples_us[capacity];
+        int count = 0;
+        int next = 0;
+    };
+    mutable zlock _latency_lock;
+    std::unordered_map<int, latency_window> _read_latencies;
+
+    // the context of a read which is sent to the primary, and to a secondary if the primary
+    // doesn't reply within the hedge delay, the first success is the reply of `task`
+    struct hedged_read_context : ref_counter
+    {
+        rpc_response_task_ptr task;
+        int partition_index;
+        rpc_address secondary;
+
+        zlock lock;                   // [
+        bool completed = false;
+        int outstanding = 0;          // the count of the requests not replied yet
+        rpc_response_task_ptr legs[2]; // to the primary and the secondary
+        task_ptr hedge_timer;
+        // ]
+    };
+    typedef ref_ptr<hedged_read_context> hedged_read_context_ptr;
+
 private:
     // local routines
     rpc_address get_address(const partition_configuration &config) const;
     error_code get_address(int partition_index, /*out*/ rpc_address &addr);
-    void handle_pending_requests(std::deque<request_context_ptr> &reqs, error_code err);
+    void handle_pending_requests(request_queue &reqs, error_code err);
     void clear_all_pending_requests();
 
     // with replica
@@ -113,12 +164,39 @@ private:
                      bool called_by_timer = false) const;
     void on_timeout(request_context_ptr &&rc) const;
 
+    // sends a read with a staleness bound to the primary or one of the secondaries, falls back
+    // to the primary if the secondary refuses it
+    bool call_bounded_staleness_read(const rpc_response_task_ptr &task,
+                                     const resolve_result &result);
+
+    // hedged reads
+    uint64_t get_hedge_delay_us(int partition_index) const;
+    void add_read_latency(int partition_index, uint64_t latency_us);
+    void send_hedged_read(const hedged_read_context_ptr &hc, int leg, rpc_address addr);
+    void on_hedged_read_reply(const hedged_read_context_ptr &hc,
+                              int leg,
+                              uint64_t start_us,
+                              error_code err,
+                              dsn::message_ex *response);
+
     // with meta server
     task_ptr query_config(int partition_index, int timeout_ms);
     void query_config_reply(error_code err,
                             dsn::message_ex *request,
                             dsn::message_ex *response,
                             int partition_index);
+    // merges the partitions of the response which are newer than the cached ones, returns false
+    // if the app id or the partition count has changed, then the cache is reset and only holds
+    // the partitions of the response
+    bool apply_config_response(const configuration_query_by_index_response &resp);
+
+    // the configurations of all partitions are watched once they are known, so that the
+    // changes are pushed by the meta server before the accesses fail
+    void watch_config();
+    void watch_config_reply(error_code err, dsn::message_ex *response);
+    std::atomic<bool> _watching{false};
+
+    friend class partition_resolver_simple_test;
 };
 } // namespace replication
 } // namespace dsn
@@ -30,15 +30,18 @@
 #include <netdb.h>
 #include <sys/socket.h>
 
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 
 #include <boost/lexical_cast.hpp>
+#include <dsn/dist/remote_command.h>
 #include <dsn/dist/replication/duplication_common.h>
 #include <dsn/dist/replication/replication_other_types.h>
 #include <dsn/tool-api/group_address.h>
 #include <dsn/utility/error_code.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/output_utils.h>
 #include <fmt/format.h>
 #include <dsn/utils/time_utils.h>
@@ -49,6 +52,22 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("ddl_client",
+                  ddl_client_query_concurrency,
+                  32,
+                  "the max count of the in-flight queries of the partition configurations when "
+                  "the apps are listed in detail");
+DSN_TAG_VARIABLE(ddl_client_query_concurrency, FT_MUTABLE);
+DSN_DEFINE_validator(ddl_client_query_concurrency, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_uint32("ddl_client",
+                  ddl_client_query_timeout_ms,
+                  60000,
+                  "the time budget shared by the queries of the partition configurations when "
+                  "the apps are listed in detail");
+DSN_TAG_VARIABLE(ddl_client_query_timeout_ms, FT_MUTABLE);
+
 using tp_output_format = ::dsn::utils::table_printer::output_format;
 
 replication_ddl_client::replication_ddl_client(const std::vector<dsn::rpc_address> &meta_servers)
@@ -184,6 +203,82 @@ dsn::error_code replication_ddl_client::create_app(const std::string &app_name,
     return error;
 }
 
+dsn::error_code
+replication_ddl_client::create_apps(const std::map<std::string, create_app_options> &apps,
+                                    std::map<std::string, dsn::error_code> &results)
+{
+    results.clear();
+    dsn::error_code first_error = dsn::ERR_OK;
+    auto set_result = [&](const std::string &app_name, dsn::error_code err) {
+        results[app_name] = err;
+        if (first_error == dsn::ERR_OK && err != dsn::ERR_OK) {
+            first_error = err;
+        }
+    };
+
+    // all the requests are sent before any of them is waited, so the apps are created on the
+    // meta server concurrently
+    std::map<std::string, rpc_response_task_ptr> tasks;
+    for (const auto &kv : apps) {
+        const std::string &app_name = kv.first;
+        const create_app_options &options = kv.second;
+        if (options.partition_count < 1 || options.replica_count < 2 || app_name.empty() ||
+            !std::all_of(app_name.cbegin(),
+                         app_name.cend(),
+                         (bool (*)(int))replication_ddl_client::valid_app_char) ||
+            options.app_type.empty() ||
+            !std::all_of(options.app_type.cbegin(),
+                         options.app_type.cend(),
+                         (bool (*)(int))replication_ddl_client::valid_app_char)) {
+            std::cout << "create app " << app_name << " failed: invalid parameters" << std::endl;
+            set_result(app_name, ERR_INVALID_PARAMETERS);
+            continue;
+        }
+
+        std::shared_ptr<configuration_create_app_request> req(
+            new configuration_create_app_request());
+        req->app_name = app_name;
+        req->options = options;
+        req->options.success_if_exist = true;
+        tasks.emplace(app_name,
+                      request_meta<configuration_create_app_request>(RPC_CM_CREATE_APP, req));
+    }
+
+    std::vector<std::string> created;
+    for (auto &kv : tasks) {
+        const std::string &app_name = kv.first;
+        kv.second->wait();
+        if (kv.second->error() != dsn::ERR_OK) {
+            std::cout << "create app " << app_name
+                      << " failed: [create] call server error: " << kv.second->error().to_string()
+                      << std::endl;
+            set_result(app_name, kv.second->error());
+            continue;
+        }
+
+        dsn::replication::configuration_create_app_response resp;
+        ::dsn::unmarshall(kv.second->get_response(), resp);
+        if (resp.err != dsn::ERR_OK) {
+            std::cout << "create app " << app_name
+                      << " failed: [create] received server error: " << resp.err.to_string()
+                      << std::endl;
+            set_result(app_name, resp.err);
+            continue;
+        }
+        std::cout << "create app " << app_name << " succeed, waiting for app ready" << std::endl;
+        created.emplace_back(app_name);
+    }
+
+    // the apps are getting ready on the meta server concurrently, so waiting for them one by
+    // one takes about the time of the slowest one
+    for (const std::string &app_name : created) {
+        const create_app_options &options = apps.at(app_name);
+        set_result(app_name,
+                   wait_app_ready(app_name, options.partition_count, options.replica_count));
+    }
+    return first_error;
+}
+
 dsn::error_code replication_ddl_client::drop_app(const std::string &app_name, int reserve_seconds)
 {
     if (app_name.empty() ||
@@ -369,18 +464,29 @@ dsn::error_code replication_ddl_client::list_apps(const dsn::app_status::type st
         tp_health.add_column("unhealthy");
         tp_health.add_column("write_unhealthy");
         tp_health.add_column("read_unhealthy");
+
+        std::vector<std::string> app_names;
+        for (const auto &info : apps) {
+            if (info.status == app_status::AS_AVAILABLE) {
+                app_names.emplace_back(info.app_name);
+            }
+        }
+        std::map<std::string, app_partitions> apps_partitions;
+        list_apps_partitions(app_names, apps_partitions);
+
         for (auto &info : apps) {
             if (info.status != app_status::AS_AVAILABLE) {
                 continue;
             }
-            int32_t app_id;
-            int32_t partition_count;
-            std::vector<partition_configuration> partitions;
-            r = list_app(info.app_name, app_id, partition_count, partitions);
+            const app_partitions &result = apps_partitions[info.app_name];
+            r = result.err;
             if (r != dsn::ERR_OK) {
                 derror("list app(%s) failed, err = %s", info.app_name.c_str(), r.to_string());
                 return r;
             }
+            int32_t app_id = result.app_id;
+            int32_t partition_count = result.partition_count;
+            const std::vector<partition_configuration> &partitions = result.partitions;
             dassert(info.app_id == app_id, "invalid app_id, %d VS %d", info.app_id, app_id);
             dassert(info.partition_count == partition_count,
                     "invalid partition_count, %d VS %d",
@@ -519,15 +625,18 @@ dsn::error_code replication_ddl_client::list_nodes(const dsn::replication::node_
             return r;
         }
 
-        for (auto &app : apps) {
-            int32_t app_id;
-            int32_t partition_count;
-            std::vector<partition_configuration> partitions;
-            r = list_app(app.app_name, app_id, partition_count, partitions);
-            if (r != dsn::ERR_OK) {
-                return r;
-            }
+        std::vector<std::string> app_names;
+        for (const auto &app : apps) {
+            app_names.emplace_back(app.app_name);
+        }
+        std::map<std::string, app_partitions> apps_partitions;
+        r = list_apps_partitions(app_names, apps_partitions);
+        if (r != dsn::ERR_OK) {
+            return r;
+        }
 
+        for (const auto &kv : apps_partitions) {
+            const std::vector<partition_configuration> &partitions = kv.second.partitions;
             for (int i = 0; i < partitions.size(); i++) {
                 const dsn::partition_configuration &p = partitions[i];
                 if (!p.primary.is_invalid()) {
@@ -589,6 +698,70 @@ dsn::error_code replication_ddl_client::list_nodes(const dsn::replication::node_
 #undef RESOLVE
 }
 
+dsn::error_code
+replication_ddl_client::remote_command_fanout(const std::vector<dsn::rpc_address> &nodes,
+                                              const std::string &cmd,
+                                              const std::vector<std::string> &arguments,
+                                              uint32_t concurrency,
+                                              int64_t timeout_ms,
+                                              bool json,
+                                              const std::string &file_name)
+{
+    std::vector<dsn::rpc_address> targets = nodes;
+    if (targets.empty()) {
+        std::map<dsn::rpc_address, dsn::replication::node_status::type> alive_nodes;
+        dsn::error_code err = list_nodes(node_status::NS_ALIVE, alive_nodes);
+        if (err != dsn::ERR_OK) {
+            return err;
+        }
+        for (const auto &kv : alive_nodes) {
+            targets.push_back(kv.first);
+        }
+    }
+
+    std::vector<dist::cmd::remote_command_result> results = dist::cmd::call_remote_fanout(
+        targets, cmd, arguments, concurrency, std::chrono::milliseconds(timeout_ms));
+
+    std::streambuf *buf;
+    std::ofstream of;
+    if (!file_name.empty()) {
+        of.open(file_name);
+        buf = of.rdbuf();
+    } else {
+        buf = std::cout.rdbuf();
+    }
+    std::ostream out(buf);
+
+    if (json) {
+        out << dist::cmd::merge_remote_command_results(results, true) << std::endl;
+        return dsn::ERR_OK;
+    }
+
+    dsn::utils::table_printer tp;
+    tp.add_title("node");
+    tp.add_column("error");
+    tp.add_column("output");
+    size_t failed_count = 0;
+    for (const auto &result : results) {
+        tp.add_row(result.node.to_std_string());
+        tp.append_data(result.err.to_string());
+        tp.append_data(result.output);
+        if (result.err != dsn::ERR_OK) {
+            ++failed_count;
+        }
+    }
+    tp.output(out);
+    out << std::endl;
+
+    dsn::utils::table_printer tp_count;
+    tp_count.add_row_name_and_data("total_node_count", results.size());
+    tp_count.add_row_name_and_data("failed_node_count", failed_count);
+    tp_count.output(out);
+    out << std::endl;
+
+    return dsn::ERR_OK;
+}
+
 dsn::error_code replication_ddl_client::cluster_name(int64_t timeout_ms, std::string &cluster_name)
 {
     std::shared_ptr<configuration_cluster_info_request> req(
@@ -816,6 +989,15 @@ dsn::error_code replication_ddl_client::list_app(const std::string &app_name,
         RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX, req);
 
     resp_task->wait();
+    return parse_partitions(resp_task, app_id, partition_count, partitions);
+}
+
+dsn::error_code
+replication_ddl_client::parse_partitions(const rpc_response_task_ptr &resp_task,
+                                         int32_t &app_id,
+                                         int32_t &partition_count,
+                                         std::vector<partition_configuration> &partitions)
+{
     if (resp_task->error() != dsn::ERR_OK) {
         return resp_task->error();
     }
@@ -828,11 +1010,71 @@ dsn::error_code replication_ddl_client::list_app(const std::string &app_name,
 
     app_id = resp.app_id;
     partition_count = resp.partition_count;
-    partitions = resp.partitions;
+    partitions = std::move(resp.partitions);
 
     return dsn::ERR_OK;
 }
 
+dsn::error_code
+replication_ddl_client::list_apps_partitions(const std::vector<std::string> &app_names,
+                                             std::map<std::string, app_partitions> &results)
+{
+    results.clear();
+    const uint64_t deadline_ms = dsn_now_ms() + FLAGS_ddl_client_query_timeout_ms;
+    auto remaining_ms = [deadline_ms]() -> int {
+        uint64_t now_ms = dsn_now_ms();
+        return now_ms >= deadline_ms ? 0 : static_cast<int>(deadline_ms - now_ms);
+    };
+
+    dsn::error_code first_error = dsn::ERR_OK;
+    auto set_result = [&](const std::string &app_name, app_partitions &&result) {
+        if (first_error == dsn::ERR_OK && result.err != dsn::ERR_OK) {
+            first_error = result.err;
+        }
+        results[app_name] = std::move(result);
+    };
+
+    // a sliding window of the in-flight queries, the oldest one is waited for before the next
+    // one is sent
+    std::deque<std::pair<std::string, rpc_response_task_ptr>> inflight;
+    auto wait_oldest = [&]() {
+        app_partitions result;
+        rpc_response_task_ptr &resp_task = inflight.front().second;
+        if (resp_task->wait(remaining_ms())) {
+            result.err = parse_partitions(
+                resp_task, result.app_id, result.partition_count, result.partitions);
+        } else {
+            result.err = dsn::ERR_TIMEOUT;
+        }
+        set_result(inflight.front().first, std::move(result));
+        inflight.pop_front();
+    };
+
+    for (const std::string &app_name : app_names) {
+        int timeout_ms = remaining_ms();
+        if (timeout_ms == 0) {
+            app_partitions result;
+            result.err = dsn::ERR_TIMEOUT;
+            set_result(app_name, std::move(result));
+            continue;
+        }
+
+        std::shared_ptr<configuration_query_by_index_request> req(
+            new configuration_query_by_index_request());
+        req->app_name = app_name;
+        inflight.emplace_back(app_name,
+                              request_meta<configuration_query_by_index_request>(
+                                  RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX, req, timeout_ms));
+        if (inflight.size() >= FLAGS_ddl_client_query_concurrency) {
+            wait_oldest();
+        }
+    }
+    while (!inflight.empty()) {
+        wait_oldest();
+    }
+    return first_error;
+}
+
 dsn::replication::configuration_meta_control_response
 replication_ddl_client::control_meta_function_level(meta_function_level::type level)
 {
@@ -947,7 +1189,8 @@ dsn::error_code replication_ddl_client::do_restore(const std::string &backup_pro
                                                    int32_t old_app_id,
                                                    const std::string &new_app_name,
                                                    bool skip_bad_partition,
-                                                   const std::string &restore_path)
+                                                   const std::string &restore_path,
+                                                   int32_t cold_tier_cache_mb)
 {
     if (old_app_name.empty() ||
         !std::all_of(old_app_name.cbegin(),
@@ -980,6 +1223,11 @@ dsn::error_code replication_ddl_client::do_restore(const std::string &backup_pro
         req->__set_restore_path(restore_path);
         std::cout << "restore app from the specified path : " << restore_path << std::endl;
     }
+    if (cold_tier_cache_mb > 0) {
+        req->__set_cold_tier_cache_mb(cold_tier_cache_mb);
+        std::cout << "restore app in cold-tier mode with a cache of " << cold_tier_cache_mb
+                  << " MB" << std::endl;
+    }
 
     auto resp_task = request_meta<configuration_restore_request>(RPC_CM_START_RESTORE, req);
     bool finish = false;
@@ -1468,6 +1716,46 @@ replication_ddl_client::set_app_envs(const std::string &app_name,
     return call_rpc_sync(update_app_env_rpc(std::move(req), RPC_CM_UPDATE_APP_ENV));
 }
 
+dsn::error_code
+replication_ddl_client::set_apps_envs(const std::vector<std::string> &app_names,
+                                      const std::vector<std::string> &keys,
+                                      const std::vector<std::string> &values,
+                                      std::map<std::string, dsn::error_code> &results)
+{
+    std::map<std::string, rpc_response_task_ptr> tasks;
+    for (const std::string &app_name : app_names) {
+        auto req = std::make_shared<configuration_update_app_env_request>();
+        req->__set_app_name(app_name);
+        req->__set_keys(keys);
+        req->__set_values(values);
+        req->__set_op(app_env_operation::type::APP_ENV_OP_SET);
+        tasks.emplace(app_name,
+                      request_meta<configuration_update_app_env_request>(RPC_CM_UPDATE_APP_ENV,
+                                                                          req));
+    }
+
+    results.clear();
+    dsn::error_code first_error = dsn::ERR_OK;
+    for (auto &kv : tasks) {
+        kv.second->wait();
+        dsn::error_code err = kv.second->error();
+        if (err == dsn::ERR_OK) {
+            configuration_update_app_env_response response;
+            ::dsn::unmarshall(kv.second->get_response(), response);
+            err = response.err;
+        }
+        if (err != dsn::ERR_OK) {
+            std::cout << "set app envs of " << kv.first << " failed: " << err.to_string()
+                      << std::endl;
+            if (first_error == dsn::ERR_OK) {
+                first_error = err;
+            }
+        }
+        results[kv.first] = err;
+    }
+    return first_error;
+}
+
 ::dsn::error_code replication_ddl_client::del_app_envs(const std::string &app_name,
                                                        const std::vector<std::string> &keys)
 {
@@ -1578,13 +1866,15 @@ error_with<start_bulk_load_response>
 replication_ddl_client::start_bulk_load(const std::string &app_name,
                                         const std::string &cluster_name,
                                         const std::string &file_provider_type,
-                                        const std::string &remote_root_path)
+                                        const std::string &remote_root_path,
+                                        bool non_blocking_ingestion)
 {
     auto req = make_unique<start_bulk_load_request>();
     req->app_name = app_name;
     req->cluster_name = cluster_name;
     req->file_provider_type = file_provider_type;
     req->remote_root_path = remote_root_path;
+    req->__set_non_blocking_ingestion(non_blocking_ingestion);
     return call_rpc_sync(start_bulk_load_rpc(std::move(req), RPC_CM_START_BULK_LOAD));
 }
 
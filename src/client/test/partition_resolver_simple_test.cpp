@@ -0,0 +1,377 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/dist/replication/replication.codes.h>
+
+#include "client/partition_resolver_simple.h"
+
+namespace dsn {
+namespace replication {
+
+DEFINE_TASK_CODE(LPC_HEDGED_READ_TEST_TIMER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class partition_resolver_simple_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _resolver = new partition_resolver_simple(rpc_address("127.0.0.1", 34601), "test_app");
+    }
+
+    void TearDown() override { _resolver = nullptr; }
+
+    static configuration_query_by_index_response make_response(int32_t app_id,
+                                                               int32_t partition_count,
+                                                               int64_t ballot,
+                                                               const std::vector<int> &indexes)
+    {
+        configuration_query_by_index_response resp;
+        resp.err = ERR_OK;
+        resp.app_id = app_id;
+        resp.partition_count = partition_count;
+        resp.is_stateful = true;
+        for (int index : indexes) {
+            partition_configuration pc;
+            pc.pid = gpid(app_id, index);
+            pc.ballot = ballot;
+            pc.primary = rpc_address("127.0.0.1", 34801);
+            resp.partitions.emplace_back(std::move(pc));
+        }
+        return resp;
+    }
+
+    static configuration_query_by_index_response make_response(int32_t app_id,
+                                                               int32_t partition_count,
+                                                               int64_t ballot)
+    {
+        std::vector<int> indexes;
+        for (int i = 0; i < partition_count; ++i) {
+            indexes.push_back(i);
+        }
+        return make_response(app_id, partition_count, ballot, indexes);
+    }
+
+    bool apply(const configuration_query_by_index_response &resp)
+    {
+        return _resolver->apply_config_response(resp);
+    }
+
+    // replies the watch with `resp` as if it came from the meta server
+    void watch_reply(const configuration_query_by_index_response &resp)
+    {
+        message_ex *request = message_ex::create_request(RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX);
+        message_ex *response = request->create_response();
+        marshall(response, resp);
+        message_ex *received = response->copy(true, true);
+        received->add_ref();
+        _resolver->watch_config_reply(ERR_OK, received);
+        received->release_ref();
+
+        // release the messages whose references are 0
+        response->add_ref();
+        response->release_ref();
+        request->add_ref();
+        request->release_ref();
+    }
+
+    // -1 if the partition isn't cached
+    int64_t cached_ballot(int partition_index) const
+    {
+        const auto &table = _resolver->get_config_cache();
+        auto iter = table.find(partition_index);
+        return iter == table.end() ? -1 : iter->second->config.ballot;
+    }
+
+    size_t cached_count() const { return _resolver->get_config_cache().size(); }
+    int32_t app_id() const { return _resolver->_app_id; }
+    int partition_count() const { return _resolver->get_partition_count(); }
+    bool is_watching() const { return _resolver->_watching.load(); }
+    void set_watching(bool watching) { _resolver->_watching.store(watching); }
+
+    typedef partition_resolver_simple::hedged_read_context_ptr hedged_read_context_ptr;
+
+    // a read of partition 0 sent to the primary as leg 0, and to a secondary as leg 1 if
+    // `hedged`, otherwise the hedge timer is still pending
+    hedged_read_context_ptr make_hedged_read(bool hedged)
+    {
+        message_ex *request = message_ex::create_request(RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX);
+        hedged_read_context_ptr hc(new partition_resolver_simple::hedged_read_context());
+        hc->task = rpc::create_rpc_response_task(
+            request, nullptr, [this](error_code err, message_ex *req, message_ex *resp) {
+                _reply_err = err;
+                ++_reply_count;
+            });
+        hc->partition_index = 0;
+        for (int leg = 0; leg < (hedged ? 2 : 1); ++leg) {
+            hc->legs[leg] = rpc::create_rpc_response_task(
+                request->copy(true, false),
+                nullptr,
+                [](error_code err, message_ex *req, message_ex *resp) {});
+            hc->outstanding++;
+        }
+        if (!hedged) {
+            hc->hedge_timer = tasking::create_task(LPC_HEDGED_READ_TEST_TIMER, nullptr, []() {});
+        }
+        return hc;
+    }
+
+    void hedged_read_reply(const hedged_read_context_ptr &hc, int leg, error_code err)
+    {
+        _resolver->on_hedged_read_reply(hc, leg, dsn_now_us(), err, nullptr);
+    }
+
+    int read_latency_count(int partition_index)
+    {
+        zauto_lock l(_resolver->_latency_lock);
+        return _resolver->_read_latencies[partition_index].count;
+    }
+
+    dsn::ref_ptr<partition_resolver_simple> _resolver;
+
+    std::atomic<int> _reply_count{0};
+    error_code _reply_err;
+};
+
+TEST_F(partition_resolver_simple_test, apply_newer_config)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+    ASSERT_EQ(4, cached_count());
+    ASSERT_EQ(1, app_id());
+    ASSERT_EQ(4, partition_count());
+
+    // only the newer ballots are taken
+    ASSERT_TRUE(apply(make_response(1, 4, 5, {1})));
+    ASSERT_TRUE(apply(make_response(1, 4, 2, {2})));
+    ASSERT_EQ(3, cached_ballot(0));
+    ASSERT_EQ(5, cached_ballot(1));
+    ASSERT_EQ(3, cached_ballot(2));
+    ASSERT_EQ(4, cached_count());
+}
+
+TEST_F(partition_resolver_simple_test, apply_config_of_split_app)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+
+    // the cache is reset to the partitions of the split app
+    ASSERT_FALSE(apply(make_response(1, 8, 4, {0, 5})));
+    ASSERT_EQ(8, partition_count());
+    ASSERT_EQ(2, cached_count());
+    ASSERT_EQ(4, cached_ballot(0));
+    ASSERT_EQ(-1, cached_ballot(1));
+    ASSERT_EQ(4, cached_ballot(5));
+}
+
+TEST_F(partition_resolver_simple_test, apply_config_of_recreated_app)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+
+    // the ballots of the new app start over, which are taken as well
+    ASSERT_FALSE(apply(make_response(2, 4, 1)));
+    ASSERT_EQ(2, app_id());
+    ASSERT_EQ(4, cached_count());
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(1, cached_ballot(i));
+    }
+}
+
+TEST_F(partition_resolver_simple_test, watch_reply_newer_config)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+    set_watching(true);
+
+    watch_reply(make_response(1, 4, 5, {2}));
+    ASSERT_EQ(5, cached_ballot(2));
+    ASSERT_EQ(3, cached_ballot(3));
+    // watched again
+    ASSERT_TRUE(is_watching());
+
+    // an expired watch is replied with no partition
+    watch_reply(make_response(1, 4, 0, {}));
+    ASSERT_EQ(4, cached_count());
+    ASSERT_TRUE(is_watching());
+}
+
+TEST_F(partition_resolver_simple_test, watch_reply_split_app)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+    set_watching(true);
+
+    watch_reply(make_response(1, 8, 4));
+    ASSERT_EQ(8, partition_count());
+    ASSERT_EQ(8, cached_count());
+    // the split app is watched with the new partition count
+    ASSERT_TRUE(is_watching());
+}
+
+TEST_F(partition_resolver_simple_test, watch_reply_recreated_app)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+    set_watching(true);
+
+    watch_reply(make_response(2, 8, 1));
+    ASSERT_EQ(2, app_id());
+    ASSERT_EQ(8, partition_count());
+    ASSERT_EQ(8, cached_count());
+    // watched again after the next query of all partitions
+    ASSERT_FALSE(is_watching());
+}
+
+TEST_F(partition_resolver_simple_test, watch_reply_not_watchable)
+{
+    ASSERT_TRUE(apply(make_response(1, 4, 3)));
+    set_watching(true);
+
+    auto resp = make_response(1, 4, 5, {0});
+    resp.err = ERR_HANDLER_NOT_FOUND;
+    watch_reply(resp);
+    ASSERT_FALSE(is_watching());
+    ASSERT_EQ(3, cached_ballot(0));
+}
+
+TEST_F(partition_resolver_simple_test, hedged_read_primary_wins)
+{
+    auto hc = make_hedged_read(true);
+    rpc_response_task_ptr secondary_leg = hc->legs[1];
+
+    hedged_read_reply(hc, 0, ERR_OK);
+    hc->task->wait();
+    ASSERT_EQ(1, _reply_count.load());
+    ASSERT_EQ(ERR_OK, _reply_err);
+    // the request to the secondary is cancelled
+    ASSERT_EQ(TASK_STATE_CANCELLED, secondary_leg->state());
+    ASSERT_EQ(nullptr, hc->legs[1].get());
+    ASSERT_EQ(1, read_latency_count(0));
+}
+
+TEST_F(partition_resolver_simple_test, hedged_read_secondary_wins)
+{
+    auto hc = make_hedged_read(true);
+    rpc_response_task_ptr primary_leg = hc->legs[0];
+
+    hedged_read_reply(hc, 1, ERR_OK);
+    hc->task->wait();
+    ASSERT_EQ(1, _reply_count.load());
+    ASSERT_EQ(ERR_OK, _reply_err);
+    ASSERT_EQ(TASK_STATE_CANCELLED, primary_leg->state());
+    ASSERT_EQ(nullptr, hc->legs[0].get());
+}
+
+TEST_F(partition_resolver_simple_test, hedged_read_both_fail)
+{
+    auto hc = make_hedged_read(true);
+
+    // the reply waits for the other request which may still succeed
+    hedged_read_reply(hc, 1, ERR_TIMEOUT);
+    ASSERT_FALSE(hc->completed);
+    ASSERT_EQ(TASK_STATE_READY, hc->task->state());
+
+    // the last failure is replied, and handled by the callback of the task
+    hedged_read_reply(hc, 0, ERR_NETWORK_FAILURE);
+    hc->task->wait();
+    ASSERT_EQ(1, _reply_count.load());
+    ASSERT_EQ(ERR_NETWORK_FAILURE, _reply_err);
+    ASSERT_EQ(0, read_latency_count(0));
+
+    // the primary fails before the hedged read is sent, which is sent no more
+    _reply_count.store(0);
+    hc = make_hedged_read(false);
+    task_ptr hedge_timer = hc->hedge_timer;
+    hedged_read_reply(hc, 0, ERR_TIMEOUT);
+    hc->task->wait();
+    ASSERT_EQ(1, _reply_count.load());
+    ASSERT_EQ(ERR_TIMEOUT, _reply_err);
+    ASSERT_EQ(TASK_STATE_CANCELLED, hedge_timer->state());
+}
+
+TEST_F(partition_resolver_simple_test, hedged_read_late_loser)
+{
+    auto hc = make_hedged_read(true);
+    hedged_read_reply(hc, 0, ERR_OK);
+    hc->task->wait();
+    ASSERT_EQ(1, _reply_count.load());
+
+    // the loser replies after the callback has run, which is ignored except for its latency
+    hedged_read_reply(hc, 1, ERR_OK);
+    ASSERT_EQ(0, hc->outstanding);
+    ASSERT_EQ(1, _reply_count.load());
+    ASSERT_EQ(ERR_OK, _reply_err);
+    ASSERT_EQ(2, read_latency_count(0));
+
+    auto failed = make_hedged_read(true);
+    hedged_read_reply(failed, 1, ERR_OK);
+    failed->task->wait();
+    hedged_read_reply(failed, 0, ERR_TIMEOUT);
+    ASSERT_EQ(2, _reply_count.load());
+    ASSERT_EQ(ERR_OK, _reply_err);
+}
+
+TEST_F(partition_resolver_simple_test, concurrent_read_and_update)
+{
+    const int partition_count = 8;
+    ASSERT_TRUE(apply(make_response(1, partition_count, 1)));
+
+    // each update raises the ballots of all the partitions together, so a reader must never see
+    // a table with different ballots, or a table older than the one it saw before
+    std::atomic<bool> stopped(false);
+    std::atomic<int> bad_reads(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            int64_t last_ballot = 0;
+            while (!stopped.load()) {
+                const auto &table = _resolver->get_config_cache();
+                if (table.size() != static_cast<size_t>(partition_count)) {
+                    ++bad_reads;
+                    continue;
+                }
+                const int64_t ballot = table.begin()->second->config.ballot;
+                for (const auto &kv : table) {
+                    if (kv.second->config.ballot != ballot) {
+                        ++bad_reads;
+                    }
+                }
+                if (ballot < last_ballot) {
+                    ++bad_reads;
+                }
+                last_ballot = ballot;
+            }
+        });
+    }
+
+    const int64_t max_ballot = 2000;
+    for (int64_t ballot = 2; ballot <= max_ballot; ++ballot) {
+        EXPECT_TRUE(apply(make_response(1, partition_count, ballot)));
+    }
+    stopped.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQ(0, bad_reads.load());
+    for (int i = 0; i < partition_count; ++i) {
+        ASSERT_EQ(max_ballot, cached_ballot(i));
+    }
+}
+
+} // namespace replication
+} // namespace dsn
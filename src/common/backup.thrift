@@ -38,6 +38,9 @@ struct configuration_restore_request
     7:string            backup_provider_name;
     8:bool              skip_bad_partition;
     9:optional string   restore_path;
+    // restore in the cold-tier mode: the data files are left on the block service, and
+    // downloaded into a local cache of this size when they are read
+    10:optional i32     cold_tier_cache_mb;
 }
 
 struct backup_request
@@ -48,6 +51,9 @@ struct backup_request
     4:i64                   backup_id;
     // user specified backup_path.
     5:optional string       backup_path;
+    // set for an incremental backup, the files unchanged since this backup are referenced
+    // instead of being uploaded again.
+    6:optional i64          prev_backup_id;
 }
 
 struct backup_response
@@ -56,6 +56,10 @@ struct start_bulk_load_request
     2:string    cluster_name;
     3:string    file_provider_type;
     4:string    remote_root_path;
+    // if true, the writes are not rejected while the downloaded files are being ingested, the
+    // ingestion mutation only marks the point after which the writes take precedence over the
+    // ingested data, see `ingestion_request.non_blocking_ingestion`
+    5:optional bool non_blocking_ingestion = false;
 }
 
 struct start_bulk_load_response
@@ -95,6 +99,7 @@ struct bulk_load_request
     7:bulk_load_status  meta_bulk_load_status;
     8:bool              query_bulk_load_metadata;
     9:string            remote_root_path;
+    10:optional bool    non_blocking_ingestion = false;
 }
 
 struct bulk_load_response
@@ -150,6 +155,10 @@ struct ingestion_request
 {
     1:string                app_name;
     2:bulk_load_metadata    metadata;
+    // if true, the app ingests the files in the background against the snapshot of the ingestion
+    // mutation (e.g. behind the existing data), while the later mutations keep being applied and
+    // take precedence over the ingested data
+    3:optional bool         non_blocking_ingestion = false;
 }
 
 struct ingestion_response
@@ -114,6 +114,9 @@ struct prepare_ack
     4:i64                 decree;
     5:i64                 last_committed_decree_in_app;
     6:i64                 last_committed_decree_in_prepare_list;
+    // set by a cumulative ack of a secondary: all the prepares up to this decree are logged on
+    // it, and the ones whose replies are omitted are acked by this one
+    7:optional i64        last_logged_decree;
 }
 
 enum learn_type
@@ -158,6 +161,10 @@ struct learn_request
     // be duplicated (ie. max_gced_decree < confirmed_decree), if not,
     // learnee will copy the missing logs.
     7:optional i64        max_gced_decree;
+
+    // The learner's local files (relative to its data dir) which can be reused by LT_APP if
+    // their md5 match.
+    8:optional list<metadata.file_meta> checkpoint_files;
 }
 
 struct learn_response
@@ -170,6 +177,15 @@ struct learn_response
     6:learn_state           state; // learning data, including memory data and files
     7:dsn.rpc_address       address; // learnee's address
     8:string                base_local_dir; // base dir of files on learnee
+    9:optional learn_state  log_state; // private logs following the checkpoint of LT_APP
+    10:optional string      log_base_local_dir; // base dir of log_state.files on learnee
+    // checkpoint files (relative to base_local_dir) which are not copied but linked from the
+    // learner's local ones (relative to its data dir)
+    11:optional map<string, string> reused_files;
+    // the count of the replicas serving the partition (primary and secondaries) and the
+    // max_replica_count at the learnee, by which the learns of app are scheduled on the learner
+    12:optional i32         replica_count;
+    13:optional i32         max_replica_count;
 }
 
 struct learn_notify_response
@@ -210,3 +226,16 @@ struct group_check_response
     8:optional bool       is_split_stopped;
 }
 
+// The group checks from all the primaries on one node to the same remote node.
+struct group_check_batch_request
+{
+    1:list<group_check_request> requests;
+}
+
+// The responses in the same order as group_check_batch_request.requests, it is empty if
+// the remote node didn't handle the checks.
+struct group_check_batch_response
+{
+    1:list<group_check_response> responses;
+}
+
@@ -38,10 +38,156 @@
 #include <thread>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_string("replication",
+                  disk_selection_policy,
+                  "replica_count",
+                  "the policy to select the data dir for a new replica, "
+                  "could be 'replica_count' or 'load_aware'");
+DSN_DEFINE_validator(disk_selection_policy, [](const char *value) -> bool {
+    return dir_selection_policy::create(value) != nullptr;
+});
+DSN_DEFINE_double("replication",
+                  disk_selection_load_weight,
+                  2.0,
+                  "the weight of the io utilization and the write throughput of a disk in the "
+                  "'load_aware' disk selection policy, counted in replicas of the app");
+DSN_DEFINE_double("replication",
+                  disk_selection_space_weight,
+                  1.0,
+                  "the weight of the used space ratio of a disk in the 'load_aware' disk "
+                  "selection policy, counted in replicas of the app");
+DSN_DEFINE_uint32("replication",
+                  disk_selection_min_available_ratio,
+                  10,
+                  "the disks with less available space ratio(%) are not selected for new "
+                  "replicas by the 'load_aware' disk selection policy, unless all of them are");
+
+namespace {
+
+// read the io ticks and the written sectors of the block device holding `dir`
+bool get_block_device_stat(const std::string &dir,
+                           /*out*/ uint64_t &io_ticks_ms,
+                           /*out*/ uint64_t &write_sectors)
+{
+    struct stat st;
+    if (::stat(dir.c_str(), &st) != 0) {
+        return false;
+    }
+
+    // see Documentation/block/stat.txt of the linux kernel for the fields
+    std::ifstream is(fmt::format("/sys/dev/block/{}:{}/stat", major(st.st_dev), minor(st.st_dev)));
+    uint64_t fields[10];
+    for (uint64_t &f : fields) {
+        if (!(is >> f)) {
+            return false;
+        }
+    }
+    write_sectors = fields[6];
+    io_ticks_ms = fields[9];
+    return true;
+}
+
+class replica_count_dir_selection_policy : public dir_selection_policy
+{
+public:
+    dir_node *select(const std::vector<std::shared_ptr<dir_node>> &nodes,
+                     app_id id) const override
+    {
+        dir_node *selected = nullptr;
+        unsigned least_app_replicas_count = 0;
+        unsigned least_total_replicas_count = 0;
+        for (auto &n : nodes) {
+            unsigned app_replicas = n->replicas_count(id);
+            unsigned total_replicas = n->replicas_count();
+
+            if (selected == nullptr || least_app_replicas_count > app_replicas) {
+                least_app_replicas_count = app_replicas;
+                least_total_replicas_count = total_replicas;
+                selected = n.get();
+            } else if (least_app_replicas_count == app_replicas &&
+                       least_total_replicas_count > total_replicas) {
+                least_total_replicas_count = total_replicas;
+                selected = n.get();
+            }
+        }
+        return selected;
+    }
+};
+
+class load_aware_dir_selection_policy : public dir_selection_policy
+{
+public:
+    dir_node *select(const std::vector<std::shared_ptr<dir_node>> &nodes,
+                     app_id id) const override
+    {
+        bool has_spacious_disk = false;
+        int64_t max_write_bytes_per_sec = 0;
+        for (auto &n : nodes) {
+            has_spacious_disk |= !is_nearly_full(*n);
+            max_write_bytes_per_sec = std::max(max_write_bytes_per_sec, n->write_bytes_per_sec);
+        }
+
+        dir_node *selected = nullptr;
+        double least_score = 0;
+        unsigned least_total_replicas_count = 0;
+        for (auto &n : nodes) {
+            if (has_spacious_disk && is_nearly_full(*n)) {
+                continue;
+            }
+
+            // the load terms are in [0, 1], so the weights tell how many replicas of the app
+            // a full loaded disk is worth
+            double load = n->io_util_percent / 100.0;
+            if (max_write_bytes_per_sec > 0) {
+                load = (load + n->write_bytes_per_sec * 1.0 / max_write_bytes_per_sec) / 2;
+            }
+            double used = n->disk_capacity_mb > 0 ? (100 - n->disk_available_ratio) / 100.0 : 0;
+            double score = n->replicas_count(id) + load * FLAGS_disk_selection_load_weight +
+                           used * FLAGS_disk_selection_space_weight;
+            unsigned total_replicas = n->replicas_count();
+
+            if (selected == nullptr || least_score > score ||
+                (least_score == score && least_total_replicas_count > total_replicas)) {
+                least_score = score;
+                least_total_replicas_count = total_replicas;
+                selected = n.get();
+            }
+        }
+        return selected;
+    }
+
+private:
+    static bool is_nearly_full(const dir_node &n)
+    {
+        // no space info yet
+        return n.disk_capacity_mb > 0 &&
+               n.disk_available_ratio < static_cast<int>(FLAGS_disk_selection_min_available_ratio);
+    }
+};
+
+} // anonymous namespace
+
+/*static*/ std::unique_ptr<dir_selection_policy>
+dir_selection_policy::create(const std::string &name)
+{
+    if (name == "replica_count") {
+        return make_unique<replica_count_dir_selection_policy>();
+    }
+    if (name == "load_aware") {
+        return make_unique<load_aware_dir_selection_policy>();
+    }
+    return nullptr;
+}
+
 unsigned dir_node::replicas_count() const
 {
     unsigned sum = 0;
@@ -93,9 +239,30 @@ void dir_node::update_disk_stat()
     } else {
         derror_f("update disk space failed: dir = {}", full_dir);
     }
+
+    uint64_t io_ticks_ms = 0;
+    uint64_t write_sectors = 0;
+    if (get_block_device_stat(full_dir, io_ticks_ms, write_sectors)) {
+        uint64_t now_ms = dsn_now_ms();
+        if (last_io_stat_time_ms != 0 && now_ms > last_io_stat_time_ms) {
+            uint64_t elapsed_ms = now_ms - last_io_stat_time_ms;
+            io_util_percent = static_cast<int>(
+                std::min<uint64_t>(100, (io_ticks_ms - last_io_ticks_ms) * 100 / elapsed_ms));
+            write_bytes_per_sec = (write_sectors - last_write_sectors) * 512 * 1000 / elapsed_ms;
+            ddebug_f("update disk io stat succeed: dir = {}, io_util = {}%, "
+                     "write_bytes_per_sec = {}",
+                     full_dir,
+                     io_util_percent,
+                     write_bytes_per_sec);
+        }
+        last_io_ticks_ms = io_ticks_ms;
+        last_write_sectors = write_sectors;
+        last_io_stat_time_ms = now_ms;
+    }
 }
 
 fs_manager::fs_manager(bool for_test)
+    : _selection_policy(dir_selection_policy::create(FLAGS_disk_selection_policy))
 {
     if (!for_test) {
         _counter_total_capacity_mb.init_app_counter("eon.replica_stub",
@@ -136,6 +303,20 @@ dir_node *fs_manager::get_dir_node(const std::string &subdir)
     return nullptr;
 }
 
+int fs_manager::get_dir_node_index(const std::string &subdir) const
+{
+    std::string norm_subdir;
+    utils::filesystem::get_normalized_path(subdir, norm_subdir);
+    for (int i = 0; i < static_cast<int>(_dir_nodes.size()); ++i) {
+        const std::string &d = _dir_nodes[i]->full_dir;
+        if (norm_subdir.compare(0, d.size(), d) == 0 &&
+            (norm_subdir.size() == d.size() || norm_subdir[d.size()] == '/')) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 // size of the two vectors should be equal
 dsn::error_code fs_manager::initialize(const std::vector<std::string> &data_dirs,
                                        const std::vector<std::string> &tags,
@@ -210,39 +391,27 @@ void fs_manager::allocate_dir(const gpid &pid, const std::string &type, /*out*/
 
     zauto_write_lock l(_lock);
 
-    dir_node *selected = nullptr;
-
-    unsigned least_app_replicas_count = 0;
-    unsigned least_total_replicas_count = 0;
-
     for (auto &n : _dir_nodes) {
         dassert(!n->has(pid),
                 "gpid(%d.%d) already in dir_node(%s)",
                 pid.get_app_id(),
                 pid.get_partition_index(),
                 n->tag.c_str());
-        unsigned app_replicas = n->replicas_count(pid.get_app_id());
-        unsigned total_replicas = n->replicas_count();
-
-        if (selected == nullptr || least_app_replicas_count > app_replicas) {
-            least_app_replicas_count = app_replicas;
-            least_total_replicas_count = total_replicas;
-            selected = n.get();
-        } else if (least_app_replicas_count == app_replicas &&
-                   least_total_replicas_count > total_replicas) {
-            least_total_replicas_count = total_replicas;
-            selected = n.get();
-        }
     }
 
-    ddebug(
-        "%s: put pid(%d.%d) to dir(%s), which has %u replicas of current app, %u replicas totally",
-        dsn_primary_address().to_string(),
-        pid.get_app_id(),
-        pid.get_partition_index(),
-        selected->tag.c_str(),
-        least_app_replicas_count,
-        least_total_replicas_count);
+    dir_node *selected = _selection_policy->select(_dir_nodes, pid.get_app_id());
+    dassert(selected != nullptr, "no dir is selected for gpid(%s)", pid.to_string());
+
+    ddebug_f("{}: put pid({}) to dir({}), which has {} replicas of current app, {} replicas "
+             "totally, io_util = {}%, write_bytes_per_sec = {}, available_ratio = {}%",
+             dsn_primary_address().to_string(),
+             pid,
+             selected->tag,
+             selected->replicas_count(pid.get_app_id()),
+             selected->replicas_count(),
+             selected->io_util_percent,
+             selected->write_bytes_per_sec,
+             selected->disk_available_ratio);
 
     selected->holding_replicas[pid.get_app_id()].emplace(pid);
     dir = utils::filesystem::path_combine(selected->full_dir, buffer);
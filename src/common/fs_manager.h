@@ -38,6 +38,14 @@ public:
     std::map<app_id, std::set<gpid>> holding_primary_replicas;
     std::map<app_id, std::set<gpid>> holding_secondary_replicas;
 
+    // sampled from the block device of the dir by update_disk_stat(), stay 0 until two samples
+    // are taken or if the device can't be found
+    int io_util_percent = 0;
+    int64_t write_bytes_per_sec = 0;
+    uint64_t last_io_ticks_ms = 0;
+    uint64_t last_write_sectors = 0;
+    uint64_t last_io_stat_time_ms = 0;
+
 public:
     dir_node(const std::string &tag_,
              const std::string &dir_,
@@ -58,6 +66,24 @@ public:
     void update_disk_stat();
 };
 
+// Picks the dir_node for a new replica in fs_manager::allocate_dir().
+// The policy is chosen by [replication] disk_selection_policy:
+//   - "replica_count": the dir holding the least replicas of the app, then the least in total.
+//   - "load_aware": also weighs the io utilization, the write throughput and the used space of
+//     the disks, and avoids the disks nearly full.
+class dir_selection_policy
+{
+public:
+    virtual ~dir_selection_policy() = default;
+
+    // `nodes` is not empty
+    virtual dir_node *select(const std::vector<std::shared_ptr<dir_node>> &nodes,
+                             app_id id) const = 0;
+
+    // return nullptr if `name` is unknown
+    static std::unique_ptr<dir_selection_policy> create(const std::string &name);
+};
+
 class fs_manager
 {
 public:
@@ -77,6 +103,8 @@ public:
     void add_replica(const dsn::gpid &pid, const std::string &pid_dir);
     void remove_replica(const dsn::gpid &pid);
     bool for_each_dir_node(const std::function<bool(const dir_node &)> &func) const;
+    // the index of the dir_node which `subdir` belongs to, or -1 if not found
+    int get_dir_node_index(const std::string &subdir) const;
     void update_disk_stat();
 
 private:
@@ -102,6 +130,7 @@ private:
     int _max_available_ratio = 0;
 
     std::vector<std::shared_ptr<dir_node>> _dir_nodes;
+    std::unique_ptr<dir_selection_policy> _selection_policy;
 
     perf_counter_wrapper _counter_total_capacity_mb;
     perf_counter_wrapper _counter_total_available_mb;
@@ -112,6 +141,7 @@ private:
     friend class replica_stub;
     friend class mock_replica_stub;
     friend class replica_disk_migrator;
+    friend class disk_rebalancer;
     friend class replica_disk_test_base;
 };
 } // replication
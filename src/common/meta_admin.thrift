@@ -62,7 +62,9 @@ enum config_type
     CT_ADD_SECONDARY_FOR_LB,
     CT_PRIMARY_FORCE_UPDATE_BALLOT,
     CT_DROP_PARTITION,
-    CT_REGISTER_CHILD
+    CT_REGISTER_CHILD,
+    // meta server => primary, replace the non-voting read replicas with `read_replicas`
+    CT_UPDATE_READ_REPLICAS
 }
 
 enum node_status
@@ -87,6 +89,9 @@ struct configuration_update_request
     // the `meta_split_status` will be set
     // only used when on_config_sync
     6:optional metadata.split_status    meta_split_status;
+
+    // Used for CT_UPDATE_READ_REPLICAS
+    7:optional list<dsn.rpc_address>    read_replicas;
 }
 
 // meta server (config mgr) => primary | secondary (downgrade) (w/ new config)
@@ -109,11 +114,28 @@ struct replica_server_info
     2:i64 total_capacity_mb;
 }
 
+// The recent throughput of a primary replica reported in the config sync, or the share of the
+// table quotas meta server assigns to it, where 0 means unlimited.
+struct partition_quota
+{
+    1:dsn.gpid pid;
+    2:i64 write_qps;
+    3:i64 write_bytes_per_sec;
+    4:i64 read_qps;
+}
+
 struct configuration_query_by_node_request
 {
     1:dsn.rpc_address  node;
     2:optional list<metadata.replica_info> stored_replicas;
     3:optional replica_server_info info;
+
+    // Set for a delta sync: the digests of the app infos the node received last time, by
+    // app id. Meta server then only returns the partitions changed since then.
+    4:optional map<i32, i64> app_info_digests;
+
+    // Set if the node enforces the table quotas: the usages of its primary replicas.
+    5:optional list<partition_quota> quota_usages;
 }
 
 struct configuration_query_by_node_response
@@ -121,6 +143,14 @@ struct configuration_query_by_node_response
     1:dsn.error_code err;
     2:list<configuration_update_request> partitions;
     3:optional list<metadata.replica_info> gc_replicas;
+
+    // Set for a delta sync: the partitions whose configs are up-to-date on the node and
+    // thus not in `partitions`.
+    4:optional list<dsn.gpid> unchanged_partitions;
+
+    // Set if the request has quota_usages: the quota shares of the primary replicas on the node
+    // whose tables have quotas. The primaries not listed are unlimited.
+    5:optional list<partition_quota> quota_shares;
 }
 
 struct configuration_recovery_request
@@ -358,3 +388,31 @@ struct ddd_diagnose_response
     1:dsn.error_code           err;
     2:list<ddd_partition_info> partitions;
 }
+
+/////////////////// Background Tasks ////////////////////
+
+enum background_task_type
+{
+    BT_INVALID,
+    BT_CHECKPOINT,
+    BT_MANUAL_COMPACTION
+}
+
+// sent by a replica before it starts a background task, and after the task is done with
+// `release` set
+struct background_task_request
+{
+    1:dsn.gpid             pid;
+    2:dsn.rpc_address      node;
+    3:background_task_type type = background_task_type.BT_INVALID;
+    4:bool                 release = false;
+}
+
+struct background_task_response
+{
+    1:dsn.error_code err;
+    // whether the replica can start the task now, otherwise it should try again later
+    2:bool           granted = false;
+    // the task is released by the meta server if it's not done within the lease
+    3:i32            lease_seconds;
+}
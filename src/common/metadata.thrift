@@ -94,6 +94,9 @@ struct replica_configuration
     // 2. false - secondary copy mutation in this prepare message asynchronously
     // NOTICE: it should always be false when update_local_configuration
     7:optional bool       split_sync_to_child = false;
+    // Used for the read replicas, which learn as potential secondaries but never join the
+    // write quorum: the prepares to them are not waited for, and they are never upgraded
+    8:optional bool       non_voting = false;
 }
 
 struct replica_info
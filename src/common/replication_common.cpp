@@ -26,10 +26,14 @@
 
 #include "replication_common.h"
 
+#include <cctype>
 #include <fstream>
 
 #include <dsn/dist/replication/replica_envs.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/dns_resolver.h>
+#include <dsn/cpp/serialization.h>
 #include <dsn/utility/filesystem.h>
 
 namespace dsn {
@@ -49,6 +53,14 @@ DSN_DEFINE_int32("replication",
     return it->second;
 }
 
+/*extern*/ int64_t app_info_digest(const app_info &info)
+{
+    binary_writer writer;
+    marshall(writer, info, DSF_THRIFT_BINARY);
+    blob buf = writer.get_buffer();
+    return static_cast<int64_t>(utils::crc64_calc(buf.data(), buf.length(), 0));
+}
+
 replication_options::replication_options()
 {
     deny_client_on_start = false;
@@ -558,6 +570,13 @@ void replica_helper::load_meta_servers(/*out*/ std::vector<dsn::rpc_address> &se
     std::string server_list = dsn_config_get_value_string(section, key, "", "");
     std::vector<std::string> lv;
     ::dsn::utils::split_args(server_list.c_str(), lv, ',');
+    // resolve the host names in parallel by the resolver threads before waiting for each of them
+    for (auto &s : lv) {
+        std::string host = s.substr(0, s.find(':'));
+        if (!host.empty() && !isdigit(host[0])) {
+            utils::dns_resolver::instance().resolve_async(host, [](uint32_t) {});
+        }
+    }
     for (auto &s : lv) {
         ::dsn::rpc_address addr;
         if (!addr.from_string_ipv4(s.c_str())) {
@@ -578,6 +597,7 @@ const std::string backup_restore_constant::APP_ID("restore.app_id");
 const std::string backup_restore_constant::BACKUP_ID("restore.backup_id");
 const std::string backup_restore_constant::SKIP_BAD_PARTITION("restore.skip_bad_partition");
 const std::string backup_restore_constant::RESTORE_PATH("restore.restore_path");
+const std::string backup_restore_constant::COLD_TIER_CACHE_MB("restore.cold_tier_cache_mb");
 
 const std::string replica_envs::DENY_CLIENT_WRITE("replica.deny_client_write");
 const std::string replica_envs::WRITE_QPS_THROTTLING("replica.write_throttling");
@@ -616,6 +636,10 @@ const std::string replica_envs::REPLICA_ACCESS_CONTROLLER_ALLOWED_USERS(
 const std::string replica_envs::READ_QPS_THROTTLING("replica.read_throttling");
 const std::string
     replica_envs::SPLIT_VALIDATE_PARTITION_HASH("replica.split.validate_partition_hash");
+const std::string replica_envs::WRITE_QPS_QUOTA("replica.write_qps_quota");
+const std::string replica_envs::WRITE_SIZE_QUOTA("replica.write_size_quota");
+const std::string replica_envs::READ_QPS_QUOTA("replica.read_qps_quota");
+const std::string replica_envs::READ_REPLICA_COUNT("replica.read_replica_count");
 
 const std::string bulk_load_constant::BULK_LOAD_INFO("bulk_load_info");
 const int32_t bulk_load_constant::BULK_LOAD_REQUEST_INTERVAL = 10;
@@ -52,6 +52,8 @@ typedef rpc_holder<query_child_state_request, query_child_state_response> query_
 
 typedef rpc_holder<backup_request, backup_response> backup_rpc;
 
+typedef rpc_holder<background_task_request, background_task_response> background_task_rpc;
+
 class replication_options
 {
 public:
@@ -141,6 +143,10 @@ private:
 
 extern const char *partition_status_to_string(partition_status::type status);
 
+// Digest of the app info delivered by config sync, which tells whether it has changed since
+// the last sync, see configuration_query_by_node_request.app_info_digests.
+extern int64_t app_info_digest(const app_info &info);
+
 class backup_restore_constant
 {
 public:
@@ -153,6 +159,7 @@ public:
     static const std::string BACKUP_ID;
     static const std::string SKIP_BAD_PARTITION;
     static const std::string RESTORE_PATH;
+    static const std::string COLD_TIER_CACHE_MB;
 };
 
 class bulk_load_constant
@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "common/fs_manager.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+static std::shared_ptr<dir_node> make_dir_node(const std::string &tag,
+                                               int replica_count,
+                                               int io_util_percent,
+                                               int available_ratio)
+{
+    auto n =
+        std::make_shared<dir_node>(tag, "/" + tag, 1000, available_ratio * 10, available_ratio);
+    for (int i = 0; i < replica_count; ++i) {
+        n->holding_replicas[1].emplace(gpid(1, tag[0] * 100 + i));
+    }
+    n->io_util_percent = io_util_percent;
+    return n;
+}
+
+TEST(fs_manager_test, replica_count_dir_selection_policy)
+{
+    auto policy = dir_selection_policy::create("replica_count");
+    ASSERT_NE(nullptr, policy);
+
+    std::vector<std::shared_ptr<dir_node>> nodes = {make_dir_node("a", 1, 100, 50),
+                                                    make_dir_node("b", 2, 0, 50)};
+    ASSERT_EQ("a", policy->select(nodes, 1)->tag);
+
+    ASSERT_EQ(nullptr, dir_selection_policy::create("unknown"));
+}
+
+TEST(fs_manager_test, load_aware_dir_selection_policy)
+{
+    auto policy = dir_selection_policy::create("load_aware");
+    ASSERT_NE(nullptr, policy);
+
+    // the busy disk is skipped although it holds less replicas
+    std::vector<std::shared_ptr<dir_node>> nodes = {make_dir_node("a", 1, 100, 50),
+                                                    make_dir_node("b", 2, 0, 50)};
+    ASSERT_EQ("b", policy->select(nodes, 1)->tag);
+
+    // the nearly full disk is skipped
+    nodes = {make_dir_node("a", 0, 0, 5), make_dir_node("b", 5, 50, 50)};
+    ASSERT_EQ("b", policy->select(nodes, 1)->tag);
+
+    // unless all the disks are nearly full
+    nodes = {make_dir_node("a", 0, 0, 5), make_dir_node("b", 5, 50, 8)};
+    ASSERT_EQ("a", policy->select(nodes, 1)->tag);
+}
+
+} // namespace replication
+} // namespace dsn
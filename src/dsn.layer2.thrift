@@ -33,6 +33,19 @@ struct configuration_query_by_index_response
     5:list<partition_configuration> partitions;
 }
 
+// watches the partition configurations of an app. the meta server replies as soon as the ballot
+// of a partition gets newer than the known one, with only the newer partitions, or with no
+// partition once the watch expires. the reply holds all the partitions if the app has changed.
+// it's replied with configuration_query_by_index_response.
+struct configuration_watch_app_request
+{
+    1:string           app_name;
+    2:i32              app_id;
+    // the ballots known by the client, indexed by the partition index
+    3:list<i64>        known_ballots;
+    4:i32              expire_ms;
+}
+
 enum app_status
 {
     AS_INVALID,
@@ -35,12 +35,64 @@
 
 #include <dsn/dist/failure_detector.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/flags.h>
 #include <chrono>
+#include <cmath>
 #include <ctime>
 
 namespace dsn {
 namespace fd {
 
+DSN_DEFINE_bool("failure_detector",
+                phi_accrual_enabled,
+                false,
+                "whether master claims a worker dead once it has been silent for longer than "
+                "the lease, if the phi of its beacon inter-arrival times exceeds "
+                "phi_accrual_threshold, rather than waiting for the grace period");
+DSN_TAG_VARIABLE(phi_accrual_enabled, FT_MUTABLE);
+DSN_DEFINE_double("failure_detector",
+                  phi_accrual_threshold,
+                  8.0,
+                  "the phi over which a worker silent for longer than the lease is claimed dead, "
+                  "phi = 8 means the chance of a false positive is 1e-8");
+DSN_DEFINE_uint32("failure_detector",
+                  phi_accrual_min_samples,
+                  10,
+                  "the minimum beacon inter-arrival times needed before phi is used");
+DSN_DEFINE_uint32("failure_detector",
+                  phi_accrual_min_std_deviation_ms,
+                  200,
+                  "the lower bound of the standard deviation of the beacon inter-arrival times, "
+                  "to tolerate jitter of the workers whose beacons are very regular");
+
+void phi_accrual_estimator::add_interval(uint64_t interval_ms)
+{
+    // the weight of a new interval in the moving averages
+    static const double kAlpha = 0.1;
+
+    double x = static_cast<double>(interval_ms);
+    if (_count++ == 0) {
+        _mean_ms = x;
+        _variance = 0;
+        return;
+    }
+    double diff = x - _mean_ms;
+    _mean_ms += kAlpha * diff;
+    _variance = (1 - kAlpha) * (_variance + kAlpha * diff * diff);
+}
+
+double phi_accrual_estimator::phi(uint64_t elapsed_ms, uint32_t min_std_deviation_ms) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+    double std_deviation =
+        std::max(std::sqrt(_variance), static_cast<double>(min_std_deviation_ms));
+    double y = (static_cast<double>(elapsed_ms) - _mean_ms) / std_deviation;
+    double p_later = 0.5 * std::erfc(y / std::sqrt(2.0));
+    return -std::log10(std::max(p_later, 1e-300));
+}
+
 failure_detector::failure_detector()
 {
     dsn::threadpool_code pool = task_spec::get(LPC_BEACON_CHECK.code())->pool_code;
@@ -117,6 +169,7 @@ void failure_detector::stop()
     _is_started = false;
     _masters.clear();
     _workers.clear();
+    _alive_workers_by_recv_time.clear();
 }
 
 void failure_detector::register_master(::dsn::rpc_address target)
@@ -277,24 +330,41 @@ void failure_detector::check_all_records()
 
         uint64_t now = dsn_now_ms();
 
-        for (auto itq = _workers.begin(); itq != _workers.end(); itq++) {
-            worker_record &record = itq->second;
-
+        // only the workers silent for longer than the lease may be claimed dead, which are at the
+        // front of the index
+        uint64_t min_silence_ms = FLAGS_phi_accrual_enabled
+                                      ? std::min(_lease_milliseconds, _grace_milliseconds)
+                                      : _grace_milliseconds;
+        for (auto itq = _alive_workers_by_recv_time.begin();
+             itq != _alive_workers_by_recv_time.end();) {
             // we should ensure now is greater than record.last_beacon_recv_time to aviod integer
             // overflow
-            if (record.is_alive && is_time_greater_than(now, record.last_beacon_recv_time) &&
-                now - record.last_beacon_recv_time > _grace_milliseconds) {
+            if (!is_time_greater_than(now, itq->first) || now - itq->first <= min_silence_ms) {
+                break;
+            }
+            worker_record &record = _workers.at(itq->second);
+            dassert(record.is_alive && record.last_beacon_recv_time == itq->first,
+                    "worker %s is not indexed correctly",
+                    record.node.to_string());
+
+            if (now - record.last_beacon_recv_time > _grace_milliseconds ||
+                is_worker_suspected(record.beacon_intervals, now - record.last_beacon_recv_time)) {
                 derror("worker %s disconnected, now=%" PRId64 ", last_beacon_recv_time=%" PRId64
-                       ", now-last_recv=%" PRId64,
+                       ", now-last_recv=%" PRId64 ", phi=%.2f",
                        record.node.to_string(),
                        now,
                        record.last_beacon_recv_time,
-                       now - record.last_beacon_recv_time);
+                       now - record.last_beacon_recv_time,
+                       record.beacon_intervals.phi(now - record.last_beacon_recv_time,
+                                                   FLAGS_phi_accrual_min_std_deviation_ms));
 
                 expire.push_back(record.node);
                 record.is_alive = false;
+                itq = _alive_workers_by_recv_time.erase(itq);
 
                 report(record.node, false, false);
+            } else {
+                ++itq;
             }
         }
         /*
@@ -306,6 +376,31 @@ void failure_detector::check_all_records()
     }
 }
 
+bool failure_detector::is_worker_suspected(const phi_accrual_estimator &estimator,
+                                           uint64_t elapsed_ms) const
+{
+    // the workers may still be serving within the lease, which is never cut for safety
+    return FLAGS_phi_accrual_enabled && elapsed_ms > _lease_milliseconds &&
+           estimator.count() >= FLAGS_phi_accrual_min_samples &&
+           estimator.phi(elapsed_ms, FLAGS_phi_accrual_min_std_deviation_ms) >=
+               FLAGS_phi_accrual_threshold;
+}
+
+double failure_detector::get_worker_phi(::dsn::rpc_address node) const
+{
+    zauto_lock l(_lock);
+    auto iter = _workers.find(node);
+    if (iter == _workers.end() || !iter->second.is_alive) {
+        return 0;
+    }
+    uint64_t now = dsn_now_ms();
+    if (now <= iter->second.last_beacon_recv_time) {
+        return 0;
+    }
+    return iter->second.beacon_intervals.phi(now - iter->second.last_beacon_recv_time,
+                                             FLAGS_phi_accrual_min_std_deviation_ms);
+}
+
 void failure_detector::add_allow_list(::dsn::rpc_address node)
 {
     zauto_lock l(_lock);
@@ -379,16 +474,26 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
         worker_record record(node, now);
         record.is_alive = true;
         _workers.insert(std::make_pair(node, record));
+        _alive_workers_by_recv_time.emplace(now, node);
 
         report(node, false, true);
         on_worker_connected(node);
     } else if (is_time_greater_than(now, itr->second.last_beacon_recv_time)) {
+        // the silence of a reconnected worker is not a beacon interval
+        if (itr->second.is_alive) {
+            itr->second.beacon_intervals.add_interval(now - itr->second.last_beacon_recv_time);
+            _alive_workers_by_recv_time.erase(
+                std::make_pair(itr->second.last_beacon_recv_time, node));
+        } else {
+            itr->second.beacon_intervals.reset();
+        }
+        _alive_workers_by_recv_time.emplace(now, node);
         // update last_beacon_recv_time
         itr->second.last_beacon_recv_time = now;
 
-        ddebug("master %s update last_beacon_recv_time=%" PRId64,
-               itr->second.node.to_string(),
-               itr->second.last_beacon_recv_time);
+        dinfo("master %s update last_beacon_recv_time=%" PRId64,
+              itr->second.node.to_string(),
+              itr->second.last_beacon_recv_time);
 
         if (itr->second.is_alive == false) {
             itr->second.is_alive = true;
@@ -530,6 +635,9 @@ void failure_detector::register_worker(::dsn::rpc_address target, bool is_connec
 
     auto ret = _workers.insert(std::make_pair(target, record));
     if (ret.second) {
+        if (record.is_alive) {
+            _alive_workers_by_recv_time.emplace(record.last_beacon_recv_time, target);
+        }
         dinfo("register worker[%s] successfully", target.to_string());
     } else {
         dinfo("worker[%s] already registered", target.to_string());
@@ -543,6 +651,11 @@ bool failure_detector::unregister_worker(::dsn::rpc_address node)
      */
     bool ret;
 
+    auto iter = _workers.find(node);
+    if (iter != _workers.end() && iter->second.is_alive) {
+        _alive_workers_by_recv_time.erase(
+            std::make_pair(iter->second.last_beacon_recv_time, node));
+    }
     size_t count = _workers.erase(node);
 
     if (count == 0) {
@@ -562,6 +675,7 @@ void failure_detector::clear_workers()
 {
     zauto_lock l(_lock);
     _workers.clear();
+    _alive_workers_by_recv_time.clear();
 }
 
 bool failure_detector::is_worker_connected(::dsn::rpc_address node) const
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <dsn/service_api_cpp.h>
+#include <algorithm>
+#include <thread>
 #include <vector>
 
 using namespace dsn;
@@ -695,3 +697,159 @@ TEST(fd, not_in_whitelist)
 
     ASSERT_TRUE(spin_wait_condition([&wait_count] { return wait_count == 1; }, 20));
 }
+
+TEST(fd, phi_accrual_estimator)
+{
+    phi_accrual_estimator estimator;
+    ASSERT_EQ(0, estimator.phi(100000, 200));
+
+    for (int i = 0; i < 100; ++i) {
+        estimator.add_interval(i % 2 == 0 ? 900 : 1100);
+    }
+    ASSERT_EQ(100, estimator.count());
+    // the next beacon is expected around 1s later
+    ASSERT_LT(estimator.phi(1000, 200), 1);
+    ASSERT_LT(estimator.phi(1500, 200), estimator.phi(2000, 200));
+    ASSERT_GT(estimator.phi(3000, 200), 8);
+    // a larger lower bound of the standard deviation tolerates more jitter
+    ASSERT_LT(estimator.phi(3000, 1000), 8);
+
+    estimator.reset();
+    ASSERT_EQ(0, estimator.count());
+    ASSERT_EQ(0, estimator.phi(100000, 200));
+}
+
+namespace dsn {
+namespace fd {
+
+// checks the workers of a failure detector which is not serving, whose workers are silent unless
+// pinged by the test
+class check_records_test : public ::testing::Test
+{
+public:
+    class test_fd : public failure_detector
+    {
+    public:
+        void on_master_disconnected(const std::vector<rpc_address> &) override {}
+        void on_master_connected(rpc_address) override {}
+        void on_worker_disconnected(const std::vector<rpc_address> &nodes) override
+        {
+            expired.insert(expired.end(), nodes.begin(), nodes.end());
+        }
+        void on_worker_connected(rpc_address) override {}
+
+        std::vector<rpc_address> expired;
+    };
+
+    check_records_test()
+    {
+        _fd._lease_milliseconds = kGraceMs;
+        _fd._grace_milliseconds = kGraceMs;
+        _fd._is_started = true;
+    }
+
+    void register_worker(rpc_address node)
+    {
+        zauto_lock l(_fd._lock);
+        _fd.register_worker(node);
+    }
+
+    void unregister_worker(rpc_address node)
+    {
+        zauto_lock l(_fd._lock);
+        ASSERT_TRUE(_fd.unregister_worker(node));
+    }
+
+    void ping(rpc_address node)
+    {
+        beacon_msg beacon;
+        beacon.time = dsn_now_ms();
+        beacon.from_addr = node;
+        beacon.to_addr = dsn_primary_address();
+        beacon_ack ack;
+        _fd.on_ping_internal(beacon, ack);
+    }
+
+    // the workers found dead
+    std::vector<rpc_address> check()
+    {
+        _fd.expired.clear();
+        _fd.check_all_records();
+        return _fd.expired;
+    }
+
+    size_t indexed_count()
+    {
+        zauto_lock l(_fd._lock);
+        return _fd._alive_workers_by_recv_time.size();
+    }
+
+    static void wait_grace()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kGraceMs * 3));
+    }
+
+    static const uint32_t kGraceMs = 100;
+
+    test_fd _fd;
+    const rpc_address _worker1{"127.0.0.1", 50001};
+    const rpc_address _worker2{"127.0.0.1", 50002};
+};
+
+TEST_F(check_records_test, expire_stale_workers)
+{
+    register_worker(_worker1);
+    register_worker(_worker2);
+    ASSERT_TRUE(check().empty());
+    ASSERT_EQ(2u, indexed_count());
+
+    // only the worker whose beacons stopped is expired, and taken out of the index
+    wait_grace();
+    ping(_worker2);
+    ASSERT_EQ(std::vector<rpc_address>({_worker1}), check());
+    ASSERT_FALSE(_fd.is_worker_connected(_worker1));
+    ASSERT_TRUE(_fd.is_worker_connected(_worker2));
+    ASSERT_EQ(1u, indexed_count());
+
+    // the expired worker comes back by a beacon
+    ping(_worker1);
+    ASSERT_TRUE(_fd.is_worker_connected(_worker1));
+    ASSERT_EQ(2u, indexed_count());
+    wait_grace();
+    std::vector<rpc_address> expired = check();
+    std::sort(expired.begin(), expired.end());
+    ASSERT_EQ(std::vector<rpc_address>({_worker1, _worker2}), expired);
+    ASSERT_EQ(0u, indexed_count());
+}
+
+TEST_F(check_records_test, expire_reregistered_workers)
+{
+    // an alive worker unregistered leaves nothing in the index
+    register_worker(_worker1);
+    register_worker(_worker2);
+    unregister_worker(_worker1);
+    ASSERT_EQ(1u, indexed_count());
+
+    // and is indexed by the time it registers again
+    wait_grace();
+    register_worker(_worker1);
+    ASSERT_EQ(2u, indexed_count());
+    ASSERT_EQ(std::vector<rpc_address>({_worker2}), check());
+    ASSERT_TRUE(_fd.is_worker_connected(_worker1));
+
+    wait_grace();
+    ASSERT_EQ(std::vector<rpc_address>({_worker1}), check());
+    ASSERT_EQ(0u, indexed_count());
+
+    // so is an expired one
+    unregister_worker(_worker1);
+    register_worker(_worker1);
+    ASSERT_EQ(1u, indexed_count());
+    ASSERT_TRUE(check().empty());
+    wait_grace();
+    ASSERT_EQ(std::vector<rpc_address>({_worker1}), check());
+    ASSERT_EQ(0u, indexed_count());
+}
+
+} // namespace fd
+} // namespace dsn
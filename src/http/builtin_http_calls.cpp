@@ -67,12 +67,24 @@ namespace dsn {
         })
         .with_help("Gets the server start time.");
 
+    register_http_call("startupReport")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_startup_report_handler(req, resp);
+        })
+        .with_help("Gets how long each phase of the server start took.");
+
     register_http_call("perfCounter")
         .with_callback([](const http_request &req, http_response &resp) {
             get_perf_counter_handler(req, resp);
         })
         .with_help("Gets the value of a perf counter");
 
+    register_http_call("metrics")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_prometheus_metrics_handler(req, resp);
+        })
+        .with_help("Gets all the perf counters in the Prometheus text exposition format");
+
     register_http_call("updateConfig")
         .with_callback(
             [](const http_request &req, http_response &resp) { update_config(req, resp); })
@@ -86,6 +98,35 @@ namespace dsn {
         .with_callback(
             [](const http_request &req, http_response &resp) { list_all_configs(req, resp); })
         .with_help("list all configs");
+
+    register_http_call("threadPoolStats")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_thread_pool_stats_handler(req, resp);
+        })
+        .with_help("Gets the queue depth, queue wait time and busy ratio of each thread pool "
+                   "worker since the last call, only for the pools with enable_worker_stats");
+
+    register_http_call("rpcSizeStats")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_rpc_size_stats_handler(req, resp);
+        })
+        .with_help("Gets the sampled body sizes of the messages of each task code, and the top "
+                   "remote addresses by the bytes per second since the last call, usage: "
+                   "rpcSizeStats?top=10");
+
+    register_http_call("pprof/contention")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_lock_contention_handler(req, resp);
+        })
+        .with_help("Profiles the lock contention for some seconds and lists the most contended "
+                   "call sites, usage: pprof/contention?seconds=10&top=20&hold_sample_interval=100");
+
+    register_http_call("pprof/continuous")
+        .with_callback([](const http_request &req, http_response &resp) {
+            get_sampling_profile_handler(req, resp);
+        })
+        .with_help("Gets the cpu profile of the task workers in the last seconds sampled by the "
+                   "sampling_profiler toollet, usage: pprof/continuous?seconds=60");
 }
 
 } // namespace dsn
@@ -28,13 +28,25 @@ extern void register_builtin_http_calls();
 
 extern void get_perf_counter_handler(const http_request &req, http_response &resp);
 
+extern void get_prometheus_metrics_handler(const http_request &req, http_response &resp);
+
 extern void get_help_handler(const http_request &req, http_response &resp);
 
 extern void get_recent_start_time_handler(const http_request &req, http_response &resp);
 
+extern void get_startup_report_handler(const http_request &req, http_response &resp);
+
 extern void update_config(const http_request &req, http_response &resp);
 
 extern void list_all_configs(const http_request &req, http_response &resp);
 
 extern void get_config(const http_request &req, http_response &resp);
+
+extern void get_thread_pool_stats_handler(const http_request &req, http_response &resp);
+
+extern void get_rpc_size_stats_handler(const http_request &req, http_response &resp);
+
+extern void get_lock_contention_handler(const http_request &req, http_response &resp);
+
+extern void get_sampling_profile_handler(const http_request &req, http_response &resp);
 } // namespace dsn
@@ -33,6 +33,7 @@
 #include <dsn/c/api_layer1.h>
 #include <dsn/http/http_server.h>
 #include <iomanip>
+#include <strings.h>
 
 namespace dsn {
 
@@ -83,6 +84,7 @@ http_message_parser::http_message_parser()
         header->hdr_length = sizeof(message_header);
         header->hdr_crc32 = header->body_crc32 = CRC_INVALID;
         strcpy(header->rpc_name, "RPC_HTTP_SERVICE");
+        reinterpret_cast<parser_context *>(parser->data)->parser->_url.clear();
         return 0;
     };
 
@@ -97,8 +99,15 @@ http_message_parser::http_message_parser()
         [](http_parser *parser, const char *at, size_t length) -> int {
         http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
         msg_parser->_stage = HTTP_ON_HEADER_FIELD;
-        if (strncmp(at, "Content-Type", length) == 0) {
-            msg_parser->_is_field_content_type = true;
+        auto field_is = [at, length](const char *name) {
+            return length == strlen(name) && strncasecmp(at, name, length) == 0;
+        };
+        if (field_is("Content-Type")) {
+            msg_parser->_header_field = header_field::content_type;
+        } else if (field_is("Accept-Encoding")) {
+            msg_parser->_header_field = header_field::accept_encoding;
+        } else {
+            msg_parser->_header_field = header_field::other;
         }
         return 0;
     };
@@ -107,12 +116,20 @@ http_message_parser::http_message_parser()
         [](http_parser *parser, const char *at, size_t length) -> int {
         http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
         msg_parser->_stage = HTTP_ON_HEADER_VALUE;
-        if (msg_parser->_is_field_content_type) {
-            auto &msg = msg_parser->_current_message;
+        auto &msg = msg_parser->_current_message;
+        switch (msg_parser->_header_field) {
+        case header_field::content_type:
             // msg->buffers[3] = content-type
             msg->buffers[3] = blob::create_from_bytes(at, length);
-            msg_parser->_is_field_content_type = false;
+            break;
+        case header_field::accept_encoding:
+            // msg->buffers[4] = accept-encoding
+            msg->buffers[4] = blob::create_from_bytes(at, length);
+            break;
+        default:
+            break;
         }
+        msg_parser->_header_field = header_field::other;
         return 0;
     };
 
@@ -124,6 +141,10 @@ http_message_parser::http_message_parser()
 
         // msg->buffers[2] = url
         msg->buffers[2] = blob::create_from_bytes(std::move(msg_parser->_url));
+        // msg->buffers[5] = "close" for HTTP/1.0 without keep-alive, or "Connection: close"
+        if (!http_should_keep_alive(parser)) {
+            msg->buffers[5] = blob::create_from_bytes(std::string("close"));
+        }
 
         message_header *header = msg->header;
         if (parser->type == HTTP_REQUEST && parser->method == HTTP_GET) {
@@ -141,6 +162,7 @@ http_message_parser::http_message_parser()
 
     _parser_setting.on_message_complete = [](http_parser *parser) -> int {
         auto message_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
+        message_parser->_current_message->header->id = message_parser->_next_request_seq++;
         message_parser->_received_messages.emplace(std::move(message_parser->_current_message));
         message_parser->_stage = HTTP_ON_MESSAGE_COMPLETE;
         return 0;
@@ -155,7 +177,8 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
 {
     read_next = 4096;
 
-    if (reader->_buffer_occupied > 0) {
+    // feeding nothing means EOF to http_parser
+    if (reader->_buffer_occupied > _parsed_length) {
         parser_context ctx{this, reader};
         _parser.data = &ctx;
 
@@ -164,14 +187,27 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
             auto &msg = data->parser->_current_message;
             blob read_buf = data->reader->_buffer;
 
-            // set http body
-            msg->buffers[1].assign(read_buf.buffer(), at - read_buf.buffer_ptr(), length);
-            msg->header->body_length = length;
+            // set http body, which may arrive in pieces
+            blob &body = msg->buffers[1];
+            if (body.length() == 0) {
+                body.assign(read_buf.buffer(), at - read_buf.buffer_ptr(), length);
+            } else {
+                std::string merged;
+                merged.reserve(body.length() + length);
+                merged.append(body.data(), body.length());
+                merged.append(at, length);
+                body = blob::create_from_bytes(std::move(merged));
+            }
+            msg->header->body_length = body.length();
             return 0;
         };
 
-        auto nparsed = http_parser_execute(
-            &_parser, &_parser_setting, reader->_buffer.data(), reader->_buffer_occupied);
+        // the bytes parsed by the previous calls belong to an incomplete message, which must not
+        // be fed to the parser again
+        auto nparsed = http_parser_execute(&_parser,
+                                           &_parser_setting,
+                                           reader->_buffer.data() + _parsed_length,
+                                           reader->_buffer_occupied - _parsed_length);
 
         // error handling
         if (_parser.http_errno != HPE_OK) {
@@ -241,6 +277,22 @@ int http_message_parser::get_buffers_on_send(message_ex *msg, send_buf *buffers)
     return i;
 }
 
+void http_message_parser::reply_in_order(message_ex *resp)
+{
+    message_ptr holder(resp);
+    std::lock_guard<std::mutex> l(_reply_lock);
+    _pending_replies.emplace(resp->header->id, std::move(holder));
+    // a request may be replied by the rpc engine directly, e.g. when it's rejected, which leaves a
+    // gap of the sequences, so the responses aren't held forever
+    static const size_t max_pending_replies = 64;
+    while (!_pending_replies.empty() && (_pending_replies.begin()->first <= _next_reply_seq ||
+                                         _pending_replies.size() > max_pending_replies)) {
+        _next_reply_seq = _pending_replies.begin()->first + 1;
+        dsn_rpc_reply(_pending_replies.begin()->second.get());
+        _pending_replies.erase(_pending_replies.begin());
+    }
+}
+
 void http_message_parser::reset()
 {
     _current_message.reset();
@@ -29,6 +29,8 @@
 #include <dsn/utility/ports.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/message_parser.h>
+#include <map>
+#include <mutex>
 #include <vector>
 #include <queue>
 
@@ -39,7 +41,7 @@ namespace dsn {
 DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_HTTP)
 
 // Number of blobs that a message_ex contains.
-#define HTTP_MSG_BUFFERS_NUM 4
+#define HTTP_MSG_BUFFERS_NUM 6
 
 // Incoming HTTP requests will be parsed into:
 //
@@ -51,6 +53,9 @@ DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_HTTP)
 //    msg->buffers[1] = body
 //    msg->buffers[2] = url
 //    msg->buffers[3] = content-type
+//    msg->buffers[4] = accept-encoding
+//    msg->buffers[5] = "close" if the connection isn't kept alive after the response
+//    msg->header->id = sequence of the request in its connection
 //
 
 enum http_parser_stage
@@ -82,6 +87,11 @@ public:
 
     int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) override;
 
+    // The pipelined requests of a connection may be served concurrently, while HTTP requires the
+    // responses in the order of the requests. So a response is held until the responses of all
+    // the requests before it are sent.
+    void reply_in_order(message_ex *resp);
+
 private:
     friend class http_message_parser_test;
 
@@ -94,12 +104,23 @@ private:
     http_parser_settings _parser_setting;
     http_parser _parser;
 
-    bool _is_field_content_type{false};
+    enum class header_field
+    {
+        other,
+        content_type,
+        accept_encoding,
+    };
+    header_field _header_field{header_field::other};
     std::unique_ptr<message_ex> _current_message;
     http_parser_stage _stage{HTTP_INVALID};
     std::string _url;
     size_t _parsed_length{0};
     std::queue<std::unique_ptr<message_ex>> _received_messages;
+    uint64_t _next_request_seq{0};
+
+    std::mutex _reply_lock;
+    uint64_t _next_reply_seq{0};
+    std::map<uint64_t, message_ptr> _pending_replies;
 };
 
 } // namespace dsn
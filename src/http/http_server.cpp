@@ -20,6 +20,9 @@
 #include <dsn/utils/time_utils.h>
 #include <boost/algorithm/string.hpp>
 #include <fmt/ostream.h>
+#ifdef DSN_HAS_ZLIB
+#include <zlib.h>
+#endif
 
 #include "http_message_parser.h"
 #include "pprof_http_service.h"
@@ -31,6 +34,48 @@
 namespace dsn {
 
 DSN_DEFINE_bool("http", enable_http_server, true, "whether to enable the embedded HTTP server");
+DSN_DEFINE_uint32("http",
+                  http_gzip_min_bytes,
+                  1024,
+                  "the response bodies of at least this size are compressed by gzip if the "
+                  "client accepts it, 0 to disable");
+
+#ifdef DSN_HAS_ZLIB
+// compresses `data` in the gzip format, returns false on failure
+static bool gzip_compress(const std::string &data, /*out*/ std::string &output)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 15 window bits, plus 16 for the gzip header and trailer
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output.resize(deflateBound(&zs, data.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef *>(&output[0]);
+    zs.avail_out = static_cast<uInt>(output.size());
+    int ret = deflate(&zs, Z_FINISH);
+    output.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+// whether the Accept-Encoding header accepts gzip, which is rejected by "gzip;q=0"
+static bool accepts_gzip(const std::string &accept_encoding)
+{
+    std::vector<std::string> codings;
+    boost::split(codings, accept_encoding, boost::is_any_of(","));
+    for (std::string &coding : codings) {
+        boost::erase_all(coding, " ");
+        if (boost::iequals(coding, "gzip") || boost::istarts_with(coding, "gzip;") ||
+            coding == "*") {
+            return !boost::iends_with(coding, ";q=0") && !boost::iends_with(coding, ";q=0.0");
+        }
+    }
+    return false;
+}
+#endif
 
 /*extern*/ std::string http_status_code_to_string(http_status_code code)
 {
@@ -112,7 +157,9 @@ void http_server::serve(message_ex *msg)
         }
     }
 
-    http_response_reply(resp, msg);
+    bool keep_alive = res.is_ok() ? res.get_value().keep_alive : false;
+    std::string accept_encoding = res.is_ok() ? res.get_value().accept_encoding : "";
+    http_response_reply(resp, msg, keep_alive, accept_encoding);
 }
 
 /*static*/ error_with<http_request> http_request::parse(message_ex *m)
@@ -126,6 +173,8 @@ void http_server::serve(message_ex *msg)
     ret.body = m->buffers[1];
     ret.full_url = m->buffers[2];
     ret.method = static_cast<http_method>(m->header->hdr_type);
+    ret.accept_encoding = m->buffers[4].to_string();
+    ret.keep_alive = m->buffers[5].length() == 0;
 
     http_parser_url u{0};
     http_parser_parse_url(ret.full_url.data(), ret.full_url.length(), false, &u);
@@ -212,25 +261,64 @@ void http_server::serve(message_ex *msg)
     return ret;
 }
 
-/*extern*/ void http_response_reply(const http_response &resp, message_ex *req)
+/*extern*/ void http_response_reply(const http_response &resp,
+                                    message_ex *req,
+                                    bool keep_alive,
+                                    const std::string &accept_encoding)
 {
     message_ptr resp_msg = req->create_response();
 
+    blob body;
+#ifdef DSN_HAS_ZLIB
+    bool gzipped = false;
+    if (FLAGS_http_gzip_min_bytes > 0 && resp.body.length() >= FLAGS_http_gzip_min_bytes &&
+        accepts_gzip(accept_encoding)) {
+        std::string compressed;
+        if (gzip_compress(resp.body, compressed)) {
+            body = blob::create_from_bytes(std::move(compressed));
+            gzipped = true;
+        }
+    }
+#endif
+    if (body.length() == 0) {
+        body = blob::create_from_bytes(resp.body.data(), resp.body.length());
+    }
+
     std::ostringstream os;
     os << "HTTP/1.1 " << http_status_code_to_string(resp.status_code) << "\r\n";
     os << "Content-Type: " << resp.content_type << "\r\n";
-    os << "Content-Length: " << resp.body.length() << "\r\n";
+    os << "Content-Length: " << body.length() << "\r\n";
+#ifdef DSN_HAS_ZLIB
+    if (gzipped) {
+        os << "Content-Encoding: gzip\r\n";
+    }
+    os << "Vary: Accept-Encoding\r\n";
+#endif
+    os << "Connection: " << (keep_alive ? "keep-alive" : "close") << "\r\n";
     if (!resp.location.empty()) {
         os << "Location: " << resp.location << "\r\n";
     }
     os << "\r\n";
-    os << resp.body;
 
-    rpc_write_stream writer(resp_msg.get());
-    writer.write(os.str().data(), os.str().length());
-    writer.flush();
+    {
+        const std::string header = os.str();
+        rpc_write_stream writer(resp_msg.get());
+        writer.write(header.data(), header.length());
+        writer.flush();
+    }
+    // the body is appended without being copied into the stream
+    if (body.length() > 0) {
+        resp_msg->write_append(body);
+    }
 
-    dsn_rpc_reply(resp_msg.get());
+    // the pipelined requests of a connection are replied in order
+    auto parser = req->io_session == nullptr ? nullptr : req->io_session->parser();
+    auto http_parser = dynamic_cast<http_message_parser *>(parser.get());
+    if (http_parser != nullptr) {
+        http_parser->reply_in_order(resp_msg.get());
+    } else {
+        dsn_rpc_reply(resp_msg.get());
+    }
 }
 
 /*extern*/ void start_http_server()
@@ -33,6 +33,9 @@ public:
     void serve(message_ex *msg);
 };
 
-extern void http_response_reply(const http_response &resp, message_ex *req);
+extern void http_response_reply(const http_response &resp,
+                                message_ex *req,
+                                bool keep_alive = true,
+                                const std::string &accept_encoding = "");
 
 } // namespace dsn
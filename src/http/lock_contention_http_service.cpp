@@ -0,0 +1,95 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/lock_contention_profiler.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/string_conv.h>
+
+#include "builtin_http_calls.h"
+
+namespace dsn {
+
+void get_lock_contention_handler(const http_request &req, http_response &resp)
+{
+    uint32_t seconds = 10;
+    uint32_t top = 20;
+    uint32_t hold_sample_interval = 100;
+    for (const auto &p : req.query_args) {
+        bool ok = false;
+        if ("seconds" == p.first) {
+            ok = buf2uint32(p.second, seconds) && seconds > 0 && seconds <= 600;
+        } else if ("top" == p.first) {
+            ok = buf2uint32(p.second, top);
+        } else if ("hold_sample_interval" == p.first) {
+            ok = buf2uint32(p.second, hold_sample_interval) && hold_sample_interval > 0;
+        }
+        if (!ok) {
+            resp.status_code = http_status_code::bad_request;
+            return;
+        }
+    }
+
+    static std::atomic_bool in_profiling{false};
+    bool expected = false;
+    if (!in_profiling.compare_exchange_strong(expected, true)) {
+        dwarn_f("node is already profiling lock contention, please wait and retry");
+        resp.status_code = http_status_code::internal_server_error;
+        return;
+    }
+
+    ddebug_f("start profiling lock contention for {} seconds", seconds);
+    utils::lock_contention_profiler::start(hold_sample_interval);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    utils::lock_contention_profiler::stop();
+    auto sites = utils::lock_contention_profiler::top_sites(top);
+    uint64_t dropped = utils::lock_contention_profiler::dropped_count();
+    in_profiling.store(false);
+
+    utils::table_printer tp("lock_contention");
+    tp.add_title("call_site");
+    tp.add_column("contended_count", utils::table_printer::alignment::kRight);
+    tp.add_column("total_wait_us", utils::table_printer::alignment::kRight);
+    tp.add_column("max_wait_us", utils::table_printer::alignment::kRight);
+    tp.add_column("sampled_hold_count", utils::table_printer::alignment::kRight);
+    tp.add_column("avg_hold_us", utils::table_printer::alignment::kRight);
+    tp.add_column("max_hold_us", utils::table_printer::alignment::kRight);
+    for (const auto &site : sites) {
+        tp.add_row(site.symbol);
+        tp.append_data(site.contended_count);
+        tp.append_data(site.total_wait_ns / 1000);
+        tp.append_data(site.max_wait_ns / 1000);
+        tp.append_data(site.sampled_hold_count);
+        tp.append_data(site.sampled_hold_count == 0
+                           ? 0.0
+                           : site.total_sampled_hold_ns / 1000.0 / site.sampled_hold_count);
+        tp.append_data(site.max_hold_ns / 1000);
+    }
+    if (dropped > 0) {
+        dwarn_f("{} lock contention records are dropped for too many call sites", dropped);
+    }
+
+    std::ostringstream out;
+    tp.output(out, utils::table_printer::output_format::kJsonCompact);
+    resp.body = out.str();
+    resp.status_code = http_status_code::ok;
+}
+} // namespace dsn
@@ -54,4 +54,11 @@ void get_perf_counter_handler(const http_request &req, http_response &resp)
     resp.body = out.str();
     resp.status_code = http_status_code::ok;
 }
+
+void get_prometheus_metrics_handler(const http_request &req, http_response &resp)
+{
+    perf_counters::instance().dump_prometheus(resp.body);
+    resp.content_type = "text/plain; version=0.0.4";
+    resp.status_code = http_status_code::ok;
+}
 } // namespace dsn
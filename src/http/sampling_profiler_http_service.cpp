@@ -0,0 +1,46 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/toollet/sampling_profiler.h>
+#include <dsn/utility/string_conv.h>
+
+#include "builtin_http_calls.h"
+
+namespace dsn {
+
+void get_sampling_profile_handler(const http_request &req, http_response &resp)
+{
+    uint32_t seconds = 60;
+    for (const auto &p : req.query_args) {
+        if ("seconds" != p.first || !buf2uint32(p.second, seconds) || seconds == 0) {
+            resp.status_code = http_status_code::bad_request;
+            return;
+        }
+    }
+
+    if (!tools::sampling_profiler::installed()) {
+        resp.body = "the sampling_profiler toollet is not enabled in [core] toollets";
+        resp.status_code = http_status_code::internal_server_error;
+        return;
+    }
+
+    resp.body = tools::sampling_profiler::get_profile(seconds);
+    resp.content_type = "application/octet-stream";
+    resp.status_code = http_status_code::ok;
+}
+} // namespace dsn
@@ -255,6 +255,47 @@ TEST_F(http_message_parser_test, eof)
 
 TEST_F(http_message_parser_test, parse_bad_request) { parse_bad_request(); }
 
+TEST_F(http_message_parser_test, parse_request_in_pieces)
+{
+    // the requests are pipelined, and the second one is received in two pieces
+    std::string first = "GET /first HTTP/1.1\r\n"
+                        "Accept-Encoding: gzip, deflate\r\n"
+                        "\r\n"
+                        "POST /second HTTP/1.0\r\n"
+                        "Content-Length: 10\r\n"
+                        "\r\n"
+                        "01234";
+    std::string second = "56789";
+
+    message_reader reader(64);
+    char *buf = reader.read_buffer_ptr(first.size());
+    memcpy(buf, first.data(), first.size());
+    reader.mark_read(first.size());
+
+    http_message_parser parser;
+    int read_next = 0;
+    message_ptr msg = parser.get_message_on_receive(&reader, read_next);
+    ASSERT_NE(msg, nullptr);
+    ASSERT_EQ(msg->buffers[2].to_string(), "/first");
+    ASSERT_EQ(msg->buffers[4].to_string(), "gzip, deflate");
+    ASSERT_EQ(msg->buffers[5].to_string(), ""); // kept alive by default
+    ASSERT_EQ(msg->header->id, 0);
+    ASSERT_EQ(parser.get_message_on_receive(&reader, read_next), nullptr);
+
+    buf = reader.read_buffer_ptr(second.size());
+    memcpy(buf, second.data(), second.size());
+    reader.mark_read(second.size());
+
+    msg = parser.get_message_on_receive(&reader, read_next);
+    ASSERT_NE(msg, nullptr);
+    ASSERT_EQ(msg->header->hdr_type, http_method::HTTP_METHOD_POST);
+    ASSERT_EQ(msg->buffers[1].to_string(), "0123456789");
+    ASSERT_EQ(msg->buffers[2].to_string(), "/second");
+    ASSERT_EQ(msg->buffers[5].to_string(), "close"); // HTTP/1.0 without keep-alive
+    ASSERT_EQ(msg->header->id, 1);
+    ASSERT_EQ(reader._buffer_occupied, 0);
+}
+
 TEST_F(http_message_parser_test, parse_multiple_requests) { parse_multiple_requests(); }
 
 TEST_F(http_message_parser_test, parse_long_url)
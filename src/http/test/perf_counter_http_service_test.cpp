@@ -18,11 +18,15 @@
 #include <gtest/gtest.h>
 #include <dsn/perf_counter/perf_counters.h>
 #include <dsn/http/http_server.h>
+#include <dsn/utility/flags.h>
 
 #include "http/builtin_http_calls.h"
+#include "perf_counter/perf_counter_histogram.h"
 
 namespace dsn {
 
+DSN_DECLARE_uint32(prometheus_snapshot_max_age_seconds);
+
 TEST(perf_counter_http_service_test, get_perf_counter)
 {
     struct test_case
@@ -70,4 +74,61 @@ TEST(perf_counter_http_service_test, get_perf_counter)
         ASSERT_EQ(fake_resp.body, fake_json);
     }
 }
+
+TEST(perf_counter_http_service_test, get_prometheus_metrics)
+{
+    uint32_t old_max_age = FLAGS_prometheus_snapshot_max_age_seconds;
+    FLAGS_prometheus_snapshot_max_age_seconds = 0;
+
+    perf_counter_wrapper partition_counter;
+    partition_counter.init_global_counter(
+        "replica", "prometheus", "get_qps@2.5", COUNTER_TYPE_NUMBER, "partition counter");
+    partition_counter->set(10);
+    perf_counter_wrapper table_counter;
+    table_counter.init_global_counter(
+        "replica", "prometheus", "get_qps@temp", COUNTER_TYPE_NUMBER, "table counter");
+    table_counter->set(20);
+    perf_counter_wrapper latency_counter;
+    latency_counter.init_global_counter(
+        "replica", "prometheus", "get_latency", COUNTER_TYPE_NUMBER_PERCENTILES, "latency");
+    for (int64_t v = 1; v <= 100; ++v) {
+        latency_counter->set(v);
+    }
+    auto *histogram =
+        dynamic_cast<perf_counter_number_percentile_histogram *>(latency_counter.get());
+    ASSERT_NE(nullptr, histogram);
+    histogram->calc();
+
+    http_request fake_req;
+    http_response fake_resp;
+    get_prometheus_metrics_handler(fake_req, fake_resp);
+    ASSERT_EQ(fake_resp.status_code, http_status_code::ok);
+    ASSERT_EQ(fake_resp.content_type, "text/plain; version=0.0.4");
+
+    const std::string &body = fake_resp.body;
+    const std::string labels = R"(app="replica",section="prometheus")";
+    // the counters of a name are grouped after a single TYPE line
+    size_t type_pos = body.find("# TYPE get_qps gauge\n");
+    ASSERT_NE(std::string::npos, type_pos);
+    ASSERT_EQ(std::string::npos, body.find("# TYPE get_qps gauge\n", type_pos + 1));
+    size_t partition_pos =
+        body.find("get_qps{" + labels + R"(,app_id="2",partition_index="5"} 10)" + "\n");
+    size_t table_pos = body.find("get_qps{" + labels + R"(,table="temp"} 20)" + "\n");
+    ASSERT_NE(std::string::npos, partition_pos);
+    ASSERT_NE(std::string::npos, table_pos);
+    ASSERT_LT(type_pos, std::min(partition_pos, table_pos));
+
+    // the histogram has a bucket per power of two
+    ASSERT_NE(std::string::npos, body.find("# TYPE get_latency histogram\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("get_latency_bucket{" + labels + R"(,le="31"} 31)" + "\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("get_latency_bucket{" + labels + R"(,le="127"} 100)" + "\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("get_latency_bucket{" + labels + R"(,le="+Inf"} 100)" + "\n"));
+    ASSERT_NE(std::string::npos, body.find("get_latency_sum{" + labels + "} 5050\n"));
+    ASSERT_NE(std::string::npos, body.find("get_latency_count{" + labels + "} 100\n"));
+
+    FLAGS_prometheus_snapshot_max_age_seconds = old_max_age;
+}
 } // namespace dsn
@@ -0,0 +1,38 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/tool-api/command_manager.h>
+#include "builtin_http_calls.h"
+
+namespace dsn {
+
+void get_thread_pool_stats_handler(const http_request &req, http_response &resp)
+{
+    if (!req.query_args.empty()) {
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    // the stats are maintained by the runtime, reuse the remote command to avoid
+    // depending on the task engine directly
+    if (!command_manager::instance().run_command("thread-pool-stats", {"json"}, resp.body)) {
+        resp.status_code = http_status_code::not_found;
+        return;
+    }
+    resp.status_code = http_status_code::ok;
+}
+} // namespace dsn
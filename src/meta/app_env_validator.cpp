@@ -114,6 +114,26 @@ bool check_throttling(const std::string &env_value, std::string &hint_message)
     return true;
 }
 
+bool check_quota(const std::string &env_value, std::string &hint_message)
+{
+    int64_t quota = 0;
+    if (!buf2int64(env_value, quota) || quota <= 0) {
+        hint_message = "The quota must be a positive int";
+        return false;
+    }
+    return true;
+}
+
+bool check_read_replica_count(const std::string &env_value, std::string &hint_message)
+{
+    int32_t count = 0;
+    if (!buf2int32(env_value, count) || count < 0) {
+        hint_message = "The read replica count must be a non-negative int";
+        return false;
+    }
+    return true;
+}
+
 bool check_split_validation(const std::string &env_value, std::string &hint_message)
 {
     bool result = false;
@@ -173,7 +193,15 @@ void app_env_validator::register_all_validators()
         {replica_envs::READ_QPS_THROTTLING,
          std::bind(&check_throttling, std::placeholders::_1, std::placeholders::_2)},
         {replica_envs::SPLIT_VALIDATE_PARTITION_HASH,
-         std::bind(&check_split_validation, std::placeholders::_1, std::placeholders::_2)}};
+         std::bind(&check_split_validation, std::placeholders::_1, std::placeholders::_2)},
+        {replica_envs::WRITE_QPS_QUOTA,
+         std::bind(&check_quota, std::placeholders::_1, std::placeholders::_2)},
+        {replica_envs::WRITE_SIZE_QUOTA,
+         std::bind(&check_quota, std::placeholders::_1, std::placeholders::_2)},
+        {replica_envs::READ_QPS_QUOTA,
+         std::bind(&check_quota, std::placeholders::_1, std::placeholders::_2)},
+        {replica_envs::READ_REPLICA_COUNT,
+         std::bind(&check_read_replica_count, std::placeholders::_1, std::placeholders::_2)}};
 }
 
 } // namespace replication
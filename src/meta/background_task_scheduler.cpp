@@ -0,0 +1,227 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "background_task_scheduler.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+#include <algorithm>
+#include <vector>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("meta_server",
+                  background_task_max_per_node,
+                  2,
+                  "the max count of the background tasks of one type (e.g. checkpoint) running "
+                  "on a replica server at the same time");
+DSN_TAG_VARIABLE(background_task_max_per_node, FT_MUTABLE);
+DSN_DEFINE_validator(background_task_max_per_node, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_uint32("meta_server",
+                  background_task_max_per_app,
+                  16,
+                  "the max count of the background tasks of one type running in a table at the "
+                  "same time");
+DSN_TAG_VARIABLE(background_task_max_per_app, FT_MUTABLE);
+DSN_DEFINE_validator(background_task_max_per_app, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_uint32("meta_server",
+                  background_task_lease_seconds,
+                  3600,
+                  "a granted background task is released if it's not done within the lease");
+DSN_DEFINE_uint32("meta_server",
+                  background_task_wait_seconds,
+                  300,
+                  "a secondary denied recently blocks the primary of its partition from being "
+                  "granted, until it hasn't asked again for this long");
+
+void background_task_scheduler::on_request(const background_task_request &request,
+                                           const partition_configuration &config,
+                                           uint64_t now_ms,
+                                           background_task_response &response)
+{
+    response.err = ERR_OK;
+    response.granted = false;
+    response.lease_seconds = FLAGS_background_task_lease_seconds;
+
+    partition_task task(request.pid, request.type);
+    zauto_lock l(_lock);
+    remove_expired(now_ms);
+
+    if (request.release) {
+        remove_running(task, request.node);
+        return;
+    }
+
+    uint64_t expire_ms = now_ms + FLAGS_background_task_lease_seconds * 1000ULL;
+    auto running = _running.find(task);
+    if (running != _running.end()) {
+        auto node = running->second.find(request.node);
+        if (node != running->second.end()) {
+            // granted already, renew the lease
+            node->second = expire_ms;
+            response.granted = true;
+            return;
+        }
+    }
+
+    const char *blocked_by = check(request, config);
+    if (blocked_by != nullptr) {
+        dinfo_f("deny background task {} of {}@{}: {}",
+                enum_to_string(request.type),
+                request.pid,
+                request.node,
+                blocked_by);
+        if (config.primary != request.node) {
+            _waiting[task][request.node] = now_ms + FLAGS_background_task_wait_seconds * 1000ULL;
+        }
+        return;
+    }
+
+    auto waiting = _waiting.find(task);
+    if (waiting != _waiting.end()) {
+        waiting->second.erase(request.node);
+        if (waiting->second.empty()) {
+            _waiting.erase(waiting);
+        }
+    }
+    _running[task][request.node] = expire_ms;
+    ++_node_counts[std::make_pair(request.node, request.type)];
+    ++_app_counts[std::make_pair(request.pid.get_app_id(), request.type)];
+    response.granted = true;
+    ddebug_f("grant background task {} to {}@{}",
+             enum_to_string(request.type),
+             request.pid,
+             request.node);
+}
+
+const char *background_task_scheduler::check(const background_task_request &request,
+                                             const partition_configuration &config) const
+{
+    bool is_primary = config.primary == request.node;
+    if (!is_primary && std::find(config.secondaries.begin(),
+                                 config.secondaries.end(),
+                                 request.node) == config.secondaries.end()) {
+        return "not a member of the partition";
+    }
+
+    partition_task task(request.pid, request.type);
+    auto running = _running.find(task);
+    size_t partition_running = running == _running.end() ? 0 : running->second.size();
+    size_t member_count = config.secondaries.size() + (config.primary.is_invalid() ? 0 : 1);
+    if (partition_running + 1 >= std::max<size_t>(member_count, 2)) {
+        return "the other replicas of the partition are running it";
+    }
+
+    auto node_count = _node_counts.find(std::make_pair(request.node, request.type));
+    if (node_count != _node_counts.end() &&
+        node_count->second >= FLAGS_background_task_max_per_node) {
+        return "too many tasks on the node";
+    }
+
+    auto app_count = _app_counts.find(std::make_pair(request.pid.get_app_id(), request.type));
+    if (app_count != _app_counts.end() && app_count->second >= FLAGS_background_task_max_per_app) {
+        return "too many tasks in the table";
+    }
+
+    if (is_primary) {
+        auto waiting = _waiting.find(task);
+        if (waiting != _waiting.end()) {
+            for (const auto &kv : waiting->second) {
+                if (std::find(config.secondaries.begin(), config.secondaries.end(), kv.first) !=
+                    config.secondaries.end()) {
+                    return "the secondaries of the partition are waiting";
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+void background_task_scheduler::remove_running(const partition_task &task,
+                                               const rpc_address &node)
+{
+    auto running = _running.find(task);
+    if (running == _running.end() || running->second.erase(node) == 0) {
+        return;
+    }
+    if (running->second.empty()) {
+        _running.erase(running);
+    }
+
+    auto node_count = _node_counts.find(std::make_pair(node, task.second));
+    if (--node_count->second == 0) {
+        _node_counts.erase(node_count);
+    }
+    auto app_count = _app_counts.find(std::make_pair(task.first.get_app_id(), task.second));
+    if (--app_count->second == 0) {
+        _app_counts.erase(app_count);
+    }
+}
+
+void background_task_scheduler::remove_expired(uint64_t now_ms)
+{
+    std::vector<std::pair<partition_task, rpc_address>> expired;
+    for (const auto &kv : _running) {
+        for (const auto &node : kv.second) {
+            if (node.second <= now_ms) {
+                expired.emplace_back(kv.first, node.first);
+            }
+        }
+    }
+    for (const auto &e : expired) {
+        dwarn_f("the background task {} of {}@{} is expired",
+                enum_to_string(e.first.second),
+                e.first.first,
+                e.second);
+        remove_running(e.first, e.second);
+    }
+
+    for (auto it = _waiting.begin(); it != _waiting.end();) {
+        for (auto node = it->second.begin(); node != it->second.end();) {
+            if (node->second <= now_ms) {
+                node = it->second.erase(node);
+            } else {
+                ++node;
+            }
+        }
+        if (it->second.empty()) {
+            it = _waiting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t background_task_scheduler::running_count(background_task_type::type type) const
+{
+    zauto_lock l(_lock);
+    size_t count = 0;
+    for (const auto &kv : _running) {
+        if (kv.first.second == type) {
+            count += kv.second.size();
+        }
+    }
+    return count;
+}
+
+} // namespace replication
+} // namespace dsn
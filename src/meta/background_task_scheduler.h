@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/dist/replication/replication_other_types.h>
+#include <dsn/tool-api/zlocks.h>
+#include <map>
+#include <set>
+
+namespace dsn {
+namespace replication {
+
+// Coordinates the heavy background tasks of the replicas (the checkpoints and the manual
+// compactions) across the cluster. A replica asks for a grant before it starts such a task and
+// releases it when the task is done. For each type of the tasks:
+// - at most [meta_server] background_task_max_per_node tasks run on a node, and at most
+//   background_task_max_per_app ones in a table,
+// - one replica of each partition is always left out, so a partition never slows down on all
+//   its replicas at the same time,
+// - the primary goes last, it's not granted while a secondary of the partition is waiting.
+//
+// A grant expires after background_task_lease_seconds if it's never released, e.g. the replica
+// is moved or the node is down.
+//
+// thread safe
+class background_task_scheduler
+{
+public:
+    // handles the grant and release request of a replica, `config` is the current
+    // configuration of the partition
+    void on_request(const background_task_request &request,
+                    const partition_configuration &config,
+                    uint64_t now_ms,
+                    /*out*/ background_task_response &response);
+
+    // all the running tasks, for test and diagnosis
+    size_t running_count(background_task_type::type type) const;
+
+private:
+    typedef std::pair<gpid, background_task_type::type> partition_task;
+    typedef std::map<rpc_address, uint64_t> node_expires;
+
+    void remove_expired(uint64_t now_ms);
+    void remove_running(const partition_task &task, const rpc_address &node);
+
+    // the rule the grant is blocked by, nullptr if it can be granted
+    const char *check(const background_task_request &request,
+                      const partition_configuration &config) const;
+
+    mutable zlock _lock;
+    // the replicas running the task, with the expire time of their grants
+    std::map<partition_task, node_expires> _running;
+    // the secondaries denied recently, which are granted before the primary. They are
+    // forgotten if they don't ask again within the lease.
+    std::map<partition_task, node_expires> _waiting;
+    std::map<std::pair<rpc_address, background_task_type::type>, int> _node_counts;
+    std::map<std::pair<int32_t, background_task_type::type>, int> _app_counts;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -118,38 +118,69 @@ void duplication_info::init_progress(int partition_index, decree d)
 }
 
 bool duplication_info::alter_progress(int partition_index, decree d)
+{
+    zauto_write_lock l(_lock);
+    return alter_progress_unlocked(partition_index, d);
+}
+
+bool duplication_info::alter_progress(const std::vector<std::pair<int, decree>> &progress)
 {
     zauto_write_lock l(_lock);
 
+    bool altered = false;
+    for (const auto &p : progress) {
+        altered |= alter_progress_unlocked(p.first, p.second);
+    }
+    return altered;
+}
+
+bool duplication_info::alter_progress_unlocked(int partition_index, decree d)
+{
     partition_progress &p = _progress[partition_index];
     if (!p.is_inited) {
         return false;
     }
-    if (p.is_altering) {
+    if (p.volatile_decree >= d) {
         return false;
     }
-    if (p.volatile_decree < d) {
-        p.volatile_decree = d;
+    // the progress keeps fresh in memory even if it's being persisted
+    p.volatile_decree = d;
+    return true;
+}
+
+std::vector<duplication_info::progress_update> duplication_info::progress_to_persist()
+{
+    zauto_write_lock l(_lock);
+
+    std::vector<progress_update> updates;
+    // progress update is not supposed to be too frequent.
+    uint64_t now = dsn_now_ms();
+    if (now <= _last_progress_update_ms + PROGRESS_UPDATE_PERIOD_MS) {
+        return updates;
     }
-    if (p.volatile_decree != p.stored_decree) {
-        // progress update is not supposed to be too frequent.
-        if (dsn_now_ms() > p.last_progress_update_ms + PROGRESS_UPDATE_PERIOD_MS) {
-            p.is_altering = true;
-            p.last_progress_update_ms = dsn_now_ms();
-            return true;
+    for (auto &kv : _progress) {
+        partition_progress &p = kv.second;
+        if (!p.is_inited || p.is_altering || p.volatile_decree == p.stored_decree) {
+            continue;
         }
+        p.is_altering = true;
+        // the progress node is created when the progress is persisted the first time
+        updates.push_back({kv.first, p.volatile_decree, p.stored_decree != invalid_decree});
     }
-    return false;
+    if (!updates.empty()) {
+        _last_progress_update_ms = now;
+    }
+    return updates;
 }
 
-void duplication_info::persist_progress(int partition_index)
+void duplication_info::persist_progress(int partition_index, decree d)
 {
     zauto_write_lock l(_lock);
 
     auto &p = _progress[partition_index];
     dassert_dup(p.is_altering, this, "partition_index: {}", partition_index);
     p.is_altering = false;
-    p.stored_decree = p.volatile_decree;
+    p.stored_decree = d;
 }
 
 void duplication_info::persist_status()
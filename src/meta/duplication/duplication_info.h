@@ -24,6 +24,7 @@
 #include <dsn/tool-api/zlocks.h>
 
 #include <utility>
+#include <vector>
 #include <fmt/format.h>
 
 namespace dsn {
@@ -82,14 +83,34 @@ public:
     bool is_valid() const { return is_duplication_status_valid(_status); }
 
     ///
-    /// alter_progress -> persist_progress
+    /// alter_progress -> progress_to_persist -> persist_progress
     ///
 
-    // Returns: false if `d` is not supposed to be persisted,
-    //          maybe because meta storage is busy or `d` is stale.
+    // Updates the in-memory progress of the partition, which is persisted later
+    // together with the other partitions of this duplication.
+    // Returns: false if `d` is stale or the partition is not initialized.
     bool alter_progress(int partition_index, decree d);
 
-    void persist_progress(int partition_index);
+    // Updates the in-memory progress of several partitions under one lock acquisition, which are
+    // <partition_index, decree> pairs.
+    // Returns: false if none of them is updated.
+    bool alter_progress(const std::vector<std::pair<int, decree>> &progress);
+
+    struct progress_update
+    {
+        int partition_index;
+        decree confirmed;
+        // whether the progress node of this partition exists on meta storage
+        bool is_stored;
+    };
+
+    // Returns the progress of all partitions changed since they were persisted, which should
+    // be persisted in a batch. It returns nothing if the progress was persisted
+    // in the recent PROGRESS_UPDATE_PERIOD_MS.
+    std::vector<progress_update> progress_to_persist();
+
+    // `d` is the decree that has been persisted for the partition.
+    void persist_progress(int partition_index, decree d);
 
     void init_progress(int partition_index, decree confirmed);
 
@@ -140,6 +161,8 @@ public:
     std::string to_string() const;
 
 private:
+    bool alter_progress_unlocked(int partition_index, decree d);
+
     friend class duplication_info_test;
     friend class meta_duplication_service_test;
 
@@ -156,13 +179,14 @@ private:
         int64_t volatile_decree{invalid_decree};
         int64_t stored_decree{invalid_decree};
         bool is_altering{false};
-        uint64_t last_progress_update_ms{0};
         bool is_inited{false};
     };
 
     // partition_idx => progress
     std::map<int, partition_progress> _progress;
 
+    uint64_t _last_progress_update_ms{0};
+
     uint64_t _last_progress_report_ms{0};
 
     duplication_status::type _status{duplication_status::DS_INIT};
@@ -270,6 +270,11 @@ void meta_duplication_service::duplication_sync(duplication_sync_rpc rpc)
     }
 
     /// update progress
+    // the confirmed decrees of a duplication are grouped to be applied in memory under one lock
+    // acquisition, and then persisted in a batch
+    std::map<std::pair<int32_t, dupid_t>,
+             std::pair<duplication_info_s_ptr, std::vector<std::pair<int, decree>>>>
+        confirmed_dups;
     for (const auto &kv : request.confirm_list) {
         gpid gpid = kv.first;
 
@@ -293,10 +298,89 @@ void meta_duplication_service::duplication_sync(duplication_sync_rpc rpc)
             if (!dup->is_valid()) {
                 continue;
             }
-            do_update_partition_confirmed(
-                dup, rpc, gpid.get_partition_index(), confirm.confirmed_decree);
+            auto &confirmed = confirmed_dups[std::make_pair(dup->app_id, dup->id)];
+            confirmed.first = dup;
+            confirmed.second.emplace_back(gpid.get_partition_index(), confirm.confirmed_decree);
         }
     }
+    for (auto &kv : confirmed_dups) {
+        duplication_info_s_ptr &dup = kv.second.first;
+        if (dup->alter_progress(kv.second.second)) {
+            do_update_partitions_confirmed(dup, rpc, dup->progress_to_persist());
+        }
+    }
+}
+
+void meta_duplication_service::do_update_partitions_confirmed(
+    duplication_info_s_ptr &dup,
+    duplication_sync_rpc &rpc,
+    std::vector<duplication_info::progress_update> updates)
+{
+    if (updates.empty()) {
+        return;
+    }
+    if (updates.size() == 1) {
+        do_update_partition_confirmed(dup, rpc, updates[0].partition_index, updates[0].confirmed);
+        return;
+    }
+
+    // the progress of the partitions changed since the last time are written in one
+    // transaction, rather than one write per partition
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    auto entries = storage->new_transaction_entries(static_cast<unsigned int>(updates.size()));
+    for (const auto &u : updates) {
+        std::string path = get_partition_path(dup, std::to_string(u.partition_index));
+        blob value = blob::create_from_bytes(std::to_string(u.confirmed));
+        error_code ec =
+            u.is_stored ? entries->set_data(path, value) : entries->create_node(path, value);
+        dassert_dup(ec == ERR_OK, dup, "add {} to transaction failed: {}", path, ec.to_string());
+    }
+
+    storage->submit_transaction(
+        entries,
+        LPC_META_STATE_HIGH,
+        [this, dup, rpc, updates](error_code ec) mutable {
+            if (ec == ERR_OK) {
+                for (const auto &u : updates) {
+                    dup->persist_progress(u.partition_index, u.confirmed);
+                    rpc.response().dup_map[dup->app_id][dup->id].progress[u.partition_index] =
+                        u.confirmed;
+                }
+            } else if (ec == ERR_TIMEOUT) {
+                dwarn_dup(dup,
+                          "persist progress of {} partitions timeout, retry after 1 second",
+                          updates.size());
+                tasking::enqueue(LPC_META_STATE_HIGH,
+                                 _meta_svc->tracker(),
+                                 [this, dup, rpc, updates]() mutable {
+                                     do_update_partitions_confirmed(dup, rpc, std::move(updates));
+                                 },
+                                 0,
+                                 1_s);
+            } else if (ec == ERR_NODE_ALREADY_EXIST || ec == ERR_OBJECT_NOT_FOUND) {
+                // the progress nodes don't exist as supposed, which rejects the transaction as
+                // a whole, so every partition finds out its node and is written alone
+                dwarn_dup(dup,
+                          "persist progress of {} partitions in a transaction failed: {}, "
+                          "write them one by one",
+                          updates.size(),
+                          ec.to_string());
+                for (const auto &u : updates) {
+                    do_update_partition_confirmed(dup, rpc, u.partition_index, u.confirmed);
+                }
+            } else {
+                dassert_dup(false,
+                            dup,
+                            "persist progress of {} partitions encountered an unexpected "
+                            "error: {}",
+                            updates.size(),
+                            ec.to_string());
+            }
+        },
+        _meta_svc->tracker());
+
+    // duplication_sync_rpc will finally be replied when confirmed points
+    // of all partitions are stored.
 }
 
 void meta_duplication_service::do_update_partition_confirmed(duplication_info_s_ptr &dup,
@@ -304,31 +388,29 @@ void meta_duplication_service::do_update_partition_confirmed(duplication_info_s_
                                                              int32_t partition_idx,
                                                              int64_t confirmed_decree)
 {
-    if (dup->alter_progress(partition_idx, confirmed_decree)) {
-        std::string path = get_partition_path(dup, std::to_string(partition_idx));
-        blob value = blob::create_from_bytes(std::to_string(confirmed_decree));
-
-        _meta_svc->get_meta_storage()->get_data(std::string(path), [=](const blob &data) mutable {
-            if (data.length() == 0) {
-                _meta_svc->get_meta_storage()->create_node(
-                    std::string(path), std::move(value), [=]() mutable {
-                        dup->persist_progress(partition_idx);
-                        rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
-                            confirmed_decree;
-                    });
-            } else {
-                _meta_svc->get_meta_storage()->set_data(
-                    std::string(path), std::move(value), [=]() mutable {
-                        dup->persist_progress(partition_idx);
-                        rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
-                            confirmed_decree;
-                    });
-            }
+    std::string path = get_partition_path(dup, std::to_string(partition_idx));
+    blob value = blob::create_from_bytes(std::to_string(confirmed_decree));
+
+    _meta_svc->get_meta_storage()->get_data(std::string(path), [=](const blob &data) mutable {
+        if (data.length() == 0) {
+            _meta_svc->get_meta_storage()->create_node(
+                std::string(path), std::move(value), [=]() mutable {
+                    dup->persist_progress(partition_idx, confirmed_decree);
+                    rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
+                        confirmed_decree;
+                });
+        } else {
+            _meta_svc->get_meta_storage()->set_data(
+                std::string(path), std::move(value), [=]() mutable {
+                    dup->persist_progress(partition_idx, confirmed_decree);
+                    rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
+                        confirmed_decree;
+                });
+        }
 
-            // duplication_sync_rpc will finally be replied when confirmed points
-            // of all partitions are stored.
-        });
-    }
+        // duplication_sync_rpc will finally be replied when confirmed points
+        // of all partitions are stored.
+    });
 }
 
 std::shared_ptr<duplication_info>
@@ -75,6 +75,11 @@ private:
     void get_all_available_app(const node_state &ns,
                                std::map<int32_t, std::shared_ptr<app_state>> &app_map) const;
 
+    // persists the progress `updates` of the partitions of `dup`
+    void do_update_partitions_confirmed(duplication_info_s_ptr &dup,
+                                        duplication_sync_rpc &rpc,
+                                        std::vector<duplication_info::progress_update> updates);
+
     void do_update_partition_confirmed(duplication_info_s_ptr &dup,
                                        duplication_sync_rpc &rpc,
                                        int32_t partition_idx,
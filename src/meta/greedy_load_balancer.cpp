@@ -28,21 +28,57 @@
 #include <iostream>
 #include <queue>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/math.h>
 #include <dsn/dist/fmt_logging.h>
 #include "greedy_load_balancer.h"
 #include "meta_data.h"
 #include "meta_admin_types.h"
+#include "server_state.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  balancer_full_round_interval,
+                  10,
+                  "every how many rounds the balancer evaluates again the apps found balanced "
+                  "and not changed since then, 0 means the apps are always evaluated");
+DSN_TAG_VARIABLE(balancer_full_round_interval, FT_MUTABLE);
+
+DSN_DEFINE_bool("meta_server",
+                balancer_load_aware_enabled,
+                false,
+                "whether the balancer moves primaries by the load they report, which needs "
+                "[replication].partition_usage_report_enabled on the replica servers");
+DSN_TAG_VARIABLE(balancer_load_aware_enabled, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  balancer_load_imbalance_percent,
+                  120,
+                  "the primaries are moved off a node whose load exceeds this percent of the "
+                  "average load of the nodes");
+DSN_TAG_VARIABLE(balancer_load_imbalance_percent, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  balancer_load_max_moves_per_round,
+                  2,
+                  "the max count of primaries the balancer moves by load in a round");
+DSN_TAG_VARIABLE(balancer_load_max_moves_per_round, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  balancer_load_bytes_per_request,
+                  4096,
+                  "how many bytes written weigh as much as one request in the load of a primary");
+DSN_TAG_VARIABLE(balancer_load_bytes_per_request, FT_MUTABLE);
+DSN_DEFINE_validator(balancer_load_bytes_per_request, [](uint32_t value) -> bool {
+    return value > 0;
+});
+
 greedy_load_balancer::greedy_load_balancer(meta_service *_svc)
     : simple_load_balancer(_svc),
       _ctrl_balancer_in_turn(nullptr),
       _ctrl_only_primary_balancer(nullptr),
       _ctrl_only_move_primary(nullptr),
-      _get_balance_operation_count(nullptr)
+      _get_balance_operation_count(nullptr),
+      _rounds_since_full_round(0)
 {
     if (_svc != nullptr) {
         _balancer_in_turn = _svc->get_meta_options()._lb_opts.balancer_in_turn;
@@ -76,6 +112,16 @@ greedy_load_balancer::greedy_load_balancer(meta_service *_svc)
         "recent_balance_copy_secondary_count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "copy secondary count by balancer in the recent period");
+    _balance_round_duration_ms.init_app_counter("eon.greedy_balancer",
+                                                "balance_round_duration_ms",
+                                                COUNTER_TYPE_NUMBER,
+                                                "duration of the last balancer round in ms");
+    _recent_balance_skipped_app_count.init_app_counter(
+        "eon.greedy_balancer",
+        "recent_balance_skipped_app_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "apps skipped by balancer coz they're unchanged since found balanced, in the recent "
+        "period");
 }
 
 greedy_load_balancer::~greedy_load_balancer()
@@ -820,11 +866,21 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
     dassert(t_alive_nodes > 2, "too few nodes will be freezed");
     number_nodes(*t_global_view->nodes);
 
+    uint64_t nodes_fingerprint = 0;
     for (auto &kv : *(t_global_view->nodes)) {
         node_state &ns = kv.second;
         if (!all_replica_infos_collected(ns)) {
             return;
         }
+        // independent of the iteration order
+        nodes_fingerprint += std::hash<rpc_address>()(kv.first) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    if (FLAGS_balancer_full_round_interval == 0 ||
+        ++_rounds_since_full_round >= FLAGS_balancer_full_round_interval) {
+        _rounds_since_full_round = 0;
+        _primary_balanced_apps.clear();
+        _secondary_balanced_apps.clear();
     }
 
     for (const auto &kv : apps) {
@@ -836,7 +892,20 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         if (app->status != app_status::AS_AVAILABLE || app->is_bulk_loading || app->splitting())
             continue;
 
+        uint64_t fingerprint = app_fingerprint(*app, nodes_fingerprint);
+        auto balanced = _primary_balanced_apps.find(kv.first);
+        if (balanced != _primary_balanced_apps.end() && balanced->second == fingerprint) {
+            _recent_balance_skipped_app_count->increment();
+            continue;
+        }
+
+        size_t action_count = t_migration_result->size();
         bool enough_information = primary_balancer_per_app(app);
+        if (enough_information && t_migration_result->size() == action_count) {
+            _primary_balanced_apps[kv.first] = fingerprint;
+        } else {
+            _primary_balanced_apps.erase(kv.first);
+        }
         if (!enough_information) {
             // Even if we don't have enough info for current app,
             // the decisions made by previous apps are kept.
@@ -883,7 +952,20 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         if (app->status != app_status::AS_AVAILABLE || app->is_bulk_loading || app->splitting())
             continue;
 
+        uint64_t fingerprint = app_fingerprint(*app, nodes_fingerprint);
+        auto balanced = _secondary_balanced_apps.find(kv.first);
+        if (balanced != _secondary_balanced_apps.end() && balanced->second == fingerprint) {
+            _recent_balance_skipped_app_count->increment();
+            continue;
+        }
+
+        size_t action_count = t_migration_result->size();
         bool enough_information = copy_secondary_per_app(app);
+        if (enough_information && t_migration_result->size() == action_count) {
+            _secondary_balanced_apps[kv.first] = fingerprint;
+        } else {
+            _secondary_balanced_apps.erase(kv.first);
+        }
         if (!enough_information) {
             // Even if we don't have enough info for current app,
             // the decisions made by previous apps are kept.
@@ -900,6 +982,150 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
             }
         }
     }
+
+    // the primaries are moved by load only when the counts are balanced
+    if (balance_checker || t_migration_result->empty()) {
+        move_primary_by_load();
+    }
+}
+
+void greedy_load_balancer::move_primary_by_load()
+{
+    if (!FLAGS_balancer_load_aware_enabled || _svc == nullptr) {
+        return;
+    }
+
+    const app_mapper &apps = *(t_global_view->apps);
+    const node_mapper &nodes = *(t_global_view->nodes);
+    std::unordered_map<gpid, int64_t> primary_loads;
+    // only the alive nodes take the primaries, so the dead ones don't lower the average load
+    std::unordered_map<rpc_address, int64_t> node_loads;
+    for (const auto &kv : nodes) {
+        if (kv.second.alive()) {
+            node_loads[kv.first] = 0;
+        }
+    }
+
+    int64_t total_load = 0;
+    for (const auto &kv : apps) {
+        const std::shared_ptr<app_state> &app = kv.second;
+        if (app->status != app_status::AS_AVAILABLE || app->is_bulk_loading ||
+            app->splitting() || is_ignored_app(kv.first)) {
+            continue;
+        }
+        // the usages which are not reported again have expired and are not returned
+        std::vector<partition_quota> usages;
+        _svc->get_server_state()->get_partition_usages(*app, usages);
+        for (const partition_quota &usage : usages) {
+            const partition_configuration &pc = app->partitions[usage.pid.get_partition_index()];
+            auto node = node_loads.find(pc.primary);
+            if (node == node_loads.end()) {
+                continue;
+            }
+            int64_t load = usage.read_qps + usage.write_qps +
+                           usage.write_bytes_per_sec / FLAGS_balancer_load_bytes_per_request;
+            primary_loads[usage.pid] = load;
+            node->second += load;
+            total_load += load;
+        }
+    }
+    if (total_load == 0) {
+        return;
+    }
+
+    double average_load = static_cast<double>(total_load) / node_loads.size();
+    // the primary count changes of the planned moves: (app id, node) -> delta
+    std::map<std::pair<app_id, rpc_address>, int> primary_deltas;
+    auto primary_count = [&](app_id id, const rpc_address &node) {
+        return nodes.find(node)->second.primary_count(id) + primary_deltas[{id, node}];
+    };
+
+    for (uint32_t moves = 0; moves < FLAGS_balancer_load_max_moves_per_round; ++moves) {
+        auto hottest = std::max_element(
+            node_loads.begin(), node_loads.end(), [](const auto &n1, const auto &n2) {
+                return n1.second < n2.second;
+            });
+        if (hottest->second <= average_load * FLAGS_balancer_load_imbalance_percent / 100) {
+            break;
+        }
+
+        // the move which reduces the sum of the squared node loads the most
+        const partition_configuration *selected = nullptr;
+        rpc_address selected_target;
+        int64_t selected_gain = 0;
+        for (const auto &kv : primary_loads) {
+            const partition_configuration &pc = *get_config(apps, kv.first);
+            if (pc.primary != hottest->first || t_migration_result->count(kv.first) > 0) {
+                continue;
+            }
+            const app_state &app = *(apps.find(kv.first.get_app_id())->second);
+            int replicas_low = app.partition_count / t_alive_nodes;
+            int replicas_high = (app.partition_count + t_alive_nodes - 1) / t_alive_nodes;
+            if (primary_count(app.app_id, pc.primary) - 1 < replicas_low) {
+                continue;
+            }
+            for (const rpc_address &secondary : pc.secondaries) {
+                auto target = node_loads.find(secondary);
+                if (target == node_loads.end() ||
+                    primary_count(app.app_id, secondary) + 1 > replicas_high) {
+                    continue;
+                }
+                int64_t gain = kv.second * (hottest->second - target->second - kv.second);
+                if (gain > selected_gain) {
+                    selected = &pc;
+                    selected_target = secondary;
+                    selected_gain = gain;
+                }
+            }
+        }
+        if (selected == nullptr) {
+            break;
+        }
+
+        int64_t load = primary_loads[selected->pid];
+        ddebug_f("move primary of gpid({}) by load {} from {} (load {}) to {} (load {}), "
+                 "average load {}",
+                 selected->pid,
+                 load,
+                 hottest->first.to_string(),
+                 hottest->second,
+                 selected_target.to_string(),
+                 node_loads[selected_target],
+                 average_load);
+        t_migration_result->emplace(
+            selected->pid,
+            generate_balancer_request(
+                *selected, balance_type::move_primary, hottest->first, selected_target));
+        hottest->second -= load;
+        node_loads[selected_target] += load;
+        --primary_deltas[{selected->pid.get_app_id(), hottest->first}];
+        ++primary_deltas[{selected->pid.get_app_id(), selected_target}];
+        primary_loads.erase(selected->pid);
+    }
+}
+
+uint64_t greedy_load_balancer::app_fingerprint(const app_state &app,
+                                               uint64_t nodes_fingerprint) const
+{
+    uint64_t fingerprint = nodes_fingerprint ^ (static_cast<uint64_t>(app.app_id) << 32);
+    auto mix = [&fingerprint](uint64_t value) {
+        fingerprint = fingerprint * 1099511628211ULL + value;
+    };
+    for (const partition_configuration &pc : app.partitions) {
+        mix(static_cast<uint64_t>(pc.ballot));
+        mix(std::hash<rpc_address>()(pc.primary));
+        for (const rpc_address &secondary : pc.secondaries) {
+            mix(std::hash<rpc_address>()(secondary));
+        }
+    }
+    return fingerprint * 31 + (_only_move_primary ? 1 : 0);
+}
+
+void greedy_load_balancer::run_balancer_round(bool balance_checker)
+{
+    uint64_t start_ms = dsn_now_ms();
+    greedy_balancer(balance_checker);
+    _balance_round_duration_ms->set(dsn_now_ms() - start_ms);
 }
 
 bool greedy_load_balancer::balance(meta_view view, migration_list &list)
@@ -913,7 +1139,7 @@ bool greedy_load_balancer::balance(meta_view view, migration_list &list)
     t_migration_result = &list;
     t_migration_result->clear();
 
-    greedy_balancer(false);
+    run_balancer_round(false);
     return !t_migration_result->empty();
 }
 
@@ -928,7 +1154,7 @@ bool greedy_load_balancer::check(meta_view view, migration_list &list)
     t_migration_result = &list;
     t_migration_result->clear();
 
-    greedy_balancer(true);
+    run_balancer_round(true);
     return !t_migration_result->empty();
 }
 
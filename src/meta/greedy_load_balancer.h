@@ -107,6 +107,15 @@ private:
     perf_counter_wrapper _recent_balance_move_primary_count;
     perf_counter_wrapper _recent_balance_copy_primary_count;
     perf_counter_wrapper _recent_balance_copy_secondary_count;
+    perf_counter_wrapper _balance_round_duration_ms;
+    perf_counter_wrapper _recent_balance_skipped_app_count;
+
+    // the apps found balanced by the primary/secondary balancer, with the fingerprints of
+    // what the decisions were made on. an app is skipped until its fingerprint changes, and all
+    // apps are evaluated again every [meta_server].balancer_full_round_interval rounds
+    std::unordered_map<app_id, uint64_t> _primary_balanced_apps;
+    std::unordered_map<app_id, uint64_t> _secondary_balanced_apps;
+    uint32_t _rounds_since_full_round;
 
 private:
     void number_nodes(const node_mapper &nodes);
@@ -134,6 +143,13 @@ private:
     bool copy_secondary_per_app(const std::shared_ptr<app_state> &app);
 
     void greedy_balancer(bool balance_checker);
+    // moves the primaries off the nodes whose load is well above the average, where the load
+    // of a primary is the usage it reports in the config sync. the primary counts of the apps
+    // are kept in the range the primary balancer converges to, so they never undo each other
+    void move_primary_by_load();
+    // the alive nodes, the configurations of the partitions and the options of the app
+    uint64_t app_fingerprint(const app_state &app, uint64_t nodes_fingerprint) const;
+    void run_balancer_round(bool balance_checker);
 
     bool all_replica_infos_collected(const node_state &ns);
     // using t_global_view to get disk_tag of node's pid
@@ -159,6 +175,8 @@ private:
     std::string clear_balancer_ignored_app_ids();
 
     bool is_ignored_app(app_id app_id);
+
+    friend class greedy_load_balancer_test;
 };
 
 inline configuration_proposal_action
@@ -20,6 +20,7 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/output_utils.h>
 #include <dsn/utils/time_utils.h>
+#include <dsn/utility/flags.h>
 
 #include "block_service/block_service_manager.h"
 #include "common/backup_utils.h"
@@ -30,6 +31,22 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("meta_server",
+                cold_backup_incremental_enabled,
+                false,
+                "whether a new backup only uploads the checkpoint files changed since the "
+                "previous backup of the policy");
+DSN_DEFINE_uint32("meta_server",
+                  cold_backup_max_incremental_count,
+                  6,
+                  "the max count of incremental backups following a full backup");
+DSN_DEFINE_uint32("meta_server",
+                  cold_backup_max_concurrent_partitions,
+                  1024,
+                  "the max count of partitions of a policy backed up concurrently across its apps, "
+                  "0 means unlimited");
+DSN_TAG_VARIABLE(cold_backup_max_concurrent_partitions, FT_MUTABLE);
+
 // TODO: backup_service and policy_context should need two locks, its own _lock and server_state's
 // _lock this maybe lead to deadlock, should refactor this
 
@@ -161,7 +178,31 @@ void policy_context::start_backup_app_partitions_unlocked(int32_t app_id)
             _backup_sig.c_str(),
             app_id);
     for (int32_t i = 0; i < iter->second; ++i) {
-        start_backup_partition_unlocked(gpid(app_id, i));
+        _progress.pending_partitions.emplace_back(app_id, i);
+    }
+    dispatch_backup_partitions_unlocked();
+}
+
+void policy_context::dispatch_backup_partitions_unlocked()
+{
+    // a partition may finish right in start_backup_partition_unlocked (e.g. the app is dropped),
+    // which dispatches again, the loop below goes on for it instead of recursing
+    if (_progress.dispatching) {
+        return;
+    }
+    _progress.dispatching = true;
+    while (!_progress.pending_partitions.empty() &&
+           (FLAGS_cold_backup_max_concurrent_partitions == 0 ||
+            _progress.running_partitions.size() < FLAGS_cold_backup_max_concurrent_partitions)) {
+        gpid pid = _progress.pending_partitions.front();
+        _progress.pending_partitions.pop_front();
+        _progress.running_partitions.insert(pid);
+        start_backup_partition_unlocked(pid);
+    }
+    _progress.dispatching = false;
+
+    if (_counter_policy_backup_running_partitions.get() != nullptr) {
+        _counter_policy_backup_running_partitions->set(_progress.running_partitions.size());
     }
 }
 
@@ -419,6 +460,15 @@ bool policy_context::update_partition_progress_unlocked(gpid pid,
             write_backup_app_finish_flag_unlocked(pid.get_app_id(), task_after_write_finish_flag);
         }
     }
+    if (local_progress == cold_backup_constant::PROGRESS_FINISHED &&
+        _progress.running_partitions.erase(pid) > 0) {
+        if (_counter_policy_backup_finished_partitions.get() != nullptr) {
+            _counter_policy_backup_finished_partitions->increment();
+            _counter_policy_backup_finished_bytes->add(
+                _progress.app_chkpt_size[pid.get_app_id()][pid.get_partition_index()]);
+        }
+        dispatch_backup_partitions_unlocked();
+    }
     return local_progress == cold_backup_constant::PROGRESS_FINISHED;
 }
 
@@ -466,6 +516,9 @@ void policy_context::start_backup_partition_unlocked(gpid pid)
     req.policy = *(static_cast<const policy_info *>(&_policy));
     req.backup_id = _cur_backup.backup_id;
     req.app_name = _policy.app_names.at(pid.get_app_id());
+    if (_cur_backup.prev_backup_id != 0) {
+        req.__set_prev_backup_id(_cur_backup.prev_backup_id);
+    }
     dsn::message_ex *request =
         dsn::message_ex::create_request(RPC_COLD_BACKUP, 0, pid.thread_hash());
     dsn::marshall(request, req);
@@ -602,6 +655,7 @@ void policy_context::prepare_current_backup_on_new_unlocked()
     _cur_backup.backup_id = _cur_backup.start_time_ms = static_cast<int64_t>(dsn_now_ms());
     _cur_backup.app_ids = _policy.app_ids;
     _cur_backup.app_names = _policy.app_names;
+    choose_prev_backup_unlocked(_cur_backup);
     _is_backup_failed = false;
 
     initialize_backup_progress_unlocked();
@@ -609,6 +663,28 @@ void policy_context::prepare_current_backup_on_new_unlocked()
         _policy.policy_name + "@" + boost::lexical_cast<std::string>(_cur_backup.backup_id);
 }
 
+void policy_context::choose_prev_backup_unlocked(backup_info &b_info) const
+{
+    b_info.prev_backup_id = b_info.base_backup_id = 0;
+    if (!FLAGS_cold_backup_incremental_enabled || _backup_history.empty()) {
+        return;
+    }
+
+    const backup_info &prev = _backup_history.rbegin()->second;
+    int64_t base_backup_id = prev.get_base_backup_id();
+    uint32_t incremental_count = 0;
+    for (const auto &kv : _backup_history) {
+        if (kv.second.base_backup_id == base_backup_id) {
+            ++incremental_count;
+        }
+    }
+    // start a new chain with a full backup once the chain is long enough
+    if (incremental_count < FLAGS_cold_backup_max_incremental_count) {
+        b_info.prev_backup_id = prev.backup_id;
+        b_info.base_backup_id = base_backup_id;
+    }
+}
+
 void policy_context::sync_backup_to_remote_storage_unlocked(const backup_info &b_info,
                                                             task_ptr sync_callback,
                                                             bool create_new_node)
@@ -790,18 +866,36 @@ void policy_context::start()
 {
     zauto_lock l(_lock);
 
-    if (_cur_backup.start_time_ms == 0) {
-        issue_new_backup_unlocked();
-    } else {
-        continue_current_backup_unlocked();
-    }
-
     std::string counter_name = _policy.policy_name + ".recent.backup.duration(ms)";
     _counter_policy_recent_backup_duration_ms.init_app_counter(
         "eon.meta.policy",
         counter_name.c_str(),
         COUNTER_TYPE_NUMBER,
         "policy recent backup duration time");
+    counter_name = _policy.policy_name + ".backup.running.partitions";
+    _counter_policy_backup_running_partitions.init_app_counter(
+        "eon.meta.policy",
+        counter_name.c_str(),
+        COUNTER_TYPE_NUMBER,
+        "the count of partitions of the policy being backed up");
+    counter_name = _policy.policy_name + ".backup.finished.partitions";
+    _counter_policy_backup_finished_partitions.init_app_counter(
+        "eon.meta.policy",
+        counter_name.c_str(),
+        COUNTER_TYPE_RATE,
+        "the count of partitions of the policy finishing backup per second");
+    counter_name = _policy.policy_name + ".backup.finished.bytes";
+    _counter_policy_backup_finished_bytes.init_app_counter(
+        "eon.meta.policy",
+        counter_name.c_str(),
+        COUNTER_TYPE_RATE,
+        "the checkpoint bytes of the partitions of the policy finishing backup per second");
+
+    if (_cur_backup.start_time_ms == 0) {
+        issue_new_backup_unlocked();
+    } else {
+        continue_current_backup_unlocked();
+    }
 
     issue_gc_backup_info_task_unlocked();
     ddebug("%s: start gc backup info task succeed", _policy.policy_name.c_str());
@@ -943,9 +1037,29 @@ void policy_context::gc_backup_info_unlocked(const backup_info &info_to_gc)
     sync_backup_to_remote_storage_unlocked(info_to_gc, sync_callback, false);
 }
 
+bool policy_context::is_backup_chain_expired_unlocked(const backup_info &info) const
+{
+    // the files of a backup may be referenced by the later incremental backups of its chain,
+    // so the backups of a chain are removed only after all of them are out of retention
+    size_t expired_count = _backup_history.size() - _policy.backup_history_count_to_keep;
+    size_t index = 0;
+    for (const auto &kv : _backup_history) {
+        bool in_retention = index++ >= expired_count;
+        if (in_retention && kv.second.get_base_backup_id() == info.get_base_backup_id()) {
+            ddebug_f("{}: backup({}) is still referenced by backup({}), delay to gc it",
+                     _policy.policy_name,
+                     info.backup_id,
+                     kv.first);
+            return false;
+        }
+    }
+    return true;
+}
+
 void policy_context::issue_gc_backup_info_task_unlocked()
 {
-    if (_backup_history.size() > _policy.backup_history_count_to_keep) {
+    if (_backup_history.size() > _policy.backup_history_count_to_keep &&
+        is_backup_chain_expired_unlocked(_backup_history.begin()->second)) {
         backup_info &info = _backup_history.begin()->second;
         info.info_status = backup_info_status::type::DELETING;
         ddebug("%s: start to gc backup info with id(%" PRId64 ")",
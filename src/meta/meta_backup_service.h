@@ -18,6 +18,8 @@
 #pragma once
 
 #include <cstdio>
+#include <deque>
+#include <set>
 #include <sstream>
 #include <iomanip> // std::setfill, std::setw
 #include <functional>
@@ -62,16 +64,32 @@ struct backup_info
     std::set<int32_t> app_ids;
     std::map<int32_t, std::string> app_names;
     int32_t info_status;
+    // an incremental backup references the files of the backups since its base backup, which is
+    // a full one. 0 means this is a full backup.
+    int64_t prev_backup_id;
+    int64_t base_backup_id;
     backup_info_status::type get_backup_status() const
     {
         return backup_info_status::type(info_status);
     }
+    int64_t get_base_backup_id() const { return base_backup_id == 0 ? backup_id : base_backup_id; }
     backup_info()
-        : backup_id(0), start_time_ms(0), end_time_ms(0), info_status(backup_info_status::ALIVE)
+        : backup_id(0),
+          start_time_ms(0),
+          end_time_ms(0),
+          info_status(backup_info_status::ALIVE),
+          prev_backup_id(0),
+          base_backup_id(0)
     {
     }
-    DEFINE_JSON_SERIALIZATION(
-        backup_id, start_time_ms, end_time_ms, app_ids, app_names, info_status)
+    DEFINE_JSON_SERIALIZATION(backup_id,
+                              start_time_ms,
+                              end_time_ms,
+                              app_ids,
+                              app_names,
+                              info_status,
+                              prev_backup_id,
+                              base_backup_id)
 };
 
 // Attention: backup_start_time == 24:00 is represent no limit for start_time, 24:00 is mainly saved
@@ -196,8 +214,13 @@ struct backup_progress
     std::map<app_id, std::map<int, int64_t>> app_chkpt_size;
     // if app is dropped when starting a new backup or under backuping, we just skip backup this app
     std::map<app_id, bool> is_app_skipped;
+    // the partitions waiting to be dispatched, and the dispatched but unfinished ones, whose count
+    // is limited by cold_backup_max_concurrent_partitions
+    std::deque<gpid> pending_partitions;
+    std::set<gpid> running_partitions;
+    bool dispatching;
 
-    backup_progress() : unfinished_apps(0) {}
+    backup_progress() : unfinished_apps(0), dispatching(false) {}
 
     void reset()
     {
@@ -206,6 +229,9 @@ struct backup_progress
         unfinished_partitions_per_app.clear();
         app_chkpt_size.clear();
         is_app_skipped.clear();
+        pending_partitions.clear();
+        running_partitions.clear();
+        dispatching = false;
     }
 };
 
@@ -254,6 +280,8 @@ mock_private :
     mock_virtual void start_backup_app_meta_unlocked(int32_t app_id);
     mock_virtual void start_backup_app_partitions_unlocked(int32_t app_id);
     mock_virtual void start_backup_partition_unlocked(gpid pid);
+    // start the pending partitions until the running ones reach the limit
+    void dispatch_backup_partitions_unlocked();
     // before finish backup one app, we write a flag file to represent whether the app's backup is
     // finished
     mock_virtual void write_backup_app_finish_flag_unlocked(int32_t app_id,
@@ -281,6 +309,9 @@ mock_private :
 
     mock_virtual void gc_backup_info_unlocked(const backup_info &info_to_gc);
     mock_virtual void issue_gc_backup_info_task_unlocked();
+    bool is_backup_chain_expired_unlocked(const backup_info &info) const;
+    // sets the backup `b_info` is incremental upon, if incremental backup is enabled
+    void choose_prev_backup_unlocked(backup_info &b_info) const;
     mock_virtual void sync_remove_backup_info(const backup_info &info, dsn::task_ptr sync_callback);
 
 mock_private :
@@ -303,6 +334,9 @@ mock_private :
     std::string _backup_sig; // policy_name@backup_id, used when print backup related log
 
     perf_counter_wrapper _counter_policy_recent_backup_duration_ms;
+    perf_counter_wrapper _counter_policy_backup_running_partitions;
+    perf_counter_wrapper _counter_policy_backup_finished_partitions;
+    perf_counter_wrapper _counter_policy_backup_finished_bytes;
 //clang-format on
     dsn::task_tracker _tracker;
 };
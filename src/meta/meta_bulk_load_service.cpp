@@ -17,12 +17,29 @@
 
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #include "meta_bulk_load_service.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  bulk_load_max_downloading_partitions,
+                  0,
+                  "the max count of partitions downloading files of bulk load in the cluster, "
+                  "0 means unlimited");
+DSN_DEFINE_uint32("meta_server",
+                  bulk_load_max_downloading_partitions_per_node,
+                  0,
+                  "the max count of partitions downloading files of bulk load whose replicas are "
+                  "on the same node, 0 means unlimited");
+DSN_DEFINE_uint32("meta_server",
+                  bulk_load_max_downloading_partitions_per_disk,
+                  0,
+                  "the max count of partitions downloading files of bulk load whose replicas are "
+                  "on the same disk, 0 means unlimited");
+
 bulk_load_service::bulk_load_service(meta_service *meta_svc, const std::string &bulk_load_dir)
     : _meta_svc(meta_svc), _state(meta_svc->get_server_state()), _bulk_load_root(bulk_load_dir)
 {
@@ -222,6 +239,7 @@ void bulk_load_service::create_app_bulk_load_dir(const std::string &app_name,
     ainfo.cluster_name = req.cluster_name;
     ainfo.file_provider_type = req.file_provider_type;
     ainfo.remote_root_path = req.remote_root_path;
+    ainfo.non_blocking_ingestion = req.non_blocking_ingestion;
     blob value = dsn::json::json_forwarder<app_bulk_load_info>::encode(ainfo);
 
     _meta_svc->get_meta_storage()->create_node(
@@ -276,6 +294,7 @@ void bulk_load_service::partition_bulk_load(const std::string &app_name, const g
 
     rpc_address primary_addr;
     ballot b;
+    replica_locations locations;
     {
         zauto_read_lock l(app_lock());
         std::shared_ptr<app_state> app = _state->get_app(pid.get_app_id());
@@ -286,8 +305,10 @@ void bulk_load_service::partition_bulk_load(const std::string &app_name, const g
             handle_app_unavailable(pid.get_app_id(), app_name);
             return;
         }
-        primary_addr = app->partitions[pid.get_partition_index()].primary;
-        b = app->partitions[pid.get_partition_index()].ballot;
+        const partition_configuration &pc = app->partitions[pid.get_partition_index()];
+        primary_addr = pc.primary;
+        b = pc.ballot;
+        get_replica_locations(pc, app->helpers->contexts[pid.get_partition_index()], locations);
     }
 
     if (primary_addr.is_invalid()) {
@@ -300,6 +321,15 @@ void bulk_load_service::partition_bulk_load(const std::string &app_name, const g
         return;
     }
 
+    if (!try_acquire_download_slot(pid, locations)) {
+        ddebug_f("app({}) partition({}) waits for other partitions to finish downloading",
+                 app_name,
+                 pid);
+        try_resend_bulk_load_request(
+            app_name, pid, bulk_load_constant::BULK_LOAD_REQUEST_SHORT_INTERVAL);
+        return;
+    }
+
     zauto_read_lock l(_lock);
     const app_bulk_load_info &ainfo = _app_bulk_load_info[pid.get_app_id()];
     auto req = make_unique<bulk_load_request>();
@@ -312,16 +342,19 @@ void bulk_load_service::partition_bulk_load(const std::string &app_name, const g
     req->ballot = b;
     req->query_bulk_load_metadata = is_partition_metadata_not_updated_unlocked(pid);
     req->remote_root_path = ainfo.remote_root_path;
+    req->__set_non_blocking_ingestion(ainfo.non_blocking_ingestion);
 
     ddebug_f("send bulk load request to node({}), app({}), partition({}), partition "
-             "status = {}, remote provider = {}, cluster_name = {}, remote_root_path = {}",
+             "status = {}, remote provider = {}, cluster_name = {}, remote_root_path = {}, "
+             "non_blocking_ingestion = {}",
              primary_addr.to_string(),
              app_name,
              pid,
              dsn::enum_to_string(req->meta_bulk_load_status),
              req->remote_provider_name,
              req->cluster_name,
-             req->remote_root_path);
+             req->remote_root_path,
+             req->non_blocking_ingestion);
 
     bulk_load_rpc rpc(std::move(req), RPC_BULK_LOAD, 0_ms, 0, pid.thread_hash());
     rpc.call(primary_addr, _meta_svc->tracker(), [this, rpc](error_code err) mutable {
@@ -329,6 +362,79 @@ void bulk_load_service::partition_bulk_load(const std::string &app_name, const g
     });
 }
 
+/*static*/ void bulk_load_service::get_replica_locations(const partition_configuration &pc,
+                                                        const config_context &cc,
+                                                        /*out*/ replica_locations &locations)
+{
+    locations.clear();
+    auto add_location = [&](const rpc_address &node) {
+        auto iter = cc.find_from_serving(node);
+        locations[node] = (iter == cc.serving.end() ? std::string() : iter->disk_tag);
+    };
+    add_location(pc.primary);
+    for (const auto &secondary : pc.secondaries) {
+        add_location(secondary);
+    }
+}
+
+// ThreadPool: THREAD_POOL_META_STATE
+bool bulk_load_service::try_acquire_download_slot(const gpid &pid,
+                                                  const replica_locations &locations)
+{
+    zauto_write_lock l(_lock);
+    if (get_partition_bulk_load_status_unlocked(pid) != bulk_load_status::BLS_DOWNLOADING) {
+        release_download_slot_unlocked(pid);
+        return true;
+    }
+    if (_partitions_download_slot.find(pid) != _partitions_download_slot.end()) {
+        return true;
+    }
+
+    // partitions whose replicas are on idle nodes and disks go first, others wait for them
+    if (FLAGS_bulk_load_max_downloading_partitions > 0 &&
+        _partitions_download_slot.size() >= FLAGS_bulk_load_max_downloading_partitions) {
+        return false;
+    }
+    for (const auto &kv : locations) {
+        if (FLAGS_bulk_load_max_downloading_partitions_per_node > 0 &&
+            _nodes_downloading_count[kv.first] >=
+                FLAGS_bulk_load_max_downloading_partitions_per_node) {
+            return false;
+        }
+        if (FLAGS_bulk_load_max_downloading_partitions_per_disk > 0 && !kv.second.empty() &&
+            _disks_downloading_count[kv] >= FLAGS_bulk_load_max_downloading_partitions_per_disk) {
+            return false;
+        }
+    }
+
+    for (const auto &kv : locations) {
+        ++_nodes_downloading_count[kv.first];
+        if (!kv.second.empty()) {
+            ++_disks_downloading_count[kv];
+        }
+    }
+    _partitions_download_slot[pid] = locations;
+    return true;
+}
+
+// ThreadPool: THREAD_POOL_META_STATE
+void bulk_load_service::release_download_slot_unlocked(const gpid &pid)
+{
+    auto iter = _partitions_download_slot.find(pid);
+    if (iter == _partitions_download_slot.end()) {
+        return;
+    }
+    for (const auto &kv : iter->second) {
+        if (--_nodes_downloading_count[kv.first] <= 0) {
+            _nodes_downloading_count.erase(kv.first);
+        }
+        if (!kv.second.empty() && --_disks_downloading_count[kv] <= 0) {
+            _disks_downloading_count.erase(kv);
+        }
+    }
+    _partitions_download_slot.erase(iter);
+}
+
 // ThreadPool: THREAD_POOL_META_STATE
 void bulk_load_service::on_partition_bulk_load_reply(error_code err,
                                                      const bulk_load_request &request,
@@ -1051,6 +1157,8 @@ void bulk_load_service::partition_ingestion(const std::string &app_name, const g
     {
         zauto_read_lock l(_lock);
         req.metadata = _partition_bulk_load_info[pid].metadata;
+        req.__set_non_blocking_ingestion(
+            _app_bulk_load_info[pid.get_app_id()].non_blocking_ingestion);
     }
 
     // create a client request, whose gpid field in header should be pid
@@ -1174,6 +1282,15 @@ inline void erase_map_elem_by_id(int32_t app_id, std::unordered_map<gpid, T> &my
 void bulk_load_service::reset_local_bulk_load_states(int32_t app_id, const std::string &app_name)
 {
     zauto_write_lock l(_lock);
+    std::vector<gpid> downloading_pids;
+    for (const auto &kv : _partitions_download_slot) {
+        if (kv.first.get_app_id() == app_id) {
+            downloading_pids.emplace_back(kv.first);
+        }
+    }
+    for (const auto &pid : downloading_pids) {
+        release_download_slot_unlocked(pid);
+    }
     _app_bulk_load_info.erase(app_id);
     _apps_in_progress_count.erase(app_id);
     _apps_pending_sync_flag.erase(app_id);
@@ -37,13 +37,15 @@ struct app_bulk_load_info
     std::string file_provider_type;
     bulk_load_status::type status;
     std::string remote_root_path;
+    bool non_blocking_ingestion{false};
     DEFINE_JSON_SERIALIZATION(app_id,
                               partition_count,
                               app_name,
                               cluster_name,
                               file_provider_type,
                               status,
-                              remote_root_path)
+                              remote_root_path,
+                              non_blocking_ingestion)
 };
 
 struct partition_bulk_load_info
@@ -138,6 +140,18 @@ private:
 
     void partition_bulk_load(const std::string &app_name, const gpid &pid);
 
+    // node -> disk tag(empty if unknown) of the replicas of a partition
+    typedef std::map<rpc_address, std::string> replica_locations;
+    static void get_replica_locations(const partition_configuration &pc,
+                                      const config_context &cc,
+                                      /*out*/ replica_locations &locations);
+
+    // a downloading partition needs a download slot before sending bulk load request, return
+    // false if the cluster, node or disk budget of downloading partitions is used up
+    bool try_acquire_download_slot(const gpid &pid, const replica_locations &locations);
+
+    void release_download_slot_unlocked(const gpid &pid);
+
     void on_partition_bulk_load_reply(error_code err,
                                       const bulk_load_request &request,
                                       const bulk_load_response &response);
@@ -404,6 +418,11 @@ private:
     std::unordered_map<app_id, bool> _apps_cleaning_up;
     // Used for bulk load rolling back to downloading
     std::unordered_map<app_id, bool> _apps_rolling_back;
+
+    // partitions allowed to download files -> replica locations when they are allowed
+    std::unordered_map<gpid, replica_locations> _partitions_download_slot;
+    std::map<rpc_address, int32_t> _nodes_downloading_count;
+    std::map<std::pair<rpc_address, std::string>, int32_t> _disks_downloading_count;
 };
 
 } // namespace replication
@@ -34,11 +34,46 @@
  */
 #include <boost/lexical_cast.hpp>
 #include <dsn/service_api_cpp.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 #include "meta_data.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("meta_server",
+                partition_configuration_binary_encoding,
+                false,
+                "whether to encode the partition configurations in the remote storage by the "
+                "thrift binary protocol rather than json, note that the meta servers before "
+                "it's supported can only decode json");
+
+blob encode_partition_configuration(const partition_configuration &pc)
+{
+    if (!FLAGS_partition_configuration_binary_encoding) {
+        return json::json_forwarder<partition_configuration>::encode(pc);
+    }
+    binary_writer writer;
+    marshall_thrift_binary(writer, pc);
+    return writer.get_buffer();
+}
+
+bool decode_partition_configuration(const blob &value, /*out*/ partition_configuration &pc)
+{
+    if (value.length() == 0 || value.data()[0] == '{') {
+        return json::json_forwarder<partition_configuration>::decode(value, pc);
+    }
+    try {
+        binary_reader reader(value);
+        unmarshall_thrift_binary(reader, pc);
+        return true;
+    } catch (const std::exception &e) {
+        derror_f("decode partition configuration failed: {}", e.what());
+        return false;
+    }
+}
+
 void when_update_replicas(config_type::type t, const std::function<void(bool)> &func)
 {
     switch (t) {
@@ -78,6 +113,37 @@ void maintain_drops(std::vector<rpc_address> &drops, const rpc_address &node, co
     when_update_replicas(t, action);
 }
 
+std::vector<rpc_address>
+place_read_replicas(const partition_configuration &pc, const node_mapper &nodes, int count)
+{
+    std::vector<std::pair<uint64_t, rpc_address>> weights;
+    const uint64_t pid = pc.pid.value();
+    for (const auto &kv : nodes) {
+        if (!kv.second.alive() || is_member(pc, kv.first)) {
+            continue;
+        }
+        const uint32_t ip = kv.first.ip();
+        const uint16_t port = kv.first.port();
+        uint64_t weight = utils::crc64_calc(&pid, sizeof(pid), 0);
+        weight = utils::crc64_calc(&ip, sizeof(ip), weight);
+        weight = utils::crc64_calc(&port, sizeof(port), weight);
+        weights.emplace_back(weight, kv.first);
+    }
+
+    count = std::min(count, static_cast<int>(weights.size()));
+    std::partial_sort(weights.begin(),
+                      weights.begin() + count,
+                      weights.end(),
+                      std::greater<std::pair<uint64_t, rpc_address>>());
+
+    std::vector<rpc_address> result;
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        result.push_back(weights[i].second);
+    }
+    return result;
+}
+
 proposal_actions::proposal_actions() : from_balancer(false) { reset_tracked_current_learner(); }
 
 void proposal_actions::reset_tracked_current_learner()
@@ -401,6 +467,49 @@ std::shared_ptr<app_state> app_state::create(const app_info &info)
     return std::make_shared<app_state>(info);
 }
 
+bool partition_set::insert(const gpid &pid)
+{
+    size_t index = pid.get_partition_index();
+    if (index / 64 >= _bits.size()) {
+        _bits.resize(index / 64 + 1, 0);
+    }
+    uint64_t mask = 1ULL << (index % 64);
+    if (_bits[index / 64] & mask) {
+        return false;
+    }
+    _app_id = pid.get_app_id();
+    _bits[index / 64] |= mask;
+    ++_size;
+    return true;
+}
+
+size_t partition_set::erase(const gpid &pid)
+{
+    if (count(pid) == 0) {
+        return 0;
+    }
+    size_t index = pid.get_partition_index();
+    _bits[index / 64] &= ~(1ULL << (index % 64));
+    --_size;
+    return 1;
+}
+
+size_t partition_set::next(size_t index) const
+{
+    size_t word = index / 64;
+    if (word >= _bits.size()) {
+        return _bits.size() * 64;
+    }
+    uint64_t bits = _bits[word] & (~0ULL << (index % 64));
+    while (bits == 0) {
+        if (++word == _bits.size()) {
+            return _bits.size() * 64;
+        }
+        bits = _bits[word];
+    }
+    return word * 64 + __builtin_ctzll(bits);
+}
+
 node_state::node_state()
     : total_primaries(0), total_partitions(0), is_alive(false), has_collected_replicas(false)
 {
@@ -453,11 +562,11 @@ const partition_set *node_state::partitions(app_id id, bool only_primary) const
 void node_state::put_partition(const gpid &pid, bool is_primary)
 {
     partition_set *all = get_partitions(pid.get_app_id(), false, true);
-    if ((all->insert(pid)).second)
+    if (all->insert(pid))
         total_partitions++;
     if (is_primary) {
         partition_set *pri = get_partitions(pid.get_app_id(), true, true);
-        if ((pri->insert(pid)).second)
+        if (pri->insert(pid))
             total_primaries++;
     }
 }
@@ -539,10 +648,10 @@ unsigned node_state::partition_count(app_id id) const
 partition_status::type node_state::served_as(const gpid &pid) const
 {
     const partition_set *ps1 = partitions(pid.get_app_id(), true);
-    if (ps1 != nullptr && ps1->find(pid) != ps1->end())
+    if (ps1 != nullptr && ps1->count(pid) > 0)
         return partition_status::PS_PRIMARY;
     const partition_set *ps2 = partitions(pid.get_app_id(), false);
-    if (ps2 != nullptr && ps2->find(pid) != ps2->end())
+    if (ps2 != nullptr && ps2->count(pid) > 0)
         return partition_status::PS_SECONDARY;
     return partition_status::PS_INACTIVE;
 }
@@ -362,7 +362,53 @@ public:
     bool splitting() const { return helpers->split_states.splitting_count > 0; }
 };
 
-typedef std::set<dsn::gpid> partition_set;
+// the partitions of an app served by a node, see node_state. It's a bitset indexed by the
+// partition index, so each partition takes a bit instead of a tree node of std::set<gpid>, and
+// the partitions are iterated in the order of their indexes.
+class partition_set
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const partition_set *set, size_t index) : _set(set), _index(index) {}
+        dsn::gpid operator*() const { return dsn::gpid(_set->_app_id, (int32_t)_index); }
+        const_iterator &operator++()
+        {
+            _index = _set->next(_index + 1);
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const { return _index == other._index; }
+        bool operator!=(const const_iterator &other) const { return _index != other._index; }
+
+    private:
+        const partition_set *_set;
+        size_t _index;
+    };
+
+    // return true if `pid` is not in the set before
+    bool insert(const dsn::gpid &pid);
+    // return the count of the partitions erased
+    size_t erase(const dsn::gpid &pid);
+    size_t count(const dsn::gpid &pid) const
+    {
+        size_t index = pid.get_partition_index();
+        return (index / 64 < _bits.size() && (_bits[index / 64] >> (index % 64) & 1)) ? 1 : 0;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const_iterator begin() const { return const_iterator(this, next(0)); }
+    const_iterator end() const { return const_iterator(this, _bits.size() * 64); }
+
+private:
+    // the index of the first partition in the set from `index`, or the end
+    size_t next(size_t index) const;
+
+    int32_t _app_id{0};
+    size_t _size{0};
+    std::vector<uint64_t> _bits;
+};
 typedef std::map<app_id, std::shared_ptr<app_state>> app_mapper;
 
 class node_state : public extensible_object<node_state, 4>
@@ -532,10 +578,23 @@ inline int count_partitions(const app_mapper &apps)
 }
 
 void when_update_replicas(config_type::type t, const std::function<void(bool)> &func);
+
+// The partition configurations in the remote storage are encoded in json, or by the thrift
+// binary protocol if [meta_server] partition_configuration_binary_encoding is enabled, which
+// is much faster to decode when the meta server restarts with lots of partitions.
+// Both encodings are decoded, as the json always starts with '{' while the binary doesn't.
+blob encode_partition_configuration(const partition_configuration &pc);
+bool decode_partition_configuration(const blob &value, /*out*/ partition_configuration &pc);
 void maintain_drops(/*inout*/ std::vector<dsn::rpc_address> &drops,
                     const dsn::rpc_address &node,
                     config_type::type t);
 
+// Choose at most `count` alive nodes out of the partition members to hold its read replicas,
+// by rendezvous hashing of the partition and the node: a node keeps its read replicas as long
+// as it is alive, and only the read replicas of a dead node move to the others.
+std::vector<rpc_address>
+place_read_replicas(const partition_configuration &pc, const node_mapper &nodes, int count);
+
 inline bool has_seconds_expired(uint64_t second_ts) { return second_ts * 1000 < dsn_now_ms(); }
 
 inline bool has_milliseconds_expired(uint64_t milliseconds_ts)
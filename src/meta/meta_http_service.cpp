@@ -24,6 +24,7 @@
 #include <dsn/dist/replication/duplication_common.h>
 #include <dsn/utility/config_api.h>
 #include <dsn/utility/output_utils.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/utils/time_utils.h>
 
 #include "meta_http_service.h"
@@ -52,11 +53,23 @@ void meta_http_service::get_app_handler(const http_request &req, http_response &
 {
     std::string app_name;
     bool detailed = false;
+    int32_t start_partition = 0;
+    uint32_t limit = 0;
     for (const auto &p : req.query_args) {
         if (p.first == "name") {
             app_name = p.second;
         } else if (p.first == "detail") {
             detailed = true;
+        } else if (p.first == "start_partition") {
+            if (!buf2int32(p.second, start_partition) || start_partition < 0) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+        } else if (p.first == "limit") {
+            if (!buf2uint32(p.second, limit)) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
         } else {
             resp.status_code = http_status_code::bad_request;
             return;
@@ -82,27 +95,24 @@ void meta_http_service::get_app_handler(const http_request &req, http_response &
     }
 
     // output as json format
-    dsn::utils::multi_table_printer mtp;
-    std::ostringstream out;
-    dsn::utils::table_printer tp_general("general");
-    tp_general.add_row_name_and_data("app_name", app_name);
-    tp_general.add_row_name_and_data("app_id", response.app_id);
-    tp_general.add_row_name_and_data("partition_count", response.partition_count);
+    dsn::utils::json_table_writer writer(resp.body);
+    writer.start_table("general");
+    writer.add_row_name_and_data("app_name", app_name);
+    writer.add_row_name_and_data("app_id", response.app_id);
+    writer.add_row_name_and_data("partition_count", response.partition_count);
     if (!response.partitions.empty()) {
-        tp_general.add_row_name_and_data("max_replica_count",
-                                         response.partitions[0].max_replica_count);
+        writer.add_row_name_and_data("max_replica_count",
+                                     response.partitions[0].max_replica_count);
     } else {
-        tp_general.add_row_name_and_data("max_replica_count", 0);
+        writer.add_row_name_and_data("max_replica_count", 0);
     }
-    mtp.add(std::move(tp_general));
+    writer.end_table();
 
     if (detailed) {
-        dsn::utils::table_printer tp_details("replicas");
-        tp_details.add_title("pidx");
-        tp_details.add_column("ballot");
-        tp_details.add_column("replica_count");
-        tp_details.add_column("primary");
-        tp_details.add_column("secondaries");
+        // only the replicas in [start_partition, start_partition + limit) are output, while the
+        // statistics are of all
+        writer.start_table("replicas",
+                           {"pidx", "ballot", "replica_count", "primary", "secondaries"});
         std::map<rpc_address, std::pair<int, int>> node_stat;
 
         int total_prim_count = 0;
@@ -119,6 +129,9 @@ void meta_http_service::get_app_handler(const http_request &req, http_response &
             }
             replica_count += p.secondaries.size();
             total_sec_count += p.secondaries.size();
+            for (const auto &secondary : p.secondaries) {
+                node_stat[secondary].second++;
+            }
             if (!p.primary.is_invalid()) {
                 if (replica_count >= p.max_replica_count)
                     fully_healthy++;
@@ -128,64 +141,76 @@ void meta_http_service::get_app_handler(const http_request &req, http_response &
                 write_unhealthy++;
                 read_unhealthy++;
             }
-            tp_details.add_row(p.pid.get_partition_index());
-            tp_details.append_data(p.ballot);
-            std::stringstream oss;
-            oss << replica_count << "/" << p.max_replica_count;
-            tp_details.append_data(oss.str());
-            tp_details.append_data((p.primary.is_invalid() ? "-" : p.primary.to_std_string()));
-            oss.str("");
-            oss << "[";
+
+            int pidx = p.pid.get_partition_index();
+            if (pidx < start_partition ||
+                (limit > 0 && static_cast<uint32_t>(pidx - start_partition) >= limit)) {
+                continue;
+            }
+            writer.add_row(pidx);
+            writer.append_data(p.ballot);
+            writer.append_data(fmt::format("{}/{}", replica_count, p.max_replica_count));
+            writer.append_data((p.primary.is_invalid() ? "-" : p.primary.to_std_string()));
+            std::string secondaries = "[";
             for (int j = 0; j < p.secondaries.size(); j++) {
                 if (j != 0)
-                    oss << ",";
-                oss << p.secondaries[j].to_std_string();
-                node_stat[p.secondaries[j]].second++;
+                    secondaries += ",";
+                secondaries += p.secondaries[j].to_std_string();
             }
-            oss << "]";
-            tp_details.append_data(oss.str());
+            secondaries += "]";
+            writer.append_data(secondaries);
         }
-        mtp.add(std::move(tp_details));
+        writer.end_table();
 
         // 'node' section.
-        dsn::utils::table_printer tp_nodes("nodes");
-        tp_nodes.add_title("node");
-        tp_nodes.add_column("primary");
-        tp_nodes.add_column("secondary");
-        tp_nodes.add_column("total");
+        writer.start_table("nodes", {"node", "primary", "secondary", "total"});
         for (auto &kv : node_stat) {
-            tp_nodes.add_row(kv.first.to_std_string());
-            tp_nodes.append_data(kv.second.first);
-            tp_nodes.append_data(kv.second.second);
-            tp_nodes.append_data(kv.second.first + kv.second.second);
+            writer.add_row(kv.first.to_std_string());
+            writer.append_data(kv.second.first);
+            writer.append_data(kv.second.second);
+            writer.append_data(kv.second.first + kv.second.second);
         }
-        tp_nodes.add_row("total");
-        tp_nodes.append_data(total_prim_count);
-        tp_nodes.append_data(total_sec_count);
-        tp_nodes.append_data(total_prim_count + total_sec_count);
-        mtp.add(std::move(tp_nodes));
+        writer.add_row("total");
+        writer.append_data(total_prim_count);
+        writer.append_data(total_sec_count);
+        writer.append_data(total_prim_count + total_sec_count);
+        writer.end_table();
 
         // healthy partition count section.
-        dsn::utils::table_printer tp_hpc("healthy");
-        tp_hpc.add_row_name_and_data("fully_healthy_partition_count", fully_healthy);
-        tp_hpc.add_row_name_and_data("unhealthy_partition_count",
+        writer.start_table("healthy");
+        writer.add_row_name_and_data("fully_healthy_partition_count", fully_healthy);
+        writer.add_row_name_and_data("unhealthy_partition_count",
                                      response.partition_count - fully_healthy);
-        tp_hpc.add_row_name_and_data("write_unhealthy_partition_count", write_unhealthy);
-        tp_hpc.add_row_name_and_data("read_unhealthy_partition_count", read_unhealthy);
-        mtp.add(std::move(tp_hpc));
+        writer.add_row_name_and_data("write_unhealthy_partition_count", write_unhealthy);
+        writer.add_row_name_and_data("read_unhealthy_partition_count", read_unhealthy);
+        writer.end_table();
     }
 
-    mtp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
-    resp.body = out.str();
+    writer.finish();
     resp.status_code = http_status_code::ok;
 }
 
 void meta_http_service::list_app_handler(const http_request &req, http_response &resp)
 {
     bool detailed = false;
+    int32_t start_app_id = 0;
+    uint32_t limit = 0;
+    std::string name_prefix;
     for (const auto &p : req.query_args) {
         if (p.first == "detail") {
             detailed = true;
+        } else if (p.first == "start_app_id") {
+            if (!buf2int32(p.second, start_app_id)) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+        } else if (p.first == "limit") {
+            if (!buf2uint32(p.second, limit)) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+        } else if (p.first == "name_prefix") {
+            name_prefix = p.second;
         } else {
             resp.status_code = http_status_code::bad_request;
             return;
@@ -204,28 +229,42 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
         resp.status_code = http_status_code::internal_server_error;
         return;
     }
-    std::vector<::dsn::app_info> &apps = response.infos;
 
-    // output as json format
-    std::ostringstream out;
-    dsn::utils::multi_table_printer mtp;
-    int available_app_count = 0;
-    dsn::utils::table_printer tp_general("general_info");
-    tp_general.add_title("app_id");
-    tp_general.add_column("status");
-    tp_general.add_column("app_name");
-    tp_general.add_column("app_type");
-    tp_general.add_column("partition_count");
-    tp_general.add_column("replica_count");
-    tp_general.add_column("is_stateful");
-    tp_general.add_column("create_time");
-    tp_general.add_column("drop_time");
-    tp_general.add_column("drop_expire");
-    tp_general.add_column("envs_count");
-    for (const auto &app : apps) {
-        if (app.status != dsn::app_status::AS_AVAILABLE) {
+    // the available apps with id >= start_app_id and name starting with name_prefix, at most
+    // `limit` of them if it's not 0. the id of the next one is returned in the summary if any
+    std::vector<const ::dsn::app_info *> apps;
+    int32_t next_app_id = 0;
+    for (const auto &app : response.infos) {
+        if (app.status != dsn::app_status::AS_AVAILABLE || app.app_id < start_app_id ||
+            app.app_name.compare(0, name_prefix.size(), name_prefix) != 0) {
             continue;
         }
+        apps.push_back(&app);
+    }
+    std::sort(apps.begin(), apps.end(), [](const ::dsn::app_info *a, const ::dsn::app_info *b) {
+        return a->app_id < b->app_id;
+    });
+    if (limit > 0 && apps.size() > limit) {
+        next_app_id = apps[limit]->app_id;
+        apps.resize(limit);
+    }
+
+    // output as json format
+    dsn::utils::json_table_writer writer(resp.body);
+    writer.start_table("general_info",
+                       {"app_id",
+                        "status",
+                        "app_name",
+                        "app_type",
+                        "partition_count",
+                        "replica_count",
+                        "is_stateful",
+                        "create_time",
+                        "drop_time",
+                        "drop_expire",
+                        "envs_count"});
+    for (const ::dsn::app_info *info : apps) {
+        const ::dsn::app_info &app = *info;
         std::string status_str = enum_to_string(app.status);
         status_str = status_str.substr(status_str.find("AS_") + 3);
         std::string create_time = "-";
@@ -234,54 +273,37 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
             dsn::utils::time_ms_to_string((uint64_t)app.create_second * 1000, buf);
             create_time = buf;
         }
-        std::string drop_time = "-";
-        std::string drop_expire_time = "-";
-        if (app.status == app_status::AS_AVAILABLE) {
-            available_app_count++;
-        } else if (app.status == app_status::AS_DROPPED && app.expire_second > 0) {
-            if (app.drop_second > 0) {
-                char buf[24];
-                dsn::utils::time_ms_to_string((uint64_t)app.drop_second * 1000, buf);
-                drop_time = buf;
-            }
-            if (app.expire_second > 0) {
-                char buf[24];
-                dsn::utils::time_ms_to_string((uint64_t)app.expire_second * 1000, buf);
-                drop_expire_time = buf;
-            }
-        }
 
-        tp_general.add_row(app.app_id);
-        tp_general.append_data(status_str);
-        tp_general.append_data(app.app_name);
-        tp_general.append_data(app.app_type);
-        tp_general.append_data(app.partition_count);
-        tp_general.append_data(app.max_replica_count);
-        tp_general.append_data(app.is_stateful);
-        tp_general.append_data(create_time);
-        tp_general.append_data(drop_time);
-        tp_general.append_data(drop_expire_time);
-        tp_general.append_data(app.envs.size());
-    }
-    mtp.add(std::move(tp_general));
+        writer.add_row(app.app_id);
+        writer.append_data(status_str);
+        writer.append_data(app.app_name);
+        writer.append_data(app.app_type);
+        writer.append_data(app.partition_count);
+        writer.append_data(app.max_replica_count);
+        writer.append_data(app.is_stateful);
+        writer.append_data(create_time);
+        // only the available apps are listed
+        writer.append_data("-");
+        writer.append_data("-");
+        writer.append_data(app.envs.size());
+    }
+    writer.end_table();
 
     int total_fully_healthy_app_count = 0;
     int total_unhealthy_app_count = 0;
     int total_write_unhealthy_app_count = 0;
     int total_read_unhealthy_app_count = 0;
-    if (detailed && available_app_count > 0) {
-        dsn::utils::table_printer tp_health("healthy_info");
-        tp_health.add_title("app_id");
-        tp_health.add_column("app_name");
-        tp_health.add_column("partition_count");
-        tp_health.add_column("fully_healthy");
-        tp_health.add_column("unhealthy");
-        tp_health.add_column("write_unhealthy");
-        tp_health.add_column("read_unhealthy");
-        for (auto &info : apps) {
-            if (info.status != app_status::AS_AVAILABLE) {
-                continue;
-            }
+    if (detailed && !apps.empty()) {
+        writer.start_table("healthy_info",
+                           {"app_id",
+                            "app_name",
+                            "partition_count",
+                            "fully_healthy",
+                            "unhealthy",
+                            "write_unhealthy",
+                            "read_unhealthy"});
+        for (const ::dsn::app_info *app : apps) {
+            const ::dsn::app_info &info = *app;
             configuration_query_by_index_request request;
             configuration_query_by_index_response response;
             request.app_name = info.app_name;
@@ -314,13 +336,13 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
                     read_unhealthy++;
                 }
             }
-            tp_health.add_row(info.app_id);
-            tp_health.append_data(info.app_name);
-            tp_health.append_data(info.partition_count);
-            tp_health.append_data(fully_healthy);
-            tp_health.append_data(info.partition_count - fully_healthy);
-            tp_health.append_data(write_unhealthy);
-            tp_health.append_data(read_unhealthy);
+            writer.add_row(info.app_id);
+            writer.append_data(info.app_name);
+            writer.append_data(info.partition_count);
+            writer.append_data(fully_healthy);
+            writer.append_data(info.partition_count - fully_healthy);
+            writer.append_data(write_unhealthy);
+            writer.append_data(read_unhealthy);
 
             if (fully_healthy == info.partition_count)
                 total_fully_healthy_app_count++;
@@ -331,32 +353,52 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
             if (read_unhealthy > 0)
                 total_read_unhealthy_app_count++;
         }
-        mtp.add(std::move(tp_health));
+        writer.end_table();
     }
 
-    dsn::utils::table_printer tp_count("summary");
-    tp_count.add_row_name_and_data("total_app_count", available_app_count);
-    if (detailed && available_app_count > 0) {
-        tp_count.add_row_name_and_data("fully_healthy_app_count", total_fully_healthy_app_count);
-        tp_count.add_row_name_and_data("unhealthy_app_count", total_unhealthy_app_count);
-        tp_count.add_row_name_and_data("write_unhealthy_app_count",
-                                       total_write_unhealthy_app_count);
-        tp_count.add_row_name_and_data("read_unhealthy_app_count", total_read_unhealthy_app_count);
+    writer.start_table("summary");
+    writer.add_row_name_and_data("total_app_count", apps.size());
+    if (detailed && !apps.empty()) {
+        writer.add_row_name_and_data("fully_healthy_app_count", total_fully_healthy_app_count);
+        writer.add_row_name_and_data("unhealthy_app_count", total_unhealthy_app_count);
+        writer.add_row_name_and_data("write_unhealthy_app_count",
+                                     total_write_unhealthy_app_count);
+        writer.add_row_name_and_data("read_unhealthy_app_count", total_read_unhealthy_app_count);
     }
-    mtp.add(std::move(tp_count));
-
-    mtp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
+    if (next_app_id > 0) {
+        writer.add_row_name_and_data("next_start_app_id", next_app_id);
+    }
+    writer.end_table();
 
-    resp.body = out.str();
+    writer.finish();
     resp.status_code = http_status_code::ok;
 }
 
 void meta_http_service::list_node_handler(const http_request &req, http_response &resp)
 {
     bool detailed = false;
+    rpc_address start_node;
+    uint32_t limit = 0;
+    std::string status;
     for (const auto &p : req.query_args) {
         if (p.first == "detail") {
             detailed = true;
+        } else if (p.first == "start_node") {
+            if (!start_node.from_string_ipv4(p.second.c_str())) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+        } else if (p.first == "limit") {
+            if (!buf2uint32(p.second, limit)) {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+        } else if (p.first == "status") {
+            if (p.second != "ALIVE" && p.second != "UNALIVE") {
+                resp.status_code = http_status_code::bad_request;
+                return;
+            }
+            status = p.second;
         } else {
             resp.status_code = http_status_code::bad_request;
             return;
@@ -365,12 +407,28 @@ void meta_http_service::list_node_handler(const http_request &req, http_response
     if (!redirect_if_not_primary(req, resp))
         return;
 
+    // the nodes from start_node in the order of their addresses, at most `limit` of them if it's
+    // not 0. the address of the next one is returned in the summary if any
     std::map<dsn::rpc_address, list_nodes_helper> tmp_map;
-    for (const auto &node : _service->_alive_set) {
-        tmp_map.emplace(node, list_nodes_helper(node.to_std_string(), "ALIVE"));
+    if (status != "UNALIVE") {
+        for (const auto &node : _service->_alive_set) {
+            if (!(node < start_node)) {
+                tmp_map.emplace(node, list_nodes_helper(node.to_std_string(), "ALIVE"));
+            }
+        }
+    }
+    if (status != "ALIVE") {
+        for (const auto &node : _service->_dead_set) {
+            if (!(node < start_node)) {
+                tmp_map.emplace(node, list_nodes_helper(node.to_std_string(), "UNALIVE"));
+            }
+        }
     }
-    for (const auto &node : _service->_dead_set) {
-        tmp_map.emplace(node, list_nodes_helper(node.to_std_string(), "UNALIVE"));
+    std::string next_node;
+    if (limit > 0 && tmp_map.size() > limit) {
+        auto next = std::next(tmp_map.begin(), limit);
+        next_node = next->first.to_std_string();
+        tmp_map.erase(next, tmp_map.end());
     }
     int alive_node_count = (_service->_alive_set).size();
     int unalive_node_count = (_service->_dead_set).size();
@@ -413,35 +471,34 @@ void meta_http_service::list_node_handler(const http_request &req, http_response
     }
 
     // output as json format
-    std::ostringstream out;
-    dsn::utils::multi_table_printer mtp;
-    dsn::utils::table_printer tp_details("details");
-    tp_details.add_title("address");
-    tp_details.add_column("status");
+    dsn::utils::json_table_writer writer(resp.body);
     if (detailed) {
-        tp_details.add_column("replica_count");
-        tp_details.add_column("primary_count");
-        tp_details.add_column("secondary_count");
+        writer.start_table(
+            "details", {"address", "status", "replica_count", "primary_count", "secondary_count"});
+    } else {
+        writer.start_table("details", {"address", "status"});
     }
     for (const auto &kv : tmp_map) {
-        tp_details.add_row(kv.second.node_address);
-        tp_details.append_data(kv.second.node_status);
+        writer.add_row(kv.second.node_address);
+        writer.append_data(kv.second.node_status);
         if (detailed) {
-            tp_details.append_data(kv.second.primary_count + kv.second.secondary_count);
-            tp_details.append_data(kv.second.primary_count);
-            tp_details.append_data(kv.second.secondary_count);
+            writer.append_data(kv.second.primary_count + kv.second.secondary_count);
+            writer.append_data(kv.second.primary_count);
+            writer.append_data(kv.second.secondary_count);
         }
     }
-    mtp.add(std::move(tp_details));
+    writer.end_table();
 
-    dsn::utils::table_printer tp_count("summary");
-    tp_count.add_row_name_and_data("total_node_count", alive_node_count + unalive_node_count);
-    tp_count.add_row_name_and_data("alive_node_count", alive_node_count);
-    tp_count.add_row_name_and_data("unalive_node_count", unalive_node_count);
-    mtp.add(std::move(tp_count));
-    mtp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
+    writer.start_table("summary");
+    writer.add_row_name_and_data("total_node_count", alive_node_count + unalive_node_count);
+    writer.add_row_name_and_data("alive_node_count", alive_node_count);
+    writer.add_row_name_and_data("unalive_node_count", unalive_node_count);
+    if (!next_node.empty()) {
+        writer.add_row_name_and_data("next_start_node", next_node);
+    }
+    writer.end_table();
 
-    resp.body = out.str();
+    writer.finish();
     resp.status_code = http_status_code::ok;
 }
 
@@ -815,6 +872,28 @@ void meta_http_service::update_scenario_handler(const http_request &req, http_re
     update_app_env(info.app_name, keys, values, resp);
 }
 
+void meta_http_service::query_recovery_handler(const http_request &req, http_response &resp)
+{
+    if (!redirect_if_not_primary(req, resp))
+        return;
+
+    recovery_progress progress = _service->_state->get_recovery_progress();
+    uint64_t end_time_ms = progress.end_time_ms > 0 ? progress.end_time_ms : dsn_now_ms();
+
+    dsn::utils::table_printer tp;
+    tp.add_row_name_and_data("stage", progress.stage);
+    tp.add_row_name_and_data("total_nodes", progress.total_nodes);
+    tp.add_row_name_and_data("queried_nodes", progress.queried_nodes);
+    tp.add_row_name_and_data("failed_nodes", progress.failed_nodes);
+    tp.add_row_name_and_data("elapsed_ms",
+                             progress.start_time_ms > 0 ? end_time_ms - progress.start_time_ms
+                                                        : 0);
+    std::ostringstream out;
+    tp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
+    resp.body = out.str();
+    resp.status_code = http_status_code::ok;
+}
+
 bool meta_http_service::redirect_if_not_primary(const http_request &req, http_response &resp)
 {
 #ifdef DSN_MOCK_TEST
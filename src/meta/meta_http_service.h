@@ -25,8 +25,12 @@
 namespace dsn {
 namespace replication {
 
-NON_MEMBER_JSON_SERIALIZATION(
-    start_bulk_load_request, app_name, cluster_name, file_provider_type, remote_root_path)
+NON_MEMBER_JSON_SERIALIZATION(start_bulk_load_request,
+                              app_name,
+                              cluster_name,
+                              file_provider_type,
+                              remote_root_path,
+                              non_blocking_ingestion)
 
 struct manual_compaction_info
 {
@@ -62,7 +66,8 @@ public:
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/meta/app?app_name=temp");
+                         "ip:port/meta/app?name=<app_name>[&detail][&start_partition=<pidx>]"
+                         "[&limit=<count>]");
         register_handler("app/duplication",
                          std::bind(&meta_http_service::query_duplication_handler,
                                    this,
@@ -74,13 +79,15 @@ public:
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/meta/apps");
+                         "ip:port/meta/apps[?detail][&start_app_id=<app_id>][&limit=<count>]"
+                         "[&name_prefix=<prefix>]");
         register_handler("nodes",
                          std::bind(&meta_http_service::list_node_handler,
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/meta/nodes");
+                         "ip:port/meta/nodes[?detail][&start_node=<ip:port>][&limit=<count>]"
+                         "[&status=ALIVE|UNALIVE]");
         register_handler("cluster",
                          std::bind(&meta_http_service::get_cluster_info_handler,
                                    this,
@@ -126,6 +133,12 @@ public:
                                    std::placeholders::_1,
                                    std::placeholders::_2),
                          "ip:port/meta/app/usage_scenario");
+        register_handler("recovery",
+                         std::bind(&meta_http_service::query_recovery_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/meta/recovery");
     }
 
     std::string path() const override { return "meta"; }
@@ -141,6 +154,7 @@ public:
     void query_bulk_load_handler(const http_request &req, http_response &resp);
     void start_compaction_handler(const http_request &req, http_response &resp);
     void update_scenario_handler(const http_request &req, http_response &resp);
+    void query_recovery_handler(const http_request &req, http_response &resp);
 
 private:
     // set redirect location if current server is not primary
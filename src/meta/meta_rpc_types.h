@@ -30,6 +30,8 @@ typedef rpc_holder<configuration_query_by_node_request, configuration_query_by_n
     configuration_query_by_node_rpc;
 typedef rpc_holder<configuration_query_by_index_request, configuration_query_by_index_response>
     configuration_query_by_index_rpc;
+typedef rpc_holder<configuration_watch_app_request, configuration_query_by_index_response>
+    configuration_watch_app_rpc;
 typedef rpc_holder<configuration_list_apps_request, configuration_list_apps_response>
     configuration_list_apps_rpc;
 typedef rpc_holder<configuration_list_nodes_request, configuration_list_nodes_response>
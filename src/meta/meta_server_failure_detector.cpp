@@ -35,6 +35,7 @@
 
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 #include "meta_server_failure_detector.h"
 #include "server_state.h"
@@ -47,6 +48,13 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  leader_lock_release_timeout_ms,
+                  3000,
+                  "how long the leader waits for its lock node to be removed when it stops "
+                  "gracefully, 0 means the lock is left to expire with the zookeeper session");
+DSN_TAG_VARIABLE(leader_lock_release_timeout_ms, FT_MUTABLE);
+
 meta_server_failure_detector::meta_server_failure_detector(meta_service *svc)
     : _svc(svc),
       _lock_svc(nullptr),
@@ -111,7 +119,7 @@ bool meta_server_failure_detector::get_leader(rpc_address *leader)
     if (_is_leader.load()) {
         *leader = dsn_primary_address();
         return true;
-    } else if (_lock_svc == nullptr) {
+    } else if (_lock_svc == nullptr || _leader_lock_released.load()) {
         leader->set_invalid();
         return false;
     } else {
@@ -178,6 +186,34 @@ void meta_server_failure_detector::acquire_leader_lock()
     }
 }
 
+void meta_server_failure_detector::release_leader_lock()
+{
+    if (_lock_svc == nullptr || FLAGS_leader_lock_release_timeout_ms == 0 ||
+        !_is_leader.exchange(false)) {
+        return;
+    }
+    _leader_lock_released.store(true);
+
+    // the lock is removed on purpose, the expire callback must not exit the process
+    if (_lock_expire_task)
+        _lock_expire_task->cancel(true);
+
+    ddebug("release the leader lock(%s)", _primary_lock_id.c_str());
+    task_ptr unlock_task =
+        _lock_svc->unlock(_primary_lock_id,
+                          dsn_primary_address().to_std_string(),
+                          false,
+                          LPC_META_SERVER_LEADER_LOCK_CALLBACK,
+                          [](error_code ec) {
+                              ddebug("leader lock released callback: err(%s)", ec.to_string());
+                          });
+    if (!unlock_task->wait(FLAGS_leader_lock_release_timeout_ms)) {
+        dwarn("release the leader lock(%s) timeout after %u ms, leave it to the session expire",
+              _primary_lock_id.c_str(),
+              FLAGS_leader_lock_release_timeout_ms);
+    }
+}
+
 void meta_server_failure_detector::reset_stability_stat(const rpc_address &node)
 {
     zauto_lock l(_map_lock);
@@ -75,6 +75,10 @@ public:
     // return if acquire the leader lock, or-else blocked forever
     void acquire_leader_lock();
 
+    // gives up the leader lock when the meta server stops gracefully, so that a standby takes
+    // over as soon as the lock node is removed, instead of after the zookeeper session expires
+    void release_leader_lock();
+
     void reset_stability_stat(const dsn::rpc_address &node);
 
     // _fd_opts is initialized in constructor with a fd_suboption stored in meta_service.
@@ -132,6 +136,8 @@ private:
     task_ptr _lock_grant_task;
     task_ptr _lock_expire_task;
     std::atomic_bool _is_leader;
+    // the lock cache still names myself as the owner after the lock is released
+    std::atomic_bool _leader_lock_released{false};
     std::atomic<uint64_t> _election_moment;
 
     // record the start time of a replica-server, check if it crashed frequently
@@ -32,6 +32,7 @@
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/extensible_object.h>
 #include <dsn/utility/string_conv.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/meta_state_service.h>
 #include <dsn/dist/replication/duplication_common.h>
 #include <dsn/dist/remote_command.h>
@@ -47,11 +48,26 @@
 #include "meta/duplication/meta_duplication_service.h"
 #include "meta_split_service.h"
 #include "meta_bulk_load_service.h"
+#include "meta_state_service_versioned.h"
 #include "runtime/security/access_controller.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("meta_server",
+                warm_standby_enabled,
+                false,
+                "whether the meta servers waiting for the leader lock keep a copy of the apps on "
+                "the remote storage, which is used at takeover unless they have changed since. it "
+                "should be enabled on all the meta servers of the cluster together");
+DSN_DEFINE_uint32("meta_server",
+                  warm_standby_sync_interval_seconds,
+                  10,
+                  "the interval of checking whether the copy of the apps is up to date on the "
+                  "meta servers waiting for the leader lock");
+DSN_DEFINE_validator(warm_standby_sync_interval_seconds,
+                     [](uint32_t value) -> bool { return value > 0; });
+
 meta_service::meta_service()
     : serverlet("meta_service"), _failure_detector(nullptr), _started(false), _recovering(false)
 {
@@ -83,6 +99,9 @@ meta_service::meta_service()
 
 meta_service::~meta_service()
 {
+    if (_failure_detector != nullptr) {
+        _failure_detector->release_leader_lock();
+    }
     _tracker.cancel_outstanding_tasks();
     unregister_ctrl_commands();
 }
@@ -207,6 +226,14 @@ error_code meta_service::remote_storage_initialize()
     }
     _cluster_root = current.empty() ? "/" : current;
 
+    if (FLAGS_warm_standby_enabled) {
+        _storage = std::make_shared<dist::meta_state_service_versioned>(
+            _storage,
+            meta_options::concat_path_unix_style(_cluster_root, "apps"),
+            apps_version_node());
+        _meta_storage.reset(new mss::meta_storage(_storage.get(), &_tracker));
+    }
+
     ddebug("init meta_state_service succeed, cluster_root = %s", _cluster_root.c_str());
     return ERR_OK;
 }
@@ -320,6 +347,16 @@ void meta_service::start_service()
                            server_state::sStateHash,
                            std::chrono::milliseconds(_opts.lb_interval_ms));
 
+    if (meta_split_service::auto_split_enabled()) {
+        ddebug("start auto split checker");
+        tasking::enqueue_timer(LPC_META_STATE_NORMAL,
+                               nullptr,
+                               [this]() { _split_svc->check_auto_split(); },
+                               meta_split_service::auto_split_check_interval(),
+                               server_state::sStateHash,
+                               meta_split_service::auto_split_check_interval());
+    }
+
     if (!_meta_opts.cold_backup_disabled) {
         ddebug("start backup service");
         tasking::enqueue(LPC_DEFAULT_CALLBACK,
@@ -371,11 +408,23 @@ error_code meta_service::start()
     // so that the command line call can be handled
     dist::cmd::register_remote_command_rpc();
 
+    if (FLAGS_warm_standby_enabled) {
+        _standby_sync_task =
+            tasking::enqueue_timer(LPC_META_STATE_NORMAL,
+                                   &_tracker,
+                                   [this]() { standby_sync(); },
+                                   std::chrono::seconds(FLAGS_warm_standby_sync_interval_seconds));
+    }
+
     _failure_detector->acquire_leader_lock();
     dassert(_failure_detector->get_leader(nullptr), "must be primary at this point");
     ddebug("%s got the primary lock, start to recover server state from remote storage",
            dsn_primary_address().to_string());
 
+    std::unique_ptr<apps_snapshot> snapshot = take_standby_snapshot();
+    err = renew_apps_version();
+    dreturn_not_ok_logged(err, "renew the version of apps failed, err = %s", err.to_string());
+
     // initialize the load balancer
     server_load_balancer *balancer = utils::factory_store<server_load_balancer>::create(
         _meta_opts._lb_opts.server_load_balancer_type.c_str(), PROVIDER_TYPE_MAIN, this);
@@ -399,7 +448,8 @@ error_code meta_service::start()
 
     // initialize the server_state
     _state->initialize(this, meta_options::concat_path_unix_style(_cluster_root, "apps"));
-    while ((err = _state->initialize_data_structure()) != ERR_OK) {
+    while ((err = _state->initialize_data_structure(snapshot.get())) != ERR_OK) {
+        snapshot.reset();
         if (err == ERR_OBJECT_NOT_FOUND && _meta_opts.recover_from_replica_server) {
             ddebug("can't find apps from remote storage, and "
                    "[meta_server].recover_from_replica_server = true, "
@@ -424,6 +474,99 @@ error_code meta_service::start()
     return ERR_OK;
 }
 
+std::string meta_service::apps_version_node() const
+{
+    return meta_options::concat_path_unix_style(_cluster_root, "apps_version");
+}
+
+error_code meta_service::get_apps_version(/*out*/ std::string &version)
+{
+    error_code err;
+    _storage
+        ->get_data(apps_version_node(),
+                   LPC_META_CALLBACK,
+                   [&err, &version](error_code ec, const blob &value) {
+                       err = ec;
+                       if (ec == ERR_OK) {
+                           version = value.to_string();
+                       }
+                   })
+        ->wait();
+    return err;
+}
+
+error_code meta_service::renew_apps_version()
+{
+    auto versioned = dynamic_cast<dist::meta_state_service_versioned *>(_storage.get());
+    if (versioned != nullptr) {
+        return versioned->renew_version();
+    }
+
+    // the version may be left by a leader with warm standby enabled, which must not be trusted
+    // any more since the apps are changed without it
+    error_code err;
+    _storage
+        ->delete_node(
+            apps_version_node(), false, LPC_META_CALLBACK, [&err](error_code ec) { err = ec; })
+        ->wait();
+    return err == ERR_OBJECT_NOT_FOUND ? ERR_OK : err;
+}
+
+// runs in the meta state thread until the leader lock is granted
+void meta_service::standby_sync()
+{
+    std::string version;
+    error_code err = get_apps_version(version);
+    if (err != ERR_OK || version.empty()) {
+        // the version is missing or cleared by a recursive delete in progress
+        _standby_snapshot.reset();
+        return;
+    }
+    if (_standby_snapshot != nullptr && _standby_snapshot->version == version) {
+        return;
+    }
+
+    uint64_t start_ms = dsn_now_ms();
+    auto snapshot = make_unique<apps_snapshot>();
+    snapshot->version = version;
+    err = server_state::load_apps_snapshot(
+        _storage.get(), meta_options::concat_path_unix_style(_cluster_root, "apps"), *snapshot);
+    if (err != ERR_OK) {
+        dwarn_f("load the standby snapshot of apps failed, err = {}", err.to_string());
+        _standby_snapshot.reset();
+        return;
+    }
+    ddebug_f("loaded the standby snapshot of {} apps at version {} in {} ms",
+             snapshot->apps.size(),
+             version,
+             dsn_now_ms() - start_ms);
+    _standby_snapshot = std::move(snapshot);
+}
+
+std::unique_ptr<apps_snapshot> meta_service::take_standby_snapshot()
+{
+    if (_standby_sync_task == nullptr) {
+        return nullptr;
+    }
+    _standby_sync_task->cancel(true);
+    _standby_sync_task = nullptr;
+    if (_standby_snapshot == nullptr) {
+        return nullptr;
+    }
+
+    std::string version;
+    error_code err = get_apps_version(version);
+    if (err != ERR_OK || version != _standby_snapshot->version) {
+        ddebug_f("the standby snapshot of apps at version {} is outdated, reload all from the "
+                 "remote storage",
+                 _standby_snapshot->version);
+        _standby_snapshot.reset();
+        return nullptr;
+    }
+    ddebug_f("the standby snapshot of apps at version {} is up to date, recover from it", version);
+    return std::move(_standby_snapshot);
+}
+
 void meta_service::register_rpc_handlers()
 {
     register_rpc_handler_with_rpc_holder(
@@ -431,6 +574,9 @@ void meta_service::register_rpc_handlers()
     register_rpc_handler_with_rpc_holder(RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX,
                                          "query_configuration_by_index",
                                          &meta_service::on_query_configuration_by_index);
+    register_rpc_handler_with_rpc_holder(RPC_CM_WATCH_APP_CONFIGURATION,
+                                         "watch_app_configuration",
+                                         &meta_service::on_watch_app_configuration);
     register_rpc_handler(RPC_CM_UPDATE_PARTITION_CONFIGURATION,
                          "update_configuration",
                          &meta_service::on_update_configuration);
@@ -495,6 +641,9 @@ void meta_service::register_rpc_handlers()
         RPC_CM_START_BACKUP_APP, "start_backup_app", &meta_service::on_start_backup_app);
     register_rpc_handler_with_rpc_holder(
         RPC_CM_QUERY_BACKUP_STATUS, "query_backup_status", &meta_service::on_query_backup_status);
+    register_rpc_handler_with_rpc_holder(RPC_CM_ACQUIRE_BACKGROUND_TASK,
+                                         "acquire_background_task",
+                                         &meta_service::on_acquire_background_task);
 }
 
 int meta_service::check_leader(dsn::message_ex *req, dsn::rpc_address *forward_address)
@@ -645,6 +794,15 @@ void meta_service::on_query_cluster_info(configuration_cluster_info_rpc rpc)
     response.err = dsn::ERR_OK;
 }
 
+// client => meta server
+void meta_service::on_watch_app_configuration(configuration_watch_app_rpc rpc)
+{
+    if (!check_status(rpc)) {
+        return;
+    }
+    _state->watch_app_configuration(std::move(rpc));
+}
+
 // client => meta server
 void meta_service::on_query_configuration_by_index(configuration_query_by_index_rpc rpc)
 {
@@ -659,6 +817,18 @@ void meta_service::on_query_configuration_by_index(configuration_query_by_index_
         return;
     }
 
+    blob data;
+    if (_state->query_configuration_by_index_serialized(
+            rpc.request(),
+            (dsn_msg_serialize_format)rpc.dsn_request()->header->context.u.serialize_format,
+            data)) {
+        ddebug_f("client {} queried an available app {}",
+                 rpc.dsn_request()->header->from_address.to_string(),
+                 rpc.request().app_name);
+        rpc.reply_serialized(data);
+        return;
+    }
+
     _state->query_configuration_by_index(rpc.request(), response);
     if (ERR_OK == response.err) {
         ddebug_f("client {} queried an available app {} with appid {}",
@@ -1168,5 +1338,20 @@ void meta_service::on_query_backup_status(query_backup_status_rpc rpc)
     _backup_handler->query_backup_status(std::move(rpc));
 }
 
+void meta_service::on_acquire_background_task(background_task_rpc rpc)
+{
+    if (!check_status(rpc)) {
+        return;
+    }
+
+    const background_task_request &request = rpc.request();
+    partition_configuration config;
+    if (!_state->query_configuration_by_gpid(request.pid, config)) {
+        rpc.response().err = ERR_OBJECT_NOT_FOUND;
+        return;
+    }
+    _background_task_scheduler.on_request(request, config, dsn_now_ms(), rpc.response());
+}
+
 } // namespace replication
 } // namespace dsn
@@ -47,6 +47,7 @@
 #include "meta_backup_service.h"
 #include "meta_state_service_utils.h"
 #include "block_service/block_service_manager.h"
+#include "background_task_scheduler.h"
 
 namespace dsn {
 namespace security {
@@ -55,6 +56,7 @@ class access_controller;
 namespace replication {
 
 class server_state;
+struct apps_snapshot;
 class meta_server_failure_detector;
 class server_load_balancer;
 class meta_duplication_service;
@@ -138,6 +140,7 @@ private:
 
     // client => meta server
     void on_query_configuration_by_index(configuration_query_by_index_rpc rpc);
+    void on_watch_app_configuration(configuration_watch_app_rpc rpc);
 
     // partition server => meta server
     void on_config_sync(configuration_query_by_node_rpc rpc);
@@ -176,6 +179,9 @@ private:
     void on_report_restore_status(configuration_report_restore_status_rpc rpc);
     void on_query_restore_status(configuration_query_restore_rpc rpc);
 
+    // the checkpoints and manual compactions of the replicas
+    void on_acquire_background_task(background_task_rpc rpc);
+
     // duplication
     void on_add_duplication(duplication_add_rpc rpc);
     void on_modify_duplication(duplication_modify_rpc rpc);
@@ -218,6 +224,13 @@ private:
     error_code remote_storage_initialize();
     bool check_freeze() const;
 
+    // warm standby, see meta_state_service_versioned
+    std::string apps_version_node() const;
+    error_code get_apps_version(/*out*/ std::string &version);
+    error_code renew_apps_version();
+    void standby_sync();
+    std::unique_ptr<apps_snapshot> take_standby_snapshot();
+
 private:
     friend class backup_engine_test;
     friend class backup_service_test;
@@ -246,6 +259,11 @@ private:
     std::shared_ptr<dist::meta_state_service> _storage;
     std::unique_ptr<mss::meta_storage> _meta_storage;
 
+    // reloads the apps tree periodically until the leader lock is granted, only accessed in the
+    // meta state thread until then
+    task_ptr _standby_sync_task;
+    std::unique_ptr<apps_snapshot> _standby_snapshot;
+
     std::shared_ptr<server_load_balancer> _balancer;
     std::shared_ptr<backup_service> _backup_handler;
 
@@ -255,6 +273,8 @@ private:
 
     std::unique_ptr<bulk_load_service> _bulk_load_svc;
 
+    background_task_scheduler _background_task_scheduler;
+
     // handle all the block filesystems for current meta service
     // (in other words, current service node)
     dist::block_service::block_service_manager _block_service_manager;
@@ -15,9 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replica_envs.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
 
 #include "meta_split_service.h"
 #include "meta_state_service_utils.h"
@@ -25,6 +29,71 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("meta_server",
+                auto_split_enabled,
+                false,
+                "whether to start the partition split of a table automatically when one of its "
+                "partitions is over the auto_split_partition_* thresholds, which requires the "
+                "replica servers to report the partition usages");
+DSN_DEFINE_uint32("meta_server",
+                  auto_split_check_interval_seconds,
+                  300,
+                  "the interval to check whether to split the tables automatically");
+DSN_DEFINE_uint64("meta_server",
+                  auto_split_partition_qps_threshold,
+                  20000,
+                  "split the table if the read and write qps of a partition is over this, 0 to "
+                  "disable");
+DSN_DEFINE_uint64("meta_server",
+                  auto_split_partition_write_mb_threshold,
+                  50,
+                  "split the table if the written MB per second of a partition is over this, 0 "
+                  "to disable");
+DSN_DEFINE_uint32("meta_server",
+                  auto_split_max_partition_count,
+                  1024,
+                  "don't split a table automatically to more partitions than this");
+DSN_DEFINE_uint32("meta_server",
+                  auto_split_cooldown_seconds,
+                  3600,
+                  "the min interval between two automatic splits of a table, so that the "
+                  "usages of the new partitions are reported before the next check");
+DSN_DEFINE_uint32("meta_server",
+                  register_child_batch_window_ms,
+                  10,
+                  "how long the child registrations of a splitting app are coalesced before "
+                  "written to the remote storage in a transaction");
+DSN_TAG_VARIABLE(register_child_batch_window_ms, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  register_child_batch_max_count,
+                  64,
+                  "the max count of child registrations written in one transaction, the "
+                  "children are registered one by one if it is not greater than 1");
+DSN_TAG_VARIABLE(register_child_batch_max_count, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  auto_split_min_hot_partition_percent,
+                  50,
+                  "split a table only if at least this percent of its partitions are over the "
+                  "thresholds, since a split doesn't help a single hot partition or hot key");
+DSN_DEFINE_uint32("meta_server",
+                  auto_split_max_consecutive_count,
+                  3,
+                  "stop splitting a table automatically after this many consecutive splits which "
+                  "didn't bring its partitions below the thresholds, until the load goes down");
+DSN_DEFINE_validator(auto_split_check_interval_seconds,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_validator(auto_split_min_hot_partition_percent,
+                     [](uint32_t value) -> bool { return value > 0 && value <= 100; });
+DSN_DEFINE_validator(auto_split_max_consecutive_count,
+                     [](uint32_t value) -> bool { return value > 0; });
+
+/*static*/ bool meta_split_service::auto_split_enabled() { return FLAGS_auto_split_enabled; }
+
+/*static*/ std::chrono::seconds meta_split_service::auto_split_check_interval()
+{
+    return std::chrono::seconds(FLAGS_auto_split_check_interval_seconds);
+}
+
 meta_split_service::meta_split_service(meta_service *meta_srv)
 {
     _meta_svc = meta_srv;
@@ -103,6 +172,7 @@ void meta_split_service::do_start_partition_split(std::shared_ptr<app_state> app
                 app->helpers->split_states.status[i] = split_status::SPLITTING;
             }
         }
+        _state->refresh_query_view(app);
 
         auto &response = rpc.response();
         response.err = ERR_OK;
@@ -205,11 +275,54 @@ void meta_split_service::register_child_on_meta(register_child_rpc rpc)
 }
 
 dsn::task_ptr meta_split_service::add_child_on_remote_storage(register_child_rpc rpc,
-                                                              bool create_new)
+                                                              bool create_new,
+                                                              bool batched)
 {
     const auto &request = rpc.request();
-    const std::string &partition_path = _state->get_partition_path(request.child_config.pid);
+    std::string partition_path = _state->get_partition_path(request.child_config.pid);
     blob value = dsn::json::json_forwarder<partition_configuration>::encode(request.child_config);
+    if (batched && FLAGS_register_child_batch_max_count > 1) {
+        // registering the children of a large app one by one takes lots of round trips, while
+        // the writes are paused on each parent
+        error_code_future_ptr tsk(new error_code_future(
+            LPC_META_STATE_HIGH,
+            [this, rpc, create_new](error_code ec) {
+                if (ec == ERR_OK) {
+                    on_add_child_on_remote_storage_reply(ec, rpc, create_new);
+                    return;
+                }
+                // any failed child fails the whole transaction, register them one by one then
+                dwarn_f("register child({}) in batch failed, err = {}, retry it alone",
+                        rpc.request().child_config.pid,
+                        ec);
+                zauto_write_lock l(app_lock());
+                std::shared_ptr<app_state> app = _state->get_app(rpc.request().app.app_name);
+                dassert_f(app != nullptr, "app({}) is not existed", rpc.request().app.app_name);
+                config_context &parent_context =
+                    app->helpers->contexts[rpc.request().parent_config.pid.get_partition_index()];
+                parent_context.pending_sync_task =
+                    add_child_on_remote_storage(rpc, create_new, false);
+            },
+            0));
+        tsk->set_tracker(_meta_svc->tracker());
+        int32_t app_id = request.child_config.pid.get_app_id();
+        bool schedule_flush = false;
+        {
+            zauto_lock l(_pending_registrations_lock);
+            auto &registrations = _pending_registrations[app_id];
+            schedule_flush = registrations.empty();
+            registrations.push_back({std::move(partition_path), value, create_new, tsk});
+        }
+        if (schedule_flush) {
+            tasking::enqueue(LPC_META_STATE_HIGH,
+                             _meta_svc->tracker(),
+                             [this, app_id]() { flush_child_registrations(app_id); },
+                             0,
+                             std::chrono::milliseconds(FLAGS_register_child_batch_window_ms));
+        }
+        return tsk;
+    }
+
     if (create_new) {
         return _meta_svc->get_remote_storage()->create_node(
             partition_path,
@@ -234,6 +347,53 @@ dsn::task_ptr meta_split_service::add_child_on_remote_storage(register_child_rpc
     }
 }
 
+void meta_split_service::flush_child_registrations(int32_t app_id)
+{
+    std::vector<pending_child_registration> registrations;
+    {
+        zauto_lock l(_pending_registrations_lock);
+        auto iter = _pending_registrations.find(app_id);
+        if (iter == _pending_registrations.end()) {
+            return;
+        }
+        registrations.swap(iter->second);
+        _pending_registrations.erase(iter);
+    }
+
+    // the registrations of the canceled splits needn't be written any more
+    registrations.erase(std::remove_if(registrations.begin(),
+                                       registrations.end(),
+                                       [](const pending_child_registration &r) {
+                                           return r.callback->state() == TASK_STATE_CANCELLED;
+                                       }),
+                        registrations.end());
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    size_t batch_count = std::max(FLAGS_register_child_batch_max_count, 1U);
+    for (size_t start = 0; start < registrations.size(); start += batch_count) {
+        size_t end = std::min(start + batch_count, registrations.size());
+        auto entries = storage->new_transaction_entries(static_cast<unsigned int>(end - start));
+        std::vector<error_code_future_ptr> callbacks;
+        callbacks.reserve(end - start);
+        for (size_t i = start; i < end; ++i) {
+            const pending_child_registration &r = registrations[i];
+            error_code ec = r.create_new ? entries->create_node(r.path, r.value)
+                                         : entries->set_data(r.path, r.value);
+            dassert_f(ec == ERR_OK, "add {} to transaction failed, err = {}", r.path, ec);
+            callbacks.emplace_back(r.callback);
+        }
+        ddebug_f("register {} children of app({}) in a transaction", callbacks.size(), app_id);
+        storage->submit_transaction(entries,
+                                    LPC_META_STATE_HIGH,
+                                    [callbacks](error_code ec) {
+                                        for (const auto &callback : callbacks) {
+                                            callback->enqueue_with(ec);
+                                        }
+                                    },
+                                    _meta_svc->tracker());
+    }
+}
+
 void meta_split_service::on_add_child_on_remote_storage_reply(error_code ec,
                                                               register_child_rpc rpc,
                                                               bool create_new)
@@ -533,6 +693,7 @@ void meta_split_service::do_cancel_partition_split(std::shared_ptr<app_state> ap
         app->partition_count /= 2;
         app->helpers->contexts.resize(app->partition_count);
         app->partitions.resize(app->partition_count);
+        _state->refresh_query_view(app);
     };
 
     auto copy = *app;
@@ -577,5 +738,109 @@ void meta_split_service::query_child_state(query_child_state_rpc rpc)
     response.__set_child_config(app->partitions[child_pidx]);
 }
 
+bool meta_split_service::should_auto_split(const app_state &app,
+                                           /*out*/ std::string &reason) const
+{
+    if (app.status != app_status::AS_AVAILABLE || app.splitting() ||
+        app.partition_count * 2 > static_cast<int32_t>(FLAGS_auto_split_max_partition_count)) {
+        return false;
+    }
+
+    // the expired usages are not returned, so a partition which stops reporting, e.g. the
+    // parent of the last split, doesn't count as hot
+    std::vector<partition_quota> usages;
+    _state->_quota_allocator.get_usages(app, usages);
+    int32_t hot_count = 0;
+    uint64_t max_qps = 0;
+    uint64_t max_write_bytes_per_sec = 0;
+    for (const partition_quota &usage : usages) {
+        uint64_t qps = usage.write_qps + usage.read_qps;
+        uint64_t write_bytes_per_sec = static_cast<uint64_t>(usage.write_bytes_per_sec);
+        max_qps = std::max(max_qps, qps);
+        max_write_bytes_per_sec = std::max(max_write_bytes_per_sec, write_bytes_per_sec);
+        if ((FLAGS_auto_split_partition_qps_threshold > 0 &&
+             qps > FLAGS_auto_split_partition_qps_threshold) ||
+            (FLAGS_auto_split_partition_write_mb_threshold > 0 &&
+             write_bytes_per_sec > (FLAGS_auto_split_partition_write_mb_threshold << 20))) {
+            ++hot_count;
+        }
+    }
+
+    // splitting doubles all the partitions, which is only worth it if the load is spread over
+    // many of them rather than on a few hot ones
+    if (hot_count == 0 || static_cast<uint64_t>(hot_count) * 100 <
+                              static_cast<uint64_t>(app.partition_count) *
+                                  FLAGS_auto_split_min_hot_partition_percent) {
+        return false;
+    }
+    reason = fmt::format("{} of its {} partitions are over the thresholds, with max qps {} and "
+                         "max written bytes per second {}",
+                         hot_count,
+                         app.partition_count,
+                         max_qps,
+                         max_write_bytes_per_sec);
+    return true;
+}
+
+void meta_split_service::check_auto_split()
+{
+    uint64_t now_ms = dsn_now_ms();
+    std::string app_name;
+    int32_t new_partition_count = 0;
+    {
+        zauto_read_lock l(app_lock());
+        for (const auto &kv : _state->_exist_apps) {
+            // split one table at a time
+            if (kv.second->splitting()) {
+                return;
+            }
+        }
+        for (const auto &kv : _state->_exist_apps) {
+            const app_state &app = *kv.second;
+            auto history = _auto_split_histories.find(app.app_id);
+            if (history != _auto_split_histories.end() &&
+                history->second.last_split_ms + FLAGS_auto_split_cooldown_seconds * 1000ULL >
+                    now_ms) {
+                continue;
+            }
+            std::string reason;
+            if (!should_auto_split(app, reason)) {
+                // the load went down, so the next automatic split is not consecutive
+                if (history != _auto_split_histories.end()) {
+                    _auto_split_histories.erase(history);
+                }
+                continue;
+            }
+            if (history != _auto_split_histories.end() &&
+                history->second.consecutive_count >= FLAGS_auto_split_max_consecutive_count) {
+                dwarn_f("don't split app({}) automatically although {}, because it has been "
+                        "split {} times in a row",
+                        app.app_name,
+                        reason,
+                        history->second.consecutive_count);
+                continue;
+            }
+            ddebug_f("split app({}) automatically to {} partitions, because {}",
+                     app.app_name,
+                     app.partition_count * 2,
+                     reason);
+            app_name = app.app_name;
+            new_partition_count = app.partition_count * 2;
+            auto_split_history &h = _auto_split_histories[app.app_id];
+            h.last_split_ms = now_ms;
+            ++h.consecutive_count;
+            break;
+        }
+    }
+    if (app_name.empty()) {
+        return;
+    }
+
+    auto request = make_unique<start_partition_split_request>();
+    request->app_name = app_name;
+    request->new_partition_count = new_partition_count;
+    start_partition_split(start_split_rpc(std::move(request), RPC_CM_START_PARTITION_SPLIT));
+}
+
 } // namespace replication
 } // namespace dsn
@@ -46,10 +46,13 @@ private:
     // primary parent -> meta_server to register child
     void register_child_on_meta(register_child_rpc rpc);
 
-    // meta -> remote storage to update child replica config
-    dsn::task_ptr add_child_on_remote_storage(register_child_rpc rpc, bool create_new);
+    // meta -> remote storage to update child replica config, which is written with the other
+    // children of the app registered around the same time in a transaction if `batched`
+    dsn::task_ptr
+    add_child_on_remote_storage(register_child_rpc rpc, bool create_new, bool batched = true);
     void
     on_add_child_on_remote_storage_reply(error_code ec, register_child_rpc rpc, bool create_new);
+    void flush_child_registrations(int32_t app_id);
 
     // primary replica -> meta to notify group pause or cancel split succeed
     void notify_stop_split(notify_stop_split_rpc rpc);
@@ -58,6 +61,16 @@ private:
     // primary replica -> meta to query child state
     void query_child_state(query_child_state_rpc rpc);
 
+    // whether [meta_server] auto_split_enabled is on
+    static bool auto_split_enabled();
+    static std::chrono::seconds auto_split_check_interval();
+
+    // meta timer to start the partition split of an overloaded table, by the partition usages
+    // reported in the config sync
+    void check_auto_split();
+    // return true if the app should be split, `reason` is set then
+    bool should_auto_split(const app_state &app, /*out*/ std::string &reason) const;
+
     static const std::string control_type_str(split_control_type::type type)
     {
         std::string str = "";
@@ -78,6 +91,28 @@ private:
     meta_service *_meta_svc;
     server_state *_state;
 
+    struct auto_split_history
+    {
+        uint64_t last_split_ms = 0;
+        // the automatic splits since the app was last found below the thresholds
+        uint32_t consecutive_count = 0;
+    };
+    // app_id -> the automatic splits of the app, only accessed by the timer
+    std::unordered_map<int32_t, auto_split_history> _auto_split_histories;
+
+    // the child configs waiting to be written to the remote storage in batch, each is
+    // completed by its own callback task, which is the pending_sync_task of the parent
+    struct pending_child_registration
+    {
+        std::string path;
+        blob value;
+        bool create_new;
+        error_code_future_ptr callback;
+    };
+    zlock _pending_registrations_lock;
+    // app_id -> registrations, whose flush is scheduled if the app is present
+    std::unordered_map<int32_t, std::vector<pending_child_registration>> _pending_registrations;
+
     zrwlock_nr &app_lock() const { return _state->_lock; }
 };
 } // namespace replication
@@ -38,12 +38,21 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 
 #include <stack>
+#include <unistd.h>
 #include <utility>
 
 namespace dsn {
 namespace dist {
+
+DSN_DEFINE_uint64("meta_server",
+                  meta_state_service_simple_log_compact_threshold_mb,
+                  64,
+                  "the log of meta_state_service_simple is compacted into the records of the "
+                  "current state once it exceeds the size and doubles since the last compaction, "
+                  "0 means never");
 // path: /, /n1/n2, /n1/n2/, /n2/n2/n3
 std::string meta_state_service_simple::normalize_path(const std::string &s)
 {
@@ -110,6 +119,15 @@ void meta_state_service_simple::write_log(blob &&log_blob,
                         _task_queue.front()->cb(true);
                         _task_queue.pop();
                     }
+                    // all the logged operations are applied now, the tree matches the log
+                    if (_task_queue.empty() && need_compact_log()) {
+                        error_code ec = compact_log();
+                        if (ec != ERR_OK) {
+                            dwarn("compact log %s failed, err = %s, continue with the old log",
+                                  _log_path.c_str(),
+                                  ec.to_string());
+                        }
+                    }
                     _log_lock.unlock();
                 });
 }
@@ -230,13 +248,88 @@ error_code meta_state_service_simple::apply_transaction(
     return ERR_OK;
 }
 
+bool meta_state_service_simple::need_compact_log() const
+{
+    uint64_t threshold = FLAGS_meta_state_service_simple_log_compact_threshold_mb << 20;
+    return threshold > 0 && _offset >= threshold && _offset >= 2 * _compacted_offset;
+}
+
+error_code meta_state_service_simple::compact_log()
+{
+    uint64_t start_time = dsn_now_ms();
+    std::string tmp_path = _log_path + ".tmp";
+    FILE *fd = fopen(tmp_path.c_str(), "wb");
+    if (fd == nullptr) {
+        derror("open file failed: %s", tmp_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    bool ok = true;
+    uint64_t size = 0;
+    auto write_record = [&ok, &size, fd](const blob &record) {
+        if (ok && fwrite(record.data(), record.length(), 1, fd) != 1) {
+            ok = false;
+        }
+        size += record.length();
+    };
+    {
+        zauto_lock _(_state_lock);
+        if (_root.data.length() > 0) {
+            write_record(set_data_log::get_log(std::string("/"), _root.data));
+        }
+        // a parent is always written before its children, so that the records can be replayed
+        std::stack<std::pair<std::string, const state_node *>> nodes;
+        for (const auto &kv : _root.children) {
+            nodes.emplace("/" + kv.first, kv.second);
+        }
+        while (!nodes.empty()) {
+            auto node = std::move(nodes.top());
+            nodes.pop();
+            write_record(create_node_log::get_log(node.first, node.second->data));
+            for (const auto &kv : node.second->children) {
+                nodes.emplace(node.first + "/" + kv.first, kv.second);
+            }
+        }
+    }
+    ok = ok && fflush(fd) == 0 && fsync(fileno(fd)) == 0;
+    ok = (fclose(fd) == 0) && ok;
+    if (!ok) {
+        derror("write file failed: %s", tmp_path.c_str());
+        utils::filesystem::remove_path(tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    // the log is either the old one or the compacted one if crashed around the renaming
+    if (!utils::filesystem::rename_path(tmp_path, _log_path)) {
+        derror("rename file failed: %s => %s", tmp_path.c_str(), _log_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    if (_log != nullptr) {
+        file::close(_log);
+    }
+    _log = file::open(_log_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+    dassert(_log != nullptr, "open file failed: %s", _log_path.c_str());
+
+    ddebug("compact log %s succeed, size = (%" PRIu64 " => %" PRIu64 "), time_used = %" PRIu64
+           "ms",
+           _log_path.c_str(),
+           _offset,
+           size,
+           dsn_now_ms() - start_time);
+    _offset = size;
+    _compacted_offset = size;
+    return ERR_OK;
+}
+
 error_code meta_state_service_simple::initialize(const std::vector<std::string> &args)
 {
     const char *work_dir =
         args.empty() ? service_app::current_service_app_info().data_dir.c_str() : args[0].c_str();
 
     _offset = 0;
-    std::string log_path = dsn::utils::filesystem::path_combine(work_dir, "meta_state_service.log");
+    _compacted_offset = 0;
+    _log_path = dsn::utils::filesystem::path_combine(work_dir, "meta_state_service.log");
+    const std::string &log_path = _log_path;
     if (utils::filesystem::file_exists(log_path)) {
         if (FILE *fd = fopen(log_path.c_str(), "rb")) {
             for (;;) {
@@ -293,6 +386,15 @@ error_code meta_state_service_simple::initialize(const std::vector<std::string>
         derror("open file failed: %s", log_path.c_str());
         return ERR_FILE_OPERATION_FAILED;
     }
+
+    // compact the log replayed, which also drops the incomplete records at the tail
+    if (need_compact_log()) {
+        zauto_lock l(_log_lock);
+        error_code ec = compact_log();
+        if (ec != ERR_OK) {
+            dwarn("compact log %s failed, err = %s", log_path.c_str(), ec.to_string());
+        }
+    }
     return ERR_OK;
 }
 
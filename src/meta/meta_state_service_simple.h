@@ -52,7 +52,8 @@ public:
           _quick_map({std::make_pair("/", &_root)}),
           _log_lock(true),
           _log(nullptr),
-          _offset(0)
+          _offset(0),
+          _compacted_offset(0)
     {
     }
 
@@ -251,6 +252,11 @@ private:
     error_code
     apply_transaction(const std::shared_ptr<meta_state_service::transaction_entries> &t_entries);
 
+    bool need_compact_log() const;
+    // rewrite the log as the records creating the current tree, and switch to it atomically.
+    // the caller should hold _log_lock, with no log being written
+    error_code compact_log();
+
     typedef std::unordered_map<std::string, state_node *> quick_map;
 
     zlock _queue_lock;
@@ -261,8 +267,11 @@ private:
     quick_map _quick_map; // <path, node*>
 
     zlock _log_lock;
+    std::string _log_path;
     disk_file *_log;
     uint64_t _offset;
+    // the log size right after the last compaction
+    uint64_t _compacted_offset;
 
     dsn::task_tracker _tracker;
 };
@@ -0,0 +1,237 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <fmt/format.h>
+
+#include "meta_state_service_versioned.h"
+
+namespace dsn {
+namespace dist {
+
+class meta_state_service_versioned::versioned_transaction_entries : public transaction_entries
+{
+public:
+    versioned_transaction_entries(const meta_state_service_versioned *svc,
+                                  std::shared_ptr<transaction_entries> inner)
+        : _svc(svc), _inner(std::move(inner)), _watched(false)
+    {
+    }
+
+    error_code create_node(const std::string &node, const blob &value) override
+    {
+        _watched = _watched || _svc->is_watched(node);
+        return _inner->create_node(node, value);
+    }
+
+    error_code delete_node(const std::string &node) override
+    {
+        _watched = _watched || _svc->is_watched(node);
+        return _inner->delete_node(node);
+    }
+
+    error_code set_data(const std::string &node, const blob &value) override
+    {
+        _watched = _watched || _svc->is_watched(node);
+        return _inner->set_data(node, value);
+    }
+
+    error_code get_result(unsigned int entry_index) override
+    {
+        return _inner->get_result(entry_index);
+    }
+
+private:
+    friend class meta_state_service_versioned;
+
+    const meta_state_service_versioned *_svc;
+    std::shared_ptr<transaction_entries> _inner;
+    bool _watched;
+};
+
+meta_state_service_versioned::meta_state_service_versioned(
+    std::shared_ptr<meta_state_service> inner, std::string watched_root, std::string version_node)
+    : _inner(std::move(inner)),
+      _watched_root(std::move(watched_root)),
+      _version_node(std::move(version_node)),
+      _version_prefix(fmt::format("{}@{}", dsn_primary_address().to_std_string(), dsn_now_us())),
+      _version_counter(0)
+{
+}
+
+bool meta_state_service_versioned::is_watched(const std::string &node) const
+{
+    return node == _watched_root ||
+           (node.size() > _watched_root.size() &&
+            node.compare(0, _watched_root.size(), _watched_root) == 0 &&
+            node[_watched_root.size()] == '/');
+}
+
+blob meta_state_service_versioned::next_version()
+{
+    return blob::create_from_bytes(fmt::format("{}:{}", _version_prefix, ++_version_counter));
+}
+
+error_code meta_state_service_versioned::renew_version()
+{
+    error_code err;
+    _inner
+        ->create_node(_version_node,
+                      LPC_META_CALLBACK,
+                      [&err](error_code ec) { err = ec; },
+                      next_version())
+        ->wait();
+    if (err == ERR_NODE_ALREADY_EXIST) {
+        _inner
+            ->set_data(_version_node,
+                       next_version(),
+                       LPC_META_CALLBACK,
+                       [&err](error_code ec) { err = ec; })
+            ->wait();
+    }
+    return err;
+}
+
+error_code meta_state_service_versioned::initialize(const std::vector<std::string> &args)
+{
+    return _inner->initialize(args);
+}
+
+error_code meta_state_service_versioned::finalize() { return _inner->finalize(); }
+
+std::shared_ptr<meta_state_service::transaction_entries>
+meta_state_service_versioned::new_transaction_entries(unsigned int capacity)
+{
+    // one more entry for the version
+    return std::make_shared<versioned_transaction_entries>(
+        this, _inner->new_transaction_entries(capacity + 1));
+}
+
+task_ptr meta_state_service_versioned::submit_transaction(
+    const std::shared_ptr<transaction_entries> &entries,
+    task_code cb_code,
+    const err_callback &cb_transaction,
+    dsn::task_tracker *tracker)
+{
+    auto versioned = dynamic_cast<versioned_transaction_entries *>(entries.get());
+    dassert(versioned != nullptr, "the transaction entries must be created by this service");
+    if (versioned->_watched) {
+        error_code err = versioned->_inner->set_data(_version_node, next_version());
+        dassert_f(err == ERR_OK,
+                  "add the version to the transaction failed, err = {}",
+                  err.to_string());
+    }
+    return _inner->submit_transaction(versioned->_inner, cb_code, cb_transaction, tracker);
+}
+
+task_ptr meta_state_service_versioned::create_node(const std::string &node,
+                                                   task_code cb_code,
+                                                   const err_callback &cb_create,
+                                                   const blob &value,
+                                                   dsn::task_tracker *tracker)
+{
+    if (!is_watched(node)) {
+        return _inner->create_node(node, cb_code, cb_create, value, tracker);
+    }
+    auto entries = new_transaction_entries(1);
+    entries->create_node(node, value);
+    return submit_transaction(entries, cb_code, cb_create, tracker);
+}
+
+task_ptr meta_state_service_versioned::delete_node(const std::string &node,
+                                                   bool recursively_delete,
+                                                   task_code cb_code,
+                                                   const err_callback &cb_delete,
+                                                   dsn::task_tracker *tracker)
+{
+    if (!is_watched(node)) {
+        return _inner->delete_node(node, recursively_delete, cb_code, cb_delete, tracker);
+    }
+    if (!recursively_delete) {
+        auto entries = new_transaction_entries(1);
+        entries->delete_node(node);
+        return submit_transaction(entries, cb_code, cb_delete, tracker);
+    }
+
+    // the children are deleted one by one, so clear the version until all of them are gone
+    return _inner->set_data(
+        _version_node,
+        blob(),
+        cb_code,
+        [this, node, cb_code, cb_delete, tracker](error_code ec) {
+            if (ec != ERR_OK) {
+                cb_delete(ec);
+                return;
+            }
+            _inner->delete_node(node,
+                                true,
+                                cb_code,
+                                [this, cb_code, cb_delete, tracker](error_code ec) {
+                                    // some children may be deleted even if the delete failed
+                                    _inner->set_data(
+                                        _version_node,
+                                        next_version(),
+                                        cb_code,
+                                        [cb_delete, ec](error_code) { cb_delete(ec); },
+                                        tracker);
+                                },
+                                tracker);
+        },
+        tracker);
+}
+
+task_ptr meta_state_service_versioned::node_exist(const std::string &node,
+                                                  task_code cb_code,
+                                                  const err_callback &cb_exist,
+                                                  dsn::task_tracker *tracker)
+{
+    return _inner->node_exist(node, cb_code, cb_exist, tracker);
+}
+
+task_ptr meta_state_service_versioned::get_data(const std::string &node,
+                                                task_code cb_code,
+                                                const err_value_callback &cb_get_data,
+                                                dsn::task_tracker *tracker)
+{
+    return _inner->get_data(node, cb_code, cb_get_data, tracker);
+}
+
+task_ptr meta_state_service_versioned::set_data(const std::string &node,
+                                                const blob &value,
+                                                task_code cb_code,
+                                                const err_callback &cb_set_data,
+                                                dsn::task_tracker *tracker)
+{
+    if (!is_watched(node)) {
+        return _inner->set_data(node, value, cb_code, cb_set_data, tracker);
+    }
+    auto entries = new_transaction_entries(1);
+    entries->set_data(node, value);
+    return submit_transaction(entries, cb_code, cb_set_data, tracker);
+}
+
+task_ptr meta_state_service_versioned::get_children(const std::string &node,
+                                                    task_code cb_code,
+                                                    const err_stringv_callback &cb_get_children,
+                                                    dsn::task_tracker *tracker)
+{
+    return _inner->get_children(node, cb_code, cb_get_children, tracker);
+}
+
+} // namespace dist
+} // namespace dsn
@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <dsn/dist/meta_state_service.h>
+
+namespace dsn {
+namespace dist {
+
+// Decorates the remote storage of the meta server, so that every write under `watched_root`
+// also changes the data of `version_node`. The version is changed in the same transaction as the
+// write, except for the recursive deletes which can't be put into a transaction: the version is
+// cleared before such a delete and set again after it.
+//
+// A meta server waiting for the leader lock can keep a copy of the watched tree, and at takeover
+// it only needs to read the version node to tell whether the copy is still up to date. The copy
+// is never trusted if the version is missing or cleared.
+class meta_state_service_versioned : public meta_state_service
+{
+public:
+    meta_state_service_versioned(std::shared_ptr<meta_state_service> inner,
+                                 std::string watched_root,
+                                 std::string version_node);
+
+    // Sets the version node to a new version, creating it if necessary. A new leader calls it
+    // before any write, so that even the writes of an old leader which are still in flight are
+    // not mistaken for part of the copy loaded at the previous version.
+    error_code renew_version();
+
+    const std::string &version_node() const { return _version_node; }
+
+    error_code initialize(const std::vector<std::string> &args) override;
+    error_code finalize() override;
+
+    std::shared_ptr<transaction_entries> new_transaction_entries(unsigned int capacity) override;
+    task_ptr submit_transaction(const std::shared_ptr<transaction_entries> &entries,
+                                task_code cb_code,
+                                const err_callback &cb_transaction,
+                                dsn::task_tracker *tracker = nullptr) override;
+
+    task_ptr create_node(const std::string &node,
+                         task_code cb_code,
+                         const err_callback &cb_create,
+                         const blob &value = blob(),
+                         dsn::task_tracker *tracker = nullptr) override;
+    task_ptr delete_node(const std::string &node,
+                         bool recursively_delete,
+                         task_code cb_code,
+                         const err_callback &cb_delete,
+                         dsn::task_tracker *tracker = nullptr) override;
+    task_ptr node_exist(const std::string &node,
+                        task_code cb_code,
+                        const err_callback &cb_exist,
+                        dsn::task_tracker *tracker = nullptr) override;
+    task_ptr get_data(const std::string &node,
+                      task_code cb_code,
+                      const err_value_callback &cb_get_data,
+                      dsn::task_tracker *tracker = nullptr) override;
+    task_ptr set_data(const std::string &node,
+                      const blob &value,
+                      task_code cb_code,
+                      const err_callback &cb_set_data,
+                      dsn::task_tracker *tracker = nullptr) override;
+    task_ptr get_children(const std::string &node,
+                          task_code cb_code,
+                          const err_stringv_callback &cb_get_children,
+                          dsn::task_tracker *tracker = nullptr) override;
+
+private:
+    class versioned_transaction_entries;
+
+    bool is_watched(const std::string &node) const;
+    blob next_version();
+
+    std::shared_ptr<meta_state_service> _inner;
+    std::string _watched_root;
+    std::string _version_node;
+    // the versions are unique among the meta servers and their restarts
+    std::string _version_prefix;
+    std::atomic<uint64_t> _version_counter;
+};
+
+} // namespace dist
+} // namespace dsn
@@ -35,11 +35,15 @@
  */
 
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replica_envs.h>
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/synchronize.h>
+#include <algorithm>
 #include <sstream>
 #include <cinttypes>
 #include <string>
@@ -56,6 +60,64 @@ using namespace dsn;
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  partition_config_update_batch_window_ms,
+                  0,
+                  "how long the partition config updates are coalesced before written to the "
+                  "remote storage in a transaction, the updates issued together are always "
+                  "coalesced even if it is 0");
+DSN_TAG_VARIABLE(partition_config_update_batch_window_ms, FT_MUTABLE);
+
+DSN_DEFINE_uint32("meta_server",
+                  partition_config_update_batch_max_count,
+                  64,
+                  "the max count of partition config updates written in one transaction, the "
+                  "updates are written one by one if it is not greater than 1");
+DSN_TAG_VARIABLE(partition_config_update_batch_max_count, FT_MUTABLE);
+
+DSN_DEFINE_bool("meta_server",
+                bulk_downgrade_on_node_dead_enabled,
+                false,
+                "whether to downgrade all the primaries on a dead node in one pass, whose config "
+                "updates are written in transactions of partition_config_update_batch_max_count "
+                "at once and handled together with the cure proposals when written");
+DSN_TAG_VARIABLE(bulk_downgrade_on_node_dead_enabled, FT_MUTABLE);
+
+DSN_DEFINE_uint32("meta_server",
+                  query_configuration_response_cache_capacity,
+                  64,
+                  "the max count of serialized query_configuration_by_index responses cached "
+                  "for each app, 0 means the responses are not cached");
+DSN_TAG_VARIABLE(query_configuration_response_cache_capacity, FT_MUTABLE);
+
+DSN_DEFINE_uint32("meta_server",
+                  config_watch_max_expire_ms,
+                  30000,
+                  "the max time a watch of app configuration is held before it's replied");
+DSN_TAG_VARIABLE(config_watch_max_expire_ms, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  config_watch_max_count,
+                  100000,
+                  "the max count of the watches of app configuration held by the meta server, "
+                  "the watches beyond it are rejected with ERR_BUSY");
+DSN_TAG_VARIABLE(config_watch_max_count, FT_MUTABLE);
+
+DSN_DEFINE_uint32("meta_server",
+                  create_partition_nodes_batch_size,
+                  64,
+                  "the max count of partition nodes created in one transaction when an app is "
+                  "created, the nodes are created one by one if it is not greater than 1");
+DSN_TAG_VARIABLE(create_partition_nodes_batch_size, FT_MUTABLE);
+
+DSN_DEFINE_uint32("meta_server",
+                  recovery_query_max_concurrency,
+                  64,
+                  "the max count of replica nodes queried concurrently for their apps and "
+                  "replicas when the meta server recovers from them");
+DSN_DEFINE_validator(recovery_query_max_concurrency,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_TAG_VARIABLE(recovery_query_max_concurrency, FT_MUTABLE);
+
 static const char *lock_state = "lock";
 static const char *unlock_state = "unlock";
 
@@ -65,7 +127,8 @@ server_state::server_state()
       _add_secondary_max_count_for_one_node(0),
       _cli_dump_handle(nullptr),
       _ctrl_add_secondary_enable_flow_control(nullptr),
-      _ctrl_add_secondary_max_count_for_one_node(nullptr)
+      _ctrl_add_secondary_max_count_for_one_node(nullptr),
+      _ctrl_drain_node(nullptr)
 {
 }
 
@@ -75,6 +138,7 @@ server_state::~server_state()
     UNREGISTER_VALID_HANDLER(_cli_dump_handle);
     UNREGISTER_VALID_HANDLER(_ctrl_add_secondary_enable_flow_control);
     UNREGISTER_VALID_HANDLER(_ctrl_add_secondary_max_count_for_one_node);
+    UNREGISTER_VALID_HANDLER(_ctrl_drain_node);
 }
 
 void server_state::register_cli_commands()
@@ -138,6 +202,13 @@ void server_state::register_cli_commands()
             return result;
         });
     dassert(_ctrl_add_secondary_max_count_for_one_node, "register cli handler failed");
+
+    _ctrl_drain_node = dsn::command_manager::instance().register_command(
+        {"meta.drain_node"},
+        "meta.drain_node <start ip:port [max_per_destination] | cancel ip:port | status>",
+        "move all primaries off the node in parallel, to its fully caught-up secondaries",
+        [this](const std::vector<std::string> &args) { return remote_command_drain_node(args); });
+    dassert(_ctrl_drain_node, "register cli handler failed");
 }
 
 void server_state::initialize(meta_service *meta_svc, const std::string &apps_root)
@@ -253,6 +324,7 @@ void server_state::transition_staging_state(std::shared_ptr<app_state> &app)
                 enum_to_string(app->status));
     }
 
+    refresh_query_view(app);
     ddebug("app(%s) transfer from %s to %s",
            app->get_logname(),
            enum_to_string(old_status),
@@ -543,22 +615,34 @@ error_code server_state::sync_apps_to_remote_storage()
     }
 }
 
-dsn::error_code server_state::sync_apps_from_remote_storage()
+dsn::error_code server_state::sync_apps_from_remote_storage(const apps_snapshot *snapshot)
 {
     dsn::error_code err;
     dsn::task_tracker tracker;
 
     dist::meta_state_service *storage = _meta_svc->get_remote_storage();
-    auto sync_partition = [this, storage, &err, &tracker](
+    auto get_data = [storage, snapshot, &tracker](const std::string &path,
+                                                  const dist::err_value_callback &cb) {
+        if (snapshot == nullptr) {
+            storage->get_data(path, LPC_META_CALLBACK, cb, &tracker);
+            return;
+        }
+        auto iter = snapshot->nodes.find(path);
+        if (iter == snapshot->nodes.end()) {
+            cb(ERR_OBJECT_NOT_FOUND, blob());
+        } else {
+            cb(ERR_OK, iter->second);
+        }
+    };
+    auto sync_partition = [this, &get_data, &err](
         std::shared_ptr<app_state> &app, int partition_id, const std::string &partition_path) {
-        storage->get_data(
+        get_data(
             partition_path,
-            LPC_META_CALLBACK,
             [this, app, partition_id, partition_path, &err](error_code ec,
                                                             const blob &value) mutable {
                 if (ec == ERR_OK) {
                     partition_configuration pc;
-                    dsn::json::json_forwarder<partition_configuration>::decode(value, pc);
+                    decode_partition_configuration(value, pc);
 
                     dassert(pc.pid.get_app_id() == app->app_id &&
                                 pc.pid.get_partition_index() == partition_id,
@@ -612,14 +696,12 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
                     derror("get partition node failed, reason(%s)", ec.to_string());
                     err = ec;
                 }
-            },
-            &tracker);
+            });
     };
 
     auto sync_app = [&](const std::string &app_path) {
-        storage->get_data(
+        get_data(
             app_path,
-            LPC_META_CALLBACK,
             [this, app_path, &err, &sync_partition](error_code ec, const blob &value) {
                 if (ec == ERR_OK) {
                     app_info info;
@@ -653,24 +735,24 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
                            ec.to_string());
                     err = ec;
                 }
-            },
-            &tracker);
+            });
     };
 
     _all_apps.clear();
     _exist_apps.clear();
 
     std::string transaction_state;
-    storage
-        ->get_data(_apps_root,
-                   LPC_META_CALLBACK,
-                   [&err, &transaction_state](error_code ec, const blob &value) {
-                       err = ec;
-                       if (ec == dsn::ERR_OK) {
-                           transaction_state.assign(value.data(), value.length());
-                       }
-                   })
-        ->wait();
+    auto get_transaction_state = [&err, &transaction_state](error_code ec, const blob &value) {
+        err = ec;
+        if (ec == dsn::ERR_OK) {
+            transaction_state.assign(value.data(), value.length());
+        }
+    };
+    if (snapshot == nullptr) {
+        storage->get_data(_apps_root, LPC_META_CALLBACK, get_transaction_state)->wait();
+    } else {
+        get_data(_apps_root, get_transaction_state);
+    }
 
     if (ERR_OBJECT_NOT_FOUND == err)
         return err;
@@ -679,22 +761,23 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
             "invalid transaction state(%s)",
             transaction_state.c_str());
 
-    storage->get_children(
-        _apps_root,
-        LPC_META_CALLBACK,
-        [&](error_code ec, const std::vector<std::string> &apps) {
-            if (ec == ERR_OK) {
-                for (const auto &appid_str : apps) {
-                    sync_app(_apps_root + "/" + appid_str);
-                }
-            } else {
-                derror("get app list from meta state service failed, path = %s, err = %s",
-                       _apps_root.c_str(),
-                       ec.to_string());
-                err = ec;
+    auto sync_apps = [&](error_code ec, const std::vector<std::string> &apps) {
+        if (ec == ERR_OK) {
+            for (const auto &appid_str : apps) {
+                sync_app(_apps_root + "/" + appid_str);
             }
-        },
-        &tracker);
+        } else {
+            derror("get app list from meta state service failed, path = %s, err = %s",
+                   _apps_root.c_str(),
+                   ec.to_string());
+            err = ec;
+        }
+    };
+    if (snapshot == nullptr) {
+        storage->get_children(_apps_root, LPC_META_CALLBACK, sync_apps, &tracker);
+    } else {
+        sync_apps(ERR_OK, snapshot->apps);
+    }
     tracker.wait_outstanding_tasks();
     if (err == ERR_OK) {
         return _all_apps.empty() ? ERR_OBJECT_NOT_FOUND : ERR_OK;
@@ -702,6 +785,79 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
     return err;
 }
 
+/*static*/ error_code server_state::load_apps_snapshot(dist::meta_state_service *storage,
+                                                       const std::string &apps_root,
+                                                       /*out*/ apps_snapshot &snapshot)
+{
+    error_code err = ERR_OK;
+    dsn::task_tracker tracker;
+    zlock lock;
+    snapshot.apps.clear();
+    snapshot.nodes.clear();
+
+    // returns true if the node is found, the missing nodes are left to
+    // sync_apps_from_remote_storage() to handle
+    auto record = [&](const std::string &path, error_code ec, const blob &value) {
+        zauto_lock l(lock);
+        if (ec == ERR_OK) {
+            snapshot.nodes.emplace(path, value);
+            return true;
+        }
+        if (ec != ERR_OBJECT_NOT_FOUND && err == ERR_OK) {
+            err = ec;
+        }
+        return false;
+    };
+
+    auto load_app = [&](const std::string &app_path) {
+        storage->get_data(
+            app_path,
+            LPC_META_CALLBACK,
+            [&, app_path](error_code ec, const blob &value) {
+                app_info info;
+                if (!record(app_path, ec, value)) {
+                    return;
+                }
+                if (!dsn::json::json_forwarder<app_info>::decode(value, info)) {
+                    zauto_lock l(lock);
+                    err = ERR_INVALID_DATA;
+                    return;
+                }
+                for (int i = 0; i < info.partition_count; ++i) {
+                    std::string partition_path = app_path + "/" + std::to_string(i);
+                    storage->get_data(partition_path,
+                                      LPC_META_CALLBACK,
+                                      [&, partition_path](error_code ec, const blob &value) {
+                                          record(partition_path, ec, value);
+                                      },
+                                      &tracker);
+                }
+            },
+            &tracker);
+    };
+
+    storage
+        ->get_data(apps_root,
+                   LPC_META_CALLBACK,
+                   [&](error_code ec, const blob &value) { record(apps_root, ec, value); })
+        ->wait();
+    storage->get_children(apps_root,
+                          LPC_META_CALLBACK,
+                          [&](error_code ec, const std::vector<std::string> &apps) {
+                              if (ec != ERR_OK) {
+                                  record(apps_root, ec, blob());
+                                  return;
+                              }
+                              snapshot.apps = apps;
+                              for (const std::string &app : apps) {
+                                  load_app(apps_root + "/" + app);
+                              }
+                          },
+                          &tracker);
+    tracker.wait_outstanding_tasks();
+    return err;
+}
+
 void server_state::initialize_node_state()
 {
     zauto_write_lock l(_lock);
@@ -728,11 +884,19 @@ void server_state::initialize_node_state()
             check_consistency(pc.pid);
         }
     }
+
+    {
+        zauto_write_lock views_l(_query_views_lock);
+        _query_views.clear();
+    }
+    for (const auto &app_pair : _exist_apps) {
+        refresh_query_view(app_pair.second);
+    }
 }
 
-error_code server_state::initialize_data_structure()
+error_code server_state::initialize_data_structure(const apps_snapshot *snapshot)
 {
-    error_code err = sync_apps_from_remote_storage();
+    error_code err = sync_apps_from_remote_storage(snapshot);
     if (err == ERR_OBJECT_NOT_FOUND) {
         if (_meta_svc->get_meta_options().recover_from_replica_server) {
             return ERR_OBJECT_NOT_FOUND;
@@ -788,8 +952,29 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
             response.err = ERR_OBJECT_NOT_FOUND;
         } else {
             response.err = ERR_OK;
-            unsigned int i = 0;
-            response.partitions.resize(ns->partition_count());
+
+            // for a delta sync, the partitions are skipped if the replicas on the node are of the
+            // same ballot and status as meta server, and the app infos are unchanged since the
+            // last sync
+            bool delta = request.__isset.app_info_digests && request.__isset.stored_replicas;
+            std::unordered_map<gpid, const replica_info *> stored;
+            std::unordered_map<int32_t, bool> app_info_unchanged;
+            if (delta) {
+                for (const replica_info &rep : request.stored_replicas) {
+                    stored.emplace(rep.pid, &rep);
+                }
+                response.__isset.unchanged_partitions = true;
+            }
+
+            // the primaries on the node by app id, to assign the table quotas to
+            std::map<int32_t, std::vector<gpid>> primaries;
+            bool quota_enabled = request.__isset.quota_usages;
+            if (quota_enabled) {
+                _quota_allocator.update_usages(request.quota_usages);
+            }
+
+            unsigned synced_count = 0;
+            response.partitions.reserve(ns->partition_count());
             ns->for_each_partition([&, this](const gpid &pid) {
                 std::shared_ptr<app_state> app = get_app(pid.get_app_id());
                 dassert(app != nullptr, "invalid app_id, app_id = %d", pid.get_app_id());
@@ -806,24 +991,59 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
                     if (req == nullptr || req->node == request.node)
                         return false;
                 }
+                ++synced_count;
 
-                response.partitions[i].info = *app;
-                response.partitions[i].config = app->partitions[pid.get_partition_index()];
-                response.partitions[i].host_node = request.node;
-                // set meta_split_status
+                const partition_configuration &pc = app->partitions[pid.get_partition_index()];
+                if (quota_enabled && pc.primary == request.node) {
+                    primaries[app->app_id].push_back(pid);
+                }
                 const split_state &app_split_states = app->helpers->split_states;
+                auto split_iter = app_split_states.status.end();
                 if (app->splitting()) {
-                    auto iter = app_split_states.status.find(pid.get_partition_index());
-                    if (iter != app_split_states.status.end()) {
-                        response.partitions[i].__set_meta_split_status(iter->second);
+                    split_iter = app_split_states.status.find(pid.get_partition_index());
+                }
+
+                if (delta && split_iter == app_split_states.status.end()) {
+                    auto unchanged = app_info_unchanged.find(app->app_id);
+                    if (unchanged == app_info_unchanged.end()) {
+                        auto digest = request.app_info_digests.find(app->app_id);
+                        bool same = digest != request.app_info_digests.end() &&
+                                    digest->second == app_info_digest(*app);
+                        unchanged = app_info_unchanged.emplace(app->app_id, same).first;
+                    }
+
+                    auto rep = stored.find(pid);
+                    if (unchanged->second && rep != stored.end() &&
+                        rep->second->ballot == pc.ballot &&
+                        rep->second->status == (pc.primary == request.node
+                                                    ? partition_status::PS_PRIMARY
+                                                    : partition_status::PS_SECONDARY)) {
+                        response.unchanged_partitions.push_back(pid);
+                        return true;
                     }
                 }
-                ++i;
+
+                response.partitions.emplace_back();
+                configuration_update_request &update = response.partitions.back();
+                update.info = *app;
+                update.config = pc;
+                update.host_node = request.node;
+                // set meta_split_status
+                if (split_iter != app_split_states.status.end()) {
+                    update.__set_meta_split_status(split_iter->second);
+                }
                 return true;
             });
-            if (i < response.partitions.size()) {
+            if (synced_count < ns->partition_count()) {
                 reject_this_request = true;
             }
+
+            if (quota_enabled) {
+                response.__isset.quota_shares = true;
+                for (const auto &kv : primaries) {
+                    _quota_allocator.assign(*get_app(kv.first), kv.second, response.quota_shares);
+                }
+            }
         }
 
         // handle the stored replicas & the gc replicas
@@ -920,12 +1140,14 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
     if (reject_this_request) {
         response.err = ERR_BUSY;
         response.partitions.clear();
+        response.unchanged_partitions.clear();
     }
     ddebug_f("send config sync response to {}, err({}), partitions_count({}), "
-             "gc_replicas_count({})",
+             "unchanged_partitions_count({}), gc_replicas_count({})",
              request.node.to_string(),
              response.err,
              response.partitions.size(),
+             response.unchanged_partitions.size(),
              response.gc_replicas.size());
 }
 
@@ -941,10 +1163,243 @@ bool server_state::query_configuration_by_gpid(dsn::gpid id,
     return false;
 }
 
+std::shared_ptr<server_state::app_query_view>
+server_state::get_query_view(const std::string &app_name) const
+{
+    zauto_read_lock l(_query_views_lock);
+    auto iter = _query_views.find(app_name);
+    return iter == _query_views.end() ? nullptr : iter->second;
+}
+
+void server_state::refresh_query_view(const std::shared_ptr<app_state> &app)
+{
+    std::shared_ptr<app_query_view> view;
+    if (app->status == app_status::AS_AVAILABLE) {
+        view = std::make_shared<app_query_view>();
+        view->app_id = app->app_id;
+        view->partition_count = app->partition_count;
+        view->is_stateful = app->is_stateful;
+        view->partitions.reserve(app->partitions.size());
+        for (const partition_configuration &pc : app->partitions) {
+            view->partitions.emplace_back(std::make_shared<const partition_configuration>(pc));
+        }
+    }
+
+    {
+        zauto_write_lock l(_query_views_lock);
+        if (view != nullptr) {
+            _query_views[app->app_name] = std::move(view);
+        } else {
+            auto iter = _query_views.find(app->app_name);
+            if (iter != _query_views.end() && iter->second->app_id == app->app_id) {
+                _query_views.erase(iter);
+            }
+        }
+    }
+    notify_config_watches(app->app_name);
+}
+
+/*static*/ void
+server_state::fill_query_response(const app_query_view &view,
+                                  const configuration_query_by_index_request &request,
+                                  /*out*/ configuration_query_by_index_response &response)
+{
+    response.err = ERR_OK;
+    response.app_id = view.app_id;
+    response.partition_count = view.partition_count;
+    response.is_stateful = view.is_stateful;
+
+    for (const int32_t &index : request.partition_indices) {
+        if (index >= 0 && index < view.partitions.size())
+            response.partitions.push_back(*std::atomic_load(&view.partitions[index]));
+    }
+    if (response.partitions.empty()) {
+        response.partitions.reserve(view.partitions.size());
+        for (const auto &slot : view.partitions) {
+            response.partitions.push_back(*std::atomic_load(&slot));
+        }
+    }
+}
+
+bool server_state::query_configuration_by_index_serialized(
+    const configuration_query_by_index_request &request,
+    dsn_msg_serialize_format fmt,
+    /*out*/ blob &data)
+{
+    std::shared_ptr<app_query_view> view = get_query_view(request.app_name);
+    if (view == nullptr) {
+        return false;
+    }
+
+    // read the version before the slots, so a response racing with a swap is never taken
+    // for the newer version
+    uint64_t version = view->version.load();
+    std::string key = std::to_string(fmt);
+    for (const int32_t &index : request.partition_indices) {
+        key.append(",").append(std::to_string(index));
+    }
+    uint32_t capacity = FLAGS_query_configuration_response_cache_capacity;
+    if (capacity > 0) {
+        zauto_lock l(view->responses_lock);
+        auto iter = view->responses.find(key);
+        if (iter != view->responses.end() && iter->second.version == version) {
+            data = iter->second.data;
+            return true;
+        }
+    }
+
+    configuration_query_by_index_response response;
+    fill_query_response(*view, request, response);
+    binary_writer writer;
+    marshall(writer, response, fmt);
+    data = writer.get_buffer();
+
+    if (capacity > 0) {
+        zauto_lock l(view->responses_lock);
+        if (view->responses.size() >= capacity && view->responses.count(key) == 0) {
+            view->responses.clear();
+        }
+        view->responses[key] = {version, data};
+    }
+    return true;
+}
+
+bool server_state::fill_watch_response(const configuration_watch_app_request &request,
+                                       /*out*/ configuration_query_by_index_response &response)
+{
+    configuration_query_by_index_request query;
+    query.app_name = request.app_name;
+
+    std::shared_ptr<app_query_view> view = get_query_view(request.app_name);
+    if (view == nullptr) {
+        // not available, the reply tells the client why
+        query_configuration_by_index(query, response);
+        return true;
+    }
+    if (!view->is_stateful) {
+        // the ballots of stateless apps don't change with their configurations
+        response.err = ERR_OPERATION_DISABLED;
+        return true;
+    }
+    if (view->app_id != request.app_id || view->partitions.size() != request.known_ballots.size()) {
+        fill_query_response(*view, query, response);
+        return true;
+    }
+
+    response.err = ERR_OK;
+    response.app_id = view->app_id;
+    response.partition_count = view->partition_count;
+    response.is_stateful = view->is_stateful;
+    response.partitions.clear();
+    for (size_t i = 0; i < view->partitions.size(); ++i) {
+        std::shared_ptr<const partition_configuration> pc = std::atomic_load(&view->partitions[i]);
+        if (pc->ballot > request.known_ballots[i]) {
+            response.partitions.push_back(*pc);
+        }
+    }
+    return !response.partitions.empty();
+}
+
+bool server_state::take_config_watch(const std::string &app_name,
+                                     const std::shared_ptr<config_watch> &watch)
+{
+    zauto_lock l(_config_watches_lock);
+    auto iter = _config_watches.find(app_name);
+    if (iter == _config_watches.end()) {
+        return false;
+    }
+    auto &watches = iter->second;
+    auto it = std::find(watches.begin(), watches.end(), watch);
+    if (it == watches.end()) {
+        return false;
+    }
+    watches.erase(it);
+    if (watches.empty()) {
+        _config_watches.erase(iter);
+    }
+    --_config_watch_count;
+    return true;
+}
+
+void server_state::watch_app_configuration(configuration_watch_app_rpc rpc)
+{
+    const configuration_watch_app_request &request = rpc.request();
+    if (fill_watch_response(request, rpc.response())) {
+        return;
+    }
+
+    uint32_t expire_ms = FLAGS_config_watch_max_expire_ms;
+    if (request.expire_ms > 0 && request.expire_ms < expire_ms) {
+        expire_ms = request.expire_ms;
+    }
+    auto watch = std::make_shared<config_watch>();
+    watch->rpc = rpc;
+    {
+        zauto_lock l(_config_watches_lock);
+        if (_config_watch_count >= FLAGS_config_watch_max_count) {
+            rpc.response().err = ERR_BUSY;
+            return;
+        }
+        _config_watches[request.app_name].push_back(watch);
+        ++_config_watch_count;
+        // the watch is owned by _config_watches, which it's taken out of to be replied
+        std::weak_ptr<config_watch> weak_watch = watch;
+        watch->expire_task = tasking::enqueue(
+            LPC_META_STATE_NORMAL,
+            tracker(),
+            [this, weak_watch]() {
+                std::shared_ptr<config_watch> watch = weak_watch.lock();
+                if (watch != nullptr && take_config_watch(watch->rpc.request().app_name, watch)) {
+                    fill_watch_response(watch->rpc.request(), watch->rpc.response());
+                }
+            },
+            0,
+            std::chrono::milliseconds(expire_ms));
+    }
+
+    // the configurations may change before the watch is registered
+    configuration_query_by_index_response response;
+    if (fill_watch_response(request, response) && take_config_watch(request.app_name, watch)) {
+        watch->expire_task->cancel(false);
+        rpc.response() = std::move(response);
+    }
+}
+
+void server_state::notify_config_watches(const std::string &app_name)
+{
+    std::vector<std::shared_ptr<config_watch>> watches;
+    {
+        zauto_lock l(_config_watches_lock);
+        auto iter = _config_watches.find(app_name);
+        if (iter == _config_watches.end()) {
+            return;
+        }
+        watches.swap(iter->second);
+        _config_watches.erase(iter);
+        _config_watch_count -= watches.size();
+    }
+
+    // replied out of the caller, which holds _lock
+    for (const auto &watch : watches) {
+        watch->expire_task->cancel(false);
+    }
+    tasking::enqueue(LPC_META_STATE_NORMAL, tracker(), [this, watches]() {
+        for (const auto &watch : watches) {
+            fill_watch_response(watch->rpc.request(), watch->rpc.response());
+        }
+    });
+}
+
 void server_state::query_configuration_by_index(
     const configuration_query_by_index_request &request,
     /*out*/ configuration_query_by_index_response &response)
 {
+    std::shared_ptr<app_query_view> view = get_query_view(request.app_name);
+    if (view != nullptr) {
+        fill_query_response(*view, request, response);
+        return;
+    }
+
     zauto_read_lock l(_lock);
     auto iter = _exist_apps.find(request.app_name.c_str());
     if (iter == _exist_apps.end()) {
@@ -1019,19 +1474,88 @@ void server_state::init_app_partition_node(std::shared_ptr<app_state> &app,
     };
 
     std::string app_partition_path = get_partition_path(*app, pidx);
-    dsn::blob value =
-        dsn::json::json_forwarder<partition_configuration>::encode(app->partitions[pidx]);
+    dsn::blob value = encode_partition_configuration(app->partitions[pidx]);
     _meta_svc->get_remote_storage()->create_node(
         app_partition_path, LPC_META_STATE_HIGH, on_create_app_partition, value);
 }
 
+void server_state::init_app_partition_nodes(std::shared_ptr<app_state> &app,
+                                            int start_pidx,
+                                            int end_pidx)
+{
+    auto on_create_app_partitions = [this, app, start_pidx, end_pidx](error_code ec) mutable {
+        dinfo_f("create partition nodes [{}, {}) of app({}) in a transaction, result: {}",
+                start_pidx,
+                end_pidx,
+                app->get_logname(),
+                ec.to_string());
+        if (ERR_OK == ec) {
+            zauto_write_lock l(_lock);
+            for (int i = start_pidx; i != end_pidx; ++i) {
+                process_one_partition(app);
+            }
+        } else if (ERR_NODE_ALREADY_EXIST == ec) {
+            // some of the nodes were created before the meta server restarted, and the
+            // transaction is rejected as a whole, so the nodes are created one by one
+            dwarn_f("some partition nodes [{}, {}) of app({}) exist, create them one by one",
+                    start_pidx,
+                    end_pidx,
+                    app->get_logname());
+            for (int i = start_pidx; i != end_pidx; ++i) {
+                init_app_partition_node(app, i, nullptr);
+            }
+        } else if (ERR_TIMEOUT == ec) {
+            dwarn_f("create partition nodes [{}, {}) of app({}) failed, retry later",
+                    start_pidx,
+                    end_pidx,
+                    app->get_logname());
+            tasking::enqueue(LPC_META_STATE_HIGH,
+                             tracker(),
+                             std::bind(&server_state::init_app_partition_nodes,
+                                       this,
+                                       app,
+                                       start_pidx,
+                                       end_pidx),
+                             0,
+                             std::chrono::milliseconds(1000));
+        } else {
+            dassert_f(false,
+                      "we can't handle this error in init app partition nodes err({}), "
+                      "app({}), partitions [{}, {})",
+                      ec.to_string(),
+                      app->get_logname(),
+                      start_pidx,
+                      end_pidx);
+        }
+    };
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    auto entries =
+        storage->new_transaction_entries(static_cast<unsigned int>(end_pidx - start_pidx));
+    for (int i = start_pidx; i != end_pidx; ++i) {
+        std::string path = get_partition_path(*app, i);
+        error_code ec =
+            entries->create_node(path, encode_partition_configuration(app->partitions[i]));
+        dassert_f(ec == ERR_OK, "add {} to transaction failed, err = {}", path, ec.to_string());
+    }
+    storage->submit_transaction(entries, LPC_META_STATE_HIGH, on_create_app_partitions, tracker());
+}
+
 void server_state::do_app_create(std::shared_ptr<app_state> &app)
 {
     auto on_create_app_root = [this, app](error_code ec) mutable {
         if (ERR_OK == ec || ERR_NODE_ALREADY_EXIST == ec) {
             dinfo("create app(%s) on storage service ok", app->get_logname());
-            for (unsigned int i = 0; i != app->partition_count; ++i) {
-                init_app_partition_node(app, i, nullptr);
+            // the partition nodes are created in transactions of batch size, which saves lots
+            // of round trips to the remote storage for the apps of many partitions
+            int batch_size = static_cast<int>(FLAGS_create_partition_nodes_batch_size);
+            for (int i = 0; i < app->partition_count; i += std::max(batch_size, 1)) {
+                if (batch_size <= 1) {
+                    init_app_partition_node(app, i, nullptr);
+                } else {
+                    init_app_partition_nodes(
+                        app, i, std::min(i + batch_size, app->partition_count));
+                }
             }
         } else if (ERR_TIMEOUT == ec) {
             dwarn("the storage service is not available currently, continue to create later");
@@ -1181,6 +1705,7 @@ void server_state::drop_app(dsn::message_ex *msg)
                 }
                 do_dropping = true;
                 app->status = app_status::AS_DROPPING;
+                refresh_query_view(app);
                 app->drop_second = dsn_now_ms() / 1000;
                 if (request.options.__isset.reserve_seconds &&
                     request.options.reserve_seconds > 0) {
@@ -1317,6 +1842,18 @@ void server_state::send_proposal(rpc_address target, const configuration_update_
     _meta_svc->send_message(target, msg);
 }
 
+void server_state::send_read_replicas_proposal(const partition_configuration &pc,
+                                               const app_state &app,
+                                               int read_replica_count)
+{
+    configuration_update_request request;
+    request.info = app;
+    request.type = config_type::CT_UPDATE_READ_REPLICAS;
+    request.config = pc;
+    request.__set_read_replicas(place_read_replicas(pc, _nodes, read_replica_count));
+    send_proposal(pc.primary, request);
+}
+
 void server_state::send_proposal(const configuration_proposal_action &action,
                                  const partition_configuration &pc,
                                  const app_state &app)
@@ -1499,6 +2036,14 @@ void server_state::update_configuration_locally(
     // as we sync to remote storage according to it
     std::string old_config_str = boost::lexical_cast<std::string>(old_cfg);
     old_cfg = config_request->config;
+    std::shared_ptr<app_query_view> view = get_query_view(app.app_name);
+    if (view != nullptr && view->app_id == app.app_id &&
+        gpid.get_partition_index() < view->partitions.size()) {
+        std::atomic_store(&view->partitions[gpid.get_partition_index()],
+                          std::make_shared<const partition_configuration>(old_cfg));
+        view->version.fetch_add(1);
+        notify_config_watches(app.app_name);
+    }
     auto find_name = _config_type_VALUES_TO_NAMES.find(config_request->type);
     if (find_name != _config_type_VALUES_TO_NAMES.end()) {
         ddebug("meta update config ok: type(%s), old_config=%s, %s",
@@ -1552,22 +2097,119 @@ task_ptr server_state::update_configuration_on_remote(
     partition_configuration &pc = config_request->config;
     std::string storage_path = get_partition_path(pc.pid);
 
-    blob json_config = dsn::json::json_forwarder<partition_configuration>::encode(pc);
-    return _meta_svc->get_remote_storage()->set_data(
-        storage_path,
-        json_config,
-        LPC_META_STATE_HIGH,
-        std::bind(&server_state::on_update_configuration_on_remote_reply,
-                  this,
-                  std::placeholders::_1,
-                  config_request),
-        tracker());
+    blob json_config = encode_partition_configuration(pc);
+    auto callback = std::bind(&server_state::on_update_configuration_on_remote_reply,
+                              this,
+                              std::placeholders::_1,
+                              config_request);
+    if (FLAGS_partition_config_update_batch_max_count <= 1) {
+        return _meta_svc->get_remote_storage()->set_data(
+            storage_path, json_config, LPC_META_STATE_HIGH, callback, tracker());
+    }
+
+    // the update is written with the others issued around the same time in a transaction,
+    // which saves lots of round trips when many partitions are reconfigured at once, e.g.
+    // when a node holding many primaries fails
+    error_code_future_ptr tsk(new error_code_future(LPC_META_STATE_HIGH, callback, 0));
+    tsk->set_tracker(tracker());
+    bool schedule_flush = false;
+    {
+        zauto_lock l(_pending_configuration_updates_lock);
+        _pending_configuration_updates.push_back({std::move(storage_path), json_config, tsk});
+        if (!_configuration_updates_flush_scheduled) {
+            _configuration_updates_flush_scheduled = true;
+            schedule_flush = true;
+        }
+    }
+    if (schedule_flush) {
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         tracker(),
+                         [this]() { flush_configuration_updates_on_remote(); },
+                         0,
+                         std::chrono::milliseconds(FLAGS_partition_config_update_batch_window_ms));
+    }
+    return tsk;
+}
+
+void server_state::flush_configuration_updates_on_remote()
+{
+    std::vector<pending_configuration_update> updates;
+    {
+        zauto_lock l(_pending_configuration_updates_lock);
+        updates.swap(_pending_configuration_updates);
+        _configuration_updates_flush_scheduled = false;
+    }
+
+    // the cancelled updates needn't be written any more
+    updates.erase(std::remove_if(updates.begin(),
+                                 updates.end(),
+                                 [](const pending_configuration_update &u) {
+                                     return u.callback->state() == TASK_STATE_CANCELLED;
+                                 }),
+                  updates.end());
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    size_t batch_count = std::max(FLAGS_partition_config_update_batch_max_count, 1U);
+    for (size_t start = 0; start < updates.size(); start += batch_count) {
+        size_t end = std::min(start + batch_count, updates.size());
+        if (end - start == 1) {
+            const pending_configuration_update &u = updates[start];
+            error_code_future_ptr callback = u.callback;
+            storage->set_data(u.path,
+                              u.value,
+                              LPC_META_STATE_HIGH,
+                              [callback](error_code ec) { callback->enqueue_with(ec); },
+                              tracker());
+            continue;
+        }
+
+        auto entries = storage->new_transaction_entries(static_cast<unsigned int>(end - start));
+        std::vector<error_code_future_ptr> callbacks;
+        callbacks.reserve(end - start);
+        for (size_t i = start; i < end; ++i) {
+            error_code ec = entries->set_data(updates[i].path, updates[i].value);
+            dassert_f(ec == ERR_OK, "add {} to transaction failed, err = {}", updates[i].path, ec);
+            callbacks.emplace_back(updates[i].callback);
+        }
+        dinfo_f("write {} partition config updates in a transaction", callbacks.size());
+        storage->submit_transaction(entries,
+                                    LPC_META_STATE_HIGH,
+                                    [callbacks](error_code ec) {
+                                        for (const auto &callback : callbacks) {
+                                            callback->enqueue_with(ec);
+                                        }
+                                    },
+                                    tracker());
+    }
 }
 
 void server_state::on_update_configuration_on_remote_reply(
     error_code ec, std::shared_ptr<configuration_update_request> &config_request)
 {
     zauto_write_lock l(_lock);
+    handle_update_configuration_on_remote_reply(ec, config_request);
+}
+
+void server_state::on_update_configurations_on_remote_reply(
+    error_code ec, std::vector<std::shared_ptr<configuration_update_request>> &requests)
+{
+    zauto_write_lock l(_lock);
+    for (auto &request : requests) {
+        std::shared_ptr<app_state> app = get_app(request->config.pid.get_app_id());
+        if (app == nullptr) {
+            continue;
+        }
+        config_context &cc = app->helpers->contexts[request->config.pid.get_partition_index()];
+        if (cc.stage != config_status::pending_remote_sync || cc.pending_sync_request != request) {
+            continue;
+        }
+        handle_update_configuration_on_remote_reply(ec, request);
+    }
+}
+
+void server_state::handle_update_configuration_on_remote_reply(
+    error_code ec, std::shared_ptr<configuration_update_request> &config_request)
+{
     dsn::gpid &gpid = config_request->config.pid;
     std::shared_ptr<app_state> app = get_app(gpid.get_app_id());
     config_context &cc = app->helpers->contexts[gpid.get_partition_index()];
@@ -1645,7 +2287,7 @@ void server_state::recall_partition(std::shared_ptr<app_state> &app, int pidx)
     dassert((pc.partition_flags & pc_flags::dropped), "");
 
     pc.partition_flags = 0;
-    blob json_partition = dsn::json::json_forwarder<partition_configuration>::encode(pc);
+    blob json_partition = encode_partition_configuration(pc);
     std::string partition_path = get_partition_path(pc.pid);
     _meta_svc->get_remote_storage()->set_data(
         partition_path, json_partition, LPC_META_STATE_HIGH, on_recall_partition);
@@ -1699,6 +2341,79 @@ void server_state::drop_partition(std::shared_ptr<app_state> &app, int pidx)
 }
 
 void server_state::downgrade_primary_to_inactive(std::shared_ptr<app_state> &app, int pidx)
+{
+    std::shared_ptr<configuration_update_request> req = make_primary_downgrade_request(app, pidx);
+    if (req == nullptr) {
+        return;
+    }
+
+    config_context &cc = app->helpers->contexts[pidx];
+    cc.stage = config_status::pending_remote_sync;
+    cc.pending_sync_request = req;
+    cc.msg = nullptr;
+
+    cc.pending_sync_task = update_configuration_on_remote(req);
+}
+
+void server_state::downgrade_primaries_to_inactive(const std::vector<gpid> &pids)
+{
+    meta_function_level::type l = _meta_svc->get_function_level();
+    size_t batch_count = FLAGS_partition_config_update_batch_max_count;
+    if (l <= meta_function_level::fl_blind || batch_count <= 1) {
+        for (const gpid &pid : pids) {
+            std::shared_ptr<app_state> app = get_app(pid.get_app_id());
+            downgrade_primary_to_inactive(app, pid.get_partition_index());
+        }
+        return;
+    }
+
+    std::vector<std::shared_ptr<configuration_update_request>> requests;
+    requests.reserve(pids.size());
+    for (const gpid &pid : pids) {
+        std::shared_ptr<app_state> app = get_app(pid.get_app_id());
+        std::shared_ptr<configuration_update_request> req =
+            make_primary_downgrade_request(app, pid.get_partition_index());
+        if (req == nullptr) {
+            continue;
+        }
+
+        // the task is never enqueued, but it keeps the partition cancellable as the others
+        // pending remote sync, the reply of the transaction skips the cancelled ones
+        config_context &cc = app->helpers->contexts[pid.get_partition_index()];
+        cc.stage = config_status::pending_remote_sync;
+        cc.pending_sync_request = req;
+        cc.msg = nullptr;
+        cc.pending_sync_task =
+            new error_code_future(LPC_META_STATE_HIGH, error_code_future::TCallback(), 0);
+        requests.emplace_back(std::move(req));
+    }
+
+    ddebug_f("downgrade {} primaries to inactive in transactions of {}",
+             requests.size(),
+             batch_count);
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    for (size_t start = 0; start < requests.size(); start += batch_count) {
+        size_t end = std::min(start + batch_count, requests.size());
+        std::vector<std::shared_ptr<configuration_update_request>> batch(
+            requests.begin() + start, requests.begin() + end);
+        auto entries = storage->new_transaction_entries(static_cast<unsigned int>(batch.size()));
+        for (const auto &req : batch) {
+            std::string path = get_partition_path(req->config.pid);
+            error_code ec = entries->set_data(path, encode_partition_configuration(req->config));
+            dassert_f(ec == ERR_OK, "add {} to transaction failed, err = {}", path, ec);
+        }
+        storage->submit_transaction(
+            entries,
+            LPC_META_STATE_HIGH,
+            [this, batch](error_code ec) mutable {
+                on_update_configurations_on_remote_reply(ec, batch);
+            },
+            tracker());
+    }
+}
+
+std::shared_ptr<configuration_update_request>
+server_state::make_primary_downgrade_request(std::shared_ptr<app_state> &app, int pidx)
 {
     partition_configuration &pc = app->partitions[pidx];
     config_context &cc = app->helpers->contexts[pidx];
@@ -1710,7 +2425,7 @@ void server_state::downgrade_primary_to_inactive(std::shared_ptr<app_state> &app
                     app->get_logname(),
                     enum_to_string(app->status));
             dwarn("stop downgrade primary as the partitions(%d.%d) is dropping", app->app_id, pidx);
-            return;
+            return nullptr;
         } else {
             dwarn("gpid(%d.%d) is syncing another request with remote, cancel it due to the "
                   "primary(%s) is down",
@@ -1731,12 +2446,7 @@ void server_state::downgrade_primary_to_inactive(std::shared_ptr<app_state> &app
     request.config.ballot++;
     request.config.primary.set_invalid();
     maintain_drops(request.config.last_drops, pc.primary, request.type);
-
-    cc.stage = config_status::pending_remote_sync;
-    cc.pending_sync_request = req;
-    cc.msg = nullptr;
-
-    cc.pending_sync_task = update_configuration_on_remote(req);
+    return req;
 }
 
 void server_state::downgrade_secondary_to_inactive(std::shared_ptr<app_state> &app,
@@ -1922,17 +2632,28 @@ void server_state::on_change_node_state(rpc_address node, bool is_alive)
             node_state &ns = iter->second;
             ns.set_alive(false);
             ns.set_replicas_collect_flag(false);
+            std::vector<gpid> primaries;
             ns.for_each_partition([&, this](const dsn::gpid &pid) {
                 std::shared_ptr<app_state> app = get_app(pid.get_app_id());
                 dassert(app != nullptr && app->status != app_status::AS_DROPPED,
                         "invalid app, app_id = %d",
                         pid.get_app_id());
-                on_partition_node_dead(app, pid.get_partition_index(), node);
+                if (FLAGS_bulk_downgrade_on_node_dead_enabled && app->is_stateful &&
+                    is_primary(app->partitions[pid.get_partition_index()], node)) {
+                    primaries.push_back(pid);
+                } else {
+                    on_partition_node_dead(app, pid.get_partition_index(), node);
+                }
                 return true;
             });
+            if (!primaries.empty()) {
+                downgrade_primaries_to_inactive(primaries);
+            }
         }
     } else {
         get_node_state(_nodes, node, true)->set_alive(true);
+        // the node is back after a restart, which ends its drain
+        _draining_nodes.erase(node);
     }
 }
 
@@ -2152,9 +2873,38 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
     std::vector<query_replica_info_response> query_replica_responses(n_replicas);
     std::vector<dsn::error_code> query_app_errors(n_replicas);
     std::vector<dsn::error_code> query_replica_errors(n_replicas);
+    // the count of the queries of each node not replied yet
+    std::unique_ptr<std::atomic<int>[]> pending_queries(new std::atomic<int>[n_replicas]);
+
+    {
+        zauto_lock l(_recovery_progress_lock);
+        _recovery_progress = recovery_progress();
+        _recovery_progress.stage = "querying";
+        _recovery_progress.total_nodes = n_replicas;
+        _recovery_progress.start_time_ms = dsn_now_ms();
+    }
+
+    // the nodes are queried at most recovery_query_max_concurrency at a time, a slot is taken
+    // before a node is queried and given back once both of its queries are replied
+    dsn::utils::semaphore slots(FLAGS_recovery_query_max_concurrency);
+    auto on_query_replied = [&](int i) {
+        if (--pending_queries[i] > 0) {
+            return;
+        }
+        {
+            zauto_lock l(_recovery_progress_lock);
+            _recovery_progress.queried_nodes++;
+            if (query_app_errors[i] != dsn::ERR_OK || query_replica_errors[i] != dsn::ERR_OK) {
+                _recovery_progress.failed_nodes++;
+            }
+        }
+        slots.signal();
+    };
 
     dsn::task_tracker tracker;
     for (int i = 0; i < n_replicas; ++i) {
+        slots.wait();
+        pending_queries[i] = 2;
         ddebug("send query app and replica request to node(%s)", replica_nodes[i].to_string());
 
         query_app_info_request app_query;
@@ -2164,7 +2914,7 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
                   RPC_QUERY_APP_INFO,
                   app_query,
                   &tracker,
-                  [i, &replica_nodes, &query_app_errors, &query_app_responses](
+                  [i, &replica_nodes, &query_app_errors, &query_app_responses, &on_query_replied](
                       dsn::error_code err, query_app_info_response &&resp) mutable {
                       ddebug("received query app response from node(%s), err(%s), apps_count(%d)",
                              replica_nodes[i].to_string(),
@@ -2174,6 +2924,7 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
                       if (err == dsn::ERR_OK) {
                           query_app_responses[i] = std::move(resp);
                       }
+                      on_query_replied(i);
                   });
 
         query_replica_info_request replica_query;
@@ -2183,7 +2934,7 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
             RPC_QUERY_REPLICA_INFO,
             replica_query,
             &tracker,
-            [i, &replica_nodes, &query_replica_errors, &query_replica_responses](
+            [i, &replica_nodes, &query_replica_errors, &query_replica_responses, &on_query_replied](
                 dsn::error_code err, query_replica_info_response &&resp) mutable {
                 ddebug("received query replica response from node(%s), err(%s), replicas_count(%d)",
                        replica_nodes[i].to_string(),
@@ -2193,6 +2944,7 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
                 if (err == dsn::ERR_OK) {
                     query_replica_responses[i] = std::move(resp);
                 }
+                on_query_replied(i);
             });
     }
 
@@ -2240,14 +2992,17 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
            (skip_bad_nodes ? "true" : "false"));
 
     if (failed_count > 0 && !skip_bad_nodes) {
+        set_recovery_stage("failed");
         return dsn::ERR_TRY_AGAIN;
     }
 
+    set_recovery_stage("constructing");
     zauto_write_lock l(_lock);
 
     dsn::error_code err = construct_apps(query_app_responses, replica_nodes, hint_message);
     if (err != dsn::ERR_OK) {
         derror("construct apps failed, err = %s", err.to_string());
+        set_recovery_stage("failed");
         return err;
     }
 
@@ -2255,12 +3010,28 @@ server_state::sync_apps_from_replica_nodes(const std::vector<dsn::rpc_address> &
         query_replica_responses, replica_nodes, skip_lost_partitions, hint_message);
     if (err != dsn::ERR_OK) {
         derror("construct partitions failed, err = %s", err.to_string());
+        set_recovery_stage("failed");
         return err;
     }
 
     return dsn::ERR_OK;
 }
 
+void server_state::set_recovery_stage(const char *stage)
+{
+    zauto_lock l(_recovery_progress_lock);
+    _recovery_progress.stage = stage;
+    if (strcmp(stage, "done") == 0 || strcmp(stage, "failed") == 0) {
+        _recovery_progress.end_time_ms = dsn_now_ms();
+    }
+}
+
+recovery_progress server_state::get_recovery_progress() const
+{
+    zauto_lock l(_recovery_progress_lock);
+    return _recovery_progress;
+}
+
 void server_state::on_start_recovery(const configuration_recovery_request &req,
                                      configuration_recovery_response &resp)
 {
@@ -2278,6 +3049,7 @@ void server_state::on_start_recovery(const configuration_recovery_request &req,
         return;
     }
 
+    set_recovery_stage("syncing");
     resp.err = sync_apps_to_remote_storage();
     if (resp.err != dsn::ERR_OK) {
         dassert(false,
@@ -2287,6 +3059,7 @@ void server_state::on_start_recovery(const configuration_recovery_request &req,
     }
 
     initialize_node_state();
+    set_recovery_stage("done");
 }
 
 void server_state::clear_proposals()
@@ -2379,6 +3152,12 @@ bool server_state::check_all_partitions()
                    ::dsn::enum_to_string(app->status));
             continue;
         }
+        // -1 means the read replicas are not managed for this app
+        int read_replica_count = -1;
+        auto env = app->envs.find(replica_envs::READ_REPLICA_COUNT);
+        if (env != app->envs.end() && !buf2int32(env->second, read_replica_count)) {
+            read_replica_count = -1;
+        }
         for (unsigned int i = 0; i != app->partition_count; ++i) {
             partition_configuration &pc = app->partitions[i];
             config_context &cc = app->helpers->contexts[i];
@@ -2405,6 +3184,9 @@ bool server_state::check_all_partitions()
                     }
                 } else {
                     healthy_partitions++;
+                    if (read_replica_count >= 0) {
+                        send_read_replicas_proposal(pc, *app, read_replica_count);
+                    }
                 }
             } else {
                 ddebug("ignore gpid(%d.%d) as it's stage is pending_remote_sync",
@@ -46,6 +46,7 @@
 #include "common/replication_common.h"
 #include "meta_data.h"
 #include "meta_service.h"
+#include "table_quota_allocator.h"
 
 namespace dsn {
 namespace replication {
@@ -105,6 +106,28 @@ class meta_service;
 // D. thread-model of meta server
 // E. load balancer
 
+// The apps tree read from the remote storage by a meta server waiting for the leader lock,
+// keyed by the node paths. The missing partition nodes are not included.
+struct apps_snapshot
+{
+    // the version of the tree when it started to be read, see meta_state_service_versioned
+    std::string version;
+    std::vector<std::string> apps;
+    std::unordered_map<std::string, blob> nodes;
+};
+
+// the progress of the last recovery from the replica nodes, see on_start_recovery
+struct recovery_progress
+{
+    // idle, querying, constructing, syncing, done or failed
+    std::string stage{"idle"};
+    int total_nodes{0};
+    int queried_nodes{0};
+    int failed_nodes{0};
+    uint64_t start_time_ms{0};
+    uint64_t end_time_ms{0};
+};
+
 class server_state
 {
 public:
@@ -115,7 +138,8 @@ public:
     ~server_state();
 
     void initialize(meta_service *meta_svc, const std::string &apps_root);
-    error_code initialize_data_structure();
+    // the apps are recovered from `snapshot` instead of the remote storage if it's not null
+    error_code initialize_data_structure(const apps_snapshot *snapshot = nullptr);
     void register_cli_commands();
 
     void lock_read(zauto_read_lock &other);
@@ -138,8 +162,27 @@ public:
 
     void query_configuration_by_index(const configuration_query_by_index_request &request,
                                       /*out*/ configuration_query_by_index_response &response);
+    // the usages the primaries of the app reported in the config sync
+    void get_partition_usages(const app_info &app, /*out*/ std::vector<partition_quota> &usages)
+    {
+        _quota_allocator.get_usages(app, usages);
+    }
+    // serves an available app's configuration query with the response serialized in `fmt`,
+    // cached until a partition of the app changes its configuration. returns false if the app
+    // has no query view, and the query should go to query_configuration_by_index
+    bool query_configuration_by_index_serialized(
+        const configuration_query_by_index_request &request,
+        dsn_msg_serialize_format fmt,
+        /*out*/ blob &data);
+    // holds the watch until a partition of the app gets a newer ballot than the known one, or
+    // the watch expires, see configuration_watch_app_request
+    void watch_app_configuration(configuration_watch_app_rpc rpc);
     bool query_configuration_by_gpid(const dsn::gpid id, /*out*/ partition_configuration &config);
 
+    // republishes the query view of the app after its status or partition count changed,
+    // the caller must hold the write lock of _lock
+    void refresh_query_view(const std::shared_ptr<app_state> &app);
+
     // app options
     void create_app(dsn::message_ex *msg);
     void drop_app(dsn::message_ex *msg);
@@ -167,6 +210,7 @@ public:
                              configuration_balancer_response &response);
     void on_start_recovery(const configuration_recovery_request &request,
                            configuration_recovery_response &response);
+    recovery_progress get_recovery_progress() const;
     void on_recv_restore_report(configuration_report_restore_status_rpc rpc);
 
     void on_query_restore_status(configuration_query_restore_rpc rpc);
@@ -196,7 +240,11 @@ private:
 
     error_code dump_app_states(const char *local_path,
                                const std::function<app_state *()> &iterator);
-    error_code sync_apps_from_remote_storage();
+    error_code sync_apps_from_remote_storage(const apps_snapshot *snapshot = nullptr);
+    // reads the apps tree under `apps_root` without changing anything, see apps_snapshot
+    static error_code load_apps_snapshot(dist::meta_state_service *storage,
+                                         const std::string &apps_root,
+                                         /*out*/ apps_snapshot &snapshot);
     // sync local state to remote storage,
     // if return OK, all states are synced correctly, and all apps are in stable state
     // else indicate error that remote storage responses
@@ -226,10 +274,14 @@ private:
         bool skip_lost_partitions,
         std::string &hint_message);
 
+    void set_recovery_stage(const char *stage);
+
     void do_app_create(std::shared_ptr<app_state> &app);
     void do_app_drop(std::shared_ptr<app_state> &app);
     void do_app_recall(std::shared_ptr<app_state> &app);
     void init_app_partition_node(std::shared_ptr<app_state> &app, int pidx, task_ptr callback);
+    // create the partition nodes in [start_pidx, end_pidx) of app in a transaction
+    void init_app_partition_nodes(std::shared_ptr<app_state> &app, int start_pidx, int end_pidx);
     // do_update_app_info()
     //  -- ensure update app_info to remote storage succeed, if timeout, it will retry autoly
     void do_update_app_info(const std::string &app_path,
@@ -238,9 +290,18 @@ private:
 
     task_ptr
     update_configuration_on_remote(std::shared_ptr<configuration_update_request> &config_request);
+    // write the config updates batched by update_configuration_on_remote in transactions
+    void flush_configuration_updates_on_remote();
     void
     on_update_configuration_on_remote_reply(error_code ec,
                                             std::shared_ptr<configuration_update_request> &request);
+    // assert(_lock.locked())
+    void handle_update_configuration_on_remote_reply(
+        error_code ec, std::shared_ptr<configuration_update_request> &request);
+    // the reply of the config updates written together in a transaction by
+    // downgrade_primaries_to_inactive, the ones cancelled since then are skipped
+    void on_update_configurations_on_remote_reply(
+        error_code ec, std::vector<std::shared_ptr<configuration_update_request>> &requests);
     void
     update_configuration_locally(app_state &app,
                                  std::shared_ptr<configuration_update_request> &config_request);
@@ -249,6 +310,12 @@ private:
     void recall_partition(std::shared_ptr<app_state> &app, int pidx);
     void drop_partition(std::shared_ptr<app_state> &app, int pidx);
     void downgrade_primary_to_inactive(std::shared_ptr<app_state> &app, int pidx);
+    // return nullptr if the primary needn't be downgraded
+    std::shared_ptr<configuration_update_request>
+    make_primary_downgrade_request(std::shared_ptr<app_state> &app, int pidx);
+    // downgrade the primaries on a dead node in one pass, see
+    // [meta_server] bulk_downgrade_on_node_dead_enabled
+    void downgrade_primaries_to_inactive(const std::vector<gpid> &pids);
     void downgrade_secondary_to_inactive(std::shared_ptr<app_state> &app,
                                          int pidx,
                                          const rpc_address &node);
@@ -263,6 +330,20 @@ private:
     void send_proposal(const configuration_proposal_action &action,
                        const partition_configuration &pc,
                        const app_state &app);
+    // propose the read replicas of a healthy partition to its primary, which are not persisted
+    // but proposed again in every round, so that they follow the primary after failover
+    void send_read_replicas_proposal(const partition_configuration &pc,
+                                     const app_state &app,
+                                     int read_replica_count);
+
+    // node drain, see server_state_drain.cpp
+    std::string remote_command_drain_node(const std::vector<std::string> &args);
+    // move the primaries of every draining node a step further, and schedule the next step
+    // unless all nodes are drained
+    void drain_nodes_step();
+    struct node_drain_context;
+    // assert(_lock.locked())
+    void drain_node_step(const rpc_address &node, node_drain_context &ctx);
 
     // util function
     int32_t next_app_id() const
@@ -295,10 +376,14 @@ private:
 private:
     friend class bulk_load_service;
     friend class bulk_load_service_test;
+    friend class config_update_batch_test;
+    friend class config_watch_test;
+    friend class greedy_load_balancer_test;
     friend class meta_app_operation_test;
     friend class meta_duplication_service;
     friend class meta_duplication_service_test;
     friend class meta_load_balance_test;
+    friend class meta_node_drain_test;
     friend class meta_split_service;
     friend class meta_split_service_test;
     friend class meta_service_test_app;
@@ -326,6 +411,83 @@ private:
     // for load balancer
     migration_list _temporary_list;
 
+    mutable zlock _recovery_progress_lock;
+    recovery_progress _recovery_progress;
+
+    // what query_configuration_by_index replies for an available app, published so that the
+    // queries are served without taking _lock and never wait behind the writers of other apps.
+    // the slots are swapped one partition at a time by update_configuration_locally, the whole
+    // view is replaced by refresh_query_view. apps without a view are served under _lock
+    struct app_query_view
+    {
+        int32_t app_id;
+        int32_t partition_count;
+        bool is_stateful;
+        std::vector<std::shared_ptr<const partition_configuration>> partitions;
+
+        // bumped after each swap of the slots, the serialized responses of older versions
+        // are stale. the responses are keyed by the serialize format and partition indices
+        struct serialized_response
+        {
+            uint64_t version;
+            blob data;
+        };
+        std::atomic<uint64_t> version{0};
+        zlock responses_lock;
+        std::unordered_map<std::string, serialized_response> responses;
+    };
+    std::shared_ptr<app_query_view> get_query_view(const std::string &app_name) const;
+    static void fill_query_response(const app_query_view &view,
+                                    const configuration_query_by_index_request &request,
+                                    /*out*/ configuration_query_by_index_response &response);
+
+    // the watches held until the configurations of their apps change, each is replied by the
+    // one who takes it out of _config_watches: the change notification or its expire task
+    struct config_watch
+    {
+        configuration_watch_app_rpc rpc;
+        task_ptr expire_task;
+    };
+    // fills the response of the watch, returns false if nothing is newer than the known
+    bool fill_watch_response(const configuration_watch_app_request &request,
+                             /*out*/ configuration_query_by_index_response &response);
+    bool take_config_watch(const std::string &app_name,
+                           const std::shared_ptr<config_watch> &watch);
+    // replies all the watches of the app, called when its configurations change
+    void notify_config_watches(const std::string &app_name);
+    zlock _config_watches_lock;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<config_watch>>> _config_watches;
+    size_t _config_watch_count{0};
+    mutable zrwlock_nr _query_views_lock;
+    std::unordered_map<std::string, std::shared_ptr<app_query_view>> _query_views;
+
+    // splits the table quotas among the primaries, see on_config_sync
+    table_quota_allocator _quota_allocator;
+
+    // the partition config updates waiting to be written to the remote storage in batch,
+    // each is completed by its own callback task, which is the pending_sync_task
+    struct pending_configuration_update
+    {
+        std::string path;
+        blob value;
+        error_code_future_ptr callback;
+    };
+    zlock _pending_configuration_updates_lock;
+    std::vector<pending_configuration_update> _pending_configuration_updates;
+    bool _configuration_updates_flush_scheduled{false};
+
+    // protected by _lock
+    struct node_drain_context
+    {
+        int32_t max_per_destination{0};
+        // the partitions whose primaries are being moved off the node, to their destinations
+        std::map<gpid, rpc_address> moving;
+        bool drained{false};
+        uint64_t start_time_ms{0};
+    };
+    std::map<rpc_address, node_drain_context> _draining_nodes;
+    bool _node_drain_step_scheduled{false};
+
     // for test
     config_change_subscriber _config_change_subscriber;
     replica_migration_subscriber _replica_migration_subscriber;
@@ -335,6 +497,7 @@ private:
     dsn_handle_t _cli_dump_handle;
     dsn_handle_t _ctrl_add_secondary_enable_flow_control;
     dsn_handle_t _ctrl_add_secondary_max_count_for_one_node;
+    dsn_handle_t _ctrl_drain_node;
 
     perf_counter_wrapper _dead_partition_count;
     perf_counter_wrapper _unreadable_partition_count;
@@ -0,0 +1,240 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/string_conv.h>
+
+#include "greedy_load_balancer.h"
+#include "meta_service.h"
+#include "server_state.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("meta_server",
+                  node_drain_step_interval_ms,
+                  1000,
+                  "the interval between the steps of the node drains, in each of which the "
+                  "primaries that finished moving are replaced with new ones");
+DSN_DEFINE_validator(node_drain_step_interval_ms,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_TAG_VARIABLE(node_drain_step_interval_ms, FT_MUTABLE);
+
+DSN_DEFINE_int32("meta_server",
+                 node_drain_max_per_destination,
+                 2,
+                 "the default max count of primaries moved to one node at the same time by a "
+                 "node drain");
+DSN_DEFINE_validator(node_drain_max_per_destination,
+                     [](int32_t value) -> bool { return value > 0; });
+DSN_TAG_VARIABLE(node_drain_max_per_destination, FT_MUTABLE);
+
+std::string server_state::remote_command_drain_node(const std::vector<std::string> &args)
+{
+    static const std::string invalid_arguments("ERR: invalid arguments");
+    if (args.empty()) {
+        return invalid_arguments;
+    }
+
+    zauto_write_lock l(_lock);
+    if (args[0] == "status") {
+        if (args.size() != 1) {
+            return invalid_arguments;
+        }
+        utils::table_printer tp("node_drain");
+        tp.add_title("node");
+        tp.add_column("status");
+        tp.add_column("primary_count");
+        tp.add_column("moving_count");
+        tp.add_column("elapsed_ms");
+        for (const auto &kv : _draining_nodes) {
+            auto iter = _nodes.find(kv.first);
+            tp.add_row(kv.first.to_std_string());
+            tp.append_data(kv.second.drained ? "drained" : "draining");
+            tp.append_data(iter == _nodes.end() ? 0 : iter->second.primary_count());
+            tp.append_data(kv.second.moving.size());
+            tp.append_data(dsn_now_ms() - kv.second.start_time_ms);
+        }
+        std::ostringstream out;
+        tp.output(out);
+        return out.str();
+    }
+
+    if (args.size() < 2) {
+        return invalid_arguments;
+    }
+    rpc_address node;
+    if (!node.from_string_ipv4(args[1].c_str())) {
+        return invalid_arguments;
+    }
+
+    if (args[0] == "cancel") {
+        if (args.size() != 2) {
+            return invalid_arguments;
+        }
+        // the moves already proposed are left to finish
+        if (_draining_nodes.erase(node) == 0) {
+            return "ERR: node isn't being drained";
+        }
+        ddebug_f("cancel the drain of node({})", node);
+        return "OK";
+    }
+
+    if (args[0] != "start" || args.size() > 3) {
+        return invalid_arguments;
+    }
+    int32_t max_per_destination = FLAGS_node_drain_max_per_destination;
+    if (args.size() == 3 &&
+        (!buf2int32(args[2], max_per_destination) || max_per_destination <= 0)) {
+        return invalid_arguments;
+    }
+    if (!is_node_alive(_nodes, node)) {
+        return "ERR: node isn't alive";
+    }
+    if (_draining_nodes.count(node) != 0) {
+        return "ERR: node is already being drained";
+    }
+
+    node_drain_context &ctx = _draining_nodes[node];
+    ctx.max_per_destination = max_per_destination;
+    ctx.start_time_ms = dsn_now_ms();
+    ddebug_f("start to drain node({}), max_per_destination = {}", node, max_per_destination);
+    drain_node_step(node, ctx);
+    if (!_node_drain_step_scheduled) {
+        _node_drain_step_scheduled = true;
+        tasking::enqueue(LPC_META_STATE_NORMAL,
+                         tracker(),
+                         [this]() { drain_nodes_step(); },
+                         server_state::sStateHash,
+                         std::chrono::milliseconds(FLAGS_node_drain_step_interval_ms));
+    }
+    return "OK";
+}
+
+void server_state::drain_nodes_step()
+{
+    zauto_write_lock l(_lock);
+    bool all_drained = true;
+    for (auto &kv : _draining_nodes) {
+        if (!kv.second.drained) {
+            drain_node_step(kv.first, kv.second);
+            all_drained = all_drained && kv.second.drained;
+        }
+    }
+    if (all_drained) {
+        _node_drain_step_scheduled = false;
+        return;
+    }
+    tasking::enqueue(LPC_META_STATE_NORMAL,
+                     tracker(),
+                     [this]() { drain_nodes_step(); },
+                     server_state::sStateHash,
+                     std::chrono::milliseconds(FLAGS_node_drain_step_interval_ms));
+}
+
+void server_state::drain_node_step(const rpc_address &node, node_drain_context &ctx)
+{
+    auto node_iter = _nodes.find(node);
+    if (node_iter == _nodes.end() || !node_iter->second.alive()) {
+        // the primaries of a dead node are all downgraded
+        ddebug_f("node({}) is dead, regard it as drained", node);
+        ctx.moving.clear();
+        ctx.drained = true;
+        return;
+    }
+
+    // a move is finished once the node isn't the primary and no more actions are left, and is
+    // also dropped if its actions were discarded, to be proposed again below
+    std::map<rpc_address, int> in_flight;
+    for (auto iter = ctx.moving.begin(); iter != ctx.moving.end();) {
+        std::shared_ptr<app_state> app = get_app(iter->first.get_app_id());
+        if (app == nullptr || app->status != app_status::AS_AVAILABLE) {
+            iter = ctx.moving.erase(iter);
+            continue;
+        }
+        int pidx = iter->first.get_partition_index();
+        const config_context &cc = app->helpers->contexts[pidx];
+        if (cc.lb_actions.empty() && cc.stage != config_status::pending_remote_sync) {
+            iter = ctx.moving.erase(iter);
+            continue;
+        }
+        ++in_flight[iter->second];
+        ++iter;
+    }
+
+    if (_meta_svc->get_function_level() <= meta_function_level::fl_freezed) {
+        return;
+    }
+
+    int primary_count = 0;
+    node_iter->second.for_each_partition([&, this](const gpid &pid) {
+        std::shared_ptr<app_state> app = get_app(pid.get_app_id());
+        if (app == nullptr || !app->is_stateful || app->status != app_status::AS_AVAILABLE) {
+            return true;
+        }
+        int pidx = pid.get_partition_index();
+        const partition_configuration &pc = app->partitions[pidx];
+        if (pc.primary != node) {
+            return true;
+        }
+        ++primary_count;
+        config_context &cc = app->helpers->contexts[pidx];
+        if (ctx.moving.count(pid) != 0 || cc.stage == config_status::pending_remote_sync ||
+            !cc.lb_actions.empty()) {
+            return true;
+        }
+
+        // a secondary in the config has acknowledged every prepare of the primary, so it's
+        // fully caught up and the primary can be handed over without learning
+        rpc_address dest;
+        for (const rpc_address &secondary : pc.secondaries) {
+            if (!is_node_alive(_nodes, secondary) || _draining_nodes.count(secondary) != 0) {
+                continue;
+            }
+            int count = in_flight[secondary];
+            if (count < ctx.max_per_destination && (dest.is_invalid() || count < in_flight[dest])) {
+                dest = secondary;
+            }
+        }
+        if (dest.is_invalid()) {
+            return true;
+        }
+
+        ++in_flight[dest];
+        ctx.moving[pid] = dest;
+        cc.lb_actions.assign_balancer_proposals(
+            {new_proposal_action(node, node, config_type::CT_DOWNGRADE_TO_SECONDARY),
+             new_proposal_action(dest, dest, config_type::CT_UPGRADE_TO_PRIMARY)});
+        configuration_proposal_action action;
+        _meta_svc->get_balancer()->cure({&_all_apps, &_nodes}, pid, action);
+        if (action.type != config_type::CT_INVALID) {
+            send_proposal(action, pc, *app);
+        }
+        return true;
+    });
+
+    if (primary_count == 0 && ctx.moving.empty()) {
+        ctx.drained = true;
+        ddebug_f("node({}) is drained in {} ms", node, dsn_now_ms() - ctx.start_time_ms);
+    }
+}
+
+} // namespace replication
+} // namespace dsn
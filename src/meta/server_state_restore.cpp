@@ -151,6 +151,10 @@ std::pair<dsn::error_code, std::shared_ptr<app_state>> server_state::restore_app
     if (req.__isset.restore_path) {
         app->envs[backup_restore_constant::RESTORE_PATH] = req.restore_path;
     }
+    if (req.__isset.cold_tier_cache_mb && req.cold_tier_cache_mb > 0) {
+        app->envs[backup_restore_constant::COLD_TIER_CACHE_MB] =
+            std::to_string(req.cold_tier_cache_mb);
+    }
     res.second.swap(app);
     return res;
 }
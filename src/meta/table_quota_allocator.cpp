@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/replication/replica_envs.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/string_conv.h>
+#include <algorithm>
+
+#include "table_quota_allocator.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("meta_server",
+                  partition_usage_expire_seconds,
+                  120,
+                  "the usage a replica server reported for a partition is ignored if it isn't "
+                  "reported again in this long, which should be a few config_sync_interval_ms");
+DSN_DEFINE_validator(partition_usage_expire_seconds,
+                     [](uint32_t value) -> bool { return value > 0; });
+
+static int64_t parse_quota(const std::map<std::string, std::string> &envs, const std::string &key)
+{
+    int64_t quota = 0;
+    auto iter = envs.find(key);
+    if (iter == envs.end() || !buf2int64(iter->second, quota) || quota < 0) {
+        return 0;
+    }
+    return quota;
+}
+
+/*static*/ bool table_quota_allocator::parse_quotas(const std::map<std::string, std::string> &envs,
+                                                    /*out*/ partition_quota &quotas)
+{
+    quotas.write_qps = parse_quota(envs, replica_envs::WRITE_QPS_QUOTA);
+    quotas.write_bytes_per_sec = parse_quota(envs, replica_envs::WRITE_SIZE_QUOTA);
+    quotas.read_qps = parse_quota(envs, replica_envs::READ_QPS_QUOTA);
+    return quotas.write_qps > 0 || quotas.write_bytes_per_sec > 0 || quotas.read_qps > 0;
+}
+
+/*static*/ int64_t table_quota_allocator::share(int64_t quota,
+                                                int64_t usage,
+                                                int64_t total_usage,
+                                                int32_t partition_count)
+{
+    if (quota <= 0 || partition_count <= 0) {
+        return 0;
+    }
+    // (usage + quota / n) / (total_usage + quota) of the quota, the parts sum up to 1
+    double part = (usage + static_cast<double>(quota) / partition_count) / (total_usage + quota);
+    return std::max<int64_t>(1, static_cast<int64_t>(quota * part));
+}
+
+void table_quota_allocator::update_usages(const std::vector<partition_quota> &usages,
+                                          uint64_t now_ms)
+{
+    uint64_t expire_ms = FLAGS_partition_usage_expire_seconds * 1000ULL;
+    zauto_lock l(_lock);
+    for (const partition_quota &usage : usages) {
+        _usages[usage.pid] = reported_usage{usage, now_ms};
+    }
+
+    // erase the expired usages at most once per expiration, rather than on every config sync
+    if (_last_expire_ms + expire_ms > now_ms) {
+        return;
+    }
+    _last_expire_ms = now_ms;
+    for (auto iter = _usages.begin(); iter != _usages.end();) {
+        if (iter->second.report_ms + expire_ms <= now_ms) {
+            iter = _usages.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+const partition_quota *table_quota_allocator::find_usage(const gpid &pid, uint64_t now_ms) const
+{
+    auto iter = _usages.find(pid);
+    if (iter == _usages.end() ||
+        iter->second.report_ms + FLAGS_partition_usage_expire_seconds * 1000ULL <= now_ms) {
+        return nullptr;
+    }
+    return &iter->second.usage;
+}
+
+void table_quota_allocator::get_usages(const app_info &app,
+                                       /*out*/ std::vector<partition_quota> &usages) const
+{
+    uint64_t now_ms = dsn_now_ms();
+    zauto_lock l(_lock);
+    for (int32_t i = 0; i < app.partition_count; ++i) {
+        const partition_quota *usage = find_usage(gpid(app.app_id, i), now_ms);
+        if (usage != nullptr) {
+            usages.push_back(*usage);
+        }
+    }
+}
+
+void table_quota_allocator::assign(const app_info &app,
+                                   const std::vector<gpid> &primaries,
+                                   /*out*/ std::vector<partition_quota> &shares) const
+{
+    partition_quota quotas;
+    if (primaries.empty() || !parse_quotas(app.envs, quotas)) {
+        return;
+    }
+
+    partition_quota total;
+    std::vector<partition_quota> usages(primaries.size());
+    {
+        uint64_t now_ms = dsn_now_ms();
+        zauto_lock l(_lock);
+        for (int32_t i = 0; i < app.partition_count; ++i) {
+            const partition_quota *usage = find_usage(gpid(app.app_id, i), now_ms);
+            if (usage != nullptr) {
+                total.write_qps += usage->write_qps;
+                total.write_bytes_per_sec += usage->write_bytes_per_sec;
+                total.read_qps += usage->read_qps;
+            }
+        }
+        for (size_t i = 0; i < primaries.size(); ++i) {
+            const partition_quota *usage = find_usage(primaries[i], now_ms);
+            if (usage != nullptr) {
+                usages[i] = *usage;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < primaries.size(); ++i) {
+        partition_quota share;
+        share.pid = primaries[i];
+        share.write_qps = table_quota_allocator::share(
+            quotas.write_qps, usages[i].write_qps, total.write_qps, app.partition_count);
+        share.write_bytes_per_sec = table_quota_allocator::share(quotas.write_bytes_per_sec,
+                                                                 usages[i].write_bytes_per_sec,
+                                                                 total.write_bytes_per_sec,
+                                                                 app.partition_count);
+        share.read_qps = table_quota_allocator::share(
+            quotas.read_qps, usages[i].read_qps, total.read_qps, app.partition_count);
+        shares.push_back(std::move(share));
+    }
+}
+
+} // namespace replication
+} // namespace dsn
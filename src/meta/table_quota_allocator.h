@@ -0,0 +1,79 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/tool-api/zlocks.h>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace dsn {
+namespace replication {
+
+// Splits the table-wide quotas set by the app envs among the primary replicas of the table, in
+// proportion to the recent usages they report in the config sync. Every partition is assigned
+// an even part of the quota on top of its proportional part, so an idle partition can admit
+// requests once the traffic moves to it, and the shares of a table always add up to its quota.
+//
+// thread safe
+class table_quota_allocator
+{
+public:
+    // return false if none of the quotas is set in `envs`.
+    static bool parse_quotas(const std::map<std::string, std::string> &envs,
+                             /*out*/ partition_quota &quotas);
+
+    // the share of `quota` for a partition of `usage`, where `total_usage` is the usage of
+    // all the `partition_count` partitions of the table.
+    static int64_t
+    share(int64_t quota, int64_t usage, int64_t total_usage, int32_t partition_count);
+
+    // the usages are reported at `now_ms`, and expire after [meta_server]
+    // partition_usage_expire_seconds unless reported again.
+    void update_usages(const std::vector<partition_quota> &usages, uint64_t now_ms = dsn_now_ms());
+
+    // the unexpired usages reported for the partitions of the app, also used by the auto split
+    // and the load balancer
+    void get_usages(const app_info &app, /*out*/ std::vector<partition_quota> &usages) const;
+
+    // append the shares of the `primaries` of the table to `shares` if the table has quotas.
+    void assign(const app_info &app,
+                const std::vector<gpid> &primaries,
+                /*out*/ std::vector<partition_quota> &shares) const;
+
+private:
+    struct reported_usage
+    {
+        partition_quota usage;
+        uint64_t report_ms;
+    };
+
+    // nullptr if the usage of `pid` isn't reported or has expired
+    const partition_quota *find_usage(const gpid &pid, uint64_t now_ms) const;
+
+    mutable zlock _lock;
+    // the usage of a removed partition, e.g. of a dropped table or a node which is gone, is
+    // erased once it expires
+    std::unordered_map<gpid, reported_usage> _usages;
+    uint64_t _last_expire_ms = 0;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,195 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "meta/background_task_scheduler.h"
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(background_task_max_per_node);
+DSN_DECLARE_uint32(background_task_max_per_app);
+DSN_DECLARE_uint32(background_task_lease_seconds);
+DSN_DECLARE_uint32(background_task_wait_seconds);
+
+class background_task_scheduler_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_max_per_node = FLAGS_background_task_max_per_node;
+        _old_max_per_app = FLAGS_background_task_max_per_app;
+        FLAGS_background_task_max_per_node = 2;
+        FLAGS_background_task_max_per_app = 16;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_background_task_max_per_node = _old_max_per_node;
+        FLAGS_background_task_max_per_app = _old_max_per_app;
+    }
+
+    // the nodes are numbered from 1, the first one is the primary
+    static partition_configuration make_config(gpid pid, const std::vector<int> &nodes)
+    {
+        partition_configuration config;
+        config.pid = pid;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (i == 0) {
+                config.primary = node(nodes[i]);
+            } else {
+                config.secondaries.push_back(node(nodes[i]));
+            }
+        }
+        return config;
+    }
+
+    static rpc_address node(int i) { return rpc_address("127.0.0.1", 34800 + i); }
+
+    bool acquire(const partition_configuration &config,
+                 int n,
+                 uint64_t now_ms = 0,
+                 bool release = false)
+    {
+        background_task_request request;
+        request.pid = config.pid;
+        request.node = node(n);
+        request.type = background_task_type::BT_CHECKPOINT;
+        request.release = release;
+        background_task_response response;
+        _scheduler.on_request(request, config, now_ms, response);
+        EXPECT_EQ(ERR_OK, response.err);
+        return response.granted;
+    }
+
+    size_t running_count() const
+    {
+        return _scheduler.running_count(background_task_type::BT_CHECKPOINT);
+    }
+
+    background_task_scheduler _scheduler;
+
+private:
+    uint32_t _old_max_per_node;
+    uint32_t _old_max_per_app;
+};
+
+TEST_F(background_task_scheduler_test, leave_one_replica_out)
+{
+    auto config = make_config(gpid(1, 0), {1, 2, 3});
+    ASSERT_TRUE(acquire(config, 2));
+    ASSERT_TRUE(acquire(config, 3));
+    ASSERT_FALSE(acquire(config, 1));
+    ASSERT_EQ(2, running_count());
+
+    // a partition with less than 3 replicas runs one at a time
+    auto single = make_config(gpid(1, 1), {1});
+    ASSERT_TRUE(acquire(single, 1));
+    auto pair = make_config(gpid(1, 2), {4, 5});
+    ASSERT_TRUE(acquire(pair, 5));
+    ASSERT_FALSE(acquire(pair, 4));
+
+    // only the members of the partition are granted
+    ASSERT_FALSE(acquire(make_config(gpid(1, 3), {1, 2, 3}), 4));
+}
+
+TEST_F(background_task_scheduler_test, renew_and_release)
+{
+    auto config = make_config(gpid(1, 0), {1, 2, 3});
+    ASSERT_TRUE(acquire(config, 2));
+    ASSERT_TRUE(acquire(config, 2));
+    ASSERT_EQ(1, running_count());
+
+    ASSERT_FALSE(acquire(config, 2, 0, true));
+    ASSERT_EQ(0, running_count());
+    // releasing twice is harmless
+    ASSERT_FALSE(acquire(config, 2, 0, true));
+    ASSERT_TRUE(acquire(config, 3));
+    ASSERT_EQ(1, running_count());
+}
+
+TEST_F(background_task_scheduler_test, max_per_node)
+{
+    ASSERT_TRUE(acquire(make_config(gpid(1, 0), {1, 2, 3}), 2));
+    ASSERT_TRUE(acquire(make_config(gpid(2, 0), {1, 2, 3}), 2));
+    ASSERT_FALSE(acquire(make_config(gpid(3, 0), {1, 2, 3}), 2));
+    ASSERT_TRUE(acquire(make_config(gpid(3, 0), {1, 2, 3}), 3));
+
+    ASSERT_FALSE(acquire(make_config(gpid(1, 0), {1, 2, 3}), 2, 0, true));
+    ASSERT_TRUE(acquire(make_config(gpid(3, 0), {1, 2, 3}), 2));
+}
+
+TEST_F(background_task_scheduler_test, max_per_app)
+{
+    FLAGS_background_task_max_per_app = 2;
+    ASSERT_TRUE(acquire(make_config(gpid(1, 0), {1, 2, 3}), 2));
+    ASSERT_TRUE(acquire(make_config(gpid(1, 1), {4, 5, 6}), 5));
+    ASSERT_FALSE(acquire(make_config(gpid(1, 2), {7, 8, 9}), 8));
+    ASSERT_TRUE(acquire(make_config(gpid(2, 0), {7, 8, 9}), 8));
+}
+
+TEST_F(background_task_scheduler_test, primary_goes_last)
+{
+    FLAGS_background_task_max_per_node = 1;
+    auto busy = make_config(gpid(1, 0), {4, 2, 5});
+    auto config = make_config(gpid(1, 1), {1, 2, 3});
+    ASSERT_TRUE(acquire(busy, 2));
+
+    // the secondary on the busy node is denied and waits, so is the primary
+    ASSERT_FALSE(acquire(config, 2, 1000));
+    ASSERT_FALSE(acquire(config, 1, 2000));
+    // but not the other secondary
+    ASSERT_TRUE(acquire(config, 3, 3000));
+
+    // the primary is granted after the waiting one is granted
+    ASSERT_FALSE(acquire(busy, 2, 4000, true));
+    ASSERT_TRUE(acquire(config, 2, 5000));
+    ASSERT_FALSE(acquire(config, 3, 6000, true));
+    ASSERT_TRUE(acquire(config, 1, 7000));
+}
+
+TEST_F(background_task_scheduler_test, waiting_expires)
+{
+    FLAGS_background_task_max_per_node = 1;
+    auto busy = make_config(gpid(1, 0), {4, 2, 5});
+    auto config = make_config(gpid(1, 1), {1, 2, 3});
+    ASSERT_TRUE(acquire(busy, 2));
+    ASSERT_FALSE(acquire(config, 2));
+    ASSERT_FALSE(acquire(config, 1));
+
+    // the secondary has stopped asking
+    uint64_t now_ms = FLAGS_background_task_wait_seconds * 1000ULL;
+    ASSERT_TRUE(acquire(config, 1, now_ms));
+}
+
+TEST_F(background_task_scheduler_test, lease_expires)
+{
+    FLAGS_background_task_max_per_node = 1;
+    auto config = make_config(gpid(1, 0), {1, 2, 3});
+    ASSERT_TRUE(acquire(config, 2));
+    ASSERT_FALSE(acquire(make_config(gpid(1, 1), {1, 2, 3}), 2));
+
+    // the grant is never released, e.g. the node is down
+    uint64_t now_ms = FLAGS_background_task_lease_seconds * 1000ULL;
+    ASSERT_TRUE(acquire(make_config(gpid(1, 1), {1, 2, 3}), 2, now_ms));
+    ASSERT_EQ(1, running_count());
+}
+
+} // namespace replication
+} // namespace dsn
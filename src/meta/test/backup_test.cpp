@@ -17,6 +17,7 @@
 
 #include <dsn/service_api_cpp.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utils/time_utils.h>
 #include <gtest/gtest.h>
 
@@ -29,6 +30,10 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(cold_backup_incremental_enabled);
+DSN_DECLARE_uint32(cold_backup_max_incremental_count);
+DSN_DECLARE_uint32(cold_backup_max_concurrent_partitions);
+
 struct method_record
 {
     dsn::utils::notify_event event;
@@ -131,6 +136,7 @@ public:
     DEFINE_MOCK0(policy_context, issue_new_backup_unlocked)
     DEFINE_MOCK0(policy_context, continue_current_backup_unlocked)
     DEFINE_MOCK1(policy_context, start_backup_app_meta_unlocked, int32_t)
+    DEFINE_MOCK1(policy_context, start_backup_partition_unlocked, gpid)
     DEFINE_MOCK1(policy_context, finish_backup_app_unlocked, int32_t)
     DEFINE_MOCK2(policy_context, write_backup_app_finish_flag_unlocked, int32_t, dsn::task_ptr)
 
@@ -537,6 +543,97 @@ TEST_F(policy_context_test, test_app_dropped_during_backup)
     }
 }
 
+TEST_F(policy_context_test, test_incremental_backup_chain)
+{
+    bool old_enabled = FLAGS_cold_backup_incremental_enabled;
+    uint32_t old_max_incremental_count = FLAGS_cold_backup_max_incremental_count;
+    FLAGS_cold_backup_incremental_enabled = true;
+    FLAGS_cold_backup_max_incremental_count = 2;
+
+    zauto_lock l(_mp._lock);
+    _mp._backup_history.clear();
+    backup_info bi;
+    _mp.choose_prev_backup_unlocked(bi);
+    ASSERT_EQ(0, bi.prev_backup_id);
+
+    // 100(full) <- 200 <- 300, then 400 is a full one
+    for (int64_t id = 100; id <= 400; id += 100) {
+        bi.backup_id = id;
+        _mp.choose_prev_backup_unlocked(bi);
+        if (id == 100 || id == 400) {
+            ASSERT_EQ(0, bi.prev_backup_id);
+            ASSERT_EQ(0, bi.base_backup_id);
+        } else {
+            ASSERT_EQ(id - 100, bi.prev_backup_id);
+            ASSERT_EQ(100, bi.base_backup_id);
+        }
+        _mp._backup_history.emplace(id, bi);
+    }
+
+    // keep the latest 2 backups: 300 still references the files of 100
+    _mp._policy.backup_history_count_to_keep = 2;
+    ASSERT_FALSE(_mp.is_backup_chain_expired_unlocked(_mp._backup_history.at(100)));
+    // keep only the latest one, the chain of 100 is out of retention as a whole
+    _mp._policy.backup_history_count_to_keep = 1;
+    ASSERT_TRUE(_mp.is_backup_chain_expired_unlocked(_mp._backup_history.at(100)));
+
+    _mp._backup_history.clear();
+    FLAGS_cold_backup_incremental_enabled = old_enabled;
+    FLAGS_cold_backup_max_incremental_count = old_max_incremental_count;
+}
+
+TEST_F(policy_context_test, test_bounded_partition_dispatch)
+{
+    uint32_t old_max_concurrent_partitions = FLAGS_cold_backup_max_concurrent_partitions;
+    FLAGS_cold_backup_max_concurrent_partitions = 3;
+
+    server_state *state = _service->get_server_state();
+    for (int32_t app_id : {1, 2}) {
+        dsn::app_info info;
+        info.is_stateful = true;
+        info.app_id = app_id;
+        info.app_type = "simple_kv";
+        info.max_replica_count = 3;
+        info.partition_count = 4;
+        info.status = dsn::app_status::AS_AVAILABLE;
+        state->_all_apps.emplace(info.app_id, app_state::create(info));
+    }
+
+    zauto_lock l(_mp._lock);
+    _mp.reset_records();
+    // the partitions are only recorded, but not really backed up
+    _mp.set_maxcall_start_backup_partition_unlocked(0);
+    _mp.prepare_current_backup_on_new_unlocked();
+
+    // the limit is shared by the apps of the policy
+    _mp.start_backup_app_partitions_unlocked(1);
+    _mp.start_backup_app_partitions_unlocked(2);
+    ASSERT_EQ(3, _mp.counter_start_backup_partition_unlocked());
+    ASSERT_EQ(3, _mp._progress.running_partitions.size());
+    ASSERT_EQ(5, _mp._progress.pending_partitions.size());
+
+    // an unfinished progress doesn't make room for the others
+    _mp.update_partition_progress_unlocked(gpid(1, 0), 500, dsn::rpc_address());
+    ASSERT_EQ(3, _mp.counter_start_backup_partition_unlocked());
+
+    // a finished partition is replaced by the next pending one
+    _mp.update_partition_progress_unlocked(
+        gpid(1, 0), cold_backup_constant::PROGRESS_FINISHED, dsn::rpc_address());
+    ASSERT_EQ(4, _mp.counter_start_backup_partition_unlocked());
+    ASSERT_EQ(3, _mp._progress.running_partitions.size());
+    ASSERT_EQ(1, _mp._progress.running_partitions.count(gpid(1, 3)));
+    ASSERT_EQ(4, _mp._progress.pending_partitions.size());
+
+    // a finished partition that is reported again is ignored
+    _mp.update_partition_progress_unlocked(
+        gpid(1, 0), cold_backup_constant::PROGRESS_FINISHED, dsn::rpc_address());
+    ASSERT_EQ(4, _mp.counter_start_backup_partition_unlocked());
+
+    _mp._progress.reset();
+    state->_all_apps.clear();
+    FLAGS_cold_backup_max_concurrent_partitions = old_max_concurrent_partitions;
+}
+
 TEST_F(policy_context_test, test_backup_failed)
 {
     fail::setup();
@@ -1,7 +1,15 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
 #include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
 
 #include "meta/meta_data.h"
+#include "meta/meta_service.h"
 #include "meta/server_load_balancer.h"
 #include "meta/greedy_load_balancer.h"
 #include "meta/test/misc/misc.h"
@@ -23,152 +31,187 @@ using namespace dsn::replication;
 #endif
 #define ASSERT_FALSE(exp) dassert(!(exp), "")
 
-class simple_priority_queue
+// Benchmarks a balancer end to end on a synthetic cluster, e.g.
+//
+//   sim_lb --nodes=300 --apps=200 --partitions=100000 --skew=1.0 --failures=3 --balancer=greedy
+//
+// the partitions are split among the apps by a zipf distribution of `skew`, and placed on the
+// nodes randomly. the replicas on the `failures` nodes are then moved to the other nodes, which
+// leaves them empty as if they were replaced. the balancer runs until it proposes nothing, each
+// round applying the proposals, and the time, proposals of every round and the peak memory are
+// reported.
+struct simulator_options
 {
-public:
-    simple_priority_queue(const std::vector<dsn::rpc_address> &nl,
-                          server_load_balancer::node_comparator &&compare)
-        : container(nl), cmp(std::move(compare))
-    {
-        std::make_heap(container.begin(), container.end(), cmp);
-    }
-    void push(const dsn::rpc_address &addr)
-    {
-        container.push_back(addr);
-        std::push_heap(container.begin(), container.end(), cmp);
-    }
-    dsn::rpc_address pop()
-    {
-        std::pop_heap(container.begin(), container.end(), cmp);
-        dsn::rpc_address result = container.back();
-        container.pop_back();
-        return result;
-    }
-    dsn::rpc_address top() const { return container.front(); }
-    bool empty() const { return container.empty(); }
-private:
-    std::vector<dsn::rpc_address> container;
-    server_load_balancer::node_comparator cmp;
+    int nodes = 100;
+    int apps = 10;
+    int partitions = 10000;
+    double skew = 0;
+    int failures = 0;
+    int disks_per_node = 8;
+    int max_rounds = 100000;
+    std::string balancer = "greedy";
 };
 
-void generate_balanced_apps(/*out*/ app_mapper &apps,
-                            node_mapper &nodes,
-                            const std::vector<dsn::rpc_address> &node_list)
+static bool parse_options(int argc, char **argv, /*out*/ simulator_options &opts)
 {
-    nodes.clear();
-    for (const auto &node : node_list)
-        nodes[node].set_alive(true);
-
-    int partitions_per_node = random32(20, 100);
-    dsn::app_info info;
-    info.status = dsn::app_status::AS_AVAILABLE;
-    info.is_stateful = true;
-    info.app_id = 1;
-    info.app_name = "test";
-    info.app_type = "test";
-    info.partition_count = partitions_per_node * node_list.size();
-    info.max_replica_count = 3;
-
-    std::shared_ptr<app_state> the_app = app_state::create(info);
-
-    simple_priority_queue pq1(node_list, server_load_balancer::primary_comparator(nodes));
-    // generate balanced primary
-    for (dsn::partition_configuration &pc : the_app->partitions) {
-        dsn::rpc_address n = pq1.pop();
-        nodes[n].put_partition(pc.pid, true);
-        pc.primary = n;
-        pq1.push(n);
-    }
-
-    // generate balanced secondary
-    simple_priority_queue pq2(node_list, server_load_balancer::partition_comparator(nodes));
-    std::vector<dsn::rpc_address> temp;
-
-    for (dsn::partition_configuration &pc : the_app->partitions) {
-        temp.clear();
-        while (pc.secondaries.size() + 1 < pc.max_replica_count) {
-            dsn::rpc_address n = pq2.pop();
-            if (!is_member(pc, n)) {
-                pc.secondaries.push_back(n);
-                nodes[n].put_partition(pc.pid, false);
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "nodes") {
+                opts.nodes = boost::lexical_cast<int>(value);
+            } else if (key == "apps") {
+                opts.apps = boost::lexical_cast<int>(value);
+            } else if (key == "partitions") {
+                opts.partitions = boost::lexical_cast<int>(value);
+            } else if (key == "skew") {
+                opts.skew = boost::lexical_cast<double>(value);
+            } else if (key == "failures") {
+                opts.failures = boost::lexical_cast<int>(value);
+            } else if (key == "disks_per_node") {
+                opts.disks_per_node = boost::lexical_cast<int>(value);
+            } else if (key == "max_rounds") {
+                opts.max_rounds = boost::lexical_cast<int>(value);
+            } else if (key == "balancer") {
+                opts.balancer = value;
+            } else {
+                return false;
             }
-            temp.push_back(n);
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
         }
-        for (auto n : temp)
-            pq2.push(n);
     }
+    return opts.nodes >= 3 && opts.apps > 0 && opts.partitions >= opts.apps &&
+           opts.failures >= 0 && opts.nodes - opts.failures >= 3 && opts.disks_per_node > 0;
+}
 
-    // check if balanced
-    int pri_min, part_min;
-    pri_min = part_min = the_app->partition_count + 1;
-    int pri_max, part_max;
-    pri_max = part_max = -1;
-
-    for (auto &kv : nodes) {
-        if (kv.second.primary_count() > pri_max)
-            pri_max = kv.second.primary_count();
-        if (kv.second.primary_count() < pri_min)
-            pri_min = kv.second.primary_count();
-        if (kv.second.partition_count() > part_max)
-            part_max = kv.second.partition_count();
-        if (kv.second.partition_count() < part_min)
-            part_min = kv.second.partition_count();
+static void generate_cluster(const simulator_options &opts,
+                             /*out*/ app_mapper &apps,
+                             /*out*/ node_mapper &nodes,
+                             /*out*/ nodes_fs_manager &manager)
+{
+    std::vector<dsn::rpc_address> node_list = generate_node_list(opts.nodes);
+    std::vector<dsn::rpc_address> survivors(node_list.begin() + opts.failures, node_list.end());
+
+    double weight_sum = 0;
+    for (int i = 1; i <= opts.apps; ++i) {
+        weight_sum += 1.0 / std::pow(i, opts.skew);
     }
 
-    apps.emplace(the_app->app_id, the_app);
+    apps.clear();
+    for (int i = 1; i <= opts.apps; ++i) {
+        dsn::app_info info;
+        info.status = dsn::app_status::AS_AVAILABLE;
+        info.app_id = i;
+        info.is_stateful = true;
+        info.app_name = "test_app" + boost::lexical_cast<std::string>(i);
+        info.app_type = "test";
+        info.max_replica_count = 3;
+        info.partition_count = std::max(
+            1, static_cast<int>(opts.partitions / std::pow(i, opts.skew) / weight_sum));
+        std::shared_ptr<app_state> app = app_state::create(info);
+        generate_app(app, node_list);
+
+        // the failed nodes are replaced by empty ones
+        for (dsn::partition_configuration &pc : app->partitions) {
+            auto replace = [&](dsn::rpc_address &addr) {
+                while (std::find(node_list.begin(), node_list.begin() + opts.failures, addr) !=
+                       node_list.begin() + opts.failures) {
+                    dsn::rpc_address target = survivors[random32(0, survivors.size() - 1)];
+                    if (!is_member(pc, target)) {
+                        addr = target;
+                    }
+                }
+            };
+            replace(pc.primary);
+            for (dsn::rpc_address &secondary : pc.secondaries) {
+                replace(secondary);
+            }
+        }
+        generate_app_serving_replica_info(app, opts.disks_per_node);
+        apps.emplace(app->app_id, app);
+    }
 
-    ASSERT_TRUE(pri_max - pri_min <= 1);
-    ASSERT_TRUE(part_max - part_min <= 1);
+    generate_node_mapper(nodes, apps, node_list);
+    generate_node_fs_manager(apps, nodes, manager, opts.disks_per_node);
 }
 
-void random_move_primary(app_mapper &apps, node_mapper &nodes, int primary_move_ratio)
+static long peak_memory_kb()
 {
-    app_state &the_app = *(apps[0]);
-    int space_size = the_app.partition_count * 100;
-    for (dsn::partition_configuration &pc : the_app.partitions) {
-        int n = random32(1, space_size) / 100;
-        if (n < primary_move_ratio) {
-            int indice = random32(0, 1);
-            nodes[pc.primary].remove_partition(pc.pid, true);
-            std::swap(pc.primary, pc.secondaries[indice]);
-            nodes[pc.primary].put_partition(pc.pid, true);
-        }
-    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
 }
 
-void greedy_balancer_perfect_move_primary()
+int main(int argc, char **argv)
 {
+    simulator_options opts;
+    if (!parse_options(argc, argv, opts)) {
+        fprintf(stderr,
+                "USAGE: %s [--nodes=N] [--apps=N] [--partitions=N] [--skew=F] [--failures=N] "
+                "[--disks_per_node=N] [--max_rounds=N] [--balancer=greedy|simple]\n",
+                argv[0]);
+        return 1;
+    }
+    dsn_run_config("config.ini", false);
+
+    meta_service svc;
+    std::unique_ptr<server_load_balancer> lb;
+    if (opts.balancer == "greedy") {
+        lb.reset(new greedy_load_balancer(&svc));
+    } else if (opts.balancer == "simple") {
+        lb.reset(new simple_load_balancer(&svc));
+    } else {
+        fprintf(stderr, "unknown balancer %s\n", opts.balancer.c_str());
+        return 1;
+    }
+
     app_mapper apps;
     node_mapper nodes;
-    std::vector<dsn::rpc_address> node_list;
-
-    generate_node_list(node_list, 20, 100);
-    generate_balanced_apps(apps, nodes, node_list);
+    nodes_fs_manager manager;
+    uint64_t start_us = dsn_now_us();
+    generate_cluster(opts, apps, nodes, manager);
+    printf("generated %d nodes, %d apps, %d partitions in %.3f s, peak memory %ld KB\n",
+           opts.nodes,
+           opts.apps,
+           count_partitions(apps),
+           (dsn_now_us() - start_us) / 1e6,
+           peak_memory_kb());
 
-    random_move_primary(apps, nodes, 70);
-    // test the greedy balancer's move primary
-    greedy_load_balancer glb(nullptr);
     migration_list ml;
-
-    glb.check({&apps, &nodes}, ml);
-    dinfo("balance checker operation count = %d", ml.size());
-    int i = 0;
-
-    while (glb.balance({&apps, &nodes}, ml)) {
-        for (const auto &kv : ml) {
-            const std::shared_ptr<configuration_balancer_request> &req = kv.second;
-            for (const configuration_proposal_action &act : req->action_list) {
-                ASSERT_TRUE(act.type != config_type::CT_ADD_SECONDARY_FOR_LB);
-            }
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    size_t total_proposals = 0;
+    int rounds = 0;
+    bool converged = false;
+    while (!converged && rounds < opts.max_rounds) {
+        start_us = dsn_now_us();
+        bool proposed = lb->balance({&apps, &nodes}, ml);
+        uint64_t round_us = dsn_now_us() - start_us;
+        total_us += round_us;
+        max_us = std::max(max_us, round_us);
+        printf("round %d: %.3f ms, %zu proposals\n", rounds++, round_us / 1e3, ml.size());
+        if (proposed) {
+            total_proposals += ml.size();
+            migration_check_and_apply(apps, nodes, ml, &manager);
+        } else {
+            converged = true;
         }
-        glb.check({&apps, &nodes}, ml);
-        dinfo("round %d: balance checker operation count = %d", ++i, ml.size());
     }
-}
 
-int main(int, char **)
-{
-    dsn_run_config("config.ini", false);
-    greedy_balancer_perfect_move_primary();
+    printf("%s: %s after %d rounds, %zu proposals, round time avg %.3f ms max %.3f ms, "
+           "peak memory %ld KB\n",
+           opts.balancer.c_str(),
+           converged ? "converged" : "not converged",
+           rounds,
+           total_proposals,
+           total_us / 1e3 / std::max(rounds, 1),
+           max_us / 1e3,
+           peak_memory_kb());
     return 0;
 }
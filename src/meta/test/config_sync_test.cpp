@@ -0,0 +1,162 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/smart_pointers.h>
+
+#include "meta_test_base.h"
+#include "meta/server_state.h"
+#include "meta/table_quota_allocator.h"
+#include <dsn/dist/replication/replica_envs.h>
+
+namespace dsn {
+namespace replication {
+
+class config_sync_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        create_app(NAME, PARTITION_COUNT);
+        app = find_app(NAME);
+
+        // the node serves partition 0 and 1 as primary
+        node_state node;
+        for (int i = 0; i < 2; ++i) {
+            app->partitions[i].primary = NODE;
+            app->partitions[i].ballot = BALLOT;
+            node.put_partition(gpid(app->app_id, i), true);
+        }
+        mock_node_state(NODE, node);
+    }
+
+    void TearDown() override
+    {
+        app.reset();
+        meta_test_base::TearDown();
+    }
+
+    configuration_query_by_node_response
+    on_config_sync(const std::map<int32_t, int64_t> *digests,
+                   const std::vector<partition_quota> *usages = nullptr)
+    {
+        auto request = make_unique<configuration_query_by_node_request>();
+        request->node = NODE;
+        request->__isset.stored_replicas = true;
+        for (int i = 0; i < 2; ++i) {
+            replica_info info;
+            info.pid = gpid(app->app_id, i);
+            info.status = partition_status::PS_PRIMARY;
+            // partition 1 is outdated on the node
+            info.ballot = (i == 0 ? BALLOT : BALLOT - 1);
+            request->stored_replicas.emplace_back(info);
+        }
+        if (digests != nullptr) {
+            request->__set_app_info_digests(*digests);
+        }
+        if (usages != nullptr) {
+            request->__set_quota_usages(*usages);
+        }
+
+        configuration_query_by_node_rpc rpc(std::move(request), RPC_CM_CONFIG_SYNC);
+        _ss->on_config_sync(rpc);
+        wait_all();
+        return rpc.response();
+    }
+
+    const std::string NAME = "config_sync_test";
+    const int32_t PARTITION_COUNT = 4;
+    const int64_t BALLOT = 3;
+    const rpc_address NODE = rpc_address("127.0.0.1", 10086);
+    std::shared_ptr<app_state> app;
+};
+
+TEST_F(config_sync_test, full_sync)
+{
+    auto resp = on_config_sync(nullptr);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(2, resp.partitions.size());
+    ASSERT_FALSE(resp.__isset.unchanged_partitions);
+}
+
+TEST_F(config_sync_test, delta_sync)
+{
+    std::map<int32_t, int64_t> digests;
+    digests[app->app_id] = app_info_digest(*app);
+    auto resp = on_config_sync(&digests);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(1, resp.partitions.size());
+    ASSERT_EQ(gpid(app->app_id, 1), resp.partitions[0].config.pid);
+    ASSERT_EQ(1, resp.unchanged_partitions.size());
+    ASSERT_EQ(gpid(app->app_id, 0), resp.unchanged_partitions[0]);
+
+    // the app info changed since the last sync
+    digests[app->app_id] = app_info_digest(*app) + 1;
+    resp = on_config_sync(&digests);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(2, resp.partitions.size());
+    ASSERT_TRUE(resp.unchanged_partitions.empty());
+}
+
+TEST_F(config_sync_test, quota_shares)
+{
+    // no quota on the table
+    std::vector<partition_quota> usages(2);
+    for (int i = 0; i < 2; ++i) {
+        usages[i].pid = gpid(app->app_id, i);
+    }
+    usages[0].write_qps = 300;
+    usages[1].write_qps = 100;
+    auto resp = on_config_sync(nullptr, &usages);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_TRUE(resp.__isset.quota_shares);
+    ASSERT_TRUE(resp.quota_shares.empty());
+
+    // 400 split by (usage + 400 / 4) / (400 + 400)
+    app->envs[replica_envs::WRITE_QPS_QUOTA] = "400";
+    resp = on_config_sync(nullptr, &usages);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(2, resp.quota_shares.size());
+    std::map<gpid, partition_quota> shares;
+    for (const auto &share : resp.quota_shares) {
+        shares[share.pid] = share;
+    }
+    ASSERT_EQ(200, shares[gpid(app->app_id, 0)].write_qps);
+    ASSERT_EQ(100, shares[gpid(app->app_id, 1)].write_qps);
+    ASSERT_EQ(0, shares[gpid(app->app_id, 0)].read_qps);
+
+    // not reported by the node
+    resp = on_config_sync(nullptr);
+    ASSERT_FALSE(resp.__isset.quota_shares);
+}
+
+TEST(table_quota_allocator_test, share)
+{
+    ASSERT_EQ(0, table_quota_allocator::share(0, 10, 10, 4));
+    // no usage, split evenly
+    ASSERT_EQ(25, table_quota_allocator::share(100, 0, 0, 4));
+    // usages of 200, 50, 25, 25 out of 300
+    ASSERT_EQ(56, table_quota_allocator::share(100, 200, 300, 4));
+    ASSERT_EQ(18, table_quota_allocator::share(100, 50, 300, 4));
+    ASSERT_EQ(12, table_quota_allocator::share(100, 25, 300, 4));
+    // an idle partition still gets a part
+    ASSERT_EQ(1, table_quota_allocator::share(4, 0, 1000000, 4));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,181 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "meta/meta_service.h"
+#include "meta/server_state.h"
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(partition_config_update_batch_max_count);
+
+// the partition config updates batched by server_state::update_configuration_on_remote, written
+// to meta_state_service_simple by flush_configuration_updates_on_remote
+class config_update_batch_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        _old_batch_max_count = FLAGS_partition_config_update_batch_max_count;
+
+        create_node(_root);
+        for (int i = 0; i < 3; ++i) {
+            create_node(path(i));
+        }
+    }
+
+    void TearDown() override
+    {
+        FLAGS_partition_config_update_batch_max_count = _old_batch_max_count;
+        meta_test_base::TearDown();
+    }
+
+    std::string path(int i) const { return _root + "/" + std::to_string(i); }
+
+    void create_node(const std::string &node)
+    {
+        _ms->get_remote_storage()->create_node(
+            node,
+            LPC_META_STATE_HIGH,
+            [](error_code ec) { ASSERT_EQ(ERR_OK, ec); },
+            blob::create_from_bytes(std::string("init")),
+            _ms->tracker());
+        wait_all();
+    }
+
+    std::string get_data(const std::string &node)
+    {
+        std::string data;
+        _ms->get_remote_storage()->get_data(node,
+                                            LPC_META_STATE_HIGH,
+                                            [&data](error_code ec, const blob &value) {
+                                                if (ec == ERR_OK) {
+                                                    data = value.to_string();
+                                                }
+                                            },
+                                            _ms->tracker());
+        wait_all();
+        return data;
+    }
+
+    // queues an update as update_configuration_on_remote does, whose result is recorded in
+    // _results once written
+    error_code_future_ptr add_update(const std::string &node, const std::string &value)
+    {
+        error_code_future_ptr callback(new error_code_future(
+            LPC_META_STATE_HIGH,
+            [this, node](error_code ec) {
+                zauto_lock l(_results_lock);
+                _results[node] = ec;
+            },
+            0));
+        callback->set_tracker(_ms->tracker());
+
+        zauto_lock l(_ss->_pending_configuration_updates_lock);
+        _ss->_pending_configuration_updates.push_back(
+            {node, blob::create_from_bytes(std::string(value)), callback});
+        return callback;
+    }
+
+    void flush()
+    {
+        _ss->flush_configuration_updates_on_remote();
+        _ss->wait_all_task();
+        wait_all();
+    }
+
+    // ERR_UNKNOWN if the update of `node` is not replied
+    error_code result_of(const std::string &node)
+    {
+        zauto_lock l(_results_lock);
+        auto iter = _results.find(node);
+        return iter == _results.end() ? ERR_UNKNOWN : iter->second;
+    }
+
+    const std::string _root{"/config_update_batch_test"};
+    uint32_t _old_batch_max_count;
+
+    zlock _results_lock;
+    std::map<std::string, error_code> _results;
+};
+
+TEST_F(config_update_batch_test, merge_updates_in_transaction)
+{
+    FLAGS_partition_config_update_batch_max_count = 8;
+    for (int i = 0; i < 3; ++i) {
+        add_update(path(i), "v" + std::to_string(i));
+    }
+    flush();
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(ERR_OK, result_of(path(i)));
+        ASSERT_EQ("v" + std::to_string(i), get_data(path(i)));
+    }
+
+    // the updates are split into transactions of at most 2, the last one is written alone and
+    // fails by itself
+    FLAGS_partition_config_update_batch_max_count = 2;
+    add_update(path(0), "w0");
+    add_update(path(1), "w1");
+    add_update(_root + "/missing", "w2");
+    flush();
+    ASSERT_EQ(ERR_OK, result_of(path(0)));
+    ASSERT_EQ(ERR_OK, result_of(path(1)));
+    ASSERT_EQ("w0", get_data(path(0)));
+    ASSERT_EQ("w1", get_data(path(1)));
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, result_of(_root + "/missing"));
+}
+
+TEST_F(config_update_batch_test, skip_cancelled_updates)
+{
+    FLAGS_partition_config_update_batch_max_count = 8;
+    add_update(path(0), "v0");
+    add_update(path(1), "v1")->cancel(false);
+    add_update(path(2), "v2");
+    flush();
+
+    ASSERT_EQ(ERR_OK, result_of(path(0)));
+    ASSERT_EQ(ERR_OK, result_of(path(2)));
+    ASSERT_EQ("v0", get_data(path(0)));
+    ASSERT_EQ("v2", get_data(path(2)));
+    // the cancelled update is neither written nor replied
+    ASSERT_EQ(ERR_UNKNOWN, result_of(path(1)));
+    ASSERT_EQ("init", get_data(path(1)));
+}
+
+TEST_F(config_update_batch_test, error_spreads_to_all_updates)
+{
+    FLAGS_partition_config_update_batch_max_count = 8;
+    add_update(path(0), "v0");
+    add_update(_root + "/missing", "v1");
+    add_update(path(2), "v2");
+    flush();
+
+    // the transaction fails as a whole, none of its updates is written
+    ASSERT_EQ(ERR_INCONSISTENT_STATE, result_of(path(0)));
+    ASSERT_EQ(ERR_INCONSISTENT_STATE, result_of(_root + "/missing"));
+    ASSERT_EQ(ERR_INCONSISTENT_STATE, result_of(path(2)));
+    ASSERT_EQ("init", get_data(path(0)));
+    ASSERT_EQ("init", get_data(path(2)));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,151 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "meta_test_base.h"
+#include "meta/server_state.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(config_watch_max_count);
+
+class config_watch_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        create_app(APP_NAME, 4);
+        _app = find_app(APP_NAME);
+    }
+
+    configuration_watch_app_rpc watch(int32_t expire_ms)
+    {
+        auto request = make_unique<configuration_watch_app_request>();
+        request->app_name = APP_NAME;
+        request->app_id = _app->app_id;
+        request->expire_ms = expire_ms;
+        for (const auto &pc : _app->partitions) {
+            request->known_ballots.push_back(pc.ballot);
+        }
+        configuration_watch_app_rpc rpc(std::move(request), RPC_CM_WATCH_APP_CONFIGURATION);
+        _ss->watch_app_configuration(rpc);
+        return rpc;
+    }
+
+    size_t held_watch_count()
+    {
+        zauto_lock l(_ss->_config_watches_lock);
+        return _ss->_config_watch_count;
+    }
+
+    const std::string APP_NAME = "config_watch_test";
+    std::shared_ptr<app_state> _app;
+};
+
+TEST_F(config_watch_test, reply_at_once_if_newer)
+{
+    auto request = make_unique<configuration_watch_app_request>();
+    request->app_name = APP_NAME;
+    request->app_id = _app->app_id;
+    request->expire_ms = 10000;
+    request->known_ballots.assign(_app->partition_count, -1);
+    configuration_watch_app_rpc rpc(std::move(request), RPC_CM_WATCH_APP_CONFIGURATION);
+    _ss->watch_app_configuration(rpc);
+
+    ASSERT_EQ(0, held_watch_count());
+    ASSERT_EQ(ERR_OK, rpc.response().err);
+    ASSERT_EQ(_app->partition_count, rpc.response().partitions.size());
+}
+
+TEST_F(config_watch_test, hold_and_notify)
+{
+    auto rpc = watch(10000);
+    ASSERT_EQ(1, held_watch_count());
+
+    // a newer ballot of partition 1 wakes the watch up
+    _app->partitions[1].ballot++;
+    _ss->refresh_query_view(_app);
+    ASSERT_EQ(0, held_watch_count());
+    _ss->wait_all_task();
+
+    ASSERT_EQ(ERR_OK, rpc.response().err);
+    ASSERT_EQ(1, rpc.response().partitions.size());
+    ASSERT_EQ(_app->partitions[1], rpc.response().partitions[0]);
+}
+
+TEST_F(config_watch_test, reply_all_if_app_changed)
+{
+    auto request = make_unique<configuration_watch_app_request>();
+    request->app_name = APP_NAME;
+    request->app_id = _app->app_id;
+    request->expire_ms = 10000;
+    // the app was split from 2 partitions
+    request->known_ballots.assign(2, 0);
+    configuration_watch_app_rpc rpc(std::move(request), RPC_CM_WATCH_APP_CONFIGURATION);
+    _ss->watch_app_configuration(rpc);
+
+    ASSERT_EQ(0, held_watch_count());
+    ASSERT_EQ(ERR_OK, rpc.response().err);
+    ASSERT_EQ(_app->partition_count, rpc.response().partition_count);
+    ASSERT_EQ(_app->partition_count, rpc.response().partitions.size());
+}
+
+TEST_F(config_watch_test, expire)
+{
+    auto rpc = watch(100);
+    ASSERT_EQ(1, held_watch_count());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    _ss->wait_all_task();
+
+    // an expired watch is replied with no partition
+    ASSERT_EQ(0, held_watch_count());
+    ASSERT_EQ(ERR_OK, rpc.response().err);
+    ASSERT_EQ(_app->app_id, rpc.response().app_id);
+    ASSERT_TRUE(rpc.response().partitions.empty());
+
+    // a change after the expiration isn't replied again
+    _app->partitions[1].ballot++;
+    _ss->refresh_query_view(_app);
+    _ss->wait_all_task();
+    ASSERT_TRUE(rpc.response().partitions.empty());
+}
+
+TEST_F(config_watch_test, max_count)
+{
+    auto old_max_count = FLAGS_config_watch_max_count;
+    FLAGS_config_watch_max_count = 1;
+
+    auto rpc1 = watch(10000);
+    auto rpc2 = watch(10000);
+    ASSERT_EQ(1, held_watch_count());
+    ASSERT_EQ(ERR_BUSY, rpc2.response().err);
+
+    _app->partitions[0].ballot++;
+    _ss->refresh_query_view(_app);
+    _ss->wait_all_task();
+    ASSERT_EQ(1, rpc1.response().partitions.size());
+
+    FLAGS_config_watch_max_count = old_max_count;
+}
+
+} // namespace replication
+} // namespace dsn
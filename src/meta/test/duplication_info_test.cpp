@@ -42,27 +42,55 @@ public:
         ASSERT_FALSE(dup.alter_progress(1, 5));
 
         dup.init_progress(1, invalid_decree);
+        dup.init_progress(2, 3);
         ASSERT_TRUE(dup.alter_progress(1, 5));
         ASSERT_EQ(dup._progress[1].volatile_decree, 5);
+        ASSERT_FALSE(dup._progress[1].is_altering);
+        // stale progress
+        ASSERT_FALSE(dup.alter_progress(2, 3));
+        ASSERT_TRUE(dup.alter_progress(2, 4));
+
+        // the changed partitions are persisted in a batch
+        auto updates = dup.progress_to_persist();
+        ASSERT_EQ(updates.size(), 2);
+        ASSERT_EQ(updates[0].partition_index, 1);
+        ASSERT_EQ(updates[0].confirmed, 5);
+        ASSERT_FALSE(updates[0].is_stored);
+        ASSERT_EQ(updates[1].partition_index, 2);
+        ASSERT_EQ(updates[1].confirmed, 4);
+        ASSERT_TRUE(updates[1].is_stored);
         ASSERT_TRUE(dup._progress[1].is_altering);
 
-        // busy updating
-        ASSERT_FALSE(dup.alter_progress(1, 10));
-        ASSERT_EQ(dup._progress[1].volatile_decree, 5);
-        ASSERT_TRUE(dup._progress[1].is_altering);
+        // the progress keeps fresh in memory while it's being persisted
+        ASSERT_TRUE(dup.alter_progress(1, 10));
+        ASSERT_EQ(dup._progress[1].volatile_decree, 10);
 
-        dup.persist_progress(1);
+        dup.persist_progress(1, 5);
+        dup.persist_progress(2, 4);
         ASSERT_EQ(dup._progress[1].stored_decree, 5);
         ASSERT_FALSE(dup._progress[1].is_altering);
 
         // too frequent to update
-        ASSERT_FALSE(dup.alter_progress(1, 10));
+        ASSERT_TRUE(dup.progress_to_persist().empty());
         ASSERT_FALSE(dup._progress[1].is_altering);
 
-        dup._progress[1].last_progress_update_ms -=
-            duplication_info::PROGRESS_UPDATE_PERIOD_MS + 100;
-        ASSERT_TRUE(dup.alter_progress(1, 15));
+        dup._last_progress_update_ms -= duplication_info::PROGRESS_UPDATE_PERIOD_MS + 100;
+        updates = dup.progress_to_persist();
+        ASSERT_EQ(updates.size(), 1);
+        ASSERT_EQ(updates[0].partition_index, 1);
+        ASSERT_EQ(updates[0].confirmed, 10);
+        ASSERT_TRUE(updates[0].is_stored);
         ASSERT_TRUE(dup._progress[1].is_altering);
+
+        // several partitions are altered at once, of which the stale ones are ignored
+        duplication_info dup2(
+            2, 1, 4, 0, "dsn://slave-cluster/temp", "/meta_test/101/duplication/2");
+        dup2.init_progress(1, 5);
+        dup2.init_progress(2, 5);
+        ASSERT_FALSE(dup2.alter_progress({{1, 5}, {2, 4}, {3, 1}}));
+        ASSERT_TRUE(dup2.alter_progress({{1, 4}, {2, 6}, {3, 1}}));
+        ASSERT_EQ(dup2._progress[1].volatile_decree, 5);
+        ASSERT_EQ(dup2._progress[2].volatile_decree, 6);
     }
 
     static void test_init_and_start()
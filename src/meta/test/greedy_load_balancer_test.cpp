@@ -0,0 +1,259 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "meta/greedy_load_balancer.h"
+#include "meta/server_state.h"
+#include "meta/test/misc/misc.h"
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+DSN_DECLARE_bool(balancer_load_aware_enabled);
+DSN_DECLARE_uint32(balancer_full_round_interval);
+DSN_DECLARE_uint32(balancer_load_max_moves_per_round);
+DSN_DECLARE_uint32(partition_usage_expire_seconds);
+
+class greedy_load_balancer_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        _origin_load_aware_enabled = FLAGS_balancer_load_aware_enabled;
+        _origin_max_moves_per_round = FLAGS_balancer_load_max_moves_per_round;
+        _origin_full_round_interval = FLAGS_balancer_full_round_interval;
+        FLAGS_balancer_load_aware_enabled = true;
+        FLAGS_balancer_load_max_moves_per_round = 1;
+
+        // a table of 4 partitions on the 3 alive nodes, the first node has 2 primaries and the
+        // others have 1, which is balanced by the counts
+        _node_list = generate_node_list(4);
+        app_info info;
+        info.app_id = 1;
+        info.app_name = "test";
+        info.app_type = "simple_kv";
+        info.partition_count = 4;
+        info.max_replica_count = 3;
+        info.is_stateful = true;
+        info.status = app_status::AS_AVAILABLE;
+        auto app = app_state::create(info);
+        const int primary_nodes[] = {0, 0, 1, 2};
+        for (int i = 0; i < info.partition_count; ++i) {
+            partition_configuration &pc = app->partitions[i];
+            pc.primary = _node_list[primary_nodes[i]];
+            for (int j = 0; j < 3; ++j) {
+                if (j != primary_nodes[i]) {
+                    pc.secondaries.push_back(_node_list[j]);
+                }
+            }
+        }
+        _apps[info.app_id] = app;
+        generate_node_mapper(_nodes, _apps, _node_list);
+        // the last node is dead and has no replicas
+        _nodes[_node_list[3]].set_alive(false);
+    }
+
+    void TearDown() override
+    {
+        FLAGS_balancer_load_aware_enabled = _origin_load_aware_enabled;
+        FLAGS_balancer_load_max_moves_per_round = _origin_max_moves_per_round;
+        FLAGS_balancer_full_round_interval = _origin_full_round_interval;
+        meta_test_base::TearDown();
+    }
+
+    // the qps reported by the partitions of the table
+    void report_usages(const std::vector<int64_t> &qps, uint64_t report_ms = dsn_now_ms())
+    {
+        std::vector<partition_quota> usages(qps.size());
+        for (size_t i = 0; i < qps.size(); ++i) {
+            usages[i].pid = gpid(1, i);
+            usages[i].read_qps = qps[i];
+        }
+        _ss->_quota_allocator.update_usages(usages, report_ms);
+    }
+
+    migration_list move_primary_by_load()
+    {
+        greedy_load_balancer balancer(_ms.get());
+        migration_list ml;
+        meta_view view = {&_apps, &_nodes};
+        balancer.t_global_view = &view;
+        balancer.t_migration_result = &ml;
+        balancer.t_alive_nodes = 3;
+        balancer.move_primary_by_load();
+        return ml;
+    }
+
+    // takes the dead node out of _nodes, and collects the replica infos of the alive ones
+    void prepare_greedy_balancer()
+    {
+        _nodes.erase(_node_list[3]);
+        generate_app_serving_replica_info(_apps[1], 2);
+    }
+
+    // runs a round of the primary and secondary balancers on the nodes in _nodes, returns the
+    // count of the apps skipped by them
+    int64_t run_greedy_balancer(greedy_load_balancer &balancer)
+    {
+        migration_list ml;
+        meta_view view = {&_apps, &_nodes};
+        balancer.t_global_view = &view;
+        balancer.t_migration_result = &ml;
+        balancer.t_alive_nodes = static_cast<int>(_nodes.size());
+        balancer._recent_balance_skipped_app_count->get_integer_value();
+        balancer.greedy_balancer(false);
+        return balancer._recent_balance_skipped_app_count->get_integer_value();
+    }
+
+    static bool is_primary_balanced(const greedy_load_balancer &balancer, app_id id)
+    {
+        return balancer._primary_balanced_apps.count(id) > 0;
+    }
+
+    std::vector<rpc_address> _node_list;
+    app_mapper _apps;
+    node_mapper _nodes;
+
+private:
+    bool _origin_load_aware_enabled;
+    uint32_t _origin_max_moves_per_round;
+    uint32_t _origin_full_round_interval;
+};
+
+TEST_F(greedy_load_balancer_test, move_primary_off_hot_node)
+{
+    // the 2 primaries of the first node take almost all the load
+    report_usages({1000, 1000, 10, 10});
+    migration_list ml = move_primary_by_load();
+    ASSERT_EQ(1, ml.size());
+
+    const auto &request = ml.begin()->second;
+    ASSERT_LT(request->gpid.get_partition_index(), 2);
+    ASSERT_EQ(balancer_request_type::move_primary, request->balance_type);
+    ASSERT_EQ(2, request->action_list.size());
+    ASSERT_EQ(_node_list[0], request->action_list[0].node);
+    ASSERT_EQ(config_type::CT_DOWNGRADE_TO_SECONDARY, request->action_list[0].type);
+    ASSERT_NE(_node_list[0], request->action_list[1].node);
+    ASSERT_NE(_node_list[3], request->action_list[1].node);
+    ASSERT_EQ(config_type::CT_UPGRADE_TO_PRIMARY, request->action_list[1].type);
+}
+
+TEST_F(greedy_load_balancer_test, max_moves_per_round)
+{
+    FLAGS_balancer_load_max_moves_per_round = 2;
+    report_usages({1000, 1000, 10, 10});
+    migration_list ml = move_primary_by_load();
+    // one primary moves off the first node, then its target is the hottest one, which can only
+    // move its small primary to the third node
+    ASSERT_EQ(2, ml.size());
+    for (const auto &kv : ml) {
+        ASSERT_NE(_node_list[0], kv.second->action_list[1].node);
+    }
+}
+
+TEST_F(greedy_load_balancer_test, no_move_if_no_gain)
+{
+    // the first node is over the average, but moving any of its primaries makes it worse
+    report_usages({100, 100, 100, 100});
+    ASSERT_TRUE(move_primary_by_load().empty());
+}
+
+TEST_F(greedy_load_balancer_test, dead_node_not_in_average)
+{
+    // the load of the first node is 600, which is under 120% of the average of the alive nodes
+    // (1520 / 3), but over that of all the nodes (1520 / 4)
+    report_usages({500, 100, 460, 460});
+    ASSERT_TRUE(move_primary_by_load().empty());
+}
+
+TEST_F(greedy_load_balancer_test, expired_usages)
+{
+    report_usages({1000, 1000, 10, 10},
+                  dsn_now_ms() - (FLAGS_partition_usage_expire_seconds + 1) * 1000);
+    ASSERT_TRUE(move_primary_by_load().empty());
+
+    // only the unexpired usages count
+    report_usages({1000, 1000});
+    ASSERT_EQ(1, move_primary_by_load().size());
+}
+
+TEST_F(greedy_load_balancer_test, disabled)
+{
+    FLAGS_balancer_load_aware_enabled = false;
+    report_usages({1000, 1000, 10, 10});
+    ASSERT_TRUE(move_primary_by_load().empty());
+}
+
+TEST_F(greedy_load_balancer_test, skip_unchanged_app)
+{
+    FLAGS_balancer_full_round_interval = 100;
+    prepare_greedy_balancer();
+    greedy_load_balancer balancer(_ms.get());
+
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_TRUE(is_primary_balanced(balancer, 1));
+
+    // skipped by both the primary and the secondary balancer
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+}
+
+TEST_F(greedy_load_balancer_test, evaluate_changed_app)
+{
+    FLAGS_balancer_full_round_interval = 100;
+    prepare_greedy_balancer();
+    greedy_load_balancer balancer(_ms.get());
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+
+    // the configuration of a partition changes
+    _apps[1]->partitions[0].ballot++;
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+
+    // a node joins, which has none of the primaries
+    node_state &ns = _nodes[_node_list[3]];
+    ns.set_addr(_node_list[3]);
+    ns.set_alive(true);
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+}
+
+TEST_F(greedy_load_balancer_test, full_round_clears_balanced_apps)
+{
+    FLAGS_balancer_full_round_interval = 3;
+    prepare_greedy_balancer();
+    greedy_load_balancer balancer(_ms.get());
+
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+    // the third round is a full one
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_TRUE(is_primary_balanced(balancer, 1));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+    ASSERT_EQ(2, run_greedy_balancer(balancer));
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+
+    // the apps are always evaluated with 0
+    FLAGS_balancer_full_round_interval = 0;
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+    ASSERT_EQ(0, run_greedy_balancer(balancer));
+}
+} // namespace replication
+} // namespace dsn
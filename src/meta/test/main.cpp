@@ -50,6 +50,11 @@ TEST(meta, state_sync) { g_app->state_sync_test(); }
 
 TEST(meta, update_configuration) { g_app->update_configuration_test(); }
 
+TEST(meta, update_configuration_with_bulk_downgrade)
+{
+    g_app->update_configuration_test(true);
+}
+
 TEST(meta, balancer_validator) { g_app->balancer_validator(); }
 
 TEST(meta, apply_balancer) { g_app->apply_balancer_test(); }
@@ -15,8 +15,10 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <dsn/service_api_c.h>
+#include <dsn/utility/flags.h>
 
 #include "meta_service_test_app.h"
 #include "meta_test_base.h"
@@ -24,6 +26,9 @@
 
 namespace dsn {
 namespace replication {
+
+DSN_DECLARE_uint32(create_partition_nodes_batch_size);
+
 class meta_app_operation_test : public meta_test_base
 {
 public:
@@ -76,6 +81,23 @@ public:
         return recall_response.err;
     }
 
+    std::vector<std::string> get_partition_nodes(const std::string &app_name)
+    {
+        std::vector<std::string> nodes;
+        _ms->get_remote_storage()
+            ->get_children(_ss->get_app_path(*find_app(app_name)),
+                           LPC_META_CALLBACK,
+                           [&nodes](error_code ec, const std::vector<std::string> &children) {
+                               ASSERT_EQ(ec, ERR_OK);
+                               nodes = children;
+                           })
+            ->wait();
+        std::sort(nodes.begin(), nodes.end(), [](const std::string &l, const std::string &r) {
+            return std::stoi(l) < std::stoi(r);
+        });
+        return nodes;
+    }
+
     void update_app_status(app_status::type status)
     {
         auto app = find_app(APP_NAME);
@@ -142,6 +164,29 @@ TEST_F(meta_app_operation_test, create_app)
     }
 }
 
+TEST_F(meta_app_operation_test, create_app_in_batches)
+{
+    uint32_t old_batch_size = FLAGS_create_partition_nodes_batch_size;
+    // the partition nodes are created one by one, in a single transaction, and in several
+    // transactions of which the last one is partial
+    uint32_t batch_sizes[] = {1, 64, 3};
+    const int32_t partition_count = 16;
+    for (uint32_t batch_size : batch_sizes) {
+        FLAGS_create_partition_nodes_batch_size = batch_size;
+        std::string app_name = "create_in_batches_" + std::to_string(batch_size);
+        create_app(app_name, partition_count);
+
+        auto app = find_app(app_name);
+        ASSERT_EQ(app->status, app_status::AS_AVAILABLE);
+        std::vector<std::string> nodes = get_partition_nodes(app_name);
+        ASSERT_EQ(nodes.size(), partition_count);
+        for (int32_t i = 0; i < partition_count; ++i) {
+            ASSERT_EQ(nodes[i], std::to_string(i));
+        }
+    }
+    FLAGS_create_partition_nodes_batch_size = old_batch_size;
+}
+
 TEST_F(meta_app_operation_test, drop_app)
 {
     create_app(APP_NAME);
@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #include "meta_test_base.h"
 #include "meta_service_test_app.h"
@@ -27,6 +28,10 @@
 
 namespace dsn {
 namespace replication {
+
+DSN_DECLARE_uint32(bulk_load_max_downloading_partitions);
+DSN_DECLARE_uint32(bulk_load_max_downloading_partitions_per_disk);
+
 class bulk_load_service_test : public meta_test_base
 {
 public:
@@ -132,6 +137,24 @@ public:
         bulk_svc().reset_local_bulk_load_states(app_id, app_name);
     }
 
+    bool try_acquire_download_slot(const gpid &pid,
+                                   const std::map<rpc_address, std::string> &locations)
+    {
+        return bulk_svc().try_acquire_download_slot(pid, locations);
+    }
+
+    bool has_download_slot()
+    {
+        return !bulk_svc()._partitions_download_slot.empty() ||
+               !bulk_svc()._nodes_downloading_count.empty() ||
+               !bulk_svc()._disks_downloading_count.empty();
+    }
+
+    void set_partition_bulk_load_status(const gpid &pid, bulk_load_status::type status)
+    {
+        bulk_svc()._partition_bulk_load_info[pid].status = status;
+    }
+
     int32_t get_app_in_process_count(int32_t app_id)
     {
         return bulk_svc()._apps_in_progress_count[app_id];
@@ -391,6 +414,36 @@ TEST_F(bulk_load_service_test, query_bulk_load_status_success)
     ASSERT_EQ(query_bulk_load(APP_NAME), ERR_OK);
 }
 
+TEST_F(bulk_load_service_test, download_slot_test)
+{
+    uint32_t old_max_partitions = FLAGS_bulk_load_max_downloading_partitions;
+    uint32_t old_max_partitions_per_disk = FLAGS_bulk_load_max_downloading_partitions_per_disk;
+    FLAGS_bulk_load_max_downloading_partitions = 2;
+    FLAGS_bulk_load_max_downloading_partitions_per_disk = 1;
+
+    const int32_t app_id = 1;
+    mock_meta_bulk_load_context(app_id, 4, bulk_load_status::BLS_DOWNLOADING);
+    rpc_address node1("127.0.0.1", 10086), node2("127.0.0.1", 10087);
+    ASSERT_TRUE(try_acquire_download_slot(gpid(app_id, 0), {{node1, "ssd1"}, {node2, "ssd1"}}));
+    // acquired slot is kept
+    ASSERT_TRUE(try_acquire_download_slot(gpid(app_id, 0), {{node1, "ssd1"}, {node2, "ssd1"}}));
+    // disk ssd1 of node1 is busy
+    ASSERT_FALSE(try_acquire_download_slot(gpid(app_id, 1), {{node1, "ssd1"}, {node2, "ssd3"}}));
+    ASSERT_TRUE(try_acquire_download_slot(gpid(app_id, 2), {{node1, "ssd2"}, {node2, "ssd2"}}));
+    // cluster budget is used up
+    ASSERT_FALSE(try_acquire_download_slot(gpid(app_id, 3), {{node1, "ssd4"}, {node2, "ssd4"}}));
+
+    // partition 0 finishes downloading, its slot is released
+    set_partition_bulk_load_status(gpid(app_id, 0), bulk_load_status::BLS_DOWNLOADED);
+    ASSERT_TRUE(try_acquire_download_slot(gpid(app_id, 0), {{node1, "ssd1"}, {node2, "ssd1"}}));
+    ASSERT_TRUE(try_acquire_download_slot(gpid(app_id, 1), {{node1, "ssd1"}, {node2, "ssd3"}}));
+
+    reset_local_bulk_load_states(app_id, APP_NAME);
+    ASSERT_FALSE(has_download_slot());
+    FLAGS_bulk_load_max_downloading_partitions = old_max_partitions;
+    FLAGS_bulk_load_max_downloading_partitions_per_disk = old_max_partitions_per_disk;
+}
+
 /// bulk load process unit tests
 class bulk_load_process_test : public bulk_load_service_test
 {
@@ -1,8 +1,15 @@
 #include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
 #include "meta/meta_data.h"
 
 using namespace dsn::replication;
 
+namespace dsn {
+namespace replication {
+DSN_DECLARE_bool(partition_configuration_binary_encoding);
+} // namespace replication
+} // namespace dsn
+
 TEST(meta_data, dropped_cmp)
 {
     dsn::rpc_address n;
@@ -48,3 +55,101 @@ TEST(meta_data, dropped_cmp)
         ASSERT_TRUE(dropped_cmp(d2, d1) == 0);
     }
 }
+
+TEST(meta_data, partition_configuration_encoding)
+{
+    dsn::partition_configuration pc;
+    pc.pid = dsn::gpid(3, 5);
+    pc.ballot = 7;
+    pc.max_replica_count = 3;
+    pc.primary = dsn::rpc_address("127.0.0.1", 34801);
+    pc.secondaries = {dsn::rpc_address("127.0.0.2", 34801), dsn::rpc_address("127.0.0.3", 34801)};
+    pc.last_drops = {dsn::rpc_address("127.0.0.4", 34801)};
+    pc.last_committed_decree = 100;
+    pc.partition_flags = 0;
+
+    bool old_value = FLAGS_partition_configuration_binary_encoding;
+    for (bool binary : {false, true}) {
+        FLAGS_partition_configuration_binary_encoding = binary;
+        dsn::blob value = encode_partition_configuration(pc);
+        ASSERT_EQ(!binary, value.data()[0] == '{');
+
+        dsn::partition_configuration decoded;
+        ASSERT_TRUE(decode_partition_configuration(value, decoded));
+        ASSERT_EQ(pc.pid, decoded.pid);
+        ASSERT_EQ(pc.ballot, decoded.ballot);
+        ASSERT_EQ(pc.primary, decoded.primary);
+        ASSERT_EQ(pc.secondaries, decoded.secondaries);
+        ASSERT_EQ(pc.last_drops, decoded.last_drops);
+        ASSERT_EQ(pc.last_committed_decree, decoded.last_committed_decree);
+    }
+    FLAGS_partition_configuration_binary_encoding = old_value;
+
+    dsn::partition_configuration decoded;
+    ASSERT_FALSE(decode_partition_configuration(dsn::blob::create_from_bytes("\x0c\x00"), decoded));
+}
+
+TEST(meta_data, place_read_replicas)
+{
+    dsn::partition_configuration pc;
+    pc.pid = dsn::gpid(3, 5);
+    pc.primary = dsn::rpc_address("127.0.0.1", 34801);
+    pc.secondaries = {dsn::rpc_address("127.0.0.2", 34801), dsn::rpc_address("127.0.0.3", 34801)};
+
+    node_mapper nodes;
+    for (int i = 1; i <= 8; ++i) {
+        dsn::rpc_address addr("127.0.0." + std::to_string(i), 34801);
+        nodes[addr].set_alive(true);
+    }
+
+    std::vector<dsn::rpc_address> result = place_read_replicas(pc, nodes, 2);
+    ASSERT_EQ(2, result.size());
+    for (const dsn::rpc_address &addr : result) {
+        ASSERT_FALSE(is_member(pc, addr));
+    }
+    ASSERT_EQ(5, place_read_replicas(pc, nodes, 10).size());
+    ASSERT_TRUE(place_read_replicas(pc, nodes, 0).empty());
+
+    // only the read replica on the dead node moves
+    nodes[result[1]].set_alive(false);
+    std::vector<dsn::rpc_address> moved = place_read_replicas(pc, nodes, 2);
+    ASSERT_EQ(2, moved.size());
+    ASSERT_EQ(result[0], moved[0]);
+    ASSERT_NE(result[1], moved[1]);
+}
+
+TEST(meta_data, partition_set)
+{
+    partition_set ps;
+    ASSERT_TRUE(ps.empty());
+    ASSERT_TRUE(ps.begin() == ps.end());
+
+    int indexes[] = {200, 0, 64, 63};
+    for (int index : indexes) {
+        ASSERT_TRUE(ps.insert(dsn::gpid(1, index)));
+    }
+    ASSERT_FALSE(ps.insert(dsn::gpid(1, 63)));
+    ASSERT_EQ(4, ps.size());
+    ASSERT_EQ(1, ps.count(dsn::gpid(1, 64)));
+    ASSERT_EQ(0, ps.count(dsn::gpid(1, 65)));
+    ASSERT_EQ(0, ps.count(dsn::gpid(1, 1000)));
+
+    // iterated in the order of partition index
+    std::vector<dsn::gpid> pids;
+    for (const dsn::gpid &pid : ps) {
+        pids.push_back(pid);
+    }
+    std::vector<dsn::gpid> expected = {
+        dsn::gpid(1, 0), dsn::gpid(1, 63), dsn::gpid(1, 64), dsn::gpid(1, 200)};
+    ASSERT_EQ(expected, pids);
+
+    ASSERT_EQ(1, ps.erase(dsn::gpid(1, 63)));
+    ASSERT_EQ(0, ps.erase(dsn::gpid(1, 63)));
+    ASSERT_EQ(0, ps.erase(dsn::gpid(1, 1000)));
+    ASSERT_EQ(3, ps.size());
+    for (int index : {0, 64, 200}) {
+        ASSERT_EQ(1, ps.erase(dsn::gpid(1, index)));
+    }
+    ASSERT_TRUE(ps.empty());
+    ASSERT_TRUE(ps.begin() == ps.end());
+}
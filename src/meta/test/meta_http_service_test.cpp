@@ -65,6 +65,51 @@ public:
         ASSERT_EQ(fake_resp.body, fake_json);
     }
 
+    void test_query_recovery()
+    {
+        http_request fake_req;
+        http_response fake_resp;
+        _mhs->query_recovery_handler(fake_req, fake_resp);
+
+        ASSERT_EQ(fake_resp.status_code, http_status_code::ok)
+            << http_status_code_to_string(fake_resp.status_code);
+        std::string fake_json = R"({"stage":"idle","total_nodes":"0","queried_nodes":"0",)"
+                                R"("failed_nodes":"0","elapsed_ms":"0"})"
+                                "\n";
+        ASSERT_EQ(fake_resp.body, fake_json);
+    }
+
+    void test_list_apps_by_page()
+    {
+        create_app(test_app + "_2");
+
+        http_request fake_req;
+        http_response fake_resp;
+        fake_req.query_args.emplace("name_prefix", test_app);
+        fake_req.query_args.emplace("limit", "1");
+        _mhs->list_app_handler(fake_req, fake_resp);
+        ASSERT_EQ(fake_resp.status_code, http_status_code::ok)
+            << http_status_code_to_string(fake_resp.status_code);
+        ASSERT_NE(fake_resp.body.find(R"("app_name":")" + test_app + R"(")"), std::string::npos);
+        ASSERT_EQ(fake_resp.body.find(test_app + "_2"), std::string::npos);
+        ASSERT_NE(fake_resp.body.find(R"("total_app_count":"1","next_start_app_id":"3")"),
+                  std::string::npos);
+
+        fake_req.query_args.clear();
+        fake_resp = http_response();
+        fake_req.query_args.emplace("start_app_id", "3");
+        _mhs->list_app_handler(fake_req, fake_resp);
+        ASSERT_EQ(fake_resp.status_code, http_status_code::ok);
+        ASSERT_NE(fake_resp.body.find(test_app + "_2"), std::string::npos);
+        ASSERT_NE(fake_resp.body.find(R"("total_app_count":"1"})"), std::string::npos);
+
+        fake_req.query_args.clear();
+        fake_resp = http_response();
+        fake_req.query_args.emplace("limit", "x");
+        _mhs->list_app_handler(fake_req, fake_resp);
+        ASSERT_EQ(fake_resp.status_code, http_status_code::bad_request);
+    }
+
     std::unique_ptr<meta_http_service> _mhs;
     std::string test_app = "test_meta_http";
 };
@@ -142,6 +187,10 @@ TEST_F(meta_http_service_test, get_app_from_primary) { test_get_app_from_primary
 
 TEST_F(meta_http_service_test, get_app_envs) { test_get_app_envs(); }
 
+TEST_F(meta_http_service_test, list_apps_by_page) { test_list_apps_by_page(); }
+
+TEST_F(meta_http_service_test, query_recovery) { test_query_recovery(); }
+
 TEST_F(meta_backup_test_base, get_backup_policy)
 {
     struct http_backup_policy_test
@@ -0,0 +1,134 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+class meta_node_drain_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        create_app(APP_NAME, PARTITION_COUNT);
+        _app = find_app(APP_NAME);
+
+        // every primary is on the node to drain, and the other two nodes serve the secondaries
+        for (int i = 0; i < 3; ++i) {
+            node_state ns;
+            ns.set_addr(node(i));
+            ns.set_alive(true);
+            mock_node_state(node(i), ns);
+        }
+        for (int i = 0; i < PARTITION_COUNT; ++i) {
+            partition_configuration &pc = _app->partitions[i];
+            pc.primary = node(0);
+            pc.secondaries = {node(1), node(2)};
+            pc.ballot = 1;
+            _ss->_nodes[node(0)].put_partition(pc.pid, true);
+            _ss->_nodes[node(1)].put_partition(pc.pid, false);
+            _ss->_nodes[node(2)].put_partition(pc.pid, false);
+        }
+    }
+
+    static rpc_address node(int i) { return rpc_address("127.0.0.1", 34800 + i); }
+
+    std::string drain_node(const std::vector<std::string> &args)
+    {
+        return _ss->remote_command_drain_node(args);
+    }
+
+    void drain_step()
+    {
+        zauto_write_lock l(_ss->_lock);
+        _ss->drain_node_step(node(0), _ss->_draining_nodes[node(0)]);
+    }
+
+    const std::map<gpid, rpc_address> &moving() { return _ss->_draining_nodes[node(0)].moving; }
+
+    bool drained() { return _ss->_draining_nodes[node(0)].drained; }
+
+    // apply the proposed moves as if the replica servers had done them
+    void finish_moves()
+    {
+        for (const auto &kv : moving()) {
+            partition_configuration &pc = _app->partitions[kv.first.get_partition_index()];
+            pc.secondaries.erase(
+                std::find(pc.secondaries.begin(), pc.secondaries.end(), kv.second));
+            pc.secondaries.push_back(node(0));
+            pc.primary = kv.second;
+            ++pc.ballot;
+            _ss->_nodes[node(0)].remove_partition(kv.first, true);
+            _ss->_nodes[kv.second].put_partition(kv.first, true);
+            _app->helpers->contexts[kv.first.get_partition_index()].lb_actions.clear();
+        }
+    }
+
+    const std::string APP_NAME = "node_drain_test";
+    const int PARTITION_COUNT = 8;
+    std::shared_ptr<app_state> _app;
+};
+
+TEST_F(meta_node_drain_test, invalid_arguments)
+{
+    ASSERT_NE("OK", drain_node({}));
+    ASSERT_NE("OK", drain_node({"start"}));
+    ASSERT_NE("OK", drain_node({"start", "invalid_address"}));
+    ASSERT_NE("OK", drain_node({"start", node(0).to_std_string(), "0"}));
+    ASSERT_NE("OK", drain_node({"start", node(10).to_std_string()}));
+    ASSERT_NE("OK", drain_node({"cancel", node(0).to_std_string()}));
+    ASSERT_NE("OK", drain_node({"unknown", node(0).to_std_string()}));
+}
+
+TEST_F(meta_node_drain_test, drain)
+{
+    ASSERT_EQ("OK", drain_node({"start", node(0).to_std_string(), "2"}));
+    ASSERT_NE("OK", drain_node({"start", node(0).to_std_string()}));
+
+    int rounds = 0;
+    while (!drained()) {
+        // each destination takes at most 2 primaries at the same time
+        ASSERT_EQ(4, moving().size());
+        std::map<rpc_address, int> per_destination;
+        for (const auto &kv : moving()) {
+            ++per_destination[kv.second];
+            const config_context &cc = _app->helpers->contexts[kv.first.get_partition_index()];
+            ASSERT_FALSE(cc.lb_actions.empty());
+        }
+        ASSERT_EQ(2, per_destination[node(1)]);
+        ASSERT_EQ(2, per_destination[node(2)]);
+
+        finish_moves();
+        drain_step();
+        ++rounds;
+    }
+    ASSERT_EQ(2, rounds);
+    ASSERT_EQ(0, _ss->_nodes[node(0)].primary_count());
+    ASSERT_TRUE(moving().empty());
+    ASSERT_NE(std::string::npos, drain_node({"status"}).find("drained"));
+
+    ASSERT_EQ("OK", drain_node({"cancel", node(0).to_std_string()}));
+    ASSERT_TRUE(_ss->_draining_nodes.empty());
+}
+
+} // namespace replication
+} // namespace dsn
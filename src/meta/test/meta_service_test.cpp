@@ -4,6 +4,7 @@
 
 #include "meta_test_base.h"
 #include "meta/meta_service.h"
+#include "meta/meta_server_failure_detector.h"
 
 #include <dsn/utility/fail_point.h>
 
@@ -62,6 +63,22 @@ public:
         fail::teardown();
     }
 
+    void release_leader_lock()
+    {
+        meta_server_failure_detector *fd = _ms->_failure_detector.get();
+        fd->acquire_leader_lock();
+        ASSERT_TRUE(fd->get_leader(nullptr));
+
+        fd->release_leader_lock();
+        rpc_address leader;
+        ASSERT_FALSE(fd->get_leader(&leader));
+        ASSERT_TRUE(leader.is_invalid());
+
+        // released only once
+        fd->release_leader_lock();
+        ASSERT_FALSE(fd->get_leader(nullptr));
+    }
+
 private:
     app_env_rpc create_fake_rpc()
     {
@@ -78,5 +95,7 @@ TEST_F(meta_service_test, check_status_failure) { check_status_failure(); }
 
 TEST_F(meta_service_test, check_status_success) { check_status_success(); }
 
+TEST_F(meta_service_test, release_leader_lock) { release_leader_lock(); }
+
 } // namespace replication
 } // namespace dsn
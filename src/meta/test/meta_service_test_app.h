@@ -104,7 +104,7 @@ public:
     virtual dsn::error_code start(const std::vector<std::string> &args) override;
     virtual dsn::error_code stop(bool /*cleanup*/) { return dsn::ERR_OK; }
     void state_sync_test();
-    void update_configuration_test();
+    void update_configuration_test(bool bulk_downgrade_on_node_dead = false);
     void balancer_validator();
     void balance_config_file();
     void apply_balancer_test();
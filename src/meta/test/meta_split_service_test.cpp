@@ -28,6 +28,7 @@
 #include <dsn/service_api_c.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replica_envs.h>
+#include <dsn/utility/flags.h>
 
 #include "meta_service_test_app.h"
 #include "meta_test_base.h"
@@ -36,6 +37,9 @@
 
 namespace dsn {
 namespace replication {
+DSN_DECLARE_uint32(partition_usage_expire_seconds);
+DSN_DECLARE_uint32(auto_split_max_consecutive_count);
+
 class meta_split_service_test : public meta_test_base
 {
 public:
@@ -95,7 +99,7 @@ public:
         return rpc.response().err;
     }
 
-    error_code register_child(int32_t parent_index, ballot req_parent_ballot, bool wait_zk)
+    register_child_rpc make_register_child_rpc(int32_t parent_index, ballot req_parent_ballot)
     {
         partition_configuration parent_config;
         parent_config.ballot = req_parent_ballot;
@@ -120,7 +124,12 @@ public:
         request->child_config = child_config;
         request->primary_address = NODE;
 
-        register_child_rpc rpc(std::move(request), RPC_CM_REGISTER_CHILD_REPLICA);
+        return register_child_rpc(std::move(request), RPC_CM_REGISTER_CHILD_REPLICA);
+    }
+
+    error_code register_child(int32_t parent_index, ballot req_parent_ballot, bool wait_zk)
+    {
+        auto rpc = make_register_child_rpc(parent_index, req_parent_ballot);
         split_svc().register_child_on_meta(rpc);
         wait_all();
         if (wait_zk) {
@@ -192,6 +201,23 @@ public:
         }
     }
 
+    // report the usages of all the partitions, the first `hot_count` of them are hot
+    void report_usages(int32_t hot_count, uint64_t report_ms)
+    {
+        std::vector<partition_quota> usages(app->partition_count);
+        for (int32_t i = 0; i < app->partition_count; ++i) {
+            usages[i].pid = gpid(app->app_id, i);
+            usages[i].write_qps = i < hot_count ? 15000 : 100;
+            usages[i].read_qps = i < hot_count ? 10000 : 100;
+        }
+        _ss->_quota_allocator.update_usages(usages, report_ms);
+    }
+
+    meta_split_service::auto_split_history &auto_split_history()
+    {
+        return split_svc()._auto_split_histories[app->app_id];
+    }
+
     void clear_app_partition_split_context()
     {
         app->partition_count = PARTITION_COUNT;
@@ -455,6 +481,29 @@ TEST_F(meta_split_service_test, register_child_test)
     }
 }
 
+TEST_F(meta_split_service_test, register_children_in_batch_test)
+{
+    mock_app_partition_split_context();
+
+    // the registrations come together are written in one transaction
+    std::vector<register_child_rpc> rpcs;
+    for (int32_t i = 0; i < PARTITION_COUNT; ++i) {
+        rpcs.emplace_back(make_register_child_rpc(i, PARENT_BALLOT));
+        split_svc().register_child_on_meta(rpcs.back());
+        ASSERT_EQ(ERR_IO_PENDING, rpcs.back().response().err);
+        ASSERT_EQ(config_status::pending_remote_sync, app->helpers->contexts[i].stage);
+    }
+    wait_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int32_t i = 0; i < PARTITION_COUNT; ++i) {
+        ASSERT_EQ(ERR_OK, rpcs[i].response().err);
+        ASSERT_EQ(config_status::not_pending, app->helpers->contexts[i].stage);
+        ASSERT_EQ(PARENT_BALLOT + 1, app->partitions[i + PARTITION_COUNT].ballot);
+    }
+    ASSERT_EQ(0, app->helpers->split_states.splitting_count);
+}
+
 // config sync unit tests
 TEST_F(meta_split_service_test, on_config_sync_test)
 {
@@ -797,6 +846,60 @@ TEST_F(meta_split_service_test, query_child_state_test)
     }
 }
 
+TEST_F(meta_split_service_test, auto_split_test)
+{
+    // no usage reported
+    std::string reason;
+    ASSERT_FALSE(split_svc().should_auto_split(*app, reason));
+
+    // a single hot partition
+    report_usages(1, dsn_now_ms());
+    ASSERT_FALSE(split_svc().should_auto_split(*app, reason));
+
+    // the usages expire if not reported again
+    report_usages(2, dsn_now_ms() - (FLAGS_partition_usage_expire_seconds + 1) * 1000);
+    ASSERT_FALSE(split_svc().should_auto_split(*app, reason));
+
+    // half of the partitions are hot
+    report_usages(2, dsn_now_ms());
+    ASSERT_TRUE(split_svc().should_auto_split(*app, reason));
+
+    split_svc().check_auto_split();
+    wait_all();
+    ASSERT_EQ(NEW_PARTITION_COUNT, app->partition_count);
+    ASSERT_TRUE(app->splitting());
+    ASSERT_FALSE(split_svc().should_auto_split(*app, reason));
+    ASSERT_EQ(1, auto_split_history().consecutive_count);
+}
+
+TEST_F(meta_split_service_test, auto_split_max_consecutive_count_test)
+{
+    report_usages(PARTITION_COUNT, dsn_now_ms());
+    auto &history = auto_split_history();
+    history.last_split_ms = 0;
+    history.consecutive_count = FLAGS_auto_split_max_consecutive_count;
+
+    // split too many times in a row
+    split_svc().check_auto_split();
+    wait_all();
+    ASSERT_EQ(PARTITION_COUNT, app->partition_count);
+    ASSERT_FALSE(app->splitting());
+    ASSERT_EQ(FLAGS_auto_split_max_consecutive_count, auto_split_history().consecutive_count);
+
+    // the load goes down, so the count is reset
+    report_usages(0, dsn_now_ms());
+    split_svc().check_auto_split();
+    wait_all();
+    ASSERT_EQ(0, split_svc()._auto_split_histories.count(app->app_id));
+
+    // split again once the load goes up
+    report_usages(PARTITION_COUNT, dsn_now_ms());
+    split_svc().check_auto_split();
+    wait_all();
+    ASSERT_EQ(NEW_PARTITION_COUNT, app->partition_count);
+    ASSERT_EQ(1, auto_split_history().consecutive_count);
+}
+
 class meta_split_service_failover_test : public meta_split_service_test
 {
 public:
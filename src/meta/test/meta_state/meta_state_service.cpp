@@ -1,4 +1,7 @@
 #include <dsn/dist/meta_state_service.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/synchronize.h>
 #include <boost/lexical_cast.hpp>
 
 #include <gtest/gtest.h>
@@ -6,11 +9,19 @@
 #include <thread>
 
 #include "meta/meta_state_service_simple.h"
+#include "meta/meta_state_service_versioned.h"
 #include "meta/meta_state_service_zookeeper.h"
 
 using namespace dsn;
 using namespace dsn::dist;
 
+namespace dsn {
+namespace dist {
+DSN_DECLARE_uint64(meta_state_service_simple_log_compact_threshold_mb);
+DSN_DECLARE_uint32(read_cache_capacity);
+} // namespace dist
+} // namespace dsn
+
 DEFINE_TASK_CODE(META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, TASK_PRIORITY_HIGH, THREAD_POOL_DEFAULT);
 
 typedef std::function<meta_state_service *()> service_creator_func;
@@ -261,6 +272,140 @@ TEST(meta_state_service, simple)
     provider_recursively_create_delete_test(simple_service_creator, simple_service_deleter);
 }
 
+TEST(meta_state_service, simple_log_compaction)
+{
+    uint64_t old_threshold = FLAGS_meta_state_service_simple_log_compact_threshold_mb;
+    FLAGS_meta_state_service_simple_log_compact_threshold_mb = 1;
+
+    std::string work_dir = "./meta_state_service_simple_compaction";
+    utils::filesystem::remove_path(work_dir);
+    ASSERT_TRUE(utils::filesystem::create_directory(work_dir));
+    std::string log_path = utils::filesystem::path_combine(work_dir, "meta_state_service.log");
+
+    auto expect_ok = [](error_code ec) { EXPECT_EQ(ERR_OK, ec); };
+    std::string value(100 * 1024, 'x');
+    meta_state_service_simple *service = new meta_state_service_simple();
+    ASSERT_EQ(ERR_OK, service->initialize({work_dir}));
+    service->create_node("/c", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    service->create_node("/c/1", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    // about 3MB are logged, which are compacted to the latest value every 1MB
+    for (int i = 0; i < 30; ++i) {
+        value[0] = static_cast<char>('a' + i % 26);
+        service
+            ->set_data("/c/1",
+                       blob::create_from_bytes(std::string(value)),
+                       META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                       expect_ok)
+            ->wait();
+    }
+    service->create_node("/c/2", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    delete service;
+
+    int64_t log_size = 0;
+    ASSERT_TRUE(utils::filesystem::file_size(log_path, log_size));
+    ASSERT_LT(log_size, 2 << 20);
+
+    // the state is recovered from the compacted log
+    service = new meta_state_service_simple();
+    ASSERT_EQ(ERR_OK, service->initialize({work_dir}));
+    service
+        ->get_data("/c/1",
+                   META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                   [&value](error_code ec, const blob &data) {
+                       ASSERT_EQ(ERR_OK, ec);
+                       ASSERT_EQ(value, data.to_string());
+                   })
+        ->wait();
+    service->node_exist("/c/2", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    delete service;
+
+    utils::filesystem::remove_path(work_dir);
+    FLAGS_meta_state_service_simple_log_compact_threshold_mb = old_threshold;
+}
+
+TEST(meta_state_service, versioned)
+{
+    auto inner = std::make_shared<meta_state_service_simple>();
+    ASSERT_EQ(ERR_OK, inner->initialize({}));
+    meta_state_service_versioned service(inner, "/versioned/apps", "/versioned/apps_version");
+
+    auto expect_ok = [](error_code ec) { EXPECT_EQ(ERR_OK, ec); };
+    auto expect_err = [](error_code ec) { EXPECT_NE(ERR_OK, ec); };
+    auto get_version = [&service]() {
+        std::string version;
+        service
+            .get_data("/versioned/apps_version",
+                      META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                      [&version](error_code ec, const blob &value) {
+                          ASSERT_EQ(ERR_OK, ec);
+                          version = value.to_string();
+                      })
+            ->wait();
+        return version;
+    };
+
+    service.create_node("/versioned", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    ASSERT_EQ(ERR_OK, service.renew_version());
+    std::string version = get_version();
+    ASSERT_FALSE(version.empty());
+
+    // the writes out of the apps don't change the version
+    service.create_node("/versioned/other", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    service.create_node("/versioned/apps_x", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    ASSERT_EQ(version, get_version());
+
+    // every write under the apps changes it
+    service.create_node("/versioned/apps", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    ASSERT_NE(version, get_version());
+    version = get_version();
+    service
+        .set_data("/versioned/apps",
+                  blob::create_from_bytes(std::string("data")),
+                  META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                  expect_ok)
+        ->wait();
+    ASSERT_NE(version, get_version());
+    version = get_version();
+
+    auto entries = service.new_transaction_entries(2);
+    ASSERT_EQ(ERR_OK, entries->create_node("/versioned/apps/1"));
+    ASSERT_EQ(ERR_OK, entries->create_node("/versioned/apps/1/0"));
+    service.submit_transaction(entries, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    ASSERT_EQ(ERR_OK, entries->get_result(0));
+    ASSERT_EQ(ERR_OK, entries->get_result(1));
+    ASSERT_NE(version, get_version());
+    version = get_version();
+
+    // a failed write doesn't change it
+    service
+        .create_node("/versioned/apps/1", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_err)
+        ->wait();
+    ASSERT_EQ(version, get_version());
+
+    utils::notify_event deleted;
+    service.delete_node("/versioned/apps",
+                        true,
+                        META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                        [&deleted](error_code ec) {
+                            EXPECT_EQ(ERR_OK, ec);
+                            deleted.notify();
+                        });
+    deleted.wait();
+    service.node_exist("/versioned/apps", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_err)
+        ->wait();
+    std::string new_version = get_version();
+    ASSERT_FALSE(new_version.empty());
+    ASSERT_NE(version, new_version);
+
+    inner->delete_node("/versioned", true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+}
+
 TEST(meta_state_service, zookeeper)
 {
     auto zookeeper_service_creator = [] {
@@ -275,3 +420,76 @@ TEST(meta_state_service, zookeeper)
     provider_basic_test(zookeeper_service_creator, zookeeper_service_deleter);
     provider_recursively_create_delete_test(zookeeper_service_creator, zookeeper_service_deleter);
 }
+
+TEST(meta_state_service, zookeeper_read_cache)
+{
+    FLAGS_read_cache_capacity = 16;
+    meta_state_service_zookeeper *svc = new meta_state_service_zookeeper();
+    ASSERT_EQ(ERR_OK, svc->initialize({}));
+
+    auto expect_value = [svc](const std::string &node,
+                              error_code expected_ec,
+                              const std::string &expected_value) {
+        svc->get_data(node,
+                      META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                      [&](error_code ec, const blob &value) {
+                          EXPECT_EQ(expected_ec, ec);
+                          if (ec == ERR_OK) {
+                              EXPECT_EQ(expected_value, value.to_string());
+                          }
+                      })
+            ->wait();
+    };
+
+    svc->create_node("/read_cache",
+                     META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                     expect_ok,
+                     blob::create_from_bytes(std::string("a")))
+        ->wait();
+    // the second read is served by the cache
+    expect_value("/read_cache", ERR_OK, "a");
+    expect_value("/read_cache", ERR_OK, "a");
+
+    // the cached value is dropped by the writes
+    svc->set_data("/read_cache",
+                  blob::create_from_bytes(std::string("b")),
+                  META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                  expect_ok)
+        ->wait();
+    expect_value("/read_cache", ERR_OK, "b");
+    expect_value("/read_cache", ERR_OK, "b");
+
+    svc->delete_node("/read_cache", false, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    expect_value("/read_cache", ERR_OBJECT_NOT_FOUND, "");
+
+    // the nodes beyond the capacity are neither watched nor cached, but still read right
+    FLAGS_read_cache_capacity = 2;
+    const int node_count = 5;
+    for (int i = 0; i < node_count; ++i) {
+        svc->create_node("/read_cache_" + std::to_string(i),
+                         META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                         expect_ok,
+                         blob::create_from_bytes(std::to_string(i)))
+            ->wait();
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < node_count; ++i) {
+            expect_value("/read_cache_" + std::to_string(i), ERR_OK, std::to_string(i));
+        }
+    }
+    for (int i = 0; i < node_count; ++i) {
+        const std::string node = "/read_cache_" + std::to_string(i);
+        svc->set_data(node,
+                      blob::create_from_bytes(std::to_string(i * 10)),
+                      META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                      expect_ok)
+            ->wait();
+        expect_value(node, ERR_OK, std::to_string(i * 10));
+        svc->delete_node(node, false, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+        expect_value(node, ERR_OBJECT_NOT_FOUND, "");
+    }
+
+    ASSERT_EQ(ERR_OK, svc->finalize());
+    FLAGS_read_cache_capacity = 0;
+}
@@ -250,6 +250,33 @@ void meta_service_test_app::state_sync_test()
         for (int i = 1; i <= 3; ++i)
             ASSERT_EQ(resp.partitions[i - 1], app_created->partitions[i]);
 
+        // 2.1.1 the serialized response is cached
+        dsn::blob data, cached_data;
+        ASSERT_TRUE(ss2->query_configuration_by_index_serialized(req, DSF_THRIFT_BINARY, data));
+        ASSERT_TRUE(
+            ss2->query_configuration_by_index_serialized(req, DSF_THRIFT_BINARY, cached_data));
+        ASSERT_EQ(data.data(), cached_data.data());
+        dsn::configuration_query_by_index_response serialized_resp;
+        dsn::binary_reader reader(data);
+        dsn::unmarshall(reader, serialized_resp, DSF_THRIFT_BINARY);
+        ASSERT_EQ(dsn::ERR_OK, serialized_resp.err);
+        ASSERT_EQ(15, serialized_resp.app_id);
+        ASSERT_EQ(resp.partitions, serialized_resp.partitions);
+
+        // 2.1.2 a watch is replied with the partitions newer than it knows
+        dsn::configuration_watch_app_request watch_req;
+        dsn::configuration_query_by_index_response watch_resp;
+        watch_req.app_name = "test_app15";
+        watch_req.app_id = 15;
+        for (const dsn::partition_configuration &config : app_created->partitions)
+            watch_req.known_ballots.push_back(config.ballot);
+        ASSERT_FALSE(ss2->fill_watch_response(watch_req, watch_resp));
+        watch_req.known_ballots[1] -= 1;
+        ASSERT_TRUE(ss2->fill_watch_response(watch_req, watch_resp));
+        ASSERT_EQ(dsn::ERR_OK, watch_resp.err);
+        ASSERT_EQ(1, watch_resp.partitions.size());
+        ASSERT_EQ(app_created->partitions[1], watch_resp.partitions[0]);
+
         // 2.2 no exist app
         req.app_name = "make_no_sense";
         ss2->query_configuration_by_index(req, resp);
@@ -263,19 +290,24 @@ void meta_service_test_app::state_sync_test()
         ASSERT_EQ(dsn::ERR_OK, resp.err);
 
         app->status = dsn::app_status::AS_DROPPING;
+        ss2->refresh_query_view(app);
+        ASSERT_FALSE(ss2->query_configuration_by_index_serialized(req, DSF_THRIFT_BINARY, data));
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_DROPPING, resp.err);
 
         app->status = dsn::app_status::AS_RECALLING;
+        ss2->refresh_query_view(app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_CREATING, resp.err);
 
         app->status = dsn::app_status::AS_CREATING;
+        ss2->refresh_query_view(app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_CREATING, resp.err);
 
         // client unknown state
         app->status = dsn::app_status::AS_DROP_FAILED;
+        ss2->refresh_query_view(app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_UNKNOWN, resp.err);
     }
@@ -3,6 +3,8 @@
 #include <dsn/service_api_c.h>
 #include <dsn/service_api_cpp.h>
 #include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 
 #include "meta/meta_service.h"
 #include "meta/server_state.h"
@@ -15,6 +17,8 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(bulk_downgrade_on_node_dead_enabled);
+
 class fake_sender_meta_service : public dsn::replication::meta_service
 {
 private:
@@ -172,8 +176,14 @@ bool meta_service_test_app::wait_state(server_state *ss, const state_validator &
     return false;
 }
 
-void meta_service_test_app::update_configuration_test()
+void meta_service_test_app::update_configuration_test(bool bulk_downgrade_on_node_dead)
 {
+    // the primaries on the dead node are downgraded and cured in the same way in bulk
+    bool old_bulk_downgrade = FLAGS_bulk_downgrade_on_node_dead_enabled;
+    FLAGS_bulk_downgrade_on_node_dead_enabled = bulk_downgrade_on_node_dead;
+    auto cleanup = dsn::defer(
+        [old_bulk_downgrade]() { FLAGS_bulk_downgrade_on_node_dead_enabled = old_bulk_downgrade; });
+
     dsn::error_code ec;
     std::shared_ptr<fake_sender_meta_service> svc(new fake_sender_meta_service(this));
     svc->_failure_detector.reset(new dsn::replication::meta_server_failure_detector(svc.get()));
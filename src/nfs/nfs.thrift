@@ -12,6 +12,8 @@ struct copy_request
     6: i32 size;
     7: bool is_last;
     8: bool overwrite;
+    // traffic class of the copy, served under its own rate budget of the source disk
+    9: optional bool high_priority;
 }
 
 struct copy_response
@@ -29,6 +31,8 @@ struct get_file_size_request
     3: list<string> file_list;
     4: string source_dir;
     5: bool overwrite;
+    // whether to return the md5 of the files, to resume the copies of them
+    6: optional bool with_md5;
 }
 
 struct get_file_size_response
@@ -36,4 +40,6 @@ struct get_file_size_response
     1: i32 error;
     2: list<string> file_list;
     3: list<i64> size_list;
+    // the md5 of each file, present if with_md5 is requested
+    4: optional list<string> md5_list;
 }
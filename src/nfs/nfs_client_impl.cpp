@@ -35,6 +35,8 @@
 #include <dsn/utility/filesystem.h>
 #include <queue>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/smart_pointers.h>
 #include "nfs_client_impl.h"
 
 namespace dsn {
@@ -45,6 +47,11 @@ DSN_DEFINE_uint32("nfs",
                   nfs_copy_block_bytes,
                   4 * 1024 * 1024,
                   "max block size (bytes) for each network copy");
+DSN_DEFINE_bool("nfs",
+                nfs_copy_resume_enabled,
+                true,
+                "whether a failed copy is resumed by a later one from the chunks copied before, "
+                "which has the source calculate the md5 of each file to copy");
 DSN_DEFINE_int32("nfs", max_copy_rate_megabytes, 500, "max rate of copying from remote node(MB/s)");
 DSN_DEFINE_int32("nfs",
                  max_concurrent_remote_copy_requests,
@@ -73,6 +80,11 @@ DSN_DEFINE_int32("nfs",
                  max_retry_count_per_copy_request,
                  2,
                  "maximum retry count when copy failed");
+DSN_DEFINE_int32("nfs",
+                 max_concurrent_copy_requests_per_source,
+                 0,
+                 "max concurrent remote copy requests of a copy task to each of its source nodes, "
+                 "0 means unlimited");
 DSN_DEFINE_int32("nfs",
                  rpc_timeout_ms,
                  10000,
@@ -113,6 +125,9 @@ nfs_client_impl::nfs_client_impl()
     _copy_token_bucket.reset(new TokenBucket(max_copy_rate_bytes, 1.5 * max_copy_rate_bytes));
     current_max_copy_rate_megabytes = FLAGS_max_copy_rate_megabytes;
 
+    // the files are written for the learners in the background
+    task_spec::set_default_disk_io_priority(LPC_NFS_WRITE, DIO_PRIORITY_LOW);
+
     register_cli_commands();
 }
 
@@ -132,8 +147,13 @@ void nfs_client_impl::begin_remote_copy(std::shared_ptr<remote_copy_request> &rc
     req->file_size_req.file_list = rci->files;
     req->file_size_req.source_dir = rci->source_dir;
     req->file_size_req.overwrite = rci->overwrite;
+    req->file_size_req.__set_with_md5(FLAGS_nfs_copy_resume_enabled);
     req->nfs_task = nfs_task;
     req->is_finished = false;
+    req->sources.emplace_back(rci->source, rci->source_dir);
+    for (const auto &source : rci->alternate_sources) {
+        req->sources.emplace_back(source.first, source.second);
+    }
 
     async_nfs_get_file_size(req->file_size_req,
                             [=](error_code err, get_file_size_response &&resp) {
@@ -166,6 +186,15 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
         return;
     }
 
+    // the chunks copied before are verified by reading the local files
+    tasking::enqueue(
+        LPC_NFS_COPY_FILE, &_tracker, [this, resp, ureq]() { init_copy_requests(resp, ureq); });
+}
+
+void nfs_client_impl::init_copy_requests(const ::dsn::service::get_file_size_response &resp,
+                                         const user_request_ptr &ureq)
+{
+    bool with_md5 = resp.__isset.md5_list && resp.md5_list.size() == resp.size_list.size();
     std::deque<copy_request_ex_ptr> copy_requests;
     ureq->file_contexts.resize(resp.size_list.size());
     for (size_t i = 0; i < resp.size_list.size(); i++) // file list
@@ -173,6 +202,23 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
         file_context_ptr filec(new file_context(ureq, resp.file_list[i], resp.size_list[i]));
         ureq->file_contexts[i] = filec;
 
+        std::map<int, uint32_t> copied;
+        if (with_md5) {
+            std::string file_path = dsn::utils::filesystem::path_combine(
+                ureq->file_size_req.dst_dir, filec->file_name);
+            copied = nfs_copy_progress::load(
+                file_path, filec->file_size, FLAGS_nfs_copy_block_bytes, resp.md5_list[i]);
+            filec->progress = dsn::make_unique<nfs_copy_progress>();
+            if (!filec->progress->start(file_path,
+                                        filec->file_size,
+                                        FLAGS_nfs_copy_block_bytes,
+                                        resp.md5_list[i],
+                                        copied)) {
+                filec->progress.reset();
+                copied.clear();
+            }
+        }
+
         // init copy requests
         uint64_t size = resp.size_list[i];
         uint64_t req_offset = 0;
@@ -190,7 +236,13 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
             req->is_last = (size <= req_size);
 
             filec->copy_requests.push_back(req);
-            copy_requests.push_back(req);
+            if (copied.count(req->index) > 0) {
+                req->is_copied = true;
+                req->is_ready_for_write = true;
+                ++filec->finished_segments;
+            } else {
+                copy_requests.push_back(req);
+            }
 
             req_offset += req_size;
             size -= req_size;
@@ -202,6 +254,29 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
             req_size = size > FLAGS_nfs_copy_block_bytes ? FLAGS_nfs_copy_block_bytes
                                                          : static_cast<uint32_t>(size);
         }
+
+        // the writes go on from the first chunk not copied
+        while (filec->current_write_index + 1 < (int)filec->copy_requests.size() &&
+               filec->copy_requests[filec->current_write_index + 1]->is_copied) {
+            filec->current_write_index++;
+        }
+        if (!copied.empty()) {
+            ddebug("{nfs_service} resume copying file %s to %s, copied_chunks = %d/%d",
+                   filec->file_name.c_str(),
+                   ureq->file_size_req.dst_dir.c_str(),
+                   filec->finished_segments,
+                   (int)filec->copy_requests.size());
+        }
+        if (filec->finished_segments == (int)filec->copy_requests.size()) {
+            ++ureq->finished_files;
+        }
+    }
+
+    if (copy_requests.empty() && !ureq->file_contexts.empty() &&
+        ureq->finished_files == (int)ureq->file_contexts.size()) {
+        // all the files have been copied before
+        handle_completion(ureq, ERR_OK);
+        return;
     }
 
     if (!copy_requests.empty()) {
@@ -265,22 +340,40 @@ void nfs_client_impl::continue_copy()
             }
         }
 
+        req->source_index = acquire_copy_source(req->file_ctx->user_req);
+        if (req->source_index < 0) {
+            // all sources are busy, put it back and wait for end_copy() to trigger again
+            --req->file_ctx->user_req->concurrent_copy_count;
+            --_concurrent_copy_request_count;
+            zauto_lock l(_copy_requests_lock);
+            if (req->file_ctx->user_req->high_priority) {
+                _copy_requests_high.push_front(req);
+            } else {
+                _copy_requests_low.push_retry(req);
+            }
+            break;
+        }
+
+        bool sent = false;
         {
             zauto_lock l(req->lock);
             const user_request_ptr &ureq = req->file_ctx->user_req;
+            const copy_source &source = ureq->sources[req->source_index];
             if (req->is_valid) {
+                sent = true;
                 // todo(jiashuo1) use non-block api `consumeWithBorrowNonBlocking` or `consume`
                 _copy_token_bucket->consumeWithBorrowAndWait(req->size);
 
                 copy_request copy_req;
-                copy_req.source = ureq->file_size_req.source;
+                copy_req.source = source.address;
                 copy_req.file_name = req->file_ctx->file_name;
                 copy_req.offset = req->offset;
                 copy_req.size = req->size;
                 copy_req.dst_dir = ureq->file_size_req.dst_dir;
-                copy_req.source_dir = ureq->file_size_req.source_dir;
+                copy_req.source_dir = source.dir;
                 copy_req.overwrite = ureq->file_size_req.overwrite;
                 copy_req.is_last = req->is_last;
+                copy_req.__set_high_priority(ureq->high_priority);
                 req->remote_copy_task =
                     async_nfs_copy(copy_req,
                                    [=](error_code err, copy_response &&resp) {
@@ -294,12 +387,16 @@ void nfs_client_impl::continue_copy()
                                        }
                                    },
                                    std::chrono::milliseconds(FLAGS_rpc_timeout_ms),
-                                   req->file_ctx->user_req->file_size_req.source);
+                                   source.address);
             } else {
                 --ureq->concurrent_copy_count;
                 --_concurrent_copy_request_count;
             }
         }
+        if (!sent) {
+            // not sent, release the source out of req->lock to keep the lock order
+            release_copy_source(req->file_ctx->user_req, req->source_index, false);
+        }
 
         if (++_concurrent_copy_request_count > FLAGS_max_concurrent_remote_copy_requests) {
             // exceed max_concurrent_remote_copy_requests limit, pause.
@@ -323,11 +420,27 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
         err = resp.error;
     }
 
+    bool failover = release_copy_source(fc->user_req, reqc->source_index, err != ERR_OK);
+
     if (err != ::dsn::ERR_OK) {
         _recent_copy_fail_count->increment();
 
         if (!fc->user_req->is_finished) {
-            if (reqc->retry_count > 0) {
+            if (failover) {
+                dwarn("{nfs_service} remote copy failed, give up source = %s, dir = %s, "
+                      "file = %s, err = %s, copy from other sources",
+                      fc->user_req->sources[reqc->source_index].address.to_string(),
+                      fc->user_req->sources[reqc->source_index].dir.c_str(),
+                      fc->file_name.c_str(),
+                      err.to_string());
+
+                // put back into copy request queue without consuming the retry count
+                zauto_lock l(_copy_requests_lock);
+                if (fc->user_req->high_priority)
+                    _copy_requests_high.push_front(reqc);
+                else
+                    _copy_requests_low.push_retry(reqc);
+            } else if (reqc->retry_count > 0) {
                 dwarn("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
                       "err = %s, retry_count = %d",
                       fc->user_req->file_size_req.source.to_string(),
@@ -373,7 +486,9 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
                 for (int i = reqc->index; i < (int)(fc->copy_requests.size()); i++) {
                     if (fc->copy_requests[i]->is_ready_for_write) {
                         fc->current_write_index++;
-                        new_writes.push_back(fc->copy_requests[i]);
+                        if (!fc->copy_requests[i]->is_copied) {
+                            new_writes.push_back(fc->copy_requests[i]);
+                        }
                     } else {
                         break;
                     }
@@ -486,11 +601,16 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
 {
     --_concurrent_local_write_count;
 
+    const file_context_ptr &fc = reqc->file_ctx;
+
+    uint32_t crc = 0;
+    if (err == ERR_OK && fc->progress) {
+        crc = dsn::utils::crc32_calc(reqc->response.file_content.data(), reqc->response.size, 0);
+    }
+
     // clear content to release memory quickly
     reqc->response.file_content = blob();
 
-    const file_context_ptr &fc = reqc->file_ctx;
-
     bool completed = false;
     if (err != ERR_OK) {
         _recent_write_fail_count->increment();
@@ -502,6 +622,9 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
         completed = true;
     } else {
         _recent_write_data_size->add(sz);
+        if (fc->progress) {
+            fc->progress->record(reqc->index, crc);
+        }
 
         file_wrapper_ptr temp_holder;
         zauto_lock l(fc->user_req->user_req_lock);
@@ -545,6 +668,15 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
                 rc->is_valid = false;
             }
         }
+        if (fc->progress) {
+            // the progress is kept for the failed copy to be resumed
+            fc->progress->close();
+            if (err == ERR_OK) {
+                dsn::utils::filesystem::remove_path(nfs_copy_progress::path_of(
+                    dsn::utils::filesystem::path_combine(req->file_size_req.dst_dir,
+                                                         fc->file_name)));
+            }
+        }
         // clear copy_requests to break circle reference
         fc->copy_requests.clear();
     }
@@ -556,6 +688,50 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
     req->nfs_task->enqueue(err, err == ERR_OK ? total_size : 0);
 }
 
+int nfs_client_impl::acquire_copy_source(const user_request_ptr &ureq)
+{
+    zauto_lock l(ureq->user_req_lock);
+    int chosen = -1;
+    for (int i = 0; i < static_cast<int>(ureq->sources.size()); ++i) {
+        const copy_source &source = ureq->sources[i];
+        if (source.failed || (FLAGS_max_concurrent_copy_requests_per_source > 0 &&
+                              source.copy_count >= FLAGS_max_concurrent_copy_requests_per_source)) {
+            continue;
+        }
+        if (chosen < 0 || source.copy_count < ureq->sources[chosen].copy_count) {
+            chosen = i;
+        }
+    }
+    if (chosen >= 0) {
+        ++ureq->sources[chosen].copy_count;
+    }
+    return chosen;
+}
+
+bool nfs_client_impl::release_copy_source(const user_request_ptr &ureq,
+                                          int source_index,
+                                          bool failed)
+{
+    zauto_lock l(ureq->user_req_lock);
+    copy_source &source = ureq->sources[source_index];
+    --source.copy_count;
+    if (!failed) {
+        return false;
+    }
+    if (source.failed) {
+        // another request has given it up already
+        return true;
+    }
+    // the last healthy source is kept, whose failures are handled by retrying
+    for (const auto &s : ureq->sources) {
+        if (&s != &source && !s.failed) {
+            source.failed = true;
+            return true;
+        }
+    }
+    return false;
+}
+
 void nfs_client_impl::register_cli_commands()
 {
 
@@ -40,6 +40,7 @@
 
 #include "nfs_types.h"
 #include "nfs_code_definition.h"
+#include "nfs_copy_progress.h"
 
 namespace dsn {
 namespace service {
@@ -108,18 +109,22 @@ public:
         ::dsn::task_ptr remote_copy_task;
         ::dsn::task_ptr local_write_task;
         bool is_ready_for_write;
+        bool is_copied; // copied into the local file before, neither copied nor written again
         bool is_valid;
         int retry_count;
-        zlock lock; // to protect is_valid
+        int source_index; // index of user_request::sources copied from
+        zlock lock;       // to protect is_valid
 
         copy_request_ex(const file_context_ptr &file, int idx, int try_count)
         {
             file_ctx = file;
             index = idx;
+            source_index = -1;
             offset = 0;
             size = 0;
             is_last = false;
             is_ready_for_write = false;
+            is_copied = false;
             is_valid = true;
             retry_count = try_count;
         }
@@ -136,6 +141,8 @@ public:
         int current_write_index;
         int finished_segments;
         std::vector<copy_request_ex_ptr> copy_requests;
+        // null if the source doesn't tell the md5 of the file
+        std::unique_ptr<nfs_copy_progress> progress;
 
         file_context(const user_request_ptr &req, const std::string &file_nm, uint64_t sz)
         {
@@ -148,10 +155,26 @@ public:
         }
     };
 
+    struct copy_source
+    {
+        rpc_address address;
+        std::string dir;
+        int copy_count; // in-flight copy requests to this source
+        bool failed;    // no more requests are sent to this source after it fails
+
+        copy_source(const rpc_address &addr, const std::string &d)
+            : address(addr), dir(d), copy_count(0), failed(false)
+        {
+        }
+    };
+
     struct user_request : public ::dsn::ref_counter
     {
         zlock user_req_lock;
 
+        // sources[0] is file_size_req.source, protected by user_req_lock
+        std::vector<copy_source> sources;
+
         bool high_priority;
         int low_queue_index;
         get_file_size_request file_size_req;
@@ -222,8 +245,10 @@ public:
                 pop_it = queue_list.begin();
             auto start_it = pop_it;
             while (true) {
-                if (pop_it->front()->file_ctx->user_req->concurrent_copy_count <
-                    max_concurrent_copy_count_per_queue) {
+                const user_request_ptr &ureq = pop_it->front()->file_ctx->user_req;
+                // a request copied from several sources gets the quota of each of them
+                if (ureq->concurrent_copy_count <
+                    max_concurrent_copy_count_per_queue * static_cast<int>(ureq->sources.size())) {
                     // ok, find one, pop from queue, and forward pop_it
                     p = pop_it->front();
                     pop_it->pop_front();
@@ -261,6 +286,10 @@ private:
                            const ::dsn::service::get_file_size_response &resp,
                            const user_request_ptr &ureq);
 
+    // split the files into copy requests, skipping the chunks copied before
+    void init_copy_requests(const ::dsn::service::get_file_size_response &resp,
+                            const user_request_ptr &ureq);
+
     void continue_copy();
 
     void
@@ -272,6 +301,13 @@ private:
 
     void handle_completion(const user_request_ptr &req, error_code err);
 
+    // choose the healthy source with the fewest in-flight copies for a copy request,
+    // return -1 if all of them are busy
+    int acquire_copy_source(const user_request_ptr &ureq);
+
+    // return true if the failed source is given up and the request can go to another one
+    bool release_copy_source(const user_request_ptr &ureq, int source_index, bool failed);
+
     void register_cli_commands();
 
 private:
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "nfs_copy_progress.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/filesystem.h>
+
+namespace dsn {
+namespace service {
+
+/*static*/ std::map<int, uint32_t> nfs_copy_progress::load(const std::string &file_path,
+                                                           uint64_t file_size,
+                                                           uint32_t chunk_size,
+                                                           const std::string &source_md5)
+{
+    std::map<int, uint32_t> copied;
+    if (source_md5.empty()) {
+        return copied;
+    }
+    std::ifstream progress(path_of(file_path));
+    uint64_t recorded_size = 0;
+    uint32_t recorded_chunk_size = 0;
+    std::string recorded_md5;
+    if (!progress || !(progress >> recorded_size >> recorded_chunk_size >> recorded_md5) ||
+        recorded_size != file_size || recorded_chunk_size != chunk_size ||
+        recorded_md5 != source_md5) {
+        return copied;
+    }
+
+    std::ifstream local(file_path, std::ios::binary);
+    if (!local) {
+        return copied;
+    }
+    std::unique_ptr<char[]> buffer(new char[chunk_size]);
+    int index = 0;
+    uint32_t crc = 0;
+    // the last line may be partial if the process crashed when it was appended
+    while (progress >> index >> crc) {
+        uint64_t offset = static_cast<uint64_t>(index) * chunk_size;
+        if (index < 0 || offset >= std::max<uint64_t>(file_size, 1)) {
+            continue;
+        }
+        size_t length = static_cast<size_t>(std::min<uint64_t>(chunk_size, file_size - offset));
+        // the data may be lost if the process crashed before it was flushed
+        if (local.seekg(offset) && local.read(buffer.get(), length) &&
+            utils::crc32_calc(buffer.get(), length, 0) == crc) {
+            copied[index] = crc;
+        }
+        local.clear();
+    }
+    ddebug("nfs: %d chunks copied before are verified for %s",
+           (int)copied.size(),
+           file_path.c_str());
+    return copied;
+}
+
+bool nfs_copy_progress::start(const std::string &file_path,
+                              uint64_t file_size,
+                              uint32_t chunk_size,
+                              const std::string &source_md5,
+                              const std::map<int, uint32_t> &copied)
+{
+    if (source_md5.empty()) {
+        return false;
+    }
+
+    std::string path = utils::filesystem::remove_file_name(file_path);
+    if (!utils::filesystem::create_directory(path)) {
+        return false;
+    }
+
+    zauto_lock l(_lock);
+    // rewrite the progress with the verified chunks only
+    _out.open(path_of(file_path), std::ios::out | std::ios::trunc);
+    if (!_out) {
+        derror("nfs: open copy progress of %s failed", file_path.c_str());
+        return false;
+    }
+    _out << file_size << ' ' << chunk_size << ' ' << source_md5 << '\n';
+    for (const auto &kv : copied) {
+        _out << kv.first << ' ' << kv.second << '\n';
+    }
+    _out.flush();
+    return true;
+}
+
+void nfs_copy_progress::record(int index, uint32_t crc)
+{
+    zauto_lock l(_lock);
+    if (_out.is_open()) {
+        _out << index << ' ' << crc << '\n';
+        _out.flush();
+    }
+}
+
+void nfs_copy_progress::close()
+{
+    zauto_lock l(_lock);
+    if (_out.is_open()) {
+        _out.close();
+    }
+}
+
+} // namespace service
+} // namespace dsn
@@ -0,0 +1,69 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <dsn/dist/nfs_node.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace service {
+
+// The progress of copying a file by nfs, recorded beside it in "<file>.nfs_progress", so that a
+// copy failed midway is resumed by a later one, even from another source, which copies only the
+// chunks missing.
+//
+// The progress starts with a line of "<file_size> <chunk_size> <md5>" identifying the content of
+// the source file by the md5 of all of it, followed by a line of "<chunk_index> <crc32>" for each
+// chunk written to the local file.
+class nfs_copy_progress
+{
+public:
+    static std::string path_of(const std::string &file_path)
+    {
+        return file_path + nfs_node::kCopyProgressSuffix;
+    }
+
+    // returns <index, crc> of the chunks recorded for the same source content, i.e. the same
+    // size, chunk size and md5, which are verified one by one against the local file
+    static std::map<int, uint32_t> load(const std::string &file_path,
+                                        uint64_t file_size,
+                                        uint32_t chunk_size,
+                                        const std::string &source_md5);
+
+    // starts to record the progress of the file, from the chunks returned by load()
+    bool start(const std::string &file_path,
+               uint64_t file_size,
+               uint32_t chunk_size,
+               const std::string &source_md5,
+               const std::map<int, uint32_t> &copied);
+    // thread-safe
+    void record(int index, uint32_t crc);
+    void close();
+
+private:
+    zlock _lock;
+    std::ofstream _out;
+};
+
+} // namespace service
+} // namespace dsn
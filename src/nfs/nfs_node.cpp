@@ -6,6 +6,8 @@
 
 namespace dsn {
 
+constexpr const char *nfs_node::kCopyProgressSuffix;
+
 std::unique_ptr<nfs_node> nfs_node::create()
 {
     return dsn::make_unique<dsn::service::nfs_node_simple>();
@@ -43,12 +45,39 @@ aio_task_ptr nfs_node::copy_remote_files(rpc_address remote,
                                          task_tracker *tracker,
                                          aio_handler &&callback,
                                          int hash)
+{
+    return copy_remote_files(remote,
+                             source_dir,
+                             {},
+                             files,
+                             dest_dir,
+                             overwrite,
+                             high_priority,
+                             callback_code,
+                             tracker,
+                             std::move(callback),
+                             hash);
+}
+
+aio_task_ptr nfs_node::copy_remote_files(
+    rpc_address remote,
+    const std::string &source_dir,
+    const std::vector<std::pair<rpc_address, std::string>> &alternate_sources,
+    const std::vector<std::string> &files,
+    const std::string &dest_dir,
+    bool overwrite,
+    bool high_priority,
+    task_code callback_code,
+    task_tracker *tracker,
+    aio_handler &&callback,
+    int hash)
 {
     auto cb = dsn::file::create_aio_task(callback_code, tracker, std::move(callback), hash);
 
     std::shared_ptr<remote_copy_request> rci = std::make_shared<remote_copy_request>();
     rci->source = remote;
     rci->source_dir = source_dir;
+    rci->alternate_sources = alternate_sources;
     rci->files = files;
     rci->dest_dir = dest_dir;
     rci->overwrite = overwrite;
@@ -32,10 +32,14 @@
  *     xxxx-xx-xx, author, first version
  *     xxxx-xx-xx, author, fix bug about xxx
  */
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <sys/stat.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/smart_pointers.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/background_io_limiter.h>
 
 #include "nfs_server_impl.h"
 
@@ -45,6 +49,17 @@ namespace service {
 DSN_DECLARE_int32(file_close_timer_interval_ms_on_server);
 DSN_DECLARE_int32(file_close_expire_time_ms);
 
+DSN_DEFINE_uint32("nfs",
+                  high_priority_disk_read_rate_mb,
+                  0,
+                  "the max rate(MB/s) of each disk to serve the high priority copies on nfs "
+                  "server, 0 means unlimited");
+DSN_DEFINE_uint32("nfs",
+                  low_priority_disk_read_rate_mb,
+                  0,
+                  "the max rate(MB/s) of each disk to serve the low priority copies on nfs "
+                  "server, 0 means unlimited");
+
 nfs_service_impl::nfs_service_impl() : ::dsn::serverlet<nfs_service_impl>("nfs")
 {
     _file_close_timer = ::dsn::tasking::enqueue_timer(
@@ -53,6 +68,9 @@ nfs_service_impl::nfs_service_impl() : ::dsn::serverlet<nfs_service_impl>("nfs")
         [this] { close_file(); },
         std::chrono::milliseconds(FLAGS_file_close_timer_interval_ms_on_server));
 
+    // the files are read for the learners in the background
+    task_spec::set_default_disk_io_priority(LPC_NFS_READ, DIO_PRIORITY_LOW);
+
     _recent_copy_data_size.init_app_counter("eon.nfs_server",
                                             "recent_copy_data_size",
                                             COUNTER_TYPE_VOLATILE_NUMBER,
@@ -72,6 +90,7 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
     std::string file_path =
         dsn::utils::filesystem::path_combine(request.source_dir, request.file_name);
     disk_file *hfile;
+    dev_t device = 0;
 
     {
         zauto_lock l(_handles_map_lock);
@@ -81,11 +100,16 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
         {
             hfile = file::open(file_path.c_str(), O_RDONLY | O_BINARY, 0);
             if (hfile) {
+                struct stat st;
+                if (::stat(file_path.c_str(), &st) == 0) {
+                    device = st.st_dev;
+                }
 
                 auto fh = std::make_shared<file_handle_info_on_server>();
                 fh->file_handle = hfile;
                 fh->file_access_count = 1;
                 fh->last_access_time = dsn_now_ms();
+                fh->device = device;
                 _handles_map.insert(std::make_pair(file_path, std::move(fh)));
             }
         } else // found
@@ -93,6 +117,7 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
             hfile = it->second->file_handle;
             it->second->file_access_count++;
             it->second->last_access_time = dsn_now_ms();
+            device = it->second->device;
         }
     }
 
@@ -117,16 +142,57 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
     cp->offset = request.offset;
     cp->size = request.size;
 
-    auto buffer_save = cp->bb.buffer().get();
+    auto read_file = [this, cp]() {
+        file::read(cp->hfile,
+                   cp->bb.buffer().get(),
+                   cp->size,
+                   cp->offset,
+                   LPC_NFS_READ,
+                   &_tracker,
+                   [this, cp](error_code err, size_t sz) mutable {
+                       internal_read_callback(err, sz, *cp);
+                   });
+    };
 
-    file::read(
-        hfile,
-        buffer_save,
-        request.size,
-        request.offset,
-        LPC_NFS_READ,
-        &_tracker,
-        [this, cp](error_code err, size_t sz) mutable { internal_read_callback(err, sz, *cp); });
+    auto delay = get_read_delay(device, request.__isset.high_priority && request.high_priority,
+                                request.size);
+    if (delay.count() > 0) {
+        tasking::enqueue(LPC_NFS_THROTTLED_READ, &_tracker, std::move(read_file), 0, delay);
+    } else {
+        read_file();
+    }
+}
+
+std::chrono::milliseconds
+nfs_service_impl::get_read_delay(dev_t device, bool high_priority, uint32_t size)
+{
+    // the copies also share the budget of the disk with the other background I/O
+    std::chrono::milliseconds shared_delay =
+        background_io_limiter::instance().acquire(device, background_io_class::learn, size);
+
+    uint32_t rate_mb = high_priority ? FLAGS_high_priority_disk_read_rate_mb
+                                     : FLAGS_low_priority_disk_read_rate_mb;
+    if (rate_mb == 0 || size == 0) {
+        return shared_delay;
+    }
+
+    folly::DynamicTokenBucket *limiter;
+    {
+        zauto_lock l(_disk_limiters_lock);
+        auto &bucket = _disk_limiters[std::make_pair(device, high_priority)];
+        if (bucket == nullptr) {
+            bucket = dsn::make_unique<folly::DynamicTokenBucket>();
+        }
+        limiter = bucket.get();
+    }
+
+    // the copies borrow from the future in the order they come, which queues them fairly
+    double rate = rate_mb * 1024.0 * 1024.0;
+    double burst = std::max(rate, static_cast<double>(size));
+    auto wait_seconds = limiter->consumeWithBorrowNonBlocking(size, rate, burst);
+    return std::max(shared_delay,
+                    std::chrono::milliseconds(
+                        static_cast<int64_t>(std::ceil(wait_seconds.get_value_or(0) * 1000))));
 }
 
 void nfs_service_impl::internal_read_callback(error_code err, size_t sz, callback_para &cp)
@@ -188,7 +254,17 @@ void nfs_service_impl::on_get_file_size(
                         break;
                     }
 
+                    std::string md5;
+                    if (request.with_md5 && !get_file_md5(fpath, md5)) {
+                        err = ERR_FILE_OPERATION_FAILED;
+                        break;
+                    }
+
                     resp.size_list.push_back((uint64_t)sz);
+                    if (request.with_md5) {
+                        resp.__isset.md5_list = true;
+                        resp.md5_list.push_back(std::move(md5));
+                    }
                     resp.file_list.push_back(
                         fpath.substr(request.source_dir.length(), fpath.length() - 1));
                 }
@@ -214,7 +290,17 @@ void nfs_service_impl::on_get_file_size(
             // Done
             uint64_t size = st.st_size;
 
+            std::string md5;
+            if (request.with_md5 && !get_file_md5(file_path, md5)) {
+                err = ERR_FILE_OPERATION_FAILED;
+                break;
+            }
+
             resp.size_list.push_back(size);
+            if (request.with_md5) {
+                resp.__isset.md5_list = true;
+                resp.md5_list.push_back(std::move(md5));
+            }
             resp.file_list.push_back((folder + request.file_list[i])
                                          .substr(request.source_dir.length(),
                                                  (folder + request.file_list[i]).length() - 1));
@@ -225,6 +311,16 @@ void nfs_service_impl::on_get_file_size(
     reply(resp);
 }
 
+/*static*/ bool nfs_service_impl::get_file_md5(const std::string &file_path,
+                                              /*out*/ std::string &md5)
+{
+    if (dsn::utils::filesystem::md5sum(file_path, md5) != ERR_OK) {
+        derror("{nfs_service} calculate md5 of file %s failed", file_path.c_str());
+        return false;
+    }
+    return true;
+}
+
 void nfs_service_impl::close_file() // release out-of-date file handle
 {
     zauto_lock l(_handles_map_lock);
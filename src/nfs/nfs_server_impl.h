@@ -28,8 +28,10 @@
 #include <dsn/tool-api/task_tracker.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <iostream>
+#include <sys/types.h>
 #include <dsn/cpp/serverlet.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/TokenBucket.h>
 
 #include "nfs_code_definition.h"
 #include "nfs_types.h"
@@ -98,9 +100,10 @@ private:
         disk_file *file_handle;
         int32_t file_access_count; // concurrent r/w count
         uint64_t last_access_time; // last touch time
+        dev_t device;              // the disk the file is on
 
         file_handle_info_on_server()
-            : file_handle(nullptr), file_access_count(0), last_access_time(0)
+            : file_handle(nullptr), file_access_count(0), last_access_time(0), device(0)
         {
         }
 
@@ -113,8 +116,15 @@ private:
 
     void internal_read_callback(error_code err, size_t sz, callback_para &cp);
 
+    // the delay before reading `size` bytes from `device`, to keep the copies of each traffic
+    // class within its rate budget of the disk. the copies are served in the order they come
+    std::chrono::milliseconds get_read_delay(dev_t device, bool high_priority, uint32_t size);
+
     void close_file();
 
+    // the md5 of the whole file, which a resumed copy of it must match, see nfs_copy_progress
+    static bool get_file_md5(const std::string &file_path, /*out*/ std::string &md5);
+
 private:
     zlock _handles_map_lock;
     std::unordered_map<std::string, std::shared_ptr<file_handle_info_on_server>>
@@ -122,6 +132,10 @@ private:
 
     ::dsn::task_ptr _file_close_timer;
 
+    zlock _disk_limiters_lock;
+    // <device, high_priority> -> rate limiter
+    std::map<std::pair<dev_t, bool>, std::unique_ptr<folly::DynamicTokenBucket>> _disk_limiters;
+
     perf_counter_wrapper _recent_copy_data_size;
     perf_counter_wrapper _recent_copy_fail_count;
 
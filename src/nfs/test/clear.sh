@@ -1,3 +1,3 @@
 #!/bin/sh
 
-rm -rf data nfs_test_dir nfs_test_dir_copy dsn_nfs_test.xml
+rm -rf data nfs_test_dir nfs_test_dir_copy nfs_test_dir_multi_source dsn_nfs_test.xml
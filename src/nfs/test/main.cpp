@@ -141,6 +141,46 @@ TEST(nfs, basic)
         ASSERT_EQ(sz1, sz2);
     }
 
+    {
+        // copy nfs_test_dir from itself and nfs_test_dir_copy to nfs_test_dir_multi_source,
+        // the copies from the alternate source nfs_test_dir_not_exist fail over to the others
+        ASSERT_FALSE(utils::filesystem::directory_exists("nfs_test_dir_multi_source"));
+
+        std::vector<std::pair<dsn::rpc_address, std::string>> alternate_sources{
+            {dsn::rpc_address("localhost", 20101), "nfs_test_dir_not_exist"},
+            {dsn::rpc_address("localhost", 20101), "nfs_test_dir_copy"}};
+        std::vector<std::string> files{"nfs_test_file1", "nfs_test_file2"};
+
+        aio_result r;
+        dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                     "nfs_test_dir",
+                                                     alternate_sources,
+                                                     files,
+                                                     "nfs_test_dir_multi_source",
+                                                     false,
+                                                     false,
+                                                     LPC_AIO_TEST_NFS,
+                                                     nullptr,
+                                                     [&r](dsn::error_code err, size_t sz) {
+                                                         r.err = err;
+                                                         r.sz = sz;
+                                                     },
+                                                     0);
+        ASSERT_NE(nullptr, t);
+        ASSERT_TRUE(t->wait(20000));
+        ASSERT_EQ(r.err, t->error());
+        ASSERT_EQ(ERR_OK, r.err);
+        ASSERT_EQ(r.sz, t->get_transferred_size());
+
+        for (const auto &file : files) {
+            std::string md5_1, md5_2;
+            ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(file, md5_1));
+            ASSERT_EQ(ERR_OK,
+                      utils::filesystem::md5sum("nfs_test_dir_multi_source/" + file, md5_2));
+            ASSERT_EQ(md5_1, md5_2);
+        }
+    }
+
     nfs->stop();
 }
 
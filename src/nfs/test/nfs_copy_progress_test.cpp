@@ -0,0 +1,144 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/filesystem.h>
+
+#include "nfs/nfs_copy_progress.h"
+
+using namespace dsn;
+using namespace dsn::service;
+
+class nfs_copy_progress_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        utils::filesystem::remove_path(kDir);
+        ASSERT_TRUE(utils::filesystem::create_directory(kDir));
+        // 3 chunks of 16, 16, 8 bytes
+        for (int i = 0; i < 40; ++i) {
+            _data.push_back(static_cast<char>('a' + i % 26));
+        }
+        write_local(_data);
+    }
+
+    void TearDown() override { utils::filesystem::remove_path(kDir); }
+
+    void write_local(const std::string &data)
+    {
+        std::ofstream out(kFile, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    uint32_t chunk_crc(int index) const
+    {
+        size_t offset = index * kChunk;
+        size_t length = std::min(kChunk, _data.size() - offset);
+        return utils::crc32_calc(_data.data() + offset, length, 0);
+    }
+
+    std::map<int, uint32_t> load(const std::string &source_md5 = kSourceMd5) const
+    {
+        return nfs_copy_progress::load(kFile, _data.size(), kChunk, source_md5);
+    }
+
+    // records the chunks of `indexes` as written
+    void record(const std::vector<int> &indexes)
+    {
+        nfs_copy_progress progress;
+        ASSERT_TRUE(progress.start(kFile, _data.size(), kChunk, kSourceMd5, {}));
+        for (int index : indexes) {
+            progress.record(index, chunk_crc(index));
+        }
+        progress.close();
+    }
+
+    static constexpr const char *kDir = "nfs_copy_progress_test_dir";
+    static constexpr const char *kFile = "nfs_copy_progress_test_dir/file";
+    static constexpr size_t kChunk = 16;
+    static constexpr const char *kSourceMd5 = "0123456789abcdef0123456789abcdef";
+
+    std::string _data;
+};
+
+constexpr const char *nfs_copy_progress_test::kDir;
+constexpr const char *nfs_copy_progress_test::kFile;
+constexpr size_t nfs_copy_progress_test::kChunk;
+constexpr const char *nfs_copy_progress_test::kSourceMd5;
+
+TEST_F(nfs_copy_progress_test, no_progress) { ASSERT_TRUE(load().empty()); }
+
+TEST_F(nfs_copy_progress_test, load_recorded_chunks)
+{
+    record({2, 0});
+    auto copied = load();
+    ASSERT_EQ(2, copied.size());
+    ASSERT_EQ(chunk_crc(0), copied[0]);
+    ASSERT_EQ(chunk_crc(2), copied[2]);
+
+    // the progress is rewritten with the chunks loaded
+    nfs_copy_progress progress;
+    ASSERT_TRUE(progress.start(kFile, _data.size(), kChunk, kSourceMd5, copied));
+    progress.record(1, chunk_crc(1));
+    progress.close();
+    ASSERT_EQ(3, load().size());
+}
+
+TEST_F(nfs_copy_progress_test, source_changed)
+{
+    record({0, 1, 2});
+    ASSERT_EQ(3, load().size());
+
+    // the same size but another content, e.g. only a byte in the middle differs
+    ASSERT_TRUE(load("fedcba9876543210fedcba9876543210").empty());
+    ASSERT_TRUE(nfs_copy_progress::load(kFile, _data.size() + 1, kChunk, kSourceMd5).empty());
+    ASSERT_TRUE(nfs_copy_progress::load(kFile, _data.size(), kChunk * 2, kSourceMd5).empty());
+}
+
+TEST_F(nfs_copy_progress_test, no_source_md5)
+{
+    // a source which doesn't tell the md5 is never resumed from
+    nfs_copy_progress progress;
+    ASSERT_FALSE(progress.start(kFile, _data.size(), kChunk, "", {}));
+    record({0, 1, 2});
+    ASSERT_TRUE(load("").empty());
+}
+
+TEST_F(nfs_copy_progress_test, local_data_lost)
+{
+    record({0, 1, 2});
+
+    // the chunk 1 is corrupted, and the chunk 2 is lost
+    std::string data = _data.substr(0, 20);
+    data[kChunk] ^= 1;
+    write_local(data);
+
+    auto copied = load();
+    ASSERT_EQ(1, copied.size());
+    ASSERT_EQ(1, copied.count(0));
+
+    // a partial line appended when crashed is ignored
+    {
+        std::ofstream out(nfs_copy_progress::path_of(kFile), std::ios::app);
+        out << "1";
+    }
+    ASSERT_EQ(1, load().size());
+}
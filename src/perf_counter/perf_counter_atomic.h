@@ -18,7 +18,6 @@ namespace dsn {
 
 // -----------   NUMBER perf counter ---------------------------------
 
-#define DIVIDE_CONTAINER 107
 class perf_counter_number_atomic : public perf_counter
 {
 public:
@@ -29,52 +28,19 @@ public:
                                const char *dsptr)
         : perf_counter(app, section, name, type, dsptr)
     {
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            _val[i].store(0);
-        }
+        set_striped_sum(&_val);
     }
     ~perf_counter_number_atomic(void) {}
 
-    virtual void increment()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(1, std::memory_order_relaxed);
-    }
-    virtual void decrement()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_sub(1, std::memory_order_relaxed);
-    }
-    virtual void add(int64_t val)
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(val, std::memory_order_relaxed);
-    }
     virtual void set(int64_t val)
     {
         // the set-op of number is reset the number to zero.
         // for simplicity, only set other zero, not add the lock to protect, if needed, should add
         // lock.
-        for (int i = 0; i < DIVIDE_CONTAINER; i++)
-            _val[i].store(0, std::memory_order_relaxed);
-        _val[0].store(val, std::memory_order_relaxed);
-    }
-    virtual double get_value()
-    {
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += static_cast<double>(_val[i].load(std::memory_order_relaxed));
-        }
-        return val;
-    }
-    virtual int64_t get_integer_value()
-    {
-        int64_t val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].load(std::memory_order_relaxed);
-        }
-        return val;
+        _val.set(val);
     }
+    virtual double get_value() { return static_cast<double>(_val.sum()); }
+    virtual int64_t get_integer_value() { return _val.sum(); }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
@@ -82,7 +48,10 @@ public:
     }
 
 protected:
-    std::atomic<int64_t> _val[DIVIDE_CONTAINER];
+    // never called as the striped sum is set
+    virtual void do_add(int64_t val) { _val.add(val); }
+
+    striped_counter _val;
 };
 
 // -----------   VOLATILE_NUMBER perf counter ---------------------------------
@@ -100,22 +69,8 @@ public:
     }
     ~perf_counter_volatile_number_atomic(void) {}
 
-    virtual double get_value()
-    {
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += static_cast<double>(_val[i].exchange(0, std::memory_order_relaxed));
-        }
-        return val;
-    }
-    virtual int64_t get_integer_value()
-    {
-        int64_t val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].exchange(0, std::memory_order_relaxed);
-        }
-        return val;
-    }
+    virtual double get_value() { return static_cast<double>(_val.fetch_and_reset()); }
+    virtual int64_t get_integer_value() { return _val.fetch_and_reset(); }
 };
 
 // -----------   RATE perf counter ---------------------------------
@@ -131,27 +86,10 @@ public:
         : perf_counter(app, section, name, type, dsptr), _rate(0)
     {
         _last_time = utils::get_current_physical_time_ns();
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            _val[i].store(0, std::memory_order_relaxed);
-        }
+        set_striped_sum(&_val);
     }
     ~perf_counter_rate_atomic(void) {}
 
-    virtual void increment()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(1, std::memory_order_relaxed);
-    }
-    virtual void decrement()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_sub(1, std::memory_order_relaxed);
-    }
-    virtual void add(int64_t val)
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(val, std::memory_order_relaxed);
-    }
     virtual void set(int64_t val) { dassert(false, "invalid execution flow"); }
     virtual double get_value()
     {
@@ -160,10 +98,7 @@ public:
         if (interval <= 0.1)
             return _rate;
 
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].fetch_and(0, std::memory_order_relaxed);
-        }
+        double val = static_cast<double>(_val.fetch_and_reset());
 
         _rate = val / interval;
         _last_time = now;
@@ -176,10 +111,14 @@ public:
         return 0.0;
     }
 
+protected:
+    // never called as the striped sum is set
+    virtual void do_add(int64_t val) { _val.add(val); }
+
 private:
     std::atomic<double> _rate;
     std::atomic<uint64_t> _last_time;
-    std::atomic<int64_t> _val[DIVIDE_CONTAINER];
+    striped_counter _val;
 };
 
 // -----------   NUMBER_PERCENTILE perf counter ---------------------------------
@@ -221,9 +160,6 @@ public:
 
     ~perf_counter_number_percentile_atomic(void) { _timer->cancel(); }
 
-    virtual void increment() { dassert(false, "invalid execution flow"); }
-    virtual void decrement() { dassert(false, "invalid execution flow"); }
-    virtual void add(int64_t val) { dassert(false, "invalid execution flow"); }
     virtual void set(int64_t val)
     {
         uint64_t idx = _tail.fetch_add(1, std::memory_order_relaxed);
@@ -276,6 +212,9 @@ public:
         return _samples[idx];
     }
 
+protected:
+    virtual void do_add(int64_t val) { dassert(false, "invalid execution flow"); }
+
 private:
     struct compute_context
     {
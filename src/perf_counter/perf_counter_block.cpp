@@ -0,0 +1,36 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/perf_counter/perf_counter_block.h>
+#include <dsn/perf_counter/perf_counters.h>
+
+namespace dsn {
+
+perf_counter_block::perf_counter_block(const char *app, const char *section, std::string label)
+    : _app(app), _section(section), _label(std::move(label))
+{
+    perf_counters::instance().register_block(this);
+}
+
+perf_counter_block::~perf_counter_block() { perf_counters::instance().remove_block(this); }
+
+perf_counter_ptr perf_counter_block::get_counter(const char *name, dsn_perf_counter_type_t type)
+{
+    return perf_counters::instance().get_block_counter(this, name, type);
+}
+
+} // namespace dsn
@@ -0,0 +1,274 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio/deadline_timer.hpp>
+#include <dsn/c/api_utilities.h>
+#include <dsn/perf_counter/perf_counter.h>
+#include <dsn/utility/config_api.h>
+
+#include "utils/shared_io_service.h"
+
+namespace dsn {
+
+// The log-bucketed layout of a histogram, like HdrHistogram: the values below
+// `kSubBucketCount` have their own buckets, and every power-of-two range above is split into
+// `kSubBucketCount` buckets of equal width, so a value is told within 1/kSubBucketCount of
+// itself. The values beyond the max trackable one are counted in the last bucket.
+struct log_histogram_layout
+{
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+    // about 9.7 hours in nanoseconds
+    static constexpr int kMaxValueBits = 45;
+    static constexpr int kBucketCount =
+        kSubBucketCount + (kMaxValueBits - kSubBucketBits) * kSubBucketCount;
+
+    static int bucket_index(int64_t value)
+    {
+        if (value < kSubBucketCount) {
+            return value < 0 ? 0 : static_cast<int>(value);
+        }
+        int bits = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+        if (bits >= kMaxValueBits) {
+            return kBucketCount - 1;
+        }
+        int shift = bits - kSubBucketBits;
+        int sub_bucket = static_cast<int>(value >> shift) & (kSubBucketCount - 1);
+        return kSubBucketCount + shift * kSubBucketCount + sub_bucket;
+    }
+
+    // the max value counted in the bucket
+    static int64_t bucket_upper_bound(int index)
+    {
+        if (index < kSubBucketCount) {
+            return index;
+        }
+        int shift = (index - kSubBucketCount) / kSubBucketCount;
+        int64_t sub_bucket = (index - kSubBucketCount) % kSubBucketCount;
+        return ((kSubBucketCount + sub_bucket + 1) << shift) - 1;
+    }
+};
+
+// The bucket counts of a histogram over a period, which can be merged with the others, e.g.
+// the histograms recorded by different threads, or over several periods.
+class histogram_snapshot
+{
+public:
+    histogram_snapshot() : _counts(log_histogram_layout::kBucketCount, 0), _total(0), _sum(0) {}
+
+    void record(int64_t value, int64_t count = 1)
+    {
+        _counts[log_histogram_layout::bucket_index(value)] += count;
+        _total += count;
+        _sum += value * count;
+    }
+
+    void merge(const histogram_snapshot &other)
+    {
+        for (int i = 0; i < log_histogram_layout::kBucketCount; ++i) {
+            _counts[i] += other._counts[i];
+        }
+        _total += other._total;
+        _sum += other._sum;
+    }
+
+    // adds the counts of `buckets` and resets them to zero, `buckets` has kBucketCount + 1 slots
+    // and the last one is the sum of the values
+    void drain(std::atomic<int64_t> *buckets)
+    {
+        for (int i = 0; i < log_histogram_layout::kBucketCount; ++i) {
+            int64_t count = buckets[i].exchange(0, std::memory_order_relaxed);
+            _counts[i] += count;
+            _total += count;
+        }
+        _sum += buckets[log_histogram_layout::kBucketCount].exchange(0, std::memory_order_relaxed);
+    }
+
+    int64_t total_count() const { return _total; }
+    int64_t sum() const { return _sum; }
+    int64_t bucket_count(int index) const { return _counts[index]; }
+
+    // the upper bound of the bucket holding the sample of rank (ratio * total + 1) like
+    // perf_counter_number_percentile_atomic, 0 if empty
+    int64_t value_at(double ratio) const
+    {
+        if (_total == 0) {
+            return 0;
+        }
+        int64_t rank = std::min(static_cast<int64_t>(ratio * _total) + 1, _total);
+        int64_t seen = 0;
+        for (int i = 0; i < log_histogram_layout::kBucketCount; ++i) {
+            seen += _counts[i];
+            if (seen >= rank) {
+                return log_histogram_layout::bucket_upper_bound(i);
+            }
+        }
+        return log_histogram_layout::bucket_upper_bound(log_histogram_layout::kBucketCount - 1);
+    }
+
+private:
+    std::vector<int64_t> _counts;
+    int64_t _total;
+    int64_t _sum;
+};
+
+// -----------   NUMBER_PERCENTILE perf counter by histogram  ---------------------------------
+
+// Unlike perf_counter_number_percentile_atomic, which computes the percentiles from the latest
+// samples in a ring, this counter records every sample into a log-bucketed histogram, so the
+// percentiles cover all the samples of the computation interval, and the tail ones like P999
+// stay accurate at high sample rates.
+//
+// The samples are recorded lock-free into the histogram of the stripe of the recording thread,
+// and the histograms of the stripes are drained and merged every interval. The merged ones are
+// accumulated as well, to be exported as a histogram, e.g. to Prometheus.
+class perf_counter_number_percentile_histogram : public perf_counter
+{
+public:
+    static constexpr int kStripeCount = 4;
+
+    perf_counter_number_percentile_histogram(const char *app,
+                                             const char *section,
+                                             const char *name,
+                                             dsn_perf_counter_type_t type,
+                                             const char *dsptr)
+        : perf_counter(app, section, name, type, dsptr)
+    {
+        for (auto &stripe : _stripes) {
+            stripe.reset(new std::atomic<int64_t>[log_histogram_layout::kBucketCount + 1]);
+            for (int i = 0; i <= log_histogram_layout::kBucketCount; ++i) {
+                stripe[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto &result : _results) {
+            result.store(0, std::memory_order_relaxed);
+        }
+
+        _counter_computation_interval_seconds = (int)dsn_config_get_value_uint64(
+            "components.pegasus_perf_counter_number_percentile_atomic",
+            "counter_computation_interval_seconds",
+            10,
+            "period (seconds) the system computes the percentiles of the "
+            "pegasus_perf_counter_number_percentile_atomic counters");
+        _timer.reset(new boost::asio::deadline_timer(tools::shared_io_service::instance().ios));
+        _timer->expires_from_now(
+            boost::posix_time::seconds(rand() % _counter_computation_interval_seconds + 1));
+        _timer->async_wait(std::bind(&perf_counter_number_percentile_histogram::on_timer,
+                                     this,
+                                     _timer,
+                                     std::placeholders::_1));
+    }
+
+    ~perf_counter_number_percentile_histogram(void) { _timer->cancel(); }
+
+    virtual void set(int64_t val)
+    {
+        std::atomic<int64_t> *stripe =
+            _stripes[striped_counter::stripe_index() % kStripeCount].get();
+        stripe[log_histogram_layout::bucket_index(val)].fetch_add(1, std::memory_order_relaxed);
+        stripe[log_histogram_layout::kBucketCount].fetch_add(val, std::memory_order_relaxed);
+    }
+
+    virtual double get_value()
+    {
+        dassert(false, "invalid execution flow");
+        return 0.0;
+    }
+    virtual int64_t get_integer_value() { return (int64_t)get_value(); }
+
+    virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
+    {
+        if ((type < 0) || (type >= COUNTER_PERCENTILE_COUNT)) {
+            dassert(false, "send a wrong counter percentile type");
+            return 0.0;
+        }
+        return (double)_results[type].load(std::memory_order_relaxed);
+    }
+
+    // drains the samples recorded since the last time into `snapshot`
+    void drain(histogram_snapshot &snapshot)
+    {
+        for (auto &stripe : _stripes) {
+            snapshot.drain(stripe.get());
+        }
+    }
+
+    // computes the percentiles of the samples recorded since the last time, the percentiles
+    // are kept if no sample is recorded, like perf_counter_number_percentile_atomic
+    void calc()
+    {
+        histogram_snapshot snapshot;
+        drain(snapshot);
+        if (snapshot.total_count() == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> l(_cumulative_lock);
+            _cumulative.merge(snapshot);
+        }
+        static const double ratios[COUNTER_PERCENTILE_COUNT] = {0.5, 0.9, 0.95, 0.99, 0.999};
+        for (int i = 0; i < COUNTER_PERCENTILE_COUNT; ++i) {
+            _results[i].store(snapshot.value_at(ratios[i]), std::memory_order_relaxed);
+        }
+    }
+
+    // the samples of all the computed intervals since the counter is created
+    histogram_snapshot get_cumulative()
+    {
+        std::lock_guard<std::mutex> l(_cumulative_lock);
+        return _cumulative;
+    }
+
+protected:
+    virtual void do_add(int64_t val) { dassert(false, "invalid execution flow"); }
+
+private:
+    void on_timer(std::shared_ptr<boost::asio::deadline_timer> timer,
+                  const boost::system::error_code &ec)
+    {
+        // as the callback is not in tls context, so the log system calls like ddebug, dassert will
+        // cause a lock
+        if (!ec) {
+            calc();
+
+            timer->expires_from_now(
+                boost::posix_time::seconds(_counter_computation_interval_seconds));
+            timer->async_wait(std::bind(&perf_counter_number_percentile_histogram::on_timer,
+                                        this,
+                                        timer,
+                                        std::placeholders::_1));
+        } else if (boost::system::errc::operation_canceled != ec) {
+            dassert(false, "on_timer error!!!");
+        }
+    }
+
+    std::unique_ptr<std::atomic<int64_t>[]> _stripes[kStripeCount];
+    std::atomic<int64_t> _results[COUNTER_PERCENTILE_COUNT];
+    std::mutex _cumulative_lock;
+    histogram_snapshot _cumulative;
+    std::shared_ptr<boost::asio::deadline_timer> _timer;
+    int _counter_computation_interval_seconds;
+};
+
+} // namespace dsn
@@ -24,9 +24,14 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <regex>
+#include <fmt/format.h>
 
 #include <dsn/perf_counter/perf_counter.h>
+#include <dsn/perf_counter/perf_counter_block.h>
 #include <dsn/perf_counter/perf_counters.h>
 #include <dsn/perf_counter/perf_counter_utils.h>
 
@@ -35,16 +40,32 @@
 
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/task.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/string_view.h>
 #include <dsn/utils/time_utils.h>
 
 #include "perf_counter_atomic.h"
+#include "perf_counter_histogram.h"
 #include "builtin_counters.h"
 #include "runtime/service_engine.h"
 
 namespace dsn {
 
+DSN_DEFINE_bool("components.pegasus_perf_counter_number_percentile_atomic",
+                number_percentile_use_histogram,
+                true,
+                "whether the percentile counters record all the samples into log-bucketed "
+                "histograms, rather than keep the latest samples only");
+
+DSN_DEFINE_uint32("perf_counters",
+                  prometheus_snapshot_max_age_seconds,
+                  10,
+                  "a Prometheus scrape takes a new snapshot of the perf counters if the latest "
+                  "one is older than this");
+DSN_TAG_VARIABLE(prometheus_snapshot_max_age_seconds, FT_MUTABLE);
+
 perf_counters::perf_counters()
+    : _snapshot_version(0), _removed_untracked_version(0), _timestamp(0)
 {
     // make shared_io_service destructed after perf_counters,
     // because shared_io_service will destruct the timer created by perf_counters
@@ -131,6 +152,7 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
         if (it == _counters.end()) {
             perf_counter_ptr counter = new_counter(app, section, name, flags, dsptr);
             _counters.emplace(full_name, counter_object{counter, 1});
+            _all_counters.reset();
             return counter;
         } else {
             dassert(it->second.counter->type() == flags,
@@ -165,6 +187,7 @@ bool perf_counters::remove_counter(const char *full_name)
             remain_ref = (--c.user_reference);
             if (remain_ref == 0) {
                 _counters.erase(it);
+                _all_counters.reset();
             }
         }
     }
@@ -183,6 +206,47 @@ perf_counter_ptr perf_counters::get_counter(const std::string &full_name)
     return nullptr;
 }
 
+void perf_counters::register_block(perf_counter_block *block)
+{
+    utils::auto_write_lock l(_lock);
+    _blocks.insert(block);
+}
+
+void perf_counters::remove_block(perf_counter_block *block)
+{
+    utils::auto_write_lock l(_lock);
+    _blocks.erase(block);
+    if (!block->_counters.empty()) {
+        _block_counter_count -= block->_counters.size();
+        _all_counters.reset();
+    }
+}
+
+perf_counter_ptr perf_counters::get_block_counter(perf_counter_block *block,
+                                                  const char *name,
+                                                  dsn_perf_counter_type_t type)
+{
+    utils::auto_write_lock l(_lock);
+    auto it = block->_counters.find(name);
+    if (it != block->_counters.end()) {
+        dassert(it->second->type() == type,
+                "counters with the same name %s@%s with different types, (%d) vs (%d)",
+                name,
+                block->_label.c_str(),
+                it->second->type(),
+                type);
+        return it->second;
+    }
+
+    std::string full_name = fmt::format("{}@{}", name, block->_label);
+    perf_counter_ptr counter = new_counter(
+        block->_app.c_str(), block->_section.c_str(), full_name.c_str(), type, full_name.c_str());
+    block->_counters.emplace(name, counter);
+    ++_block_counter_count;
+    _all_counters.reset();
+    return counter;
+}
+
 perf_counter *perf_counters::new_counter(const char *app,
                                          const char *section,
                                          const char *name,
@@ -195,22 +259,36 @@ perf_counter *perf_counters::new_counter(const char *app,
         return new perf_counter_volatile_number_atomic(app, section, name, type, dsptr);
     else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_RATE)
         return new perf_counter_rate_atomic(app, section, name, type, dsptr);
-    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES)
+    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES) {
+        if (FLAGS_number_percentile_use_histogram) {
+            return new perf_counter_number_percentile_histogram(app, section, name, type, dsptr);
+        }
         return new perf_counter_number_percentile_atomic(app, section, name, type, dsptr);
+    }
     else {
         dassert(false, "invalid type(%d)", type);
         return nullptr;
     }
 }
 
-void perf_counters::get_all_counters(std::vector<perf_counter_ptr> *all) const
+std::shared_ptr<const std::vector<perf_counter_ptr>> perf_counters::get_all_counters() const
 {
-    all->clear();
     utils::auto_read_lock l(_lock);
-    all->reserve(_counters.size());
-    for (auto &p : _counters) {
-        all->push_back(p.second.counter);
+    std::lock_guard<std::mutex> guard(_all_counters_lock);
+    if (_all_counters == nullptr) {
+        auto all = std::make_shared<std::vector<perf_counter_ptr>>();
+        all->reserve(_counters.size() + _block_counter_count);
+        for (auto &p : _counters) {
+            all->push_back(p.second.counter);
+        }
+        for (const perf_counter_block *block : _blocks) {
+            for (const auto &p : block->_counters) {
+                all->push_back(p.second);
+            }
+        }
+        _all_counters = std::move(all);
     }
+    return _all_counters;
 }
 
 std::string perf_counters::list_snapshot_by_regexp(const std::vector<std::string> &args) const
@@ -299,47 +377,64 @@ void perf_counters::take_snapshot()
 {
     builtin_counters::instance().update_counters();
 
-    std::vector<perf_counter_ptr> all_counters;
-    get_all_counters(&all_counters);
+    std::shared_ptr<const std::vector<perf_counter_ptr>> all_counters = get_all_counters();
 
-    utils::auto_write_lock l(_snapshot_lock);
-    for (auto &p : _snapshots) {
-        p.second.updated_recently = false;
+    // read the values before locking the snapshots, so that the readers are blocked only for
+    // updating them
+    std::vector<std::pair<double, double>> values;
+    values.reserve(all_counters->size());
+    for (const perf_counter_ptr &c : *all_counters) {
+        if (c->type() != COUNTER_TYPE_NUMBER_PERCENTILES) {
+            values.emplace_back(c->get_value(), 0.0);
+        } else {
+            values.emplace_back(c->get_percentile(COUNTER_PERCENTILE_99),
+                                c->get_percentile(COUNTER_PERCENTILE_999));
+        }
     }
 
-    // updated counters from current value
-    for (const perf_counter_ptr &c : all_counters) {
-        counter_snapshot &cs = _snapshots[c->full_name()];
+    utils::auto_write_lock l(_snapshot_lock);
+    uint64_t version = ++_snapshot_version;
+    auto update = [this, version](std::string name, dsn_perf_counter_type_t type, double value) {
+        counter_snapshot &cs = _snapshots[name];
         if (cs.name.empty()) {
             // recently created counter, which wasn't in snapshot before
-            cs.name = c->full_name();
-            cs.type = c->type();
+            cs.name = std::move(name);
+            cs.type = type;
+            cs.value = value;
+            cs.version = version;
+        } else if (cs.value != value) {
+            cs.value = value;
+            cs.version = version;
         }
-        cs.updated_recently = true;
-        if (c->type() != COUNTER_TYPE_NUMBER_PERCENTILES) {
-            cs.value = c->get_value();
-        } else {
-            cs.value = c->get_percentile(COUNTER_PERCENTILE_99);
+        cs.seen_version = version;
+    };
 
+    // updated counters from current value
+    for (size_t i = 0; i < all_counters->size(); ++i) {
+        const perf_counter_ptr &c = (*all_counters)[i];
+        update(c->full_name(), c->type(), values[i].first);
+        if (c->type() == COUNTER_TYPE_NUMBER_PERCENTILES) {
             // take P999 metrics into account as well.
-            std::string name_p999 = std::string(c->full_name()) + ".p999";
-            counter_snapshot &cs999 = _snapshots[name_p999];
-            cs999.name = std::move(name_p999);
-            cs999.type = c->type();
-            cs999.updated_recently = true;
-            cs999.value = c->get_percentile(COUNTER_PERCENTILE_999);
+            update(std::string(c->full_name()) + ".p999", c->type(), values[i].second);
         }
     }
 
     _timestamp = dsn_now_ms() / 1000;
 
     // delete old counters
-    std::vector<std::string> old_counters;
-    for (auto &p : _snapshots)
-        if (!p.second.updated_recently)
-            old_counters.push_back(p.first);
-    for (const std::string &n : old_counters)
-        _snapshots.erase(n);
+    for (auto it = _snapshots.begin(); it != _snapshots.end();) {
+        if (it->second.seen_version != version) {
+            _removed_snapshots.emplace_back(version, it->first);
+            it = _snapshots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    while (!_removed_snapshots.empty() &&
+           _removed_snapshots.front().first + kMaxRemovedVersions <= version) {
+        _removed_untracked_version = _removed_snapshots.front().first;
+        _removed_snapshots.pop_front();
+    }
 }
 
 void perf_counters::iterate_snapshot(const snapshot_iterator &v) const
@@ -350,6 +445,39 @@ void perf_counters::iterate_snapshot(const snapshot_iterator &v) const
     }
 }
 
+uint64_t perf_counters::snapshot_version() const
+{
+    utils::auto_read_lock l(_snapshot_lock);
+    return _snapshot_version;
+}
+
+bool perf_counters::iterate_snapshot_since(uint64_t version,
+                                           const snapshot_iterator &v,
+                                           /*out*/ std::vector<std::string> *removed) const
+{
+    utils::auto_read_lock l(_snapshot_lock);
+    for (auto &kv : _snapshots) {
+        if (kv.second.version > version) {
+            v(kv.second);
+        }
+    }
+
+    if (version < _removed_untracked_version) {
+        return false;
+    }
+    if (removed != nullptr) {
+        for (auto it = _removed_snapshots.rbegin();
+             it != _removed_snapshots.rend() && it->first > version;
+             ++it) {
+            // skip the ones created again
+            if (_snapshots.find(it->second) == _snapshots.end()) {
+                removed->push_back(it->second);
+            }
+        }
+    }
+    return true;
+}
+
 void perf_counters::query_snapshot(const std::vector<std::string> &counters,
                                    const snapshot_iterator &v,
                                    std::vector<bool> *found) const
@@ -371,4 +499,234 @@ void perf_counters::query_snapshot(const std::vector<std::string> &counters,
     }
 }
 
+namespace {
+
+struct prometheus_metric
+{
+    std::string name;
+    std::string labels;
+    const char *type;
+    // the value of the counters other than the percentile ones
+    double value;
+    perf_counter_ptr counter;
+
+    bool operator<(const prometheus_metric &other) const
+    {
+        int r = name.compare(other.name);
+        return r != 0 ? r < 0 : strcmp(type, other.type) < 0;
+    }
+};
+
+// the names must match [a-zA-Z_:][a-zA-Z0-9_:]*, the other chars are replaced by '_'
+void append_prometheus_name(string_view name, /*out*/ std::string &out)
+{
+    for (size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = name[i];
+        bool valid = isalpha(c) || c == '_' || c == ':' || (i > 0 && isdigit(c));
+        out.push_back(valid ? c : '_');
+    }
+}
+
+void append_prometheus_label(const char *key, string_view value, /*out*/ std::string &out)
+{
+    if (!out.empty()) {
+        out.push_back(',');
+    }
+    out.append(key);
+    out.append("=\"");
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out.append("\\n");
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+bool is_digits(string_view s)
+{
+    return !s.empty() &&
+           std::all_of(s.begin(), s.end(), [](unsigned char c) { return isdigit(c); });
+}
+
+// splits the full name "app*section*name@tag" into the metric name and the labels, where the
+// tag is "<app_id>.<partition_index>" for a partition or else the name of a table
+prometheus_metric to_prometheus_metric(const std::string &full_name, const char *type)
+{
+    prometheus_metric m;
+    m.type = type;
+    m.value = 0;
+
+    size_t app_end = full_name.find('*');
+    size_t section_end = app_end == std::string::npos ? app_end : full_name.find('*', app_end + 1);
+    if (section_end == std::string::npos) {
+        append_prometheus_name(full_name, m.name);
+        return m;
+    }
+
+    size_t name_end = full_name.rfind('@');
+    if (name_end == std::string::npos || name_end < section_end) {
+        name_end = full_name.size();
+    }
+    append_prometheus_name(
+        string_view(full_name.data() + section_end + 1, name_end - section_end - 1), m.name);
+    append_prometheus_label("app", string_view(full_name.data(), app_end), m.labels);
+    append_prometheus_label(
+        "section",
+        string_view(full_name.data() + app_end + 1, section_end - app_end - 1),
+        m.labels);
+    if (name_end == full_name.size()) {
+        return m;
+    }
+
+    string_view tag(full_name.data() + name_end + 1, full_name.size() - name_end - 1);
+    size_t dot = full_name.find('.', name_end + 1);
+    if (dot != std::string::npos) {
+        string_view app_id(full_name.data() + name_end + 1, dot - name_end - 1);
+        string_view partition_index(full_name.data() + dot + 1, full_name.size() - dot - 1);
+        if (is_digits(app_id) && is_digits(partition_index)) {
+            append_prometheus_label("app_id", app_id, m.labels);
+            append_prometheus_label("partition_index", partition_index, m.labels);
+            return m;
+        }
+    }
+    append_prometheus_label("table", tag, m.labels);
+    return m;
+}
+
+void append_prometheus_sample(const std::string &name,
+                              const char *suffix,
+                              const std::string &labels,
+                              const std::string &extra_label,
+                              const std::string &value,
+                              /*out*/ std::string &out)
+{
+    out.append(name);
+    out.append(suffix);
+    if (!labels.empty() || !extra_label.empty()) {
+        out.push_back('{');
+        out.append(labels);
+        if (!labels.empty() && !extra_label.empty()) {
+            out.push_back(',');
+        }
+        out.append(extra_label);
+        out.push_back('}');
+    }
+    out.push_back(' ');
+    out.append(value);
+    out.push_back('\n');
+}
+
+// the histogram is exported with a bucket per power of two, rather than each of its buckets
+void append_prometheus_histogram(const std::string &name,
+                                 const prometheus_metric &m,
+                                 const histogram_snapshot &snapshot,
+                                 /*out*/ std::string &out)
+{
+    using layout = log_histogram_layout;
+    int64_t count = 0;
+    std::string le;
+    for (int i = 0; i < layout::kBucketCount - layout::kSubBucketCount; ++i) {
+        count += snapshot.bucket_count(i);
+        if (i % layout::kSubBucketCount == layout::kSubBucketCount - 1) {
+            le = "le=\"" + std::to_string(layout::bucket_upper_bound(i)) + "\"";
+            append_prometheus_sample(name, "_bucket", m.labels, le, std::to_string(count), out);
+        }
+    }
+    append_prometheus_sample(
+        name, "_bucket", m.labels, "le=\"+Inf\"", std::to_string(snapshot.total_count()), out);
+    append_prometheus_sample(name, "_sum", m.labels, "", std::to_string(snapshot.sum()), out);
+    append_prometheus_sample(
+        name, "_count", m.labels, "", std::to_string(snapshot.total_count()), out);
+}
+
+void append_prometheus_summary(const std::string &name,
+                               const prometheus_metric &m,
+                               /*out*/ std::string &out)
+{
+    static const char *quantiles[COUNTER_PERCENTILE_COUNT] = {
+        "quantile=\"0.5\"",
+        "quantile=\"0.9\"",
+        "quantile=\"0.95\"",
+        "quantile=\"0.99\"",
+        "quantile=\"0.999\""};
+    for (int i = 0; i < COUNTER_PERCENTILE_COUNT; ++i) {
+        double value =
+            m.counter->get_percentile(static_cast<dsn_perf_counter_percentile_type_t>(i));
+        append_prometheus_sample(name, "", m.labels, quantiles[i], fmt::format("{}", value), out);
+    }
+}
+
+} // anonymous namespace
+
+void perf_counters::dump_prometheus(/*out*/ std::string &out)
+{
+    int64_t timestamp;
+    {
+        utils::auto_read_lock l(_snapshot_lock);
+        timestamp = _timestamp;
+    }
+    if (dsn_now_ms() / 1000 - timestamp >= FLAGS_prometheus_snapshot_max_age_seconds) {
+        take_snapshot();
+    }
+
+    std::vector<prometheus_metric> metrics;
+    {
+        utils::auto_read_lock l(_snapshot_lock);
+        metrics.reserve(_snapshots.size());
+        for (const auto &kv : _snapshots) {
+            // the percentiles are read from the counters below
+            if (kv.second.type != COUNTER_TYPE_NUMBER_PERCENTILES) {
+                metrics.emplace_back(to_prometheus_metric(kv.first, "gauge"));
+                metrics.back().value = kv.second.value;
+            }
+        }
+    }
+
+    std::shared_ptr<const std::vector<perf_counter_ptr>> all_counters = get_all_counters();
+    for (const perf_counter_ptr &c : *all_counters) {
+        if (c->type() == COUNTER_TYPE_NUMBER_PERCENTILES) {
+            bool is_histogram =
+                dynamic_cast<perf_counter_number_percentile_histogram *>(c.get()) != nullptr;
+            metrics.emplace_back(
+                to_prometheus_metric(c->full_name(), is_histogram ? "histogram" : "summary"));
+            metrics.back().counter = c;
+        }
+    }
+
+    // the samples of a metric must be grouped together after its TYPE line
+    std::sort(metrics.begin(), metrics.end());
+
+    out.reserve(out.size() + metrics.size() * 128);
+    std::string name;
+    const prometheus_metric *last = nullptr;
+    for (const prometheus_metric &m : metrics) {
+        if (m.name.empty()) {
+            continue;
+        }
+        if (last == nullptr || last->name != m.name || strcmp(last->type, m.type) != 0) {
+            // a name shared by the counters of different types are told apart by a suffix
+            name = m.name;
+            if (last != nullptr && last->name == m.name) {
+                name.append("_").append(m.type);
+            }
+            out.append("# TYPE ").append(name).append(" ").append(m.type).append("\n");
+            last = &m;
+        }
+
+        if (m.counter == nullptr) {
+            append_prometheus_sample(name, "", m.labels, "", fmt::format("{}", m.value), out);
+        } else if (strcmp(m.type, "histogram") == 0) {
+            auto *c = static_cast<perf_counter_number_percentile_histogram *>(m.counter.get());
+            append_prometheus_histogram(name, m, c->get_cumulative(), out);
+        } else {
+            append_prometheus_summary(name, m, out);
+        }
+    }
+}
+
 } // namespace dsn
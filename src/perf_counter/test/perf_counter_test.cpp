@@ -40,6 +40,7 @@
 #include <vector>
 
 #include "perf_counter/perf_counter_atomic.h"
+#include "perf_counter/perf_counter_histogram.h"
 
 using namespace dsn;
 using namespace dsn::tools;
@@ -125,6 +126,106 @@ TEST(perf_counter, perf_counter_atomic)
     }
 }
 
+TEST(perf_counter, striped_counter_concurrent_add)
+{
+    // more threads than the stripes, so that some of them share a stripe
+    const int thread_count = 32;
+    const int increments = 100000;
+
+    perf_counter_ptr counter = new perf_counter_number_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER, "");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&counter, increments]() {
+            for (int j = 0; j < increments; ++j) {
+                counter->increment();
+                counter->add(3);
+                counter->decrement();
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(static_cast<int64_t>(thread_count) * increments * 3,
+              counter->get_integer_value());
+}
+
+TEST(perf_counter, log_histogram_layout)
+{
+    using layout = log_histogram_layout;
+    // the small values are told exactly
+    for (int64_t v = 0; v <= layout::kSubBucketCount * 2; ++v) {
+        ASSERT_EQ(v, layout::bucket_upper_bound(layout::bucket_index(v)));
+    }
+    ASSERT_EQ(0, layout::bucket_index(-1));
+
+    // the others are told within 1/kSubBucketCount of themselves
+    for (int64_t v : {1000L, 123456L, 999999999L, (1L << layout::kMaxValueBits) - 1}) {
+        int64_t upper = layout::bucket_upper_bound(layout::bucket_index(v));
+        ASSERT_GE(upper, v);
+        ASSERT_LE(upper - v, v / layout::kSubBucketCount);
+    }
+    ASSERT_EQ(layout::kBucketCount - 1, layout::bucket_index(1L << layout::kMaxValueBits));
+    ASSERT_EQ(layout::kBucketCount - 1, layout::bucket_index(INT64_MAX));
+}
+
+TEST(perf_counter, histogram_snapshot)
+{
+    histogram_snapshot empty;
+    ASSERT_EQ(0, empty.value_at(0.99));
+
+    histogram_snapshot odd, even, all;
+    for (int64_t v = 1; v <= 100000; ++v) {
+        (v % 2 ? odd : even).record(v);
+        all.record(v);
+    }
+    odd.merge(even);
+    ASSERT_EQ(all.total_count(), odd.total_count());
+
+    for (double ratio : {0.5, 0.9, 0.99, 0.999}) {
+        int64_t expected = static_cast<int64_t>(ratio * 100000) + 1;
+        int64_t value = all.value_at(ratio);
+        ASSERT_EQ(value, odd.value_at(ratio));
+        ASSERT_GE(value, expected);
+        ASSERT_LE(value - expected, expected / log_histogram_layout::kSubBucketCount);
+    }
+}
+
+TEST(perf_counter, perf_counter_number_percentile_histogram)
+{
+    ref_ptr<perf_counter_number_percentile_histogram> counter =
+        new perf_counter_number_percentile_histogram(
+            "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "");
+
+    // the samples of all threads over the whole interval are counted
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([counter, t]() {
+            for (int64_t v = t + 1; v <= 100000; v += 4) {
+                counter->set(v);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    counter->calc();
+    double p999 = counter->get_percentile(COUNTER_PERCENTILE_999);
+    ASSERT_GE(p999, 99901);
+    ASSERT_LE(p999, 99901 + 99901 / log_histogram_layout::kSubBucketCount);
+
+    // the percentiles are kept over an interval without samples
+    counter->calc();
+    ASSERT_EQ(p999, counter->get_percentile(COUNTER_PERCENTILE_999));
+
+    // the samples of the last interval are drained
+    counter->set(10);
+    counter->calc();
+    ASSERT_EQ(10, counter->get_percentile(COUNTER_PERCENTILE_50));
+    ASSERT_EQ(10, counter->get_percentile(COUNTER_PERCENTILE_999));
+}
+
 TEST(perf_counter, print_type)
 {
     ASSERT_STREQ("NUMBER", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER));
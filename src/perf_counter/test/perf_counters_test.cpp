@@ -34,6 +34,7 @@
  */
 
 #include <dsn/perf_counter/perf_counters.h>
+#include <dsn/perf_counter/perf_counter_block.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/perf_counter/perf_counter_utils.h>
 #include <gtest/gtest.h>
@@ -347,3 +348,90 @@ TEST(perf_counters_test, get_by_fullname)
         }
     }
 }
+
+TEST(perf_counters_test, snapshot_since_version)
+{
+    dsn::perf_counter_wrapper changed;
+    changed.init_global_counter("delta", "s", "changed", COUNTER_TYPE_NUMBER, "");
+    dsn::perf_counter_wrapper unchanged;
+    unchanged.init_global_counter("delta", "s", "unchanged", COUNTER_TYPE_NUMBER, "");
+    dsn::perf_counter_wrapper removed;
+    removed.init_global_counter("delta", "s", "removed", COUNTER_TYPE_NUMBER, "");
+
+    perf_counters::instance().take_snapshot();
+    uint64_t version = perf_counters::instance().snapshot_version();
+
+    std::map<std::string, double> visited;
+    std::vector<std::string> removed_names;
+    perf_counters::snapshot_iterator iter = [&visited](const perf_counters::counter_snapshot &cs) {
+        visited.emplace(cs.name, cs.value);
+    };
+
+    // nothing of ours is changed since the snapshot itself
+    ASSERT_TRUE(perf_counters::instance().iterate_snapshot_since(version, iter, &removed_names));
+    ASSERT_EQ(0, visited.count("delta*s*changed"));
+    ASSERT_EQ(0, visited.count("delta*s*unchanged"));
+
+    changed->set(10);
+    removed.clear();
+    dsn::perf_counter_wrapper created;
+    created.init_global_counter("delta", "s", "created", COUNTER_TYPE_NUMBER, "");
+    perf_counters::instance().take_snapshot();
+    ASSERT_EQ(version + 1, perf_counters::instance().snapshot_version());
+
+    visited.clear();
+    ASSERT_TRUE(perf_counters::instance().iterate_snapshot_since(version, iter, &removed_names));
+    ASSERT_EQ(10, visited["delta*s*changed"]);
+    ASSERT_EQ(1, visited.count("delta*s*created"));
+    ASSERT_EQ(0, visited.count("delta*s*unchanged"));
+    ASSERT_EQ(std::vector<std::string>({"delta*s*removed"}), removed_names);
+
+    // the removed counters are told only if the version is recent enough
+    uint64_t latest = perf_counters::instance().snapshot_version();
+    for (int i = 0; i < 100; ++i) {
+        perf_counters::instance().take_snapshot();
+    }
+    removed_names.clear();
+    ASSERT_TRUE(perf_counters::instance().iterate_snapshot_since(latest, iter, &removed_names));
+    ASSERT_TRUE(removed_names.empty());
+    ASSERT_FALSE(perf_counters::instance().iterate_snapshot_since(version, iter, &removed_names));
+}
+
+TEST(perf_counters_test, counter_block)
+{
+    std::map<std::string, double> visited;
+    perf_counters::snapshot_iterator iter = [&visited](const perf_counters::counter_snapshot &cs) {
+        visited.emplace(cs.name, cs.value);
+    };
+
+    {
+        perf_counter_block block("block", "s", "1.2");
+        lazy_perf_counter updated;
+        updated.init(&block, "updated", COUNTER_TYPE_NUMBER);
+        lazy_perf_counter zero;
+        zero.init(&block, "zero", COUNTER_TYPE_NUMBER);
+        lazy_perf_counter never;
+        never.init(&block, "never", COUNTER_TYPE_VOLATILE_NUMBER);
+
+        // the counters are created on their first non-zero update
+        zero.set(0);
+        zero.add(0);
+        ASSERT_EQ(nullptr, zero.get());
+        updated.set(10);
+        updated.increment();
+        ASSERT_NE(nullptr, updated.get());
+        ASSERT_EQ(updated.get(), block.get_counter("updated", COUNTER_TYPE_NUMBER).get());
+
+        perf_counters::instance().take_snapshot();
+        perf_counters::instance().iterate_snapshot(iter);
+        ASSERT_EQ(11, visited["block*s*updated@1.2"]);
+        ASSERT_EQ(0, visited.count("block*s*zero@1.2"));
+        ASSERT_EQ(0, visited.count("block*s*never@1.2"));
+    }
+
+    // the counters are removed together with the block
+    visited.clear();
+    perf_counters::instance().take_snapshot();
+    perf_counters::instance().iterate_snapshot(iter);
+    ASSERT_EQ(0, visited.count("block*s*updated@1.2"));
+}
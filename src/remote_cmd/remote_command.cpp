@@ -7,6 +7,9 @@
 #include <dsn/cpp/rpc_holder.h>
 #include <dsn/c/api_layer1.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/utility/synchronize.h>
+#include <atomic>
+#include <nlohmann/json.hpp>
 
 #include "command_types.h"
 
@@ -33,6 +36,117 @@ task_ptr async_call_remote(rpc_address remote,
     });
 }
 
+namespace {
+
+struct fanout_context
+{
+    std::vector<rpc_address> remotes;
+    std::string cmd;
+    std::vector<std::string> arguments;
+    std::chrono::milliseconds timeout;
+    std::function<void(std::vector<remote_command_result>)> callback;
+
+    std::vector<remote_command_result> results;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+};
+
+// each chain of calls goes on to the next remote when the current one is done, so the count of
+// chains bounds the calls in flight
+void call_next_remote(const std::shared_ptr<fanout_context> &ctx)
+{
+    size_t i = ctx->next.fetch_add(1);
+    if (i >= ctx->remotes.size()) {
+        return;
+    }
+    async_call_remote(ctx->remotes[i],
+                      ctx->cmd,
+                      ctx->arguments,
+                      [ctx, i](error_code ec, const std::string &output) {
+                          remote_command_result &result = ctx->results[i];
+                          result.err = ec;
+                          if (ec == ERR_OK) {
+                              result.output = output;
+                          }
+                          if (ctx->done.fetch_add(1) + 1 == ctx->remotes.size()) {
+                              ctx->callback(std::move(ctx->results));
+                              return;
+                          }
+                          call_next_remote(ctx);
+                      },
+                      ctx->timeout);
+}
+
+} // anonymous namespace
+
+void async_call_remote_fanout(const std::vector<rpc_address> &remotes,
+                              const std::string &cmd,
+                              const std::vector<std::string> &arguments,
+                              uint32_t concurrency,
+                              std::chrono::milliseconds timeout,
+                              std::function<void(std::vector<remote_command_result>)> callback)
+{
+    if (remotes.empty()) {
+        callback({});
+        return;
+    }
+
+    auto ctx = std::make_shared<fanout_context>();
+    ctx->remotes = remotes;
+    ctx->cmd = cmd;
+    ctx->arguments = arguments;
+    ctx->timeout = timeout;
+    ctx->callback = std::move(callback);
+    ctx->results.resize(remotes.size());
+    for (size_t i = 0; i < remotes.size(); ++i) {
+        ctx->results[i].node = remotes[i];
+    }
+
+    size_t chains = std::min<size_t>(std::max<uint32_t>(concurrency, 1), remotes.size());
+    for (size_t i = 0; i < chains; ++i) {
+        call_next_remote(ctx);
+    }
+}
+
+std::vector<remote_command_result> call_remote_fanout(const std::vector<rpc_address> &remotes,
+                                                      const std::string &cmd,
+                                                      const std::vector<std::string> &arguments,
+                                                      uint32_t concurrency,
+                                                      std::chrono::milliseconds timeout)
+{
+    std::vector<remote_command_result> results;
+    utils::notify_event done;
+    async_call_remote_fanout(remotes,
+                             cmd,
+                             arguments,
+                             concurrency,
+                             timeout,
+                             [&results, &done](std::vector<remote_command_result> r) {
+                                 results = std::move(r);
+                                 done.notify();
+                             });
+    done.wait();
+    return results;
+}
+
+std::string merge_remote_command_results(const std::vector<remote_command_result> &results,
+                                         bool pretty)
+{
+    nlohmann::json merged = nlohmann::json::object();
+    for (const remote_command_result &result : results) {
+        nlohmann::json &node = merged[result.node.to_std_string()];
+        if (result.err != ERR_OK) {
+            node["error"] = result.err.to_string();
+            continue;
+        }
+        node = nlohmann::json::parse(result.output, nullptr, false);
+        if (node.is_discarded()) {
+            node = result.output;
+        }
+    }
+    return merged.dump(pretty ? 4 : -1);
+}
+
 bool register_remote_command_rpc()
 {
     rpc_request_handler cb = [](dsn::message_ex *msg) {
@@ -0,0 +1,207 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "async_file_deleter.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                async_file_deletion_enabled,
+                false,
+                "whether to delete the garbage log files, the garbage replica dirs and the "
+                "learned checkpoints in the background at a limited rate");
+DSN_DEFINE_uint32("replication",
+                  async_file_deletion_rate_mb_per_disk,
+                  64,
+                  "max bytes in MB per second deleted on each disk by the async file deleter");
+DSN_DEFINE_validator(async_file_deletion_rate_mb_per_disk, [](uint32_t value) -> bool {
+    return value > 0;
+});
+
+const std::string async_file_deleter::kTrashDirName = ".trash";
+
+// the budget is handed out in this many rounds per second
+static const int kReleaseRoundsPerSecond = 10;
+
+/*static*/ bool async_file_deleter::enabled() { return FLAGS_async_file_deletion_enabled; }
+
+async_file_deleter::~async_file_deleter() { _tracker.cancel_outstanding_tasks(); }
+
+bool async_file_deleter::remove_path(const std::string &path)
+{
+    if (!enabled() || !utils::filesystem::path_exists(path)) {
+        return utils::filesystem::remove_path(path);
+    }
+
+    std::string trash_dir = utils::filesystem::path_combine(
+        utils::filesystem::remove_file_name(path), kTrashDirName);
+    struct stat st;
+    if (!utils::filesystem::create_directory(trash_dir) || ::stat(trash_dir.c_str(), &st) != 0) {
+        dwarn_f("create trash dir {} failed, remove {} in place", trash_dir, path);
+        return utils::filesystem::remove_path(path);
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    std::string trash_path = utils::filesystem::path_combine(
+        trash_dir, fmt::format("{}.{}", utils::filesystem::get_file_name(path), _next_id++));
+
+    // the leftovers of the previous runs go first
+    enqueue_trash_entries(trash_dir, st.st_dev);
+
+    if (!utils::filesystem::rename_path(path, trash_path)) {
+        dwarn_f("move {} to {} failed, remove it in place", path, trash_path);
+        return utils::filesystem::remove_path(path);
+    }
+    _pending[st.st_dev].emplace_back(trash_path);
+    ddebug_f("moved {} to {} to delete in background", path, trash_path);
+
+    if (_timer_task == nullptr) {
+        _timer_task = tasking::enqueue_timer(
+            LPC_ASYNC_FILE_DELETION,
+            &_tracker,
+            [this]() {
+                release(FLAGS_async_file_deletion_rate_mb_per_disk * 1024 * 1024 /
+                        kReleaseRoundsPerSecond);
+            },
+            std::chrono::milliseconds(1000 / kReleaseRoundsPerSecond));
+    }
+    return true;
+}
+
+void async_file_deleter::enqueue_trash_entries(const std::string &trash_dir, dev_t dev)
+{
+    if (!_trash_dirs.insert(trash_dir).second) {
+        return;
+    }
+
+    std::vector<std::string> entries;
+    if (!utils::filesystem::get_subfiles(trash_dir, entries, false) ||
+        !utils::filesystem::get_subdirectories(trash_dir, entries, false)) {
+        dwarn_f("list trash dir {} failed", trash_dir);
+        return;
+    }
+    for (auto &e : entries) {
+        _pending[dev].emplace_back(std::move(e));
+    }
+}
+
+size_t async_file_deleter::pending_count() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    size_t count = 0;
+    for (const auto &kv : _pending) {
+        count += kv.second.size();
+    }
+    return count;
+}
+
+void async_file_deleter::release(int64_t budget_bytes)
+{
+    std::lock_guard<std::mutex> release_guard(_release_lock);
+    std::vector<dev_t> devs;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        for (const auto &kv : _pending) {
+            devs.emplace_back(kv.first);
+        }
+    }
+
+    for (dev_t dev : devs) {
+        int64_t budget = budget_bytes;
+        while (budget > 0) {
+            std::string path;
+            {
+                std::lock_guard<std::mutex> l(_lock);
+                auto &paths = _pending[dev];
+                if (paths.empty()) {
+                    break;
+                }
+                path = paths.front();
+            }
+
+            // only release() pops the queues, so the front stays the same
+            bool done = false;
+            budget -= release_path(path, budget, done);
+            if (!done) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> l(_lock);
+            _pending[dev].pop_front();
+        }
+    }
+}
+
+/*static*/ int64_t
+async_file_deleter::release_path(const std::string &path, int64_t budget_bytes, bool &done)
+{
+    done = false;
+    if (utils::filesystem::directory_exists(path)) {
+        // the files first, then the emptied dirs at once
+        std::vector<std::string> files;
+        utils::filesystem::get_subfiles(path, files, true);
+        int64_t released = 0;
+        for (const auto &f : files) {
+            bool file_done = false;
+            released += release_path(f, budget_bytes - released, file_done);
+            if (!file_done) {
+                return released;
+            }
+        }
+        if (!utils::filesystem::remove_path(path)) {
+            derror_f("remove dir {} failed", path);
+        }
+        done = true;
+        return released;
+    }
+
+    int64_t size = 0;
+    if (!utils::filesystem::file_size(path, size)) {
+        // removed by someone else
+        done = true;
+        return 0;
+    }
+
+    int64_t new_size = std::max<int64_t>(0, size - budget_bytes);
+    if (new_size > 0) {
+        if (::truncate(path.c_str(), new_size) == 0) {
+            return size - new_size;
+        }
+        dwarn_f("truncate file {} to {} failed, err = {}",
+                path,
+                new_size,
+                utils::safe_strerror(errno));
+    }
+    if (!utils::filesystem::remove_path(path)) {
+        derror_f("remove file {} failed", path);
+    }
+    done = true;
+    return size;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/singleton.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/types.h>
+
+namespace dsn {
+namespace replication {
+
+// async_file_deleter removes files and dirs in the background, so that deleting many large
+// files at once doesn't stall the writes on the same disk.
+//
+// With [replication] async_file_deletion_enabled, remove_path() moves the path into the
+// `.trash` dir next to it, which is neither a log file nor a replica dir to any scanner, and
+// the files are truncated chunk by chunk at no more than async_file_deletion_rate_mb_per_disk
+// per disk before being unlinked. The entries left in a trash dir by a previous run are
+// deleted once the dir is used again.
+//
+// All the methods are thread-safe.
+class async_file_deleter : public utils::singleton<async_file_deleter>
+{
+public:
+    static const std::string kTrashDirName;
+
+    static bool enabled();
+
+    // Removes the file or dir at `path`, in the background if enabled, otherwise
+    // in place like utils::filesystem::remove_path().
+    // Returns false if `path` could not be removed or moved away.
+    bool remove_path(const std::string &path);
+
+    size_t pending_count() const;
+
+    // Deletes at most `budget_bytes` bytes queued on each disk, called by the timer.
+    void release(int64_t budget_bytes);
+
+private:
+    friend class utils::singleton<async_file_deleter>;
+
+    async_file_deleter() = default;
+    ~async_file_deleter();
+
+    void enqueue_trash_entries(const std::string &trash_dir, dev_t dev);
+
+    // return the bytes released from `path`, set `done` if it is removed
+    static int64_t release_path(const std::string &path, int64_t budget_bytes, bool &done);
+
+private:
+    std::mutex _release_lock; // only one release() at a time, which pops the queues
+    mutable std::mutex _lock;
+    uint64_t _next_id{0};
+    std::set<std::string> _trash_dirs;
+    std::map<dev_t, std::deque<std::string>> _pending; // device -> paths in the trash dirs
+
+    task_tracker _tracker;
+    task_ptr _timer_task;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -21,6 +21,7 @@
 #include "replica/replica_stub.h"
 #include "block_service/block_service_manager.h"
 
+#include <dsn/tool-api/background_io_limiter.h>
 #include <dsn/utility/filesystem.h>
 
 namespace dsn {
@@ -607,25 +608,140 @@ void cold_backup_context::prepare_upload()
     _metadata.checkpoint_decree = checkpoint_decree;
     _metadata.checkpoint_timestamp = checkpoint_timestamp;
     _metadata.checkpoint_total_size = checkpoint_file_total_size;
+    // the md5 of a file is calculated by the upload as the file is read, or before it only if
+    // the file may be the same as a remote one, see local_file_md5()
     for (int32_t idx = 0; idx < checkpoint_files.size(); idx++) {
         std::string &file = checkpoint_files[idx];
         file_meta f_meta;
         f_meta.name = file;
-        std::string file_full_path = ::dsn::utils::filesystem::path_combine(checkpoint_dir, file);
         int64_t file_size = checkpoint_file_sizes[idx];
-        std::string file_md5;
-        if (::dsn::utils::filesystem::md5sum(file_full_path, file_md5) != ERR_OK) {
-            derror("%s: get local file size or md5 fail, file = %s", name, file_full_path.c_str());
-            fail_upload("compute local file size or md5 failed");
-            return;
-        }
-        f_meta.md5 = file_md5;
         f_meta.size = file_size;
         _metadata.files.emplace_back(f_meta);
         _file_status.insert(std::make_pair(file, FileUploadUncomplete));
-        _file_infos.insert(std::make_pair(file, std::make_pair(file_size, file_md5)));
+        _file_infos.insert(std::make_pair(file, std::make_pair(file_size, std::string())));
     }
     _upload_file_size.store(0);
+
+    if (request.__isset.prev_backup_id) {
+        reference_unchanged_files();
+    }
+}
+
+const std::string *cold_backup_context::local_file_md5(const std::string &local_filename)
+{
+    std::string &md5 = _file_infos.at(local_filename).second;
+    if (md5.empty()) {
+        std::string file_full_path =
+            ::dsn::utils::filesystem::path_combine(checkpoint_dir, local_filename);
+        if (::dsn::utils::filesystem::md5sum(file_full_path, md5) != ERR_OK) {
+            derror("%s: get local file md5 fail, file = %s", name, file_full_path.c_str());
+            md5.clear();
+            return nullptr;
+        }
+    }
+    return &md5;
+}
+
+bool cold_backup_context::read_remote_file(const std::string &remote_file, blob &content)
+{
+    dist::block_service::create_file_response create_resp;
+    block_service
+        ->create_file(dist::block_service::create_file_request{remote_file, false},
+                      TASK_CODE_EXEC_INLINED,
+                      [&create_resp](const dist::block_service::create_file_response &resp) {
+                          create_resp = resp;
+                      })
+        ->wait();
+    if (create_resp.err != ERR_OK || create_resp.file_handle->get_size() <= 0) {
+        dwarn("%s: open remote file(%s) failed, err = %s",
+              name,
+              remote_file.c_str(),
+              create_resp.err.to_string());
+        return false;
+    }
+
+    dist::block_service::read_response read_resp;
+    create_resp.file_handle
+        ->read(dist::block_service::read_request{0, -1},
+               TASK_CODE_EXEC_INLINED,
+               [&read_resp](const dist::block_service::read_response &resp) { read_resp = resp; })
+        ->wait();
+    if (read_resp.err != ERR_OK) {
+        dwarn("%s: read remote file(%s) failed, err = %s",
+              name,
+              remote_file.c_str(),
+              read_resp.err.to_string());
+        return false;
+    }
+    content = read_resp.buffer;
+    return true;
+}
+
+void cold_backup_context::reference_unchanged_files()
+{
+    const int64_t prev_backup_id = request.prev_backup_id;
+    blob content;
+    if (!read_remote_file(cold_backup::get_current_chkpt_file(
+                              backup_root, request.app_name, request.pid, prev_backup_id),
+                          content)) {
+        dwarn("%s: previous backup(%" PRId64 ") isn't available, upload all the files",
+              name,
+              prev_backup_id);
+        return;
+    }
+    cold_backup_file_location prev_location;
+    prev_location.backup_id = prev_backup_id;
+    prev_location.chkpt_dirname = content.to_string();
+
+    cold_backup_metadata prev_metadata;
+    std::string prev_chkpt_dir = ::dsn::utils::filesystem::path_combine(
+        cold_backup::get_replica_backup_path(
+            backup_root, request.app_name, request.pid, prev_backup_id),
+        prev_location.chkpt_dirname);
+    if (!read_remote_file(
+            ::dsn::utils::filesystem::path_combine(prev_chkpt_dir,
+                                                   cold_backup_constant::BACKUP_METADATA),
+            content) ||
+        !json::json_forwarder<cold_backup_metadata>::decode(content, prev_metadata)) {
+        dwarn("%s: read backup metadata of previous backup(%" PRId64 ") failed, upload all "
+              "the files",
+              name,
+              prev_backup_id);
+        return;
+    }
+
+    // the immutable files with the same size and md5 are not uploaded again
+    int32_t referenced_count = 0;
+    int64_t referenced_size = 0;
+    for (const file_meta &prev_file : prev_metadata.files) {
+        auto info = _file_infos.find(prev_file.name);
+        if (info == _file_infos.end() || info->second.first != prev_file.size) {
+            continue;
+        }
+        const std::string *md5 = local_file_md5(prev_file.name);
+        if (md5 == nullptr) {
+            fail_upload("compute local file md5 failed");
+            return;
+        }
+        if (*md5 != prev_file.md5) {
+            continue;
+        }
+        auto prev_ref = prev_metadata.referenced_files.find(prev_file.name);
+        _metadata.referenced_files[prev_file.name] =
+            prev_ref != prev_metadata.referenced_files.end() ? prev_ref->second : prev_location;
+        _file_status[prev_file.name] = FileUploadComplete;
+        _file_remain_cnt -= 1;
+        referenced_count += 1;
+        referenced_size += prev_file.size;
+    }
+    _upload_file_size.store(referenced_size);
+    ddebug("%s: reference %d unchanged files(%" PRId64 " bytes) of previous backup(%" PRId64
+           "), %d files are left to upload",
+           name,
+           referenced_count,
+           referenced_size,
+           prev_backup_id,
+           _file_remain_cnt);
 }
 
 void cold_backup_context::upload_file(const std::string &local_filename)
@@ -646,11 +762,16 @@ void cold_backup_context::upload_file(const std::string &local_filename)
                 const dist::block_service::block_file_ptr &file_handle = resp.file_handle;
                 dassert(file_handle != nullptr, "");
                 int64_t local_file_size = _file_infos.at(local_filename).first;
-                std::string md5 = _file_infos.at(local_filename).second;
                 std::string full_path_local_file =
                     ::dsn::utils::filesystem::path_combine(checkpoint_dir, local_filename);
-                if (md5 == file_handle->get_md5sum() &&
-                    local_file_size == file_handle->get_size()) {
+                // the local md5 is calculated only if the remote file may be the same, otherwise
+                // it's calculated by the upload
+                const std::string *md5 = nullptr;
+                if (local_file_size == file_handle->get_size() &&
+                    !file_handle->get_md5sum().empty()) {
+                    md5 = local_file_md5(local_filename);
+                }
+                if (md5 != nullptr && *md5 == file_handle->get_md5sum()) {
                     ddebug("%s: checkpoint file already exist on remote, file = %s",
                            name,
                            full_path_local_file.c_str());
@@ -659,7 +780,21 @@ void cold_backup_context::upload_file(const std::string &local_filename)
                     ddebug("%s: start upload checkpoint file to remote, file = %s",
                            name,
                            full_path_local_file.c_str());
-                    on_upload(file_handle, full_path_local_file);
+                    std::chrono::milliseconds delay = background_io_limiter::instance().acquire(
+                        checkpoint_dir, background_io_class::backup, local_file_size);
+                    if (delay.count() > 0) {
+                        add_ref();
+                        tasking::enqueue(LPC_BACKGROUND_COLD_BACKUP,
+                                         nullptr,
+                                         [this, file_handle, full_path_local_file]() {
+                                             on_upload(file_handle, full_path_local_file);
+                                             release_ref();
+                                         },
+                                         0,
+                                         delay);
+                    } else {
+                        on_upload(file_handle, full_path_local_file);
+                    }
                 }
             } else if (resp.err == ERR_TIMEOUT) {
                 derror("%s: block service create file timeout, retry after 10s, file = %s",
@@ -728,12 +863,19 @@ void cold_backup_context::on_upload(const dist::block_service::block_file_ptr &f
             if (resp.err == ERR_OK) {
                 std::string local_filename =
                     ::dsn::utils::filesystem::get_file_name(full_path_local_file);
-                dassert(_file_infos.at(local_filename).first ==
-                            static_cast<int64_t>(resp.uploaded_size),
-                        "");
+                std::pair<int64_t, std::string> &info = _file_infos.at(local_filename);
+                dassert(info.first == static_cast<int64_t>(resp.uploaded_size), "");
                 ddebug("%s: upload checkpoint file complete, file = %s",
                        name,
                        full_path_local_file.c_str());
+                if (!resp.md5.empty()) {
+                    info.second = resp.md5;
+                } else if (local_file_md5(local_filename) == nullptr) {
+                    // the block service doesn't calculate the md5 for the upload
+                    fail_upload("compute local file md5 failed");
+                    release_ref();
+                    return;
+                }
                 on_upload_file_complete(local_filename);
             } else if (resp.err == ERR_TIMEOUT) {
                 derror("%s: upload checkpoint file timeout, retry after 10s, file = %s",
@@ -797,6 +939,10 @@ void cold_backup_context::write_backup_metadata()
         [this, metadata](const dist::block_service::create_file_response &resp) {
             if (resp.err == ERR_OK) {
                 dassert(resp.file_handle != nullptr, "");
+                // all the files are uploaded or referenced, whose md5 are known now
+                for (file_meta &f_meta : _metadata.files) {
+                    f_meta.md5 = _file_infos.at(f_meta.name).second;
+                }
                 blob buffer = json::json_forwarder<cold_backup_metadata>::encode(_metadata);
                 // hold itself until callback is executed
                 add_ref();
@@ -71,13 +71,26 @@ enum cold_backup_status
 };
 const char *cold_backup_status_to_string(cold_backup_status status);
 
+// where a file of an incremental backup was uploaded:
+//      <root>/<backup_id>/<appname_appid>/<partition_index>/<chkpt_dirname>
+struct cold_backup_file_location
+{
+    int64_t backup_id;
+    std::string chkpt_dirname;
+    DEFINE_JSON_SERIALIZATION(backup_id, chkpt_dirname)
+};
+
 struct cold_backup_metadata
 {
     int64_t checkpoint_decree;
     int64_t checkpoint_timestamp;
     std::vector<file_meta> files;
     int64_t checkpoint_total_size;
-    DEFINE_JSON_SERIALIZATION(checkpoint_decree, checkpoint_timestamp, files, checkpoint_total_size)
+    // the files in `files` which were not uploaded under this checkpoint dir, because they
+    // were unchanged since a previous backup
+    std::map<std::string, cold_backup_file_location> referenced_files;
+    DEFINE_JSON_SERIALIZATION(
+        checkpoint_decree, checkpoint_timestamp, files, checkpoint_total_size, referenced_files)
 };
 
 //
@@ -290,6 +303,14 @@ private:
                   const blob &value,
                   const std::function<void(bool)> &callback);
     void prepare_upload();
+    // for incremental backup, marks the files unchanged since the previous backup as uploaded,
+    // and references them in the backup metadata.
+    void reference_unchanged_files();
+    // returns the md5 of the local checkpoint file, which is calculated if it isn't yet, or
+    // nullptr if the calculation fails
+    const std::string *local_file_md5(const std::string &local_filename);
+    // reads the whole remote file synchronously
+    bool read_remote_file(const std::string &remote_file, /*out*/ blob &content);
     void on_upload_chkpt_dir();
     void upload_file(const std::string &local_filename);
     void on_upload(const dist::block_service::block_file_ptr &file_handle,
@@ -355,7 +376,8 @@ private:
     std::atomic_int _upload_status;
 
     int32_t _max_concurrent_uploading_file_cnt;
-    // filename -> <filesize, md5>
+    // filename -> <filesize, md5>, the md5 is empty until it's calculated, each entry is
+    // updated only by the upload of its file
     std::map<std::string, std::pair<int64_t, std::string>> _file_infos;
 
     zlock _lock; // lock the structure below
@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "restore_download_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+void restore_download_scheduler::acquire(const gpid &pid)
+{
+    if (_max_concurrent_count == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> l(_lock);
+    auto ticket = std::make_tuple(pid.get_partition_index(), pid.get_app_id(), _next_seq++);
+    _waiting.insert(ticket);
+    _cond.wait(l, [this, &ticket]() {
+        return _running_count < _max_concurrent_count && *_waiting.begin() == ticket;
+    });
+    _waiting.erase(_waiting.begin());
+    ++_running_count;
+    // the next waiting one may be allowed as well
+    _cond.notify_all();
+}
+
+bool restore_download_scheduler::try_acquire(const gpid &pid)
+{
+    if (_max_concurrent_count == 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    if (_running_count >= _max_concurrent_count) {
+        return false;
+    }
+    if (!_waiting.empty() &&
+        std::make_tuple(std::get<0>(*_waiting.begin()), std::get<1>(*_waiting.begin())) <
+            std::make_tuple(pid.get_partition_index(), pid.get_app_id())) {
+        return false;
+    }
+    ++_running_count;
+    return true;
+}
+
+void restore_download_scheduler::release()
+{
+    if (_max_concurrent_count == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    --_running_count;
+    _cond.notify_all();
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,65 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <tuple>
+
+#include <dsn/tool-api/gpid.h>
+
+namespace dsn {
+namespace replication {
+
+// Limits the count of files downloaded concurrently by the restoring replicas of a node.
+// Files of the partition with the smallest index are served first, so that the partitions of
+// a restoring table finish one after another and become readable early, rather than all of
+// them finishing at the end.
+class restore_download_scheduler
+{
+public:
+    // max_concurrent_count = 0 means unlimited
+    explicit restore_download_scheduler(uint32_t max_concurrent_count)
+        : _max_concurrent_count(max_concurrent_count)
+    {
+    }
+
+    // blocks until a file of `pid` is allowed to be downloaded
+    void acquire(const gpid &pid);
+
+    // returns false rather than blocks if a file of `pid` isn't allowed to be downloaded now,
+    // that is all the slots are taken or a smaller partition is waiting for one
+    bool try_acquire(const gpid &pid);
+
+    void release();
+
+private:
+    const uint32_t _max_concurrent_count;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    uint32_t _running_count{0};
+    uint64_t _next_seq{0};
+    // <partition_index, app_id, seq> of the waiting downloads
+    std::set<std::tuple<int32_t, int32_t, uint64_t>> _waiting;
+};
+
+} // namespace replication
+} // namespace dsn
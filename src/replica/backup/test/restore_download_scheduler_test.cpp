@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "replica/backup/restore_download_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(restore_download_scheduler_test, smaller_partition_first)
+{
+    restore_download_scheduler scheduler(1);
+    scheduler.acquire(gpid(1, 3));
+
+    std::mutex order_lock;
+    std::vector<int32_t> order;
+    auto download = [&](int32_t pidx) {
+        scheduler.acquire(gpid(1, pidx));
+        {
+            std::lock_guard<std::mutex> l(order_lock);
+            order.push_back(pidx);
+        }
+        scheduler.release();
+    };
+    std::thread t5(download, 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread t2(download, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // partition 2 goes first though it comes later
+    scheduler.release();
+    t5.join();
+    t2.join();
+    ASSERT_EQ(std::vector<int32_t>({2, 5}), order);
+}
+
+TEST(restore_download_scheduler_test, try_acquire)
+{
+    restore_download_scheduler scheduler(2);
+    ASSERT_TRUE(scheduler.try_acquire(gpid(1, 3)));
+    ASSERT_TRUE(scheduler.try_acquire(gpid(1, 4)));
+    // all the slots are taken
+    ASSERT_FALSE(scheduler.try_acquire(gpid(1, 0)));
+
+    std::atomic<bool> acquired(false);
+    std::thread t2([&]() {
+        scheduler.acquire(gpid(1, 2));
+        acquired.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(acquired.load());
+
+    // the released slot goes to the waiting partition 2
+    scheduler.release();
+    t2.join();
+    ASSERT_TRUE(acquired.load());
+    scheduler.release();
+    ASSERT_TRUE(scheduler.try_acquire(gpid(1, 1)));
+    scheduler.release();
+    scheduler.release();
+}
+
+TEST(restore_download_scheduler_test, unlimited)
+{
+    restore_download_scheduler scheduler(0);
+    for (int32_t i = 0; i < 10; ++i) {
+        scheduler.acquire(gpid(1, i));
+    }
+    ASSERT_TRUE(scheduler.try_acquire(gpid(1, 0)));
+    for (int32_t i = 0; i < 11; ++i) {
+        scheduler.release();
+    }
+}
+
+} // namespace replication
+} // namespace dsn
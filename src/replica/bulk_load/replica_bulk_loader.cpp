@@ -20,6 +20,7 @@
 #include <dsn/dist/block_service.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replication_app_base.h>
+#include <dsn/tool-api/background_io_limiter.h>
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/filesystem.h>
 
@@ -60,13 +61,23 @@ void replica_bulk_loader::on_bulk_load(const bulk_load_request &request,
 
     ddebug_replica("receive bulk load request, remote provider = {}, remote_root_path = {}, "
                    "cluster_name = {}, app_name = {}, "
-                   "meta_bulk_load_status = {}, local bulk_load_status = {}",
+                   "meta_bulk_load_status = {}, local bulk_load_status = {}, "
+                   "non_blocking_ingestion = {}",
                    request.remote_provider_name,
                    request.remote_root_path,
                    request.cluster_name,
                    request.app_name,
                    enum_to_string(request.meta_bulk_load_status),
-                   enum_to_string(_status));
+                   enum_to_string(_status),
+                   request.non_blocking_ingestion);
+    _non_blocking_ingestion = request.non_blocking_ingestion;
+    if (_non_blocking_ingestion && !_replica->_app->support_non_blocking_ingestion()) {
+        // the app would apply the later writes before the ingested data, fall back to rejecting
+        // the writes during the ingestion
+        dwarn_replica("app doesn't support non-blocking ingestion, the writes will be rejected "
+                      "during the ingestion");
+        _non_blocking_ingestion = false;
+    }
 
     error_code ec = do_bulk_load(request.app_name,
                                  request.meta_bulk_load_status,
@@ -423,11 +434,25 @@ error_code replica_bulk_loader::download_sst_files(const std::string &remote_dir
         auto bulk_load_download_task = tasking::enqueue(
             LPC_BACKGROUND_BULK_LOAD, tracker(), [this, remote_dir, local_dir, f_meta, fs]() {
                 uint64_t f_size = 0;
+                std::string f_md5;
+                background_io_limiter::instance().throttle(
+                    local_dir, background_io_class::bulk_load, f_meta.size);
                 error_code ec = _stub->_block_service_manager.download_file(
-                    remote_dir, local_dir, f_meta.name, fs, f_size);
+                    remote_dir, local_dir, f_meta.name, fs, f_size, f_md5);
                 const std::string &file_name =
                     utils::filesystem::path_combine(local_dir, f_meta.name);
-                if (ec == ERR_OK || ec == ERR_PATH_ALREADY_EXIST) {
+                if (ec == ERR_OK && !f_md5.empty()) {
+                    // md5 is calculated while downloading, no need to read the file again
+                    if (static_cast<int64_t>(f_size) != f_meta.size || f_md5 != f_meta.md5) {
+                        derror_replica("file({}) damaged, size: {} VS {}, md5: {} VS {}",
+                                       file_name,
+                                       f_size,
+                                       f_meta.size,
+                                       f_md5,
+                                       f_meta.md5);
+                        ec = ERR_CORRUPTION;
+                    }
+                } else if (ec == ERR_OK || ec == ERR_PATH_ALREADY_EXIST) {
                     if (!utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
                         ec = ERR_CORRUPTION;
                     } else if (ec == ERR_PATH_ALREADY_EXIST) {
@@ -646,6 +671,7 @@ void replica_bulk_loader::clear_bulk_load_states()
 
     _replica->_is_bulk_load_ingestion = false;
     _replica->_app->set_ingestion_status(ingestion_status::IS_INVALID);
+    _non_blocking_ingestion = false;
 
     _bulk_load_start_time_ms = 0;
     _replica->_bulk_load_ingestion_start_time_ms = 0;
@@ -123,6 +123,9 @@ private:
 
     inline void set_bulk_load_status(bulk_load_status::type status) { _status = status; }
 
+    // whether the writes keep flowing during the ingestion, set by the meta server
+    inline bool is_non_blocking_ingestion() const { return _non_blocking_ingestion; }
+
     inline uint64_t duration_ms() const
     {
         return _bulk_load_start_time_ms > 0 ? (dsn_now_ms() - _bulk_load_start_time_ms) : 0;
@@ -158,6 +161,7 @@ private:
     std::atomic<error_code> _download_status{ERR_OK};
     // file_name -> downloading task
     std::map<std::string, task_ptr> _download_task;
+    bool _non_blocking_ingestion{false};
 
     // Used for perf-counter
     uint64_t _bulk_load_start_time_ms{0};
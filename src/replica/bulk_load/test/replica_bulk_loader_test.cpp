@@ -26,6 +26,30 @@
 namespace dsn {
 namespace replication {
 
+// an app which records the order in which the mutations are applied
+class ingestion_order_app : public mock_replication_app_base
+{
+public:
+    explicit ingestion_order_app(replica *r) : mock_replication_app_base(r) {}
+
+    int on_batched_write_updates(int64_t decree,
+                                 uint64_t timestamp,
+                                 const mutation_update **updates,
+                                 int update_length) override
+    {
+        bool has_ingestion = false;
+        for (int i = 0; i < update_length; ++i) {
+            applied.emplace_back(decree, updates[i]->code);
+            has_ingestion = has_ingestion || updates[i]->code == dsn::apps::RPC_RRDB_RRDB_BULK_LOAD;
+        }
+        return has_ingestion ? ingestion_error : write_error;
+    }
+
+    std::vector<std::pair<decree, task_code>> applied;
+    int ingestion_error{0};
+    int write_error{0};
+};
+
 class replica_bulk_loader_test : public replica_test_base
 {
 public:
@@ -449,6 +473,72 @@ TEST_F(replica_bulk_loader_test, on_bulk_load_ballot_change)
     ASSERT_EQ(test_on_bulk_load(), ERR_INVALID_STATE);
 }
 
+TEST_F(replica_bulk_loader_test, on_bulk_load_non_blocking_ingestion)
+{
+    auto app = static_cast<mock_replication_app_base *>(_replica->get_app());
+    app->set_support_non_blocking_ingestion(true);
+    mock_primary_states();
+    create_bulk_load_request(bulk_load_status::BLS_INGESTING);
+    _req.__set_non_blocking_ingestion(true);
+    test_on_bulk_load();
+    ASSERT_TRUE(_bulk_loader->is_non_blocking_ingestion());
+
+    // reset when the bulk load finishes
+    utils::filesystem::create_directory(LOCAL_DIR);
+    test_handle_bulk_load_finish(bulk_load_status::BLS_INGESTING,
+                                 100,
+                                 ingestion_status::IS_FAILED,
+                                 true,
+                                 bulk_load_status::BLS_FAILED);
+    ASSERT_FALSE(_bulk_loader->is_non_blocking_ingestion());
+    ASSERT_FALSE(_replica->is_ingestion());
+}
+
+TEST_F(replica_bulk_loader_test, on_bulk_load_non_blocking_ingestion_not_supported)
+{
+    mock_primary_states();
+    create_bulk_load_request(bulk_load_status::BLS_INGESTING);
+    _req.__set_non_blocking_ingestion(true);
+    test_on_bulk_load();
+    // the writes are still rejected during the ingestion
+    ASSERT_FALSE(_bulk_loader->is_non_blocking_ingestion());
+}
+
+TEST_F(replica_bulk_loader_test, non_blocking_ingestion_write_order)
+{
+    auto owned_app = make_unique<ingestion_order_app>(_replica.get());
+    ingestion_order_app *app = owned_app.get();
+    app->set_support_non_blocking_ingestion(true);
+    // the ingestion fails in the app, which is reported to meta server by ingestion_response
+    app->ingestion_error = -1;
+    _replica->set_app(std::move(owned_app));
+    _replica->set_app_last_committed_decree(0);
+
+    // the writes before and after the ingestion mutation are applied around it in decree order
+    std::vector<mutation_ptr> mus;
+    for (decree d = 1; d <= 4; ++d) {
+        mus.emplace_back(create_test_mutation(d, "value"));
+    }
+    mus[1]->data.updates.back().code = dsn::apps::RPC_RRDB_RRDB_BULK_LOAD;
+    for (const auto &mu : mus) {
+        ASSERT_EQ(ERR_OK, app->apply_mutation(mu.get()));
+    }
+
+    ASSERT_EQ(4, app->last_committed_decree());
+    ASSERT_EQ(4, app->applied.size());
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(i + 1, app->applied[i].first);
+        ASSERT_EQ(i == 1 ? dsn::apps::RPC_RRDB_RRDB_BULK_LOAD : RPC_COLD_BACKUP,
+                  app->applied[i].second);
+    }
+
+    // a failed write isn't ignored like a failed ingestion
+    auto mu = create_test_mutation(5, "value");
+    app->write_error = -1;
+    ASSERT_EQ(ERR_LOCAL_APP_FAILURE, app->apply_mutation(mu.get()));
+    ASSERT_EQ(4, app->last_committed_decree());
+}
+
 // on_group_bulk_load unit tests
 TEST_F(replica_bulk_loader_test, on_group_bulk_load_test)
 {
@@ -0,0 +1,221 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "cold_tier_cache.h"
+
+#include <fstream>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+
+#include "block_service/block_service_manager.h"
+
+namespace dsn {
+namespace replication {
+
+const std::string cold_tier_manifest::kFileName = "manifest";
+
+error_code cold_tier_manifest::store(const std::string &dir) const
+{
+    std::string path = utils::filesystem::path_combine(dir, kFileName);
+    std::string tmp_path = path + ".tmp";
+
+    std::ofstream os(tmp_path.c_str(),
+                     (std::ofstream::out | std::ios::binary | std::ofstream::trunc));
+    if (!os.is_open()) {
+        derror_f("open file {} failed", tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    blob bb = json::json_forwarder<cold_tier_manifest>::encode(*this);
+    os.write(bb.data(), (std::streamsize)bb.length());
+    if (os.bad()) {
+        derror_f("write file {} failed", tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    os.close();
+
+    if (!utils::filesystem::rename_path(tmp_path, path)) {
+        derror_f("move file from {} to {} failed", tmp_path, path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return ERR_OK;
+}
+
+error_code cold_tier_manifest::load(const std::string &dir)
+{
+    std::string path = utils::filesystem::path_combine(dir, kFileName);
+    if (!utils::filesystem::file_exists(path)) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    std::string data;
+    error_code err = utils::filesystem::read_file(path, data);
+    if (err != ERR_OK) {
+        derror_f("read file {} failed, err = {}", path, err);
+        return err;
+    }
+
+    blob bb = blob::create_from_bytes(std::move(data));
+    if (!json::json_forwarder<cold_tier_manifest>::decode(bb, *this)) {
+        derror_f("decode json from file {} failed", path);
+        return ERR_INVALID_DATA;
+    }
+    return ERR_OK;
+}
+
+cold_tier_cache::cold_tier_cache(dist::block_service::block_service_manager *bsm,
+                                 dist::block_service::block_filesystem *fs,
+                                 const std::string &local_dir,
+                                 const cold_tier_manifest &manifest)
+    : _bsm(bsm), _fs(fs), _local_dir(local_dir), _capacity_bytes(manifest.cache_capacity_bytes)
+{
+    for (const cold_tier_file &f : manifest.files) {
+        _files.emplace(f.meta.name, f);
+    }
+
+    // the files cached before the replica was closed are still valid
+    for (const auto &kv : _files) {
+        std::string path = utils::filesystem::path_combine(_local_dir, kv.first);
+        int64_t size = 0;
+        if (utils::filesystem::file_size(path, size) && size == kv.second.meta.size) {
+            touch(kv.first);
+        }
+    }
+    evict();
+}
+
+error_code cold_tier_cache::get_file(const std::string &name, /*out*/ std::string &local_path)
+{
+    cold_tier_file file;
+    {
+        zauto_lock l(_lock);
+        auto it = _files.find(name);
+        if (it == _files.end()) {
+            return ERR_OBJECT_NOT_FOUND;
+        }
+        local_path = utils::filesystem::path_combine(_local_dir, name);
+        if (_cached.count(name) > 0) {
+            touch(name);
+            return ERR_OK;
+        }
+        file = it->second;
+    }
+
+    zauto_lock dl(_download_lock);
+    {
+        // downloaded by the previous holder of `_download_lock`
+        zauto_lock l(_lock);
+        if (_cached.count(name) > 0) {
+            touch(name);
+            return ERR_OK;
+        }
+    }
+
+    error_code err = download(file);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    zauto_lock l(_lock);
+    touch(name);
+    evict();
+    return ERR_OK;
+}
+
+error_code cold_tier_cache::download(const cold_tier_file &file)
+{
+    uint64_t f_size = 0;
+    std::string f_md5;
+    error_code err =
+        _bsm->download_file(file.remote_dir, _local_dir, file.meta.name, _fs, f_size, f_md5);
+    const std::string path = utils::filesystem::path_combine(_local_dir, file.meta.name);
+    if (err == ERR_OK && !f_md5.empty()) {
+        if (static_cast<int64_t>(f_size) != file.meta.size || f_md5 != file.meta.md5) {
+            derror_f("file({}) damaged, size: {} VS {}, md5: {} VS {}",
+                     path,
+                     f_size,
+                     file.meta.size,
+                     f_md5,
+                     file.meta.md5);
+            err = ERR_CORRUPTION;
+        }
+    } else if (err == ERR_OK || err == ERR_PATH_ALREADY_EXIST) {
+        err = utils::filesystem::verify_file(path, file.meta.md5, file.meta.size) ? ERR_OK
+                                                                                 : ERR_CORRUPTION;
+    }
+
+    if (err != ERR_OK) {
+        derror_f("failed to download cold tier file({}) from {}, error = {}",
+                 file.meta.name,
+                 file.remote_dir,
+                 err);
+        // download again next time
+        utils::filesystem::remove_path(path);
+        return err;
+    }
+    ddebug_f("downloaded cold tier file({}) of {} bytes", path, file.meta.size);
+    return ERR_OK;
+}
+
+void cold_tier_cache::touch(const std::string &name)
+{
+    auto it = _cached.find(name);
+    if (it != _cached.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return;
+    }
+    _lru.push_front(name);
+    _cached.emplace(name, _lru.begin());
+    _cached_bytes += _files[name].meta.size;
+}
+
+void cold_tier_cache::evict()
+{
+    // the most recently read file is kept even if it's larger than the capacity
+    while (_cached_bytes > _capacity_bytes && _lru.size() > 1) {
+        const std::string &name = _lru.back();
+        std::string path = utils::filesystem::path_combine(_local_dir, name);
+        if (!utils::filesystem::remove_path(path)) {
+            dwarn_f("remove cold tier file({}) failed", path);
+        }
+        _cached_bytes -= _files[name].meta.size;
+        _cached.erase(name);
+        _lru.pop_back();
+    }
+}
+
+bool cold_tier_cache::is_cached(const std::string &name) const
+{
+    zauto_lock l(_lock);
+    return _cached.count(name) > 0;
+}
+
+int64_t cold_tier_cache::cached_bytes() const
+{
+    zauto_lock l(_lock);
+    return _cached_bytes;
+}
+
+size_t cold_tier_cache::cached_count() const
+{
+    zauto_lock l(_lock);
+    return _cached.size();
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dsn/cpp/json_helper.h>
+#include <dsn/tool-api/zlocks.h>
+
+#include "common/replication_common.h"
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+class block_filesystem;
+class block_service_manager;
+} // namespace block_service
+} // namespace dist
+
+namespace replication {
+
+struct cold_tier_file
+{
+    // the checkpoint dir on the block service which the file was backed up to
+    std::string remote_dir;
+    file_meta meta;
+
+    DEFINE_JSON_SERIALIZATION(remote_dir, meta)
+};
+
+// Persisted under <replica_dir>/cold_tier when a partition is restored in the cold-tier mode, so
+// that the cache can be rebuilt when the replica is loaded again.
+struct cold_tier_manifest
+{
+    static const std::string kFileName;
+
+    std::string backup_provider_name;
+    int64_t cache_capacity_bytes{0};
+    // the files of the checkpoint which were not downloaded by the restore
+    std::vector<cold_tier_file> files;
+
+    DEFINE_JSON_SERIALIZATION(backup_provider_name, cache_capacity_bytes, files)
+
+    error_code store(const std::string &dir) const;
+    error_code load(const std::string &dir);
+};
+
+// cold_tier_cache keeps the files of a cold-tier partition on the block service, and a local
+// cache of the recently read ones. A file is downloaded from its backup when it's read and not
+// cached, and the least recently read files are removed once the cache is over its capacity.
+//
+// It is thread-safe. Only one file is downloaded at a time, so a read of a cached file never
+// waits for a download.
+class cold_tier_cache
+{
+public:
+    cold_tier_cache(dist::block_service::block_service_manager *bsm,
+                    dist::block_service::block_filesystem *fs,
+                    const std::string &local_dir,
+                    const cold_tier_manifest &manifest);
+
+    // get the local path of the file, which is downloaded if not cached.
+    // return ERR_OBJECT_NOT_FOUND if the file is not in the manifest.
+    error_code get_file(const std::string &name, /*out*/ std::string &local_path);
+
+    bool is_cached(const std::string &name) const;
+    int64_t cached_bytes() const;
+    size_t cached_count() const;
+
+private:
+    // the cached files are at the front of `_lru`, called with `_lock` held
+    void touch(const std::string &name);
+    void evict();
+
+    error_code download(const cold_tier_file &file);
+
+    dist::block_service::block_service_manager *_bsm;
+    dist::block_service::block_filesystem *_fs;
+    const std::string _local_dir;
+    const int64_t _capacity_bytes;
+
+    // only one download at a time
+    zlock _download_lock;
+
+    mutable zlock _lock;
+    std::map<std::string, cold_tier_file> _files;
+    // the cached files, the most recently read first
+    std::list<std::string> _lru;
+    std::map<std::string, std::list<std::string>::iterator> _cached;
+    int64_t _cached_bytes{0};
+};
+
+} // namespace replication
+} // namespace dsn
@@ -23,6 +23,7 @@
 #include <dsn/c/api_layer1.h>
 
 #include "disk_cleaner.h"
+#include "async_file_deleter.h"
 
 namespace dsn {
 namespace replication {
@@ -106,7 +107,7 @@ error_s disk_remove_useless_dirs(const std::vector<std::string> &data_dirs,
         }
 
         if (last_write_time + remove_interval_seconds <= current_time_ms / 1000) {
-            if (!dsn::utils::filesystem::remove_path(fpath)) {
+            if (!async_file_deleter::instance().remove_path(fpath)) {
                 dwarn_f("gc_disk: failed to delete directory '{}', time_used_ms = {}",
                         fpath,
                         dsn_now_ms() - current_time_ms);
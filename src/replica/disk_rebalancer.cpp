@@ -0,0 +1,253 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "disk_rebalancer.h"
+#include "replica.h"
+#include "replica_disk_migrator.h"
+#include "replica_stub.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                disk_rebalance_enabled,
+                false,
+                "whether to move secondaries between the data dirs automatically to balance "
+                "their space and io load");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_interval_seconds,
+                  300,
+                  "interval in seconds to evaluate the disks for rebalance");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_max_concurrent_count,
+                  1,
+                  "max count of the disk migrations running at the same time on a node");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_max_mb_per_round,
+                  10240,
+                  "max total size in MB of the replicas scheduled to move in one round");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_available_ratio_gap,
+                  10,
+                  "rebalance the disks when the available space ratio(%) of the most free one "
+                  "exceeds the least free one by this much");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_io_util_gap,
+                  30,
+                  "rebalance the disks when the io utilization(%) of the busiest one exceeds "
+                  "the idlest one by this much");
+DSN_DEFINE_validator(disk_rebalance_interval_seconds, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_validator(disk_rebalance_available_ratio_gap, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_validator(disk_rebalance_io_util_gap, [](uint32_t value) -> bool {
+    return value > 0;
+});
+
+namespace {
+
+int64_t get_dir_size_mb(const std::string &dir)
+{
+    std::vector<std::string> files;
+    if (!utils::filesystem::get_subfiles(dir, files, true)) {
+        return -1;
+    }
+    int64_t total = 0;
+    for (const auto &f : files) {
+        int64_t sz = 0;
+        if (utils::filesystem::file_size(f, sz)) {
+            total += sz;
+        }
+    }
+    return total >> 20;
+}
+
+} // anonymous namespace
+
+/*static*/ bool disk_rebalancer::enabled() { return FLAGS_disk_rebalance_enabled; }
+
+disk_rebalancer::disk_rebalancer(replica_stub *stub) : _stub(stub)
+{
+    _counter_scheduled_migration_count.init_app_counter(
+        "eon.replica_stub",
+        "disk.rebalance.scheduled.count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "replica count scheduled to migrate between disks by the disk rebalancer");
+}
+
+disk_rebalancer::~disk_rebalancer() {}
+
+void disk_rebalancer::start()
+{
+    ddebug_f("rebalance the disks periodically in {}s", FLAGS_disk_rebalance_interval_seconds);
+
+    _timer_task =
+        tasking::enqueue_timer(LPC_DISK_REBALANCE,
+                               &_stub->_tracker,
+                               [this]() { rebalance(); },
+                               std::chrono::seconds(FLAGS_disk_rebalance_interval_seconds));
+}
+
+void disk_rebalancer::close()
+{
+    if (_timer_task) {
+        _timer_task->cancel(true);
+        _timer_task = nullptr;
+    }
+}
+
+/*static*/ bool disk_rebalancer::select_disks(const std::vector<disk_load> &disks,
+                                              const disk_load *&origin,
+                                              const disk_load *&target)
+{
+    origin = nullptr;
+    target = nullptr;
+    if (disks.size() < 2) {
+        return false;
+    }
+
+    // the space first, since a full disk fails the writes while a hot one only slows them
+    const disk_load *least_free = &disks.front();
+    const disk_load *most_free = &disks.front();
+    for (const auto &d : disks) {
+        if (d.available_ratio < least_free->available_ratio) {
+            least_free = &d;
+        }
+        if (d.available_ratio > most_free->available_ratio) {
+            most_free = &d;
+        }
+    }
+    if (most_free->available_ratio - least_free->available_ratio >=
+        static_cast<int>(FLAGS_disk_rebalance_available_ratio_gap)) {
+        origin = least_free;
+        target = most_free;
+        return true;
+    }
+
+    const disk_load *busiest = &disks.front();
+    const disk_load *idlest = &disks.front();
+    for (const auto &d : disks) {
+        if (d.io_util_percent > busiest->io_util_percent) {
+            busiest = &d;
+        }
+        if (d.io_util_percent < idlest->io_util_percent) {
+            idlest = &d;
+        }
+    }
+    // never move the load to a disk with notably less space
+    if (busiest->io_util_percent - idlest->io_util_percent >=
+            static_cast<int>(FLAGS_disk_rebalance_io_util_gap) &&
+        busiest->available_ratio - idlest->available_ratio <
+            static_cast<int>(FLAGS_disk_rebalance_available_ratio_gap)) {
+        origin = busiest;
+        target = idlest;
+        return true;
+    }
+    return false;
+}
+
+int disk_rebalancer::running_migration_count() const
+{
+    int count = 0;
+    zauto_read_lock l(_stub->_replicas_lock);
+    for (const auto &kv : _stub->_replicas) {
+        if (kv.second->disk_migrator()->status() != disk_migration_status::IDLE) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void disk_rebalancer::rebalance()
+{
+    int running = running_migration_count();
+    if (running >= static_cast<int>(FLAGS_disk_rebalance_max_concurrent_count)) {
+        ddebug_f("skip disk rebalance since {} migrations are running", running);
+        return;
+    }
+
+    std::vector<disk_load> disks;
+    {
+        zauto_read_lock l(_stub->_fs_manager._lock);
+        for (const auto &n : _stub->_fs_manager._dir_nodes) {
+            disk_load d;
+            d.tag = n->tag;
+            d.available_ratio = n->disk_available_ratio;
+            d.io_util_percent = n->io_util_percent;
+            for (const auto &kv : n->holding_replicas) {
+                d.replicas.insert(d.replicas.end(), kv.second.begin(), kv.second.end());
+            }
+            disks.emplace_back(std::move(d));
+        }
+    }
+
+    const disk_load *origin = nullptr;
+    const disk_load *target = nullptr;
+    if (!select_disks(disks, origin, target)) {
+        return;
+    }
+
+    int64_t budget_mb = FLAGS_disk_rebalance_max_mb_per_round;
+    for (const gpid &pid : origin->replicas) {
+        if (running >= static_cast<int>(FLAGS_disk_rebalance_max_concurrent_count)) {
+            break;
+        }
+
+        replica_ptr rep = _stub->get_replica(pid);
+        if (rep == nullptr || rep->status() != partition_status::PS_SECONDARY ||
+            rep->disk_migrator()->status() != disk_migration_status::IDLE) {
+            continue;
+        }
+
+        int64_t size_mb = get_dir_size_mb(rep->dir());
+        if (size_mb < 0 || size_mb > budget_mb) {
+            continue;
+        }
+        budget_mb -= size_mb;
+
+        ddebug_f("{}: schedule disk migration from {}(available_ratio = {}%, io_util = {}%) "
+                 "to {}(available_ratio = {}%, io_util = {}%), size = {}MB",
+                 rep->name(),
+                 origin->tag,
+                 origin->available_ratio,
+                 origin->io_util_percent,
+                 target->tag,
+                 target->available_ratio,
+                 target->io_util_percent,
+                 size_mb);
+
+        auto request = make_unique<replica_disk_migrate_request>();
+        request->pid = pid;
+        request->origin_disk = origin->tag;
+        request->target_disk = target->tag;
+        replica_disk_migrate_rpc rpc(std::move(request), RPC_REPLICA_DISK_MIGRATE);
+        rep->disk_migrator()->on_migrate_replica(rpc);
+
+        _counter_scheduled_migration_count->increment();
+        ++running;
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,80 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+
+#include "common/replication_common.h"
+
+namespace dsn {
+namespace replication {
+
+class replica_stub;
+
+// Per-server(replica_stub)-instance.
+// Every [replication] disk_rebalance_interval_seconds, compares the data dirs of this node by
+// available space ratio, then by io utilization, and moves secondaries from the worst disk to
+// the best one via replica_disk_migrator, as an operator would with a replica_disk_migrate_request.
+//
+// At most disk_rebalance_max_concurrent_count migrations run at a time, and the replicas moved
+// per round are bounded by disk_rebalance_max_mb_per_round.
+class disk_rebalancer
+{
+public:
+    static bool enabled();
+
+    explicit disk_rebalancer(replica_stub *stub);
+
+    ~disk_rebalancer();
+
+    void start();
+
+    void close();
+
+    // Evaluates the disks and schedules the migrations, called by the timer.
+    void rebalance();
+
+private:
+    struct disk_load
+    {
+        std::string tag;
+        int available_ratio;
+        int io_util_percent;
+        std::vector<gpid> replicas;
+    };
+
+    // pick the disk to move replicas from and the one to move them to, return false if they
+    // are balanced enough
+    static bool select_disks(const std::vector<disk_load> &disks,
+                             /*out*/ const disk_load *&origin,
+                             /*out*/ const disk_load *&target);
+
+    int running_migration_count() const;
+
+    friend class disk_rebalancer_test;
+
+private:
+    replica_stub *_stub;
+
+    task_ptr _timer_task;
+    perf_counter_wrapper _counter_scheduled_migration_count;
+};
+
+} // namespace replication
+} // namespace dsn
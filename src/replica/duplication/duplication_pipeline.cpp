@@ -4,6 +4,7 @@
 
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 #include "replica/replica_stub.h"
 #include "duplication_pipeline.h"
@@ -12,6 +13,14 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  duplication_max_inflight_batches,
+                  1,
+                  "the max count of the mutation batches a duplication ships to the remote "
+                  "cluster concurrently");
+DSN_DEFINE_validator(duplication_max_inflight_batches,
+                     [](uint32_t value) -> bool { return value > 0 && value <= 64; });
+
 //                     //
 // mutation_duplicator //
 //                     //
@@ -26,7 +35,8 @@ namespace replication {
 
 void load_mutation::run()
 {
-    decree last_decree = _duplicator->progress().last_decree;
+    decree last_decree =
+        std::max(_duplicator->progress().last_decree, _duplicator->_ship->last_inflight_decree());
     _start_decree = last_decree + 1;
     if (_replica->private_log()->max_commit_on_disk() < _start_decree) {
         // wait 100ms for next try if no mutation was added.
@@ -53,11 +63,40 @@ load_mutation::load_mutation(replica_duplicator *duplicator,
 
 void ship_mutation::ship(mutation_tuple_set &&in)
 {
-    _mutation_duplicator->duplicate(std::move(in), [this](size_t total_shipped_size) mutable {
-        update_progress();
-        _counter_dup_shipped_bytes_rate->add(total_shipped_size);
+    size_t slot;
+    decree last_decree = _last_decree;
+    bool step_down = false;
+    {
+        zauto_lock l(_window_lock);
+        dassert_replica(!_free_slots.empty(), "no free slot to ship batch {}", last_decree);
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+        _window[last_decree].slot = slot;
+        _counter_dup_inflight_batches->set(_window.size());
+        step_down = !(_window_full = _free_slots.empty());
+    }
+
+    size_t raw_size = 0;
+    for (const mutation_tuple &mut : in) {
+        raw_size += std::get<2>(mut).length();
+    }
+    _counter_dup_raw_bytes_rate->add(raw_size);
+
+    _mutation_duplicators[slot]->duplicate(
+        std::move(in), [this, last_decree, slot, raw_size](size_t total_shipped_size) mutable {
+            _counter_dup_shipped_bytes_rate->add(total_shipped_size);
+            if (raw_size > 0) {
+                _counter_dup_shipped_percent->set(total_shipped_size * 100 / raw_size);
+            }
+            if (on_batch_shipped(last_decree, slot)) {
+                step_down_next_stage();
+            }
+        });
+
+    // keep loading while the window is not full
+    if (step_down) {
         step_down_next_stage();
-    });
+    }
 }
 
 void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
@@ -65,7 +104,15 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
     _last_decree = last_decree;
 
     if (in.empty()) {
-        update_progress();
+        {
+            zauto_lock l(_window_lock);
+            if (_window.empty()) {
+                update_progress(last_decree);
+            } else if (last_decree > _window.rbegin()->first) {
+                // confirmed along with the in-flight batches before it
+                _window[last_decree].acked = true;
+            }
+        }
         step_down_next_stage();
         return;
     }
@@ -73,15 +120,41 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
     ship(std::move(in));
 }
 
-void ship_mutation::update_progress()
+void ship_mutation::update_progress(decree last_decree)
 {
     dcheck_eq_replica(
-        _duplicator->update_progress(duplication_progress().set_last_decree(_last_decree)),
+        _duplicator->update_progress(duplication_progress().set_last_decree(last_decree)),
         error_s::ok());
 
     // committed decree never decreases
     decree last_committed_decree = _replica->last_committed_decree();
-    dcheck_ge_replica(last_committed_decree, _last_decree);
+    dcheck_ge_replica(last_committed_decree, last_decree);
+}
+
+decree ship_mutation::last_inflight_decree() const
+{
+    zauto_lock l(_window_lock);
+    return _window.empty() ? invalid_decree : _window.rbegin()->first;
+}
+
+bool ship_mutation::on_batch_shipped(decree last_decree, size_t slot)
+{
+    zauto_lock l(_window_lock);
+    auto it = _window.find(last_decree);
+    dassert_replica(it != _window.end(), "batch {} is not in flight", last_decree);
+    it->second.acked = true;
+    _free_slots.push_back(slot);
+
+    // advance the progress over the contiguous acked batches
+    while (!_window.empty() && _window.begin()->second.acked) {
+        update_progress(_window.begin()->first);
+        _window.erase(_window.begin());
+    }
+    _counter_dup_inflight_batches->set(_window.size());
+
+    bool resume = _window_full;
+    _window_full = false;
+    return resume;
 }
 
 ship_mutation::ship_mutation(replica_duplicator *duplicator)
@@ -90,14 +163,33 @@ ship_mutation::ship_mutation(replica_duplicator *duplicator)
       _replica(duplicator->_replica),
       _stub(duplicator->_replica->get_replica_stub())
 {
-    _mutation_duplicator = new_mutation_duplicator(
-        duplicator, _duplicator->remote_cluster_name(), _replica->get_app_info()->app_name);
-    _mutation_duplicator->set_task_environment(duplicator);
+    for (uint32_t i = 0; i < FLAGS_duplication_max_inflight_batches; ++i) {
+        _mutation_duplicators.emplace_back(new_mutation_duplicator(
+            duplicator, _duplicator->remote_cluster_name(), _replica->get_app_info()->app_name));
+        _mutation_duplicators.back()->set_task_environment(duplicator);
+        _free_slots.push_back(FLAGS_duplication_max_inflight_batches - 1 - i);
+    }
 
     _counter_dup_shipped_bytes_rate.init_app_counter("eon.replica_stub",
                                                      "dup.shipped_bytes_rate",
                                                      COUNTER_TYPE_RATE,
                                                      "shipping rate of private log in bytes");
+    _counter_dup_raw_bytes_rate.init_app_counter(
+        "eon.replica_stub",
+        "dup.raw_bytes_rate",
+        COUNTER_TYPE_RATE,
+        "rate of the mutations shipped in bytes, before batched and compressed");
+    _counter_dup_inflight_batches.init_app_counter(
+        "eon.replica_stub",
+        fmt::format("dup.inflight_batches@{}.{}", get_gpid(), _duplicator->id()).c_str(),
+        COUNTER_TYPE_NUMBER,
+        "count of the mutation batches in flight of the duplication");
+    _counter_dup_shipped_percent.init_app_counter(
+        "eon.replica_stub",
+        fmt::format("dup.shipped_percent@{}.{}", get_gpid(), _duplicator->id()).c_str(),
+        COUNTER_TYPE_NUMBER,
+        "the shipped bytes of the last batch in percentage of its mutations, which is the "
+        "compression ratio of the duplication");
 }
 
 } // namespace replication
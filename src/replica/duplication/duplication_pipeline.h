@@ -7,6 +7,7 @@
 #include <dsn/cpp/pipeline.h>
 #include <dsn/dist/replication/replica_base.h>
 #include <dsn/dist/replication/mutation_duplicator.h>
+#include <dsn/tool-api/zlocks.h>
 
 #include "replica/replica.h"
 #include "replica_duplicator.h"
@@ -41,8 +42,10 @@ private:
 };
 
 // ship_mutation is a pipeline stage receiving a set of mutations,
-// sending them to the remote cluster. After finished, the pipeline
-// will restart from load_mutation.
+// sending them to the remote cluster. Up to FLAGS_duplication_max_inflight_batches
+// batches are shipped concurrently, the pipeline restarts from load_mutation as long
+// as the window is not full. The progress only advances over the contiguous batches
+// acked by the remote cluster.
 // ThreadPool: THREAD_POOL_REPLICATION
 class ship_mutation final : public replica_base,
                             public pipeline::when<decree, mutation_tuple_set>,
@@ -57,13 +60,34 @@ public:
 
     void ship(mutation_tuple_set &&in);
 
+    // the last decree of the batches loaded but not confirmed yet, invalid_decree if
+    // there's none. load_mutation continues from it instead of the confirmed progress.
+    decree last_inflight_decree() const;
+
 private:
-    void update_progress();
+    void update_progress(decree last_decree);
+
+    // Returns true if the pipeline was held by a full window and should step down now.
+    bool on_batch_shipped(decree last_decree, size_t slot);
+
+    struct inflight_batch
+    {
+        bool acked{false};
+        size_t slot{0};
+    };
 
     friend class ship_mutation_test;
     friend class replica_duplicator_test;
 
-    std::unique_ptr<mutation_duplicator> _mutation_duplicator;
+    // one duplicator for every in-flight batch, so that the implementation is not
+    // required to handle several batches concurrently.
+    std::vector<std::unique_ptr<mutation_duplicator>> _mutation_duplicators;
+    std::vector<size_t> _free_slots;
+
+    // last decree of batch => state, ordered by decree
+    mutable zlock _window_lock;
+    std::map<decree, inflight_batch> _window;
+    bool _window_full{false};
 
     replica_duplicator *_duplicator;
     replica *_replica;
@@ -72,6 +96,9 @@ private:
     decree _last_decree{invalid_decree};
 
     perf_counter_wrapper _counter_dup_shipped_bytes_rate;
+    perf_counter_wrapper _counter_dup_raw_bytes_rate;
+    perf_counter_wrapper _counter_dup_inflight_batches;
+    perf_counter_wrapper _counter_dup_shipped_percent;
 };
 
 } // namespace replication
@@ -24,6 +24,7 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/utility/output_utils.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/string_conv.h>
 
 namespace dsn {
@@ -31,6 +32,17 @@ namespace replication {
 
 DEFINE_TASK_CODE(LPC_DUPLICATION_SYNC_TIMER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
+DSN_DEFINE_uint32("replication",
+                  duplication_full_sync_rounds,
+                  6,
+                  "every this many duplication syncs, one carries the confirm points of all the "
+                  "duplications even if they didn't move since the last sync, so that a meta "
+                  "server which lost them learns them again");
+DSN_TAG_VARIABLE(duplication_full_sync_rounds, FT_MUTABLE);
+DSN_DEFINE_validator(duplication_full_sync_rounds, [](uint32_t value) -> bool {
+    return value > 0;
+});
+
 void duplication_sync_timer::run()
 {
     // ensure duplication sync never be concurrent
@@ -51,12 +63,34 @@ void duplication_sync_timer::run()
     auto req = make_unique<duplication_sync_request>();
     req->node = _stub->primary_address();
 
-    // collects confirm points from all primaries on this server
+    zauto_lock l(_lock);
+    bool full_sync = ++_syncs_since_full_sync >= FLAGS_duplication_full_sync_rounds;
+    if (full_sync) {
+        _syncs_since_full_sync = 0;
+    }
+
+    // collects confirm points from all primaries on this server, of which only the moved ones
+    // are sent unless it's a full sync
     uint64_t pending_muts_cnt = 0;
+    size_t confirms_count = 0;
+    size_t sent_count = 0;
+    _sending_confirms.clear();
     for (const replica_ptr &r : get_all_primaries()) {
         auto confirmed = r->get_duplication_manager()->get_duplication_confirms_to_update();
-        if (!confirmed.empty()) {
-            req->confirm_list[r->get_gpid()] = std::move(confirmed);
+        std::vector<duplication_confirm_entry> moved;
+        for (auto &entry : confirmed) {
+            auto key = std::make_pair(r->get_gpid(), entry.dupid);
+            _sending_confirms[key] = entry.confirmed_decree;
+            auto it = _synced_confirms.find(key);
+            if (full_sync || it == _synced_confirms.end() ||
+                it->second != entry.confirmed_decree) {
+                moved.emplace_back(std::move(entry));
+            }
+        }
+        confirms_count += confirmed.size();
+        sent_count += moved.size();
+        if (!moved.empty()) {
+            req->confirm_list[r->get_gpid()] = std::move(moved);
         }
         pending_muts_cnt += r->get_duplication_manager()->get_pending_mutations_count();
     }
@@ -64,9 +98,12 @@ void duplication_sync_timer::run()
 
     duplication_sync_rpc rpc(std::move(req), RPC_CM_DUPLICATION_SYNC, 3_s);
     rpc_address meta_server_address(_stub->get_meta_server_address());
-    ddebug_f("duplication_sync to meta({})", meta_server_address.to_string());
+    ddebug_f("duplication_sync to meta({}), full_sync = {}, sent {} of {} confirm points",
+             meta_server_address.to_string(),
+             full_sync,
+             sent_count,
+             confirms_count);
 
-    zauto_lock l(_lock);
     _rpc_task =
         rpc.call(meta_server_address, &_stub->_tracker, [this, rpc](error_code err) mutable {
             on_duplication_sync_reply(err, rpc.response());
@@ -86,6 +123,13 @@ void duplication_sync_timer::on_duplication_sync_reply(error_code err,
     }
 
     zauto_lock l(_lock);
+    if (err == ERR_OK) {
+        _synced_confirms = std::move(_sending_confirms);
+    } else {
+        // the meta server may have missed any of them
+        _synced_confirms.clear();
+    }
+    _sending_confirms.clear();
     _rpc_task = nullptr;
 }
 
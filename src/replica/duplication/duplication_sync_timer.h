@@ -78,6 +78,13 @@ private:
     task_ptr _timer_task;
     task_ptr _rpc_task;
     mutable zlock _lock; // protect _rpc_task
+
+    // <gpid, dupid> -> confirmed decree, the confirm points known by meta server since the last
+    // successful sync, which are omitted from the next one unless they move
+    std::map<std::pair<gpid, dupid_t>, decree> _synced_confirms;
+    // the confirm points of the ongoing sync, which replace `_synced_confirms` on success
+    std::map<std::pair<gpid, dupid_t>, decree> _sending_confirms;
+    uint32_t _syncs_since_full_sync{0};
 };
 
 } // namespace replication
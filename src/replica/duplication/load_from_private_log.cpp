@@ -16,6 +16,7 @@
 // under the License.
 
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 #include "replica/replica_stub.h"
 #include "replica/replica.h"
@@ -26,6 +27,17 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  duplication_read_ahead_kb,
+                  0,
+                  "the max size of the log blocks a duplication reads ahead into one batch, "
+                  "0 means only one block is read each time");
+DSN_DEFINE_uint32("replication",
+                  duplication_load_rate_limit_mb,
+                  0,
+                  "the max rate in MB/s a duplication reads the private log, so that it doesn't "
+                  "compete with the writes on the disk, 0 means unlimited");
+
 /*static*/ constexpr int load_from_private_log::MAX_ALLOWED_BLOCK_REPEATS;
 /*static*/ constexpr int load_from_private_log::MAX_ALLOWED_FILE_REPEATS;
 
@@ -45,6 +57,12 @@ bool load_from_private_log::will_fail_fast() const
 // we try to list all files and select a new one to start (find_log_file_to_start).
 bool load_from_private_log::switch_to_next_log_file()
 {
+    if (_next != nullptr && _next->index() == _current->index() + 1) {
+        log_file_ptr file = std::move(_next);
+        start_from_log_file(file);
+        return true;
+    }
+
     auto file_map = _private_log->get_log_file_map();
     auto next_file_it = file_map.find(_current->index() + 1);
     if (next_file_it != file_map.end()) {
@@ -78,6 +96,23 @@ void load_from_private_log::run()
         }
     }
 
+    if (FLAGS_duplication_load_rate_limit_mb > 0) {
+        double rate = FLAGS_duplication_load_rate_limit_mb * 1024.0 * 1024.0;
+        if (_read_limiter.available(rate, rate) <= 0) {
+            // the tokens were borrowed by the previous reads
+            repeat(100_ms);
+            return;
+        }
+    }
+
+    if (replica_memory_budget::enabled() &&
+        _stub->memory_budget().is_throttled(memory_subsystem::DUPLICATION)) {
+        // wait for the loaded mutations to be shipped
+        _stub->memory_budget().on_throttled();
+        repeat(100_ms);
+        return;
+    }
+
     replay_log_block();
 }
 
@@ -105,6 +140,7 @@ void load_from_private_log::find_log_file_to_start()
 void load_from_private_log::find_log_file_to_start(std::map<int, log_file_ptr> log_file_map)
 {
     _current = nullptr;
+    _next = nullptr;
     if (dsn_unlikely(log_file_map.empty())) {
         derror_replica("unable to start duplication since no log file is available");
         return;
@@ -131,9 +167,14 @@ void load_from_private_log::find_log_file_to_start(std::map<int, log_file_ptr> l
 
 void load_from_private_log::replay_log_block()
 {
+    int64_t prev_end_offset = _current_global_end_offset;
     error_s err =
         mutation_log::replay_block(_current,
                                    [this](int log_bytes_length, mutation_ptr &mu) -> bool {
+                                       if (replica_memory_budget::enabled()) {
+                                           mu->charge_memory(&_stub->memory_budget(),
+                                                             memory_subsystem::DUPLICATION);
+                                       }
                                        auto es = _mutation_batch.add(std::move(mu));
                                        dassert_replica(es.is_ok(), es.description());
                                        _counter_dup_log_read_bytes_rate->add(log_bytes_length);
@@ -147,6 +188,13 @@ void load_from_private_log::replay_log_block()
             repeat();
             return;
         }
+        if (err.code() == ERR_HANDLE_EOF && _read_ahead_bytes > 0) {
+            // caught up with the private log, ship what has been read ahead
+            _read_ahead_bytes = 0;
+            step_down_next_stage(_mutation_batch.last_decree(),
+                                 _mutation_batch.move_all_mutations());
+            return;
+        }
 
         // Error handling on loading failure:
         // - If block loading failed for `MAX_ALLOWED_REPEATS` times, it restarts reading the file.
@@ -194,8 +242,21 @@ void load_from_private_log::replay_log_block()
     }
 
     _start_offset = static_cast<size_t>(_current_global_end_offset - _current->start_offset());
+    _read_ahead_bytes += _current_global_end_offset - prev_end_offset;
+    if (FLAGS_duplication_load_rate_limit_mb > 0) {
+        double rate = FLAGS_duplication_load_rate_limit_mb * 1024.0 * 1024.0;
+        _read_limiter.consumeWithBorrowNonBlocking(
+            std::min<double>(_current_global_end_offset - prev_end_offset, rate), rate, rate);
+    }
+
+    if (should_read_ahead()) {
+        open_next_log_file();
+        repeat();
+        return;
+    }
 
     // update last_decree even for empty batch.
+    _read_ahead_bytes = 0;
     step_down_next_stage(_mutation_batch.last_decree(), _mutation_batch.move_all_mutations());
 }
 
@@ -233,11 +294,50 @@ void load_from_private_log::set_start_decree(decree start_decree)
     _mutation_batch.set_start_decree(start_decree);
 }
 
+bool load_from_private_log::should_read_ahead()
+{
+    if (_read_ahead_bytes >= static_cast<int64_t>(FLAGS_duplication_read_ahead_kb) << 10) {
+        return false;
+    }
+    if (FLAGS_duplication_load_rate_limit_mb > 0) {
+        double rate = FLAGS_duplication_load_rate_limit_mb * 1024.0 * 1024.0;
+        if (_read_limiter.available(rate, rate) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void load_from_private_log::open_next_log_file()
+{
+    if (_next != nullptr) {
+        return;
+    }
+    auto file_map = _private_log->get_log_file_map();
+    auto next_file_it = file_map.find(_current->index() + 1);
+    if (next_file_it == file_map.end()) {
+        return;
+    }
+    log_file_ptr file;
+    error_s es = log_utils::open_read(next_file_it->second->path(), file);
+    if (!es.is_ok()) {
+        // retried by switch_to_next_log_file
+        dwarn_replica("{}", es);
+        return;
+    }
+    // issues the first reads of the file
+    file->reset_stream(0);
+    _next = std::move(file);
+}
+
 void load_from_private_log::start_from_log_file(log_file_ptr f)
 {
     ddebug_replica("start loading from log file {}", f->path());
 
     _current = std::move(f);
+    if (_next != nullptr && _next->index() != _current->index() + 1) {
+        _next = nullptr;
+    }
     _start_offset = 0;
     _current_global_end_offset = _current->start_offset();
     _err_block_repeats_num = 0;
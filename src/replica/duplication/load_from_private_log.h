@@ -19,6 +19,7 @@
 
 #include <dsn/cpp/pipeline.h>
 #include <dsn/utility/errors.h>
+#include <dsn/utility/TokenBucket.h>
 #include <dsn/dist/replication/mutation_duplicator.h>
 #include <gtest/gtest_prod.h>
 
@@ -35,6 +36,10 @@ class replica_stub;
 /// It works in THREAD_POOL_REPLICATION_LONG (LPC_DUPLICATION_LOAD_MUTATIONS),
 /// which permits tasks to be executed in a blocking way.
 /// NOTE: The resulted `mutation_tuple_set` may be empty.
+///
+/// When FLAGS_duplication_read_ahead_kb is set, it keeps reading the following blocks
+/// (through the log file boundaries) into the batch before stepping down, and opens the
+/// next log file in advance so that its first reads are issued asynchronously.
 class load_from_private_log final : public replica_base,
                                     public pipeline::when<>,
                                     public pipeline::result<decree, mutation_tuple_set>
@@ -62,6 +67,12 @@ public:
 
     void start_from_log_file(log_file_ptr f);
 
+    // Returns true if the next block should be read into the current batch.
+    bool should_read_ahead();
+
+    // Opens the log file following `_current` if it's already there.
+    void open_next_log_file();
+
     bool will_fail_skip() const;
     bool will_fail_fast() const;
 
@@ -82,6 +93,8 @@ private:
     replica_stub *_stub;
 
     log_file_ptr _current;
+    // the log file following `_current`, opened in advance for read-ahead
+    log_file_ptr _next;
 
     size_t _start_offset{0};
     int64_t _current_global_end_offset{0};
@@ -94,6 +107,10 @@ private:
 
     decree _start_decree{0};
 
+    // bytes read into `_mutation_batch` since it was stepped down last time
+    int64_t _read_ahead_bytes{0};
+    folly::DynamicTokenBucket _read_limiter;
+
     perf_counter_wrapper _counter_dup_load_file_failed_count;
     perf_counter_wrapper _counter_dup_load_skipped_bytes_count;
     perf_counter_wrapper _counter_dup_log_read_bytes_rate;
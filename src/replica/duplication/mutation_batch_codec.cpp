@@ -0,0 +1,181 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/mutation_duplicator.h>
+#include <dsn/utility/binary_reader.h>
+#include <dsn/utility/binary_writer.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_string("replication",
+                  duplication_batch_compression_type,
+                  "none",
+                  "compress the mutation batches shipped by duplication with: none, lz4 or zstd, "
+                  "if the remote cluster supports it");
+DSN_DEFINE_validator(duplication_batch_compression_type, [](const char *name) {
+    utils::compression_type type;
+    return utils::compression_type_from_string(name, type) && utils::compression_supported(type);
+});
+
+namespace {
+
+static constexpr uint32_t MUTATION_BATCH_MAGIC = 0x6475706d; // "dupm"
+
+struct mutation_batch_header
+{
+    uint32_t magic{MUTATION_BATCH_MAGIC};
+    uint32_t type{0};       // utils::compression_type, may be none if the data is incompressible
+    uint32_t raw_length{0}; // length of the mutations before compression
+    uint32_t count{0};      // count of the mutations
+};
+
+template <typename T>
+bool read_checked(binary_reader &reader, /*out*/ T &val)
+{
+    return reader.get_remaining_size() >= static_cast<int>(sizeof(T)) &&
+           reader.read_pod(val) == static_cast<int>(sizeof(T));
+}
+
+bool read_checked(binary_reader &reader, /*out*/ blob &val)
+{
+    int32_t len = 0;
+    return read_checked(reader, len) && len >= 0 && len <= reader.get_remaining_size() &&
+           reader.read(val, len) == len;
+}
+
+} // anonymous namespace
+
+uint32_t supported_batch_compressions()
+{
+    uint32_t mask = 0;
+    for (auto t : {utils::compression_type::none,
+                   utils::compression_type::lz4,
+                   utils::compression_type::zstd}) {
+        if (utils::compression_supported(t)) {
+            mask |= 1u << static_cast<uint32_t>(t);
+        }
+    }
+    return mask;
+}
+
+utils::compression_type negotiate_batch_compression(uint32_t remote_compressions)
+{
+    utils::compression_type type = utils::compression_type::none;
+    utils::compression_type_from_string(FLAGS_duplication_batch_compression_type, type);
+    if ((remote_compressions & (1u << static_cast<uint32_t>(type))) == 0) {
+        return utils::compression_type::none;
+    }
+    return type;
+}
+
+blob encode_mutation_batch(const mutation_tuple_set &mutations, utils::compression_type type)
+{
+    // the task codes are encoded by names, as their values differ among the processes
+    binary_writer writer;
+    for (const mutation_tuple &mut : mutations) {
+        writer.write(std::get<0>(mut));
+        writer.write(std::string(std::get<1>(mut).to_string()));
+        writer.write(std::get<2>(mut));
+    }
+    blob raw = writer.get_buffer();
+
+    mutation_batch_header hdr;
+    hdr.raw_length = raw.length();
+    hdr.count = static_cast<uint32_t>(mutations.size());
+
+    size_t bound =
+        type == utils::compression_type::none ? 0 : utils::compress_bound(type, raw.length());
+    if (bound > 0) {
+        std::shared_ptr<char> buf = utils::make_shared_array<char>(sizeof(hdr) + bound);
+        size_t sz =
+            utils::compress(type, raw.data(), raw.length(), buf.get() + sizeof(hdr), bound);
+        // stored as is if it's incompressible
+        if (sz > 0 && sz < raw.length()) {
+            hdr.type = static_cast<uint32_t>(type);
+            memcpy(buf.get(), &hdr, sizeof(hdr));
+            return blob(std::move(buf), 0, static_cast<unsigned int>(sizeof(hdr) + sz));
+        }
+    }
+
+    hdr.type = static_cast<uint32_t>(utils::compression_type::none);
+    std::shared_ptr<char> buf = utils::make_shared_array<char>(sizeof(hdr) + raw.length());
+    memcpy(buf.get(), &hdr, sizeof(hdr));
+    memcpy(buf.get() + sizeof(hdr), raw.data(), raw.length());
+    return blob(std::move(buf), 0, static_cast<unsigned int>(sizeof(hdr) + raw.length()));
+}
+
+error_s decode_mutation_batch(const blob &data, /*out*/ std::vector<mutation_tuple> &mutations)
+{
+    mutation_batch_header hdr;
+    if (data.length() < sizeof(hdr)) {
+        return FMT_ERR(ERR_INVALID_DATA, "invalid mutation batch, length = {}", data.length());
+    }
+    memcpy(&hdr, data.data(), sizeof(hdr));
+    if (hdr.magic != MUTATION_BATCH_MAGIC) {
+        return FMT_ERR(ERR_INVALID_DATA, "invalid magic of mutation batch: {:#x}", hdr.magic);
+    }
+
+    blob raw = data.range(sizeof(hdr));
+    auto type = static_cast<utils::compression_type>(hdr.type);
+    if (type != utils::compression_type::none) {
+        if (!utils::compression_supported(type)) {
+            return FMT_ERR(
+                ERR_INVALID_DATA, "unsupported compression type of mutation batch: {}", hdr.type);
+        }
+        std::shared_ptr<char> buf = utils::make_shared_array<char>(hdr.raw_length);
+        if (!utils::decompress(type, raw.data(), raw.length(), buf.get(), hdr.raw_length)) {
+            return FMT_ERR(ERR_INVALID_DATA,
+                           "failed to decompress mutation batch by {}, length = {}",
+                           utils::compression_type_to_string(type),
+                           raw.length());
+        }
+        raw = blob(std::move(buf), 0, hdr.raw_length);
+    }
+    if (raw.length() != hdr.raw_length) {
+        return FMT_ERR(ERR_INVALID_DATA,
+                       "invalid length of mutation batch: {} vs {}",
+                       raw.length(),
+                       hdr.raw_length);
+    }
+
+    binary_reader reader(raw);
+    mutations.clear();
+    mutations.reserve(hdr.count);
+    for (uint32_t i = 0; i < hdr.count; ++i) {
+        uint64_t timestamp = 0;
+        blob code_name;
+        blob payload;
+        if (!read_checked(reader, timestamp) || !read_checked(reader, code_name) ||
+            !read_checked(reader, payload)) {
+            return FMT_ERR(ERR_INVALID_DATA, "mutation batch is truncated at mutation {}", i);
+        }
+        task_code code = task_code::try_get(code_name.to_string(), TASK_CODE_INVALID);
+        if (code == TASK_CODE_INVALID) {
+            return FMT_ERR(ERR_INVALID_DATA,
+                           "unknown task code of mutation batch: {}",
+                           code_name.to_string());
+        }
+        mutations.emplace_back(timestamp, code, std::move(payload));
+    }
+    return error_s::ok();
+}
+
+} // namespace replication
+} // namespace dsn
@@ -7,9 +7,11 @@
 
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
+DSN_DECLARE_uint32(duplication_full_sync_rounds);
 
 class duplication_sync_timer_test : public duplication_test_base
 {
@@ -343,6 +345,59 @@ public:
         ASSERT_EQ(find_dup(stub->find_replica(1, 0), 2)->_status, duplication_status::DS_PAUSE);
     }
 
+    void test_delta_sync()
+    {
+        uint32_t origin_rounds = FLAGS_duplication_full_sync_rounds;
+        FLAGS_duplication_full_sync_rounds = 3;
+
+        duplication_sync_response resp;
+        for (int appid = 1; appid <= 2; appid++) {
+            auto r = stub->add_primary_replica(appid, 1);
+            duplication_entry ent;
+            ent.dupid = 1;
+            ent.progress[1] = 1000;
+            ent.status = duplication_status::DS_PAUSE;
+            add_dup(r, dsn::make_unique<replica_duplicator>(ent, r));
+            find_dup(r, 1)->update_progress(duplication_progress().set_last_decree(1500));
+            resp.dup_map[appid][ent.dupid] = ent;
+        }
+        stub->set_state_connected();
+
+        auto sync_and_count = [this]() {
+            size_t count = 0;
+            RPC_MOCKING(duplication_sync_rpc)
+            {
+                dup_sync->run();
+                const auto &req = duplication_sync_rpc::mail_box().back().request();
+                for (const auto &kv : req.confirm_list) {
+                    count += kv.second.size();
+                }
+            }
+            return count;
+        };
+
+        // the confirm points are sent until the meta server has received them
+        ASSERT_EQ(sync_and_count(), 2);
+        dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+        ASSERT_EQ(sync_and_count(), 0);
+        dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+
+        // all of them are sent in a full sync
+        ASSERT_EQ(sync_and_count(), 2);
+        dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+
+        // only the moved one is sent
+        find_dup(stub->find_replica(1, 1), 1)
+            ->update_progress(duplication_progress().set_last_decree(1600));
+        ASSERT_EQ(sync_and_count(), 1);
+
+        // all of them are sent again after a failed sync
+        dup_sync->on_duplication_sync_reply(ERR_TIMEOUT, resp);
+        ASSERT_EQ(sync_and_count(), 2);
+
+        FLAGS_duplication_full_sync_rounds = origin_rounds;
+    }
+
 protected:
     std::unique_ptr<duplication_sync_timer> dup_sync;
 };
@@ -359,6 +414,8 @@ TEST_F(duplication_sync_timer_test, on_duplication_sync_reply) { test_on_duplica
 
 TEST_F(duplication_sync_timer_test, replica_status_transition) { test_replica_status_transition(); }
 
+TEST_F(duplication_sync_timer_test, delta_sync) { test_delta_sync(); }
+
 TEST_F(duplication_sync_timer_test, receive_illegal_duplication_status)
 {
     test_receive_illegal_duplication_status();
@@ -5,6 +5,7 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/defer.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem/operations.hpp>
@@ -17,6 +18,8 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(duplication_read_ahead_kb);
+
 DEFINE_STORAGE_WRITE_RPC_CODE(RPC_RRDB_RRDB_PUT, ALLOW_BATCH, IS_IDEMPOTENT)
 
 class load_from_private_log_test : public duplication_test_base
@@ -238,6 +241,18 @@ TEST_F(load_from_private_log_test, start_duplication_100000_4MB)
     test_start_duplication(100000, 4);
 }
 
+TEST_F(load_from_private_log_test, start_duplication_read_ahead)
+{
+    uint32_t old_read_ahead_kb = FLAGS_duplication_read_ahead_kb;
+    FLAGS_duplication_read_ahead_kb = 256;
+    auto cleanup = dsn::defer([old_read_ahead_kb]() {
+        FLAGS_duplication_read_ahead_kb = old_read_ahead_kb;
+    });
+
+    // the blocks are read ahead through the log file boundaries
+    test_start_duplication(50000, 1);
+}
+
 // Ensure replica_duplicator can correctly handle real-world log file
 TEST_F(load_from_private_log_test, handle_real_private_log)
 {
@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/dist/replication/mutation_duplicator.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_string(duplication_batch_compression_type);
+
+static mutation_tuple_set create_test_mutations(int count)
+{
+    mutation_tuple_set mutations;
+    for (int i = 0; i < count; ++i) {
+        std::string value = "value of the mutation for duplication " + std::to_string(i % 7);
+        mutations.emplace(
+            i / 2, RPC_REPLICATION_WRITE_EMPTY, blob::create_from_bytes(std::move(value)));
+    }
+    return mutations;
+}
+
+TEST(mutation_batch_codec, round_trip)
+{
+    mutation_tuple_set mutations = create_test_mutations(100);
+    for (auto type : {utils::compression_type::none,
+                      utils::compression_type::lz4,
+                      utils::compression_type::zstd}) {
+        if (!utils::compression_supported(type)) {
+            continue;
+        }
+        blob data = encode_mutation_batch(mutations, type);
+
+        std::vector<mutation_tuple> decoded;
+        ASSERT_TRUE(decode_mutation_batch(data, decoded).is_ok());
+        ASSERT_EQ(decoded.size(), mutations.size());
+        auto it = mutations.begin();
+        for (const mutation_tuple &mut : decoded) {
+            ASSERT_EQ(std::get<0>(mut), std::get<0>(*it));
+            ASSERT_EQ(std::get<1>(mut), std::get<1>(*it));
+            ASSERT_EQ(std::get<2>(mut).to_string(), std::get<2>(*it).to_string());
+            ++it;
+        }
+
+        // the batch is truncated
+        ASSERT_FALSE(decode_mutation_batch(data.range(0, data.length() - 1), decoded).is_ok());
+    }
+
+    std::vector<mutation_tuple> decoded;
+    ASSERT_FALSE(decode_mutation_batch(blob::create_from_bytes("invalid"), decoded).is_ok());
+}
+
+TEST(mutation_batch_codec, negotiate)
+{
+    uint32_t supported = supported_batch_compressions();
+    ASSERT_NE(supported & (1u << static_cast<uint32_t>(utils::compression_type::none)), 0);
+
+    const char *old_type = FLAGS_duplication_batch_compression_type;
+    FLAGS_duplication_batch_compression_type = "lz4";
+    ASSERT_EQ(negotiate_batch_compression(supported),
+              utils::compression_supported(utils::compression_type::lz4)
+                  ? utils::compression_type::lz4
+                  : utils::compression_type::none);
+    // the remote doesn't support lz4
+    ASSERT_EQ(negotiate_batch_compression(1u), utils::compression_type::none);
+    FLAGS_duplication_batch_compression_type = old_type;
+}
+
+} // namespace replication
+} // namespace dsn
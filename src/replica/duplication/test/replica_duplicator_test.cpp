@@ -63,7 +63,7 @@ public:
 
             duplicator->update_status_if_needed(duplication_status::DS_START);
             ASSERT_EQ(duplicator->_status, duplication_status::DS_START);
-            auto expected_env = duplicator->_ship->_mutation_duplicator->_env;
+            auto expected_env = duplicator->_ship->_mutation_duplicators[0]->_env;
             ASSERT_EQ(duplicator->tracker(), expected_env.__conf.tracker);
             ASSERT_EQ(duplicator->get_gpid().thread_hash(), expected_env.__conf.thread_hash);
 
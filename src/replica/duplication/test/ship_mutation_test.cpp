@@ -6,9 +6,13 @@
 #include "replica/duplication/duplication_pipeline.h"
 #include "duplication_test_base.h"
 
+#include <dsn/utility/flags.h>
+
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(duplication_max_inflight_batches);
+
 /*static*/ mock_mutation_duplicator::duplicate_function mock_mutation_duplicator::_func;
 
 struct mock_stage : pipeline::when<>
@@ -67,6 +71,48 @@ public:
         ASSERT_EQ(duplicator->progress().last_decree, 2);
     }
 
+    // ensure the progress only advances over the contiguous acked batches.
+    void test_ship_inflight_batches()
+    {
+        uint32_t old_window = FLAGS_duplication_max_inflight_batches;
+        FLAGS_duplication_max_inflight_batches = 2;
+
+        ship_mutation shipper(duplicator.get());
+        mock_stage end;
+
+        pipeline::base base;
+        base.thread_pool(LPC_REPLICATION_LONG_LOW).task_tracker(_replica->tracker());
+        base.from(shipper).link(end);
+
+        std::vector<mutation_duplicator::callback> callbacks;
+        mock_mutation_duplicator::mock(
+            [&callbacks](mutation_tuple_set, mutation_duplicator::callback cb) {
+                callbacks.emplace_back(std::move(cb));
+            });
+        _replica->set_last_committed_decree(4);
+
+        for (int64_t d = 1; d <= 4; d += 2) {
+            mutation_batch batch(duplicator.get());
+            batch.add(create_test_mutation(d, "hello"));
+            batch.add(create_test_mutation(d + 1, "hello"));
+            shipper.run(d + 1, batch.move_all_mutations());
+        }
+        ASSERT_EQ(callbacks.size(), 2);
+        ASSERT_EQ(shipper.last_inflight_decree(), 4);
+
+        // the later batch is acked first
+        callbacks[1](0);
+        ASSERT_EQ(duplicator->progress().last_decree, invalid_decree);
+        ASSERT_EQ(shipper.last_inflight_decree(), 4);
+
+        callbacks[0](0);
+        ASSERT_EQ(duplicator->progress().last_decree, 4);
+        ASSERT_EQ(shipper.last_inflight_decree(), invalid_decree);
+
+        base.wait_all();
+        FLAGS_duplication_max_inflight_batches = old_window;
+    }
+
     ship_mutation *mock_ship_mutation()
     {
         duplicator->_ship = make_unique<ship_mutation>(duplicator.get());
@@ -78,6 +124,8 @@ public:
 
 TEST_F(ship_mutation_test, ship_mutation_tuple_set) { test_ship_mutation_tuple_set(); }
 
+TEST_F(ship_mutation_test, ship_inflight_batches) { test_ship_inflight_batches(); }
+
 void retry(pipeline::base *base)
 {
     base->schedule([base]() { retry(base); }, 10_s);
@@ -0,0 +1,220 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "group_check_batcher.h"
+#include "replica_stub.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                group_check_batch_enabled,
+                false,
+                "whether to send the group checks to the same node in one batched rpc");
+DSN_DEFINE_uint32("replication",
+                  group_check_batch_interval_ms,
+                  100,
+                  "interval in milliseconds to send the batched group checks");
+DSN_DEFINE_uint32("replication",
+                  group_check_batch_max_count,
+                  1024,
+                  "max count of group checks in one batch, the batch is sent at once when full");
+DSN_DEFINE_uint32("replication",
+                  group_check_batch_retry_interval_s,
+                  300,
+                  "interval in seconds to retry batching the group checks to a node which didn't "
+                  "handle them, the checks are sent to it one by one meanwhile");
+DSN_DEFINE_validator(group_check_batch_interval_ms, [](uint32_t value) -> bool {
+    return value > 0;
+});
+DSN_DEFINE_validator(group_check_batch_max_count, [](uint32_t value) -> bool {
+    return value > 0;
+});
+
+/*static*/ bool group_check_batcher::enabled() { return FLAGS_group_check_batch_enabled; }
+
+group_check_batcher::group_check_batcher(replica_stub *stub) : _stub(stub) {}
+
+group_check_batcher::~group_check_batcher() {}
+
+void group_check_batcher::start()
+{
+    ddebug_f("send batched group checks periodically in {}ms", FLAGS_group_check_batch_interval_ms);
+
+    _timer_task =
+        tasking::enqueue_timer(LPC_GROUP_CHECK_BATCH,
+                               &_tracker,
+                               [this]() { flush(); },
+                               std::chrono::milliseconds(FLAGS_group_check_batch_interval_ms));
+}
+
+void group_check_batcher::close()
+{
+    if (_timer_task) {
+        _timer_task->cancel(true);
+        _timer_task = nullptr;
+    }
+    _tracker.cancel_outstanding_tasks();
+
+    // the callbacks of the queued checks are cancelled along with their replicas
+    zauto_lock l(_lock);
+    _pending.clear();
+    _unbatched_nodes.clear();
+}
+
+task_ptr group_check_batcher::add(const rpc_address &node,
+                                  const group_check_request &request,
+                                  task_tracker *tracker,
+                                  int thread_hash,
+                                  reply_callback &&callback)
+{
+    pending_check check;
+    check.request = request;
+    check.reply = std::make_shared<std::pair<error_code, group_check_response>>();
+    check.callback_task = tasking::create_task(
+        LPC_GROUP_CHECK_BATCH_REPLY,
+        tracker,
+        [ reply = check.reply, cb = std::move(callback) ]() {
+            cb(reply->first, std::move(reply->second));
+        },
+        thread_hash);
+    task_ptr callback_task = check.callback_task;
+
+    bool unbatched = false;
+    std::vector<pending_check> full;
+    {
+        zauto_lock l(_lock);
+        if (is_unbatched(node)) {
+            unbatched = true;
+        } else {
+            auto &checks = _pending[node];
+            checks.emplace_back(std::move(check));
+            if (checks.size() >= FLAGS_group_check_batch_max_count) {
+                full = std::move(checks);
+                _pending.erase(node);
+            }
+        }
+    }
+    if (unbatched) {
+        send_single(node, std::move(check));
+    } else if (!full.empty()) {
+        send(node, std::move(full));
+    }
+    return callback_task;
+}
+
+bool group_check_batcher::is_unbatched(const rpc_address &node)
+{
+    auto iter = _unbatched_nodes.find(node);
+    if (iter == _unbatched_nodes.end()) {
+        return false;
+    }
+    if (dsn_now_ms() >= iter->second) {
+        _unbatched_nodes.erase(iter);
+        return false;
+    }
+    return true;
+}
+
+void group_check_batcher::flush()
+{
+    std::map<rpc_address, std::vector<pending_check>> pending;
+    {
+        zauto_lock l(_lock);
+        pending.swap(_pending);
+    }
+    for (auto &kv : pending) {
+        send(kv.first, std::move(kv.second));
+    }
+}
+
+void group_check_batcher::send(const rpc_address &node, std::vector<pending_check> &&checks)
+{
+    auto request = make_unique<group_check_batch_request>();
+    request->requests.reserve(checks.size());
+    for (const auto &check : checks) {
+        request->requests.emplace_back(check.request);
+    }
+
+    dinfo_f("send {} group checks to {} in batch", checks.size(), node);
+
+    group_check_batch_rpc rpc(std::move(request), RPC_GROUP_CHECK_BATCH);
+    rpc.call(node, &_tracker, [ this, node, rpc, checks = std::move(checks) ](
+                                  error_code err) mutable {
+        on_batch_reply(node, err, checks, std::move(rpc.response().responses));
+    });
+}
+
+void group_check_batcher::send_single(const rpc_address &node, pending_check &&check)
+{
+    group_check_rpc rpc(make_unique<group_check_request>(check.request), RPC_GROUP_CHECK);
+    rpc.call(node, &_tracker, [ rpc, check = std::move(check) ](error_code err) mutable {
+        auto &reply = *check.reply;
+        reply.first = err;
+        if (err == ERR_OK) {
+            reply.second = std::move(rpc.response());
+        }
+        check.callback_task->enqueue();
+    });
+}
+
+void group_check_batcher::on_batch_reply(const rpc_address &node,
+                                         error_code err,
+                                         std::vector<pending_check> &checks,
+                                         std::vector<group_check_response> &&responses)
+{
+    if (err == ERR_HANDLER_NOT_FOUND) {
+        // the remote node is of an old version which doesn't know RPC_GROUP_CHECK_BATCH
+        dwarn_f("{} didn't handle {} group checks in batch, send them one by one in the next {}s",
+                node,
+                checks.size(),
+                FLAGS_group_check_batch_retry_interval_s);
+        uint64_t retry_ts_ms =
+            dsn_now_ms() + static_cast<uint64_t>(FLAGS_group_check_batch_retry_interval_s) * 1000;
+        {
+            zauto_lock l(_lock);
+            _unbatched_nodes[node] = retry_ts_ms;
+        }
+        for (auto &check : checks) {
+            send_single(node, std::move(check));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < checks.size(); ++i) {
+        auto &reply = *checks[i].reply;
+        if (err != ERR_OK) {
+            reply.first = err;
+        } else if (i >= responses.size()) {
+            // the remote node didn't handle the check, e.g. it is not connected to meta
+            reply.first = ERR_INVALID_STATE;
+        } else {
+            reply.first = ERR_OK;
+            reply.second = std::move(responses[i]);
+        }
+        // it is harmless if the check has been cancelled by its replica
+        checks[i].callback_task->enqueue();
+    }
+}
+
+} // namespace replication
+} // namespace dsn
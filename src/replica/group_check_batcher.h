@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/tool-api/zlocks.h>
+
+#include "common/replication_common.h"
+
+#include <map>
+#include <vector>
+
+namespace dsn {
+namespace replication {
+
+class replica_stub;
+
+// Per-server(replica_stub)-instance.
+// Aggregates the group checks from all the primaries on this node to the same remote node,
+// and sends them in one RPC_GROUP_CHECK_BATCH per [replication] group_check_batch_interval_ms,
+// instead of one RPC_GROUP_CHECK per secondary per partition.
+// The remote nodes of an old version which don't handle RPC_GROUP_CHECK_BATCH are sent
+// RPC_GROUP_CHECK one by one, until batching is retried after
+// [replication] group_check_batch_retry_interval_s.
+class group_check_batcher
+{
+public:
+    typedef std::function<void(error_code, group_check_response &&)> reply_callback;
+
+    static bool enabled();
+
+    explicit group_check_batcher(replica_stub *stub);
+
+    ~group_check_batcher();
+
+    void start();
+
+    void close();
+
+    // Queues a group check to `node`. Returns the task that runs `callback` in
+    // `tracker` with `thread_hash` once the reply of its batch arrives, which can
+    // be cancelled like the one returned by rpc::call.
+    task_ptr add(const rpc_address &node,
+                 const group_check_request &request,
+                 task_tracker *tracker,
+                 int thread_hash,
+                 reply_callback &&callback);
+
+    // Sends out all the queued group checks.
+    void flush();
+
+private:
+    struct pending_check
+    {
+        group_check_request request;
+        task_ptr callback_task;
+        std::shared_ptr<std::pair<error_code, group_check_response>> reply;
+    };
+
+    void send(const rpc_address &node, std::vector<pending_check> &&checks);
+
+    void send_single(const rpc_address &node, pending_check &&check);
+
+    void on_batch_reply(const rpc_address &node,
+                        error_code err,
+                        std::vector<pending_check> &checks,
+                        std::vector<group_check_response> &&responses);
+
+    // Whether `node` is known not to handle RPC_GROUP_CHECK_BATCH, must be called with _lock held.
+    bool is_unbatched(const rpc_address &node);
+
+private:
+    friend class group_check_batcher_test;
+
+    replica_stub *_stub;
+
+    task_ptr _timer_task;
+    mutable zlock _lock; // protect _pending and _unbatched_nodes
+    std::map<rpc_address, std::vector<pending_check>> _pending;
+    // node => time in milliseconds to retry batching the group checks to it
+    std::map<rpc_address, uint64_t> _unbatched_nodes;
+
+    dsn::task_tracker _tracker;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "group_commit_controller.h"
+
+#include <algorithm>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                log_adaptive_group_commit,
+                false,
+                "whether to size the write batches of shared and private logs dynamically to "
+                "meet log_group_commit_latency_target_us instead of using the static "
+                "batch buffer limits");
+DSN_DEFINE_uint32("replication",
+                  log_group_commit_latency_target_us,
+                  2000,
+                  "the target latency (in microseconds) from appending a mutation to the log "
+                  "until it is durable, under adaptive group commit");
+DSN_DEFINE_uint32("replication",
+                  log_group_commit_max_batch_count,
+                  512,
+                  "the max count of mutations in one write batch under adaptive group commit");
+DSN_DEFINE_validator(log_group_commit_max_batch_count,
+                     [](uint32_t value) -> bool { return value > 0; });
+
+// an idle period longer than this is not taken as the interval of a steady arrival
+static const uint64_t kMaxArrivalIntervalUs = 1000 * 1000;
+
+/*static*/ bool group_commit_controller::enabled() { return FLAGS_log_adaptive_group_commit; }
+
+group_commit_controller::group_commit_controller(const char *counter_name)
+{
+    if (enabled()) {
+        _batch_size_counter.init_app_counter("eon.replica_stub",
+                                             counter_name,
+                                             COUNTER_TYPE_NUMBER_PERCENTILES,
+                                             "mutation count of each log write batch");
+    }
+}
+
+/*static*/ uint64_t group_commit_controller::ewma(uint64_t old_value, uint64_t sample)
+{
+    // weight 1/8 for the new sample, as tcp does for rtt
+    return old_value == 0 ? sample : (old_value * 7 + sample) / 8;
+}
+
+void group_commit_controller::on_append(uint64_t now_us)
+{
+    uint64_t last = _last_append_us.exchange(now_us, std::memory_order_relaxed);
+    if (last == 0 || now_us < last) {
+        return;
+    }
+    uint64_t interval = std::min(now_us - last, kMaxArrivalIntervalUs);
+    _arrival_interval_us.store(ewma(_arrival_interval_us.load(std::memory_order_relaxed), interval),
+                               std::memory_order_relaxed);
+}
+
+uint64_t group_commit_controller::flush_delay_us(uint32_t pending_count,
+                                                 uint64_t pending_start_us,
+                                                 uint64_t now_us)
+{
+    if (pending_count >= FLAGS_log_group_commit_max_batch_count) {
+        return 0;
+    }
+
+    uint64_t target = FLAGS_log_group_commit_latency_target_us;
+    uint64_t latency = write_latency_us();
+    if (latency >= target) {
+        // the write alone exceeds the target, waiting only adds to it
+        return 0;
+    }
+    uint64_t budget = target - latency;
+    uint64_t waited = now_us > pending_start_us ? now_us - pending_start_us : 0;
+    if (waited >= budget) {
+        return 0;
+    }
+    uint64_t remaining = budget - waited;
+
+    uint64_t interval = arrival_interval_us();
+    if (interval == 0 || interval >= remaining) {
+        // no more append is expected within the budget
+        return 0;
+    }
+    uint64_t expected_count = budget / interval + 1;
+    if (pending_count >= expected_count) {
+        return 0;
+    }
+    return remaining;
+}
+
+void group_commit_controller::on_write_issued(uint32_t mutation_count)
+{
+    if (_batch_size_counter.get() != nullptr) {
+        _batch_size_counter->set(mutation_count);
+    }
+}
+
+void group_commit_controller::on_write_completed(uint64_t latency_us)
+{
+    _write_latency_us.store(ewma(write_latency_us(), std::max<uint64_t>(latency_us, 1)),
+                            std::memory_order_relaxed);
+}
+
+} // namespace replication
+} // namespace dsn
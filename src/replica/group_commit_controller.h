@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+
+namespace dsn {
+namespace replication {
+
+// group_commit_controller decides when the pending mutations of a mutation log should be
+// issued as one write, in place of the static `log_private_batch_buffer_*` limits.
+//
+// It keeps an EWMA of the interval between two appends and of the time a write takes to
+// be durable (write + flush). The latency target is split into the write latency and a
+// waiting budget: a batch starts to be written when it is as large as the appends expected
+// within the budget, when its oldest mutation has waited for the budget, or immediately if
+// the next append is not expected before the budget runs out.
+//
+// The achieved batch size is reported by a percentile counter.
+//
+// Methods are thread-safe; the caller usually invokes on_append/flush_delay_us under the
+// log lock and on_write_completed from the write callback.
+class group_commit_controller
+{
+public:
+    // whether [replication] log_adaptive_group_commit is on
+    static bool enabled();
+
+    // `counter_name` is the name of the app counter of the achieved batch size, a counter
+    // is only created when adaptive group commit is enabled.
+    explicit group_commit_controller(const char *counter_name);
+
+    void on_append(uint64_t now_us);
+
+    // Returns how long (in microseconds) the caller should still wait before issuing the
+    // pending write of `pending_count` mutations, the first of which was appended at
+    // `pending_start_us`. 0 means the write should be issued now.
+    uint64_t flush_delay_us(uint32_t pending_count, uint64_t pending_start_us, uint64_t now_us);
+
+    void on_write_issued(uint32_t mutation_count);
+    void on_write_completed(uint64_t latency_us);
+
+    uint64_t arrival_interval_us() const
+    {
+        return _arrival_interval_us.load(std::memory_order_relaxed);
+    }
+    uint64_t write_latency_us() const { return _write_latency_us.load(std::memory_order_relaxed); }
+
+private:
+    static uint64_t ewma(uint64_t old_value, uint64_t sample);
+
+    // 0 means no sample yet
+    std::atomic<uint64_t> _arrival_interval_us{0};
+    std::atomic<uint64_t> _write_latency_us{0};
+    std::atomic<uint64_t> _last_append_us{0};
+
+    perf_counter_wrapper _batch_size_counter;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,177 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "hotkey_detector.h"
+
+#include <algorithm>
+#include <dsn/utility/flags.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                builtin_hotkey_detection_enabled,
+                false,
+                "whether to detect the hot keys in the replica layer by the partition hashes of "
+                "the requests, instead of by the app");
+DSN_DEFINE_bool("replication",
+                hotkey_detection_continuous,
+                false,
+                "whether to always detect the hot keys on the primaries, the results are "
+                "exposed at ip:port/replica/hotkeys");
+DSN_DEFINE_uint32("replication",
+                  hotkey_detection_sample_interval,
+                  10,
+                  "sample one of every this many requests for the hot key detection");
+DSN_DEFINE_uint32("replication",
+                  hotkey_detection_top_k,
+                  10,
+                  "the max count of the hot keys kept for a partition");
+DSN_DEFINE_validator(hotkey_detection_sample_interval,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_validator(hotkey_detection_top_k, [](uint32_t value) -> bool { return value > 0; });
+
+const int hotkey_detector::SKETCH_DEPTH;
+const int hotkey_detector::SKETCH_WIDTH;
+const uint64_t hotkey_detector::DECAY_SAMPLES;
+
+// the odd multipliers of the multiply-shift hashes of the sketch rows
+static const uint64_t kSketchSeeds[hotkey_detector::SKETCH_DEPTH] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL};
+
+/*static*/ bool hotkey_detector::enabled() { return FLAGS_builtin_hotkey_detection_enabled; }
+
+/*static*/ bool hotkey_detector::continuous()
+{
+    return FLAGS_builtin_hotkey_detection_enabled && FLAGS_hotkey_detection_continuous;
+}
+
+bool hotkey_detector::start()
+{
+    zauto_lock l(_lock);
+    if (running()) {
+        return false;
+    }
+    _sketch.assign(SKETCH_DEPTH * SKETCH_WIDTH, 0);
+    _top.clear();
+    _samples = 0;
+    _running.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool hotkey_detector::stop()
+{
+    zauto_lock l(_lock);
+    if (!running()) {
+        return false;
+    }
+    _running.store(false, std::memory_order_relaxed);
+    std::vector<uint32_t>().swap(_sketch);
+    std::unordered_map<uint64_t, uint64_t>().swap(_top);
+    return true;
+}
+
+void hotkey_detector::sample(uint64_t key)
+{
+    if (_seen.fetch_add(1, std::memory_order_relaxed) % FLAGS_hotkey_detection_sample_interval !=
+        0) {
+        return;
+    }
+
+    zauto_lock l(_lock);
+    // stopped just now
+    if (_sketch.empty()) {
+        return;
+    }
+
+    uint64_t estimate = add_to_sketch(key);
+    auto iter = _top.find(key);
+    if (iter != _top.end()) {
+        iter->second = estimate;
+    } else if (_top.size() < FLAGS_hotkey_detection_top_k) {
+        _top.emplace(key, estimate);
+    } else {
+        auto less = [](const std::pair<const uint64_t, uint64_t> &a,
+                       const std::pair<const uint64_t, uint64_t> &b) {
+            return a.second < b.second;
+        };
+        auto min = std::min_element(_top.begin(), _top.end(), less);
+        if (estimate > min->second) {
+            _top.erase(min);
+            _top.emplace(key, estimate);
+        }
+    }
+
+    if (++_samples >= DECAY_SAMPLES) {
+        decay();
+    }
+}
+
+uint64_t hotkey_detector::add_to_sketch(uint64_t key)
+{
+    static const int kShift = 64 - 8; // log2(SKETCH_WIDTH) = 8
+    static_assert(SKETCH_WIDTH == 1 << 8, "kShift mismatches SKETCH_WIDTH");
+
+    uint32_t estimate = UINT32_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; ++i) {
+        uint32_t &counter = _sketch[i * SKETCH_WIDTH + ((key * kSketchSeeds[i]) >> kShift)];
+        estimate = std::min(estimate, ++counter);
+    }
+    return estimate;
+}
+
+void hotkey_detector::decay()
+{
+    for (uint32_t &counter : _sketch) {
+        counter >>= 1;
+    }
+    for (auto &kv : _top) {
+        kv.second >>= 1;
+    }
+    _samples = 0;
+}
+
+std::vector<hotkey_detector::hotkey> hotkey_detector::top_keys() const
+{
+    std::vector<hotkey> keys;
+    {
+        zauto_lock l(_lock);
+        keys.reserve(_top.size());
+        for (const auto &kv : _top) {
+            keys.push_back({kv.first, kv.second});
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [](const hotkey &a, const hotkey &b) {
+        return a.count > b.count;
+    });
+    return keys;
+}
+
+std::string hotkey_detector::dump() const
+{
+    nlohmann::json json = nlohmann::json::array();
+    for (const hotkey &key : top_keys()) {
+        json.push_back(nlohmann::json{{"hash", fmt::format("{:#x}", key.hash)},
+                                      {"count", key.count}});
+    }
+    return json.dump();
+}
+
+} // namespace replication
+} // namespace dsn
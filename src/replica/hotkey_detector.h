@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <dsn/tool-api/zlocks.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dsn {
+namespace replication {
+
+// hotkey_detector finds the top-K hot keys among the requests of a partition with bounded
+// memory. A sampled key is counted in a count-min sketch, and the keys of the top estimates are
+// kept in a table of at most [replication] hotkey_detection_top_k entries. All the counts are
+// halved every DECAY_SAMPLES samples, so that a continuous detection follows the recent load.
+//
+// The replica layer can't decode the request keys of the app, so a key is the partition hash
+// of the request, which is the hash of the hash key of pegasus.
+//
+// The memory is allocated by start() and released by stop(). record() is lock free if the
+// detection is not running, and only the sampled requests take the lock.
+class hotkey_detector
+{
+public:
+    // whether [replication] builtin_hotkey_detection_enabled is on, otherwise the detect
+    // hotkey requests are served by the app
+    static bool enabled();
+    // whether the detection always runs on the primaries
+    static bool continuous();
+
+    struct hotkey
+    {
+        uint64_t hash;
+        uint64_t count;
+    };
+
+    static const int SKETCH_DEPTH = 4;
+    static const int SKETCH_WIDTH = 256;
+    static const uint64_t DECAY_SAMPLES = 100000;
+
+    // return false if it's running already.
+    bool start();
+    // return false if it's not running.
+    bool stop();
+    bool running() const { return _running.load(std::memory_order_relaxed); }
+
+    void record(uint64_t key)
+    {
+        if (running()) {
+            sample(key);
+        }
+    }
+
+    // the hot keys in the descending order of the sampled counts
+    std::vector<hotkey> top_keys() const;
+    // formatted as a json array of {"hash":"0x...","count":...}
+    std::string dump() const;
+
+private:
+    void sample(uint64_t key);
+    // under _lock
+    uint64_t add_to_sketch(uint64_t key);
+    void decay();
+
+    std::atomic_bool _running{false};
+    std::atomic<uint32_t> _seen{0};
+
+    mutable zlock _lock;
+    std::vector<uint32_t> _sketch;
+    std::unordered_map<uint64_t, uint64_t> _top;
+    uint64_t _samples{0};
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,56 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/utility/error_code.h>
+#include <cstddef>
+#include <mutex>
+
+namespace dsn {
+namespace replication {
+
+// Joins the concurrent copies of the checkpoint and of the private logs following it, the
+// last finished one goes on with the learning.
+class learn_copy_join
+{
+public:
+    explicit learn_copy_join(int count) : _pending(count) {}
+
+    // returns true if all the copies are finished
+    bool finish(error_code err, size_t size)
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (err != ERR_OK) {
+            _err = err;
+        }
+        _size += size;
+        return --_pending == 0;
+    }
+
+    error_code err() const { return _err; }
+    size_t size() const { return _size; }
+
+private:
+    std::mutex _lock;
+    int _pending;
+    error_code _err{ERR_OK};
+    size_t _size{0};
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "learn_scheduler.h"
+
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint64("replication",
+                  learn_scheduler_waiting_expire_ms,
+                  60000,
+                  "a learn of app refused by the learn scheduler is taken as waiting for so long "
+                  "since its last try, during which the less urgent learns are not admitted");
+DSN_TAG_VARIABLE(learn_scheduler_waiting_expire_ms, FT_MUTABLE);
+
+DSN_DEFINE_int32("replication",
+                 learn_urgent_replica_count,
+                 1,
+                 "the learns of app of the partitions served by no more than this many replicas "
+                 "copy the files in high priority of nfs, taking the bandwidth before the "
+                 "other learns of app");
+DSN_TAG_VARIABLE(learn_urgent_replica_count, FT_MUTABLE);
+
+bool learn_scheduler::try_admit(gpid pid, urgency u, int max_concurrent_count, uint64_t now_ms)
+{
+    zauto_lock l(_lock);
+    remove_expired_waitings(now_ms);
+
+    if (_running.count(pid) != 0) {
+        return true;
+    }
+
+    bool admitted = static_cast<int>(_running.size()) < max_concurrent_count;
+    for (auto it = _waiting.begin(); admitted && it != _waiting.end(); ++it) {
+        if (it->first != pid && it->second.u.higher_than(u)) {
+            admitted = false;
+        }
+    }
+
+    if (admitted) {
+        _waiting.erase(pid);
+        _running.emplace(pid, u);
+    } else {
+        _waiting[pid] = waiting_learn{u, now_ms};
+    }
+    return admitted;
+}
+
+void learn_scheduler::release(gpid pid)
+{
+    zauto_lock l(_lock);
+    _running.erase(pid);
+    _waiting.erase(pid);
+}
+
+bool learn_scheduler::is_full(int max_concurrent_count) const
+{
+    zauto_lock l(_lock);
+    return static_cast<int>(_running.size()) >= max_concurrent_count;
+}
+
+int learn_scheduler::running_count() const
+{
+    zauto_lock l(_lock);
+    return static_cast<int>(_running.size());
+}
+
+int learn_scheduler::waiting_count() const
+{
+    zauto_lock l(_lock);
+    return static_cast<int>(_waiting.size());
+}
+
+/*static*/ bool learn_scheduler::is_urgent(urgency u)
+{
+    return u.replica_count <= FLAGS_learn_urgent_replica_count;
+}
+
+void learn_scheduler::remove_expired_waitings(uint64_t now_ms)
+{
+    for (auto it = _waiting.begin(); it != _waiting.end();) {
+        if (it->second.last_seen_ms + FLAGS_learn_scheduler_waiting_expire_ms <= now_ms) {
+            it = _waiting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace replication
+} // namespace dsn
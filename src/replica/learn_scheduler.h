@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/tool-api/zlocks.h>
+#include <cstdint>
+#include <map>
+
+namespace dsn {
+namespace replication {
+
+// learn_scheduler admits the learns of the apps (LT_APP) of the replicas on this node, at most
+// [replication] learn_app_max_concurrent_count at a time, by the urgency of the partitions
+// rather than first come first served.
+//
+// A partition which is served by fewer replicas is more urgent, and of those with the same
+// count, the one missing more replicas of its max_replica_count set by meta server. A learn
+// is admitted only if there is a free slot and no learn waiting for one is more urgent; the
+// refused learns are remembered as waiting until they retry in a later round, or are not seen
+// for [replication] learn_scheduler_waiting_expire_ms.
+//
+// Methods are thread-safe.
+class learn_scheduler
+{
+public:
+    struct urgency
+    {
+        // the count of the replicas serving the partition, i.e. primary and secondaries
+        int replica_count;
+        // max_replica_count - replica_count
+        int missing_count;
+
+        // whether it's more urgent than `other`
+        bool higher_than(const urgency &other) const
+        {
+            return replica_count != other.replica_count ? replica_count < other.replica_count
+                                                        : missing_count > other.missing_count;
+        }
+    };
+
+    // Returns whether the learn of `pid` can start now, in which case it must be released later.
+    bool try_admit(gpid pid, urgency u, int max_concurrent_count, uint64_t now_ms);
+
+    // The learn of `pid` is completed or abandoned, and it's not waiting any more.
+    void release(gpid pid);
+
+    // whether no more learns can be admitted
+    bool is_full(int max_concurrent_count) const;
+
+    int running_count() const;
+    int waiting_count() const;
+
+    // Whether the learns of `u` should take the nfs bandwidth before the others, see
+    // [replication] learn_urgent_replica_count.
+    static bool is_urgent(urgency u);
+
+private:
+    void remove_expired_waitings(uint64_t now_ms);
+
+    struct waiting_learn
+    {
+        urgency u;
+        uint64_t last_seen_ms;
+    };
+
+    mutable zlock _lock;
+    std::map<gpid, urgency> _running;
+    std::map<gpid, waiting_learn> _waiting;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -4,9 +4,25 @@
 
 #include "log_block.h"
 
+#include <cstring>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/utils.h>
+#include <dsn/dist/fmt_logging.h>
+
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_string("replication",
+                  log_block_compression_type,
+                  "none",
+                  "compress the blocks of the mutation logs with: none, lz4 or zstd. The logs "
+                  "written with compression can't be read by the versions without it");
+
+DSN_DEFINE_validator(log_block_compression_type, [](const char *name) {
+    utils::compression_type type;
+    return utils::compression_type_from_string(name, type) && utils::compression_supported(type);
+});
+
 log_block::log_block(int64_t start_offset) : _start_offset(start_offset) { init(); }
 
 log_block::log_block() { init(); }
@@ -20,6 +36,94 @@ void log_block::init()
     add(temp_writer.get_buffer());
 }
 
+void log_block::compress(utils::compression_type type)
+{
+    dassert(!_compressed, "the log block has been compressed");
+
+    // the compressors need a continuous input, which is prefixed with a slot of the
+    // compression header, so that the data can be stored as is if it's incompressible
+    log_block_compression_header chdr;
+    chdr.raw_length = static_cast<uint32_t>(_size - sizeof(log_block_header));
+    std::shared_ptr<char> raw = utils::make_shared_array<char>(sizeof(chdr) + chdr.raw_length);
+    char *p = raw.get() + sizeof(chdr);
+    for (size_t i = 1; i < _data.size(); i++) {
+        memcpy(p, _data[i].data(), _data[i].length());
+        p += _data[i].length();
+    }
+
+    blob body;
+    size_t bound = type == utils::compression_type::none
+                       ? 0
+                       : utils::compress_bound(type, chdr.raw_length);
+    if (bound > 0) {
+        std::shared_ptr<char> buf = utils::make_shared_array<char>(sizeof(chdr) + bound);
+        size_t sz = utils::compress(
+            type, raw.get() + sizeof(chdr), chdr.raw_length, buf.get() + sizeof(chdr), bound);
+        if (sz > 0 && sz < chdr.raw_length) {
+            chdr.type = static_cast<uint32_t>(type);
+            memcpy(buf.get(), &chdr, sizeof(chdr));
+            body = blob(buf, static_cast<unsigned int>(sizeof(chdr) + sz));
+        }
+    }
+    if (body.length() == 0) {
+        chdr.type = static_cast<uint32_t>(utils::compression_type::none);
+        memcpy(raw.get(), &chdr, sizeof(chdr));
+        body = blob(raw, static_cast<unsigned int>(sizeof(chdr) + chdr.raw_length));
+    }
+
+    blob hdr_blob = _data.front();
+    auto hdr = reinterpret_cast<log_block_header *>(const_cast<char *>(hdr_blob.data()));
+    hdr->magic = static_cast<int32_t>(LOG_BLOCK_COMPRESSED_MAGIC);
+
+    _data.clear();
+    _size = 0;
+    add(hdr_blob);
+    add(body);
+    _compressed = true;
+}
+
+/*static*/ error_code log_block::decompress(const log_block_header &hdr, /*inout*/ blob &body)
+{
+    if (!hdr.is_compressed()) {
+        return ERR_OK;
+    }
+
+    log_block_compression_header chdr;
+    if (body.length() < sizeof(chdr)) {
+        derror_f("invalid compressed log block, length = {}", body.length());
+        return ERR_INVALID_DATA;
+    }
+    memcpy(&chdr, body.data(), sizeof(chdr));
+    blob payload = body.range(sizeof(chdr));
+
+    auto type = static_cast<utils::compression_type>(chdr.type);
+    if (type == utils::compression_type::none) {
+        if (payload.length() != chdr.raw_length) {
+            derror_f("invalid uncompressed log block, length = {} vs {}",
+                     payload.length(),
+                     chdr.raw_length);
+            return ERR_INVALID_DATA;
+        }
+        body = payload;
+        return ERR_OK;
+    }
+
+    if (!utils::compression_supported(type)) {
+        derror_f("unsupported compression type of log block: {}", chdr.type);
+        return ERR_INVALID_DATA;
+    }
+    std::shared_ptr<char> raw = utils::make_shared_array<char>(chdr.raw_length);
+    if (!utils::decompress(type, payload.data(), payload.length(), raw.get(), chdr.raw_length)) {
+        derror_f("failed to decompress log block by {}, length = {}, raw_length = {}",
+                 utils::compression_type_to_string(type),
+                 payload.length(),
+                 chdr.raw_length);
+        return ERR_INVALID_DATA;
+    }
+    body = blob(raw, chdr.raw_length);
+    return ERR_OK;
+}
+
 void log_appender::append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb)
 {
     _mutations.push_back(mu);
@@ -28,15 +132,39 @@ void log_appender::append_mutation(const mutation_ptr &mu, const aio_task_ptr &c
     }
     log_block *blk = &_blocks.back();
     if (blk->size() > DEFAULT_MAX_BLOCK_BYTES) {
+        if (_compression != utils::compression_type::none) {
+            blk->compress(_compression);
+        }
         _full_blocks_size += blk->size();
         _full_blocks_blob_cnt += blk->data().size();
         int64_t new_block_start_offset = blk->start_offset() + blk->size();
         _blocks.emplace_back(new_block_start_offset);
         blk = &_blocks.back();
     }
-    mu->data.header.log_offset = blk->start_offset() + blk->size();
+    if (_compression != utils::compression_type::none) {
+        // see log_block_compression_header
+        mu->data.header.log_offset = blk->start_offset() + sizeof(log_block_header);
+    } else {
+        mu->data.header.log_offset = blk->start_offset() + blk->size();
+    }
     mu->write_to([blk](const blob &bb) { blk->add(bb); });
 }
 
+void log_appender::seal()
+{
+    log_block &blk = _blocks.back();
+    if (_compression != utils::compression_type::none && !blk.compressed() &&
+        blk.size() > sizeof(log_block_header)) {
+        blk.compress(_compression);
+    }
+}
+
+/*static*/ utils::compression_type log_appender::configured_compression()
+{
+    utils::compression_type type = utils::compression_type::none;
+    utils::compression_type_from_string(FLAGS_log_block_compression_type, type);
+    return type;
+}
+
 } // namespace replication
 } // namespace dsn
@@ -6,19 +6,48 @@
 
 #include "mutation.h"
 
+#include <dsn/utility/compression.h>
+
 namespace dsn {
 namespace replication {
 
 // each block in log file has a log_block_header
+// the magic of the blocks whose body is a sequence of mutations
+static constexpr uint32_t LOG_BLOCK_MAGIC = 0xdeadbeef;
+// the magic of the blocks packed by log_block::compress, whose body is a
+// log_block_compression_header followed by the compressed mutations
+static constexpr uint32_t LOG_BLOCK_COMPRESSED_MAGIC = 0xdeadbee0;
+
 struct log_block_header
 {
-    int32_t magic{static_cast<int32_t>(0xdeadbeef)}; // 0xdeadbeef
+    int32_t magic{static_cast<int32_t>(LOG_BLOCK_MAGIC)};
     int32_t length{0};   // block data length (not including log_block_header)
     int32_t body_crc{0}; // block data crc (not including log_block_header)
 
     // start offset of the block (including log_block_header) in this log file
     // TODO(wutao1): this field is unusable. the value is always set, but not read.
     uint32_t local_offset{0};
+
+    bool is_valid() const
+    {
+        return magic == static_cast<int32_t>(LOG_BLOCK_MAGIC) ||
+               magic == static_cast<int32_t>(LOG_BLOCK_COMPRESSED_MAGIC);
+    }
+
+    bool is_compressed() const
+    {
+        return magic == static_cast<int32_t>(LOG_BLOCK_COMPRESSED_MAGIC);
+    }
+};
+
+// The position of a mutation inside a compressed body doesn't exist in the file, so all the
+// mutations in a compressed block take the offset right after the log_block_header as their
+// log_offset, which keeps the offsets comparable with the block boundaries, e.g. the
+// valid_start_offset of a private log.
+struct log_block_compression_header
+{
+    uint32_t type{0};       // utils::compression_type, may be none if the data is incompressible
+    uint32_t raw_length{0}; // length of the mutations before compression
 };
 
 // a memory structure holding data which belongs to one block.
@@ -64,9 +93,21 @@ public:
     // global offset to start writting this block
     int64_t start_offset() const { return _start_offset; }
 
+    bool compressed() const { return _compressed; }
+
+    // Packs all the mutations of the block into one compressed blob. The block can't be
+    // appended any more after that.
+    void compress(utils::compression_type type);
+
+    // Restores the mutations of a compressed block whose crc has been checked, does nothing
+    // if the block is not compressed.
+    static error_code decompress(const log_block_header &hdr, /*inout*/ blob &body);
+
 private:
     friend class log_appender;
     void init();
+
+    bool _compressed{false};
 };
 
 // Append writes into a buffer which consists of one or more fixed-size log blocks,
@@ -75,7 +116,12 @@ private:
 class log_appender
 {
 public:
-    explicit log_appender(int64_t start_offset) { _blocks.emplace_back(start_offset); }
+    explicit log_appender(int64_t start_offset,
+                          utils::compression_type compression = utils::compression_type::none)
+        : _compression(compression)
+    {
+        _blocks.emplace_back(start_offset);
+    }
 
     log_appender(int64_t start_offset, log_block &block)
     {
@@ -98,6 +144,13 @@ public:
 
     std::vector<log_block> &all_blocks() { return _blocks; }
 
+    // Compresses the unfilled block if compression is enabled, must be called before the
+    // blocks are written, as the size of the appender is changed.
+    void seal();
+
+    // The compression configured by [replication] log_block_compression_type.
+    static utils::compression_type configured_compression();
+
 protected:
     static constexpr size_t DEFAULT_MAX_BLOCK_BYTES = 1 * 1024 * 1024; // 1MB
 
@@ -111,6 +164,7 @@ protected:
     size_t _full_blocks_blob_cnt{0};
     std::vector<aio_task_ptr> _callbacks;
     std::vector<mutation_ptr> _mutations;
+    utils::compression_type _compression{utils::compression_type::none};
 };
 
 } // namespace replication
@@ -26,14 +26,22 @@
 
 #include "log_file.h"
 #include "log_file_stream.h"
+#include "spare_log_file_pool.h"
 
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                log_file_mmap_read,
+                false,
+                "whether to read log files through mmap when scanning them, e.g. replay and "
+                "duplication, which avoids allocating and copying every log block");
+
 log_file::~log_file() { close(); }
 /*static */ log_file_ptr log_file::open_read(const char *path, /*out*/ error_code &err)
 {
@@ -125,7 +133,10 @@ log_file::~log_file() { close(); }
     return lf;
 }
 
-/*static*/ log_file_ptr log_file::create_write(const char *dir, int index, int64_t start_offset)
+/*static*/ log_file_ptr log_file::create_write(const char *dir,
+                                               int index,
+                                               int64_t start_offset,
+                                               spare_log_file_pool *spares)
 {
     char path[512];
     sprintf(path, "%s/log.%d.%" PRId64, dir, index, start_offset);
@@ -135,6 +146,10 @@ log_file::~log_file() { close(); }
         return nullptr;
     }
 
+    if (spares != nullptr && spares->take(path)) {
+        dinfo("log file %s is taken from the spare files", path);
+    }
+
     disk_file *hfile = file::open(path, O_RDWR | O_CREAT | O_BINARY, 0666);
     if (!hfile) {
         dwarn("create log %s failed", path);
@@ -173,6 +188,7 @@ void log_file::close()
     //_stream implicitly refer to _handle so it needs to be cleaned up first.
     // TODO: We need better abstraction to avoid those manual stuffs..
     _stream.reset(nullptr);
+    _mmap_stream.reset(nullptr);
     if (_handle) {
         error_code err = file::close(_handle);
         dassert(err == ERR_OK, "file::close failed, err = %s", err.to_string());
@@ -193,9 +209,43 @@ void log_file::flush() const
 }
 
 error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
+{
+    log_block_header hdr;
+    return read_next_log_block(hdr, bb);
+}
+
+error_code log_file::read_next_log_block(/*out*/ log_block_header &hdr, /*out*/ ::dsn::blob &bb)
+{
+    error_code err = read_next_log_block_unchecked(hdr, bb);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    auto crc = crc_of_block(bb, _crc32);
+    if (crc != hdr.body_crc) {
+        derror("crc checking failed");
+        return ERR_INVALID_DATA;
+    }
+    _crc32 = crc;
+
+    return log_block::decompress(hdr, bb);
+}
+
+/*static*/ uint32_t log_file::crc_of_block(const ::dsn::blob &bb, uint32_t prev_crc)
+{
+    return dsn::utils::crc32_calc(
+        static_cast<const void *>(bb.data()), static_cast<size_t>(bb.length()), prev_crc);
+}
+
+error_code log_file::read_next_log_block_unchecked(/*out*/ log_block_header &hdr,
+                                                   /*out*/ ::dsn::blob &bb)
 {
     dassert(_is_read, "log file must be of read mode");
-    auto err = _stream->read_next(sizeof(log_block_header), bb);
+    auto read_next = [this](size_t size, blob &result) {
+        return _mmap_stream ? _mmap_stream->read_next(size, result)
+                            : _stream->read_next(size, result);
+    };
+    auto err = read_next(sizeof(log_block_header), bb);
     if (err != ERR_OK || bb.length() != sizeof(log_block_header)) {
         if (err == ERR_OK || err == ERR_HANDLE_EOF) {
             // if read_count is 0, then we meet the end of file
@@ -209,14 +259,14 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
 
         return err;
     }
-    log_block_header hdr = *reinterpret_cast<const log_block_header *>(bb.data());
+    hdr = *reinterpret_cast<const log_block_header *>(bb.data());
 
-    if (hdr.magic != 0xdeadbeef) {
+    if (!hdr.is_valid()) {
         derror("invalid data header magic: 0x%x", hdr.magic);
         return ERR_INVALID_DATA;
     }
 
-    err = _stream->read_next(hdr.length, bb);
+    err = read_next(hdr.length, bb);
     if (err != ERR_OK || hdr.length != bb.length()) {
         derror("read data block body failed, size = %d vs %d, err = %s",
                bb.length(),
@@ -231,14 +281,6 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
         return err;
     }
 
-    auto crc = dsn::utils::crc32_calc(
-        static_cast<const void *>(bb.data()), static_cast<size_t>(hdr.length), _crc32);
-    if (crc != hdr.body_crc) {
-        derror("crc checking failed");
-        return ERR_INVALID_DATA;
-    }
-    _crc32 = crc;
-
     return ERR_OK;
 }
 
@@ -274,7 +316,7 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
         int64_t local_offset = block.start_offset() - start_offset();
         auto hdr = reinterpret_cast<log_block_header *>(const_cast<char *>(block.front().data()));
 
-        dassert(hdr->magic == 0xdeadbeef, "");
+        dassert(hdr->is_valid(), "");
         hdr->local_offset = local_offset;
         hdr->length = static_cast<int32_t>(block.size() - sizeof(log_block_header));
         hdr->body_crc = _crc32;
@@ -324,7 +366,14 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
 
 void log_file::reset_stream(size_t offset /*default = 0*/)
 {
-    if (_stream == nullptr) {
+    if (_mmap_stream == nullptr && _stream == nullptr && _is_read && FLAGS_log_file_mmap_read) {
+        // fall back to file_streamer if the file can not be mapped
+        _mmap_stream = mmap_streamer::create(_path, offset);
+    }
+
+    if (_mmap_stream != nullptr) {
+        _mmap_stream->reset(offset);
+    } else if (_stream == nullptr) {
         _stream.reset(new file_streamer(_handle, offset));
     } else {
         _stream->reset(offset);
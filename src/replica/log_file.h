@@ -66,6 +66,7 @@ struct replica_log_info
 typedef std::unordered_map<gpid, replica_log_info> replica_log_info_map;
 
 class log_file;
+class spare_log_file_pool;
 typedef dsn::ref_ptr<log_file> log_file_ptr;
 
 //
@@ -95,10 +96,14 @@ public:
 
     // open the log file for write
     // the file path is '{dir}/log.{index}.{start_offset}'
+    // a ready file of `spares` is taken as the new file if it is provided
     // returns:
     //   - non-null if open succeed
     //   - null if open failed
-    static log_file_ptr create_write(const char *dir, int index, int64_t start_offset);
+    static log_file_ptr create_write(const char *dir,
+                                     int index,
+                                     int64_t start_offset,
+                                     spare_log_file_pool *spares = nullptr);
 
     // close the log file
     void close();
@@ -119,8 +124,23 @@ public:
     //  - ERR_INCOMPLETE_DATA
     //  - ERR_INVALID_DATA
     //  - other io errors caused by file read operator
+    // a compressed block is decompressed after its crc is checked, see log_block::decompress
     error_code read_next_log_block(/*out*/ ::dsn::blob &bb);
 
+    // the same as above, the header of the block is passed out by 'hdr', whose length is
+    // the on-disk length of the body
+    error_code read_next_log_block(/*out*/ log_block_header &hdr, /*out*/ ::dsn::blob &bb);
+
+    // the same as read_next_log_block, except that the crc of the body is not checked. The
+    // caller checks it with `hdr.body_crc` and the body_crc of the previous block, see
+    // crc_of_block.
+    error_code read_next_log_block_unchecked(/*out*/ log_block_header &hdr,
+                                             /*out*/ ::dsn::blob &bb);
+
+    // the crc of the body of a log block, `prev_crc` is the body_crc of its previous block in
+    // the file, or 0 if it is the first one.
+    static uint32_t crc_of_block(const ::dsn::blob &bb, uint32_t prev_crc);
+
     //
     // write routines
     //
@@ -197,6 +217,8 @@ private:
         _end_offset; // end offset in the global space: end_offset = start_offset + file_size
     class file_streamer;
     std::unique_ptr<file_streamer> _stream;
+    class mmap_streamer;
+    std::unique_ptr<mmap_streamer> _mmap_stream; // used instead of _stream if not null
     disk_file *_handle;        // file handle
     const bool _is_read;       // if opened for read or write
     std::string _path;         // file path
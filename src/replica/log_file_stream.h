@@ -30,6 +30,12 @@
 
 #include "log_file.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
 namespace dsn {
 namespace replication {
 
@@ -192,5 +198,119 @@ private:
     disk_file *_file_handle;
 };
 
+// log_file::mmap_streamer
+//
+// An alternative of file_streamer for sequential scans, enabled by
+// [replication] log_file_mmap_read. The file is mapped read-only as a whole, and read_next
+// returns views of the mapping instead of copies. A view holds a reference of the mapping,
+// so the mapping lives as long as any mutation decoded from it.
+//
+// The pages behind the cursor are released with MADV_DONTNEED to bound the page cache used
+// by a scan; they are faulted in from the file again if a view is still accessed.
+class log_file::mmap_streamer
+{
+public:
+    // returns nullptr if the file can not be mapped
+    static std::unique_ptr<mmap_streamer> create(const std::string &path, size_t file_offset)
+    {
+        std::unique_ptr<mmap_streamer> s(new mmap_streamer(path));
+        if (!s->remap()) {
+            return nullptr;
+        }
+        s->reset(file_offset);
+        return s;
+    }
+
+    void reset(size_t file_offset)
+    {
+        _offset = file_offset;
+        if (_offset < _released) {
+            _released = _offset & ~(page_size() - 1);
+        }
+    }
+
+    // the same semantics as file_streamer::read_next, except that the result is always
+    // reference counted
+    error_code read_next(size_t size, /*out*/ blob &result)
+    {
+        // the file may still be appended, e.g. the private log read by duplication
+        if (_offset + size > _size && !remap()) {
+            result = blob();
+            return ERR_FILE_OPERATION_FAILED;
+        }
+
+        size_t len = _offset >= _size ? 0 : std::min(size, _size - _offset);
+        if (len == 0) {
+            result = blob();
+            return size == 0 ? ERR_OK : ERR_HANDLE_EOF;
+        }
+        result = blob(std::shared_ptr<char>(_data, _data.get() + _offset), 0, len);
+        _offset += len;
+        release_consumed();
+        return len == size ? ERR_OK : ERR_HANDLE_EOF;
+    }
+
+private:
+    explicit mmap_streamer(const std::string &path) : _path(path) {}
+
+    // maps the file again if it has grown, the old mapping is kept by the views on it
+    bool remap()
+    {
+        int fd = ::open(_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            derror_f("open {} for mmap failed: {}", _path, utils::safe_strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            derror_f("stat {} for mmap failed: {}", _path, utils::safe_strerror(errno));
+            ::close(fd);
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size > _size) {
+            void *addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                derror_f("mmap {} failed: {}", _path, utils::safe_strerror(errno));
+                ::close(fd);
+                return false;
+            }
+            ::madvise(addr, size, MADV_SEQUENTIAL);
+            _data = std::shared_ptr<char>(static_cast<char *>(addr),
+                                          [size](char *p) { ::munmap(p, size); });
+            _size = size;
+            _released = 0;
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void release_consumed()
+    {
+        // keep the most recent pages, which the current block is likely to be on
+        size_t keep_from = _offset > release_window_bytes ? _offset - release_window_bytes : 0;
+        keep_from &= ~(page_size() - 1);
+        if (keep_from >= _released + release_window_bytes) {
+            ::madvise(_data.get() + _released, keep_from - _released, MADV_DONTNEED);
+            _released = keep_from;
+        }
+    }
+
+    static size_t page_size()
+    {
+        static const size_t sz = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return sz;
+    }
+
+    static constexpr size_t release_window_bytes = 4 * 1024 * 1024; // 4MB
+
+    const std::string _path;
+    std::shared_ptr<char> _data; // the current mapping
+    size_t _size{0};             // size of the current mapping
+    size_t _offset{0};           // file offset of the cursor
+    size_t _released{0};         // [0, _released) is released by MADV_DONTNEED
+};
+
 } // namespace replication
 } // namespace dsn
@@ -35,9 +35,11 @@
 
 #include "mutation.h"
 #include "mutation_log.h"
+#include "mutation_pool.h"
 #include "replica.h"
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/pooled_binary_writer.h>
 
 namespace dsn {
 namespace replication {
@@ -54,9 +56,12 @@ mutation::mutation()
     next = nullptr;
     _private0 = 0;
     _not_logged = 1;
-    _prepare_ts_ms = 0;
+    _prepare_ts_us = 0;
     strcpy(_name, "0.0.0.0");
     _appro_data_bytes = sizeof(mutation_header);
+    _memory_budget = nullptr;
+    _memory_subsystem = memory_subsystem::MUTATION;
+    _charged_bytes = 0;
     _create_ts_ns = dsn_now_ns();
     _tid = ++s_tid;
     _is_sync_to_child = false;
@@ -97,6 +102,50 @@ mutation::~mutation()
     for (auto &request : _prepare_requests) {
         request->release_ref();
     }
+
+    if (_memory_budget != nullptr) {
+        _memory_budget->release(_memory_subsystem, _charged_bytes);
+    }
+
+    mutation_pool *pool = mutation_pool::header_of(this)->owner;
+    if (pool != nullptr) {
+        data.updates.clear();
+        client_requests.clear();
+        _prepare_requests.clear();
+        pool->recycle_buffers(data.updates, client_requests, _prepare_requests);
+    }
+}
+
+/*static*/ void *mutation::operator new(size_t size)
+{
+    auto h = static_cast<mutation_pool::block_header *>(
+        ::operator new(sizeof(mutation_pool::block_header) + size));
+    h->owner = nullptr;
+    return h + 1;
+}
+
+/*static*/ void mutation::operator delete(void *p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    mutation_pool::block_header *h = mutation_pool::header_of(p);
+    if (h->owner != nullptr) {
+        h->owner->deallocate(h);
+    } else {
+        ::operator delete(h);
+    }
+}
+
+void mutation::charge_memory(replica_memory_budget *budget, memory_subsystem subsystem)
+{
+    if (_memory_budget != nullptr) {
+        return;
+    }
+    _memory_budget = budget;
+    _memory_subsystem = subsystem;
+    _charged_bytes = _appro_data_bytes;
+    _memory_budget->consume(_memory_subsystem, _charged_bytes);
 }
 
 void mutation::set_id(ballot b, decree c)
@@ -149,6 +198,9 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
 {
     if (request != nullptr) {
         ADD_CUSTOM_POINT(tracer, request->header->id);
+        if (data.updates.empty()) {
+            tracer->set_category(code.to_string());
+        }
     }
     data.updates.push_back(mutation_update());
     mutation_update &update = data.updates.back();
@@ -181,7 +233,7 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
 
 void mutation::write_to(const std::function<void(const blob &)> &inserter) const
 {
-    binary_writer writer(1024);
+    pooled_binary_writer writer(1024);
     write_mutation_header(writer, data.header);
     writer.write_pod(static_cast<int>(data.updates.size()));
     for (const mutation_update &update : data.updates) {
@@ -197,7 +249,12 @@ void mutation::write_to(const std::function<void(const blob &)> &inserter) const
 
         writer.write_pod(static_cast<int>(update.data.length()));
     }
-    inserter(writer.get_buffer());
+    // hand over the pooled buffers without merging them, the log blocks are written by gather
+    std::vector<blob> buffers;
+    writer.get_buffers(buffers);
+    for (const blob &bb : buffers) {
+        inserter(bb);
+    }
     for (const mutation_update &update : data.updates) {
         inserter(update.data);
     }
@@ -226,9 +283,10 @@ void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
     }
 }
 
-/*static*/ mutation_ptr mutation::read_from(binary_reader &reader, dsn::message_ex *from)
+/*static*/ mutation_ptr
+mutation::read_from(binary_reader &reader, dsn::message_ex *from, mutation_pool *pool)
 {
-    mutation_ptr mu(new mutation());
+    mutation_ptr mu(pool != nullptr ? pool->create() : new mutation());
     read_mutation_header(reader, mu->data.header);
 
     int size;
@@ -343,7 +401,9 @@ void mutation::wait_log_task() const
 mutation_queue::mutation_queue(gpid gpid,
                                int max_concurrent_op /*= 2*/,
                                bool batch_write_disabled /*= false*/)
-    : _max_concurrent_op(max_concurrent_op), _batch_write_disabled(batch_write_disabled)
+    : _max_concurrent_op(max_concurrent_op),
+      _max_batch_bytes(1024 * 1024),
+      _batch_write_disabled(batch_write_disabled)
 {
     _current_op_count = 0;
     _pending_mutation = nullptr;
@@ -384,7 +444,7 @@ mutation_ptr mutation_queue::add_work(task_code code, dsn::message_ex *request,
 
     // check if need to switch work queue
     if (_batch_write_disabled || !spec->rpc_request_is_write_allow_batch ||
-        _pending_mutation->is_full()) {
+        _pending_mutation->appro_data_bytes() >= _max_batch_bytes) {
         _pending_mutation->add_ref(); // released when unlink
         _hdr.add(_pending_mutation);
         _pending_mutation = nullptr;
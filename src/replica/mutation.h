@@ -36,6 +36,7 @@
 #pragma once
 
 #include "common/replication_common.h"
+#include "replica_memory_budget.h"
 #include <list>
 #include <atomic>
 #include <dsn/utility/link.h>
@@ -50,6 +51,7 @@ namespace replication {
 
 class mutation;
 typedef dsn::ref_ptr<mutation> mutation_ptr;
+class mutation_pool;
 
 // mutation is the 2pc unit of PacificA, which wraps one or more client requests and add
 // header informations related to PacificA algorithm for them.
@@ -60,6 +62,11 @@ public:
     mutation();
     virtual ~mutation();
 
+    // every mutation is prefixed with a header recording the mutation_pool it's allocated
+    // from, see mutation_pool::create
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     // copy mutation from an existing mutation, typically used in partition split
     // mutation should not reply to client, because parent has already replied
     static mutation_ptr copy_no_reply(const mutation_ptr &old_mu);
@@ -88,7 +95,7 @@ public:
     node_tasks &remote_tasks() { return _prepare_or_commit_tasks; }
     bool is_prepare_close_to_timeout(int gap_ms, int timeout_ms)
     {
-        return dsn_now_ms() + gap_ms >= _prepare_ts_ms + timeout_ms;
+        return dsn_now_ms() + gap_ms >= prepare_ts_ms() + timeout_ms;
     }
     uint64_t create_ts_ns() const { return _create_ts_ns; }
     ballot get_ballot() const { return data.header.ballot; }
@@ -119,13 +126,17 @@ public:
     void set_error_acked() { _is_error_acked = true; }
     int clear_prepare_or_commit_tasks();
     void wait_log_task() const;
-    uint64_t prepare_ts_ms() const { return _prepare_ts_ms; }
-    void set_prepare_ts() { _prepare_ts_ms = dsn_now_ms(); }
+    uint64_t prepare_ts_ms() const { return _prepare_ts_us / 1000; }
+    uint64_t prepare_ts_us() const { return _prepare_ts_us; }
+    void set_prepare_ts() { _prepare_ts_us = dsn_now_us(); }
 
     // >= 1 MB
     bool is_full() const { return _appro_data_bytes >= 1024 * 1024; }
     int appro_data_bytes() const { return _appro_data_bytes; }
 
+    // charge the data bytes to `budget` until the mutation is freed, only the first charge counts
+    void charge_memory(replica_memory_budget *budget, memory_subsystem subsystem);
+
     // read & write mutation data
     //
     // "mutation_update.code" should be marshalled as string for cross-process compatiblity,
@@ -134,7 +145,8 @@ public:
     //   - the private/shared log may be replayed by different program when server restart
     void write_to(const std::function<void(const blob &)> &inserter) const;
     void write_to(binary_writer &writer, dsn::message_ex *to) const;
-    static mutation_ptr read_from(binary_reader &reader, dsn::message_ex *from);
+    static mutation_ptr
+    read_from(binary_reader &reader, dsn::message_ex *from, mutation_pool *pool = nullptr);
 
     static void write_mutation_header(binary_writer &writer, const mutation_header &header);
     static void read_mutation_header(binary_reader &reader, mutation_header &header);
@@ -154,6 +166,8 @@ public:
     bool is_sync_to_child() { return _is_sync_to_child; }
 
 private:
+    friend class mutation_pool;
+
     union
     {
         struct
@@ -173,12 +187,15 @@ private:
         uint32_t _private0;
     };
 
-    uint64_t _prepare_ts_ms;
+    uint64_t _prepare_ts_us;
     ::dsn::task_ptr _log_task;
     node_tasks _prepare_or_commit_tasks;
     std::vector<dsn::message_ex *> _prepare_requests; // may combine duplicate requests
     char _name[60];                                   // app_id.partition_index.ballot.decree
     int _appro_data_bytes;
+    replica_memory_budget *_memory_budget;
+    memory_subsystem _memory_subsystem;
+    int _charged_bytes;
     uint64_t _create_ts_ns; // for profiling
     uint64_t _tid;          // trace id, unique in process
     static std::atomic<uint64_t> s_tid;
@@ -220,6 +237,13 @@ public:
     // which triggers further round of operations as returned
     mutation_ptr check_possible_work(int current_running_count);
 
+    // whether there are mutations waiting for the concurrent ops
+    bool has_pending_work() const { return !_hdr.is_empty() || _pending_mutation != nullptr; }
+
+    // tuned by prepare_window_controller
+    void set_max_concurrent_op(int max_c) { _max_concurrent_op = max_c; }
+    void set_max_batch_bytes(int bytes) { _max_batch_bytes = bytes; }
+
 private:
     mutation_ptr unlink_next_workload()
     {
@@ -231,11 +255,10 @@ private:
         return r;
     }
 
-    void reset_max_concurrent_ops(int max_c) { _max_concurrent_op = max_c; }
-
 private:
     int _current_op_count;
     int _max_concurrent_op;
+    int _max_batch_bytes;
     bool _batch_write_disabled;
 
     volatile int *_pcount;
@@ -30,10 +30,17 @@
 namespace dsn {
 namespace replication {
 
+const mutation_ptr mutation_cache::_null_mutation;
+
 mutation_cache::mutation_cache(decree init_decree, int max_count)
 {
     _max_count = max_count;
-    _array.resize(max_count, nullptr);
+    size_t size = 1;
+    while (size < static_cast<size_t>(max_count)) {
+        size <<= 1;
+    }
+    _array.resize(size, nullptr);
+    _mask = static_cast<int64_t>(size) - 1;
 
     reset(init_decree, false);
 }
@@ -46,10 +53,9 @@ mutation_cache::mutation_cache(const mutation_cache &cache)
         _array.emplace_back(old_mu == nullptr ? nullptr : mutation::copy_no_reply(old_mu));
     }
 
+    _mask = cache._mask;
     _max_count = cache._max_count;
     _interval = cache._interval;
-    _start_idx = cache._start_idx;
-    _end_idx = cache._end_idx;
     _start_decree = cache._start_decree;
     _end_decree.store(cache._end_decree.load());
 }
@@ -75,8 +81,7 @@ error_code mutation_cache::put(mutation_ptr &mu)
         return ERR_CAPACITY_EXCEEDED;
     }
 
-    int idx = ((decree - _end_decree) + _end_idx + _max_count) % _max_count;
-    mutation_ptr &old = _array[idx];
+    mutation_ptr &old = _array[decree & _mask];
     if (old != nullptr) {
         dassert(old->data.header.ballot <= mu->data.header.ballot,
                 "%" PRId64 " VS %" PRId64 "",
@@ -84,19 +89,16 @@ error_code mutation_cache::put(mutation_ptr &mu)
                 mu->data.header.ballot);
     }
 
-    _array[idx] = mu;
+    old = mu;
 
     // update tracking data
     _interval += delta;
 
     if (tag > 0) {
-        _end_idx = idx;
         _end_decree = decree;
     } else if (tag < 0) {
-        _start_idx = idx;
         _start_decree = decree;
     } else if (_interval == 1) {
-        _start_idx = _end_idx = idx;
         _start_decree = _end_decree = decree;
     }
     return ERR_OK;
@@ -105,18 +107,16 @@ error_code mutation_cache::put(mutation_ptr &mu)
 mutation_ptr mutation_cache::pop_min()
 {
     if (_interval > 0) {
-        mutation_ptr mu = _array[_start_idx];
-        _array[_start_idx] = nullptr;
+        // moved out without touching the ref count
+        mutation_ptr mu = std::move(_array[_start_decree & _mask]);
 
         _interval--;
-        _start_idx = (_start_idx + 1) % _max_count;
 
         if (_interval == 0) {
             // TODO: FIXE ME LATER
             // dassert (_total_size_bytes == 0, "");
 
             _end_decree = _start_decree;
-            _end_idx = _start_idx;
         } else {
             _start_decree++;
         }
@@ -129,21 +129,12 @@ mutation_ptr mutation_cache::pop_min()
 void mutation_cache::reset(decree init_decree, bool clear_mutations)
 {
     _start_decree = _end_decree = init_decree;
-    _start_idx = _end_idx = 0;
     _interval = 0;
 
     if (clear_mutations) {
-        for (int i = 0; i < _max_count; i++)
-            _array[i] = nullptr;
+        for (auto &mu : _array)
+            mu = nullptr;
     }
 }
-
-mutation_ptr mutation_cache::get_mutation_by_decree(decree decree)
-{
-    if (decree < _start_decree || decree > _end_decree)
-        return nullptr;
-    else
-        return _array[(_start_idx + (decree - _start_decree) + _max_count) % _max_count];
-}
 }
 } // namespace end
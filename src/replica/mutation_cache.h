@@ -37,6 +37,9 @@ namespace replication {
 // mutation_cache is an in-memory array that stores a limited number
 // (SEE replication_options::max_mutation_count_in_prepare_list) of mutation log entries.
 //
+// The array is a ring whose size is the power of two not less than the capacity, a mutation is
+// stored at the slot of `decree & mask`.
+//
 // Inherited by: prepare_list
 class mutation_cache
 {
@@ -48,7 +51,14 @@ public:
 
     error_code put(mutation_ptr &mu);
     mutation_ptr pop_min();
-    mutation_ptr get_mutation_by_decree(decree decree);
+    // the returned reference is valid until the cache is changed, copy it to hold the mutation
+    const mutation_ptr &get_mutation_by_decree(decree decree) const
+    {
+        if (decree < _start_decree || decree > _end_decree || _interval == 0) {
+            return _null_mutation;
+        }
+        return _array[decree & _mask];
+    }
     void reset(decree init_decree, bool clear_mutations);
 
     decree min_decree() const { return _start_decree; }
@@ -57,13 +67,14 @@ public:
     int capacity() const { return _max_count; }
 
 private:
+    static const mutation_ptr _null_mutation;
+
     std::vector<mutation_ptr> _array;
+    int64_t _mask;
     int _max_count;
 
     int _interval;
 
-    int _start_idx;
-    int _end_idx;
     decree _start_decree;
     std::atomic<decree> _end_decree;
 };
@@ -27,6 +27,7 @@
 #include "mutation_log.h"
 #include "replica.h"
 #include "mutation_log_utils.h"
+#include "async_file_deleter.h"
 
 #include <dsn/utils/latency_tracer.h>
 #include <dsn/utility/filesystem.h>
@@ -34,10 +35,23 @@
 #include <dsn/utility/fail_point.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/flags.h>
+
+#include "runtime/service_engine.h"
+#include "runtime/task/task_engine.h"
+
+#include <thread>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                log_shared_batch_callbacks,
+                false,
+                "whether to run the callbacks of one shared log write on the same replication "
+                "thread in one task, which acks the prepares of the write together");
+DSN_TAG_VARIABLE(log_shared_batch_callbacks, FT_MUTABLE);
+
 ::dsn::task_ptr mutation_log_shared::append(mutation_ptr &mu,
                                             dsn::task_code callback_code,
                                             dsn::task_tracker *tracker,
@@ -45,37 +59,97 @@ namespace replication {
                                             int hash,
                                             int64_t *pending_size)
 {
-    auto d = mu->data.header.decree;
     ::dsn::aio_task_ptr cb =
         callback ? file::create_aio_task(
                        callback_code, tracker, std::forward<aio_handler>(callback), hash)
                  : nullptr;
 
-    _slock.lock();
-
     ADD_POINT(mu->tracer);
-    // init pending buffer
-    if (nullptr == _pending_write) {
-        _pending_write = std::make_shared<log_appender>(mark_new_offset(0, true).second);
+    uint64_t now_us = 0;
+    if (group_commit_controller::enabled()) {
+        now_us = dsn_now_us();
+        _group_commit.on_append(now_us);
     }
-    _pending_write->append_mutation(mu, cb);
+    _unwritten_count.fetch_add(1);
+    _unwritten_bytes.fetch_add(mu->appro_data_bytes());
 
-    // update meta
-    update_max_decree(mu->data.header.pid, d);
+    // the appends of the same partition are issued in order, which are kept by the stack
+    auto node = new staged_mutation{mu, cb, now_us, _staged_head.load(std::memory_order_relaxed)};
+    while (!_staged_head.compare_exchange_weak(node->next, node)) {
+    }
 
     // start to write if possible
-    if (!_is_writing.load(std::memory_order_acquire)) {
-        write_pending_mutations(true);
-        if (pending_size) {
-            *pending_size = 0;
+    seal_and_write(false);
+    if (pending_size) {
+        *pending_size = _unwritten_bytes.load(std::memory_order_relaxed);
+    }
+    return cb;
+}
+
+/*static*/ void mutation_log_shared::release_staged_mutations(staged_mutation *head)
+{
+    while (head != nullptr) {
+        staged_mutation *next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+bool mutation_log_shared::seal_and_write(bool force)
+{
+    // the request is seen either by this thread taking the role, or by the holder after it
+    // leaves the role
+    _seal_requested.store(true);
+    bool issued = false;
+    while (_seal_requested.load() && !_sealing.exchange(true)) {
+        _seal_requested.store(false);
+
+        stage_pending_mutations();
+
+        log_file_ptr lf;
+        std::shared_ptr<log_appender> pending;
+        if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
+            (force || should_write_pending())) {
+            pending = seal_pending_mutations(lf);
         }
-    } else {
-        if (pending_size) {
-            *pending_size = _pending_write->size();
+        _sealing.store(false);
+
+        // seperate commit_log_block from the sealing role
+        if (pending) {
+            commit_pending_mutations(lf, pending);
+            issued = true;
         }
-        _slock.unlock();
     }
-    return cb;
+    return issued;
+}
+
+void mutation_log_shared::stage_pending_mutations()
+{
+    // reverse the stack into the order of the appends
+    staged_mutation *head = nullptr;
+    for (staged_mutation *node = _staged_head.exchange(nullptr); node != nullptr;) {
+        staged_mutation *next = node->next;
+        node->next = head;
+        head = node;
+        node = next;
+    }
+    if (head == nullptr) {
+        return;
+    }
+
+    // init pending buffer
+    if (nullptr == _pending_write) {
+        _pending_write = std::make_shared<log_appender>(mark_new_offset(0, true).second,
+                                                        log_appender::configured_compression());
+        _pending_write_start_time_us = head->append_time_us;
+    }
+    for (staged_mutation *node = head; node != nullptr; node = node->next) {
+        _pending_write->append_mutation(node->mu, node->cb);
+
+        // update meta
+        update_max_decree(node->mu->data.header.pid, node->mu->data.header.decree);
+    }
+    release_staged_mutations(head);
 }
 
 void mutation_log_shared::flush() { flush_internal(-1); }
@@ -88,41 +162,65 @@ void mutation_log_shared::flush_internal(int max_count)
     while (max_count <= 0 || count < max_count) {
         if (_is_writing.load(std::memory_order_acquire)) {
             _tracker.wait_outstanding_tasks();
-        } else {
-            _slock.lock();
-            if (_is_writing.load(std::memory_order_acquire)) {
-                _slock.unlock();
-                continue;
-            }
-            if (!_pending_write) {
-                // !_is_writing && !_pending_write, means flush done
-                _slock.unlock();
-                break;
-            }
-            // !_is_writing && _pending_write, start next write
-            write_pending_mutations(true);
+        } else if (_unwritten_count.load() == 0) {
+            // the count is decreased only when a write completes, so nothing unwritten means
+            // all the appended mutations are on disk, even if another write is issued now
+            break;
+        } else if (seal_and_write(true)) {
+            // !_is_writing && some unwritten, start next write
             count++;
+        } else {
+            // another thread is sealing the mutations, or has just issued the write
+            std::this_thread::yield();
         }
     }
 }
 
-void mutation_log_shared::write_pending_mutations(bool release_lock_required)
+bool mutation_log_shared::should_write_pending()
+{
+    if (!group_commit_controller::enabled()) {
+        return true;
+    }
+    uint64_t delay_us = _group_commit.flush_delay_us(
+        _pending_write->mutations().size(), _pending_write_start_time_us, dsn_now_us());
+    if (delay_us == 0) {
+        return true;
+    }
+    schedule_group_commit(delay_us);
+    return false;
+}
+
+void mutation_log_shared::schedule_group_commit(uint64_t delay_us)
+{
+    if (_group_commit_scheduled.exchange(true)) {
+        return;
+    }
+    tasking::enqueue(LPC_GROUP_COMMIT_LOG_SHARED,
+                     &_tracker,
+                     [this]() {
+                         _group_commit_scheduled.store(false);
+                         seal_and_write(true);
+                     },
+                     0,
+                     std::chrono::milliseconds((delay_us + 999) / 1000));
+}
+
+std::shared_ptr<log_appender> mutation_log_shared::seal_pending_mutations(log_file_ptr &lf)
 {
-    dassert(release_lock_required, "lock must be hold at this point");
     dassert(!_is_writing.load(std::memory_order_relaxed), "");
     dassert(_pending_write != nullptr, "");
     dassert(_pending_write->size() > 0, "pending write size = %d", (int)_pending_write->size());
+    _pending_write->seal();
     auto pr = mark_new_offset(_pending_write->size(), false);
     dcheck_eq(pr.second, _pending_write->start_offset());
+    lf = pr.first;
 
     _is_writing.store(true, std::memory_order_release);
 
     // move or reset pending variables
     auto pending = std::move(_pending_write);
-
-    // seperate commit_log_block from within the lock
-    _slock.unlock();
-    commit_pending_mutations(pr.first, pending);
+    _group_commit.on_write_issued(pending->mutations().size());
+    return pending;
 }
 
 void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
@@ -131,11 +229,12 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
     for (auto &mu : pending->mutations()) {
         ADD_POINT(mu->tracer);
     }
+    uint64_t start_time_us = dsn_now_us();
     lf->commit_log_blocks( // forces a new line for params
         *pending,
         LPC_WRITE_REPLICATION_LOG_SHARED,
         &_tracker,
-        [this, lf, pending](error_code err, size_t sz) mutable {
+        [this, lf, pending, start_time_us](error_code err, size_t sz) mutable {
             dassert(_is_writing.load(std::memory_order_relaxed), "");
 
             for (auto &mu : pending->mutations()) {
@@ -144,7 +243,7 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
 
             for (auto &block : pending->all_blocks()) {
                 auto hdr = (log_block_header *)block.front().data();
-                dassert(hdr->magic == 0xdeadbeef, "header magic is changed: 0x%x", hdr->magic);
+                dassert(hdr->is_valid(), "header magic is changed: 0x%x", hdr->magic);
             }
 
             if (err == ERR_OK) {
@@ -160,10 +259,20 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
                 if (_write_size_counter) {
                     (*_write_size_counter)->add(sz);
                 }
+                _group_commit.on_write_completed(dsn_now_us() - start_time_us);
             } else {
                 derror("write shared log failed, err = %s", err.to_string());
             }
 
+            // decrease the unwritten mutations before resetting _is_writing, so that flush()
+            // can't find both of them cleared before this block is on disk
+            int64_t bytes = 0;
+            for (auto &mu : pending->mutations()) {
+                bytes += mu->appro_data_bytes();
+            }
+            _unwritten_count.fetch_sub(pending->mutations().size());
+            _unwritten_bytes.fetch_sub(bytes);
+
             // here we use _is_writing instead of _issued_write.expired() to check writing done,
             // because the following callbacks may run before "block" released, which may cause
             // the next init_prepare() not starting the write.
@@ -171,24 +280,60 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
 
             // notify the callbacks
             // ATTENTION: callback may be called before this code block executed done.
-            for (auto &c : pending->callbacks()) {
-                c->enqueue(err, sz);
-            }
+            notify_callbacks(pending->callbacks(), err, sz);
 
             // start to write next if possible
             if (err == ERR_OK) {
-                _slock.lock();
-
-                if (!_is_writing.load(std::memory_order_acquire) && _pending_write) {
-                    write_pending_mutations(true);
-                } else {
-                    _slock.unlock();
-                }
+                seal_and_write(false);
             }
         },
         0);
 }
 
+/*static*/ void mutation_log_shared::notify_callbacks(const std::vector<aio_task_ptr> &callbacks,
+                                                    error_code err,
+                                                    size_t size)
+{
+    if (!FLAGS_log_shared_batch_callbacks || callbacks.size() <= 1) {
+        for (auto &c : callbacks) {
+            c->enqueue(err, size);
+        }
+        return;
+    }
+
+    // the callbacks on the same queue, the order of each partition is kept
+    std::map<size_t, std::vector<aio_task_ptr>> batches;
+    for (auto &c : callbacks) {
+        if (c->spec().pool_code != THREAD_POOL_REPLICATION || c->spec().allow_inline) {
+            c->enqueue(err, size);
+            continue;
+        }
+        task_worker_pool *pool = c->node()->computation()->get_pool(c->spec().pool_code);
+        if (!pool->spec().partitioned) {
+            c->enqueue(err, size);
+            continue;
+        }
+        batches[static_cast<unsigned int>(c->hash()) % pool->queues().size()].push_back(c);
+    }
+
+    for (auto &kv : batches) {
+        auto &batch = kv.second;
+        if (batch.size() == 1) {
+            batch.front()->enqueue(err, size);
+            continue;
+        }
+        int hash = batch.front()->hash();
+        tasking::enqueue(LPC_WRITE_REPLICATION_LOG_CALLBACKS,
+                         nullptr,
+                         [ batch = std::move(batch), err, size ]() {
+                             for (auto &c : batch) {
+                                 c->exec_inline(err, size);
+                             }
+                         },
+                         hash);
+    }
+}
+
 ////////////////////////////////////////////////////
 
 mutation_log_private::mutation_log_private(const std::string &dir,
@@ -202,8 +347,11 @@ mutation_log_private::mutation_log_private(const std::string &dir,
       replica_base(r),
       _batch_buffer_bytes(batch_buffer_bytes),
       _batch_buffer_max_count(batch_buffer_max_count),
-      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms)
+      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms),
+      _group_commit("private_log_batch_size")
 {
+    // the logs are appended with the highest priority, though the task priority is common
+    task_spec::set_default_disk_io_priority(LPC_WRITE_REPLICATION_LOG_PRIVATE, DIO_PRIORITY_HIGH);
     mutation_log_private::init_states();
 }
 
@@ -220,10 +368,17 @@ mutation_log_private::mutation_log_private(const std::string &dir,
 
     // init pending buffer
     if (nullptr == _pending_write) {
-        _pending_write = make_unique<log_appender>(mark_new_offset(0, true).second);
+        _pending_write = make_unique<log_appender>(mark_new_offset(0, true).second,
+                                                log_appender::configured_compression());
         _pending_write_start_time_ms = dsn_now_ms();
+        if (group_commit_controller::enabled()) {
+            _pending_write_start_time_us = dsn_now_us();
+        }
     }
     _pending_write->append_mutation(mu, nullptr);
+    if (group_commit_controller::enabled()) {
+        _group_commit.on_append(dsn_now_us());
+    }
 
     // update meta
     _pending_write_max_commit =
@@ -231,10 +386,7 @@ mutation_log_private::mutation_log_private(const std::string &dir,
     _pending_write_max_decree = std::max(_pending_write_max_decree, mu->data.header.decree);
 
     // start to write if possible
-    if (!_is_writing.load(std::memory_order_acquire) &&
-        (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
-         static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
-         flush_interval_expired())) {
+    if (!_is_writing.load(std::memory_order_acquire) && should_write_pending()) {
         write_pending_mutations(true);
         if (pending_size) {
             *pending_size = 0;
@@ -360,16 +512,57 @@ void mutation_log_private::init_states()
     _issued_write.reset();
     _pending_write = nullptr;
     _pending_write_start_time_ms = 0;
+    _pending_write_start_time_us = 0;
     _pending_write_max_commit = 0;
     _pending_write_max_decree = 0;
 }
 
+bool mutation_log_private::should_write_pending()
+{
+    // the byte limit is kept under adaptive group commit to bound the size of a log block
+    if (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes) {
+        return true;
+    }
+    if (!group_commit_controller::enabled()) {
+        return static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
+               flush_interval_expired();
+    }
+    uint64_t delay_us = _group_commit.flush_delay_us(
+        _pending_write->mutations().size(), _pending_write_start_time_us, dsn_now_us());
+    if (delay_us == 0) {
+        return true;
+    }
+    schedule_group_commit(delay_us);
+    return false;
+}
+
+void mutation_log_private::schedule_group_commit(uint64_t delay_us)
+{
+    if (_group_commit_scheduled.exchange(true)) {
+        return;
+    }
+    tasking::enqueue(LPC_GROUP_COMMIT_LOG_PRIVATE,
+                     &_tracker,
+                     [this]() {
+                         _group_commit_scheduled.store(false);
+                         _plock.lock();
+                         if (!_is_writing.load(std::memory_order_acquire) && _pending_write) {
+                             write_pending_mutations(true);
+                         } else {
+                             _plock.unlock();
+                         }
+                     },
+                     get_gpid().thread_hash(),
+                     std::chrono::milliseconds((delay_us + 999) / 1000));
+}
+
 void mutation_log_private::write_pending_mutations(bool release_lock_required)
 {
     dassert(release_lock_required, "lock must be hold at this point");
     dassert(!_is_writing.load(std::memory_order_relaxed), "");
     dassert(_pending_write != nullptr, "");
     dassert(_pending_write->size() > 0, "pending write size = %d", (int)_pending_write->size());
+    _pending_write->seal();
     auto pr = mark_new_offset(_pending_write->size(), false);
     dcheck_eq_replica(pr.second, _pending_write->start_offset());
 
@@ -380,7 +573,9 @@ void mutation_log_private::write_pending_mutations(bool release_lock_required)
     // move or reset pending variables
     std::shared_ptr<log_appender> pending = std::move(_pending_write);
     _issued_write = pending;
+    _group_commit.on_write_issued(pending->mutations().size());
     _pending_write_start_time_ms = 0;
+    _pending_write_start_time_us = 0;
     decree max_commit = _pending_write_max_commit;
     _pending_write_max_commit = 0;
     _pending_write_max_decree = 0;
@@ -395,16 +590,17 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
                                                     std::shared_ptr<log_appender> &pending,
                                                     decree max_commit)
 {
+    uint64_t start_time_us = dsn_now_us();
     lf->commit_log_blocks(
         *pending,
         LPC_WRITE_REPLICATION_LOG_PRIVATE,
         &_tracker,
-        [this, lf, pending, max_commit](error_code err, size_t sz) mutable {
+        [this, lf, pending, max_commit, start_time_us](error_code err, size_t sz) mutable {
             dassert(_is_writing.load(std::memory_order_relaxed), "");
 
             for (auto &block : pending->all_blocks()) {
                 auto hdr = (log_block_header *)block.front().data();
-                dassert(hdr->magic == 0xdeadbeef, "header magic is changed: 0x%x", hdr->magic);
+                dassert(hdr->is_valid(), "header magic is changed: 0x%x", hdr->magic);
             }
 
             if (err != ERR_OK) {
@@ -422,6 +618,7 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
             //
             // FIXME : the file could have been closed
             lf->flush();
+            _group_commit.on_write_completed(dsn_now_us() - start_time_us);
 
             // update _private_max_commit_on_disk after written into log file done
             update_max_commit_on_disk(max_commit);
@@ -432,9 +629,7 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
             _plock.lock();
 
             if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
-                (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
-                 static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
-                 flush_interval_expired())) {
+                should_write_pending()) {
                 write_pending_mutations(true);
             } else {
                 _plock.unlock();
@@ -445,12 +640,20 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
 
 ///////////////////////////////////////////////////////////////
 
-mutation_log::mutation_log(const std::string &dir, int32_t max_log_file_mb, gpid gpid, replica *r)
+mutation_log::mutation_log(const std::string &dir,
+                           int32_t max_log_file_mb,
+                           gpid gpid,
+                           replica *r,
+                           int tracker_bucket_count)
+    : _tracker(tracker_bucket_count)
 {
     _dir = dir;
     _is_private = (gpid.value() != 0);
     _max_log_file_size_in_bytes = static_cast<int64_t>(max_log_file_mb) * 1024L * 1024L;
     _min_log_file_size_in_bytes = _max_log_file_size_in_bytes / 10;
+    if (spare_log_file_pool::enabled()) {
+        _spare_files = make_unique<spare_log_file_pool>(_dir, _max_log_file_size_in_bytes);
+    }
     _owner_replica = r;
     _private_gpid = gpid;
 
@@ -712,12 +915,13 @@ error_code mutation_log::create_new_log_file()
 {
     // create file
     uint64_t start = dsn_now_ns();
-    log_file_ptr logf =
-        log_file::create_write(_dir.c_str(), _last_file_index + 1, _global_end_offset);
+    log_file_ptr logf = log_file::create_write(
+        _dir.c_str(), _last_file_index + 1, _global_end_offset, _spare_files.get());
     if (logf == nullptr) {
         derror("cannot create log file with index %d", _last_file_index + 1);
         return ERR_FILE_OPERATION_FAILED;
     }
+    schedule_prepare_spare_file();
     dassert(logf->end_offset() == logf->start_offset(),
             "%" PRId64 " VS %" PRId64 "",
             logf->end_offset(),
@@ -789,6 +993,25 @@ error_code mutation_log::create_new_log_file()
     return ERR_OK;
 }
 
+void mutation_log::schedule_prepare_spare_file()
+{
+    if (_spare_files == nullptr) {
+        return;
+    }
+    spare_log_file_pool *spares = _spare_files.get();
+    tasking::enqueue(
+        LPC_PREPARE_SPARE_LOG_FILE, &_spare_tracker, [spares]() { spares->prepare(); });
+}
+
+bool mutation_log::remove_log_file(const std::string &fpath)
+{
+    if (_spare_files != nullptr && _spare_files->recycle(fpath)) {
+        schedule_prepare_spare_file();
+        return true;
+    }
+    return async_file_deleter::instance().remove_path(fpath);
+}
+
 std::pair<log_file_ptr, int64_t> mutation_log::mark_new_offset(size_t size,
                                                                bool create_new_log_if_needed)
 {
@@ -1310,7 +1533,7 @@ int mutation_log::garbage_collection(gpid gpid,
 
         // delete file
         auto &fpath = log->path();
-        if (!dsn::utils::filesystem::remove_path(fpath)) {
+        if (!remove_log_file(fpath)) {
             derror("gc_private @ %d.%d: fail to remove %s, stop current gc cycle ...",
                    _private_gpid.get_app_id(),
                    _private_gpid.get_partition_index(),
@@ -1570,7 +1793,7 @@ int mutation_log::garbage_collection(const replica_log_info_map &gc_condition,
 
         // delete file
         auto &fpath = log->path();
-        if (!dsn::utils::filesystem::remove_path(fpath)) {
+        if (!remove_log_file(fpath)) {
             derror("gc_shared: fail to remove %s, stop current gc cycle ...", fpath.c_str());
             break;
         }
@@ -30,6 +30,8 @@
 #include "mutation.h"
 #include "log_block.h"
 #include "log_file.h"
+#include "group_commit_controller.h"
+#include "spare_log_file_pool.h"
 
 #include <atomic>
 #include <dsn/tool-api/zlocks.h>
@@ -96,8 +98,13 @@ public:
     //
     // ctors
     // when is_private = true, should specify "private_gpid"
+    // tracker_bucket_count is passed to the tracker of the log, see task_tracker
     //
-    mutation_log(const std::string &dir, int32_t max_log_file_mb, gpid gpid, replica *r = nullptr);
+    mutation_log(const std::string &dir,
+                 int32_t max_log_file_mb,
+                 gpid gpid,
+                 replica *r = nullptr,
+                 int tracker_bucket_count = 1);
 
     virtual ~mutation_log() = default;
 
@@ -325,6 +332,12 @@ private:
     // - _lock.locked()
     error_code create_new_log_file();
 
+    // prepare the next spare log file in background, if spare log files are enabled
+    void schedule_prepare_spare_file();
+
+    // remove a garbage-collected log file, it is recycled as a spare file if possible
+    bool remove_log_file(const std::string &fpath);
+
     // get total size ithout lock.
     int64_t total_size_no_lock() const;
 
@@ -342,6 +355,12 @@ protected:
 
     dsn::task_tracker _tracker;
 
+    // nullptr if neither log_file_preallocate nor log_file_recycle is on.
+    // the preparation has its own tracker so that flushing the log never waits on it, and is
+    // declared after the pool so that it is cancelled before the pool is destroyed.
+    std::unique_ptr<spare_log_file_pool> _spare_files;
+    dsn::task_tracker _spare_tracker;
+
 private:
     friend class mutation_log_test;
     friend class mock_mutation_log_private;
@@ -382,14 +401,18 @@ typedef dsn::ref_ptr<mutation_log> mutation_log_ptr;
 class mutation_log_shared : public mutation_log
 {
 public:
+    // the shared log is appended from all the replica threads, so its tracker is sharded
     mutation_log_shared(const std::string &dir,
                         int32_t max_log_file_mb,
                         bool force_flush,
                         perf_counter_wrapper *write_size_counter = nullptr)
-        : mutation_log(dir, max_log_file_mb, dsn::gpid(), nullptr),
+        : mutation_log(
+              dir, max_log_file_mb, dsn::gpid(), nullptr, dsn::task_tracker::PER_THREAD_SHARDED),
+          _staged_head(nullptr),
           _is_writing(false),
           _force_flush(force_flush),
-          _write_size_counter(write_size_counter)
+          _write_size_counter(write_size_counter),
+          _group_commit("shared_log_batch_size")
     {
     }
 
@@ -397,6 +420,7 @@ public:
     {
         close();
         _tracker.cancel_outstanding_tasks();
+        release_staged_mutations(_staged_head.exchange(nullptr));
     }
 
     virtual ::dsn::task_ptr append(mutation_ptr &mu,
@@ -410,28 +434,78 @@ public:
     virtual void flush_once() override;
 
 private:
-    // async write pending mutations into log file
+    // A mutation appended but not yet moved into the pending write. The appends of all the
+    // partitions are pushed onto a lock-free stack, so that they don't serialize on a lock,
+    // and the thread holding the sealing role moves them into the pending write in batch.
+    struct staged_mutation
+    {
+        mutation_ptr mu;
+        aio_task_ptr cb;
+        uint64_t append_time_us;
+        staged_mutation *next;
+    };
+
+    static void release_staged_mutations(staged_mutation *head);
+
+    // Moves the staged mutations into the pending write, and issues the write if possible (or
+    // if `force`, regardless of group commit), by the thread which takes the sealing role. The
+    // other callers return at once, leaving their requests to the role holder, which goes on
+    // until no more request comes. Returns whether a write was issued by this call.
+    bool seal_and_write(bool force);
+
+    // move the staged mutations into the pending write, called by the sealing thread
+    void stage_pending_mutations();
+
+    // seal the pending write and mark its offset, called by the sealing thread
     // Preconditions:
     // - _pending_write != nullptr
-    // - _issued_write.expired() == true (because only one async write is allowed at the same time)
-    // release_lock_required should always be true => this function must release the lock
-    // appropriately for less lock contention
-    void write_pending_mutations(bool release_lock_required);
+    // - _is_writing == false (because only one async write is allowed at the same time)
+    std::shared_ptr<log_appender> seal_pending_mutations(log_file_ptr &lf);
 
     void commit_pending_mutations(log_file_ptr &lf, std::shared_ptr<log_appender> &pending);
 
+    // notify the callbacks of a write. With [replication] log_shared_batch_callbacks, the
+    // callbacks dispatched to the same worker of THREAD_POOL_REPLICATION are run by one task,
+    // so the prepares of the partitions on the worker are acked together.
+    static void notify_callbacks(const std::vector<aio_task_ptr> &callbacks,
+                                 error_code err,
+                                 size_t size);
+
     // flush at most count times
     // if count <= 0, means flush until all data is on disk
     void flush_internal(int max_count);
 
+    // whether the pending mutations should be written now, called by the sealing thread with
+    // _is_writing == false. Under adaptive group commit a delayed write may be scheduled
+    // instead.
+    bool should_write_pending();
+
+    // issue the pending write after `delay_us`, unless one is already scheduled
+    void schedule_group_commit(uint64_t delay_us);
+
 private:
+    // the appended mutations in the reverse order, see staged_mutation
+    std::atomic<staged_mutation *> _staged_head;
+    // the mutations appended but not written yet, and their approximate bytes, which are
+    // decreased when the write of the mutations completes
+    std::atomic<int64_t> _unwritten_count{0};
+    std::atomic<int64_t> _unwritten_bytes{0};
+
+    // the sealing role, see seal_and_write()
+    std::atomic_bool _sealing{false};
+    std::atomic_bool _seal_requested{false};
+
     // bufferring - only one concurrent write is allowed
-    mutable zlock _slock;
     std::atomic_bool _is_writing;
+    // accessed by the sealing thread only
     std::shared_ptr<log_appender> _pending_write;
+    uint64_t _pending_write_start_time_us{0};
 
     bool _force_flush;
     perf_counter_wrapper *_write_size_counter;
+
+    group_commit_controller _group_commit;
+    std::atomic_bool _group_commit_scheduled{false};
 };
 
 class mutation_log_private : public mutation_log, private replica_base
@@ -499,6 +573,15 @@ private:
         return _pending_write_start_time_ms + _batch_buffer_flush_interval_ms <= dsn_now_ms();
     }
 
+    // whether the pending mutations should be written now, called with _plock held and
+    // _is_writing == false. Under adaptive group commit the count limit and the flush
+    // interval are replaced by group_commit_controller, and a delayed write may be
+    // scheduled instead.
+    bool should_write_pending();
+
+    // issue the pending write after `delay_us`, unless one is already scheduled
+    void schedule_group_commit(uint64_t delay_us);
+
 private:
     // bufferring - only one concurrent write is allowed
     typedef std::vector<mutation_ptr> mutations;
@@ -509,6 +592,7 @@ private:
     std::weak_ptr<log_appender> _issued_write;
     std::shared_ptr<log_appender> _pending_write;
     uint64_t _pending_write_start_time_ms;
+    uint64_t _pending_write_start_time_us;
     decree _pending_write_max_commit;
     decree _pending_write_max_decree;
     mutable zlock _plock;
@@ -516,6 +600,9 @@ private:
     uint32_t _batch_buffer_bytes;
     uint32_t _batch_buffer_max_count;
     uint64_t _batch_buffer_flush_interval_ms;
+
+    group_commit_controller _group_commit;
+    std::atomic_bool _group_commit_scheduled{false};
 };
 
 } // namespace replication
@@ -4,13 +4,415 @@
 
 #include "mutation_log.h"
 #include "mutation_log_utils.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <dsn/tool-api/task.h>
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/errors.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                log_replay_pipelined,
+                false,
+                "whether to replay mutation logs with a pipeline, in which log blocks are read "
+                "ahead across files, and checked and decoded by log_replay_decode_threads "
+                "threads, while mutations are still applied in log order");
+DSN_DEFINE_uint32("replication",
+                  log_replay_decode_threads,
+                  2,
+                  "the count of threads to check and decode log blocks in pipelined replay");
+DSN_DEFINE_validator(log_replay_decode_threads, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  log_replay_max_pending_blocks,
+                  64,
+                  "the max count of log blocks read ahead in pipelined replay");
+DSN_DEFINE_validator(log_replay_max_pending_blocks,
+                     [](uint32_t value) -> bool { return value > 0; });
+
+namespace {
+
+// the time break-down of a replay, which is printed when the replay is done
+struct replay_stats
+{
+    uint64_t start_ns{dsn_now_ns()};
+    uint64_t read_ns{0};
+    uint64_t decode_ns{0};
+    uint64_t apply_ns{0};
+    uint64_t blocks{0};
+    uint64_t bytes{0};
+    uint64_t mutations{0};
+
+    void print(size_t file_count, bool pipelined, error_code err) const
+    {
+        uint64_t total_ms = (dsn_now_ns() - start_ns) / 1000000;
+        if (pipelined) {
+            ddebug_f("replay {} log files pipelined [err: {}]: {} blocks, {} bytes, {} mutations, "
+                     "time_used = {} ms (read {} ms, check and decode {} ms on {} threads, "
+                     "apply {} ms)",
+                     file_count,
+                     err,
+                     blocks,
+                     bytes,
+                     mutations,
+                     total_ms,
+                     read_ns / 1000000,
+                     decode_ns / 1000000,
+                     FLAGS_log_replay_decode_threads,
+                     apply_ns / 1000000);
+        } else {
+            ddebug_f("replay {} log files [err: {}]: {} mutations, time_used = {} ms "
+                     "(read, check and decode {} ms, apply {} ms)",
+                     file_count,
+                     err,
+                     mutations,
+                     total_ms,
+                     total_ms - apply_ns / 1000000,
+                     apply_ns / 1000000);
+        }
+    }
+};
+
+// log_replay_pipeline runs mutation_log::replay in three stages:
+//  - a reader thread reads the blocks of all the files in order, with read-ahead bounded by
+//    log_replay_max_pending_blocks;
+//  - decoder threads check the crc of the blocks and decode their mutations;
+//  - the caller applies the decoded mutations in order, exactly as the sequential replay
+//    does, including the handling of errors.
+class log_replay_pipeline
+{
+public:
+    log_replay_pipeline(std::map<int, log_file_ptr> &logs, replay_stats &stats)
+        : _logs(logs), _stats(stats)
+    {
+    }
+
+    ~log_replay_pipeline() { stop(); }
+
+    error_code replay(mutation_log::replay_callback &callback, /*out*/ int64_t &end_offset);
+
+private:
+    struct block
+    {
+        // set by the reader
+        log_file *log;
+        // the global offset of the block
+        int64_t start_offset;
+        // not ERR_OK if this is the end of the file: the result of the failed read
+        error_code read_err;
+        log_block_header hdr;
+        blob body;
+        uint32_t prev_crc;
+
+        // set by the decoder
+        bool decoded{false};
+        error_code err;
+        // the global offset the replay has reached in the block, either its end or where
+        // `err` happened
+        int64_t end_offset;
+        std::vector<std::pair<int, mutation_ptr>> mutations;
+    };
+    typedef std::shared_ptr<block> block_ptr;
+
+    void start();
+    void stop();
+    void read_files(service_node *node);
+    void decode_blocks(service_node *node);
+    static void decode(block &b);
+
+    // blocks until the next block in order is ready, nullptr if the reader has finished
+    block_ptr next_block();
+
+    std::map<int, log_file_ptr> &_logs;
+    replay_stats &_stats;
+
+    std::mutex _lock;
+    std::condition_variable _ready_cv;   // a block is decoded, or read
+    std::condition_variable _consume_cv; // a block is consumed, or stopping
+    std::deque<block_ptr> _blocks;       // in order, read but not consumed
+    std::deque<block_ptr> _to_decode;
+    bool _read_done{false};
+    bool _stopping{false};
+    uint64_t _read_ns{0};
+    uint64_t _decode_ns{0};
+
+    std::vector<std::thread> _threads;
+};
+
+void log_replay_pipeline::start()
+{
+    service_node *node = task::get_current_node2();
+    _threads.emplace_back([this, node]() { read_files(node); });
+    for (uint32_t i = 0; i < FLAGS_log_replay_decode_threads; ++i) {
+        _threads.emplace_back([this, node]() { decode_blocks(node); });
+    }
+}
+
+void log_replay_pipeline::stop()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopping = true;
+    }
+    _consume_cv.notify_all();
+    _ready_cv.notify_all();
+    for (auto &t : _threads) {
+        t.join();
+    }
+    _threads.clear();
+}
+
+void log_replay_pipeline::read_files(service_node *node)
+{
+    if (node != nullptr) {
+        task::set_tls_dsn_context(node, nullptr);
+    }
+
+    for (auto &kv : _logs) {
+        log_file *log = kv.second.get();
+        log->reset_stream();
+        int64_t offset = log->start_offset();
+        uint32_t prev_crc = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> l(_lock);
+                _consume_cv.wait(l, [this]() {
+                    return _stopping || _blocks.size() < FLAGS_log_replay_max_pending_blocks;
+                });
+                if (_stopping) {
+                    return;
+                }
+            }
+
+            uint64_t start = dsn_now_ns();
+            auto b = std::make_shared<block>();
+            b->log = log;
+            b->start_offset = offset;
+            b->read_err = log->read_next_log_block_unchecked(b->hdr, b->body);
+            if (b->read_err == ERR_OK) {
+                // the read buffer is reused by the next read, while the block is decoded
+                // in another thread
+                if (!b->body.buffer_ptr()) {
+                    std::shared_ptr<char> buf(utils::make_shared_array<char>(b->body.length()));
+                    memcpy(buf.get(), b->body.data(), b->body.length());
+                    b->body = blob(std::move(buf), 0, b->body.length());
+                }
+                b->prev_crc = prev_crc;
+                prev_crc = b->hdr.body_crc;
+                offset += sizeof(log_block_header) + b->hdr.length;
+            }
+            uint64_t elapsed = dsn_now_ns() - start;
+
+            {
+                std::lock_guard<std::mutex> l(_lock);
+                _read_ns += elapsed;
+                _blocks.push_back(b);
+                if (b->read_err == ERR_OK) {
+                    _to_decode.push_back(b);
+                }
+            }
+            _ready_cv.notify_all();
+            if (b->read_err != ERR_OK) {
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _read_done = true;
+    }
+    _ready_cv.notify_all();
+}
+
+void log_replay_pipeline::decode_blocks(service_node *node)
+{
+    if (node != nullptr) {
+        task::set_tls_dsn_context(node, nullptr);
+    }
+
+    while (true) {
+        block_ptr b;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _ready_cv.wait(l, [this]() { return _stopping || !_to_decode.empty(); });
+            if (_stopping) {
+                return;
+            }
+            b = std::move(_to_decode.front());
+            _to_decode.pop_front();
+        }
+
+        uint64_t start = dsn_now_ns();
+        decode(*b);
+        uint64_t elapsed = dsn_now_ns() - start;
+
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            _decode_ns += elapsed;
+            b->decoded = true;
+        }
+        _ready_cv.notify_all();
+    }
+}
+
+// the same checks as log_file::read_next_log_block and mutation_log::replay_block
+/*static*/ void log_replay_pipeline::decode(block &b)
+{
+    b.end_offset = b.start_offset;
+    if (log_file::crc_of_block(b.body, b.prev_crc) != b.hdr.body_crc) {
+        derror("crc checking failed");
+        b.err = ERR_INVALID_DATA;
+        return;
+    }
+
+    b.err = log_block::decompress(b.hdr, b.body);
+    if (b.err != ERR_OK) {
+        return;
+    }
+
+    binary_reader reader(b.body);
+    b.end_offset += sizeof(log_block_header);
+    const int64_t compressed_offset = b.hdr.is_compressed() ? b.end_offset : invalid_offset;
+
+    // the first block is log_file_header
+    if (b.start_offset == b.log->start_offset()) {
+        b.end_offset += b.log->read_file_header(reader);
+        if (!b.log->is_right_header()) {
+            derror("failed to read log file header");
+            b.err = ERR_INVALID_DATA;
+            return;
+        }
+    }
+
+    int64_t offset = b.end_offset;
+    while (!reader.is_eof()) {
+        auto old_size = reader.get_remaining_size();
+        mutation_ptr mu = mutation::read_from(reader, nullptr);
+        dassert(nullptr != mu, "");
+        mu->set_logged();
+
+        int64_t expected_offset = compressed_offset != invalid_offset ? compressed_offset : offset;
+        if (mu->data.header.log_offset != expected_offset) {
+            derror_f("offset mismatch in log entry and mutation {} vs {}",
+                     expected_offset,
+                     mu->data.header.log_offset);
+            b.err = ERR_INVALID_DATA;
+            break;
+        }
+
+        int log_length = old_size - reader.get_remaining_size();
+        b.mutations.emplace_back(log_length, std::move(mu));
+        offset += log_length;
+    }
+    // the mutations before a bad one are still applied, as the sequential replay does
+    b.end_offset = offset;
+    if (compressed_offset != invalid_offset && b.err == ERR_OK) {
+        b.end_offset = compressed_offset + b.hdr.length;
+    }
+}
+
+log_replay_pipeline::block_ptr log_replay_pipeline::next_block()
+{
+    std::unique_lock<std::mutex> l(_lock);
+    _ready_cv.wait(l, [this]() {
+        return (!_blocks.empty() &&
+                (_blocks.front()->read_err != ERR_OK || _blocks.front()->decoded)) ||
+               (_blocks.empty() && _read_done);
+    });
+    if (_blocks.empty()) {
+        return nullptr;
+    }
+    block_ptr b = std::move(_blocks.front());
+    _blocks.pop_front();
+    l.unlock();
+    _consume_cv.notify_all();
+    return b;
+}
+
+error_code log_replay_pipeline::replay(mutation_log::replay_callback &callback,
+                                       /*out*/ int64_t &end_offset)
+{
+    start();
+
+    error_code err = ERR_OK;
+    for (auto &kv : _logs) {
+        log_file_ptr &log = kv.second;
+
+        if (log->start_offset() != end_offset) {
+            derror("offset mismatch in log file offset and global offset %" PRId64 " vs %" PRId64,
+                   log->start_offset(),
+                   end_offset);
+            err = ERR_INVALID_DATA;
+            break;
+        }
+
+        ddebug("start to replay mutation log %s, offset = [%" PRId64 ", %" PRId64
+               "), size = %" PRId64,
+               log->path().c_str(),
+               log->start_offset(),
+               log->end_offset(),
+               log->end_offset() - log->start_offset());
+
+        // the blocks of the file end with the failed read, the blocks after a failed one
+        // are skipped
+        end_offset = log->start_offset();
+        err = ERR_OK;
+        while (true) {
+            block_ptr b = next_block();
+            dassert(b != nullptr && b->log == log.get(),
+                    "blocks of %s are lost",
+                    log->path().c_str());
+            if (b->read_err != ERR_OK) {
+                if (err == ERR_OK) {
+                    end_offset = b->start_offset;
+                    err = b->read_err;
+                }
+                break;
+            }
+            if (err != ERR_OK) {
+                continue;
+            }
+
+            _stats.blocks++;
+            _stats.bytes += sizeof(log_block_header) + b->hdr.length;
+            uint64_t start = dsn_now_ns();
+            for (auto &m : b->mutations) {
+                callback(m.first, m.second);
+            }
+            _stats.apply_ns += dsn_now_ns() - start;
+            _stats.mutations += b->mutations.size();
+            end_offset = b->end_offset;
+            err = b->err;
+        }
+
+        ddebug("finish to replay mutation log (%s) [err: %s]",
+               log->path().c_str(),
+               err.to_string());
+        log->close();
+
+        if (err == ERR_OK || err == ERR_HANDLE_EOF) {
+            // do nothing
+        } else if (err == ERR_INCOMPLETE_DATA) {
+            dwarn("delay handling error: %s", err.to_string());
+        } else {
+            break;
+        }
+    }
+
+    stop();
+    _stats.read_ns = _read_ns;
+    _stats.decode_ns = _decode_ns;
+    return err;
+}
+
+} // anonymous namespace
+
 /*static*/ error_code mutation_log::replay(log_file_ptr log,
                                            replay_callback callback,
                                            /*out*/ int64_t &end_offset)
@@ -59,13 +461,16 @@ namespace replication {
     end_offset = global_start_offset; // reset end_offset to the start.
 
     // reads the entire block into memory
-    error_code err = log->read_next_log_block(bb);
+    log_block_header hdr;
+    error_code err = log->read_next_log_block(hdr, bb);
     if (err != ERR_OK) {
         return error_s::make(err, "failed to read log block");
     }
 
     reader = dsn::make_unique<binary_reader>(bb);
     end_offset += sizeof(log_block_header);
+    // all mutations in a compressed block share the offset of its body
+    const int64_t compressed_offset = hdr.is_compressed() ? end_offset : invalid_offset;
 
     // The first block is log_file_header.
     if (global_start_offset == log->start_offset()) {
@@ -82,10 +487,12 @@ namespace replication {
         dassert(nullptr != mu, "");
         mu->set_logged();
 
-        if (mu->data.header.log_offset != end_offset) {
+        int64_t expected_offset =
+            compressed_offset != invalid_offset ? compressed_offset : end_offset;
+        if (mu->data.header.log_offset != expected_offset) {
             return FMT_ERR(ERR_INVALID_DATA,
                            "offset mismatch in log entry and mutation {} vs {}",
-                           end_offset,
+                           expected_offset,
                            mu->data.header.log_offset);
         }
 
@@ -96,6 +503,9 @@ namespace replication {
         end_offset += log_length;
     }
 
+    if (compressed_offset != invalid_offset) {
+        end_offset = compressed_offset + hdr.length;
+    }
     return error_s::ok();
 }
 
@@ -132,7 +542,6 @@ namespace replication {
     int64_t g_start_offset = 0;
     int64_t g_end_offset = 0;
     error_code err = ERR_OK;
-    log_file_ptr last;
 
     if (logs.size() > 0) {
         g_start_offset = logs.begin()->second->start_offset();
@@ -147,32 +556,47 @@ namespace replication {
 
     end_offset = g_start_offset;
 
-    for (auto &kv : logs) {
-        log_file_ptr &log = kv.second;
-
-        if (log->start_offset() != end_offset) {
-            derror("offset mismatch in log file offset and global offset %" PRId64 " vs %" PRId64,
-                   log->start_offset(),
-                   end_offset);
-            return ERR_INVALID_DATA;
-        }
+    replay_stats stats;
+    if (FLAGS_log_replay_pipelined) {
+        err = log_replay_pipeline(logs, stats).replay(callback, end_offset);
+    } else {
+        replay_callback apply = [&stats, &callback](int log_length, mutation_ptr &mu) {
+            uint64_t start = dsn_now_ns();
+            bool ret = callback(log_length, mu);
+            stats.apply_ns += dsn_now_ns() - start;
+            stats.mutations++;
+            return ret;
+        };
+
+        for (auto &kv : logs) {
+            log_file_ptr &log = kv.second;
+
+            if (log->start_offset() != end_offset) {
+                derror("offset mismatch in log file offset and global offset %" PRId64
+                       " vs %" PRId64,
+                       log->start_offset(),
+                       end_offset);
+                return ERR_INVALID_DATA;
+            }
 
-        last = log;
-        err = mutation_log::replay(log, callback, end_offset);
+            err = mutation_log::replay(log, apply, end_offset);
 
-        log->close();
+            log->close();
 
-        if (err == ERR_OK || err == ERR_HANDLE_EOF) {
-            // do nothing
-        } else if (err == ERR_INCOMPLETE_DATA) {
-            // If the file is not corrupted, it may also return the value of ERR_INCOMPLETE_DATA.
-            // In this case, the correctness is relying on the check of start_offset.
-            dwarn("delay handling error: %s", err.to_string());
-        } else {
-            // for other errors, we should break
-            break;
+            if (err == ERR_OK || err == ERR_HANDLE_EOF) {
+                // do nothing
+            } else if (err == ERR_INCOMPLETE_DATA) {
+                // If the file is not corrupted, it may also return the value of
+                // ERR_INCOMPLETE_DATA. In this case, the correctness is relying on the check of
+                // start_offset.
+                dwarn("delay handling error: %s", err.to_string());
+            } else {
+                // for other errors, we should break
+                break;
+            }
         }
     }
+    stats.print(logs.size(), FLAGS_log_replay_pipelined, err);
 
     if (err == ERR_OK || err == ERR_HANDLE_EOF) {
         // the log may still be written when used for learning
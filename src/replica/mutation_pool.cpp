@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "mutation_pool.h"
+
+#include <new>
+#include <dsn/utility/flags.h>
+#include <dsn/dist/fmt_logging.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                mutation_pool_enabled,
+                false,
+                "whether to recycle the mutations of a replica through its mutation pool");
+DSN_DEFINE_uint32("replication",
+                  mutation_pool_max_cached_count,
+                  512,
+                  "max count of the free mutations cached by the mutation pool of a replica");
+
+mutation_pool::mutation_pool(gpid pid)
+{
+    _free_buffers.reserve(FLAGS_mutation_pool_max_cached_count);
+
+    std::string counter_str = fmt::format("mutation.pool.memory.bytes@{}", pid);
+    _counter_memory_bytes.init_app_counter(
+        "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
+}
+
+mutation_pool::~mutation_pool()
+{
+    free_block *b = _free_blocks;
+    while (b != nullptr) {
+        free_block *next = b->next;
+        ::operator delete(b);
+        b = next;
+    }
+}
+
+mutation *mutation_pool::create()
+{
+    if (!FLAGS_mutation_pool_enabled) {
+        return new mutation();
+    }
+
+    block_header *h = nullptr;
+    buffers bufs;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+        if (_free_blocks != nullptr) {
+            h = reinterpret_cast<block_header *>(_free_blocks);
+            _free_blocks = _free_blocks->next;
+            _free_count--;
+        }
+        if (!_free_buffers.empty()) {
+            bufs = std::move(_free_buffers.back());
+            _free_buffers.pop_back();
+        }
+    }
+    if (h == nullptr) {
+        h = static_cast<block_header *>(::operator new(block_size()));
+        _memory_bytes.fetch_add(block_size(), std::memory_order_relaxed);
+        update_counter();
+    }
+
+    // released in deallocate()
+    add_ref();
+    h->owner = this;
+    mutation *mu = ::new (h + 1) mutation();
+    mu->data.updates.swap(bufs.updates);
+    mu->client_requests.swap(bufs.client_requests);
+    mu->_prepare_requests.swap(bufs.prepare_requests);
+    return mu;
+}
+
+size_t mutation_pool::cached_count() const
+{
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+    return _free_count;
+}
+
+void mutation_pool::recycle_buffers(std::vector<mutation_update> &updates,
+                                    std::vector<dsn::message_ex *> &client_requests,
+                                    std::vector<dsn::message_ex *> &prepare_requests)
+{
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+    // never grows beyond the reserved capacity, so that no malloc happens under the lock
+    if (_free_buffers.size() < _free_buffers.capacity()) {
+        _free_buffers.emplace_back();
+        buffers &bufs = _free_buffers.back();
+        bufs.updates.swap(updates);
+        bufs.client_requests.swap(client_requests);
+        bufs.prepare_requests.swap(prepare_requests);
+    }
+}
+
+void mutation_pool::deallocate(block_header *h)
+{
+    bool cached = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+        if (_free_count < FLAGS_mutation_pool_max_cached_count) {
+            free_block *b = reinterpret_cast<free_block *>(h);
+            b->next = _free_blocks;
+            _free_blocks = b;
+            _free_count++;
+            cached = true;
+        }
+    }
+    if (!cached) {
+        ::operator delete(h);
+        _memory_bytes.fetch_sub(block_size(), std::memory_order_relaxed);
+        update_counter();
+    }
+
+    // the pool may be destroyed here if its replica has gone
+    release_ref();
+}
+
+void mutation_pool::update_counter()
+{
+    _counter_memory_bytes->set(_memory_bytes.load(std::memory_order_relaxed));
+}
+
+} // namespace replication
+} // namespace dsn
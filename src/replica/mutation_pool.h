@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include "mutation.h"
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace replication {
+
+// mutation_pool recycles the mutations of a replica, so that the steady-state writes cost
+// (almost) no malloc for the mutation objects and the vectors inside them:
+// - the memory of a freed mutation is cached in the free list of the pool it's allocated from,
+// - its update vector and request vectors are cleared and cached with their capacity, and
+//   moved into the next mutation created from the pool.
+//
+// Mutations are freed on any thread (the log callbacks, the rpc threads...), so the caches are
+// guarded by a spin lock. Each live mutation holds a reference of its pool, the pool may outlive
+// its replica.
+//
+// It's enabled by [replication] mutation_pool_enabled, mutations are allocated by `new` when
+// disabled.
+class mutation_pool : public ref_counter
+{
+public:
+    explicit mutation_pool(gpid pid);
+    ~mutation_pool() override;
+
+    // creates a new mutation, which is returned to the pool when it's freed
+    mutation *create();
+
+    size_t cached_count() const;
+
+    // the bytes of the mutations allocated from the pool, including the cached ones
+    int64_t memory_bytes() const { return _memory_bytes.load(std::memory_order_relaxed); }
+
+private:
+    friend class mutation;
+
+    // the header placed just before every mutation object, see mutation::operator new, which
+    // is 16 bytes to keep the alignment of malloc
+    struct block_header
+    {
+        mutation_pool *owner;
+        int64_t reserved;
+    };
+    static_assert(sizeof(block_header) == 16, "block_header should be 16 bytes");
+
+    struct free_block
+    {
+        free_block *next;
+    };
+
+    struct buffers
+    {
+        std::vector<mutation_update> updates;
+        std::vector<dsn::message_ex *> client_requests;
+        std::vector<dsn::message_ex *> prepare_requests;
+    };
+
+    static block_header *header_of(void *mu)
+    {
+        return reinterpret_cast<block_header *>(mu) - 1;
+    }
+
+    static size_t block_size() { return sizeof(block_header) + sizeof(mutation); }
+
+    // called by the destructor of a pooled mutation, the vectors must have been cleared
+    void recycle_buffers(std::vector<mutation_update> &updates,
+                         std::vector<dsn::message_ex *> &client_requests,
+                         std::vector<dsn::message_ex *> &prepare_requests);
+
+    // called by mutation::operator delete
+    void deallocate(block_header *h);
+
+    void update_counter();
+
+private:
+    mutable utils::ex_lock_nr_spin _lock;
+    free_block *_free_blocks{nullptr};
+    size_t _free_count{0};
+    std::vector<buffers> _free_buffers;
+
+    std::atomic<int64_t> _memory_bytes{0};
+    perf_counter_wrapper _counter_memory_bytes;
+};
+
+typedef dsn::ref_ptr<mutation_pool> mutation_pool_ptr;
+
+} // namespace replication
+} // namespace dsn
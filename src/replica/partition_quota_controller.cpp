@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <dsn/c/api_layer1.h>
+
+#include "partition_quota_controller.h"
+
+namespace dsn {
+namespace replication {
+
+bool partition_quota_controller::limiter::consume(int64_t units)
+{
+    demand.fetch_add(units, std::memory_order_relaxed);
+    int64_t r = rate.load(std::memory_order_relaxed);
+    if (r <= 0) {
+        return true;
+    }
+    // burst up to one second of the share, a larger request is admitted once the bucket is full
+    return bucket.consume(units, r, std::max(r, units));
+}
+
+partition_quota_controller::partition_quota_controller() : _last_collect_ms(dsn_now_ms()) {}
+
+void partition_quota_controller::set_share(const partition_quota &share)
+{
+    _write_qps.rate.store(share.write_qps, std::memory_order_relaxed);
+    _write_size.rate.store(share.write_bytes_per_sec, std::memory_order_relaxed);
+    _read_qps.rate.store(share.read_qps, std::memory_order_relaxed);
+}
+
+bool partition_quota_controller::consume_write(int64_t bytes)
+{
+    // count the demand on both even if the first one rejects
+    bool qps_ok = _write_qps.consume(1);
+    bool size_ok = _write_size.consume(bytes);
+    return qps_ok && size_ok;
+}
+
+bool partition_quota_controller::consume_read() { return _read_qps.consume(1); }
+
+void partition_quota_controller::collect_usage(/*out*/ partition_quota &usage)
+{
+    uint64_t now_ms = dsn_now_ms();
+    uint64_t elapsed_ms = std::max<uint64_t>(1, now_ms - _last_collect_ms);
+    _last_collect_ms = now_ms;
+
+    auto per_sec = [elapsed_ms](limiter &l) {
+        return static_cast<int64_t>(l.demand.exchange(0, std::memory_order_relaxed) * 1000 /
+                                    elapsed_ms);
+    };
+    usage.write_qps = per_sec(_write_qps);
+    usage.write_bytes_per_sec = per_sec(_write_size);
+    usage.read_qps = per_sec(_read_qps);
+}
+
+} // namespace replication
+} // namespace dsn
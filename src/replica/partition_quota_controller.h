@@ -0,0 +1,65 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/utility/TokenBucket.h>
+
+namespace dsn {
+namespace replication {
+
+// Enforces the share of the table quotas that meta server assigns to a primary replica in the
+// config sync, and measures the demand of the replica, including the rejected requests, which
+// meta server splits the quotas by.
+//
+// thread safe
+class partition_quota_controller
+{
+public:
+    partition_quota_controller();
+
+    // a share of 0 is unlimited
+    void set_share(const partition_quota &share);
+    void reset_share() { set_share(partition_quota()); }
+
+    // return false if the request exceeds the share.
+    bool consume_write(int64_t bytes);
+    bool consume_read();
+
+    // the demand per second since the last call.
+    void collect_usage(/*out*/ partition_quota &usage);
+
+private:
+    struct limiter
+    {
+        std::atomic<int64_t> rate{0};
+        std::atomic<int64_t> demand{0};
+        folly::DynamicTokenBucket bucket;
+
+        bool consume(int64_t units);
+    };
+
+    limiter _write_qps;
+    limiter _write_size;
+    limiter _read_qps;
+    uint64_t _last_collect_ms;
+};
+
+} // namespace replication
+} // namespace dsn
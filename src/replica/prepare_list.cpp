@@ -28,10 +28,18 @@
 
 #include <dsn/utils/latency_tracer.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                prepare_list_batch_commit,
+                false,
+                "whether to commit the contiguous ready mutations of prepare list in one batch");
+
+/*static*/ bool prepare_list::batch_commit_enabled() { return FLAGS_prepare_list_batch_commit; }
+
 prepare_list::prepare_list(replica_base *r,
                            decree init_decree,
                            int max_count,
@@ -137,6 +145,33 @@ error_code prepare_list::prepare(mutation_ptr &mu,
     }
 }
 
+void prepare_list::commit_one(const mutation_ptr &mu)
+{
+    _last_committed_decree++;
+    if (_batch_committer) {
+        _committing.push_back(mu);
+    } else {
+        mutation_ptr m = mu;
+        _committer(m);
+    }
+}
+
+void prepare_list::flush_committing()
+{
+    if (_committing.empty()) {
+        return;
+    }
+
+    // the committer may commit again, e.g. from the primary's check_possible_work
+    std::vector<mutation_ptr> batch;
+    batch.swap(_committing);
+    _batch_committer(batch);
+    if (_committing.empty()) {
+        batch.clear();
+        _committing.swap(batch);
+    }
+}
+
 //
 // ordered commit
 //
@@ -149,29 +184,29 @@ void prepare_list::commit(decree d, commit_type ct)
     switch (ct) {
     case COMMIT_TO_DECREE_HARD: {
         for (decree d0 = last_committed_decree() + 1; d0 <= d; d0++) {
-            mutation_ptr mu = get_mutation_by_decree(d0);
+            const mutation_ptr &mu = get_mutation_by_decree(d0);
 
             dassert_replica(
                 mu != nullptr && mu->is_logged(), "mutation {} is missing in prepare list", d0);
             dcheck_ge_replica(mu->data.header.ballot, last_bt);
 
-            _last_committed_decree++;
             last_bt = mu->data.header.ballot;
-            _committer(mu);
+            commit_one(mu);
         }
+        flush_committing();
 
         return;
     }
     case COMMIT_TO_DECREE_SOFT: {
         for (decree d0 = last_committed_decree() + 1; d0 <= d; d0++) {
-            mutation_ptr mu = get_mutation_by_decree(d0);
+            const mutation_ptr &mu = get_mutation_by_decree(d0);
             if (mu != nullptr && mu->is_ready_for_commit() && mu->data.header.ballot >= last_bt) {
-                _last_committed_decree++;
                 last_bt = mu->data.header.ballot;
-                _committer(mu);
+                commit_one(mu);
             } else
                 break;
         }
+        flush_committing();
 
         return;
     }
@@ -179,16 +214,15 @@ void prepare_list::commit(decree d, commit_type ct)
         if (d != last_committed_decree() + 1)
             return;
 
-        int count = 0;
-        mutation_ptr mu = get_mutation_by_decree(last_committed_decree() + 1);
-
-        while (mu != nullptr && mu->is_ready_for_commit() && mu->data.header.ballot >= last_bt) {
-            _last_committed_decree++;
+        for (;;) {
+            const mutation_ptr &mu = get_mutation_by_decree(_last_committed_decree + 1);
+            if (mu == nullptr || !mu->is_ready_for_commit() || mu->data.header.ballot < last_bt) {
+                break;
+            }
             last_bt = mu->data.header.ballot;
-            _committer(mu);
-            count++;
-            mu = mutation_cache::get_mutation_by_decree(_last_committed_decree + 1);
+            commit_one(mu);
         }
+        flush_committing();
 
         return;
     }
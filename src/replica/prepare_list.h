@@ -50,6 +50,8 @@ class prepare_list : public mutation_cache, private replica_base
 {
 public:
     typedef std::function<void(mutation_ptr &)> mutation_committer;
+    // commits a contiguous range of mutations, ordered by decree, in one call
+    typedef std::function<void(std::vector<mutation_ptr> &)> mutation_batch_committer;
 
 public:
     prepare_list(replica_base *r, decree init_decree, int max_count, mutation_committer committer);
@@ -59,6 +61,13 @@ public:
     void reset(decree init_decree);
     void truncate(decree init_decree);
     void set_committer(mutation_committer committer) { _committer = committer; }
+    // once set, commit() hands all the mutations it commits to the batch committer instead of
+    // calling the committer one by one
+    void set_batch_committer(mutation_batch_committer committer)
+    {
+        _batch_committer = std::move(committer);
+    }
+    static bool batch_commit_enabled();
 
     //
     // for two-phase commit
@@ -71,8 +80,13 @@ public:
     void commit(decree decree, commit_type ct);                   // ordered commit
 
 private:
+    void commit_one(const mutation_ptr &mu);
+    void flush_committing();
+
     decree _last_committed_decree;
     mutation_committer _committer;
+    mutation_batch_committer _batch_committer;
+    std::vector<mutation_ptr> _committing;
 };
 
 } // namespace replication
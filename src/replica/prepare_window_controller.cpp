@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "prepare_window_controller.h"
+
+#include <algorithm>
+#include <limits>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                adaptive_prepare_window,
+                false,
+                "whether to tune the count of the concurrent prepares and the batch size of "
+                "the mutations on primary from the measured 2pc latency");
+
+const int prepare_window_controller::ALPHA;
+const int prepare_window_controller::BETA;
+const uint32_t prepare_window_controller::MIN_BATCH_BYTES;
+const uint32_t prepare_window_controller::MAX_BATCH_BYTES;
+const int prepare_window_controller::EPOCH_SAMPLES;
+
+/*static*/ bool prepare_window_controller::enabled() { return FLAGS_adaptive_prepare_window; }
+
+prepare_window_controller::prepare_window_controller(int max_window)
+    : _max_window(std::max(max_window, 1))
+{
+    reset();
+}
+
+void prepare_window_controller::reset()
+{
+    _window = std::min(2, _max_window);
+    _batch_bytes = MIN_BATCH_BYTES;
+    _latency_us = 0;
+    _epoch_min_us = std::numeric_limits<uint64_t>::max();
+    _prev_epoch_min_us = std::numeric_limits<uint64_t>::max();
+    _epoch_samples = 0;
+    _round_commits = 0;
+    _round_saturated = false;
+}
+
+uint64_t prepare_window_controller::base_latency_us() const
+{
+    uint64_t base = std::min(_epoch_min_us, _prev_epoch_min_us);
+    return base == std::numeric_limits<uint64_t>::max() ? 0 : base;
+}
+
+void prepare_window_controller::on_committed(uint64_t latency_us, bool saturated)
+{
+    latency_us = std::max<uint64_t>(latency_us, 1);
+    _latency_us = _latency_us == 0 ? latency_us : (_latency_us * 7 + latency_us) / 8;
+    _epoch_min_us = std::min(_epoch_min_us, latency_us);
+    if (++_epoch_samples >= EPOCH_SAMPLES) {
+        _prev_epoch_min_us = _epoch_min_us;
+        _epoch_min_us = std::numeric_limits<uint64_t>::max();
+        _epoch_samples = 0;
+    }
+
+    _round_saturated = _round_saturated || saturated;
+    if (++_round_commits < _window) {
+        return;
+    }
+
+    // a round is over
+    double queued = _window * (1.0 - static_cast<double>(base_latency_us()) / _latency_us);
+    if (queued < ALPHA && _round_saturated) {
+        _window = std::min(_window + 1, _max_window);
+    } else if (queued > BETA) {
+        _window = std::max(_window - 1, 1);
+    }
+
+    if (_round_saturated) {
+        _batch_bytes = std::min(_batch_bytes * 2, MAX_BATCH_BYTES);
+    } else {
+        _batch_bytes = std::max(_batch_bytes / 2, MIN_BATCH_BYTES);
+    }
+
+    _round_commits = 0;
+    _round_saturated = false;
+}
+
+} // namespace replication
+} // namespace dsn
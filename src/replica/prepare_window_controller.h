@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+
+namespace dsn {
+namespace replication {
+
+// prepare_window_controller tunes the 2PC pipeline depth of a primary, that is the max count
+// of the concurrent prepares of mutation_queue, together with the max size a mutation may be
+// batched to while it waits, in place of the static staleness_for_commit and 1MB limits.
+//
+// It works like the delay-based congestion control of TCP Vegas. A 2PC latency sample is the
+// time from the prepare to the commit of a mutation, which covers both the prepare RTT and the
+// log append. The min recent sample is the base latency, and the mutations queued somewhere
+// along the pipeline are estimated as `window * (1 - base / latency)`. Once per round (as many
+// commits as the window), the window grows by one if they are fewer than ALPHA while the
+// window is saturated, and shrinks by one if they are more than BETA.
+//
+// The batch size doubles when the window is saturated (mutations are left waiting after a
+// commit) and halves when it isn't, so that mutations are only batched, which delays them,
+// when the window alone can't carry the load.
+//
+// It is not thread-safe, the methods are called in the replica thread.
+class prepare_window_controller
+{
+public:
+    // whether [replication] adaptive_prepare_window is on
+    static bool enabled();
+
+    static const int ALPHA = 1;
+    static const int BETA = 3;
+    static const uint32_t MIN_BATCH_BYTES = 64 * 1024;
+    static const uint32_t MAX_BATCH_BYTES = 1024 * 1024;
+
+    // the window is bounded by [1, max_window]
+    explicit prepare_window_controller(int max_window);
+
+    // starts over, e.g. when the replica becomes primary again
+    void reset();
+
+    // `latency_us` is the 2PC latency of the committed mutation, `saturated` is whether there
+    // are still mutations waiting for the window
+    void on_committed(uint64_t latency_us, bool saturated);
+
+    int window() const { return _window; }
+    uint32_t batch_bytes() const { return _batch_bytes; }
+
+    uint64_t base_latency_us() const;
+    uint64_t latency_us() const { return _latency_us; }
+
+private:
+    // the base latency is the min of the current and the previous epochs, so that it follows
+    // the changes of the links
+    static const int EPOCH_SAMPLES = 1024;
+
+    const int _max_window;
+    int _window;
+    uint32_t _batch_bytes;
+
+    uint64_t _latency_us;
+    uint64_t _epoch_min_us;
+    uint64_t _prev_epoch_min_us;
+    int _epoch_samples;
+
+    int _round_commits;
+    bool _round_saturated;
+};
+
+} // namespace replication
+} // namespace dsn
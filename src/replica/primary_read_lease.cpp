@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "primary_read_lease.h"
+
+#include <algorithm>
+#include <limits>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                primary_read_lease_enabled,
+                false,
+                "whether primary serves the reads only under the read lease granted by its "
+                "secondaries");
+DSN_DEFINE_uint32("replication",
+                  primary_read_lease_ms,
+                  12000,
+                  "the read lease granted by a secondary on each prepare or group check ack, it "
+                  "should be longer than group_check_interval_ms to keep an idle primary readable");
+DSN_DEFINE_validator(primary_read_lease_ms, [](uint32_t value) -> bool { return value > 0; });
+
+/*static*/ bool primary_read_lease::enabled() { return FLAGS_primary_read_lease_enabled; }
+
+/*static*/ uint64_t primary_read_lease::lease_ms() { return FLAGS_primary_read_lease_ms; }
+
+void primary_read_lease::reset(uint64_t last_granted_ms)
+{
+    _wait_until_ms = last_granted_ms == 0 ? 0 : last_granted_ms + lease_ms();
+    _granted_ts_ms.clear();
+}
+
+void primary_read_lease::renew(const rpc_address &node, uint64_t send_ts_ms)
+{
+    uint64_t &ts = _granted_ts_ms[node];
+    ts = std::max(ts, send_ts_ms);
+}
+
+uint64_t primary_read_lease::expire_ts_ms(const std::vector<rpc_address> &secondaries) const
+{
+    uint64_t granted_ts_ms = std::numeric_limits<uint64_t>::max();
+    for (const rpc_address &node : secondaries) {
+        auto it = _granted_ts_ms.find(node);
+        if (it == _granted_ts_ms.end()) {
+            return 0;
+        }
+        granted_ts_ms = std::min(granted_ts_ms, it->second);
+    }
+
+    // a primary without secondaries is only bounded by its failure detector
+    return secondaries.empty() ? std::numeric_limits<uint64_t>::max()
+                               : granted_ts_ms + lease_ms();
+}
+
+} // namespace replication
+} // namespace dsn
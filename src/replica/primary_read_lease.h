@@ -0,0 +1,75 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <dsn/tool-api/rpc_address.h>
+
+namespace dsn {
+namespace replication {
+
+// primary_read_lease is the lease under which a primary serves strongly consistent reads
+// locally.
+//
+// Every secondary grants the primary a lease of `primary_read_lease_ms` when it acks a prepare
+// or a group check, which is counted from the time the primary sent the message out. The
+// primary holds the lease until the earliest grant of its secondaries runs out, and refuses
+// reads the moment it does. A learner grants the lease in the same way, so that it already
+// holds one when it is upgraded to secondary, instead of leaving the primary unreadable until
+// its first ack as secondary.
+//
+// A secondary can't grant the lease to a new primary before the one it granted to the previous
+// primary runs out, so a newly promoted primary waits out the lease it granted as secondary,
+// counted from the time it received the message, before it serves reads or accepts writes.
+//
+// It is not thread-safe, the methods are called in the replica thread.
+class primary_read_lease
+{
+public:
+    // whether [replication] primary_read_lease_enabled is on
+    static bool enabled();
+    // [replication] primary_read_lease_ms
+    static uint64_t lease_ms();
+
+    // starts a new term of primary, no lease is held until `last_granted_ms + lease_ms()`,
+    // where `last_granted_ms` is the last time the replica granted a lease as secondary
+    void reset(uint64_t last_granted_ms = 0);
+
+    // `node` acked a message sent at `send_ts_ms`
+    void renew(const rpc_address &node, uint64_t send_ts_ms);
+
+    // the time when the lease runs out, 0 if no lease is held
+    uint64_t expire_ts_ms(const std::vector<rpc_address> &secondaries) const;
+
+    bool is_valid(const std::vector<rpc_address> &secondaries, uint64_t now_ms) const
+    {
+        return !is_waiting(now_ms) && now_ms < expire_ts_ms(secondaries);
+    }
+
+    // whether the primary is still waiting out the lease granted to the previous primary
+    bool is_waiting(uint64_t now_ms) const { return now_ms < _wait_until_ms; }
+
+private:
+    uint64_t _wait_until_ms{0};
+    std::unordered_map<rpc_address, uint64_t> _granted_ts_ms;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,69 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "read_staleness_tracker.h"
+
+namespace dsn {
+namespace replication {
+
+const size_t read_staleness_tracker::MAX_POINTS;
+
+void read_staleness_tracker::on_primary_committed(decree d, uint64_t now_ms)
+{
+    if (d <= invalid_decree || d < _max_known_decree) {
+        return;
+    }
+
+    if (d == _max_known_decree && !_points.empty()) {
+        // the primary was still at `d` by now
+        _points.back().receive_ts_ms = now_ms;
+        return;
+    }
+
+    _max_known_decree = d;
+    _points.push_back({d, now_ms});
+    if (_points.size() > MAX_POINTS) {
+        // losing a point only makes the estimation more conservative
+        _points.pop_front();
+    }
+}
+
+void read_staleness_tracker::advance(decree local_committed)
+{
+    while (!_points.empty() && _points.front().committed <= local_committed) {
+        _fresh_ts_ms = _points.front().receive_ts_ms;
+        _points.pop_front();
+    }
+}
+
+bool read_staleness_tracker::within_decrees(decree local_committed, uint64_t bound)
+{
+    if (_max_known_decree == invalid_decree) {
+        return false;
+    }
+    return _max_known_decree <= local_committed ||
+           static_cast<uint64_t>(_max_known_decree - local_committed) <= bound;
+}
+
+bool read_staleness_tracker::within_ms(decree local_committed, uint64_t bound_ms, uint64_t now_ms)
+{
+    advance(local_committed);
+    return _fresh_ts_ms > 0 && now_ms <= _fresh_ts_ms + bound_ms;
+}
+
+} // namespace replication
+} // namespace dsn
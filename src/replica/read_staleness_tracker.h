@@ -0,0 +1,64 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <dsn/dist/replication/replication_other_types.h>
+
+namespace dsn {
+namespace replication {
+
+// read_staleness_tracker estimates how far a secondary lags behind its primary, for the
+// bounded-staleness reads served by the secondary.
+//
+// The primary propagates its committed decree by the prepares and the group checks. Each one
+// received is a point (committed decree, receive time), and the secondary is as fresh as the
+// primary was at the receive time of the latest point whose decree it has committed locally.
+// The lag in decrees is measured against the largest committed decree of primary known. The
+// points stay valid across the changes of primary, as committed decrees are never revoked.
+//
+// It is not thread-safe, the methods are called in the replica thread.
+class read_staleness_tracker
+{
+public:
+    static const size_t MAX_POINTS = 64;
+
+    void on_primary_committed(decree d, uint64_t now_ms);
+
+    // whether a secondary which has committed `local_committed` is within the bound
+    bool within_decrees(decree local_committed, uint64_t bound);
+    bool within_ms(decree local_committed, uint64_t bound_ms, uint64_t now_ms);
+
+private:
+    void advance(decree local_committed);
+
+    struct point
+    {
+        decree committed;
+        uint64_t receive_ts_ms;
+    };
+    // ordered by the committed decree, the ones committed locally are popped
+    std::deque<point> _points;
+    decree _max_known_decree{invalid_decree};
+    uint64_t _fresh_ts_ms{0};
+};
+
+} // namespace replication
+} // namespace dsn
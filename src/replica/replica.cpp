@@ -34,12 +34,14 @@
 #include "bulk_load/replica_bulk_loader.h"
 #include "split/replica_split_manager.h"
 #include "replica_disk_migrator.h"
+#include "replica_shutdown_snapshot.h"
 #include "runtime/security/access_controller.h"
 
 #include <dsn/utils/latency_tracer.h>
 #include <dsn/cpp/json_helper.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/rand.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/utility/strings.h>
@@ -48,6 +50,20 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                read_isolation_enabled,
+                false,
+                "whether to execute the client reads on THREAD_POOL_REPLICATION_READ, in which "
+                "each data dir owns read_isolation_workers_per_dir workers, so that the slow "
+                "reads of a disk never block the reads of the others. the partitioned pool is "
+                "expected to have read_isolation_workers_per_dir * data dir count workers");
+DSN_DEFINE_uint32("replication",
+                  read_isolation_workers_per_dir,
+                  2,
+                  "the count of THREAD_POOL_REPLICATION_READ workers owned by each data dir");
+DSN_DEFINE_validator(read_isolation_workers_per_dir,
+                     [](uint32_t value) -> bool { return value > 0; });
+
 replica::replica(
     replica_stub *stub, gpid gpid, const app_info &app, const char *dir, bool need_restore)
     : serverlet<replica>("replica"),
@@ -71,34 +87,41 @@ replica::replica(
     dassert(stub != nullptr, "");
     _stub = stub;
     _dir = dir;
+    _dir_node_index = std::max(stub->_fs_manager.get_dir_node_index(dir), 0);
+    if (!stub->_disk_logs.empty()) {
+        _disk_shared_log = stub->get_shared_log(_dir);
+    }
     _options = &stub->options();
     init_state();
     _config.pid = gpid;
     _bulk_loader = make_unique<replica_bulk_loader>(this);
     _split_mgr = make_unique<replica_split_manager>(this);
     _disk_migrator = make_unique<replica_disk_migrator>(this);
-
-    std::string counter_str = fmt::format("private.log.size(MB)@{}", gpid);
-    _counter_private_log_size.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
-
-    counter_str = fmt::format("recent.write.throttling.delay.count@{}", gpid);
-    _counter_recent_write_throttling_delay_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
-
-    counter_str = fmt::format("recent.write.throttling.reject.count@{}", gpid);
-    _counter_recent_write_throttling_reject_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
-
-    counter_str = fmt::format("recent.read.throttling.delay.count@{}", gpid);
-    _counter_recent_read_throttling_delay_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
-
-    counter_str = fmt::format("recent.read.throttling.reject.count@{}", gpid);
-    _counter_recent_read_throttling_reject_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
-
-    counter_str = fmt::format("dup.disabled_non_idempotent_write_count@{}", _app_info.app_name);
+    _mutation_pool = new mutation_pool(gpid);
+
+    _counter_block = make_unique<perf_counter_block>(
+        task::get_current_node_name(), "eon.replica", fmt::format("{}", gpid));
+    _counter_private_log_size.init(
+        _counter_block.get(), "private.log.size(MB)", COUNTER_TYPE_NUMBER);
+    _counter_recent_write_throttling_delay_count.init(
+        _counter_block.get(), "recent.write.throttling.delay.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_recent_write_throttling_reject_count.init(
+        _counter_block.get(), "recent.write.throttling.reject.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_recent_read_throttling_delay_count.init(
+        _counter_block.get(), "recent.read.throttling.delay.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_recent_read_throttling_reject_count.init(
+        _counter_block.get(), "recent.read.throttling.reject.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_prepare_window_size.init(
+        _counter_block.get(), "prepare.window.size", COUNTER_TYPE_NUMBER);
+    _counter_recent_write_admission_reject_count.init(
+        _counter_block.get(), "recent.write.admission.reject.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_recent_read_lease_reject_count.init(
+        _counter_block.get(), "recent.read.lease.reject.count", COUNTER_TYPE_VOLATILE_NUMBER);
+    _counter_recent_read_staleness_reject_count.init(
+        _counter_block.get(), "recent.read.staleness.reject.count", COUNTER_TYPE_VOLATILE_NUMBER);
+
+    std::string counter_str =
+        fmt::format("dup.disabled_non_idempotent_write_count@{}", _app_info.app_name);
     _counter_dup_disabled_non_idempotent_write_count.init_app_counter(
         "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
 
@@ -109,6 +132,10 @@ replica::replica(
     _counter_backup_request_qps.init_app_counter(
         "eon.replica", counter_str.c_str(), COUNTER_TYPE_RATE, counter_str.c_str());
 
+    counter_str = fmt::format("bounded_staleness_read_qps@{}", _app_info.app_name);
+    _counter_bounded_staleness_read_qps.init_app_counter(
+        "eon.replica", counter_str.c_str(), COUNTER_TYPE_RATE, counter_str.c_str());
+
     if (need_restore) {
         // add an extra env for restore
         _extra_envs.insert(
@@ -146,6 +173,10 @@ void replica::init_state()
                          0,
                          _options->max_mutation_count_in_prepare_list,
                          std::bind(&replica::execute_mutation, this, std::placeholders::_1));
+    if (prepare_list::batch_commit_enabled()) {
+        _prepare_list->set_batch_committer(
+            std::bind(&replica::execute_mutations, this, std::placeholders::_1));
+    }
 
     _config.ballot = 0;
     _config.pid.set_app_id(0);
@@ -172,6 +203,8 @@ replica::~replica(void)
 
 void replica::on_client_read(dsn::message_ex *request, bool ignore_throttling)
 {
+    _resource_usage.on_rpc_in(request->body_size());
+    _resource_usage.on_access(dsn_now_ms());
     if (!_access_controller->allowed(request)) {
         response_client_read(request, ERR_ACL_DENY);
         return;
@@ -180,36 +213,69 @@ void replica::on_client_read(dsn::message_ex *request, bool ignore_throttling)
     CHECK_REQUEST_IF_SPLITTING(read)
 
     if (status() == partition_status::PS_INACTIVE ||
-        status() == partition_status::PS_POTENTIAL_SECONDARY) {
+        (status() == partition_status::PS_POTENTIAL_SECONDARY && !is_serving_read_replica())) {
         response_client_read(request, ERR_INVALID_STATE);
         return;
     }
 
+    _read_hotkey_detector.record(request->header->client.partition_hash);
+
     if (!ignore_throttling && throttle_read_request(request)) {
         return;
     }
 
     if (!request->is_backup_request()) {
-        // only backup request is allowed to read from a stale replica
+        // only backup request is allowed to read from a stale replica, or a secondary within
+        // the staleness bound of the request
 
         if (status() != partition_status::PS_PRIMARY) {
-            response_client_read(request, ERR_INVALID_STATE);
-            return;
-        }
+            if (!is_read_staleness_allowed(request)) {
+                response_client_read(request, ERR_INVALID_STATE);
+                return;
+            }
+        } else {
+            // a small window where the state is not the latest yet
+            if (last_committed_decree() < _primary_states.last_prepare_decree_on_new_primary) {
+                derror_replica("last_committed_decree(%" PRId64
+                               ") < last_prepare_decree_on_new_primary(%" PRId64 ")",
+                               last_committed_decree(),
+                               _primary_states.last_prepare_decree_on_new_primary);
+                response_client_read(request, ERR_INVALID_STATE);
+                return;
+            }
 
-        // a small window where the state is not the latest yet
-        if (last_committed_decree() < _primary_states.last_prepare_decree_on_new_primary) {
-            derror_replica("last_committed_decree(%" PRId64
-                           ") < last_prepare_decree_on_new_primary(%" PRId64 ")",
-                           last_committed_decree(),
-                           _primary_states.last_prepare_decree_on_new_primary);
-            response_client_read(request, ERR_INVALID_STATE);
-            return;
+            if (primary_read_lease::enabled() &&
+                !_primary_states.read_lease.is_valid(_primary_states.membership.secondaries,
+                                                     dsn_now_ms())) {
+                _counter_recent_read_lease_reject_count.increment();
+                response_client_read(request, ERR_INVALID_STATE);
+                return;
+            }
         }
     } else {
         _counter_backup_request_qps->increment();
     }
 
+    if (FLAGS_read_isolation_enabled) {
+        // the checks above are cheap, only the execution is moved off the shared workers
+        tasking::enqueue(LPC_REPLICATION_CLIENT_READ,
+                         &_tracker,
+                         [ this, req = message_ptr(request) ]() { execute_client_read(req); },
+                         read_isolation_hash());
+        return;
+    }
+    execute_client_read(request);
+}
+
+int replica::read_isolation_hash() const
+{
+    // the replicas of a data dir share its own group of workers in the partitioned pool
+    int workers_per_dir = static_cast<int>(FLAGS_read_isolation_workers_per_dir);
+    return _dir_node_index * workers_per_dir + get_gpid().thread_hash() % workers_per_dir;
+}
+
+void replica::execute_client_read(dsn::message_ex *request)
+{
     uint64_t start_time_ns = dsn_now_ns();
     dassert(_app != nullptr, "");
     _app->on_request(request);
@@ -221,6 +287,34 @@ void replica::on_client_read(dsn::message_ex *request, bool ignore_throttling)
     }
 }
 
+bool replica::is_read_staleness_allowed(dsn::message_ex *request)
+{
+    uint16_t bound = request->read_staleness_bound();
+    if (bound == 0 || (status() != partition_status::PS_SECONDARY && !is_serving_read_replica())) {
+        return false;
+    }
+
+    // the reads are served by the app, which may fall behind the prepare list
+    decree local_committed = _app->last_committed_decree();
+    read_staleness_tracker &tracker = _secondary_states.read_staleness;
+    bool allowed = request->is_read_staleness_in_ms()
+                       ? tracker.within_ms(local_committed, bound, dsn_now_ms())
+                       : tracker.within_decrees(local_committed, bound);
+    if (allowed) {
+        _counter_bounded_staleness_read_qps->increment();
+    } else {
+        _counter_recent_read_staleness_reject_count.increment();
+    }
+    return allowed;
+}
+
+bool replica::is_serving_read_replica() const
+{
+    return status() == partition_status::PS_POTENTIAL_SECONDARY &&
+           _potential_secondary_states.non_voting &&
+           _potential_secondary_states.learning_status == learner_status::LearningSucceeded;
+}
+
 void replica::response_client_read(dsn::message_ex *request, error_code error)
 {
     _stub->response_client(get_gpid(), true, request, status(), error);
@@ -338,7 +432,7 @@ void replica::execute_mutation(mutation_ptr &mu)
     }
 
     if (status() == partition_status::PS_PRIMARY) {
-        ADD_CUSTOM_POINT(mu->tracer, "completed");
+        on_primary_mutation_executed(mu);
         mutation_ptr next = _primary_states.write_queue.check_possible_work(
             static_cast<int>(_prepare_list->max_decree() - d));
 
@@ -346,23 +440,95 @@ void replica::execute_mutation(mutation_ptr &mu)
             init_prepare(next, false);
         }
     }
+}
+
+void replica::execute_mutations(std::vector<mutation_ptr> &mus)
+{
+    // only the primary and the secondary out of checkpointing are sure to apply every mutation,
+    // the other states decide mutation by mutation
+    bool batched =
+        status() == partition_status::PS_PRIMARY ||
+        (status() == partition_status::PS_SECONDARY && !_secondary_states.checkpoint_is_running);
+    if (!batched || mus.size() == 1) {
+        for (mutation_ptr &mu : mus) {
+            execute_mutation(mu);
+        }
+        return;
+    }
+
+    bool is_primary = status() == partition_status::PS_PRIMARY;
+    if (is_primary) {
+        for (const mutation_ptr &mu : mus) {
+            ADD_POINT(mu->tracer);
+        }
+    }
+    check_state_completeness();
+    dassert(_app->last_committed_decree() + 1 == mus.front()->data.header.decree,
+            "app commit: %" PRId64 ", mutation decree: %" PRId64 "",
+            _app->last_committed_decree(),
+            mus.front()->data.header.decree);
+
+    size_t applied = 0;
+    error_code err = _app->apply_mutations(mus, applied);
+
+    dinfo("TwoPhaseCommit, %s: mutations [%" PRId64 ", %" PRId64 "] committed, applied = %d, "
+          "err = %s",
+          name(),
+          mus.front()->data.header.decree,
+          mus.back()->data.header.decree,
+          static_cast<int>(applied),
+          err.to_string());
+
+    if (err != ERR_OK) {
+        handle_local_failure(err);
+    }
+
+    if (status() == partition_status::PS_PRIMARY) {
+        for (mutation_ptr &mu : mus) {
+            on_primary_mutation_executed(mu);
+        }
+
+        // the committed range may free more than one slot of the write queue
+        decree d = mus.back()->data.header.decree;
+        mutation_ptr next;
+        while (status() == partition_status::PS_PRIMARY &&
+               (next = _primary_states.write_queue.check_possible_work(
+                    static_cast<int>(_prepare_list->max_decree() - d))) != nullptr) {
+            init_prepare(next, false);
+        }
+    }
+}
+
+void replica::on_primary_mutation_executed(mutation_ptr &mu)
+{
+    ADD_CUSTOM_POINT(mu->tracer, "completed");
+    if (prepare_window_controller::enabled() && mu->prepare_ts_us() > 0) {
+        update_prepare_window(dsn_now_us() - mu->prepare_ts_us());
+    }
 
     // update table level latency perf-counters for primary partition
-    if (partition_status::PS_PRIMARY == status()) {
-        uint64_t now_ns = dsn_now_ns();
-        for (auto update : mu->data.updates) {
-            // If the corresponding perf counter exist, count the duration of this operation.
-            // code in update will always be legal
-            if (_counters_table_level_latency[update.code] != nullptr) {
-                _counters_table_level_latency[update.code]->set(now_ns - update.start_time_ns);
-            }
+    uint64_t now_ns = dsn_now_ns();
+    for (auto update : mu->data.updates) {
+        // If the corresponding perf counter exist, count the duration of this operation.
+        // code in update will always be legal
+        if (_counters_table_level_latency[update.code] != nullptr) {
+            _counters_table_level_latency[update.code]->set(now_ns - update.start_time_ns);
         }
     }
 }
 
+void replica::update_prepare_window(uint64_t latency_us)
+{
+    prepare_window_controller &ctrl = _primary_states.prepare_window;
+    ctrl.on_committed(latency_us, _primary_states.write_queue.has_pending_work());
+    _primary_states.write_queue.set_max_concurrent_op(ctrl.window());
+    _primary_states.write_queue.set_max_batch_bytes(ctrl.batch_bytes());
+    _counter_prepare_window_size.set(ctrl.window());
+}
+
 mutation_ptr replica::new_mutation(decree decree)
 {
-    mutation_ptr mu(new mutation());
+    mutation_ptr mu(_mutation_pool->create());
     mu->data.header.pid = get_gpid();
     mu->data.header.ballot = get_ballot();
     mu->data.header.decree = decree;
@@ -389,9 +555,59 @@ decree replica::last_prepared_decree() const
     return start;
 }
 
+mutation_log_ptr replica::shared_log() const
+{
+    return _disk_shared_log != nullptr ? _disk_shared_log : _stub->_log;
+}
+
+decree replica::shared_log_replay_decree() const
+{
+    // the private log holds everything since the last checkpoint, so the mutations before its
+    // max decree needn't be replayed from the shared log any more
+    return _plog_complete_decree != invalid_decree ? _plog_complete_decree
+                                                   : last_committed_decree();
+}
+
+void replica::store_shutdown_snapshot()
+{
+    if (_app == nullptr || _private_log == nullptr) {
+        return;
+    }
+
+    // a snapshot is only valid when the private log is durable and the app has nothing to
+    // replay from it, so the next open finds decree `committed_decree` checkpointed
+    _private_log->flush();
+    error_code err = background_sync_checkpoint();
+    if (err != ERR_OK) {
+        dwarn_replica("skip storing shutdown snapshot since sync checkpoint failed, err = {}",
+                      err);
+        return;
+    }
+
+    replica_shutdown_snapshot snapshot;
+    snapshot.ballot = get_ballot();
+    snapshot.committed_decree = _app->last_durable_decree();
+    snapshot.plog_max_decree = _private_log->max_decree(get_gpid());
+    uint64_t last_access_ms =
+        std::max(_resource_usage.last_access_ms(), create_time_milliseconds());
+    uint64_t now_ms = dsn_now_ms();
+    snapshot.idle_ms = now_ms > last_access_ms ? now_ms - last_access_ms : 0;
+    err = snapshot.store(dir());
+    if (err != ERR_OK) {
+        dwarn_replica("store shutdown snapshot failed, err = {}", err);
+        return;
+    }
+    ddebug_replica("store shutdown snapshot succeed: ballot = {}, committed = {}, plog_max = {}, "
+                   "idle_ms = {}",
+                   snapshot.ballot,
+                   snapshot.committed_decree,
+                   snapshot.plog_max_decree,
+                   snapshot.idle_ms);
+}
+
 bool replica::verbose_commit_log() const { return _stub->_verbose_commit_log; }
 
-void replica::close()
+void replica::close(bool clean_shutdown)
 {
     dassert_replica(status() == partition_status::PS_ERROR ||
                         status() == partition_status::PS_INACTIVE ||
@@ -436,6 +652,10 @@ void replica::close()
         dassert_replica(r, "partition split context is not cleared");
     }
 
+    if (clean_shutdown) {
+        store_shutdown_snapshot();
+    }
+
     if (_private_log != nullptr) {
         _private_log->close();
         _private_log = nullptr;
@@ -456,8 +676,6 @@ void replica::close()
         _disk_migrator.reset();
     }
 
-    _counter_private_log_size.clear();
-
     // duplication_impl may have ongoing tasks.
     // release it before release replica.
     _duplication_mgr.reset();
@@ -545,7 +763,43 @@ void replica::init_table_level_latency_counters()
 
 void replica::on_detect_hotkey(const detect_hotkey_request &req, detect_hotkey_response &resp)
 {
-    _app->on_detect_hotkey(req, resp);
+    if (!hotkey_detector::enabled()) {
+        _app->on_detect_hotkey(req, resp);
+        return;
+    }
+
+    hotkey_detector &detector =
+        req.type == hotkey_type::READ ? _read_hotkey_detector : _write_hotkey_detector;
+    switch (req.action) {
+    case detect_action::START:
+        if (detector.start()) {
+            resp.err = ERR_OK;
+        } else {
+            resp.err = ERR_SERVICE_ALREADY_EXIST;
+            resp.__set_err_hint("hotkey detection is running now");
+        }
+        break;
+    case detect_action::STOP:
+        detector.stop();
+        resp.err = ERR_OK;
+        break;
+    case detect_action::QUERY:
+        if (detector.running()) {
+            resp.err = ERR_OK;
+            resp.__set_hotkey_result(detector.dump());
+        } else {
+            resp.err = ERR_INVALID_STATE;
+            resp.__set_err_hint("hotkey detection is not running");
+        }
+        break;
+    default:
+        resp.err = ERR_INVALID_PARAMETERS;
+        break;
+    }
+    ddebug_replica("{} {} hotkey detection: {}",
+                   enum_to_string(req.action),
+                   enum_to_string(req.type),
+                   resp.err.to_string());
 }
 
 uint32_t replica::query_data_version() const
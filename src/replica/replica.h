@@ -46,15 +46,21 @@
 #include <dsn/tool-api/thread_access_checker.h>
 #include <dsn/cpp/serverlet.h>
 
+#include <dsn/perf_counter/perf_counter_block.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/dist/replication/replica_base.h>
 
 #include "common/replication_common.h"
 #include "mutation.h"
 #include "mutation_log.h"
+#include "mutation_pool.h"
 #include "prepare_list.h"
 #include "replica_context.h"
 #include "utils/throttling_controller.h"
+#include "partition_quota_controller.h"
+#include "hotkey_detector.h"
+#include "replica_resource_usage.h"
+#include "cold_tier_cache.h"
 
 namespace dsn {
 namespace security {
@@ -109,7 +115,15 @@ public:
     //    routines for replica stub
     //
     static replica *load(replica_stub *stub, const char *dir);
+    // Describe the replica under `dir` by its metadata and shutdown snapshot without opening it,
+    // if it had been idle for at least `idle_threshold_ms` before the last clean shutdown.
+    // Return false if it is not such a cold replica, and it should be loaded as usual.
+    static bool load_cold(const char *dir,
+                          uint64_t idle_threshold_ms,
+                          /*out*/ app_info &app,
+                          /*out*/ replica_info &info);
     // {parent_dir} is used in partition split for get_child_dir in replica_stub
+    static bool load_app_info(const char *dir, /*out*/ gpid &pid, /*out*/ app_info &info);
     static replica *newr(replica_stub *stub,
                          gpid gpid,
                          const app_info &app,
@@ -126,8 +140,13 @@ public:
     void check_state_completeness();
     // error_code check_and_fix_private_log_completeness();
 
-    // close() will wait all traced tasks to finish
-    void close();
+    // close() will wait all traced tasks to finish.
+    // `clean_shutdown` persists a replica_shutdown_snapshot before the logs are closed, so that
+    // the next open can skip replaying the shared log for this replica.
+    void close(bool clean_shutdown = false);
+
+    // the decree up to which the shared log needn't be replayed after this replica is loaded
+    decree shared_log_replay_decree() const;
 
     //
     //    requests from clients
@@ -185,6 +204,9 @@ public:
     uint64_t create_time_milliseconds() const { return _create_time_ms; }
     const char *name() const { return replica_name(); }
     mutation_log_ptr private_log() const { return _private_log; }
+    // the shared log of the server, or the one of the replica's disk when
+    // [replication] slog_per_disk_enabled
+    mutation_log_ptr shared_log() const;
     const replication_options *options() const { return _options; }
     replica_stub *get_replica_stub() { return _stub; }
     bool verbose_commit_log() const;
@@ -196,6 +218,12 @@ public:
     replica_duplicator_manager *get_duplication_manager() const { return _duplication_mgr.get(); }
     bool is_duplicating() const { return _duplicating; }
 
+    //
+    // Cold tier
+    //
+    // nullptr unless the partition was restored in the cold-tier mode
+    cold_tier_cache *get_cold_tier_cache() const { return _cold_tier_cache.get(); }
+
     //
     // Backup
     //
@@ -203,6 +231,9 @@ public:
 
     void update_last_checkpoint_generate_time();
 
+    replica_resource_usage &resource_usage() { return _resource_usage; }
+    const replica_resource_usage &resource_usage() const { return _resource_usage; }
+
     //
     // Bulk load
     //
@@ -240,9 +271,23 @@ private:
     // common helpers
     void init_state();
     void response_client_read(dsn::message_ex *request, error_code error);
+    // whether a secondary serves the read within the staleness bound of the request
+    bool is_read_staleness_allowed(dsn::message_ex *request);
+    // whether this is a read replica which has learned successfully
+    bool is_serving_read_replica() const;
+    // run the read on the app, which is done on THREAD_POOL_REPLICATION_READ when
+    // [replication] read_isolation_enabled, see read_isolation_hash()
+    void execute_client_read(dsn::message_ex *request);
+    int read_isolation_hash() const;
     void response_client_write(dsn::message_ex *request, error_code error);
     void execute_mutation(mutation_ptr &mu);
+    // execute a contiguous range of committed mutations, see prepare_list_batch_commit
+    void execute_mutations(std::vector<mutation_ptr> &mus);
+    // the per-mutation bookkeeping of primary after a mutation is executed
+    void on_primary_mutation_executed(mutation_ptr &mu);
     mutation_ptr new_mutation(decree decree);
+    // feeds the 2pc latency of a committed mutation to the prepare window of primary
+    void update_prepare_window(uint64_t latency_us);
 
     // initialization
     replica(replica_stub *stub, gpid gpid, const app_info &app, const char *dir, bool need_restore);
@@ -262,14 +307,33 @@ private:
                               const mutation_ptr &mu,
                               int timeout_milliseconds,
                               bool pop_all_committed_mutations = false,
-                              int64_t learn_signature = invalid_signature);
+                              int64_t learn_signature = invalid_signature,
+                              const std::vector<blob> *mutation_buffers = nullptr);
     void on_append_log_completed(mutation_ptr &mu, error_code err, size_t size);
     void on_prepare_reply(std::pair<mutation_ptr, partition_status::type> pr,
                           error_code err,
                           dsn::message_ex *request,
                           dsn::message_ex *reply);
+    void on_read_replica_prepare_reply(const mutation_ptr &mu,
+                                       error_code err,
+                                       dsn::message_ex *request,
+                                       dsn::message_ex *reply);
     void do_possible_commit_on_primary(mutation_ptr &mu);
-    void ack_prepare_message(error_code err, mutation_ptr &mu);
+    void ack_prepare_message(error_code err,
+                             mutation_ptr &mu,
+                             decree last_logged_decree = invalid_decree);
+    // with [replication] prepare_ack_batched, the logged prepares of a secondary are acked
+    // once the replication thread is done with the log callbacks queued, by one cumulative ack
+    void batch_prepare_ack(mutation_ptr &mu);
+    void flush_prepare_acks();
+    // count the cumulative ack of `node` for the prepares up to `last_logged_decree`
+    void on_cumulative_prepare_ack(const rpc_address &node, decree last_logged_decree);
+    // whether the timed out prepare of `mu` to `node` may still be acked by a cumulative ack,
+    // as a later prepare to `node` is still waiting for the reply
+    bool is_cumulative_prepare_ack_expected(const mutation_ptr &mu, const rpc_address &node);
+    // forget the timed out prepares to `node` passed by `ack`, returns false if one of them
+    // is never to be acked
+    bool check_timed_out_prepares(const rpc_address &node, const prepare_ack &ack);
     void cleanup_preparing_mutations(bool wait);
 
     /////////////////////////////////////////////////////////////////
@@ -288,6 +352,21 @@ private:
     void notify_learn_completion();
     error_code apply_learned_state_from_private_log(learn_state &state);
 
+    // Attaches the private logs following the checkpoint of a LT_APP response, so that the
+    // learner copies them along with the checkpoint rather than in a later LT_LOG round.
+    void attach_private_logs_to_checkpoint(const learn_request &request,
+                                           /*out*/ learn_response &response);
+    // Leaves out the checkpoint files of a LT_APP response that the learner already has
+    // locally, see learn_request.checkpoint_files.
+    void reuse_learner_checkpoint_files(const learn_request &request,
+                                        /*out*/ learn_response &response);
+    // Links the reused checkpoint files into learn_dir(), those failed to link are moved
+    // back to the files to copy.
+    void link_reused_checkpoint_files(const learn_request &req, /*inout*/ learn_response &resp);
+    // Applies the private logs copied along with the checkpoint onto the just applied one.
+    error_code apply_learned_logs_of_checkpoint(const learn_request &req,
+                                                const learn_response &resp);
+
     // Prepares in-memory mutations for the replica's learning.
     // Returns false if there's no delta data in cache (aka prepare-list).
     bool prepare_cached_learn_state(const learn_request &request,
@@ -320,6 +399,7 @@ private:
     // reconfiguration
     void assign_primary(configuration_update_request &proposal);
     void add_potential_secondary(configuration_update_request &proposal);
+    void update_read_replicas(const configuration_update_request &proposal);
     void upgrade_to_secondary_on_primary(::dsn::rpc_address node);
     void downgrade_to_secondary_on_primary(configuration_update_request &proposal);
     void downgrade_to_inactive_on_primary(configuration_update_request &proposal);
@@ -348,7 +428,8 @@ private:
     // group check
     void init_group_check();
     void broadcast_group_check();
-    void on_group_check_reply(error_code err,
+    void on_group_check_reply(uint64_t send_ts_ms,
+                              error_code err,
                               const std::shared_ptr<group_check_request> &req,
                               const std::shared_ptr<group_check_response> &resp);
 
@@ -357,7 +438,9 @@ private:
     void on_checkpoint_timer();
     void init_checkpoint(bool is_emergency);
     error_code background_async_checkpoint(bool is_emergency);
+    error_code background_write_checkpoint_snapshot(std::shared_ptr<checkpoint_snapshot> snapshot);
     error_code background_sync_checkpoint();
+    void store_shutdown_snapshot();
     void catch_up_with_private_logs(partition_status::type s);
     void on_checkpoint_completed(error_code err);
     void on_copy_checkpoint_ack(error_code err,
@@ -368,6 +451,21 @@ private:
                                            std::shared_ptr<learn_response> resp,
                                            const std::string &chk_dir);
 
+    /////////////////////////////////////////////////////////////////
+    // background tasks coordinated by the meta server, see background_task_scheduler
+    // return true if the task can run now, otherwise a grant is asked for if it's not being
+    // asked, and `on_granted` is called in the replication thread once it's granted
+    bool acquire_background_task(background_task_type::type type,
+                                 std::function<void()> on_granted);
+    // release the grant of the task if it's granted, called when the task is done
+    void release_background_task(background_task_type::type type);
+    // return true if the manual compaction trigger in `envs` is held back before it's granted,
+    // and `held_envs` is `envs` without the trigger
+    bool hold_manual_compaction_env(const std::map<std::string, std::string> &envs,
+                                    /*out*/ std::map<std::string, std::string> &held_envs);
+    // called by the checkpoint timer
+    void release_manual_compaction_if_done();
+
     /////////////////////////////////////////////////////////////////
     // cold backup
     virtual void generate_backup_checkpoint(cold_backup_context_ptr backup_context);
@@ -392,12 +490,22 @@ private:
                                    const std::string &remote_chkpt_dir,
                                    const std::string &local_chkpt_dir,
                                    cold_backup_metadata &backup_metadata);
+    // download one file of the checkpoint to restore and verify it
+    error_code download_restore_file(dist::block_service::block_filesystem *fs,
+                                     const std::string &remote_dir,
+                                     const std::string &local_chkpt_dir,
+                                     const file_meta &f_meta);
     error_code download_checkpoint(const configuration_restore_request &req,
                                    const std::string &remote_chkpt_dir,
                                    const std::string &local_chkpt_dir);
     dsn::error_code find_valid_checkpoint(const configuration_restore_request &req,
                                           /*out*/ std::string &remote_chkpt_dir);
     dsn::error_code restore_checkpoint();
+    // whether the partition is restored in the cold-tier mode,
+    // see backup_restore_constant::COLD_TIER_CACHE_MB
+    bool get_cold_tier_cache_capacity(/*out*/ int64_t &capacity_bytes) const;
+    // load the cold tier cache if the partition was restored in the cold-tier mode
+    error_code init_cold_tier_cache();
 
     dsn::error_code skip_restore_partition(const std::string &restore_dir);
     void tell_meta_to_restore_rollback();
@@ -427,6 +535,14 @@ private:
     /// return true if request is throttled.
     bool throttle_write_request(message_ex *request);
     bool throttle_read_request(message_ex *request);
+    /// return true if the write is rejected by the backpressure of the primary.
+    /// \see replication_admission_controller
+    bool reject_write_by_backpressure(message_ex *request);
+    /// return true if the write is rejected as the mutations of the node are over their memory
+    /// budget, otherwise charge the mutations to the budget.
+    /// \see replica_memory_budget
+    bool reject_write_by_memory_budget(message_ex *request);
+    void charge_mutation_memory(const mutation_ptr &mu);
     /// update throttling controllers
     /// \see replica::update_app_envs
     void update_throttle_envs(const std::map<std::string, std::string> &envs);
@@ -466,10 +582,28 @@ private:
     uint64_t _last_config_change_time_ms;
     uint64_t _last_checkpoint_generate_time_ms;
     uint64_t _next_checkpoint_interval_trigger_time_ms;
+    // a snapshot taken by init_checkpoint() is being written in background
+    std::atomic<bool> _checkpoint_snapshot_writing{false};
+    // the states of the background tasks coordinated by the meta server, indexed by
+    // background_task_type, see acquire_background_task()
+    enum background_task_state
+    {
+        BTS_IDLE = 0,
+        BTS_ACQUIRING,
+        BTS_GRANTED
+    };
+    std::atomic<int> _background_task_states[3]{};
+    // the manual compaction trigger passed to the app last time, and whether it's passed under
+    // the current grant
+    std::string _last_manual_compact_trigger;
+    bool _manual_compaction_triggered{false};
 
     // prepare list
     prepare_list *_prepare_list;
 
+    // the mutations of this replica are allocated from it
+    mutation_pool_ptr _mutation_pool;
+
     // private prepare log (may be empty, depending on config)
     mutation_log_ptr _private_log;
 
@@ -482,6 +616,11 @@ private:
     // constants
     replica_stub *_stub;
     std::string _dir;
+    // the index of the data dir in the fs_manager, 0 if not found
+    int _dir_node_index;
+    // the shared log of the disk holding the replica with [replication] slog_per_disk_enabled,
+    // resolved on construction and updated once the replica is migrated to another disk
+    mutation_log_ptr _disk_shared_log;
     replication_options *_options;
     app_info _app_info;
     std::map<std::string, std::string> _extra_envs;
@@ -530,6 +669,18 @@ private:
     throttling_controller _write_qps_throttling_controller;  // throttling by requests-per-second
     throttling_controller _write_size_throttling_controller; // throttling by bytes-per-second
     throttling_controller _read_qps_throttling_controller;
+    // the share of the table quotas assigned by meta server
+    partition_quota_controller _quota_controller;
+
+    // the builtin hot key detection, by the partition hashes of the client requests
+    hotkey_detector _read_hotkey_detector;
+    hotkey_detector _write_hotkey_detector;
+
+    replica_resource_usage _resource_usage;
+
+    // the max decree of the private log if it was flushed by a clean shutdown and fully
+    // replayed on open, invalid_decree otherwise
+    decree _plog_complete_decree{invalid_decree};
 
     // duplication
     std::unique_ptr<replica_duplicator_manager> _duplication_mgr;
@@ -551,15 +702,28 @@ private:
     // disk migrator
     std::unique_ptr<replica_disk_migrator> _disk_migrator;
 
+    std::unique_ptr<cold_tier_cache> _cold_tier_cache;
+
+    // read lease, the last time this replica granted the primary a read lease as secondary or
+    // learner
+    uint64_t _last_read_lease_grant_ms{0};
+
     // perf counters
-    perf_counter_wrapper _counter_private_log_size;
-    perf_counter_wrapper _counter_recent_write_throttling_delay_count;
-    perf_counter_wrapper _counter_recent_write_throttling_reject_count;
-    perf_counter_wrapper _counter_recent_read_throttling_delay_count;
-    perf_counter_wrapper _counter_recent_read_throttling_reject_count;
+    // the per-partition counters "<name>@<gpid>", which are created on their first update
+    std::unique_ptr<perf_counter_block> _counter_block;
+    lazy_perf_counter _counter_private_log_size;
+    lazy_perf_counter _counter_recent_write_throttling_delay_count;
+    lazy_perf_counter _counter_recent_write_throttling_reject_count;
+    lazy_perf_counter _counter_recent_read_throttling_delay_count;
+    lazy_perf_counter _counter_recent_read_throttling_reject_count;
     std::vector<perf_counter *> _counters_table_level_latency;
     perf_counter_wrapper _counter_dup_disabled_non_idempotent_write_count;
     perf_counter_wrapper _counter_backup_request_qps;
+    lazy_perf_counter _counter_prepare_window_size;
+    lazy_perf_counter _counter_recent_write_admission_reject_count;
+    lazy_perf_counter _counter_recent_read_lease_reject_count;
+    perf_counter_wrapper _counter_bounded_staleness_read_qps;
+    lazy_perf_counter _counter_recent_read_staleness_reject_count;
 
     dsn::task_tracker _tracker;
     // the thread access checker
@@ -34,13 +34,23 @@
 #include <dsn/utils/latency_tracer.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                prepare_ack_batched,
+                false,
+                "whether a secondary acks the prepares logged together with one cumulative ack, "
+                "only enable it after all the replica servers are upgraded to support it");
+DSN_TAG_VARIABLE(prepare_ack_batched, FT_MUTABLE);
+
 void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
 {
     _checker.only_one_thread_access();
+    _resource_usage.on_rpc_in(request->body_size());
+    _resource_usage.on_access(dsn_now_ms());
 
     if (!_access_controller->allowed(request)) {
         response_client_write(request, ERR_ACL_DENY);
@@ -85,15 +95,25 @@ void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
         return;
     }
 
+    // the previous primary may still serve reads under the lease granted by this replica
+    if (primary_read_lease::enabled() && _primary_states.read_lease.is_waiting(dsn_now_ms())) {
+        response_client_write(request, ERR_INVALID_STATE);
+        return;
+    }
+
     if (_is_bulk_load_ingestion) {
-        if (request->rpc_code() != dsn::apps::RPC_RRDB_RRDB_BULK_LOAD) {
+        if (request->rpc_code() == dsn::apps::RPC_RRDB_RRDB_BULK_LOAD) {
+            response_client_write(request, ERR_NO_NEED_OPERATE);
+            return;
+        }
+        // the app ingests in the background on a non-blocking ingestion, while the writes after
+        // the ingestion mutation keep flowing
+        if (!_bulk_loader->is_non_blocking_ingestion()) {
             // reject write requests during ingestion
             _stub->_counter_bulk_load_ingestion_reject_write_count->increment();
             response_client_write(request, ERR_OPERATION_DISABLED);
-        } else {
-            response_client_write(request, ERR_NO_NEED_OPERATE);
+            return;
         }
-        return;
     }
 
     if (request->rpc_code() == dsn::apps::RPC_RRDB_RRDB_BULK_LOAD) {
@@ -123,10 +143,20 @@ void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
         return;
     }
 
+    _write_hotkey_detector.record(request->header->client.partition_hash);
+
     if (!ignore_throttling && throttle_write_request(request)) {
         return;
     }
 
+    if (replication_admission_controller::enabled() && reject_write_by_backpressure(request)) {
+        return;
+    }
+
+    if (replica_memory_budget::enabled() && reject_write_by_memory_budget(request)) {
+        return;
+    }
+
     dinfo("%s: got write request from %s", name(), request->header->from_address.to_string());
     auto mu = _primary_states.write_queue.add_work(request->rpc_code(), request, this);
     if (mu) {
@@ -144,6 +174,7 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
 
     error_code err = ERR_OK;
     uint8_t count = 0;
+    std::vector<blob> mutation_buffers;
     const auto request_count = mu->client_requests.size();
     mu->data.header.last_committed_decree = last_committed_decree();
 
@@ -207,13 +238,17 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
             last_committed_decree());
 
     // local prepare
+    charge_mutation_memory(mu);
     err = _prepare_list->prepare(mu, partition_status::PS_PRIMARY, pop_all_committed_mutations);
     if (err != ERR_OK) {
         goto ErrOut;
     }
 
     // remote prepare
+    // the mutation is serialized only once, and the prepare messages to all the members reference
+    // the same immutable buffers instead of copying the update data into each of them
     mu->set_prepare_ts();
+    mu->write_to([&mutation_buffers](const blob &bb) { mutation_buffers.push_back(bb); });
     mu->set_left_secondary_ack_count((unsigned int)_primary_states.membership.secondaries.size());
     for (auto it = _primary_states.membership.secondaries.begin();
          it != _primary_states.membership.secondaries.end();
@@ -222,7 +257,9 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
                              partition_status::PS_SECONDARY,
                              mu,
                              _options->prepare_timeout_ms_for_secondaries,
-                             pop_all_committed_mutations);
+                             pop_all_committed_mutations,
+                             invalid_signature,
+                             &mutation_buffers);
     }
 
     count = 0;
@@ -234,8 +271,12 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
                                  mu,
                                  _options->prepare_timeout_ms_for_potential_secondaries,
                                  pop_all_committed_mutations,
-                                 it->second.signature);
-            count++;
+                                 it->second.signature,
+                                 &mutation_buffers);
+            // the read replicas are fed asynchronously, the commit never waits for them
+            if (!it->second.non_voting) {
+                count++;
+            }
         }
     }
     mu->set_left_potential_secondary_ack_count(count);
@@ -252,16 +293,16 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
                 mu->data.header.log_offset);
         dassert(mu->log_task() == nullptr, "");
         int64_t pending_size;
-        mu->log_task() = _stub->_log->append(mu,
-                                             LPC_WRITE_REPLICATION_LOG,
-                                             &_tracker,
-                                             std::bind(&replica::on_append_log_completed,
-                                                       this,
-                                                       mu,
-                                                       std::placeholders::_1,
-                                                       std::placeholders::_2),
-                                             get_gpid().thread_hash(),
-                                             &pending_size);
+        mu->log_task() = shared_log()->append(mu,
+                                              LPC_WRITE_REPLICATION_LOG,
+                                              &_tracker,
+                                              std::bind(&replica::on_append_log_completed,
+                                                        this,
+                                                        mu,
+                                                        std::placeholders::_1,
+                                                        std::placeholders::_2),
+                                              get_gpid().thread_hash(),
+                                              &pending_size);
         dassert(nullptr != mu->log_task(), "");
         if (_options->log_shared_pending_size_throttling_threshold_kb > 0 &&
             _options->log_shared_pending_size_throttling_delay_ms > 0 &&
@@ -294,7 +335,8 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
                                    const mutation_ptr &mu,
                                    int timeout_milliseconds,
                                    bool pop_all_committed_mutations,
-                                   int64_t learn_signature)
+                                   int64_t learn_signature,
+                                   const std::vector<blob> *mutation_buffers)
 {
     ADD_CUSTOM_POINT(mu->tracer, addr.to_string());
     dsn::message_ex *msg = dsn::message_ex::create_request(
@@ -305,20 +347,45 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
     if (status == partition_status::PS_SECONDARY && _primary_states.sync_send_write_request) {
         rconfig.__set_split_sync_to_child(true);
     }
+    if (status == partition_status::PS_POTENTIAL_SECONDARY &&
+        _primary_states.is_read_replica(addr)) {
+        rconfig.__set_non_voting(true);
+    }
 
     {
         rpc_write_stream writer(msg);
         marshall(writer, get_gpid(), DSF_THRIFT_BINARY);
         marshall(writer, rconfig, DSF_THRIFT_BINARY);
-        mu->write_to(writer, msg);
     }
 
+    // append the serialized mutation after the committed header, which keeps the same layout as
+    // mutation::write_to(binary_writer&) so that the receiver is unaware of it
+    std::vector<blob> local_buffers;
+    if (mutation_buffers == nullptr) {
+        mu->write_to([&local_buffers](const blob &bb) { local_buffers.push_back(bb); });
+        mutation_buffers = &local_buffers;
+    }
+    for (const blob &bb : *mutation_buffers) {
+        if (bb.length() > 0) {
+            msg->write_append(bb);
+        }
+    }
+    _resource_usage.on_rpc_out(msg->body_size());
+
+    // the prepare may be sent out of the task which creates the mutation, so the trace of the
+    // mutation is set explicitly
+    dsn::utils::trace_context_scope trace_scope(mu->tracer->context());
     mu->remote_tasks()[addr] =
         rpc::call(addr,
                   msg,
                   &_tracker,
                   [=](error_code err, dsn::message_ex *request, dsn::message_ex *reply) {
-                      on_prepare_reply(std::make_pair(mu, rconfig.status), err, request, reply);
+                      if (rconfig.non_voting) {
+                          on_read_replica_prepare_reply(mu, err, request, reply);
+                      } else {
+                          on_prepare_reply(
+                              std::make_pair(mu, rconfig.status), err, request, reply);
+                      }
                   },
                   get_gpid().thread_hash());
 
@@ -348,6 +415,8 @@ void replica::do_possible_commit_on_primary(mutation_ptr &mu)
 void replica::on_prepare(dsn::message_ex *request)
 {
     _checker.only_one_thread_access();
+    _resource_usage.on_rpc_in(request->body_size());
+    _resource_usage.on_access(dsn_now_ms());
 
     replica_configuration rconfig;
     mutation_ptr mu;
@@ -355,7 +424,7 @@ void replica::on_prepare(dsn::message_ex *request)
     {
         rpc_read_stream reader(request);
         unmarshall(reader, rconfig, DSF_THRIFT_BINARY);
-        mu = mutation::read_from(reader, request);
+        mu = mutation::read_from(reader, request, _mutation_pool.get());
         mu->set_is_sync_to_child(rconfig.split_sync_to_child);
         rconfig.split_sync_to_child = false;
     }
@@ -445,6 +514,10 @@ void replica::on_prepare(dsn::message_ex *request)
             "invalid status, %s VS %s",
             enum_to_string(rconfig.status),
             enum_to_string(status()));
+    if (partition_status::PS_SECONDARY == status() || rconfig.non_voting) {
+        _secondary_states.read_staleness.on_primary_committed(
+            mu->data.header.last_committed_decree, dsn_now_ms());
+    }
     if (decree <= last_committed_decree()) {
         ack_prepare_message(ERR_OK, mu);
         return;
@@ -464,6 +537,7 @@ void replica::on_prepare(dsn::message_ex *request)
         return;
     }
 
+    charge_mutation_memory(mu);
     error_code err = _prepare_list->prepare(mu, status());
     dassert(err == ERR_OK, "prepare mutation failed, err = %s", err.to_string());
 
@@ -496,15 +570,15 @@ void replica::on_prepare(dsn::message_ex *request)
     }
 
     dassert(mu->log_task() == nullptr, "");
-    mu->log_task() = _stub->_log->append(mu,
-                                         LPC_WRITE_REPLICATION_LOG,
-                                         &_tracker,
-                                         std::bind(&replica::on_append_log_completed,
-                                                   this,
-                                                   mu,
-                                                   std::placeholders::_1,
-                                                   std::placeholders::_2),
-                                         get_gpid().thread_hash());
+    mu->log_task() = shared_log()->append(mu,
+                                          LPC_WRITE_REPLICATION_LOG,
+                                          &_tracker,
+                                          std::bind(&replica::on_append_log_completed,
+                                                    this,
+                                                    mu,
+                                                    std::placeholders::_1,
+                                                    std::placeholders::_2),
+                                          get_gpid().thread_hash());
     dassert(nullptr != mu->log_task(), "");
 }
 
@@ -522,6 +596,11 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
 
     if (err == ERR_OK) {
         mu->set_logged();
+        if (replication_admission_controller::enabled() &&
+            status() == partition_status::PS_PRIMARY && mu->prepare_ts_us() > 0) {
+            _primary_states.write_admission.on_shared_log_appended(dsn_now_us() -
+                                                                   mu->prepare_ts_us());
+        }
     } else {
         derror("%s: append shared log failed for mutation %s, err = %s",
                name(),
@@ -540,6 +619,11 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
             }
             break;
         case partition_status::PS_SECONDARY:
+            if (err == ERR_OK && FLAGS_prepare_ack_batched && !_split_mgr->is_splitting()) {
+                batch_prepare_ack(mu);
+                break;
+            }
+        // fall through
         case partition_status::PS_POTENTIAL_SECONDARY:
             if (err != ERR_OK) {
                 handle_local_failure(err);
@@ -568,7 +652,14 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
 
     // write local private log if necessary
     if (err == ERR_OK && status() != partition_status::PS_ERROR) {
-        _private_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
+        int64_t pending_size = 0;
+        _private_log->append(
+            mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr, 0, &pending_size);
+        _resource_usage.on_plog_write(mu->appro_data_bytes());
+        if (replication_admission_controller::enabled() &&
+            status() == partition_status::PS_PRIMARY) {
+            _primary_states.write_admission.on_private_log_appended(pending_size);
+        }
     }
 }
 
@@ -644,12 +735,31 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
             dassert(_primary_states.check_exist(node, partition_status::PS_SECONDARY),
                     "invalid secondary node address, address = %s",
                     node.to_string());
+            // prepare_ts is not later than the send time of any retry
+            _primary_states.read_lease.renew(node, mu->prepare_ts_ms());
+            if (!check_timed_out_prepares(node, resp)) {
+                derror_replica("mutation {} is acked by {}, but the timed out prepares before it "
+                               "are not",
+                               mu->name(),
+                               node.to_string());
+                _stub->_counter_replicas_recent_prepare_fail_count->increment();
+                handle_remote_failure(st, node, ERR_TIMEOUT, "prepare");
+                break;
+            }
+            if (mu->remote_tasks().erase(node) == 0) {
+                // acked by a cumulative ack already
+                break;
+            }
             dassert(mu->left_secondary_ack_count() > 0, "%u", mu->left_secondary_ack_count());
             if (0 == mu->decrease_left_secondary_ack_count()) {
                 do_possible_commit_on_primary(mu);
             }
+            if (resp.__isset.last_logged_decree) {
+                on_cumulative_prepare_ack(node, resp.last_logged_decree);
+            }
             break;
         case partition_status::PS_POTENTIAL_SECONDARY:
+            _primary_states.read_lease.renew(node, mu->prepare_ts_ms());
             dassert(mu->left_potential_secondary_ack_count() > 0,
                     "%u",
                     mu->left_potential_secondary_ack_count());
@@ -701,10 +811,11 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
                     [this, node, target_status, mu, prepare_timeout_ms, learn_signature] {
                         // need to check status/ballot/decree before sending prepare message,
                         // because the config may have been changed or the mutation may have been
-                        // committed during the delay time.
+                        // committed or acked by a cumulative ack during the delay time.
                         if (status() == partition_status::PS_PRIMARY &&
                             get_ballot() == mu->data.header.ballot &&
-                            mu->get_decree() > last_committed_decree()) {
+                            mu->get_decree() > last_committed_decree() &&
+                            mu->remote_tasks().count(node) > 0) {
                             send_prepare_message(node,
                                                  target_status,
                                                  mu,
@@ -719,6 +830,20 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
             }
         }
 
+        // the secondary batching its acks omits the reply of a prepare covered by the
+        // cumulative ack of a later one, which may come after the rpc of this one times out
+        if (resp.err == ERR_TIMEOUT && target_status == partition_status::PS_SECONDARY &&
+            FLAGS_prepare_ack_batched && is_cumulative_prepare_ack_expected(mu, node)) {
+            dwarn_replica("mutation {} prepare to {} timed out, wait for the cumulative ack of "
+                          "the later prepares",
+                          mu->name(),
+                          node.to_string());
+            // keep the remote task so that the cumulative ack counts it
+            _primary_states.timed_out_prepares[node].insert(mu->get_decree());
+            return;
+        }
+        _primary_states.timed_out_prepares.erase(node);
+
         _stub->_counter_replicas_recent_prepare_fail_count->increment();
 
         // make sure this is before any later commit ops
@@ -738,7 +863,41 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
     }
 }
 
-void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
+void replica::on_read_replica_prepare_reply(const mutation_ptr &mu,
+                                            error_code err,
+                                            dsn::message_ex *request,
+                                            dsn::message_ex *reply)
+{
+    _checker.only_one_thread_access();
+
+    // the mutation may have been committed already, which is fine as nothing waits for the ack
+    if (partition_status::PS_PRIMARY != status() || mu->data.header.ballot < get_ballot()) {
+        return;
+    }
+
+    prepare_ack resp;
+    if (err != ERR_OK) {
+        resp.err = err;
+    } else {
+        ::dsn::unmarshall(reply, resp);
+    }
+    if (resp.err == ERR_OK) {
+        return;
+    }
+
+    // the read replica can't commit beyond the missing prepare, so it has to learn again, which
+    // starts after meta server proposes the read replicas next time
+    ::dsn::rpc_address node = request->to_address;
+    derror_replica("mutation {} on_read_replica_prepare_reply from {}, err = {}",
+                   mu->name(),
+                   node.to_string(),
+                   resp.err.to_string());
+    if (_primary_states.is_read_replica(node)) {
+        handle_remote_failure(partition_status::PS_POTENTIAL_SECONDARY, node, resp.err, "prepare");
+    }
+}
+
+void replica::ack_prepare_message(error_code err, mutation_ptr &mu, decree last_logged_decree)
 {
     ADD_CUSTOM_POINT(mu->tracer, name());
     prepare_ack resp;
@@ -746,6 +905,9 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
     resp.err = err;
     resp.ballot = get_ballot();
     resp.decree = mu->data.header.decree;
+    if (last_logged_decree != invalid_decree) {
+        resp.__set_last_logged_decree(last_logged_decree);
+    }
 
     // for partition_status::PS_POTENTIAL_SECONDARY ONLY
     resp.last_committed_decree_in_app = _app->last_committed_decree();
@@ -756,6 +918,10 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
 
     if (err == ERR_OK) {
         if (mu->is_child_acked()) {
+            if (status() == partition_status::PS_SECONDARY ||
+                status() == partition_status::PS_POTENTIAL_SECONDARY) {
+                _last_read_lease_grant_ms = dsn_now_ms();
+            }
             dinfo_replica("mutation {} ack_prepare_message, err = {}", mu->name(), err);
             for (auto &request : prepare_requests) {
                 reply(request, resp);
@@ -778,6 +944,146 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
     }
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::batch_prepare_ack(mutation_ptr &mu)
+{
+    _secondary_states.pending_prepare_acks.push_back(mu);
+    if (_secondary_states.prepare_ack_flush_scheduled) {
+        return;
+    }
+    // runs after the log callbacks queued before it
+    _secondary_states.prepare_ack_flush_scheduled = true;
+    tasking::enqueue(LPC_FLUSH_PREPARE_ACKS,
+                     &_tracker,
+                     [this]() { flush_prepare_acks(); },
+                     get_gpid().thread_hash());
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::flush_prepare_acks()
+{
+    _checker.only_one_thread_access();
+
+    _secondary_states.prepare_ack_flush_scheduled = false;
+    std::vector<mutation_ptr> acks;
+    acks.swap(_secondary_states.pending_prepare_acks);
+
+    // the prepares up to `last_logged` are all logged in the current ballot
+    decree last_logged = last_committed_decree();
+    if (status() == partition_status::PS_SECONDARY) {
+        for (decree d = last_logged + 1; d <= _prepare_list->max_decree(); ++d) {
+            const mutation_ptr &mu = _prepare_list->get_mutation_by_decree(d);
+            if (mu == nullptr || !mu->is_logged() || mu->data.header.ballot != get_ballot()) {
+                break;
+            }
+            last_logged = d;
+        }
+    }
+
+    mutation_ptr last_covered;
+    std::vector<mutation_ptr> uncovered;
+    for (auto &mu : acks) {
+        if (mu->data.header.ballot < get_ballot()) {
+            continue;
+        }
+        if (status() != partition_status::PS_SECONDARY ||
+            mu->data.header.ballot != get_ballot() || mu->get_decree() > last_logged) {
+            uncovered.push_back(mu);
+            continue;
+        }
+        // the replies of the others are omitted, the primary cancels their rpcs once the
+        // cumulative ack arrives
+        if (last_covered == nullptr || mu->get_decree() > last_covered->get_decree()) {
+            last_covered = mu;
+        }
+    }
+    // the cumulative ack goes first, as the primary takes an ack of a later prepare passing a
+    // timed out one as the loss of the latter
+    if (last_covered != nullptr) {
+        ack_prepare_message(ERR_OK, last_covered, last_logged);
+    }
+    for (auto &mu : uncovered) {
+        ack_prepare_message(ERR_OK, mu);
+    }
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::on_cumulative_prepare_ack(const rpc_address &node, decree last_logged_decree)
+{
+    mutation_ptr first_ready;
+    decree max_decree = std::min(last_logged_decree, _prepare_list->max_decree());
+    for (decree d = last_committed_decree() + 1; d <= max_decree; ++d) {
+        mutation_ptr mu = _prepare_list->get_mutation_by_decree(d);
+        if (mu == nullptr || mu->data.header.ballot != get_ballot()) {
+            continue;
+        }
+        auto iter = mu->remote_tasks().find(node);
+        if (iter == mu->remote_tasks().end()) {
+            continue;
+        }
+        // the reply of this prepare is omitted by the secondary
+        iter->second->cancel(false);
+        mu->remote_tasks().erase(iter);
+        dassert(mu->left_secondary_ack_count() > 0, "%u", mu->left_secondary_ack_count());
+        if (0 == mu->decrease_left_secondary_ack_count() && first_ready == nullptr) {
+            first_ready = mu;
+        }
+    }
+
+    // commit once for the batch
+    if (first_ready != nullptr) {
+        do_possible_commit_on_primary(first_ready);
+    }
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+bool replica::is_cumulative_prepare_ack_expected(const mutation_ptr &mu, const rpc_address &node)
+{
+    for (decree d = mu->get_decree() + 1; d <= _prepare_list->max_decree(); ++d) {
+        mutation_ptr later = _prepare_list->get_mutation_by_decree(d);
+        if (later == nullptr || later->data.header.ballot != get_ballot()) {
+            continue;
+        }
+        // the rpc of a prepare waiting for a retry is finished
+        auto iter = later->remote_tasks().find(node);
+        if (iter != later->remote_tasks().end() && iter->second->state() == TASK_STATE_READY) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+bool replica::check_timed_out_prepares(const rpc_address &node, const prepare_ack &ack)
+{
+    auto iter = _primary_states.timed_out_prepares.find(node);
+    if (iter == _primary_states.timed_out_prepares.end()) {
+        return true;
+    }
+
+    // the cumulative ack counts all the prepares up to `last_logged_decree`, while the others
+    // before an individual ack are lost, as the secondary acks the prepares in order
+    bool cumulative = ack.__isset.last_logged_decree;
+    decree acked_decree = cumulative ? ack.last_logged_decree : ack.decree;
+    bool all_acked = true;
+    std::set<decree> &decrees = iter->second;
+    for (auto it = decrees.begin(); it != decrees.end() && *it <= acked_decree;
+         it = decrees.erase(it)) {
+        if (cumulative || *it <= last_committed_decree()) {
+            continue;
+        }
+        mutation_ptr mu = _prepare_list->get_mutation_by_decree(*it);
+        if (mu != nullptr && mu->data.header.ballot == get_ballot() &&
+            mu->remote_tasks().count(node) > 0) {
+            all_acked = false;
+        }
+    }
+    if (decrees.empty()) {
+        _primary_states.timed_out_prepares.erase(iter);
+    }
+    return all_acked;
+}
+
 void replica::cleanup_preparing_mutations(bool wait)
 {
     decree start = last_committed_decree() + 1;
@@ -792,7 +1098,7 @@ void replica::cleanup_preparing_mutations(bool wait)
             // make sure the buffers from mutations are valid for underlying aio
             //
             if (wait) {
-                _stub->_log->flush();
+                shared_log()->flush();
                 mu->wait_log_task();
             }
         }
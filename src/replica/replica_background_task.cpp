@@ -0,0 +1,132 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica.h"
+#include "replica_stub.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replica_envs.h>
+#include <dsn/utility/chrono_literals.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                background_task_coordinated,
+                false,
+                "whether to ask the meta server for a grant before a non-emergency checkpoint or "
+                "a manual compaction, which limits the ones running in the cluster at the same "
+                "time, see [meta_server] background_task_max_per_node");
+DSN_TAG_VARIABLE(background_task_coordinated, FT_MUTABLE);
+
+bool replica::acquire_background_task(background_task_type::type type,
+                                      std::function<void()> on_granted)
+{
+    if (!FLAGS_background_task_coordinated) {
+        return true;
+    }
+
+    std::atomic<int> &state = _background_task_states[type];
+    int expected = BTS_IDLE;
+    if (!state.compare_exchange_strong(expected, BTS_ACQUIRING)) {
+        return expected == BTS_GRANTED;
+    }
+
+    auto request = make_unique<background_task_request>();
+    request->pid = get_gpid();
+    request->node = _stub->primary_address();
+    request->type = type;
+    background_task_rpc rpc(
+        std::move(request), RPC_CM_ACQUIRE_BACKGROUND_TASK, 3_s, 0, get_gpid().thread_hash());
+    rpc.call(_stub->get_meta_server_address(),
+             &_tracker,
+             [this, rpc, on_granted = std::move(on_granted)](error_code err) mutable {
+                 std::atomic<int> &state = _background_task_states[rpc.request().type];
+                 if (err == ERR_OK) {
+                     err = rpc.response().err;
+                 }
+                 if (err != ERR_OK || !rpc.response().granted) {
+                     dinfo_replica("background task {} is not granted, err = {}",
+                                   enum_to_string(rpc.request().type),
+                                   err);
+                     state.store(BTS_IDLE);
+                     return;
+                 }
+                 state.store(BTS_GRANTED);
+                 if (on_granted) {
+                     on_granted();
+                 }
+             });
+    return false;
+}
+
+void replica::release_background_task(background_task_type::type type)
+{
+    int expected = BTS_GRANTED;
+    if (!_background_task_states[type].compare_exchange_strong(expected, BTS_IDLE)) {
+        return;
+    }
+
+    // the grant expires on the meta server if the release is lost
+    auto request = make_unique<background_task_request>();
+    request->pid = get_gpid();
+    request->node = _stub->primary_address();
+    request->type = type;
+    request->release = true;
+    background_task_rpc rpc(
+        std::move(request), RPC_CM_ACQUIRE_BACKGROUND_TASK, 3_s, 0, get_gpid().thread_hash());
+    rpc.call(_stub->get_meta_server_address(), &_tracker, [](error_code) {});
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+bool replica::hold_manual_compaction_env(const std::map<std::string, std::string> &envs,
+                                         std::map<std::string, std::string> &held_envs)
+{
+    auto iter = envs.find(replica_envs::MANUAL_COMPACT_ONCE_TRIGGER_TIME);
+    if (iter == envs.end() || iter->second == _last_manual_compact_trigger) {
+        return false;
+    }
+
+    // the envs are synced from the meta server periodically, so the trigger is passed by the
+    // next sync after it's granted
+    if (acquire_background_task(background_task_type::BT_MANUAL_COMPACTION, nullptr)) {
+        _last_manual_compact_trigger = iter->second;
+        _manual_compaction_triggered = FLAGS_background_task_coordinated;
+        return false;
+    }
+
+    held_envs = envs;
+    held_envs.erase(replica_envs::MANUAL_COMPACT_ONCE_TRIGGER_TIME);
+    return true;
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::release_manual_compaction_if_done()
+{
+    if (!_manual_compaction_triggered) {
+        return;
+    }
+    manual_compaction_status status = get_manual_compact_status();
+    if (status == kIdle || status == kFinished) {
+        _manual_compaction_triggered = false;
+        release_background_task(background_task_type::BT_MANUAL_COMPACTION);
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -56,7 +56,13 @@ void replica::init_group_check()
 
     ddebug("%s: init group check", name());
 
-    if (partition_status::PS_PRIMARY != status() || _options->group_check_disabled)
+    if (partition_status::PS_PRIMARY != status())
+        return;
+
+    // the lease granted to the previous primary must run out first
+    _primary_states.read_lease.reset(_last_read_lease_grant_ms);
+
+    if (_options->group_check_disabled)
         return;
 
     dassert(nullptr == _primary_states.group_check_task, "");
@@ -116,6 +122,9 @@ void replica::broadcast_group_check()
             dassert(
                 it != _primary_states.learners.end(), "learner %s is missing", addr.to_string());
             request->config.learner_signature = it->second.signature;
+            if (it->second.non_voting) {
+                request->config.__set_non_voting(true);
+            }
         }
 
         ddebug("%s: send group check to %s with state %s",
@@ -123,17 +132,24 @@ void replica::broadcast_group_check()
                addr.to_string(),
                enum_to_string(it->second));
 
-        dsn::task_ptr callback_task =
-            rpc::call(addr,
-                      RPC_GROUP_CHECK,
-                      *request,
-                      &_tracker,
-                      [=](error_code err, group_check_response &&resp) {
-                          auto alloc = std::make_shared<group_check_response>(std::move(resp));
-                          on_group_check_reply(err, request, alloc);
-                      },
-                      std::chrono::milliseconds(0),
-                      get_gpid().thread_hash());
+        uint64_t send_ts_ms = dsn_now_ms();
+        auto on_reply = [=](error_code err, group_check_response &&resp) {
+            auto alloc = std::make_shared<group_check_response>(std::move(resp));
+            on_group_check_reply(send_ts_ms, err, request, alloc);
+        };
+        dsn::task_ptr callback_task;
+        if (_stub->_group_check_batcher != nullptr) {
+            callback_task = _stub->_group_check_batcher->add(
+                addr, *request, &_tracker, get_gpid().thread_hash(), std::move(on_reply));
+        } else {
+            callback_task = rpc::call(addr,
+                                      RPC_GROUP_CHECK,
+                                      *request,
+                                      &_tracker,
+                                      std::move(on_reply),
+                                      std::chrono::milliseconds(0),
+                                      get_gpid().thread_hash());
+        }
 
         _primary_states.group_check_pending_replies[addr] = callback_task;
     }
@@ -181,6 +197,9 @@ void replica::on_group_check(const group_check_request &request,
     case partition_status::PS_INACTIVE:
         break;
     case partition_status::PS_SECONDARY:
+        _last_read_lease_grant_ms = dsn_now_ms();
+        _secondary_states.read_staleness.on_primary_committed(request.last_committed_decree,
+                                                              dsn_now_ms());
         if (request.last_committed_decree > last_committed_decree()) {
             _prepare_list->commit(request.last_committed_decree, COMMIT_TO_DECREE_HARD);
         }
@@ -188,7 +207,13 @@ void replica::on_group_check(const group_check_request &request,
         _split_mgr->trigger_secondary_parent_split(request, response);
         break;
     case partition_status::PS_POTENTIAL_SECONDARY:
+        _last_read_lease_grant_ms = dsn_now_ms();
         init_learn(request.config.learner_signature);
+        _potential_secondary_states.non_voting = request.config.non_voting;
+        if (request.config.non_voting) {
+            _secondary_states.read_staleness.on_primary_committed(request.last_committed_decree,
+                                                                  dsn_now_ms());
+        }
         break;
     case partition_status::PS_ERROR:
         break;
@@ -210,7 +235,8 @@ void replica::on_group_check(const group_check_request &request,
     response.learner_signature = _potential_secondary_states.learning_version;
 }
 
-void replica::on_group_check_reply(error_code err,
+void replica::on_group_check_reply(uint64_t send_ts_ms,
+                                   error_code err,
                                    const std::shared_ptr<group_check_request> &req,
                                    const std::shared_ptr<group_check_response> &resp)
 {
@@ -230,6 +256,12 @@ void replica::on_group_check_reply(error_code err,
         handle_remote_failure(req->config.status, req->node, err, "group check");
         _stub->_counter_replicas_recent_group_check_fail_count->increment();
     } else {
+        // a learner grants the lease as well, so that it holds the lease once upgraded to
+        // secondary
+        if (req->config.status == partition_status::PS_SECONDARY ||
+            req->config.status == partition_status::PS_POTENTIAL_SECONDARY) {
+            _primary_states.read_lease.renew(req->node, send_ts_ms);
+        }
         if (resp->learner_status_ == learner_status::LearningSucceeded &&
             req->config.status == partition_status::PS_POTENTIAL_SECONDARY) {
             handle_learning_succeeded_on_primary(req->node, resp->learner_signature);
@@ -37,6 +37,7 @@
 #include "mutation.h"
 #include "mutation_log.h"
 #include "replica_stub.h"
+#include "async_file_deleter.h"
 #include "duplication/replica_duplicator_manager.h"
 #include "split/replica_split_manager.h"
 #include <dsn/utility/filesystem.h>
@@ -52,6 +53,8 @@ void replica::on_checkpoint_timer()
 {
     _checker.only_one_thread_access();
 
+    release_manual_compaction_if_done();
+
     if (dsn_now_ms() > _next_checkpoint_interval_trigger_time_ms) {
         // we trigger emergency checkpoint if no checkpoint generated for a long time
         ddebug("%s: trigger emergency checkpoint by checkpoint_max_interval_hours, "
@@ -117,7 +120,7 @@ void replica::on_checkpoint_timer()
                                  (int64_t)_options->log_private_reserve_max_size_mb * 1024 * 1024,
                                  (int64_t)_options->log_private_reserve_max_time_seconds);
                              if (status() == partition_status::PS_PRIMARY)
-                                 _counter_private_log_size->set(_private_log->total_size() /
+                                 _counter_private_log_size.set(_private_log->total_size() /
                                                                 1000000);
                          });
     }
@@ -135,6 +138,36 @@ void replica::init_checkpoint(bool is_emergency)
         return;
     }
 
+    // the snapshot is taken between the writes, and written in background without blocking them
+    if (_checkpoint_snapshot_writing.load()) {
+        ddebug_replica("ignore doing checkpoint as the last checkpoint snapshot is being written");
+        return;
+    }
+
+    // the emergency ones are not delayed by the coordination of the meta server
+    if (!is_emergency && !acquire_background_task(background_task_type::BT_CHECKPOINT,
+                                                  [this] { init_checkpoint(false); })) {
+        return;
+    }
+
+    std::shared_ptr<checkpoint_snapshot> snapshot = _app->take_checkpoint_snapshot();
+    if (snapshot != nullptr) {
+        if (snapshot->decree() <= _app->last_durable_decree()) {
+            dinfo_replica("ignore checkpoint snapshot as it is not newer than "
+                          "last_durable_decree({})",
+                          _app->last_durable_decree());
+            release_background_task(background_task_type::BT_CHECKPOINT);
+            return;
+        }
+        _checkpoint_snapshot_writing.store(true);
+        tasking::enqueue(LPC_CHECKPOINT_REPLICA, &_tracker, [this, snapshot] {
+            background_write_checkpoint_snapshot(snapshot);
+        });
+        if (is_emergency)
+            _stub->_counter_recent_trigger_emergency_checkpoint_count->increment();
+        return;
+    }
+
     // here we demand that async_checkpoint() is implemented.
     // we delay some time to run background_async_checkpoint() to pass unit test dsn.rep_tests.
     //
@@ -229,7 +262,7 @@ void replica::on_copy_checkpoint_ack(error_code err,
     std::string ldir = utils::filesystem::path_combine(_app->learn_dir(), "checkpoint.copy");
 
     if (utils::filesystem::path_exists(ldir))
-        utils::filesystem::remove_path(ldir);
+        async_file_deleter::instance().remove_path(ldir);
 
     _primary_states.checkpoint_task = _stub->_nfs->copy_remote_files(
         resp->address,
@@ -318,6 +351,38 @@ error_code replica::background_async_checkpoint(bool is_emergency)
                used_time,
                err.to_string());
     }
+    if (err != ERR_TRY_AGAIN) {
+        release_background_task(background_task_type::BT_CHECKPOINT);
+    }
+    return err;
+}
+
+// run in background thread
+error_code
+replica::background_write_checkpoint_snapshot(std::shared_ptr<checkpoint_snapshot> snapshot)
+{
+    uint64_t start_time = dsn_now_ns();
+    decree old_durable = _app->last_durable_decree();
+    auto err = snapshot->write();
+    uint64_t used_time = dsn_now_ns() - start_time;
+    if (err == ERR_OK) {
+        ddebug_replica("write checkpoint snapshot succeed, time_used_ns = {}, snapshot_decree = "
+                       "{}, app_last_committed_decree = {}, app_last_durable_decree = ({} => {})",
+                       used_time,
+                       snapshot->decree(),
+                       _app->last_committed_decree(),
+                       old_durable,
+                       _app->last_durable_decree());
+        update_last_checkpoint_generate_time();
+    } else {
+        derror_replica("write checkpoint snapshot failed, time_used_ns = {}, snapshot_decree = "
+                       "{}, err = {}",
+                       used_time,
+                       snapshot->decree(),
+                       err);
+    }
+    _checkpoint_snapshot_writing.store(false);
+    release_background_task(background_task_type::BT_CHECKPOINT);
     return err;
 }
 
@@ -97,6 +97,9 @@ void replica::on_config_proposal(configuration_update_request &proposal)
     case config_type::CT_REMOVE:
         remove(proposal);
         break;
+    case config_type::CT_UPDATE_READ_REPLICAS:
+        update_read_replicas(proposal);
+        break;
     default:
         dassert(false, "invalid config_type, type = %s", enum_to_string(proposal.type));
     }
@@ -170,7 +173,7 @@ void replica::add_potential_secondary(configuration_update_request &proposal)
             proposal.node.to_string());
 
     int potential_secondaries_count =
-        _primary_states.membership.secondaries.size() + _primary_states.learners.size();
+        _primary_states.membership.secondaries.size() + _primary_states.voting_learner_count();
     if (potential_secondaries_count >= _primary_states.membership.max_replica_count - 1) {
         if (proposal.type == config_type::CT_ADD_SECONDARY) {
             if (_primary_states.learners.find(proposal.node) == _primary_states.learners.end()) {
@@ -200,6 +203,11 @@ void replica::add_potential_secondary(configuration_update_request &proposal)
     state.timeout_task = nullptr; // TODO: add timer for learner task
 
     auto it = _primary_states.learners.find(proposal.node);
+    if (it != _primary_states.learners.end() && it->second.non_voting) {
+        // the read replica joins the write quorum, and learns again as a voting learner
+        _primary_states.learners.erase(it);
+        it = _primary_states.learners.end();
+    }
     if (it != _primary_states.learners.end()) {
         state.signature = it->second.signature;
     } else {
@@ -224,6 +232,72 @@ void replica::add_potential_secondary(configuration_update_request &proposal)
         proposal.node, RPC_LEARN_ADD_LEARNER, request, get_gpid().thread_hash());
 }
 
+// run on primary to replace the read replicas with the ones placed by meta server.
+//
+// A read replica is a learner which never joins the write quorum: it receives the prepares
+// like a potential secondary, but the commits never wait for its acks, and it stays a potential
+// secondary when its learning succeeds, serving the bounded-staleness reads. It is not counted
+// in max_replica_count, and a failed one is simply removed to learn again when meta server
+// proposes it next time.
+void replica::update_read_replicas(const configuration_update_request &proposal)
+{
+    if (status() != partition_status::PS_PRIMARY) {
+        dwarn_replica("ignore update read replicas proposal for invalid state, state = {}",
+                      enum_to_string(status()));
+        return;
+    }
+
+    std::set<::dsn::rpc_address> targets;
+    for (const ::dsn::rpc_address &node : proposal.read_replicas) {
+        partition_status::type st = _primary_states.get_node_status(node);
+        if (st == partition_status::PS_INACTIVE || _primary_states.is_read_replica(node)) {
+            targets.insert(node);
+        }
+    }
+
+    for (auto it = _primary_states.learners.begin(); it != _primary_states.learners.end();) {
+        if (!it->second.non_voting || targets.count(it->first) > 0) {
+            ++it;
+            continue;
+        }
+        ddebug_replica("remove read replica {}", it->first.to_string());
+        replica_configuration rconfig;
+        _primary_states.get_replica_config(partition_status::PS_INACTIVE, rconfig);
+        rconfig.__set_non_voting(true);
+        rpc::call_one_way_typed(it->first, RPC_REMOVE_REPLICA, rconfig, get_gpid().thread_hash());
+        _primary_states.statuses.erase(it->first);
+        it = _primary_states.learners.erase(it);
+    }
+
+    for (const ::dsn::rpc_address &node : targets) {
+        if (_primary_states.is_read_replica(node)) {
+            continue;
+        }
+
+        remote_learner_state state;
+        state.prepare_start_decree = invalid_decree;
+        state.timeout_task = nullptr;
+        state.signature = ++_primary_states.next_learning_version;
+        state.non_voting = true;
+        _primary_states.learners[node] = state;
+        _primary_states.statuses[node] = partition_status::PS_POTENTIAL_SECONDARY;
+
+        group_check_request request;
+        request.app = _app_info;
+        request.node = node;
+        _primary_states.get_replica_config(
+            partition_status::PS_POTENTIAL_SECONDARY, request.config, state.signature);
+        request.config.__set_non_voting(true);
+        request.last_committed_decree = last_committed_decree();
+
+        ddebug_replica("call one way {} to start learning as read replica with signature "
+                       "[{:#018x}]",
+                       node.to_string(),
+                       state.signature);
+        rpc::call_one_way_typed(node, RPC_LEARN_ADD_LEARNER, request, get_gpid().thread_hash());
+    }
+}
+
 void replica::upgrade_to_secondary_on_primary(::dsn::rpc_address node)
 {
     ddebug("%s: upgrade potential secondary %s to secondary", name(), node.to_string());
@@ -348,7 +422,8 @@ void replica::on_remove(const replica_configuration &request)
     // - when r2 is on learning, the remove request is arrived, with the same ballot
     // - here we ignore the lately arrived remove request, which is proper
     //
-    if (request.ballot == get_ballot() && partition_status::PS_POTENTIAL_SECONDARY == status()) {
+    if (request.ballot == get_ballot() && partition_status::PS_POTENTIAL_SECONDARY == status() &&
+        !(request.non_voting && _potential_secondary_states.non_voting)) {
         dwarn("this implies that a config proposal request (e.g. add secondary) "
               "with the same ballot arrived before this remove request, "
               "current status is %s",
@@ -549,7 +624,12 @@ void replica::update_app_envs(const std::map<std::string, std::string> &envs)
 {
     if (_app) {
         update_app_envs_internal(envs);
-        _app->update_app_envs(envs);
+        std::map<std::string, std::string> held_envs;
+        if (hold_manual_compaction_env(envs, held_envs)) {
+            _app->update_app_envs(held_envs);
+        } else {
+            _app->update_app_envs(envs);
+        }
     }
 }
 
@@ -994,6 +1074,17 @@ bool replica::update_local_configuration(const replica_configuration &config,
            _last_config_change_time_ms - oldTs,
            boost::lexical_cast<std::string>(_config).c_str());
 
+    // the continuous hot key detection runs on the primaries only
+    if (hotkey_detector::continuous() && status() != old_status) {
+        if (status() == partition_status::PS_PRIMARY) {
+            _read_hotkey_detector.start();
+            _write_hotkey_detector.start();
+        } else if (old_status == partition_status::PS_PRIMARY) {
+            _read_hotkey_detector.stop();
+            _write_hotkey_detector.stop();
+        }
+    }
+
     if (status() != old_status) {
         bool is_closing =
             (status() == partition_status::PS_ERROR ||
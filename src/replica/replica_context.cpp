@@ -50,6 +50,17 @@ void primary_context::cleanup(bool clean_pending_mutations)
 {
     do_cleanup_pending_mutations(clean_pending_mutations);
 
+    // the 2pc pipeline depth is tuned over again when the replica becomes primary next time
+    prepare_window.reset();
+    if (prepare_window_controller::enabled()) {
+        write_queue.set_max_concurrent_op(prepare_window.window());
+        write_queue.set_max_batch_bytes(prepare_window.batch_bytes());
+    }
+
+    read_lease.reset();
+    write_admission.reset();
+    timed_out_prepares.clear();
+
     // clean up group check
     CLEANUP_TASK_ALWAYS(group_check_task)
 
@@ -134,6 +145,23 @@ void primary_context::get_replica_config(partition_status::type st,
     config.learner_signature = learner_signature;
 }
 
+bool primary_context::is_read_replica(::dsn::rpc_address node) const
+{
+    auto it = learners.find(node);
+    return it != learners.end() && it->second.non_voting;
+}
+
+unsigned primary_context::voting_learner_count() const
+{
+    unsigned count = 0;
+    for (const auto &kv : learners) {
+        if (!kv.second.non_voting) {
+            ++count;
+        }
+    }
+    return count;
+}
+
 bool primary_context::check_exist(::dsn::rpc_address node, partition_status::type st)
 {
     switch (st) {
@@ -218,6 +246,8 @@ bool potential_secondary_context::cleanup(bool force)
 
     CLEANUP_TASK(learn_remote_files_task, force)
 
+    CLEANUP_TASK(learn_remote_logs_task, force)
+
     CLEANUP_TASK(catchup_with_private_log_task, force)
 
     learning_version = 0;
@@ -225,21 +255,33 @@ bool potential_secondary_context::cleanup(bool force)
     learning_copy_file_count = 0;
     learning_copy_file_size = 0;
     learning_copy_buffer_size = 0;
-    learning_round_is_running = false;
-    if (learn_app_concurrent_count_increased) {
-        --owner_replica->get_replica_stub()->_learn_app_concurrent_count;
-        learn_app_concurrent_count_increased = false;
+    if (learn_memory_bytes != 0) {
+        charge_learn_memory(0);
     }
+    learning_round_is_running = false;
+    // also forgets it waiting for the learn scheduler
+    owner_replica->get_replica_stub()->_learn_scheduler.release(owner_replica->get_gpid());
+    learn_app_concurrent_count_increased = false;
     learning_start_prepare_decree = invalid_decree;
     first_learn_start_decree = invalid_decree;
     learning_status = learner_status::LearningInvalid;
+    non_voting = false;
     return true;
 }
 
+void potential_secondary_context::charge_learn_memory(int64_t bytes)
+{
+    replica_memory_budget &budget = owner_replica->get_replica_stub()->memory_budget();
+    budget.release(memory_subsystem::LEARN, learn_memory_bytes);
+    learn_memory_bytes = bytes;
+    budget.consume(memory_subsystem::LEARN, learn_memory_bytes);
+}
+
 bool potential_secondary_context::is_cleaned()
 {
     return nullptr == delay_learning_task && nullptr == learning_task &&
-           nullptr == learn_remote_files_task && nullptr == learn_remote_files_completed_task &&
+           nullptr == learn_remote_files_task && nullptr == learn_remote_logs_task &&
+           nullptr == learn_remote_files_completed_task &&
            nullptr == catchup_with_private_log_task && nullptr == completion_notify_task;
 }
 
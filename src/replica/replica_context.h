@@ -29,8 +29,13 @@
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/dist/block_service.h>
 #include <dsn/cpp/json_helper.h>
+#include <set>
 
 #include "mutation.h"
+#include "prepare_window_controller.h"
+#include "primary_read_lease.h"
+#include "replication_admission_controller.h"
+#include "read_staleness_tracker.h"
 
 class replication_service_test_app;
 
@@ -46,6 +51,8 @@ struct remote_learner_state
     ::dsn::task_ptr timeout_task;
     decree prepare_start_decree;
     std::string last_learn_log_file;
+    // a read replica, see replica::update_read_replicas()
+    bool non_voting = false;
 };
 
 typedef std::unordered_map<::dsn::rpc_address, remote_learner_state> learner_map;
@@ -80,6 +87,7 @@ public:
     primary_context(gpid gpid, int max_concurrent_2pc_count = 1, bool batch_write_disabled = false)
         : next_learning_version(0),
           write_queue(gpid, max_concurrent_2pc_count, batch_write_disabled),
+          prepare_window(max_concurrent_2pc_count),
           last_prepare_decree_on_new_primary(0),
           last_prepare_ts_ms(dsn_now_ms())
     {
@@ -94,6 +102,10 @@ public:
                             uint64_t learner_signature = invalid_signature);
     bool check_exist(::dsn::rpc_address node, partition_status::type status);
     partition_status::type get_node_status(::dsn::rpc_address addr) const;
+    // whether `node` is a non-voting learner, which is not counted in the write quorum
+    bool is_read_replica(::dsn::rpc_address node) const;
+    // the learners which are going to be secondaries
+    unsigned voting_learner_count() const;
 
     void do_cleanup_pending_mutations(bool clean_pending_mutations = true);
 
@@ -113,6 +125,17 @@ public:
 
     // 2pc batching
     mutation_queue write_queue;
+    // tunes the concurrent ops and the batch size of write_queue if it's enabled
+    prepare_window_controller prepare_window;
+    // under which the primary serves reads if it's enabled
+    primary_read_lease read_lease;
+    // rejects the client writes early under backpressure if it's enabled
+    replication_admission_controller write_admission;
+
+    // the prepares to each secondary whose rpcs timed out while a later prepare to it was still
+    // waiting for the reply, which a secondary batching its acks acks by the cumulative ack of
+    // the later one, see replica::on_prepare_reply()
+    std::unordered_map<rpc_address, std::set<decree>> timed_out_prepares;
 
     // group check
     dsn::task_ptr group_check_task; // the repeated group check task of LPC_GROUP_CHECK
@@ -185,6 +208,12 @@ public:
     ::dsn::task_ptr checkpoint_task;
     ::dsn::task_ptr checkpoint_completed_task;
     ::dsn::task_ptr catchup_with_private_log_task;
+    // the lag behind primary, for the bounded-staleness reads, which is also tracked by a read
+    // replica, see potential_secondary_context::non_voting
+    read_staleness_tracker read_staleness;
+    // the prepares logged but not acked yet, see replica::batch_prepare_ack()
+    std::vector<mutation_ptr> pending_prepare_acks;
+    bool prepare_ack_flush_scheduled{false};
 };
 
 class potential_secondary_context
@@ -227,9 +256,19 @@ public:
     // It indicates the minimum decree under `learn/` dir.
     decree first_learn_start_decree{invalid_decree};
 
+    // a read replica never becomes a secondary, but serves the bounded-staleness reads once it
+    // has learned successfully
+    bool non_voting{false};
+
+    // the learn state of the running round charged to the memory budget of the node
+    int64_t learn_memory_bytes{0};
+    // charge `bytes` instead of the learn state of the previous round
+    void charge_learn_memory(int64_t bytes);
+
     ::dsn::task_ptr delay_learning_task;
     ::dsn::task_ptr learning_task;
     ::dsn::task_ptr learn_remote_files_task;
+    ::dsn::task_ptr learn_remote_logs_task;
     ::dsn::task_ptr learn_remote_files_completed_task;
     ::dsn::task_ptr catchup_with_private_log_task;
     ::dsn::task_ptr completion_notify_task;
@@ -24,6 +24,7 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replication_app_base.h>
+#include <dsn/tool-api/background_io_limiter.h>
 #include <dsn/utility/fail_point.h>
 
 namespace dsn {
@@ -256,6 +257,20 @@ bool replica_disk_migrator::migrate_replica_checkpoint(const replica_disk_migrat
         return false;
     }
 
+    // the checkpoint is about as large as the data dir
+    uint64_t data_size = 0;
+    std::vector<std::string> data_files;
+    if (utils::filesystem::get_subfiles(_replica->get_app()->data_dir(), data_files, true)) {
+        for (const std::string &file : data_files) {
+            int64_t file_size = 0;
+            if (utils::filesystem::file_size(file, file_size)) {
+                data_size += file_size;
+            }
+        }
+    }
+    background_io_limiter::instance().throttle(
+        _replica->dir(), background_io_class::disk_migration, data_size);
+
     const auto &copy_checkpoint_err =
         _replica->get_app()->copy_checkpoint_to_dir(_target_data_dir.c_str(), 0 /*last_decree*/);
     if (copy_checkpoint_err != ERR_OK) {
@@ -282,6 +297,13 @@ bool replica_disk_migrator::migrate_replica_app_info(const replica_disk_migrate_
         return false;
     });
     replica_init_info init_info = _replica->get_app()->init_info();
+    mutation_log_ptr target_slog = _replica->_stub->get_shared_log(_target_replica_dir);
+    if (target_slog != _replica->shared_log()) {
+        // with [replication] slog_per_disk_enabled the offset in the origin disk's shared log
+        // means nothing to the target one, so start the replica from the end of the latter
+        init_info.init_offset_in_shared_log =
+            target_slog->on_partition_reset(get_gpid(), _replica->last_durable_decree());
+    }
     const auto &store_init_info_err = init_info.store(_target_replica_dir);
     if (store_init_info_err != ERR_OK) {
         derror_replica("disk migration(origin={}, target={}) stores app init info failed({})",
@@ -350,6 +372,10 @@ void replica_disk_migrator::update_replica_dir()
     _replica->get_replica_stub()->_fs_manager.remove_replica(get_gpid());
     _replica->get_replica_stub()->_fs_manager.add_replica(get_gpid(), _target_replica_dir);
     _replica->get_replica_stub()->update_disk_holding_replicas();
+    if (_replica->_disk_shared_log != nullptr) {
+        _replica->_disk_shared_log =
+            _replica->get_replica_stub()->get_shared_log(_target_replica_dir);
+    }
 
     _status = disk_migration_status::CLOSED;
     ddebug_replica("disk replica migration move data from origin dir({}) to new dir({}) "
@@ -5,6 +5,9 @@
 #include <nlohmann/json.hpp>
 #include <fmt/format.h>
 #include <dsn/utility/output_utils.h>
+#include <dsn/utils/latency_tracer.h>
+#include <dsn/utils/slow_request_recorder.h>
+#include <dsn/utils/time_utils.h>
 #include "replica_http_service.h"
 #include "duplication/duplication_sync_timer.h"
 
@@ -139,5 +142,123 @@ void replica_http_service::query_manual_compaction_handler(const http_request &r
     resp.body = json.dump();
 }
 
+void replica_http_service::query_hotkeys_handler(const http_request &req, http_response &resp)
+{
+    if (!hotkey_detector::enabled()) {
+        resp.body = "builtin hotkey detection is not enabled "
+                    "[builtin_hotkey_detection_enabled=false]";
+        resp.status_code = http_status_code::not_found;
+        return;
+    }
+    auto it = req.query_args.find("app_id");
+    if (it == req.query_args.end()) {
+        resp.body = "app_id should not be empty";
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    int32_t app_id = -1;
+    if (!buf2int32(it->second, app_id) || app_id < 0) {
+        resp.body = fmt::format("invalid app_id={}", it->second);
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    std::map<int32_t, std::pair<std::string, std::string>> hotkeys;
+    _stub->query_app_hotkeys(app_id, hotkeys);
+
+    nlohmann::json json = nlohmann::json::object();
+    for (const auto &kv : hotkeys) {
+        json[std::to_string(kv.first)] = nlohmann::json{
+            {"read", nlohmann::json::parse(kv.second.first)},
+            {"write", nlohmann::json::parse(kv.second.second)},
+        };
+    }
+    resp.status_code = http_status_code::ok;
+    resp.body = json.dump();
+}
+
+void replica_http_service::query_slow_requests_handler(const http_request &req,
+                                                       http_response &resp)
+{
+    if (!utils::FLAGS_enable_latency_tracer || utils::FLAGS_slow_request_recorder_size == 0) {
+        resp.body = "slow request recorder is not enabled "
+                    "[enable_latency_tracer=false or slow_request_recorder_size=0]";
+        resp.status_code = http_status_code::not_found;
+        return;
+    }
+
+    std::string category;
+    auto it = req.query_args.find("category");
+    if (it != req.query_args.end()) {
+        category = it->second;
+    }
+
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto &window : utils::slow_request_recorder::instance().get_windows(category)) {
+        nlohmann::json requests = nlohmann::json::array();
+        for (const auto &request : window.requests) {
+            nlohmann::json stages = nlohmann::json::array();
+            for (const auto &stage : request.stages) {
+                stages.push_back(nlohmann::json{{"name", stage.second}, {"span_ns", stage.first}});
+            }
+            requests.push_back(nlohmann::json{{"name", request.name},
+                                              {"start_ns", request.start_ns},
+                                              {"latency_ns", request.latency_ns},
+                                              {"stages", std::move(stages)}});
+        }
+        char window_start[100];
+        utils::time_ms_to_date_time(window.window_start_ms, window_start, sizeof(window_start));
+        json.push_back(nlohmann::json{{"category", window.category},
+                                      {"window_start", window_start},
+                                      {"requests", std::move(requests)}});
+    }
+    resp.status_code = http_status_code::ok;
+    resp.body = json.dump();
+}
+
+void replica_http_service::query_resource_usage_handler(const http_request &req,
+                                                        http_response &resp)
+{
+    auto it = req.query_args.find("app_id");
+    if (it == req.query_args.end()) {
+        resp.body = "app_id should not be empty";
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    int32_t app_id = -1;
+    if (!buf2int32(it->second, app_id) || app_id < 0) {
+        resp.body = fmt::format("invalid app_id={}", it->second);
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    std::map<int32_t, replica_resource_usage::snapshot> usages;
+    _stub->query_app_resource_usage(app_id, usages);
+    if (usages.empty()) {
+        resp.body = fmt::format("app_id={} not found", it->second);
+        resp.status_code = http_status_code::not_found;
+        return;
+    }
+
+    nlohmann::json json = nlohmann::json::object();
+    for (const auto &kv : usages) {
+        const replica_resource_usage::snapshot &usage = kv.second;
+        json[std::to_string(kv.first)] = nlohmann::json{
+            {"plog_write_bytes", usage.plog_write_bytes},
+            {"plog_read_bytes", usage.plog_read_bytes},
+            {"apply_count", usage.apply_count},
+            {"apply_time_ns", usage.apply_time_ns},
+            {"rpc_bytes_in", usage.rpc_bytes_in},
+            {"rpc_bytes_out", usage.rpc_bytes_out},
+            {"learn_bytes_served", usage.learn_bytes_served},
+            {"learn_bytes_received", usage.learn_bytes_received},
+        };
+    }
+    resp.status_code = http_status_code::ok;
+    resp.body = json.dump();
+}
+
 } // namespace replication
 } // namespace dsn
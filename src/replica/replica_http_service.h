@@ -32,6 +32,24 @@ public:
                                    std::placeholders::_1,
                                    std::placeholders::_2),
                          "ip:port/replica/maual_compaction?app_id=<app_id>");
+        register_handler("hotkeys",
+                         std::bind(&replica_http_service::query_hotkeys_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/replica/hotkeys?app_id=<app_id>");
+        register_handler("slow_requests",
+                         std::bind(&replica_http_service::query_slow_requests_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/replica/slow_requests?category=<task_code>");
+        register_handler("resource_usage",
+                         std::bind(&replica_http_service::query_resource_usage_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/replica/resource_usage?app_id=<app_id>");
     }
 
     std::string path() const override { return "replica"; }
@@ -39,6 +57,9 @@ public:
     void query_duplication_handler(const http_request &req, http_response &resp);
     void query_app_data_version_handler(const http_request &req, http_response &resp);
     void query_manual_compaction_handler(const http_request &req, http_response &resp);
+    void query_hotkeys_handler(const http_request &req, http_response &resp);
+    void query_slow_requests_handler(const http_request &req, http_response &resp);
+    void query_resource_usage_handler(const http_request &req, http_response &resp);
 
 private:
     replica_stub *_stub;
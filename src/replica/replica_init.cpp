@@ -29,6 +29,7 @@
 #include "mutation_log.h"
 #include "replica_stub.h"
 #include "backup/replica_backup_manager.h"
+#include "replica_shutdown_snapshot.h"
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/dist/replication/replication_app_base.h>
@@ -123,42 +124,39 @@ error_code replica::initialize_on_load()
     return init_app_and_prepare_list(false);
 }
 
-/*static*/ replica *replica::load(replica_stub *stub, const char *dir)
+/*static*/ bool replica::load_app_info(const char *dir, /*out*/ gpid &pid, /*out*/ app_info &info)
 {
-    FAIL_POINT_INJECT_F("mock_replica_load", [&](string_view) -> replica * { return nullptr; });
-
     char splitters[] = {'\\', '/', 0};
     std::string name = utils::get_last_component(std::string(dir), splitters);
     if (name == "") {
         derror("invalid replica dir %s", dir);
-        return nullptr;
+        return false;
     }
 
     char app_type[128];
     int32_t app_id, pidx;
     if (3 != sscanf(name.c_str(), "%d.%d.%s", &app_id, &pidx, app_type)) {
         derror("invalid replica dir %s", dir);
-        return nullptr;
+        return false;
     }
 
-    gpid pid(app_id, pidx);
+    pid = gpid(app_id, pidx);
     if (!utils::filesystem::directory_exists(dir)) {
         derror("replica dir %s not exist", dir);
-        return nullptr;
+        return false;
     }
 
-    dsn::app_info info;
     replica_app_info info2(&info);
     std::string path = utils::filesystem::path_combine(dir, ".app-info");
     auto err = info2.load(path.c_str());
     if (ERR_OK != err) {
         derror("load app-info from %s failed, err = %s", path.c_str(), err.to_string());
-        return nullptr;
+        return false;
     }
 
     if (info.app_type != app_type) {
         derror("unmatched app type %s for %s", info.app_type.c_str(), path.c_str());
-        return nullptr;
+        return false;
     }
 
     if (info.partition_count < pidx) {
@@ -166,12 +164,51 @@ error_code replica::initialize_on_load()
                  "ignore it",
                  pid,
                  info.partition_count);
+        return false;
+    }
+    return true;
+}
+
+/*static*/ bool replica::load_cold(const char *dir,
+                                   uint64_t idle_threshold_ms,
+                                   /*out*/ app_info &app,
+                                   /*out*/ replica_info &info)
+{
+    // the snapshot is only there after a clean shutdown, with which the private log alone covers
+    // the replica, so it needn't take part in the replay of the shared log
+    replica_shutdown_snapshot snapshot;
+    if (snapshot.load(dir) != ERR_OK || snapshot.idle_ms < idle_threshold_ms) {
+        return false;
+    }
+
+    gpid pid;
+    if (!load_app_info(dir, pid, app)) {
+        return false;
+    }
+
+    info.pid = pid;
+    info.ballot = snapshot.ballot;
+    info.status = partition_status::PS_INACTIVE;
+    info.last_committed_decree = snapshot.committed_decree;
+    info.last_prepared_decree = snapshot.plog_max_decree;
+    info.last_durable_decree = snapshot.committed_decree;
+    info.app_type = app.app_type;
+    return true;
+}
+
+/*static*/ replica *replica::load(replica_stub *stub, const char *dir)
+{
+    FAIL_POINT_INJECT_F("mock_replica_load", [&](string_view) -> replica * { return nullptr; });
+
+    gpid pid;
+    dsn::app_info info;
+    if (!load_app_info(dir, pid, info)) {
         return nullptr;
     }
 
     replica *rep = new replica(stub, pid, info, dir, false);
 
-    err = rep->initialize_on_load();
+    error_code err = rep->initialize_on_load();
     if (err == ERR_OK) {
         ddebug("%s: load replica succeed", rep->name());
         return rep;
@@ -211,11 +248,18 @@ error_code replica::init_app_and_prepare_list(bool create_new)
     error_code err;
     std::string log_dir = utils::filesystem::path_combine(dir(), "plog");
 
+    // the app may read the files of the cold tier when it's opened
+    err = init_cold_tier_cache();
+    if (err != ERR_OK) {
+        derror_replica("init cold tier cache failed, err = {}", err);
+        return err;
+    }
+
     _app.reset(replication_app_base::new_storage_instance(_app_info.app_type, this));
     dassert(nullptr == _private_log, "private log must not be initialized yet");
 
     if (create_new) {
-        err = _app->open_new_internal(this, _stub->_log->on_partition_reset(get_gpid(), 0), 0);
+        err = _app->open_new_internal(this, shared_log()->on_partition_reset(get_gpid(), 0), 0);
         // two case:
         //      1, just open a new app, in this case, the last_committed_decree and
         //      last_durable_decree
@@ -227,6 +271,10 @@ error_code replica::init_app_and_prepare_list(bool create_new)
         //         in prepare_list is 0, so should make it equal to last_committed_decree in app
         _prepare_list->reset(_app->last_committed_decree());
     } else {
+        // always consume the snapshot here, it must never outlive the run it was made for
+        replica_shutdown_snapshot snapshot;
+        error_code snapshot_err = snapshot.load_and_remove(dir());
+
         err = _app->open_internal(this);
         if (err == ERR_OK) {
             dassert(_app->last_committed_decree() == _app->last_durable_decree(),
@@ -247,7 +295,7 @@ error_code replica::init_app_and_prepare_list(bool create_new)
             ddebug("%s: plog_dir = %s", name(), log_dir.c_str());
 
             // sync valid_start_offset between app and logs
-            _stub->_log->set_valid_start_offset_on_open(
+            shared_log()->set_valid_start_offset_on_open(
                 get_gpid(), _app->init_info().init_offset_in_shared_log);
             _private_log->set_valid_start_offset_on_open(
                 get_gpid(), _app->init_info().init_offset_in_private_log);
@@ -259,7 +307,10 @@ error_code replica::init_app_and_prepare_list(bool create_new)
 
                 uint64_t start_time = dsn_now_ms();
                 err = _private_log->open(
-                    [this](int log_length, mutation_ptr &mu) { return replay_mutation(mu, true); },
+                    [this](int log_length, mutation_ptr &mu) {
+                        _resource_usage.on_plog_read(log_length);
+                        return replay_mutation(mu, true);
+                    },
                     [this](error_code err) {
                         tasking::enqueue(LPC_REPLICATION_ERROR,
                                          &_tracker,
@@ -291,6 +342,15 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                     _private_log->check_valid_start_offset(
                         get_gpid(), _app->init_info().init_offset_in_private_log);
 
+                    if (snapshot_err == ERR_OK &&
+                        snapshot.committed_decree == _app->last_durable_decree() &&
+                        snapshot.plog_max_decree == _private_log->max_decree(get_gpid())) {
+                        _plog_complete_decree = snapshot.plog_max_decree;
+                        ddebug_replica("private log is complete since clean shutdown, skip "
+                                       "replaying shared log before decree {}",
+                                       _plog_complete_decree);
+                    }
+
                     set_inactive_state_transient(true);
                 }
                 /* in the beginning the prepare_list is reset to the durable_decree */
@@ -312,7 +372,7 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                     _private_log->close();
                     _private_log = nullptr;
 
-                    _stub->_log->on_partition_removed(get_gpid());
+                    shared_log()->on_partition_removed(get_gpid());
                 }
             }
         }
@@ -450,6 +510,7 @@ bool replica::replay_mutation(mutation_ptr &mu, bool is_private)
 
     // prepare
     _uniq_timestamp_us.try_update(mu->data.header.timestamp);
+    charge_mutation_memory(mu);
     error_code err = _prepare_list->prepare(mu, partition_status::PS_INACTIVE);
     dcheck_eq_replica(err, ERR_OK);
 
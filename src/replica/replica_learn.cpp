@@ -37,15 +37,131 @@
 #include "mutation.h"
 #include "mutation_log.h"
 #include "replica_stub.h"
+#include "async_file_deleter.h"
+#include "learn_copy_join.h"
 #include "replica/duplication/replica_duplicator_manager.h"
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/nfs_node.h>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                learn_app_with_private_logs,
+                false,
+                "whether to copy the private logs following the checkpoint along with it "
+                "while learning app, so that the catch-up overlaps with the checkpoint copy");
+
+DSN_DEFINE_bool("replication",
+                learn_app_delta_enabled,
+                false,
+                "whether the learner reports its local files so that LT_APP only copies the "
+                "checkpoint files it doesn't have, which are only reused if their md5 match");
+
+namespace {
+
+// the urgency of the learn of app told by the learnee, which is of an old version if they are
+// not set, and the learn is taken as the least urgent one
+learn_scheduler::urgency get_learn_urgency(const learn_response &resp)
+{
+    if (!resp.__isset.replica_count) {
+        return {std::numeric_limits<int>::max(), 0};
+    }
+    int max_replica_count = resp.__isset.max_replica_count ? resp.max_replica_count : 0;
+    return {resp.replica_count, std::max(max_replica_count - resp.replica_count, 0)};
+}
+
+// ${replica_dir}/learn.plog, where the private logs of a LT_APP round are copied to, apart
+// from the checkpoint in learn_dir() which is moved as a whole by apply_checkpoint
+std::string learn_log_dir(const std::string &replica_dir)
+{
+    return utils::filesystem::path_combine(replica_dir, "learn.plog");
+}
+
+// Removes the files in learn_dir other than those to copy, which are kept along with their
+// copy progress if the last round failed midway, so that nfs resumes copying them.
+bool prune_learn_dir(const std::string &learn_dir, const std::vector<std::string> &files)
+{
+    if (!utils::filesystem::directory_exists(learn_dir)) {
+        return true;
+    }
+
+    std::unordered_set<std::string> kept;
+    for (const auto &file : files) {
+        auto path = utils::filesystem::path_combine(learn_dir, file);
+        kept.insert(path + nfs_node::kCopyProgressSuffix);
+        kept.insert(std::move(path));
+    }
+
+    std::vector<std::string> local_files;
+    if (!utils::filesystem::get_subfiles(learn_dir, local_files, true)) {
+        return false;
+    }
+    for (const auto &file : local_files) {
+        if (kept.count(file) == 0 && !utils::filesystem::remove_path(file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_local_file_unchanged(const std::string &path, const file_meta &meta)
+{
+    int64_t size = 0;
+    if (!utils::filesystem::file_size(path, size) || size != meta.size) {
+        return false;
+    }
+    std::string md5;
+    return !meta.md5.empty() && utils::filesystem::md5sum(path, md5) == ERR_OK && md5 == meta.md5;
+}
+
+// Lists the files under `data_dir` with their paths relative to it.
+std::vector<file_meta> list_local_checkpoint_files(const std::string &data_dir)
+{
+    std::vector<file_meta> metas;
+    std::vector<std::string> files;
+    if (!utils::filesystem::get_subfiles(data_dir, files, true)) {
+        dwarn_f("list files of {} failed", data_dir);
+        return metas;
+    }
+
+    metas.reserve(files.size());
+    std::vector<std::string> md5_files;
+    for (const auto &file : files) {
+        file_meta meta;
+        if (file.compare(0, data_dir.length() + 1, data_dir + "/") != 0 ||
+            !utils::filesystem::file_size(file, meta.size)) {
+            continue;
+        }
+        md5_files.emplace_back(file);
+        meta.name = file.substr(data_dir.length() + 1);
+        metas.emplace_back(std::move(meta));
+    }
+
+    // the checksums are computed in parallel, the files whose checksums fail are left out
+    std::vector<std::string> md5s;
+    utils::filesystem::md5sum_files(md5_files, md5s);
+    for (size_t i = 0; i < metas.size(); ++i) {
+        metas[i].md5 = std::move(md5s[i]);
+    }
+    metas.erase(std::remove_if(metas.begin(),
+                               metas.end(),
+                               [](const file_meta &meta) { return meta.md5.empty(); }),
+                metas.end());
+    return metas;
+}
+
+} // anonymous namespace
+
 void replica::init_learn(uint64_t signature)
 {
     _checker.only_one_thread_access();
@@ -178,7 +294,7 @@ void replica::init_learn(uint64_t signature)
     }
 
     if (_app->last_committed_decree() == 0 &&
-        _stub->_learn_app_concurrent_count.load() >= _options->learn_app_max_concurrent_count) {
+        _stub->_learn_scheduler.is_full(_options->learn_app_max_concurrent_count)) {
         dwarn("%s: init_learn[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
               "ms, need to learn app because app_committed_decree = 0, but "
               "learn_app_concurrent_count(%d) >= learn_app_max_concurrent_count(%d), skip",
@@ -186,11 +302,21 @@ void replica::init_learn(uint64_t signature)
               _potential_secondary_states.learning_version,
               _config.primary.to_string(),
               _potential_secondary_states.duration_ms(),
-              _stub->_learn_app_concurrent_count.load(),
+              _stub->_learn_scheduler.running_count(),
               _options->learn_app_max_concurrent_count);
         return;
     }
 
+    if (replica_memory_budget::enabled() &&
+        _stub->memory_budget().is_throttled(memory_subsystem::LEARN)) {
+        dwarn_replica("init_learn[{:#018x}]: learnee = {}, learn memory({}) over budget, skip",
+                      _potential_secondary_states.learning_version,
+                      _config.primary.to_string(),
+                      _stub->memory_budget().usage(memory_subsystem::LEARN));
+        _stub->memory_budget().on_throttled();
+        return;
+    }
+
     _stub->_counter_replicas_learning_recent_round_start_count->increment();
     _potential_secondary_states.learning_round_is_running = true;
 
@@ -202,6 +328,11 @@ void replica::init_learn(uint64_t signature)
     request.learner = _stub->_primary_address;
     request.signature = _potential_secondary_states.learning_version;
     _app->prepare_get_checkpoint(request.app_specific_learn_request);
+    // LT_APP is only chosen before the learner starts to receive prepares
+    if (FLAGS_learn_app_delta_enabled &&
+        _potential_secondary_states.learning_status == learner_status::LearningWithoutPrepare) {
+        request.__set_checkpoint_files(list_local_checkpoint_files(_app->data_dir()));
+    }
 
     ddebug("%s: init_learn[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
            " ms, max_gced_decree = %" PRId64 ", local_committed_decree = %" PRId64 ", "
@@ -338,6 +469,9 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
 
     // but just set state to partition_status::PS_POTENTIAL_SECONDARY
     _primary_states.get_replica_config(partition_status::PS_POTENTIAL_SECONDARY, response.config);
+    response.__set_replica_count(
+        static_cast<int32_t>(_primary_states.membership.secondaries.size()) + 1);
+    response.__set_max_replica_count(_primary_states.membership.max_replica_count);
 
     auto it = _primary_states.learners.find(request.learner);
     if (it == _primary_states.learners.end()) {
@@ -535,13 +669,41 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
                     response.state.meta.length(),
                     static_cast<uint32_t>(response.state.files.size()),
                     response.state.to_decree_included);
+
+                if (request.__isset.checkpoint_files) {
+                    reuse_learner_checkpoint_files(request, response);
+                }
+
+                // logs for duplication must be learned from the confirmed decree, which is
+                // left to the LT_LOG rounds
+                if (FLAGS_learn_app_with_private_logs && !is_duplicating()) {
+                    attach_private_logs_to_checkpoint(request, response);
+                }
             }
         }
     }
 
+    // the files are shipped to the learner by the nfs later, they are accounted here as the
+    // nfs knows nothing about the partitions
+    uint64_t served_bytes = response.state.meta.length();
     for (auto &file : response.state.files) {
+        int64_t size = 0;
+        if (utils::filesystem::file_size(file, size)) {
+            served_bytes += size;
+        }
         file = file.substr(response.base_local_dir.length() + 1);
     }
+    if (response.__isset.log_state) {
+        served_bytes += response.log_state.meta.length();
+        for (const auto &file : response.log_state.files) {
+            int64_t size = 0;
+            if (utils::filesystem::file_size(
+                    utils::filesystem::path_combine(response.log_base_local_dir, file), size)) {
+                served_bytes += size;
+            }
+        }
+    }
+    _resource_usage.on_learn_served(served_bytes);
 
     reply(msg, response);
 
@@ -588,6 +750,10 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
            enum_to_string(_potential_secondary_states.learning_status));
 
     _potential_secondary_states.learning_copy_buffer_size += resp.state.meta.length();
+    if (replica_memory_budget::enabled()) {
+        _potential_secondary_states.charge_learn_memory(resp.state.meta.length());
+    }
+    _resource_usage.on_learn_received(resp.state.meta.length());
     _stub->_counter_replicas_learning_recent_copy_buffer_size->add(resp.state.meta.length());
 
     if (resp.err != ERR_OK) {
@@ -678,7 +844,7 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
 
         if (err == ERR_OK) {
             err = _app->open_new_internal(this,
-                                          _stub->_log->on_partition_reset(get_gpid(), 0),
+                                          shared_log()->on_partition_reset(get_gpid(), 0),
                                           _private_log->on_partition_reset(get_gpid(), 0));
 
             if (err != ERR_OK) {
@@ -717,26 +883,31 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     }
 
     if (resp.type == learn_type::LT_APP) {
-        if (++_stub->_learn_app_concurrent_count > _options->learn_app_max_concurrent_count) {
-            --_stub->_learn_app_concurrent_count;
+        learn_scheduler::urgency u = get_learn_urgency(resp);
+        if (!_stub->_learn_scheduler.try_admit(
+                get_gpid(), u, _options->learn_app_max_concurrent_count, dsn_now_ms())) {
             dwarn("%s: on_learn_reply[%016" PRIx64
-                  "]: learnee = %s, learn_app_concurrent_count(%d) >= "
-                  "learn_app_max_concurrent_count(%d), skip this round",
+                  "]: learnee = %s, replica_count = %d, missing_count = %d, "
+                  "learn_app_concurrent_count(%d) >= learn_app_max_concurrent_count(%d) or more "
+                  "urgent learns are waiting, skip this round",
                   name(),
                   _potential_secondary_states.learning_version,
                   _config.primary.to_string(),
-                  _stub->_learn_app_concurrent_count.load(),
+                  u.replica_count,
+                  u.missing_count,
+                  _stub->_learn_scheduler.running_count(),
                   _options->learn_app_max_concurrent_count);
             _potential_secondary_states.learning_round_is_running = false;
             return;
         } else {
             _potential_secondary_states.learn_app_concurrent_count_increased = true;
             ddebug("%s: on_learn_reply[%016" PRIx64
-                   "]: learnee = %s, ++learn_app_concurrent_count = %d",
+                   "]: learnee = %s, replica_count = %d, ++learn_app_concurrent_count = %d",
                    name(),
                    _potential_secondary_states.learning_version,
                    _config.primary.to_string(),
-                   _stub->_learn_app_concurrent_count.load());
+                   u.replica_count,
+                   _stub->_learn_scheduler.running_count());
         }
     }
 
@@ -774,7 +945,7 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
         // appended by the mutations AFTER current position
         err = _app->update_init_info(
             this,
-            _stub->_log->on_partition_reset(get_gpid(), _app->last_committed_decree()),
+            shared_log()->on_partition_reset(get_gpid(), _app->last_committed_decree()),
             _private_log->on_partition_reset(get_gpid(), _app->last_committed_decree()),
             _app->last_committed_decree());
 
@@ -806,7 +977,7 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
 
                 // write to shared log with no callback, the later 2pc ensures that logs
                 // are written to the disk
-                _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
+                shared_log()->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
 
                 // because shared log are written without callback, need to manully
                 // set flag and write mutations to private log
@@ -828,6 +999,7 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
                            mu->name(),
                            existing_mutation->data.header.ballot);
                 } else {
+                    charge_mutation_memory(mu);
                     _prepare_list->prepare(mu, partition_status::PS_POTENTIAL_SECONDARY);
                 }
 
@@ -883,9 +1055,11 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
         _potential_secondary_states.learn_remote_files_task->enqueue();
     }
 
-    else if (resp.state.files.size() > 0) {
+    else if (resp.state.files.size() > 0 || !resp.reused_files.empty()) {
         auto learn_dir = _app->learn_dir();
-        utils::filesystem::remove_path(learn_dir);
+        if (!prune_learn_dir(learn_dir, resp.state.files)) {
+            async_file_deleter::instance().remove_path(learn_dir);
+        }
         utils::filesystem::create_directory(learn_dir);
 
         if (!dsn::utils::filesystem::directory_exists(learn_dir)) {
@@ -913,16 +1087,95 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
             return;
         }
 
-        bool high_priority = (resp.type == learn_type::LT_APP ? false : true);
+        if (!resp.reused_files.empty()) {
+            link_reused_checkpoint_files(req, resp);
+        }
+
+        // the learns of app of the partitions at risk preempt the bandwidth of the others
+        bool high_priority = resp.type != learn_type::LT_APP ||
+                             learn_scheduler::is_urgent(get_learn_urgency(resp));
         ddebug("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
-               " ms, start to copy remote files, copy_file_count = %d, priority = %s",
+               " ms, start to copy remote files, copy_file_count = %d, reused_file_count = %d, "
+               "priority = %s",
                name(),
                req.signature,
                resp.config.primary.to_string(),
                _potential_secondary_states.duration_ms(),
                static_cast<int>(resp.state.files.size()),
+               static_cast<int>(resp.reused_files.size()),
                high_priority ? "high" : "low");
 
+        // copy the private logs following the checkpoint concurrently with it, they are
+        // applied right after the checkpoint in on_copy_remote_state_completed
+        bool copy_checkpoint = !resp.state.files.empty();
+        auto join = std::make_shared<learn_copy_join>(1);
+        if (resp.__isset.log_state && !resp.log_state.files.empty()) {
+            auto log_dir = learn_log_dir(dir());
+            utils::filesystem::remove_path(log_dir);
+            utils::filesystem::create_directory(log_dir);
+            if (!utils::filesystem::directory_exists(log_dir)) {
+                dwarn("%s: on_learn_reply[%016" PRIx64
+                      "]: learnee = %s, create replica learn log dir %s failed, "
+                      "learn the private logs in later rounds",
+                      name(),
+                      req.signature,
+                      resp.config.primary.to_string(),
+                      log_dir.c_str());
+                resp.__isset.log_state = false;
+            } else {
+                ddebug("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, start to copy remote "
+                       "private logs along with the checkpoint, copy_file_count = %d",
+                       name(),
+                       req.signature,
+                       resp.config.primary.to_string(),
+                       static_cast<int>(resp.log_state.files.size()));
+                join = std::make_shared<learn_copy_join>(copy_checkpoint ? 2 : 1);
+                _potential_secondary_states.learn_remote_logs_task =
+                    _stub->_nfs->copy_remote_files(
+                        resp.config.primary,
+                        resp.log_base_local_dir,
+                        resp.log_state.files,
+                        log_dir,
+                        true, // overwrite
+                        high_priority,
+                        LPC_REPLICATION_COPY_REMOTE_FILES,
+                        &_tracker,
+                        [
+                          this,
+                          join,
+                          copy_start = _potential_secondary_states.duration_ms(),
+                          req_copy = req,
+                          resp_copy = resp
+                        ](error_code err, size_t sz) mutable {
+                            if (join->finish(err, sz)) {
+                                on_copy_remote_state_completed(join->err(),
+                                                               join->size(),
+                                                               copy_start,
+                                                               std::move(req_copy),
+                                                               std::move(resp_copy));
+                            }
+                        });
+            }
+        }
+
+        if (!copy_checkpoint) {
+            // all the checkpoint files are reused locally
+            if (_potential_secondary_states.learn_remote_logs_task == nullptr) {
+                _potential_secondary_states.learn_remote_files_task =
+                    tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES, &_tracker, [
+                        this,
+                        copy_start = _potential_secondary_states.duration_ms(),
+                        req_cap = std::move(req),
+                        resp_cap = std::move(resp)
+                    ]() mutable {
+                        on_copy_remote_state_completed(
+                            ERR_OK, 0, copy_start, std::move(req_cap), std::move(resp_cap));
+                    });
+                _potential_secondary_states.learn_remote_files_task->enqueue();
+            }
+            return;
+        }
+
         _potential_secondary_states.learn_remote_files_task = _stub->_nfs->copy_remote_files(
             resp.config.primary,
             resp.base_local_dir,
@@ -934,12 +1187,18 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
             &_tracker,
             [
               this,
+              join,
               copy_start = _potential_secondary_states.duration_ms(),
               req_cap = std::move(req),
               resp_copy = resp
             ](error_code err, size_t sz) mutable {
-                on_copy_remote_state_completed(
-                    err, sz, copy_start, std::move(req_cap), std::move(resp_copy));
+                if (join->finish(err, sz)) {
+                    on_copy_remote_state_completed(join->err(),
+                                                   join->size(),
+                                                   copy_start,
+                                                   std::move(req_cap),
+                                                   std::move(resp_copy));
+                }
             });
     } else {
         _potential_secondary_states.learn_remote_files_task =
@@ -956,6 +1215,148 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     }
 }
 
+void replica::reuse_learner_checkpoint_files(const learn_request &request,
+                                             /*out*/ learn_response &response)
+{
+    // base name => the learner's file, the same file may reside in several checkpoints
+    std::unordered_multimap<std::string, const file_meta *> learner_files;
+    for (const auto &meta : request.checkpoint_files) {
+        learner_files.emplace(utils::filesystem::get_file_name(meta.name), &meta);
+    }
+
+    std::vector<std::string> copy_files;
+    int64_t reused_size = 0;
+    for (auto &file : response.state.files) {
+        int64_t size = 0;
+        if (!utils::filesystem::file_size(file, size)) {
+            copy_files.emplace_back(std::move(file));
+            continue;
+        }
+
+        std::string md5;
+        const file_meta *reused = nullptr;
+        auto range = learner_files.equal_range(utils::filesystem::get_file_name(file));
+        for (auto it = range.first; it != range.second && reused == nullptr; ++it) {
+            const file_meta *meta = it->second;
+            // a different file of the same name and size would corrupt the checkpoint
+            if (meta->size != size || meta->md5.empty()) {
+                continue;
+            }
+            if (md5.empty() && utils::filesystem::md5sum(file, md5) != ERR_OK) {
+                break;
+            }
+            if (meta->md5 == md5) {
+                reused = meta;
+            }
+        }
+
+        if (reused == nullptr) {
+            copy_files.emplace_back(std::move(file));
+        } else {
+            response.reused_files[file.substr(response.base_local_dir.length() + 1)] =
+                reused->name;
+            reused_size += size;
+        }
+    }
+    response.state.files = std::move(copy_files);
+    response.__isset.reused_files = !response.reused_files.empty();
+
+    ddebug("%s: on_learn[%016" PRIx64 "]: learner = %s, reuse learner's checkpoint files, "
+           "learner_file_count = %u, reused_file_count = %u, reused_file_size = %" PRId64
+           ", copy_file_count = %u",
+           name(),
+           request.signature,
+           request.learner.to_string(),
+           static_cast<uint32_t>(request.checkpoint_files.size()),
+           static_cast<uint32_t>(response.reused_files.size()),
+           reused_size,
+           static_cast<uint32_t>(response.state.files.size()));
+}
+
+void replica::link_reused_checkpoint_files(const learn_request &req,
+                                           /*inout*/ learn_response &resp)
+{
+    std::unordered_map<std::string, const file_meta *> local_files;
+    for (const auto &meta : req.checkpoint_files) {
+        local_files.emplace(meta.name, &meta);
+    }
+
+    // the local files may have changed or gone since they were reported, copy them instead
+    auto learn_dir = _app->learn_dir();
+    for (auto it = resp.reused_files.begin(); it != resp.reused_files.end();) {
+        auto src = utils::filesystem::path_combine(_app->data_dir(), it->second);
+        auto target = utils::filesystem::path_combine(learn_dir, it->first);
+        auto target_dir = utils::filesystem::remove_file_name(target);
+
+        bool linked = false;
+        auto meta = local_files.find(it->second);
+        if (meta != local_files.end() && is_local_file_unchanged(src, *meta->second) &&
+            (utils::filesystem::directory_exists(target_dir) ||
+             utils::filesystem::create_directory(target_dir))) {
+            linked = utils::filesystem::link_file(src, target);
+        }
+
+        if (linked) {
+            ++it;
+        } else {
+            dwarn("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, link reused file %s to %s "
+                  "failed, copy it from learnee instead",
+                  name(),
+                  req.signature,
+                  resp.config.primary.to_string(),
+                  src.c_str(),
+                  target.c_str());
+            resp.state.files.push_back(it->first);
+            it = resp.reused_files.erase(it);
+        }
+    }
+}
+
+void replica::attach_private_logs_to_checkpoint(const learn_request &request,
+                                                /*out*/ learn_response &response)
+{
+    decree log_start_decree = response.state.to_decree_included + 1;
+    decree local_committed_decree = last_committed_decree();
+    if (log_start_decree > local_committed_decree) {
+        return;
+    }
+
+    // the logs must cover all the decrees following the checkpoint, or the learner would
+    // have a gap in between
+    learn_state log_state;
+    if (!_private_log->get_learn_state(get_gpid(), log_start_decree, log_state)) {
+        ddebug("%s: on_learn[%016" PRIx64 "]: learner = %s, private logs do not cover "
+               "decree %" PRId64 " following the checkpoint, learn them in later rounds",
+               name(),
+               request.signature,
+               request.learner.to_string(),
+               log_start_decree);
+        return;
+    }
+
+    const std::string &log_dir = _private_log->dir();
+    for (auto &file : log_state.files) {
+        file = file.substr(log_dir.length() + 1);
+    }
+    log_state.from_decree_excluded = response.state.to_decree_included;
+    // it is safe to commit to last_committed_decree() now
+    log_state.to_decree_included = local_committed_decree;
+
+    ddebug("%s: on_learn[%016" PRIx64 "]: learner = %s, attach private logs to checkpoint, "
+           "learned_meta_size = %u, learned_file_count = %u, decree_range = (%" PRId64
+           ", %" PRId64 "]",
+           name(),
+           request.signature,
+           request.learner.to_string(),
+           log_state.meta.length(),
+           static_cast<uint32_t>(log_state.files.size()),
+           log_state.from_decree_excluded,
+           log_state.to_decree_included);
+
+    response.__set_log_state(std::move(log_state));
+    response.__set_log_base_local_dir(log_dir);
+}
+
 bool replica::prepare_cached_learn_state(const learn_request &request,
                                          decree learn_start_decree,
                                          decree local_committed_decree,
@@ -1052,20 +1453,25 @@ void replica::on_copy_remote_state_completed(error_code err,
            enum_to_string(_potential_secondary_states.learning_status));
 
     if (resp.type == learn_type::LT_APP) {
-        --_stub->_learn_app_concurrent_count;
+        _stub->_learn_scheduler.release(get_gpid());
         _potential_secondary_states.learn_app_concurrent_count_increased = false;
         ddebug("%s: on_copy_remote_state_completed[%016" PRIx64
                "]: learnee = %s, --learn_app_concurrent_count = %d",
                name(),
                _potential_secondary_states.learning_version,
                _config.primary.to_string(),
-               _stub->_learn_app_concurrent_count.load());
+               _stub->_learn_scheduler.running_count());
     }
 
     if (err == ERR_OK) {
-        _potential_secondary_states.learning_copy_file_count += resp.state.files.size();
+        size_t file_count = resp.state.files.size();
+        if (resp.__isset.log_state) {
+            file_count += resp.log_state.files.size();
+        }
+        _potential_secondary_states.learning_copy_file_count += file_count;
         _potential_secondary_states.learning_copy_file_size += size;
-        _stub->_counter_replicas_learning_recent_copy_file_count->add(resp.state.files.size());
+        _resource_usage.on_learn_received(size);
+        _stub->_counter_replicas_learning_recent_copy_file_count->add(file_count);
         _stub->_counter_replicas_learning_recent_copy_file_size->add(size);
     }
 
@@ -1092,6 +1498,9 @@ void replica::on_copy_remote_state_completed(error_code err,
             std::string file = utils::filesystem::path_combine(_app->learn_dir(), f);
             lstate.files.push_back(file);
         }
+        for (auto &kv : resp.reused_files) {
+            lstate.files.push_back(utils::filesystem::path_combine(_app->learn_dir(), kv.first));
+        }
 
         // apply app learning
         if (resp.type == learn_type::LT_APP) {
@@ -1120,6 +1529,10 @@ void replica::on_copy_remote_state_completed(error_code err,
                        _potential_secondary_states.duration_ms(),
                        dsn_now_ns() - start_ts,
                        _app->last_committed_decree());
+
+                if (resp.__isset.log_state) {
+                    err = apply_learned_logs_of_checkpoint(req, resp);
+                }
             } else {
                 derror("%s: on_copy_remote_state_completed[%016" PRIx64
                        "]: learnee = %s, learn_duration = %" PRIu64 " ms, "
@@ -1225,6 +1638,7 @@ void replica::on_copy_remote_state_completed(error_code err,
     // so that we don't have unnecessary failed reconfiguration later due to this non-nullptr in
     // cleanup
     _potential_secondary_states.learn_remote_files_task = nullptr;
+    _potential_secondary_states.learn_remote_logs_task = nullptr;
 
     _potential_secondary_states.learn_remote_files_completed_task =
         tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES_COMPLETED,
@@ -1266,6 +1680,9 @@ void replica::on_learn_remote_state_completed(error_code err)
            enum_to_string(_potential_secondary_states.learning_status));
 
     _potential_secondary_states.learning_round_is_running = false;
+    if (_potential_secondary_states.learn_memory_bytes != 0) {
+        _potential_secondary_states.charge_learn_memory(0);
+    }
 
     if (err != ERR_OK) {
         handle_learning_error(err, true);
@@ -1318,6 +1735,11 @@ error_code replica::handle_learning_succeeded_on_primary(::dsn::rpc_address node
         return ERR_INVALID_STATE;
     }
 
+    if (it->second.non_voting) {
+        // a read replica keeps learning by the prepares as a potential secondary
+        return ERR_OK;
+    }
+
     upgrade_to_secondary_on_primary(node);
     return ERR_OK;
 }
@@ -1498,10 +1920,53 @@ void replica::on_add_learner(const group_check_request &request)
                 "invalid partition_status, status = %s",
                 enum_to_string(status()));
         init_learn(request.config.learner_signature);
+        _potential_secondary_states.non_voting = request.config.non_voting;
     }
 }
 
 // in non-replication thread
+error_code replica::apply_learned_logs_of_checkpoint(const learn_request &req,
+                                                     const learn_response &resp)
+{
+    auto log_dir = learn_log_dir(dir());
+    learn_state lstate;
+    lstate.from_decree_excluded = resp.log_state.from_decree_excluded;
+    lstate.to_decree_included = resp.log_state.to_decree_included;
+    lstate.meta = resp.log_state.meta;
+    for (auto &f : resp.log_state.files) {
+        lstate.files.push_back(utils::filesystem::path_combine(log_dir, f));
+    }
+
+    auto start_ts = dsn_now_ns();
+    error_code err = apply_learned_state_from_private_log(lstate);
+    if (err == ERR_OK) {
+        ddebug("%s: on_copy_remote_state_completed[%016" PRIx64
+               "]: learnee = %s, learn_duration = %" PRIu64 " ms, "
+               "apply_log_duration = %" PRIu64 " ns, apply private logs following the "
+               "checkpoint succeed, app_committed_decree = %" PRId64,
+               name(),
+               req.signature,
+               resp.config.primary.to_string(),
+               _potential_secondary_states.duration_ms(),
+               dsn_now_ns() - start_ts,
+               _app->last_committed_decree());
+    } else {
+        derror("%s: on_copy_remote_state_completed[%016" PRIx64
+               "]: learnee = %s, learn_duration = %" PRIu64 " ms, "
+               "apply_log_duration = %" PRIu64 " ns, apply private logs following the "
+               "checkpoint failed, err = %s",
+               name(),
+               req.signature,
+               resp.config.primary.to_string(),
+               _potential_secondary_states.duration_ms(),
+               dsn_now_ns() - start_ts,
+               err.to_string());
+    }
+
+    utils::filesystem::remove_path(log_dir);
+    return err;
+}
+
 error_code replica::apply_learned_state_from_private_log(learn_state &state)
 {
     bool duplicating = is_duplicating();
@@ -0,0 +1,258 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica_map.h"
+#include "replica.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace dsn {
+namespace replication {
+
+namespace {
+
+// The hazard pointers of a thread: one for the index and one for the replica it reads. The
+// records are never freed, a record is reused by another thread after its thread exits.
+struct hazard_record
+{
+    std::atomic<const void *> index{nullptr};
+    std::atomic<const void *> replica{nullptr};
+    std::atomic<bool> active{false};
+    hazard_record *next{nullptr};
+};
+
+std::atomic<hazard_record *> s_hazard_records{nullptr};
+
+hazard_record *acquire_hazard_record()
+{
+    for (hazard_record *r = s_hazard_records.load(); r != nullptr; r = r->next) {
+        bool expected = false;
+        if (!r->active.load(std::memory_order_relaxed) &&
+            r->active.compare_exchange_strong(expected, true)) {
+            return r;
+        }
+    }
+
+    hazard_record *r = new hazard_record();
+    r->active.store(true, std::memory_order_relaxed);
+    hazard_record *head = s_hazard_records.load();
+    do {
+        r->next = head;
+    } while (!s_hazard_records.compare_exchange_weak(head, r));
+    return r;
+}
+
+struct thread_hazard_record
+{
+    thread_hazard_record() : record(acquire_hazard_record()) {}
+    ~thread_hazard_record() { record->active.store(false, std::memory_order_release); }
+    hazard_record *record;
+};
+
+hazard_record *local_hazard_record()
+{
+    static thread_local thread_hazard_record r;
+    return r.record;
+}
+
+// waits until no reader protects `p`, the readers only hold a hazard pointer for a few
+// instructions
+void wait_for_readers(const void *p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    for (hazard_record *r = s_hazard_records.load(); r != nullptr; r = r->next) {
+        while (r->index.load() == p || r->replica.load() == p) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t round_up_power_of_two(size_t n)
+{
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+replica_map::app_partitions::app_partitions(size_t count)
+    : slots(new std::atomic<replica *>[count]), count(count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+replica_map::replica_map() : _index(new index()) {}
+
+replica_map::~replica_map() { delete _index.load(); }
+
+replica_ptr replica_map::get(gpid id) const
+{
+    hazard_record *h = local_hazard_record();
+    index *idx;
+    do {
+        idx = _index.load();
+        h->index.store(idx);
+    } while (idx != _index.load());
+
+    replica *r = nullptr;
+    auto app_id = static_cast<size_t>(id.get_app_id());
+    auto pidx = static_cast<size_t>(id.get_partition_index());
+    if (app_id < idx->apps.size() && idx->apps[app_id] != nullptr &&
+        pidx < idx->apps[app_id]->count) {
+        std::atomic<replica *> &slot = idx->apps[app_id]->slots[pidx];
+        do {
+            r = slot.load();
+            h->replica.store(r);
+        } while (r != slot.load());
+    }
+
+    // the map holds a reference of `r` until no hazard pointer points to it
+    replica_ptr result(r);
+    h->replica.store(nullptr, std::memory_order_release);
+    h->index.store(nullptr, std::memory_order_release);
+    return result;
+}
+
+std::atomic<replica *> *replica_map::slot_of(gpid id) const
+{
+    index *idx = _index.load(std::memory_order_relaxed);
+    auto app_id = static_cast<size_t>(id.get_app_id());
+    auto pidx = static_cast<size_t>(id.get_partition_index());
+    if (app_id < idx->apps.size() && idx->apps[app_id] != nullptr &&
+        pidx < idx->apps[app_id]->count) {
+        return &idx->apps[app_id]->slots[pidx];
+    }
+    return nullptr;
+}
+
+void replica_map::ensure_slot(gpid id)
+{
+    if (slot_of(id) == nullptr) {
+        rebuild_index();
+    }
+}
+
+void replica_map::rebuild_index()
+{
+    std::unique_ptr<index> idx(new index());
+    std::vector<size_t> partition_counts;
+    for (const auto &kv : _map) {
+        if (kv.first.get_app_id() < 0 || kv.first.get_partition_index() < 0) {
+            continue;
+        }
+        auto app_id = static_cast<size_t>(kv.first.get_app_id());
+        if (app_id >= partition_counts.size()) {
+            partition_counts.resize(app_id + 1, 0);
+        }
+        partition_counts[app_id] = std::max(
+            partition_counts[app_id], static_cast<size_t>(kv.first.get_partition_index()) + 1);
+    }
+
+    idx->apps.resize(partition_counts.size());
+    for (size_t i = 0; i < partition_counts.size(); ++i) {
+        if (partition_counts[i] > 0) {
+            // leave room for the partition split, which doubles the partition count
+            idx->apps[i].reset(new app_partitions(round_up_power_of_two(partition_counts[i])));
+        }
+    }
+    for (const auto &kv : _map) {
+        if (kv.first.get_app_id() >= 0 && kv.first.get_partition_index() >= 0) {
+            idx->apps[kv.first.get_app_id()]->slots[kv.first.get_partition_index()].store(
+                kv.second.get(), std::memory_order_relaxed);
+        }
+    }
+
+    index *old = _index.exchange(idx.release());
+    wait_for_readers(old);
+    delete old;
+}
+
+std::pair<replica_map::const_iterator, bool> replica_map::insert(const value_type &kv)
+{
+    auto pr = _map.insert(kv);
+    if (pr.second) {
+        ensure_slot(kv.first);
+        std::atomic<replica *> *slot = slot_of(kv.first);
+        if (slot != nullptr) {
+            slot->store(kv.second.get());
+        }
+    }
+    return std::make_pair(const_iterator(pr.first), pr.second);
+}
+
+void replica_map::assign(gpid id, replica_ptr r)
+{
+    auto it = _map.find(id);
+    if (it == _map.end()) {
+        insert(value_type(id, std::move(r)));
+        return;
+    }
+
+    std::atomic<replica *> *slot = slot_of(id);
+    if (slot != nullptr) {
+        slot->store(r.get());
+    }
+    wait_for_readers(it->second.get());
+    it->second = std::move(r);
+}
+
+size_t replica_map::erase(gpid id)
+{
+    auto it = _map.find(id);
+    if (it == _map.end()) {
+        return 0;
+    }
+    erase(const_iterator(it));
+    return 1;
+}
+
+replica_map::const_iterator replica_map::erase(const_iterator it)
+{
+    std::atomic<replica *> *slot = slot_of(it->first);
+    if (slot != nullptr) {
+        slot->store(nullptr);
+    }
+    wait_for_readers(it->second.get());
+    return _map.erase(it);
+}
+
+void replica_map::clear()
+{
+    // the replicas are released after no reader holds the index pointing to them
+    map_type old;
+    old.swap(_map);
+    rebuild_index();
+}
+
+replica_map &replica_map::operator=(map_type &&m)
+{
+    map_type old(std::move(m));
+    old.swap(_map);
+    rebuild_index();
+    return *this;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,105 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/utility/autoref_ptr.h>
+
+namespace dsn {
+namespace replication {
+
+class replica;
+typedef dsn::ref_ptr<replica> replica_ptr;
+
+// replica_map holds the serving replicas of replica_stub. Besides the gpid -> replica map, it
+// publishes an index of the replicas: a dense vector per app indexed by the partition index,
+// so that get() neither takes a lock nor probes the hash map, which is on the path of every
+// client request and replication rpc.
+//
+// The mutations must be serialized by the caller (replica_stub::_replicas_lock), while get()
+// can run on any thread concurrently. The readers protect the index and the replica they
+// access with hazard pointers, and a mutation waits until no reader holds the index it
+// replaces or the replica it removes before freeing them. Replica open/close is rare, so the
+// writers paying for the reclamation is fine.
+class replica_map
+{
+public:
+    typedef std::unordered_map<gpid, replica_ptr> map_type;
+    typedef map_type::const_iterator const_iterator;
+    typedef map_type::value_type value_type;
+
+    replica_map();
+    ~replica_map();
+
+    replica_map(const replica_map &) = delete;
+    replica_map &operator=(const replica_map &) = delete;
+
+    // lock-free lookup, returns nullptr if there's no such replica
+    replica_ptr get(gpid id) const;
+
+    // the map itself, which should be read under the lock of the writers
+    const map_type &map() const { return _map; }
+    const_iterator begin() const { return _map.begin(); }
+    const_iterator end() const { return _map.end(); }
+    const_iterator find(gpid id) const { return _map.find(id); }
+    size_t size() const { return _map.size(); }
+    bool empty() const { return _map.empty(); }
+
+    std::pair<const_iterator, bool> insert(const value_type &kv);
+    std::pair<const_iterator, bool> emplace(gpid id, replica_ptr r)
+    {
+        return insert(value_type(id, std::move(r)));
+    }
+    // inserts or replaces the replica of `id`
+    void assign(gpid id, replica_ptr r);
+    size_t erase(gpid id);
+    const_iterator erase(const_iterator it);
+    void clear();
+    replica_map &operator=(map_type &&m);
+
+private:
+    struct app_partitions
+    {
+        explicit app_partitions(size_t count);
+        std::unique_ptr<std::atomic<replica *>[]> slots;
+        size_t count;
+    };
+
+    struct index
+    {
+        std::vector<std::unique_ptr<app_partitions>> apps;
+    };
+
+    // returns the slot of `id` in the current index, nullptr if it's out of its range
+    std::atomic<replica *> *slot_of(gpid id) const;
+    // rebuilds the index from `_map` if `id` isn't in the range of the current one
+    void ensure_slot(gpid id);
+    void rebuild_index();
+
+    map_type _map;
+    std::atomic<index *> _index;
+};
+
+} // namespace replication
+} // namespace dsn
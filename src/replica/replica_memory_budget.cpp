@@ -0,0 +1,146 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica_memory_budget.h"
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/flags.h>
+#include <fmt/format.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                memory_budget_enabled,
+                false,
+                "whether to throttle the writes, learns and duplication of the replicas when "
+                "their memory is over memory_budget_total_mb");
+DSN_DEFINE_uint32("replication",
+                  memory_budget_total_mb,
+                  4096,
+                  "the total memory budget of the mutations, learn states and duplication batches "
+                  "of all the replicas on the node");
+DSN_DEFINE_uint32("replication",
+                  memory_budget_mutation_percent,
+                  60,
+                  "the share of the memory budget for the mutations of the prepare lists");
+DSN_DEFINE_uint32("replication",
+                  memory_budget_duplication_percent,
+                  20,
+                  "the share of the memory budget for the mutations loaded for duplication");
+DSN_DEFINE_uint32("replication",
+                  memory_budget_learn_percent,
+                  20,
+                  "the share of the memory budget for the learn states received by the learners");
+DSN_DEFINE_validator(memory_budget_total_mb, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_validator(memory_budget_mutation_percent,
+                     [](uint32_t value) -> bool { return value <= 100; });
+DSN_DEFINE_validator(memory_budget_duplication_percent,
+                     [](uint32_t value) -> bool { return value <= 100; });
+DSN_DEFINE_validator(memory_budget_learn_percent,
+                     [](uint32_t value) -> bool { return value <= 100; });
+
+const int replica_memory_budget::SUBSYSTEM_COUNT;
+
+const char *memory_subsystem_to_string(memory_subsystem s)
+{
+    switch (s) {
+    case memory_subsystem::MUTATION:
+        return "mutation";
+    case memory_subsystem::DUPLICATION:
+        return "duplication";
+    case memory_subsystem::LEARN:
+        return "learn";
+    default:
+        return "invalid";
+    }
+}
+
+/*static*/ bool replica_memory_budget::enabled() { return FLAGS_memory_budget_enabled; }
+
+/*static*/ int64_t replica_memory_budget::total_budget()
+{
+    return FLAGS_memory_budget_total_mb * 1024LL * 1024LL;
+}
+
+/*static*/ int64_t replica_memory_budget::share(memory_subsystem s)
+{
+    uint32_t percent = 0;
+    switch (s) {
+    case memory_subsystem::MUTATION:
+        percent = FLAGS_memory_budget_mutation_percent;
+        break;
+    case memory_subsystem::DUPLICATION:
+        percent = FLAGS_memory_budget_duplication_percent;
+        break;
+    case memory_subsystem::LEARN:
+        percent = FLAGS_memory_budget_learn_percent;
+        break;
+    default:
+        dassert(false, "invalid memory subsystem %d", static_cast<int>(s));
+    }
+    return total_budget() * percent / 100;
+}
+
+void replica_memory_budget::init_perf_counters()
+{
+    for (int i = 0; i < SUBSYSTEM_COUNT; ++i) {
+        const char *name = memory_subsystem_to_string(static_cast<memory_subsystem>(i));
+        _counter_usage_bytes[i].init_app_counter(
+            "eon.replica_stub",
+            fmt::format("memory.budget.{}.bytes", name).c_str(),
+            COUNTER_TYPE_NUMBER,
+            fmt::format("the bytes of the {} memory of the replicas", name).c_str());
+    }
+    _counter_total_usage_bytes.init_app_counter("eon.replica_stub",
+                                                "memory.budget.total.bytes",
+                                                COUNTER_TYPE_NUMBER,
+                                                "the bytes tracked by the memory budget");
+    _counter_recent_throttled_count.init_app_counter(
+        "eon.replica_stub",
+        "recent.memory.budget.throttled.count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "the writes, learns and duplication loads throttled by the memory budget recently");
+}
+
+void replica_memory_budget::update_perf_counters()
+{
+    for (int i = 0; i < SUBSYSTEM_COUNT; ++i) {
+        _counter_usage_bytes[i]->set(usage(static_cast<memory_subsystem>(i)));
+    }
+    _counter_total_usage_bytes->set(total_usage());
+}
+
+void replica_memory_budget::consume(memory_subsystem s, int64_t bytes)
+{
+    _usage[static_cast<int>(s)].fetch_add(bytes, std::memory_order_relaxed);
+    _total_usage.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void replica_memory_budget::release(memory_subsystem s, int64_t bytes)
+{
+    _usage[static_cast<int>(s)].fetch_sub(bytes, std::memory_order_relaxed);
+    _total_usage.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool replica_memory_budget::is_throttled(memory_subsystem s) const
+{
+    return total_usage() >= total_budget() && usage(s) >= share(s);
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+
+namespace dsn {
+namespace replication {
+
+// the subsystems sharing the memory budget of a node
+enum class memory_subsystem
+{
+    // the mutations of the prepare lists, including the ones held by the pending log buffers
+    MUTATION = 0,
+    // the mutations loaded from the private logs for duplication
+    DUPLICATION,
+    // the learn states received by the learners
+    LEARN,
+    COUNT
+};
+
+const char *memory_subsystem_to_string(memory_subsystem s);
+
+// replica_memory_budget tracks the bytes held by the replicas of a node, which are otherwise
+// bounded only by counts, e.g. max_mutation_count_in_prepare_list, so that a table of huge values
+// may take all the memory. Every subsystem has a share of [replication] memory_budget_total_mb,
+// and may use more than its share while the node is under the total budget; once the total is
+// over, the subsystems over their shares are throttled: the client writes are rejected with
+// ERR_BUSY, the learns and the duplication loading are paused, until the memory is released.
+//
+// It is thread-safe.
+class replica_memory_budget
+{
+public:
+    // whether [replication] memory_budget_enabled is on
+    static bool enabled();
+
+    void init_perf_counters();
+    void update_perf_counters();
+
+    void consume(memory_subsystem s, int64_t bytes);
+    void release(memory_subsystem s, int64_t bytes);
+
+    bool is_throttled(memory_subsystem s) const;
+    void on_throttled() { _counter_recent_throttled_count->increment(); }
+
+    int64_t usage(memory_subsystem s) const
+    {
+        return _usage[static_cast<int>(s)].load(std::memory_order_relaxed);
+    }
+    int64_t total_usage() const { return _total_usage.load(std::memory_order_relaxed); }
+
+    static int64_t total_budget();
+    static int64_t share(memory_subsystem s);
+
+private:
+    static const int SUBSYSTEM_COUNT = static_cast<int>(memory_subsystem::COUNT);
+
+    std::atomic<int64_t> _usage[SUBSYSTEM_COUNT]{};
+    std::atomic<int64_t> _total_usage{0};
+
+    perf_counter_wrapper _counter_usage_bytes[SUBSYSTEM_COUNT];
+    perf_counter_wrapper _counter_total_usage_bytes;
+    perf_counter_wrapper _counter_recent_throttled_count;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,106 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dsn {
+namespace replication {
+
+// replica_resource_usage accounts the resources consumed by a replica since it is opened, to
+// find out which partitions of a node are the expensive ones:
+//  - the bytes of the mutations appended to and replayed from the private log,
+//  - the time spent by the app applying the mutations,
+//  - the bytes of the client requests and the prepares received, and of the prepares sent,
+//  - the bytes of the learn states served to the learners, whose files are shipped by the nfs,
+//    and of the ones copied from the learnee.
+//
+// The counters are added by relaxed atomics on the paths doing the work, so it is cheap to be
+// always on. It is thread-safe.
+//
+// It also remembers when the replica was accessed by a client request or a prepare for the last
+// time, to tell the cold replicas which can be loaded lazily on the next start.
+class replica_resource_usage
+{
+public:
+    struct snapshot
+    {
+        uint64_t plog_write_bytes{0};
+        uint64_t plog_read_bytes{0};
+        uint64_t apply_count{0};
+        uint64_t apply_time_ns{0};
+        uint64_t rpc_bytes_in{0};
+        uint64_t rpc_bytes_out{0};
+        uint64_t learn_bytes_served{0};
+        uint64_t learn_bytes_received{0};
+    };
+
+    void on_plog_write(uint64_t bytes) { add(_plog_write_bytes, bytes); }
+    void on_plog_read(uint64_t bytes) { add(_plog_read_bytes, bytes); }
+    void on_apply(uint64_t count, uint64_t time_ns)
+    {
+        add(_apply_count, count);
+        add(_apply_time_ns, time_ns);
+    }
+    void on_rpc_in(uint64_t bytes) { add(_rpc_bytes_in, bytes); }
+    void on_rpc_out(uint64_t bytes) { add(_rpc_bytes_out, bytes); }
+    void on_learn_served(uint64_t bytes) { add(_learn_bytes_served, bytes); }
+    void on_learn_received(uint64_t bytes) { add(_learn_bytes_received, bytes); }
+    void on_access(uint64_t now_ms) { _last_access_ms.store(now_ms, std::memory_order_relaxed); }
+
+    // 0 if never accessed since opened
+    uint64_t last_access_ms() const { return load(_last_access_ms); }
+
+    snapshot get_snapshot() const
+    {
+        snapshot s;
+        s.plog_write_bytes = load(_plog_write_bytes);
+        s.plog_read_bytes = load(_plog_read_bytes);
+        s.apply_count = load(_apply_count);
+        s.apply_time_ns = load(_apply_time_ns);
+        s.rpc_bytes_in = load(_rpc_bytes_in);
+        s.rpc_bytes_out = load(_rpc_bytes_out);
+        s.learn_bytes_served = load(_learn_bytes_served);
+        s.learn_bytes_received = load(_learn_bytes_received);
+        return s;
+    }
+
+private:
+    static void add(std::atomic<uint64_t> &counter, uint64_t delta)
+    {
+        counter.fetch_add(delta, std::memory_order_relaxed);
+    }
+    static uint64_t load(const std::atomic<uint64_t> &counter)
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> _plog_write_bytes{0};
+    std::atomic<uint64_t> _plog_read_bytes{0};
+    std::atomic<uint64_t> _apply_count{0};
+    std::atomic<uint64_t> _apply_time_ns{0};
+    std::atomic<uint64_t> _rpc_bytes_in{0};
+    std::atomic<uint64_t> _rpc_bytes_out{0};
+    std::atomic<uint64_t> _learn_bytes_served{0};
+    std::atomic<uint64_t> _learn_bytes_received{0};
+    std::atomic<uint64_t> _last_access_ms{0};
+};
+
+} // namespace replication
+} // namespace dsn
@@ -1,9 +1,13 @@
 #include <fstream>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <dsn/utility/error_code.h>
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/utility/utils.h>
 
 #include <dsn/dist/replication/replication_app_base.h>
@@ -14,12 +18,38 @@
 #include "replica_stub.h"
 #include "block_service/block_service_manager.h"
 #include "backup/cold_backup_context.h"
+#include "cold_tier_cache.h"
 
 using namespace dsn::dist::block_service;
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  restore_download_concurrency,
+                  1,
+                  "the count of checkpoint files a restoring replica downloads concurrently");
+DSN_DEFINE_validator(restore_download_concurrency,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_string("replication",
+                  cold_tier_file_suffix,
+                  ".sst",
+                  "the checkpoint files with this suffix are left on the block service when a "
+                  "partition is restored in the cold-tier mode, and downloaded when they are read");
+
+// the root of the backups of the policy: [<restore_path>/]<cluster_name>[/<policy_name>]
+static std::string get_restore_backup_root(const configuration_restore_request &req)
+{
+    std::string backup_root = req.cluster_name;
+    if (!req.restore_path.empty()) {
+        backup_root = dsn::utils::filesystem::path_combine(req.restore_path, backup_root);
+    }
+    if (!req.policy_name.empty()) {
+        backup_root = dsn::utils::filesystem::path_combine(backup_root, req.policy_name);
+    }
+    return backup_root;
+}
+
 bool replica::remove_useless_file_under_chkpt(const std::string &chkpt_dir,
                                               const cold_backup_metadata &metadata)
 {
@@ -109,42 +139,91 @@ error_code replica::download_checkpoint(const configuration_restore_request &req
     }
 
     // download checkpoint files
-    task_tracker tracker;
+    const std::string backup_root = get_restore_backup_root(req);
+    const gpid old_gpid(req.app_id, _config.pid.get_partition_index());
+    std::vector<std::string> remote_dirs;
+    remote_dirs.reserve(backup_metadata.files.size());
     for (const auto &f_meta : backup_metadata.files) {
-        tasking::enqueue(
-            TASK_CODE_EXEC_INLINED,
-            &tracker,
-            [this, &err, remote_chkpt_dir, local_chkpt_dir, f_meta, fs]() {
-                uint64_t f_size = 0;
-                error_code download_err = _stub->_block_service_manager.download_file(
-                    remote_chkpt_dir, local_chkpt_dir, f_meta.name, fs, f_size);
-                const std::string file_name =
-                    utils::filesystem::path_combine(local_chkpt_dir, f_meta.name);
-                if (download_err == ERR_OK || download_err == ERR_PATH_ALREADY_EXIST) {
-                    if (!utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
-                        download_err = ERR_CORRUPTION;
-                    } else if (download_err == ERR_PATH_ALREADY_EXIST) {
-                        download_err = ERR_OK;
-                        f_size = f_meta.size;
-                    }
-                }
+        // the unchanged files of an incremental backup are under the previous backups
+        auto ref = backup_metadata.referenced_files.find(f_meta.name);
+        if (ref == backup_metadata.referenced_files.end()) {
+            remote_dirs.emplace_back(remote_chkpt_dir);
+        } else {
+            remote_dirs.emplace_back(utils::filesystem::path_combine(
+                cold_backup::get_replica_backup_path(
+                    backup_root, req.app_name, old_gpid, ref->second.backup_id),
+                ref->second.chkpt_dirname));
+        }
+    }
 
-                if (download_err != ERR_OK) {
-                    derror_replica(
-                        "failed to download file({}), error = {}", f_meta.name, download_err);
-                    // ERR_CORRUPTION means we should rollback restore, so we can't change err if it
-                    // is ERR_CORRUPTION now, otherwise it will be overridden by other errors
-                    if (err != ERR_CORRUPTION) {
-                        err = download_err;
-                        return;
-                    }
-                }
+    // in the cold-tier mode, the data files are left on the block service and downloaded into
+    // the cold tier cache when they are read
+    cold_tier_manifest cold_tier;
+    const bool cold_tier_enabled = get_cold_tier_cache_capacity(cold_tier.cache_capacity_bytes);
+    std::vector<size_t> download_indexes;
+    int64_t cold_tier_bytes = 0;
+    for (size_t i = 0; i < backup_metadata.files.size(); ++i) {
+        const file_meta &f_meta = backup_metadata.files[i];
+        if (cold_tier_enabled &&
+            boost::algorithm::ends_with(f_meta.name, FLAGS_cold_tier_file_suffix)) {
+            cold_tier_file f;
+            f.remote_dir = remote_dirs[i];
+            f.meta = f_meta;
+            cold_tier.files.emplace_back(std::move(f));
+            cold_tier_bytes += f_meta.size;
+        } else {
+            download_indexes.push_back(i);
+        }
+    }
 
-                // update progress if download file succeed
-                update_restore_progress(f_size);
-                // report current status to meta server
-                report_restore_status_to_meta();
-            });
+    // the files are downloaded by `restore_download_concurrency` workers, one of them is the
+    // current thread. The helpers share THREAD_POOL_REPLICATION_LONG with the current thread and
+    // with the other restoring replicas, so they never block waiting for each other: a helper
+    // returns rather than waits when no download slot is free, and the current thread downloads
+    // every file nobody else takes, and cancels the helpers which haven't started at the end.
+    zlock err_lock;
+    std::atomic<size_t> next_file(0);
+    auto download_files = [&](bool is_helper) {
+        while (next_file.load() < download_indexes.size()) {
+            if (is_helper) {
+                if (!_stub->_restore_download_scheduler.try_acquire(_config.pid)) {
+                    return;
+                }
+            } else {
+                _stub->_restore_download_scheduler.acquire(_config.pid);
+            }
+            const size_t n = next_file.fetch_add(1);
+            if (n >= download_indexes.size()) {
+                _stub->_restore_download_scheduler.release();
+                return;
+            }
+            const size_t i = download_indexes[n];
+            error_code download_err = download_restore_file(
+                fs, remote_dirs[i], local_chkpt_dir, backup_metadata.files[i]);
+            _stub->_restore_download_scheduler.release();
+            if (download_err != ERR_OK) {
+                // stop the other workers
+                next_file.store(download_indexes.size());
+                // ERR_CORRUPTION means we should rollback restore, so we can't change err if it
+                // is ERR_CORRUPTION now, otherwise it will be overridden by other errors
+                zauto_lock l(err_lock);
+                if (err != ERR_CORRUPTION) {
+                    err = download_err;
+                }
+                return;
+            }
+        }
+    };
+    task_tracker tracker;
+    std::vector<task_ptr> helpers;
+    for (uint32_t i = 1; i < FLAGS_restore_download_concurrency; ++i) {
+        helpers.emplace_back(tasking::enqueue(
+            LPC_RESTORE_DOWNLOAD_FILE, &tracker, [&download_files]() { download_files(true); }));
+    }
+    download_files(false);
+    // all the files have been taken, only wait for the helpers which are downloading
+    for (auto &helper : helpers) {
+        helper->cancel(true);
     }
     tracker.wait_outstanding_tasks();
 
@@ -155,9 +234,107 @@ error_code replica::download_checkpoint(const configuration_restore_request &req
         clear_restore_useless_files(local_chkpt_dir, backup_metadata);
     }
 
+    if (ERR_OK == err && cold_tier_enabled) {
+        cold_tier.backup_provider_name = req.backup_provider_name;
+        const std::string cold_tier_dir = utils::filesystem::path_combine(_dir, "cold_tier");
+        if (!utils::filesystem::create_directory(cold_tier_dir)) {
+            derror_replica("create cold tier dir {} failed", cold_tier_dir);
+            return ERR_FILE_OPERATION_FAILED;
+        }
+        err = cold_tier.store(cold_tier_dir);
+        if (err == ERR_OK) {
+            ddebug_replica("restored in cold-tier mode, {} files of {} bytes left on {}",
+                           cold_tier.files.size(),
+                           cold_tier_bytes,
+                           req.backup_provider_name);
+            update_restore_progress(cold_tier_bytes);
+        }
+    }
+
     return err;
 }
 
+bool replica::get_cold_tier_cache_capacity(/*out*/ int64_t &capacity_bytes) const
+{
+    auto iter = _app_info.envs.find(backup_restore_constant::COLD_TIER_CACHE_MB);
+    int32_t cache_mb = 0;
+    if (iter == _app_info.envs.end() || !buf2int32(iter->second, cache_mb) || cache_mb <= 0) {
+        return false;
+    }
+    capacity_bytes = cache_mb * 1024LL * 1024LL;
+    return true;
+}
+
+error_code replica::init_cold_tier_cache()
+{
+    const std::string cold_tier_dir = utils::filesystem::path_combine(_dir, "cold_tier");
+    cold_tier_manifest manifest;
+    error_code err = manifest.load(cold_tier_dir);
+    if (err == ERR_OBJECT_NOT_FOUND) {
+        return ERR_OK;
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    block_filesystem *fs =
+        _stub->_block_service_manager.get_or_create_block_filesystem(manifest.backup_provider_name);
+    if (fs == nullptr) {
+        derror_replica("get block filesystem by provider {} failed",
+                       manifest.backup_provider_name);
+        return ERR_INVALID_PARAMETERS;
+    }
+    _cold_tier_cache = make_unique<cold_tier_cache>(
+        &_stub->_block_service_manager, fs, cold_tier_dir, manifest);
+    ddebug_replica("init cold tier cache, {} files on {}, {} bytes cached",
+                   manifest.files.size(),
+                   manifest.backup_provider_name,
+                   _cold_tier_cache->cached_bytes());
+    return ERR_OK;
+}
+
+error_code replica::download_restore_file(block_filesystem *fs,
+                                          const std::string &remote_dir,
+                                          const std::string &local_chkpt_dir,
+                                          const file_meta &f_meta)
+{
+    uint64_t f_size = 0;
+    std::string f_md5;
+    error_code err = _stub->_block_service_manager.download_file(
+        remote_dir, local_chkpt_dir, f_meta.name, fs, f_size, f_md5);
+    const std::string file_name = utils::filesystem::path_combine(local_chkpt_dir, f_meta.name);
+    if (err == ERR_OK && !f_md5.empty()) {
+        // md5 is calculated while downloading, no need to read the file again
+        if (static_cast<int64_t>(f_size) != f_meta.size || f_md5 != f_meta.md5) {
+            derror_replica("file({}) damaged, size: {} VS {}, md5: {} VS {}",
+                           file_name,
+                           f_size,
+                           f_meta.size,
+                           f_md5,
+                           f_meta.md5);
+            err = ERR_CORRUPTION;
+        }
+    } else if (err == ERR_OK || err == ERR_PATH_ALREADY_EXIST) {
+        if (!utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
+            err = ERR_CORRUPTION;
+        } else if (err == ERR_PATH_ALREADY_EXIST) {
+            err = ERR_OK;
+            f_size = f_meta.size;
+        }
+    }
+
+    if (err != ERR_OK) {
+        derror_replica("failed to download file({}), error = {}", f_meta.name, err);
+        return err;
+    }
+
+    // update progress if download file succeed
+    update_restore_progress(f_size);
+    // report current status to meta server
+    report_restore_status_to_meta();
+    return ERR_OK;
+}
+
 error_code replica::get_backup_metadata(block_filesystem *fs,
                                         const std::string &remote_chkpt_dir,
                                         const std::string &local_chkpt_dir,
@@ -224,13 +401,7 @@ dsn::error_code replica::find_valid_checkpoint(const configuration_restore_reque
     dsn::gpid old_gpid;
     old_gpid.set_app_id(req.app_id);
     old_gpid.set_partition_index(_config.pid.get_partition_index());
-    std::string backup_root = req.cluster_name;
-    if (!req.restore_path.empty()) {
-        backup_root = dsn::utils::filesystem::path_combine(req.restore_path, backup_root);
-    }
-    if (!req.policy_name.empty()) {
-        backup_root = dsn::utils::filesystem::path_combine(backup_root, req.policy_name);
-    }
+    std::string backup_root = get_restore_backup_root(req);
     int64_t backup_id = req.time_stamp;
 
     std::string manifest_file =
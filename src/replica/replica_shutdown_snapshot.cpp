@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica_shutdown_snapshot.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <fstream>
+
+namespace dsn {
+namespace replication {
+
+const std::string replica_shutdown_snapshot::kFileName = ".shutdown-snapshot";
+
+error_code replica_shutdown_snapshot::store(const std::string &replica_dir) const
+{
+    std::string path = utils::filesystem::path_combine(replica_dir, kFileName);
+    std::string tmp_path = path + ".tmp";
+
+    std::ofstream os(tmp_path.c_str(),
+                     (std::ofstream::out | std::ios::binary | std::ofstream::trunc));
+    if (!os.is_open()) {
+        derror_f("open file {} failed", tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    blob bb = json::json_forwarder<replica_shutdown_snapshot>::encode(*this);
+    os.write(bb.data(), (std::streamsize)bb.length());
+    if (os.bad()) {
+        derror_f("write file {} failed", tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    os.close();
+
+    if (!utils::filesystem::rename_path(tmp_path, path)) {
+        derror_f("move file from {} to {} failed", tmp_path, path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return ERR_OK;
+}
+
+error_code replica_shutdown_snapshot::load(const std::string &replica_dir)
+{
+    std::string path = utils::filesystem::path_combine(replica_dir, kFileName);
+    if (!utils::filesystem::file_exists(path)) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    std::string data;
+    error_code err = utils::filesystem::read_file(path, data);
+    if (err != ERR_OK) {
+        derror_f("read file {} failed, err = {}", path, err);
+        return err;
+    }
+
+    blob bb = blob::create_from_bytes(std::move(data));
+    if (!json::json_forwarder<replica_shutdown_snapshot>::decode(bb, *this)) {
+        derror_f("decode json from file {} failed", path);
+        return ERR_INVALID_DATA;
+    }
+    return ERR_OK;
+}
+
+error_code replica_shutdown_snapshot::load_and_remove(const std::string &replica_dir)
+{
+    error_code err = load(replica_dir);
+    if (err == ERR_OBJECT_NOT_FOUND) {
+        return err;
+    }
+
+    std::string path = utils::filesystem::path_combine(replica_dir, kFileName);
+    if (!utils::filesystem::remove_path(path)) {
+        derror_f("remove file {} failed", path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return err;
+}
+
+} // namespace replication
+} // namespace dsn
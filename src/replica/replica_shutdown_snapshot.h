@@ -0,0 +1,55 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/cpp/json_helper.h>
+#include <dsn/utility/errors.h>
+
+namespace dsn {
+namespace replication {
+
+// Persisted by replica::close() on a clean shutdown of the replica server, after the private
+// log is flushed and the app is checkpointed, so that the next open knows how far the private
+// log alone covers the replica and the shared log replay can skip the files before it.
+//
+// The snapshot is removed as soon as the replica is opened again, so it never describes a
+// replica that has written anything since. Until then it is also enough to describe the replica
+// to the meta server, so that a cold replica, which had been idle for `idle_ms` before the
+// shutdown, can be registered without being opened.
+struct replica_shutdown_snapshot
+{
+    static const std::string kFileName;
+
+    int64_t ballot{0};
+    int64_t committed_decree{0};
+    int64_t plog_max_decree{0};
+    uint64_t idle_ms{0};
+
+    DEFINE_JSON_SERIALIZATION(ballot, committed_decree, plog_max_decree, idle_ms)
+
+    error_code store(const std::string &replica_dir) const;
+
+    // load the snapshot under `replica_dir` and keep the file
+    error_code load(const std::string &replica_dir);
+
+    // load the snapshot under `replica_dir` and remove the file, whether it is valid or not
+    error_code load_and_remove(const std::string &replica_dir);
+};
+
+} // namespace replication
+} // namespace dsn
@@ -43,15 +43,18 @@
 #include "split/replica_split_manager.h"
 #include "replica_disk_migrator.h"
 #include "disk_cleaner.h"
+#include "async_file_deleter.h"
 
 #include <boost/algorithm/string/replace.hpp>
 #include <dsn/cpp/json_helper.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/rand.h>
 #include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/utility/enum_helper.h>
+#include <algorithm>
 #include <vector>
 #include <deque>
 #include <dsn/dist/fmt_logging.h>
@@ -59,11 +62,70 @@
 #include <gperftools/malloc_extension.h>
 #endif
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/startup_report.h>
 #include <dsn/dist/remote_command.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                config_sync_delta_enabled,
+                false,
+                "whether to sync configs with meta server in delta, that only the partitions "
+                "changed since the last sync are returned");
+DSN_DEFINE_uint32("replication",
+                  config_sync_full_interval_count,
+                  10,
+                  "do a full config sync every this many syncs when the delta sync is enabled");
+DSN_DEFINE_validator(config_sync_full_interval_count,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  max_concurrent_restore_download_count,
+                  0,
+                  "the max count of files downloaded concurrently by the restoring replicas of "
+                  "this node, the partitions with smaller index are served first, 0 means "
+                  "unlimited");
+DSN_DEFINE_bool("replication",
+                clean_shutdown_snapshot_enabled,
+                false,
+                "whether to flush and checkpoint the replicas and persist a snapshot of them "
+                "when the replica server is closed, so the next start skips the shared log replay");
+DSN_DEFINE_uint64("replication",
+                  lazy_load_cold_replica_idle_seconds,
+                  0,
+                  "the replicas idle for at least so long before the last clean shutdown are "
+                  "registered with their shutdown snapshots on start and opened only when they "
+                  "are members of their partitions or proposed to be, 0 means to open all the "
+                  "replicas on start; it takes effect with clean_shutdown_snapshot_enabled");
+
+DSN_DEFINE_bool("replication",
+                slog_per_disk_enabled,
+                false,
+                "whether to keep one shared log under each data dir for the replicas on that "
+                "disk, instead of a single one under slog_dir");
+
+DSN_DEFINE_bool("replication",
+                table_quota_enabled,
+                false,
+                "whether to report the usages of the primary replicas in the config sync and "
+                "enforce the shares of the table quotas that meta server assigns to them");
+DSN_DEFINE_bool("replication",
+                partition_usage_report_enabled,
+                false,
+                "whether to report the usages of the primary replicas in the config sync, for "
+                "the auto split and the load-aware balancer of meta server, implied by "
+                "table_quota_enabled");
+DSN_DEFINE_bool("replication",
+                thrift_compact_internal_rpc_enabled,
+                false,
+                "whether to send the group checks, config syncs and learns in thrift compact "
+                "rather than binary, unless their rpc_msg_payload_serialize_default_format is "
+                "configured");
+
+// the shared log dir under each data dir, with [replication] slog_per_disk_enabled
+static const std::string kDiskSlogDirName = "slog";
+
 bool replica_stub::s_not_exit_on_log_failure = false;
 
 replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
@@ -83,8 +145,8 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
       _release_tcmalloc_memory(false),
       _mem_release_max_reserved_mem_percentage(10),
       _max_concurrent_bulk_load_downloading_count(5),
-      _learn_app_concurrent_count(0),
       _fs_manager(false),
+      _restore_download_scheduler(FLAGS_max_concurrent_restore_download_count),
       _bulk_load_downloading_count(0)
 {
 #ifdef DSN_ENABLE_GPERF
@@ -458,6 +520,8 @@ void replica_stub::install_perf_counters()
         "replicas.splitting.recent.split.fail.count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "splitting fail count in the recent period");
+
+    _memory_budget.init_perf_counters();
 }
 
 void replica_stub::initialize(bool clear /* = false*/)
@@ -482,6 +546,19 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
     }
     ddebug("meta_servers = %s", oss.str().c_str());
 
+    if (FLAGS_thrift_compact_internal_rpc_enabled) {
+        // the peers and meta server are able to decode them whatever versions they are, and
+        // reply in the same format
+        for (task_code code : {RPC_GROUP_CHECK,
+                               RPC_GROUP_CHECK_BATCH,
+                               RPC_CM_CONFIG_SYNC,
+                               RPC_LEARN,
+                               RPC_LEARN_COMPLETION_NOTIFY,
+                               RPC_LEARN_ADD_LEARNER}) {
+            task_spec::set_default_rpc_msg_payload_serialize_format(code, DSF_THRIFT_COMPACT);
+        }
+    }
+
     _deny_client = _options.deny_client_on_start;
     _verbose_client_log = _options.verbose_client_log_on_start;
     _verbose_commit_log = _options.verbose_commit_log_on_start;
@@ -526,35 +603,67 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
     }
 
     {
+        utils::startup_phase_timer t("replica_server.init_fs_manager");
         dsn::error_code err;
         err = _fs_manager.initialize(_options.data_dirs, _options.data_dir_tags, false);
         dassert(err == dsn::ERR_OK, "initialize fs manager failed, err(%s)", err.to_string());
     }
 
-    _log = new mutation_log_shared(_options.slog_dir,
-                                   _options.log_shared_file_size_mb,
-                                   _options.log_shared_force_flush,
-                                   &_counter_shared_log_recent_write_size);
-    ddebug("slog_dir = %s", _options.slog_dir.c_str());
+    if (FLAGS_slog_per_disk_enabled) {
+        for (const auto &dn : _fs_manager._dir_nodes) {
+            std::string dir = utils::filesystem::path_combine(dn->full_dir, kDiskSlogDirName);
+            _disk_logs[dn->tag] = new mutation_log_shared(dir,
+                                                          _options.log_shared_file_size_mb,
+                                                          _options.log_shared_force_flush,
+                                                          &_counter_shared_log_recent_write_size);
+            ddebug_f("slog_dir of disk {} = {}", dn->tag, dir);
+        }
+    } else {
+        _log = new mutation_log_shared(_options.slog_dir,
+                                       _options.log_shared_file_size_mb,
+                                       _options.log_shared_force_flush,
+                                       &_counter_shared_log_recent_write_size);
+        ddebug("slog_dir = %s", _options.slog_dir.c_str());
+    }
 
     // init rps
     ddebug("start to load replicas");
 
+    // the data dirs are usually on different disks, scan them in parallel
     std::vector<std::string> dir_list;
-    for (auto &dir : _options.data_dirs) {
-        std::vector<std::string> tmp_list;
-        if (!dsn::utils::filesystem::get_subdirectories(dir, tmp_list, false)) {
-            dassert(false, "Fail to get subdirectories in %s.", dir.c_str());
+    {
+        utils::startup_phase_timer t("replica_server.scan_data_dirs");
+        std::vector<std::vector<std::string>> sub_dirs(_options.data_dirs.size());
+        std::vector<task_ptr> scan_tasks;
+        for (size_t i = 0; i < _options.data_dirs.size(); ++i) {
+            scan_tasks.push_back(tasking::enqueue(
+                LPC_REPLICATION_INIT_LOAD,
+                &_tracker,
+                [this, i, &sub_dirs] {
+                    const std::string &dir = _options.data_dirs[i];
+                    if (!dsn::utils::filesystem::get_subdirectories(dir, sub_dirs[i], false)) {
+                        dassert(false, "Fail to get subdirectories in %s.", dir.c_str());
+                    }
+                },
+                static_cast<int>(i)));
+        }
+        for (size_t i = 0; i < scan_tasks.size(); ++i) {
+            scan_tasks[i]->wait();
+            dir_list.insert(dir_list.end(), sub_dirs[i].begin(), sub_dirs[i].end());
         }
-        dir_list.insert(dir_list.end(), tmp_list.begin(), tmp_list.end());
     }
 
+    std::unique_ptr<utils::startup_phase_timer> load_timer(
+        new utils::startup_phase_timer("replica_server.load_replicas"));
     replicas rps;
+    closed_replicas cold_rps;
     utils::ex_lock rps_lock;
     std::deque<task_ptr> load_tasks;
     uint64_t start_time = dsn_now_ms();
     for (auto &dir : dir_list) {
-        if (dsn::replication::is_data_dir_invalid(dir)) {
+        std::string name = utils::get_last_component(dir, "/");
+        if (dsn::replication::is_data_dir_invalid(dir) || name == kDiskSlogDirName ||
+            name == async_file_deleter::kTrashDirName) {
             ddebug_f("ignore dir {}", dir);
             continue;
         }
@@ -562,9 +671,34 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         load_tasks.push_back(tasking::create_task(
             LPC_REPLICATION_INIT_LOAD,
             &_tracker,
-            [this, dir, &rps, &rps_lock] {
+            [this, dir, &rps, &cold_rps, &rps_lock] {
                 ddebug("process dir %s", dir.c_str());
 
+                if (FLAGS_lazy_load_cold_replica_idle_seconds > 0) {
+                    std::pair<app_info, replica_info> cold_info;
+                    if (replica::load_cold(dir.c_str(),
+                                           FLAGS_lazy_load_cold_replica_idle_seconds * 1000,
+                                           cold_info.first,
+                                           cold_info.second)) {
+                        _fs_manager.get_disk_tag(dir, cold_info.second.disk_tag);
+                        ddebug_f("{}: register cold replica '{}' without opening it, "
+                                 "<durable, commit> = <{}, {}>, last_prepared_decree = {}",
+                                 cold_info.second.pid,
+                                 dir,
+                                 cold_info.second.last_durable_decree,
+                                 cold_info.second.last_committed_decree,
+                                 cold_info.second.last_prepared_decree);
+
+                        utils::auto_lock<utils::ex_lock> l(rps_lock);
+                        gpid pid = cold_info.second.pid;
+                        dassert_f(cold_rps.find(pid) == cold_rps.end(),
+                                  "conflict cold replica dir: {}",
+                                  dir);
+                        cold_rps.emplace(pid, std::move(cold_info));
+                        return;
+                    }
+                }
+
                 auto r = replica::load(this, dir.c_str());
                 if (r != nullptr) {
                     ddebug("%s@%s: load replica '%s' success, <durable, commit> = <%" PRId64
@@ -595,23 +729,131 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         tsk->wait();
     }
     uint64_t finish_time = dsn_now_ms();
+    load_timer.reset();
 
     dir_list.clear();
     load_tasks.clear();
-    ddebug("load replicas succeed, replica_count = %d, time_used = %" PRIu64 " ms",
+    ddebug("load replicas succeed, replica_count = %d, cold_replica_count = %d, "
+           "time_used = %" PRIu64 " ms",
            static_cast<int>(rps.size()),
+           static_cast<int>(cold_rps.size()),
            finish_time - start_time);
 
     // init shared prepare log
     ddebug("start to replay shared log");
 
+    std::unique_ptr<utils::startup_phase_timer> replay_timer(
+        new utils::startup_phase_timer("replica_server.replay_shared_log"));
+    bool is_log_complete = true;
+    if (_disk_logs.empty()) {
+        is_log_complete = replay_shared_log(_log, rps);
+    } else {
+        // replay the shared log of each disk with the replicas on it
+        std::map<std::string, replicas> disk_rps;
+        for (auto &kv : rps) {
+            std::string tag;
+            error_code err = _fs_manager.get_disk_tag(kv.second->dir(), tag);
+            dassert_f(err == ERR_OK, "get disk tag of {} failed", kv.second->dir());
+            disk_rps[tag].emplace(kv.first, kv.second);
+        }
+        rps.clear();
+        for (auto &kv : _disk_logs) {
+            replicas &tag_rps = disk_rps[kv.first];
+            if (!replay_shared_log(kv.second, tag_rps)) {
+                is_log_complete = false;
+            }
+            rps.insert(tag_rps.begin(), tag_rps.end());
+        }
+    }
+
+    // we will mark all replicas inactive not transient unless all logs are complete
+    if (!is_log_complete) {
+        derror("logs are not complete for some replicas, which means that shared log is truncated, "
+               "mark all replicas as inactive");
+        for (auto it = rps.begin(); it != rps.end(); ++it) {
+            it->second->set_inactive_state_transient(false);
+        }
+    }
+    replay_timer.reset();
+
+    // gc
+    if (false == _options.gc_disabled) {
+        _gc_timer_task = tasking::enqueue_timer(
+            LPC_GARBAGE_COLLECT_LOGS_AND_REPLICAS,
+            &_tracker,
+            [this] { on_gc(); },
+            std::chrono::milliseconds(_options.gc_interval_ms),
+            0,
+            std::chrono::milliseconds(rand::next_u32(0, _options.gc_interval_ms)));
+    }
+
+    // disk stat
+    if (false == _options.disk_stat_disabled) {
+        _disk_stat_timer_task = ::dsn::tasking::enqueue_timer(
+            LPC_DISK_STAT,
+            &_tracker,
+            [this]() { on_disk_stat(); },
+            std::chrono::seconds(_options.disk_stat_interval_seconds),
+            0,
+            std::chrono::seconds(_options.disk_stat_interval_seconds));
+    }
+
+    // attach rps
+    _replicas = std::move(rps);
+    _counter_replicas_count->add((uint64_t)_replicas.size());
+    for (const auto &kv : _replicas) {
+        _fs_manager.add_replica(kv.first, kv.second->dir());
+    }
+    // the cold replicas are taken as closed ones, which are reported to meta server and opened
+    // from their dirs on demand
+    for (auto &kv : cold_rps) {
+        dassert_f(_replicas.find(kv.first) == _replicas.end(),
+                  "conflict replica dir of cold replica {}",
+                  kv.first);
+        _fs_manager.add_replica(
+            kv.first, get_replica_dir(kv.second.first.app_type.c_str(), kv.first, false));
+        _cold_replicas.insert(kv.first);
+    }
+    _closed_replicas = std::move(cold_rps);
+
+    _nfs = dsn::nfs_node::create();
+    _nfs->start();
+
+    dist::cmd::register_remote_command_rpc();
+
+    if (_options.delay_for_fd_timeout_on_start) {
+        uint64_t now_time_ms = dsn_now_ms();
+        uint64_t delay_time_ms =
+            (_options.fd_grace_seconds + 3) * 1000; // for more 3 seconds than grace seconds
+        if (now_time_ms < dsn::utils::process_start_millis() + delay_time_ms) {
+            uint64_t delay = dsn::utils::process_start_millis() + delay_time_ms - now_time_ms;
+            ddebug("delay for %" PRIu64 "ms to make failure detector timeout", delay);
+            tasking::enqueue(LPC_REPLICA_SERVER_DELAY_START,
+                             &_tracker,
+                             [this]() { this->initialize_start(); },
+                             0,
+                             std::chrono::milliseconds(delay));
+        } else {
+            initialize_start();
+        }
+    } else {
+        initialize_start();
+    }
+}
+
+// replay the shared `log` for the replicas in `rps`, the replicas failed to replay are removed
+// from `rps`.
+// return whether the logs of the remaining replicas are complete.
+bool replica_stub::replay_shared_log(mutation_log_ptr &log, replicas &rps)
+{
+    const std::string log_dir = log->dir();
     std::map<gpid, decree> replay_condition;
     for (auto it = rps.begin(); it != rps.end(); ++it) {
-        replay_condition[it->first] = it->second->last_committed_decree();
+        replay_condition[it->first] = it->second->shared_log_replay_decree();
     }
 
-    start_time = dsn_now_ms();
-    error_code err = _log->open(
+    uint64_t start_time = dsn_now_ms();
+    error_code err = log->open(
         [&rps](int log_length, mutation_ptr &mu) {
             auto it = rps.find(mu->data.header.pid);
             if (it != rps.end()) {
@@ -622,12 +864,16 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         },
         [this](error_code err) { this->handle_log_failure(err); },
         replay_condition);
-    finish_time = dsn_now_ms();
+    uint64_t finish_time = dsn_now_ms();
 
     if (err == ERR_OK) {
-        ddebug("replay shared log succeed, time_used = %" PRIu64 " ms", finish_time - start_time);
+        ddebug_f("replay shared log {} succeed, time_used = {} ms",
+                 log_dir,
+                 finish_time - start_time);
     } else {
-        derror("replay shared log failed, err = %s, time_used = %" PRIu64 " ms, clear all logs ...",
+        derror("replay shared log %s failed, err = %s, time_used = %" PRIu64
+               " ms, clear all logs ...",
+               log_dir.c_str(),
                err.to_string(),
                finish_time - start_time);
 
@@ -654,16 +900,16 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         rps.clear();
 
         // restart log service
-        _log->close();
-        _log = nullptr;
-        if (!utils::filesystem::remove_path(_options.slog_dir)) {
-            dassert(false, "remove directory %s failed", _options.slog_dir.c_str());
+        log->close();
+        log = nullptr;
+        if (!utils::filesystem::remove_path(log_dir)) {
+            dassert(false, "remove directory %s failed", log_dir.c_str());
         }
-        _log = new mutation_log_shared(_options.slog_dir,
-                                       _options.log_shared_file_size_mb,
-                                       _options.log_shared_force_flush,
-                                       &_counter_shared_log_recent_write_size);
-        auto lerr = _log->open(nullptr, [this](error_code err) { this->handle_log_failure(err); });
+        log = new mutation_log_shared(log_dir,
+                                      _options.log_shared_file_size_mb,
+                                      _options.log_shared_force_flush,
+                                      &_counter_shared_log_recent_write_size);
+        auto lerr = log->open(nullptr, [this](error_code err) { this->handle_log_failure(err); });
         dassert(lerr == ERR_OK, "restart log service must succeed");
     }
 
@@ -674,7 +920,7 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
 
         it->second->reset_prepare_list_after_replay();
 
-        decree smax = _log->max_decree(it->first);
+        decree smax = log->max_decree(it->first);
         decree pmax = invalid_decree;
         decree pmax_commit = invalid_decree;
         if (it->second->private_log()) {
@@ -683,7 +929,7 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
 
             // possible when shared log is restarted
             if (smax == 0) {
-                _log->update_max_decree(it->first, pmax);
+                log->update_max_decree(it->first, pmax);
                 smax = pmax;
             }
 
@@ -725,68 +971,7 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
             it->second->set_inactive_state_transient(false);
         }
     }
-
-    // we will mark all replicas inactive not transient unless all logs are complete
-    if (!is_log_complete) {
-        derror("logs are not complete for some replicas, which means that shared log is truncated, "
-               "mark all replicas as inactive");
-        for (auto it = rps.begin(); it != rps.end(); ++it) {
-            it->second->set_inactive_state_transient(false);
-        }
-    }
-
-    // gc
-    if (false == _options.gc_disabled) {
-        _gc_timer_task = tasking::enqueue_timer(
-            LPC_GARBAGE_COLLECT_LOGS_AND_REPLICAS,
-            &_tracker,
-            [this] { on_gc(); },
-            std::chrono::milliseconds(_options.gc_interval_ms),
-            0,
-            std::chrono::milliseconds(rand::next_u32(0, _options.gc_interval_ms)));
-    }
-
-    // disk stat
-    if (false == _options.disk_stat_disabled) {
-        _disk_stat_timer_task = ::dsn::tasking::enqueue_timer(
-            LPC_DISK_STAT,
-            &_tracker,
-            [this]() { on_disk_stat(); },
-            std::chrono::seconds(_options.disk_stat_interval_seconds),
-            0,
-            std::chrono::seconds(_options.disk_stat_interval_seconds));
-    }
-
-    // attach rps
-    _replicas = std::move(rps);
-    _counter_replicas_count->add((uint64_t)_replicas.size());
-    for (const auto &kv : _replicas) {
-        _fs_manager.add_replica(kv.first, kv.second->dir());
-    }
-
-    _nfs = dsn::nfs_node::create();
-    _nfs->start();
-
-    dist::cmd::register_remote_command_rpc();
-
-    if (_options.delay_for_fd_timeout_on_start) {
-        uint64_t now_time_ms = dsn_now_ms();
-        uint64_t delay_time_ms =
-            (_options.fd_grace_seconds + 3) * 1000; // for more 3 seconds than grace seconds
-        if (now_time_ms < dsn::utils::process_start_millis() + delay_time_ms) {
-            uint64_t delay = dsn::utils::process_start_millis() + delay_time_ms - now_time_ms;
-            ddebug("delay for %" PRIu64 "ms to make failure detector timeout", delay);
-            tasking::enqueue(LPC_REPLICA_SERVER_DELAY_START,
-                             &_tracker,
-                             [this]() { this->initialize_start(); },
-                             0,
-                             std::chrono::milliseconds(delay));
-        } else {
-            initialize_start();
-        }
-    } else {
-        initialize_start();
-    }
+    return is_log_complete;
 }
 
 void replica_stub::initialize_start()
@@ -820,6 +1005,16 @@ void replica_stub::initialize_start()
         _duplication_sync_timer->start();
     }
 
+    if (group_check_batcher::enabled()) {
+        _group_check_batcher = dsn::make_unique<group_check_batcher>(this);
+        _group_check_batcher->start();
+    }
+
+    if (disk_rebalancer::enabled()) {
+        _disk_rebalancer = dsn::make_unique<disk_rebalancer>(this);
+        _disk_rebalancer->start();
+    }
+
     _backup_server = dsn::make_unique<replica_backup_server>(this);
 
     // init liveness monitor
@@ -849,7 +1044,7 @@ dsn::error_code replica_stub::on_kill_replica(gpid id)
         replicas rs;
         {
             zauto_read_lock l(_replicas_lock);
-            rs = _replicas;
+            rs = _replicas.map();
         }
         for (auto it = rs.begin(); it != rs.end(); ++it) {
             replica_ptr &r = it->second;
@@ -872,12 +1067,8 @@ dsn::error_code replica_stub::on_kill_replica(gpid id)
 
 replica_ptr replica_stub::get_replica(gpid id) const
 {
-    zauto_read_lock l(_replicas_lock);
-    auto it = _replicas.find(id);
-    if (it != _replicas.end())
-        return it->second;
-    else
-        return nullptr;
+    // lock-free, the lookups are far more frequent than the replica open/close
+    return _replicas.get(id);
 }
 
 replica_stub::replica_life_cycle replica_stub::get_replica_life_cycle(gpid id)
@@ -999,7 +1190,7 @@ void replica_stub::on_query_replica_info(query_replica_info_rpc rpc)
     {
         zauto_read_lock l(_replicas_lock);
         for (auto it = _replicas.begin(); it != _replicas.end(); ++it) {
-            replica_ptr &r = it->second;
+            const replica_ptr &r = it->second;
             replica_info info;
             get_replica_info(info, r);
             if (visited_replicas.find(info.pid) == visited_replicas.end()) {
@@ -1094,7 +1285,7 @@ void replica_stub::on_query_app_info(query_app_info_rpc rpc)
     {
         zauto_read_lock l(_replicas_lock);
         for (auto it = _replicas.begin(); it != _replicas.end(); ++it) {
-            replica_ptr &r = it->second;
+            const replica_ptr &r = it->second;
             const app_info &info = *r->get_app_info();
             if (visited_apps.find(info.app_id) == visited_apps.end()) {
                 resp.apps.push_back(info);
@@ -1157,19 +1348,66 @@ void replica_stub::on_group_check(group_check_rpc rpc)
     if (rep != nullptr) {
         rep->on_group_check(request, response);
     } else {
-        if (request.config.status == partition_status::PS_POTENTIAL_SECONDARY) {
-            std::shared_ptr<group_check_request> req(new group_check_request);
-            *req = request;
+        on_group_check_of_absent_replica(request, response);
+    }
+}
 
-            begin_open_replica(request.app, request.config.pid, req, nullptr);
-            response.err = ERR_OK;
-            response.learner_signature = invalid_signature;
-        } else {
+void replica_stub::on_group_check_batch(group_check_batch_rpc rpc)
+{
+    const auto &requests = rpc.request().requests;
+    if (!is_connected()) {
+        dwarn("%s: received %d group checks in batch: not connected, ignore",
+              _primary_address_str,
+              static_cast<int>(requests.size()));
+        return;
+    }
+
+    dinfo("%s: received %d group checks in batch",
+          _primary_address_str,
+          static_cast<int>(requests.size()));
+
+    auto &responses = rpc.response().responses;
+    responses.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const group_check_request &request = requests[i];
+        group_check_response &response = responses[i];
+        response.pid = request.config.pid;
+
+        replica_ptr rep = get_replica(request.config.pid);
+        if (rep != nullptr) {
+            // in case that the replica is closed before handling it
             response.err = ERR_OBJECT_NOT_FOUND;
+
+            // each replica handles its own check in its own thread, the batch is replied
+            // when the last one is done
+            tasking::enqueue(LPC_GROUP_CHECK_BATCH,
+                             rep->tracker(),
+                             [rep, rpc, i]() mutable {
+                                 rep->on_group_check(rpc.request().requests[i],
+                                                     rpc.response().responses[i]);
+                             },
+                             request.config.pid.thread_hash());
+        } else {
+            on_group_check_of_absent_replica(request, response);
         }
     }
 }
 
+void replica_stub::on_group_check_of_absent_replica(const group_check_request &request,
+                                                    /*out*/ group_check_response &response)
+{
+    if (request.config.status == partition_status::PS_POTENTIAL_SECONDARY) {
+        std::shared_ptr<group_check_request> req(new group_check_request);
+        *req = request;
+
+        begin_open_replica(request.app, request.config.pid, req, nullptr);
+        response.err = ERR_OK;
+        response.learner_signature = invalid_signature;
+    } else {
+        response.err = ERR_OBJECT_NOT_FOUND;
+    }
+}
+
 void replica_stub::on_learn(dsn::message_ex *msg)
 {
     learn_request request;
@@ -1273,7 +1511,7 @@ void replica_stub::get_local_replicas(std::vector<replica_info> &replicas)
     replicas.reserve(total_replicas);
 
     for (auto &pairs : _replicas) {
-        replica_ptr &rep = pairs.second;
+        const replica_ptr &rep = pairs.second;
         // child partition should not sync config from meta server
         // because it is not ready in meta view
         if (rep->status() == partition_status::PS_PARTITION_SPLIT) {
@@ -1314,10 +1552,35 @@ void replica_stub::query_configuration_by_node()
     get_local_replicas(req.stored_replicas);
     req.__isset.stored_replicas = true;
 
+    // meta server judges whether a partition is changed by the ballot and status in the
+    // stored replicas and the app info digests, a full sync is still done periodically
+    // for safety
+    if (FLAGS_config_sync_delta_enabled && !_synced_app_info_digests.empty() &&
+        ++_config_sync_count % FLAGS_config_sync_full_interval_count != 0) {
+        req.__set_app_info_digests(
+            std::map<int32_t, int64_t>(_synced_app_info_digests.begin(),
+                                       _synced_app_info_digests.end()));
+    }
+
+    if (FLAGS_table_quota_enabled || FLAGS_partition_usage_report_enabled) {
+        req.__isset.quota_usages = true;
+        zauto_read_lock l(_replicas_lock);
+        for (const auto &kv : _replicas) {
+            if (kv.second->status() == partition_status::PS_PRIMARY) {
+                partition_quota usage;
+                usage.pid = kv.first;
+                kv.second->_quota_controller.collect_usage(usage);
+                req.quota_usages.push_back(std::move(usage));
+            }
+        }
+    }
+
     ::dsn::marshall(msg, req);
 
-    ddebug("send query node partitions request to meta server, stored_replicas_count = %d",
-           (int)req.stored_replicas.size());
+    ddebug("send query node partitions request to meta server, stored_replicas_count = %d, "
+           "delta = %s",
+           (int)req.stored_replicas.size(),
+           req.__isset.app_info_digests ? "true" : "false");
 
     rpc_address target(_failure_detector->get_servers());
     _config_query_task =
@@ -1389,14 +1652,31 @@ void replica_stub::on_node_query_reply(error_code err,
         }
 
         ddebug_f("process query node partitions response for resp.err = ERR_OK, "
-                 "partitions_count({}), gc_replicas_count({})",
+                 "partitions_count({}), unchanged_partitions_count({}), gc_replicas_count({})",
                  resp.partitions.size(),
+                 resp.unchanged_partitions.size(),
                  resp.gc_replicas.size());
 
         replicas rs;
         {
             zauto_read_lock l(_replicas_lock);
-            rs = _replicas;
+            rs = _replicas.map();
+        }
+
+        if (FLAGS_table_quota_enabled) {
+            update_quota_shares(rs, resp.quota_shares);
+        }
+
+        // the unchanged partitions still exist on meta server
+        for (const gpid &pid : resp.unchanged_partitions) {
+            rs.erase(pid);
+        }
+
+        if (!resp.__isset.unchanged_partitions) {
+            _synced_app_info_digests.clear();
+        }
+        for (const auto &update : resp.partitions) {
+            _synced_app_info_digests[update.info.app_id] = app_info_digest(update.info);
         }
 
         for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
@@ -1431,6 +1711,24 @@ void replica_stub::on_node_query_reply(error_code err,
     }
 }
 
+void replica_stub::update_quota_shares(const replicas &rs,
+                                       const std::vector<partition_quota> &shares)
+{
+    std::unordered_map<gpid, const partition_quota *> share_map;
+    for (const partition_quota &share : shares) {
+        share_map.emplace(share.pid, &share);
+    }
+    // the replicas not listed are unlimited
+    for (const auto &kv : rs) {
+        auto iter = share_map.find(kv.first);
+        if (iter != share_map.end()) {
+            kv.second->_quota_controller.set_share(*iter->second);
+        } else {
+            kv.second->_quota_controller.reset_share();
+        }
+    }
+}
+
 void replica_stub::set_meta_server_connected_for_test(
     const configuration_query_by_node_response &resp)
 {
@@ -1466,7 +1764,17 @@ void replica_stub::on_node_query_reply_scatter(replica_stub_ptr this_,
                                 req.__isset.meta_split_status ? req.meta_split_status
                                                               : split_status::NOT_SPLIT);
     } else {
-        if (req.config.primary == _primary_address) {
+        if (is_cold_replica(req.config.pid) &&
+            (req.config.primary == _primary_address ||
+             std::find(req.config.secondaries.begin(),
+                       req.config.secondaries.end(),
+                       _primary_address) != req.config.secondaries.end())) {
+            // it must take part in 2pc, the config is synced once again after it is opened
+            ddebug("%s@%s: open cold replica which is still a member of the partition",
+                   req.config.pid.to_string(),
+                   _primary_address_str);
+            begin_open_replica(req.info, req.config.pid, nullptr, nullptr);
+        } else if (req.config.primary == _primary_address) {
             ddebug("%s@%s: replica not exists on replica server, which is primary, remove it "
                    "from meta server",
                    req.config.pid.to_string(),
@@ -1500,6 +1808,12 @@ void replica_stub::on_node_query_reply_scatter2(replica_stub_ptr this_, gpid id)
     }
 }
 
+bool replica_stub::is_cold_replica(gpid id) const
+{
+    zauto_read_lock l(_replicas_lock);
+    return _cold_replicas.find(id) != _cold_replicas.end();
+}
+
 void replica_stub::remove_replica_on_meta_server(const app_info &info,
                                                  const partition_configuration &config)
 {
@@ -1541,7 +1855,7 @@ void replica_stub::on_meta_server_disconnected()
     replicas rs;
     {
         zauto_read_lock l(_replicas_lock);
-        rs = _replicas;
+        rs = _replicas.map();
     }
 
     for (auto it = rs.begin(); it != rs.end(); ++it) {
@@ -1624,6 +1938,7 @@ void replica_stub::on_gc_replica(replica_stub_ptr this_, gpid id)
             return;
         closed_info = iter->second;
         _closed_replicas.erase(iter);
+        _cold_replicas.erase(id);
         _fs_manager.remove_replica(id);
     }
 
@@ -1663,6 +1978,7 @@ void replica_stub::on_gc()
         replica_ptr rep;
         partition_status::type status;
         mutation_log_ptr plog;
+        mutation_log_ptr slog;
         decree last_durable_decree;
         int64_t init_offset_in_shared_log;
     };
@@ -1677,6 +1993,7 @@ void replica_stub::on_gc()
             info.rep = rep;
             info.status = rep->status();
             info.plog = rep->private_log();
+            info.slog = rep->shared_log();
             info.last_durable_decree = rep->last_durable_decree();
             info.init_offset_in_shared_log = rep->get_app()->init_info().init_offset_in_shared_log;
         }
@@ -1703,9 +2020,13 @@ void replica_stub::on_gc()
     //   of triggering all replicas to do checkpoint, we will only trigger a few of necessary
     //   replicas which block garbage collection of the oldest log file.
     //
-    if (_log != nullptr) {
+    int64_t shared_log_size = 0;
+    for (const mutation_log_ptr &slog : get_shared_logs()) {
         replica_log_info_map gc_condition;
         for (auto &kv : rs) {
+            if (kv.second.slog != slog) {
+                continue;
+            }
             replica_log_info ri;
             replica_ptr &rep = kv.second.rep;
             mutation_log_ptr &plog = kv.second.plog;
@@ -1737,7 +2058,7 @@ void replica_stub::on_gc()
         }
 
         std::set<gpid> prevent_gc_replicas;
-        int reserved_log_count = _log->garbage_collection(
+        int reserved_log_count = slog->garbage_collection(
             gc_condition, _options.log_shared_file_count_limit, prevent_gc_replicas);
         if (reserved_log_count > _options.log_shared_file_count_limit * 2) {
             ddebug("gc_shared: trigger emergency checkpoint by log_shared_file_count_limit, "
@@ -1746,6 +2067,9 @@ void replica_stub::on_gc()
                    _options.log_shared_file_count_limit,
                    reserved_log_count);
             for (auto &kv : rs) {
+                if (kv.second.slog != slog) {
+                    continue;
+                }
                 tasking::enqueue(
                     LPC_PER_REPLICA_CHECKPOINT_TIMER,
                     kv.second.rep->tracker(),
@@ -1782,8 +2106,9 @@ void replica_stub::on_gc()
             }
         }
 
-        _counter_shared_log_size->set(_log->total_size() / (1024 * 1024));
+        shared_log_size += slog->total_size();
     }
+    _counter_shared_log_size->set(shared_log_size / (1024 * 1024));
 
     // statistic learning info
     uint64_t learning_count = 0;
@@ -1837,6 +2162,7 @@ void replica_stub::on_gc()
         }
     }
 
+    _memory_budget.update_perf_counters();
     _counter_replicas_learning_count->set(learning_count);
     _counter_replicas_learning_max_duration_time_ms->set(learning_max_duration_time_ms);
     _counter_replicas_learning_max_copy_file_size->set(learning_max_copy_file_size);
@@ -1938,6 +2264,7 @@ void replica_stub::on_disk_stat()
     _opening_replicas[id] = task;
     _counter_replicas_opening_count->increment();
     _closed_replicas.erase(id);
+    _cold_replicas.erase(id);
 
     _replicas_lock.unlock_write();
     return task;
@@ -2131,6 +2458,32 @@ void replica_stub::trigger_checkpoint(replica_ptr r, bool is_emergency)
     r->init_checkpoint(is_emergency);
 }
 
+mutation_log_ptr replica_stub::get_shared_log(const std::string &replica_dir)
+{
+    if (_disk_logs.empty()) {
+        return _log;
+    }
+
+    std::string tag;
+    error_code err = _fs_manager.get_disk_tag(replica_dir, tag);
+    dassert_f(err == ERR_OK, "get disk tag of {} failed", replica_dir);
+    auto it = _disk_logs.find(tag);
+    dassert_f(it != _disk_logs.end(), "no shared log for disk {}", tag);
+    return it->second;
+}
+
+std::vector<mutation_log_ptr> replica_stub::get_shared_logs() const
+{
+    std::vector<mutation_log_ptr> logs;
+    if (_log != nullptr) {
+        logs.emplace_back(_log);
+    }
+    for (const auto &kv : _disk_logs) {
+        logs.emplace_back(kv.second);
+    }
+    return logs;
+}
+
 void replica_stub::handle_log_failure(error_code err)
 {
     derror("handle log failure: %s", err.to_string());
@@ -2151,6 +2504,8 @@ void replica_stub::open_service()
     register_rpc_handler(RPC_REMOVE_REPLICA, "remove", &replica_stub::on_remove);
     register_rpc_handler_with_rpc_holder(
         RPC_GROUP_CHECK, "GroupCheck", &replica_stub::on_group_check);
+    register_rpc_handler_with_rpc_holder(
+        RPC_GROUP_CHECK_BATCH, "GroupCheckBatch", &replica_stub::on_group_check_batch);
     register_rpc_handler_with_rpc_holder(
         RPC_QUERY_PN_DECREE, "query_decree", &replica_stub::on_query_decree);
     register_rpc_handler_with_rpc_holder(
@@ -2352,7 +2707,7 @@ replica_stub::exec_command_on_replica(const std::vector<std::string> &args,
     replicas rs;
     {
         zauto_read_lock l(_replicas_lock);
-        rs = _replicas;
+        rs = _replicas.map();
     }
 
     std::set<gpid> required_ids;
@@ -2491,6 +2846,16 @@ void replica_stub::close()
         _duplication_sync_timer = nullptr;
     }
 
+    if (_group_check_batcher != nullptr) {
+        _group_check_batcher->close();
+        _group_check_batcher = nullptr;
+    }
+
+    if (_disk_rebalancer != nullptr) {
+        _disk_rebalancer->close();
+        _disk_rebalancer = nullptr;
+    }
+
     if (_config_query_task != nullptr) {
         _config_query_task->cancel(true);
         _config_query_task = nullptr;
@@ -2542,7 +2907,7 @@ void replica_stub::close()
         }
 
         while (!_replicas.empty()) {
-            _replicas.begin()->second->close();
+            _replicas.begin()->second->close(FLAGS_clean_shutdown_snapshot_enabled);
 
             _counter_replicas_count->decrement();
             _replicas.erase(_replicas.begin());
@@ -2848,6 +3213,35 @@ void replica_stub::query_app_data_version(
     }
 }
 
+void replica_stub::query_app_hotkeys(
+    int32_t app_id, std::map<int32_t, std::pair<std::string, std::string>> &hotkeys)
+{
+    zauto_read_lock l(_replicas_lock);
+    for (const auto &kv : _replicas) {
+        const replica_ptr &rep = kv.second;
+        if (kv.first.get_app_id() != app_id || rep == nullptr) {
+            continue;
+        }
+        if (rep->_read_hotkey_detector.running() || rep->_write_hotkey_detector.running()) {
+            hotkeys[kv.first.get_partition_index()] = std::make_pair(
+                rep->_read_hotkey_detector.dump(), rep->_write_hotkey_detector.dump());
+        }
+    }
+}
+
+void replica_stub::query_app_resource_usage(
+    int32_t app_id, std::map<int32_t, replica_resource_usage::snapshot> &usages)
+{
+    zauto_read_lock l(_replicas_lock);
+    for (const auto &kv : _replicas) {
+        const replica_ptr &rep = kv.second;
+        if (kv.first.get_app_id() != app_id || rep == nullptr) {
+            continue;
+        }
+        usages[kv.first.get_partition_index()] = rep->resource_usage().get_snapshot();
+    }
+}
+
 void replica_stub::query_app_manual_compact_status(
     int32_t app_id, std::unordered_map<gpid, manual_compaction_status> &status)
 {
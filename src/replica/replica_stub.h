@@ -34,6 +34,7 @@
 
 #include <functional>
 #include <tuple>
+#include <set>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/dist/failure_detector_multimaster.h>
 #include <dsn/dist/nfs_node.h>
@@ -41,13 +42,20 @@
 #include "common/replication_common.h"
 #include "common/fs_manager.h"
 #include "block_service/block_service_manager.h"
+#include "backup/restore_download_scheduler.h"
 #include "replica.h"
+#include "replica_map.h"
+#include "group_check_batcher.h"
+#include "replica_memory_budget.h"
+#include "disk_rebalancer.h"
+#include "learn_scheduler.h"
 
 namespace dsn {
 namespace replication {
 
 typedef rpc_holder<group_check_response, learn_notify_response> learn_completion_notification_rpc;
 typedef rpc_holder<group_check_request, group_check_response> group_check_rpc;
+typedef rpc_holder<group_check_batch_request, group_check_batch_response> group_check_batch_rpc;
 typedef rpc_holder<query_replica_decree_request, query_replica_decree_response>
     query_replica_decree_rpc;
 typedef rpc_holder<query_replica_info_request, query_replica_info_response> query_replica_info_rpc;
@@ -129,6 +137,7 @@ public:
     void on_add_learner(const group_check_request &request);
     void on_remove(const replica_configuration &request);
     void on_group_check(group_check_rpc rpc);
+    void on_group_check_batch(group_check_batch_rpc rpc);
     void on_copy_checkpoint(copy_checkpoint_rpc rpc);
     void on_group_bulk_load(group_bulk_load_rpc rpc);
 
@@ -154,6 +163,7 @@ public:
     //
     replica_ptr get_replica(gpid id) const;
     replication_options &options() { return _options; }
+    replica_memory_budget &memory_budget() { return _memory_budget; }
     const replication_options &options() const { return _options; }
     bool is_connected() const { return NS_Connected == _state; }
     virtual rpc_address get_meta_server_address() const { return _failure_detector->get_servers(); }
@@ -161,6 +171,11 @@ public:
 
     std::string get_replica_dir(const char *app_type, gpid id, bool create_new = true);
 
+    // the shared log the replica under `replica_dir` appends to, which is resolved by a scan
+    // of the data dirs, so the replicas keep the result
+    mutation_log_ptr get_shared_log(const std::string &replica_dir);
+    std::vector<mutation_log_ptr> get_shared_logs() const;
+
     // during partition split, we should gurantee child replica and parent replica share the
     // same data dir
     std::string get_child_dir(const char *app_type, gpid child_pid, const std::string &parent_dir);
@@ -246,7 +261,14 @@ private:
     void on_node_query_reply_scatter(replica_stub_ptr this_,
                                      const configuration_update_request &config);
     void on_node_query_reply_scatter2(replica_stub_ptr this_, gpid id);
+    bool is_cold_replica(gpid id) const;
+    // apply the shares of the table quotas from the config sync to the replicas
+    void update_quota_shares(const replicas &rs, const std::vector<partition_quota> &shares);
     void remove_replica_on_meta_server(const app_info &info, const partition_configuration &config);
+    // handles the group check to a replica which isn't on this node, shared by
+    // RPC_GROUP_CHECK and RPC_GROUP_CHECK_BATCH
+    void on_group_check_of_absent_replica(const group_check_request &request,
+                                          /*out*/ group_check_response &response);
     ::dsn::task_ptr begin_open_replica(const app_info &app,
                                        gpid id,
                                        std::shared_ptr<group_check_request> req,
@@ -260,6 +282,7 @@ private:
     void notify_replica_state_update(const replica_configuration &config, bool is_closing);
     void trigger_checkpoint(replica_ptr r, bool is_emergency);
     void handle_log_failure(error_code err);
+    bool replay_shared_log(mutation_log_ptr &log, replicas &rps);
 
     void install_perf_counters();
     dsn::error_code on_kill_replica(gpid id);
@@ -293,6 +316,15 @@ private:
         int32_t app_id,
         /*pidx => data_version*/ std::unordered_map<int32_t, uint32_t> &version_map);
 
+    // the hot keys of the replicas of the app under the builtin detection, in the json arrays
+    // of hotkey_detector::dump(), pidx => (read, write)
+    void query_app_hotkeys(int32_t app_id,
+                           std::map<int32_t, std::pair<std::string, std::string>> &hotkeys);
+
+    // the resource usage of the replicas of the app, pidx => usage
+    void query_app_resource_usage(int32_t app_id,
+                                  std::map<int32_t, replica_resource_usage::snapshot> &usages);
+
 #ifdef DSN_ENABLE_GPERF
     // Try to release tcmalloc memory back to operating system
     void gc_tcmalloc_memory();
@@ -312,11 +344,14 @@ private:
 
     friend class mock_replica_stub;
     friend class duplication_sync_timer;
+    friend class group_check_batcher;
+    friend class disk_rebalancer;
     friend class duplication_sync_timer_test;
     friend class replica_duplicator_manager_test;
     friend class duplication_test_base;
     friend class replica_test;
     friend class replica_disk_test_base;
+    friend class replica_disk_test;
     friend class replica_disk_migrate_test;
 
     typedef std::unordered_map<gpid, ::dsn::task_ptr> opening_replicas;
@@ -326,12 +361,18 @@ private:
         closed_replicas; // <gpid, <app_info, replica_info> >
 
     mutable zrwlock_nr _replicas_lock;
-    replicas _replicas;
+    replica_map _replicas;
     opening_replicas _opening_replicas;
     closing_replicas _closing_replicas;
     closed_replicas _closed_replicas;
+    // the closed replicas registered by their shutdown snapshots on start without being opened,
+    // with [replication] lazy_load_cold_replica_idle_seconds
+    std::set<gpid> _cold_replicas;
 
     mutation_log_ptr _log;
+    // disk tag -> the shared log under that data dir, with [replication] slog_per_disk_enabled,
+    // when `_log` is not created
+    std::map<std::string, mutation_log_ptr> _disk_logs;
     ::dsn::rpc_address _primary_address;
     char _primary_address_str[64];
 
@@ -346,12 +387,17 @@ private:
 
     // temproal states
     ::dsn::task_ptr _config_query_task;
+    // the digests of the app infos got by the last config sync, protected by _state_lock
+    std::unordered_map<int32_t, int64_t> _synced_app_info_digests;
+    uint32_t _config_sync_count{0};
     ::dsn::task_ptr _config_sync_timer_task;
     ::dsn::task_ptr _gc_timer_task;
     ::dsn::task_ptr _disk_stat_timer_task;
     ::dsn::task_ptr _mem_release_timer_task;
 
     std::unique_ptr<duplication_sync_timer> _duplication_sync_timer;
+    std::unique_ptr<group_check_batcher> _group_check_batcher;
+    std::unique_ptr<disk_rebalancer> _disk_rebalancer;
     std::unique_ptr<replica_backup_server> _backup_server;
 
     // command_handlers
@@ -376,8 +422,11 @@ private:
     int32_t _max_concurrent_bulk_load_downloading_count;
 
     // we limit LT_APP max concurrent count, because nfs service implementation is
-    // too simple, it do not support priority.
-    std::atomic_int _learn_app_concurrent_count;
+    // too simple, the most urgent partitions are admitted first.
+    learn_scheduler _learn_scheduler;
+
+    // the bytes of the mutations, learn states and duplication batches of all the replicas
+    replica_memory_budget _memory_budget;
 
     // handle all the data dirs
     fs_manager _fs_manager;
@@ -386,6 +435,8 @@ private:
     // (in other words, current service node)
     dist::block_service::block_service_manager _block_service_manager;
 
+    restore_download_scheduler _restore_download_scheduler;
+
     // nfs_node
     std::unique_ptr<dsn::nfs_node> _nfs;
 
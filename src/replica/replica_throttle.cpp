@@ -27,7 +27,7 @@ namespace replication {
                     [ this, req = message_ptr(request) ]() { on_client_##op_type(req, true); },    \
                     get_gpid().thread_hash(),                                                      \
                     std::chrono::milliseconds(delay_ms));                                          \
-                _counter_recent_##op_type##_throttling_delay_count->increment();                   \
+                _counter_recent_##op_type##_throttling_delay_count.increment();                    \
             } else { /** type == throttling_controller::REJECT **/                                 \
                 if (delay_ms > 0) {                                                                \
                     tasking::enqueue(LPC_##op_type##_THROTTLING_DELAY,                             \
@@ -40,7 +40,7 @@ namespace replication {
                 } else {                                                                           \
                     response_client_##op_type(request, ERR_BUSY);                                  \
                 }                                                                                  \
-                _counter_recent_##op_type##_throttling_reject_count->increment();                  \
+                _counter_recent_##op_type##_throttling_reject_count.increment();                   \
             }                                                                                      \
             return true;                                                                           \
         }                                                                                          \
@@ -48,6 +48,11 @@ namespace replication {
 
 bool replica::throttle_write_request(message_ex *request)
 {
+    if (!_quota_controller.consume_write(request->body_size())) {
+        response_client_write(request, ERR_BUSY);
+        _counter_recent_write_throttling_reject_count.increment();
+        return true;
+    }
     THROTTLE_REQUEST(write, qps, request, 1);
     THROTTLE_REQUEST(write, size, request, request->body_size());
     return false;
@@ -55,10 +60,56 @@ bool replica::throttle_write_request(message_ex *request)
 
 bool replica::throttle_read_request(message_ex *request)
 {
+    if (!_quota_controller.consume_read()) {
+        response_client_read(request, ERR_BUSY);
+        _counter_recent_read_throttling_reject_count.increment();
+        return true;
+    }
     THROTTLE_REQUEST(read, qps, request, 1);
     return false;
 }
 
+bool replica::reject_write_by_backpressure(message_ex *request)
+{
+    write_backpressure bp;
+    bp.uncommitted_count = _prepare_list->max_decree() - last_committed_decree();
+    bp.uncommitted_capacity = _options->staleness_for_commit;
+    const mutation_ptr &oldest = _prepare_list->get_mutation_by_decree(last_committed_decree() + 1);
+    if (oldest != nullptr && oldest->prepare_ts_us() > 0) {
+        bp.ack_lag_ms = dsn_now_ms() - oldest->prepare_ts_ms();
+    }
+
+    std::string reason;
+    if (_primary_states.write_admission.is_write_accepted(bp, reason)) {
+        return false;
+    }
+    dinfo_replica("reject write from {} for {}", request->header->from_address.to_string(), reason);
+    response_client_write(request, ERR_BUSY);
+    _counter_recent_write_admission_reject_count.increment();
+    return true;
+}
+
+bool replica::reject_write_by_memory_budget(message_ex *request)
+{
+    replica_memory_budget &budget = _stub->memory_budget();
+    if (!budget.is_throttled(memory_subsystem::MUTATION)) {
+        return false;
+    }
+    dinfo_replica("reject write from {} for mutation memory({}) over budget",
+                  request->header->from_address.to_string(),
+                  budget.usage(memory_subsystem::MUTATION));
+    response_client_write(request, ERR_BUSY);
+    budget.on_throttled();
+    return true;
+}
+
+void replica::charge_mutation_memory(const mutation_ptr &mu)
+{
+    if (replica_memory_budget::enabled()) {
+        mu->charge_memory(&_stub->memory_budget(), memory_subsystem::MUTATION);
+    }
+}
+
 void replica::update_throttle_envs(const std::map<std::string, std::string> &envs)
 {
     update_throttle_env_internal(
@@ -26,7 +26,7 @@
 
 /*
  * Description:
- *     What is this file about?
+ *     admit or reject the client writes of a primary by its backpressure
  *
  * Revision history:
  *     xxxx-xx-xx, author, first version
@@ -35,24 +35,90 @@
 
 #include "replication_admission_controller.h"
 
+#include <dsn/utility/flags.h>
+#include <fmt/format.h>
+
 namespace dsn {
 namespace replication {
 
-replication_admission_controller::replication_admission_controller(task_queue *q,
-                                                                   std::vector<std::string> &sargs)
-    : admission_controller(q, sargs)
+DSN_DEFINE_bool("replication",
+                write_admission_enabled,
+                false,
+                "whether to reject the client writes of a primary with ERR_BUSY when its "
+                "backpressure is over the write_admission_* thresholds");
+DSN_DEFINE_uint32("replication",
+                  write_admission_max_prepare_list_percent,
+                  90,
+                  "reject the writes if the uncommitted mutations are over this percent of "
+                  "staleness_for_commit, 0 to disable");
+DSN_DEFINE_uint32("replication",
+                  write_admission_max_plog_pending_kb,
+                  64 * 1024,
+                  "reject the writes if the private log buffer not issued to the disk is over "
+                  "this size, 0 to disable");
+DSN_DEFINE_uint32("replication",
+                  write_admission_max_ack_lag_ms,
+                  5000,
+                  "reject the writes if the oldest uncommitted mutation is older than this, "
+                  "0 to disable");
+DSN_DEFINE_uint32("replication",
+                  write_admission_max_log_latency_ms,
+                  1000,
+                  "reject the writes if the smoothed latency of the shared log appends is over "
+                  "this, 0 to disable");
+DSN_DEFINE_validator(write_admission_max_prepare_list_percent,
+                     [](uint32_t value) -> bool { return value <= 100; });
+
+const int replication_admission_controller::LATENCY_SMOOTHING_SHIFT;
+
+/*static*/ bool replication_admission_controller::enabled()
 {
+    return FLAGS_write_admission_enabled;
 }
 
-replication_admission_controller::~replication_admission_controller() {}
+void replication_admission_controller::reset()
+{
+    _log_latency_us = 0;
+    _plog_pending_bytes = 0;
+}
 
-bool replication_admission_controller::is_task_accepted(task *t)
+void replication_admission_controller::on_shared_log_appended(uint64_t latency_us)
 {
-    // read latency
+    if (_log_latency_us == 0) {
+        _log_latency_us = latency_us;
+    } else {
+        _log_latency_us = _log_latency_us - (_log_latency_us >> LATENCY_SMOOTHING_SHIFT) +
+                          (latency_us >> LATENCY_SMOOTHING_SHIFT);
+    }
+}
 
+bool replication_admission_controller::is_write_accepted(const write_backpressure &bp,
+                                                         /*out*/ std::string &reason) const
+{
+    if (FLAGS_write_admission_max_prepare_list_percent > 0 && bp.uncommitted_capacity > 0 &&
+        bp.uncommitted_count * 100 >=
+            bp.uncommitted_capacity * FLAGS_write_admission_max_prepare_list_percent) {
+        reason = fmt::format(
+            "uncommitted mutations({}/{})", bp.uncommitted_count, bp.uncommitted_capacity);
+        return false;
+    }
+    if (FLAGS_write_admission_max_plog_pending_kb > 0 &&
+        _plog_pending_bytes >= FLAGS_write_admission_max_plog_pending_kb * 1024LL) {
+        reason = fmt::format("private log pending bytes({})", _plog_pending_bytes);
+        return false;
+    }
+    if (FLAGS_write_admission_max_ack_lag_ms > 0 &&
+        bp.ack_lag_ms >= FLAGS_write_admission_max_ack_lag_ms) {
+        reason = fmt::format("ack lag({}ms)", bp.ack_lag_ms);
+        return false;
+    }
+    if (FLAGS_write_admission_max_log_latency_ms > 0 &&
+        _log_latency_us >= FLAGS_write_admission_max_log_latency_ms * 1000ULL) {
+        reason = fmt::format("shared log latency({}us)", _log_latency_us);
+        return false;
+    }
     return true;
 }
 
-int replication_admission_controller::get_system_utilization() { return 0; }
-}
-} // end namespace
+} // namespace replication
+} // namespace dsn
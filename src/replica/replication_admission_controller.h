@@ -26,7 +26,7 @@
 
 /*
  * Description:
- *     What is this file about?
+ *     admit or reject the client writes of a primary by its backpressure
  *
  * Revision history:
  *     xxxx-xx-xx, author, first version
@@ -35,21 +35,58 @@
 
 #pragma once
 
-#include <dsn/tool_api.h>
-#include <dsn/dist/replication.h>
+#include <cstdint>
+#include <string>
 
 namespace dsn {
 namespace replication {
 
-class replication_admission_controller : public admission_controller
+// The backpressure of a primary, sampled when a client write arrives.
+struct write_backpressure
+{
+    // the mutations prepared but not committed, and the max allowed (staleness_for_commit)
+    int64_t uncommitted_count{0};
+    int64_t uncommitted_capacity{0};
+    // the age of the oldest uncommitted mutation, that is how long the secondaries lag to ack
+    uint64_t ack_lag_ms{0};
+};
+
+// replication_admission_controller rejects the client writes of a primary early with ERR_BUSY,
+// which the clients retry, when the replica can't commit them in time, instead of letting them
+// time out deep in 2PC. A write is rejected if any of the signals is over its threshold:
+// - the occupancy of the prepare list;
+// - the pending bytes of the private log, which pile up when the disk stalls;
+// - the ack lag of the secondaries;
+// - the smoothed latency of the shared log appends.
+//
+// It is not thread-safe, the methods are called in the replica thread.
+class replication_admission_controller
 {
 public:
-    replication_admission_controller(task_queue *q, std::vector<std::string> &sargs);
-    virtual ~replication_admission_controller();
+    // whether [replication] write_admission_enabled is on
+    static bool enabled();
+
+    // starts over, e.g. when the replica becomes primary again
+    void reset();
+
+    // `latency_us` is from the prepare to the completion of the shared log append
+    void on_shared_log_appended(uint64_t latency_us);
+    // `pending_bytes` is the size of the private log buffer not issued to the disk yet
+    void on_private_log_appended(int64_t pending_bytes) { _plog_pending_bytes = pending_bytes; }
+
+    // return true if the write is admitted, otherwise `reason` is set.
+    bool is_write_accepted(const write_backpressure &bp, /*out*/ std::string &reason) const;
+
+    uint64_t log_latency_us() const { return _log_latency_us; }
+    int64_t plog_pending_bytes() const { return _plog_pending_bytes; }
 
 private:
-    virtual bool is_task_accepted(task *task);
-    virtual int get_system_utilization();
+    // the weight of a new sample in the smoothed latency, 1 / 8 as TCP's SRTT
+    static const int LATENCY_SMOOTHING_SHIFT = 3;
+
+    uint64_t _log_latency_us{0};
+    int64_t _plog_pending_bytes{0};
 };
-}
-} // end namespace
+
+} // namespace replication
+} // namespace dsn
@@ -329,6 +329,16 @@ bool replication_app_base::is_primary() const
 
 bool replication_app_base::is_duplicating() const { return _replica->is_duplicating(); }
 
+error_code replication_app_base::get_cold_tier_file(const std::string &name,
+                                                    /*out*/ std::string &local_path)
+{
+    cold_tier_cache *cache = _replica->get_cold_tier_cache();
+    if (cache == nullptr) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+    return cache->get_file(name, local_path);
+}
+
 error_code replication_app_base::open_internal(replica *r)
 {
     if (!dsn::utils::filesystem::directory_exists(_dir_data)) {
@@ -440,6 +450,30 @@ error_code replication_app_base::open_new_internal(replica *r,
     return err;
 }
 
+int replication_app_base::on_batched_write_updates(int64_t decree,
+                                                   uint64_t timestamp,
+                                                   const mutation_update **updates,
+                                                   int update_length)
+{
+    dsn::message_ex **requests =
+        (dsn::message_ex **)alloca(sizeof(dsn::message_ex *) * update_length);
+    for (int i = 0; i < update_length; ++i) {
+        requests[i] = dsn::message_ex::create_received_request(
+            updates[i]->code,
+            (dsn_msg_serialize_format)updates[i]->serialization_type,
+            (void *)updates[i]->data.data(),
+            updates[i]->data.length());
+    }
+
+    int storage_error = on_batched_write_requests(decree, timestamp, requests, update_length);
+
+    // release faked requests
+    for (int i = 0; i < update_length; ++i) {
+        requests[i]->release_ref();
+    }
+    return storage_error;
+}
+
 int replication_app_base::on_batched_write_requests(int64_t decree,
                                                     uint64_t timestamp,
                                                     dsn::message_ex **requests,
@@ -459,6 +493,39 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
 }
 
 ::dsn::error_code replication_app_base::apply_mutation(const mutation *mu)
+{
+    int batched_count = 0;
+    uint64_t start_ns = dsn_now_ns();
+    ::dsn::error_code err = apply_one_mutation(mu, batched_count);
+    if (err == ERR_OK) {
+        _replica->resource_usage().on_apply(1, dsn_now_ns() - start_ns);
+        _replica->update_commit_qps(batched_count);
+    }
+    return err;
+}
+
+::dsn::error_code replication_app_base::apply_mutations(const std::vector<mutation_ptr> &mus,
+                                                        size_t &applied)
+{
+    ::dsn::error_code err = ERR_OK;
+    int total_count = 0;
+    uint64_t start_ns = dsn_now_ns();
+    for (applied = 0; applied < mus.size(); ++applied) {
+        int batched_count = 0;
+        err = apply_one_mutation(mus[applied], batched_count);
+        if (err != ERR_OK) {
+            break;
+        }
+        total_count += batched_count;
+    }
+    if (applied > 0) {
+        _replica->resource_usage().on_apply(applied, dsn_now_ns() - start_ns);
+        _replica->update_commit_qps(total_count);
+    }
+    return err;
+}
+
+::dsn::error_code replication_app_base::apply_one_mutation(const mutation *mu, int &batched_count)
 {
     FAIL_POINT_INJECT_F("replication_app_base_apply_mutation",
                         [](dsn::string_view) { return ERR_OK; });
@@ -479,11 +546,22 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
 
     bool has_ingestion_request = false;
     int request_count = static_cast<int>(mu->client_requests.size());
+    // the client requests are absent on the non-primary replicas and during log replay, then
+    // the updates are passed to the app as they are
+    bool has_client_request = false;
+    for (const auto &req : mu->client_requests) {
+        if (req != nullptr) {
+            has_client_request = true;
+            break;
+        }
+    }
     dsn::message_ex **batched_requests =
         (dsn::message_ex **)alloca(sizeof(dsn::message_ex *) * request_count);
+    const mutation_update **batched_updates =
+        (const mutation_update **)alloca(sizeof(mutation_update *) * request_count);
     dsn::message_ex **faked_requests =
         (dsn::message_ex **)alloca(sizeof(dsn::message_ex *) * request_count);
-    int batched_count = 0; // write-empties are not included.
+    batched_count = 0; // write-empties are not included.
     int faked_count = 0;
     for (int i = 0; i < request_count; i++) {
         const mutation_update &update = mu->data.updates[i];
@@ -495,16 +573,20 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
                   i,
                   update.code.to_string());
 
-            if (req == nullptr) {
-                req = dsn::message_ex::create_received_request(
-                    update.code,
-                    (dsn_msg_serialize_format)update.serialization_type,
-                    (void *)update.data.data(),
-                    update.data.length());
-                faked_requests[faked_count++] = req;
+            if (!has_client_request) {
+                batched_updates[batched_count++] = &update;
+            } else {
+                if (req == nullptr) {
+                    req = dsn::message_ex::create_received_request(
+                        update.code,
+                        (dsn_msg_serialize_format)update.serialization_type,
+                        (void *)update.data.data(),
+                        update.data.length());
+                    faked_requests[faked_count++] = req;
+                }
+                batched_requests[batched_count++] = req;
             }
 
-            batched_requests[batched_count++] = req;
             if (update.code == dsn::apps::RPC_RRDB_RRDB_BULK_LOAD) {
                 has_ingestion_request = true;
             }
@@ -518,8 +600,15 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
         }
     }
 
-    int perror = on_batched_write_requests(
-        mu->data.header.decree, mu->data.header.timestamp, batched_requests, batched_count);
+    int perror = has_client_request
+                     ? on_batched_write_requests(mu->data.header.decree,
+                                                 mu->data.header.timestamp,
+                                                 batched_requests,
+                                                 batched_count)
+                     : on_batched_write_updates(mu->data.header.decree,
+                                                mu->data.header.timestamp,
+                                                batched_updates,
+                                                batched_count);
 
     // release faked requests
     for (int i = 0; i < faked_count; i++) {
@@ -571,8 +660,6 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
                batched_count);
     }
 
-    _replica->update_commit_qps(batched_count);
-
     return ERR_OK;
 }
 
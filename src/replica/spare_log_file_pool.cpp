@@ -0,0 +1,209 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "spare_log_file_pool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                log_file_preallocate,
+                false,
+                "whether to preallocate the next log file to the max log file size in "
+                "background, before the log switches to it");
+DSN_DEFINE_bool("replication",
+                log_file_recycle,
+                false,
+                "whether to reuse garbage-collected log files as new log files instead of "
+                "removing them");
+DSN_DEFINE_uint32("replication",
+                  log_file_recycle_max_count,
+                  2,
+                  "the max count of spare log files kept for each log");
+
+/*static*/ bool spare_log_file_pool::enabled()
+{
+    return FLAGS_log_file_preallocate || FLAGS_log_file_recycle;
+}
+
+spare_log_file_pool::spare_log_file_pool(const std::string &log_dir, int64_t file_size)
+    : _dir(utils::filesystem::path_combine(log_dir, ".spare")), _file_size(file_size)
+{
+    // the spare files left by the last run have unknown content, treat them as recycled
+    std::vector<std::string> files;
+    if (utils::filesystem::directory_exists(_dir) &&
+        utils::filesystem::get_subfiles(_dir, files, false)) {
+        _dir_created = true;
+        for (auto &f : files) {
+            _recycled.emplace_back(std::move(f));
+        }
+    }
+}
+
+bool spare_log_file_pool::take(const std::string &path)
+{
+    std::string spare;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_ready.empty()) {
+            return false;
+        }
+        spare = std::move(_ready.front());
+        _ready.pop_front();
+    }
+
+    if (!utils::filesystem::rename_path(spare, path)) {
+        derror_f("rename spare log file {} to {} failed", spare, path);
+        utils::filesystem::remove_path(spare);
+        return false;
+    }
+    return true;
+}
+
+void spare_log_file_pool::prepare()
+{
+    std::string path;
+    bool create = false;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_preparing || !_ready.empty()) {
+            return;
+        }
+        if (!_recycled.empty()) {
+            path = std::move(_recycled.front());
+            _recycled.pop_front();
+        } else if (FLAGS_log_file_preallocate) {
+            if (!_dir_created) {
+                if (!utils::filesystem::create_directory(_dir)) {
+                    derror_f("create spare log dir {} failed", _dir);
+                    return;
+                }
+                _dir_created = true;
+            }
+            path = next_path();
+            create = true;
+        } else {
+            return;
+        }
+        _preparing = true;
+    }
+
+    bool ok = reset_file(path, create);
+
+    std::lock_guard<std::mutex> l(_lock);
+    _preparing = false;
+    if (ok) {
+        _ready.emplace_back(std::move(path));
+    } else {
+        utils::filesystem::remove_path(path);
+    }
+}
+
+bool spare_log_file_pool::recycle(const std::string &path)
+{
+    if (!FLAGS_log_file_recycle) {
+        return false;
+    }
+
+    std::string spare;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_ready.size() + _recycled.size() + (_preparing ? 1 : 0) >=
+            FLAGS_log_file_recycle_max_count) {
+            return false;
+        }
+        if (!_dir_created) {
+            if (!utils::filesystem::create_directory(_dir)) {
+                derror_f("create spare log dir {} failed", _dir);
+                return false;
+            }
+            _dir_created = true;
+        }
+        spare = next_path();
+    }
+
+    if (!utils::filesystem::rename_path(path, spare)) {
+        derror_f("move log file {} to {} failed", path, spare);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    _recycled.emplace_back(std::move(spare));
+    return true;
+}
+
+size_t spare_log_file_pool::ready_count() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _ready.size();
+}
+
+size_t spare_log_file_pool::recycled_count() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _recycled.size();
+}
+
+bool spare_log_file_pool::reset_file(const std::string &path, bool create)
+{
+    int fd = ::open(path.c_str(), O_RDWR | (create ? O_CREAT | O_EXCL : 0), 0666);
+    if (fd < 0) {
+        derror_f("open spare log file {} failed: {}", path, utils::safe_strerror(errno));
+        return false;
+    }
+
+    // the stale content of a recycled file must not be read as log blocks
+    bool ok = true;
+    if (!create && ::ftruncate(fd, 0) != 0) {
+        derror_f("truncate spare log file {} failed: {}", path, utils::safe_strerror(errno));
+        ok = false;
+    }
+
+    // the allocation is only a hint, a failure (e.g. not supported by the file system)
+    // leaves an empty file which is still usable
+    if (ok && FLAGS_log_file_preallocate &&
+        ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, _file_size) != 0) {
+        dwarn_f("preallocate spare log file {} failed: {}", path, utils::safe_strerror(errno));
+    }
+
+    if (ok && ::fsync(fd) != 0) {
+        derror_f("sync spare log file {} failed: {}", path, utils::safe_strerror(errno));
+        ok = false;
+    }
+    ::close(fd);
+    return ok;
+}
+
+std::string spare_log_file_pool::next_path()
+{
+    // the names only have to be unique in the directory
+    std::string path;
+    do {
+        path = utils::filesystem::path_combine(_dir, "spare." + std::to_string(_next_id++));
+    } while (utils::filesystem::path_exists(path));
+    return path;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace dsn {
+namespace replication {
+
+// spare_log_file_pool keeps files under `<log_dir>/.spare` ready to become the next log
+// files of a mutation_log, so that a log switch is a rename instead of creating a file
+// and growing it block by block on the write path.
+//
+// - With [replication] log_file_preallocate, a spare file is allocated to the max log file
+//   size with fallocate(FALLOC_FL_KEEP_SIZE). Its size stays 0, so it is read exactly as a
+//   file that was created empty.
+// - With [replication] log_file_recycle, garbage-collected log files are moved into the
+//   pool instead of unlinked, and are truncated before being reused.
+//
+// prepare() does the blocking work and should be called off the write path, all the
+// methods are thread-safe.
+class spare_log_file_pool
+{
+public:
+    // whether either log_file_preallocate or log_file_recycle is on
+    static bool enabled();
+
+    spare_log_file_pool(const std::string &log_dir, int64_t file_size);
+
+    // Renames a ready spare file to `path`. Returns false if no spare is ready, then the
+    // caller should create the file itself.
+    bool take(const std::string &path);
+
+    // Makes a spare file ready if there is none, reusing a recycled file first.
+    void prepare();
+
+    // Moves a garbage-collected log file into the pool. Returns false if recycling is
+    // disabled or the pool is full, then the caller should remove the file itself.
+    bool recycle(const std::string &path);
+
+    size_t ready_count() const;
+    size_t recycled_count() const;
+
+private:
+    bool reset_file(const std::string &path, bool create);
+    std::string next_path();
+
+    const std::string _dir;
+    const int64_t _file_size;
+
+    mutable std::mutex _lock;
+    bool _dir_created{false};
+    bool _preparing{false};
+    uint64_t _next_id{0};
+    std::deque<std::string> _ready;    // preallocated, size 0
+    std::deque<std::string> _recycled; // with stale content, to be reset
+};
+
+} // namespace replication
+} // namespace dsn
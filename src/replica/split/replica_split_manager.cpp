@@ -22,10 +22,24 @@
 #include <dsn/utility/defer.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                split_link_checkpoint_enabled,
+                false,
+                "whether the child hardlinks the files of the latest checkpoint of the parent "
+                "when they are on the same disk, instead of the parent flushing the memtable "
+                "and copying a new checkpoint in its replica thread");
+DSN_DEFINE_uint32("replication",
+                  split_apply_batch_size,
+                  1,
+                  "the max count of the mutations the child applies in one batch when it "
+                  "catches up with the private log of the parent");
+DSN_DEFINE_validator(split_apply_batch_size, [](uint32_t value) -> bool { return value > 0; });
+
 replica_split_manager::replica_split_manager(replica *r)
     : replica_base(r), _replica(r), _stub(r->get_replica_stub())
 {
@@ -203,10 +217,34 @@ void replica_split_manager::parent_prepare_states(const std::string &dir) // on
     }
 
     learn_state parent_states;
-    int64_t checkpoint_decree;
-    // generate checkpoint
-    error_code ec = _replica->_app->copy_checkpoint_to_dir(dir.c_str(), &checkpoint_decree, true);
-    if (ec == ERR_OK) {
+    int64_t checkpoint_decree = invalid_decree;
+    error_code ec = ERR_OBJECT_NOT_FOUND;
+    if (FLAGS_split_link_checkpoint_enabled) {
+        ec = parent_link_checkpoint(dir, parent_states);
+        if (ec == ERR_OK) {
+            checkpoint_decree = parent_states.to_decree_included;
+            ddebug_replica("link checkpoint succeed: checkpoint dir = {}, checkpoint decree = {}, "
+                           "file count = {}",
+                           dir,
+                           checkpoint_decree,
+                           parent_states.files.size());
+        } else {
+            dwarn_replica("link checkpoint failed, error={}, copy a new one instead", ec);
+        }
+    }
+
+    if (ec != ERR_OK) {
+        // generate checkpoint
+        ec = _replica->_app->copy_checkpoint_to_dir(dir.c_str(), &checkpoint_decree, true);
+        if (ec != ERR_OK) {
+            dwarn_replica("prepare checkpoint failed, error={}, please wait and retry", ec);
+            tasking::enqueue(LPC_PARTITION_SPLIT,
+                             tracker(),
+                             std::bind(&replica_split_manager::parent_prepare_states, this, dir),
+                             get_gpid().thread_hash(),
+                             std::chrono::seconds(1));
+            return;
+        }
         ddebug_replica("prepare checkpoint succeed: checkpoint dir = {}, checkpoint decree = {}",
                        dir,
                        checkpoint_decree);
@@ -214,14 +252,6 @@ void replica_split_manager::parent_prepare_states(const std::string &dir) // on
         // learn_state.files[0] will be used to get learn dir in function 'storage_apply_checkpoint'
         // so we add a fake file name here, this file won't appear on disk
         parent_states.files.push_back(dsn::utils::filesystem::path_combine(dir, "file_name"));
-    } else {
-        dwarn_replica("prepare checkpoint failed, error={}, please wait and retry", ec);
-        tasking::enqueue(LPC_PARTITION_SPLIT,
-                         tracker(),
-                         std::bind(&replica_split_manager::parent_prepare_states, this, dir),
-                         get_gpid().thread_hash(),
-                         std::chrono::seconds(1));
-        return;
     }
 
     std::vector<mutation_ptr> mutation_list;
@@ -236,7 +266,9 @@ void replica_split_manager::parent_prepare_states(const std::string &dir) // on
         std::make_shared<prepare_list>(_replica, *_replica->_prepare_list);
     plist->truncate(last_committed_decree());
 
-    dcheck_eq(last_committed_decree(), checkpoint_decree);
+    // a linked checkpoint may be older than the last committed decree, the gap is covered by
+    // the private log
+    dcheck_ge(last_committed_decree(), checkpoint_decree);
     dcheck_ge(mutation_list.size(), 0);
     dcheck_ge(files.size(), 0);
     ddebug_replica("prepare state succeed: {} mutations, {} private log files, total file size = "
@@ -260,6 +292,63 @@ void replica_split_manager::parent_prepare_states(const std::string &dir) // on
     }
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+error_code replica_split_manager::parent_link_checkpoint(const std::string &dir,
+                                                         /*out*/ learn_state &lstate)
+{
+    if (_replica->_app->last_durable_decree() == 0) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    blob placeholder;
+    learn_state chkpt_state;
+    error_code ec = _replica->_app->get_checkpoint(0, placeholder, chkpt_state);
+    if (ec != ERR_OK) {
+        return ec;
+    }
+    if (chkpt_state.files.empty()) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    // the private log must cover the decrees following the checkpoint
+    learn_state log_state;
+    if (!_replica->_private_log->get_learn_state(
+            get_gpid(), chkpt_state.to_decree_included + 1, log_state)) {
+        return ERR_INCOMPLETE_DATA;
+    }
+
+    // lay out the files under the learn dir of the child the same as a learner does, hardlinks
+    // fail across the disks
+    const std::string &data_dir = _replica->_app->data_dir();
+    lstate.files.clear();
+    for (const std::string &file : chkpt_state.files) {
+        if (file.compare(0, data_dir.length(), data_dir) != 0) {
+            ec = ERR_FILE_OPERATION_FAILED;
+            break;
+        }
+        std::string target =
+            utils::filesystem::path_combine(dir, file.substr(data_dir.length() + 1));
+        std::string target_dir = utils::filesystem::remove_file_name(target);
+        if (!(utils::filesystem::directory_exists(target_dir) ||
+              utils::filesystem::create_directory(target_dir)) ||
+            !utils::filesystem::link_file(file, target)) {
+            ec = ERR_FILE_OPERATION_FAILED;
+            break;
+        }
+        lstate.files.push_back(std::move(target));
+    }
+    if (ec != ERR_OK) {
+        lstate.files.clear();
+        utils::filesystem::remove_path(dir);
+        return ec;
+    }
+
+    lstate.from_decree_excluded = chkpt_state.from_decree_excluded;
+    lstate.to_decree_included = chkpt_state.to_decree_included;
+    lstate.meta = chkpt_state.meta;
+    return ERR_OK;
+}
+
 // ThreadPool: THREAD_POOL_REPLICATION
 void replica_split_manager::child_copy_prepare_list(
     learn_state lstate,
@@ -297,11 +386,15 @@ void replica_split_manager::child_copy_prepare_list(
     plist->set_committer(std::bind(&replica::execute_mutation, _replica, std::placeholders::_1));
     delete _replica->_prepare_list;
     _replica->_prepare_list = new prepare_list(this, *plist);
+    if (prepare_list::batch_commit_enabled()) {
+        _replica->_prepare_list->set_batch_committer(
+            std::bind(&replica::execute_mutations, _replica, std::placeholders::_1));
+    }
     for (decree d = last_committed_decree + 1; d <= _replica->_prepare_list->max_decree(); ++d) {
         mutation_ptr mu = _replica->_prepare_list->get_mutation_by_decree(d);
         dassert_replica(mu != nullptr, "can not find mutation, dercee={}", d);
         mu->data.header.pid = get_gpid();
-        _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
+        _replica->shared_log()->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
         _replica->_private_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
         // set mutation has been logged in private log
         if (!mu->is_logged()) {
@@ -397,14 +490,37 @@ replica_split_manager::child_apply_private_logs(std::vector<std::string> plog_fi
 
     error_code ec;
     int64_t offset;
+    // committed mutations are buffered and applied in batches of FLAGS_split_apply_batch_size
+    std::vector<mutation_ptr> batch;
+    auto flush_batch = [this, &batch]() {
+        size_t applied = 0;
+        error_code err = _replica->_app->apply_mutations(batch, applied);
+        if (err != ERR_OK) {
+            derror_replica("apply mutations failed, error={}, applied count={}, batch size={}",
+                           err,
+                           applied,
+                           batch.size());
+        }
+        batch.clear();
+    };
     // temp prepare_list used for apply states
     prepare_list plist(_replica,
                        _replica->_app->last_committed_decree(),
                        _replica->_options->max_mutation_count_in_prepare_list,
-                       [this](mutation_ptr &mu) {
-                           if (mu->data.header.decree ==
-                               _replica->_app->last_committed_decree() + 1) {
+                       [this, &batch, &flush_batch](mutation_ptr &mu) {
+                           decree next_decree = batch.empty()
+                                                    ? _replica->_app->last_committed_decree() + 1
+                                                    : batch.back()->data.header.decree + 1;
+                           if (mu->data.header.decree != next_decree) {
+                               return;
+                           }
+                           if (FLAGS_split_apply_batch_size <= 1) {
                                _replica->_app->apply_mutation(mu);
+                               return;
+                           }
+                           batch.push_back(mu);
+                           if (batch.size() >= FLAGS_split_apply_batch_size) {
+                               flush_batch();
                            }
                        });
 
@@ -432,6 +548,10 @@ replica_split_manager::child_apply_private_logs(std::vector<std::string> plog_fi
         return ec;
     }
 
+    if (!batch.empty()) {
+        flush_batch();
+    }
+
     _replica->_split_states.splitting_copy_file_count += plog_files.size();
     _replica->_split_states.splitting_copy_file_size += total_file_size;
     _stub->_counter_replicas_splitting_recent_copy_file_count->add(plog_files.size());
@@ -461,6 +581,9 @@ replica_split_manager::child_apply_private_logs(std::vector<std::string> plog_fi
     _replica->_split_states.splitting_copy_mutation_count += count;
     _stub->_counter_replicas_splitting_recent_copy_mutation_count->add(count);
     plist.commit(last_committed_decree, COMMIT_TO_DECREE_HARD);
+    if (!batch.empty()) {
+        flush_batch();
+    }
     ddebug_replica(
         "apply in-memory mutations succeed, mutation count={}, app last_committed_decree={}",
         count,
@@ -1280,20 +1403,20 @@ void replica_split_manager::on_copy_mutation(mutation_ptr &mu) // on child parti
         if (!mu->is_logged()) {
             mu->set_logged();
         }
-        mu->log_task() = _stub->_log->append(
+        mu->log_task() = _replica->shared_log()->append(
             mu, LPC_WRITE_REPLICATION_LOG, tracker(), nullptr, get_gpid().thread_hash());
         _replica->_private_log->append(
             mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr, get_gpid().thread_hash());
     } else { // child sync copy mutation
-        mu->log_task() = _stub->_log->append(mu,
-                                             LPC_WRITE_REPLICATION_LOG,
-                                             tracker(),
-                                             std::bind(&replica::on_append_log_completed,
-                                                       _replica,
-                                                       mu,
-                                                       std::placeholders::_1,
-                                                       std::placeholders::_2),
-                                             get_gpid().thread_hash());
+        mu->log_task() = _replica->shared_log()->append(mu,
+                                                        LPC_WRITE_REPLICATION_LOG,
+                                                        tracker(),
+                                                        std::bind(&replica::on_append_log_completed,
+                                                                  _replica,
+                                                                  mu,
+                                                                  std::placeholders::_1,
+                                                                  std::placeholders::_2),
+                                                        get_gpid().thread_hash());
     }
 }
 
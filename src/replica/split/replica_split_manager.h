@@ -48,6 +48,9 @@ private:
     void child_init_replica(gpid parent_gpid, rpc_address primary_address, ballot init_ballot);
 
     void parent_prepare_states(const std::string &dir);
+    // hardlink the files of the latest checkpoint of parent into `dir`, which avoids flushing
+    // the memtable on the replica thread of parent
+    error_code parent_link_checkpoint(const std::string &dir, /*out*/ learn_state &lstate);
 
     // child copy parent prepare list and call child_learn_states
     void child_copy_prepare_list(learn_state lstate,
@@ -20,10 +20,13 @@
 
 #include <gtest/gtest.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(split_apply_batch_size);
+
 class replica_split_test : public replica_test_base
 {
 public:
@@ -253,6 +256,11 @@ public:
         _child_replica->tracker()->wait_outstanding_tasks();
     }
 
+    error_code test_parent_link_checkpoint(learn_state &lstate)
+    {
+        return _parent_split_mgr->parent_link_checkpoint("./split_link_dir", lstate);
+    }
+
     void test_child_catch_up_states(decree local_decree, decree goal_decree, decree min_decree)
     {
         mock_child_async_learn_states(_child_replica, true, 0);
@@ -658,6 +666,30 @@ TEST_F(replica_split_test, child_apply_private_logs_succeed)
     cleanup_child_split_context();
 }
 
+TEST_F(replica_split_test, child_apply_private_logs_in_batch)
+{
+    fail::cfg("mutation_log_replay_succeed", "return()");
+    fail::cfg("replication_app_base_apply_mutation", "return()");
+    uint32_t old_batch_size = FLAGS_split_apply_batch_size;
+    FLAGS_split_apply_batch_size = 3;
+
+    generate_child(true, false);
+    test_child_apply_private_logs();
+    ASSERT_EQ(child_get_prepare_list_count(), MAX_COUNT);
+
+    FLAGS_split_apply_batch_size = old_batch_size;
+    cleanup_prepare_list(_child_replica);
+    cleanup_child_split_context();
+}
+
+TEST_F(replica_split_test, parent_link_checkpoint_without_durable_decree)
+{
+    // nothing is durable yet, so parent falls back to copying a new checkpoint
+    learn_state lstate;
+    ASSERT_EQ(test_parent_link_checkpoint(lstate), ERR_OBJECT_NOT_FOUND);
+    ASSERT_TRUE(lstate.files.empty());
+}
+
 // child_catch_up_states tests
 TEST_F(replica_split_test, child_catch_up_states_tests)
 {
@@ -0,0 +1,625 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "sharded_kv.server.impl.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+DSN_DEFINE_uint32("sharded_kv", shard_count, 16, "the count of shards the keys are hashed into");
+DSN_DEFINE_validator(shard_count, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("sharded_kv",
+                  reserved_checkpoint_count,
+                  2,
+                  "how many latest checkpoints are kept, the elder ones may still be learned");
+DSN_DEFINE_validator(reserved_checkpoint_count, [](uint32_t value) -> bool { return value > 0; });
+
+static const char *const kManifestPrefix = "checkpoint.";
+static const char *const kShardFilePrefix = "shard.";
+static const char *const kTmpFileSuffix = ".tmp";
+static const uint32_t kShardFileMagic = 0xdeadbeef;
+
+static bool starts_with(const std::string &s, const char *prefix)
+{
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static bool ends_with(const std::string &s, const char *suffix)
+{
+    size_t len = strlen(suffix);
+    return s.length() >= len && s.compare(s.length() - len, len, suffix) == 0;
+}
+
+// `path` is either a file or a directory
+static bool sync_path(const std::string &path, int flags)
+{
+    int fd = ::open(path.c_str(), flags);
+    if (fd < 0) {
+        derror_f("open {} failed: {}", path, utils::safe_strerror(errno));
+        return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    if (!ok) {
+        derror_f("sync {} failed: {}", path, utils::safe_strerror(errno));
+    }
+    ::close(fd);
+    return ok;
+}
+
+// write to a temporary file at first, so that a file with the final name is always complete,
+// even after a crash of the machine
+static bool write_file_atomically(const std::string &path,
+                                  const std::function<void(std::ofstream &)> &writer)
+{
+    std::string tmp_path = path + kTmpFileSuffix;
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!os.is_open()) {
+            derror("open file %s failed", tmp_path.c_str());
+            return false;
+        }
+        writer(os);
+        os.flush();
+        if (!os.good()) {
+            derror("write file %s failed", tmp_path.c_str());
+            return false;
+        }
+    }
+    // the content must be on disk before the rename is, and the rename before the caller
+    // takes the file as written
+    std::string dir = utils::filesystem::remove_file_name(path);
+    return sync_path(tmp_path, O_WRONLY) && utils::filesystem::rename_path(tmp_path, path) &&
+           sync_path(dir.empty() ? "." : dir, O_RDONLY | O_DIRECTORY);
+}
+
+sharded_kv_service_impl::sharded_kv_service_impl(replica *r)
+    : simple_kv_service(r),
+      _shard_count(FLAGS_shard_count),
+      _last_applied_decree(0),
+      _last_durable_decree(0)
+{
+    reset_shards();
+    ddebug_replica("sharded_kv_service_impl inited, shard_count = {}", _shard_count);
+}
+
+void sharded_kv_service_impl::reset_shards()
+{
+    _shards.clear();
+    for (uint32_t i = 0; i < _shard_count; ++i) {
+        _shards.emplace_back(new shard());
+        _shards.back()->data = std::make_shared<kv_map>();
+    }
+}
+
+sharded_kv_service_impl::shard &sharded_kv_service_impl::get_shard(const std::string &key)
+{
+    return *_shards[std::hash<std::string>()(key) % _shard_count];
+}
+
+sharded_kv_service_impl::kv_map &sharded_kv_service_impl::mutable_data(shard &s)
+{
+    // the values are shared by the clone, only the keys and the blob headers are copied
+    if (s.data.use_count() > 1) {
+        s.data = std::make_shared<kv_map>(*s.data);
+    }
+    return *s.data;
+}
+
+void sharded_kv_service_impl::put(const std::string &key, const std::string &value)
+{
+    shard &s = get_shard(key);
+    zauto_write_lock l(s.lock);
+    mutable_data(s)[key] = blob::create_from_bytes(value.data(), value.length());
+    s.last_write_decree = _last_applied_decree;
+}
+
+void sharded_kv_service_impl::append(const std::string &key, const std::string &value)
+{
+    shard &s = get_shard(key);
+    zauto_write_lock l(s.lock);
+    blob &old_value = mutable_data(s)[key];
+    std::string new_value;
+    new_value.reserve(old_value.length() + value.length());
+    new_value.assign(old_value.data(), old_value.length());
+    new_value.append(value);
+    old_value = blob::create_from_bytes(std::move(new_value));
+    s.last_write_decree = _last_applied_decree;
+}
+
+// RPC_SIMPLE_KV_READ
+void sharded_kv_service_impl::on_read(const std::string &key,
+                                      ::dsn::rpc_replier<std::string> &reply)
+{
+    std::string r;
+    {
+        shard &s = get_shard(key);
+        zauto_read_lock l(s.lock);
+        auto it = s.data->find(key);
+        if (it != s.data->end()) {
+            r.assign(it->second.data(), it->second.length());
+        }
+    }
+    reply(r);
+}
+
+// RPC_SIMPLE_KV_WRITE
+void sharded_kv_service_impl::on_write(const kv_pair &pr, ::dsn::rpc_replier<int32_t> &reply)
+{
+    put(pr.key, pr.value);
+    reply(0);
+}
+
+// RPC_SIMPLE_KV_APPEND
+void sharded_kv_service_impl::on_append(const kv_pair &pr, ::dsn::rpc_replier<int32_t> &reply)
+{
+    append(pr.key, pr.value);
+    reply(0);
+}
+
+int sharded_kv_service_impl::on_batched_write_requests(int64_t decree,
+                                                       uint64_t timestamp,
+                                                       dsn::message_ex **requests,
+                                                       int request_length)
+{
+    zauto_lock l(_write_lock);
+    _last_applied_decree = decree;
+    return simple_kv_service::on_batched_write_requests(
+        decree, timestamp, requests, request_length);
+}
+
+int sharded_kv_service_impl::on_batched_write_updates(int64_t decree,
+                                                      uint64_t timestamp,
+                                                      const mutation_update **updates,
+                                                      int update_length)
+{
+    zauto_lock l(_write_lock);
+    _last_applied_decree = decree;
+    for (int i = 0; i < update_length; ++i) {
+        const mutation_update &update = *updates[i];
+        kv_pair pr;
+        binary_reader reader(update.data);
+        unmarshall(reader, pr, (dsn_msg_serialize_format)update.serialization_type);
+        if (update.code == RPC_SIMPLE_KV_SIMPLE_KV_WRITE) {
+            put(pr.key, pr.value);
+        } else if (update.code == RPC_SIMPLE_KV_SIMPLE_KV_APPEND) {
+            append(pr.key, pr.value);
+        } else {
+            dassert_replica(false, "unsupported write code {}", update.code.to_string());
+        }
+    }
+    return 0;
+}
+
+std::string sharded_kv_service_impl::manifest_path(int64_t decree) const
+{
+    return utils::filesystem::path_combine(_dir_data, kManifestPrefix + std::to_string(decree));
+}
+
+std::string sharded_kv_service_impl::shard_file_name(uint32_t index, int64_t decree) const
+{
+    // the content of a shard at a decree is the same on all the replicas, hence the file
+    // name identifies the content
+    return fmt::format("{}{}.{}.{}", kShardFilePrefix, _shard_count, index, decree);
+}
+
+::dsn::error_code sharded_kv_service_impl::start(int argc, char **argv)
+{
+    zauto_lock cl(_checkpoint_lock);
+    zauto_lock l(_write_lock);
+
+    std::vector<std::string> sub_list;
+    if (!utils::filesystem::get_subfiles(_dir_data, sub_list, false)) {
+        derror_replica("get subfiles of {} failed", _dir_data);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    int64_t max_decree = 0;
+    for (const auto &path : sub_list) {
+        std::string name = utils::filesystem::get_file_name(path);
+        if (starts_with(name, kManifestPrefix) && !ends_with(name, kTmpFileSuffix)) {
+            max_decree = std::max(max_decree, atoll(name.c_str() + strlen(kManifestPrefix)));
+        }
+    }
+
+    if (max_decree > 0) {
+        checkpoint_manifest manifest;
+        dsn::error_code err = load_checkpoint(manifest_path(max_decree), manifest);
+        if (err != ERR_OK) {
+            return err;
+        }
+        _last_manifest = std::move(manifest);
+        _last_durable_decree.store(max_decree);
+    }
+    gc_checkpoints();
+    return ERR_OK;
+}
+
+::dsn::error_code sharded_kv_service_impl::stop(bool clear_state)
+{
+    zauto_lock cl(_checkpoint_lock);
+    zauto_lock l(_write_lock);
+    if (clear_state) {
+        if (!utils::filesystem::remove_path(_dir_data)) {
+            dassert_replica(false, "fail to delete directory {}", _dir_data);
+        }
+        reset_shards();
+        _last_manifest = checkpoint_manifest();
+        _last_applied_decree = 0;
+        _last_durable_decree.store(0);
+    }
+    return ERR_OK;
+}
+
+void sharded_kv_service_impl::load_shard_file(const std::string &path)
+{
+    std::ifstream is(path, std::ios::binary);
+    dassert_replica(is.is_open(), "open shard file {} failed", path);
+
+    uint64_t count;
+    uint32_t magic;
+    is.read((char *)&count, sizeof(count));
+    is.read((char *)&magic, sizeof(magic));
+    dassert_replica(magic == kShardFileMagic, "invalid shard file {}", path);
+
+    std::string key;
+    std::string value;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint32_t sz;
+        is.read((char *)&sz, sizeof(sz));
+        key.resize(sz);
+        is.read(&key[0], sz);
+
+        is.read((char *)&sz, sizeof(sz));
+        value.resize(sz);
+        is.read(&value[0], sz);
+
+        // the keys are rehashed, as the shard count may be changed since the file is written
+        shard &s = get_shard(key);
+        (*s.data)[key] = blob::create_from_bytes(value.data(), value.length());
+    }
+    dassert_replica(is.good(), "read shard file {} failed", path);
+}
+
+bool sharded_kv_service_impl::load_manifest(const std::string &path,
+                                            /*out*/ checkpoint_manifest &manifest) const
+{
+    std::string name = utils::filesystem::get_file_name(path);
+    manifest.decree = atoll(name.c_str() + strlen(kManifestPrefix));
+
+    std::ifstream is(path);
+    if (!is.is_open() || !(is >> manifest.shard_count)) {
+        derror_replica("read manifest {} failed", path);
+        return false;
+    }
+    manifest.shard_files.clear();
+    std::string file;
+    while (is >> file) {
+        manifest.shard_files.emplace_back(std::move(file));
+    }
+    if (manifest.shard_files.size() != manifest.shard_count) {
+        derror_replica("invalid manifest {}: shard_count = {}, shard_file_count = {}",
+                       path,
+                       manifest.shard_count,
+                       manifest.shard_files.size());
+        return false;
+    }
+    return true;
+}
+
+dsn::error_code sharded_kv_service_impl::load_checkpoint(const std::string &path,
+                                                         /*out*/ checkpoint_manifest &manifest)
+{
+    if (!load_manifest(path, manifest)) {
+        return ERR_CORRUPTION;
+    }
+
+    reset_shards();
+    std::string dir = utils::filesystem::remove_file_name(path);
+    for (const auto &file : manifest.shard_files) {
+        load_shard_file(utils::filesystem::path_combine(dir, file));
+    }
+    for (auto &s : _shards) {
+        s->last_write_decree = manifest.decree;
+    }
+    _last_applied_decree = manifest.decree;
+
+    ddebug_replica("load checkpoint {} succeed, shard_count = {}", path, manifest.shard_count);
+    return ERR_OK;
+}
+
+dsn::error_code sharded_kv_service_impl::install_checkpoint(const std::string &path,
+                                                            const checkpoint_manifest &manifest)
+{
+    std::string dir = utils::filesystem::remove_file_name(path);
+    for (const auto &file : manifest.shard_files) {
+        std::string target = utils::filesystem::path_combine(_dir_data, file);
+        if (utils::filesystem::file_exists(target)) {
+            continue;
+        }
+        if (!utils::filesystem::rename_path(utils::filesystem::path_combine(dir, file), target)) {
+            derror_replica("move shard file {} from {} failed", file, dir);
+            return ERR_FILE_OPERATION_FAILED;
+        }
+    }
+    if (!utils::filesystem::rename_path(path, manifest_path(manifest.decree))) {
+        derror_replica("move manifest {} failed", path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return ERR_OK;
+}
+
+std::unique_ptr<sharded_kv_service_impl::snapshot> sharded_kv_service_impl::take_snapshot()
+{
+    // take the snapshot between the write batches, the shards are cloned by the next writes
+    std::unique_ptr<snapshot> s(new snapshot(this));
+    s->_data.resize(_shard_count);
+    s->_write_decrees.resize(_shard_count);
+
+    zauto_lock l(_write_lock);
+    s->_decree = _last_applied_decree;
+    for (uint32_t i = 0; i < _shard_count; ++i) {
+        zauto_read_lock rl(_shards[i]->lock);
+        s->_data[i] = _shards[i]->data;
+        s->_write_decrees[i] = _shards[i]->last_write_decree;
+    }
+    return s;
+}
+
+std::unique_ptr<checkpoint_snapshot> sharded_kv_service_impl::take_checkpoint_snapshot()
+{
+    return take_snapshot();
+}
+
+dsn::error_code sharded_kv_service_impl::write_snapshot(const snapshot &s)
+{
+    zauto_lock cl(_checkpoint_lock);
+
+    int64_t decree = s._decree;
+    if (decree <= last_durable_decree()) {
+        return ERR_OK;
+    }
+
+    uint64_t start_time = dsn_now_ns();
+    bool reusable = _last_manifest.shard_count == _shard_count;
+    checkpoint_manifest manifest;
+    manifest.decree = decree;
+    manifest.shard_count = _shard_count;
+    uint32_t written_count = 0;
+    for (uint32_t i = 0; i < _shard_count; ++i) {
+        // the shard is unchanged since the last checkpoint
+        if (reusable && s._write_decrees[i] <= _last_manifest.decree) {
+            manifest.shard_files.emplace_back(_last_manifest.shard_files[i]);
+            continue;
+        }
+
+        std::string file = shard_file_name(i, decree);
+        const kv_map &data = *s._data[i];
+        bool ok = write_file_atomically(
+            utils::filesystem::path_combine(_dir_data, file), [&data](std::ofstream &os) {
+                uint64_t count = data.size();
+                os.write((const char *)&count, sizeof(count));
+                os.write((const char *)&kShardFileMagic, sizeof(kShardFileMagic));
+                for (const auto &kv : data) {
+                    uint32_t sz = static_cast<uint32_t>(kv.first.length());
+                    os.write((const char *)&sz, sizeof(sz));
+                    os.write(kv.first.data(), sz);
+
+                    sz = kv.second.length();
+                    os.write((const char *)&sz, sizeof(sz));
+                    os.write(kv.second.data(), sz);
+                }
+            });
+        if (!ok) {
+            derror_replica("write shard file {} failed", file);
+            return ERR_CHECKPOINT_FAILED;
+        }
+        manifest.shard_files.emplace_back(std::move(file));
+        ++written_count;
+    }
+
+    // the manifest is written at last, a checkpoint takes effect with it
+    bool ok = write_file_atomically(manifest_path(decree), [&manifest](std::ofstream &os) {
+        os << manifest.shard_count << std::endl;
+        for (const auto &file : manifest.shard_files) {
+            os << file << std::endl;
+        }
+    });
+    if (!ok) {
+        derror_replica("write manifest of checkpoint {} failed", decree);
+        return ERR_CHECKPOINT_FAILED;
+    }
+
+    _last_manifest = std::move(manifest);
+    _last_durable_decree.store(decree);
+    gc_checkpoints();
+
+    ddebug_replica("write checkpoint {} succeed, written_shard_count = {}, shard_count = {}, "
+                   "time_used_ms = {}",
+                   decree,
+                   written_count,
+                   _shard_count,
+                   (dsn_now_ns() - start_time) / 1000000);
+    return ERR_OK;
+}
+
+void sharded_kv_service_impl::gc_checkpoints()
+{
+    std::vector<std::string> sub_list;
+    if (!utils::filesystem::get_subfiles(_dir_data, sub_list, false)) {
+        dwarn_replica("get subfiles of {} failed", _dir_data);
+        return;
+    }
+
+    // the checkpoints newer than the last one are stale, which happens after learning
+    std::vector<int64_t> decrees;
+    for (const auto &path : sub_list) {
+        std::string name = utils::filesystem::get_file_name(path);
+        if (starts_with(name, kManifestPrefix) && !ends_with(name, kTmpFileSuffix)) {
+            int64_t decree = atoll(name.c_str() + strlen(kManifestPrefix));
+            if (decree <= _last_manifest.decree) {
+                decrees.emplace_back(decree);
+            }
+        }
+    }
+    std::sort(decrees.begin(), decrees.end(), std::greater<int64_t>());
+    if (decrees.size() > FLAGS_reserved_checkpoint_count) {
+        decrees.resize(FLAGS_reserved_checkpoint_count);
+    }
+
+    std::set<std::string> reserved_files;
+    for (int64_t decree : decrees) {
+        checkpoint_manifest manifest;
+        if (!load_manifest(manifest_path(decree), manifest)) {
+            // keep all the shard files as the referred ones are unknown
+            return;
+        }
+        reserved_files.emplace(kManifestPrefix + std::to_string(decree));
+        reserved_files.insert(manifest.shard_files.begin(), manifest.shard_files.end());
+    }
+
+    for (const auto &path : sub_list) {
+        std::string name = utils::filesystem::get_file_name(path);
+        if ((starts_with(name, kManifestPrefix) || starts_with(name, kShardFilePrefix)) &&
+            reserved_files.count(name) == 0) {
+            if (!utils::filesystem::remove_path(path)) {
+                dwarn_replica("remove file {} failed", path);
+            }
+        }
+    }
+}
+
+::dsn::error_code sharded_kv_service_impl::sync_checkpoint()
+{
+    return write_snapshot(*take_snapshot());
+}
+
+::dsn::error_code sharded_kv_service_impl::async_checkpoint(bool flush_memtable)
+{
+    return write_snapshot(*take_snapshot());
+}
+
+::dsn::error_code sharded_kv_service_impl::copy_checkpoint_to_dir(const char *checkpoint_dir,
+                                                                  int64_t *last_decree,
+                                                                  bool flush_memtable)
+{
+    dsn::error_code err = write_snapshot(*take_snapshot());
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    zauto_lock cl(_checkpoint_lock);
+    if (_last_manifest.decree == 0) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+    if (!utils::filesystem::directory_exists(checkpoint_dir) &&
+        !utils::filesystem::create_directory(checkpoint_dir)) {
+        derror_replica("create directory {} failed", checkpoint_dir);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    // the files are immutable, so they are linked rather than copied, unless the checkpoint_dir
+    // is on another disk, e.g. of the disk migration
+    std::vector<std::string> files = _last_manifest.shard_files;
+    files.emplace_back(kManifestPrefix + std::to_string(_last_manifest.decree));
+    err = utils::filesystem::copy_files(_dir_data, files, checkpoint_dir, true /*allow_link*/);
+    if (err != ERR_OK) {
+        derror_replica("copy checkpoint files to {} failed", checkpoint_dir);
+        return err;
+    }
+    *last_decree = _last_manifest.decree;
+    return ERR_OK;
+}
+
+// helper routines to accelerate learning
+::dsn::error_code sharded_kv_service_impl::get_checkpoint(int64_t learn_start,
+                                                          const dsn::blob &learn_request,
+                                                          /*out*/ learn_state &state)
+{
+    zauto_lock cl(_checkpoint_lock);
+    state.from_decree_excluded = 0;
+    state.to_decree_included = _last_manifest.decree;
+    if (_last_manifest.decree == 0) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    for (const auto &file : _last_manifest.shard_files) {
+        state.files.emplace_back(utils::filesystem::path_combine(_dir_data, file));
+    }
+    state.files.emplace_back(manifest_path(_last_manifest.decree));
+    return ERR_OK;
+}
+
+::dsn::error_code sharded_kv_service_impl::storage_apply_checkpoint(chkpt_apply_mode mode,
+                                                                    const learn_state &state)
+{
+    std::string path;
+    for (const auto &file : state.files) {
+        if (starts_with(utils::filesystem::get_file_name(file), kManifestPrefix)) {
+            path = file;
+            break;
+        }
+    }
+    if (path.empty()) {
+        derror_replica("no manifest found in the learned files");
+        return ERR_CHECKPOINT_FAILED;
+    }
+
+    zauto_lock cl(_checkpoint_lock);
+    checkpoint_manifest manifest;
+    if (!load_manifest(path, manifest)) {
+        return ERR_CHECKPOINT_FAILED;
+    }
+
+    dsn::error_code err;
+    if (mode == chkpt_apply_mode::learn) {
+        zauto_lock l(_write_lock);
+        err = install_checkpoint(path, manifest);
+        if (err == ERR_OK) {
+            err = load_checkpoint(manifest_path(manifest.decree), manifest);
+        }
+    } else {
+        dassert_replica(chkpt_apply_mode::copy == mode, "invalid mode {}", (int)mode);
+        dassert_replica(manifest.decree > last_durable_decree(),
+                        "checkpoint's decree is smaller than current");
+        // the data in memory is not older than the copied checkpoint, only the files are taken
+        err = install_checkpoint(path, manifest);
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    _last_manifest = std::move(manifest);
+    _last_durable_decree.store(_last_manifest.decree);
+    gc_checkpoints();
+    return ERR_OK;
+}
+} // namespace application
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,184 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/blob.h>
+
+#include "simple_kv.server.h"
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+// sharded_kv is a storage engine serving the simple_kv rpcs, aimed at benchmarking the
+// replication framework:
+// - the keys are hashed into shards, each guarded by its own rw lock;
+// - the values are ref-counted blobs, so that a snapshot shares them instead of copying;
+// - a checkpoint takes a copy-on-write snapshot of the shards, which is persisted by the
+//   replication layer in the background while writes go on;
+// - a checkpoint is a manifest "checkpoint.<decree>" referring to one file per shard, and
+//   only the shards written since the last checkpoint are rewritten. Every file lives in
+//   the data dir and is immutable once written, so that learning can reuse the files the
+//   learner already has.
+class sharded_kv_service_impl : public simple_kv_service
+{
+public:
+    static void register_service()
+    {
+        replication_app_base::register_storage_engine(
+            "sharded_kv", replication_app_base::create<sharded_kv_service_impl>);
+    }
+
+    explicit sharded_kv_service_impl(replica *r);
+
+    // RPC_SIMPLE_KV_READ
+    void on_read(const std::string &key, ::dsn::rpc_replier<std::string> &reply) override;
+    // RPC_SIMPLE_KV_WRITE
+    void on_write(const kv_pair &pr, ::dsn::rpc_replier<int32_t> &reply) override;
+    // RPC_SIMPLE_KV_APPEND
+    void on_append(const kv_pair &pr, ::dsn::rpc_replier<int32_t> &reply) override;
+
+    int on_batched_write_requests(int64_t decree,
+                                  uint64_t timestamp,
+                                  dsn::message_ex **requests,
+                                  int request_length) override;
+
+    int on_batched_write_updates(int64_t decree,
+                                 uint64_t timestamp,
+                                 const mutation_update **updates,
+                                 int update_length) override;
+
+    ::dsn::error_code start(int argc, char **argv) override;
+
+    ::dsn::error_code stop(bool clear_state) override;
+
+    int64_t last_durable_decree() const override { return _last_durable_decree.load(); }
+
+    ::dsn::error_code sync_checkpoint() override;
+
+    ::dsn::error_code async_checkpoint(bool flush_memtable) override;
+
+    std::unique_ptr<checkpoint_snapshot> take_checkpoint_snapshot() override;
+
+    ::dsn::error_code copy_checkpoint_to_dir(const char *checkpoint_dir,
+                                             int64_t *last_decree,
+                                             bool flush_memtable = false) override;
+
+    ::dsn::error_code prepare_get_checkpoint(blob &learn_req) override { return dsn::ERR_OK; }
+
+    ::dsn::error_code get_checkpoint(int64_t learn_start,
+                                     const dsn::blob &learn_request,
+                                     /*out*/ learn_state &state) override;
+
+    ::dsn::error_code storage_apply_checkpoint(chkpt_apply_mode mode,
+                                               const learn_state &state) override;
+
+    std::string query_compact_state() const override { return ""; }
+
+    void update_app_envs(const std::map<std::string, std::string> &envs) override {}
+
+    void query_app_envs(/*out*/ std::map<std::string, std::string> &envs) override {}
+
+    uint32_t query_data_version() const override { return 0; }
+
+private:
+    friend class sharded_kv_test;
+
+    typedef std::unordered_map<std::string, blob> kv_map;
+
+    struct shard
+    {
+        zrwlock_nr lock;
+        // shared with the snapshots of the running checkpoint, cloned before being written
+        std::shared_ptr<kv_map> data;
+        // the decree of the last write to this shard
+        int64_t last_write_decree = 0;
+    };
+
+    // the shard files referred by a checkpoint
+    struct checkpoint_manifest
+    {
+        int64_t decree = 0;
+        uint32_t shard_count = 0;
+        std::vector<std::string> shard_files;
+    };
+
+    class snapshot : public checkpoint_snapshot
+    {
+    public:
+        explicit snapshot(sharded_kv_service_impl *app) : _app(app) {}
+        int64_t decree() const override { return _decree; }
+        dsn::error_code write() override { return _app->write_snapshot(*this); }
+
+    private:
+        friend class sharded_kv_service_impl;
+
+        sharded_kv_service_impl *_app;
+        int64_t _decree = 0;
+        std::vector<std::shared_ptr<kv_map>> _data;
+        std::vector<int64_t> _write_decrees;
+    };
+
+    shard &get_shard(const std::string &key);
+    // get the data of the shard for writing, the caller should hold the write lock of it
+    kv_map &mutable_data(shard &s);
+
+    void put(const std::string &key, const std::string &value);
+    void append(const std::string &key, const std::string &value);
+
+    void reset_shards();
+    void load_shard_file(const std::string &path);
+    bool load_manifest(const std::string &path, /*out*/ checkpoint_manifest &manifest) const;
+    // load the checkpoint whose manifest is at path, the shard files are in the same dir
+    dsn::error_code load_checkpoint(const std::string &path,
+                                    /*out*/ checkpoint_manifest &manifest);
+
+    // the dir of path is the data dir if path is not in it: move the files of the checkpoint
+    // into the data dir, the existing files are kept as they have the same content
+    dsn::error_code install_checkpoint(const std::string &manifest_path,
+                                       const checkpoint_manifest &manifest);
+
+    std::unique_ptr<snapshot> take_snapshot();
+    dsn::error_code write_snapshot(const snapshot &s);
+    // remove the files which are referred by none of the manifests kept
+    void gc_checkpoints();
+
+    std::string manifest_path(int64_t decree) const;
+    std::string shard_file_name(uint32_t index, int64_t decree) const;
+
+private:
+    const uint32_t _shard_count;
+    std::vector<std::unique_ptr<shard>> _shards;
+
+    // held during a batch of writes, so that a snapshot is consistent with a decree
+    zlock _write_lock;
+    // the decree of the last write batch applied
+    int64_t _last_applied_decree;
+
+    // only one checkpoint is made at a time
+    zlock _checkpoint_lock;
+    checkpoint_manifest _last_manifest;
+    std::atomic<int64_t> _last_durable_decree;
+};
+} // namespace application
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,303 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "simple_kv.bench.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/toollet/sampling_profiler.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+DSN_DEFINE_uint32("simple_kv.bench", concurrency, 32, "the count of outstanding requests");
+DSN_DEFINE_validator(concurrency, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("simple_kv.bench", read_percent, 50, "the percentage of the reads, 0 - 100");
+DSN_DEFINE_validator(read_percent, [](uint32_t value) -> bool { return value <= 100; });
+DSN_DEFINE_uint32("simple_kv.bench", key_count, 100000, "the count of the keys");
+DSN_DEFINE_validator(key_count, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_string("simple_kv.bench",
+                  key_distribution,
+                  "uniform",
+                  "how the keys are chosen, uniform or zipfian");
+DSN_DEFINE_validator(key_distribution, [](const char *value) -> bool {
+    return strcmp(value, "uniform") == 0 || strcmp(value, "zipfian") == 0;
+});
+DSN_DEFINE_double("simple_kv.bench",
+                  zipfian_theta,
+                  0.99,
+                  "the skew of the zipfian distribution, in (0, 1)");
+DSN_DEFINE_uint32("simple_kv.bench", value_size, 1024, "the size of the written values");
+DSN_DEFINE_bool("simple_kv.bench", preload, true, "write every key once before the warmup");
+DSN_DEFINE_uint32("simple_kv.bench", warmup_seconds, 10, "the seconds before the measurement");
+DSN_DEFINE_uint32("simple_kv.bench", duration_seconds, 30, "the seconds of the measurement");
+DSN_DEFINE_validator(duration_seconds, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("simple_kv.bench", timeout_ms, 5000, "the timeout of every request");
+DSN_DEFINE_string("simple_kv.bench",
+                  profile_path,
+                  "",
+                  "where the sampling profile of the measurement is written, in pprof format, "
+                  "if the sampling_profiler toollet is installed");
+
+// the zipfian generator of "Quickly Generating Billion-Record Synthetic Databases", as in YCSB
+class simple_kv_bench_client_app::zipfian_generator
+{
+public:
+    zipfian_generator(uint64_t n, double theta) : _n(n), _theta(theta)
+    {
+        double zeta2 = zeta(2);
+        _zetan = zeta(n);
+        _alpha = 1.0 / (1.0 - theta);
+        _eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / _zetan);
+        _half_pow_theta = 1.0 + std::pow(0.5, theta);
+    }
+
+    // the rank of the key, 0 is the hottest
+    uint64_t next() const
+    {
+        double u = rand::next_double01();
+        double uz = u * _zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < _half_pow_theta) {
+            return 1;
+        }
+        auto rank = static_cast<uint64_t>(_n * std::pow(_eta * u - _eta + 1, _alpha));
+        return std::min(_n - 1, rank);
+    }
+
+private:
+    double zeta(uint64_t n) const
+    {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(i, _theta);
+        }
+        return sum;
+    }
+
+    uint64_t _n;
+    double _theta;
+    double _zetan;
+    double _alpha;
+    double _eta;
+    double _half_pow_theta;
+};
+
+simple_kv_bench_client_app::simple_kv_bench_client_app(const service_app_info *info)
+    : ::dsn::service_app(info), _value(FLAGS_value_size, 'v')
+{
+}
+
+::dsn::error_code simple_kv_bench_client_app::start(const std::vector<std::string> &args)
+{
+    if (args.size() < 4) {
+        return ::dsn::ERR_INVALID_PARAMETERS;
+    }
+
+    dsn::rpc_address meta;
+    meta.from_string_ipv4(args[2].c_str());
+    _client.reset(new simple_kv_client(args[1].c_str(), {meta}, args[3].c_str()));
+    if (strcmp(FLAGS_key_distribution, "zipfian") == 0) {
+        dassert_f(FLAGS_zipfian_theta > 0 && FLAGS_zipfian_theta < 1,
+                  "invalid zipfian_theta {}",
+                  FLAGS_zipfian_theta);
+        _zipfian.reset(new zipfian_generator(FLAGS_key_count, FLAGS_zipfian_theta));
+    }
+
+    _preloading.store(FLAGS_preload ? FLAGS_concurrency : 0);
+    for (uint32_t i = 0; i < FLAGS_concurrency; ++i) {
+        issue(i);
+    }
+    if (!FLAGS_preload) {
+        tasking::enqueue(LPC_SIMPLE_KV_TEST_TIMER,
+                         &_tracker,
+                         [this]() { report(); },
+                         0,
+                         std::chrono::seconds(FLAGS_warmup_seconds));
+    }
+    return ::dsn::ERR_OK;
+}
+
+::dsn::error_code simple_kv_bench_client_app::stop(bool cleanup)
+{
+    _stopped.store(true);
+    _tracker.cancel_outstanding_tasks();
+    _client.reset();
+    return ::dsn::ERR_OK;
+}
+
+uint64_t simple_kv_bench_client_app::next_key()
+{
+    if (_zipfian == nullptr) {
+        return rand::next_u64(FLAGS_key_count);
+    }
+    // scramble the ranks, so that the hot keys are spread over the partitions
+    uint64_t rank = _zipfian->next();
+    return (rank * 0x9e3779b97f4a7c15ULL) % FLAGS_key_count;
+}
+
+std::string simple_kv_bench_client_app::key_string(uint64_t key) const
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "key%012" PRIu64, key);
+    return buf;
+}
+
+void simple_kv_bench_client_app::issue(int loop)
+{
+    if (_stopped.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::chrono::milliseconds timeout(FLAGS_timeout_ms);
+    if (_preloading.load(std::memory_order_relaxed) > 0) {
+        uint64_t key = _preload_next.fetch_add(1);
+        if (key < FLAGS_key_count) {
+            kv_pair pr;
+            pr.key = key_string(key);
+            pr.value = _value;
+            _client->write(pr,
+                           [this, loop, key](error_code err, int32_t) {
+                               on_preload_done(loop, key, err);
+                           },
+                           timeout,
+                           std::hash<std::string>()(pr.key));
+            return;
+        }
+        if (_preloading.fetch_sub(1) == 1) {
+            // the last loop finishing the preload
+            tasking::enqueue(LPC_SIMPLE_KV_TEST_TIMER,
+                             &_tracker,
+                             [this]() { report(); },
+                             0,
+                             std::chrono::seconds(FLAGS_warmup_seconds));
+        }
+    }
+
+    std::string key = key_string(next_key());
+    uint64_t hash = std::hash<std::string>()(key);
+    uint64_t start_ns = dsn_now_ns();
+    if (rand::next_u32(100) < FLAGS_read_percent) {
+        _client->read(key,
+                      [this, loop, start_ns](error_code err, std::string &&) {
+                          on_done(loop, true, start_ns, err);
+                      },
+                      timeout,
+                      hash);
+    } else {
+        kv_pair pr;
+        pr.key = std::move(key);
+        pr.value = _value;
+        _client->write(pr,
+                       [this, loop, start_ns](error_code err, int32_t) {
+                           on_done(loop, false, start_ns, err);
+                       },
+                       timeout,
+                       hash);
+    }
+}
+
+void simple_kv_bench_client_app::on_preload_done(int loop, uint64_t key, error_code err)
+{
+    if (err != ERR_OK) {
+        // the app may be not ready yet, write the key again
+        dwarn_f("preload key {} failed: {}", key, err);
+        kv_pair pr;
+        pr.key = key_string(key);
+        pr.value = _value;
+        _client->write(pr,
+                       [this, loop, key](error_code err, int32_t) {
+                           on_preload_done(loop, key, err);
+                       },
+                       std::chrono::milliseconds(FLAGS_timeout_ms),
+                       std::hash<std::string>()(pr.key));
+        return;
+    }
+    issue(loop);
+}
+
+void simple_kv_bench_client_app::on_done(int loop, bool is_read, uint64_t start_ns, error_code err)
+{
+    if (_measuring.load(std::memory_order_relaxed)) {
+        op_stats &stats = is_read ? _read : _write;
+        if (err == ERR_OK) {
+            stats.latency.add(dsn_now_ns() - start_ns);
+        } else {
+            stats.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    issue(loop);
+}
+
+void simple_kv_bench_client_app::report()
+{
+    if (!_measuring.load()) {
+        // the warmup is over
+        _measure_start_ns = dsn_now_ns();
+        _measuring.store(true);
+        tasking::enqueue(LPC_SIMPLE_KV_TEST_TIMER,
+                         &_tracker,
+                         [this]() { report(); },
+                         0,
+                         std::chrono::seconds(FLAGS_duration_seconds));
+        return;
+    }
+
+    _measuring.store(false);
+    double seconds = (dsn_now_ns() - _measure_start_ns) / 1e9;
+    for (bool is_read : {true, false}) {
+        const op_stats &stats = is_read ? _read : _write;
+        uint64_t count = stats.latency.count();
+        printf("{\"op\":\"%s\",\"concurrency\":%u,\"read_percent\":%u,\"key_count\":%u,"
+               "\"key_distribution\":\"%s\",\"value_size\":%u,\"count\":%" PRIu64 ","
+               "\"errors\":%" PRIu64 ",\"qps\":%.1f,\"p50_us\":%.3f,\"p99_us\":%.3f,"
+               "\"p999_us\":%.3f,\"max_us\":%.3f}\n",
+               is_read ? "read" : "write",
+               FLAGS_concurrency,
+               FLAGS_read_percent,
+               FLAGS_key_count,
+               FLAGS_key_distribution,
+               FLAGS_value_size,
+               count,
+               stats.errors.load(),
+               count / seconds,
+               stats.latency.percentile(50) / 1e3,
+               stats.latency.percentile(99) / 1e3,
+               stats.latency.percentile(99.9) / 1e3,
+               stats.latency.max() / 1e3);
+    }
+    fflush(stdout);
+
+    if (strlen(FLAGS_profile_path) > 0 && tools::sampling_profiler::installed()) {
+        std::ofstream out(FLAGS_profile_path, std::ios::binary);
+        out << tools::sampling_profiler::get_profile(static_cast<uint32_t>(seconds + 1));
+        ddebug_f("the profile of the measurement is written to {}", FLAGS_profile_path);
+    }
+    dsn_exit(0);
+}
+
+} // namespace application
+} // namespace replication
+} // namespace dsn
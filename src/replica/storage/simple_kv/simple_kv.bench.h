@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <dsn/cpp/service_app.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/latency_histogram.h>
+
+#include "simple_kv.client.h"
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+// simple_kv_bench_client_app is a load generator of the simple_kv rpcs, which is served by
+// both simple_kv and sharded_kv. Its arguments are the same as simple_kv_client_app:
+//
+//   <cluster_name> <meta_server> <app_name>
+//
+// and the load is configured in [simple_kv.bench]. It keeps `concurrency` requests outstanding,
+// each a read at `read_percent` or a write otherwise, of a key chosen uniformly or by a
+// (scrambled) zipfian distribution among `key_count` keys. After preloading every key when
+// `preload` is set and a warmup of `warmup_seconds`, the requests completed in
+// `duration_seconds` are measured, and a line of json is printed per operation. Then, if the
+// sampling_profiler toollet is installed and `profile_path` is set, the profile of the
+// measurement is written to that file, and the process exits.
+class simple_kv_bench_client_app : public ::dsn::service_app
+{
+public:
+    explicit simple_kv_bench_client_app(const service_app_info *info);
+
+    ~simple_kv_bench_client_app() override { stop(); }
+
+    ::dsn::error_code start(const std::vector<std::string> &args) override;
+
+    ::dsn::error_code stop(bool cleanup = false) override;
+
+private:
+    struct op_stats
+    {
+        latency_histogram latency;
+        std::atomic<uint64_t> errors{0};
+    };
+
+    class zipfian_generator;
+
+    void issue(int loop);
+    void on_preload_done(int loop, uint64_t key, error_code err);
+    void on_done(int loop, bool is_read, uint64_t start_ns, error_code err);
+    uint64_t next_key();
+    std::string key_string(uint64_t key) const;
+    void report();
+
+    std::unique_ptr<simple_kv_client> _client;
+    std::unique_ptr<zipfian_generator> _zipfian;
+    std::string _value;
+
+    std::atomic<uint64_t> _preload_next{0};
+    std::atomic<int> _preloading{0};
+    std::atomic<bool> _measuring{false};
+    std::atomic<bool> _stopped{false};
+    uint64_t _measure_start_ns{0};
+    op_stats _read;
+    op_stats _write;
+
+    dsn::task_tracker _tracker;
+};
+
+} // namespace application
+} // namespace replication
+} // namespace dsn
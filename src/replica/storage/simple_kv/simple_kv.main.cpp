@@ -35,7 +35,9 @@
 
 // apps
 #include "simple_kv.app.example.h"
+#include "simple_kv.bench.h"
 #include "simple_kv.server.impl.h"
+#include "sharded_kv.server.impl.h"
 
 // framework specific tools
 #include <dsn/dist/replication/meta_service_app.h>
@@ -47,12 +49,16 @@ static void dsn_app_registration_simple_kv()
     dsn::FLAGS_enable_http_server = false; // disable http server
 
     dsn::replication::application::simple_kv_service_impl::register_service();
+    // shares the rpc handlers registered by simple_kv, may be used with "app_type = sharded_kv"
+    dsn::replication::application::sharded_kv_service_impl::register_service();
 
     dsn::service::meta_service_app::register_all();
     dsn::replication::replication_service_app::register_all();
 
     dsn::service_app::register_factory<dsn::replication::application::simple_kv_client_app>(
         "client");
+    dsn::service_app::register_factory<
+        dsn::replication::application::simple_kv_bench_client_app>("bench_client");
 }
 
 int main(int argc, char **argv)
@@ -0,0 +1,75 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/async_file_deleter.h"
+
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(async_file_deletion_enabled);
+DSN_DECLARE_uint32(async_file_deletion_rate_mb_per_disk);
+
+TEST(async_file_deleter_test, remove_path)
+{
+    const std::string dir = "./async_file_deleter_test";
+    const std::string file = utils::filesystem::path_combine(dir, "log.1.0");
+    const std::string trash =
+        utils::filesystem::path_combine(dir, async_file_deleter::kTrashDirName);
+    utils::filesystem::remove_path(dir);
+    ASSERT_TRUE(utils::filesystem::create_directory(dir));
+    {
+        std::ofstream os(file);
+        os << std::string(3 << 20, 'x');
+    }
+
+    FLAGS_async_file_deletion_enabled = true;
+    FLAGS_async_file_deletion_rate_mb_per_disk = 1;
+    auto &deleter = async_file_deleter::instance();
+
+    // moved away at once
+    ASSERT_TRUE(deleter.remove_path(file));
+    ASSERT_FALSE(utils::filesystem::file_exists(file));
+    ASSERT_TRUE(utils::filesystem::directory_exists(trash));
+
+    // and deleted in chunks
+    deleter.release(1 << 20);
+    std::vector<std::string> files;
+    ASSERT_TRUE(utils::filesystem::get_subfiles(trash, files, false));
+    if (!files.empty()) {
+        int64_t size = 0;
+        ASSERT_TRUE(utils::filesystem::file_size(files[0], size));
+        ASSERT_LE(size, 2 << 20);
+    }
+
+    while (deleter.pending_count() > 0) {
+        deleter.release(1 << 20);
+    }
+    files.clear();
+    ASSERT_TRUE(utils::filesystem::get_subfiles(trash, files, false));
+    ASSERT_TRUE(files.empty());
+
+    FLAGS_async_file_deletion_enabled = false;
+    utils::filesystem::remove_path(dir);
+}
+
+} // namespace replication
+} // namespace dsn
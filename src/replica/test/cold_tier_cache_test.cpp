@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/cold_tier_cache.h"
+
+#include <fstream>
+
+#include <dsn/utility/filesystem.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+class cold_tier_cache_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        utils::filesystem::remove_path(_dir);
+        ASSERT_TRUE(utils::filesystem::create_directory(_dir));
+    }
+
+    void TearDown() override { utils::filesystem::remove_path(_dir); }
+
+    // add a file of `size` bytes to the manifest, and create it locally if `cached`
+    void add_file(cold_tier_manifest &manifest, const std::string &name, int size, bool cached)
+    {
+        cold_tier_file f;
+        f.remote_dir = "/backup/chkpt";
+        f.meta.name = name;
+        f.meta.size = size;
+        manifest.files.push_back(f);
+        if (cached) {
+            std::ofstream os(utils::filesystem::path_combine(_dir, name));
+            os << std::string(size, 'x');
+        }
+    }
+
+    bool file_exists(const std::string &name) const
+    {
+        return utils::filesystem::file_exists(utils::filesystem::path_combine(_dir, name));
+    }
+
+protected:
+    const std::string _dir = "./cold_tier_cache_test";
+};
+
+TEST_F(cold_tier_cache_test, manifest_store_and_load)
+{
+    cold_tier_manifest manifest;
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, manifest.load(_dir));
+
+    manifest.backup_provider_name = "local_service";
+    manifest.cache_capacity_bytes = 1024;
+    add_file(manifest, "1.sst", 10, false);
+    ASSERT_EQ(ERR_OK, manifest.store(_dir));
+
+    cold_tier_manifest loaded;
+    ASSERT_EQ(ERR_OK, loaded.load(_dir));
+    ASSERT_EQ("local_service", loaded.backup_provider_name);
+    ASSERT_EQ(1024, loaded.cache_capacity_bytes);
+    ASSERT_EQ(1, loaded.files.size());
+    ASSERT_EQ("/backup/chkpt", loaded.files[0].remote_dir);
+    ASSERT_EQ("1.sst", loaded.files[0].meta.name);
+    ASSERT_EQ(10, loaded.files[0].meta.size);
+}
+
+TEST_F(cold_tier_cache_test, get_cached_file)
+{
+    cold_tier_manifest manifest;
+    manifest.cache_capacity_bytes = 250;
+    add_file(manifest, "1.sst", 100, true);
+    add_file(manifest, "2.sst", 100, true);
+    add_file(manifest, "3.sst", 100, false);
+
+    cold_tier_cache cache(nullptr, nullptr, _dir, manifest);
+    ASSERT_EQ(2, cache.cached_count());
+    ASSERT_EQ(200, cache.cached_bytes());
+
+    std::string path;
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, cache.get_file("4.sst", path));
+    ASSERT_EQ(ERR_OK, cache.get_file("1.sst", path));
+    ASSERT_EQ(utils::filesystem::path_combine(_dir, "1.sst"), path);
+    ASSERT_FALSE(cache.is_cached("3.sst"));
+}
+
+TEST_F(cold_tier_cache_test, warm_up_over_capacity)
+{
+    cold_tier_manifest manifest;
+    manifest.cache_capacity_bytes = 150;
+    add_file(manifest, "1.sst", 100, true);
+    add_file(manifest, "2.sst", 100, true);
+    // the size doesn't match, which is not cached
+    add_file(manifest, "3.sst", 100, false);
+    {
+        std::ofstream os(utils::filesystem::path_combine(_dir, "3.sst"));
+        os << "partial";
+    }
+
+    cold_tier_cache cache(nullptr, nullptr, _dir, manifest);
+    ASSERT_EQ(1, cache.cached_count());
+    ASSERT_EQ(100, cache.cached_bytes());
+    ASSERT_TRUE(cache.is_cached("2.sst"));
+    ASSERT_FALSE(file_exists("1.sst"));
+    ASSERT_FALSE(cache.is_cached("3.sst"));
+}
+
+} // namespace replication
+} // namespace dsn
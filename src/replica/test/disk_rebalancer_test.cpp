@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/disk_rebalancer.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+class disk_rebalancer_test : public testing::Test
+{
+public:
+    void add_disk(const std::string &tag, int available_ratio, int io_util_percent)
+    {
+        disk_rebalancer::disk_load d;
+        d.tag = tag;
+        d.available_ratio = available_ratio;
+        d.io_util_percent = io_util_percent;
+        _disks.emplace_back(std::move(d));
+    }
+
+    // return "origin->target", or "" if balanced
+    std::string select()
+    {
+        const disk_rebalancer::disk_load *origin = nullptr;
+        const disk_rebalancer::disk_load *target = nullptr;
+        if (!disk_rebalancer::select_disks(_disks, origin, target)) {
+            return "";
+        }
+        return origin->tag + "->" + target->tag;
+    }
+
+private:
+    std::vector<disk_rebalancer::disk_load> _disks;
+};
+
+TEST_F(disk_rebalancer_test, single_disk)
+{
+    add_disk("ssd1", 10, 100);
+    ASSERT_EQ("", select());
+}
+
+TEST_F(disk_rebalancer_test, balanced)
+{
+    add_disk("ssd1", 50, 40);
+    add_disk("ssd2", 45, 20);
+    ASSERT_EQ("", select());
+}
+
+TEST_F(disk_rebalancer_test, by_space)
+{
+    add_disk("ssd1", 50, 0);
+    add_disk("ssd2", 20, 0);
+    add_disk("ssd3", 40, 90);
+    ASSERT_EQ("ssd2->ssd1", select());
+}
+
+TEST_F(disk_rebalancer_test, by_io)
+{
+    add_disk("ssd1", 50, 90);
+    add_disk("ssd2", 45, 10);
+    ASSERT_EQ("ssd1->ssd2", select());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,208 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "replica/group_check_batcher.h"
+#include "replica_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(group_check_batch_max_count);
+
+class group_check_batcher_test : public replica_stub_test_base
+{
+public:
+    group_check_batcher_test() : _batcher(stub.get()) {}
+
+    ~group_check_batcher_test() { _tracker.cancel_outstanding_tasks(); }
+
+    // queues a group check of partition 1.pidx to `node`, whose reply is recorded in _replies
+    task_ptr add(const rpc_address &node, int pidx)
+    {
+        group_check_request request;
+        request.config.pid = gpid(1, pidx);
+        return _batcher.add(node,
+                            request,
+                            &_tracker,
+                            0,
+                            [this, pidx](error_code err, group_check_response &&resp) {
+                                zauto_lock l(_lock);
+                                _replies[pidx] = std::make_pair(err, resp.pid);
+                            });
+    }
+
+    std::vector<group_check_batcher::pending_check> take_pending(const rpc_address &node)
+    {
+        zauto_lock l(_batcher._lock);
+        auto checks = std::move(_batcher._pending[node]);
+        _batcher._pending.erase(node);
+        return checks;
+    }
+
+    size_t pending_count(const rpc_address &node)
+    {
+        zauto_lock l(_batcher._lock);
+        auto iter = _batcher._pending.find(node);
+        return iter == _batcher._pending.end() ? 0 : iter->second.size();
+    }
+
+    void on_batch_reply(const rpc_address &node,
+                        error_code err,
+                        std::vector<group_check_response> &&responses)
+    {
+        auto checks = take_pending(node);
+        _batcher.on_batch_reply(node, err, checks, std::move(responses));
+    }
+
+    void expire_unbatched(const rpc_address &node)
+    {
+        zauto_lock l(_batcher._lock);
+        _batcher._unbatched_nodes[node] = dsn_now_ms();
+    }
+
+    std::pair<error_code, gpid> reply_of(int pidx)
+    {
+        zauto_lock l(_lock);
+        return _replies[pidx];
+    }
+
+    static std::vector<int> pidxes(const std::vector<group_check_request> &requests)
+    {
+        std::vector<int> result;
+        for (const auto &request : requests) {
+            result.emplace_back(request.config.pid.get_partition_index());
+        }
+        return result;
+    }
+
+    // the callbacks queued in the batcher are tracked by _tracker, which must outlive it
+    dsn::task_tracker _tracker;
+    group_check_batcher _batcher;
+
+    zlock _lock; // protect _replies
+    std::map<int, std::pair<error_code, gpid>> _replies;
+
+    const rpc_address _node1{"127.0.0.1", 34801};
+    const rpc_address _node2{"127.0.0.1", 34802};
+};
+
+TEST_F(group_check_batcher_test, batch_checks_by_node)
+{
+    uint32_t old_max_count = FLAGS_group_check_batch_max_count;
+    FLAGS_group_check_batch_max_count = 3;
+
+    RPC_MOCKING(group_check_batch_rpc)
+    {
+        auto &mail_box = group_check_batch_rpc::mail_box();
+
+        add(_node1, 1);
+        add(_node1, 2);
+        add(_node2, 4);
+        ASSERT_EQ(0u, mail_box.size());
+
+        // the batch is sent at once when full
+        add(_node1, 3);
+        ASSERT_EQ(1u, mail_box.size());
+        ASSERT_EQ(std::vector<int>({1, 2, 3}), pidxes(mail_box[0].request().requests));
+        ASSERT_EQ(0u, pending_count(_node1));
+
+        // the others are sent on flush
+        _batcher.flush();
+        ASSERT_EQ(2u, mail_box.size());
+        ASSERT_EQ(std::vector<int>({4}), pidxes(mail_box[1].request().requests));
+
+        _batcher.flush();
+        ASSERT_EQ(2u, mail_box.size());
+    }
+
+    FLAGS_group_check_batch_max_count = old_max_count;
+}
+
+TEST_F(group_check_batcher_test, fan_out_batch_reply)
+{
+    std::vector<task_ptr> tasks;
+    for (int pidx = 1; pidx <= 3; ++pidx) {
+        tasks.emplace_back(add(_node1, pidx));
+    }
+
+    // each check gets its own response, the ones the remote node didn't handle fail
+    std::vector<group_check_response> responses(2);
+    responses[0].pid = gpid(1, 1);
+    responses[1].pid = gpid(1, 2);
+    on_batch_reply(_node1, ERR_OK, std::move(responses));
+    for (const auto &task : tasks) {
+        task->wait();
+    }
+    ASSERT_EQ(std::make_pair(ERR_OK, gpid(1, 1)), reply_of(1));
+    ASSERT_EQ(std::make_pair(ERR_OK, gpid(1, 2)), reply_of(2));
+    ASSERT_EQ(ERR_INVALID_STATE, reply_of(3).first);
+
+    // the error of the batch spreads to all of its checks
+    tasks.clear();
+    for (int pidx = 4; pidx <= 5; ++pidx) {
+        tasks.emplace_back(add(_node1, pidx));
+    }
+    on_batch_reply(_node1, ERR_TIMEOUT, std::vector<group_check_response>());
+    for (const auto &task : tasks) {
+        task->wait();
+    }
+    ASSERT_EQ(ERR_TIMEOUT, reply_of(4).first);
+    ASSERT_EQ(ERR_TIMEOUT, reply_of(5).first);
+}
+
+TEST_F(group_check_batcher_test, fall_back_for_old_nodes)
+{
+    RPC_MOCKING(group_check_rpc)
+    {
+        RPC_MOCKING(group_check_batch_rpc)
+        {
+            auto &single_mail_box = group_check_rpc::mail_box();
+            auto &batch_mail_box = group_check_batch_rpc::mail_box();
+
+            add(_node1, 1);
+            add(_node1, 2);
+            add(_node2, 3);
+
+            // the checks of the batch which _node1 can't handle are resent one by one
+            on_batch_reply(_node1, ERR_HANDLER_NOT_FOUND, std::vector<group_check_response>());
+            ASSERT_EQ(2u, single_mail_box.size());
+            ASSERT_EQ(gpid(1, 1), single_mail_box[0].request().config.pid);
+            ASSERT_EQ(gpid(1, 2), single_mail_box[1].request().config.pid);
+
+            // so are the later checks to _node1, while the ones to _node2 are still batched
+            add(_node1, 4);
+            ASSERT_EQ(3u, single_mail_box.size());
+            ASSERT_EQ(gpid(1, 4), single_mail_box[2].request().config.pid);
+            ASSERT_EQ(0u, pending_count(_node1));
+            _batcher.flush();
+            ASSERT_EQ(1u, batch_mail_box.size());
+            ASSERT_EQ(std::vector<int>({3}), pidxes(batch_mail_box[0].request().requests));
+
+            // batching to _node1 is retried after a while
+            expire_unbatched(_node1);
+            add(_node1, 5);
+            ASSERT_EQ(3u, single_mail_box.size());
+            ASSERT_EQ(1u, pending_count(_node1));
+        }
+    }
+}
+
+} // namespace replication
+} // namespace dsn
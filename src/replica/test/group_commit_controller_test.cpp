@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/group_commit_controller.h"
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(log_adaptive_group_commit);
+DSN_DECLARE_uint32(log_group_commit_latency_target_us);
+DSN_DECLARE_uint32(log_group_commit_max_batch_count);
+
+class group_commit_controller_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_target = FLAGS_log_group_commit_latency_target_us;
+        _old_max_count = FLAGS_log_group_commit_max_batch_count;
+        FLAGS_log_group_commit_latency_target_us = 2000;
+        FLAGS_log_group_commit_max_batch_count = 100;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_log_group_commit_latency_target_us = _old_target;
+        FLAGS_log_group_commit_max_batch_count = _old_max_count;
+    }
+
+    // appends `count` mutations with a constant interval, starting at `start_us`
+    static uint64_t append(group_commit_controller &c, uint64_t start_us, int count, uint64_t step)
+    {
+        uint64_t now = start_us;
+        for (int i = 0; i < count; ++i) {
+            now += step;
+            c.on_append(now);
+        }
+        return now;
+    }
+
+private:
+    uint32_t _old_target;
+    uint32_t _old_max_count;
+};
+
+TEST_F(group_commit_controller_test, no_history)
+{
+    group_commit_controller c("group_commit_controller_test");
+    // nothing is known about the arrival, so do not wait
+    ASSERT_EQ(0, c.flush_delay_us(1, 1000, 1000));
+}
+
+TEST_F(group_commit_controller_test, wait_for_expected_arrivals)
+{
+    group_commit_controller c("group_commit_controller_test");
+    uint64_t now = append(c, 1000000, 50, 100);
+    ASSERT_EQ(100, c.arrival_interval_us());
+
+    c.on_write_completed(1000);
+    ASSERT_EQ(1000, c.write_latency_us());
+
+    // budget = 2000 - 1000 = 1000us, about 11 appends are expected within it
+    ASSERT_EQ(1000, c.flush_delay_us(1, now, now));
+    ASSERT_EQ(600, c.flush_delay_us(5, now - 400, now));
+    ASSERT_EQ(0, c.flush_delay_us(11, now - 400, now));
+
+    // the budget is used up
+    ASSERT_EQ(0, c.flush_delay_us(2, now - 1000, now));
+    // no append is expected in the rest of the budget
+    ASSERT_EQ(0, c.flush_delay_us(2, now - 950, now));
+}
+
+TEST_F(group_commit_controller_test, slow_write)
+{
+    group_commit_controller c("group_commit_controller_test");
+    uint64_t now = append(c, 1000000, 50, 10);
+    // the write alone takes longer than the target
+    c.on_write_completed(3000);
+    ASSERT_EQ(0, c.flush_delay_us(1, now, now));
+
+    // the write becomes faster
+    for (int i = 0; i < 100; ++i) {
+        c.on_write_completed(500);
+    }
+    ASSERT_GT(c.flush_delay_us(1, now, now), 0);
+}
+
+TEST_F(group_commit_controller_test, max_batch_count)
+{
+    group_commit_controller c("group_commit_controller_test");
+    uint64_t now = append(c, 1000000, 50, 1);
+    c.on_write_completed(100);
+    ASSERT_GT(c.flush_delay_us(99, now, now), 0);
+    ASSERT_EQ(0, c.flush_delay_us(100, now, now));
+}
+
+TEST_F(group_commit_controller_test, idle_interval_is_bounded)
+{
+    group_commit_controller c("group_commit_controller_test");
+    c.on_append(1);
+    c.on_append(100000000);
+    ASSERT_EQ(1000000, c.arrival_interval_us());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/hotkey_detector.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(hotkey_detector_test, start_stop)
+{
+    hotkey_detector d;
+    ASSERT_FALSE(d.running());
+    ASSERT_FALSE(d.stop());
+
+    // not running, nothing is recorded
+    for (int i = 0; i < 100; ++i) {
+        d.record(1);
+    }
+    ASSERT_TRUE(d.top_keys().empty());
+
+    ASSERT_TRUE(d.start());
+    ASSERT_FALSE(d.start());
+    ASSERT_TRUE(d.running());
+    ASSERT_TRUE(d.stop());
+    ASSERT_FALSE(d.running());
+}
+
+TEST(hotkey_detector_test, top_keys)
+{
+    hotkey_detector d;
+    ASSERT_TRUE(d.start());
+
+    // two hot keys among many cold ones
+    for (uint64_t i = 0; i < 200000; ++i) {
+        d.record(0x1234);
+        d.record(i % 2 == 0 ? 0x5678 : i + 0x20000000);
+        d.record(i + 0x10000);
+    }
+    auto keys = d.top_keys();
+    ASSERT_FALSE(keys.empty());
+    ASSERT_LE(keys.size(), 10);
+    ASSERT_EQ(0x1234, keys[0].hash);
+    ASSERT_EQ(0x5678, keys[1].hash);
+    ASSERT_GT(keys[0].count, keys[1].count);
+    ASSERT_NE(std::string::npos, d.dump().find("\"0x1234\""));
+
+    ASSERT_TRUE(d.stop());
+    ASSERT_TRUE(d.top_keys().empty());
+}
+
+} // namespace replication
+} // namespace dsn
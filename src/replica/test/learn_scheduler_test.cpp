@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "replica/learn_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint64(learn_scheduler_waiting_expire_ms);
+DSN_DECLARE_int32(learn_urgent_replica_count);
+
+TEST(learn_scheduler_test, admit_by_urgency)
+{
+    learn_scheduler s;
+    learn_scheduler::urgency adding_third{2, 1};
+    learn_scheduler::urgency single{1, 2};
+    gpid p1(1, 1), p2(1, 2), p3(1, 3);
+
+    ASSERT_TRUE(s.try_admit(p1, adding_third, 1, 1000));
+    // admitted again in the later rounds
+    ASSERT_TRUE(s.try_admit(p1, adding_third, 1, 1000));
+    ASSERT_TRUE(s.is_full(1));
+
+    // no free slot, both wait
+    ASSERT_FALSE(s.try_admit(p2, adding_third, 1, 1000));
+    ASSERT_FALSE(s.try_admit(p3, single, 1, 1000));
+    ASSERT_EQ(2, s.waiting_count());
+
+    // the slot is freed, the less urgent one comes first but gives way
+    s.release(p1);
+    ASSERT_FALSE(s.try_admit(p2, adding_third, 1, 2000));
+    ASSERT_TRUE(s.try_admit(p3, single, 1, 2000));
+    ASSERT_EQ(1, s.running_count());
+    ASSERT_EQ(1, s.waiting_count());
+
+    s.release(p3);
+    ASSERT_TRUE(s.try_admit(p2, adding_third, 1, 3000));
+    ASSERT_EQ(0, s.waiting_count());
+}
+
+TEST(learn_scheduler_test, waiting_expire)
+{
+    uint64_t old_expire_ms = FLAGS_learn_scheduler_waiting_expire_ms;
+    FLAGS_learn_scheduler_waiting_expire_ms = 100;
+
+    learn_scheduler s;
+    gpid p1(1, 1), p2(1, 2), p3(1, 3);
+    ASSERT_TRUE(s.try_admit(p1, {2, 1}, 1, 1000));
+    ASSERT_FALSE(s.try_admit(p3, {1, 2}, 1, 1000));
+    s.release(p1);
+
+    // the more urgent one is still waiting
+    ASSERT_FALSE(s.try_admit(p2, {2, 1}, 1, 1050));
+    // but not any more if it does not retry in time
+    ASSERT_TRUE(s.try_admit(p2, {2, 1}, 1, 1100));
+    ASSERT_EQ(0, s.waiting_count());
+
+    FLAGS_learn_scheduler_waiting_expire_ms = old_expire_ms;
+}
+
+TEST(learn_scheduler_test, urgency)
+{
+    ASSERT_TRUE(learn_scheduler::urgency({1, 1}).higher_than({2, 1}));
+    ASSERT_TRUE(learn_scheduler::urgency({2, 2}).higher_than({2, 1}));
+    ASSERT_FALSE(learn_scheduler::urgency({2, 1}).higher_than({2, 1}));
+
+    int old_count = FLAGS_learn_urgent_replica_count;
+    FLAGS_learn_urgent_replica_count = 1;
+    ASSERT_TRUE(learn_scheduler::is_urgent({1, 2}));
+    ASSERT_FALSE(learn_scheduler::is_urgent({2, 1}));
+    FLAGS_learn_urgent_replica_count = old_count;
+}
+
+} // namespace replication
+} // namespace dsn
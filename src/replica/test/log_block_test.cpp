@@ -6,6 +6,8 @@
 
 #include "replica_test_base.h"
 
+#include <dsn/utility/rand.h>
+
 namespace dsn {
 namespace replication {
 
@@ -153,5 +155,100 @@ TEST_F(log_appender_test, read_log_block)
     ASSERT_EQ(mutation_idx, 1024);
 }
 
+// reads the blocks written by `appender` back, returns the number of mutations
+static int read_log_blocks(log_appender &appender, const std::vector<std::string> &data)
+{
+    std::string buffer;
+    for (const auto &block : appender.all_blocks()) {
+        for (const blob &bb : block.data()) {
+            buffer += bb.to_string();
+        }
+    }
+    EXPECT_EQ(buffer.size(), appender.size());
+
+    auto bb = blob::create_from_bytes(std::move(buffer));
+    binary_reader reader(bb);
+    int mutation_idx = 0;
+    for (const auto &expected_block : appender.all_blocks()) {
+        blob hdr_bb;
+        reader.read(hdr_bb, sizeof(log_block_header));
+        log_block_header hdr = *reinterpret_cast<const log_block_header *>(hdr_bb.data());
+        EXPECT_TRUE(hdr.is_compressed());
+
+        blob blk_bb;
+        reader.read(blk_bb, expected_block.size() - sizeof(log_block_header));
+        EXPECT_EQ(ERR_OK, log_block::decompress(hdr, blk_bb));
+        binary_reader blk_reader(blk_bb);
+        while (!blk_reader.is_eof()) {
+            mutation_ptr mu = mutation::read_from(blk_reader, nullptr);
+            EXPECT_EQ(mu->data.header.log_offset,
+                      expected_block.start_offset() + sizeof(log_block_header));
+            EXPECT_EQ(mu->data.updates[0].data.to_string(), data[mutation_idx]);
+            mutation_idx++;
+        }
+    }
+    EXPECT_TRUE(reader.is_eof());
+    return mutation_idx;
+}
+
+TEST_F(log_appender_test, compressed_blocks)
+{
+    for (auto type : {utils::compression_type::lz4, utils::compression_type::zstd}) {
+        if (!utils::compression_supported(type)) {
+            continue;
+        }
+
+        log_appender appender(10, type);
+        std::vector<std::string> data;
+        size_t raw_size = 0;
+        for (int i = 0; i < 1024; i++) { // more than DEFAULT_MAX_BLOCK_BYTES
+            data.emplace_back(1024, 'a' + i % 26);
+            appender.append_mutation(create_test_mutation(1 + i, data.back()), nullptr);
+            raw_size += data.back().size();
+        }
+        appender.seal();
+        ASSERT_EQ(appender.all_blocks().size(), 2);
+
+        int64_t start_offset = 10;
+        for (const log_block &blk : appender.all_blocks()) {
+            ASSERT_TRUE(blk.compressed());
+            ASSERT_EQ(blk.data().size(), 2);
+            ASSERT_EQ(blk.start_offset(), start_offset);
+            start_offset += blk.size();
+        }
+        ASSERT_LT(appender.size(), raw_size / 10);
+        ASSERT_EQ(read_log_blocks(appender, data), 1024);
+    }
+}
+
+TEST_F(log_appender_test, incompressible_blocks)
+{
+    for (auto type : {utils::compression_type::lz4, utils::compression_type::zstd}) {
+        if (!utils::compression_supported(type)) {
+            continue;
+        }
+
+        log_appender appender(10, type);
+        std::vector<std::string> data;
+        for (int i = 0; i < 16; i++) {
+            std::string value(1024, '\0');
+            for (auto &c : value) {
+                c = static_cast<char>(rand::next_u32(0, 255));
+            }
+            data.emplace_back(std::move(value));
+            appender.append_mutation(create_test_mutation(1 + i, data.back()), nullptr);
+        }
+        appender.seal();
+
+        // the data is stored as is, still in the format of the compressed blocks
+        const log_block &blk = appender.all_blocks().back();
+        ASSERT_TRUE(blk.compressed());
+        auto chdr = reinterpret_cast<const log_block_compression_header *>(blk.data()[1].data());
+        ASSERT_EQ(chdr->type, static_cast<uint32_t>(utils::compression_type::none));
+        ASSERT_EQ(chdr->raw_length + sizeof(*chdr), blk.data()[1].length());
+        ASSERT_EQ(read_log_blocks(appender, data), 16);
+    }
+}
+
 } // namespace replication
 } // namespace dsn
@@ -0,0 +1,449 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <boost/lexical_cast.hpp>
+#include <fmt/format.h>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/latency_histogram.h>
+#include <dsn/tool_api.h>
+
+#include "aio/aio_provider.h"
+#include "replica/mutation_log.h"
+#include "replica/test/mock_utils.h"
+
+// Benchmarks the mutation log on a real directory, e.g.
+//
+//   dsn_mlog_bench --mode=shared --concurrency=8 --mutation_size=1024 --aio_provider=io_uring
+//   dsn_mlog_bench --mode=private --concurrency=16 --mutations=200000
+//
+// in the "shared" mode `concurrency` writers, each as a partition, append to one shared log,
+// every writer keeping `max_pending` appends outstanding, and the commit latency is from the
+// append to its callback. in the "private" mode every writer appends to its own private log,
+// which has no callback, so the commit latency is from the append to the moment a poller sees
+// the mutation in `max_commit_on_disk()`, which adds up to `poll_interval_us` to it.
+//
+// the disk io goes through a counting provider which forwards to `aio_provider`, so that the
+// writes and fsyncs of any provider are counted. after the appends complete, the logs are closed
+// and replayed. a single line of json is printed at the end.
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_string("mlog_bench",
+                  aio_provider,
+                  "dsn::tools::native_aio_provider",
+                  "the aio provider which dsn::tools::mlog_bench_aio_provider forwards to");
+
+struct bench_options
+{
+    std::string mode = "shared";
+    std::string aio_provider = "native";
+    std::string dir = "./mlog_bench_data";
+    int mutation_size = 1024;
+    int concurrency = 4;
+    int max_pending = 64;
+    int mutations = 100000;
+    int log_file_mb = 32;
+    bool force_flush = true;
+    int batch_buffer_kb = 512;
+    int batch_buffer_count = 512;
+    int batch_flush_interval_ms = 10000;
+    int poll_interval_us = 50;
+    int callback_threads = 4;
+};
+
+static bench_options s_opts;
+
+static std::atomic<uint64_t> s_write_count{0};
+static std::atomic<uint64_t> s_write_bytes{0};
+static std::atomic<uint64_t> s_flush_count{0};
+
+class mlog_bench_aio_provider : public aio_provider
+{
+public:
+    explicit mlog_bench_aio_provider(disk_engine *disk)
+        : aio_provider(disk),
+          _inner(utils::factory_store<aio_provider>::create(
+              FLAGS_aio_provider, PROVIDER_TYPE_MAIN, disk))
+    {
+        dassert_f(_inner != nullptr, "aio provider {} is not found", FLAGS_aio_provider);
+    }
+
+    dsn_handle_t open(const char *file_name, int flag, int pmode) override
+    {
+        return _inner->open(file_name, flag, pmode);
+    }
+
+    error_code close(dsn_handle_t fh) override { return _inner->close(fh); }
+
+    error_code flush(dsn_handle_t fh) override
+    {
+        s_flush_count.fetch_add(1, std::memory_order_relaxed);
+        return _inner->flush(fh);
+    }
+
+    error_code write(const aio_context &aio_ctx, /*out*/ uint32_t *processed_bytes) override
+    {
+        return _inner->write(aio_ctx, processed_bytes);
+    }
+
+    error_code read(const aio_context &aio_ctx, /*out*/ uint32_t *processed_bytes) override
+    {
+        return _inner->read(aio_ctx, processed_bytes);
+    }
+
+    void submit_aio_task(aio_task *aio) override
+    {
+        if (aio->get_aio_context()->type == AIO_Write) {
+            s_write_count.fetch_add(1, std::memory_order_relaxed);
+            s_write_bytes.fetch_add(aio->get_aio_context()->buffer_size,
+                                    std::memory_order_relaxed);
+        }
+        _inner->submit_aio_task(aio);
+    }
+
+    aio_context *prepare_aio_context(aio_task *tsk) override
+    {
+        return _inner->prepare_aio_context(tsk);
+    }
+
+    bool support_vectored_write() const override { return _inner->support_vectored_write(); }
+
+private:
+    std::unique_ptr<aio_provider> _inner;
+};
+
+DSN_REGISTER_COMPONENT_PROVIDER(mlog_bench_aio_provider, "dsn::tools::mlog_bench_aio_provider");
+
+static latency_histogram s_latency;
+
+static mutation_ptr create_mutation(gpid pid, decree d, const blob &data, bool is_private)
+{
+    mutation_ptr mu(new mutation());
+    mu->data.header.ballot = 1;
+    mu->data.header.decree = d;
+    mu->data.header.pid = pid;
+    // the private log reports the max last_committed_decree on disk, which is how the poller
+    // learns that the mutation is durable
+    mu->data.header.last_committed_decree = is_private ? d : d - 1;
+    mu->data.header.log_offset = 0;
+    mu->data.header.timestamp = dsn_now_us();
+
+    mu->data.updates.emplace_back(mutation_update());
+    mu->data.updates.back().code = RPC_COLD_BACKUP; // whatever code it is but WRITE_EMPTY
+    mu->data.updates.back().data = data;
+    mu->client_requests.push_back(nullptr);
+    mu->set_logged();
+    return mu;
+}
+
+static void wait_until(const std::function<bool()> &done)
+{
+    while (!done()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(s_opts.poll_interval_us));
+    }
+}
+
+static void run_shared(const blob &data)
+{
+    mutation_log_ptr mlog =
+        new mutation_log_shared(s_opts.dir, s_opts.log_file_mb, s_opts.force_flush);
+    error_code err = mlog->open([](int, mutation_ptr &) { return true; }, nullptr);
+    dassert_f(err == ERR_OK, "open shared log failed: {}", err);
+
+    std::vector<std::atomic<int>> pending(s_opts.concurrency);
+    std::vector<std::thread> writers;
+    for (int i = 0; i < s_opts.concurrency; ++i) {
+        writers.emplace_back([&, i]() {
+            dsn_mimic_app("mlog_bench", 1);
+            gpid pid(1, i);
+            for (decree d = 1; d <= s_opts.mutations; ++d) {
+                wait_until([&]() { return pending[i].load() < s_opts.max_pending; });
+                mutation_ptr mu = create_mutation(pid, d, data, false);
+                uint64_t start_ns = dsn_now_ns();
+                pending[i].fetch_add(1);
+                mlog->append(mu,
+                             LPC_WRITE_REPLICATION_LOG_SHARED,
+                             nullptr,
+                             [&pending, i, start_ns](error_code err, size_t) {
+                                 dassert_f(err == ERR_OK, "append shared log failed: {}", err);
+                                 s_latency.add(dsn_now_ns() - start_ns);
+                                 pending[i].fetch_sub(1);
+                             },
+                             i);
+            }
+            wait_until([&]() { return pending[i].load() == 0; });
+        });
+    }
+    for (auto &t : writers) {
+        t.join();
+    }
+    mlog->close();
+}
+
+static void run_private(const blob &data)
+{
+    mock_replica_stub stub;
+    std::vector<std::unique_ptr<mock_replica>> replicas;
+    std::vector<mutation_log_ptr> mlogs;
+    for (int i = 0; i < s_opts.concurrency; ++i) {
+        std::string dir = utils::filesystem::path_combine(s_opts.dir, std::to_string(i));
+        replicas.emplace_back(create_mock_replica(&stub, 1, i, dir.c_str()));
+        mlogs.emplace_back(new mutation_log_private(dir,
+                                                    s_opts.log_file_mb,
+                                                    gpid(1, i),
+                                                    replicas.back().get(),
+                                                    s_opts.batch_buffer_kb * 1024,
+                                                    s_opts.batch_buffer_count,
+                                                    s_opts.batch_flush_interval_ms));
+        error_code err = mlogs.back()->open([](int, mutation_ptr &) { return true; }, nullptr);
+        dassert_f(err == ERR_OK, "open private log failed: {}", err);
+    }
+
+    // the append time of every decree, which is read by the poller after the decree is on disk
+    std::vector<std::vector<uint64_t>> append_ns(
+        s_opts.concurrency, std::vector<uint64_t>(s_opts.mutations + 1));
+    std::atomic<int> running{s_opts.concurrency};
+    std::vector<std::thread> writers;
+    for (int i = 0; i < s_opts.concurrency; ++i) {
+        writers.emplace_back([&, i]() {
+            dsn_mimic_app("mlog_bench", 1);
+            gpid pid(1, i);
+            for (decree d = 1; d <= s_opts.mutations; ++d) {
+                while (d - mlogs[i]->max_commit_on_disk() > s_opts.max_pending) {
+                    // as the prepare window of a replica, stop appending until the pending
+                    // mutations are on disk
+                    mlogs[i]->flush_once();
+                }
+                mutation_ptr mu = create_mutation(pid, d, data, true);
+                append_ns[i][d] = dsn_now_ns();
+                mlogs[i]->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, nullptr, nullptr, i);
+            }
+            mlogs[i]->flush();
+            running.fetch_sub(1);
+        });
+    }
+
+    std::vector<decree> durable(s_opts.concurrency, 0);
+    bool all_durable = false;
+    while (!all_durable) {
+        bool finished = running.load() == 0;
+        all_durable = true;
+        for (int i = 0; i < s_opts.concurrency; ++i) {
+            decree on_disk = mlogs[i]->max_commit_on_disk();
+            uint64_t now_ns = dsn_now_ns();
+            for (decree d = durable[i] + 1; d <= on_disk; ++d) {
+                s_latency.add(now_ns - append_ns[i][d]);
+            }
+            durable[i] = std::max(durable[i], on_disk);
+            all_durable = all_durable && durable[i] == s_opts.mutations;
+        }
+        dassert_f(!finished || all_durable, "the flushed mutations are not all on disk");
+        std::this_thread::sleep_for(std::chrono::microseconds(s_opts.poll_interval_us));
+    }
+    for (auto &t : writers) {
+        t.join();
+    }
+    for (auto &mlog : mlogs) {
+        mlog->close();
+    }
+}
+
+// replays the logs under every directory of `dirs`, returns the bytes of the log files
+static int64_t replay_logs(const std::vector<std::string> &dirs, /*out*/ int64_t &replayed)
+{
+    int64_t total_bytes = 0;
+    replayed = 0;
+    for (const std::string &dir : dirs) {
+        std::vector<std::string> files;
+        dassert_f(utils::filesystem::get_subfiles(dir, files, false), "list {} failed", dir);
+        for (const std::string &file : files) {
+            int64_t sz = 0;
+            utils::filesystem::file_size(file, sz);
+            total_bytes += sz;
+        }
+        int64_t end_offset;
+        error_code err = mutation_log::replay(files,
+                                              [&replayed](int, mutation_ptr &) {
+                                                  ++replayed;
+                                                  return true;
+                                              },
+                                              end_offset);
+        dassert_f(err == ERR_OK || err == ERR_HANDLE_EOF, "replay {} failed: {}", dir, err);
+    }
+    return total_bytes;
+}
+
+static void run_bench()
+{
+    utils::filesystem::remove_path(s_opts.dir);
+    dassert_f(utils::filesystem::create_directory(s_opts.dir), "create {} failed", s_opts.dir);
+
+    blob data = blob::create_from_bytes(std::string(s_opts.mutation_size, 'x'));
+    uint64_t start_ns = dsn_now_ns();
+    if (s_opts.mode == "shared") {
+        run_shared(data);
+    } else {
+        run_private(data);
+    }
+    double append_seconds = (dsn_now_ns() - start_ns) / 1e9;
+    uint64_t appended = static_cast<uint64_t>(s_opts.concurrency) * s_opts.mutations;
+
+    std::vector<std::string> dirs;
+    if (s_opts.mode == "shared") {
+        dirs.push_back(s_opts.dir);
+    } else {
+        for (int i = 0; i < s_opts.concurrency; ++i) {
+            dirs.push_back(utils::filesystem::path_combine(s_opts.dir, std::to_string(i)));
+        }
+    }
+    int64_t replayed = 0;
+    start_ns = dsn_now_ns();
+    int64_t log_bytes = replay_logs(dirs, replayed);
+    double replay_seconds = (dsn_now_ns() - start_ns) / 1e9;
+    dassert_f(replayed == appended, "{} mutations are replayed, {} appended", replayed, appended);
+
+    printf("{\"mode\":\"%s\",\"aio_provider\":\"%s\",\"mutation_size\":%d,\"concurrency\":%d,"
+           "\"max_pending\":%d,\"mutations\":%" PRIu64 ",\"append_per_second\":%.1f,"
+           "\"append_mb_per_second\":%.3f,\"commit_p50_us\":%.3f,\"commit_p99_us\":%.3f,"
+           "\"commit_p999_us\":%.3f,\"commit_max_us\":%.3f,\"writes\":%" PRIu64 ","
+           "\"write_bytes\":%" PRIu64 ",\"fsyncs\":%" PRIu64 ",\"replay_mb_per_second\":%.3f}\n",
+           s_opts.mode.c_str(),
+           FLAGS_aio_provider,
+           s_opts.mutation_size,
+           s_opts.concurrency,
+           s_opts.max_pending,
+           appended,
+           appended / append_seconds,
+           appended * s_opts.mutation_size / 1048576.0 / append_seconds,
+           s_latency.percentile(50) / 1e3,
+           s_latency.percentile(99) / 1e3,
+           s_latency.percentile(99.9) / 1e3,
+           s_latency.max() / 1e3,
+           s_write_count.load(),
+           s_write_bytes.load(),
+           s_flush_count.load(),
+           log_bytes / 1048576.0 / std::max(replay_seconds, 1e-9));
+    fflush(stdout);
+}
+
+class mlog_bench_app : public service_app
+{
+public:
+    explicit mlog_bench_app(const service_app_info *info) : service_app(info) {}
+
+    error_code start(const std::vector<std::string> &args) override { return ERR_OK; }
+
+    error_code stop(bool cleanup) override { return ERR_OK; }
+};
+
+static bool parse_options(int argc, char **argv, /*out*/ bench_options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "mode") {
+                opts.mode = value;
+            } else if (key == "aio_provider") {
+                opts.aio_provider = value;
+            } else if (key == "dir") {
+                opts.dir = value;
+            } else if (key == "mutation_size") {
+                opts.mutation_size = boost::lexical_cast<int>(value);
+            } else if (key == "concurrency") {
+                opts.concurrency = boost::lexical_cast<int>(value);
+            } else if (key == "max_pending") {
+                opts.max_pending = boost::lexical_cast<int>(value);
+            } else if (key == "mutations") {
+                opts.mutations = boost::lexical_cast<int>(value);
+            } else if (key == "log_file_mb") {
+                opts.log_file_mb = boost::lexical_cast<int>(value);
+            } else if (key == "force_flush") {
+                opts.force_flush = boost::lexical_cast<bool>(value);
+            } else if (key == "batch_buffer_kb") {
+                opts.batch_buffer_kb = boost::lexical_cast<int>(value);
+            } else if (key == "batch_buffer_count") {
+                opts.batch_buffer_count = boost::lexical_cast<int>(value);
+            } else if (key == "batch_flush_interval_ms") {
+                opts.batch_flush_interval_ms = boost::lexical_cast<int>(value);
+            } else if (key == "poll_interval_us") {
+                opts.poll_interval_us = boost::lexical_cast<int>(value);
+            } else if (key == "callback_threads") {
+                opts.callback_threads = boost::lexical_cast<int>(value);
+            } else {
+                return false;
+            }
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
+        }
+    }
+    return (opts.mode == "shared" || opts.mode == "private") && !opts.dir.empty() &&
+           opts.mutation_size > 0 && opts.concurrency > 0 && opts.max_pending > 0 &&
+           opts.mutations > 0 && opts.log_file_mb > 0 && opts.batch_buffer_kb > 0 &&
+           opts.batch_buffer_count > 0 && opts.batch_flush_interval_ms >= 0 &&
+           opts.poll_interval_us > 0 && opts.callback_threads > 0;
+}
+
+} // namespace replication
+} // namespace dsn
+
+int main(int argc, char **argv)
+{
+    using namespace dsn::replication;
+    if (!parse_options(argc, argv, s_opts)) {
+        fprintf(stderr,
+                "USAGE: %s [--mode=shared|private] [--aio_provider=native|io_uring|<full name>] "
+                "[--dir=PATH] [--mutation_size=N] [--concurrency=N] [--max_pending=N] "
+                "[--mutations=N] [--log_file_mb=N] [--force_flush=0|1] [--batch_buffer_kb=N] "
+                "[--batch_buffer_count=N] [--batch_flush_interval_ms=N] [--poll_interval_us=N] "
+                "[--callback_threads=N]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::string provider = s_opts.aio_provider.find("::") == std::string::npos
+                               ? "dsn::tools::" + s_opts.aio_provider + "_aio_provider"
+                               : s_opts.aio_provider;
+    std::string cargs =
+        fmt::format("aio_provider={};callback_threads={}", provider, s_opts.callback_threads);
+    dsn::service_app::register_factory<mlog_bench_app>("mlog_bench");
+    char *args[] = {argv[0],
+                    const_cast<char *>("config.ini"),
+                    const_cast<char *>("-cargs"),
+                    const_cast<char *>(cargs.c_str())};
+    dsn_run(4, args, false);
+
+    dsn_mimic_app("mlog_bench", 1);
+    run_bench();
+    dsn_exit(0);
+}
@@ -81,12 +81,22 @@ public:
     void set_ingestion_status(ingestion_status::type status) { _ingestion_status = status; }
     ingestion_status::type get_ingestion_status() override { return _ingestion_status; }
 
+    bool support_non_blocking_ingestion() const override
+    {
+        return _support_non_blocking_ingestion;
+    }
+    void set_support_non_blocking_ingestion(bool support)
+    {
+        _support_non_blocking_ingestion = support;
+    }
+
     uint32_t query_data_version() const { return 1; }
 
 private:
     std::map<std::string, std::string> _envs;
     decree _decree = 5;
     ingestion_status::type _ingestion_status;
+    bool _support_non_blocking_ingestion{false};
 };
 
 class mock_replica : public replica
@@ -148,6 +158,8 @@ public:
     void prepare_list_truncate(decree d) { _prepare_list->truncate(d); }
     void prepare_list_commit_hard(decree d) { _prepare_list->commit(d, COMMIT_TO_DECREE_HARD); }
     decree get_app_last_committed_decree() { return _app->last_committed_decree(); }
+    replication_app_base *get_app() { return _app.get(); }
+    void set_app(std::unique_ptr<replication_app_base> app) { _app = std::move(app); }
     void set_app_last_committed_decree(decree d) { _app->_last_committed_decree = d; }
     void set_primary_partition_configuration(partition_configuration &pconfig)
     {
@@ -214,7 +226,7 @@ public:
 
     ~mock_replica_stub() override = default;
 
-    void add_replica(replica *r) { _replicas[r->get_gpid()] = replica_ptr(r); }
+    void add_replica(replica *r) { _replicas.assign(r->get_gpid(), replica_ptr(r)); }
 
     mock_replica *add_primary_replica(int appid, int part_index = 1)
     {
@@ -255,7 +267,7 @@ public:
 
         mock_replica_ptr rep = new mock_replica(this, pid, std::move(info), "./");
         rep->set_replica_config(config);
-        _replicas[pid] = rep;
+        _replicas.assign(pid, rep);
 
         return rep;
     }
@@ -27,8 +27,13 @@
 #include "replica/mutation_log.h"
 #include "replica_test_base.h"
 
+#include <dsn/utility/compression.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 using namespace ::dsn;
 using namespace ::dsn::replication;
@@ -264,6 +269,10 @@ TEST(replication, log_file)
 
 namespace dsn {
 namespace replication {
+DSN_DECLARE_bool(log_replay_pipelined);
+DSN_DECLARE_bool(log_file_mmap_read);
+DSN_DECLARE_string(log_block_compression_type);
+DSN_DECLARE_bool(log_shared_batch_callbacks);
 
 class mutation_log_test : public replica_test_base
 {
@@ -441,6 +450,14 @@ TEST_F(mutation_log_test, replay_single_file_1) { test_replay_single_file(1); }
 
 TEST_F(mutation_log_test, replay_single_file_10) { test_replay_single_file(10); }
 
+TEST_F(mutation_log_test, replay_single_file_mmap)
+{
+    bool old_mmap_read = FLAGS_log_file_mmap_read;
+    FLAGS_log_file_mmap_read = true;
+    test_replay_single_file(5000);
+    FLAGS_log_file_mmap_read = old_mmap_read;
+}
+
 // mutation_log::open
 TEST_F(mutation_log_test, open)
 {
@@ -482,6 +499,116 @@ TEST_F(mutation_log_test, replay_multiple_files_20000_1mb) { test_replay_multipl
 
 TEST_F(mutation_log_test, replay_multiple_files_50000_1mb) { test_replay_multiple_files(50000, 1); }
 
+TEST_F(mutation_log_test, replay_multiple_files_pipelined)
+{
+    std::vector<mutation_ptr> mutations;
+    {
+        mutation_log_ptr mlog = create_private_log(1);
+        for (int i = 0; i < 20000; i++) {
+            mutation_ptr mu = create_test_mutation(2 + i, "hello!");
+            mutations.push_back(mu);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+    }
+
+    std::vector<std::string> log_files;
+    ASSERT_TRUE(utils::filesystem::get_subfiles(_log_dir, log_files, false));
+    ASSERT_GT(log_files.size(), 1);
+
+    auto replay = [&](bool pipelined, int64_t &end_offset) {
+        bool old_pipelined = FLAGS_log_replay_pipelined;
+        FLAGS_log_replay_pipelined = pipelined;
+        int mutation_index = -1;
+        error_code err = mutation_log::replay(
+            log_files,
+            [&mutations, &mutation_index](int log_length, mutation_ptr &mu) -> bool {
+                mutation_ptr wmu = mutations[++mutation_index];
+                EXPECT_EQ(wmu->data.header, mu->data.header);
+                EXPECT_EQ(wmu->data.updates.size(), mu->data.updates.size());
+                EXPECT_EQ(wmu->data.updates[0].data.to_string(),
+                          mu->data.updates[0].data.to_string());
+                return true;
+            },
+            end_offset);
+        FLAGS_log_replay_pipelined = old_pipelined;
+        EXPECT_EQ(ERR_OK, err);
+        EXPECT_EQ(mutation_index + 1, (int)mutations.size());
+    };
+
+    int64_t sequential_end_offset = 0;
+    int64_t pipelined_end_offset = 0;
+    replay(false, sequential_end_offset);
+    replay(true, pipelined_end_offset);
+    ASSERT_EQ(sequential_end_offset, pipelined_end_offset);
+}
+
+TEST_F(mutation_log_test, replay_compressed_blocks)
+{
+    const char *codec = nullptr;
+    for (auto type : {utils::compression_type::lz4, utils::compression_type::zstd}) {
+        if (utils::compression_supported(type)) {
+            codec = utils::compression_type_to_string(type);
+        }
+    }
+    if (codec == nullptr) {
+        return;
+    }
+
+    // the uncompressed blocks written before enabling the compression can still be replayed
+    std::vector<mutation_ptr> mutations;
+    const char *old_compression = FLAGS_log_block_compression_type;
+    {
+        mutation_log_ptr mlog = create_private_log(1);
+        for (int i = 0; i < 20000; i++) {
+            FLAGS_log_block_compression_type = (i < 5000) ? "none" : codec;
+            mutation_ptr mu = create_test_mutation(2 + i, "hello!");
+            mutations.push_back(mu);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+    }
+    FLAGS_log_block_compression_type = old_compression;
+
+    std::vector<std::string> log_files;
+    ASSERT_TRUE(utils::filesystem::get_subfiles(_log_dir, log_files, false));
+
+    int64_t raw_size = 0;
+    auto replay = [&](bool pipelined, int64_t &end_offset) {
+        bool old_pipelined = FLAGS_log_replay_pipelined;
+        FLAGS_log_replay_pipelined = pipelined;
+        int mutation_index = -1;
+        raw_size = 0;
+        error_code err = mutation_log::replay(
+            log_files,
+            [&mutations, &mutation_index, &raw_size](int log_length, mutation_ptr &mu) -> bool {
+                mutation_ptr wmu = mutations[++mutation_index];
+                EXPECT_EQ(wmu->data.header, mu->data.header);
+                EXPECT_EQ(wmu->data.updates[0].data.to_string(),
+                          mu->data.updates[0].data.to_string());
+                raw_size += log_length;
+                return true;
+            },
+            end_offset);
+        FLAGS_log_replay_pipelined = old_pipelined;
+        EXPECT_EQ(ERR_OK, err);
+        EXPECT_EQ(mutation_index + 1, (int)mutations.size());
+    };
+
+    int64_t sequential_end_offset = 0;
+    int64_t pipelined_end_offset = 0;
+    replay(false, sequential_end_offset);
+    replay(true, pipelined_end_offset);
+    ASSERT_EQ(sequential_end_offset, pipelined_end_offset);
+
+    // the repetitive mutations are well compressed
+    int64_t total_size = 0;
+    for (const auto &path : log_files) {
+        int64_t sz = 0;
+        ASSERT_TRUE(utils::filesystem::file_size(path, sz));
+        total_size += sz;
+    }
+    ASSERT_LT(total_size, raw_size / 2);
+}
+
 TEST_F(mutation_log_test, replay_start_decree)
 {
     // decree ranges from [1, 30)
@@ -495,5 +622,199 @@ TEST_F(mutation_log_test, replay_start_decree)
     ASSERT_EQ(mlog->get_log_file_map().size(), 3);
 }
 
+TEST_F(mutation_log_test, shared_log_batch_callbacks)
+{
+    bool old_batch_callbacks = FLAGS_log_shared_batch_callbacks;
+    FLAGS_log_shared_batch_callbacks = true;
+
+    mutation_log_ptr mlog = new mutation_log_shared(_log_dir, 32, false);
+    ASSERT_EQ(ERR_OK, mlog->open([](int, mutation_ptr &) { return true; }, nullptr));
+
+    const int partition_count = 16;
+    const int mutation_count = 50;
+    for (int i = 0; i < partition_count; ++i) {
+        mlog->set_valid_start_offset_on_open(gpid(1, i), 0);
+    }
+    task_tracker tracker;
+    std::mutex lock;
+    std::vector<std::vector<decree>> acked(partition_count);
+    for (decree d = 1; d <= mutation_count; ++d) {
+        for (int i = 0; i < partition_count; ++i) {
+            gpid pid(1, i);
+            mutation_ptr mu = create_test_mutation(d, "hello!");
+            mu->data.header.pid = pid;
+            mlog->append(mu,
+                         LPC_WRITE_REPLICATION_LOG,
+                         &tracker,
+                         [&, i, d](error_code err, size_t size) {
+                             ASSERT_EQ(ERR_OK, err);
+                             ASSERT_GT(size, 0);
+                             std::lock_guard<std::mutex> guard(lock);
+                             acked[i].push_back(d);
+                         },
+                         pid.thread_hash());
+        }
+    }
+    tracker.wait_outstanding_tasks();
+
+    // all the mutations of each partition are acked in order
+    for (int i = 0; i < partition_count; ++i) {
+        ASSERT_EQ(mutation_count, acked[i].size());
+        for (int j = 0; j < mutation_count; ++j) {
+            ASSERT_EQ(j + 1, acked[i][j]);
+        }
+    }
+
+    mlog->close();
+    FLAGS_log_shared_batch_callbacks = old_batch_callbacks;
+}
+
+TEST_F(mutation_log_test, shared_log_concurrent_append)
+{
+    mutation_log_ptr mlog = new mutation_log_shared(_log_dir, 1, false);
+    ASSERT_EQ(ERR_OK, mlog->open([](int, mutation_ptr &) { return true; }, nullptr));
+
+    // each thread appends the mutations of its own partition
+    const int partition_count = 8;
+    const int mutation_count = 500;
+    std::vector<mutation_ptr> mutations;
+    for (int i = 0; i < partition_count; ++i) {
+        mlog->set_valid_start_offset_on_open(gpid(1, i), 0);
+        for (decree d = 1; d <= mutation_count; ++d) {
+            mutations.emplace_back(create_test_mutation(d, "hello!"));
+            mutations.back()->data.header.pid = gpid(1, i);
+        }
+    }
+
+    task_tracker tracker;
+    std::mutex lock;
+    std::vector<std::vector<decree>> acked(partition_count);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < partition_count; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < mutation_count; ++j) {
+                mutation_ptr &mu = mutations[i * mutation_count + j];
+                decree d = mu->data.header.decree;
+                mlog->append(mu,
+                             LPC_WRITE_REPLICATION_LOG,
+                             &tracker,
+                             [&, i, d](error_code err, size_t size) {
+                                 ASSERT_EQ(ERR_OK, err);
+                                 std::lock_guard<std::mutex> guard(lock);
+                                 acked[i].push_back(d);
+                             },
+                             gpid(1, i).thread_hash());
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    mlog->flush();
+    tracker.wait_outstanding_tasks();
+    mlog->close();
+
+    // all the mutations are acked, and logged in the order of each partition
+    std::vector<decree> replayed(partition_count, 0);
+    mlog = new mutation_log_shared(_log_dir, 1, false);
+    ASSERT_EQ(ERR_OK, mlog->open(
+                          [&](int, mutation_ptr &mu) {
+                              int i = mu->data.header.pid.get_partition_index();
+                              EXPECT_EQ(replayed[i] + 1, mu->data.header.decree);
+                              replayed[i] = mu->data.header.decree;
+                              return true;
+                          },
+                          nullptr));
+    for (int i = 0; i < partition_count; ++i) {
+        ASSERT_EQ(mutation_count, acked[i].size());
+        ASSERT_EQ(mutation_count, replayed[i]);
+    }
+    mlog->close();
+}
+
+TEST_F(mutation_log_test, shared_log_flush_with_concurrent_append)
+{
+    // large enough to keep all the mutations in log.1.0
+    mutation_log_ptr mlog = new mutation_log_shared(_log_dir, 64, false);
+    ASSERT_EQ(ERR_OK, mlog->open([](int, mutation_ptr &) { return true; }, nullptr));
+
+    const int partition_count = 4;
+    const int mutation_count = 2000;
+    std::vector<mutation_ptr> mutations;
+    for (int i = 0; i < partition_count; ++i) {
+        mlog->set_valid_start_offset_on_open(gpid(1, i), 0);
+        for (decree d = 1; d <= mutation_count; ++d) {
+            mutations.emplace_back(create_test_mutation(d, "hello!"));
+            mutations.back()->data.header.pid = gpid(1, i);
+        }
+    }
+
+    task_tracker tracker;
+    std::vector<std::atomic<decree>> appended(partition_count);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < partition_count; ++i) {
+        appended[i].store(0);
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < mutation_count; ++j) {
+                mutation_ptr &mu = mutations[i * mutation_count + j];
+                mlog->append(mu,
+                             LPC_WRITE_REPLICATION_LOG,
+                             &tracker,
+                             [](error_code err, size_t) { ASSERT_EQ(ERR_OK, err); },
+                             gpid(1, i).thread_hash());
+                appended[i].store(mu->data.header.decree);
+            }
+        });
+    }
+
+    // flush while appending, and record the size of the log file on disk once flushed
+    const std::string log_file = utils::filesystem::path_combine(_log_dir, "log.1.0");
+    std::vector<std::vector<decree>> flushed_decrees;
+    std::vector<int64_t> flushed_sizes;
+    bool all_appended = false;
+    while (!all_appended) {
+        all_appended = true;
+        std::vector<decree> decrees;
+        for (auto &d : appended) {
+            decrees.push_back(d.load());
+            all_appended = all_appended && decrees.back() == mutation_count;
+        }
+        mlog->flush();
+        int64_t sz = 0;
+        ASSERT_TRUE(utils::filesystem::file_size(log_file, sz));
+        flushed_decrees.emplace_back(std::move(decrees));
+        flushed_sizes.push_back(sz);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    tracker.wait_outstanding_tasks();
+    mlog->close();
+
+    // the end offset of each mutation in log.1.0, whose start offset is 0
+    std::vector<std::vector<int64_t>> end_offsets(partition_count,
+                                                  std::vector<int64_t>(mutation_count + 1, 0));
+    mlog = new mutation_log_shared(_log_dir, 64, false);
+    ASSERT_EQ(ERR_OK, mlog->open(
+                          [&](int log_length, mutation_ptr &mu) {
+                              end_offsets[mu->data.header.pid.get_partition_index()]
+                                         [mu->data.header.decree] =
+                                             mu->data.header.log_offset + log_length;
+                              return true;
+                          },
+                          nullptr));
+    mlog->close();
+
+    // every mutation appended before a flush was on disk when the flush returned
+    for (int k = 0; k < flushed_sizes.size(); ++k) {
+        for (int i = 0; i < partition_count; ++i) {
+            for (decree d = 1; d <= flushed_decrees[k][i]; ++d) {
+                ASSERT_GT(end_offsets[i][d], 0);
+                ASSERT_LE(end_offsets[i][d], flushed_sizes[k]);
+            }
+        }
+    }
+}
+
 } // namespace replication
 } // namespace dsn
@@ -0,0 +1,113 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/mutation_pool.h"
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(mutation_pool_enabled);
+DSN_DECLARE_uint32(mutation_pool_max_cached_count);
+
+class mutation_pool_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_enabled = FLAGS_mutation_pool_enabled;
+        _old_max_count = FLAGS_mutation_pool_max_cached_count;
+        FLAGS_mutation_pool_enabled = true;
+        FLAGS_mutation_pool_max_cached_count = 4;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_mutation_pool_enabled = _old_enabled;
+        FLAGS_mutation_pool_max_cached_count = _old_max_count;
+    }
+
+private:
+    bool _old_enabled;
+    uint32_t _old_max_count;
+};
+
+TEST_F(mutation_pool_test, recycle)
+{
+    mutation_pool_ptr pool(new mutation_pool(gpid(1, 1)));
+
+    mutation *first = nullptr;
+    {
+        mutation_ptr mu(pool->create());
+        first = mu.get();
+        mu->data.updates.resize(8);
+        mu->client_requests.resize(8, nullptr);
+        ASSERT_EQ(0, pool->cached_count());
+        ASSERT_GT(pool->memory_bytes(), 0);
+    }
+    ASSERT_EQ(1, pool->cached_count());
+    int64_t bytes = pool->memory_bytes();
+
+    // the memory and the vectors are reused, the data is not
+    mutation_ptr mu(pool->create());
+    ASSERT_EQ(first, mu.get());
+    ASSERT_EQ(0, pool->cached_count());
+    ASSERT_EQ(bytes, pool->memory_bytes());
+    ASSERT_TRUE(mu->data.updates.empty());
+    ASSERT_GE(mu->data.updates.capacity(), 8);
+    ASSERT_TRUE(mu->client_requests.empty());
+    ASSERT_GE(mu->client_requests.capacity(), 8);
+    ASSERT_FALSE(mu->is_logged());
+}
+
+TEST_F(mutation_pool_test, max_cached_count)
+{
+    mutation_pool_ptr pool(new mutation_pool(gpid(1, 2)));
+    {
+        std::vector<mutation_ptr> mutations;
+        for (int i = 0; i < 10; i++) {
+            mutations.emplace_back(pool->create());
+        }
+    }
+    ASSERT_EQ(FLAGS_mutation_pool_max_cached_count, pool->cached_count());
+    ASSERT_EQ(FLAGS_mutation_pool_max_cached_count * (16 + sizeof(mutation)),
+              pool->memory_bytes());
+}
+
+TEST_F(mutation_pool_test, outlive_pool_owner)
+{
+    mutation_ptr mu;
+    {
+        mutation_pool_ptr pool(new mutation_pool(gpid(1, 3)));
+        mu = pool->create();
+        // hold by the mutation
+        ASSERT_EQ(2, pool->get_count());
+    }
+    // the pool is released with the last mutation
+    mu = nullptr;
+
+    FLAGS_mutation_pool_enabled = false;
+    mutation_pool_ptr pool(new mutation_pool(gpid(1, 4)));
+    mu = pool->create();
+    ASSERT_EQ(1, pool->get_count());
+    ASSERT_EQ(0, pool->memory_bytes());
+}
+
+} // namespace replication
+} // namespace dsn
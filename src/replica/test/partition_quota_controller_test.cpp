@@ -0,0 +1,69 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/partition_quota_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(partition_quota_controller_test, unlimited_by_default)
+{
+    partition_quota_controller c;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(c.consume_write(1 << 20));
+        ASSERT_TRUE(c.consume_read());
+    }
+}
+
+TEST(partition_quota_controller_test, reject_over_share)
+{
+    partition_quota_controller c;
+    partition_quota share;
+    share.write_qps = 10;
+    share.read_qps = 5;
+    c.set_share(share);
+
+    // a burst of one second of the share is admitted
+    int admitted = 0;
+    for (int i = 0; i < 100; ++i) {
+        admitted += c.consume_write(100) ? 1 : 0;
+    }
+    ASSERT_LE(admitted, 11);
+    ASSERT_GE(admitted, 10);
+    admitted = 0;
+    for (int i = 0; i < 100; ++i) {
+        admitted += c.consume_read() ? 1 : 0;
+    }
+    ASSERT_LE(admitted, 6);
+    ASSERT_GE(admitted, 5);
+
+    // the rejected requests count for the demand
+    partition_quota usage;
+    c.collect_usage(usage);
+    ASSERT_GT(usage.write_qps, 0);
+    ASSERT_GT(usage.write_bytes_per_sec, 0);
+    ASSERT_GT(usage.read_qps, 0);
+
+    c.reset_share();
+    ASSERT_TRUE(c.consume_write(100));
+    ASSERT_TRUE(c.consume_read());
+}
+
+} // namespace replication
+} // namespace dsn
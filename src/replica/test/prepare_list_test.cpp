@@ -0,0 +1,106 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/prepare_list.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+class prepare_list_test : public ::testing::Test, public replica_base
+{
+public:
+    prepare_list_test() : replica_base(gpid(1, 1), "1.1@test", "test") {}
+
+    mutation_ptr create_mutation(decree d, ballot b = 1)
+    {
+        mutation_ptr mu(new mutation());
+        mu->data.header.pid = get_gpid();
+        mu->data.header.ballot = b;
+        mu->data.header.decree = d;
+        mu->set_logged();
+        return mu;
+    }
+};
+
+TEST_F(prepare_list_test, mutation_cache_ring)
+{
+    // the capacity is not a power of two, the ring is larger than the capacity
+    mutation_cache cache(0, 3);
+    for (decree d = 1; d <= 3; ++d) {
+        mutation_ptr mu = create_mutation(d);
+        ASSERT_EQ(ERR_OK, cache.put(mu));
+    }
+    mutation_ptr mu = create_mutation(4);
+    ASSERT_EQ(ERR_CAPACITY_EXCEEDED, cache.put(mu));
+
+    // wrap around the ring
+    for (decree d = 4; d <= 10; ++d) {
+        ASSERT_EQ(d - 3, cache.pop_min()->data.header.decree);
+        mu = create_mutation(d);
+        ASSERT_EQ(ERR_OK, cache.put(mu));
+        ASSERT_EQ(3, cache.count());
+        ASSERT_EQ(d - 2, cache.min_decree());
+        ASSERT_EQ(d, cache.max_decree());
+    }
+    for (decree d = 8; d <= 10; ++d) {
+        ASSERT_EQ(d, cache.get_mutation_by_decree(d)->data.header.decree);
+    }
+    ASSERT_TRUE(cache.get_mutation_by_decree(7) == nullptr);
+    ASSERT_TRUE(cache.get_mutation_by_decree(11) == nullptr);
+
+    cache.reset(10, true);
+    ASSERT_EQ(0, cache.count());
+    ASSERT_TRUE(cache.get_mutation_by_decree(10) == nullptr);
+}
+
+TEST_F(prepare_list_test, batch_commit)
+{
+    std::vector<decree> committed;
+    int batch_count = 0;
+    prepare_list plist(this, 0, 8, [&](mutation_ptr &mu) {
+        committed.push_back(mu->data.header.decree);
+    });
+
+    for (decree d = 1; d <= 5; ++d) {
+        mutation_ptr mu = create_mutation(d);
+        ASSERT_EQ(ERR_OK, plist.prepare(mu, partition_status::PS_PRIMARY));
+    }
+
+    // without a batch committer, the mutations are committed one by one
+    plist.commit(2, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(std::vector<decree>({1, 2}), committed);
+
+    plist.set_batch_committer([&](std::vector<mutation_ptr> &mus) {
+        batch_count++;
+        for (const mutation_ptr &mu : mus) {
+            committed.push_back(mu->data.header.decree);
+        }
+    });
+    plist.commit(5, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(1, batch_count);
+    ASSERT_EQ(std::vector<decree>({1, 2, 3, 4, 5}), committed);
+    ASSERT_EQ(5, plist.last_committed_decree());
+
+    // nothing to commit
+    plist.commit(5, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(1, batch_count);
+}
+
+} // namespace replication
+} // namespace dsn
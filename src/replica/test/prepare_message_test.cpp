@@ -0,0 +1,113 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/mutation.h"
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/replication/replication.codes.h>
+
+namespace dsn {
+namespace replication {
+
+class prepare_message_test : public ::testing::Test
+{
+public:
+    static mutation_ptr create_test_mutation()
+    {
+        mutation_ptr mu(new mutation());
+        mu->data.header.pid = gpid(1, 2);
+        mu->data.header.ballot = 3;
+        mu->data.header.decree = 4;
+        mu->data.header.last_committed_decree = 3;
+        mu->data.header.log_offset = invalid_offset;
+        mu->data.header.timestamp = 5;
+        for (const std::string &value : {"value1", "", "value3"}) {
+            mu->data.updates.emplace_back();
+            mu->data.updates.back().code = RPC_COLD_BACKUP;
+            mu->data.updates.back().data = blob::create_from_bytes(std::string(value));
+            mu->client_requests.push_back(nullptr);
+        }
+        return mu;
+    }
+
+    static std::string flatten_body(message_ex *msg)
+    {
+        std::string body;
+        for (size_t i = 0; i < msg->buffers.size(); i++) {
+            size_t offset = (i == 0 ? sizeof(message_header) : 0);
+            const blob &bb = msg->buffers[i];
+            body.append(bb.data() + offset, bb.length() - offset);
+        }
+        return body;
+    }
+};
+
+TEST_F(prepare_message_test, shared_buffers_keep_layout)
+{
+    mutation_ptr mu = create_test_mutation();
+    std::vector<blob> mutation_buffers;
+    mu->write_to([&mutation_buffers](const blob &bb) { mutation_buffers.push_back(bb); });
+
+    // the copying layout
+    message_ptr copied = message_ex::create_request(RPC_PREPARE);
+    {
+        rpc_write_stream writer(copied.get());
+        marshall(writer, mu->data.header.pid, DSF_THRIFT_BINARY);
+        mu->write_to(writer, copied.get());
+    }
+
+    // the shared layout, as sent to every member by the primary
+    message_ptr shared = message_ex::create_request(RPC_PREPARE);
+    {
+        rpc_write_stream writer(shared.get());
+        marshall(writer, mu->data.header.pid, DSF_THRIFT_BINARY);
+    }
+    for (const blob &bb : mutation_buffers) {
+        if (bb.length() > 0) {
+            shared->write_append(bb);
+        }
+    }
+
+    ASSERT_EQ(copied->body_size(), shared->body_size());
+    ASSERT_EQ(flatten_body(copied.get()), flatten_body(shared.get()));
+
+    // the update data is referenced rather than copied
+    bool found = false;
+    for (const blob &bb : shared->buffers) {
+        found = found || bb.data() == mu->data.updates[0].data.data();
+    }
+    ASSERT_TRUE(found);
+
+    message_ptr received = shared->copy(true, true);
+    rpc_read_stream reader(received.get());
+    gpid pid;
+    unmarshall(reader, pid, DSF_THRIFT_BINARY);
+    ASSERT_EQ(mu->data.header.pid, pid);
+    mutation_ptr decoded = mutation::read_from(reader, nullptr);
+    ASSERT_EQ(mu->data.header.decree, decoded->data.header.decree);
+    ASSERT_EQ(mu->data.header.timestamp, decoded->data.header.timestamp);
+    ASSERT_EQ(mu->data.updates.size(), decoded->data.updates.size());
+    for (size_t i = 0; i < mu->data.updates.size(); i++) {
+        ASSERT_EQ(mu->data.updates[i].code, decoded->data.updates[i].code);
+        ASSERT_EQ(mu->data.updates[i].data.to_string(), decoded->data.updates[i].data.to_string());
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/prepare_window_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+// commits `rounds` rounds of mutations with a constant latency
+static void commit(prepare_window_controller &c, int rounds, uint64_t latency_us, bool saturated)
+{
+    for (int i = 0; i < rounds; ++i) {
+        int n = c.window();
+        for (int j = 0; j < n; ++j) {
+            c.on_committed(latency_us, saturated);
+        }
+    }
+}
+
+TEST(prepare_window_controller_test, grow_without_queuing)
+{
+    prepare_window_controller c(10);
+    ASSERT_EQ(2, c.window());
+    ASSERT_EQ(prepare_window_controller::MIN_BATCH_BYTES, c.batch_bytes());
+
+    // not saturated, nothing to grow for
+    commit(c, 5, 1000, false);
+    ASSERT_EQ(2, c.window());
+
+    // the latency doesn't rise with the window (e.g. a high-RTT link), so it grows to the max
+    commit(c, 20, 1000, true);
+    ASSERT_EQ(10, c.window());
+    ASSERT_EQ(prepare_window_controller::MAX_BATCH_BYTES, c.batch_bytes());
+    ASSERT_EQ(1000, c.base_latency_us());
+}
+
+TEST(prepare_window_controller_test, shrink_on_queuing)
+{
+    prepare_window_controller c(10);
+    commit(c, 20, 1000, true);
+    ASSERT_EQ(10, c.window());
+
+    // the mutations start to queue: 10 * (1 - 1000 / 4000) > BETA
+    commit(c, 20, 4000, true);
+    ASSERT_LT(c.window(), 10);
+    ASSERT_GE(c.window(), 1);
+    int window = c.window();
+
+    // the batches shrink once the window is no more saturated
+    commit(c, 10, 4000, false);
+    ASSERT_LE(c.window(), window);
+    ASSERT_EQ(prepare_window_controller::MIN_BATCH_BYTES, c.batch_bytes());
+
+    c.reset();
+    ASSERT_EQ(2, c.window());
+    ASSERT_EQ(0, c.base_latency_us());
+}
+
+TEST(prepare_window_controller_test, bounded)
+{
+    prepare_window_controller c(1);
+    ASSERT_EQ(1, c.window());
+    commit(c, 10, 1000, true);
+    ASSERT_EQ(1, c.window());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,77 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/primary_read_lease.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(primary_read_lease_test, renew_and_expire)
+{
+    uint64_t lease_ms = primary_read_lease::lease_ms();
+    rpc_address s1(0x7f000001, 34801);
+    rpc_address s2(0x7f000001, 34802);
+    std::vector<rpc_address> secondaries = {s1, s2};
+
+    primary_read_lease lease;
+    lease.reset();
+    // no lease before all the secondaries grant it
+    ASSERT_FALSE(lease.is_valid(secondaries, 1));
+    lease.renew(s1, 100);
+    ASSERT_FALSE(lease.is_valid(secondaries, 101));
+
+    // held until the earliest grant runs out
+    lease.renew(s2, 200);
+    ASSERT_EQ(100 + lease_ms, lease.expire_ts_ms(secondaries));
+    ASSERT_TRUE(lease.is_valid(secondaries, 100 + lease_ms - 1));
+    ASSERT_FALSE(lease.is_valid(secondaries, 100 + lease_ms));
+
+    // an older grant never shortens the lease
+    lease.renew(s1, 300);
+    lease.renew(s1, 150);
+    ASSERT_EQ(200 + lease_ms, lease.expire_ts_ms(secondaries));
+
+    // a primary without secondaries
+    ASSERT_TRUE(lease.is_valid({}, 1000000));
+
+    lease.reset();
+    ASSERT_FALSE(lease.is_valid(secondaries, 250));
+}
+
+TEST(primary_read_lease_test, wait_out_previous_lease)
+{
+    uint64_t lease_ms = primary_read_lease::lease_ms();
+    rpc_address s1(0x7f000001, 34801);
+    std::vector<rpc_address> secondaries = {s1};
+
+    primary_read_lease lease;
+    // the replica granted the previous primary a lease at 1000 as secondary
+    lease.reset(1000);
+    ASSERT_TRUE(lease.is_waiting(1000 + lease_ms - 1));
+    ASSERT_FALSE(lease.is_waiting(1000 + lease_ms));
+
+    lease.renew(s1, 1001);
+    ASSERT_FALSE(lease.is_valid(secondaries, 1000 + lease_ms - 1));
+    ASSERT_TRUE(lease.is_valid(secondaries, 1000 + lease_ms));
+    ASSERT_TRUE(lease.is_valid({}, 1000 + lease_ms));
+    ASSERT_FALSE(lease.is_valid({}, 1000));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,77 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/read_staleness_tracker.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(read_staleness_tracker_test, within_decrees)
+{
+    read_staleness_tracker t;
+    // nothing is known about the primary yet
+    ASSERT_FALSE(t.within_decrees(10, 100));
+
+    t.on_primary_committed(20, 1000);
+    ASSERT_TRUE(t.within_decrees(20, 0));
+    ASSERT_TRUE(t.within_decrees(15, 5));
+    ASSERT_FALSE(t.within_decrees(14, 5));
+
+    // the outdated messages are ignored
+    t.on_primary_committed(18, 1100);
+    ASSERT_FALSE(t.within_decrees(19, 0));
+}
+
+TEST(read_staleness_tracker_test, within_ms)
+{
+    read_staleness_tracker t;
+    ASSERT_FALSE(t.within_ms(10, 1000, 0));
+
+    t.on_primary_committed(10, 1000);
+    t.on_primary_committed(20, 2000);
+    t.on_primary_committed(30, 3000);
+
+    // not caught up with any point
+    ASSERT_FALSE(t.within_ms(9, 100000, 3000));
+
+    // as fresh as the primary was at 2000
+    ASSERT_TRUE(t.within_ms(25, 500, 2500));
+    ASSERT_FALSE(t.within_ms(25, 500, 2501));
+
+    // the primary stays at 30, which renews the last point
+    ASSERT_TRUE(t.within_ms(30, 0, 3000));
+    t.on_primary_committed(30, 4000);
+    ASSERT_TRUE(t.within_ms(30, 100, 4100));
+    ASSERT_FALSE(t.within_ms(30, 100, 4101));
+}
+
+TEST(read_staleness_tracker_test, bounded_points)
+{
+    read_staleness_tracker t;
+    for (decree d = 1; d <= 2 * read_staleness_tracker::MAX_POINTS; ++d) {
+        t.on_primary_committed(d, d * 10);
+    }
+    // the oldest points are dropped, which never claims a fresher state
+    ASSERT_FALSE(t.within_ms(read_staleness_tracker::MAX_POINTS, 100000, 10000));
+    decree d = read_staleness_tracker::MAX_POINTS + 1;
+    ASSERT_TRUE(t.within_ms(d, 0, d * 10));
+}
+
+} // namespace replication
+} // namespace dsn
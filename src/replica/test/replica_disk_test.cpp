@@ -28,6 +28,16 @@ namespace replication {
 
 using query_disk_info_rpc = rpc_holder<query_disk_info_request, query_disk_info_response>;
 
+class durable_replication_app : public mock_replication_app_base
+{
+public:
+    explicit durable_replication_app(replica *r) : mock_replication_app_base(r) {}
+
+    decree last_durable_decree() const override { return durable_decree; }
+
+    decree durable_decree = 0;
+};
+
 class replica_disk_test : public replica_disk_test_base
 {
 public:
@@ -36,6 +46,66 @@ public:
 public:
     void SetUp() override { generate_fake_rpc(); }
 
+    // the shared log of the disk `tag`, as [replication] slog_per_disk_enabled creates
+    mutation_log_ptr create_disk_log(const std::string &tag)
+    {
+        std::string dir = fmt::format("./{}/slog", tag);
+        utils::filesystem::remove_path(dir);
+        mutation_log_ptr log = new mutation_log_shared(dir, 1, false);
+        stub->_disk_logs[tag] = log;
+        return log;
+    }
+
+    void clear_disk_logs()
+    {
+        for (auto &kv : stub->_disk_logs) {
+            kv.second->close();
+        }
+        stub->_disk_logs.clear();
+    }
+
+    mock_replica_ptr create_disk_replica(gpid pid, const std::string &tag)
+    {
+        replica_configuration config;
+        config.pid = pid;
+        config.ballot = 1;
+        config.status = partition_status::PS_INACTIVE;
+        std::string dir = fmt::format("./{}/{}.replica", tag, pid);
+        utils::filesystem::create_directory(dir);
+        mock_replica_ptr rep = new mock_replica(stub.get(), pid, app_info_1, dir.c_str());
+        rep->set_replica_config(config);
+        return rep;
+    }
+
+    static void append_mutations(mutation_log_ptr &log, gpid pid, decree count, size_t value_size)
+    {
+        task_tracker tracker;
+        log->set_valid_start_offset_on_open(pid, 0);
+        for (decree d = 1; d <= count; ++d) {
+            mutation_ptr mu(new mutation());
+            mu->data.header.ballot = 1;
+            mu->data.header.decree = d;
+            mu->data.header.pid = pid;
+            mu->data.header.last_committed_decree = 0;
+            mu->data.header.log_offset = 0;
+            mu->data.header.timestamp = d;
+            mu->data.updates.emplace_back(mutation_update());
+            mu->data.updates.back().code = RPC_COLD_BACKUP;
+            mu->data.updates.back().data = blob::create_from_bytes(std::string(value_size, 'v'));
+            mu->client_requests.push_back(nullptr);
+            log->append(mu, LPC_WRITE_REPLICATION_LOG, &tracker, nullptr, pid.thread_hash());
+        }
+        log->flush();
+        tracker.wait_outstanding_tasks();
+    }
+
+    mutation_log_ptr disk_shared_log(replica *rep) { return rep->_disk_shared_log; }
+
+    bool replay_shared_log(mutation_log_ptr &log, replicas &rps)
+    {
+        return stub->replay_shared_log(log, rps);
+    }
+
 private:
     void generate_fake_rpc()
     {
@@ -198,5 +268,106 @@ TEST_F(replica_disk_test, gc_disk_useless_dir)
     ASSERT_EQ(report.error_replica_count, 2);
 }
 
+TEST_F(replica_disk_test, disk_shared_log_resolved_once)
+{
+    // the replicas created without the disk logs use the shared log of the server
+    mock_replica_ptr rep0 = create_disk_replica(gpid(3, 3), "tag_1");
+    ASSERT_EQ(nullptr, disk_shared_log(rep0.get()).get());
+
+    mutation_log_ptr log1 = create_disk_log("tag_1");
+    mutation_log_ptr log2 = create_disk_log("tag_2");
+    mock_replica_ptr rep1 = create_disk_replica(gpid(3, 1), "tag_1");
+    mock_replica_ptr rep2 = create_disk_replica(gpid(3, 2), "tag_2");
+    ASSERT_EQ(log1.get(), rep1->shared_log().get());
+    ASSERT_EQ(log2.get(), rep2->shared_log().get());
+
+    // the replicas keep the logs they resolved, without scanning the data dirs again
+    stub->_disk_logs["tag_1"] = log2;
+    ASSERT_EQ(log1.get(), rep1->shared_log().get());
+    stub->_disk_logs["tag_1"] = log1;
+
+    clear_disk_logs();
+
+}
+
+TEST_F(replica_disk_test, replay_disk_shared_logs)
+{
+    const gpid pid1(3, 1);
+    const gpid pid2(3, 2);
+    {
+        mutation_log_ptr log1 = create_disk_log("tag_1");
+        mutation_log_ptr log2 = create_disk_log("tag_2");
+        ASSERT_EQ(ERR_OK, log1->open(nullptr, nullptr));
+        ASSERT_EQ(ERR_OK, log2->open(nullptr, nullptr));
+        append_mutations(log1, pid1, 10, 100);
+        append_mutations(log2, pid2, 20, 100);
+        clear_disk_logs();
+    }
+
+    // reopen the logs as on restart
+    mutation_log_ptr log1 = new mutation_log_shared("./tag_1/slog", 1, false);
+    mutation_log_ptr log2 = new mutation_log_shared("./tag_2/slog", 1, false);
+    stub->_disk_logs["tag_1"] = log1;
+    stub->_disk_logs["tag_2"] = log2;
+    mock_replica_ptr rep1 = create_disk_replica(pid1, "tag_1");
+    mock_replica_ptr rep2 = create_disk_replica(pid2, "tag_2");
+    rep1->init_private_log("./tag_1/3.1.replica/plog");
+    rep2->init_private_log("./tag_2/3.2.replica/plog");
+
+    // each log is replayed with the replicas of its own disk
+    replicas rps1{{pid1, rep1}};
+    ASSERT_TRUE(replay_shared_log(log1, rps1));
+    ASSERT_EQ(1u, rps1.size());
+    ASSERT_EQ(10, log1->max_decree(pid1));
+    ASSERT_EQ(10, rep1->private_log()->max_decree(pid1));
+    ASSERT_EQ(0, rep2->private_log()->max_decree(pid2));
+
+    replicas rps2{{pid2, rep2}};
+    ASSERT_TRUE(replay_shared_log(log2, rps2));
+    ASSERT_EQ(1u, rps2.size());
+    ASSERT_EQ(20, log2->max_decree(pid2));
+    ASSERT_EQ(20, rep2->private_log()->max_decree(pid2));
+    ASSERT_EQ(0, log2->max_decree(pid1));
+
+    ASSERT_EQ(log1.get(), rep1->shared_log().get());
+    ASSERT_EQ(log2.get(), rep2->shared_log().get());
+    clear_disk_logs();
+}
+
+TEST_F(replica_disk_test, gc_disk_shared_logs)
+{
+    const gpid pid1(3, 1);
+    const gpid pid2(3, 2);
+    mutation_log_ptr log1 = create_disk_log("tag_1");
+    mutation_log_ptr log2 = create_disk_log("tag_2");
+    ASSERT_EQ(ERR_OK, log1->open(nullptr, nullptr));
+    ASSERT_EQ(ERR_OK, log2->open(nullptr, nullptr));
+
+    // several files of 1MB in each log
+    append_mutations(log1, pid1, 64, 64 * 1024);
+    append_mutations(log2, pid2, 64, 64 * 1024);
+    size_t log2_file_count = log2->get_log_file_map().size();
+    ASSERT_GT(log1->get_log_file_map().size(), 1u);
+    ASSERT_GT(log2_file_count, 1u);
+
+    // the replica of tag_1 has made all of its mutations durable, while the one of tag_2
+    // has made none
+    mock_replica_ptr rep1 = create_disk_replica(pid1, "tag_1");
+    mock_replica_ptr rep2 = create_disk_replica(pid2, "tag_2");
+    auto app1 = make_unique<durable_replication_app>(rep1.get());
+    app1->durable_decree = 64;
+    rep1->set_app(std::move(app1));
+    rep2->set_app(make_unique<durable_replication_app>(rep2.get()));
+    stub->add_replica(rep1.get());
+    stub->add_replica(rep2.get());
+
+    // each log is collected by the replicas of its own disk only
+    stub->on_gc();
+    ASSERT_EQ(1u, log1->get_log_file_map().size());
+    ASSERT_EQ(log2_file_count, log2->get_log_file_map().size());
+
+    clear_disk_logs();
+}
+
 } // namespace replication
 } // namespace dsn
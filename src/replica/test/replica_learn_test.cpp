@@ -2,9 +2,15 @@
 // This source code is licensed under the Apache License Version 2.0, which
 // can be found in the LICENSE file in the root directory of this source tree.
 
+#include <algorithm>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/strings.h>
 
 #include "replica/replica.h"
+#include "replica/learn_copy_join.h"
+#include "replica/mutation_log.h"
 #include "mock_utils.h"
 #include "replica/duplication/test/duplication_test_base.h"
 
@@ -149,11 +155,230 @@ public:
             ASSERT_EQ(_replica->get_max_gced_decree_for_learn(), tt.want);
         }
     }
+
+    void test_reuse_learner_checkpoint_files()
+    {
+        const std::string learnee_dir = "./reuse_learner_checkpoint_files";
+        utils::filesystem::remove_path(learnee_dir);
+        ASSERT_TRUE(utils::filesystem::create_directory(learnee_dir + "/checkpoint.10"));
+
+        auto write_file = [](const std::string &path, const std::string &content) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << content;
+        };
+        auto make_meta = [](const std::string &name, const std::string &content) {
+            file_meta meta;
+            meta.name = name;
+            meta.size = content.size();
+            meta.md5 = utils::string_md5(content.data(), content.size());
+            return meta;
+        };
+
+        struct test_data
+        {
+            std::string file;
+            std::string learnee_content;
+            std::string learner_content;
+            bool with_md5;
+
+            bool wreused;
+        } tests[] = {
+            // the same file
+            {"000001.sst", "abcdefgh", "abcdefgh", true, true},
+            // the same name but a different size
+            {"000002.sst", "abcdefgh", "abcdefg", true, false},
+            // the same name and size but a different content
+            {"000003.sst", "abcdefgh", "abcdefgz", true, false},
+            // the learner failed to checksum its file
+            {"000004.sst", "abcdefgh", "abcdefgh", false, false},
+            // the learner doesn't have the file
+            {"000005.sst", "abcdefgh", "", true, false},
+        };
+
+        _replica = create_duplicating_replica();
+        learn_request req;
+        learn_response resp;
+        resp.base_local_dir = learnee_dir;
+        for (const auto &tt : tests) {
+            auto path = learnee_dir + "/checkpoint.10/" + tt.file;
+            write_file(path, tt.learnee_content);
+            resp.state.files.emplace_back(path);
+            if (tt.learner_content.empty()) {
+                continue;
+            }
+            auto meta = make_meta("checkpoint.8/" + tt.file, tt.learner_content);
+            if (!tt.with_md5) {
+                meta.md5.clear();
+            }
+            req.checkpoint_files.emplace_back(std::move(meta));
+        }
+
+        _replica->reuse_learner_checkpoint_files(req, resp);
+
+        for (const auto &tt : tests) {
+            auto path = learnee_dir + "/checkpoint.10/" + tt.file;
+            auto it = resp.reused_files.find("checkpoint.10/" + tt.file);
+            bool copied = std::find(resp.state.files.begin(), resp.state.files.end(), path) !=
+                          resp.state.files.end();
+            if (tt.wreused) {
+                ASSERT_NE(it, resp.reused_files.end()) << tt.file;
+                ASSERT_EQ(it->second, "checkpoint.8/" + tt.file);
+                ASSERT_FALSE(copied) << tt.file;
+            } else {
+                ASSERT_EQ(it, resp.reused_files.end()) << tt.file;
+                ASSERT_TRUE(copied) << tt.file;
+            }
+        }
+        ASSERT_EQ(resp.reused_files.size(), 1);
+        ASSERT_EQ(resp.state.files.size(), 4);
+        ASSERT_TRUE(resp.__isset.reused_files);
+
+        utils::filesystem::remove_path(learnee_dir);
+    }
+
+    // writes the mutations of decree [1, count] of ~4KB each into a private log of `r` with
+    // files of 1MB, and commits them
+    mutation_log_ptr create_private_log(mock_replica *r, decree count)
+    {
+        std::string log_dir = utils::filesystem::path_combine(r->dir(), "plog");
+        utils::filesystem::remove_path(log_dir);
+        utils::filesystem::create_directory(log_dir);
+
+        mutation_log_ptr mlog =
+            new mutation_log_private(log_dir, 1, r->get_gpid(), r, 1024, 512, 10000);
+        EXPECT_EQ(ERR_OK, mlog->open(nullptr, nullptr));
+        for (decree d = 1; d <= count; ++d) {
+            mutation_ptr mu(new mutation());
+            mu->data.header.ballot = 1;
+            mu->data.header.decree = d;
+            mu->data.header.pid = r->get_gpid();
+            mu->data.header.last_committed_decree = d - 1;
+            mu->data.header.log_offset = 0;
+            mu->data.updates.push_back(mutation_update());
+            mu->data.updates.back().code = RPC_REPLICATION_WRITE_EMPTY;
+            mu->data.updates.back().data = blob::create_from_bytes(std::string(4096, 'x'));
+            mu->client_requests.push_back(nullptr);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->flush();
+
+        r->init_private_log(mlog);
+        r->set_last_committed_decree(count);
+        return mlog;
+    }
+
+    void test_attach_private_logs_to_checkpoint()
+    {
+        mutation_log_ptr mlog = create_private_log(_replica.get(), 1000);
+        learn_request req;
+
+        // the logs don't cover the decrees following an early checkpoint, which are left to
+        // the later rounds of LT_LOG
+        {
+            learn_response resp;
+            resp.state.to_decree_included = 10;
+            _replica->attach_private_logs_to_checkpoint(req, resp);
+            ASSERT_FALSE(resp.__isset.log_state);
+        }
+
+        // nothing follows the checkpoint
+        {
+            learn_response resp;
+            resp.state.to_decree_included = 1000;
+            _replica->attach_private_logs_to_checkpoint(req, resp);
+            ASSERT_FALSE(resp.__isset.log_state);
+        }
+
+        {
+            learn_response resp;
+            resp.state.to_decree_included = 900;
+            _replica->attach_private_logs_to_checkpoint(req, resp);
+            ASSERT_TRUE(resp.__isset.log_state);
+            ASSERT_EQ(900, resp.log_state.from_decree_excluded);
+            ASSERT_EQ(1000, resp.log_state.to_decree_included);
+            ASSERT_EQ(mlog->dir(), resp.log_base_local_dir);
+            ASSERT_FALSE(resp.log_state.files.empty());
+            for (const auto &file : resp.log_state.files) {
+                ASSERT_TRUE(utils::filesystem::file_exists(
+                    utils::filesystem::path_combine(resp.log_base_local_dir, file)))
+                    << file;
+            }
+        }
+
+        mlog->close();
+    }
+
+    void test_learn_copy_join()
+    {
+        // the error of either copy is reported, whichever finishes first
+        for (bool checkpoint_failed : {true, false}) {
+            learn_copy_join join(2);
+            ASSERT_FALSE(join.finish(checkpoint_failed ? ERR_FILE_OPERATION_FAILED : ERR_OK, 100));
+            ASSERT_TRUE(join.finish(checkpoint_failed ? ERR_OK : ERR_FILE_OPERATION_FAILED, 200));
+            ASSERT_EQ(ERR_FILE_OPERATION_FAILED, join.err());
+            ASSERT_EQ(300u, join.size());
+        }
+
+        learn_copy_join join(2);
+        ASSERT_FALSE(join.finish(ERR_OK, 100));
+        ASSERT_TRUE(join.finish(ERR_OK, 200));
+        ASSERT_EQ(ERR_OK, join.err());
+        ASSERT_EQ(300u, join.size());
+    }
+
+    void test_apply_learned_logs_of_checkpoint()
+    {
+        mutation_log_ptr mlog = create_private_log(_replica.get(), 1000);
+        learn_request req;
+        learn_response resp;
+        resp.state.to_decree_included = 900;
+        _replica->attach_private_logs_to_checkpoint(req, resp);
+        ASSERT_TRUE(resp.__isset.log_state);
+
+        // the learner has applied the checkpoint and copied the logs into its learn.plog dir
+        const std::string learner_dir = "./test-learner";
+        utils::filesystem::remove_path(learner_dir);
+        auto learner = create_mock_replica(stub.get(), 1, 1, learner_dir.c_str());
+        learner->set_app_last_committed_decree(900);
+        std::string learn_log_dir = utils::filesystem::path_combine(learner->dir(), "learn.plog");
+        ASSERT_TRUE(utils::filesystem::create_directory(learn_log_dir));
+        for (const auto &file : resp.log_state.files) {
+            ASSERT_EQ(ERR_OK,
+                      utils::filesystem::copy_file(
+                          utils::filesystem::path_combine(resp.log_base_local_dir, file),
+                          utils::filesystem::path_combine(learn_log_dir, file)));
+        }
+
+        // the last mutation is committed by no later one in the logs, but by to_decree_included
+        ASSERT_EQ(ERR_OK, learner->apply_learned_logs_of_checkpoint(req, resp));
+        ASSERT_EQ(resp.log_state.to_decree_included, learner->get_app_last_committed_decree());
+        ASSERT_FALSE(utils::filesystem::directory_exists(learn_log_dir));
+
+        mlog->close();
+        utils::filesystem::remove_path(learner_dir);
+    }
 };
 
 TEST_F(replica_learn_test, get_learn_start_decree) { test_get_learn_start_decree(); }
 
 TEST_F(replica_learn_test, get_max_gced_decree_for_learn) { test_get_max_gced_decree_for_learn(); }
 
+TEST_F(replica_learn_test, reuse_learner_checkpoint_files)
+{
+    test_reuse_learner_checkpoint_files();
+}
+
+TEST_F(replica_learn_test, attach_private_logs_to_checkpoint)
+{
+    test_attach_private_logs_to_checkpoint();
+}
+
+TEST_F(replica_learn_test, learn_copy_join) { test_learn_copy_join(); }
+
+TEST_F(replica_learn_test, apply_learned_logs_of_checkpoint)
+{
+    test_apply_learned_logs_of_checkpoint();
+}
+
 } // namespace replication
 } // namespace dsn
@@ -0,0 +1,130 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/replica_map.h"
+#include "replica_test_base.h"
+
+#include <atomic>
+#include <thread>
+
+namespace dsn {
+namespace replication {
+
+class replica_map_test : public replica_stub_test_base
+{
+public:
+    replica_ptr create_replica(int app_id, int partition_index)
+    {
+        return create_mock_replica(stub.get(), app_id, partition_index).release();
+    }
+};
+
+TEST_F(replica_map_test, insert_erase_get)
+{
+    replica_map m;
+    ASSERT_EQ(nullptr, m.get(gpid(1, 0)));
+    ASSERT_EQ(nullptr, m.get(gpid(-1, -1)));
+
+    replica_ptr r1 = create_replica(1, 0);
+    replica_ptr r2 = create_replica(3, 5);
+    ASSERT_TRUE(m.insert(replica_map::value_type(gpid(1, 0), r1)).second);
+    ASSERT_FALSE(m.insert(replica_map::value_type(gpid(1, 0), r2)).second);
+    ASSERT_TRUE(m.emplace(gpid(3, 5), r2).second);
+    ASSERT_EQ(2, m.size());
+    ASSERT_EQ(r1, m.get(gpid(1, 0)));
+    ASSERT_EQ(r2, m.get(gpid(3, 5)));
+    ASSERT_EQ(nullptr, m.get(gpid(3, 4)));
+    ASSERT_EQ(nullptr, m.get(gpid(2, 0)));
+    ASSERT_EQ(nullptr, m.get(gpid(3, 1000)));
+
+    // the partition split doubles the partition count
+    replica_ptr r3 = create_replica(3, 13);
+    m.assign(gpid(3, 13), r3);
+    ASSERT_EQ(r2, m.get(gpid(3, 5)));
+    ASSERT_EQ(r3, m.get(gpid(3, 13)));
+
+    m.assign(gpid(3, 5), r1);
+    ASSERT_EQ(r1, m.get(gpid(3, 5)));
+
+    ASSERT_EQ(1, m.erase(gpid(3, 5)));
+    ASSERT_EQ(0, m.erase(gpid(3, 5)));
+    ASSERT_EQ(nullptr, m.get(gpid(3, 5)));
+    ASSERT_EQ(r3, m.get(gpid(3, 13)));
+
+    m.erase(m.begin());
+    ASSERT_EQ(1, m.size());
+
+    replica_map::map_type rs;
+    rs.emplace(gpid(7, 1), r2);
+    m = std::move(rs);
+    ASSERT_EQ(1, m.size());
+    ASSERT_EQ(nullptr, m.get(gpid(1, 0)));
+    ASSERT_EQ(nullptr, m.get(gpid(3, 13)));
+    ASSERT_EQ(r2, m.get(gpid(7, 1)));
+
+    m.clear();
+    ASSERT_TRUE(m.empty());
+    ASSERT_EQ(nullptr, m.get(gpid(7, 1)));
+}
+
+// the readers never see a freed replica while the replicas are opened and closed
+TEST_F(replica_map_test, concurrent_get)
+{
+    const int partition_count = 8;
+    replica_map m;
+    std::vector<replica_ptr> replicas;
+    for (int i = 0; i < partition_count; ++i) {
+        replicas.push_back(create_replica(1, i));
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> found{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                for (int i = 0; i < partition_count; ++i) {
+                    replica_ptr r = m.get(gpid(1, i));
+                    if (r != nullptr) {
+                        ASSERT_EQ(gpid(1, i), r->get_gpid());
+                        ++found;
+                    }
+                }
+            }
+        });
+    }
+
+    for (int round = 0; round < 1000; ++round) {
+        int i = round % partition_count;
+        m.emplace(gpid(1, i), replicas[i]);
+        if (round % 3 == 0) {
+            m.erase(gpid(1, (round / 3) % partition_count));
+        }
+        if (round % 100 == 0) {
+            // forces rebuilding the index
+            m.emplace(gpid(2 + round / 100, 0), create_replica(2 + round / 100, 0));
+        }
+    }
+    stop.store(true);
+    for (std::thread &t : readers) {
+        t.join();
+    }
+    ASSERT_GT(found.load(), 0);
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,69 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/replica_memory_budget.h"
+#include "replica/mutation.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+// with the default budget of 4096 MB, 60% for the mutations and 20% for the learns
+TEST(replica_memory_budget_test, is_throttled)
+{
+    replica_memory_budget budget;
+    const int64_t mb = 1024 * 1024;
+
+    budget.consume(memory_subsystem::MUTATION, 3000 * mb);
+    ASSERT_EQ(3000 * mb, budget.total_usage());
+    // over the share but under the total budget
+    ASSERT_FALSE(budget.is_throttled(memory_subsystem::MUTATION));
+
+    budget.consume(memory_subsystem::LEARN, 500 * mb);
+    budget.consume(memory_subsystem::DUPLICATION, 600 * mb);
+    ASSERT_TRUE(budget.is_throttled(memory_subsystem::MUTATION));
+    ASSERT_FALSE(budget.is_throttled(memory_subsystem::LEARN));
+    ASSERT_FALSE(budget.is_throttled(memory_subsystem::DUPLICATION));
+
+    budget.release(memory_subsystem::MUTATION, 100 * mb);
+    ASSERT_FALSE(budget.is_throttled(memory_subsystem::MUTATION));
+
+    budget.release(memory_subsystem::MUTATION, 2900 * mb);
+    budget.release(memory_subsystem::LEARN, 500 * mb);
+    budget.release(memory_subsystem::DUPLICATION, 600 * mb);
+    ASSERT_EQ(0, budget.total_usage());
+}
+
+TEST(replica_memory_budget_test, charge_mutation)
+{
+    replica_memory_budget budget;
+    {
+        mutation_ptr mu = new mutation();
+        mu->charge_memory(&budget, memory_subsystem::DUPLICATION);
+        ASSERT_EQ(mu->appro_data_bytes(), budget.usage(memory_subsystem::DUPLICATION));
+
+        // only the first charge counts
+        mu->charge_memory(&budget, memory_subsystem::MUTATION);
+        ASSERT_EQ(0, budget.usage(memory_subsystem::MUTATION));
+        ASSERT_EQ(mu->appro_data_bytes(), budget.total_usage());
+    }
+    ASSERT_EQ(0, budget.total_usage());
+}
+
+} // namespace replication
+} // namespace dsn
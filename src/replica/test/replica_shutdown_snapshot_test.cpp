@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/replica_shutdown_snapshot.h"
+
+#include <dsn/utility/filesystem.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(replica_shutdown_snapshot_test, store_and_load)
+{
+    const std::string dir = "./shutdown_snapshot_test";
+    utils::filesystem::remove_path(dir);
+    ASSERT_TRUE(utils::filesystem::create_directory(dir));
+
+    replica_shutdown_snapshot loaded;
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, loaded.load_and_remove(dir));
+
+    replica_shutdown_snapshot snapshot;
+    snapshot.ballot = 3;
+    snapshot.committed_decree = 100;
+    snapshot.plog_max_decree = 102;
+    snapshot.idle_ms = 5000;
+    ASSERT_EQ(ERR_OK, snapshot.store(dir));
+
+    // the snapshot is kept by load
+    ASSERT_EQ(ERR_OK, loaded.load(dir));
+    ASSERT_EQ(5000, loaded.idle_ms);
+
+    ASSERT_EQ(ERR_OK, loaded.load_and_remove(dir));
+    ASSERT_EQ(3, loaded.ballot);
+    ASSERT_EQ(100, loaded.committed_decree);
+    ASSERT_EQ(102, loaded.plog_max_decree);
+    ASSERT_EQ(5000, loaded.idle_ms);
+
+    // the snapshot is consumed by the first load
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, loaded.load_and_remove(dir));
+
+    utils::filesystem::remove_path(dir);
+}
+
+} // namespace replication
+} // namespace dsn
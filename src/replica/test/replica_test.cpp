@@ -18,6 +18,7 @@
 #include <dsn/dist/replication/replica_envs.h>
 #include <dsn/utility/defer.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
 
 #include "common/backup_utils.h"
@@ -28,6 +29,27 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(read_isolation_workers_per_dir);
+DSN_DECLARE_bool(prepare_ack_batched);
+
+class mock_checkpoint_snapshot : public checkpoint_snapshot
+{
+public:
+    explicit mock_checkpoint_snapshot(error_code write_err) : _write_err(write_err) {}
+
+    int64_t decree() const override { return 10; }
+    error_code write() override
+    {
+        ++write_count;
+        return _write_err;
+    }
+
+    int write_count = 0;
+
+private:
+    const error_code _write_err;
+};
+
 class replica_test : public replica_test_base
 {
 public:
@@ -137,6 +159,38 @@ public:
     }
 
 public:
+    error_code test_write_checkpoint_snapshot(std::shared_ptr<checkpoint_snapshot> snapshot)
+    {
+        _mock_replica->_checkpoint_snapshot_writing.store(true);
+        return _mock_replica->background_write_checkpoint_snapshot(std::move(snapshot));
+    }
+
+    bool is_checkpoint_snapshot_writing() const
+    {
+        return _mock_replica->_checkpoint_snapshot_writing.load();
+    }
+
+    // `node` in `status` acks a group check sent at `send_ts_ms`
+    void ack_group_check(const rpc_address &node,
+                         partition_status::type status,
+                         uint64_t send_ts_ms)
+    {
+        auto request = std::make_shared<group_check_request>();
+        request->node = node;
+        request->config.ballot = _mock_replica->get_ballot();
+        request->config.status = status;
+        auto response = std::make_shared<group_check_response>();
+        response->err = ERR_OK;
+        _mock_replica->_primary_states.group_check_pending_replies[node] = nullptr;
+        _mock_replica->on_group_check_reply(send_ts_ms, ERR_OK, request, response);
+    }
+
+    bool is_read_lease_valid(uint64_t now_ms) const
+    {
+        const auto &states = _mock_replica->_primary_states;
+        return states.read_lease.is_valid(states.membership.secondaries, now_ms);
+    }
+
     dsn::app_info _app_info;
     dsn::gpid pid;
     mock_replica_ptr _mock_replica;
@@ -181,6 +235,23 @@ TEST_F(replica_test, backup_request_qps)
     ASSERT_GT(get_table_level_backup_request_qps(), 0);
 }
 
+TEST_F(replica_test, read_isolation_hash)
+{
+    auto old_workers_per_dir = FLAGS_read_isolation_workers_per_dir;
+    FLAGS_read_isolation_workers_per_dir = 3;
+
+    // each data dir owns its own range of workers
+    for (int dir_index = 0; dir_index < 4; ++dir_index) {
+        _mock_replica->_dir_node_index = dir_index;
+        int hash = _mock_replica->read_isolation_hash();
+        ASSERT_GE(hash, dir_index * 3);
+        ASSERT_LT(hash, (dir_index + 1) * 3);
+        ASSERT_EQ(hash % 3, pid.thread_hash() % 3);
+    }
+
+    FLAGS_read_isolation_workers_per_dir = old_workers_per_dir;
+}
+
 TEST_F(replica_test, query_data_version_test)
 {
     replica_http_service http_svc(stub.get());
@@ -236,6 +307,40 @@ TEST_F(replica_test, query_compaction_test)
     }
 }
 
+TEST_F(replica_test, query_resource_usage_test)
+{
+    _mock_replica->resource_usage().on_plog_write(100);
+    _mock_replica->resource_usage().on_apply(2, 3000);
+    _mock_replica->resource_usage().on_rpc_in(10);
+    _mock_replica->resource_usage().on_rpc_in(20);
+    _mock_replica->resource_usage().on_learn_served(1024);
+
+    replica_http_service http_svc(stub.get());
+    struct query_resource_usage_test
+    {
+        std::string app_id;
+        http_status_code expected_code;
+        std::string expected_response_json;
+    } tests[] = {{"", http_status_code::bad_request, "app_id should not be empty"},
+                 {"wrong", http_status_code::bad_request, "invalid app_id=wrong"},
+                 {"2",
+                  http_status_code::ok,
+                  R"({"1":{"apply_count":2,"apply_time_ns":3000,"learn_bytes_received":0,)"
+                  R"("learn_bytes_served":1024,"plog_read_bytes":0,"plog_write_bytes":100,)"
+                  R"("rpc_bytes_in":30,"rpc_bytes_out":0}})"},
+                 {"4", http_status_code::not_found, "app_id=4 not found"}};
+    for (const auto &test : tests) {
+        http_request req;
+        http_response resp;
+        if (!test.app_id.empty()) {
+            req.query_args["app_id"] = test.app_id;
+        }
+        http_svc.query_resource_usage_handler(req, resp);
+        ASSERT_EQ(resp.status_code, test.expected_code);
+        ASSERT_EQ(resp.body, test.expected_response_json);
+    }
+}
+
 TEST_F(replica_test, update_validate_partition_hash_test)
 {
     struct update_validate_partition_hash_test
@@ -259,6 +364,142 @@ TEST_F(replica_test, update_validate_partition_hash_test)
     }
 }
 
+TEST_F(replica_test, write_checkpoint_snapshot)
+{
+    for (const auto &write_err : {ERR_OK, ERR_FILE_OPERATION_FAILED}) {
+        auto snapshot = std::make_shared<mock_checkpoint_snapshot>(write_err);
+        ASSERT_EQ(write_err, test_write_checkpoint_snapshot(snapshot));
+        ASSERT_EQ(1, snapshot->write_count);
+        // the next checkpoint is allowed whether the snapshot is written or not
+        ASSERT_FALSE(is_checkpoint_snapshot_writing());
+    }
+}
+
+TEST_F(replica_test, cumulative_prepare_ack)
+{
+    rpc_address node1("127.0.0.1", 34801);
+    rpc_address node2("127.0.0.1", 34802);
+    std::vector<mutation_ptr> mutations;
+    for (decree d = 1; d <= 3; ++d) {
+        mutation_ptr mu(new mutation());
+        mu->data.header.pid = pid;
+        mu->data.header.ballot = _mock_replica->get_ballot();
+        mu->data.header.decree = d;
+        mu->data.header.last_committed_decree = 0;
+        mu->set_left_secondary_ack_count(2);
+        mu->remote_tasks()[node1] = tasking::create_task(LPC_DELAY_PREPARE, nullptr, []() {});
+        mu->remote_tasks()[node2] = tasking::create_task(LPC_DELAY_PREPARE, nullptr, []() {});
+        ASSERT_EQ(ERR_OK, _mock_replica->get_plist()->prepare(mu, partition_status::PS_PRIMARY));
+        mutations.push_back(mu);
+    }
+
+    // node1 has logged the prepares up to decree 2
+    _mock_replica->on_cumulative_prepare_ack(node1, 2);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(1, mutations[i]->left_secondary_ack_count());
+        ASSERT_EQ(0, mutations[i]->remote_tasks().count(node1));
+        ASSERT_EQ(1, mutations[i]->remote_tasks().count(node2));
+    }
+    ASSERT_EQ(2, mutations[2]->left_secondary_ack_count());
+    ASSERT_EQ(1, mutations[2]->remote_tasks().count(node1));
+
+    // the acks counted are not counted again
+    _mock_replica->on_cumulative_prepare_ack(node1, 3);
+    ASSERT_EQ(1, mutations[0]->left_secondary_ack_count());
+    ASSERT_EQ(1, mutations[2]->left_secondary_ack_count());
+    ASSERT_EQ(0, _mock_replica->last_committed_decree());
+}
+
+TEST_F(replica_test, prepare_timeout_before_cumulative_ack)
+{
+    FLAGS_prepare_ack_batched = true;
+    auto cleanup = dsn::defer([]() { FLAGS_prepare_ack_batched = false; });
+
+    rpc_address node1("127.0.0.1", 34801);
+    rpc_address node2("127.0.0.1", 34802);
+    std::vector<mutation_ptr> mutations;
+    for (decree d = 1; d <= 3; ++d) {
+        mutation_ptr mu(new mutation());
+        mu->data.header.pid = pid;
+        mu->data.header.ballot = _mock_replica->get_ballot();
+        mu->data.header.decree = d;
+        mu->data.header.last_committed_decree = 0;
+        mu->set_left_secondary_ack_count(2);
+        mu->remote_tasks()[node1] = tasking::create_task(LPC_DELAY_PREPARE, nullptr, []() {});
+        mu->remote_tasks()[node2] = tasking::create_task(LPC_DELAY_PREPARE, nullptr, []() {});
+        ASSERT_EQ(ERR_OK, _mock_replica->get_plist()->prepare(mu, partition_status::PS_PRIMARY));
+        mutations.push_back(mu);
+    }
+    auto &timed_out_prepares = _mock_replica->_primary_states.timed_out_prepares;
+    auto prepare_timeout = [this](const mutation_ptr &mu, const rpc_address &node) {
+        message_ptr request = message_ex::create_request(RPC_PREPARE);
+        request->to_address = node;
+        _mock_replica->on_prepare_reply(
+            std::make_pair(mu, partition_status::PS_SECONDARY), ERR_TIMEOUT, request, nullptr);
+    };
+
+    // node1 flushes the acks so late that the prepare of decree 1 times out, while the rpc of
+    // decree 3 still waits for the cumulative ack
+    ASSERT_TRUE(_mock_replica->is_cumulative_prepare_ack_expected(mutations[0], node1));
+    prepare_timeout(mutations[0], node1);
+    ASSERT_EQ(1, timed_out_prepares.count(node1));
+    ASSERT_EQ(1, mutations[0]->remote_tasks().count(node1));
+    ASSERT_EQ(2, mutations[0]->left_secondary_ack_count());
+
+    // then the cumulative ack counts it
+    prepare_ack ack;
+    ack.decree = 3;
+    ack.__set_last_logged_decree(3);
+    ASSERT_TRUE(_mock_replica->check_timed_out_prepares(node1, ack));
+    ASSERT_EQ(0, timed_out_prepares.count(node1));
+    _mock_replica->on_cumulative_prepare_ack(node1, 3);
+    for (auto &mu : mutations) {
+        ASSERT_EQ(1, mu->left_secondary_ack_count());
+        ASSERT_EQ(0, mu->remote_tasks().count(node1));
+    }
+
+    // an individual ack passing a timed out prepare means the ack of the latter is lost
+    prepare_timeout(mutations[0], node2);
+    ASSERT_EQ(1, timed_out_prepares.count(node2));
+    prepare_ack individual_ack;
+    individual_ack.decree = 2;
+    ASSERT_FALSE(_mock_replica->check_timed_out_prepares(node2, individual_ack));
+    ASSERT_EQ(0, timed_out_prepares.count(node2));
+
+    // no cumulative ack is expected without a later prepare waiting for the reply
+    ASSERT_FALSE(_mock_replica->is_cumulative_prepare_ack_expected(mutations[2], node2));
+    mutations[2]->remote_tasks()[node2]->cancel(false);
+    ASSERT_FALSE(_mock_replica->is_cumulative_prepare_ack_expected(mutations[1], node2));
+    ASSERT_EQ(0, _mock_replica->last_committed_decree());
+}
+
+TEST_F(replica_test, read_lease_across_learner_upgrade)
+{
+    rpc_address secondary("127.0.0.1", 34801);
+    rpc_address learner("127.0.0.1", 34802);
+    rpc_address new_node("127.0.0.1", 34803);
+    auto &membership = _mock_replica->_primary_states.membership;
+    membership.secondaries = {secondary};
+    _mock_replica->_primary_states.read_lease.reset();
+
+    uint64_t now_ms = dsn_now_ms();
+    ack_group_check(secondary, partition_status::PS_SECONDARY, now_ms);
+    ack_group_check(learner, partition_status::PS_POTENTIAL_SECONDARY, now_ms);
+    ASSERT_TRUE(is_read_lease_valid(now_ms));
+
+    // the learner is upgraded to secondary, the lease it granted as learner keeps the primary
+    // readable before its first ack as secondary
+    membership.secondaries = {secondary, learner};
+    ASSERT_TRUE(is_read_lease_valid(now_ms));
+    ASSERT_FALSE(is_read_lease_valid(now_ms + primary_read_lease::lease_ms()));
+
+    // a secondary which never granted the lease still leaves the primary without one
+    membership.secondaries = {secondary, learner, new_node};
+    ASSERT_FALSE(is_read_lease_valid(now_ms));
+    ack_group_check(new_node, partition_status::PS_SECONDARY, now_ms);
+    ASSERT_TRUE(is_read_lease_valid(now_ms));
+}
+
 TEST_F(replica_test, test_replica_backup_and_restore)
 {
     test_on_cold_backup();
@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/replication_admission_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+// with the default thresholds
+TEST(replication_admission_controller_test, is_write_accepted)
+{
+    replication_admission_controller c;
+    std::string reason;
+
+    write_backpressure bp;
+    bp.uncommitted_count = 10;
+    bp.uncommitted_capacity = 20;
+    bp.ack_lag_ms = 100;
+    ASSERT_TRUE(c.is_write_accepted(bp, reason));
+
+    bp.uncommitted_count = 18;
+    ASSERT_FALSE(c.is_write_accepted(bp, reason));
+    ASSERT_EQ("uncommitted mutations(18/20)", reason);
+    bp.uncommitted_count = 10;
+
+    bp.ack_lag_ms = 5000;
+    ASSERT_FALSE(c.is_write_accepted(bp, reason));
+    bp.ack_lag_ms = 100;
+
+    c.on_private_log_appended(64 << 20);
+    ASSERT_FALSE(c.is_write_accepted(bp, reason));
+    c.on_private_log_appended(0);
+    ASSERT_TRUE(c.is_write_accepted(bp, reason));
+}
+
+TEST(replication_admission_controller_test, smoothed_log_latency)
+{
+    replication_admission_controller c;
+    std::string reason;
+    write_backpressure bp;
+
+    c.on_shared_log_appended(1000);
+    ASSERT_EQ(1000, c.log_latency_us());
+
+    // a single stall doesn't reject the writes, a lasting one does
+    c.on_shared_log_appended(2000000);
+    ASSERT_EQ(1000 - 125 + 250000, c.log_latency_us());
+    ASSERT_TRUE(c.is_write_accepted(bp, reason));
+    for (int i = 0; i < 20; ++i) {
+        c.on_shared_log_appended(2000000);
+    }
+    ASSERT_FALSE(c.is_write_accepted(bp, reason));
+
+    c.reset();
+    ASSERT_EQ(0, c.log_latency_us());
+    ASSERT_TRUE(c.is_write_accepted(bp, reason));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,388 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <boost/lexical_cast.hpp>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/cpp/json_helper.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/utility/binary_writer.h>
+
+#include "replica/mutation.h"
+
+// Benchmarks the encoding and decoding of the structures on the hot paths, e.g.
+//
+//   dsn_serialization_bench --iterations=100000 --value_size=256 --case=learn_response
+//
+// every thrift struct is encoded by a binary_writer and decoded by a binary_reader in each of
+// DSF_THRIFT_BINARY, DSF_THRIFT_COMPACT and DSF_THRIFT_JSON. besides there are the json_helper
+// encoding of the meta server states, the mutations as the log writes and reads them, and the
+// rpc messages which are encoded into a request and decoded from the received bytes, including
+// the message_header.
+//
+// the global operator new is replaced to count the allocations, which are only counted on the
+// bench thread. a line of json is printed for every case.
+
+static thread_local uint64_t t_alloc_count = 0;
+static thread_local uint64_t t_alloc_bytes = 0;
+
+void *operator new(size_t size)
+{
+    ++t_alloc_count;
+    t_alloc_bytes += size;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+namespace dsn {
+namespace replication {
+
+struct bench_options
+{
+    int iterations = 100000;
+    int value_size = 256;
+    std::string filter;
+};
+
+static bench_options s_opts;
+
+struct op_stat
+{
+    double ns = 0;
+    double allocs = 0;
+    double alloc_bytes = 0;
+};
+
+static op_stat measure(const std::function<void()> &op)
+{
+    // warm up, which also makes the lazily allocated states ready
+    for (int i = 0; i < std::min(s_opts.iterations, 1000); ++i) {
+        op();
+    }
+
+    uint64_t count = t_alloc_count;
+    uint64_t bytes = t_alloc_bytes;
+    uint64_t start_ns = dsn_now_ns();
+    for (int i = 0; i < s_opts.iterations; ++i) {
+        op();
+    }
+    op_stat stat;
+    stat.ns = static_cast<double>(dsn_now_ns() - start_ns) / s_opts.iterations;
+    stat.allocs = static_cast<double>(t_alloc_count - count) / s_opts.iterations;
+    stat.alloc_bytes = static_cast<double>(t_alloc_bytes - bytes) / s_opts.iterations;
+    return stat;
+}
+
+static void report(const std::string &name,
+                   const char *format,
+                   size_t encoded_bytes,
+                   const op_stat &encode,
+                   const op_stat &decode)
+{
+    printf("{\"case\":\"%s\",\"format\":\"%s\",\"iterations\":%d,\"encoded_bytes\":%zu,"
+           "\"encode_ns\":%.1f,\"encode_allocs\":%.2f,\"encode_alloc_bytes\":%.1f,"
+           "\"decode_ns\":%.1f,\"decode_allocs\":%.2f,\"decode_alloc_bytes\":%.1f}\n",
+           name.c_str(),
+           format,
+           s_opts.iterations,
+           encoded_bytes,
+           encode.ns,
+           encode.allocs,
+           encode.alloc_bytes,
+           decode.ns,
+           decode.allocs,
+           decode.alloc_bytes);
+    fflush(stdout);
+}
+
+static bool case_enabled(const std::string &name)
+{
+    return s_opts.filter.empty() || name.find(s_opts.filter) != std::string::npos;
+}
+
+static const std::pair<dsn_msg_serialize_format, const char *> s_formats[] = {
+    {DSF_THRIFT_BINARY, "binary"}, {DSF_THRIFT_COMPACT, "compact"}, {DSF_THRIFT_JSON, "json"}};
+
+template <typename T>
+static void bench_thrift(const std::string &name, const T &value)
+{
+    if (!case_enabled(name)) {
+        return;
+    }
+    for (const auto &fmt : s_formats) {
+        binary_writer writer;
+        marshall(writer, value, fmt.first);
+        blob encoded = writer.get_buffer();
+
+        op_stat encode = measure([&]() {
+            binary_writer w;
+            marshall(w, value, fmt.first);
+        });
+        op_stat decode = measure([&]() {
+            T decoded;
+            binary_reader reader(encoded);
+            unmarshall(reader, decoded, fmt.first);
+        });
+        report(name, fmt.second, encoded.length(), encode, decode);
+    }
+}
+
+template <typename T>
+static void bench_json_helper(const std::string &name, const T &value)
+{
+    if (!case_enabled(name)) {
+        return;
+    }
+    blob encoded = json::json_forwarder<T>::encode(value);
+    op_stat encode = measure([&]() { json::json_forwarder<T>::encode(value); });
+    op_stat decode = measure([&]() {
+        T decoded;
+        dassert(json::json_forwarder<T>::decode(encoded, decoded), "decode failed");
+    });
+    report(name, "dsn_json", encoded.length(), encode, decode);
+}
+
+template <typename T>
+static void bench_rpc_message(const std::string &name, const T &value)
+{
+    if (!case_enabled(name)) {
+        return;
+    }
+    for (const auto &fmt : s_formats) {
+        auto encode_request = [&]() {
+            message_ex *msg = message_ex::create_request(RPC_LEARN);
+            msg->header->context.u.serialize_format = fmt.first;
+            marshall(msg, value);
+            return msg;
+        };
+
+        // the bytes on the wire, the message_header is ahead of the body
+        message_ex *msg = encode_request();
+        msg->add_ref();
+        binary_writer writer;
+        for (const blob &bb : msg->buffers) {
+            writer.write(bb.data(), bb.length());
+        }
+        blob wire = writer.get_buffer();
+        msg->release_ref();
+
+        op_stat encode = measure([&]() {
+            message_ex *request = encode_request();
+            request->add_ref();
+            request->release_ref();
+        });
+        op_stat decode = measure([&]() {
+            message_ex *received = message_ex::create_receive_message(wire);
+            received->add_ref();
+            T decoded;
+            unmarshall(received, decoded);
+            received->release_ref();
+        });
+        report(name, fmt.second, wire.length(), encode, decode);
+    }
+}
+
+static void bench_mutation(const std::string &name, const mutation_ptr &mu)
+{
+    if (!case_enabled(name)) {
+        return;
+    }
+    binary_writer writer;
+    mu->write_to(writer, nullptr);
+    blob encoded = writer.get_buffer();
+
+    op_stat encode = measure([&]() {
+        binary_writer w;
+        mu->write_to(w, nullptr);
+    });
+    op_stat decode = measure([&]() {
+        binary_reader reader(encoded);
+        mutation_ptr decoded = mutation::read_from(reader, nullptr);
+    });
+    report(name, "mutation_log", encoded.length(), encode, decode);
+}
+
+static partition_configuration make_partition_configuration()
+{
+    partition_configuration pc;
+    pc.pid = gpid(2, 7);
+    pc.ballot = 12;
+    pc.max_replica_count = 3;
+    pc.primary = rpc_address("10.0.0.1", 34801);
+    pc.secondaries = {rpc_address("10.0.0.2", 34801), rpc_address("10.0.0.3", 34801)};
+    pc.last_drops = {rpc_address("10.0.0.4", 34801)};
+    pc.last_committed_decree = 123456789;
+    pc.partition_flags = 0;
+    return pc;
+}
+
+static app_info make_app_info()
+{
+    app_info info;
+    info.status = app_status::AS_AVAILABLE;
+    info.app_type = "pegasus";
+    info.app_name = "serialization_bench";
+    info.app_id = 2;
+    info.partition_count = 64;
+    info.envs = {{"replica.slow_query_threshold", "30"}, {"default_ttl", "86400"}};
+    info.is_stateful = true;
+    info.max_replica_count = 3;
+    info.create_second = 1600000000;
+    return info;
+}
+
+static learn_response make_learn_response()
+{
+    learn_response resp;
+    resp.err = ERR_OK;
+    resp.config.pid = gpid(2, 7);
+    resp.config.ballot = 12;
+    resp.config.primary = rpc_address("10.0.0.1", 34801);
+    resp.config.status = partition_status::PS_POTENTIAL_SECONDARY;
+    resp.config.learner_signature = 42;
+    resp.last_committed_decree = 123456789;
+    resp.prepare_start_decree = 123456700;
+    resp.type = learn_type::LT_APP;
+    resp.state.from_decree_excluded = 0;
+    resp.state.to_decree_included = 123456789;
+    resp.state.meta = blob::create_from_bytes(std::string(s_opts.value_size, 'm'));
+    for (int i = 0; i < 16; ++i) {
+        resp.state.files.push_back("checkpoint.123456789/" + std::to_string(100000 + i) + ".sst");
+    }
+    resp.address = rpc_address("10.0.0.1", 34801);
+    resp.base_local_dir = "/home/work/ssd1/pegasus/replica/reps/2.7.pegasus/data/rdb";
+    return resp;
+}
+
+static configuration_update_request make_configuration_update_request()
+{
+    configuration_update_request request;
+    request.info = make_app_info();
+    request.config = make_partition_configuration();
+    request.type = config_type::CT_ADD_SECONDARY;
+    request.node = rpc_address("10.0.0.4", 34801);
+    return request;
+}
+
+static mutation_ptr make_mutation()
+{
+    mutation_ptr mu(new mutation());
+    mu->data.header.pid = gpid(2, 7);
+    mu->data.header.ballot = 12;
+    mu->data.header.decree = 123456789;
+    mu->data.header.log_offset = 1024;
+    mu->data.header.last_committed_decree = 123456788;
+    mu->data.header.timestamp = dsn_now_us();
+    for (int i = 0; i < 4; ++i) {
+        mutation_update update;
+        update.code = RPC_REPLICATION_WRITE_EMPTY;
+        update.serialization_type = DSF_THRIFT_BINARY;
+        update.data = blob::create_from_bytes(std::string(s_opts.value_size, 'v'));
+        mu->data.updates.push_back(update);
+    }
+    return mu;
+}
+
+static void run_bench()
+{
+    bench_thrift("learn_response", make_learn_response());
+    bench_thrift("configuration_update_request", make_configuration_update_request());
+    bench_thrift("partition_configuration", make_partition_configuration());
+    bench_json_helper("partition_configuration", make_partition_configuration());
+    bench_json_helper("app_info", make_app_info());
+    bench_rpc_message("rpc_learn_response", make_learn_response());
+    bench_mutation("mutation", make_mutation());
+}
+
+class serialization_bench_app : public service_app
+{
+public:
+    explicit serialization_bench_app(const service_app_info *info) : service_app(info) {}
+
+    error_code start(const std::vector<std::string> &args) override { return ERR_OK; }
+
+    error_code stop(bool cleanup) override { return ERR_OK; }
+};
+
+static bool parse_options(int argc, char **argv, /*out*/ bench_options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "iterations") {
+                opts.iterations = boost::lexical_cast<int>(value);
+            } else if (key == "value_size") {
+                opts.value_size = boost::lexical_cast<int>(value);
+            } else if (key == "case") {
+                opts.filter = value;
+            } else {
+                return false;
+            }
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
+        }
+    }
+    return opts.iterations > 0 && opts.value_size >= 0;
+}
+
+} // namespace replication
+} // namespace dsn
+
+int main(int argc, char **argv)
+{
+    using namespace dsn::replication;
+    if (!parse_options(argc, argv, s_opts)) {
+        fprintf(
+            stderr, "USAGE: %s [--iterations=N] [--value_size=N] [--case=SUBSTRING]\n", argv[0]);
+        return 1;
+    }
+
+    dsn::service_app::register_factory<serialization_bench_app>("serialization_bench");
+    char *args[] = {argv[0], const_cast<char *>("config.ini")};
+    dsn_run(2, args, false);
+
+    dsn_mimic_app("serialization_bench", 1);
+    run_bench();
+    dsn_exit(0);
+}
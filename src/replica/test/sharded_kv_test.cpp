@@ -0,0 +1,214 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/utility/filesystem.h>
+
+#include "replica/storage/simple_kv/sharded_kv.server.impl.h"
+#include "replica_test_base.h"
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+class sharded_kv_test : public replica_test_base
+{
+public:
+    sharded_kv_test()
+    {
+        utils::filesystem::remove_path(_log_dir);
+        utils::filesystem::remove_path(kLearnerDir);
+    }
+
+    std::unique_ptr<sharded_kv_service_impl> open_app(replica *r)
+    {
+        auto app = make_unique<sharded_kv_service_impl>(r);
+        utils::filesystem::create_directory(app->data_dir());
+        EXPECT_EQ(ERR_OK, app->start(0, nullptr));
+        return app;
+    }
+
+    void write(sharded_kv_service_impl *app,
+               int64_t decree,
+               const std::string &key,
+               const std::string &value)
+    {
+        kv_pair pr;
+        pr.key = key;
+        pr.value = value;
+        binary_writer writer;
+        marshall(writer, pr, DSF_THRIFT_BINARY);
+
+        mutation_update update;
+        update.code = RPC_SIMPLE_KV_SIMPLE_KV_WRITE;
+        update.serialization_type = DSF_THRIFT_BINARY;
+        update.data = writer.get_buffer();
+        const mutation_update *updates[] = {&update};
+        ASSERT_EQ(0, app->on_batched_write_updates(decree, 0, updates, 1));
+    }
+
+    // writes key.<decree> at each decree in [1, count]
+    void write_keys(sharded_kv_service_impl *app, int64_t count)
+    {
+        for (int64_t d = 1; d <= count; ++d) {
+            write(app, d, "key." + std::to_string(d), "value." + std::to_string(d));
+        }
+    }
+
+    void check_keys(sharded_kv_service_impl *app, int64_t count)
+    {
+        for (int64_t d = 1; d <= count; ++d) {
+            ASSERT_EQ("value." + std::to_string(d), get(app, "key." + std::to_string(d)));
+        }
+    }
+
+    std::string get(sharded_kv_service_impl *app, const std::string &key)
+    {
+        const sharded_kv_service_impl::shard &s = app->get_shard(key);
+        auto it = s.data->find(key);
+        return it == s.data->end() ? "" : it->second.to_string();
+    }
+
+    std::vector<std::string> shard_files(sharded_kv_service_impl *app)
+    {
+        return app->_last_manifest.shard_files;
+    }
+
+    std::vector<std::string> file_names(const std::string &dir)
+    {
+        std::vector<std::string> paths;
+        EXPECT_TRUE(utils::filesystem::get_subfiles(dir, paths, false));
+        std::vector<std::string> names;
+        for (const auto &path : paths) {
+            names.emplace_back(utils::filesystem::get_file_name(path));
+        }
+        return names;
+    }
+
+    const std::string kLearnerDir{"./test-learner"};
+};
+
+TEST_F(sharded_kv_test, checkpoint_and_restart)
+{
+    auto app = open_app(_replica.get());
+    write_keys(app.get(), 100);
+    ASSERT_EQ(ERR_OK, app->sync_checkpoint());
+    ASSERT_EQ(100, app->last_durable_decree());
+
+    // the files are complete once written, no temporary file is left
+    for (const auto &name : file_names(app->data_dir())) {
+        ASSERT_EQ(std::string::npos, name.find(".tmp")) << name;
+    }
+    ASSERT_TRUE(utils::filesystem::file_exists(
+        utils::filesystem::path_combine(app->data_dir(), "checkpoint.100")));
+
+    // the data is loaded from the last checkpoint on restart
+    ASSERT_EQ(ERR_OK, app->stop(false));
+    app = open_app(_replica.get());
+    ASSERT_EQ(100, app->last_durable_decree());
+    check_keys(app.get(), 100);
+}
+
+TEST_F(sharded_kv_test, reuse_unchanged_shard_files)
+{
+    auto app = open_app(_replica.get());
+    write_keys(app.get(), 100);
+    ASSERT_EQ(ERR_OK, app->sync_checkpoint());
+    std::vector<std::string> old_files = shard_files(app.get());
+
+    // only the shard written since the last checkpoint is rewritten
+    write(app.get(), 101, "key.1", "new value");
+    ASSERT_EQ(ERR_OK, app->sync_checkpoint());
+    ASSERT_EQ(101, app->last_durable_decree());
+    std::vector<std::string> new_files = shard_files(app.get());
+    ASSERT_EQ(old_files.size(), new_files.size());
+    int rewritten_count = 0;
+    for (size_t i = 0; i < new_files.size(); ++i) {
+        if (new_files[i] != old_files[i]) {
+            ++rewritten_count;
+            ASSERT_EQ(fmt::format("shard.{}.{}.101", new_files.size(), i), new_files[i]);
+        }
+    }
+    ASSERT_EQ(1, rewritten_count);
+
+    // the reused files are still referred after restart
+    ASSERT_EQ(ERR_OK, app->stop(false));
+    app = open_app(_replica.get());
+    ASSERT_EQ(101, app->last_durable_decree());
+    ASSERT_EQ(new_files, shard_files(app.get()));
+    ASSERT_EQ("new value", get(app.get(), "key.1"));
+    ASSERT_EQ("value.2", get(app.get(), "key.2"));
+}
+
+TEST_F(sharded_kv_test, learn_checkpoint)
+{
+    auto learnee = open_app(_replica.get());
+    write_keys(learnee.get(), 100);
+    ASSERT_EQ(ERR_OK, learnee->sync_checkpoint());
+
+    learn_state state;
+    ASSERT_EQ(ERR_OK, learnee->get_checkpoint(0, blob(), state));
+    ASSERT_EQ(100, state.to_decree_included);
+    ASSERT_EQ(shard_files(learnee.get()).size() + 1, state.files.size());
+
+    // the files are copied into the learn dir of the learner, which already holds one of the
+    // shard files in its data dir
+    auto learner_replica = create_mock_replica(stub.get(), 1, 2, kLearnerDir.c_str());
+    auto learner = open_app(learner_replica.get());
+    ASSERT_TRUE(utils::filesystem::create_directory(learner->learn_dir()));
+    learn_state learned_state = state;
+    learned_state.files.clear();
+    for (const auto &file : state.files) {
+        std::string learned_file = utils::filesystem::path_combine(
+            learner->learn_dir(), utils::filesystem::get_file_name(file));
+        ASSERT_EQ(ERR_OK, utils::filesystem::copy_file(file, learned_file));
+        learned_state.files.emplace_back(learned_file);
+    }
+    const std::string held_file = shard_files(learnee.get())[0];
+    ASSERT_EQ(ERR_OK,
+              utils::filesystem::copy_file(
+                  utils::filesystem::path_combine(learnee->data_dir(), held_file),
+                  utils::filesystem::path_combine(learner->data_dir(), held_file)));
+
+    ASSERT_EQ(ERR_OK,
+              learner->storage_apply_checkpoint(
+                  replication_app_base::chkpt_apply_mode::learn, learned_state));
+    ASSERT_EQ(100, learner->last_durable_decree());
+    ASSERT_EQ(shard_files(learnee.get()), shard_files(learner.get()));
+    check_keys(learner.get(), 100);
+
+    // the held file is reused, the others are moved into the data dir
+    for (const auto &file : shard_files(learnee.get())) {
+        ASSERT_EQ(file == held_file,
+                  utils::filesystem::file_exists(
+                      utils::filesystem::path_combine(learner->learn_dir(), file)))
+            << file;
+        ASSERT_TRUE(utils::filesystem::file_exists(
+            utils::filesystem::path_combine(learner->data_dir(), file)));
+    }
+
+    // the learned checkpoint is loaded on restart
+    ASSERT_EQ(ERR_OK, learner->stop(false));
+    learner = open_app(learner_replica.get());
+    ASSERT_EQ(100, learner->last_durable_decree());
+    check_keys(learner.get(), 100);
+}
+
+} // namespace application
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,142 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/spare_log_file_pool.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(log_file_preallocate);
+DSN_DECLARE_bool(log_file_recycle);
+DSN_DECLARE_uint32(log_file_recycle_max_count);
+
+class spare_log_file_pool_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_preallocate = FLAGS_log_file_preallocate;
+        _old_recycle = FLAGS_log_file_recycle;
+        _old_max_count = FLAGS_log_file_recycle_max_count;
+        FLAGS_log_file_preallocate = true;
+        FLAGS_log_file_recycle = true;
+        FLAGS_log_file_recycle_max_count = 2;
+
+        utils::filesystem::remove_path(_log_dir);
+        utils::filesystem::create_directory(_log_dir);
+    }
+
+    void TearDown() override
+    {
+        FLAGS_log_file_preallocate = _old_preallocate;
+        FLAGS_log_file_recycle = _old_recycle;
+        FLAGS_log_file_recycle_max_count = _old_max_count;
+        utils::filesystem::remove_path(_log_dir);
+    }
+
+    std::string write_file(const std::string &name, int64_t size)
+    {
+        std::string path = utils::filesystem::path_combine(_log_dir, name);
+        std::ofstream out(path);
+        out << std::string(size, 'a');
+        return path;
+    }
+
+    static int64_t file_size(const std::string &path)
+    {
+        int64_t sz = -1;
+        utils::filesystem::file_size(path, sz);
+        return sz;
+    }
+
+protected:
+    const std::string _log_dir{"./test-spare-log"};
+    const int64_t _file_size{1024 * 1024};
+
+private:
+    bool _old_preallocate;
+    bool _old_recycle;
+    uint32_t _old_max_count;
+};
+
+TEST_F(spare_log_file_pool_test, preallocate)
+{
+    spare_log_file_pool pool(_log_dir, _file_size);
+    std::string path = utils::filesystem::path_combine(_log_dir, "log.1.0");
+    ASSERT_FALSE(pool.take(path));
+
+    pool.prepare();
+    ASSERT_EQ(1, pool.ready_count());
+    // only one spare is prepared ahead
+    pool.prepare();
+    ASSERT_EQ(1, pool.ready_count());
+
+    ASSERT_TRUE(pool.take(path));
+    ASSERT_EQ(0, pool.ready_count());
+    // the size of a preallocated file is kept 0
+    ASSERT_EQ(0, file_size(path));
+}
+
+TEST_F(spare_log_file_pool_test, recycle)
+{
+    spare_log_file_pool pool(_log_dir, _file_size);
+    std::string gc1 = write_file("log.1.0", 100);
+    std::string gc2 = write_file("log.2.100", 100);
+    std::string gc3 = write_file("log.3.200", 100);
+
+    ASSERT_TRUE(pool.recycle(gc1));
+    ASSERT_TRUE(pool.recycle(gc2));
+    // the pool is full
+    ASSERT_FALSE(pool.recycle(gc3));
+    ASSERT_FALSE(utils::filesystem::file_exists(gc1));
+    ASSERT_TRUE(utils::filesystem::file_exists(gc3));
+    ASSERT_EQ(2, pool.recycled_count());
+
+    // a recycled file is truncated before being reused
+    pool.prepare();
+    ASSERT_EQ(1, pool.recycled_count());
+    std::string path = utils::filesystem::path_combine(_log_dir, "log.4.300");
+    ASSERT_TRUE(pool.take(path));
+    ASSERT_EQ(0, file_size(path));
+
+    FLAGS_log_file_recycle = false;
+    ASSERT_FALSE(pool.recycle(gc3));
+}
+
+TEST_F(spare_log_file_pool_test, reload)
+{
+    {
+        spare_log_file_pool pool(_log_dir, _file_size);
+        ASSERT_TRUE(pool.recycle(write_file("log.1.0", 100)));
+    }
+
+    // the spare files left by the last run are reused after a reset
+    spare_log_file_pool pool(_log_dir, _file_size);
+    ASSERT_EQ(1, pool.recycled_count());
+    pool.prepare();
+    std::string path = utils::filesystem::path_combine(_log_dir, "log.2.100");
+    ASSERT_TRUE(pool.take(path));
+    ASSERT_EQ(0, file_size(path));
+}
+
+} // namespace replication
+} // namespace dsn
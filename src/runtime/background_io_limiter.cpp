@@ -0,0 +1,220 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/tool-api/background_io_limiter.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/smart_pointers.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("background_io",
+                  disk_rate_mb,
+                  0,
+                  "the max rate(MB/s) of the background I/O on each disk, shared by all the "
+                  "classes of it, 0 means unlimited");
+DSN_TAG_VARIABLE(disk_rate_mb, FT_MUTABLE);
+DSN_DEFINE_uint32("background_io",
+                  learn_rate_mb,
+                  0,
+                  "the rate(MB/s) of each disk reserved for the files served to the learners, "
+                  "0 means no reserved rate");
+DSN_TAG_VARIABLE(learn_rate_mb, FT_MUTABLE);
+DSN_DEFINE_uint32("background_io",
+                  bulk_load_rate_mb,
+                  0,
+                  "the rate(MB/s) of each disk reserved for the files downloaded by bulk load, "
+                  "0 means no reserved rate");
+DSN_TAG_VARIABLE(bulk_load_rate_mb, FT_MUTABLE);
+DSN_DEFINE_uint32("background_io",
+                  backup_rate_mb,
+                  0,
+                  "the rate(MB/s) of each disk reserved for the files uploaded by cold backup, "
+                  "0 means no reserved rate");
+DSN_TAG_VARIABLE(backup_rate_mb, FT_MUTABLE);
+DSN_DEFINE_uint32("background_io",
+                  disk_migration_rate_mb,
+                  0,
+                  "the rate(MB/s) of each disk reserved for the checkpoints copied by disk "
+                  "migration, 0 means no reserved rate");
+DSN_TAG_VARIABLE(disk_migration_rate_mb, FT_MUTABLE);
+
+const char *background_io_class_to_string(background_io_class cls)
+{
+    switch (cls) {
+    case background_io_class::learn:
+        return "learn";
+    case background_io_class::bulk_load:
+        return "bulk_load";
+    case background_io_class::backup:
+        return "backup";
+    case background_io_class::disk_migration:
+        return "disk_migration";
+    default:
+        return "invalid";
+    }
+}
+
+static double class_rate(background_io_class cls)
+{
+    uint32_t rate_mb = 0;
+    switch (cls) {
+    case background_io_class::learn:
+        rate_mb = FLAGS_learn_rate_mb;
+        break;
+    case background_io_class::bulk_load:
+        rate_mb = FLAGS_bulk_load_rate_mb;
+        break;
+    case background_io_class::backup:
+        rate_mb = FLAGS_backup_rate_mb;
+        break;
+    case background_io_class::disk_migration:
+        rate_mb = FLAGS_disk_migration_rate_mb;
+        break;
+    default:
+        break;
+    }
+    return rate_mb * 1024.0 * 1024.0;
+}
+
+background_io_limiter::background_io_limiter()
+{
+    for (int i = 0; i < kClassCount; ++i) {
+        std::string name = background_io_class_to_string(static_cast<background_io_class>(i));
+        _counter_bytes[i].init_global_counter("replica",
+                                              "background_io",
+                                              (name + "_bytes").c_str(),
+                                              COUNTER_TYPE_RATE,
+                                              "the bytes of the background I/O per second");
+        _counter_borrowed_bytes[i].init_global_counter(
+            "replica",
+            "background_io",
+            (name + "_borrowed_bytes").c_str(),
+            COUNTER_TYPE_RATE,
+            "the bytes of the background I/O beyond the reserved rate per second");
+        _counter_throttled_count[i].init_global_counter(
+            "replica",
+            "background_io",
+            (name + "_throttled_count").c_str(),
+            COUNTER_TYPE_VOLATILE_NUMBER,
+            "the count of the background I/O delayed by the limiter");
+    }
+}
+
+background_io_limiter::disk_buckets *background_io_limiter::get_disk_buckets(dev_t disk)
+{
+    zauto_lock l(_lock);
+    auto &buckets = _disks[disk];
+    if (buckets == nullptr) {
+        buckets = dsn::make_unique<disk_buckets>();
+    }
+    return buckets.get();
+}
+
+std::chrono::milliseconds
+background_io_limiter::acquire(dev_t disk, background_io_class cls, uint64_t bytes)
+{
+    return acquire(disk, cls, bytes, folly::DynamicTokenBucket::defaultClockNow());
+}
+
+std::chrono::milliseconds background_io_limiter::acquire(dev_t disk,
+                                                         background_io_class cls,
+                                                         uint64_t bytes,
+                                                         double now_seconds)
+{
+    int index = static_cast<int>(cls);
+    dassert(index >= 0 && index < kClassCount, "invalid background io class %d", index);
+    _counter_bytes[index]->add(bytes);
+
+    double disk_rate = FLAGS_disk_rate_mb * 1024.0 * 1024.0;
+    double share_rate = class_rate(cls);
+    if (bytes == 0 || (disk_rate == 0 && share_rate == 0)) {
+        return std::chrono::milliseconds(0);
+    }
+
+    // the I/O larger than the burst of a bucket borrows from the future of it
+    double size = static_cast<double>(bytes);
+    double disk_burst = std::max(disk_rate, size);
+    double share_burst = std::max(share_rate, size);
+    disk_buckets *buckets = get_disk_buckets(disk);
+    folly::DynamicTokenBucket &share = buckets->classes[index];
+
+    double wait_seconds = 0;
+    if (disk_rate == 0) {
+        wait_seconds =
+            share.consumeWithBorrowNonBlocking(size, share_rate, share_burst, now_seconds)
+                .get_value_or(0);
+    } else if (share_rate == 0) {
+        wait_seconds =
+            buckets->total.consumeWithBorrowNonBlocking(size, disk_rate, disk_burst, now_seconds)
+                .get_value_or(0);
+    } else if (share.consume(size, share_rate, share_burst, now_seconds)) {
+        // the reserved rate is also accounted in the budget of the disk, which delays the
+        // borrowers of the other classes
+        wait_seconds =
+            buckets->total.consumeWithBorrowNonBlocking(size, disk_rate, disk_burst, now_seconds)
+                .get_value_or(0);
+    } else if (buckets->total.consume(size, disk_rate, disk_burst, now_seconds)) {
+        // borrows the idle budget of the disk
+        _counter_borrowed_bytes[index]->add(bytes);
+    } else {
+        double share_wait =
+            share.consumeWithBorrowNonBlocking(size, share_rate, share_burst, now_seconds)
+                .get_value_or(0);
+        double disk_wait =
+            buckets->total.consumeWithBorrowNonBlocking(size, disk_rate, disk_burst, now_seconds)
+                .get_value_or(0);
+        wait_seconds = std::max(share_wait, disk_wait);
+    }
+
+    if (wait_seconds <= 0) {
+        return std::chrono::milliseconds(0);
+    }
+    _counter_throttled_count[index]->increment();
+    return std::chrono::milliseconds(static_cast<int64_t>(std::ceil(wait_seconds * 1000)));
+}
+
+std::chrono::milliseconds
+background_io_limiter::acquire(const std::string &path, background_io_class cls, uint64_t bytes)
+{
+    struct stat st;
+    dev_t disk = 0;
+    if (::stat(path.c_str(), &st) == 0) {
+        disk = st.st_dev;
+    } else {
+        dwarn("stat %s failed, account its background io to the default disk", path.c_str());
+    }
+    return acquire(disk, cls, bytes);
+}
+
+void background_io_limiter::throttle(const std::string &path,
+                                     background_io_class cls,
+                                     uint64_t bytes)
+{
+    std::chrono::milliseconds delay = acquire(path, cls, bytes);
+    if (delay.count() > 0) {
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+} // namespace dsn
@@ -28,7 +28,9 @@
 #include <dsn/tool/nativerun.h>
 #include <dsn/toollet/tracer.h>
 #include <dsn/toollet/profiler.h>
+#include <dsn/toollet/sampling_profiler.h>
 #include <dsn/toollet/fault_injector.h>
+#include <dsn/toollet/latency_injector.h>
 
 #include <dsn/tool/providers.common.h>
 
@@ -42,5 +44,7 @@ void dsn_core_init()
     dsn::tools::register_tool<dsn::tools::simulator>("simulator");
     dsn::tools::register_toollet<dsn::tools::tracer>("tracer");
     dsn::tools::register_toollet<dsn::tools::profiler>("profiler");
+    dsn::tools::register_toollet<dsn::tools::sampling_profiler>("sampling_profiler");
     dsn::tools::register_toollet<dsn::tools::fault_injector>("fault_injector");
+    dsn::tools::register_toollet<dsn::tools::latency_injector>("latency_injector");
 }
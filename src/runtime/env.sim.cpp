@@ -42,6 +42,7 @@ namespace dsn {
 namespace tools {
 
 /*static*/ int sim_env_provider::_seed;
+/*static*/ int sim_env_provider::_forced_seed = 0;
 
 void sim_env_provider::on_worker_start(task_worker *worker)
 {
@@ -59,6 +60,9 @@ sim_env_provider::sim_env_provider(env_provider *inner_provider) : env_provider(
                                          "random_seed",
                                          0,
                                          "random seed for the simulator, 0 for random random seed");
+    if (_forced_seed != 0) {
+        _seed = _forced_seed;
+    }
     if (_seed == 0) {
         _seed = std::random_device{}();
     }
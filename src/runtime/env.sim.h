@@ -45,10 +45,13 @@ class sim_env_provider : public env_provider
 public:
     sim_env_provider(env_provider *inner_provider);
     static int seed() { return _seed; }
+    // overrides [tools.simulator] random_seed, e.g. in a child process of a parallel run
+    static void set_seed(int seed) { _forced_seed = seed; }
 
 private:
     static void on_worker_start(task_worker *worker);
     static int _seed;
+    static int _forced_seed;
 };
 }
 } // end namespace
@@ -0,0 +1,439 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/toollet/latency_injector.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <sstream>
+
+#include <dsn/tool-api/aio_task.h>
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_string("latency_injector",
+                  rules,
+                  "",
+                  "the rules added on start in the format of `latency-inject add`, separated "
+                  "by ';'");
+
+namespace {
+
+enum class distribution_type
+{
+    none,
+    fixed,
+    uniform,
+    normal,
+    pareto,
+};
+
+struct latency_rule
+{
+    std::string name;
+    latency_target target = latency_target::rpc_request;
+    task_code code = TASK_CODE_INVALID;
+    // the port is ignored if it's 0
+    rpc_address addr;
+    std::string disk;
+    dev_t disk_dev = 0;
+    double ratio = 1;
+
+    std::string delay;
+    distribution_type type = distribution_type::none;
+    double p1 = 0;
+    double p2 = 0;
+
+    double bandwidth_mbps = 0;
+    // the bytes are queued on a virtual link, which is busy until this time
+    std::atomic<uint64_t> link_busy_until_us{0};
+
+    std::atomic<uint64_t> hit_count{0};
+
+    bool match(latency_target t, task_code c, rpc_address remote, int fd) const
+    {
+        if (t != target || (code != TASK_CODE_INVALID && c != code)) {
+            return false;
+        }
+        if (!addr.is_invalid() &&
+            (remote.ip() != addr.ip() || (addr.port() != 0 && remote.port() != addr.port()))) {
+            return false;
+        }
+        if (!disk.empty()) {
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0 || st.st_dev != disk_dev) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double sample_delay_ms() const
+    {
+        switch (type) {
+        case distribution_type::fixed:
+            return p1;
+        case distribution_type::uniform:
+            return p1 + (p2 - p1) * rand::next_double01();
+        case distribution_type::normal: {
+            // Box-Muller
+            double u1 = std::max(rand::next_double01(), 1e-9);
+            double u2 = rand::next_double01();
+            return std::max(0.0, p1 + p2 * std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2));
+        }
+        case distribution_type::pareto:
+            return p1 / std::pow(std::max(rand::next_double01(), 1e-9), 1 / p2);
+        default:
+            return 0;
+        }
+    }
+
+    // the time for `bytes` to be transferred on the virtual link, including the queueing
+    uint64_t transfer_us(uint64_t bytes)
+    {
+        if (bandwidth_mbps <= 0) {
+            return 0;
+        }
+        uint64_t now = dsn_now_us();
+        auto cost = static_cast<uint64_t>(bytes / (bandwidth_mbps * 1048576) * 1000000);
+        uint64_t busy_until = link_busy_until_us.load();
+        uint64_t done;
+        do {
+            done = std::max(now, busy_until) + cost;
+        } while (!link_busy_until_us.compare_exchange_weak(busy_until, done));
+        return done - now;
+    }
+};
+
+typedef std::vector<std::shared_ptr<latency_rule>> rule_list;
+
+std::atomic<bool> s_has_rules{false};
+utils::rw_lock_nr s_rules_lock; // [
+rule_list s_rules;
+// ]
+
+// should be called with s_rules_lock held
+rule_list::iterator find_rule(const std::string &name)
+{
+    return std::find_if(s_rules.begin(),
+                        s_rules.end(),
+                        [&](const std::shared_ptr<latency_rule> &r) { return r->name == name; });
+}
+
+bool parse_distribution(const std::string &str, latency_rule &rule)
+{
+    std::vector<std::string> parts;
+    utils::split_args(str.c_str(), parts, ':');
+    if (parts.empty()) {
+        return false;
+    }
+    std::vector<double> params;
+    for (size_t i = 1; i < parts.size(); ++i) {
+        double value;
+        if (!buf2double(parts[i], value) || value < 0) {
+            return false;
+        }
+        params.push_back(value);
+    }
+
+    if (parts[0] == "fixed" && params.size() == 1) {
+        rule.type = distribution_type::fixed;
+    } else if (parts[0] == "uniform" && params.size() == 2 && params[0] <= params[1]) {
+        rule.type = distribution_type::uniform;
+    } else if (parts[0] == "normal" && params.size() == 2) {
+        rule.type = distribution_type::normal;
+    } else if (parts[0] == "pareto" && params.size() == 2 && params[1] > 0) {
+        rule.type = distribution_type::pareto;
+    } else {
+        return false;
+    }
+    rule.p1 = params[0];
+    rule.p2 = params.size() > 1 ? params[1] : 0;
+    rule.delay = str;
+    return true;
+}
+
+const char *target_name(latency_target target)
+{
+    switch (target) {
+    case latency_target::rpc_request:
+        return "rpc_request";
+    case latency_target::rpc_response:
+        return "rpc_response";
+    default:
+        return "aio";
+    }
+}
+
+void on_rpc_request_enqueue(rpc_request_task *callee)
+{
+    message_ex *req = callee->get_request();
+    uint32_t delay = latency_injector::next_delay_ms(latency_target::rpc_request,
+                                                     callee->spec().code,
+                                                     req->header->from_address,
+                                                     -1,
+                                                     req->body_size() + sizeof(message_header));
+    if (delay > 0) {
+        callee->set_delay(callee->delay_milliseconds() + delay);
+    }
+}
+
+void on_rpc_response_enqueue(rpc_response_task *resp)
+{
+    message_ex *response = resp->get_response();
+    uint32_t delay = latency_injector::next_delay_ms(
+        latency_target::rpc_response,
+        resp->spec().code,
+        resp->get_request()->to_address,
+        -1,
+        response == nullptr ? 0 : response->body_size() + sizeof(message_header));
+    if (delay > 0) {
+        resp->set_delay(resp->delay_milliseconds() + delay);
+    }
+}
+
+void on_aio_enqueue(aio_task *callee)
+{
+    aio_context *ctx = callee->get_aio_context();
+    uint32_t delay = latency_injector::next_delay_ms(
+        latency_target::aio,
+        callee->spec().code,
+        rpc_address(),
+        static_cast<int>(reinterpret_cast<uintptr_t>(ctx->file)),
+        callee->get_transferred_size());
+    if (delay > 0) {
+        callee->set_delay(callee->delay_milliseconds() + delay);
+    }
+}
+
+std::string latency_inject_command(const std::vector<std::string> &args)
+{
+    if (args.empty()) {
+        return "invalid arguments";
+    }
+    if (args[0] == "add") {
+        std::string err =
+            latency_injector::add_rule(std::vector<std::string>(args.begin() + 1, args.end()));
+        return err.empty() ? "OK" : err;
+    }
+    if (args[0] == "remove" && args.size() == 2) {
+        return latency_injector::remove_rule(args[1]) ? "OK" : "rule not found";
+    }
+    if (args[0] == "clear" && args.size() == 1) {
+        latency_injector::clear_rules();
+        return "OK";
+    }
+    if (args[0] == "list" && args.size() == 1) {
+        return latency_injector::list_rules();
+    }
+    return "invalid arguments";
+}
+
+} // anonymous namespace
+
+/*static*/ std::string latency_injector::add_rule(const std::vector<std::string> &args)
+{
+    if (args.size() < 2) {
+        return "a rule needs a name and a target";
+    }
+
+    auto rule = std::make_shared<latency_rule>();
+    rule->name = args[0];
+    if (args[1] == "rpc_request") {
+        rule->target = latency_target::rpc_request;
+    } else if (args[1] == "rpc_response") {
+        rule->target = latency_target::rpc_response;
+    } else if (args[1] == "aio") {
+        rule->target = latency_target::aio;
+    } else {
+        return "invalid target " + args[1];
+    }
+
+    for (size_t i = 2; i < args.size(); ++i) {
+        size_t pos = args[i].find('=');
+        if (pos == std::string::npos) {
+            return "invalid option " + args[i];
+        }
+        std::string key = args[i].substr(0, pos);
+        std::string value = args[i].substr(pos + 1);
+        bool ok = true;
+        if (key == "code") {
+            rule->code = task_code::try_get(value, TASK_CODE_INVALID);
+            ok = rule->code != TASK_CODE_INVALID;
+        } else if (key == "addr") {
+            ok = rule->target != latency_target::aio &&
+                 rule->addr.from_string_ipv4(
+                     (value.find(':') == std::string::npos ? value + ":0" : value).c_str());
+        } else if (key == "disk") {
+            struct stat st;
+            ok = rule->target == latency_target::aio && stat(value.c_str(), &st) == 0;
+            if (ok) {
+                rule->disk = value;
+                rule->disk_dev = st.st_dev;
+            }
+        } else if (key == "ratio") {
+            ok = buf2double(value, rule->ratio) && rule->ratio >= 0 && rule->ratio <= 1;
+        } else if (key == "delay") {
+            ok = parse_distribution(value, *rule);
+        } else if (key == "bandwidth") {
+            ok = buf2double(value, rule->bandwidth_mbps) && rule->bandwidth_mbps > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return "invalid option " + args[i];
+        }
+    }
+    if (rule->type == distribution_type::none && rule->bandwidth_mbps <= 0) {
+        return "a rule needs a delay or a bandwidth";
+    }
+
+    utils::auto_write_lock l(s_rules_lock);
+    auto it = find_rule(rule->name);
+    if (it != s_rules.end()) {
+        *it = rule;
+    } else {
+        s_rules.push_back(rule);
+    }
+    s_has_rules.store(true);
+    return std::string();
+}
+
+/*static*/ bool latency_injector::remove_rule(const std::string &name)
+{
+    utils::auto_write_lock l(s_rules_lock);
+    auto it = find_rule(name);
+    if (it == s_rules.end()) {
+        return false;
+    }
+    s_rules.erase(it);
+    s_has_rules.store(!s_rules.empty());
+    return true;
+}
+
+/*static*/ void latency_injector::clear_rules()
+{
+    utils::auto_write_lock l(s_rules_lock);
+    s_rules.clear();
+    s_has_rules.store(false);
+}
+
+/*static*/ std::string latency_injector::list_rules()
+{
+    std::ostringstream oss;
+    utils::auto_read_lock l(s_rules_lock);
+    for (const auto &rule : s_rules) {
+        oss << rule->name << " " << target_name(rule->target);
+        if (rule->code != TASK_CODE_INVALID) {
+            oss << " code=" << rule->code.to_string();
+        }
+        if (!rule->addr.is_invalid()) {
+            oss << " addr=" << rule->addr.to_string();
+        }
+        if (!rule->disk.empty()) {
+            oss << " disk=" << rule->disk;
+        }
+        oss << " ratio=" << rule->ratio;
+        if (!rule->delay.empty()) {
+            oss << " delay=" << rule->delay;
+        }
+        if (rule->bandwidth_mbps > 0) {
+            oss << " bandwidth=" << rule->bandwidth_mbps;
+        }
+        oss << " hits=" << rule->hit_count.load() << std::endl;
+    }
+    return oss.str();
+}
+
+/*static*/ uint32_t latency_injector::next_delay_ms(
+    latency_target target, task_code code, ::dsn::rpc_address remote, int fd, uint64_t bytes)
+{
+    if (!s_has_rules.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    std::shared_ptr<latency_rule> rule;
+    {
+        utils::auto_read_lock l(s_rules_lock);
+        for (const auto &r : s_rules) {
+            if (r->match(target, code, remote, fd)) {
+                rule = r;
+                break;
+            }
+        }
+    }
+    if (rule == nullptr || (rule->ratio < 1 && rand::next_double01() >= rule->ratio)) {
+        return 0;
+    }
+
+    rule->hit_count.fetch_add(1, std::memory_order_relaxed);
+    double delay_us = rule->sample_delay_ms() * 1000 + rule->transfer_us(bytes);
+    return static_cast<uint32_t>(std::ceil(delay_us / 1000));
+}
+
+void latency_injector::install(service_spec &)
+{
+    for (int i = 0; i <= dsn::task_code::max(); i++) {
+        if (i == TASK_CODE_INVALID)
+            continue;
+
+        task_spec *spec = task_spec::get(i);
+        dassert(spec != nullptr, "task_spec cannot be null");
+        spec->on_rpc_request_enqueue.put_back(on_rpc_request_enqueue, "latency_injector");
+        spec->on_rpc_response_enqueue.put_back(on_rpc_response_enqueue, "latency_injector");
+        spec->on_aio_enqueue.put_back(on_aio_enqueue, "latency_injector");
+    }
+
+    std::vector<std::string> rules;
+    utils::split_args(FLAGS_rules, rules, ';');
+    for (const auto &r : rules) {
+        std::vector<std::string> args;
+        utils::split_args(r.c_str(), args, ' ');
+        std::string err = add_rule(args);
+        dassert(err.empty(),
+                "invalid rule \"%s\" in [latency_injector] rules: %s",
+                r.c_str(),
+                err.c_str());
+    }
+
+    command_manager::instance().register_command(
+        {"latency-inject"},
+        "latency-inject - add, remove or list the rules to inject latency into rpc and aio",
+        "latency-inject add <name> rpc_request|rpc_response|aio [code=<task code>] "
+        "[addr=<ip>[:<port>]] [disk=<path>] [ratio=<0..1>] "
+        "[delay=fixed:<ms>|uniform:<min>:<max>|normal:<mean>:<stddev>|pareto:<min>:<alpha>] "
+        "[bandwidth=<MB/s>]\n"
+        "latency-inject remove <name>\n"
+        "latency-inject clear\n"
+        "latency-inject list",
+        latency_inject_command);
+}
+
+latency_injector::latency_injector(const char *name) : toollet(name) {}
+
+} // namespace tools
+} // namespace dsn
@@ -97,6 +97,9 @@ void nativerun::install(service_spec &spec)
 
         if (tspec.queue_factory_name == "")
             tspec.queue_factory_name = ("dsn::tools::simple_task_queue");
+
+        if (tspec.timer_factory_name == "")
+            tspec.timer_factory_name = spec.timer_factory_name;
     }
 }
 
@@ -54,6 +54,8 @@ START<== queue(server) == ENQUEUE <===== net(reply) ======= REPLY <=============
 #include "profiler_header.h"
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/output_utils.h>
+#include <time.h>
 
 namespace dsn {
 namespace tools {
@@ -106,7 +108,134 @@ counter_info *counter_info_ptr[] = {
                      "TIMEOUT(#/s)",
                      "#/s"),
     new counter_info(
-        {"task.inqueue", "tiq"}, TASK_IN_QUEUE, COUNTER_TYPE_NUMBER, "InQueue(#)", "#")};
+        {"task.inqueue", "tiq"}, TASK_IN_QUEUE, COUNTER_TYPE_NUMBER, "InQueue(#)", "#"),
+    new counter_info(
+        {"cpu.time", "ct"}, TASK_CPU_TIME_NS, COUNTER_TYPE_NUMBER_PERCENTILES, "CPU(ns)", "ns")};
+
+// the cpu time of the rpc request tasks accumulated by the partition they are sent to
+class cpu_time_by_gpid
+{
+public:
+    void add(gpid pid, uint64_t cpu_ns)
+    {
+        {
+            utils::auto_read_lock l(_lock);
+            auto it = _cpu_ns.find(pid);
+            if (it != _cpu_ns.end()) {
+                it->second.fetch_add(cpu_ns, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        utils::auto_write_lock l(_lock);
+        _cpu_ns[pid].fetch_add(cpu_ns, std::memory_order_relaxed);
+    }
+
+    std::map<gpid, uint64_t> get(bool reset)
+    {
+        std::map<gpid, uint64_t> result;
+        utils::auto_write_lock l(_lock);
+        for (auto &kv : _cpu_ns) {
+            result[kv.first] = reset ? kv.second.exchange(0) : kv.second.load();
+        }
+        return result;
+    }
+
+private:
+    utils::rw_lock_nr _lock;
+    std::unordered_map<gpid, std::atomic<uint64_t>> _cpu_ns;
+};
+
+static cpu_time_by_gpid s_cpu_time_by_gpid;
+
+// tasks may be executed inline inside other tasks, so a stack is kept for each thread,
+// and the cpu time of a task excludes that of the tasks executed inside it
+struct cpu_time_frame
+{
+    uint64_t start_ns;
+    uint64_t children_ns;
+};
+static thread_local std::vector<cpu_time_frame> s_cpu_time_frames;
+
+static uint64_t thread_cpu_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void profiler_cpu_time_begin() { s_cpu_time_frames.push_back({thread_cpu_time_ns(), 0}); }
+
+static void profiler_cpu_time_end(task *this_, perf_counter *ptr)
+{
+    if (s_cpu_time_frames.empty()) {
+        // the profiler is installed when the task is running
+        return;
+    }
+
+    cpu_time_frame frame = s_cpu_time_frames.back();
+    s_cpu_time_frames.pop_back();
+    uint64_t total_ns = thread_cpu_time_ns() - frame.start_ns;
+    if (!s_cpu_time_frames.empty()) {
+        s_cpu_time_frames.back().children_ns += total_ns;
+    }
+
+    uint64_t self_ns = total_ns > frame.children_ns ? total_ns - frame.children_ns : 0;
+    ptr->set(self_ns);
+    s_spec_profilers[this_->spec().code].total_cpu_ns.fetch_add(self_ns,
+                                                                std::memory_order_relaxed);
+    if (this_->spec().type == TASK_TYPE_RPC_REQUEST) {
+        gpid pid = static_cast<rpc_request_task *>(this_)->get_request()->header->gpid;
+        if (pid.get_app_id() != 0) {
+            s_cpu_time_by_gpid.add(pid, self_ns);
+        }
+    }
+}
+
+static std::string profiler_cpu_time_command(const std::vector<std::string> &args)
+{
+    bool reset = !args.empty() && args[0] == "reset";
+
+    utils::multi_table_printer mtp;
+    utils::table_printer code_tp("task_code");
+    code_tp.add_title("task_code");
+    code_tp.add_column("cpu_ms", utils::table_printer::alignment::kRight);
+    for (int i = 0; i <= s_task_code_max; i++) {
+        if (s_spec_profilers[i].ptr[TASK_CPU_TIME_NS].get() == nullptr) {
+            continue;
+        }
+        uint64_t cpu_ns = reset ? s_spec_profilers[i].total_cpu_ns.exchange(0)
+                                : s_spec_profilers[i].total_cpu_ns.load();
+        if (cpu_ns != 0) {
+            code_tp.add_row(dsn::task_code(i).to_string());
+            code_tp.append_data(cpu_ns / 1000000);
+        }
+    }
+    mtp.add(std::move(code_tp));
+
+    utils::table_printer app_tp("app");
+    app_tp.add_title("app_id");
+    app_tp.add_column("cpu_ms", utils::table_printer::alignment::kRight);
+    utils::table_printer partition_tp("partition");
+    partition_tp.add_title("gpid");
+    partition_tp.add_column("cpu_ms", utils::table_printer::alignment::kRight);
+    std::map<int32_t, uint64_t> cpu_ns_by_app;
+    for (const auto &kv : s_cpu_time_by_gpid.get(reset)) {
+        cpu_ns_by_app[kv.first.get_app_id()] += kv.second;
+        partition_tp.add_row(kv.first.to_string());
+        partition_tp.append_data(kv.second / 1000000);
+    }
+    for (const auto &kv : cpu_ns_by_app) {
+        app_tp.add_row(kv.first);
+        app_tp.append_data(kv.second / 1000000);
+    }
+    mtp.add(std::move(app_tp));
+    mtp.add(std::move(partition_tp));
+
+    std::ostringstream out;
+    mtp.output(out, utils::table_printer::output_format::kTabular);
+    return out.str();
+}
 
 // call normal task
 static void profiler_on_task_create(task *caller, task *callee)
@@ -153,6 +282,9 @@ static void profiler_on_task_begin(task *this_)
     ptr = s_spec_profilers[code].ptr[TASK_IN_QUEUE].get();
     if (ptr != nullptr)
         ptr->decrement();
+
+    if (s_spec_profilers[code].ptr[TASK_CPU_TIME_NS].get() != nullptr)
+        profiler_cpu_time_begin();
 }
 
 static void profiler_on_task_end(task *this_)
@@ -169,6 +301,10 @@ static void profiler_on_task_end(task *this_)
     ptr = s_spec_profilers[code].ptr[TASK_THROUGHPUT].get();
     if (ptr != nullptr)
         ptr->increment();
+
+    ptr = s_spec_profilers[code].ptr[TASK_CPU_TIME_NS].get();
+    if (ptr != nullptr)
+        profiler_cpu_time_end(this_, ptr);
 }
 
 static void profiler_on_task_cancelled(task *this_)
@@ -344,6 +480,12 @@ void profiler::install(service_spec &)
         "collect_call_count",
         true,
         "whether to collect how many time this kind of tasks invoke each of other kinds tasks");
+    auto profile_cpu = dsn_config_get_value_bool(
+        "task..default",
+        "profiler::cpu",
+        false,
+        "whether to profile the thread cpu time of the tasks, which costs two more system calls "
+        "for each task");
 
     for (int i = 0; i <= s_task_code_max; i++) {
         if (i == TASK_CODE_INVALID)
@@ -426,6 +568,17 @@ void profiler::install(service_spec &)
                 COUNTER_TYPE_NUMBER,
                 "cancelled times of a specific task type");
 
+        if (dsn_config_get_value_bool(section_name.c_str(),
+                                      "profiler::cpu",
+                                      profile_cpu,
+                                      "whether to profile the thread cpu time of a task"))
+            s_spec_profilers[i].ptr[TASK_CPU_TIME_NS].init_global_counter(
+                "zion",
+                "profiler",
+                (name + std::string(".cpu(ns)")).c_str(),
+                COUNTER_TYPE_NUMBER_PERCENTILES,
+                "thread cpu time consumed by executing tasks, excluding the inline executed ones");
+
         if (spec->type == dsn_task_type_t::TASK_TYPE_RPC_REQUEST) {
             if (dsn_config_get_value_bool(section_name.c_str(),
                                           "profiler::latency.server",
@@ -523,6 +676,13 @@ void profiler::install(service_spec &)
         spec->on_rpc_reply.put_back(profiler_on_rpc_reply, "profiler");
         spec->on_rpc_response_enqueue.put_back(profiler_on_rpc_response_enqueue, "profiler");
     }
+
+    command_manager::instance().register_command(
+        {"profiler.cpu"},
+        "profiler.cpu - get the accumulated thread cpu time by task code, app and partition, "
+        "the latter two only for rpc requests, and the task codes must enable profiler::cpu",
+        "profiler.cpu [reset]",
+        profiler_cpu_time_command);
 }
 
 profiler::profiler(const char *name) : toollet(name) {}
@@ -44,6 +44,7 @@ enum perf_counter_ptr_type
     RPC_CLIENT_NON_TIMEOUT_LATENCY_NS,
     RPC_CLIENT_TIMEOUT_THROUGHPUT,
     TASK_IN_QUEUE,
+    TASK_CPU_TIME_NS,
 
     PERF_COUNTER_COUNT,
     PERF_COUNTER_INVALID
@@ -78,12 +79,15 @@ struct task_spec_profiler
     bool collect_call_count;
     bool is_profile;
     std::atomic<int64_t> *call_counts;
+    // the total cpu time consumed by this kind of tasks, valid only when profiler::cpu is on
+    std::atomic<uint64_t> total_cpu_ns;
 
     task_spec_profiler()
     {
         collect_call_count = false;
         is_profile = false;
         call_counts = nullptr;
+        total_cpu_ns.store(0);
         memset((void *)ptr, 0, sizeof(ptr));
     }
 };
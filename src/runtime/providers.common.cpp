@@ -34,10 +34,15 @@
  */
 
 #include "runtime/rpc/asio_net_provider.h"
+#include "runtime/rpc/io_uring_net_provider.h"
+#include "runtime/rpc/rdma_net_provider.h"
+#include "runtime/rpc/shm_net_provider.h"
+#include "runtime/rpc/tls_net_provider.h"
 #include <dsn/tool/providers.common.h>
 #include "utils/lockp.std.h"
 #include "runtime/task/simple_task_queue.h"
 #include "runtime/task/hpc_task_queue.h"
+#include "runtime/task/timing_wheel_timer_service.h"
 #include "runtime/rpc/network.sim.h"
 #include "utils/simple_logger.h"
 #include "runtime/rpc/dsn_message_parser.h"
@@ -66,10 +71,22 @@ void register_common_providers()
 
     register_component_provider<asio_network_provider>("dsn::tools::asio_network_provider");
     register_component_provider<asio_udp_provider>("dsn::tools::asio_udp_provider");
+    register_component_provider<shm_network_provider>("dsn::tools::shm_network_provider");
+    register_component_provider<tls_network_provider>("dsn::tools::tls_network_provider");
+#ifdef DSN_HAS_IO_URING
+    register_component_provider<io_uring_network_provider>(
+        "dsn::tools::io_uring_network_provider");
+#endif
+#ifdef DSN_ENABLE_RDMA
+    register_component_provider<rdma_network_provider>("dsn::tools::rdma_network_provider");
+#endif
     register_component_provider<sim_network_provider>("dsn::tools::sim_network_provider");
     register_component_provider<simple_task_queue>("dsn::tools::simple_task_queue");
     register_component_provider<hpc_concurrent_task_queue>("dsn::tools::hpc_concurrent_task_queue");
+    register_component_provider<work_stealing_task_queue>("dsn::tools::work_stealing_task_queue");
     register_component_provider<simple_timer_service>("dsn::tools::simple_timer_service");
+    register_component_provider<timing_wheel_timer_service>(
+        "dsn::tools::timing_wheel_timer_service");
 
     register_message_header_parser<dsn_message_parser>(NET_HDR_DSN, {"RDSN"});
     register_message_header_parser<thrift_message_parser>(NET_HDR_THRIFT, {"THFT"});
@@ -24,6 +24,7 @@
  * THE SOFTWARE.
  */
 
+#include <dsn/utility/numa.h>
 #include <dsn/utility/rand.h>
 #include <memory>
 
@@ -61,13 +62,24 @@ error_code asio_network_provider::start(rpc_channel channel, int port, bool clie
                                          1,
                                          "thread number for io service (timer and boost network)");
 
+    bool numa_spread = dsn_config_get_value_bool(
+        "network",
+        "io_service_numa_spread",
+        false,
+        "whether to bind the io service threads to the numa nodes in blocks, the thread i of n "
+        "to the node i * #node / n, so the buffers they allocate are node-local");
+
     // get connection threshold from config, default value 0 means no threshold
     _cfg_conn_threshold_per_ip = (uint32_t)dsn_config_get_value_uint64(
         "network", "conn_threshold_per_ip", 0, "max connection count to each server per ip");
 
     for (int i = 0; i < io_service_worker_count; i++) {
-        _workers.push_back(std::make_shared<std::thread>([this, i]() {
+        _workers.push_back(std::make_shared<std::thread>([=]() {
             task::set_tls_dsn_context(node(), nullptr);
+            if (numa_spread) {
+                utils::numa::bind_current_thread(i * utils::numa::node_count() /
+                                                 io_service_worker_count);
+            }
 
             const char *name = ::dsn::tools::get_service_node_name(node());
             char buffer[128];
@@ -143,29 +155,7 @@ void asio_network_provider::do_accept()
             } else {
                 auto ip = remote.address().to_v4().to_ulong();
                 auto port = remote.port();
-                ::dsn::rpc_address client_addr(ip, port);
-
-                message_parser_ptr null_parser;
-                rpc_session_ptr s =
-                    new asio_rpc_session(*this,
-                                         client_addr,
-                                         (std::shared_ptr<boost::asio::ip::tcp::socket> &)socket,
-                                         null_parser,
-                                         false);
-
-                // when server connection threshold is hit, close the session, otherwise accept it
-                if (check_if_conn_threshold_exceeded(s->remote_address())) {
-                    dwarn("close rpc connection from %s to %s due to hitting server "
-                          "connection threshold per ip",
-                          s->remote_address().to_string(),
-                          address().to_string());
-                    s->close();
-                } else {
-                    on_server_session_accepted(s);
-
-                    // we should start read immediately after the rpc session is completely created.
-                    s->start_read_next();
-                }
+                on_socket_accepted(socket, ::dsn::rpc_address(ip, port));
             }
         }
 
@@ -173,6 +163,36 @@ void asio_network_provider::do_accept()
     });
 }
 
+void asio_network_provider::on_socket_accepted(
+    const std::shared_ptr<boost::asio::ip::tcp::socket> &socket, ::dsn::rpc_address client_addr)
+{
+    message_parser_ptr null_parser;
+    rpc_session_ptr s =
+        new asio_rpc_session(*this,
+                             client_addr,
+                             (std::shared_ptr<boost::asio::ip::tcp::socket> &)socket,
+                             null_parser,
+                             false);
+    accept_server_session(s);
+}
+
+void asio_network_provider::accept_server_session(rpc_session_ptr s)
+{
+    // when server connection threshold is hit, close the session, otherwise accept it
+    if (check_if_conn_threshold_exceeded(s->remote_address())) {
+        dwarn("close rpc connection from %s to %s due to hitting server "
+              "connection threshold per ip",
+              s->remote_address().to_string(),
+              address().to_string());
+        s->close();
+    } else {
+        on_server_session_accepted(s);
+
+        // we should start read immediately after the rpc session is completely created.
+        s->start_read_next();
+    }
+}
+
 void asio_udp_provider::send_message(message_ex *request)
 {
     auto parser = get_message_parser(request->hdr_format);
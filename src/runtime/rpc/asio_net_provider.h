@@ -43,10 +43,17 @@ public:
     virtual ::dsn::rpc_address address() override { return _address; }
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
 
+protected:
+    // creates the server session on the `socket` just accepted from `client_addr`
+    virtual void on_socket_accepted(const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                                    ::dsn::rpc_address client_addr);
+    // registers the server session `s`, or closes it if the connection threshold is hit
+    void accept_server_session(rpc_session_ptr s);
+
 private:
     void do_accept();
 
-private:
+protected:
     friend class asio_rpc_session;
     friend class asio_network_provider_test;
 
@@ -26,9 +26,29 @@
 
 #include "asio_rpc_session.h"
 
+#include <dsn/utility/flags.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_uint64("network",
+                  zerocopy_send_threshold_bytes,
+                  0,
+                  "send the batches of messages not smaller than this with MSG_ZEROCOPY, "
+                  "0 means to disable zero-copy send");
+
+struct asio_rpc_session::zerocopy_send_state
+{
+    std::vector<iovec> iovs;
+    size_t next_iov = 0;
+    std::vector<message_ex *> msgs;
+    bool has_id = false;
+    uint32_t last_id = 0;
+};
+
 void asio_rpc_session::set_options()
 {
     utils::auto_write_lock socket_guard(_socket_lock);
@@ -73,9 +93,36 @@ void asio_rpc_session::set_options()
         if (ec)
             dwarn("asio socket set option failed, error = %s", ec.message().c_str());
         dinfo("boost asio set no_delay = true");
+
+        enable_zerocopy();
     }
 }
 
+void asio_rpc_session::enable_zerocopy()
+{
+#ifdef SO_ZEROCOPY
+    if (FLAGS_zerocopy_send_threshold_bytes == 0 || _zerocopy_enabled.load()) {
+        return;
+    }
+
+    int one = 1;
+    if (setsockopt(_socket->native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        dwarn("asio socket set SO_ZEROCOPY failed, error = %s", strerror(errno));
+        return;
+    }
+
+    // the zero-copy sends are issued on the native socket, which must not block
+    boost::system::error_code ec;
+    _socket->native_non_blocking(true, ec);
+    if (ec) {
+        dwarn("asio socket set native non-blocking failed, error = %s", ec.message().c_str());
+        return;
+    }
+    _zerocopy_enabled.store(true);
+    dinfo("boost asio set SO_ZEROCOPY = true");
+#endif
+}
+
 void asio_rpc_session::do_read(int read_next)
 {
     add_ref();
@@ -100,37 +147,53 @@ void asio_rpc_session::do_read(int read_next)
                 }
                 on_failure();
             } else {
-                _reader.mark_read(length);
+                on_read_completed(length);
+            }
 
-                int read_next = -1;
+            release_ref();
+        });
+}
 
-                if (!_parser) {
-                    read_next = prepare_parser();
-                }
+void asio_rpc_session::on_read_completed(size_t length)
+{
+    _reader.mark_read(length);
 
-                if (_parser) {
-                    message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+    int read_next = -1;
 
-                    while (msg != nullptr) {
-                        this->on_message_read(msg);
-                        msg = _parser->get_message_on_receive(&_reader, read_next);
-                    }
-                }
+    if (!_parser) {
+        read_next = prepare_parser();
+    }
 
-                if (read_next == -1) {
-                    derror("asio read from %s failed", _remote_addr.to_string());
-                    on_failure();
-                } else {
-                    start_read_next(read_next);
-                }
-            }
+    if (_parser) {
+        message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
 
-            release_ref();
-        });
+        while (msg != nullptr) {
+            this->on_message_read(msg);
+            msg = _parser->get_message_on_receive(&_reader, read_next);
+        }
+    }
+
+    if (read_next == -1) {
+        derror("asio read from %s failed", _remote_addr.to_string());
+        on_failure();
+    } else {
+        start_read_next(read_next);
+    }
 }
 
 void asio_rpc_session::send(uint64_t signature)
 {
+    if (_zerocopy_enabled.load(std::memory_order_relaxed)) {
+        uint64_t total = 0;
+        for (auto &buf : _sending_buffers) {
+            total += buf.sz;
+        }
+        if (total >= FLAGS_zerocopy_send_threshold_bytes) {
+            send_zerocopy(signature);
+            return;
+        }
+    }
+
     std::vector<boost::asio::const_buffer> asio_wbufs;
     int bcount = (int)_sending_buffers.size();
 
@@ -157,16 +220,231 @@ void asio_rpc_session::send(uint64_t signature)
         });
 }
 
+void asio_rpc_session::send_zerocopy(uint64_t signature)
+{
+    auto state = std::make_shared<zerocopy_send_state>();
+    int bcount = (int)_sending_buffers.size();
+    state->iovs.resize(bcount);
+    for (int i = 0; i < bcount; i++) {
+        state->iovs[i].iov_base = _sending_buffers[i].buf;
+        state->iovs[i].iov_len = _sending_buffers[i].sz;
+    }
+
+    // the messages are released by on_send_completed() once all the data is queued into the
+    // socket, but the kernel still references their buffers until the notifications arrive
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        for (auto &msg : _sending_msgs) {
+            msg->add_ref();
+            state->msgs.push_back(msg);
+        }
+    }
+
+    add_ref();
+    do_send_zerocopy(signature, state);
+}
+
+void asio_rpc_session::do_send_zerocopy(uint64_t signature,
+                                        const std::shared_ptr<zerocopy_send_state> &state)
+{
+#ifdef MSG_ZEROCOPY
+    {
+        utils::auto_read_lock socket_guard(_socket_lock);
+
+        int fd = _socket->native_handle();
+        while (state->next_iov < state->iovs.size()) {
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = state->iovs.data() + state->next_iov;
+            msg.msg_iovlen = state->iovs.size() - state->next_iov;
+
+            bool zerocopy = true;
+            ssize_t sent = ::sendmsg(fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+            if (sent < 0 && errno == ENOBUFS) {
+                // the optmem limit for pinning pages is hit, copy this time
+                zerocopy = false;
+                sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+            }
+
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    _socket->async_wait(boost::asio::socket_base::wait_write,
+                                        [this, signature, state](boost::system::error_code ec) {
+                                            if (ec) {
+                                                derror("asio write to %s failed: %s",
+                                                       _remote_addr.to_string(),
+                                                       ec.message().c_str());
+                                                on_zerocopy_send_failed(state);
+                                            } else {
+                                                do_send_zerocopy(signature, state);
+                                            }
+                                        });
+                    return;
+                }
+                derror("asio write to %s failed: %s", _remote_addr.to_string(), strerror(errno));
+                break;
+            }
+
+            if (zerocopy) {
+                state->has_id = true;
+                state->last_id = _zerocopy_next_id++;
+            }
+
+            // skip the sent bytes
+            size_t left = sent;
+            while (state->next_iov < state->iovs.size() &&
+                   left >= state->iovs[state->next_iov].iov_len) {
+                left -= state->iovs[state->next_iov].iov_len;
+                state->next_iov++;
+            }
+            if (state->next_iov < state->iovs.size()) {
+                iovec &iov = state->iovs[state->next_iov];
+                iov.iov_base = static_cast<char *>(iov.iov_base) + left;
+                iov.iov_len -= left;
+            }
+        }
+
+        if (state->next_iov == state->iovs.size() && state->has_id) {
+            {
+                utils::auto_lock<utils::ex_lock_nr> l(_zerocopy_lock);
+                _zerocopy_pending.push_back(
+                    zerocopy_batch{state->last_id, std::move(state->msgs)});
+                state->msgs.clear();
+            }
+            wait_zerocopy_completions();
+        }
+    }
+
+    // on_failure() closes the socket, so it must be called without _socket_lock
+    if (state->next_iov < state->iovs.size()) {
+        on_zerocopy_send_failed(state);
+        return;
+    }
+    for (auto &msg : state->msgs) {
+        msg->release_ref();
+    }
+    on_send_completed(signature);
+    release_ref();
+#endif
+}
+
+void asio_rpc_session::on_zerocopy_send_failed(const std::shared_ptr<zerocopy_send_state> &state)
+{
+    for (auto &msg : state->msgs) {
+        msg->release_ref();
+    }
+    state->msgs.clear();
+    on_failure(true);
+    release_ref();
+}
+
+// should be called with _socket_lock held
+void asio_rpc_session::wait_zerocopy_completions()
+{
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_zerocopy_lock);
+        if (_zerocopy_waiting || _zerocopy_pending.empty()) {
+            return;
+        }
+        _zerocopy_waiting = true;
+    }
+
+    // the notifications are delivered by the error queue of the socket
+    add_ref();
+    _socket->async_wait(boost::asio::socket_base::wait_error, [this](boost::system::error_code ec) {
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_zerocopy_lock);
+            _zerocopy_waiting = false;
+        }
+        if (!ec) {
+            utils::auto_read_lock socket_guard(_socket_lock);
+            read_zerocopy_completions();
+            wait_zerocopy_completions();
+        }
+        release_ref();
+    });
+}
+
+// should be called with _socket_lock held
+void asio_rpc_session::read_zerocopy_completions()
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    int fd = _socket->native_handle();
+    std::vector<message_ex *> released;
+    while (true) {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            auto serr = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // the data is copied anyway (e.g. loopback), it's cheaper to not pin the pages
+                if (_zerocopy_enabled.exchange(false)) {
+                    dinfo("asio zero-copy send to %s falls back to copying, disable it",
+                          _remote_addr.to_string());
+                }
+            }
+
+            // for tcp the completions are notified in order, [ee_info, ee_data] is the range
+            // of the completed ids
+            uint32_t hi = serr->ee_data;
+            utils::auto_lock<utils::ex_lock_nr> l(_zerocopy_lock);
+            while (!_zerocopy_pending.empty() &&
+                   static_cast<int32_t>(_zerocopy_pending.front().last_id - hi) <= 0) {
+                auto &msgs = _zerocopy_pending.front().msgs;
+                released.insert(released.end(), msgs.begin(), msgs.end());
+                _zerocopy_pending.pop_front();
+            }
+        }
+    }
+
+    for (auto &msg : released) {
+        msg->release_ref();
+    }
+#endif
+}
+
 asio_rpc_session::asio_rpc_session(asio_network_provider &net,
                                    ::dsn::rpc_address remote_addr,
                                    std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                                    message_parser_ptr &parser,
                                    bool is_client)
-    : rpc_session(net, remote_addr, parser, is_client), _socket(socket)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _socket(socket),
+      _zerocopy_enabled(false),
+      _zerocopy_next_id(0),
+      _zerocopy_waiting(false)
 {
     set_options();
 }
 
+asio_rpc_session::~asio_rpc_session()
+{
+    // the socket is closed, the kernel holds its own references to the pinned pages
+    for (auto &batch : _zerocopy_pending) {
+        for (auto &msg : batch.msgs) {
+            msg->release_ref();
+        }
+    }
+}
+
 void asio_rpc_session::close()
 {
     utils::auto_write_lock socket_guard(_socket_lock);
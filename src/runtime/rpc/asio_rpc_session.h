@@ -30,6 +30,7 @@
 #include <dsn/utility/priority_queue.h>
 #include <dsn/tool-api/message_parser.h>
 #include <boost/asio.hpp>
+#include <deque>
 #include "asio_net_provider.h"
 
 namespace dsn {
@@ -46,7 +47,7 @@ public:
                      message_parser_ptr &parser,
                      bool is_client);
 
-    ~asio_rpc_session() override = default;
+    ~asio_rpc_session() override;
 
     void send(uint64_t signature) override;
 
@@ -54,9 +55,20 @@ public:
 
     void connect() override;
 
-private:
+protected:
     void do_read(int read_next) override;
     void set_options();
+    // parses the `length` bytes just read into _reader, and starts the next read
+    void on_read_completed(size_t length);
+    // the bytes can't be sent by sendmsg(MSG_ZEROCOPY), e.g. they are encrypted
+    void disable_zerocopy() { _zerocopy_enabled.store(false); }
+
+    // boost::asio::socket is thread-unsafe, must use lock to prevent a
+    // reading/writing socket being modified or closed concurrently.
+    std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
+    ::dsn::utils::rw_lock_nr _socket_lock;
+
+private:
     void on_message_read(message_ex *msg)
     {
         if (!on_recv_message(msg, 0)) {
@@ -64,11 +76,32 @@ private:
         }
     }
 
+    // zero-copy send of large batches with MSG_ZEROCOPY, the messages are kept alive
+    // until the kernel notifies that their pages are released.
+    struct zerocopy_send_state;
+    void enable_zerocopy();
+    void send_zerocopy(uint64_t signature);
+    void do_send_zerocopy(uint64_t signature, const std::shared_ptr<zerocopy_send_state> &state);
+    void on_zerocopy_send_failed(const std::shared_ptr<zerocopy_send_state> &state);
+    void wait_zerocopy_completions();
+    void read_zerocopy_completions();
+
 private:
-    // boost::asio::socket is thread-unsafe, must use lock to prevent a
-    // reading/writing socket being modified or closed concurrently.
-    std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
-    ::dsn::utils::rw_lock_nr _socket_lock;
+    // false if SO_ZEROCOPY is not supported, or the kernel falls back to copying
+    std::atomic_bool _zerocopy_enabled;
+    // the kernel numbers the successful sendmsg(MSG_ZEROCOPY) calls of a socket from 0,
+    // only accessed in send(), which is never called concurrently
+    uint32_t _zerocopy_next_id;
+
+    struct zerocopy_batch
+    {
+        uint32_t last_id;
+        std::vector<message_ex *> msgs;
+    };
+    ::dsn::utils::ex_lock_nr _zerocopy_lock; // [
+    std::deque<zerocopy_batch> _zerocopy_pending;
+    bool _zerocopy_waiting;
+    // ]
 };
 
 } // namespace tools
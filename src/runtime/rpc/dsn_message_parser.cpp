@@ -35,9 +35,17 @@
 
 #include "dsn_message_parser.h"
 #include <dsn/service_api_c.h>
+#include <dsn/utility/compression.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
+DSN_DEFINE_uint32("network",
+                  max_decompressed_body_bytes,
+                  128 * 1024 * 1024,
+                  "the max length of a compressed message body once decompressed, the length is "
+                  "read from the wire and the messages claiming a larger one are rejected");
+
 void dsn_message_parser::reset() { _header_checked = false; }
 
 message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
@@ -77,16 +85,33 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
                 read_next = -1;
                 delete msg;
                 return nullptr;
-            } else {
-                reader->_buffer = buf.range(msg_sz);
-                reader->_buffer_occupied -= msg_sz;
-                _header_checked = false;
-                read_next = (reader->_buffer_occupied >= sizeof(message_header)
-                                 ? 0
-                                 : sizeof(message_header) - reader->_buffer_occupied);
-                msg->hdr_format = NET_HDR_DSN;
-                return msg;
             }
+
+            if (msg->header->context.u.compression_type !=
+                (uint64_t)utils::compression_type::none) {
+                delete msg;
+                if (!decompress_body(msg_bb)) {
+                    message_header *header = (message_header *)buf_ptr;
+                    derror("dsn message body decompression failed, id = %" PRIu64
+                           ", trace_id = %016" PRIx64 ", rpc_name = %s, from_addr = %s",
+                           header->id,
+                           header->trace_id,
+                           header->rpc_name,
+                           header->from_address.to_string());
+                    read_next = -1;
+                    return nullptr;
+                }
+                msg = message_ex::create_receive_message(msg_bb);
+            }
+
+            reader->_buffer = buf.range(msg_sz);
+            reader->_buffer_occupied -= msg_sz;
+            _header_checked = false;
+            read_next = (reader->_buffer_occupied >= sizeof(message_header)
+                             ? 0
+                             : sizeof(message_header) - reader->_buffer_occupied);
+            msg->hdr_format = NET_HDR_DSN;
+            return msg;
         } else { // buf_len < msg_sz
             read_next = msg_sz - buf_len;
             return nullptr;
@@ -111,6 +136,14 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
     dassert(len == (size_t)header->body_length + sizeof(message_header), "data length is wrong");
 #endif
 
+    if (header->context.u.is_request && !header->context.u.is_forwarded) {
+        // announce the codecs we can decompress, so that the server may compress the response
+        header->context.u.accept_lz4 = utils::compression_supported(utils::compression_type::lz4);
+        header->context.u.accept_zstd =
+            utils::compression_supported(utils::compression_type::zstd);
+    }
+    compress_body(msg);
+
     if (task_spec::get(msg->local_rpc_code)->rpc_message_crc_required) {
         // compute data crc if necessary (only once for the first time)
         if (header->body_crc32 == CRC_INVALID) {
@@ -157,6 +190,131 @@ int dsn_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf *b
     return i;
 }
 
+/*static*/ void dsn_message_parser::compress_body(message_ex *msg)
+{
+    auto &header = msg->header;
+    auto &buffers = msg->buffers;
+
+    // a resent message has been compressed already
+    if (header->context.u.compression_type != (uint64_t)utils::compression_type::none) {
+        return;
+    }
+
+    // the codec and threshold are configured on the request code, for both directions
+    task_spec *spec = task_spec::get(msg->local_rpc_code);
+    if (spec == nullptr) {
+        return;
+    }
+    if (!header->context.u.is_request && spec->rpc_paired_code != TASK_CODE_INVALID) {
+        spec = task_spec::get(spec->rpc_paired_code);
+    }
+    if (spec->rpc_message_compression_type == RCT_NONE ||
+        header->body_length < spec->rpc_message_compression_threshold_bytes) {
+        return;
+    }
+
+    utils::compression_type type;
+    bool accepted;
+    if (spec->rpc_message_compression_type == RCT_LZ4) {
+        type = utils::compression_type::lz4;
+        accepted = header->context.u.accept_lz4;
+    } else {
+        type = utils::compression_type::zstd;
+        accepted = header->context.u.accept_zstd;
+    }
+    // the accept bits of a response are copied from the request, they tell whether the client
+    // is able to decompress it
+    if (!utils::compression_supported(type) || (!header->context.u.is_request && !accepted)) {
+        return;
+    }
+
+    // the body is usually scattered in several buffers, the first of which begins with the header
+    size_t body_len = header->body_length;
+    std::unique_ptr<char[]> merged;
+    const char *body;
+    if (buffers.size() == 1) {
+        body = buffers[0].data() + sizeof(message_header);
+    } else if (buffers.size() == 2 && buffers[0].length() == sizeof(message_header)) {
+        body = buffers[1].data();
+    } else {
+        merged.reset(new char[body_len]);
+        char *ptr = merged.get();
+        for (size_t i = 0; i < buffers.size(); i++) {
+            size_t offset = (i == 0 ? sizeof(message_header) : 0);
+            memcpy(ptr, buffers[i].data() + offset, buffers[i].length() - offset);
+            ptr += buffers[i].length() - offset;
+        }
+        body = merged.get();
+    }
+
+    // the compressed body is prefixed with the length of the original body
+    size_t bound = utils::compress_bound(type, body_len);
+    if (bound == 0) {
+        return;
+    }
+    std::shared_ptr<char> compressed = utils::make_shared_array<char>(sizeof(uint32_t) + bound);
+    size_t sz = utils::compress(type, body, body_len, compressed.get() + sizeof(uint32_t), bound);
+    if (sz == 0 || sz + sizeof(uint32_t) >= body_len) {
+        // not compressible
+        return;
+    }
+    uint32_t raw_len = (uint32_t)body_len;
+    memcpy(compressed.get(), &raw_len, sizeof(raw_len));
+
+    blob hdr = buffers[0].range(0, sizeof(message_header));
+    buffers.clear();
+    buffers.emplace_back(std::move(hdr));
+    buffers.emplace_back(std::move(compressed), 0, (unsigned int)(sizeof(uint32_t) + sz));
+
+    header->body_length = (uint32_t)(sizeof(uint32_t) + sz);
+    header->body_crc32 = CRC_INVALID;
+    header->context.u.compression_type = (uint64_t)type;
+}
+
+/*static*/ bool dsn_message_parser::decompress_body(/*inout*/ blob &data)
+{
+    const message_header *header = reinterpret_cast<const message_header *>(data.data());
+    auto type = (utils::compression_type)header->context.u.compression_type;
+    if (!utils::compression_supported(type)) {
+        derror("unsupported compression type %d", (int)type);
+        return false;
+    }
+
+    const char *body = data.data() + sizeof(message_header);
+    size_t body_len = data.length() - sizeof(message_header);
+    if (body_len < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t raw_len;
+    memcpy(&raw_len, body, sizeof(raw_len));
+    if (raw_len == 0 || raw_len > FLAGS_max_decompressed_body_bytes) {
+        derror("invalid decompressed body length %u, max_decompressed_body_bytes = %u",
+               raw_len,
+               FLAGS_max_decompressed_body_bytes);
+        return false;
+    }
+
+    // decompress right behind the header, so that the message is still one contiguous buffer
+    std::shared_ptr<char> raw =
+        utils::make_shared_array<char>(sizeof(message_header) + (size_t)raw_len);
+    if (!utils::decompress(type,
+                           body + sizeof(uint32_t),
+                           body_len - sizeof(uint32_t),
+                           raw.get() + sizeof(message_header),
+                           raw_len)) {
+        return false;
+    }
+    memcpy(raw.get(), header, sizeof(message_header));
+
+    message_header *raw_header = reinterpret_cast<message_header *>(raw.get());
+    raw_header->body_length = raw_len;
+    raw_header->body_crc32 = CRC_INVALID;
+    raw_header->context.u.compression_type = (uint64_t)utils::compression_type::none;
+
+    data = blob(std::move(raw), 0, (unsigned int)(sizeof(message_header) + raw_len));
+    return true;
+}
+
 /*static*/ bool dsn_message_parser::is_right_header(char *hdr)
 {
     uint32_t *pcrc = reinterpret_cast<uint32_t *>(hdr + FIELD_OFFSET(message_header, hdr_crc32));
@@ -55,6 +55,14 @@ public:
 
     virtual int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) override;
 
+    // compress the body of `msg` if it is configured for its task code and large enough,
+    // the message header is kept in place.
+    static void compress_body(message_ex *msg);
+
+    // `data` is a whole message with a compressed body, replace it with the decompressed one,
+    // returns false if the body is corrupted.
+    static bool decompress_body(/*inout*/ blob &data);
+
 private:
     static bool is_right_header(char *hdr);
 
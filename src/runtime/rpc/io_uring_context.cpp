@@ -0,0 +1,269 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "io_uring_context.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params *p)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T *ring_ptr(void *base, unsigned offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+unsigned load_acquire(const unsigned *p)
+{
+    return reinterpret_cast<const std::atomic<unsigned> *>(p)->load(std::memory_order_acquire);
+}
+
+void store_release(unsigned *p, unsigned v)
+{
+    reinterpret_cast<std::atomic<unsigned> *>(p)->store(v, std::memory_order_release);
+}
+
+} // anonymous namespace
+
+io_uring_context::~io_uring_context()
+{
+    if (_sqes != nullptr) {
+        munmap(_sqes, _sqes_size);
+    }
+    if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+        munmap(_cq_ring, _cq_ring_size);
+    }
+    if (_sq_ring != nullptr) {
+        munmap(_sq_ring, _sq_ring_size);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+int io_uring_context::init(unsigned entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    // defer the task work to the submitting thread, which saves the interrupts
+    p.flags = IORING_SETUP_COOP_TASKRUN;
+    _fd = sys_io_uring_setup(entries, &p);
+    if (_fd < 0 && errno == EINVAL) {
+        // not supported until linux 5.19
+        memset(&p, 0, sizeof(p));
+        _fd = sys_io_uring_setup(entries, &p);
+    }
+    if (_fd < 0) {
+        return -errno;
+    }
+
+    _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring = mmap(nullptr,
+                    _sq_ring_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    _fd,
+                    IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED) {
+        _sq_ring = nullptr;
+        return -errno;
+    }
+    if (single_mmap) {
+        _cq_ring = _sq_ring;
+    } else {
+        _cq_ring = mmap(nullptr,
+                        _cq_ring_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        _fd,
+                        IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) {
+            _cq_ring = nullptr;
+            return -errno;
+        }
+    }
+
+    _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr,
+                      _sqes_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      _fd,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return -errno;
+    }
+    _sqes = static_cast<io_uring_sqe *>(sqes);
+
+    _sq_head = ring_ptr<unsigned>(_sq_ring, p.sq_off.head);
+    _sq_tail = ring_ptr<unsigned>(_sq_ring, p.sq_off.tail);
+    _sq_mask = *ring_ptr<unsigned>(_sq_ring, p.sq_off.ring_mask);
+    _sq_entries = *ring_ptr<unsigned>(_sq_ring, p.sq_off.ring_entries);
+    _sqe_tail = *_sq_tail;
+
+    // the sqes are always used in order, so the index array is an identity mapping
+    unsigned *sq_array = ring_ptr<unsigned>(_sq_ring, p.sq_off.array);
+    for (unsigned i = 0; i < _sq_entries; ++i) {
+        sq_array[i] = i;
+    }
+
+    _cq_head = ring_ptr<unsigned>(_cq_ring, p.cq_off.head);
+    _cq_tail = ring_ptr<unsigned>(_cq_ring, p.cq_off.tail);
+    _cq_mask = *ring_ptr<unsigned>(_cq_ring, p.cq_off.ring_mask);
+    _cqes = ring_ptr<io_uring_cqe>(_cq_ring, p.cq_off.cqes);
+    return 0;
+}
+
+io_uring_sqe *io_uring_context::get_sqe()
+{
+    if (_sqe_tail - load_acquire(_sq_head) >= _sq_entries) {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &_sqes[_sqe_tail & _sq_mask];
+    ++_sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int io_uring_context::submit_and_wait(unsigned wait_nr)
+{
+    unsigned to_submit = _sqe_tail - *_sq_tail;
+    store_release(_sq_tail, _sqe_tail);
+
+    while (true) {
+        int ret = sys_io_uring_enter(
+            _fd, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (ret >= 0) {
+            return ret;
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+        // the sqes are consumed by the kernel even if the waiting is interrupted
+        to_submit = 0;
+    }
+}
+
+io_uring_cqe *io_uring_context::peek_cqe()
+{
+    unsigned head = *_cq_head;
+    if (head == load_acquire(_cq_tail)) {
+        return nullptr;
+    }
+    return &_cqes[head & _cq_mask];
+}
+
+void io_uring_context::cqe_seen() { store_release(_cq_head, *_cq_head + 1); }
+
+io_uring_buffer_ring::~io_uring_buffer_ring()
+{
+    if (_buf_ring != nullptr) {
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = _group_id;
+        sys_io_uring_register(_ring->fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(_buf_ring, _buf_ring_size);
+    }
+    delete[] _buffers;
+}
+
+int io_uring_buffer_ring::init(io_uring_context &ring,
+                               uint16_t group_id,
+                               unsigned count,
+                               unsigned buffer_size)
+{
+    _ring = &ring;
+    _group_id = group_id;
+    _count = count;
+    _buffer_size = buffer_size;
+
+    // the ring must be page aligned
+    _buf_ring_size = count * sizeof(io_uring_buf);
+    void *p = mmap(
+        nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return -errno;
+    }
+    _buf_ring = static_cast<io_uring_buf_ring *>(p);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+    reg.ring_entries = count;
+    reg.bgid = group_id;
+    if (sys_io_uring_register(ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int err = errno;
+        munmap(_buf_ring, _buf_ring_size);
+        _buf_ring = nullptr;
+        return -err;
+    }
+
+    _buffers = new char[static_cast<size_t>(count) * buffer_size];
+    for (unsigned i = 0; i < count; ++i) {
+        recycle(static_cast<uint16_t>(i));
+    }
+    return 0;
+}
+
+void io_uring_buffer_ring::recycle(uint16_t id)
+{
+    io_uring_buf *buf = &_buf_ring->bufs[_tail & (_count - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffer(id));
+    buf->len = _buffer_size;
+    buf->bid = id;
+    ++_tail;
+    reinterpret_cast<std::atomic<uint16_t> *>(&_buf_ring->tail)
+        ->store(_tail, std::memory_order_release);
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
@@ -0,0 +1,115 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define DSN_HAS_IO_URING 1
+#endif
+#endif
+
+#ifdef DSN_HAS_IO_URING
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace dsn {
+namespace tools {
+
+// A minimal wrapper of the io_uring syscalls, so that liburing is not a dependency.
+// Not thread-safe, the ring is supposed to be used by a single thread.
+class io_uring_context
+{
+public:
+    io_uring_context() = default;
+    ~io_uring_context();
+
+    // returns 0 on success, or -errno
+    int init(unsigned entries);
+
+    int fd() const { return _fd; }
+
+    // returns nullptr when the submission queue is full, the returned sqe is cleared
+    io_uring_sqe *get_sqe();
+
+    // submit all the sqes got since the last submission, and wait for at least
+    // `wait_nr` completions, returns the number of submitted sqes, or -errno
+    int submit_and_wait(unsigned wait_nr);
+
+    // returns nullptr if there is no completion now, cqe_seen() must be called after
+    // the returned cqe is handled
+    io_uring_cqe *peek_cqe();
+    void cqe_seen();
+
+private:
+    int _fd = -1;
+
+    void *_sq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    void *_cq_ring = nullptr;
+    size_t _cq_ring_size = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    unsigned *_sq_head = nullptr;
+    unsigned *_sq_tail = nullptr;
+    unsigned _sq_mask = 0;
+    unsigned _sq_entries = 0;
+    // the sqes in [*_sq_tail, _sqe_tail) are got but not submitted
+    unsigned _sqe_tail = 0;
+
+    unsigned *_cq_head = nullptr;
+    unsigned *_cq_tail = nullptr;
+    unsigned _cq_mask = 0;
+    io_uring_cqe *_cqes = nullptr;
+};
+
+// A ring of buffers provided to the kernel (IORING_REGISTER_PBUF_RING), from which the
+// kernel picks a buffer for each completion of the recv operations with IOSQE_BUFFER_SELECT.
+class io_uring_buffer_ring
+{
+public:
+    io_uring_buffer_ring() = default;
+    ~io_uring_buffer_ring();
+
+    // `count` must be a power of 2, returns 0 on success, or -errno
+    int init(io_uring_context &ring, uint16_t group_id, unsigned count, unsigned buffer_size);
+
+    uint16_t group_id() const { return _group_id; }
+    unsigned buffer_size() const { return _buffer_size; }
+    char *buffer(uint16_t id) const { return _buffers + static_cast<size_t>(id) * _buffer_size; }
+
+    // give the buffer back to the kernel after the data in it is consumed
+    void recycle(uint16_t id);
+
+private:
+    io_uring_context *_ring = nullptr;
+    io_uring_buf_ring *_buf_ring = nullptr;
+    size_t _buf_ring_size = 0;
+    char *_buffers = nullptr;
+    unsigned _count = 0;
+    unsigned _buffer_size = 0;
+    uint16_t _group_id = 0;
+    uint16_t _tail = 0;
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
@@ -0,0 +1,404 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "io_uring_net_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <arpa/inet.h>
+#include <future>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "io_uring_rpc_session.h"
+
+namespace dsn {
+namespace tools {
+
+static thread_local io_uring_loop *s_current_loop = nullptr;
+
+// a pending read on the eventfd, to wake up the loop waiting for completions
+class io_uring_loop::wakeup_operation : public io_uring_operation
+{
+public:
+    wakeup_operation(io_uring_loop *loop) : _loop(loop) {}
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = _loop->_event_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&_value);
+        sqe->len = sizeof(_value);
+    }
+
+    bool complete(io_uring_cqe *cqe) override
+    {
+        if (!_loop->_stopped.load(std::memory_order_relaxed)) {
+            _loop->submit(this);
+        }
+        return false;
+    }
+
+private:
+    io_uring_loop *_loop;
+    uint64_t _value;
+};
+
+io_uring_loop::io_uring_loop(unsigned entries, unsigned buffer_count, unsigned buffer_size)
+    : _entries(entries),
+      _buffer_count(buffer_count),
+      _buffer_size(buffer_size),
+      _event_fd(-1),
+      _stopped(false)
+{
+}
+
+io_uring_loop::~io_uring_loop()
+{
+    if (_event_fd >= 0) {
+        ::close(_event_fd);
+    }
+}
+
+int io_uring_loop::init()
+{
+    int err = _ring.init(_entries);
+    if (err != 0) {
+        return err;
+    }
+
+    if (_buffer_count > 0) {
+        _buffer_ring.reset(new io_uring_buffer_ring());
+        err = _buffer_ring->init(_ring, 0, _buffer_count, _buffer_size);
+        if (err != 0) {
+            // provided buffer rings are supported since linux 5.19
+            dwarn("io_uring provided buffer ring is not supported, fall back to single-shot recv, "
+                  "err = %s",
+                  strerror(-err));
+            _buffer_ring.reset();
+        }
+    }
+
+    _event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_event_fd < 0) {
+        return -errno;
+    }
+    _wakeup_op.reset(new wakeup_operation(this));
+
+    s_current_loop = this;
+    submit(_wakeup_op.get());
+    return 0;
+}
+
+void io_uring_loop::run()
+{
+    std::vector<std::function<void()>> posted;
+    while (!_stopped.load(std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> l(_posted_lock);
+            posted.swap(_posted);
+        }
+        for (auto &cb : posted) {
+            cb();
+        }
+        posted.clear();
+
+        int ret = _ring.submit_and_wait(1);
+        // EBUSY or EAGAIN means the completion queue is overflowed, just consume it
+        if (ret < 0 && ret != -EBUSY && ret != -EAGAIN) {
+            dassert(false, "io_uring_enter failed: err(%s)", strerror(-ret));
+        }
+
+        io_uring_cqe *cqe;
+        while ((cqe = _ring.peek_cqe()) != nullptr) {
+            auto op = reinterpret_cast<io_uring_operation *>(cqe->user_data);
+            // the cqe must be consumed before completing, because the completion
+            // may submit new sqes
+            io_uring_cqe c = *cqe;
+            _ring.cqe_seen();
+            if (op != nullptr && op->complete(&c)) {
+                delete op;
+            }
+        }
+    }
+    s_current_loop = nullptr;
+}
+
+void io_uring_loop::stop()
+{
+    _stopped.store(true);
+    wakeup();
+}
+
+void io_uring_loop::wakeup()
+{
+    if (_event_fd < 0) {
+        return;
+    }
+    uint64_t v = 1;
+    if (::write(_event_fd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+        dwarn("io_uring loop wakeup failed, err = %s", strerror(errno));
+    }
+}
+
+void io_uring_loop::dispatch(std::function<void()> cb)
+{
+    if (in_loop_thread()) {
+        cb();
+        return;
+    }
+
+    bool need_wakeup;
+    {
+        std::lock_guard<std::mutex> l(_posted_lock);
+        need_wakeup = _posted.empty();
+        _posted.emplace_back(std::move(cb));
+    }
+    // the loop will drain all the posted callbacks once woken up
+    if (need_wakeup) {
+        wakeup();
+    }
+}
+
+void io_uring_loop::submit(io_uring_operation *op)
+{
+    io_uring_sqe *sqe = _ring.get_sqe();
+    while (sqe == nullptr) {
+        // the submission queue is full, flush it
+        int ret = _ring.submit_and_wait(0);
+        dassert(ret >= 0 || ret == -EBUSY || ret == -EAGAIN,
+                "io_uring_enter failed: err(%s)",
+                strerror(-ret));
+        sqe = _ring.get_sqe();
+    }
+    op->prepare(sqe);
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+}
+
+bool io_uring_loop::in_loop_thread() const { return s_current_loop == this; }
+
+class io_uring_network_provider::accept_operation : public io_uring_operation
+{
+public:
+    accept_operation(io_uring_network_provider *net) : _net(net) {}
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        _addr_len = sizeof(_addr);
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = _net->_listen_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&_addr);
+        sqe->addr2 = reinterpret_cast<uint64_t>(&_addr_len);
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    }
+
+    bool complete(io_uring_cqe *cqe) override
+    {
+        if (cqe->res >= 0) {
+            ::dsn::rpc_address client_addr(ntohl(_addr.sin_addr.s_addr), ntohs(_addr.sin_port));
+            _net->on_accepted(cqe->res, client_addr);
+        } else if (cqe->res == -ECANCELED || cqe->res == -EINVAL) {
+            // the listening socket is shut down
+            return false;
+        } else {
+            dwarn("io_uring accept failed, err = %s", strerror(-cqe->res));
+        }
+
+        _net->_loops[0]->submit(this);
+        return false;
+    }
+
+private:
+    io_uring_network_provider *_net;
+    sockaddr_in _addr;
+    socklen_t _addr_len;
+};
+
+io_uring_network_provider::io_uring_network_provider(rpc_engine *srv, network *inner_provider)
+    : connection_oriented_network(srv, inner_provider), _next_loop(0), _listen_fd(-1)
+{
+}
+
+io_uring_network_provider::~io_uring_network_provider()
+{
+    if (_listen_fd >= 0) {
+        ::shutdown(_listen_fd, SHUT_RDWR);
+    }
+    for (auto &l : _loops) {
+        l->stop();
+    }
+    for (auto &w : _workers) {
+        w->join();
+    }
+    if (_listen_fd >= 0) {
+        ::close(_listen_fd);
+    }
+}
+
+error_code io_uring_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    if (_listen_fd >= 0)
+        return ERR_SERVICE_ALREADY_RUNNING;
+
+    dassert(channel == RPC_CHANNEL_TCP, "invalid given channel %s", channel.to_string());
+
+    int io_service_worker_count =
+        (int)dsn_config_get_value_uint64("network",
+                                         "io_service_worker_count",
+                                         1,
+                                         "thread number for io service (timer and boost network)");
+    unsigned entries = (unsigned)dsn_config_get_value_uint64(
+        "network", "io_uring_entries", 1024, "submission queue size of each io_uring loop");
+    unsigned buffer_count = (unsigned)dsn_config_get_value_uint64(
+        "network",
+        "io_uring_buffer_count",
+        1024,
+        "count of the provided recv buffers of each io_uring loop, must be a power of 2, "
+        "0 means to use single-shot recv into the message buffers");
+    unsigned buffer_size = (unsigned)dsn_config_get_value_uint64(
+        "network", "io_uring_buffer_size", 16384, "size of each provided recv buffer of io_uring");
+    dassert((buffer_count & (buffer_count - 1)) == 0,
+            "io_uring_buffer_count(%u) must be a power of 2",
+            buffer_count);
+
+    // get connection threshold from config, default value 0 means no threshold
+    _cfg_conn_threshold_per_ip = (uint32_t)dsn_config_get_value_uint64(
+        "network", "conn_threshold_per_ip", 0, "max connection count to each server per ip");
+
+    // the loops are shared by the following starts
+    if (_loops.empty()) {
+        std::vector<std::future<int>> inited;
+        for (int i = 0; i < io_service_worker_count; i++) {
+            _loops.emplace_back(new io_uring_loop(entries, buffer_count, buffer_size));
+            auto promise = std::make_shared<std::promise<int>>();
+            inited.push_back(promise->get_future());
+            io_uring_loop *loop = _loops.back().get();
+            _workers.push_back(std::make_shared<std::thread>([this, i, loop, promise]() {
+                task::set_tls_dsn_context(node(), nullptr);
+
+                const char *name = ::dsn::tools::get_service_node_name(node());
+                char buffer[128];
+                sprintf(buffer, "%s.io_uring.%d", name, i);
+                task_worker::set_name(buffer);
+
+                int err = loop->init();
+                promise->set_value(err);
+                if (err == 0) {
+                    loop->run();
+                }
+            }));
+        }
+
+        error_code result = ERR_OK;
+        for (auto &f : inited) {
+            int err = f.get();
+            if (err != 0) {
+                derror("io_uring setup failed, err = %s", strerror(-err));
+                result = ERR_NETWORK_INIT_FAILED;
+            }
+        }
+        if (result != ERR_OK) {
+            for (auto &l : _loops) {
+                l->stop();
+            }
+            for (auto &w : _workers) {
+                w->join();
+            }
+            _workers.clear();
+            _loops.clear();
+            return result;
+        }
+    }
+
+    _address.assign_ipv4(get_local_ipv4(), port);
+
+    if (!client_only) {
+        _listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (_listen_fd < 0) {
+            derror("io_uring tcp acceptor open failed, error = %s", strerror(errno));
+            return ERR_NETWORK_INIT_FAILED;
+        }
+        int reuse = 1;
+        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(_address.port());
+        if (::bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+            derror("io_uring tcp acceptor bind failed, error = %s", strerror(errno));
+            ::close(_listen_fd);
+            _listen_fd = -1;
+            return ERR_NETWORK_INIT_FAILED;
+        }
+        if (::listen(_listen_fd, SOMAXCONN) < 0) {
+            derror("io_uring tcp acceptor listen failed, port = %u, error = %s",
+                   _address.port(),
+                   strerror(errno));
+            ::close(_listen_fd);
+            _listen_fd = -1;
+            return ERR_NETWORK_INIT_FAILED;
+        }
+
+        _accept_op.reset(new accept_operation(this));
+        io_uring_loop *loop = _loops[0].get();
+        loop->dispatch([loop, this]() { loop->submit(_accept_op.get()); });
+    }
+
+    return ERR_OK;
+}
+
+io_uring_loop *io_uring_network_provider::next_loop()
+{
+    return _loops[_next_loop.fetch_add(1, std::memory_order_relaxed) % _loops.size()].get();
+}
+
+rpc_session_ptr io_uring_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    return rpc_session_ptr(
+        new io_uring_rpc_session(*this, server_addr, next_loop(), -1, parser, true));
+}
+
+void io_uring_network_provider::on_accepted(int fd, const ::dsn::rpc_address &client_addr)
+{
+    message_parser_ptr null_parser;
+    rpc_session_ptr s =
+        new io_uring_rpc_session(*this, client_addr, next_loop(), fd, null_parser, false);
+
+    // when server connection threshold is hit, close the session, otherwise accept it
+    if (check_if_conn_threshold_exceeded(s->remote_address())) {
+        dwarn("close rpc connection from %s to %s due to hitting server "
+              "connection threshold per ip",
+              s->remote_address().to_string(),
+              address().to_string());
+        s->close();
+    } else {
+        on_server_session_accepted(s);
+
+        // we should start read immediately after the rpc session is completely created.
+        s->start_read_next();
+    }
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
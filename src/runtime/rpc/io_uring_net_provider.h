@@ -0,0 +1,135 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include "io_uring_context.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <dsn/tool_api.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+namespace tools {
+
+// An asynchronous operation submitted to an io_uring_loop, the address of the operation
+// is used as the user_data of its sqes.
+class io_uring_operation
+{
+public:
+    virtual ~io_uring_operation() = default;
+
+    virtual void prepare(io_uring_sqe *sqe) = 0;
+
+    // returns true if the operation is finished and should be deleted by the loop
+    virtual bool complete(io_uring_cqe *cqe) = 0;
+};
+
+// An event loop running on a single thread, which owns an io_uring instance. All the sqes
+// prepared during one iteration of the loop are submitted in a single io_uring_enter call.
+class io_uring_loop
+{
+public:
+    io_uring_loop(unsigned entries, unsigned buffer_count, unsigned buffer_size);
+    ~io_uring_loop();
+
+    // must be called in the loop thread before run(), returns 0 on success, or -errno
+    int init();
+    void run();
+    // thread-safe
+    void stop();
+
+    // run `cb` in the loop thread, it's run immediately if called in the loop thread.
+    // thread-safe
+    void dispatch(std::function<void()> cb);
+
+    // prepare a sqe for the operation, which is submitted in the next iteration.
+    // must be called in the loop thread
+    void submit(io_uring_operation *op);
+
+    bool in_loop_thread() const;
+
+    // returns nullptr if the provided buffer ring is not supported by the kernel,
+    // in which case the recv operations must provide their own buffers
+    io_uring_buffer_ring *buffer_ring() const { return _buffer_ring.get(); }
+
+private:
+    class wakeup_operation;
+    void wakeup();
+
+private:
+    const unsigned _entries;
+    const unsigned _buffer_count;
+    const unsigned _buffer_size;
+
+    // declared in this order so that the ring is closed before the wakeup operation
+    // is freed, and the buffer ring is unregistered before the ring is closed
+    std::unique_ptr<wakeup_operation> _wakeup_op;
+    io_uring_context _ring;
+    std::unique_ptr<io_uring_buffer_ring> _buffer_ring;
+    int _event_fd;
+    std::atomic_bool _stopped;
+
+    std::mutex _posted_lock; // [
+    std::vector<std::function<void()>> _posted;
+    // ]
+};
+
+// A TCP network provider based on io_uring, to reduce the syscalls of the asio provider:
+//  - recv: multishot recv with the buffers selected from a provided buffer ring,
+//    so that one recv request serves all the incoming data of a connection,
+//  - send: sendmsg with the scattered buffers of a batch of messages,
+//  - all the operations issued in one loop iteration are submitted in batch.
+class io_uring_network_provider : public connection_oriented_network
+{
+public:
+    io_uring_network_provider(rpc_engine *srv, network *inner_provider);
+
+    ~io_uring_network_provider() override;
+
+    virtual error_code start(rpc_channel channel, int port, bool client_only) override;
+    virtual ::dsn::rpc_address address() override { return _address; }
+    virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+private:
+    class accept_operation;
+    friend class accept_operation;
+    friend class io_uring_rpc_session;
+
+    // sessions are assigned to the loops in a round-robin way
+    io_uring_loop *next_loop();
+    void on_accepted(int fd, const ::dsn::rpc_address &client_addr);
+
+private:
+    std::vector<std::unique_ptr<io_uring_loop>> _loops;
+    std::vector<std::shared_ptr<std::thread>> _workers;
+    std::atomic<uint32_t> _next_loop;
+    int _listen_fd;
+    std::unique_ptr<accept_operation> _accept_op;
+    ::dsn::rpc_address _address;
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
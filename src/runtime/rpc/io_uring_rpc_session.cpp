@@ -0,0 +1,404 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "io_uring_rpc_session.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+// Owned by the session, and reused by all the recv requests of the session.
+class io_uring_rpc_session::recv_operation : public io_uring_operation
+{
+public:
+    recv_operation(io_uring_rpc_session *s) : _session(s) {}
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = _session->_socket_fd.load();
+        io_uring_buffer_ring *buffers = _session->_loop->buffer_ring();
+        if (buffers != nullptr) {
+            // a multishot recv keeps generating completions until it's cancelled,
+            // or it runs out of the provided buffers
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = buffers->group_id();
+        } else {
+            message_reader &reader = _session->_reader;
+            sqe->addr = reinterpret_cast<uint64_t>(reader.read_buffer_ptr(_session->_read_next));
+            sqe->len = reader.read_buffer_capacity();
+        }
+    }
+
+    bool complete(io_uring_cqe *cqe) override
+    {
+        io_uring_rpc_session *s = _session;
+        bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        s->on_recv_completed(cqe);
+        // the session, together with this operation, may be destroyed here
+        if (!more) {
+            s->release_ref();
+        }
+        return false;
+    }
+
+private:
+    io_uring_rpc_session *_session;
+};
+
+class io_uring_rpc_session::send_operation : public io_uring_operation
+{
+public:
+    send_operation(io_uring_rpc_session *s, uint64_t signature)
+        : _session(s), _signature(signature)
+    {
+        _session->add_ref();
+
+        int bcount = (int)_session->_sending_buffers.size();
+        _iovs.resize(bcount);
+        for (int i = 0; i < bcount; i++) {
+            _iovs[i].iov_base = _session->_sending_buffers[i].buf;
+            _iovs[i].iov_len = _session->_sending_buffers[i].sz;
+        }
+        _next_iov = 0;
+    }
+
+    ~send_operation() override { _session->release_ref(); }
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        memset(&_msg, 0, sizeof(_msg));
+        _msg.msg_iov = _iovs.data() + _next_iov;
+        _msg.msg_iovlen = _iovs.size() - _next_iov;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = _session->_socket_fd.load();
+        sqe->addr = reinterpret_cast<uint64_t>(&_msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+
+    bool complete(io_uring_cqe *cqe) override
+    {
+        if (cqe->res < 0) {
+            derror("io_uring write to %s failed: %s",
+                   _session->_remote_addr.to_string(),
+                   strerror(-cqe->res));
+            _session->on_failure(true);
+            return true;
+        }
+
+        // skip the sent bytes, and resubmit the remaining if it's a partial write
+        size_t sent = cqe->res;
+        while (_next_iov < _iovs.size() && sent >= _iovs[_next_iov].iov_len) {
+            sent -= _iovs[_next_iov].iov_len;
+            _next_iov++;
+        }
+        if (_next_iov < _iovs.size()) {
+            _iovs[_next_iov].iov_base = static_cast<char *>(_iovs[_next_iov].iov_base) + sent;
+            _iovs[_next_iov].iov_len -= sent;
+            _session->_loop->submit(this);
+            return false;
+        }
+
+        _session->on_send_completed(_signature);
+        return true;
+    }
+
+private:
+    io_uring_rpc_session *_session;
+    uint64_t _signature;
+    std::vector<iovec> _iovs;
+    size_t _next_iov;
+    msghdr _msg;
+};
+
+class io_uring_rpc_session::connect_operation : public io_uring_operation
+{
+public:
+    connect_operation(io_uring_rpc_session *s) : _session(s)
+    {
+        _session->add_ref();
+
+        memset(&_addr, 0, sizeof(_addr));
+        _addr.sin_family = AF_INET;
+        _addr.sin_addr.s_addr = htonl(_session->_remote_addr.ip());
+        _addr.sin_port = htons(_session->_remote_addr.port());
+    }
+
+    ~connect_operation() override { _session->release_ref(); }
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = _session->_socket_fd.load();
+        sqe->addr = reinterpret_cast<uint64_t>(&_addr);
+        sqe->off = sizeof(_addr);
+    }
+
+    bool complete(io_uring_cqe *cqe) override
+    {
+        if (cqe->res == 0) {
+            dinfo("client session %s connected", _session->_remote_addr.to_string());
+
+            _session->set_options();
+            _session->set_connected();
+            _session->on_send_completed();
+            _session->start_read_next();
+        } else {
+            derror("client session connect to %s failed, error = %s",
+                   _session->_remote_addr.to_string(),
+                   strerror(-cqe->res));
+            _session->on_failure(true);
+        }
+        return true;
+    }
+
+private:
+    io_uring_rpc_session *_session;
+    sockaddr_in _addr;
+};
+
+// cancel the multishot recv of a session, the recv completes with -ECANCELED
+class recv_cancel_operation : public io_uring_operation
+{
+public:
+    recv_cancel_operation(io_uring_operation *target) : _target(target) {}
+
+    void prepare(io_uring_sqe *sqe) override
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(_target);
+    }
+
+    bool complete(io_uring_cqe *cqe) override { return true; }
+
+private:
+    io_uring_operation *_target;
+};
+
+io_uring_rpc_session::io_uring_rpc_session(io_uring_network_provider &net,
+                                           ::dsn::rpc_address remote_addr,
+                                           io_uring_loop *loop,
+                                           int socket_fd,
+                                           message_parser_ptr &parser,
+                                           bool is_client)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _loop(loop),
+      _socket_fd(socket_fd),
+      _recv_op(new recv_operation(this)),
+      _recv_armed(false),
+      _recv_cancelling(false),
+      _read_requested(false),
+      _data_pending(false),
+      _read_next(0)
+{
+    if (socket_fd >= 0) {
+        set_options();
+    }
+}
+
+io_uring_rpc_session::~io_uring_rpc_session()
+{
+    int fd = _socket_fd.load();
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void io_uring_rpc_session::set_options()
+{
+    int fd = _socket_fd.load();
+    if (fd < 0) {
+        return;
+    }
+
+    int size = 16 * 1024 * 1024;
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0)
+        dwarn("io_uring socket set option failed, error = %s", strerror(errno));
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+        dwarn("io_uring socket set option failed, error = %s", strerror(errno));
+
+    // disable the Nagle algorithm for the same reason as asio_rpc_session
+    int no_delay = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) < 0)
+        dwarn("io_uring socket set option failed, error = %s", strerror(errno));
+    dinfo("io_uring socket buffer size set as 16MB, no_delay = true");
+}
+
+void io_uring_rpc_session::do_read(int read_next)
+{
+    add_ref();
+    _loop->dispatch([this, read_next]() {
+        start_recv(read_next);
+        release_ref();
+    });
+}
+
+void io_uring_rpc_session::start_recv(int read_next)
+{
+    _read_requested = true;
+    _read_next = read_next;
+
+    // the data received while the reading is delayed
+    if (_data_pending) {
+        _data_pending = false;
+        _read_requested = false;
+        on_data_read();
+        return;
+    }
+
+    if (!_recv_armed) {
+        arm_recv();
+    }
+}
+
+void io_uring_rpc_session::arm_recv()
+{
+    // released when the recv operation completes without IORING_CQE_F_MORE
+    add_ref();
+    _recv_armed = true;
+    _loop->submit(_recv_op.get());
+}
+
+void io_uring_rpc_session::cancel_recv()
+{
+    _recv_cancelling = true;
+    _loop->submit(new recv_cancel_operation(_recv_op.get()));
+}
+
+void io_uring_rpc_session::on_recv_completed(io_uring_cqe *cqe)
+{
+    io_uring_buffer_ring *buffers = _loop->buffer_ring();
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+        _recv_armed = false;
+        _recv_cancelling = false;
+    }
+
+    int res = cqe->res;
+    if (res > 0) {
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            uint16_t id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            memcpy(_reader.read_buffer_ptr(res), buffers->buffer(id), res);
+            buffers->recycle(id);
+        }
+        _reader.mark_read(res);
+
+        if (_read_requested) {
+            _read_requested = false;
+            on_data_read();
+        } else {
+            // the reading is delayed, stop receiving until the next do_read(),
+            // so that the flow control of tcp takes effect
+            _data_pending = true;
+            if (_recv_armed && !_recv_cancelling) {
+                cancel_recv();
+            }
+        }
+        return;
+    }
+
+    if (res == -ENOBUFS || res == -ECANCELED) {
+        // the multishot recv is terminated because the provided buffers are used up,
+        // or it's cancelled: re-arm it if the upper layer is still waiting
+        if (_read_requested && !_recv_armed) {
+            arm_recv();
+        }
+        return;
+    }
+
+    if (res == 0) {
+        ddebug("io_uring read from %s failed: end of file", _remote_addr.to_string());
+    } else {
+        derror("io_uring read from %s failed: %s", _remote_addr.to_string(), strerror(-res));
+    }
+    on_failure();
+}
+
+void io_uring_rpc_session::on_data_read()
+{
+    int read_next = -1;
+
+    if (!_parser) {
+        read_next = prepare_parser();
+    }
+
+    if (_parser) {
+        message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+
+        while (msg != nullptr) {
+            this->on_message_read(msg);
+            msg = _parser->get_message_on_receive(&_reader, read_next);
+        }
+    }
+
+    if (read_next == -1) {
+        derror("io_uring read from %s failed", _remote_addr.to_string());
+        on_failure();
+    } else {
+        start_read_next(read_next);
+    }
+}
+
+void io_uring_rpc_session::send(uint64_t signature)
+{
+    auto op = new send_operation(this, signature);
+    io_uring_loop *loop = _loop;
+    loop->dispatch([loop, op]() { loop->submit(op); });
+}
+
+void io_uring_rpc_session::close()
+{
+    // the in-flight operations fail after shutdown, the socket is closed
+    // when all of them are completed, i.e. when the session is destroyed
+    int fd = _socket_fd.load();
+    if (fd >= 0 && ::shutdown(fd, SHUT_RDWR) < 0 && errno != ENOTCONN)
+        dwarn("io_uring socket shutdown failed, error = %s", strerror(errno));
+}
+
+void io_uring_rpc_session::connect()
+{
+    if (set_connecting()) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            derror("client session connect to %s failed, error = %s",
+                   _remote_addr.to_string(),
+                   strerror(errno));
+            on_failure(true);
+            return;
+        }
+        _socket_fd.store(fd);
+
+        auto op = new connect_operation(this);
+        io_uring_loop *loop = _loop;
+        loop->dispatch([loop, op]() { loop->submit(op); });
+    }
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
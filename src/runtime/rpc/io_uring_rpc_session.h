@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include "io_uring_net_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/message_parser.h>
+
+namespace dsn {
+namespace tools {
+
+// A TCP session implementation based on io_uring.
+// All the socket operations of a session are issued in the thread of its loop.
+// Thread-safe
+class io_uring_rpc_session : public rpc_session
+{
+public:
+    io_uring_rpc_session(io_uring_network_provider &net,
+                         ::dsn::rpc_address remote_addr,
+                         io_uring_loop *loop,
+                         int socket_fd,
+                         message_parser_ptr &parser,
+                         bool is_client);
+
+    ~io_uring_rpc_session() override;
+
+    void send(uint64_t signature) override;
+
+    void close() override;
+
+    void connect() override;
+
+private:
+    class recv_operation;
+    class send_operation;
+    class connect_operation;
+    friend class recv_operation;
+    friend class send_operation;
+    friend class connect_operation;
+
+    void do_read(int read_next) override;
+    void set_options();
+    void on_message_read(message_ex *msg)
+    {
+        if (!on_recv_message(msg, 0)) {
+            on_failure(false);
+        }
+    }
+
+    // the following are called in the loop thread
+    void start_recv(int read_next);
+    void arm_recv();
+    void cancel_recv();
+    void on_recv_completed(io_uring_cqe *cqe);
+    void on_data_read();
+
+private:
+    io_uring_loop *_loop;
+    std::atomic_int _socket_fd;
+    std::unique_ptr<recv_operation> _recv_op;
+
+    // accessed in the loop thread only [
+    // whether the recv operation is in flight
+    bool _recv_armed;
+    // whether a cancellation of the multishot recv is in flight
+    bool _recv_cancelling;
+    // whether the upper layer is waiting for data, it's false when the reading is delayed
+    bool _read_requested;
+    // whether there is data received when _read_requested is false
+    bool _data_pending;
+    int _read_next;
+    // ]
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
@@ -34,6 +34,7 @@
  */
 
 #include "message_parser_manager.h"
+#include "read_buffer_pool.h"
 #include <dsn/service_api_c.h>
 
 namespace dsn {
@@ -147,7 +148,9 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
         // TODO(wutao1): make it a buffer queue like what sofa-pbrpc does
         //               (https://github.com/baidu/sofa-pbrpc/blob/master/src/sofa/pbrpc/buffer.h)
         //               to reduce memory copy.
-        _buffer.assign(dsn::utils::make_shared_array<char>(sz), 0, sz);
+        unsigned int capacity;
+        std::shared_ptr<char> buf = read_buffer_pool::allocate(sz, capacity);
+        _buffer.assign(std::move(buf), 0, capacity);
         _buffer_occupied = 0;
 
         // copy
@@ -25,14 +25,43 @@
  */
 
 #include "message_parser_manager.h"
+#include "rpc_size_stats.h"
 #include "runtime/rpc/rpc_engine.h"
 
 #include <dsn/tool-api/network.h>
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
+#include <algorithm>
 
 namespace dsn {
+DSN_DEFINE_uint32("network",
+                  client_sessions_per_server,
+                  1,
+                  "how many client sessions are connected to each server, the requests are routed "
+                  "to them by rpc_call_connection_slot or the task priority");
+
+DSN_DEFINE_uint32("network",
+                  send_lane_weight_low,
+                  1,
+                  "how many messages of TASK_PRIORITY_LOW are sent in each round of a session, "
+                  "when the messages of the other priorities are waiting too");
+DSN_DEFINE_uint32("network",
+                  send_lane_weight_common,
+                  4,
+                  "how many messages of TASK_PRIORITY_COMMON are sent in each round of a session, "
+                  "when the messages of the other priorities are waiting too");
+DSN_DEFINE_uint32("network",
+                  send_lane_weight_high,
+                  16,
+                  "how many messages of TASK_PRIORITY_HIGH are sent in each round of a session, "
+                  "when the messages of the other priorities are waiting too");
+DSN_DEFINE_uint64("network",
+                  send_batch_max_bytes,
+                  0,
+                  "stop adding messages into a send batch of a session once it's larger than "
+                  "this, so the urgent messages don't wait behind too much data, 0 means no limit");
+
 /*static*/ join_point<void, rpc_session *>
     rpc_session::on_rpc_session_connected("rpc.session.connected");
 /*static*/ join_point<void, rpc_session *>
@@ -44,6 +73,8 @@ namespace dsn {
 
 rpc_session::~rpc_session()
 {
+    rpc_size_stats::instance().unregister_session(_size_stats.get());
+
     clear_pending_messages();
     clear_send_queue(false);
 
@@ -135,14 +166,18 @@ void rpc_session::clear_send_queue(bool resend_msgs)
         msg->release_ref();
     }
 
+    int lane = TASK_PRIORITY_COUNT - 1;
     while (true) {
         dlink *msg;
         {
             utils::auto_lock<utils::ex_lock_nr> l(_lock);
-            msg = _messages.next();
-            if (msg == &_messages)
+            while (lane >= 0 && _messages[lane].is_alone()) {
+                lane--;
+            }
+            if (lane < 0)
                 break;
 
+            msg = _messages[lane].next();
             msg->remove();
             --_message_count;
         }
@@ -165,10 +200,23 @@ void rpc_session::clear_send_queue(bool resend_msgs)
     }
 }
 
+/*static*/ int rpc_session::get_send_lane(message_ex *msg)
+{
+    if (msg->local_rpc_code == TASK_CODE_INVALID) {
+        return TASK_PRIORITY_COMMON;
+    }
+    task_spec *sp = task_spec::get(msg->local_rpc_code);
+    if (sp == nullptr || sp->priority < 0 || sp->priority >= TASK_PRIORITY_COUNT) {
+        return TASK_PRIORITY_COMMON;
+    }
+    return sp->priority;
+}
+
 inline bool rpc_session::unlink_message_for_send()
 {
-    auto n = _messages.next();
     int bcount = 0;
+    uint64_t bytes = 0;
+    bool full = false;
 
     dbg_dassert(0 == _sending_buffers.size(),
                 "sending_buffers should be empty, but size = %d",
@@ -177,23 +225,48 @@ inline bool rpc_session::unlink_message_for_send()
                 "sending_msgs should be empty, but size = %d",
                 (int)_sending_msgs.size());
 
-    while (n != &_messages) {
-        auto lmsg = CONTAINING_RECORD(n, message_ex, dl);
-        auto lcount = _parser->get_buffer_count_on_send(lmsg);
-        if (bcount > 0 && bcount + lcount > _max_buffer_block_count_per_send) {
+    const uint32_t weights[TASK_PRIORITY_COUNT] = {
+        FLAGS_send_lane_weight_low, FLAGS_send_lane_weight_common, FLAGS_send_lane_weight_high};
+
+    // weighted round robin of the lanes, from the highest priority, so the urgent messages
+    // are sent first and the others are not starved
+    while (!full) {
+        bool taken = false;
+        for (int lane = TASK_PRIORITY_COUNT - 1; lane >= 0 && !full; lane--) {
+            uint32_t quota = std::max(weights[lane], 1u);
+            for (uint32_t i = 0; i < quota; i++) {
+                auto n = _messages[lane].next();
+                if (n == &_messages[lane]) {
+                    break;
+                }
+
+                auto lmsg = CONTAINING_RECORD(n, message_ex, dl);
+                auto lcount = _parser->get_buffer_count_on_send(lmsg);
+                if (bcount > 0 && (bcount + lcount > _max_buffer_block_count_per_send ||
+                                   (FLAGS_send_batch_max_bytes > 0 &&
+                                    bytes >= FLAGS_send_batch_max_bytes))) {
+                    full = true;
+                    break;
+                }
+
+                _sending_buffers.resize(bcount + lcount);
+                auto rcount = _parser->get_buffers_on_send(lmsg, &_sending_buffers[bcount]);
+                dassert(lcount >= rcount, "%d VS %d", lcount, rcount);
+                if (lcount != rcount)
+                    _sending_buffers.resize(bcount + rcount);
+                for (int j = bcount; j < bcount + rcount; j++) {
+                    bytes += _sending_buffers[j].sz;
+                }
+                bcount += rcount;
+                _sending_msgs.push_back(lmsg);
+
+                lmsg->dl.remove();
+                taken = true;
+            }
+        }
+        if (!taken) {
             break;
         }
-
-        _sending_buffers.resize(bcount + lcount);
-        auto rcount = _parser->get_buffers_on_send(lmsg, &_sending_buffers[bcount]);
-        dassert(lcount >= rcount, "%d VS %d", lcount, rcount);
-        if (lcount != rcount)
-            _sending_buffers.resize(bcount + rcount);
-        bcount += rcount;
-        _sending_msgs.push_back(lmsg);
-
-        n = n->next();
-        lmsg->dl.remove();
     }
 
     // added in send_message
@@ -266,7 +339,7 @@ void rpc_session::send_message(message_ex *msg)
     uint64_t sig;
     {
         utils::auto_lock<utils::ex_lock_nr> l(_lock);
-        msg->dl.insert_before(&_messages);
+        msg->dl.insert_before(&_messages[get_send_lane(msg)]);
         ++_message_count;
 
         if ((SS_CONNECTED == _connect_state) && !_is_sending_next) {
@@ -318,6 +391,7 @@ void rpc_session::on_send_completed(uint64_t signature)
             }
 
             for (auto &msg : _sending_msgs) {
+                rpc_size_stats::instance().on_message(*_size_stats, msg, true);
                 // added in rpc_engine::reply (for server) or rpc_session::send_message (for client)
                 msg->release_ref();
                 _message_sent++;
@@ -355,7 +429,8 @@ rpc_session::rpc_session(connection_oriented_network &net,
 
       _is_client(is_client),
       _matcher(_net.engine()->matcher()),
-      _delay_server_receive_ms(0)
+      _delay_server_receive_ms(0),
+      _size_stats(rpc_size_stats::instance().register_session(remote_addr, is_client))
 {
     if (!is_client) {
         on_rpc_session_connected.execute(this);
@@ -398,6 +473,7 @@ bool rpc_session::on_recv_message(message_ex *msg, int delay_ms)
         msg->header->from_address = _remote_addr;
     msg->to_address = _net.address();
     msg->io_session = this;
+    rpc_size_stats::instance().on_message(*_size_stats, msg, false);
 
     // ignore msg if join point return false
     if (dsn_unlikely(!on_rpc_recv_message.execute(msg, true))) {
@@ -498,6 +574,10 @@ bool rpc_session::is_negotiation_succeed() const
 void rpc_session::set_client_username(const std::string &user_name)
 {
     _client_username = user_name;
+    // the decisions were made for the old user
+    for (auto &decision : _acl_decisions) {
+        decision.store(0, std::memory_order_relaxed);
+    }
 }
 
 const std::string &rpc_session::get_client_username() const { return _client_username; }
@@ -590,6 +670,39 @@ connection_oriented_network::connection_oriented_network(rpc_engine *srv, networ
     : network(srv, inner_provider)
 {
     _cfg_conn_threshold_per_ip = 0;
+    _cfg_client_sessions_per_server = std::max(1u, FLAGS_client_sessions_per_server);
+}
+
+uint32_t connection_oriented_network::get_client_session_slot(message_ex *request) const
+{
+    uint32_t n = _cfg_client_sessions_per_server;
+    if (n == 1) {
+        return 0;
+    }
+
+    // the replies go back with the session they are received from
+    const task_spec *sp = task_spec::get(request->local_rpc_code);
+    if (sp == nullptr) {
+        return 0;
+    }
+    if (sp->rpc_call_connection_slot >= 0) {
+        return (uint32_t)sp->rpc_call_connection_slot % n;
+    }
+
+    // the bulk traffic of low priority takes the last session, the high priority requests take
+    // the first one, and the others are spread over the rest by the thread hash so that the
+    // requests of the same partition keep their order
+    switch (sp->priority) {
+    case TASK_PRIORITY_LOW:
+        return n - 1;
+    case TASK_PRIORITY_HIGH:
+        return 0;
+    default:
+        if (n <= 2) {
+            return 0;
+        }
+        return 1 + (uint32_t)request->header->client.thread_hash % (n - 2);
+    }
 }
 
 void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_send)
@@ -601,10 +714,11 @@ void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_s
         //   normal (not forwarding) reply message from server to client, in which case
         //   the io_session has also been set.
         dassert(is_send, "received message should always has io_session set");
+        uint32_t slot = get_client_session_slot(msg);
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(msg->to_address);
         if (it != _clients.end()) {
-            s = it->second;
+            s = it->second[slot];
         }
     }
 
@@ -614,16 +728,28 @@ void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_s
 }
 
 void connection_oriented_network::send_message(message_ex *request)
+{
+    // rpc call
+    get_or_create_client_session(request)->send_message(request);
+}
+
+void connection_oriented_network::prepare_session(message_ex *request)
+{
+    get_or_create_client_session(request);
+}
+
+rpc_session_ptr connection_oriented_network::get_or_create_client_session(message_ex *request)
 {
     rpc_session_ptr client = nullptr;
     auto &to = request->to_address;
+    uint32_t slot = get_client_session_slot(request);
 
     // TODO: thread-local client ptr cache
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(to);
         if (it != _clients.end()) {
-            client = it->second;
+            client = it->second[slot];
         }
     }
 
@@ -631,12 +757,15 @@ void connection_oriented_network::send_message(message_ex *request)
     bool new_client = false;
     if (nullptr == client.get()) {
         utils::auto_write_lock l(_clients_lock);
-        auto it = _clients.find(to);
-        if (it != _clients.end()) {
-            client = it->second;
+        auto &sessions = _clients[to];
+        if (sessions.empty()) {
+            sessions.resize(_cfg_client_sessions_per_server);
+        }
+        if (sessions[slot] != nullptr) {
+            client = sessions[slot];
         } else {
             client = create_client_session(to);
-            _clients.insert(client_sessions::value_type(to, client));
+            sessions[slot] = client;
             new_client = true;
         }
         scount = (int)_clients.size();
@@ -644,14 +773,13 @@ void connection_oriented_network::send_message(message_ex *request)
 
     // init connection if necessary
     if (new_client) {
-        ddebug("client session created, remote_server = %s, current_count = %d",
+        ddebug("client session created, remote_server = %s, slot = %u, current_count = %d",
                client->remote_address().to_string(),
+               slot,
                scount);
         client->connect();
     }
-
-    // rpc call
-    client->send_message(request);
+    return client;
 }
 
 rpc_session_ptr connection_oriented_network::get_server_session(::dsn::rpc_address ep)
@@ -775,8 +903,10 @@ void connection_oriented_network::on_client_session_connected(rpc_session_ptr &s
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
-            r = true;
+        if (it != _clients.end()) {
+            r = std::any_of(it->second.begin(),
+                            it->second.end(),
+                            [&s](const rpc_session_ptr &p) { return p.get() == s.get(); });
         }
         scount = (int)_clients.size();
     }
@@ -795,9 +925,20 @@ void connection_oriented_network::on_client_session_disconnected(rpc_session_ptr
     {
         utils::auto_write_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
-            _clients.erase(it);
-            r = true;
+        if (it != _clients.end()) {
+            auto &sessions = it->second;
+            auto it2 = std::find_if(sessions.begin(),
+                                    sessions.end(),
+                                    [&s](const rpc_session_ptr &p) { return p.get() == s.get(); });
+            if (it2 != sessions.end()) {
+                *it2 = nullptr;
+                r = true;
+                if (std::all_of(sessions.begin(), sessions.end(), [](const rpc_session_ptr &p) {
+                        return p == nullptr;
+                    })) {
+                    _clients.erase(it);
+                }
+            }
         }
         scount = (int)_clients.size();
     }
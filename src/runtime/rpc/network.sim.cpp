@@ -39,6 +39,7 @@
 #include <dsn/utility/rand.h>
 #include <dsn/tool/node_scoper.h>
 #include "network.sim.h"
+#include "dsn_message_parser.h"
 
 namespace dsn {
 namespace tools {
@@ -74,6 +75,11 @@ static message_ex *virtual_send_message(message_ex *msg)
     }
 
     blob bb(buffer, 0, msg->header->body_length + sizeof(message_header));
+    // the message bypasses the parser on receiving, so decompress the body here
+    if (msg->header->context.u.compression_type != 0) {
+        bool ok = dsn_message_parser::decompress_body(bb);
+        dassert(ok, "decompress message %s failed", msg->header->rpc_name);
+    }
     message_ex *recv_msg = message_ex::create_receive_message(bb);
     recv_msg->to_address = msg->to_address;
 
@@ -0,0 +1,439 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifdef DSN_ENABLE_RDMA
+
+#include "rdma_channel.h"
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdlib.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_string("network",
+                  rdma_device_name,
+                  "",
+                  "the rdma device to create the queue pairs on, the first one if it's empty");
+DSN_DEFINE_uint32("network", rdma_port_num, 1, "the port of the rdma device to use");
+DSN_DEFINE_int32("network",
+                 rdma_gid_index,
+                 0,
+                 "the gid index of the rdma port, which selects the RoCE version and the ip "
+                 "of the path, see show_gids");
+
+namespace {
+const uint64_t CREDIT_WR_ID = UINT64_MAX;
+
+// the device context and the protection domain are shared by all the channels
+struct rdma_device
+{
+    ibv_context *context{nullptr};
+    ibv_pd *pd{nullptr};
+    ibv_port_attr port_attr;
+    ibv_gid gid;
+};
+
+rdma_device *open_rdma_device()
+{
+    int count = 0;
+    ibv_device **devices = ibv_get_device_list(&count);
+    if (devices == nullptr) {
+        dwarn("get rdma device list failed, error = %s", strerror(errno));
+        return nullptr;
+    }
+
+    ibv_device *device = nullptr;
+    for (int i = 0; i < count; i++) {
+        if (strlen(FLAGS_rdma_device_name) == 0 ||
+            strcmp(ibv_get_device_name(devices[i]), FLAGS_rdma_device_name) == 0) {
+            device = devices[i];
+            break;
+        }
+    }
+
+    std::unique_ptr<rdma_device> dev(new rdma_device());
+    if (device == nullptr) {
+        dwarn("rdma device \"%s\" is not found", FLAGS_rdma_device_name);
+    } else if ((dev->context = ibv_open_device(device)) == nullptr) {
+        dwarn("open rdma device %s failed", ibv_get_device_name(device));
+    }
+    ibv_free_device_list(devices);
+    if (dev->context == nullptr) {
+        return nullptr;
+    }
+
+    if (ibv_query_port(dev->context, FLAGS_rdma_port_num, &dev->port_attr) != 0 ||
+        dev->port_attr.state != IBV_PORT_ACTIVE ||
+        ibv_query_gid(dev->context, FLAGS_rdma_port_num, FLAGS_rdma_gid_index, &dev->gid) != 0 ||
+        (dev->pd = ibv_alloc_pd(dev->context)) == nullptr) {
+        dwarn("rdma port %u of %s is unavailable",
+              FLAGS_rdma_port_num,
+              ibv_get_device_name(dev->context->device));
+        ibv_close_device(dev->context);
+        return nullptr;
+    }
+
+    ddebug("rdma device %s is opened, port = %u, lid = %u",
+           ibv_get_device_name(dev->context->device),
+           FLAGS_rdma_port_num,
+           dev->port_attr.lid);
+    return dev.release();
+}
+
+// opened on the first use, and kept until the process exits
+rdma_device *get_rdma_device()
+{
+    static std::once_flag once;
+    static rdma_device *device = nullptr;
+    std::call_once(once, []() { device = open_rdma_device(); });
+    return device;
+}
+} // anonymous namespace
+
+/*static*/ bool rdma_channel::device_available() { return get_rdma_device() != nullptr; }
+
+/*static*/ std::unique_ptr<rdma_channel> rdma_channel::create(uint32_t slot_size,
+                                                              uint32_t slot_count)
+{
+    std::unique_ptr<rdma_channel> channel(new rdma_channel());
+    if (!channel->init(slot_size, slot_count)) {
+        return nullptr;
+    }
+    return channel;
+}
+
+bool rdma_channel::init(uint32_t slot_size, uint32_t slot_count)
+{
+    rdma_device *dev = get_rdma_device();
+    if (dev == nullptr) {
+        return false;
+    }
+
+    memset(&_local, 0, sizeof(_local));
+    _local.slot_size = slot_size;
+    _local.slot_count = slot_count;
+    // the credit-only sends may be in flight along with the data sends
+    _max_send_wr = slot_count * 2;
+
+    size_t region_size = size_t(slot_size) * slot_count;
+    void *send_buf = nullptr;
+    void *recv_buf = nullptr;
+    if (posix_memalign(&send_buf, 4096, region_size) != 0) {
+        return false;
+    }
+    _send_buf = static_cast<char *>(send_buf);
+    if (posix_memalign(&recv_buf, 4096, region_size) != 0) {
+        return false;
+    }
+    _recv_buf = static_cast<char *>(recv_buf);
+
+    _send_mr = ibv_reg_mr(dev->pd, _send_buf, region_size, IBV_ACCESS_LOCAL_WRITE);
+    _recv_mr = ibv_reg_mr(dev->pd, _recv_buf, region_size, IBV_ACCESS_LOCAL_WRITE);
+    _comp_channel = ibv_create_comp_channel(dev->context);
+    if (_send_mr == nullptr || _recv_mr == nullptr || _comp_channel == nullptr) {
+        derror("create rdma channel failed, error = %s", strerror(errno));
+        return false;
+    }
+    int flags = fcntl(_comp_channel->fd, F_GETFL);
+    fcntl(_comp_channel->fd, F_SETFL, flags | O_NONBLOCK);
+
+    _send_cq = ibv_create_cq(dev->context, _max_send_wr, nullptr, _comp_channel, 0);
+    _recv_cq = ibv_create_cq(dev->context, slot_count, nullptr, _comp_channel, 0);
+    if (_send_cq == nullptr || _recv_cq == nullptr || ibv_req_notify_cq(_send_cq, 0) != 0 ||
+        ibv_req_notify_cq(_recv_cq, 0) != 0) {
+        derror("create rdma completion queue failed, error = %s", strerror(errno));
+        return false;
+    }
+
+    ibv_qp_init_attr qp_attr;
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.send_cq = _send_cq;
+    qp_attr.recv_cq = _recv_cq;
+    qp_attr.qp_type = IBV_QPT_RC;
+    qp_attr.sq_sig_all = 1;
+    qp_attr.cap.max_send_wr = _max_send_wr;
+    qp_attr.cap.max_recv_wr = slot_count;
+    qp_attr.cap.max_send_sge = 1;
+    qp_attr.cap.max_recv_sge = 1;
+    _qp = ibv_create_qp(dev->pd, &qp_attr);
+    if (_qp == nullptr) {
+        derror("create rdma queue pair failed, error = %s", strerror(errno));
+        return false;
+    }
+
+    // the receives can be posted since INIT
+    ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_INIT;
+    attr.pkey_index = 0;
+    attr.port_num = FLAGS_rdma_port_num;
+    attr.qp_access_flags = 0;
+    if (ibv_modify_qp(
+            _qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) !=
+        0) {
+        derror("modify rdma queue pair to INIT failed, error = %s", strerror(errno));
+        return false;
+    }
+    for (uint32_t i = 0; i < slot_count; i++) {
+        if (!post_recv(i)) {
+            return false;
+        }
+    }
+
+    _free_send_slots.reserve(slot_count);
+    for (uint32_t i = slot_count; i > 0; i--) {
+        _free_send_slots.push_back(i - 1);
+    }
+
+    _local.qp_num = _qp->qp_num;
+    _local.psn = rand::next_u32(0, 0xffffff);
+    _local.lid = dev->port_attr.lid;
+    memcpy(_local.gid, dev->gid.raw, sizeof(_local.gid));
+    return true;
+}
+
+rdma_channel::~rdma_channel()
+{
+    if (_qp != nullptr) {
+        ibv_destroy_qp(_qp);
+    }
+    if (_send_cq != nullptr) {
+        ibv_destroy_cq(_send_cq);
+    }
+    if (_recv_cq != nullptr) {
+        ibv_destroy_cq(_recv_cq);
+    }
+    if (_comp_channel != nullptr) {
+        ibv_destroy_comp_channel(_comp_channel);
+    }
+    if (_send_mr != nullptr) {
+        ibv_dereg_mr(_send_mr);
+    }
+    if (_recv_mr != nullptr) {
+        ibv_dereg_mr(_recv_mr);
+    }
+    free(_send_buf);
+    free(_recv_buf);
+}
+
+bool rdma_channel::connect(const rdma_endpoint &remote)
+{
+    rdma_device *dev = get_rdma_device();
+
+    ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTR;
+    attr.path_mtu = dev->port_attr.active_mtu;
+    attr.dest_qp_num = remote.qp_num;
+    attr.rq_psn = remote.psn;
+    attr.max_dest_rd_atomic = 1;
+    attr.min_rnr_timer = 12;
+    attr.ah_attr.dlid = remote.lid;
+    attr.ah_attr.sl = 0;
+    attr.ah_attr.src_path_bits = 0;
+    attr.ah_attr.port_num = FLAGS_rdma_port_num;
+    // RoCE is routed by the gid, while infiniband may be routed by the lid only
+    static const uint8_t zero_gid[16] = {0};
+    if (memcmp(remote.gid, zero_gid, sizeof(zero_gid)) != 0) {
+        attr.ah_attr.is_global = 1;
+        memcpy(attr.ah_attr.grh.dgid.raw, remote.gid, sizeof(remote.gid));
+        attr.ah_attr.grh.sgid_index = FLAGS_rdma_gid_index;
+        attr.ah_attr.grh.hop_limit = 1;
+    }
+    if (ibv_modify_qp(_qp,
+                      &attr,
+                      IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
+                          IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+        derror("modify rdma queue pair to RTR failed, error = %s", strerror(errno));
+        return false;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTS;
+    attr.timeout = 14;
+    attr.retry_cnt = 7;
+    // retry infinitely if the receiver is out of slots, though the credits prevent that
+    attr.rnr_retry = 7;
+    attr.sq_psn = _local.psn;
+    attr.max_rd_atomic = 1;
+    if (ibv_modify_qp(_qp,
+                      &attr,
+                      IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY |
+                          IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+        derror("modify rdma queue pair to RTS failed, error = %s", strerror(errno));
+        return false;
+    }
+
+    _peer_slot_size = std::min(_local.slot_size, remote.slot_size);
+    _credits = remote.slot_count;
+    return true;
+}
+
+bool rdma_channel::take_events()
+{
+    ibv_cq *cq = nullptr;
+    void *context = nullptr;
+    while (ibv_get_cq_event(_comp_channel, &cq, &context) == 0) {
+        ibv_ack_cq_events(cq, 1);
+    }
+    if (ibv_req_notify_cq(_send_cq, 0) != 0 || ibv_req_notify_cq(_recv_cq, 0) != 0) {
+        derror("request rdma completion notification failed, error = %s", strerror(errno));
+        _failed = true;
+    }
+    return !_failed;
+}
+
+bool rdma_channel::post_recv(uint32_t slot)
+{
+    ibv_sge sge;
+    sge.addr = reinterpret_cast<uint64_t>(recv_slot(slot));
+    sge.length = _local.slot_size;
+    sge.lkey = _recv_mr->lkey;
+
+    ibv_recv_wr wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = slot;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+
+    ibv_recv_wr *bad_wr = nullptr;
+    if (ibv_post_recv(_qp, &wr, &bad_wr) != 0) {
+        derror("post rdma receive failed, error = %s", strerror(errno));
+        _failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool rdma_channel::post_send(uint64_t wr_id, char *data, uint32_t length)
+{
+    ibv_sge sge;
+    sge.addr = reinterpret_cast<uint64_t>(data);
+    sge.length = length;
+    sge.lkey = _send_mr->lkey;
+
+    ibv_send_wr wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = wr_id;
+    wr.sg_list = &sge;
+    wr.num_sge = length > 0 ? 1 : 0;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(_unreturned_credits);
+
+    ibv_send_wr *bad_wr = nullptr;
+    if (ibv_post_send(_qp, &wr, &bad_wr) != 0) {
+        derror("post rdma send failed, error = %s", strerror(errno));
+        _failed = true;
+        return false;
+    }
+    _credits--;
+    _unreturned_credits = 0;
+    _outstanding_sends++;
+    return true;
+}
+
+size_t rdma_channel::write(const char *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length && !_failed && _credits >= 2 && !_free_send_slots.empty() &&
+           _outstanding_sends < _max_send_wr) {
+        uint32_t slot = _free_send_slots.back();
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(length - written, _peer_slot_size));
+        memcpy(send_slot(slot), data + written, n);
+        if (!post_send(slot, send_slot(slot), n)) {
+            break;
+        }
+        _free_send_slots.pop_back();
+        written += n;
+    }
+    return written;
+}
+
+bool rdma_channel::return_credits()
+{
+    uint32_t threshold = std::max(1u, _local.slot_count / 4);
+    if (_failed || _unreturned_credits < threshold || _credits < 1 ||
+        _outstanding_sends >= _max_send_wr) {
+        return !_failed;
+    }
+    return post_send(CREDIT_WR_ID, nullptr, 0);
+}
+
+bool rdma_channel::poll_send()
+{
+    ibv_wc wcs[16];
+    int n;
+    while (!_failed && (n = ibv_poll_cq(_send_cq, 16, wcs)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (wcs[i].status != IBV_WC_SUCCESS) {
+                derror("rdma send failed, status = %s", ibv_wc_status_str(wcs[i].status));
+                _failed = true;
+                break;
+            }
+            _outstanding_sends--;
+            if (wcs[i].wr_id != CREDIT_WR_ID) {
+                _free_send_slots.push_back(static_cast<uint32_t>(wcs[i].wr_id));
+            }
+        }
+    }
+    if (n < 0) {
+        _failed = true;
+    }
+    return !_failed;
+}
+
+bool rdma_channel::poll_recv(const std::function<void(const char *, size_t)> &on_data)
+{
+    ibv_wc wcs[16];
+    int n;
+    while (!_failed && (n = ibv_poll_cq(_recv_cq, 16, wcs)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (wcs[i].status != IBV_WC_SUCCESS) {
+                derror("rdma receive failed, status = %s", ibv_wc_status_str(wcs[i].status));
+                _failed = true;
+                break;
+            }
+            if (wcs[i].wc_flags & IBV_WC_WITH_IMM) {
+                _credits += ntohl(wcs[i].imm_data);
+            }
+            uint32_t slot = static_cast<uint32_t>(wcs[i].wr_id);
+            if (wcs[i].byte_len > 0) {
+                on_data(recv_slot(slot), wcs[i].byte_len);
+            }
+            if (!post_recv(slot)) {
+                break;
+            }
+            _unreturned_credits++;
+        }
+    }
+    if (n < 0) {
+        _failed = true;
+    }
+    return !_failed;
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
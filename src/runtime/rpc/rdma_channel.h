@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#ifdef DSN_ENABLE_RDMA
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <infiniband/verbs.h>
+
+namespace dsn {
+namespace tools {
+
+// The attributes of an rc queue pair, which are exchanged by the peers before connecting.
+struct rdma_endpoint
+{
+    uint32_t qp_num;
+    uint32_t psn;
+    uint16_t lid;
+    uint8_t gid[16];
+    uint32_t slot_size;
+    uint32_t slot_count;
+};
+
+// A reliable-connected queue pair that carries a byte stream in both directions.
+//
+// The bytes are copied into the slots of a registered send region and posted as SEND
+// work requests, each of which lands in one of the slots that the peer has posted to its
+// receive queue. RC keeps them in order, so the receiver just appends the slots to its
+// stream.
+//
+// A sender can have at most as many SENDs in flight as the receive slots of the peer,
+// which are counted as credits. The receiver returns the credits of the reposted slots
+// in the immediate data of its own SENDs, or in an empty SEND once enough of them are
+// pending. The last credit is preserved for that empty SEND, so the two sides never wait
+// for each other's credits.
+//
+// Not thread-safe, the owner should serialize the calls.
+class rdma_channel
+{
+public:
+    // Creates a queue pair on the configured device, with `slot_count` receive slots of
+    // `slot_size` bytes posted. Returns nullptr if rdma is unavailable.
+    static std::unique_ptr<rdma_channel> create(uint32_t slot_size, uint32_t slot_count);
+
+    // Whether there is an active rdma device to create channels on.
+    static bool device_available();
+
+    ~rdma_channel();
+
+    const rdma_endpoint &local_endpoint() const { return _local; }
+
+    // Connects the queue pair to the one of the peer, the peer may start sending then.
+    bool connect(const rdma_endpoint &remote);
+
+    // The fd of the completion channel, which is readable when any completion arrives.
+    int event_fd() const { return _comp_channel->fd; }
+
+    // Acknowledges the pending completion events, and requests the next ones.
+    // It should be called before polling the completions after event_fd() is readable.
+    bool take_events();
+
+    // Copies at most `length` bytes to the peer, returns the bytes accepted. Less bytes
+    // are accepted if the credits or the send slots are used up.
+    size_t write(const char *data, size_t length);
+
+    // Processes the completions of the sends, which frees their slots.
+    bool poll_send();
+
+    // Processes the received slots, each of which is passed to `on_data` and reposted.
+    bool poll_recv(const std::function<void(const char *, size_t)> &on_data);
+
+    // Returns the credits of the reposted slots to the peer with an empty SEND, if enough
+    // of them are pending.
+    bool return_credits();
+
+    // Whether a work request or a completion failed, the channel is unusable then.
+    bool failed() const { return _failed; }
+
+private:
+    rdma_channel() = default;
+    bool init(uint32_t slot_size, uint32_t slot_count);
+    bool post_recv(uint32_t slot);
+    bool post_send(uint64_t wr_id, char *data, uint32_t length);
+    char *send_slot(uint32_t slot) const { return _send_buf + size_t(slot) * _local.slot_size; }
+    char *recv_slot(uint32_t slot) const { return _recv_buf + size_t(slot) * _local.slot_size; }
+
+private:
+    ibv_comp_channel *_comp_channel{nullptr};
+    ibv_cq *_send_cq{nullptr};
+    ibv_cq *_recv_cq{nullptr};
+    ibv_qp *_qp{nullptr};
+    char *_send_buf{nullptr};
+    char *_recv_buf{nullptr};
+    ibv_mr *_send_mr{nullptr};
+    ibv_mr *_recv_mr{nullptr};
+
+    rdma_endpoint _local;
+    uint32_t _peer_slot_size{0};
+    uint32_t _max_send_wr{0};
+    uint32_t _outstanding_sends{0};
+    std::vector<uint32_t> _free_send_slots;
+    // the receive slots which the peer can still send to
+    uint32_t _credits{0};
+    // the reposted receive slots which are not told to the peer yet
+    uint32_t _unreturned_credits{0};
+    bool _failed{false};
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
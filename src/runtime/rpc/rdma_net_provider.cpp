@@ -0,0 +1,228 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifdef DSN_ENABLE_RDMA
+
+#include "rdma_net_provider.h"
+
+#include <dsn/utility/flags.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+#include "rdma_rpc_session.h"
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("network",
+                  rdma_port_offset,
+                  10000,
+                  "a server accepts the rdma handshakes on the tcp port of its rpc port plus "
+                  "this offset");
+DSN_DEFINE_string("network",
+                  rdma_server_ports,
+                  "",
+                  "the rpc ports of the servers to connect with rdma as a client, separated by "
+                  "comma, e.g. the port of the replica servers; all the servers are tried if "
+                  "it's empty");
+DSN_DEFINE_uint32("network",
+                  rdma_slot_size,
+                  64 * 1024,
+                  "the bytes of each registered send or receive slot of a rdma session");
+DSN_DEFINE_uint32("network",
+                  rdma_slot_count,
+                  64,
+                  "the count of the send slots, and the receive slots, of a rdma session");
+DSN_DEFINE_validator(rdma_slot_count, [](uint32_t count) -> bool { return count >= 2; });
+
+rdma_network_provider::rdma_network_provider(rpc_engine *srv, network *inner_provider)
+    : asio_network_provider(srv, inner_provider)
+{
+    std::vector<std::string> ports;
+    utils::split_args(FLAGS_rdma_server_ports, ports, ',');
+    for (const auto &port : ports) {
+        uint32_t p = 0;
+        if (buf2uint32(port, p) && p > 0 && p <= UINT16_MAX) {
+            _rdma_server_ports.insert(static_cast<uint16_t>(p));
+        } else {
+            dwarn("invalid port \"%s\" in [network] rdma_server_ports", port.c_str());
+        }
+    }
+}
+
+rdma_network_provider::~rdma_network_provider()
+{
+    if (_rdma_acceptor) {
+        boost::system::error_code ec;
+        _rdma_acceptor->close(ec);
+    }
+}
+
+error_code rdma_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    error_code err = asio_network_provider::start(channel, port, client_only);
+    if (err != ERR_OK || client_only || _rdma_acceptor != nullptr) {
+        return err;
+    }
+
+    uint32_t rdma_port = _address.port() + FLAGS_rdma_port_offset;
+    if (!rdma_channel::device_available() || rdma_port > UINT16_MAX) {
+        // the peers can still connect with tcp
+        dwarn("rdma is unavailable for the server on port %u", _address.port());
+        return ERR_OK;
+    }
+
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::any(),
+                                            static_cast<uint16_t>(rdma_port));
+    _rdma_acceptor.reset(new boost::asio::ip::tcp::acceptor(_io_service));
+    _rdma_acceptor->open(endpoint.protocol(), ec);
+    if (!ec) {
+        _rdma_acceptor->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+        _rdma_acceptor->bind(endpoint, ec);
+    }
+    if (!ec) {
+        _rdma_acceptor->listen(boost::asio::socket_base::max_connections, ec);
+    }
+    if (ec) {
+        dwarn("rdma acceptor listen on port %u failed, error = %s",
+              rdma_port,
+              ec.message().c_str());
+        _rdma_acceptor.reset();
+        return ERR_OK;
+    }
+
+    do_accept_rdma();
+    return ERR_OK;
+}
+
+bool rdma_network_provider::is_rdma_reachable(::dsn::rpc_address server_addr)
+{
+    if (server_addr.type() != HOST_TYPE_IPV4 ||
+        (!_rdma_server_ports.empty() && _rdma_server_ports.count(server_addr.port()) == 0) ||
+        !rdma_channel::device_available()) {
+        return false;
+    }
+
+    utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+    return _rdma_unavailable.count(server_addr) == 0;
+}
+
+void rdma_network_provider::mark_rdma_unavailable(::dsn::rpc_address server_addr)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+    if (_rdma_unavailable.insert(server_addr).second) {
+        dwarn("rdma is unavailable for %s, fall back to tcp", server_addr.to_string());
+    }
+}
+
+rpc_session_ptr rdma_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    if (!is_rdma_reachable(server_addr)) {
+        return asio_network_provider::create_client_session(server_addr);
+    }
+
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    return rpc_session_ptr(
+        new rdma_rpc_session(*this, server_addr, socket, nullptr, parser, true));
+}
+
+void rdma_network_provider::do_accept_rdma()
+{
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+
+    _rdma_acceptor->async_accept(*socket, [this, socket](boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (!ec) {
+            auto hs = std::make_shared<rdma_handshake>();
+            boost::asio::async_read(*socket,
+                                    boost::asio::buffer(hs.get(), sizeof(rdma_handshake)),
+                                    [this, socket, hs](boost::system::error_code ec, size_t) {
+                                        if (!ec) {
+                                            on_rdma_handshake(socket, hs);
+                                        }
+                                    });
+        }
+
+        do_accept_rdma();
+    });
+}
+
+void rdma_network_provider::on_rdma_handshake(
+    const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+    const std::shared_ptr<rdma_handshake> &hs)
+{
+    boost::system::error_code ec;
+    auto remote = socket->remote_endpoint(ec);
+    if (ec || hs->magic != RDMA_HANDSHAKE_MAGIC) {
+        derror("invalid rdma handshake, error = %s", ec ? ec.message().c_str() : "bad magic");
+        return;
+    }
+
+    // the queue pair should be ready to receive before the client knows it
+    auto channel = rdma_channel::create(FLAGS_rdma_slot_size, FLAGS_rdma_slot_count);
+    if (!channel || !channel->connect(hs->endpoint)) {
+        return;
+    }
+    auto reply = std::make_shared<rdma_handshake>();
+    reply->magic = RDMA_HANDSHAKE_MAGIC;
+    reply->endpoint = channel->local_endpoint();
+
+    ::dsn::rpc_address client_addr(remote.address().to_v4().to_ulong(), remote.port());
+    message_parser_ptr null_parser;
+    rpc_session_ptr s =
+        new rdma_rpc_session(*this, client_addr, socket, std::move(channel), null_parser, false);
+
+    // when server connection threshold is hit, close the session, otherwise accept it
+    if (check_if_conn_threshold_exceeded(s->remote_address())) {
+        dwarn("close rdma rpc connection from %s to %s due to hitting server "
+              "connection threshold per ip",
+              s->remote_address().to_string(),
+              address().to_string());
+        s->close();
+        return;
+    }
+
+    boost::asio::async_write(
+        *socket,
+        boost::asio::buffer(reply.get(), sizeof(rdma_handshake)),
+        [this, s, reply](boost::system::error_code ec, size_t) mutable {
+            if (ec) {
+                derror("rdma handshake reply to %s failed, error = %s",
+                       s->remote_address().to_string(),
+                       ec.message().c_str());
+                s->close();
+                return;
+            }
+
+            on_server_session_accepted(s);
+
+            auto rdma_session = static_cast<rdma_rpc_session *>(s.get());
+            rdma_session->on_established();
+            rdma_session->start_read_next();
+        });
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#ifdef DSN_ENABLE_RDMA
+
+#include <atomic>
+#include <string>
+#include <unordered_set>
+
+#include "asio_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+struct rdma_handshake;
+
+// A network provider which moves the bytes of the rpc sessions through rdma rc queue pairs,
+// intended for the traffic between the replica servers, e.g. prepare, group check and learn.
+//
+// A server also listens on `port + rdma_port_offset` with tcp, on which the clients exchange
+// the attributes of the queue pairs. That connection is kept open to tell the liveness of
+// the peer. The normal tcp port is served as asio_network_provider does, so the clients
+// which don't configure rdma are not affected.
+//
+// As a client, only the servers on [network] rdma_server_ports are connected with rdma, and
+// the others, or the ones whose rdma handshake failed, are connected with tcp.
+class rdma_network_provider : public asio_network_provider
+{
+public:
+    rdma_network_provider(rpc_engine *srv, network *inner_provider);
+
+    ~rdma_network_provider() override;
+
+    error_code start(rpc_channel channel, int port, bool client_only) override;
+    rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    // fall back to tcp for `server_addr` after a rdma session failed to connect to it
+    void mark_rdma_unavailable(::dsn::rpc_address server_addr);
+
+private:
+    bool is_rdma_reachable(::dsn::rpc_address server_addr);
+    void do_accept_rdma();
+    void on_rdma_handshake(const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                           const std::shared_ptr<rdma_handshake> &hs);
+
+private:
+    friend class rdma_rpc_session;
+
+    std::shared_ptr<boost::asio::ip::tcp::acceptor> _rdma_acceptor;
+    std::unordered_set<uint16_t> _rdma_server_ports;
+
+    ::dsn::utils::ex_lock_nr _rdma_lock; // [
+    std::unordered_set<::dsn::rpc_address> _rdma_unavailable;
+    // ]
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
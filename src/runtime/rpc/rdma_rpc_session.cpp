@@ -0,0 +1,402 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifdef DSN_ENABLE_RDMA
+
+#include "rdma_rpc_session.h"
+
+#include <dsn/utility/flags.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DECLARE_uint32(rdma_port_offset);
+DSN_DECLARE_uint32(rdma_slot_size);
+DSN_DECLARE_uint32(rdma_slot_count);
+
+rdma_rpc_session::rdma_rpc_session(rdma_network_provider &net,
+                                   ::dsn::rpc_address remote_addr,
+                                   const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                                   std::unique_ptr<rdma_channel> channel,
+                                   message_parser_ptr &parser,
+                                   bool is_client)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _rdma_net(net),
+      _socket(socket),
+      _channel(std::move(channel)),
+      _socket_byte(0),
+      _send_signature(0),
+      _send_index(0),
+      _send_offset(0),
+      _closed(false),
+      _read_waiting(false),
+      _read_next(0),
+      _send_waiting(false)
+{
+}
+
+rdma_rpc_session::~rdma_rpc_session() { release_send_msgs(); }
+
+void rdma_rpc_session::on_established()
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+    if (_closed) {
+        return;
+    }
+
+    int fd = ::dup(_channel->event_fd());
+    if (fd < 0) {
+        derror("dup the completion channel of rdma session %s failed, error = %s",
+               _remote_addr.to_string(),
+               strerror(errno));
+        return;
+    }
+    _event.reset(new boost::asio::posix::stream_descriptor(_rdma_net._io_service, fd));
+    wait_event();
+    watch_socket();
+}
+
+void rdma_rpc_session::wait_event()
+{
+    add_ref();
+    _event->async_read_some(boost::asio::null_buffers(),
+                            [this](boost::system::error_code ec, std::size_t length) {
+                                if (!ec) {
+                                    on_event();
+                                }
+                                release_ref();
+                            });
+}
+
+void rdma_rpc_session::watch_socket()
+{
+    // nothing is expected on the socket after the handshake, it's readable only when the
+    // peer is gone
+    add_ref();
+    _socket->async_read_some(boost::asio::buffer(&_socket_byte, 1),
+                             [this](boost::system::error_code ec, std::size_t length) {
+                                 if (ec != boost::asio::error::operation_aborted) {
+                                     ddebug("rdma session %s is closed by the peer: %s",
+                                            _remote_addr.to_string(),
+                                            ec ? ec.message().c_str() : "unexpected data");
+                                 }
+                                 on_failure();
+                                 release_ref();
+                             });
+}
+
+void rdma_rpc_session::on_event()
+{
+    bool resume_read = false;
+    bool send_done = false;
+    int read_next = 0;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+        if (_closed) {
+            return;
+        }
+        // the credits are returned along with the receives, so only the send slots
+        // may be freed here
+        if (_channel->take_events() && _channel->poll_send() && _send_waiting &&
+            write_pending()) {
+            _send_waiting = false;
+            send_done = true;
+        }
+        if (!_channel->failed()) {
+            std::swap(resume_read, _read_waiting);
+            read_next = _read_next;
+            wait_event();
+        }
+    }
+
+    // the references are taken over from the waiting sides
+    if (send_done) {
+        finish_send(true);
+    }
+    if (resume_read) {
+        try_read(read_next);
+    } else if (_channel->failed()) {
+        derror("rdma session %s failed", _remote_addr.to_string());
+        on_failure();
+    }
+}
+
+void rdma_rpc_session::do_read(int read_next)
+{
+    // don't process the messages in the stack of the previous ones
+    add_ref();
+    _rdma_net._io_service.post([this, read_next]() { try_read(read_next); });
+}
+
+// holds a reference of the session, which is released or passed to the waiting state
+void rdma_rpc_session::try_read(int read_next)
+{
+    bool received = false;
+    bool send_done = false;
+    bool failed = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+        if (_closed) {
+            release_ref();
+            return;
+        }
+
+        _channel->poll_recv([this, &received](const char *data, size_t length) {
+            memcpy(_reader.read_buffer_ptr(length), data, length);
+            _reader.mark_read(length);
+            received = true;
+        });
+        // the credits of the peer may be returned
+        if (_send_waiting && write_pending()) {
+            _send_waiting = false;
+            send_done = true;
+        }
+        _channel->return_credits();
+
+        failed = _channel->failed();
+        if (!failed && !received) {
+            _read_waiting = true;
+            _read_next = read_next;
+        }
+    }
+
+    if (send_done) {
+        finish_send(true);
+    }
+    if (failed) {
+        derror("rdma read from %s failed", _remote_addr.to_string());
+        on_failure();
+        release_ref();
+        return;
+    }
+    if (!received) {
+        return;
+    }
+
+    read_next = -1;
+    if (!_parser) {
+        read_next = prepare_parser();
+    }
+    if (_parser) {
+        message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+        while (msg != nullptr) {
+            if (!on_recv_message(msg, 0)) {
+                on_failure(false);
+            }
+            msg = _parser->get_message_on_receive(&_reader, read_next);
+        }
+    }
+
+    if (read_next == -1) {
+        derror("rdma read from %s failed", _remote_addr.to_string());
+        on_failure();
+    } else {
+        start_read_next(read_next);
+    }
+    release_ref();
+}
+
+void rdma_rpc_session::send(uint64_t signature)
+{
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        for (auto &msg : _sending_msgs) {
+            msg->add_ref();
+            _send_msgs.push_back(msg);
+        }
+    }
+    _send_signature = signature;
+    _send_bufs = _sending_buffers;
+    _send_index = 0;
+    _send_offset = 0;
+
+    add_ref();
+    bool done = false;
+    bool failed = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+        if (_closed) {
+            failed = true;
+        } else {
+            done = write_pending();
+            failed = _channel->failed();
+            if (!done && !failed) {
+                _send_waiting = true;
+                return;
+            }
+        }
+    }
+    finish_send(!failed);
+}
+
+bool rdma_rpc_session::write_pending()
+{
+    while (_send_index < _send_bufs.size()) {
+        auto &buf = _send_bufs[_send_index];
+        if (_send_offset == buf.sz) {
+            _send_index++;
+            _send_offset = 0;
+            continue;
+        }
+
+        size_t length = _channel->write(static_cast<const char *>(buf.buf) + _send_offset,
+                                        buf.sz - _send_offset);
+        if (length == 0) {
+            // waiting for the credits or the send slots
+            return false;
+        }
+        _send_offset += length;
+    }
+    return true;
+}
+
+// releases the reference held by send()
+void rdma_rpc_session::finish_send(bool succeed)
+{
+    release_send_msgs();
+    if (succeed) {
+        on_send_completed(_send_signature);
+    } else {
+        derror("rdma write to %s failed", _remote_addr.to_string());
+        on_failure(true);
+    }
+    release_ref();
+}
+
+void rdma_rpc_session::release_send_msgs()
+{
+    for (auto &msg : _send_msgs) {
+        msg->release_ref();
+    }
+    _send_msgs.clear();
+}
+
+void rdma_rpc_session::close()
+{
+    bool read_waiting = false;
+    bool send_waiting = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+        if (_closed) {
+            return;
+        }
+        _closed = true;
+        std::swap(read_waiting, _read_waiting);
+        std::swap(send_waiting, _send_waiting);
+
+        // the pending handlers are cancelled, and the peer sees the eof of the socket
+        boost::system::error_code ec;
+        _socket->shutdown(boost::asio::socket_base::shutdown_type::shutdown_both, ec);
+        _socket->close(ec);
+        if (ec)
+            dwarn("rdma socket close failed, error = %s", ec.message().c_str());
+        if (_event) {
+            _event->close(ec);
+        }
+    }
+
+    // the references held by the waiting sides
+    if (send_waiting) {
+        release_send_msgs();
+        release_ref();
+    }
+    if (read_waiting) {
+        release_ref();
+    }
+}
+
+void rdma_rpc_session::on_connect_failed()
+{
+    _rdma_net.mark_rdma_unavailable(_remote_addr);
+    on_failure(true);
+}
+
+void rdma_rpc_session::connect()
+{
+    if (!set_connecting()) {
+        return;
+    }
+
+    uint32_t port = _remote_addr.port() + FLAGS_rdma_port_offset;
+    _channel = rdma_channel::create(FLAGS_rdma_slot_size, FLAGS_rdma_slot_count);
+    if (!_channel || port > UINT16_MAX) {
+        on_connect_failed();
+        return;
+    }
+    _handshake.magic = RDMA_HANDSHAKE_MAGIC;
+    _handshake.endpoint = _channel->local_endpoint();
+
+    boost::asio::ip::tcp::endpoint ep(boost::asio::ip::address_v4(_remote_addr.ip()),
+                                      static_cast<uint16_t>(port));
+
+    add_ref();
+    utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+    _socket->async_connect(ep, [this](boost::system::error_code ec) {
+        if (ec) {
+            derror("rdma session connect to %s failed, error = %s",
+                   _remote_addr.to_string(),
+                   ec.message().c_str());
+            on_connect_failed();
+            release_ref();
+            return;
+        }
+
+        utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+        boost::asio::async_write(
+            *_socket,
+            boost::asio::buffer(&_handshake, sizeof(_handshake)),
+            [this](boost::system::error_code ec, std::size_t length) {
+                if (ec) {
+                    derror("rdma handshake to %s failed, error = %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                    on_connect_failed();
+                    release_ref();
+                    return;
+                }
+
+                // wait for the queue pair of the server
+                utils::auto_lock<utils::ex_lock_nr> l(_rdma_lock);
+                boost::asio::async_read(
+                    *_socket,
+                    boost::asio::buffer(&_handshake, sizeof(_handshake)),
+                    [this](boost::system::error_code ec, std::size_t length) {
+                        if (ec || _handshake.magic != RDMA_HANDSHAKE_MAGIC ||
+                            !_channel->connect(_handshake.endpoint)) {
+                            derror("rdma session connect to %s failed, error = %s",
+                                   _remote_addr.to_string(),
+                                   ec ? ec.message().c_str() : "invalid handshake");
+                            on_connect_failed();
+                        } else {
+                            dinfo("client rdma session %s connected", _remote_addr.to_string());
+
+                            on_established();
+                            set_connected();
+                            on_send_completed();
+                            start_read_next();
+                        }
+                        release_ref();
+                    });
+            });
+    });
+}
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#ifdef DSN_ENABLE_RDMA
+
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/message_parser.h>
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <memory>
+
+#include "rdma_channel.h"
+#include "rdma_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// the message on the handshake connection from either side, which carries the attributes
+// of its queue pair
+struct rdma_handshake
+{
+    uint32_t magic;
+    rdma_endpoint endpoint;
+};
+
+#define RDMA_HANDSHAKE_MAGIC 0x646d6472 // "rdmd"
+
+// An rpc session through the queue pair of a rdma_channel.
+// Thread-safe
+class rdma_rpc_session : public rpc_session
+{
+public:
+    rdma_rpc_session(rdma_network_provider &net,
+                     ::dsn::rpc_address remote_addr,
+                     const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                     std::unique_ptr<rdma_channel> channel,
+                     message_parser_ptr &parser,
+                     bool is_client);
+
+    ~rdma_rpc_session() override;
+
+    void send(uint64_t signature) override;
+
+    void close() override;
+
+    void connect() override;
+
+    // start to watch the completions and the tcp socket once the queue pairs are connected
+    void on_established();
+
+private:
+    void do_read(int read_next) override;
+    void try_read(int read_next);
+    void finish_send(bool succeed);
+    void release_send_msgs();
+    void on_event();
+    void on_connect_failed();
+
+    // the following should be called with _rdma_lock held
+    bool write_pending();
+    void wait_event();
+    void watch_socket();
+
+private:
+    rdma_network_provider &_rdma_net;
+    std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
+    std::unique_ptr<rdma_channel> _channel;
+    // a dup of the fd of the completion channel, which is owned by the descriptor
+    std::unique_ptr<boost::asio::posix::stream_descriptor> _event;
+    rdma_handshake _handshake;
+    char _socket_byte;
+
+    // the current batch of send(), the messages are referenced until the batch is posted,
+    // because _sending_msgs is cleared once the session is disconnected
+    uint64_t _send_signature;
+    std::vector<message_parser::send_buf> _send_bufs;
+    std::vector<message_ex *> _send_msgs;
+    size_t _send_index;
+    size_t _send_offset;
+
+    ::dsn::utils::ex_lock_nr _rdma_lock; // [
+    bool _closed;
+    // waiting for the completions or the credits, a reference of the session is held by
+    // each of the waiting sides
+    bool _read_waiting;
+    int _read_next;
+    bool _send_waiting;
+    // ]
+};
+
+} // namespace tools
+} // namespace dsn
+
+#endif // DSN_ENABLE_RDMA
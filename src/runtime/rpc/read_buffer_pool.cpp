@@ -0,0 +1,175 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "read_buffer_pool.h"
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/synchronize.h>
+#include <dsn/utility/utils.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace dsn {
+
+DSN_DEFINE_bool("network",
+                enable_read_buffer_pool,
+                false,
+                "whether to recycle the read buffers of the rpc sessions");
+DSN_DEFINE_uint64("network",
+                  read_buffer_pool_max_cached_bytes,
+                  256 * 1024 * 1024,
+                  "max bytes of the free read buffers cached by the pool");
+
+namespace {
+
+const int MIN_SIZE_CLASS_SHIFT = 12;
+const int SIZE_CLASS_COUNT = 12;
+// the hit rate is computed on each window of allocations
+const uint64_t HIT_RATE_WINDOW = 1024;
+
+class buffer_pool
+{
+public:
+    buffer_pool() : _cached_bytes(0), _pinned_bytes(0), _allocations(0), _hits(0)
+    {
+        _pinned_bytes_counter.init_global_counter(
+            "zion",
+            "network",
+            "read_buffer_pool.pinned.bytes",
+            COUNTER_TYPE_NUMBER,
+            "bytes of the read buffers from the pool which are still referenced");
+        _cached_bytes_counter.init_global_counter("zion",
+                                                  "network",
+                                                  "read_buffer_pool.cached.bytes",
+                                                  COUNTER_TYPE_NUMBER,
+                                                  "bytes of the free read buffers in the pool");
+        _hit_rate_counter.init_global_counter(
+            "zion",
+            "network",
+            "read_buffer_pool.hit.rate(%)",
+            COUNTER_TYPE_NUMBER,
+            "percentage of the read buffer allocations served by the pool recently");
+    }
+
+    char *pop(int size_class)
+    {
+        char *p = nullptr;
+        {
+            size_class_list &l = _lists[size_class];
+            utils::auto_lock<utils::ex_lock_nr_spin> guard(l.lock);
+            if (!l.buffers.empty()) {
+                p = l.buffers.back();
+                l.buffers.pop_back();
+            }
+        }
+
+        uint64_t sz = class_size(size_class);
+        if (p != nullptr) {
+            _cached_bytes_counter->set(_cached_bytes.fetch_sub(sz) - sz);
+            _hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            p = new char[sz];
+        }
+        _pinned_bytes_counter->set(_pinned_bytes.fetch_add(sz) + sz);
+
+        uint64_t allocations = _allocations.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (allocations % HIT_RATE_WINDOW == 0) {
+            uint64_t hits = _hits.exchange(0, std::memory_order_relaxed);
+            _hit_rate_counter->set(hits * 100 / HIT_RATE_WINDOW);
+        }
+        return p;
+    }
+
+    void push(char *p, int size_class)
+    {
+        uint64_t sz = class_size(size_class);
+        _pinned_bytes_counter->set(_pinned_bytes.fetch_sub(sz) - sz);
+
+        if (_cached_bytes.load(std::memory_order_relaxed) + sz >
+            FLAGS_read_buffer_pool_max_cached_bytes) {
+            delete[] p;
+            return;
+        }
+        {
+            size_class_list &l = _lists[size_class];
+            utils::auto_lock<utils::ex_lock_nr_spin> guard(l.lock);
+            l.buffers.push_back(p);
+        }
+        _cached_bytes_counter->set(_cached_bytes.fetch_add(sz) + sz);
+    }
+
+    static uint64_t class_size(int size_class)
+    {
+        return 1ULL << (size_class + MIN_SIZE_CLASS_SHIFT);
+    }
+
+private:
+    struct size_class_list
+    {
+        utils::ex_lock_nr_spin lock;
+        std::vector<char *> buffers;
+        // keep the locks of the adjacent lists in different cache lines
+        char padding[64];
+    };
+    size_class_list _lists[SIZE_CLASS_COUNT];
+
+    std::atomic<uint64_t> _cached_bytes;
+    std::atomic<uint64_t> _pinned_bytes;
+    std::atomic<uint64_t> _allocations;
+    std::atomic<uint64_t> _hits;
+
+    perf_counter_wrapper _pinned_bytes_counter;
+    perf_counter_wrapper _cached_bytes_counter;
+    perf_counter_wrapper _hit_rate_counter;
+};
+
+// the pool is never destroyed, because the buffers may be released during the exiting
+buffer_pool &get_pool()
+{
+    static buffer_pool *pool = new buffer_pool();
+    return *pool;
+}
+
+int get_size_class(unsigned int size)
+{
+    int shift = MIN_SIZE_CLASS_SHIFT;
+    while (shift < MIN_SIZE_CLASS_SHIFT + SIZE_CLASS_COUNT && (1U << shift) < size) {
+        shift++;
+    }
+    return shift - MIN_SIZE_CLASS_SHIFT;
+}
+
+} // anonymous namespace
+
+/*static*/ std::shared_ptr<char> read_buffer_pool::allocate(unsigned int size,
+                                                            /*out*/ unsigned int &capacity)
+{
+    int size_class = get_size_class(size);
+    if (!FLAGS_enable_read_buffer_pool || size_class >= SIZE_CLASS_COUNT) {
+        capacity = size;
+        return utils::make_shared_array<char>(size);
+    }
+
+    buffer_pool &pool = get_pool();
+    capacity = static_cast<unsigned int>(buffer_pool::class_size(size_class));
+    return std::shared_ptr<char>(pool.pop(size_class),
+                                 [size_class](char *p) { get_pool().push(p, size_class); });
+}
+
+} // namespace dsn
@@ -0,0 +1,40 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <memory>
+
+namespace dsn {
+
+// read_buffer_pool recycles the read buffers of message_reader.
+//
+// A read buffer is referenced by all the messages parsed from it, it's returned to the pool
+// when the last of them is released, and served to the next reader asking for a buffer of the
+// same size class. The size classes are powers of 2 from 4KB to 8MB, larger buffers are not
+// pooled. The pool is shared by all the sessions, because a buffer is usually allocated by an
+// io thread but released by a worker thread.
+//
+// It is enabled by [network] enable_read_buffer_pool, buffers are allocated by new when disabled.
+class read_buffer_pool
+{
+public:
+    // returns a buffer of at least `size` bytes, its actual size is returned by `capacity`
+    static std::shared_ptr<char> allocate(unsigned int size, /*out*/ unsigned int &capacity);
+};
+
+} // namespace dsn
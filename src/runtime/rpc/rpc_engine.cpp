@@ -29,6 +29,7 @@
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <cstring>
 
 #include "rpc_engine.h"
 #include "runtime/service_engine.h"
@@ -38,11 +39,44 @@
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/cpp/serialization.h>
 #include <dsn/utility/rand.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utils/latency_tracer.h>
+#include <algorithm>
 #include <set>
+#include <thread>
 
 namespace dsn {
 
 DEFINE_TASK_CODE(LPC_RPC_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_RPC_COALESCING_FLUSH, TASK_PRIORITY_HIGH, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_RPC(RPC_COALESCED_REQUESTS, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+DSN_DEFINE_uint32("core",
+                  rpc_matcher_bucket_count,
+                  0,
+                  "bucket count of the rpc client matcher, rounded up to a power of 2, "
+                  "0 means 4 times of the cpu count");
+DSN_DEFINE_uint32("core",
+                  rpc_timeout_wheel_tick_ms,
+                  0,
+                  "tick of the timing wheel tracking the rpc timeouts, the timeouts are rounded "
+                  "up to it, 0 means to use a timeout task for each rpc call");
+
+DSN_DEFINE_uint32("network",
+                  rpc_coalescing_window_ms,
+                  0,
+                  "how long a coalesced request waits for the following ones before it is sent, "
+                  "0 means to send the batch as soon as the flush task runs");
+DSN_DEFINE_uint32("network",
+                  rpc_coalescing_max_batch_count,
+                  64,
+                  "max count of the requests coalesced into one frame");
+DSN_DEFINE_uint32("network",
+                  rpc_coalescing_max_batch_bytes,
+                  65536,
+                  "max body bytes of the requests coalesced into one frame, larger requests are "
+                  "sent directly");
 
 class rpc_timeout_task : public task
 {
@@ -64,27 +98,124 @@ private:
     uint64_t _id;
 };
 
+rpc_client_matcher::rpc_client_matcher(rpc_engine *engine)
+    : _engine(engine), _wheel_tick_ms(FLAGS_rpc_timeout_wheel_tick_ms)
+{
+    uint32_t count = FLAGS_rpc_matcher_bucket_count;
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    }
+    _bucket_count = 1;
+    while (_bucket_count < count) {
+        _bucket_count <<= 1;
+    }
+
+    _buckets.reset(new bucket[_bucket_count]);
+    for (uint32_t i = 0; i < _bucket_count; i++) {
+        _buckets[i].last_tick = 0;
+        if (_wheel_tick_ms > 0) {
+            _buckets[i].wheel.resize(TIMING_WHEEL_SLOT_COUNT);
+        }
+    }
+}
+
 rpc_client_matcher::~rpc_client_matcher()
 {
-    for (int i = 0; i < MATCHER_BUCKET_NR; i++) {
-        dassert(_requests[i].size() == 0,
+    if (_wheel_timer != nullptr) {
+        _wheel_timer->cancel(true);
+    }
+    for (uint32_t i = 0; i < _bucket_count; i++) {
+        dassert(_buckets[i].requests.size() == 0,
                 "all rpc entries must be removed before the matcher ends");
     }
 }
 
+void rpc_client_matcher::start_timing_wheel()
+{
+    uint64_t now_tick = dsn_now_ms() / _wheel_tick_ms;
+    for (uint32_t i = 0; i < _bucket_count; i++) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_buckets[i].lock);
+        _buckets[i].last_tick = now_tick;
+    }
+
+    _wheel_timer = new timer_task(LPC_RPC_TIMEOUT,
+                                  [this]() { on_timing_wheel_tick(); },
+                                  static_cast<int>(_wheel_tick_ms),
+                                  0,
+                                  _engine->node());
+    _wheel_timer->enqueue();
+}
+
+void rpc_client_matcher::add_timeout(bucket &b, uint64_t key, match_entry &entry, int timeout_ms)
+{
+    // round up, so that a call never times out earlier than expected
+    uint64_t tick = (dsn_now_ms() + std::max(timeout_ms, 0) + _wheel_tick_ms - 1) / _wheel_tick_ms;
+    if (tick <= b.last_tick) {
+        tick = b.last_tick + 1;
+    }
+    entry.expire_tick = tick;
+    b.wheel[tick & (TIMING_WHEEL_SLOT_COUNT - 1)].push_back(key);
+}
+
+void rpc_client_matcher::on_timing_wheel_tick()
+{
+    uint64_t now_tick = dsn_now_ms() / _wheel_tick_ms;
+    std::vector<uint64_t> expired;
+
+    for (uint32_t i = 0; i < _bucket_count; i++) {
+        bucket &b = _buckets[i];
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        if (now_tick <= b.last_tick) {
+            continue;
+        }
+
+        // go through a round at most even if the timer is delayed for long
+        uint64_t from = b.last_tick + 1;
+        if (now_tick - b.last_tick > TIMING_WHEEL_SLOT_COUNT) {
+            from = now_tick - TIMING_WHEEL_SLOT_COUNT + 1;
+        }
+        for (uint64_t t = from; t <= now_tick; t++) {
+            std::vector<uint64_t> &slot = b.wheel[t & (TIMING_WHEEL_SLOT_COUNT - 1)];
+            size_t kept = 0;
+            for (uint64_t key : slot) {
+                auto it = b.requests.find(key);
+                if (it == b.requests.end() || it->second.expire_tick == 0) {
+                    // replied, or already expired
+                    continue;
+                }
+                if (it->second.expire_tick <= now_tick) {
+                    it->second.expire_tick = 0;
+                    expired.push_back(key);
+                } else if ((it->second.expire_tick & (TIMING_WHEEL_SLOT_COUNT - 1)) ==
+                           (t & (TIMING_WHEEL_SLOT_COUNT - 1))) {
+                    // expires in the following rounds
+                    slot[kept++] = key;
+                }
+            }
+            slot.resize(kept);
+        }
+        b.last_tick = now_tick;
+    }
+
+    for (uint64_t key : expired) {
+        on_rpc_timeout(key);
+    }
+}
+
 bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *reply, int delay_ms)
 {
     rpc_response_task_ptr call;
     task_ptr timeout_task;
-    int bucket_index = key % MATCHER_BUCKET_NR;
+    bucket &b = get_bucket(key);
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        auto it = b.requests.find(key);
+        if (it != b.requests.end()) {
             call = std::move(it->second.resp_task);
             timeout_task = std::move(it->second.timeout_task);
-            _requests[bucket_index].erase(it);
+            // the key left on the timing wheel is skipped when it expires
+            b.requests.erase(it);
         } else {
             if (reply) {
                 dassert(reply->get_count() == 0,
@@ -96,9 +227,9 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
-    dbg_dassert(timeout_task != nullptr, "rpc timeout task cannot be empty");
+    dbg_dassert(timeout_task != nullptr || _wheel_tick_ms > 0, "rpc timeout task cannot be empty");
 
-    if (timeout_task != task::get_current_task()) {
+    if (timeout_task != nullptr && timeout_task != task::get_current_task()) {
         timeout_task->cancel(false); // no need to wait
     }
 
@@ -198,18 +329,18 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
 void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 {
     rpc_response_task_ptr call;
-    int bucket_index = key % MATCHER_BUCKET_NR;
+    bucket &b = get_bucket(key);
     uint64_t timeout_ts_ms;
     bool resend = false;
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        auto it = b.requests.find(key);
+        if (it != b.requests.end()) {
             timeout_ts_ms = it->second.timeout_ts_ms;
             call = it->second.resp_task;
             if (timeout_ts_ms == 0) {
-                _requests[bucket_index].erase(it);
+                b.requests.erase(it);
             }
 
             // resend is enabled
@@ -240,23 +371,25 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 
     // TODO: memory pool for this task
     task_ptr new_timeout_task;
-    if (resend) {
+    if (resend && _wheel_tick_ms == 0) {
         new_timeout_task = new rpc_timeout_task(this, key, call->node());
     }
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        auto it = b.requests.find(key);
+        if (it != b.requests.end()) {
             // timeout
             if (!resend) {
-                _requests[bucket_index].erase(it);
+                b.requests.erase(it);
             }
 
             // resend
-            else {
+            else if (new_timeout_task != nullptr) {
                 // reset timeout task
                 it->second.timeout_task = new_timeout_task;
+            } else {
+                add_timeout(b, key, it->second, static_cast<int>(timeout_ts_ms - now_ts_ms));
             }
         }
 
@@ -276,15 +409,17 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
         _engine->call_ip(req->to_address, req, nullptr);
 
         // use rest of the timeout to resend once only
-        new_timeout_task->set_delay(static_cast<int>(timeout_ts_ms - now_ts_ms));
-        new_timeout_task->enqueue();
+        if (new_timeout_task != nullptr) {
+            new_timeout_task->set_delay(static_cast<int>(timeout_ts_ms - now_ts_ms));
+            new_timeout_task->enqueue();
+        }
     }
 }
 
 void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_ptr &call)
 {
     message_header &hdr = *request->header;
-    int bucket_index = hdr.id % MATCHER_BUCKET_NR;
+    bucket &b = get_bucket(hdr.id);
     auto sp = task_spec::get(request->local_rpc_code);
     int timeout_ms = hdr.client.timeout_ms;
     uint64_t timeout_ts_ms = 0;
@@ -297,12 +432,22 @@ void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_pt
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
+
+    if (_wheel_tick_ms > 0) {
+        std::call_once(_wheel_started, [this]() { start_timing_wheel(); });
+
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        auto pr = b.requests.emplace(hdr.id, match_entry{call, nullptr, timeout_ts_ms, 0});
+        dassert(pr.second, "the message is already on the fly!!!");
+        add_timeout(b, hdr.id, pr.first->second, timeout_ms);
+        return;
+    }
+
     task *timeout_task(new rpc_timeout_task(this, hdr.id, call->node()));
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto pr =
-            _requests[bucket_index].emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms});
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+        auto pr = b.requests.emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms, 0});
         dassert(pr.second, "the message is already on the fly!!!");
     }
 
@@ -311,43 +456,156 @@ void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_pt
 }
 
 //----------------------------------------------------------------------------------------------
-rpc_server_dispatcher::rpc_server_dispatcher()
+/*static*/ uint64_t rpc_server_dispatcher::handler_table::name_key(const char *name, size_t len)
+{
+    // the names mostly differ in the length, the head or the tail
+    uint64_t head = 0, middle = 0, tail = 0;
+    memcpy(&head, name, std::min<size_t>(len, 8));
+    if (len > 8) {
+        size_t n = std::min<size_t>(len - 8, 8);
+        memcpy(&tail, name + len - n, n);
+    }
+    if (len > 16) {
+        size_t n = std::min<size_t>(len - 16, 8);
+        memcpy(&middle, name + (len - n) / 2, n);
+    }
+    return mix(head ^ len, middle) ^ tail;
+}
+
+/*static*/ uint64_t rpc_server_dispatcher::handler_table::mix(uint64_t key, uint64_t seed)
 {
-    _vhandlers.resize(dsn::task_code::max() + 1);
-    for (auto &h : _vhandlers) {
-        h = new std::pair<std::unique_ptr<handler_entry>, utils::rw_lock_nr>();
+    uint64_t h = (key ^ seed) * 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+void rpc_server_dispatcher::handler_table::build_name_index()
+{
+    std::vector<name_slot> names;
+    for (const auto &entry : by_code) {
+        if (entry != nullptr) {
+            names.push_back({entry->code.to_string(), entry.get()});
+            if (entry->extra_name != entry->code.to_string()) {
+                names.push_back({entry->extra_name.c_str(), entry.get()});
+            }
+        }
+    }
+    name_count = names.size();
+
+    size_t slot_count = 16;
+    while (slot_count < names.size() * 2) {
+        slot_count *= 2;
+    }
+    size_t bucket_count = slot_count / 4;
+    by_name.assign(slot_count, name_slot{nullptr, nullptr});
+    displacements.assign(bucket_count, 0);
+    overflow.clear();
+    bucket_seed = rand::next_u64();
+
+    std::vector<std::vector<std::pair<uint64_t, name_slot>>> buckets(bucket_count);
+    for (const name_slot &n : names) {
+        uint64_t key = name_key(n.name, strlen(n.name));
+        buckets[mix(key, bucket_seed) & (bucket_count - 1)].emplace_back(key, n);
+    }
+
+    // place the largest buckets first, while most slots are free
+    std::vector<size_t> order(bucket_count);
+    for (size_t i = 0; i < bucket_count; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&buckets](size_t l, size_t r) {
+        return buckets[l].size() > buckets[r].size();
+    });
+
+    std::vector<size_t> slots;
+    for (size_t b : order) {
+        const auto &bucket = buckets[b];
+        if (bucket.empty()) {
+            break;
+        }
+        bool placed = false;
+        for (int attempt = 0; attempt < 1024 && !placed; ++attempt) {
+            uint64_t displacement = rand::next_u64();
+            slots.clear();
+            placed = true;
+            for (const auto &kv : bucket) {
+                size_t slot = mix(kv.first, displacement) & (slot_count - 1);
+                if (by_name[slot].name != nullptr ||
+                    std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed) {
+                displacements[b] = displacement;
+                for (size_t i = 0; i < bucket.size(); ++i) {
+                    by_name[slots[i]] = bucket[i].second;
+                }
+            }
+        }
+        if (!placed) {
+            for (const auto &kv : bucket) {
+                overflow.push_back(kv.second);
+            }
+        }
     }
-    _handlers.clear();
 }
 
-rpc_server_dispatcher::~rpc_server_dispatcher()
+rpc_server_dispatcher::handler_entry *
+rpc_server_dispatcher::handler_table::find(const char *name) const
 {
-    for (auto &h : _vhandlers) {
-        delete h;
+    size_t len = strnlen(name, DSN_MAX_TASK_CODE_NAME_LENGTH);
+    auto matches = [name, len](const name_slot &s) {
+        return s.name != nullptr && strncmp(s.name, name, len) == 0 && s.name[len] == '\0';
+    };
+
+    uint64_t key = name_key(name, len);
+    uint64_t displacement = displacements[mix(key, bucket_seed) & (displacements.size() - 1)];
+    const name_slot &s = by_name[mix(key, displacement) & (by_name.size() - 1)];
+    if (matches(s)) {
+        return s.entry;
     }
-    _vhandlers.clear();
-    _handlers.clear();
-    dassert(_handlers.size() == 0,
-            "please make sure all rpc handlers are unregistered at this point");
+    for (const name_slot &o : overflow) {
+        if (matches(o)) {
+            return o.entry;
+        }
+    }
+    return nullptr;
+}
+
+rpc_server_dispatcher::rpc_server_dispatcher()
+{
+    std::unique_ptr<handler_table> table(new handler_table());
+    table->by_code.resize(dsn::task_code::max() + 1);
+    table->build_name_index();
+    _table.store(table.get(), std::memory_order_release);
+    _tables.push_back(std::move(table));
+}
+
+rpc_server_dispatcher::~rpc_server_dispatcher() { _tables.clear(); }
+
+void rpc_server_dispatcher::publish(std::unique_ptr<handler_table> table)
+{
+    table->build_name_index();
+    _table.store(table.get(), std::memory_order_release);
+    _tables.push_back(std::move(table));
 }
 
 bool rpc_server_dispatcher::register_rpc_handler(dsn::task_code code,
                                                  const char *extra_name,
                                                  const rpc_request_handler &h)
 {
-    std::unique_ptr<handler_entry> ctx(new handler_entry{code, extra_name, h});
-
-    utils::auto_write_lock l(_handlers_lock);
-    auto it = _handlers.find(code.to_string());
-    auto it2 = _handlers.find(extra_name);
-    if (it == _handlers.end() && it2 == _handlers.end()) {
-        _handlers[code.to_string()] = ctx.get();
-        _handlers[ctx->extra_name] = ctx.get();
-
-        {
-            utils::auto_write_lock l(_vhandlers[code.code()]->second);
-            _vhandlers[code.code()]->first = std::move(ctx);
-        }
+    std::shared_ptr<handler_entry> ctx(new handler_entry{code, extra_name, h});
+
+    utils::auto_lock<utils::ex_lock_nr> l(_update_lock);
+    const handler_table *current = _table.load(std::memory_order_relaxed);
+    if (current->by_code[code] == nullptr && current->find(code.to_string()) == nullptr &&
+        current->find(extra_name) == nullptr) {
+        std::unique_ptr<handler_table> table(new handler_table(*current));
+        table->by_code[code] = std::move(ctx);
+        publish(std::move(table));
         return true;
     } else {
         dassert(false, "rpc registration confliction for '%s' '%s'", code.to_string(), extra_name);
@@ -357,22 +615,15 @@ bool rpc_server_dispatcher::register_rpc_handler(dsn::task_code code,
 
 bool rpc_server_dispatcher::unregister_rpc_handler(dsn::task_code rpc_code)
 {
-    {
-        utils::auto_write_lock l(_handlers_lock);
-        auto it = _handlers.find(rpc_code.to_string());
-        if (it == _handlers.end())
-            return false;
-
-        handler_entry *ctx = it->second;
-        _handlers.erase(it);
-        _handlers.erase(ctx->extra_name);
-
-        {
-            utils::auto_write_lock l(_vhandlers[rpc_code]->second);
-            _vhandlers[rpc_code]->first.reset();
-        }
+    utils::auto_lock<utils::ex_lock_nr> l(_update_lock);
+    const handler_table *current = _table.load(std::memory_order_relaxed);
+    if (current->by_code[rpc_code] == nullptr) {
+        return false;
     }
 
+    std::unique_ptr<handler_table> table(new handler_table(*current));
+    table->by_code[rpc_code].reset();
+    publish(std::move(table));
     return true;
 }
 
@@ -380,18 +631,17 @@ rpc_request_task *rpc_server_dispatcher::on_request(message_ex *msg, service_nod
 {
     rpc_request_handler handler;
 
+    const handler_table *table = _table.load(std::memory_order_acquire);
     if (TASK_CODE_INVALID != msg->local_rpc_code) {
-        utils::auto_read_lock l(_vhandlers[msg->local_rpc_code]->second);
-        handler_entry *ctx = _vhandlers[msg->local_rpc_code]->first.get();
+        const handler_entry *ctx = table->by_code[msg->local_rpc_code].get();
         if (ctx != nullptr) {
             handler = ctx->h;
         }
     } else {
-        utils::auto_read_lock l(_handlers_lock);
-        auto it = _handlers.find(msg->header->rpc_name);
-        if (it != _handlers.end()) {
-            msg->local_rpc_code = it->second->code;
-            handler = it->second->h;
+        const handler_entry *ctx = table->find(msg->header->rpc_name);
+        if (ctx != nullptr) {
+            msg->local_rpc_code = ctx->code;
+            handler = ctx->h;
         }
     }
 
@@ -404,7 +654,228 @@ rpc_request_task *rpc_server_dispatcher::on_request(message_ex *msg, service_nod
 }
 
 //----------------------------------------------------------------------------------------------
-rpc_engine::rpc_engine(service_node *node) : _node(node), _rpc_matcher(this)
+// the header of each request in a RPC_COALESCED_REQUESTS frame, followed by the rpc name and the
+// body of the request. the other fields in message_header are shared with the frame.
+struct coalesced_request_header
+{
+    uint64_t id;
+    uint64_t trace_id;
+    uint64_t gpid;
+    uint64_t context;
+    int32_t timeout_ms;
+    int32_t thread_hash;
+    uint64_t partition_hash;
+    uint32_t body_length;
+    uint32_t rpc_name_length;
+};
+
+rpc_request_coalescer::rpc_request_coalescer(rpc_engine *engine) : _engine(engine) {}
+
+rpc_request_coalescer::~rpc_request_coalescer()
+{
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+    for (auto &kv : _batches) {
+        for (auto request : kv.second.requests) {
+            request->release_ref();
+        }
+    }
+}
+
+bool rpc_request_coalescer::try_coalesce(network *net, message_ex *request)
+{
+    auto &hdr = *request->header;
+    if (request->hdr_format != NET_HDR_DSN || hdr.context.u.is_forwarded ||
+        hdr.body_length >= FLAGS_rpc_coalescing_max_batch_bytes) {
+        return false;
+    }
+
+    batch_key key(net, request->to_address);
+    std::vector<message_ex *> full;
+    bool schedule_flush = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+        batch &b = _batches[key];
+        schedule_flush = b.requests.empty();
+        request->add_ref(); // released in send_batch
+        b.requests.push_back(request);
+        b.bytes += hdr.body_length;
+        if (b.requests.size() >= FLAGS_rpc_coalescing_max_batch_count ||
+            b.bytes >= FLAGS_rpc_coalescing_max_batch_bytes) {
+            full.swap(b.requests);
+            b.bytes = 0;
+            // the pending flush task will find the batch empty or flush the following requests
+            schedule_flush = false;
+        }
+    }
+
+    if (!full.empty()) {
+        send_batch(key, std::move(full));
+    } else if (schedule_flush) {
+        task_ptr t(new raw_task(
+            LPC_RPC_COALESCING_FLUSH, [this, key]() { flush(key); }, 0, _engine->node()));
+        t->set_delay(static_cast<int>(FLAGS_rpc_coalescing_window_ms));
+        t->enqueue();
+    }
+    return true;
+}
+
+void rpc_request_coalescer::flush(const batch_key &key)
+{
+    std::vector<message_ex *> requests;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+        auto iter = _batches.find(key);
+        if (iter == _batches.end()) {
+            // flushed by an earlier task
+            return;
+        }
+        requests.swap(iter->second.requests);
+        // the entry is created again by the next request to the address, so that the batches
+        // of the addresses no longer called don't pile up
+        _batches.erase(iter);
+    }
+    if (!requests.empty()) {
+        send_batch(key, std::move(requests));
+    }
+}
+
+void rpc_request_coalescer::send_batch(const batch_key &key, std::vector<message_ex *> &&requests)
+{
+    network *net = key.first;
+    if (requests.size() == 1) {
+        net->send_message(requests[0]);
+        requests[0]->release_ref();
+        return;
+    }
+
+    message_ex *frame = make_frame(requests);
+    frame->to_address = key.second;
+    frame->server_address = key.second;
+    for (auto request : requests) {
+        request->release_ref();
+    }
+    net->send_message(frame);
+}
+
+/*static*/ message_ex *rpc_request_coalescer::make_frame(const std::vector<message_ex *> &requests)
+{
+    dassert(!requests.empty(), "no requests to coalesce");
+
+    int timeout_ms = 0;
+    size_t total = 0;
+    for (auto request : requests) {
+        timeout_ms = std::max(timeout_ms, request->header->client.timeout_ms);
+        total += sizeof(coalesced_request_header) +
+                 strnlen(request->header->rpc_name, sizeof(request->header->rpc_name)) +
+                 request->header->body_length;
+    }
+
+    message_ex *frame = message_ex::create_request(RPC_COALESCED_REQUESTS, timeout_ms);
+    frame->header->from_address = requests[0]->header->from_address;
+    frame->header->trace_id = requests[0]->header->trace_id;
+
+    void *ptr;
+    size_t sz;
+    frame->write_next(&ptr, &sz, total);
+    char *p = (char *)ptr;
+    for (auto request : requests) {
+        auto &hdr = *request->header;
+        coalesced_request_header sub;
+        sub.id = hdr.id;
+        sub.trace_id = hdr.trace_id;
+        sub.gpid = hdr.gpid.value();
+        sub.context = hdr.context.context;
+        sub.timeout_ms = hdr.client.timeout_ms;
+        sub.thread_hash = hdr.client.thread_hash;
+        sub.partition_hash = hdr.client.partition_hash;
+        sub.body_length = hdr.body_length;
+        sub.rpc_name_length = strnlen(hdr.rpc_name, sizeof(hdr.rpc_name));
+        memcpy(p, &sub, sizeof(sub));
+        p += sizeof(sub);
+        memcpy(p, hdr.rpc_name, sub.rpc_name_length);
+        p += sub.rpc_name_length;
+
+        // the first buffer of a request to send begins with the header
+        for (size_t i = 0; i < request->buffers.size(); i++) {
+            size_t offset = (i == 0 ? sizeof(message_header) : 0);
+            size_t len = request->buffers[i].length() - offset;
+            memcpy(p, request->buffers[i].data() + offset, len);
+            p += len;
+        }
+    }
+    dassert(p == (char *)ptr + total, "coalesced frame length is wrong");
+    frame->write_commit(total);
+    return frame;
+}
+
+/*static*/ bool rpc_request_coalescer::split_frame(message_ex *frame,
+                                                   /*out*/ std::vector<message_ex *> &requests)
+{
+    // a received message may keep its header standalone
+    blob body;
+    for (auto &buf : frame->buffers) {
+        if (buf.data() == (const char *)frame->header) {
+            continue;
+        }
+        if (body.length() == 0) {
+            body = buf;
+        } else {
+            std::string merged(body.data(), body.length());
+            merged.append(buf.data(), buf.length());
+            body = blob::create_from_bytes(std::move(merged));
+        }
+    }
+
+    const message_header &frame_hdr = *frame->header;
+    size_t offset = 0;
+    while (offset < body.length()) {
+        coalesced_request_header sub;
+        if (body.length() - offset < sizeof(sub)) {
+            break;
+        }
+        memcpy(&sub, body.data() + offset, sizeof(sub));
+        offset += sizeof(sub);
+        if (sub.rpc_name_length >= DSN_MAX_TASK_CODE_NAME_LENGTH ||
+            body.length() - offset < (size_t)sub.rpc_name_length + sub.body_length) {
+            break;
+        }
+
+        message_ex *request = message_ex::create_receive_message_with_standalone_header(
+            body.range((int)(offset + sub.rpc_name_length), (int)sub.body_length));
+        auto &hdr = *request->header;
+        hdr = frame_hdr;
+        memcpy(hdr.rpc_name, body.data() + offset, sub.rpc_name_length);
+        hdr.rpc_name[sub.rpc_name_length] = '\0';
+        offset += sub.rpc_name_length + sub.body_length;
+
+        // resolved by the name
+        hdr.rpc_code.local_code = TASK_CODE_INVALID;
+        hdr.rpc_code.local_hash = 0;
+        hdr.hdr_crc32 = hdr.body_crc32 = CRC_INVALID;
+        hdr.body_length = sub.body_length;
+        hdr.id = sub.id;
+        hdr.trace_id = sub.trace_id;
+        hdr.gpid.set_value(sub.gpid);
+        hdr.context.context = sub.context;
+        // the codecs the client accepts are only announced on the frame
+        hdr.context.u.accept_lz4 = frame_hdr.context.u.accept_lz4;
+        hdr.context.u.accept_zstd = frame_hdr.context.u.accept_zstd;
+        hdr.client.timeout_ms = sub.timeout_ms;
+        hdr.client.thread_hash = sub.thread_hash;
+        hdr.client.partition_hash = sub.partition_hash;
+
+        request->hdr_format = frame->hdr_format;
+        request->to_address = frame->to_address;
+        request->io_session = frame->io_session;
+        requests.push_back(request);
+    }
+
+    return offset == body.length();
+}
+
+//----------------------------------------------------------------------------------------------
+rpc_engine::rpc_engine(service_node *node)
+    : _node(node), _rpc_matcher(this), _request_coalescer(this)
 {
     dassert(_node != nullptr, "");
     _is_running = false;
@@ -548,6 +1019,23 @@ void rpc_engine::on_recv_request(network *net, message_ex *msg, int delay_ms)
 
     auto code = msg->rpc_code();
 
+    if (code == RPC_COALESCED_REQUESTS) {
+        std::vector<message_ex *> requests;
+        if (!rpc_request_coalescer::split_frame(msg, requests)) {
+            derror("recv corrupted coalesced requests from %s, trace_id = %016" PRIx64
+                   ", %d requests are split out",
+                   msg->header->from_address.to_string(),
+                   msg->header->trace_id,
+                   (int)requests.size());
+        }
+        dassert(msg->get_count() == 0, "request should not be referenced by anybody so far");
+        delete msg;
+        for (auto request : requests) {
+            on_recv_request(net, request, delay_ms);
+        }
+        return;
+    }
+
     if (code != ::dsn::TASK_CODE_INVALID) {
         rpc_request_task *tsk = nullptr;
 
@@ -611,8 +1099,19 @@ void rpc_engine::call(message_ex *request, const rpc_response_task_ptr &call)
 {
     auto &hdr = *request->header;
     hdr.from_address = primary_address();
-    hdr.trace_id = rand::next_u64(std::numeric_limits<decltype(hdr.trace_id)>::min(),
-                                  std::numeric_limits<decltype(hdr.trace_id)>::max());
+
+    // the request joins the trace of the current thread, or starts a new one if sampled
+    const utils::trace_context &trace = utils::trace_context::current();
+    if (trace.sampled) {
+        hdr.trace_id = trace.trace_id;
+        hdr.context.u.is_trace_sampled = true;
+        hdr.context.u.parent_span_id = trace.span_id;
+    } else {
+        hdr.trace_id = rand::next_u64(std::numeric_limits<decltype(hdr.trace_id)>::min(),
+                                      std::numeric_limits<decltype(hdr.trace_id)>::max());
+        hdr.context.u.is_trace_sampled = utils::trace_context::should_sample();
+        hdr.context.u.parent_span_id = 0;
+    }
 
     call_address(request->server_address, request, call);
 }
@@ -640,6 +1139,20 @@ void rpc_engine::call_group(rpc_address addr,
     }
 }
 
+void rpc_engine::prepare_session(rpc_address addr, message_ex *request)
+{
+    if (addr.type() != HOST_TYPE_IPV4) {
+        return;
+    }
+
+    auto sp = task_spec::get(request->local_rpc_code);
+    network *net = _client_nets[request->hdr_format][sp->rpc_call_channel].get();
+    if (net != nullptr) {
+        request->to_address = addr;
+        net->prepare_session(request);
+    }
+}
+
 void rpc_engine::call_ip(rpc_address addr,
                          message_ex *request,
                          const rpc_response_task_ptr &call,
@@ -715,6 +1228,10 @@ void rpc_engine::call_ip(rpc_address addr,
         _rpc_matcher.on_call(request, call);
     }
 
+    if (sp->rpc_request_coalescing_enabled && _request_coalescer.try_coalesce(net, request)) {
+        return;
+    }
+
     net->send_message(request);
 }
 
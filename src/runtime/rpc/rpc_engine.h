@@ -27,9 +27,13 @@
 #pragma once
 
 #include <dsn/utility/synchronize.h>
+#include <dsn/utility/slab_allocator.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/network.h>
 #include <dsn/tool-api/global_config.h>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace dsn {
 
@@ -50,11 +54,15 @@ class rpc_engine;
 // (due to
 // less std::shared_ptr<rpc_client_matcher> operations in rpc_timeout_task
 //
-#define MATCHER_BUCKET_NR 13
+// the requests are sharded into [core] rpc_matcher_bucket_count buckets by the request id,
+// each with its own lock. the timeouts are tracked either by one rpc_timeout_task per call, or,
+// if [core] rpc_timeout_wheel_tick_ms > 0, by a timing wheel in each bucket which is driven by
+// a single timer of the engine, so that no task is created or cancelled per call.
+//
 class rpc_client_matcher : public ref_counter
 {
 public:
-    rpc_client_matcher(rpc_engine *engine) : _engine(engine) {}
+    rpc_client_matcher(rpc_engine *engine);
 
     ~rpc_client_matcher();
 
@@ -79,16 +87,49 @@ private:
     void on_rpc_timeout(uint64_t key);
 
 private:
-    rpc_engine *_engine;
     struct match_entry
     {
         rpc_response_task_ptr resp_task;
-        task_ptr timeout_task;
+        task_ptr timeout_task;  // nullptr if the timing wheel is used
         uint64_t timeout_ts_ms; // > 0 for auto-resent msgs
+        uint64_t expire_tick;   // the tick it expires on the timing wheel, 0 if not on the wheel
+    };
+    // the entries are allocated on the calling threads and freed on the replying ones
+    typedef std::unordered_map<uint64_t,
+                               match_entry,
+                               std::hash<uint64_t>,
+                               std::equal_to<uint64_t>,
+                               utils::slab_stl_allocator<std::pair<const uint64_t, match_entry>>>
+        rpc_requests;
+
+    static const int TIMING_WHEEL_SLOT_COUNT = 512;
+    struct bucket
+    {
+        ::dsn::utils::ex_lock_nr_spin lock;
+        rpc_requests requests;
+        // the slot (tick % TIMING_WHEEL_SLOT_COUNT) holds the keys which may expire at the tick,
+        // the keys already replied are skipped lazily when the slot is expired
+        std::vector<std::vector<uint64_t>> wheel;
+        uint64_t last_tick;
+        // keep the locks of the adjacent buckets in different cache lines
+        char padding[64];
     };
-    typedef std::unordered_map<uint64_t, match_entry> rpc_requests;
-    rpc_requests _requests[MATCHER_BUCKET_NR];
-    ::dsn::utils::ex_lock_nr_spin _requests_lock[MATCHER_BUCKET_NR];
+
+    bucket &get_bucket(uint64_t key) { return _buckets[key & (_bucket_count - 1)]; }
+
+    // must be called with the lock of the bucket held
+    void add_timeout(bucket &b, uint64_t key, match_entry &entry, int timeout_ms);
+    void start_timing_wheel();
+    void on_timing_wheel_tick();
+
+private:
+    rpc_engine *_engine;
+    uint32_t _bucket_count; // power of 2
+    std::unique_ptr<bucket[]> _buckets;
+
+    uint32_t _wheel_tick_ms; // 0 if the timing wheel is disabled
+    std::once_flag _wheel_started;
+    task_ptr _wheel_timer;
 };
 
 class rpc_server_dispatcher
@@ -102,8 +143,7 @@ public:
     rpc_request_task *on_request(message_ex *msg, service_node *node);
     int handler_count() const
     {
-        utils::auto_read_lock l(_handlers_lock);
-        return static_cast<int>(_handlers.size());
+        return static_cast<int>(_table.load(std::memory_order_acquire)->name_count);
     }
 
 private:
@@ -114,17 +154,89 @@ private:
         rpc_request_handler h;
     };
 
-    mutable utils::rw_lock_nr _handlers_lock;
-    // there are 2 pairs for each rpc handler: code_name->hander_entry*, extra_name->hander_entry*
-    // the hander_entry pointers are the same for these 2 pairs, and the pointer is owned by
-    // _vhandlers[code_index]->first
-    //
-    // we support an extra name for compatibility to
-    // rpc client of other framework like thrift or grpc
-    std::unordered_map<std::string, handler_entry *> _handlers;
+    // an immutable snapshot of the handlers. the handlers are registered at startup and seldom
+    // unregistered, so every update publishes a new table, and the dispatch reads the current one
+    // without any lock.
+    struct handler_table
+    {
+        // there is one entry for each rpc code
+        std::vector<std::shared_ptr<handler_entry>> by_code;
+
+        // there are 2 names for each rpc handler: the code name and the extra name, the latter is
+        // for compatibility to rpc client of other framework like thrift or grpc.
+        //
+        // the names are indexed by a perfect hash built by hash-and-displace: a name is keyed by
+        // its length and a few of its words, the key picks a bucket, and the displacement of the
+        // bucket picks the slot, so a lookup takes one probe and one string comparison. the few
+        // names which can't be placed (e.g. with the same key) are compared one by one.
+        struct name_slot
+        {
+            const char *name;
+            handler_entry *entry;
+        };
+        std::vector<name_slot> by_name;
+        std::vector<uint64_t> displacements;
+        std::vector<name_slot> overflow;
+        uint64_t bucket_seed{0};
+        size_t name_count{0};
+
+        handler_entry *find(const char *name) const;
+        void build_name_index();
+        static uint64_t name_key(const char *name, size_t len);
+        static uint64_t mix(uint64_t key, uint64_t seed);
+    };
+
+    // publishes `table` as the current one
+    void publish(std::unique_ptr<handler_table> table);
+
+    utils::ex_lock_nr _update_lock;
+    std::atomic<handler_table *> _table;
+    // the superseded tables are kept until destruction, as the dispatch may still read them
+    std::vector<std::unique_ptr<handler_table>> _tables;
+};
 
-    // there is one entry for each rpc code
-    std::vector<std::pair<std::unique_ptr<handler_entry>, utils::rw_lock_nr> *> _vhandlers;
+//
+// coalesce the small requests to the same server into one RPC_COALESCED_REQUESTS frame, to save
+// the per-message header and sending overhead for the high fanout clients.
+//
+// only the requests whose task code enables rpc_request_coalescing_enabled are coalesced. each
+// coalesced request is still registered in the client matcher with its own id, and the server
+// splits the frame into the original requests and replies to each of them separately.
+//
+// a batch is sent when it reaches [network] rpc_coalescing_max_batch_count or
+// rpc_coalescing_max_batch_bytes, or rpc_coalescing_window_ms after its first request.
+//
+class rpc_request_coalescer
+{
+public:
+    explicit rpc_request_coalescer(rpc_engine *engine);
+    ~rpc_request_coalescer();
+
+    // returns false if the request should be sent directly
+    bool try_coalesce(network *net, message_ex *request);
+
+    // pack the requests into a frame, the requests are not changed
+    static message_ex *make_frame(const std::vector<message_ex *> &requests);
+
+    // split a received frame into the original requests, which share the buffer of the frame
+    static bool split_frame(message_ex *frame, /*out*/ std::vector<message_ex *> &requests);
+
+private:
+    typedef std::pair<network *, rpc_address> batch_key;
+    struct batch
+    {
+        std::vector<message_ex *> requests; // each holds a ref
+        size_t bytes = 0;
+    };
+
+    void flush(const batch_key &key);
+    void send_batch(const batch_key &key, std::vector<message_ex *> &&requests);
+
+private:
+    rpc_engine *_engine;
+
+    utils::ex_lock_nr_spin _lock;
+    std::map<batch_key, batch> _batches;
 };
 
 class rpc_engine
@@ -173,6 +285,9 @@ public:
     // call with explicit address
     void call_address(rpc_address addr, message_ex *request, const rpc_response_task_ptr &call);
 
+    // open the session to `addr` that `request` would be sent with, without sending it
+    void prepare_session(rpc_address addr, message_ex *request);
+
 private:
     network *create_network(const network_server_config &netcs,
                             bool client_only,
@@ -187,6 +302,7 @@ private:
     ::dsn::rpc_address _local_primary_address;
     rpc_client_matcher _rpc_matcher;
     rpc_server_dispatcher _rpc_dispatcher;
+    rpc_request_coalescer _request_coalescer;
 
     volatile bool _is_running;
     volatile bool _is_serving;
@@ -26,20 +26,36 @@
 
 #include <dsn/utility/ports.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/pooled_binary_writer.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/network.h>
 #include <dsn/tool-api/message_parser.h>
 #include <cctype>
 
 #include "runtime/task/task_engine.h"
+#include "runtime/task/task_object_pool.h"
 
 using namespace dsn::utils;
 
 namespace dsn {
 
+DSN_DEFINE_uint32("network",
+                  message_inline_body_bytes,
+                  0,
+                  "the bytes allocated along with the header of a message being written, the "
+                  "body is written there without another allocation if it fits; 0 means the "
+                  "bodies are always written to separate buffers");
+DSN_DEFINE_validator(message_inline_body_bytes,
+                     [](uint32_t value) -> bool { return value <= 64 * 1024; });
+
 std::atomic<uint64_t> message_ex::_id(0);
 uint32_t message_ex::s_local_hash = 0;
 
+/*static*/ void *message_ex::operator new(size_t size) { return task_object_pool::allocate(size); }
+
+/*static*/ void message_ex::operator delete(void *p) { task_object_pool::deallocate(p); }
+
 message_ex::message_ex()
     : header(nullptr),
       local_rpc_code(::dsn::TASK_CODE_INVALID),
@@ -313,7 +329,7 @@ message_ex *message_ex::create_request(dsn::task_code rpc_code,
     hdr.id = new_id();
 
     hdr.context.u.is_request = true;
-    hdr.context.u.serialize_format = sp->rpc_msg_payload_serialize_default_format;
+    hdr.context.u.serialize_format = sp->get_rpc_msg_payload_serialize_format();
     hdr.context.u.is_forward_supported = true;
 
     msg->hdr_format = sp->rpc_call_header_format;
@@ -368,16 +384,23 @@ message_ex *message_ex::create_response()
 
 void message_ex::prepare_buffer_header()
 {
+    // the header and the inline body share one block, along with the reference count of it
     size_t header_size = sizeof(message_header);
-    auto ptr(dsn::utils::make_shared_array<char>(header_size));
+    size_t block_size = header_size + FLAGS_message_inline_body_bytes;
+    auto ptr(dsn::utils::make_shared_array<char>(block_size));
 
     // here we should call placement new,
     // so the gpid & rpc_address can be initialized
     new (ptr.get())(message_header);
     this->header = (message_header *)ptr.get();
 
-    ::dsn::blob buffer(std::move(ptr), header_size);
-    this->buffers.push_back(buffer);
+    ::dsn::blob block(std::move(ptr), block_size);
+    // the header and a few body chunks
+    this->buffers.reserve(4);
+    this->buffers.push_back(block.range(0, header_size));
+    if (block_size > header_size) {
+        _inline_body = block.range(header_size);
+    }
     this->_rw_index = 0;
     this->_rw_offset = header_size;
 }
@@ -395,12 +418,18 @@ void message_ex::write_next(void **ptr, size_t *size, size_t min_size)
     dassert(!this->_is_read && this->_rw_committed,
             "there are pending msg write not committed"
             ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
-    auto ptr_data(utils::make_shared_array<char>(min_size));
-    *size = min_size;
-    *ptr = ptr_data.get();
+    // the chunk may be larger than min_size, all of which is writable
+    ::dsn::blob buffer;
+    if (_inline_body.length() > 0 && _inline_body.length() >= min_size) {
+        buffer = std::move(_inline_body);
+        _inline_body = blob();
+    } else {
+        buffer = binary_writer_chunk_pool::allocate(min_size);
+    }
+    *size = buffer.length();
+    *ptr = const_cast<char *>(buffer.data());
     this->_rw_committed = false;
 
-    ::dsn::blob buffer(ptr_data, min_size);
     this->_rw_index++;
     this->_rw_offset = 0;
     this->buffers.push_back(buffer);
@@ -422,6 +451,20 @@ void message_ex::write_commit(size_t size)
     this->header->body_length += (int)size;
 }
 
+void message_ex::write_append(const blob &data)
+{
+    dassert(!this->_is_read && this->_rw_committed,
+            "there are pending msg write not committed"
+            ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
+    this->_rw_index++;
+    this->_rw_offset = (int)data.length();
+    this->buffers.push_back(data);
+    this->header->body_length += (int)data.length();
+
+    dassert(this->_rw_index + 1 == (int)this->buffers.size(),
+            "message write buffer count is not right");
+}
+
 bool message_ex::read_next(void **ptr, size_t *size)
 {
     // printf("%p %s %d\n", this, __FUNCTION__, utils::get_current_tid());
@@ -0,0 +1,236 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "rpc_size_stats.h"
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/utility/flags.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("network",
+                  rpc_size_stats_sample_interval,
+                  16,
+                  "one of every this many messages of a thread has its body size sampled into "
+                  "the histograms of its session and task code, 0 for no sampling; the bytes of "
+                  "the sessions are counted anyway");
+DSN_TAG_VARIABLE(rpc_size_stats_sample_interval, FT_MUTABLE);
+
+void rpc_size_histogram::merge(const rpc_size_histogram &other)
+{
+    for (int i = 0; i < kBucketCount; i++) {
+        _buckets[i].fetch_add(other._buckets[i].load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+    }
+    _sum.fetch_add(other.sum(), std::memory_order_relaxed);
+    uint64_t other_max = other.max();
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (other_max > max &&
+           !_max.compare_exchange_weak(max, other_max, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t rpc_size_histogram::count() const
+{
+    uint64_t total = 0;
+    for (const auto &b : _buckets) {
+        total += b.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t rpc_size_histogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(total * p / 100.0 + 0.5));
+    uint64_t seen = 0;
+    int i = 0;
+    for (; i < kBucketCount - 1; i++) {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            break;
+        }
+    }
+    uint64_t upper = i == 0 ? 0 : (i >= 64 ? UINT64_MAX : (1ULL << i) - 1);
+    return std::min(upper, max());
+}
+
+rpc_size_stats::rpc_size_stats() : _code_body_sizes(task_code::max() + 1)
+{
+    for (auto &h : _code_body_sizes) {
+        h.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+std::unique_ptr<rpc_session_size_stats> rpc_size_stats::register_session(rpc_address remote,
+                                                                         bool is_client)
+{
+    std::unique_ptr<rpc_session_size_stats> stats(new rpc_session_size_stats(remote, is_client));
+    stats->last_report_ms = dsn_now_ms();
+    utils::auto_lock<utils::ex_lock_nr> l(_lock);
+    _sessions.insert(stats.get());
+    return stats;
+}
+
+void rpc_size_stats::unregister_session(rpc_session_size_stats *stats)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_lock);
+    _sessions.erase(stats);
+}
+
+/*static*/ bool rpc_size_stats::should_sample()
+{
+    uint32_t interval = FLAGS_rpc_size_stats_sample_interval;
+    if (interval == 0) {
+        return false;
+    }
+    static thread_local uint32_t message_count = 0;
+    return ++message_count % interval == 0;
+}
+
+void rpc_size_stats::on_sampled_message(rpc_session_size_stats &stats,
+                                        message_ex *msg,
+                                        uint64_t size)
+{
+    stats.body_sizes.add(size);
+
+    // the received messages are not bound to their local codes yet
+    task_code code = msg->local_rpc_code;
+    if (code == TASK_CODE_INVALID) {
+        code = task_code::try_get(msg->header->rpc_name, TASK_CODE_INVALID);
+    }
+    if (code == TASK_CODE_INVALID || static_cast<size_t>(code.code()) >= _code_body_sizes.size()) {
+        return;
+    }
+
+    auto &slot = _code_body_sizes[code];
+    rpc_size_histogram *h = slot.load(std::memory_order_acquire);
+    if (h == nullptr) {
+        auto created = new rpc_size_histogram();
+        if (slot.compare_exchange_strong(h, created, std::memory_order_acq_rel)) {
+            h = created;
+        } else {
+            delete created;
+        }
+    }
+    h->add(size);
+}
+
+void rpc_size_stats::get_stats(int top_n, utils::multi_table_printer &out)
+{
+    utils::table_printer codes_tp("task_code_body_sizes");
+    codes_tp.add_title("task_code");
+    codes_tp.add_column("samples", utils::table_printer::alignment::kRight);
+    codes_tp.add_column("avg", utils::table_printer::alignment::kRight);
+    codes_tp.add_column("p50", utils::table_printer::alignment::kRight);
+    codes_tp.add_column("p99", utils::table_printer::alignment::kRight);
+    codes_tp.add_column("max", utils::table_printer::alignment::kRight);
+    for (size_t code = 0; code < _code_body_sizes.size(); code++) {
+        rpc_size_histogram *h = _code_body_sizes[code].load(std::memory_order_acquire);
+        uint64_t samples = h == nullptr ? 0 : h->count();
+        if (samples == 0) {
+            continue;
+        }
+        codes_tp.add_row(task_code(static_cast<int>(code)).to_string());
+        codes_tp.append_data(samples);
+        codes_tp.append_data(h->sum() / samples);
+        codes_tp.append_data(h->percentile(50));
+        codes_tp.append_data(h->percentile(99));
+        codes_tp.append_data(h->max());
+    }
+
+    // the sessions to the same remote address are summed up, and the server sessions by the
+    // hosts of the clients, of which the ports are ephemeral
+    struct remote_stats
+    {
+        uint64_t sessions = 0;
+        uint64_t recv_bytes = 0;
+        uint64_t sent_bytes = 0;
+        uint64_t recv_bytes_per_sec = 0;
+        uint64_t sent_bytes_per_sec = 0;
+        rpc_size_histogram body_sizes;
+    };
+    std::unordered_map<rpc_address, remote_stats> remotes;
+    uint64_t now_ms = dsn_now_ms();
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        for (rpc_session_size_stats *s : _sessions) {
+            uint64_t recv = s->recv_bytes.load(std::memory_order_relaxed);
+            uint64_t sent = s->sent_bytes.load(std::memory_order_relaxed);
+            uint64_t elapsed_ms = std::max<uint64_t>(now_ms - s->last_report_ms, 1);
+
+            remote_stats &r = remotes[s->is_client ? s->remote_address
+                                                   : rpc_address(s->remote_address.ip(), 0)];
+            r.sessions++;
+            r.recv_bytes += recv;
+            r.sent_bytes += sent;
+            r.recv_bytes_per_sec += (recv - s->last_report_recv_bytes) * 1000 / elapsed_ms;
+            r.sent_bytes_per_sec += (sent - s->last_report_sent_bytes) * 1000 / elapsed_ms;
+            r.body_sizes.merge(s->body_sizes);
+
+            s->last_report_recv_bytes = recv;
+            s->last_report_sent_bytes = sent;
+            s->last_report_ms = now_ms;
+        }
+    }
+
+    std::vector<std::pair<rpc_address, remote_stats *>> sorted;
+    sorted.reserve(remotes.size());
+    for (auto &kv : remotes) {
+        sorted.emplace_back(kv.first, &kv.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+        return a.second->recv_bytes_per_sec + a.second->sent_bytes_per_sec >
+               b.second->recv_bytes_per_sec + b.second->sent_bytes_per_sec;
+    });
+    if (top_n >= 0 && sorted.size() > static_cast<size_t>(top_n)) {
+        sorted.resize(top_n);
+    }
+
+    utils::table_printer remotes_tp("top_remote_addresses");
+    remotes_tp.add_title("remote_address");
+    remotes_tp.add_column("sessions", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("recv_bytes_per_sec", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("sent_bytes_per_sec", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("recv_bytes", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("sent_bytes", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("body_p50", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("body_p99", utils::table_printer::alignment::kRight);
+    remotes_tp.add_column("body_max", utils::table_printer::alignment::kRight);
+    for (const auto &kv : sorted) {
+        const remote_stats &r = *kv.second;
+        remotes_tp.add_row(kv.first.to_std_string());
+        remotes_tp.append_data(r.sessions);
+        remotes_tp.append_data(r.recv_bytes_per_sec);
+        remotes_tp.append_data(r.sent_bytes_per_sec);
+        remotes_tp.append_data(r.recv_bytes);
+        remotes_tp.append_data(r.sent_bytes);
+        remotes_tp.append_data(r.body_sizes.percentile(50));
+        remotes_tp.append_data(r.body_sizes.percentile(99));
+        remotes_tp.append_data(r.body_sizes.max());
+    }
+
+    out.add(std::move(codes_tp));
+    out.add(std::move(remotes_tp));
+}
+
+} // namespace dsn
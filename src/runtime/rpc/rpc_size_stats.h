@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/rpc_address.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/synchronize.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/singleton.h>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace dsn {
+
+// A lock-free histogram of message body sizes with one bucket for every power of two.
+class rpc_size_histogram
+{
+public:
+    void add(uint64_t size)
+    {
+        _buckets[index(size)].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(size, std::memory_order_relaxed);
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while (size > max && !_max.compare_exchange_weak(max, size, std::memory_order_relaxed)) {
+        }
+    }
+
+    // add all the samples of `other` to this one
+    void merge(const rpc_size_histogram &other);
+
+    uint64_t count() const;
+    uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+    // Returns the upper bound of the bucket which the `p`-th percentile falls into, capped by
+    // the max, 0 if there is no sample.
+    uint64_t percentile(double p) const;
+
+private:
+    // bucket i holds the sizes in [2^(i-1), 2^i), and bucket 0 holds 0
+    static int index(uint64_t size) { return size == 0 ? 0 : 64 - __builtin_clzll(size); }
+
+    static const int kBucketCount = 65;
+    std::atomic<uint64_t> _buckets[kBucketCount] = {};
+    std::atomic<uint64_t> _sum{0};
+    std::atomic<uint64_t> _max{0};
+};
+
+// The size statistics of the messages of an rpc session, the body bytes are counted for every
+// message, and the body sizes are sampled, see [network] rpc_size_stats_sample_interval.
+struct rpc_session_size_stats
+{
+    rpc_session_size_stats(rpc_address remote, bool is_client)
+        : remote_address(remote), is_client(is_client)
+    {
+    }
+
+    const rpc_address remote_address;
+    const bool is_client;
+    std::atomic<uint64_t> recv_bytes{0};
+    std::atomic<uint64_t> sent_bytes{0};
+    rpc_size_histogram body_sizes;
+
+    // the counters at the last report, from which the rates are derived, under the lock of
+    // rpc_size_stats
+    uint64_t last_report_recv_bytes = 0;
+    uint64_t last_report_sent_bytes = 0;
+    uint64_t last_report_ms = 0;
+};
+
+// Collects the size statistics of the messages received and sent by all the rpc sessions of
+// the process, by the sessions and by the task codes.
+class rpc_size_stats : public utils::singleton<rpc_size_stats>
+{
+public:
+    // the stats of a session are counted only when it's registered
+    std::unique_ptr<rpc_session_size_stats> register_session(rpc_address remote, bool is_client);
+    void unregister_session(rpc_session_size_stats *stats);
+
+    void on_message(rpc_session_size_stats &stats, message_ex *msg, bool is_send)
+    {
+        uint64_t size = msg->body_size();
+        (is_send ? stats.sent_bytes : stats.recv_bytes).fetch_add(size, std::memory_order_relaxed);
+        if (should_sample()) {
+            on_sampled_message(stats, msg, size);
+        }
+    }
+
+    // outputs the body sizes of the task codes, and the top `top_n` remote addresses by the
+    // bytes per second since the last call
+    void get_stats(int top_n, utils::multi_table_printer &out);
+
+private:
+    rpc_size_stats();
+    friend class utils::singleton<rpc_size_stats>;
+
+    static bool should_sample();
+    void on_sampled_message(rpc_session_size_stats &stats, message_ex *msg, uint64_t size);
+
+    std::vector<std::atomic<rpc_size_histogram *>> _code_body_sizes; // by task code
+
+    utils::ex_lock_nr _lock;
+    std::unordered_set<rpc_session_size_stats *> _sessions;
+};
+
+} // namespace dsn
@@ -25,7 +25,10 @@
  */
 
 #include "runtime/task/task_engine.h"
+#include "runtime/rpc/rpc_engine.h"
+#include "runtime/service_engine.h"
 #include <dsn/tool-api/task.h>
+#include <dsn/utils/latency_tracer.h>
 
 namespace dsn {
 
@@ -50,11 +53,54 @@ rpc_request_task::~rpc_request_task()
 void rpc_request_task::enqueue()
 {
     if (spec().rpc_request_dropped_before_execution_when_timeout) {
-        _enqueue_ts_ns = dsn_now_ns();
+        _enqueue_ts_ns = dsn_now_coarse_ns();
     }
     task::enqueue(node()->computation()->get_pool(spec().pool_code));
 }
 
+void rpc_request_task::on_dropped_for_timeout()
+{
+    dwarn("rpc_request_task(%s) from(%s) stop to execute due to timeout_ms(%d) exceed",
+          spec().name.c_str(),
+          _request->header->from_address.to_string(),
+          _request->header->client.timeout_ms);
+
+    if (spec().rpc_request_dropped_counter != nullptr) {
+        spec().rpc_request_dropped_counter->increment();
+    }
+
+    if (spec().rpc_request_reply_timeout_when_dropped) {
+        auto resp = _request->create_response();
+        task::get_current_rpc()->reply(resp, ERR_TIMEOUT);
+    }
+}
+
+void rpc_request_task::exec_traced()
+{
+    // the sampled bit is set by the client, which doesn't turn the tracing on for this node
+    if (!utils::FLAGS_enable_latency_tracer) {
+        _handler(_request);
+        return;
+    }
+
+    const auto &hdr = *_request->header;
+    utils::trace_span span;
+    span.context.trace_id = hdr.trace_id;
+    span.context.span_id = utils::trace_context::new_span_id();
+    span.context.parent_span_id = hdr.context.u.parent_span_id;
+    span.context.sampled = true;
+    span.name = hdr.rpc_name;
+    span.node = node()->rpc()->primary_address().to_std_string();
+    span.start_ns = dsn_now_ns();
+    {
+        // the rpcs sent by the handler, and the tracers it creates, are children of the span
+        utils::trace_context_scope scope(span.context);
+        _handler(_request);
+    }
+    span.end_ns = dsn_now_ns();
+    utils::export_trace_span(span);
+}
+
 rpc_response_task::rpc_response_task(message_ex *request,
                                      const rpc_response_handler &cb,
                                      int hash,
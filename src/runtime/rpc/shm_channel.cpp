@@ -0,0 +1,211 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "shm_channel.h"
+
+#include <dsn/c/api_utilities.h>
+#include <algorithm>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+void shm_ring::attach(void *base, uint32_t capacity)
+{
+    _ctrl = reinterpret_cast<shm_ring_control *>(base);
+    _data = reinterpret_cast<char *>(base) + sizeof(shm_ring_control);
+    _capacity = capacity;
+}
+
+size_t shm_ring::write(const char *buf, size_t len)
+{
+    uint64_t head = _ctrl->head.load(std::memory_order_relaxed);
+    uint64_t tail = _ctrl->tail.load(std::memory_order_acquire);
+    size_t n = std::min(len, (size_t)(_capacity - (head - tail)));
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t pos = head & (_capacity - 1);
+    size_t first = std::min(n, (size_t)_capacity - pos);
+    memcpy(_data + pos, buf, first);
+    memcpy(_data, buf + first, n - first);
+
+    // seq_cst to be ordered before reading reader_waiting in take_reader_waiting()
+    _ctrl->head.store(head + n, std::memory_order_seq_cst);
+    return n;
+}
+
+size_t shm_ring::read(char *buf, size_t len)
+{
+    uint64_t tail = _ctrl->tail.load(std::memory_order_relaxed);
+    uint64_t head = _ctrl->head.load(std::memory_order_acquire);
+    size_t n = std::min(len, (size_t)(head - tail));
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t pos = tail & (_capacity - 1);
+    size_t first = std::min(n, (size_t)_capacity - pos);
+    memcpy(buf, _data + pos, first);
+    memcpy(buf + first, _data, n - first);
+
+    _ctrl->tail.store(tail + n, std::memory_order_seq_cst);
+    return n;
+}
+
+bool shm_ring::prepare_read_wait()
+{
+    _ctrl->reader_waiting.store(1, std::memory_order_seq_cst);
+    if (_ctrl->head.load(std::memory_order_seq_cst) !=
+        _ctrl->tail.load(std::memory_order_relaxed)) {
+        _ctrl->reader_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool shm_ring::prepare_write_wait()
+{
+    _ctrl->writer_waiting.store(1, std::memory_order_seq_cst);
+    if (_ctrl->head.load(std::memory_order_relaxed) - _ctrl->tail.load(std::memory_order_seq_cst) <
+        _capacity) {
+        _ctrl->writer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool shm_ring::take_reader_waiting()
+{
+    return _ctrl->reader_waiting.load(std::memory_order_seq_cst) != 0 &&
+           _ctrl->reader_waiting.exchange(0) != 0;
+}
+
+bool shm_ring::take_writer_waiting()
+{
+    return _ctrl->writer_waiting.load(std::memory_order_seq_cst) != 0 &&
+           _ctrl->writer_waiting.exchange(0) != 0;
+}
+
+shm_channel::shm_channel(bool is_client, uint32_t ring_capacity)
+    : _is_client(is_client), _ring_capacity(ring_capacity)
+{
+}
+
+shm_channel::~shm_channel()
+{
+    if (_base != nullptr) {
+        ::munmap(_base, _size);
+    }
+    for (int fd : {_mem_fd, _client_event_fd, _server_event_fd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool shm_channel::map()
+{
+    _size = shm_ring::memory_size(_ring_capacity) * 2;
+    void *base = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _mem_fd, 0);
+    if (base == MAP_FAILED) {
+        derror("mmap the shared memory failed, error = %s", strerror(errno));
+        return false;
+    }
+    _base = base;
+
+    // the client-to-server ring comes first
+    char *c2s = reinterpret_cast<char *>(_base);
+    char *s2c = c2s + shm_ring::memory_size(_ring_capacity);
+    _tx.attach(_is_client ? c2s : s2c, _ring_capacity);
+    _rx.attach(_is_client ? s2c : c2s, _ring_capacity);
+    return true;
+}
+
+/*static*/ std::unique_ptr<shm_channel> shm_channel::create(uint32_t ring_capacity)
+{
+    dassert((ring_capacity & (ring_capacity - 1)) == 0,
+            "shm ring capacity(%u) must be a power of 2",
+            ring_capacity);
+
+    std::unique_ptr<shm_channel> channel(new shm_channel(true, ring_capacity));
+    channel->_mem_fd = ::memfd_create("rdsn-shm", MFD_CLOEXEC);
+    if (channel->_mem_fd < 0) {
+        derror("memfd_create failed, error = %s", strerror(errno));
+        return nullptr;
+    }
+    // the memory is zero-filled, so are the controls of the rings
+    if (::ftruncate(channel->_mem_fd, shm_ring::memory_size(ring_capacity) * 2) < 0) {
+        derror("ftruncate the shared memory failed, error = %s", strerror(errno));
+        return nullptr;
+    }
+
+    channel->_client_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    channel->_server_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (channel->_client_event_fd < 0 || channel->_server_event_fd < 0) {
+        derror("eventfd failed, error = %s", strerror(errno));
+        return nullptr;
+    }
+
+    if (!channel->map()) {
+        return nullptr;
+    }
+    return channel;
+}
+
+/*static*/ std::unique_ptr<shm_channel> shm_channel::attach(int mem_fd,
+                                                            int client_event_fd,
+                                                            int server_event_fd,
+                                                            uint32_t ring_capacity)
+{
+    std::unique_ptr<shm_channel> channel(new shm_channel(false, ring_capacity));
+    channel->_mem_fd = mem_fd;
+    channel->_client_event_fd = client_event_fd;
+    channel->_server_event_fd = server_event_fd;
+
+    if ((ring_capacity & (ring_capacity - 1)) != 0 || ring_capacity == 0) {
+        derror("invalid shm ring capacity %u", ring_capacity);
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(mem_fd, &st) < 0 || (size_t)st.st_size < shm_ring::memory_size(ring_capacity) * 2) {
+        derror("the shared memory is smaller than expected");
+        return nullptr;
+    }
+
+    if (!channel->map()) {
+        return nullptr;
+    }
+    return channel;
+}
+
+void shm_channel::notify_peer()
+{
+    uint64_t one = 1;
+    int fd = _is_client ? _server_event_fd : _client_event_fd;
+    if (::write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        dwarn("notify the shm peer failed, error = %s", strerror(errno));
+    }
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,119 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dsn {
+namespace tools {
+
+// A single-producer single-consumer byte ring in shared memory, which carries a byte stream
+// just like a TCP connection does. The head and tail are the total bytes ever written and read.
+//
+// The waiting flags tell the peer to notify: the consumer sets reader_waiting before it waits
+// for data, and the producer notifies it after publishing the data if the flag is set, and vice
+// versa for the space.
+struct shm_ring_control
+{
+    std::atomic<uint64_t> head;
+    char padding1[56];
+    std::atomic<uint64_t> tail;
+    char padding2[56];
+    std::atomic<uint32_t> reader_waiting;
+    std::atomic<uint32_t> writer_waiting;
+    char padding3[56];
+};
+
+class shm_ring
+{
+public:
+    shm_ring() : _ctrl(nullptr), _data(nullptr), _capacity(0) {}
+
+    // `base` points to a shm_ring_control followed by `capacity` bytes of data,
+    // `capacity` must be a power of 2
+    void attach(void *base, uint32_t capacity);
+
+    static size_t memory_size(uint32_t capacity) { return sizeof(shm_ring_control) + capacity; }
+
+    // the producer side, returns the count of bytes written, which may be less than `len`
+    size_t write(const char *buf, size_t len);
+    // the consumer side, returns the count of bytes read
+    size_t read(char *buf, size_t len);
+
+    // returns true if the caller should wait for the peer to notify, or false if the data or
+    // space is already available
+    bool prepare_read_wait();
+    bool prepare_write_wait();
+
+    // returns true if the peer is waiting and should be notified, the flag is cleared
+    bool take_reader_waiting();
+    bool take_writer_waiting();
+
+private:
+    shm_ring_control *_ctrl;
+    char *_data;
+    uint32_t _capacity;
+};
+
+// The shared memory and the eventfds of a session, one ring for each direction.
+// The memory is a memfd which is passed to the server along with the eventfds.
+class shm_channel
+{
+public:
+    ~shm_channel();
+
+    // created by the client, returns nullptr on failure
+    static std::unique_ptr<shm_channel> create(uint32_t ring_capacity);
+    // attached by the server to the fds received from the client, which are owned by
+    // the channel then, returns nullptr on failure
+    static std::unique_ptr<shm_channel>
+    attach(int mem_fd, int client_event_fd, int server_event_fd, uint32_t ring_capacity);
+
+    shm_ring &tx() { return _tx; }
+    shm_ring &rx() { return _rx; }
+
+    // the eventfd to wait on, which is notified by the peer
+    int event_fd() const { return _is_client ? _client_event_fd : _server_event_fd; }
+    void notify_peer();
+
+    int mem_fd() const { return _mem_fd; }
+    int client_event_fd() const { return _client_event_fd; }
+    int server_event_fd() const { return _server_event_fd; }
+    uint32_t ring_capacity() const { return _ring_capacity; }
+
+private:
+    shm_channel(bool is_client, uint32_t ring_capacity);
+    bool map();
+
+private:
+    const bool _is_client;
+    const uint32_t _ring_capacity;
+    int _mem_fd = -1;
+    int _client_event_fd = -1;
+    int _server_event_fd = -1;
+    void *_base = nullptr;
+    size_t _size = 0;
+    shm_ring _tx;
+    shm_ring _rx;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,233 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "shm_net_provider.h"
+
+#include <dsn/utility/flags.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "shm_rpc_session.h"
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_string("network",
+                  shm_socket_dir,
+                  "/tmp",
+                  "the directory of the unix domain sockets on which the shm sessions are set up");
+DSN_DEFINE_uint32("network",
+                  shm_ring_capacity,
+                  4 * 1024 * 1024,
+                  "the bytes of the shared memory ring of each direction of a shm session, "
+                  "must be a power of 2");
+DSN_DEFINE_validator(shm_ring_capacity, [](uint32_t capacity) -> bool {
+    return capacity > 0 && (capacity & (capacity - 1)) == 0;
+});
+
+shm_network_provider::shm_network_provider(rpc_engine *srv, network *inner_provider)
+    : asio_network_provider(srv, inner_provider), _next_shm_client_port(1)
+{
+}
+
+shm_network_provider::~shm_network_provider()
+{
+    if (_shm_acceptor) {
+        boost::system::error_code ec;
+        _shm_acceptor->close(ec);
+        ::unlink(_shm_socket_path.c_str());
+    }
+}
+
+/*static*/ std::string shm_network_provider::shm_socket_path(uint16_t port)
+{
+    return std::string(FLAGS_shm_socket_dir) + "/rdsn-shm-" + std::to_string(port) + ".sock";
+}
+
+error_code shm_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    error_code err = asio_network_provider::start(channel, port, client_only);
+    if (err != ERR_OK || client_only || _shm_acceptor != nullptr) {
+        return err;
+    }
+
+    // the tcp port is taken by this process now, so the socket file must be a stale one
+    _shm_socket_path = shm_socket_path(_address.port());
+    ::unlink(_shm_socket_path.c_str());
+
+    boost::system::error_code ec;
+    boost::asio::local::stream_protocol::endpoint endpoint(_shm_socket_path);
+    _shm_acceptor.reset(new boost::asio::local::stream_protocol::acceptor(_io_service));
+    _shm_acceptor->open(endpoint.protocol(), ec);
+    if (!ec) {
+        _shm_acceptor->bind(endpoint, ec);
+    }
+    if (!ec) {
+        _shm_acceptor->listen(boost::asio::socket_base::max_connections, ec);
+    }
+    if (ec) {
+        // the peers can still connect with tcp
+        dwarn("shm acceptor listen on %s failed, error = %s",
+              _shm_socket_path.c_str(),
+              ec.message().c_str());
+        _shm_acceptor.reset();
+        ::unlink(_shm_socket_path.c_str());
+        return ERR_OK;
+    }
+
+    do_accept_shm();
+    return ERR_OK;
+}
+
+bool shm_network_provider::is_shm_reachable(::dsn::rpc_address server_addr)
+{
+    if (server_addr.type() != HOST_TYPE_IPV4 ||
+        (server_addr.ip() != _address.ip() && server_addr.ip() != INADDR_LOOPBACK)) {
+        return false;
+    }
+
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+        if (_shm_unavailable.count(server_addr) > 0) {
+            return false;
+        }
+    }
+    return ::access(shm_socket_path(server_addr.port()).c_str(), F_OK) == 0;
+}
+
+void shm_network_provider::mark_shm_unavailable(::dsn::rpc_address server_addr)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+    if (_shm_unavailable.insert(server_addr).second) {
+        dwarn("shm is unavailable for %s, fall back to tcp", server_addr.to_string());
+    }
+}
+
+rpc_session_ptr shm_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    if (!is_shm_reachable(server_addr)) {
+        return asio_network_provider::create_client_session(server_addr);
+    }
+
+    auto socket = std::make_shared<uds_socket>(_io_service);
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    return rpc_session_ptr(
+        new shm_rpc_session(*this, server_addr, socket, nullptr, parser, true));
+}
+
+void shm_network_provider::do_accept_shm()
+{
+    auto socket = std::make_shared<uds_socket>(_io_service);
+
+    _shm_acceptor->async_accept(*socket, [this, socket](boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (!ec) {
+            socket->async_wait(boost::asio::socket_base::wait_read,
+                               [this, socket](boost::system::error_code ec) {
+                                   if (!ec) {
+                                       on_shm_handshake(socket);
+                                   }
+                               });
+        }
+
+        do_accept_shm();
+    });
+}
+
+void shm_network_provider::on_shm_handshake(const std::shared_ptr<uds_socket> &socket)
+{
+    shm_handshake hs;
+    int fds[3] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+
+    iovec iov;
+    iov.iov_base = &hs;
+    iov.iov_len = sizeof(hs);
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = ::recvmsg(socket->native_handle(), &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    int fd_count = 0;
+    if (n > 0) {
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                fd_count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(fds, CMSG_DATA(cm), std::min(fd_count, 3) * sizeof(int));
+                break;
+            }
+        }
+    }
+
+    std::unique_ptr<shm_channel> channel;
+    if (n == (ssize_t)sizeof(hs) && hs.magic == SHM_HANDSHAKE_MAGIC && fd_count == 3) {
+        channel = shm_channel::attach(fds[0], fds[1], fds[2], hs.ring_capacity);
+    } else {
+        derror("invalid shm handshake, length = %d, fd count = %d", (int)n, fd_count);
+        for (int i = 0; i < std::min(fd_count, 3); i++) {
+            ::close(fds[i]);
+        }
+    }
+    if (!channel) {
+        return;
+    }
+
+    uint16_t port = _next_shm_client_port.fetch_add(1);
+    if (port == 0 || port >= 32768) {
+        _next_shm_client_port.store(2);
+        port = 1;
+    }
+    ::dsn::rpc_address client_addr(INADDR_LOOPBACK, port);
+
+    message_parser_ptr null_parser;
+    rpc_session_ptr s =
+        new shm_rpc_session(*this, client_addr, socket, std::move(channel), null_parser, false);
+
+    // when server connection threshold is hit, close the session, otherwise accept it
+    if (check_if_conn_threshold_exceeded(s->remote_address())) {
+        dwarn("close shm rpc connection from %s to %s due to hitting server "
+              "connection threshold per ip",
+              s->remote_address().to_string(),
+              address().to_string());
+        s->close();
+        return;
+    }
+
+    // tell the client that the channel is attached
+    char ack = 1;
+    if (::send(socket->native_handle(), &ack, 1, MSG_NOSIGNAL | MSG_DONTWAIT) != 1) {
+        derror("shm handshake ack to %s failed, error = %s",
+               s->remote_address().to_string(),
+               strerror(errno));
+        s->close();
+        return;
+    }
+
+    on_server_session_accepted(s);
+
+    auto shm_session = static_cast<shm_rpc_session *>(s.get());
+    shm_session->on_established();
+    shm_session->start_read_next();
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_set>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include "asio_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// A network provider for the peers on the same host, which moves the bytes of an rpc session
+// through a pair of rings in shared memory instead of the loopback tcp stack. The sessions
+// are set up through a unix domain socket, which passes the memfd and the eventfds to the
+// server and is kept open to tell the liveness of the peer.
+//
+// The remote peers on other hosts, or the servers not listening for shm sessions, are
+// connected with tcp as asio_network_provider does.
+class shm_network_provider : public asio_network_provider
+{
+public:
+    shm_network_provider(rpc_engine *srv, network *inner_provider);
+
+    ~shm_network_provider() override;
+
+    error_code start(rpc_channel channel, int port, bool client_only) override;
+    rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    // the unix domain socket on which the server of `port` accepts the shm sessions
+    static std::string shm_socket_path(uint16_t port);
+
+    // fall back to tcp for `server_addr` after a shm session failed to connect to it,
+    // e.g. the socket file is left by a dead process
+    void mark_shm_unavailable(::dsn::rpc_address server_addr);
+
+private:
+    typedef boost::asio::local::stream_protocol::socket uds_socket;
+
+    bool is_shm_reachable(::dsn::rpc_address server_addr);
+    void do_accept_shm();
+    void on_shm_handshake(const std::shared_ptr<uds_socket> &socket);
+
+private:
+    friend class shm_rpc_session;
+
+    std::shared_ptr<boost::asio::local::stream_protocol::acceptor> _shm_acceptor;
+    std::string _shm_socket_path;
+    // the server-side shm sessions have no ip address of their own, they are named as
+    // 127.0.0.1 with the ports below the ephemeral ones of tcp
+    std::atomic<uint16_t> _next_shm_client_port;
+
+    ::dsn::utils::ex_lock_nr _shm_lock; // [
+    std::unordered_set<::dsn::rpc_address> _shm_unavailable;
+    // ]
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,387 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "shm_rpc_session.h"
+
+#include <dsn/utility/flags.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DECLARE_uint32(shm_ring_capacity);
+
+shm_rpc_session::shm_rpc_session(
+    shm_network_provider &net,
+    ::dsn::rpc_address remote_addr,
+    const std::shared_ptr<boost::asio::local::stream_protocol::socket> &socket,
+    std::unique_ptr<shm_channel> channel,
+    message_parser_ptr &parser,
+    bool is_client)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _shm_net(net),
+      _socket(socket),
+      _channel(std::move(channel)),
+      _event_value(0),
+      _socket_byte(0),
+      _send_signature(0),
+      _send_index(0),
+      _send_offset(0),
+      _closed(false),
+      _read_waiting(false),
+      _read_next(0),
+      _send_waiting(false)
+{
+}
+
+shm_rpc_session::~shm_rpc_session() { release_send_msgs(); }
+
+void shm_rpc_session::on_established()
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+    if (_closed) {
+        return;
+    }
+
+    int fd = ::dup(_channel->event_fd());
+    if (fd < 0) {
+        derror("dup the eventfd of shm session %s failed, error = %s",
+               _remote_addr.to_string(),
+               strerror(errno));
+        return;
+    }
+    _event.reset(new boost::asio::posix::stream_descriptor(_shm_net._io_service, fd));
+    wait_event();
+    watch_socket();
+}
+
+void shm_rpc_session::wait_event()
+{
+    add_ref();
+    _event->async_read_some(boost::asio::buffer(&_event_value, sizeof(_event_value)),
+                            [this](boost::system::error_code ec, std::size_t length) {
+                                if (!ec) {
+                                    on_event();
+                                }
+                                release_ref();
+                            });
+}
+
+void shm_rpc_session::watch_socket()
+{
+    // nothing is expected on the socket after the handshake, it's readable only when the
+    // peer is gone
+    add_ref();
+    _socket->async_read_some(boost::asio::buffer(&_socket_byte, 1),
+                             [this](boost::system::error_code ec, std::size_t length) {
+                                 if (ec != boost::asio::error::operation_aborted) {
+                                     ddebug("shm session %s is closed by the peer: %s",
+                                            _remote_addr.to_string(),
+                                            ec ? ec.message().c_str() : "unexpected data");
+                                 }
+                                 on_failure();
+                                 release_ref();
+                             });
+}
+
+void shm_rpc_session::on_event()
+{
+    bool resume_read = false;
+    bool resume_send = false;
+    int read_next = 0;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+        if (_closed) {
+            return;
+        }
+        std::swap(resume_read, _read_waiting);
+        std::swap(resume_send, _send_waiting);
+        read_next = _read_next;
+        wait_event();
+    }
+
+    // the references are taken over from the waiting sides
+    if (resume_send) {
+        continue_send();
+    }
+    if (resume_read) {
+        try_read(read_next);
+    }
+}
+
+void shm_rpc_session::do_read(int read_next)
+{
+    // don't process the messages in the stack of the previous ones
+    add_ref();
+    _shm_net._io_service.post([this, read_next]() { try_read(read_next); });
+}
+
+// holds a reference of the session, which is released or passed to the waiting state
+void shm_rpc_session::try_read(int read_next)
+{
+    shm_ring &ring = _channel->rx();
+    while (true) {
+        char *ptr = _reader.read_buffer_ptr(read_next);
+        size_t length = ring.read(ptr, _reader.read_buffer_capacity());
+        if (length > 0) {
+            if (ring.take_writer_waiting()) {
+                _channel->notify_peer();
+            }
+            _reader.mark_read(length);
+
+            read_next = -1;
+            if (!_parser) {
+                read_next = prepare_parser();
+            }
+            if (_parser) {
+                message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+                while (msg != nullptr) {
+                    if (!on_recv_message(msg, 0)) {
+                        on_failure(false);
+                    }
+                    msg = _parser->get_message_on_receive(&_reader, read_next);
+                }
+            }
+
+            if (read_next == -1) {
+                derror("shm read from %s failed", _remote_addr.to_string());
+                on_failure();
+            } else {
+                start_read_next(read_next);
+            }
+            release_ref();
+            return;
+        }
+
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+            if (_closed) {
+                break;
+            }
+            if (ring.prepare_read_wait()) {
+                _read_waiting = true;
+                _read_next = read_next;
+                return;
+            }
+        }
+    }
+    release_ref();
+}
+
+void shm_rpc_session::send(uint64_t signature)
+{
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        for (auto &msg : _sending_msgs) {
+            msg->add_ref();
+            _send_msgs.push_back(msg);
+        }
+    }
+    _send_signature = signature;
+    _send_bufs = _sending_buffers;
+    _send_index = 0;
+    _send_offset = 0;
+
+    add_ref();
+    continue_send();
+}
+
+// holds a reference of the session, which is released or passed to the waiting state
+void shm_rpc_session::continue_send()
+{
+    shm_ring &ring = _channel->tx();
+    while (_send_index < _send_bufs.size()) {
+        auto &buf = _send_bufs[_send_index];
+        size_t length =
+            ring.write(static_cast<const char *>(buf.buf) + _send_offset, buf.sz - _send_offset);
+        if (length > 0) {
+            if (ring.take_reader_waiting()) {
+                _channel->notify_peer();
+            }
+            _send_offset += length;
+            if (_send_offset == buf.sz) {
+                _send_index++;
+                _send_offset = 0;
+            }
+            continue;
+        }
+
+        // the ring is full
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+            if (_closed) {
+                break;
+            }
+            if (ring.prepare_write_wait()) {
+                _send_waiting = true;
+                return;
+            }
+        }
+    }
+
+    release_send_msgs();
+    if (_send_index < _send_bufs.size()) {
+        derror("shm write to %s failed: session closed", _remote_addr.to_string());
+        on_failure(true);
+    } else {
+        on_send_completed(_send_signature);
+    }
+    release_ref();
+}
+
+void shm_rpc_session::release_send_msgs()
+{
+    for (auto &msg : _send_msgs) {
+        msg->release_ref();
+    }
+    _send_msgs.clear();
+}
+
+void shm_rpc_session::close()
+{
+    bool read_waiting = false;
+    bool send_waiting = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+        if (_closed) {
+            return;
+        }
+        _closed = true;
+        std::swap(read_waiting, _read_waiting);
+        std::swap(send_waiting, _send_waiting);
+
+        // the pending handlers are cancelled, and the peer sees the eof of the socket
+        boost::system::error_code ec;
+        _socket->shutdown(boost::asio::socket_base::shutdown_type::shutdown_both, ec);
+        _socket->close(ec);
+        if (ec)
+            dwarn("shm socket close failed, error = %s", ec.message().c_str());
+        if (_event) {
+            _event->close(ec);
+        }
+    }
+
+    // the references held by the waiting sides
+    if (send_waiting) {
+        release_send_msgs();
+        release_ref();
+    }
+    if (read_waiting) {
+        release_ref();
+    }
+}
+
+bool shm_rpc_session::send_handshake()
+{
+    shm_handshake hs;
+    hs.magic = SHM_HANDSHAKE_MAGIC;
+    hs.ring_capacity = _channel->ring_capacity();
+
+    int fds[3] = {_channel->mem_fd(), _channel->client_event_fd(), _channel->server_event_fd()};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    iovec iov;
+    iov.iov_base = &hs;
+    iov.iov_len = sizeof(hs);
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    // the socket buffer of a new connection always has room for the small handshake
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(_socket->native_handle(), &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != (ssize_t)sizeof(hs)) {
+        derror("shm handshake to %s failed, error = %s",
+               _remote_addr.to_string(),
+               sent < 0 ? strerror(errno) : "partial write");
+        return false;
+    }
+    return true;
+}
+
+void shm_rpc_session::on_connect_failed()
+{
+    _shm_net.mark_shm_unavailable(_remote_addr);
+    on_failure(true);
+}
+
+void shm_rpc_session::connect()
+{
+    if (!set_connecting()) {
+        return;
+    }
+
+    _channel = shm_channel::create(FLAGS_shm_ring_capacity);
+    if (!_channel) {
+        on_connect_failed();
+        return;
+    }
+
+    boost::asio::local::stream_protocol::endpoint ep(
+        shm_network_provider::shm_socket_path(_remote_addr.port()));
+
+    add_ref();
+    utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+    _socket->async_connect(ep, [this](boost::system::error_code ec) {
+        if (ec || !send_handshake()) {
+            derror("shm session connect to %s failed, error = %s",
+                   _remote_addr.to_string(),
+                   ec ? ec.message().c_str() : "handshake failed");
+            on_connect_failed();
+            release_ref();
+            return;
+        }
+
+        // wait for the server to attach to the channel
+        utils::auto_lock<utils::ex_lock_nr> l(_shm_lock);
+        boost::asio::async_read(
+            *_socket,
+            boost::asio::buffer(&_socket_byte, 1),
+            [this](boost::system::error_code ec, std::size_t length) {
+                if (ec) {
+                    derror("shm session connect to %s failed, error = %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                    on_connect_failed();
+                } else {
+                    dinfo("client shm session %s connected", _remote_addr.to_string());
+
+                    on_established();
+                    set_connected();
+                    on_send_completed();
+                    start_read_next();
+                }
+                release_ref();
+            });
+    });
+}
+
+} // namespace tools
+} // namespace dsn
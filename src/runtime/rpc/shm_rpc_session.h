@@ -0,0 +1,106 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/message_parser.h>
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <memory>
+
+#include "shm_channel.h"
+#include "shm_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// the first message on the unix domain socket, sent by the client along with the fds of
+// the memfd, the client eventfd and the server eventfd
+struct shm_handshake
+{
+    uint32_t magic;
+    uint32_t ring_capacity;
+};
+
+#define SHM_HANDSHAKE_MAGIC 0x6d687364 // "dshm"
+
+// An rpc session through the shared memory rings of a shm_channel.
+// Thread-safe
+class shm_rpc_session : public rpc_session
+{
+public:
+    shm_rpc_session(shm_network_provider &net,
+                    ::dsn::rpc_address remote_addr,
+                    const std::shared_ptr<boost::asio::local::stream_protocol::socket> &socket,
+                    std::unique_ptr<shm_channel> channel,
+                    message_parser_ptr &parser,
+                    bool is_client);
+
+    ~shm_rpc_session() override;
+
+    void send(uint64_t signature) override;
+
+    void close() override;
+
+    void connect() override;
+
+    // start to watch the eventfd and the unix domain socket once the channel is shared
+    void on_established();
+
+private:
+    void do_read(int read_next) override;
+    void try_read(int read_next);
+    void continue_send();
+    void release_send_msgs();
+    void on_event();
+    bool send_handshake();
+    void on_connect_failed();
+
+    // the following should be called with _shm_lock held
+    void wait_event();
+    void watch_socket();
+
+private:
+    shm_network_provider &_shm_net;
+    std::shared_ptr<boost::asio::local::stream_protocol::socket> _socket;
+    std::unique_ptr<shm_channel> _channel;
+    // a dup of the eventfd of this side, which is owned by the descriptor
+    std::unique_ptr<boost::asio::posix::stream_descriptor> _event;
+    uint64_t _event_value;
+    char _socket_byte;
+
+    // the current batch of send(), the messages are referenced until the batch is written
+    // to the ring, because _sending_msgs is cleared once the session is disconnected
+    uint64_t _send_signature;
+    std::vector<message_parser::send_buf> _send_bufs;
+    std::vector<message_ex *> _send_msgs;
+    size_t _send_index;
+    size_t _send_offset;
+
+    ::dsn::utils::ex_lock_nr _shm_lock; // [
+    bool _closed;
+    // waiting for the peer to write data or to free space, a reference of the session
+    // is held by each of the waiting sides
+    bool _read_waiting;
+    int _read_next;
+    bool _send_waiting;
+    // ]
+};
+
+} // namespace tools
+} // namespace dsn
@@ -34,9 +34,17 @@
 #include <dsn/utility/crc.h>
 #include <dsn/utility/endians.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 
+DSN_DEFINE_bool("core",
+                thrift_zero_copy_blob_decode,
+                true,
+                "whether the blob fields decoded in thrift binary protocol reference the buffer "
+                "being decoded rather than copy it, which keeps the whole buffer alive as long as "
+                "the blobs are");
+
 //                 //
 // Request Parsing //
 //                 //
@@ -199,7 +207,8 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
         return nullptr;
     }
 
-    message_ex *msg = create_message_from_request_blob(buf);
+    // the blob fields decoded from the message reference its body only
+    message_ex *msg = create_message_from_request_blob(buf.range(0, _meta_v0->body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
@@ -246,7 +255,8 @@ message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader,
         read_next = _v1_specific_vars->_body_length - buf.size();
         return nullptr;
     }
-    message_ex *msg = create_message_from_request_blob(buf);
+    message_ex *msg =
+        create_message_from_request_blob(buf.range(0, _v1_specific_vars->_body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
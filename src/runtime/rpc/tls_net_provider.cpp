@@ -0,0 +1,290 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "tls_net_provider.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include "tls_rpc_session.h"
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_string("network",
+                  tls_cert_file,
+                  "",
+                  "the PEM certificate chain of this process, presented as both a tls server "
+                  "and a tls client");
+DSN_DEFINE_string("network", tls_key_file, "", "the PEM private key of tls_cert_file");
+DSN_DEFINE_string("network",
+                  tls_ca_file,
+                  "",
+                  "the PEM certificates of the CAs of the cluster to verify the tls peers with, "
+                  "required by tls_verify_peer; the CAs of the system are never trusted");
+DSN_DEFINE_bool("network",
+                tls_verify_peer,
+                true,
+                "whether to require and verify the certificates of the tls peers, on both "
+                "the client and the server side");
+DSN_DEFINE_bool("network",
+                tls_verify_peer_ip,
+                false,
+                "whether a tls client also requires the certificate of the server to name its "
+                "ip in the subject alternative names, only with tls_verify_peer");
+DSN_DEFINE_string("network",
+                  tls_ciphersuites,
+                  "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256",
+                  "the TLSv1.3 cipher suites in the order of preference, the AES-GCM ones are "
+                  "supported by kTLS on most kernels");
+DSN_DEFINE_string("network",
+                  tls_cipher_list,
+                  "ECDHE+AESGCM:ECDHE+CHACHA20",
+                  "the TLSv1.2 ciphers in the format of `openssl ciphers`");
+DSN_DEFINE_bool("network",
+                tls_enable_ktls,
+                true,
+                "whether to hand the keys to the kernel after the tls handshake, if both "
+                "OpenSSL and the kernel support it");
+DSN_DEFINE_string("network",
+                  tls_plaintext_subnets,
+                  "",
+                  "the ipv4 subnets whose peers are connected without tls, separated by "
+                  "comma, e.g. 10.1.2.0/24; a server still accepts tls from them");
+
+static void log_ssl_errors(const char *what)
+{
+    unsigned long e;
+    while ((e = ERR_get_error()) != 0) {
+        char buf[256];
+        ERR_error_string_n(e, buf, sizeof(buf));
+        derror("%s: %s", what, buf);
+    }
+}
+
+SSL_CTX *tls_network_provider::create_context(bool is_server)
+{
+    SSL_CTX *ctx = SSL_CTX_new(is_server ? TLS_server_method() : TLS_client_method());
+    if (ctx == nullptr) {
+        log_ssl_errors("create SSL_CTX failed");
+        return nullptr;
+    }
+
+    // the kernel keeps no state for a renegotiation, and OpenSSL hands the keys of
+    // TLSv1.2 to the kernel in more versions than the ones of TLSv1.3
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION);
+    // SSL_write() returns once a record is written, so a send can go on from where it stops
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    // the sessions are long-lived, and a NewSessionTicket after the handshake would be an
+    // unexpected record for a client with kTLS rx
+    SSL_CTX_set_num_tickets(ctx, 0);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (FLAGS_tls_enable_ktls) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+
+    bool ok = SSL_CTX_set_ciphersuites(ctx, FLAGS_tls_ciphersuites) == 1 &&
+              SSL_CTX_set_cipher_list(ctx, FLAGS_tls_cipher_list) == 1;
+    if (ok && strlen(FLAGS_tls_cert_file) > 0) {
+        ok = SSL_CTX_use_certificate_chain_file(ctx, FLAGS_tls_cert_file) == 1 &&
+             SSL_CTX_use_PrivateKey_file(ctx, FLAGS_tls_key_file, SSL_FILETYPE_PEM) == 1 &&
+             SSL_CTX_check_private_key(ctx) == 1;
+    } else if (ok && is_server) {
+        derror("[network] tls_cert_file is required by a tls server");
+        ok = false;
+    }
+    if (ok && FLAGS_tls_verify_peer) {
+        // only the CAs of the cluster are trusted, as any certificate of a public CA would
+        // otherwise be accepted as a peer
+        if (strlen(FLAGS_tls_ca_file) == 0) {
+            derror("[network] tls_ca_file is required by tls_verify_peer");
+            ok = false;
+        } else {
+            ok = SSL_CTX_load_verify_locations(ctx, FLAGS_tls_ca_file, nullptr) == 1;
+        }
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
+    }
+    if (!ok) {
+        log_ssl_errors("configure SSL_CTX failed");
+        SSL_CTX_free(ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+tls_network_provider::tls_network_provider(rpc_engine *srv, network *inner_provider)
+    : asio_network_provider(srv, inner_provider), _client_ctx(nullptr), _server_ctx(nullptr)
+{
+    std::vector<std::string> subnets;
+    utils::split_args(FLAGS_tls_plaintext_subnets, subnets, ',');
+    for (const auto &subnet : subnets) {
+        std::string ip = subnet;
+        uint32_t prefix = 32;
+        size_t slash = subnet.find('/');
+        if (slash != std::string::npos) {
+            ip = subnet.substr(0, slash);
+            if (!buf2uint32(subnet.substr(slash + 1), prefix) || prefix > 32) {
+                prefix = UINT32_MAX;
+            }
+        }
+        in_addr addr;
+        if (prefix == UINT32_MAX || inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+            dwarn("invalid subnet \"%s\" in [network] tls_plaintext_subnets", subnet.c_str());
+            continue;
+        }
+        uint32_t mask = prefix == 0 ? 0 : UINT32_MAX << (32 - prefix);
+        _plaintext_subnets.push_back(ipv4_subnet{ntohl(addr.s_addr) & mask, mask});
+    }
+
+    _client_ctx = create_context(false);
+    if (_client_ctx == nullptr) {
+        derror("the tls client sessions are unavailable as the SSL_CTX isn't configured");
+    }
+}
+
+tls_network_provider::~tls_network_provider()
+{
+    if (_client_ctx != nullptr) {
+        SSL_CTX_free(_client_ctx);
+    }
+    if (_server_ctx != nullptr) {
+        SSL_CTX_free(_server_ctx);
+    }
+}
+
+error_code tls_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    if (_client_ctx == nullptr) {
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    if (!client_only && _server_ctx == nullptr) {
+        _server_ctx = create_context(true);
+        if (_server_ctx == nullptr) {
+            return ERR_NETWORK_INIT_FAILED;
+        }
+    }
+    return asio_network_provider::start(channel, port, client_only);
+}
+
+bool tls_network_provider::is_plaintext_peer(::dsn::rpc_address addr) const
+{
+    if (addr.type() != HOST_TYPE_IPV4) {
+        return false;
+    }
+    for (const auto &subnet : _plaintext_subnets) {
+        if ((addr.ip() & subnet.mask) == subnet.network) {
+            return true;
+        }
+    }
+    return false;
+}
+
+rpc_session_ptr tls_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    if (is_plaintext_peer(server_addr)) {
+        return asio_network_provider::create_client_session(server_addr);
+    }
+
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    // the session fails to connect if the SSL_CTX is unavailable
+    SSL *ssl = _client_ctx == nullptr ? nullptr : SSL_new(_client_ctx);
+    if (ssl != nullptr && FLAGS_tls_verify_peer && FLAGS_tls_verify_peer_ip &&
+        server_addr.type() == HOST_TYPE_IPV4) {
+        uint32_t ip = htonl(server_addr.ip());
+        X509_VERIFY_PARAM_set1_ip(
+            SSL_get0_param(ssl), reinterpret_cast<const unsigned char *>(&ip), sizeof(ip));
+    }
+    return rpc_session_ptr(new tls_rpc_session(*this, server_addr, socket, ssl, parser, true));
+}
+
+void tls_network_provider::on_socket_accepted(
+    const std::shared_ptr<boost::asio::ip::tcp::socket> &socket, ::dsn::rpc_address client_addr)
+{
+    if (!is_plaintext_peer(client_addr)) {
+        start_server_handshake(socket, client_addr);
+        return;
+    }
+
+    // a plaintext peer may still be configured to connect with tls, which is told by the
+    // first byte, a ClientHello starts with the handshake record type
+    socket->async_wait(boost::asio::socket_base::wait_read,
+                       [this, socket, client_addr](boost::system::error_code ec) {
+                           if (!ec) {
+                               on_first_bytes(socket, client_addr);
+                           }
+                       });
+}
+
+void tls_network_provider::on_first_bytes(
+    const std::shared_ptr<boost::asio::ip::tcp::socket> &socket, ::dsn::rpc_address client_addr)
+{
+    uint8_t first_byte = 0;
+    ssize_t n = ::recv(socket->native_handle(), &first_byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n <= 0) {
+        boost::system::error_code ec;
+        socket->close(ec);
+        return;
+    }
+
+    const uint8_t TLS_RECORD_HANDSHAKE = 0x16;
+    if (first_byte == TLS_RECORD_HANDSHAKE) {
+        start_server_handshake(socket, client_addr);
+    } else {
+        asio_network_provider::on_socket_accepted(socket, client_addr);
+    }
+}
+
+void tls_network_provider::start_server_handshake(
+    const std::shared_ptr<boost::asio::ip::tcp::socket> &socket, ::dsn::rpc_address client_addr)
+{
+    SSL *ssl = SSL_new(_server_ctx);
+    if (ssl == nullptr) {
+        log_ssl_errors("create SSL failed");
+        boost::system::error_code ec;
+        socket->close(ec);
+        return;
+    }
+
+    message_parser_ptr null_parser;
+    rpc_session_ptr s =
+        new tls_rpc_session(*this,
+                            client_addr,
+                            (std::shared_ptr<boost::asio::ip::tcp::socket> &)socket,
+                            ssl,
+                            null_parser,
+                            false);
+    auto session = static_cast<tls_rpc_session *>(s.get());
+    session->handshake([this, s](bool succeed) {
+        if (succeed) {
+            accept_server_session(s);
+        } else {
+            s->close();
+        }
+    });
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <openssl/ssl.h>
+
+#include "asio_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// A network provider which encrypts the rpc sessions with TLS. The handshake is done by
+// OpenSSL in user space, after which the keys are handed to the kernel (kTLS) if both the
+// OpenSSL build and the kernel support it, so the sessions send and receive the plaintext
+// with the plain socket calls as asio_rpc_session does. Where the NIC supports TLS offload
+// and it's enabled by ethtool, the kernel moves the crypto to the NIC by itself. Without
+// kTLS the bytes are encrypted and decrypted by OpenSSL in user space.
+//
+// The provider is chosen per channel and port like the other providers, e.g.
+//
+//   [apps.replica]
+//   network.server.34801.RPC_CHANNEL_TCP = dsn::tools::tls_network_provider, 65536
+//
+// The peers in [network] tls_plaintext_subnets, e.g. the ones of the same rack, are
+// connected, and accepted, without TLS.
+class tls_network_provider : public asio_network_provider
+{
+public:
+    tls_network_provider(rpc_engine *srv, network *inner_provider);
+
+    ~tls_network_provider() override;
+
+    error_code start(rpc_channel channel, int port, bool client_only) override;
+    rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    // whether the sessions with `addr` are allowed to be plaintext
+    bool is_plaintext_peer(::dsn::rpc_address addr) const;
+
+protected:
+    void on_socket_accepted(const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                            ::dsn::rpc_address client_addr) override;
+
+private:
+    struct ipv4_subnet
+    {
+        uint32_t network;
+        uint32_t mask;
+    };
+
+    // creates the SSL_CTX for the client or the server side, nullptr on failure
+    static SSL_CTX *create_context(bool is_server);
+
+    void on_first_bytes(const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                        ::dsn::rpc_address client_addr);
+    void start_server_handshake(const std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                                ::dsn::rpc_address client_addr);
+
+private:
+    friend class tls_rpc_session;
+
+    SSL_CTX *_client_ctx;
+    SSL_CTX *_server_ctx;
+    std::vector<ipv4_subnet> _plaintext_subnets;
+};
+
+} // namespace tools
+} // namespace dsn
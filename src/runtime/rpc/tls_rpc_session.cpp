@@ -0,0 +1,391 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "tls_rpc_session.h"
+
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <dsn/utility/flags.h>
+#include <openssl/err.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("network",
+                  tls_handshake_timeout_ms,
+                  10000,
+                  "the session is closed if its tls handshake isn't done in this time");
+DSN_DEFINE_validator(tls_handshake_timeout_ms, [](uint32_t timeout) -> bool {
+    return timeout > 0;
+});
+
+// the plaintext of a TLS record is at most 16KB
+static const size_t TLS_MAX_RECORD_BYTES = 16 * 1024;
+
+// should be called right after the failed SSL call, on the same thread
+static std::string ssl_error_message(int ssl_error)
+{
+    if (ssl_error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) {
+        return errno == 0 ? "unexpected eof" : strerror(errno);
+    }
+    char buf[256];
+    ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+    return buf;
+}
+
+struct tls_rpc_session::send_state
+{
+    std::vector<message_parser::send_buf> bufs;
+    // the next bytes of `bufs` to be copied into `chunk`
+    size_t index = 0;
+    size_t offset = 0;
+    // the plaintext of the record being written
+    std::string chunk;
+    size_t chunk_written = 0;
+};
+
+tls_rpc_session::tls_rpc_session(tls_network_provider &net,
+                                 ::dsn::rpc_address remote_addr,
+                                 std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                                 SSL *ssl,
+                                 message_parser_ptr &parser,
+                                 bool is_client)
+    : asio_rpc_session(net, remote_addr, socket, parser, is_client),
+      _tls_net(net),
+      _ssl(ssl),
+      _ktls_send(false),
+      _ktls_recv(false)
+{
+}
+
+tls_rpc_session::~tls_rpc_session()
+{
+    if (_ssl != nullptr) {
+        SSL_free(_ssl);
+    }
+}
+
+void tls_rpc_session::connect()
+{
+    if (set_connecting()) {
+        boost::asio::ip::tcp::endpoint ep(boost::asio::ip::address_v4(_remote_addr.ip()),
+                                          _remote_addr.port());
+
+        add_ref();
+        _socket->async_connect(ep, [this](boost::system::error_code ec) {
+            if (ec) {
+                derror("client session connect to %s failed, error = %s",
+                       _remote_addr.to_string(),
+                       ec.message().c_str());
+                on_failure(true);
+                release_ref();
+                return;
+            }
+
+            set_options();
+            handshake([this](bool succeed) {
+                if (succeed) {
+                    dinfo("client session %s connected with tls", _remote_addr.to_string());
+                    set_connected();
+                    on_send_completed();
+                    start_read_next();
+                } else {
+                    on_failure(true);
+                }
+                release_ref();
+            });
+        });
+    }
+}
+
+void tls_rpc_session::handshake(std::function<void(bool)> callback)
+{
+    if (_ssl == nullptr) {
+        derror("tls session with %s has no SSL_CTX, see the errors of configuring it",
+               _remote_addr.to_string());
+        callback(false);
+        return;
+    }
+
+    // the SSL calls are made on the native socket, which must not block
+    boost::system::error_code ec;
+    {
+        utils::auto_write_lock socket_guard(_socket_lock);
+        _socket->native_non_blocking(true, ec);
+        if (!ec && SSL_set_fd(_ssl, _socket->native_handle()) != 1) {
+            ec = boost::asio::error::make_error_code(boost::asio::error::bad_descriptor);
+        }
+    }
+    if (ec) {
+        derror("tls session with %s prepare the socket failed, error = %s",
+               _remote_addr.to_string(),
+               ec.message().c_str());
+        callback(false);
+        return;
+    }
+    if (is_client()) {
+        SSL_set_connect_state(_ssl);
+    } else {
+        SSL_set_accept_state(_ssl);
+    }
+
+    // the waiting of the socket is aborted once the session is closed
+    rpc_session_ptr self(this);
+    auto timer = std::make_shared<boost::asio::deadline_timer>(_tls_net._io_service);
+    timer->expires_from_now(boost::posix_time::milliseconds(FLAGS_tls_handshake_timeout_ms));
+    timer->async_wait([this, self](const boost::system::error_code &ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            derror("tls handshake with %s timed out", _remote_addr.to_string());
+            close();
+        }
+    });
+
+    do_handshake(timer, callback);
+}
+
+void tls_rpc_session::do_handshake(const std::shared_ptr<boost::asio::deadline_timer> &timer,
+                                   const std::function<void(bool)> &callback)
+{
+    int ssl_error;
+    std::string message;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_ssl_lock);
+        ERR_clear_error();
+        int ret = SSL_do_handshake(_ssl);
+        ssl_error = ret == 1 ? SSL_ERROR_NONE : SSL_get_error(_ssl, ret);
+        if (ssl_error != SSL_ERROR_NONE && ssl_error != SSL_ERROR_WANT_READ &&
+            ssl_error != SSL_ERROR_WANT_WRITE) {
+            message = ssl_error_message(ssl_error);
+        }
+    }
+
+    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+        wait_socket(ssl_error, [this, timer, callback](boost::system::error_code ec) {
+            if (ec) {
+                derror("tls handshake with %s failed, error = %s",
+                       _remote_addr.to_string(),
+                       ec.message().c_str());
+                timer->cancel();
+                callback(false);
+            } else {
+                do_handshake(timer, callback);
+            }
+        });
+        return;
+    }
+
+    timer->cancel();
+    if (ssl_error != SSL_ERROR_NONE) {
+        derror("tls handshake with %s failed, error = %s",
+               _remote_addr.to_string(),
+               message.c_str());
+        callback(false);
+        return;
+    }
+
+    on_handshake_completed();
+    callback(true);
+}
+
+void tls_rpc_session::on_handshake_completed()
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    _ktls_send = BIO_get_ktls_send(SSL_get_wbio(_ssl));
+    _ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(_ssl));
+#endif
+
+    // a kTLS socket rejects MSG_ZEROCOPY, and SSL_write() copies the bytes anyway
+    disable_zerocopy();
+
+#if defined(SOL_TLS) && defined(TLS_RX_EXPECT_NO_PAD)
+    if (_ktls_recv && SSL_version(_ssl) == TLS1_3_VERSION) {
+        // OpenSSL doesn't pad the records, which lets the kernel decrypt them into the read
+        // buffer directly
+        int one = 1;
+        utils::auto_read_lock socket_guard(_socket_lock);
+        int fd = _socket->native_handle();
+        if (setsockopt(fd, SOL_TLS, TLS_RX_EXPECT_NO_PAD, &one, sizeof(one)) < 0) {
+            dinfo("tls socket set TLS_RX_EXPECT_NO_PAD failed, error = %s", strerror(errno));
+        }
+    }
+#endif
+
+    ddebug("tls session with %s established, version = %s, cipher = %s, "
+           "ktls send = %s, ktls recv = %s",
+           _remote_addr.to_string(),
+           SSL_get_version(_ssl),
+           SSL_get_cipher_name(_ssl),
+           _ktls_send ? "true" : "false",
+           _ktls_recv ? "true" : "false");
+}
+
+void tls_rpc_session::wait_socket(int ssl_error,
+                                  std::function<void(boost::system::error_code)> handler)
+{
+    utils::auto_read_lock socket_guard(_socket_lock);
+    _socket->async_wait(ssl_error == SSL_ERROR_WANT_READ ? boost::asio::socket_base::wait_read
+                                                         : boost::asio::socket_base::wait_write,
+                        std::move(handler));
+}
+
+void tls_rpc_session::do_read(int read_next)
+{
+    if (_ktls_recv) {
+        asio_rpc_session::do_read(read_next);
+        return;
+    }
+
+    add_ref();
+    read_ssl(read_next);
+}
+
+void tls_rpc_session::read_ssl(int read_next)
+{
+    void *ptr = _reader.read_buffer_ptr(read_next);
+    int remaining = _reader.read_buffer_capacity();
+
+    int ret;
+    int ssl_error;
+    std::string message;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_ssl_lock);
+        ERR_clear_error();
+        ret = SSL_read(_ssl, ptr, remaining);
+        ssl_error = ret > 0 ? SSL_ERROR_NONE : SSL_get_error(_ssl, ret);
+        if (ret <= 0 && ssl_error != SSL_ERROR_WANT_READ && ssl_error != SSL_ERROR_WANT_WRITE &&
+            ssl_error != SSL_ERROR_ZERO_RETURN) {
+            message = ssl_error_message(ssl_error);
+        }
+    }
+
+    if (ret > 0) {
+        on_read_completed(ret);
+        release_ref();
+        return;
+    }
+
+    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+        wait_socket(ssl_error, [this, read_next](boost::system::error_code ec) {
+            if (ec) {
+                derror(
+                    "tls read from %s failed: %s", _remote_addr.to_string(), ec.message().c_str());
+                on_failure();
+                release_ref();
+            } else {
+                read_ssl(read_next);
+            }
+        });
+        return;
+    }
+
+    if (ssl_error == SSL_ERROR_ZERO_RETURN) {
+        ddebug("tls read from %s failed: closed by the peer", _remote_addr.to_string());
+    } else {
+        derror("tls read from %s failed: %s", _remote_addr.to_string(), message.c_str());
+    }
+    on_failure();
+    release_ref();
+}
+
+void tls_rpc_session::send(uint64_t signature)
+{
+    if (_ktls_send) {
+        asio_rpc_session::send(signature);
+        return;
+    }
+
+    auto state = std::make_shared<send_state>();
+    state->bufs = _sending_buffers;
+
+    add_ref();
+    write_ssl(signature, state);
+}
+
+void tls_rpc_session::write_ssl(uint64_t signature, const std::shared_ptr<send_state> &state)
+{
+    while (true) {
+        // the small buffers, e.g. the headers, are coalesced into full records
+        if (state->chunk_written == state->chunk.size()) {
+            state->chunk.clear();
+            state->chunk_written = 0;
+            while (state->index < state->bufs.size() &&
+                   state->chunk.size() < TLS_MAX_RECORD_BYTES) {
+                const message_parser::send_buf &buf = state->bufs[state->index];
+                size_t n = std::min(buf.sz - state->offset,
+                                    TLS_MAX_RECORD_BYTES - state->chunk.size());
+                state->chunk.append(static_cast<const char *>(buf.buf) + state->offset, n);
+                state->offset += n;
+                if (state->offset == buf.sz) {
+                    state->index++;
+                    state->offset = 0;
+                }
+            }
+            if (state->chunk.empty()) {
+                break;
+            }
+        }
+
+        int ret;
+        int ssl_error;
+        std::string message;
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_ssl_lock);
+            ERR_clear_error();
+            ret = SSL_write(_ssl,
+                            state->chunk.data() + state->chunk_written,
+                            static_cast<int>(state->chunk.size() - state->chunk_written));
+            ssl_error = ret > 0 ? SSL_ERROR_NONE : SSL_get_error(_ssl, ret);
+            if (ret <= 0 && ssl_error != SSL_ERROR_WANT_READ &&
+                ssl_error != SSL_ERROR_WANT_WRITE) {
+                message = ssl_error_message(ssl_error);
+            }
+        }
+
+        if (ret > 0) {
+            state->chunk_written += ret;
+            continue;
+        }
+
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+            // SSL_write() should be retried with the same bytes
+            wait_socket(ssl_error, [this, signature, state](boost::system::error_code ec) {
+                if (ec) {
+                    derror("tls write to %s failed: %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                    on_failure(true);
+                    release_ref();
+                } else {
+                    write_ssl(signature, state);
+                }
+            });
+            return;
+        }
+
+        derror("tls write to %s failed: %s", _remote_addr.to_string(), message.c_str());
+        on_failure(true);
+        release_ref();
+        return;
+    }
+
+    on_send_completed(signature);
+    release_ref();
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <functional>
+#include <boost/asio/deadline_timer.hpp>
+#include <openssl/ssl.h>
+
+#include "asio_rpc_session.h"
+#include "tls_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// A TLS session over a tcp socket. If the keys are handed to the kernel after the handshake,
+// the bytes of that direction go through the socket as asio_rpc_session does, otherwise
+// they are encrypted or decrypted with SSL_write() and SSL_read() on the non-blocking socket.
+// Thread-safe
+class tls_rpc_session : public asio_rpc_session
+{
+public:
+    // takes the ownership of `ssl`
+    tls_rpc_session(tls_network_provider &net,
+                    ::dsn::rpc_address remote_addr,
+                    std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
+                    SSL *ssl,
+                    message_parser_ptr &parser,
+                    bool is_client);
+
+    ~tls_rpc_session() override;
+
+    void send(uint64_t signature) override;
+
+    void connect() override;
+
+    // runs the handshake on the connected socket, `callback` is called with whether it
+    // has succeeded, in [network] tls_handshake_timeout_ms
+    void handshake(std::function<void(bool)> callback);
+
+    bool ktls_send() const { return _ktls_send; }
+    bool ktls_recv() const { return _ktls_recv; }
+
+private:
+    struct send_state;
+
+    void do_read(int read_next) override;
+    void read_ssl(int read_next);
+    void write_ssl(uint64_t signature, const std::shared_ptr<send_state> &state);
+    void do_handshake(const std::shared_ptr<boost::asio::deadline_timer> &timer,
+                      const std::function<void(bool)> &callback);
+    void on_handshake_completed();
+
+    // waits for the socket to be readable or writable as `ssl_error` wants, the `handler`
+    // is called with the error of waiting
+    void wait_socket(int ssl_error, std::function<void(boost::system::error_code)> handler);
+
+private:
+    tls_network_provider &_tls_net;
+    SSL *_ssl;
+    // the SSL object is not thread-safe, SSL_read() and SSL_write() may be called concurrently
+    ::dsn::utils::ex_lock_nr _ssl_lock;
+
+    // whether kTLS is enabled for the direction, set once after the handshake
+    bool _ktls_send;
+    bool _ktls_recv;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,527 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/toollet/sampling_profiler.h>
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/task.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/flags.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("sampling_profiler",
+                  sampling_frequency_hz,
+                  19,
+                  "how many times the stack of a task worker is sampled per second of its thread "
+                  "cpu time, a prime avoids sampling in lockstep with the periodic work");
+DSN_DEFINE_uint32("sampling_profiler",
+                  window_seconds,
+                  600,
+                  "how many seconds of the sampled stacks are kept");
+
+namespace {
+
+constexpr int kMaxDepth = 48;
+// the frames of the signal handler and the signal trampoline
+constexpr int kSkippedFrames = 2;
+constexpr uint64_t kRingSize = 8192;
+constexpr uint64_t kBucketSeconds = 10;
+
+struct raw_sample
+{
+    std::atomic<uint64_t> sequence;
+    const char *thread_pool;
+    int task_code;
+    int depth;
+    void *pcs[kMaxDepth];
+};
+
+// A bounded lock-free queue (by Dmitry Vyukov), which is pushed by the signal handlers of all the
+// sampled threads and popped by the aggregation thread. A push neither locks nor allocates.
+class sample_ring
+{
+public:
+    sample_ring() : _slots(new raw_sample[kRingSize]), _push_pos(0), _pop_pos(0)
+    {
+        for (uint64_t i = 0; i < kRingSize; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // samples the stack of the current thread, false if the ring is full. It's inlined into the
+    // signal handler so that the frames to skip are certain.
+    __attribute__((always_inline)) bool push(const char *thread_pool, int task_code)
+    {
+        uint64_t pos = _push_pos.load(std::memory_order_relaxed);
+        raw_sample *slot;
+        for (;;) {
+            slot = &_slots[pos & (kRingSize - 1)];
+            int64_t diff = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire)) -
+                           static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _push_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->thread_pool = thread_pool;
+        slot->task_code = task_code;
+        slot->depth = backtrace(slot->pcs, kMaxDepth);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only called by the aggregation thread
+    template <typename TVisitor>
+    void pop_all(TVisitor &&visit)
+    {
+        for (;;) {
+            raw_sample &slot = _slots[_pop_pos & (kRingSize - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != _pop_pos + 1) {
+                return;
+            }
+            visit(slot);
+            slot.sequence.store(_pop_pos + kRingSize, std::memory_order_release);
+            ++_pop_pos;
+        }
+    }
+
+private:
+    std::unique_ptr<raw_sample[]> _slots;
+    std::atomic<uint64_t> _push_pos;
+    uint64_t _pop_pos;
+};
+
+struct stack_key
+{
+    const char *thread_pool;
+    int task_code;
+    std::vector<void *> pcs;
+
+    bool operator==(const stack_key &other) const
+    {
+        return thread_pool == other.thread_pool && task_code == other.task_code &&
+               pcs == other.pcs;
+    }
+};
+
+struct stack_key_hash
+{
+    size_t operator()(const stack_key &key) const
+    {
+        size_t h = std::hash<const void *>()(key.thread_pool) * 31 + key.task_code;
+        for (void *pc : key.pcs) {
+            h = h * 31 + std::hash<void *>()(pc);
+        }
+        return h;
+    }
+};
+
+typedef std::unordered_map<stack_key, uint64_t, stack_key_hash> stack_counts;
+
+// the stacks aggregated over kBucketSeconds
+struct stack_bucket
+{
+    uint64_t start_seconds;
+    stack_counts counts;
+};
+
+struct sampler
+{
+    sample_ring ring;
+    std::atomic<uint64_t> dropped_count{0};
+    int64_t period_ns;
+
+    std::mutex lock;
+    std::deque<stack_bucket> buckets;
+};
+
+sampler *s_sampler = nullptr;
+std::atomic<bool> s_installed{false};
+
+// the tags of the samples of the current thread, read by the signal handler
+__thread const char *tls_thread_pool = nullptr;
+__thread int tls_task_code = 0;
+
+// a SIGRTMIN signal rather than SIGPROF, so that it works along with the gperftools profiler of
+// /pprof/profile
+int sample_signal() { return SIGRTMIN + 4; }
+
+uint64_t now_seconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void on_sample_signal(int, siginfo_t *, void *)
+{
+    int saved_errno = errno;
+    if (!s_sampler->ring.push(tls_thread_pool, tls_task_code)) {
+        s_sampler->dropped_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    errno = saved_errno;
+}
+
+struct thread_timer
+{
+    timer_t id;
+    bool created = false;
+
+    ~thread_timer()
+    {
+        if (created) {
+            timer_delete(id);
+        }
+    }
+};
+thread_local thread_timer tls_timer;
+
+void on_task_worker_start(task_worker *worker)
+{
+    tls_thread_pool = worker->pool_spec().name.c_str();
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = sample_signal();
+    sev.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &tls_timer.id) != 0) {
+        derror_f("failed to create the sampling timer of {}: {}", worker->name(), errno);
+        return;
+    }
+    tls_timer.created = true;
+
+    struct itimerspec its;
+    its.it_interval.tv_sec = s_sampler->period_ns / 1000000000;
+    its.it_interval.tv_nsec = s_sampler->period_ns % 1000000000;
+    its.it_value = its.it_interval;
+    if (timer_settime(tls_timer.id, 0, &its, nullptr) != 0) {
+        derror_f("failed to start the sampling timer of {}: {}", worker->name(), errno);
+    }
+}
+
+void on_task_begin(task *t) { tls_task_code = t->spec().code.code(); }
+
+void on_task_end(task *) { tls_task_code = TASK_CODE_INVALID; }
+
+void aggregate_samples()
+{
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        uint64_t now = now_seconds();
+        std::lock_guard<std::mutex> l(s_sampler->lock);
+        auto &buckets = s_sampler->buckets;
+        if (buckets.empty() || now - buckets.back().start_seconds >= kBucketSeconds) {
+            buckets.emplace_back();
+            buckets.back().start_seconds = now;
+        }
+        while (buckets.size() > FLAGS_window_seconds / kBucketSeconds + 1) {
+            buckets.pop_front();
+        }
+
+        stack_counts &counts = buckets.back().counts;
+        s_sampler->ring.pop_all([&counts](const raw_sample &s) {
+            int skipped = std::min(kSkippedFrames, s.depth);
+            ++counts[stack_key{s.thread_pool,
+                               s.task_code,
+                               std::vector<void *>(s.pcs + skipped, s.pcs + s.depth)}];
+        });
+    }
+}
+
+// writes the messages of protobuf by hand, which is simple for profile.proto
+class proto_writer
+{
+public:
+    void append_varint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            _data.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        _data.push_back(static_cast<char>(value));
+    }
+
+    void write_varint(uint32_t field, uint64_t value)
+    {
+        append_varint((static_cast<uint64_t>(field) << 3) | 0);
+        append_varint(value);
+    }
+
+    void write_bytes(uint32_t field, const std::string &bytes)
+    {
+        append_varint((static_cast<uint64_t>(field) << 3) | 2);
+        append_varint(bytes.size());
+        _data.append(bytes);
+    }
+
+    void write_packed(uint32_t field, const std::vector<uint64_t> &values)
+    {
+        proto_writer packed;
+        for (uint64_t value : values) {
+            packed.append_varint(value);
+        }
+        write_bytes(field, packed.data());
+    }
+
+    const std::string &data() const { return _data; }
+
+private:
+    std::string _data;
+};
+
+struct mapping
+{
+    uint64_t start;
+    uint64_t limit;
+    uint64_t offset;
+    std::string file;
+};
+
+// the executable mappings of /proc/self/maps, by which pprof tells the binary of an address
+std::vector<mapping> load_mappings()
+{
+    std::vector<mapping> mappings;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        mapping m;
+        char perms[8] = {0};
+        char file[4096] = {0};
+        if (sscanf(line.c_str(),
+                   "%lx-%lx %7s %lx %*s %*s %4095s",
+                   &m.start,
+                   &m.limit,
+                   perms,
+                   &m.offset,
+                   file) >= 4 &&
+            perms[2] == 'x') {
+            m.file = file;
+            mappings.emplace_back(std::move(m));
+        }
+    }
+    return mappings;
+}
+
+std::string encode_profile(const stack_counts &stacks, int64_t period_ns, uint32_t seconds)
+{
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint64_t> string_ids;
+    auto string_id = [&strings, &string_ids](const std::string &s) {
+        auto it = string_ids.emplace(s, strings.size());
+        if (it.second) {
+            strings.push_back(s);
+        }
+        return it.first->second;
+    };
+    string_id("");
+
+    auto value_type = [&string_id](const char *type, const char *unit) {
+        proto_writer w;
+        w.write_varint(1, string_id(type));
+        w.write_varint(2, string_id(unit));
+        return w.data();
+    };
+
+    proto_writer profile;
+    profile.write_bytes(1, value_type("samples", "count"));
+    profile.write_bytes(1, value_type("cpu", "nanoseconds"));
+
+    std::vector<mapping> mappings = load_mappings();
+    auto mapping_id = [&mappings](uint64_t address) -> uint64_t {
+        auto it = std::upper_bound(
+            mappings.begin(), mappings.end(), address, [](uint64_t addr, const mapping &m) {
+                return addr < m.start;
+            });
+        if (it == mappings.begin() || address >= (it - 1)->limit) {
+            return 0;
+        }
+        return it - mappings.begin();
+    };
+
+    // pprof takes the leaf frame first, and the addresses of the callers are their return
+    // addresses minus 1, so that they are told within the call instructions
+    std::unordered_map<uint64_t, uint64_t> location_ids;
+    proto_writer locations;
+    for (const auto &kv : stacks) {
+        const stack_key &key = kv.first;
+        std::vector<uint64_t> ids;
+        ids.reserve(key.pcs.size());
+        for (size_t i = 0; i < key.pcs.size(); ++i) {
+            uint64_t address = reinterpret_cast<uint64_t>(key.pcs[i]) - (i == 0 ? 0 : 1);
+            auto it = location_ids.emplace(address, location_ids.size() + 1);
+            if (it.second) {
+                proto_writer location;
+                location.write_varint(1, it.first->second);
+                location.write_varint(2, mapping_id(address));
+                location.write_varint(3, address);
+                locations.write_bytes(4, location.data());
+            }
+            ids.push_back(it.first->second);
+        }
+
+        proto_writer sample;
+        sample.write_packed(1, ids);
+        sample.write_packed(
+            2, {kv.second, static_cast<uint64_t>(kv.second * static_cast<uint64_t>(period_ns))});
+        auto add_label = [&sample, &string_id](const char *label_key, const std::string &value) {
+            proto_writer label;
+            label.write_varint(1, string_id(label_key));
+            label.write_varint(2, string_id(value));
+            sample.write_bytes(3, label.data());
+        };
+        if (key.thread_pool != nullptr) {
+            add_label("thread_pool", key.thread_pool);
+        }
+        if (key.task_code != TASK_CODE_INVALID) {
+            add_label("task_code", task_code(key.task_code).to_string());
+        }
+        profile.write_bytes(2, sample.data());
+    }
+
+    for (size_t i = 0; i < mappings.size(); ++i) {
+        proto_writer m;
+        m.write_varint(1, i + 1);
+        m.write_varint(2, mappings[i].start);
+        m.write_varint(3, mappings[i].limit);
+        m.write_varint(4, mappings[i].offset);
+        m.write_varint(5, string_id(mappings[i].file));
+        profile.write_bytes(3, m.data());
+    }
+    std::string result = profile.data();
+    result.append(locations.data());
+
+    // period_type is encoded before the string table, which needs its strings
+    proto_writer tail;
+    tail.write_varint(9,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                              .count() -
+                          seconds * 1000000000ULL);
+    tail.write_varint(10, seconds * 1000000000ULL);
+    tail.write_bytes(11, value_type("cpu", "nanoseconds"));
+    tail.write_varint(12, period_ns);
+    for (const std::string &s : strings) {
+        tail.write_bytes(6, s);
+    }
+    result.append(tail.data());
+    return result;
+}
+
+} // anonymous namespace
+
+sampling_profiler::sampling_profiler(const char *name) : toollet(name) {}
+
+void sampling_profiler::install(service_spec &)
+{
+    dassert_f(FLAGS_sampling_frequency_hz > 0 && FLAGS_sampling_frequency_hz <= 1000,
+              "invalid sampling_frequency_hz {}",
+              FLAGS_sampling_frequency_hz);
+    s_sampler = new sampler();
+    s_sampler->period_ns = 1000000000LL / FLAGS_sampling_frequency_hz;
+
+    // backtrace loads libgcc_s and allocates on its first call, which must not happen in the
+    // signal handler
+    void *pcs[1];
+    backtrace(pcs, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sample_signal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    dassert_f(sigaction(sample_signal(), &sa, nullptr) == 0,
+              "failed to set the handler of the sampling signal: {}",
+              errno);
+
+    for (int i = 0; i <= task_code::max(); i++) {
+        if (i == TASK_CODE_INVALID) {
+            continue;
+        }
+        task_spec *spec = task_spec::get(i);
+        dassert(spec != nullptr, "task_spec cannot be null");
+        spec->on_task_begin.put_back(on_task_begin, "sampling_profiler");
+        spec->on_task_end.put_back(on_task_end, "sampling_profiler");
+    }
+    task_worker::on_start.put_back(on_task_worker_start, "sampling_profiler");
+
+    std::thread(aggregate_samples).detach();
+    s_installed.store(true);
+}
+
+/*static*/ bool sampling_profiler::installed() { return s_installed.load(); }
+
+/*static*/ std::string sampling_profiler::get_profile(uint32_t seconds)
+{
+    if (!installed()) {
+        return std::string();
+    }
+
+    stack_counts merged;
+    {
+        uint64_t now = now_seconds();
+        std::lock_guard<std::mutex> l(s_sampler->lock);
+        for (const stack_bucket &bucket : s_sampler->buckets) {
+            if (bucket.start_seconds + kBucketSeconds + seconds <= now) {
+                continue;
+            }
+            for (const auto &kv : bucket.counts) {
+                merged[kv.first] += kv.second;
+            }
+        }
+    }
+
+    uint64_t dropped = s_sampler->dropped_count.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        dwarn_f("{} stack samples are dropped for the ring is full", dropped);
+    }
+    return encode_profile(merged, s_sampler->period_ns, seconds);
+}
+
+} // namespace tools
+} // namespace dsn
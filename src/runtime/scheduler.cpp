@@ -39,60 +39,54 @@
 #include <dsn/tool/node_scoper.h>
 #include "scheduler.h"
 #include "env.sim.h"
+#include <algorithm>
 #include <set>
 
 namespace dsn {
 namespace tools {
 
-void event_wheel::add_event(uint64_t ts, task *t)
+void event_wheel::push(uint64_t ts, event_entry &&entry)
 {
     utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
 
-    std::vector<event_entry> *evts;
-    auto itr = _events.find(ts);
-    if (itr != _events.end())
-        evts = itr->second;
-    else {
-        evts = new std::vector<event_entry>();
-        _events.insert(std::make_pair(ts, evts));
-    }
+    _events.push_back(timed_event{ts, _next_seq++, std::move(entry)});
+    std::push_heap(_events.begin(), _events.end(), later());
+}
 
+void event_wheel::add_event(uint64_t ts, task *t)
+{
     event_entry entry;
     entry.app_task = t;
-    evts->push_back(entry);
+    push(ts, std::move(entry));
 }
 
 void event_wheel::add_system_event(uint64_t ts, std::function<void()> t)
 {
-    utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
-
-    std::vector<event_entry> *evts;
-    auto itr = _events.find(ts);
-    if (itr != _events.end())
-        evts = itr->second;
-    else {
-        evts = new std::vector<event_entry>();
-        _events.insert(std::make_pair(ts, evts));
-    }
-
     event_entry entry;
     entry.system_task = std::move(t);
     entry.app_task = nullptr;
-    evts->push_back(entry);
+    push(ts, std::move(entry));
 }
 
-std::vector<event_entry> *event_wheel::pop_next_events(/*out*/ uint64_t &ts)
+bool event_wheel::pop_next_events(uint64_t quantum_ns,
+                                  /*out*/ uint64_t &ts,
+                                  /*out*/ std::vector<event_entry> &events)
 {
     utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
 
-    std::vector<event_entry> *evts = NULL;
-    auto itr = _events.begin();
-    if (itr != _events.end()) {
-        evts = itr->second;
-        ts = itr->first;
-        _events.erase(itr);
+    if (_events.empty()) {
+        return false;
     }
-    return evts;
+
+    uint64_t first = _events.front().ts;
+    uint64_t end = quantum_ns == 0 ? first + 1 : (first / quantum_ns + 1) * quantum_ns;
+    while (!_events.empty() && _events.front().ts < end) {
+        std::pop_heap(_events.begin(), _events.end(), later());
+        ts = _events.back().ts;
+        events.push_back(std::move(_events.back().entry));
+        _events.pop_back();
+    }
+    return true;
 }
 
 void event_wheel::clear()
@@ -110,6 +104,15 @@ scheduler::scheduler(void)
     _time_ns = 0;
     _running = false;
     _running_thread = nullptr;
+    _time_quantum_ns =
+        dsn_config_get_value_uint64("tools.simulator",
+                                    "time_quantum_us",
+                                    0,
+                                    "the timed events in the same quantum are run as one batch "
+                                    "in a random order, at the time of the latest of them, which "
+                                    "saves the time advances for the large scenarios; 0 to run "
+                                    "them at their exact time") *
+        1000;
     task_worker::on_create.put_back(on_task_worker_create, "simulation.on_task_worker_create");
     task_worker::on_start.put_back(on_task_worker_start, "simulation.on_task_worker_start");
 
@@ -224,15 +227,15 @@ void scheduler::wait_schedule(bool in_continue, bool is_continue_ready /*= false
 
     if (s->first_time_schedule) {
         s->first_time_schedule = false;
-        if (s->index == 0)
-            schedule();
-    } else {
-        schedule();
+        if (s->index == 0 && schedule(s))
+            return;
+    } else if (schedule(s)) {
+        return;
     }
     s->runnable.wait();
 }
 
-void scheduler::schedule()
+bool scheduler::schedule(sim_worker_state *current)
 {
     _is_scheduling = true;
 
@@ -240,27 +243,30 @@ void scheduler::schedule()
 
     while (true) {
         // run ready workers whenever possible
-        std::vector<int> ready_workers;
+        _ready_workers.clear();
         for (auto &s : _threads) {
             if ((s->in_continuation && s->is_continuation_ready) ||
                 (!s->in_continuation && s->worker->queue()->count() > 0)) {
-                ready_workers.push_back(s->index);
+                _ready_workers.push_back(s->index);
             }
         }
 
-        if (ready_workers.size() > 0) {
-            int i = rand::next_u32(0, (uint32_t)ready_workers.size() - 1);
-            _running_thread = _threads[ready_workers[i]];
-            _running_thread->runnable.release();
-
+        if (_ready_workers.size() > 0) {
+            int i = rand::next_u32(0, (uint32_t)_ready_workers.size() - 1);
+            _running_thread = _threads[_ready_workers[i]];
             _is_scheduling = false;
-            return;
+            if (_running_thread == current) {
+                return true;
+            }
+            _running_thread->runnable.release();
+            return false;
         }
 
         // otherwise, run the timed tasks
         uint64_t ts = 0;
-        auto events = _wheel.pop_next_events(ts);
-        if (events) {
+        std::vector<event_entry> events;
+        events.swap(_events);
+        if (_wheel.pop_next_events(_time_quantum_ns, ts, events)) {
             {
                 utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
                 _time_ns = ts;
@@ -268,9 +274,9 @@ void scheduler::schedule()
 
             // randomize the events, and see
             std::random_shuffle(
-                events->begin(), events->end(), [](int n) { return rand::next_u32(0, n - 1); });
+                events.begin(), events.end(), [](int n) { return rand::next_u32(0, n - 1); });
 
-            for (auto e : *events) {
+            for (auto &e : events) {
                 if (e.app_task != nullptr) {
                     task *t = e.app_task;
 
@@ -286,7 +292,8 @@ void scheduler::schedule()
                 }
             }
 
-            delete events;
+            events.clear();
+            _events.swap(events);
             continue;
         }
 
@@ -295,6 +302,7 @@ void scheduler::schedule()
     }
 
     _is_scheduling = false;
+    return false;
 }
 }
 } // end namespace
@@ -48,6 +48,8 @@ struct event_entry
     std::function<void()> system_task;
 };
 
+// The timed events of the simulation, kept in a binary heap ordered by the time and then by
+// the order of adding, so the events of the same time are popped in the order of adding.
 class event_wheel
 {
 public:
@@ -55,7 +57,12 @@ public:
 
     void add_event(uint64_t ts, task *t);
     void add_system_event(uint64_t ts, std::function<void()> t);
-    std::vector<event_entry> *pop_next_events(/*out*/ uint64_t &ts);
+    // pops the events of the earliest time into `events`, or the events in the same
+    // `quantum_ns` as the earliest one if `quantum_ns` isn't 0, in which case `ts` is the
+    // latest time of them; returns false if there is no event
+    bool pop_next_events(uint64_t quantum_ns,
+                         /*out*/ uint64_t &ts,
+                         /*out*/ std::vector<event_entry> &events);
     void clear();
     bool has_more_events() const
     {
@@ -64,8 +71,24 @@ public:
     }
 
 private:
-    typedef std::map<uint64_t, std::vector<event_entry> *> Events;
-    Events _events;
+    struct timed_event
+    {
+        uint64_t ts;
+        uint64_t seq;
+        event_entry entry;
+    };
+    struct later
+    {
+        bool operator()(const timed_event &l, const timed_event &r) const
+        {
+            return l.ts > r.ts || (l.ts == r.ts && l.seq > r.seq);
+        }
+    };
+
+    void push(uint64_t ts, event_entry &&entry);
+
+    std::vector<timed_event> _events;
+    uint64_t _next_seq = 0;
     mutable ::dsn::utils::ex_lock _lock;
 };
 
@@ -124,6 +147,11 @@ private:
     bool _running;
     std::vector<sim_worker_state *> _threads;
     sim_worker_state *_running_thread;
+    // the events of the same quantum are run as one batch, 0 for the exact time
+    uint64_t _time_quantum_ns;
+    // reused by schedule() to save the allocations
+    std::vector<int> _ready_workers;
+    std::vector<event_entry> _events;
     static __thread bool _is_scheduling;
 
     struct checker_info
@@ -135,7 +163,9 @@ private:
     std::vector<checker_info> _checkers;
 
 private:
-    void schedule();
+    // picks the next worker to run, returns true if it's `current` which goes on running
+    // without the round trip of its semaphore
+    bool schedule(sim_worker_state *current);
     void check();
 
     static void on_task_worker_create(task_worker *worker);
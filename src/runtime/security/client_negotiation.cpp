@@ -18,6 +18,7 @@
 #include "client_negotiation.h"
 #include "negotiation_utils.h"
 #include "negotiation_manager.h"
+#include "session_ticket.h"
 
 #include <boost/algorithm/string/join.hpp>
 #include <dsn/dist/fmt_logging.h>
@@ -37,6 +38,13 @@ client_negotiation::client_negotiation(rpc_session_ptr session) : negotiation(se
 void client_negotiation::start()
 {
     ddebug_f("{}: start negotiation", _name);
+
+    blob ticket;
+    if (session_ticket_cache::get(_session->remote_address(), ticket)) {
+        _status = negotiation_status::type::SASL_RESUME;
+        send(_status, ticket);
+        return;
+    }
     list_mechanisms();
 }
 
@@ -56,6 +64,10 @@ void client_negotiation::handle_response(error_code err, const negotiation_respo
                      _name);
             succ_negotiation();
         } else {
+            if (_status == negotiation_status::type::SASL_RESUME) {
+                // the next connection will do the full negotiation
+                session_ticket_cache::remove(_session->remote_address());
+            }
             fail_negotiation();
         }
         return;
@@ -79,6 +91,9 @@ void client_negotiation::handle_response(error_code err, const negotiation_respo
     case negotiation_status::type::SASL_CHALLENGE_RESP:
         on_challenge(response);
         break;
+    case negotiation_status::type::SASL_RESUME:
+        on_resume(response);
+        break;
     default:
         fail_negotiation();
     }
@@ -164,6 +179,7 @@ void client_negotiation::on_challenge(const negotiation_response &challenge)
     }
 
     if (challenge.status == negotiation_status::type::SASL_SUCC) {
+        session_ticket_cache::put(_session->remote_address(), challenge.msg);
         succ_negotiation();
         return;
     }
@@ -172,6 +188,26 @@ void client_negotiation::on_challenge(const negotiation_response &challenge)
     fail_negotiation();
 }
 
+void client_negotiation::on_resume(const negotiation_response &resp)
+{
+    if (resp.status == negotiation_status::type::SASL_SUCC) {
+        // the server renews the ticket on every successful resumption
+        session_ticket_cache::put(_session->remote_address(), resp.msg);
+        succ_negotiation();
+        return;
+    }
+
+    session_ticket_cache::remove(_session->remote_address());
+    if (resp.status == negotiation_status::type::SASL_RESUME_REJECTED) {
+        ddebug_f("{}: session ticket is rejected, fall back to full negotiation", _name);
+        list_mechanisms();
+        return;
+    }
+
+    dwarn_f("{}: recv wrong negotiation msg type: {}", _name, enum_to_string(resp.status));
+    fail_negotiation();
+}
+
 void client_negotiation::select_mechanism(const std::string &mechanism)
 {
     _selected_mechanism = mechanism;
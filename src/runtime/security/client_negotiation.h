@@ -35,6 +35,7 @@ private:
     void on_recv_mechanisms(const negotiation_response &resp);
     void on_mechanism_selected(const negotiation_response &resp);
     void on_challenge(const negotiation_response &resp);
+    void on_resume(const negotiation_response &resp);
 
     void list_mechanisms();
     void select_mechanism(const std::string &mechanism);
@@ -38,6 +38,7 @@ meta_access_controller::meta_access_controller()
         register_allowed_list("RPC_CM_LIST_NODES");
         register_allowed_list("RPC_CM_CLUSTER_INFO");
         register_allowed_list("RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX");
+        register_allowed_list("RPC_CM_WATCH_APP_CONFIGURATION");
     } else {
         std::vector<std::string> rpc_code_white_list;
         utils::split_args(FLAGS_meta_acl_rpc_allow_list, rpc_code_white_list, ',');
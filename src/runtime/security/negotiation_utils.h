@@ -46,6 +46,10 @@ inline const char *enum_to_string(negotiation_status::type s)
         return "negotiation_challenge_response";
     case negotiation_status::type::SASL_AUTH_DISABLE:
         return "negotiation_auth_disable";
+    case negotiation_status::type::SASL_RESUME:
+        return "negotiation_resume";
+    case negotiation_status::type::SASL_RESUME_REJECTED:
+        return "negotiation_resume_rejected";
     case negotiation_status::type::INVALID:
         return "negotiation_invalid";
     default:
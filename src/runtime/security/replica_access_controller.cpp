@@ -21,9 +21,20 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/network.h>
 
+#include <atomic>
+
 namespace dsn {
 namespace security {
-replica_access_controller::replica_access_controller(const std::string &name) { _name = name; }
+namespace {
+std::atomic<uint32_t> next_decision_slot{0};
+} // anonymous namespace
+
+replica_access_controller::replica_access_controller(const std::string &name)
+    : _decision_slot(next_decision_slot.fetch_add(1, std::memory_order_relaxed)),
+      _acl(std::make_shared<acl_snapshot>())
+{
+    _name = name;
+}
 
 bool replica_access_controller::allowed(message_ex *msg)
 {
@@ -32,38 +43,44 @@ bool replica_access_controller::allowed(message_ex *msg)
         return true;
     }
 
-    {
-        utils::auto_read_lock l(_lock);
-        // If the user didn't specify any ACL, it means this table is publicly accessible to
-        // everyone. This is a backdoor to allow old-version clients to gracefully upgrade. After
-        // they are finally ensured to be fully upgraded, they can specify some usernames to ACL and
-        // the table will be truly protected.
-        if (!_users.empty() && _users.find(user_name) == _users.end()) {
-            ddebug_f("{}: user_name {} doesn't exist in acls map", _name, user_name);
-            return false;
-        }
-        return true;
+    // The decision is cached on the session, because the user name of a session never changes.
+    // It's valid until the acl is changed, which publishes a new version.
+    bool allowed = false;
+    if (msg->io_session->get_acl_decision(_decision_slot, _acl.version(), allowed)) {
+        return allowed;
     }
+
+    uint64_t version = 0;
+    const acl_snapshot &acl = _acl.get(&version);
+    // If the user didn't specify any ACL, it means this table is publicly accessible to
+    // everyone. This is a backdoor to allow old-version clients to gracefully upgrade. After
+    // they are finally ensured to be fully upgraded, they can specify some usernames to ACL and
+    // the table will be truly protected.
+    allowed = acl.users.empty() || acl.users.find(user_name) != acl.users.end();
+    if (!allowed) {
+        ddebug_f("{}: user_name {} doesn't exist in acls map", _name, user_name);
+    }
+    msg->io_session->set_acl_decision(_decision_slot, version, allowed);
+    return allowed;
 }
 
 void replica_access_controller::update(const std::string &users)
 {
-    {
-        // check to see whether we should update it or not.
-        utils::auto_read_lock l(_lock);
-        if (_env_users == users) {
-            return;
-        }
+    std::lock_guard<std::mutex> l(_update_lock);
+    // check to see whether we should update it or not.
+    if (_acl.get().env_users == users) {
+        return;
     }
 
     std::unordered_set<std::string> users_set;
     utils::split_args(users.c_str(), users_set, ',');
-    {
-        utils::auto_write_lock l(_lock);
-        // This swap operation is in constant time
-        _users.swap(users_set);
-        _env_users = users;
-    }
+    set_acl(std::move(users_set), users);
+}
+
+void replica_access_controller::set_acl(std::unordered_set<std::string> &&users,
+                                        const std::string &env_users)
+{
+    _acl.set(std::make_shared<acl_snapshot>(acl_snapshot{std::move(users), env_users}));
 }
 } // namespace security
 } // namespace dsn
@@ -17,9 +17,13 @@
 
 #pragma once
 
-#include <dsn/utility/synchronize.h>
+#include <mutex>
+#include <dsn/utility/published_snapshot.h>
 #include "access_controller.h"
 
+#include <memory>
+#include <string>
+
 namespace dsn {
 namespace security {
 class replica_access_controller : public access_controller
@@ -30,10 +34,20 @@ public:
     void update(const std::string &users) override;
 
 private:
-    utils::rw_lock_nr _lock; // [
-    std::unordered_set<std::string> _users;
-    std::string _env_users;
-    // ]
+    // An immutable view of the acl. update() publishes a new snapshot instead of modifying
+    // the current one, so allowed() reads it without locking.
+    struct acl_snapshot
+    {
+        std::unordered_set<std::string> users;
+        std::string env_users;
+    };
+
+    void set_acl(std::unordered_set<std::string> &&users, const std::string &env_users);
+
+    // the slot of the decisions of this controller cached on the sessions
+    const uint32_t _decision_slot;
+    std::mutex _update_lock; // serializes update()
+    utils::published_snapshot<acl_snapshot> _acl;
     std::string _name;
 
     friend class replica_access_controller_test;
@@ -26,6 +26,21 @@ namespace cpp dsn.security
 // if servers says ok)      |                                     |
 //                          | ---         RPC_CALL           ---> |
 //                          | <--         RPC_RESP           ---- |
+//
+// session resumption:
+//
+// The server attaches a signed session ticket to SASL_SUCC if [security] session_ticket_key
+// is configured. When the client reconnects, it presents the ticket instead of listing the
+// mechanisms, and skips all the SASL rounds if the server accepts it:
+//
+//                       client                              server
+//                          | ---        SASL_RESUME          --> |
+//                          | <--         SASL_SUCC           --- | (ticket accepted)
+//
+//                          | ---        SASL_RESUME          --> |
+//                          | <--    SASL_RESUME_REJECTED     --- | (ticket rejected, fall back
+//                          | ---    SASL_LIST_MECHANISMS     --> |  to the full negotiation)
+//                          |               .....                 |
 
 enum negotiation_status {
     INVALID
@@ -39,6 +54,8 @@ enum negotiation_status {
     SASL_SUCC
     SASL_AUTH_DISABLE
     SASL_AUTH_FAIL
+    SASL_RESUME
+    SASL_RESUME_REJECTED
 }
 
 struct negotiation_request {
@@ -18,6 +18,7 @@
 #include "server_negotiation.h"
 #include "negotiation_utils.h"
 #include "sasl_init.h"
+#include "session_ticket.h"
 
 #include <boost/algorithm/string/join.hpp>
 #include <dsn/dist/fmt_logging.h>
@@ -44,7 +45,11 @@ void server_negotiation::handle_request(negotiation_rpc rpc)
 {
     switch (_status) {
     case negotiation_status::type::SASL_LIST_MECHANISMS:
-        on_list_mechanisms(rpc);
+        if (rpc.request().status == negotiation_status::type::SASL_RESUME) {
+            on_resume(rpc);
+        } else {
+            on_list_mechanisms(rpc);
+        }
         break;
     case negotiation_status::type::SASL_LIST_MECHANISMS_RESP:
         on_select_mechanism(rpc);
@@ -73,6 +78,19 @@ void server_negotiation::on_list_mechanisms(negotiation_rpc rpc)
     response.msg = blob::create_from_bytes(mech_list.data(), mech_list.length());
 }
 
+void server_negotiation::on_resume(negotiation_rpc rpc)
+{
+    std::string user_name;
+    if (verify_session_ticket(rpc.request().msg, _session->remote_address(), user_name)) {
+        ddebug_f("{}: resume negotiation with session ticket of user {}", _name, user_name);
+        succ_negotiation(rpc, user_name);
+        return;
+    }
+
+    // keep waiting for SASL_LIST_MECHANISMS, the client will do the full negotiation
+    rpc.response().status = negotiation_status::type::SASL_RESUME_REJECTED;
+}
+
 void server_negotiation::on_select_mechanism(negotiation_rpc rpc)
 {
     const negotiation_request &request = rpc.request();
@@ -162,6 +180,7 @@ void server_negotiation::succ_negotiation(negotiation_rpc rpc, const std::string
 {
     negotiation_response &response = rpc.response();
     _status = response.status = negotiation_status::type::SASL_SUCC;
+    response.msg = issue_session_ticket(user_name, _session->remote_address());
     _session->set_client_username(user_name);
     _session->set_negotiation_succeed();
     ddebug_f("{}: negotiation succeed", _name);
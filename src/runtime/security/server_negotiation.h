@@ -38,6 +38,7 @@ public:
 
 private:
     void on_list_mechanisms(negotiation_rpc rpc);
+    void on_resume(negotiation_rpc rpc);
     void on_select_mechanism(negotiation_rpc rpc);
     void on_initiate(negotiation_rpc rpc);
     void on_challenge_resp(negotiation_rpc rpc);
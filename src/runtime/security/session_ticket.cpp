@@ -0,0 +1,176 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "session_ticket.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utils/time_utils.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <unordered_map>
+#include <mutex>
+
+namespace dsn {
+namespace security {
+DSN_DEFINE_string("security",
+                  session_ticket_key,
+                  "",
+                  "the secret shared by all servers to sign session tickets, "
+                  "session resumption is disabled if it's empty");
+DSN_DEFINE_uint32("security",
+                  session_ticket_lifetime_seconds,
+                  3600,
+                  "how long a session ticket can be used to resume a negotiation");
+
+namespace {
+const uint8_t TICKET_VERSION = 1;
+const size_t TICKET_MAC_LENGTH = 32;
+const size_t TICKET_HEADER_LENGTH = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint16_t);
+
+void compute_mac(const char *data,
+                 size_t length,
+                 const rpc_address &client,
+                 unsigned char mac[TICKET_MAC_LENGTH])
+{
+    // bind the ticket to the client ip, so it's useless when leaked to other hosts
+    uint32_t ip = client.ip();
+    std::string input(data, length);
+    input.append(reinterpret_cast<const char *>(&ip), sizeof(ip));
+
+    unsigned int mac_length = 0;
+    HMAC(EVP_sha256(),
+         FLAGS_session_ticket_key,
+         static_cast<int>(strlen(FLAGS_session_ticket_key)),
+         reinterpret_cast<const unsigned char *>(input.data()),
+         input.length(),
+         mac,
+         &mac_length);
+}
+
+// Returns the expire time of the ticket, or 0 if it's malformed.
+uint64_t get_expire_seconds(const blob &ticket)
+{
+    if (ticket.length() < TICKET_HEADER_LENGTH + TICKET_MAC_LENGTH ||
+        static_cast<uint8_t>(ticket.data()[0]) != TICKET_VERSION) {
+        return 0;
+    }
+    uint64_t expire_s;
+    uint16_t name_length;
+    memcpy(&expire_s, ticket.data() + 1, sizeof(expire_s));
+    memcpy(&name_length, ticket.data() + 1 + sizeof(expire_s), sizeof(name_length));
+    if (ticket.length() != TICKET_HEADER_LENGTH + name_length + TICKET_MAC_LENGTH) {
+        return 0;
+    }
+    return expire_s;
+}
+} // anonymous namespace
+
+bool session_ticket_enabled() { return strlen(FLAGS_session_ticket_key) > 0; }
+
+blob issue_session_ticket(const std::string &user_name, const rpc_address &client)
+{
+    if (!session_ticket_enabled() || user_name.length() > UINT16_MAX) {
+        return blob();
+    }
+
+    uint64_t expire_s =
+        utils::get_current_physical_time_s() + FLAGS_session_ticket_lifetime_seconds;
+    uint16_t name_length = static_cast<uint16_t>(user_name.length());
+
+    size_t body_length = TICKET_HEADER_LENGTH + name_length;
+    std::shared_ptr<char> buf(new char[body_length + TICKET_MAC_LENGTH],
+                              std::default_delete<char[]>());
+    char *p = buf.get();
+    *p++ = static_cast<char>(TICKET_VERSION);
+    memcpy(p, &expire_s, sizeof(expire_s));
+    p += sizeof(expire_s);
+    memcpy(p, &name_length, sizeof(name_length));
+    p += sizeof(name_length);
+    memcpy(p, user_name.data(), name_length);
+    compute_mac(buf.get(), body_length, client, reinterpret_cast<unsigned char *>(p + name_length));
+
+    return blob(std::move(buf), static_cast<unsigned int>(body_length + TICKET_MAC_LENGTH));
+}
+
+bool verify_session_ticket(const blob &ticket, const rpc_address &client, std::string &user_name)
+{
+    if (!session_ticket_enabled()) {
+        return false;
+    }
+
+    uint64_t expire_s = get_expire_seconds(ticket);
+    if (expire_s == 0) {
+        dwarn_f("receive a malformed session ticket from {}", client.to_string());
+        return false;
+    }
+
+    size_t body_length = ticket.length() - TICKET_MAC_LENGTH;
+    unsigned char mac[TICKET_MAC_LENGTH];
+    compute_mac(ticket.data(), body_length, client, mac);
+    if (CRYPTO_memcmp(mac, ticket.data() + body_length, TICKET_MAC_LENGTH) != 0) {
+        dwarn_f("receive a session ticket with bad signature from {}", client.to_string());
+        return false;
+    }
+
+    if (expire_s <= utils::get_current_physical_time_s()) {
+        ddebug_f("the session ticket from {} is expired", client.to_string());
+        return false;
+    }
+
+    user_name.assign(ticket.data() + TICKET_HEADER_LENGTH, body_length - TICKET_HEADER_LENGTH);
+    return true;
+}
+
+namespace {
+std::mutex ticket_cache_lock;
+std::unordered_map<rpc_address, blob> ticket_cache;
+} // anonymous namespace
+
+void session_ticket_cache::put(const rpc_address &server, const blob &ticket)
+{
+    if (get_expire_seconds(ticket) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> l(ticket_cache_lock);
+    ticket_cache[server] = ticket;
+}
+
+bool session_ticket_cache::get(const rpc_address &server, blob &ticket)
+{
+    std::lock_guard<std::mutex> l(ticket_cache_lock);
+    auto iter = ticket_cache.find(server);
+    if (iter == ticket_cache.end()) {
+        return false;
+    }
+    if (get_expire_seconds(iter->second) <= utils::get_current_physical_time_s()) {
+        ticket_cache.erase(iter);
+        return false;
+    }
+    ticket = iter->second;
+    return true;
+}
+
+void session_ticket_cache::remove(const rpc_address &server)
+{
+    std::lock_guard<std::mutex> l(ticket_cache_lock);
+    ticket_cache.erase(server);
+}
+
+} // namespace security
+} // namespace dsn
@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool-api/rpc_address.h>
+#include <dsn/utility/blob.h>
+#include <string>
+
+namespace dsn {
+namespace security {
+
+// A session ticket lets a client that has recently passed SASL negotiation skip the
+// mechanism/challenge rounds when it reconnects. The server issues a ticket in SASL_SUCC,
+// and the client presents it in SASL_RESUME on the next connection to the same server.
+//
+// The ticket is signed with HMAC-SHA256 under [security] session_ticket_key, so every
+// server sharing the key accepts tickets issued by any of them. It carries the
+// authenticated user name and an expire time, and is bound to the client ip.
+//
+// layout: | version(1) | expire_s(8) | name_len(2) | user_name | hmac(32) |
+
+// Whether session tickets are enabled, i.e. session_ticket_key is configured.
+bool session_ticket_enabled();
+
+// Issue a ticket for `user_name` which connects from `client`.
+// Returns an empty blob if session tickets are disabled.
+blob issue_session_ticket(const std::string &user_name, const rpc_address &client);
+
+// Verify the `ticket` presented by `client`. Returns true and sets `user_name` if the
+// signature is valid and the ticket has not expired.
+bool verify_session_ticket(const blob &ticket, const rpc_address &client, std::string &user_name);
+
+// Client-side cache of the tickets received from each server.
+class session_ticket_cache
+{
+public:
+    static void put(const rpc_address &server, const blob &ticket);
+    // Returns false if no unexpired ticket is cached for `server`.
+    static bool get(const rpc_address &server, blob &ticket);
+    static void remove(const rpc_address &server);
+};
+
+} // namespace security
+} // namespace dsn
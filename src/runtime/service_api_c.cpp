@@ -39,6 +39,8 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/process_utils.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/startup_report.h>
+#include <dsn/utility/clock.h>
 #include <dsn/utils/time_utils.h>
 #include <dsn/utility/errors.h>
 #include <dsn/dist/fmt_logging.h>
@@ -57,6 +59,9 @@ namespace dsn {
 namespace security {
 DSN_DECLARE_bool(enable_auth);
 } // namespace security
+namespace utils {
+DSN_DECLARE_string(clock_source);
+} // namespace utils
 } // namespace dsn
 //
 // global state
@@ -148,6 +153,13 @@ DSN_API dsn::message_ex *dsn_rpc_call_wait(dsn::rpc_address server, dsn::message
     }
 }
 
+DSN_API void dsn_rpc_prepare_session(dsn::rpc_address server, dsn::message_ex *request)
+{
+    request->add_ref();
+    ::dsn::task::get_current_rpc()->prepare_session(server, request);
+    request->release_ref();
+}
+
 DSN_API void dsn_rpc_call_one_way(dsn::rpc_address server, dsn::message_ex *request)
 {
     auto msg = ((::dsn::message_ex *)request);
@@ -352,14 +364,25 @@ bool run(const char *config_file,
     // dsn_config_get_value_uint64() to load the corresponding configs. That will make
     // dsn_config_get_value_uint64() get wrong value if we put dsn_config_load at behind of
     // dsn_global_init()
-    if (!dsn_config_load(config_file, config_arguments)) {
-        printf("Fail to load config file %s\n", config_file);
-        return false;
+    {
+        dsn::utils::startup_phase_timer t("load_config");
+        if (!dsn_config_load(config_file, config_arguments)) {
+            printf("Fail to load config file %s\n", config_file);
+            return false;
+        }
+        dsn::flags_initialize();
+        if (!dsn::utils::clock::select(dsn::utils::FLAGS_clock_source)) {
+            printf("unknown [core] clock_source %s\n", dsn::utils::FLAGS_clock_source);
+            return false;
+        }
     }
-    dsn::flags_initialize();
 
-    dsn_global_init();
-    dsn_core_init();
+    {
+        // the perf counters and the task codes are registered here
+        dsn::utils::startup_phase_timer t("init_global");
+        dsn_global_init();
+        dsn_core_init();
+    }
     ::dsn::task::set_tls_dsn_context(nullptr, nullptr);
 
     dsn_all.engine_ready = false;
@@ -382,6 +405,8 @@ bool run(const char *config_file,
     }
 
     // initialize global specification from config file
+    std::unique_ptr<dsn::utils::startup_phase_timer> spec_timer(
+        new dsn::utils::startup_phase_timer("init_service_spec"));
     ::dsn::service_spec spec;
     if (!spec.init()) {
         printf("error in config file %s, exit ...\n", config_file);
@@ -425,6 +450,7 @@ bool run(const char *config_file,
         printf("error in config file %s, exit ...\n", config_file);
         return false;
     }
+    spec_timer.reset();
 
 #ifdef DSN_ENABLE_GPERF
     double_t tcmalloc_release_rate =
@@ -440,6 +466,8 @@ bool run(const char *config_file,
     dsn_log_init(spec.logging_factory_name, spec.dir_log, dsn_log_prefixed_message_func);
 
     // prepare minimum necessary
+    std::unique_ptr<dsn::utils::startup_phase_timer> engine_timer(
+        new dsn::utils::startup_phase_timer("init_engine"));
     ::dsn::service_engine::instance().init_before_toollets(spec);
 
     ddebug("process(%ld) start: %" PRIu64 ", date: %s",
@@ -462,11 +490,13 @@ bool run(const char *config_file,
 
     // init runtime
     ::dsn::service_engine::instance().init_after_toollets();
+    engine_timer.reset();
 
     dsn_all.engine_ready = true;
 
     // init security if FLAGS_enable_auth == true
     if (dsn::security::FLAGS_enable_auth) {
+        dsn::utils::startup_phase_timer t("init_security");
         if (!dsn::security::init(is_server)) {
             return false;
         }
@@ -501,6 +531,7 @@ bool run(const char *config_file,
         }
 
         if (create_it) {
+            dsn::utils::startup_phase_timer t(fmt::format("start_app.{}", sp.full_name));
             ::dsn::service_engine::instance().start_node(sp);
         }
     }
@@ -532,7 +563,11 @@ bool run(const char *config_file,
                                                       });
 
     // invoke customized init after apps are created
-    dsn::tools::sys_init_after_app_created.execute();
+    {
+        dsn::utils::startup_phase_timer t("init_after_apps");
+        dsn::tools::sys_init_after_app_created.execute();
+    }
+    dsn::utils::startup_report::instance().complete();
 
     // start the tool
     dsn_all.tool->run();
@@ -27,11 +27,14 @@
 #include "service_engine.h"
 #include "runtime/task/task_engine.h"
 #include "runtime/rpc/rpc_engine.h"
+#include "runtime/rpc/rpc_size_stats.h"
 
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/smart_pointers.h>
 #include <dsn/tool-api/env_provider.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/tool_api.h>
 #include <dsn/tool/node_scoper.h>
 
@@ -151,6 +154,11 @@ void service_node::get_queue_info(
     ss << "]}";
 }
 
+void service_node::get_worker_stats(/*out*/ utils::table_printer &tp)
+{
+    _computation->get_worker_stats(tp);
+}
+
 rpc_request_task *service_node::generate_intercepted_request_task(message_ex *req)
 {
     bool is_write = task_spec::get(req->local_rpc_code)->rpc_request_is_write_operation;
@@ -184,12 +192,28 @@ service_engine::service_engine()
         "system.queue - get queue internal information",
         "system.queue",
         &service_engine::get_queue_info);
+
+    _get_thread_pool_stats_cmd = dsn::command_manager::instance().register_command(
+        {"thread-pool-stats"},
+        "thread-pool-stats - get the queue depth, queue wait time (us) and busy ratio of each "
+        "worker since the last call, only for the pools with enable_worker_stats",
+        "thread-pool-stats [json]",
+        &service_engine::get_thread_pool_stats);
+
+    _get_rpc_size_stats_cmd = dsn::command_manager::instance().register_command(
+        {"rpc-size-stats"},
+        "rpc-size-stats - get the sampled body sizes of the messages of each task code, and the "
+        "top remote addresses by the bytes per second of their sessions since the last call",
+        "rpc-size-stats [json] [top_n=10]",
+        &service_engine::get_rpc_size_stats);
 }
 
 service_engine::~service_engine()
 {
     UNREGISTER_VALID_HANDLER(_get_runtime_info_cmd);
     UNREGISTER_VALID_HANDLER(_get_queue_info_cmd);
+    UNREGISTER_VALID_HANDLER(_get_thread_pool_stats_cmd);
+    UNREGISTER_VALID_HANDLER(_get_rpc_size_stats_cmd);
 }
 
 void service_engine::init_before_toollets(const service_spec &spec)
@@ -284,6 +308,51 @@ std::string service_engine::get_queue_info(const std::vector<std::string> &args)
     return ss.str();
 }
 
+std::string service_engine::get_thread_pool_stats(const std::vector<std::string> &args)
+{
+    utils::table_printer tp("thread_pool_stats");
+    tp.add_title("worker");
+    tp.add_column("queue_depth", utils::table_printer::alignment::kRight);
+    tp.add_column("tasks", utils::table_printer::alignment::kRight);
+    tp.add_column("tasks_per_sec", utils::table_printer::alignment::kRight);
+    tp.add_column("busy_ratio", utils::table_printer::alignment::kRight);
+    tp.add_column("wait_p50_us", utils::table_printer::alignment::kRight);
+    tp.add_column("wait_p99_us", utils::table_printer::alignment::kRight);
+    tp.add_column("wait_max_us", utils::table_printer::alignment::kRight);
+    for (auto &it : service_engine::instance()._nodes_by_app_id) {
+        it.second->get_worker_stats(tp);
+    }
+
+    std::ostringstream out;
+    if (!args.empty() && args[0] == "json") {
+        tp.output(out, utils::table_printer::output_format::kJsonCompact);
+    } else {
+        tp.output(out);
+    }
+    return out.str();
+}
+
+std::string service_engine::get_rpc_size_stats(const std::vector<std::string> &args)
+{
+    bool json = false;
+    int top_n = 10;
+    for (const auto &arg : args) {
+        if (arg == "json") {
+            json = true;
+        } else if (!dsn::buf2int32(arg, top_n) || top_n < 0) {
+            return "invalid argument: " + arg;
+        }
+    }
+
+    utils::multi_table_printer mtp;
+    rpc_size_stats::instance().get_stats(top_n, mtp);
+    std::ostringstream out;
+    mtp.output(out,
+               json ? utils::table_printer::output_format::kJsonCompact
+                    : utils::table_printer::output_format::kTabular);
+    return out.str();
+}
+
 bool service_engine::is_simulator() const { return _simulator; }
 
 void service_engine::set_simulator() { _simulator = true; }
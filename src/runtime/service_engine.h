@@ -50,6 +50,9 @@ namespace dsn {
 class task_engine;
 class rpc_engine;
 class env_provider;
+namespace utils {
+class table_printer;
+}
 class nfs_node;
 class task_queue;
 class task_worker_pool;
@@ -72,6 +75,7 @@ public:
                           const std::vector<std::string> &args,
                           /*out*/ std::stringstream &ss);
     void get_queue_info(/*out*/ std::stringstream &ss);
+    void get_worker_stats(/*out*/ utils::table_printer &tp);
 
     dsn::error_code start();
     dsn::error_code start_app();
@@ -117,6 +121,8 @@ public:
     env_provider *env() const { return _env; }
     static std::string get_runtime_info(const std::vector<std::string> &args);
     static std::string get_queue_info(const std::vector<std::string> &args);
+    static std::string get_thread_pool_stats(const std::vector<std::string> &args);
+    static std::string get_rpc_size_stats(const std::vector<std::string> &args);
 
     void init_before_toollets(const service_spec &spec);
     void init_after_toollets();
@@ -132,6 +138,8 @@ private:
 
     dsn_handle_t _get_runtime_info_cmd;
     dsn_handle_t _get_queue_info_cmd;
+    dsn_handle_t _get_thread_pool_stats_cmd;
+    dsn_handle_t _get_rpc_size_stats_cmd;
 
     bool _simulator;
 
@@ -18,6 +18,8 @@ public:
 
     // Gets simulated time in nanoseconds.
     virtual uint64_t now_ns() const { return scheduler::instance().now_ns(); }
+
+    virtual uint64_t coarse_now_ns() const { return now_ns(); }
 };
 
 } // namespace tools
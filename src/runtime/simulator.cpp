@@ -33,7 +33,14 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+#include <random>
+
 #include <dsn/tool/simulator.h>
+#include <dsn/utility/filesystem.h>
 #include "scheduler.h"
 #include "service_engine.h"
 
@@ -50,8 +57,114 @@ void simulator::register_checker(const std::string &name, checker::factory f)
     scheduler::instance().add_checker(name, f);
 }
 
+// Runs the simulations of `runs` random seeds from `base_seed` in the child processes, at
+// most `concurrency` of them at a time, and exits with whether all of them have passed.
+// Returns in the child processes, each of which keeps its data and output in
+// <data_dir>/sim.<seed>.
+static void run_seeds_in_processes(service_spec &spec,
+                                   int base_seed,
+                                   uint32_t runs,
+                                   uint32_t concurrency)
+{
+    std::map<pid_t, int> running;
+    std::vector<int> failed;
+    uint32_t next = 0;
+    while (next < runs || !running.empty()) {
+        if (next < runs && running.size() < concurrency) {
+            int seed = base_seed + static_cast<int>(next++);
+            std::string dir =
+                utils::filesystem::path_combine(spec.data_dir, "sim." + std::to_string(seed));
+            utils::filesystem::create_directory(dir);
+
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if (pid < 0) {
+                printf("fork for random seed %d failed: %s\n", seed, strerror(errno));
+                exit(1);
+            }
+            if (pid == 0) {
+                std::string output = utils::filesystem::path_combine(dir, "output.txt");
+                int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd >= 0) {
+                    dup2(fd, STDOUT_FILENO);
+                    dup2(fd, STDERR_FILENO);
+                    close(fd);
+                }
+                spec.data_dir = dir;
+                spec.dir_coredump = utils::filesystem::path_combine(dir, "coredumps");
+                utils::filesystem::create_directory(spec.dir_coredump);
+                spec.dir_log = utils::filesystem::path_combine(dir, "log");
+                utils::filesystem::create_directory(spec.dir_log);
+                sim_env_provider::set_seed(seed);
+                return;
+            }
+            running.emplace(pid, seed);
+            continue;
+        }
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            printf("simulation of random seed %d passed\n", it->second);
+        } else {
+            if (WIFSIGNALED(status)) {
+                printf("simulation of random seed %d is killed by signal %d\n",
+                       it->second,
+                       WTERMSIG(status));
+            } else {
+                printf("simulation of random seed %d exited with %d\n",
+                       it->second,
+                       WEXITSTATUS(status));
+            }
+            failed.push_back(it->second);
+        }
+        running.erase(it);
+    }
+
+    printf("%u simulations, %zu failed", runs, failed.size());
+    for (size_t i = 0; i < failed.size(); ++i) {
+        printf("%s%d", i == 0 ? ": random seed " : ", ", failed[i]);
+    }
+    printf("\nthe outputs are in %s/sim.<seed>, replay one with [tools.simulator] random_seed\n",
+           spec.data_dir.c_str());
+    exit(failed.empty() ? 0 : 1);
+}
+
 void simulator::install(service_spec &spec)
 {
+    uint32_t parallel_runs = (uint32_t)dsn_config_get_value_uint64(
+        "tools.simulator",
+        "parallel_runs",
+        0,
+        "run the simulation of this many random seeds in the child processes, from "
+        "random_seed on, and exit with whether all of them have passed; 0 to run once in "
+        "this process");
+    if (parallel_runs > 0) {
+        uint32_t concurrency = (uint32_t)dsn_config_get_value_uint64(
+            "tools.simulator",
+            "parallel_processes",
+            0,
+            "how many child processes run the seeds at a time, 0 for the count of cpus");
+        if (concurrency == 0) {
+            concurrency = std::max(1, static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)));
+        }
+        int base_seed = (int)dsn_config_get_value_uint64("tools.simulator",
+                                                         "random_seed",
+                                                         0,
+                                                         "random seed for the simulator, 0 for "
+                                                         "random random seed");
+        if (base_seed == 0) {
+            base_seed = std::random_device{}() & 0x3fffffff;
+        }
+        // no thread is started yet, so it's safe to fork
+        run_seeds_in_processes(spec, base_seed, parallel_runs, concurrency);
+    }
+
     register_component_provider<sim_env_provider>("dsn::tools::sim_env_provider");
     register_component_provider<sim_task_queue>("dsn::tools::sim_task_queue");
     register_component_provider<sim_timer_service>("dsn::tools::sim_timer_service");
@@ -109,6 +222,9 @@ void simulator::install(service_spec &spec)
 
         if (tspec.queue_factory_name == "")
             tspec.queue_factory_name = ("dsn::tools::sim_task_queue");
+
+        if (tspec.timer_factory_name == "")
+            tspec.timer_factory_name = spec.timer_factory_name;
     }
 
     sys_exit.put_front(simulator::on_system_exit, "simulator");
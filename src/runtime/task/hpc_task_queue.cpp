@@ -34,6 +34,7 @@
  */
 
 #include "hpc_task_queue.h"
+#include "task_engine.h"
 #include <boost/function_output_iterator.hpp>
 
 namespace dsn {
@@ -80,5 +81,109 @@ task *hpc_concurrent_task_queue::dequeue(int &batch_size)
     } while (count != 0);
     return head;
 }
+
+work_stealing_task_queue::work_stealing_task_queue(task_worker_pool *pool,
+                                                   int index,
+                                                   task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider)
+{
+}
+
+void work_stealing_task_queue::enqueue(task *task)
+{
+    auto &qs = _queues[task->spec().priority];
+    if (task->hash() == 0) {
+        qs.stealable.enqueue(task);
+    } else {
+        qs.affine.enqueue(task);
+    }
+    _sema.signal(1);
+}
+
+/*static*/ int work_stealing_task_queue::dequeue_bulk(queue_t &q, task *&head, task *&last, int max)
+{
+    auto out = boost::make_function_output_iterator([&head, &last](task *in) {
+        if (last) {
+            last->next = in;
+        } else {
+            head = in;
+        }
+
+        last = in;
+        last->next = nullptr;
+    });
+    return static_cast<int>(q.try_dequeue_bulk(out, max));
+}
+
+std::vector<work_stealing_task_queue *> &work_stealing_task_queue::siblings()
+{
+    // queues are all created before any worker starts, so it's safe to collect
+    // the siblings lazily on the first steal
+    std::call_once(_siblings_once, [this]() {
+        auto &queues = pool()->queues();
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto q = dynamic_cast<work_stealing_task_queue *>(
+                queues[(index() + i) % queues.size()]);
+            if (q != nullptr) {
+                _siblings.push_back(q);
+            }
+        }
+    });
+    return _siblings;
+}
+
+int work_stealing_task_queue::steal(task *&head, task *&last, int max)
+{
+    int stolen = 0;
+    for (auto victim : siblings()) {
+        int count = 0;
+        for (auto &qs : victim->_queues) {
+            count += dequeue_bulk(qs.stealable, head, last, max - stolen - count);
+            if (stolen + count == max) {
+                break;
+            }
+        }
+        if (count > 0) {
+            // as these tasks are moved from victim to here, the queue length and the
+            // semaphore count of the victim should also be moved
+            victim->_sema.tryWaitMany(count);
+            victim->decrease_count(count);
+            increase_count(count);
+            stolen += count;
+        }
+        if (stolen == max) {
+            break;
+        }
+    }
+    return stolen;
+}
+
+task *work_stealing_task_queue::dequeue(int &batch_size)
+{
+    task *head = nullptr, *last = nullptr;
+    int max = batch_size;
+    int count = 0;
+
+    // the semaphore count is only a hint here, as tasks may be stolen after they are
+    // signaled, so the queues are always checked after waiting
+    _sema.waitMany(max, pool()->spec().work_stealing_wait_us);
+    for (auto &qs : _queues) {
+        count += dequeue_bulk(qs.affine, head, last, max - count);
+        if (count == max) {
+            break;
+        }
+        count += dequeue_bulk(qs.stealable, head, last, max - count);
+        if (count == max) {
+            break;
+        }
+    }
+
+    if (count == 0) {
+        count = steal(head, last, max);
+    }
+
+    batch_size = count;
+    return head;
+}
 }
 }
@@ -39,6 +39,8 @@
 #include <concurrentqueue/blockingconcurrentqueue.h>
 
 #include <dsn/tool-api/task_queue.h>
+#include <mutex>
+#include <vector>
 
 namespace dsn {
 namespace tools {
@@ -57,5 +59,41 @@ public:
 
     task *dequeue(/*inout*/ int &batch_size) override;
 };
+
+// work_stealing_task_queue is designed for partitioned thread pools, where each worker
+// owns one queue. Tasks with a non-zero hash are partition-affine: they are only executed
+// by the owner worker, so the per-partition ordering is preserved. Tasks with hash == 0
+// are not bound to any partition, and an idle worker may steal them from its siblings.
+class work_stealing_task_queue : public task_queue
+{
+public:
+    work_stealing_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+private:
+    typedef moodycamel::ConcurrentQueue<task *> queue_t;
+
+    // move at most `max` tasks from `q` into the list [head, last]
+    static int dequeue_bulk(queue_t &q, task *&head, task *&last, int max);
+
+    // get at most `max` stealable tasks from the siblings into the list [head, last]
+    int steal(task *&head, task *&last, int max);
+
+    std::vector<work_stealing_task_queue *> &siblings();
+
+private:
+    moodycamel::LightweightSemaphore _sema;
+    struct
+    {
+        queue_t affine;
+        queue_t stealable;
+    } _queues[TASK_PRIORITY_COUNT];
+
+    std::once_flag _siblings_once;
+    std::vector<work_stealing_task_queue *> _siblings;
+};
 }
 }
@@ -44,6 +44,7 @@
 #include <dsn/dist/fmt_logging.h>
 
 #include "task_engine.h"
+#include "task_object_pool.h"
 #include "runtime/service_engine.h"
 #include "runtime/rpc/rpc_engine.h"
 
@@ -118,6 +119,7 @@ task::task(dsn::task_code code, int hash, service_node *node)
     _wait_for_cancel = false;
     _is_null = false;
     next = nullptr;
+    enqueue_ts_ns = 0;
 
     if (node != nullptr) {
         _node = node;
@@ -147,6 +149,10 @@ task::~task()
     }
 }
 
+/*static*/ void *task::operator new(size_t size) { return task_object_pool::allocate(size); }
+
+/*static*/ void task::operator delete(void *p) { task_object_pool::deallocate(p); }
+
 bool task::set_retry(bool enqueue_immediately /*= true*/)
 {
     task_state RUNNING_STATE = TASK_STATE_RUNNING;
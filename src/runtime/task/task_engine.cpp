@@ -25,14 +25,40 @@
  */
 
 #include "task_engine.h"
+#include <dsn/utility/output_utils.h>
+#include <fmt/format.h>
+#include <cinttypes>
+#include <sys/resource.h>
 
 using namespace dsn::utils;
 
 namespace dsn {
 
 task_worker_pool::task_worker_pool(const threadpool_spec &opts, task_engine *owner)
-    : _spec(opts), _owner(owner), _node(owner->node()), _is_running(false)
+    : _spec(opts),
+      _owner(owner),
+      _node(owner->node()),
+      _is_running(false),
+      _elastic_last_cpu_ns(0),
+      _elastic_idle_rounds(0)
 {
+    if (_spec.elastic_worker_count && _spec.partitioned) {
+        dwarn("thread pool [%s] is partitioned, whose worker count can't be elastic",
+              _spec.name.c_str());
+        _spec.elastic_worker_count = false;
+    }
+    if (_spec.elastic_worker_count) {
+        // the adjustment is made on the queue wait time and the busy time of the workers
+        _spec.enable_worker_stats = true;
+        if (_spec.max_worker_count <= 0) {
+            _spec.max_worker_count = static_cast<int>(std::thread::hardware_concurrency());
+        }
+        _spec.min_worker_count =
+            std::max(1, std::min(_spec.min_worker_count, _spec.max_worker_count));
+        _spec.worker_count =
+            std::max(_spec.min_worker_count, std::min(_spec.worker_count, _spec.max_worker_count));
+    }
+    _active_worker_count.store(_spec.worker_count);
 }
 
 void task_worker_pool::create()
@@ -69,14 +95,13 @@ void task_worker_pool::create()
 
     for (int i = 0; i < qCount; ++i) {
         auto tsvc = factory_store<timer_service>::create(
-            service_engine::instance().spec().timer_factory_name.c_str(),
-            PROVIDER_TYPE_MAIN,
-            _node,
-            nullptr);
+            _spec.timer_factory_name.c_str(), PROVIDER_TYPE_MAIN, _node, nullptr);
         _per_queue_timer_svcs.push_back(tsvc);
     }
 
-    for (int i = 0; i < _spec.worker_count; i++) {
+    // the workers beyond worker_count are parked until the pool grows
+    int thread_count = _spec.elastic_worker_count ? _spec.max_worker_count : _spec.worker_count;
+    for (int i = 0; i < thread_count; i++) {
         auto q = _queues[qCount == 1 ? 0 : i];
         task_worker *worker = factory_store<task_worker>::create(
             _spec.worker_factory_name.c_str(), PROVIDER_TYPE_MAIN, this, q, i, nullptr);
@@ -110,6 +135,133 @@ void task_worker_pool::start()
            _spec.partitioned ? "true" : "false");
 
     _is_running = true;
+
+    if (_spec.elastic_worker_count) {
+        std::string prefix = _spec.name;
+        _active_workers_counter.init_global_counter(_node->full_name(),
+                                                    "engine",
+                                                    (prefix + ".active.workers").c_str(),
+                                                    COUNTER_TYPE_NUMBER,
+                                                    "the active workers of the elastic pool");
+        _worker_grow_counter.init_global_counter(_node->full_name(),
+                                                 "engine",
+                                                 (prefix + ".worker.grow.count").c_str(),
+                                                 COUNTER_TYPE_VOLATILE_NUMBER,
+                                                 "the workers activated in the elastic pool");
+        _worker_shrink_counter.init_global_counter(_node->full_name(),
+                                                   "engine",
+                                                   (prefix + ".worker.shrink.count").c_str(),
+                                                   COUNTER_TYPE_VOLATILE_NUMBER,
+                                                   "the workers parked in the elastic pool");
+        _active_workers_counter->set(_spec.worker_count);
+
+        ddebug("[%s] thread pool [%s] has elastic worker count between %d and %d",
+               _node->full_name(),
+               _spec.name.c_str(),
+               _spec.min_worker_count,
+               _spec.max_worker_count);
+        // lives as long as the process, just like the workers
+        std::thread(&task_worker_pool::elastic_control_loop, this).detach();
+    }
+}
+
+void task_worker_pool::park(task_worker *worker)
+{
+    std::unique_lock<std::mutex> l(_park_lock);
+    _park_cond.wait_for(l, std::chrono::milliseconds(100), [this, worker]() {
+        return worker->index() < _active_worker_count.load(std::memory_order_relaxed);
+    });
+}
+
+static uint64_t process_cpu_ns()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+void task_worker_pool::elastic_control_loop()
+{
+    task_worker::set_name(fmt::format("{}.elastic", _spec.name).c_str());
+    uint64_t last_ns = dsn_now_ns();
+    _elastic_last_cpu_ns = process_cpu_ns();
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(_spec.elastic_adjust_interval_ms));
+        uint64_t now_ns = dsn_now_ns();
+        adjust_worker_count(now_ns - last_ns);
+        last_ns = now_ns;
+    }
+}
+
+void task_worker_pool::adjust_worker_count(uint64_t interval_ns)
+{
+    // the pool grows over the high water mark, and shrinks under the low water mark after
+    // staying there for a few rounds, so it doesn't swing with the bursts
+    static const double GROW_BUSY_RATIO = 0.75;
+    static const double SHRINK_BUSY_RATIO = 0.4;
+    static const double MAX_CPU_RATIO = 0.9;
+    static const int SHRINK_IDLE_ROUNDS = 5;
+
+    task_worker_stats total;
+    _elastic_last_stats.resize(_workers.size());
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        task_worker_stats current = _workers[i]->accumulated_stats();
+        task_worker_stats &last = _elastic_last_stats[i];
+        total.executed_count += current.executed_count - last.executed_count;
+        total.busy_ns += current.busy_ns - last.busy_ns;
+        for (int b = 0; b < task_worker_stats::WAIT_BUCKET_COUNT; ++b) {
+            total.wait_buckets[b] += current.wait_buckets[b] - last.wait_buckets[b];
+        }
+        last = current;
+    }
+    uint64_t cpu_ns = process_cpu_ns();
+    double cpu_ratio = (cpu_ns - _elastic_last_cpu_ns) * 1.0 /
+                       (interval_ns * std::max(1U, std::thread::hardware_concurrency()));
+    _elastic_last_cpu_ns = cpu_ns;
+
+    int active = active_worker_count();
+    double busy_ratio = total.busy_ns * 1.0 / (interval_ns * active);
+    uint64_t wait_us = total.wait_percentile_us(90);
+
+    int target = active;
+    if (wait_us > _spec.elastic_target_wait_us && busy_ratio > GROW_BUSY_RATIO &&
+        cpu_ratio < MAX_CPU_RATIO) {
+        // grow by a quarter to catch up with the bursts quickly
+        target = std::min(_spec.max_worker_count, active + std::max(1, active / 4));
+        _elastic_idle_rounds = 0;
+    } else if (wait_us < _spec.elastic_target_wait_us / 4 && busy_ratio < SHRINK_BUSY_RATIO) {
+        if (++_elastic_idle_rounds >= SHRINK_IDLE_ROUNDS) {
+            target = std::max(_spec.min_worker_count, active - 1);
+            _elastic_idle_rounds = 0;
+        }
+    } else {
+        _elastic_idle_rounds = 0;
+    }
+
+    if (target == active) {
+        return;
+    }
+    ddebug("[%s] thread pool [%s] changes the active workers from %d to %d, the p90 queue wait "
+           "is %" PRIu64 "us, busy ratio is %.2f, cpu ratio is %.2f",
+           _node->full_name(),
+           _spec.name.c_str(),
+           active,
+           target,
+           wait_us,
+           busy_ratio,
+           cpu_ratio);
+    {
+        std::lock_guard<std::mutex> l(_park_lock);
+        _active_worker_count.store(target, std::memory_order_relaxed);
+    }
+    _park_cond.notify_all();
+    _active_workers_counter->set(target);
+    if (target > active) {
+        _worker_grow_counter->add(target - active);
+    } else {
+        _worker_shrink_counter->add(active - target);
+    }
 }
 
 void task_worker_pool::add_timer(task *t)
@@ -200,6 +352,52 @@ void task_worker_pool::get_queue_info(/*out*/ std::stringstream &ss)
     ss << "]\n";
 }
 
+static void append_worker_stats(table_printer &tp,
+                                const std::string &row_name,
+                                int queue_depth,
+                                const task_worker_stats &stats)
+{
+    tp.add_row(row_name);
+    tp.append_data(queue_depth);
+    tp.append_data(stats.executed_count);
+    tp.append_data(stats.tasks_per_second());
+    tp.append_data(stats.busy_ratio());
+    tp.append_data(stats.wait_percentile_us(50));
+    tp.append_data(stats.wait_percentile_us(99));
+    tp.append_data(stats.wait_percentile_us(100));
+}
+
+void task_worker_pool::get_worker_stats(/*out*/ table_printer &tp)
+{
+    std::string prefix = std::string(_node->full_name()) + "." + _spec.name;
+
+    int total_depth = 0;
+    for (auto &q : _queues) {
+        if (q) {
+            total_depth += q->count();
+        }
+    }
+
+    task_worker_stats total;
+    for (auto &wk : _workers) {
+        if (wk) {
+            task_worker_stats stats = wk->collect_stats();
+            append_worker_stats(
+                tp, prefix + "." + std::to_string(wk->index()), wk->queue()->count(), stats);
+            total.merge(stats);
+        }
+    }
+
+    // average the durations and busy time, so that tasks_per_second is the rate of the
+    // whole pool, and busy_ratio is the average of the workers
+    if (!_workers.empty()) {
+        task_worker_stats pool_stats = total;
+        pool_stats.duration_ns = total.duration_ns / _workers.size();
+        pool_stats.busy_ns = total.busy_ns / _workers.size();
+        append_worker_stats(tp, prefix, total_depth, pool_stats);
+    }
+}
+
 task_engine::task_engine(service_node *node)
 {
     _is_running = false;
@@ -270,4 +468,13 @@ void task_engine::get_queue_info(/*out*/ std::stringstream &ss)
         }
     }
 }
+
+void task_engine::get_worker_stats(/*out*/ table_printer &tp)
+{
+    for (auto &p : _pools) {
+        if (p && p->spec().enable_worker_stats) {
+            p->get_worker_stats(tp);
+        }
+    }
+}
 } // end namespace
@@ -40,12 +40,16 @@
 #include <dsn/tool-api/admission_controller.h>
 #include <dsn/tool-api/task_worker.h>
 #include <dsn/tool-api/timer_service.h>
+#include <condition_variable>
 
 namespace dsn {
 
 class task_engine;
 class task_worker_pool;
 class task_worker;
+namespace utils {
+class table_printer;
+}
 
 //
 // a task_worker_pool is a set of TaskWorkers share the same configs;
@@ -76,11 +80,26 @@ public:
                           const std::vector<std::string> &args,
                           /*out*/ std::stringstream &ss);
     void get_queue_info(/*out*/ std::stringstream &ss);
+    // one row for each worker and one for the whole pool, with the stats since the last call
+    void get_worker_stats(/*out*/ utils::table_printer &tp);
     std::vector<task_queue *> &queues() { return _queues; }
     std::vector<task_worker *> &workers() { return _workers; }
     std::vector<admission_controller *> &controllers() { return _controllers; }
 
+    // elastic worker count: the workers whose index >= active_worker_count() are parked. it's
+    // always worker_count if elastic_worker_count is off.
+    int active_worker_count() const
+    {
+        return _active_worker_count.load(std::memory_order_relaxed);
+    }
+    // blocks the parked `worker` for a while, or until it's activated
+    void park(task_worker *worker);
+
 private:
+    // elastic worker count: adjusts the active workers every elastic_adjust_interval_ms
+    void elastic_control_loop();
+    void adjust_worker_count(uint64_t interval_ns);
+
     threadpool_spec _spec;
     task_engine *_owner;
     service_node *_node;
@@ -92,6 +111,18 @@ private:
     std::vector<timer_service *> _per_queue_timer_svcs;
 
     bool _is_running;
+
+    std::atomic<int> _active_worker_count;
+    std::mutex _park_lock;
+    std::condition_variable _park_cond;
+    // the accumulated stats of each worker and the cpu time of the process at the last adjust
+    std::vector<task_worker_stats> _elastic_last_stats;
+    uint64_t _elastic_last_cpu_ns;
+    // the successive adjusts which find the pool idle enough to shrink
+    int _elastic_idle_rounds;
+    perf_counter_wrapper _active_workers_counter;
+    perf_counter_wrapper _worker_grow_counter;
+    perf_counter_wrapper _worker_shrink_counter;
 };
 
 class task_engine
@@ -120,6 +151,7 @@ public:
                           const std::vector<std::string> &args,
                           /*out*/ std::stringstream &ss);
     void get_queue_info(/*out*/ std::stringstream &ss);
+    void get_worker_stats(/*out*/ utils::table_printer &tp);
 
 private:
     std::vector<task_worker_pool *> _pools;
@@ -0,0 +1,252 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "task_object_pool.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+
+DSN_DEFINE_bool("core",
+                enable_task_object_pool,
+                false,
+                "whether to allocate task objects and rpc messages from the per-thread object "
+                "pools");
+DSN_DEFINE_uint32("core",
+                  task_object_pool_max_cached_blocks,
+                  1024,
+                  "max count of the free blocks cached per thread for each size class");
+
+namespace {
+
+class thread_cache;
+
+const size_t SIZE_CLASS_GRANULARITY = 64;
+const int SIZE_CLASS_COUNT = 16;
+const int NOT_POOLED = -1;
+
+// the header is placed just before the object, it's 16 bytes so that the object
+// keeps the alignment of malloc
+struct block_header
+{
+    thread_cache *owner;
+    int size_class;
+    int reserved;
+};
+static_assert(sizeof(block_header) == 16, "block_header should be 16 bytes");
+
+struct free_block
+{
+    free_block *next;
+};
+
+void free_list(free_block *b)
+{
+    while (b != nullptr) {
+        free_block *next = b->next;
+        ::free(b);
+        b = next;
+    }
+}
+
+class thread_cache
+{
+public:
+    thread_cache() : _orphaned(false)
+    {
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            _local[i] = nullptr;
+            _local_count[i] = 0;
+            _remote[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // called by the owner thread
+    block_header *pop(int size_class)
+    {
+        if (_local[size_class] == nullptr) {
+            reclaim(size_class);
+        }
+
+        free_block *b = _local[size_class];
+        if (b == nullptr) {
+            return nullptr;
+        }
+        _local[size_class] = b->next;
+        _local_count[size_class]--;
+        return reinterpret_cast<block_header *>(b);
+    }
+
+    // called by the owner thread
+    void push_local(block_header *h)
+    {
+        int size_class = h->size_class;
+        if (_local_count[size_class] >= FLAGS_task_object_pool_max_cached_blocks) {
+            ::free(h);
+            return;
+        }
+
+        free_block *b = reinterpret_cast<free_block *>(h);
+        b->next = _local[size_class];
+        _local[size_class] = b;
+        _local_count[size_class]++;
+    }
+
+    // called by the other threads
+    void push_remote(block_header *h)
+    {
+        std::atomic<free_block *> &remote = _remote[h->size_class];
+        free_block *b = reinterpret_cast<free_block *>(h);
+        b->next = remote.load(std::memory_order_relaxed);
+        while (!remote.compare_exchange_weak(
+            b->next, b, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        }
+
+        // the owner has exited, nobody else will reclaim the remote list
+        if (_orphaned.load(std::memory_order_seq_cst)) {
+            free_remote_lists();
+        }
+    }
+
+    // called by the owner thread when it exits, the cache itself is never destroyed because
+    // the blocks allocated from it may still be freed by other threads later
+    void orphan()
+    {
+        _orphaned.store(true, std::memory_order_seq_cst);
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            free_list(_local[i]);
+            _local[i] = nullptr;
+            _local_count[i] = 0;
+        }
+        free_remote_lists();
+    }
+
+private:
+    // move the remote free list into the local one, the blocks exceeding the limit are freed
+    void reclaim(int size_class)
+    {
+        free_block *b = _remote[size_class].exchange(nullptr, std::memory_order_acquire);
+        while (b != nullptr) {
+            free_block *next = b->next;
+            push_local(reinterpret_cast<block_header *>(b));
+            b = next;
+        }
+    }
+
+    void free_remote_lists()
+    {
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            free_list(_remote[i].exchange(nullptr, std::memory_order_seq_cst));
+        }
+    }
+
+private:
+    free_block *_local[SIZE_CLASS_COUNT];
+    uint32_t _local_count[SIZE_CLASS_COUNT];
+    std::atomic<free_block *> _remote[SIZE_CLASS_COUNT];
+    std::atomic<bool> _orphaned;
+};
+
+// thread_cache_holder orphans the cache of the current thread when the thread exits
+struct thread_cache_holder
+{
+    thread_cache *cache = nullptr;
+    bool exited = false;
+
+    ~thread_cache_holder()
+    {
+        exited = true;
+        if (cache != nullptr) {
+            cache->orphan();
+            cache = nullptr;
+        }
+    }
+};
+
+thread_local thread_cache_holder tls_cache_holder;
+
+// nullptr is returned if the current thread is exiting
+thread_cache *current_cache()
+{
+    thread_cache_holder &holder = tls_cache_holder;
+    if (holder.cache == nullptr && !holder.exited) {
+        holder.cache = new thread_cache();
+    }
+    return holder.cache;
+}
+
+} // anonymous namespace
+
+/*static*/ size_t task_object_pool::max_pooled_size()
+{
+    return SIZE_CLASS_GRANULARITY * SIZE_CLASS_COUNT - sizeof(block_header);
+}
+
+/*static*/ void *task_object_pool::allocate(size_t size)
+{
+    int size_class = static_cast<int>((size + sizeof(block_header) + SIZE_CLASS_GRANULARITY - 1) /
+                                      SIZE_CLASS_GRANULARITY) -
+                     1;
+    thread_cache *cache = nullptr;
+    if (FLAGS_enable_task_object_pool && size_class < SIZE_CLASS_COUNT) {
+        cache = current_cache();
+    }
+
+    block_header *h = nullptr;
+    if (cache == nullptr) {
+        h = static_cast<block_header *>(::malloc(size + sizeof(block_header)));
+        size_class = NOT_POOLED;
+    } else {
+        h = cache->pop(size_class);
+        if (h == nullptr) {
+            h = static_cast<block_header *>(
+                ::malloc(SIZE_CLASS_GRANULARITY * static_cast<size_t>(size_class + 1)));
+        }
+    }
+
+    if (h == nullptr) {
+        throw std::bad_alloc();
+    }
+    h->owner = cache;
+    h->size_class = size_class;
+    return h + 1;
+}
+
+/*static*/ void task_object_pool::deallocate(void *p)
+{
+    if (p == nullptr) {
+        return;
+    }
+
+    block_header *h = static_cast<block_header *>(p) - 1;
+    if (h->size_class == NOT_POOLED) {
+        ::free(h);
+        return;
+    }
+
+    thread_cache *owner = h->owner;
+    if (owner == tls_cache_holder.cache) {
+        owner->push_local(h);
+    } else {
+        owner->push_remote(h);
+    }
+}
+
+} // namespace dsn
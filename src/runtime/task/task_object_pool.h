@@ -0,0 +1,43 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+
+namespace dsn {
+
+// task_object_pool serves the allocations of task objects (task, rpc_response_task, aio_task,
+// etc.) and rpc messages from per-thread free lists, so that creating a task or a message on
+// the hot path costs no malloc.
+//
+// The blocks are grouped into size classes. A block freed by its owner thread goes back to the
+// owner's local free list directly; a block freed by another thread is pushed into the owner's
+// lock-free remote free list, which is reclaimed by the owner when its local free list is empty.
+//
+// It is enabled by [core] enable_task_object_pool, blocks are allocated by malloc when disabled.
+class task_object_pool
+{
+public:
+    static void *allocate(size_t size);
+    static void deallocate(void *p);
+
+    // the max object size served by the pool, larger objects are allocated by malloc
+    static size_t max_pooled_size();
+};
+
+} // namespace dsn
@@ -94,6 +94,10 @@ void task_queue::enqueue_internal(task *task)
         }
     }
 
+    if (_spec->enable_worker_stats) {
+        task->enqueue_ts_ns = dsn_now_ns();
+    }
+
     tls_dsn.last_worker_queue_size = increase_count();
     enqueue(task);
 }
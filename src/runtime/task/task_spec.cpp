@@ -37,6 +37,7 @@
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/threadpool_spec.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/perf_counter/perf_counters.h>
 
 namespace dsn {
 
@@ -144,8 +145,15 @@ task_spec::task_spec(int code,
       priority(pri),
       pool_code(pool),
       rpc_call_header_format(NET_HDR_DSN),
+      rpc_msg_payload_serialize_default_format(DSF_INVALID),
       rpc_call_channel(RPC_CHANNEL_TCP),
       rpc_message_crc_required(false),
+      rpc_message_compression_type(RCT_NONE),
+      rpc_message_compression_threshold_bytes(4096),
+      rpc_request_coalescing_enabled(false),
+      rpc_call_connection_slot(-1),
+      rpc_read_hedging_enabled(false),
+      disk_io_priority(DIO_PRIORITY_INVALID),
       on_task_create((std::string(name) + std::string(".create")).c_str()),
       on_task_enqueue((std::string(name) + std::string(".enqueue")).c_str()),
       on_task_begin((std::string(name) + std::string(".begin")).c_str()),
@@ -226,6 +234,17 @@ bool task_spec::init()
                 return false;
             }
         }
+
+        if (spec->type == TASK_TYPE_RPC_REQUEST &&
+            spec->rpc_request_dropped_before_execution_when_timeout) {
+            spec->rpc_request_dropped_counter = perf_counters::instance().get_global_counter(
+                "zion",
+                "engine",
+                (spec->name + ".dropped.timeout").c_str(),
+                COUNTER_TYPE_RATE,
+                "requests dropped before execution for timeout per second",
+                true);
+        }
     }
 
     ::dsn::command_manager::instance().register_command(
@@ -256,6 +275,45 @@ bool task_spec::init()
     return true;
 }
 
+disk_io_priority_t task_spec::get_disk_io_priority() const
+{
+    if (disk_io_priority != DIO_PRIORITY_INVALID) {
+        return disk_io_priority;
+    }
+    switch (priority) {
+    case TASK_PRIORITY_HIGH:
+        return DIO_PRIORITY_HIGH;
+    case TASK_PRIORITY_LOW:
+        return DIO_PRIORITY_LOW;
+    default:
+        return DIO_PRIORITY_NORMAL;
+    }
+}
+
+void task_spec::set_default_disk_io_priority(task_code code, disk_io_priority_t pri)
+{
+    task_spec *spec = task_spec::get(code);
+    if (spec->disk_io_priority == DIO_PRIORITY_INVALID) {
+        spec->disk_io_priority = pri;
+    }
+}
+
+dsn_msg_serialize_format task_spec::get_rpc_msg_payload_serialize_format() const
+{
+    return rpc_msg_payload_serialize_default_format == DSF_INVALID
+               ? DSF_THRIFT_BINARY
+               : rpc_msg_payload_serialize_default_format;
+}
+
+void task_spec::set_default_rpc_msg_payload_serialize_format(task_code code,
+                                                             dsn_msg_serialize_format fmt)
+{
+    task_spec *spec = task_spec::get(code);
+    if (spec->rpc_msg_payload_serialize_default_format == DSF_INVALID) {
+        spec->rpc_msg_payload_serialize_default_format = fmt;
+    }
+}
+
 bool threadpool_spec::init(/*out*/ std::vector<threadpool_spec> &specs)
 {
     /*
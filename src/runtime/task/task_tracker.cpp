@@ -36,21 +36,30 @@
 #include <dsn/tool-api/task_tracker.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool_api.h>
+#include <thread>
 
 namespace dsn {
 
-task_tracker::task_tracker(int task_bucket_count) : _task_bucket_count(task_bucket_count)
+/*static*/ int task_tracker::get_task_bucket_count(int task_bucket_count)
 {
-    _outstanding_tasks_lock = new ::dsn::utils::ex_lock_nr_spin[_task_bucket_count];
-    _outstanding_tasks = new dlink[_task_bucket_count];
+    if (task_bucket_count == PER_THREAD_SHARDED) {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    dassert(task_bucket_count > 0, "invalid task bucket count %d", task_bucket_count);
+    return task_bucket_count;
+}
+
+task_tracker::task_tracker(int task_bucket_count)
+    : _task_bucket_count(get_task_bucket_count(task_bucket_count))
+{
+    _buckets = new bucket[_task_bucket_count];
 }
 
 task_tracker::~task_tracker()
 {
     cancel_outstanding_tasks();
 
-    delete[] _outstanding_tasks;
-    delete[] _outstanding_tasks_lock;
+    delete[] _buckets;
 }
 
 // TODO:
@@ -80,9 +89,9 @@ void task_tracker::wait_outstanding_tasks()
             trackable_task *tcm;
 
             {
-                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-                auto n = _outstanding_tasks[i].next();
-                if (n != &_outstanding_tasks[i]) {
+                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_buckets[i].lock);
+                auto n = _buckets[i].tasks.next();
+                if (n != &_buckets[i].tasks) {
                     tcm = CONTAINING_RECORD(n, trackable_task, _dl);
 
                     // try to get the lock
@@ -122,9 +131,9 @@ void task_tracker::cancel_outstanding_tasks()
             trackable_task *tcm;
 
             {
-                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-                auto n = _outstanding_tasks[i].next();
-                if (n != &_outstanding_tasks[i]) {
+                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_buckets[i].lock);
+                auto n = _buckets[i].tasks.next();
+                if (n != &_buckets[i].tasks) {
                     tcm = CONTAINING_RECORD(n, trackable_task, _dl);
                     prepare_state = tcm->owner_delete_prepare();
                 } else
@@ -157,9 +166,9 @@ int task_tracker::cancel_but_not_wait_outstanding_tasks()
 {
     int not_finished = 0;
     for (int i = 0; i < _task_bucket_count; i++) {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-        auto n = _outstanding_tasks[i].next();
-        if (n != &_outstanding_tasks[i]) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_buckets[i].lock);
+        auto n = _buckets[i].tasks.next();
+        if (n != &_buckets[i].tasks) {
             trackable_task *tcm = CONTAINING_RECORD(n, trackable_task, _dl);
             if (tcm->_task != task::get_current_task()) {
                 bool finished;
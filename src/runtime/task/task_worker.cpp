@@ -26,7 +26,10 @@
 
 #include <sstream>
 #include <dsn/utility/process_utils.h>
+#include <dsn/utility/numa.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/c/api_layer1.h>
+#include <fmt/format.h>
 
 #include "task_engine.h"
 
@@ -52,6 +55,23 @@ task_worker::task_worker(task_worker_pool *pool,
 
     _thread = nullptr;
     _processed_task_count = 0;
+    _avg_task_exec_ns = 0;
+
+    _stat_executed_count.store(0);
+    _stat_busy_ns.store(0);
+    for (auto &b : _stat_wait_buckets) {
+        b.store(0);
+    }
+    _last_stats.timestamp_ns = dsn_now_ns();
+
+    if (pool->spec().adaptive_dequeue_batch) {
+        _dequeue_batch_size_counter.init_global_counter(
+            pool->node()->full_name(),
+            "engine",
+            fmt::format("{}.{}.dequeue.batch.size", pool->spec().name, index).c_str(),
+            COUNTER_TYPE_NUMBER,
+            "the current adaptive dequeue batch size of the worker");
+    }
 }
 
 task_worker::~task_worker()
@@ -161,7 +181,14 @@ void task_worker::run_internal()
     set_name(name().c_str());
     set_priority(pool_spec().worker_priority);
 
-    if (true == pool_spec().worker_share_core) {
+    int numa_node = pool_spec().numa_node;
+    if (numa_node < 0 && pool_spec().numa_spread) {
+        numa_node = static_cast<int>(_index * static_cast<uint64_t>(utils::numa::node_count()) /
+                                     pool()->workers().size());
+    }
+    if (numa_node >= 0) {
+        utils::numa::bind_current_thread(numa_node);
+    } else if (true == pool_spec().worker_share_core) {
         if (pool_spec().worker_affinity_mask > 0) {
             set_affinity(pool_spec().worker_affinity_mask);
         }
@@ -191,14 +218,87 @@ void task_worker::run_internal()
     loop();
 }
 
+int task_worker::next_adaptive_batch_size()
+{
+    const threadpool_spec &spec = pool_spec();
+
+    // leave some tasks to the other workers sharing the same queue
+    int workers_per_queue = spec.partitioned ? 1 : pool()->active_worker_count();
+    int size = (queue()->count() + workers_per_queue - 1) / workers_per_queue;
+
+    // a batch should not be executed for too long, otherwise the tasks
+    // at the tail of the batch are delayed for nothing
+    if (_avg_task_exec_ns > 0) {
+        uint64_t limit = spec.adaptive_dequeue_batch_target_us * 1000ULL / _avg_task_exec_ns;
+        size = static_cast<int>(std::min(static_cast<uint64_t>(size), limit));
+    }
+
+    size = std::max(1, std::min(size, spec.adaptive_dequeue_batch_max_size));
+    _dequeue_batch_size_counter->set(size);
+    return size;
+}
+
+void task_worker::on_batch_executed(int batch_size, uint64_t exec_ns)
+{
+    if (batch_size <= 0) {
+        return;
+    }
+
+    // exponential moving average with weight 1/8 for the new sample
+    uint64_t sample = exec_ns / batch_size;
+    if (_avg_task_exec_ns == 0) {
+        _avg_task_exec_ns = std::max(sample, (uint64_t)1);
+    } else {
+        _avg_task_exec_ns = std::max((_avg_task_exec_ns * 7 + sample) / 8, (uint64_t)1);
+    }
+}
+
+task_worker_stats task_worker::accumulated_stats() const
+{
+    task_worker_stats current;
+    current.timestamp_ns = dsn_now_ns();
+    current.executed_count = _stat_executed_count.load(std::memory_order_relaxed);
+    current.busy_ns = _stat_busy_ns.load(std::memory_order_relaxed);
+    for (int i = 0; i < task_worker_stats::WAIT_BUCKET_COUNT; ++i) {
+        current.wait_buckets[i] = _stat_wait_buckets[i].load(std::memory_order_relaxed);
+    }
+    return current;
+}
+
+task_worker_stats task_worker::collect_stats()
+{
+    task_worker_stats current = accumulated_stats();
+
+    std::lock_guard<std::mutex> l(_stats_lock);
+    task_worker_stats delta;
+    delta.timestamp_ns = current.timestamp_ns;
+    delta.duration_ns = current.timestamp_ns - _last_stats.timestamp_ns;
+    delta.executed_count = current.executed_count - _last_stats.executed_count;
+    delta.busy_ns = current.busy_ns - _last_stats.busy_ns;
+    for (int i = 0; i < task_worker_stats::WAIT_BUCKET_COUNT; ++i) {
+        delta.wait_buckets[i] = current.wait_buckets[i] - _last_stats.wait_buckets[i];
+    }
+    _last_stats = current;
+    return delta;
+}
+
 void task_worker::loop()
 {
     task_queue *q = queue();
     int best_batch_size = pool_spec().dequeue_batch_size;
+    bool adaptive = pool_spec().adaptive_dequeue_batch;
+    bool stats = pool_spec().enable_worker_stats;
+    bool elastic = pool_spec().elastic_worker_count;
 
     while (_is_running) {
-        int batch_size = best_batch_size;
+        if (elastic && dsn_unlikely(_index >= pool()->active_worker_count())) {
+            pool()->park(this);
+            continue;
+        }
+
+        int batch_size = adaptive ? next_adaptive_batch_size() : best_batch_size;
         task *task = q->dequeue(batch_size), *next;
+        uint64_t start_ns = (adaptive || stats) ? dsn_now_ns() : 0;
 
         q->decrease_count(batch_size);
 
@@ -208,6 +308,12 @@ void task_worker::loop()
         while (task != nullptr) {
             next = task->next;
             task->next = nullptr;
+            if (stats) {
+                // the task may be released after executed, so record the wait time first
+                uint64_t wait_ns =
+                    start_ns > task->enqueue_ts_ns ? start_ns - task->enqueue_ts_ns : 0;
+                add_stat(_stat_wait_buckets[task_worker_stats::wait_bucket(wait_ns)], 1);
+            }
             task->exec_internal();
             task = next;
 #ifndef NDEBUG
@@ -222,10 +328,75 @@ void task_worker::loop()
                 batch_size);
 #endif
 
+        if (adaptive || stats) {
+            uint64_t exec_ns = dsn_now_ns() - start_ns;
+            if (adaptive) {
+                on_batch_executed(batch_size, exec_ns);
+            }
+            if (stats) {
+                add_stat(_stat_executed_count, batch_size);
+                add_stat(_stat_busy_ns, exec_ns);
+            }
+        }
+
         _processed_task_count += batch_size;
     }
 }
 
 const threadpool_spec &task_worker::pool_spec() const { return pool()->spec(); }
 
+void task_worker_stats::reset()
+{
+    timestamp_ns = 0;
+    duration_ns = 0;
+    executed_count = 0;
+    busy_ns = 0;
+    for (auto &b : wait_buckets) {
+        b = 0;
+    }
+}
+
+void task_worker_stats::merge(const task_worker_stats &other)
+{
+    timestamp_ns = std::max(timestamp_ns, other.timestamp_ns);
+    duration_ns += other.duration_ns;
+    executed_count += other.executed_count;
+    busy_ns += other.busy_ns;
+    for (int i = 0; i < WAIT_BUCKET_COUNT; ++i) {
+        wait_buckets[i] += other.wait_buckets[i];
+    }
+}
+
+uint64_t task_worker_stats::wait_percentile_us(double percentage) const
+{
+    uint64_t total = 0;
+    for (auto b : wait_buckets) {
+        total += b;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(total * percentage / 100.0);
+    uint64_t sum = 0;
+    for (int i = 0; i < WAIT_BUCKET_COUNT; ++i) {
+        sum += wait_buckets[i];
+        if (sum > target || sum == total) {
+            return 1ULL << i;
+        }
+    }
+    return 1ULL << (WAIT_BUCKET_COUNT - 1);
+}
+
+int task_worker_stats::wait_bucket(uint64_t wait_ns)
+{
+    uint64_t us = wait_ns / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < WAIT_BUCKET_COUNT - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
 } // end namespace
@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "timing_wheel_timer_service.h"
+
+namespace dsn {
+namespace tools {
+
+timing_wheel_timer_service::timing_wheel_timer_service(service_node *node,
+                                                       timer_service *inner_provider)
+    : timer_service(node, inner_provider),
+      _start_time(std::chrono::steady_clock::now()),
+      _current_tick(0),
+      _is_running(false)
+{
+}
+
+timing_wheel_timer_service::~timing_wheel_timer_service()
+{
+    if (_is_running.exchange(false)) {
+        _worker.join();
+    }
+}
+
+void timing_wheel_timer_service::start()
+{
+    _is_running = true;
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+
+        char buffer[128];
+        sprintf(buffer, "%s.timer", get_service_node_name(node()));
+
+        task_worker::set_name(buffer);
+        task_worker::set_priority(worker_priority_t::THREAD_xPRIORITY_ABOVE_NORMAL);
+
+        run();
+    });
+}
+
+uint64_t timing_wheel_timer_service::now_tick() const
+{
+    // one tick is one millisecond
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - _start_time)
+        .count();
+}
+
+void timing_wheel_timer_service::add_timer(task *task)
+{
+    timer_entry entry;
+    entry.expire_tick = now_tick() + task->delay_milliseconds();
+    entry.tsk = task;
+    task->set_delay(0);
+
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+    // the timers already expired are fired at the next tick
+    place(entry, _current_tick + 1);
+}
+
+void timing_wheel_timer_service::place(const timer_entry &entry, uint64_t min_tick)
+{
+    uint64_t expire_tick = std::max(entry.expire_tick, min_tick);
+    uint64_t distance = expire_tick - _current_tick;
+
+    int level = 0;
+    while (level < LEVEL_COUNT - 1 && distance >= (1ULL << ((level + 1) * SLOT_BITS))) {
+        ++level;
+    }
+
+    // timers too far away for the top level are placed at its farthest slot,
+    // and will be placed again when that slot is cascaded
+    uint64_t max_distance = (1ULL << (LEVEL_COUNT * SLOT_BITS)) - 1;
+    uint64_t slot_tick = std::min(expire_tick, _current_tick + max_distance);
+
+    _slots[level][(slot_tick >> (level * SLOT_BITS)) & SLOT_MASK].push_back(
+        {expire_tick, entry.tsk});
+}
+
+void timing_wheel_timer_service::cascade(int level, uint64_t tick)
+{
+    slot_t entries;
+    entries.swap(_slots[level][(tick >> (level * SLOT_BITS)) & SLOT_MASK]);
+    for (auto &entry : entries) {
+        // slot 0 of _current_tick is not fired yet, so timers may still be placed there
+        place(entry, _current_tick);
+    }
+}
+
+void timing_wheel_timer_service::advance(uint64_t tick, /*out*/ std::vector<task *> &expired)
+{
+    while (_current_tick < tick) {
+        ++_current_tick;
+
+        // cascade from the higher levels first, so that the timers moved into
+        // the level below are cascaded again if they belong to this tick's round
+        int level = 1;
+        while (level < LEVEL_COUNT &&
+               (_current_tick & ((1ULL << (level * SLOT_BITS)) - 1)) == 0) {
+            ++level;
+        }
+        for (int i = level - 1; i >= 1; --i) {
+            cascade(i, _current_tick);
+        }
+
+        auto &slot = _slots[0][_current_tick & SLOT_MASK];
+        for (auto &entry : slot) {
+            dassert(entry.expire_tick == _current_tick,
+                    "timer of task %s is misplaced: %" PRIu64 " vs %" PRIu64,
+                    entry.tsk->spec().name.c_str(),
+                    entry.expire_tick,
+                    _current_tick);
+            expired.push_back(entry.tsk);
+        }
+        slot.clear();
+    }
+}
+
+void timing_wheel_timer_service::run()
+{
+    std::vector<task *> expired;
+    while (_is_running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        {
+            utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+            advance(now_tick(), expired);
+        }
+
+        for (auto t : expired) {
+            t->enqueue();
+
+            // to consume the added ref count by task::enqueue for add_timer
+            t->release_ref();
+        }
+        expired.clear();
+    }
+}
+
+} // namespace tools
+} // namespace dsn
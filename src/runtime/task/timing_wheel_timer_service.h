@@ -0,0 +1,91 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/synchronize.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+namespace tools {
+
+// timing_wheel_timer_service is a hashed hierarchical timing wheel: adding a timer costs
+// O(1) without any allocation inside asio, and all timers expired in one tick are enqueued
+// into their task queues in a batch.
+//
+// The wheel consists of LEVEL_COUNT levels with SLOT_COUNT slots each, a slot of level i
+// spans SLOT_COUNT^i ticks. Timers in a higher level are cascaded down to the lower levels
+// when the wheel of the lower level completes a round.
+class timing_wheel_timer_service : public timer_service
+{
+public:
+    timing_wheel_timer_service(service_node *node, timer_service *inner_provider);
+
+    ~timing_wheel_timer_service() override;
+
+    // after milliseconds, the provider should call task->enqueue()
+    void add_timer(task *task) override;
+
+    void start() override;
+
+private:
+    static const int SLOT_BITS = 8;
+    static const int SLOT_COUNT = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOT_COUNT - 1;
+    static const int LEVEL_COUNT = 4;
+
+    struct timer_entry
+    {
+        uint64_t expire_tick;
+        task *tsk;
+    };
+    typedef std::vector<timer_entry> slot_t;
+
+    uint64_t now_tick() const;
+
+    // put the timer into the proper slot according to its distance to _current_tick,
+    // timers expired before `min_tick` are fired at `min_tick`,
+    // must be called with _lock held
+    void place(const timer_entry &entry, uint64_t min_tick);
+
+    // move all the timers in the slot to the lower levels, must be called with _lock held
+    void cascade(int level, uint64_t tick);
+
+    // advance the wheel to `tick` and collect the expired timers,
+    // must be called with _lock held
+    void advance(uint64_t tick, /*out*/ std::vector<task *> &expired);
+
+    void run();
+
+private:
+    std::chrono::steady_clock::time_point _start_time;
+
+    utils::ex_lock_nr_spin _lock;
+    uint64_t _current_tick; // all the timers before or at this tick have been fired
+    slot_t _slots[LEVEL_COUNT][SLOT_COUNT];
+
+    std::atomic<bool> _is_running;
+    std::thread _worker;
+};
+
+} // namespace tools
+} // namespace dsn
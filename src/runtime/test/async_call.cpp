@@ -38,6 +38,7 @@
 #include <dsn/service_api_cpp.h>
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <functional>
 #include <chrono>
 
@@ -115,6 +116,43 @@ TEST(async_call, task_call)
         EXPECT_FALSE(test_tasks[i]->cancel(true));
 }
 
+TEST(async_call, sharded_task_tracker)
+{
+    dsn::task_tracker tracker(dsn::task_tracker::PER_THREAD_SHARDED);
+    ASSERT_GE(tracker.task_bucket_count(), 1);
+
+    // the tasks are tracked from different threads
+    std::atomic<int> executed(0);
+    dsn::task_tracker parent_tracker;
+    for (int i = 0; i < 4; ++i) {
+        tasking::enqueue(LPC_TEST_CLIENTLET,
+                         &parent_tracker,
+                         [&tracker, &executed]() {
+                             for (int j = 0; j < 100; ++j) {
+                                 tasking::enqueue(LPC_TEST_CLIENTLET,
+                                                  &tracker,
+                                                  [&executed]() { ++executed; },
+                                                  j);
+                             }
+                         },
+                         i);
+    }
+    parent_tracker.wait_outstanding_tasks();
+    tracker.wait_outstanding_tasks();
+    ASSERT_EQ(400, executed.load());
+
+    std::atomic<bool> cancelled_executed(false);
+    for (int i = 0; i < 10; ++i) {
+        tasking::enqueue(LPC_TEST_CLIENTLET,
+                         &tracker,
+                         [&cancelled_executed]() { cancelled_executed = true; },
+                         i,
+                         std::chrono::seconds(30));
+    }
+    tracker.cancel_outstanding_tasks();
+    ASSERT_FALSE(cancelled_executed.load());
+}
+
 TEST(async_call, rpc_call)
 {
     rpc_address addr("localhost", 20101);
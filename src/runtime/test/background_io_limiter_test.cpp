@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/tool-api/background_io_limiter.h>
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+DSN_DECLARE_uint32(disk_rate_mb);
+DSN_DECLARE_uint32(bulk_load_rate_mb);
+
+class background_io_limiter_test : public testing::Test
+{
+public:
+    void TearDown() override
+    {
+        FLAGS_disk_rate_mb = 0;
+        FLAGS_bulk_load_rate_mb = 0;
+    }
+
+    // the delay in ms of the I/O of `mb` MB
+    int64_t acquire(dev_t disk, background_io_class cls, int mb, double now_seconds)
+    {
+        return background_io_limiter::instance()
+            .acquire(disk, cls, mb * 1024 * 1024, now_seconds)
+            .count();
+    }
+};
+
+TEST_F(background_io_limiter_test, unlimited)
+{
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(0, acquire(1, background_io_class::learn, 100, 100));
+    }
+}
+
+TEST_F(background_io_limiter_test, share_and_borrow)
+{
+    FLAGS_disk_rate_mb = 10;
+    FLAGS_bulk_load_rate_mb = 4;
+    const dev_t disk = 2;
+
+    // within the reserved rate
+    ASSERT_EQ(0, acquire(disk, background_io_class::bulk_load, 4, 100));
+    // beyond the reserved rate, borrows the idle budget of the disk
+    ASSERT_EQ(0, acquire(disk, background_io_class::bulk_load, 4, 100));
+    // the disk has only 2MB left, waits for the reserved rate
+    int64_t delay = acquire(disk, background_io_class::bulk_load, 4, 100);
+    ASSERT_GE(delay, 1000);
+    ASSERT_LE(delay, 1001);
+
+    // a class without reserved rate waits for the budget of the disk, which is in debt of 2MB
+    delay = acquire(disk, background_io_class::backup, 1, 100);
+    ASSERT_GE(delay, 300);
+    ASSERT_LE(delay, 301);
+
+    // the budgets are refilled
+    ASSERT_EQ(0, acquire(disk, background_io_class::backup, 1, 102));
+    ASSERT_EQ(0, acquire(disk, background_io_class::bulk_load, 4, 102));
+
+    // the other disks have their own budgets
+    ASSERT_EQ(0, acquire(disk + 1, background_io_class::backup, 10, 100));
+}
+
+TEST_F(background_io_limiter_test, share_only)
+{
+    FLAGS_bulk_load_rate_mb = 4;
+    const dev_t disk = 4;
+
+    ASSERT_EQ(0, acquire(disk, background_io_class::bulk_load, 4, 100));
+    int64_t delay = acquire(disk, background_io_class::bulk_load, 2, 100);
+    ASSERT_GE(delay, 500);
+    ASSERT_LE(delay, 501);
+    // the other classes are not limited
+    ASSERT_EQ(0, acquire(disk, background_io_class::backup, 100, 100));
+}
+
+} // namespace dsn
@@ -17,6 +17,7 @@
 
 #include "runtime/security/negotiation_utils.h"
 #include "runtime/security/client_negotiation.h"
+#include "runtime/security/session_ticket.h"
 #include "runtime/rpc/network.sim.h"
 
 #include <gtest/gtest.h>
@@ -25,6 +26,8 @@
 
 namespace dsn {
 namespace security {
+DSN_DECLARE_string(session_ticket_key);
+
 class client_negotiation_test : public testing::Test
 {
 public:
@@ -111,6 +114,45 @@ TEST_F(client_negotiation_test, handle_response)
     }
 }
 
+TEST_F(client_negotiation_test, resume)
+{
+    const char *old_key = FLAGS_session_ticket_key;
+    FLAGS_session_ticket_key = "test_ticket_key";
+    rpc_address server = _sim_session->remote_address();
+    blob ticket = issue_session_ticket("test_user", rpc_address("127.0.0.1", 1));
+
+    RPC_MOCKING(negotiation_rpc)
+    {
+        // no ticket is cached, start with the full negotiation
+        session_ticket_cache::remove(server);
+        _client_negotiation->start();
+        ASSERT_EQ(get_negotiation_status(), negotiation_status::type::SASL_LIST_MECHANISMS);
+
+        // the ticket attached to SASL_SUCC is cached, and used by the next negotiation
+        negotiation_response succ;
+        succ.status = negotiation_status::type::SASL_SUCC;
+        succ.msg = ticket;
+        on_challenge(succ);
+        blob cached;
+        ASSERT_TRUE(session_ticket_cache::get(server, cached));
+        ASSERT_EQ(cached.to_string(), ticket.to_string());
+        _client_negotiation->start();
+        ASSERT_EQ(get_negotiation_status(), negotiation_status::type::SASL_RESUME);
+        handle_response(ERR_OK, succ);
+        ASSERT_EQ(get_negotiation_status(), negotiation_status::type::SASL_SUCC);
+
+        // a rejected ticket is dropped, and falls back to the full negotiation
+        _client_negotiation->start();
+        negotiation_response reject;
+        reject.status = negotiation_status::type::SASL_RESUME_REJECTED;
+        handle_response(ERR_OK, reject);
+        ASSERT_EQ(get_negotiation_status(), negotiation_status::type::SASL_LIST_MECHANISMS);
+        ASSERT_FALSE(session_ticket_cache::get(server, cached));
+    }
+
+    FLAGS_session_ticket_key = old_key;
+}
+
 TEST_F(client_negotiation_test, on_mechanism_selected)
 {
     struct
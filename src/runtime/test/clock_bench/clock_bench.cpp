@@ -0,0 +1,118 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/utility/clock.h>
+
+// Measures the cost of reading the clocks, e.g.
+//
+//   dsn_clock_bench --threads=8 --calls=10000000
+//
+// every thread reads the clock `calls` times, and the average ns per call is reported for each
+// clock as a json line.
+struct bench_options
+{
+    int threads = 1;
+    uint64_t calls = 10000000;
+};
+
+static bool parse_options(int argc, char **argv, /*out*/ bench_options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "threads") {
+                opts.threads = boost::lexical_cast<int>(value);
+            } else if (key == "calls") {
+                opts.calls = boost::lexical_cast<uint64_t>(value);
+            } else {
+                return false;
+            }
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
+        }
+    }
+    return opts.threads > 0 && opts.calls > 0;
+}
+
+static void run(const bench_options &opts, const char *name, const std::function<uint64_t()> &now)
+{
+    std::atomic<uint64_t> sink(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opts.threads; ++i) {
+        threads.emplace_back([&]() {
+            uint64_t sum = 0;
+            for (uint64_t j = 0; j < opts.calls; ++j) {
+                sum += now();
+            }
+            sink += sum;
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                    .count();
+    printf("{\"clock\":\"%s\",\"threads\":%d,\"calls\":%" PRIu64 ",\"ns_per_call\":%.2f,"
+           "\"sink\":%" PRIu64 "}\n",
+           name,
+           opts.threads,
+           opts.calls,
+           ns / opts.calls,
+           sink.load() % 10);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options opts;
+    if (!parse_options(argc, argv, opts)) {
+        fprintf(stderr, "USAGE: %s [--threads=N] [--calls=N]\n", argv[0]);
+        return 1;
+    }
+
+    dsn::utils::clock system_clock;
+    run(opts, "system", [&system_clock]() { return system_clock.now_ns(); });
+    run(opts, "coarse", [&system_clock]() { return system_clock.coarse_now_ns(); });
+    if (dsn::utils::tsc_clock::supported()) {
+        dsn::utils::tsc_clock tsc;
+        run(opts, "tsc", [&tsc]() { return tsc.now_ns(); });
+    }
+
+    // through the global clock as the callers do
+    run(opts, "dsn_now_ns", []() { return dsn_now_ns(); });
+    if (dsn::utils::clock::select("tsc")) {
+        run(opts, "dsn_now_ns_tsc", []() { return dsn_now_ns(); });
+    }
+    return 0;
+}
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+rm -rf data dsn_coroutine_test.xml coroutine_test.tmp
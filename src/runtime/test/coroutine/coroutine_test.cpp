@@ -0,0 +1,240 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+
+#include <dsn/cpp/coroutine.h>
+
+#if !defined(__cpp_impl_coroutine)
+#error "dsn_coroutine_test must be compiled with C++20 coroutines"
+#endif
+
+#include <dsn/cpp/serverlet.h>
+#include <dsn/cpp/service_app.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/synchronize.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace dsn {
+namespace coro {
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE(LPC_COROUTINE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_AIO(LPC_COROUTINE_TEST_AIO, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_RPC(RPC_COROUTINE_TEST_ECHO, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+const rpc_address test_server_address("localhost", 20401);
+
+class coroutine_test_server : public serverlet<coroutine_test_server>, public service_app
+{
+public:
+    explicit coroutine_test_server(const service_app_info *info)
+        : serverlet<coroutine_test_server>("coroutine_test_server"), service_app(info)
+    {
+    }
+
+    error_code start(const std::vector<std::string> &args) override
+    {
+        register_async_rpc_handler(
+            RPC_COROUTINE_TEST_ECHO, "echo", &coroutine_test_server::on_echo);
+        return ERR_OK;
+    }
+
+    error_code stop(bool cleanup = false) override { return ERR_OK; }
+
+    void on_echo(const std::string &request, rpc_replier<std::string> &reply) { reply(request); }
+};
+
+// whether the current thread is a worker of THREAD_POOL_TEST_SERVER
+bool in_test_pool()
+{
+    task_worker *worker = task::get_current_worker();
+    return worker != nullptr && worker->pool_spec().pool_code == THREAD_POOL_TEST_SERVER;
+}
+
+// sets the flag when the coroutine frame holding it is destroyed
+struct frame_guard
+{
+    std::atomic<bool> *destroyed;
+    ~frame_guard() { destroyed->store(true); }
+};
+
+detached run_schedule(task_tracker *tracker, bool *resumed_in_pool, utils::notify_event *done)
+{
+    co_await schedule(LPC_COROUTINE_TEST, tracker, 0, 10_ms);
+    *resumed_in_pool = in_test_pool();
+    done->notify();
+}
+
+TEST(coroutine, schedule)
+{
+    task_tracker tracker;
+    bool resumed_in_pool = false;
+    utils::notify_event done;
+    run_schedule(&tracker, &resumed_in_pool, &done);
+    done.wait();
+    ASSERT_TRUE(resumed_in_pool);
+    tracker.wait_outstanding_tasks();
+}
+
+async<int> add_later(task_tracker *tracker, int a, int b)
+{
+    co_await schedule(LPC_COROUTINE_TEST, tracker);
+    co_return a + b;
+}
+
+async<void> throw_later(task_tracker *tracker)
+{
+    co_await schedule(LPC_COROUTINE_TEST, tracker);
+    throw std::runtime_error("thrown by throw_later");
+}
+
+detached run_async_chain(task_tracker *tracker, int *sum, bool *caught, utils::notify_event *done)
+{
+    int first = co_await add_later(tracker, 1, 2);
+    int second = co_await add_later(tracker, first, 4);
+    *sum = second;
+    try {
+        co_await throw_later(tracker);
+    } catch (const std::runtime_error &) {
+        *caught = true;
+    }
+    done->notify();
+}
+
+TEST(coroutine, async_chain)
+{
+    task_tracker tracker;
+    int sum = 0;
+    bool caught = false;
+    utils::notify_event done;
+    run_async_chain(&tracker, &sum, &caught, &done);
+    done.wait();
+    ASSERT_EQ(7, sum);
+    ASSERT_TRUE(caught);
+    tracker.wait_outstanding_tasks();
+}
+
+detached run_call(task_tracker *tracker,
+                  std::string request,
+                  std::pair<error_code, std::string> *result,
+                  bool *resumed_in_pool,
+                  utils::notify_event *done)
+{
+    *result = co_await call<std::string>(
+        test_server_address, RPC_COROUTINE_TEST_ECHO, request, tracker, 10_s);
+    *resumed_in_pool = in_test_pool();
+    done->notify();
+}
+
+TEST(coroutine, call)
+{
+    task_tracker tracker;
+    std::pair<error_code, std::string> result;
+    bool resumed_in_pool = false;
+    utils::notify_event done;
+    run_call(&tracker, "hello", &result, &resumed_in_pool, &done);
+    done.wait();
+    ASSERT_EQ(ERR_OK, result.first);
+    ASSERT_EQ("hello", result.second);
+    ASSERT_TRUE(resumed_in_pool);
+    tracker.wait_outstanding_tasks();
+}
+
+detached run_write_and_read(task_tracker *tracker,
+                            disk_file *file,
+                            std::string *read_back,
+                            error_code *err,
+                            utils::notify_event *done)
+{
+    const char *data = "hello, world";
+    const int size = static_cast<int>(strlen(data));
+    auto wr = co_await write(file, data, size, 0, LPC_COROUTINE_TEST_AIO, tracker);
+    if (wr.first != ERR_OK || wr.second != size) {
+        *err = wr.first == ERR_OK ? ERR_IO_PENDING : wr.first;
+        done->notify();
+        co_return;
+    }
+
+    char buffer[64] = {};
+    auto rd = co_await read(file, buffer, size, 0, LPC_COROUTINE_TEST_AIO, tracker);
+    *err = rd.first;
+    read_back->assign(buffer, rd.second);
+    done->notify();
+}
+
+TEST(coroutine, write_and_read)
+{
+    disk_file *file = file::open("coroutine_test.tmp", O_RDWR | O_CREAT | O_BINARY, 0666);
+    ASSERT_NE(nullptr, file);
+
+    task_tracker tracker;
+    std::string read_back;
+    error_code err = ERR_UNKNOWN;
+    utils::notify_event done;
+    run_write_and_read(&tracker, file, &read_back, &err, &done);
+    done.wait();
+    ASSERT_EQ(ERR_OK, err);
+    ASSERT_EQ("hello, world", read_back);
+    tracker.wait_outstanding_tasks();
+
+    ASSERT_EQ(ERR_OK, file::close(file));
+}
+
+async<void> wait_long(task_tracker *tracker, std::atomic<bool> *destroyed)
+{
+    frame_guard guard{destroyed};
+    co_await schedule(LPC_COROUTINE_TEST, tracker, 0, 100_s);
+    ADD_FAILURE() << "wait_long is resumed after it's cancelled";
+}
+
+detached run_cancelled(task_tracker *tracker,
+                       std::atomic<bool> *outer_destroyed,
+                       std::atomic<bool> *inner_destroyed)
+{
+    frame_guard guard{outer_destroyed};
+    co_await wait_long(tracker, inner_destroyed);
+    ADD_FAILURE() << "run_cancelled is resumed after it's cancelled";
+}
+
+TEST(coroutine, cancelled_by_tracker)
+{
+    task_tracker tracker;
+    std::atomic<bool> outer_destroyed{false};
+    std::atomic<bool> inner_destroyed{false};
+    run_cancelled(&tracker, &outer_destroyed, &inner_destroyed);
+    ASSERT_FALSE(outer_destroyed.load());
+    ASSERT_FALSE(inner_destroyed.load());
+
+    // the task which would resume the chain is cancelled, then the whole chain is destroyed
+    tracker.cancel_outstanding_tasks();
+    ASSERT_TRUE(inner_destroyed.load());
+    ASSERT_TRUE(outer_destroyed.load());
+}
+
+} // namespace coro
+} // namespace dsn
+
+void register_coroutine_test_server()
+{
+    dsn::service_app::register_factory<dsn::coro::coroutine_test_server>(
+        "coroutine_test_server");
+}
@@ -0,0 +1,70 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include "runtime/scheduler.h"
+
+namespace dsn {
+namespace tools {
+
+TEST(event_wheel_test, pop_next_events)
+{
+    event_wheel wheel;
+    std::vector<int> order;
+    auto add = [&](uint64_t ts, int id) {
+        wheel.add_system_event(ts, [&order, id]() { order.push_back(id); });
+    };
+    add(3000, 4);
+    add(1000, 1);
+    add(2000, 3);
+    add(1000, 2);
+    add(2500, 5);
+
+    uint64_t ts = 0;
+    std::vector<event_entry> events;
+    auto run = [&]() {
+        for (auto &e : events) {
+            e.system_task();
+        }
+        events.clear();
+    };
+
+    // the events of the same time are popped in the order of adding
+    ASSERT_TRUE(wheel.pop_next_events(0, ts, events));
+    ASSERT_EQ(1000, ts);
+    run();
+    ASSERT_EQ(std::vector<int>({1, 2}), order);
+
+    // the events in [2000, 3000) are popped as one batch at the time of the latest one
+    ASSERT_TRUE(wheel.pop_next_events(1000, ts, events));
+    ASSERT_EQ(2500, ts);
+    run();
+    ASSERT_EQ(std::vector<int>({1, 2, 3, 5}), order);
+
+    ASSERT_TRUE(wheel.has_more_events());
+    ASSERT_TRUE(wheel.pop_next_events(1000, ts, events));
+    ASSERT_EQ(3000, ts);
+    run();
+    ASSERT_EQ(std::vector<int>({1, 2, 3, 5, 4}), order);
+
+    ASSERT_FALSE(wheel.has_more_events());
+    ASSERT_FALSE(wheel.pop_next_events(0, ts, events));
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/toollet/latency_injector.h>
+#include <dsn/tool-api/task_code.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace tools {
+
+DEFINE_TASK_CODE_RPC(RPC_LATENCY_INJECTOR_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(latency_injector_test, add_rule)
+{
+    ASSERT_FALSE(latency_injector::add_rule({"r"}).empty());
+    ASSERT_FALSE(latency_injector::add_rule({"r", "network"}).empty());
+    // neither a delay nor a bandwidth
+    ASSERT_FALSE(latency_injector::add_rule({"r", "rpc_request"}).empty());
+    ASSERT_FALSE(latency_injector::add_rule({"r", "rpc_request", "delay=lognormal:1:2"}).empty());
+    ASSERT_FALSE(latency_injector::add_rule({"r", "rpc_request", "delay=uniform:5:1"}).empty());
+    ASSERT_FALSE(latency_injector::add_rule({"r", "rpc_request", "ratio=2"}).empty());
+    // aio has no remote address
+    ASSERT_FALSE(
+        latency_injector::add_rule({"r", "aio", "addr=10.0.0.1", "delay=fixed:1"}).empty());
+    ASSERT_FALSE(
+        latency_injector::add_rule({"r", "rpc_request", "code=NOT_A_CODE", "delay=fixed:1"})
+            .empty());
+    ASSERT_TRUE(latency_injector::list_rules().empty());
+
+    ASSERT_EQ("",
+              latency_injector::add_rule({"r",
+                                          "rpc_request",
+                                          "code=RPC_LATENCY_INJECTOR_TEST",
+                                          "addr=10.0.0.1",
+                                          "delay=normal:20:5",
+                                          "bandwidth=100"}));
+    // replaced by the name
+    ASSERT_EQ("", latency_injector::add_rule({"r", "rpc_response", "delay=pareto:1:1.5"}));
+    std::string rules = latency_injector::list_rules();
+    ASSERT_NE(std::string::npos, rules.find("r rpc_response ratio=1 delay=pareto:1:1.5 hits=0"));
+    ASSERT_TRUE(latency_injector::remove_rule("r"));
+    ASSERT_FALSE(latency_injector::remove_rule("r"));
+}
+
+TEST(latency_injector_test, next_delay_ms)
+{
+    rpc_address slow("10.0.0.1", 34801);
+    rpc_address other("10.0.0.2", 34801);
+    ASSERT_EQ(0, latency_injector::next_delay_ms(latency_target::rpc_request,
+                                                 RPC_LATENCY_INJECTOR_TEST,
+                                                 slow,
+                                                 -1,
+                                                 100));
+
+    ASSERT_EQ("",
+              latency_injector::add_rule({"slow_node",
+                                          "rpc_request",
+                                          "code=RPC_LATENCY_INJECTOR_TEST",
+                                          "addr=10.0.0.1",
+                                          "delay=fixed:10"}));
+    ASSERT_EQ(10,
+              latency_injector::next_delay_ms(
+                  latency_target::rpc_request, RPC_LATENCY_INJECTOR_TEST, slow, -1, 100));
+    ASSERT_EQ(0,
+              latency_injector::next_delay_ms(
+                  latency_target::rpc_request, RPC_LATENCY_INJECTOR_TEST, other, -1, 100));
+    ASSERT_EQ(0,
+              latency_injector::next_delay_ms(
+                  latency_target::rpc_response, RPC_LATENCY_INJECTOR_TEST, slow, -1, 100));
+
+    // 1MB/s, the second 512KB is queued behind the first one
+    ASSERT_EQ("", latency_injector::add_rule({"slow_link", "rpc_response", "bandwidth=1"}));
+    uint32_t first = latency_injector::next_delay_ms(
+        latency_target::rpc_response, RPC_LATENCY_INJECTOR_TEST, other, -1, 512 * 1024);
+    uint32_t second = latency_injector::next_delay_ms(
+        latency_target::rpc_response, RPC_LATENCY_INJECTOR_TEST, other, -1, 512 * 1024);
+    ASSERT_GE(first, 499);
+    ASSERT_LE(first, 501);
+    ASSERT_GE(second, 990);
+    ASSERT_LE(second, 1001);
+
+    // none of the tasks is delayed with ratio 0
+    ASSERT_EQ("", latency_injector::add_rule({"slow_disk", "aio", "ratio=0", "delay=fixed:5"}));
+    ASSERT_EQ(0,
+              latency_injector::next_delay_ms(
+                  latency_target::aio, RPC_LATENCY_INJECTOR_TEST, rpc_address(), -1, 4096));
+
+    ASSERT_NE(std::string::npos, latency_injector::list_rules().find("slow_node"));
+    latency_injector::clear_rules();
+    ASSERT_TRUE(latency_injector::list_rules().empty());
+}
+
+} // namespace tools
+} // namespace dsn
@@ -5,8 +5,10 @@
 #include <gtest/gtest.h>
 
 #include <dsn/tool-api/message_parser.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
+DSN_DECLARE_bool(enable_read_buffer_pool);
 
 class message_reader_test : public testing::Test
 {
@@ -86,6 +88,38 @@ public:
         ASSERT_EQ(reader._buffer.length(), 4500);
         ASSERT_EQ(reader._buffer_occupied, 500);
     }
+
+    void test_read_buffer_pool()
+    {
+        bool old_enabled = FLAGS_enable_read_buffer_pool;
+        FLAGS_enable_read_buffer_pool = true;
+
+        const char *p1 = nullptr;
+        blob msg_data;
+        {
+            message_reader reader(5000);
+            p1 = reader.read_buffer_ptr(1000);
+            // rounded up to the size class
+            ASSERT_EQ(reader._buffer.length(), 8192);
+            reader.mark_read(1000);
+
+            // the buffer is still referenced by the parsed message
+            msg_data = reader.buffer();
+        }
+        {
+            message_reader reader(5000);
+            ASSERT_NE(p1, reader.read_buffer_ptr(1000));
+        }
+
+        // recycled after the last reference is released
+        msg_data = blob();
+        {
+            message_reader reader(5000);
+            ASSERT_EQ(p1, reader.read_buffer_ptr(1000));
+        }
+
+        FLAGS_enable_read_buffer_pool = old_enabled;
+    }
 };
 
 TEST_F(message_reader_test, init) { test_init(); }
@@ -96,4 +130,6 @@ TEST_F(message_reader_test, read_data) { test_read_data(); }
 
 TEST_F(message_reader_test, consume_buffer) { test_consume_buffer(); }
 
+TEST_F(message_reader_test, read_buffer_pool) { test_read_buffer_pool(); }
+
 } // namespace dsn
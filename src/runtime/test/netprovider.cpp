@@ -35,23 +35,54 @@
 
 #include <memory>
 #include <thread>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
 
 #include <dsn/service_api_cpp.h>
 
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/task_spec.h>
 
+#include <dsn/utility/flags.h>
 #include "runtime/rpc/asio_net_provider.h"
+#include "runtime/rpc/io_uring_net_provider.h"
 #include "runtime/rpc/network.sim.h"
 #include "runtime/rpc/rpc_engine.h"
+#include "runtime/rpc/shm_channel.h"
+#include "runtime/rpc/shm_net_provider.h"
+#include "runtime/rpc/shm_rpc_session.h"
+#include "runtime/rpc/rdma_channel.h"
+#include "runtime/rpc/rdma_net_provider.h"
+#include "runtime/rpc/rdma_rpc_session.h"
+#include "runtime/rpc/tls_net_provider.h"
+#include "runtime/rpc/tls_rpc_session.h"
 #include "runtime/service_engine.h"
 #include "test_utils.h"
 
 using namespace dsn;
 using namespace dsn::tools;
 
+namespace dsn {
+namespace tools {
+DSN_DECLARE_uint64(zerocopy_send_threshold_bytes);
+DSN_DECLARE_string(tls_cert_file);
+DSN_DECLARE_string(tls_key_file);
+DSN_DECLARE_string(tls_ca_file);
+DSN_DECLARE_string(tls_plaintext_subnets);
+DSN_DECLARE_bool(tls_verify_peer_ip);
+} // namespace tools
+DSN_DECLARE_uint32(client_sessions_per_server);
+DSN_DECLARE_uint32(send_lane_weight_low);
+DSN_DECLARE_uint32(send_lane_weight_common);
+DSN_DECLARE_uint32(send_lane_weight_high);
+DSN_DECLARE_uint64(send_batch_max_bytes);
+} // namespace dsn
+
 class asio_network_provider_test : public asio_network_provider
 {
 public:
@@ -67,10 +98,26 @@ public:
             "change _cfg_conn_threshold_per_ip %u -> %u for test", _cfg_conn_threshold_per_ip, n);
         _cfg_conn_threshold_per_ip = n;
     }
+
+    using connection_oriented_network::get_client_session_slot;
+
+    int client_session_count(rpc_address addr)
+    {
+        utils::auto_read_lock l(_clients_lock);
+        auto it = _clients.find(addr);
+        if (it == _clients.end()) {
+            return 0;
+        }
+        return (int)std::count_if(it->second.begin(),
+                                  it->second.end(),
+                                  [](const rpc_session_ptr &p) { return p != nullptr; });
+    }
 };
 
 static int TEST_PORT = 20401;
 DEFINE_TASK_CODE_RPC(RPC_TEST_NETPROVIDER, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_RPC(RPC_TEST_NETPROVIDER_LOW, TASK_PRIORITY_LOW, THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_RPC(RPC_TEST_NETPROVIDER_HIGH, TASK_PRIORITY_HIGH, THREAD_POOL_TEST_SERVER)
 
 volatile int wait_flag = 0;
 void response_handler(dsn::error_code ec,
@@ -184,6 +231,320 @@ TEST(tools_common, asio_net_provider)
     TEST_PORT++;
 }
 
+#ifdef DSN_HAS_IO_URING
+TEST(tools_common, io_uring_net_provider)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    std::unique_ptr<io_uring_network_provider> io_uring_network(
+        new io_uring_network_provider(task::get_current_rpc(), nullptr));
+
+    error_code start_result;
+    start_result = io_uring_network->start(RPC_CHANNEL_TCP, TEST_PORT, false);
+    if (start_result == ERR_NETWORK_INIT_FAILED) {
+        // io_uring may be disabled by the kernel
+        return;
+    }
+    ASSERT_TRUE(start_result == ERR_OK);
+
+    start_result = io_uring_network->start(RPC_CHANNEL_TCP, TEST_PORT, false);
+    ASSERT_TRUE(start_result == ERR_SERVICE_ALREADY_RUNNING);
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    rpc_session_ptr client_session =
+        io_uring_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    client_session->connect();
+
+    // several rounds to go through the re-arming of the multishot recv
+    for (int i = 0; i < 10; i++) {
+        rpc_client_session_send(client_session);
+    }
+    client_session->close();
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT++;
+}
+#endif
+
+TEST(tools_common, shm_channel)
+{
+    std::unique_ptr<shm_channel> client = shm_channel::create(64);
+    ASSERT_NE(nullptr, client);
+    std::unique_ptr<shm_channel> server = shm_channel::attach(::dup(client->mem_fd()),
+                                                              ::dup(client->client_event_fd()),
+                                                              ::dup(client->server_event_fd()),
+                                                              client->ring_capacity());
+    ASSERT_NE(nullptr, server);
+
+    // nothing to read, the reader should wait
+    char buf[100];
+    ASSERT_EQ(0, server->rx().read(buf, sizeof(buf)));
+    ASSERT_TRUE(server->rx().prepare_read_wait());
+
+    // the writer takes the waiting flag once
+    std::string data(100, 'a');
+    for (int i = 0; i < 100; i++) {
+        data[i] += i % 26;
+    }
+    ASSERT_EQ(40, client->tx().write(data.data(), 40));
+    ASSERT_TRUE(client->tx().take_reader_waiting());
+    ASSERT_FALSE(client->tx().take_reader_waiting());
+
+    // the ring is full after 64 bytes
+    ASSERT_EQ(24, client->tx().write(data.data() + 40, 60));
+    ASSERT_TRUE(client->tx().prepare_write_wait());
+    ASSERT_EQ(30, server->rx().read(buf, 30));
+    ASSERT_TRUE(server->rx().take_writer_waiting());
+
+    // wrap around the end of the ring
+    ASSERT_EQ(30, client->tx().write(data.data() + 64, 30));
+    ASSERT_EQ(64, server->rx().read(buf + 30, sizeof(buf) - 30));
+    ASSERT_EQ(data.substr(0, 94), std::string(buf, 94));
+    ASSERT_FALSE(server->rx().prepare_write_wait());
+}
+
+TEST(tools_common, shm_net_provider)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    std::unique_ptr<shm_network_provider> shm_network(
+        new shm_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, shm_network->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    // the server is on the same host
+    rpc_session_ptr client_session =
+        shm_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ASSERT_NE(nullptr, dynamic_cast<shm_rpc_session *>(client_session.get()));
+    client_session->connect();
+
+    for (int i = 0; i < 10; i++) {
+        rpc_client_session_send(client_session);
+    }
+    client_session->close();
+
+    // fall back to tcp once the shm session can't be set up
+    rpc_address other_addr("localhost", TEST_PORT + 1);
+    shm_network->mark_shm_unavailable(other_addr);
+    rpc_session_ptr tcp_session = shm_network->create_client_session(other_addr);
+    ASSERT_EQ(nullptr, dynamic_cast<shm_rpc_session *>(tcp_session.get()));
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT++;
+}
+
+#ifdef DSN_ENABLE_RDMA
+TEST(tools_common, rdma_channel)
+{
+    if (!rdma_channel::device_available())
+        return;
+
+    std::unique_ptr<rdma_channel> client = rdma_channel::create(16, 4);
+    std::unique_ptr<rdma_channel> server = rdma_channel::create(16, 4);
+    ASSERT_NE(nullptr, client);
+    ASSERT_NE(nullptr, server);
+    ASSERT_TRUE(client->connect(server->local_endpoint()));
+    ASSERT_TRUE(server->connect(client->local_endpoint()));
+
+    // more bytes than the slots of the server, which are reposted and returned as credits
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data.push_back(static_cast<char>('a' + i % 26));
+    }
+    std::string received;
+    size_t written = 0;
+    uint64_t start_ms = dsn_now_ms();
+    while (received.size() < data.size() && dsn_now_ms() - start_ms < 10000) {
+        written += client->write(data.data() + written, data.size() - written);
+        ASSERT_TRUE(client->poll_send());
+        ASSERT_TRUE(client->poll_recv([](const char *, size_t) {}));
+        ASSERT_TRUE(server->poll_recv(
+            [&received](const char *buf, size_t length) { received.append(buf, length); }));
+        ASSERT_TRUE(server->return_credits());
+        ASSERT_TRUE(server->poll_send());
+    }
+    ASSERT_EQ(data, received);
+}
+
+TEST(tools_common, rdma_net_provider)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+            "dsn::tools::sim_semaphore_provider" ||
+        !rdma_channel::device_available())
+        return;
+
+    std::unique_ptr<rdma_network_provider> rdma_network(
+        new rdma_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, rdma_network->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    rpc_session_ptr client_session =
+        rdma_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ASSERT_NE(nullptr, dynamic_cast<rdma_rpc_session *>(client_session.get()));
+    client_session->connect();
+
+    for (int i = 0; i < 10; i++) {
+        rpc_client_session_send(client_session);
+    }
+    client_session->close();
+
+    // fall back to tcp once the rdma session can't be set up
+    rpc_address other_addr("localhost", TEST_PORT + 1);
+    rdma_network->mark_rdma_unavailable(other_addr);
+    rpc_session_ptr tcp_session = rdma_network->create_client_session(other_addr);
+    ASSERT_EQ(nullptr, dynamic_cast<rdma_rpc_session *>(tcp_session.get()));
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT++;
+}
+#endif
+
+// writes a self-signed certificate naming 127.0.0.1, which is also the CA to verify itself
+static bool write_self_signed_cert(const char *cert_file, const char *key_file)
+{
+    EVP_PKEY *pkey = nullptr;
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    bool ok = kctx != nullptr && EVP_PKEY_keygen_init(kctx) == 1 &&
+              EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) == 1 &&
+              EVP_PKEY_keygen(kctx, &pkey) == 1;
+    EVP_PKEY_CTX_free(kctx);
+
+    X509 *x509 = ok ? X509_new() : nullptr;
+    if (x509 != nullptr) {
+        ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+        X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+        X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+        X509_set_pubkey(x509, pkey);
+        X509_NAME *name = X509_get_subject_name(x509);
+        X509_NAME_add_entry_by_txt(
+            name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("rdsn"), -1, -1, 0);
+        X509_set_issuer_name(x509, name);
+        X509V3_CTX v3ctx;
+        X509V3_set_ctx_nodb(&v3ctx);
+        X509V3_set_ctx(&v3ctx, x509, x509, nullptr, nullptr, 0);
+        X509_EXTENSION *san =
+            X509V3_EXT_conf_nid(nullptr, &v3ctx, NID_subject_alt_name, "IP:127.0.0.1");
+        ok = san != nullptr && X509_add_ext(x509, san, -1) == 1 &&
+             X509_sign(x509, pkey, EVP_sha256()) > 0;
+        X509_EXTENSION_free(san);
+    }
+
+    FILE *cert = ok ? fopen(cert_file, "w") : nullptr;
+    FILE *key = ok ? fopen(key_file, "w") : nullptr;
+    ok = cert != nullptr && key != nullptr && PEM_write_X509(cert, x509) == 1 &&
+         PEM_write_PrivateKey(key, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (cert != nullptr) {
+        fclose(cert);
+    }
+    if (key != nullptr) {
+        fclose(key);
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+TEST(tools_common, tls_net_provider)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(write_self_signed_cert("tls_test_cert.pem", "tls_test_key.pem"));
+    const char *old_cert_file = FLAGS_tls_cert_file;
+    const char *old_key_file = FLAGS_tls_key_file;
+    const char *old_ca_file = FLAGS_tls_ca_file;
+    const char *old_plaintext_subnets = FLAGS_tls_plaintext_subnets;
+    bool old_verify_peer_ip = FLAGS_tls_verify_peer_ip;
+    FLAGS_tls_cert_file = "tls_test_cert.pem";
+    FLAGS_tls_key_file = "tls_test_key.pem";
+    FLAGS_tls_ca_file = "tls_test_cert.pem";
+
+    std::unique_ptr<tls_network_provider> tls_network(
+        new tls_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, tls_network->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    rpc_session_ptr client_session =
+        tls_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ASSERT_NE(nullptr, dynamic_cast<tls_rpc_session *>(client_session.get()));
+    client_session->connect();
+    for (int i = 0; i < 10; i++) {
+        rpc_client_session_send(client_session);
+    }
+    client_session->close();
+
+    // the server is also verified by its ip once required
+    FLAGS_tls_verify_peer_ip = true;
+    std::unique_ptr<tls_network_provider> ip_network(
+        new tls_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, ip_network->start(RPC_CHANNEL_TCP, TEST_PORT, true));
+    rpc_session_ptr ip_session =
+        ip_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ip_session->connect();
+    rpc_client_session_send(ip_session);
+    ip_session->close();
+    FLAGS_tls_verify_peer_ip = old_verify_peer_ip;
+
+    // a server whose certificate isn't issued by the CAs of the cluster is rejected
+    ASSERT_TRUE(write_self_signed_cert("tls_test_other_cert.pem", "tls_test_other_key.pem"));
+    FLAGS_tls_ca_file = "tls_test_other_cert.pem";
+    std::unique_ptr<tls_network_provider> other_network(
+        new tls_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, other_network->start(RPC_CHANNEL_TCP, TEST_PORT, true));
+    rpc_session_ptr other_session =
+        other_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    other_session->connect();
+    rpc_client_session_send(other_session, true);
+    other_session->close();
+
+    // the CAs of the system are never trusted in place of those of the cluster
+    FLAGS_tls_ca_file = "";
+    std::unique_ptr<tls_network_provider> no_ca_network(
+        new tls_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_NETWORK_INIT_FAILED, no_ca_network->start(RPC_CHANNEL_TCP, TEST_PORT, true));
+    FLAGS_tls_ca_file = "tls_test_cert.pem";
+
+    // the peers of the plaintext subnets are connected without tls, and still accepted by
+    // the tls server
+    FLAGS_tls_plaintext_subnets = "10.0.0.0/8,127.0.0.0/8";
+    std::unique_ptr<tls_network_provider> plaintext_network(
+        new tls_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, plaintext_network->start(RPC_CHANNEL_TCP, TEST_PORT, true));
+    ASSERT_TRUE(plaintext_network->is_plaintext_peer(rpc_address("10.1.2.3", 34801)));
+    ASSERT_FALSE(plaintext_network->is_plaintext_peer(rpc_address("192.168.1.1", 34801)));
+
+    rpc_session_ptr plaintext_session =
+        plaintext_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ASSERT_EQ(nullptr, dynamic_cast<tls_rpc_session *>(plaintext_session.get()));
+    plaintext_session->connect();
+    rpc_client_session_send(plaintext_session);
+    plaintext_session->close();
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+    FLAGS_tls_cert_file = old_cert_file;
+    FLAGS_tls_key_file = old_key_file;
+    FLAGS_tls_ca_file = old_ca_file;
+    FLAGS_tls_plaintext_subnets = old_plaintext_subnets;
+
+    TEST_PORT++;
+}
+
 TEST(tools_common, asio_udp_provider)
 {
     if (dsn::service_engine::instance().spec().semaphore_factory_name ==
@@ -257,6 +618,38 @@ TEST(tools_common, sim_net_provider)
     TEST_PORT++;
 }
 
+TEST(tools_common, asio_net_provider_zerocopy_send)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    uint64_t old_threshold = FLAGS_zerocopy_send_threshold_bytes;
+    // every send goes through the zero-copy path, which falls back to copying on loopback
+    FLAGS_zerocopy_send_threshold_bytes = 1;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    std::unique_ptr<asio_network_provider> asio_network(
+        new asio_network_provider(task::get_current_rpc(), nullptr));
+    error_code start_result = asio_network->start(RPC_CHANNEL_TCP, TEST_PORT, false);
+    ASSERT_TRUE(start_result == ERR_OK);
+
+    rpc_session_ptr client_session =
+        asio_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    client_session->connect();
+    for (int i = 0; i < 10; i++) {
+        rpc_client_session_send(client_session);
+    }
+    client_session->close();
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+    FLAGS_zerocopy_send_threshold_bytes = old_threshold;
+
+    TEST_PORT++;
+}
+
 TEST(tools_common, asio_network_provider_connection_threshold)
 {
     if (dsn::service_engine::instance().spec().semaphore_factory_name ==
@@ -306,3 +699,125 @@ TEST(tools_common, asio_network_provider_connection_threshold)
 
     TEST_PORT++;
 }
+
+TEST(tools_common, asio_network_provider_multiple_client_sessions)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    uint32_t old_count = FLAGS_client_sessions_per_server;
+    FLAGS_client_sessions_per_server = 4;
+    std::unique_ptr<asio_network_provider_test> asio_network(
+        new asio_network_provider_test(task::get_current_rpc(), nullptr));
+    FLAGS_client_sessions_per_server = old_count;
+
+    error_code start_result = asio_network->start(RPC_CHANNEL_TCP, TEST_PORT, false);
+    ASSERT_TRUE(start_result == ERR_OK);
+
+    // routed by the priority
+    message_ptr low = message_ex::create_request(RPC_TEST_NETPROVIDER_LOW, 0, 0);
+    message_ptr high = message_ex::create_request(RPC_TEST_NETPROVIDER_HIGH, 0, 0);
+    message_ptr common1 = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, 1);
+    message_ptr common2 = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, 2);
+    ASSERT_EQ(3, asio_network->get_client_session_slot(low));
+    ASSERT_EQ(0, asio_network->get_client_session_slot(high));
+    ASSERT_EQ(2, asio_network->get_client_session_slot(common1));
+    ASSERT_EQ(1, asio_network->get_client_session_slot(common2));
+
+    // routed by the configured slot
+    task_spec *spec = task_spec::get(RPC_TEST_NETPROVIDER_LOW);
+    spec->rpc_call_connection_slot = 5;
+    ASSERT_EQ(1, asio_network->get_client_session_slot(low));
+    spec->rpc_call_connection_slot = -1;
+
+    // the sessions are created on demand
+    rpc_address server("localhost", TEST_PORT);
+    message_ptr high2 = message_ex::create_request(RPC_TEST_NETPROVIDER_HIGH, 0, 0);
+    for (auto msg : {low, high, high2}) {
+        msg->to_address = server;
+        msg->header->from_address = asio_network->address();
+        asio_network->send_message(msg);
+    }
+    ASSERT_EQ(2, asio_network->client_session_count(server));
+
+    TEST_PORT++;
+}
+
+// a client session which never connects, to check how the queued messages are batched
+class send_lane_test_session : public rpc_session
+{
+public:
+    send_lane_test_session(connection_oriented_network &net, message_parser_ptr &parser)
+        : rpc_session(net, rpc_address("localhost", 1), parser, true)
+    {
+    }
+
+    void connect() override {}
+    void close() override {}
+    void do_read(int read_next) override {}
+    void send(uint64_t signature) override {}
+
+    // the rpc names of the next batch
+    std::vector<std::string> next_batch()
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        std::vector<std::string> names;
+        if (unlink_message_for_send()) {
+            for (auto msg : _sending_msgs) {
+                names.push_back(msg->header->rpc_name);
+                msg->release_ref();
+            }
+            _sending_msgs.clear();
+            _sending_buffers.clear();
+        }
+        return names;
+    }
+};
+
+TEST(tools_common, rpc_session_send_lanes)
+{
+    std::unique_ptr<asio_network_provider> asio_network(
+        new asio_network_provider(task::get_current_rpc(), nullptr));
+    message_parser_ptr parser(asio_network->new_message_parser(NET_HDR_DSN));
+    ref_ptr<send_lane_test_session> session(new send_lane_test_session(*asio_network, parser));
+
+    std::string low = RPC_TEST_NETPROVIDER_LOW.to_string();
+    std::string common = RPC_TEST_NETPROVIDER.to_string();
+    std::string high = RPC_TEST_NETPROVIDER_HIGH.to_string();
+    auto send_all = [&]() {
+        for (auto code :
+             {RPC_TEST_NETPROVIDER_LOW, RPC_TEST_NETPROVIDER, RPC_TEST_NETPROVIDER_HIGH}) {
+            for (int i = 0; i < 3; i++) {
+                session->send_message(message_ex::create_request(code, 0, 0));
+            }
+        }
+    };
+
+    // the higher priorities go first, and the lower ones still get their share
+    send_all();
+    ASSERT_EQ(std::vector<std::string>({high, high, high, common, common, common, low, low, low}),
+              session->next_batch());
+
+    auto saved_weights = std::make_tuple(
+        FLAGS_send_lane_weight_low, FLAGS_send_lane_weight_common, FLAGS_send_lane_weight_high);
+    FLAGS_send_lane_weight_low = 1;
+    FLAGS_send_lane_weight_common = 1;
+    FLAGS_send_lane_weight_high = 2;
+    send_all();
+    ASSERT_EQ(std::vector<std::string>({high, high, common, low, high, common, low, common, low}),
+              session->next_batch());
+    std::tie(
+        FLAGS_send_lane_weight_low, FLAGS_send_lane_weight_common, FLAGS_send_lane_weight_high) =
+        saved_weights;
+
+    // a batch is cut once it's large enough
+    uint64_t saved_batch_bytes = FLAGS_send_batch_max_bytes;
+    FLAGS_send_batch_max_bytes = 1;
+    send_all();
+    ASSERT_EQ(std::vector<std::string>({high}), session->next_batch());
+    ASSERT_EQ(std::vector<std::string>({high}), session->next_batch());
+    FLAGS_send_batch_max_bytes = saved_batch_bytes;
+    ASSERT_EQ(7, session->next_batch().size());
+    ASSERT_TRUE(session->next_batch().empty());
+}
@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/command_manager.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+// profiler::cpu is on for both in config-test.ini
+DEFINE_TASK_CODE(LPC_PROFILER_CPU_BUSY_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_PROFILER_CPU_IDLE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// the cpu time of the task code reported by 'profiler.cpu', -1 if the command is not registered
+static int64_t profiler_cpu_ms(const char *code)
+{
+    std::string output;
+    if (!command_manager::instance().run_command("profiler.cpu", {}, output)) {
+        return -1;
+    }
+
+    // the task codes with no cpu time are not listed
+    std::istringstream in(output);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream row(line);
+        std::string name;
+        int64_t cpu_ms;
+        if (row >> name >> cpu_ms && name == code) {
+            return cpu_ms;
+        }
+    }
+    return 0;
+}
+
+TEST(profiler_test, cpu_time)
+{
+    std::string output;
+    // only installed by config-test.ini
+    if (!command_manager::instance().run_command("profiler.cpu", {"reset"}, output)) {
+        return;
+    }
+
+    // burn about 500ms of cpu
+    tasking::enqueue(LPC_PROFILER_CPU_BUSY_TEST,
+                     nullptr,
+                     []() {
+                         auto start = std::chrono::steady_clock::now();
+                         volatile uint64_t x = 0;
+                         while (std::chrono::steady_clock::now() - start <
+                                std::chrono::milliseconds(500)) {
+                             ++x;
+                         }
+                     })
+        ->wait();
+    // takes 500ms but hardly any cpu
+    tasking::enqueue(LPC_PROFILER_CPU_IDLE_TEST,
+                     nullptr,
+                     []() { std::this_thread::sleep_for(std::chrono::milliseconds(500)); })
+        ->wait();
+
+    ASSERT_GE(profiler_cpu_ms("LPC_PROFILER_CPU_BUSY_TEST"), 250);
+    ASSERT_LT(profiler_cpu_ms("LPC_PROFILER_CPU_IDLE_TEST"), 100);
+
+    // the counters are cleared by reset
+    ASSERT_TRUE(command_manager::instance().run_command("profiler.cpu", {"reset"}, output));
+    ASSERT_EQ(0, profiler_cpu_ms("LPC_PROFILER_CPU_BUSY_TEST"));
+}
+
+} // namespace dsn
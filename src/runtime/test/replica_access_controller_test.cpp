@@ -15,6 +15,9 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include <dsn/utility/flags.h>
 #include <dsn/dist/replication.h>
@@ -37,7 +40,20 @@ public:
 
     void set_replica_users(std::unordered_set<std::string> &&replica_users)
     {
-        _replica_access_controller->_users.swap(replica_users);
+        _replica_access_controller->set_acl(std::move(replica_users), "");
+    }
+
+    uint64_t get_acl_version() { return _replica_access_controller->_acl.version(); }
+
+    std::string get_env_users() { return _replica_access_controller->_acl.get().env_users; }
+
+    // whether the decision of the current acl of `controller` is cached on `session`
+    static bool decision_cached(const replica_access_controller &controller,
+                                rpc_session *session,
+                                bool &allowed)
+    {
+        return session->get_acl_decision(
+            controller._decision_slot, controller._acl.version(), allowed);
     }
 
     std::unique_ptr<replica_access_controller> _replica_access_controller;
@@ -72,5 +88,107 @@ TEST_F(replica_access_controller_test, allowed)
 
     FLAGS_enable_acl = origin_enable_acl;
 }
+
+TEST_F(replica_access_controller_test, update)
+{
+    bool origin_enable_acl = FLAGS_enable_acl;
+    FLAGS_enable_acl = true;
+
+    std::unique_ptr<tools::sim_network_provider> sim_net(
+        new tools::sim_network_provider(nullptr, nullptr));
+    auto sim_session = sim_net->create_client_session(rpc_address("localhost", 10086));
+    sim_session->set_client_username("user1");
+    dsn::message_ptr msg = message_ex::create_request(RPC_CM_LIST_APPS);
+    msg->io_session = sim_session;
+
+    bool decision = false;
+    _replica_access_controller->update("user1,user2");
+    ASSERT_EQ(get_env_users(), "user1,user2");
+    ASSERT_FALSE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_TRUE(allowed(msg));
+    ASSERT_TRUE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_TRUE(decision);
+
+    // the same acl doesn't publish a new snapshot, so the cached decision is still valid
+    uint64_t version = get_acl_version();
+    _replica_access_controller->update("user1,user2");
+    ASSERT_EQ(get_acl_version(), version);
+    ASSERT_TRUE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_TRUE(allowed(msg));
+
+    // the cached decision is invalidated once the acl changes, and a denial is cached as well
+    _replica_access_controller->update("user2");
+    ASSERT_NE(get_acl_version(), version);
+    ASSERT_FALSE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_FALSE(allowed(msg));
+    ASSERT_TRUE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_FALSE(decision);
+
+    // the same session accessing several tables keeps the decisions of all of them
+    replica_access_controller other("other");
+    other.update("user1");
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(other.allowed(msg));
+        ASSERT_FALSE(allowed(msg));
+    }
+    ASSERT_TRUE(decision_cached(other, sim_session, decision));
+    ASSERT_TRUE(decision);
+    ASSERT_TRUE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_FALSE(decision);
+
+    // the decisions are dropped with the user of the session
+    sim_session->set_client_username("user2");
+    ASSERT_FALSE(decision_cached(*_replica_access_controller, sim_session, decision));
+    ASSERT_TRUE(allowed(msg));
+    ASSERT_FALSE(other.allowed(msg));
+
+    // an empty acl allows everyone
+    _replica_access_controller->update("");
+    ASSERT_TRUE(allowed(msg));
+
+    FLAGS_enable_acl = origin_enable_acl;
+}
+
+TEST_F(replica_access_controller_test, concurrent_allowed_and_update)
+{
+    bool origin_enable_acl = FLAGS_enable_acl;
+    FLAGS_enable_acl = true;
+
+    std::unique_ptr<tools::sim_network_provider> sim_net(
+        new tools::sim_network_provider(nullptr, nullptr));
+    auto allowed_session = sim_net->create_client_session(rpc_address("localhost", 10086));
+    allowed_session->set_client_username("user1");
+    dsn::message_ptr allowed_msg = message_ex::create_request(RPC_CM_LIST_APPS);
+    allowed_msg->io_session = allowed_session;
+    auto denied_session = sim_net->create_client_session(rpc_address("localhost", 10087));
+    denied_session->set_client_username("user3");
+    dsn::message_ptr denied_msg = message_ex::create_request(RPC_CM_LIST_APPS);
+    denied_msg->io_session = denied_session;
+
+    // user1 is in every acl published below, user3 in none of them
+    _replica_access_controller->update("user1");
+    std::atomic<bool> stop{false};
+    std::atomic<int> wrong_decisions{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                if (!allowed(allowed_msg) || allowed(denied_msg)) {
+                    wrong_decisions.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 2000; ++i) {
+        _replica_access_controller->update(i % 2 == 0 ? "user1,user2" : "user1");
+    }
+    stop.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(wrong_decisions.load(), 0);
+
+    FLAGS_enable_acl = origin_enable_acl;
+}
 } // namespace security
 } // namespace dsn
@@ -27,6 +27,8 @@
 #include <vector>
 #include <string>
 #include <queue>
+#include <atomic>
+#include <thread>
 
 #include <boost/lexical_cast.hpp>
 #include <gtest/gtest.h>
@@ -36,7 +38,10 @@
 #include <dsn/utility/priority_queue.h>
 #include <dsn/tool-api/group_address.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/tool-api/task_spec.h>
 
+#include "runtime/task/task_engine.h"
 #include "test_utils.h"
 
 typedef std::function<void(error_code, dsn::message_ex *, dsn::message_ex *)> rpc_reply_handler;
@@ -245,3 +250,104 @@ TEST(core, send_to_invalid_address)
 
     send_message(group, std::string("echo hehehe"), 1, action_on_succeed, action_on_failure);
 }
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_1)
+DEFINE_TASK_CODE(LPC_TEST_BLOCK_WORKER, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_1)
+DEFINE_TASK_CODE_RPC(RPC_TEST_DROPPED_FOR_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_1)
+
+static std::atomic<int> dropped_test_executed_count{0};
+static std::atomic<int> dropped_test_finished_count{0};
+static std::atomic<int> dropped_test_timeout_reply_count{0};
+
+// calls this node while all the workers of the pool serving the request are blocked for longer
+// than the timeout of the request, returns the error the client gets
+static error_code call_behind_blocked_workers(int timeout_ms)
+{
+    int finished_count = dropped_test_finished_count.load();
+    task_worker_pool *pool =
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_FOR_TEST_1);
+    int worker_count = pool->spec().worker_count;
+    std::atomic<int> blocked_count{0};
+    std::atomic<bool> released{false};
+    dsn::task_tracker tracker;
+    for (int i = 0; i < worker_count; ++i) {
+        tasking::enqueue(LPC_TEST_BLOCK_WORKER, &tracker, [&]() {
+            blocked_count++;
+            while (!released.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        // wait until it's taken by an idle worker before blocking the next one
+        while (blocked_count.load() <= i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    error_code client_err = ERR_OK;
+    task_ptr t = rpc::call(dsn_primary_address(),
+                           RPC_TEST_DROPPED_FOR_TIMEOUT,
+                           std::string("hello"),
+                           nullptr,
+                           [&client_err](error_code err, const std::string &) { client_err = err; },
+                           std::chrono::milliseconds(timeout_ms));
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms * 2));
+    released.store(true);
+    tracker.wait_outstanding_tasks();
+    t->wait();
+
+    // wait for the request to be dropped
+    uint64_t deadline_ms = dsn_now_ms() + 10000;
+    while (dropped_test_finished_count.load() == finished_count && dsn_now_ms() < deadline_ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(finished_count + 1, dropped_test_finished_count.load());
+    return client_err;
+}
+
+TEST(core, rpc_request_dropped_for_timeout)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    task_spec *spec = task_spec::get(RPC_TEST_DROPPED_FOR_TIMEOUT);
+    ASSERT_TRUE(spec->rpc_request_dropped_before_execution_when_timeout);
+    perf_counter_ptr counter = spec->rpc_request_dropped_counter;
+    ASSERT_NE(nullptr, counter.get());
+    std::string counter_name = counter->full_name();
+    ASSERT_NE(std::string::npos, counter_name.find("RPC_TEST_DROPPED_FOR_TIMEOUT.dropped.timeout"));
+
+    spec->on_task_end.put_back([](task *) { dropped_test_finished_count++; },
+                               "rpc_request_dropped_for_timeout");
+    task_spec::get(RPC_TEST_DROPPED_FOR_TIMEOUT_ACK)
+        ->on_rpc_reply.put_native([](task *, message_ex *response) {
+            if (error_code(response->header->server.error_code.local_code) == ERR_TIMEOUT) {
+                dropped_test_timeout_reply_count++;
+            }
+            return true;
+        });
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_DROPPED_FOR_TIMEOUT, "rpc.test.dropped.for.timeout", [](message_ex *request) {
+            dropped_test_executed_count++;
+            dsn_rpc_reply(request->create_response());
+        }));
+
+    bool reply_timeout_when_dropped = spec->rpc_request_reply_timeout_when_dropped;
+    for (bool reply : {true, false}) {
+        spec->rpc_request_reply_timeout_when_dropped = reply;
+        // the counter is a rate, so only check it's not zero after the drop
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        counter->get_value();
+
+        int timeout_reply_count = dropped_test_timeout_reply_count.load();
+        ASSERT_EQ(ERR_TIMEOUT, call_behind_blocked_workers(100));
+        ASSERT_EQ(reply ? timeout_reply_count + 1 : timeout_reply_count,
+                  dropped_test_timeout_reply_count.load());
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        ASSERT_GT(counter->get_value(), 0);
+    }
+    spec->rpc_request_reply_timeout_when_dropped = reply_timeout_when_dropped;
+
+    ASSERT_EQ(0, dropped_test_executed_count.load());
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_DROPPED_FOR_TIMEOUT));
+}
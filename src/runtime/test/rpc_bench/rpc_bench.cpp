@@ -0,0 +1,415 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h>
+#include <thread>
+#include <boost/lexical_cast.hpp>
+#include <fmt/format.h>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/message_parser.h>
+#include <dsn/utility/endians.h>
+#include <dsn/utility/latency_histogram.h>
+#include <dsn/cpp/serialization_helper/thrift_helper.h>
+
+#include "runtime/rpc/dsn_message_parser.h"
+#include "runtime/rpc/thrift_message_parser.h"
+
+// Benchmarks the rpc path of the runtime, e.g.
+//
+//   dsn_rpc_bench --provider=asio --message_size=1024 --concurrency=64 --connections=4
+//   dsn_rpc_bench --mode=parser --parser=thrift --message_size=4096
+//
+// in the "echo" mode, a server app and `connections` client apps are started in this process,
+// each client app having its own network and thus its own connection to the server. the clients
+// keep `concurrency` echo requests outstanding in total, and after `warmup_seconds` the requests
+// completed in `duration_seconds` are measured. since both sides run in this process, the cpu
+// per request covers the client and the server.
+//
+// in the "parser" mode, the messages are encoded and decoded in memory by the given parser, as
+// the network does on send and receive, without any network. the thrift parser only decodes
+// requests and encodes responses, so that is what is measured for it.
+//
+// a single line of json is printed at the end, so that the results can be collected by scripts.
+
+namespace dsn {
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_SERVER)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_CLIENT)
+DEFINE_TASK_CODE_RPC(RPC_BENCH_ECHO, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_SERVER)
+
+struct bench_options
+{
+    std::string mode = "echo";
+    std::string provider = "asio";
+    std::string parser = "dsn";
+    int message_size = 1024;
+    int concurrency = 16;
+    int connections = 1;
+    int server_threads = 4;
+    int client_threads = 4;
+    int io_threads = 2;
+    int port = 34901;
+    int warmup_seconds = 2;
+    int duration_seconds = 10;
+    int iterations = 1000000;
+};
+
+static bench_options s_opts;
+
+static latency_histogram s_latency;
+static std::atomic<uint64_t> s_errors{0};
+static std::atomic<bool> s_stopped{false};
+
+static uint64_t cpu_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+}
+
+static void write_payload(message_ex *msg, const std::string &payload)
+{
+    void *ptr;
+    size_t size;
+    msg->write_next(&ptr, &size, payload.size());
+    memcpy(ptr, payload.data(), payload.size());
+    msg->write_commit(payload.size());
+}
+
+class bench_server : public serverlet<bench_server>, public service_app
+{
+public:
+    explicit bench_server(const service_app_info *info)
+        : serverlet<bench_server>("bench_server"), service_app(info)
+    {
+    }
+
+    error_code start(const std::vector<std::string> &args) override
+    {
+        register_rpc_handler(RPC_BENCH_ECHO, "rpc.bench.echo", &bench_server::on_echo);
+        return ERR_OK;
+    }
+
+    error_code stop(bool cleanup) override
+    {
+        unregister_rpc_handler(RPC_BENCH_ECHO);
+        return ERR_OK;
+    }
+
+    void on_echo(message_ex *request)
+    {
+        message_ex *response = request->create_response();
+        void *data;
+        size_t size;
+        while (request->read_next(&data, &size)) {
+            void *ptr;
+            size_t sz;
+            response->write_next(&ptr, &sz, size);
+            memcpy(ptr, data, size);
+            response->write_commit(size);
+            request->read_commit(size);
+        }
+        dsn_rpc_reply(response);
+    }
+};
+
+class bench_client : public service_app
+{
+public:
+    explicit bench_client(const service_app_info *info)
+        : service_app(info),
+          _server("127.0.0.1", static_cast<uint16_t>(s_opts.port)),
+          _payload(s_opts.message_size, 'x')
+    {
+    }
+
+    error_code start(const std::vector<std::string> &args) override
+    {
+        // spread the outstanding requests over the connections
+        int index = info().index - 1;
+        int loops = s_opts.concurrency / s_opts.connections +
+                    (index < s_opts.concurrency % s_opts.connections ? 1 : 0);
+        for (int i = 0; i < loops; ++i) {
+            send_one(i);
+        }
+        return ERR_OK;
+    }
+
+    error_code stop(bool cleanup) override { return ERR_OK; }
+
+private:
+    void send_one(int loop)
+    {
+        if (s_stopped.load(std::memory_order_relaxed)) {
+            return;
+        }
+        message_ex *request = message_ex::create_request(RPC_BENCH_ECHO, 0, loop);
+        write_payload(request, _payload);
+        uint64_t start_ns = dsn_now_ns();
+        rpc::call(_server,
+                  request,
+                  nullptr,
+                  [this, loop, start_ns](error_code err, message_ex *, message_ex *) {
+                      if (err == ERR_OK) {
+                          s_latency.add(dsn_now_ns() - start_ns);
+                      } else {
+                          s_errors.fetch_add(1, std::memory_order_relaxed);
+                      }
+                      send_one(loop);
+                  },
+                  loop);
+    }
+
+    rpc_address _server;
+    std::string _payload;
+};
+
+static void print_result(uint64_t requests, double seconds, uint64_t cpu_used_us)
+{
+    printf("{\"mode\":\"%s\",\"provider\":\"%s\",\"parser\":\"%s\",\"message_size\":%d,"
+           "\"concurrency\":%d,\"connections\":%d,\"server_threads\":%d,\"client_threads\":%d,"
+           "\"io_threads\":%d,\"requests\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"qps\":%.1f,"
+           "\"p50_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"cpu_us_per_request\":%.3f}\n",
+           s_opts.mode.c_str(),
+           s_opts.mode == "echo" ? s_opts.provider.c_str() : "",
+           s_opts.mode == "echo" ? "dsn" : s_opts.parser.c_str(),
+           s_opts.message_size,
+           s_opts.concurrency,
+           s_opts.connections,
+           s_opts.server_threads,
+           s_opts.client_threads,
+           s_opts.io_threads,
+           requests,
+           s_errors.load(),
+           requests / std::max(seconds, 1e-9),
+           s_latency.percentile(50) / 1e3,
+           s_latency.percentile(99) / 1e3,
+           s_latency.percentile(99.9) / 1e3,
+           cpu_used_us / static_cast<double>(std::max<uint64_t>(requests, 1)));
+    fflush(stdout);
+}
+
+// starts the runtime with the options filled into config.ini, and the apps in `app_list`
+static void start_runtime(const char *prog, const char *app_list)
+{
+    std::string provider = s_opts.provider.find("::") == std::string::npos
+                               ? "dsn::tools::" + s_opts.provider + "_network_provider"
+                               : s_opts.provider;
+    std::string cargs = fmt::format("provider={};port={};client_port={};connections={};"
+                                    "server_threads={};client_threads={};io_threads={}",
+                                    provider,
+                                    s_opts.port,
+                                    s_opts.port + 1,
+                                    s_opts.connections,
+                                    s_opts.server_threads,
+                                    s_opts.client_threads,
+                                    s_opts.io_threads);
+    service_app::register_factory<bench_server>("bench_server");
+    service_app::register_factory<bench_client>("bench_client");
+
+    char *argv[] = {const_cast<char *>(prog),
+                    const_cast<char *>("config.ini"),
+                    const_cast<char *>("-cargs"),
+                    const_cast<char *>(cargs.c_str()),
+                    const_cast<char *>("-app_list"),
+                    const_cast<char *>(app_list)};
+    dsn_run(6, argv, false);
+}
+
+static int run_echo(const char *prog)
+{
+    start_runtime(prog, "server;client");
+
+    // the clients start after their `delay_seconds`
+    std::this_thread::sleep_for(std::chrono::seconds(1 + s_opts.warmup_seconds));
+    s_latency.reset();
+    s_errors.store(0);
+    uint64_t start_cpu_us = cpu_us();
+    uint64_t start_ns = dsn_now_ns();
+    std::this_thread::sleep_for(std::chrono::seconds(s_opts.duration_seconds));
+    uint64_t requests = s_latency.count();
+    double seconds = (dsn_now_ns() - start_ns) / 1e9;
+    uint64_t cpu_used_us = cpu_us() - start_cpu_us;
+    s_stopped.store(true);
+
+    print_result(requests, seconds, cpu_used_us);
+    dsn_exit(0);
+    return 0;
+}
+
+// copies the buffers which the parser would send into `reader`, as the peer receives them
+static void send_to(message_parser &parser, message_ex *msg, message_reader &reader)
+{
+    std::vector<message_parser::send_buf> buffers(parser.get_buffer_count_on_send(msg));
+    int count = parser.get_buffers_on_send(msg, buffers.data());
+    for (int i = 0; i < count; ++i) {
+        char *ptr = reader.read_buffer_ptr(buffers[i].sz);
+        memcpy(ptr, buffers[i].buf, buffers[i].sz);
+        reader.mark_read(buffers[i].sz);
+    }
+}
+
+// returns a request in the v0 thrift network format, with `payload` as its body
+static std::string make_thrift_request(const std::string &payload)
+{
+    binary_writer body_writer;
+    binary_writer_transport trans(body_writer);
+    boost::shared_ptr<binary_writer_transport> trans_ptr(&trans, [](binary_writer_transport *) {});
+    ::apache::thrift::protocol::TBinaryProtocol proto(trans_ptr);
+    proto.writeMessageBegin("RPC_BENCH_ECHO", ::apache::thrift::protocol::T_CALL, 1);
+    body_writer.write(payload.data(), payload.size());
+    proto.writeMessageEnd();
+    blob body = body_writer.get_buffer();
+
+    std::string data = std::string("THFT") + std::string(44, '\0');
+    data_output out(&data[4], 44);
+    out.write_u32(0);             // hdr_version
+    out.write_u32(48);            // hdr_length
+    out.write_u32(0);             // hdr_crc32
+    out.write_u32(body.length()); // body_length
+    out.write_u32(0);             // body_crc32
+    out.write_u32(1);             // app_id
+    out.write_u32(0);             // partition_index
+    out.write_u32(1000);          // client_timeout
+    out.write_u32(0);             // client_thread_hash
+    out.write_u64(0);             // client_partition_hash
+    data.append(body.data(), body.length());
+    return data;
+}
+
+static int run_parser(const char *prog)
+{
+    // only the server is started, which is idle
+    start_runtime(prog, "server");
+
+    std::string payload(s_opts.message_size, 'x');
+    std::string thrift_request = make_thrift_request(payload);
+    message_reader reader(65536);
+    dsn_message_parser dsn_parser;
+    thrift_message_parser thrift_parser;
+
+    uint64_t start_cpu_us = cpu_us();
+    uint64_t start_ns = dsn_now_ns();
+    for (int i = 0; i < s_opts.iterations; ++i) {
+        uint64_t begin_ns = dsn_now_ns();
+        int read_next;
+        message_ptr received;
+        if (s_opts.parser == "dsn") {
+            message_ptr request = message_ex::create_request(RPC_BENCH_ECHO, 0, 0);
+            write_payload(request.get(), payload);
+            dsn_parser.prepare_on_send(request.get());
+            send_to(dsn_parser, request.get(), reader);
+            received = dsn_parser.get_message_on_receive(&reader, read_next);
+        } else {
+            char *ptr = reader.read_buffer_ptr(thrift_request.size());
+            memcpy(ptr, thrift_request.data(), thrift_request.size());
+            reader.mark_read(thrift_request.size());
+            received = thrift_parser.get_message_on_receive(&reader, read_next);
+            dassert(received != nullptr, "failed to parse the thrift request");
+
+            message_ptr response = received->create_response();
+            strcpy(response->header->server.error_name, "ERR_OK");
+            write_payload(response.get(), payload);
+            thrift_parser.prepare_on_send(response.get());
+            send_to(thrift_parser, response.get(), reader);
+            reader.truncate_read();
+        }
+        dassert(received != nullptr, "failed to parse the message");
+        s_latency.add(dsn_now_ns() - begin_ns);
+    }
+    double seconds = (dsn_now_ns() - start_ns) / 1e9;
+
+    print_result(s_opts.iterations, seconds, cpu_us() - start_cpu_us);
+    dsn_exit(0);
+    return 0;
+}
+
+static bool parse_options(int argc, char **argv, /*out*/ bench_options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "mode") {
+                opts.mode = value;
+            } else if (key == "provider") {
+                opts.provider = value;
+            } else if (key == "parser") {
+                opts.parser = value;
+            } else if (key == "message_size") {
+                opts.message_size = boost::lexical_cast<int>(value);
+            } else if (key == "concurrency") {
+                opts.concurrency = boost::lexical_cast<int>(value);
+            } else if (key == "connections") {
+                opts.connections = boost::lexical_cast<int>(value);
+            } else if (key == "server_threads") {
+                opts.server_threads = boost::lexical_cast<int>(value);
+            } else if (key == "client_threads") {
+                opts.client_threads = boost::lexical_cast<int>(value);
+            } else if (key == "io_threads") {
+                opts.io_threads = boost::lexical_cast<int>(value);
+            } else if (key == "port") {
+                opts.port = boost::lexical_cast<int>(value);
+            } else if (key == "warmup_seconds") {
+                opts.warmup_seconds = boost::lexical_cast<int>(value);
+            } else if (key == "duration_seconds") {
+                opts.duration_seconds = boost::lexical_cast<int>(value);
+            } else if (key == "iterations") {
+                opts.iterations = boost::lexical_cast<int>(value);
+            } else {
+                return false;
+            }
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
+        }
+    }
+    return (opts.mode == "echo" || opts.mode == "parser") &&
+           (opts.parser == "dsn" || opts.parser == "thrift") && opts.message_size > 0 &&
+           opts.connections > 0 && opts.concurrency >= opts.connections &&
+           opts.server_threads > 0 && opts.client_threads > 0 && opts.io_threads > 0 &&
+           opts.port > 0 && opts.port < 65535 && opts.warmup_seconds >= 0 &&
+           opts.duration_seconds > 0 && opts.iterations > 0;
+}
+
+} // namespace dsn
+
+int main(int argc, char **argv)
+{
+    if (!dsn::parse_options(argc, argv, dsn::s_opts)) {
+        fprintf(stderr,
+                "USAGE: %s [--mode=echo|parser] [--provider=asio|shm|io_uring|rdma|<full name>] "
+                "[--parser=dsn|thrift] [--message_size=N] [--concurrency=N] [--connections=N] "
+                "[--server_threads=N] [--client_threads=N] [--io_threads=N] [--port=N] "
+                "[--warmup_seconds=N] [--duration_seconds=N] [--iterations=N]\n",
+                argv[0]);
+        return 1;
+    }
+    return dsn::s_opts.mode == "echo" ? dsn::run_echo(argv[0]) : dsn::run_parser(argv[0]);
+}
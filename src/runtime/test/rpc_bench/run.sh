@@ -0,0 +1,41 @@
+#!/bin/bash
+# Runs dsn_rpc_bench over a matrix of settings and appends the json results to ${RESULT_FILE}.
+#
+# The matrix can be narrowed by the environment, e.g.
+#   PROVIDERS="asio" MESSAGE_SIZES="64 4096" DURATION_SECONDS=5 ./run.sh
+
+PROVIDERS=${PROVIDERS:-"asio"}
+PARSERS=${PARSERS:-"dsn thrift"}
+MESSAGE_SIZES=${MESSAGE_SIZES:-"64 1024 16384"}
+CONCURRENCIES=${CONCURRENCIES:-"1 64"}
+CONNECTIONS=${CONNECTIONS:-"1 4"}
+DURATION_SECONDS=${DURATION_SECONDS:-10}
+RESULT_FILE=${RESULT_FILE:-"rpc_bench_result.json"}
+
+for size in ${MESSAGE_SIZES}; do
+    for parser in ${PARSERS}; do
+        if ! ./dsn_rpc_bench --mode=parser --parser="${parser}" --message_size="${size}" \
+                >> "${RESULT_FILE}"; then
+            echo "dsn_rpc_bench --mode=parser --parser=${parser} --message_size=${size} failed"
+            exit 1
+        fi
+    done
+
+    for provider in ${PROVIDERS}; do
+        for concurrency in ${CONCURRENCIES}; do
+            for connections in ${CONNECTIONS}; do
+                if [ "${connections}" -gt "${concurrency}" ]; then
+                    continue
+                fi
+                args="--provider=${provider} --message_size=${size} --concurrency=${concurrency}"
+                args="${args} --connections=${connections} --duration_seconds=${DURATION_SECONDS}"
+                if ! ./dsn_rpc_bench ${args} >> "${RESULT_FILE}"; then
+                    echo "dsn_rpc_bench ${args} failed"
+                    exit 1
+                fi
+            done
+        done
+    done
+done
+
+echo "results are written to ${RESULT_FILE}"
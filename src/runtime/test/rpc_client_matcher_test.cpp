@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/rpc/rpc_engine.h"
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_c.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/flags.h>
+#include <future>
+
+#include "runtime/service_engine.h"
+
+namespace dsn {
+DSN_DECLARE_uint32(rpc_timeout_wheel_tick_ms);
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_CLIENT_MATCHER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class rpc_client_matcher_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_tick_ms = FLAGS_rpc_timeout_wheel_tick_ms;
+        FLAGS_rpc_timeout_wheel_tick_ms = 10;
+        _matcher.reset(new rpc_client_matcher(task::get_current_rpc()));
+    }
+
+    void TearDown() override
+    {
+        _matcher.reset();
+        FLAGS_rpc_timeout_wheel_tick_ms = _old_tick_ms;
+    }
+
+    // returns the future of the error code the call completes with
+    std::future<error_code> call(int timeout_ms, uint64_t &id)
+    {
+        auto result = std::make_shared<std::promise<error_code>>();
+        message_ex *req = message_ex::create_request(RPC_TEST_CLIENT_MATCHER, timeout_ms, 0);
+        id = req->header->id;
+        rpc_response_task_ptr t(new rpc_response_task(
+            req,
+            [result](error_code err, message_ex *, message_ex *) { result->set_value(err); },
+            0));
+        _matcher->on_call(req, t);
+        return result->get_future();
+    }
+
+protected:
+    uint32_t _old_tick_ms;
+    std::unique_ptr<rpc_client_matcher> _matcher;
+};
+
+TEST_F(rpc_client_matcher_test, timing_wheel)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    // time out on the wheel
+    uint64_t id;
+    uint64_t start_ms = dsn_now_ms();
+    auto timeout_result = call(100, id);
+    ASSERT_EQ(ERR_TIMEOUT, timeout_result.get());
+    ASSERT_GE(dsn_now_ms() - start_ms, 100);
+    ASSERT_FALSE(_matcher->on_recv_reply(nullptr, id, nullptr, 0));
+
+    // replied before the timeout, the key left on the wheel is skipped
+    std::vector<std::future<error_code>> results;
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < 100; i++) {
+        results.push_back(call(50, id));
+        ids.push_back(id);
+    }
+    for (uint64_t key : ids) {
+        ASSERT_TRUE(_matcher->on_recv_reply(nullptr, key, nullptr, 0));
+    }
+    for (auto &r : results) {
+        ASSERT_EQ(ERR_NETWORK_FAILURE, r.get());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+} // namespace dsn
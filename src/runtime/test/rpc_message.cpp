@@ -35,6 +35,7 @@
 
 #include "runtime/message_utils.cpp"
 #include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <gtest/gtest.h>
 
@@ -222,3 +223,36 @@ TEST(rpc_message, copy_message_no_reply)
     // so we only need to call release_ref here.
     msg->release_ref();
 }
+
+namespace dsn {
+DSN_DECLARE_uint32(message_inline_body_bytes);
+} // namespace dsn
+
+TEST(rpc_message, inline_body)
+{
+    uint32_t old_inline_body_bytes = FLAGS_message_inline_body_bytes;
+    FLAGS_message_inline_body_bytes = 512;
+
+    message_ptr msg = message_ex::create_request(RPC_CODE_FOR_TEST);
+    void *ptr;
+    size_t size;
+    msg->write_next(&ptr, &size, 100);
+    ASSERT_EQ(512, size);
+    // the body follows the header in the same block
+    ASSERT_EQ(reinterpret_cast<char *>(msg->header) + sizeof(message_header), ptr);
+    memset(ptr, 'a', 100);
+    msg->write_commit(100);
+
+    // the inline body is used only once
+    msg->write_next(&ptr, &size, 100);
+    ASSERT_NE(msg->buffers[1].data() + msg->buffers[1].length(), ptr);
+    memset(ptr, 'b', 100);
+    msg->write_commit(100);
+
+    ASSERT_EQ(3, msg->buffers.size());
+    ASSERT_EQ(200, msg->header->body_length);
+    ASSERT_EQ(std::string(100, 'a'), msg->buffers[1].to_string());
+    ASSERT_EQ(std::string(100, 'b'), msg->buffers[2].to_string());
+
+    FLAGS_message_inline_body_bytes = old_inline_body_bytes;
+}
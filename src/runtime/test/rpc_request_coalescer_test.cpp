@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/rpc/rpc_engine.h"
+
+#include <gtest/gtest.h>
+#include <dsn/tool-api/rpc_message.h>
+
+namespace dsn {
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_COALESCED_A, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_RPC(RPC_TEST_COALESCED_B, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+static message_ex *create_request(task_code code, const std::string &body, int timeout_ms)
+{
+    message_ex *request = message_ex::create_request(code, timeout_ms, 3, 5);
+    request->header->gpid = gpid(2, 7);
+    if (!body.empty()) {
+        void *ptr;
+        size_t sz;
+        request->write_next(&ptr, &sz, body.size());
+        memcpy(ptr, body.data(), body.size());
+        request->write_commit(body.size());
+    }
+    return request;
+}
+
+static std::string body_of(message_ex *msg)
+{
+    std::string body;
+    void *ptr;
+    size_t sz;
+    while (msg->read_next(&ptr, &sz)) {
+        body.append((const char *)ptr, sz);
+        msg->read_commit(sz);
+    }
+    return body;
+}
+
+TEST(rpc_request_coalescer, make_and_split_frame)
+{
+    std::vector<std::string> bodies = {"hello", "", std::string(1000, 'x')};
+    std::vector<message_ptr> requests = {create_request(RPC_TEST_COALESCED_A, bodies[0], 100),
+                                         create_request(RPC_TEST_COALESCED_B, bodies[1], 300),
+                                         create_request(RPC_TEST_COALESCED_A, bodies[2], 200)};
+    std::vector<message_ex *> raw;
+    for (auto &r : requests) {
+        raw.push_back(r.get());
+    }
+
+    message_ptr frame = rpc_request_coalescer::make_frame(raw);
+    ASSERT_STREQ("RPC_COALESCED_REQUESTS", frame->header->rpc_name);
+    ASSERT_EQ(300, frame->header->client.timeout_ms);
+
+    // the frame as received by the server
+    message_ptr received = frame->copy(true, true);
+    std::vector<message_ex *> split;
+    ASSERT_TRUE(rpc_request_coalescer::split_frame(received.get(), split));
+    ASSERT_EQ(requests.size(), split.size());
+
+    for (size_t i = 0; i < split.size(); i++) {
+        message_ptr r = split[i];
+        auto &expect = *requests[i]->header;
+        ASSERT_EQ(requests[i]->local_rpc_code, r->rpc_code());
+        ASSERT_STREQ(expect.rpc_name, r->header->rpc_name);
+        ASSERT_EQ(expect.id, r->header->id);
+        ASSERT_EQ(expect.trace_id, r->header->trace_id);
+        ASSERT_EQ(expect.gpid, r->header->gpid);
+        ASSERT_EQ(expect.client.timeout_ms, r->header->client.timeout_ms);
+        ASSERT_EQ(expect.client.thread_hash, r->header->client.thread_hash);
+        ASSERT_EQ(expect.client.partition_hash, r->header->client.partition_hash);
+        ASSERT_TRUE(r->header->context.u.is_request);
+        ASSERT_EQ(bodies[i].size(), r->header->body_length);
+        ASSERT_EQ(bodies[i], body_of(r.get()));
+    }
+}
+
+TEST(rpc_request_coalescer, split_corrupted_frame)
+{
+    message_ptr request = create_request(RPC_TEST_COALESCED_A, "hello", 100);
+    std::vector<message_ex *> raw = {request.get(), request.get()};
+    message_ptr frame = rpc_request_coalescer::make_frame(raw);
+    message_ptr received = frame->copy(true, true);
+
+    // truncate the second request
+    received->buffers[0] = received->buffers[0].range(0, received->buffers[0].length() - 1);
+    received->header->body_length -= 1;
+
+    std::vector<message_ex *> split;
+    ASSERT_FALSE(rpc_request_coalescer::split_frame(received.get(), split));
+    ASSERT_EQ(1, split.size());
+    message_ptr r = split[0];
+    ASSERT_EQ("hello", body_of(r.get()));
+}
+
+} // namespace dsn
@@ -0,0 +1,80 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/rpc/rpc_engine.h"
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_c.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/task.h>
+
+namespace dsn {
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_DISPATCHER_A, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_RPC(RPC_TEST_DISPATCHER_B, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// returns the code of the handler the request is dispatched to, or TASK_CODE_INVALID
+static task_code dispatch(rpc_server_dispatcher &dispatcher, task_code code, const char *name)
+{
+    message_ex *req = message_ex::create_request(code == TASK_CODE_INVALID ? RPC_TEST_DISPATCHER_A
+                                                                            : code);
+    req->add_ref();
+    if (name != nullptr) {
+        req->local_rpc_code = TASK_CODE_INVALID;
+        strncpy(req->header->rpc_name, name, sizeof(req->header->rpc_name) - 1);
+    }
+
+    task_code result = TASK_CODE_INVALID;
+    rpc_request_task *t = dispatcher.on_request(req, nullptr);
+    if (t != nullptr) {
+        result = req->local_rpc_code;
+        t->add_ref();
+        t->release_ref();
+    }
+    req->release_ref();
+    return result;
+}
+
+TEST(rpc_server_dispatcher, dispatch_by_code_and_name)
+{
+    rpc_server_dispatcher dispatcher;
+    auto handler = [](message_ex *) {};
+    ASSERT_TRUE(dispatcher.register_rpc_handler(RPC_TEST_DISPATCHER_A, "test.a", handler));
+    ASSERT_TRUE(dispatcher.register_rpc_handler(RPC_TEST_DISPATCHER_B, "test.b", handler));
+    ASSERT_EQ(4, dispatcher.handler_count());
+
+    ASSERT_EQ(RPC_TEST_DISPATCHER_A, dispatch(dispatcher, RPC_TEST_DISPATCHER_A, nullptr));
+    ASSERT_EQ(RPC_TEST_DISPATCHER_B, dispatch(dispatcher, RPC_TEST_DISPATCHER_B, nullptr));
+    ASSERT_EQ(RPC_TEST_DISPATCHER_A, dispatch(dispatcher, TASK_CODE_INVALID, "test.a"));
+    ASSERT_EQ(RPC_TEST_DISPATCHER_B, dispatch(dispatcher, TASK_CODE_INVALID, "test.b"));
+    ASSERT_EQ(RPC_TEST_DISPATCHER_B,
+              dispatch(dispatcher, TASK_CODE_INVALID, RPC_TEST_DISPATCHER_B.to_string()));
+    ASSERT_EQ(TASK_CODE_INVALID, dispatch(dispatcher, TASK_CODE_INVALID, "test.c"));
+    ASSERT_EQ(TASK_CODE_INVALID, dispatch(dispatcher, TASK_CODE_INVALID, "test."));
+
+    ASSERT_TRUE(dispatcher.unregister_rpc_handler(RPC_TEST_DISPATCHER_A));
+    ASSERT_FALSE(dispatcher.unregister_rpc_handler(RPC_TEST_DISPATCHER_A));
+    ASSERT_EQ(2, dispatcher.handler_count());
+    ASSERT_EQ(TASK_CODE_INVALID, dispatch(dispatcher, RPC_TEST_DISPATCHER_A, nullptr));
+    ASSERT_EQ(TASK_CODE_INVALID, dispatch(dispatcher, TASK_CODE_INVALID, "test.a"));
+    ASSERT_EQ(RPC_TEST_DISPATCHER_B, dispatch(dispatcher, TASK_CODE_INVALID, "test.b"));
+
+    ASSERT_TRUE(dispatcher.unregister_rpc_handler(RPC_TEST_DISPATCHER_B));
+    ASSERT_EQ(0, dispatcher.handler_count());
+}
+
+} // namespace dsn
@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "runtime/rpc/rpc_size_stats.h"
+#include "test_utils.h"
+
+namespace dsn {
+
+DSN_DECLARE_uint32(rpc_size_stats_sample_interval);
+
+TEST(rpc_size_stats_test, histogram)
+{
+    rpc_size_histogram h;
+    ASSERT_EQ(0, h.count());
+    ASSERT_EQ(0, h.percentile(50));
+
+    for (uint64_t size = 1; size <= 100; size++) {
+        h.add(size);
+    }
+    ASSERT_EQ(100, h.count());
+    ASSERT_EQ(5050, h.sum());
+    ASSERT_EQ(100, h.max());
+    // 50 falls into [32, 64)
+    ASSERT_EQ(63, h.percentile(50));
+    // capped by the max
+    ASSERT_EQ(100, h.percentile(99));
+
+    rpc_size_histogram merged;
+    merged.add(4096);
+    merged.merge(h);
+    ASSERT_EQ(101, merged.count());
+    ASSERT_EQ(4096, merged.max());
+}
+
+TEST(rpc_size_stats_test, session_stats)
+{
+    uint32_t old_interval = FLAGS_rpc_size_stats_sample_interval;
+    FLAGS_rpc_size_stats_sample_interval = 1;
+
+    rpc_address remote("127.0.0.1", 34801);
+    auto stats = rpc_size_stats::instance().register_session(remote, true);
+    message_ex *msg = message_ex::create_request(RPC_TEST_HASH);
+    msg->add_ref();
+    msg->header->body_length = 1000;
+    rpc_size_stats::instance().on_message(*stats, msg, true);
+    msg->header->body_length = 10;
+    rpc_size_stats::instance().on_message(*stats, msg, false);
+    msg->release_ref();
+
+    ASSERT_EQ(1000, stats->sent_bytes.load());
+    ASSERT_EQ(10, stats->recv_bytes.load());
+    ASSERT_EQ(2, stats->body_sizes.count());
+    ASSERT_EQ(1000, stats->body_sizes.max());
+
+    utils::multi_table_printer mtp;
+    rpc_size_stats::instance().get_stats(10, mtp);
+    std::ostringstream out;
+    mtp.output(out, utils::table_printer::output_format::kJsonCompact);
+    ASSERT_NE(std::string::npos, out.str().find("RPC_TEST_HASH")) << out.str();
+    ASSERT_NE(std::string::npos, out.str().find(remote.to_std_string())) << out.str();
+    // the counters at the report are kept for the rates of the next one
+    ASSERT_EQ(1000, stats->last_report_sent_bytes);
+
+    // the unregistered session is reported no more
+    rpc_size_stats::instance().unregister_session(stats.get());
+    utils::multi_table_printer mtp2;
+    rpc_size_stats::instance().get_stats(10, mtp2);
+    std::ostringstream out2;
+    mtp2.output(out2, utils::table_printer::output_format::kJsonCompact);
+    ASSERT_EQ(std::string::npos, out2.str().find(remote.to_std_string())) << out2.str();
+
+    FLAGS_rpc_size_stats_sample_interval = old_interval;
+}
+
+} // namespace dsn
@@ -0,0 +1,56 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <chrono>
+#include <thread>
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/toollet/sampling_profiler.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DEFINE_TASK_CODE(LPC_SAMPLING_PROFILER_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(sampling_profiler_test, get_profile)
+{
+    // only installed by config-test.ini
+    if (!tools::sampling_profiler::installed()) {
+        return;
+    }
+
+    // burn about 1 second of cpu, ~19 samples
+    auto t = tasking::enqueue(LPC_SAMPLING_PROFILER_TEST, nullptr, []() {
+        auto start = std::chrono::steady_clock::now();
+        volatile uint64_t x = 0;
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+            ++x;
+        }
+    });
+    t->wait();
+    // wait for the samples to be aggregated
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::string profile = tools::sampling_profiler::get_profile(60);
+    // the labels are in the string table of the profile
+    ASSERT_NE(std::string::npos, profile.find("LPC_SAMPLING_PROFILER_TEST"));
+    ASSERT_NE(std::string::npos, profile.find("THREAD_POOL_DEFAULT"));
+    ASSERT_NE(std::string::npos, profile.find("cpu"));
+    ASSERT_NE(std::string::npos, profile.find("nanoseconds"));
+}
+
+} // namespace dsn
@@ -17,13 +17,17 @@
 
 #include "runtime/security/server_negotiation.h"
 #include "runtime/security/negotiation_utils.h"
+#include "runtime/security/session_ticket.h"
 #include "runtime/rpc/network.sim.h"
 
 #include <gtest/gtest.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace security {
+DSN_DECLARE_string(session_ticket_key);
+
 class server_negotiation_test : public testing::Test
 {
 public:
@@ -48,6 +52,8 @@ public:
 
     void on_select_mechanism(negotiation_rpc rpc) { _srv_negotiation->on_select_mechanism(rpc); }
 
+    void handle_request(negotiation_rpc rpc) { _srv_negotiation->handle_request(rpc); }
+
     void on_initiate(negotiation_rpc rpc) { _srv_negotiation->on_initiate(rpc); }
 
     void on_challenge_resp(negotiation_rpc rpc) { _srv_negotiation->on_challenge_resp(rpc); }
@@ -90,6 +96,54 @@ TEST_F(server_negotiation_test, on_list_mechanisms)
     }
 }
 
+TEST_F(server_negotiation_test, on_resume)
+{
+    const char *old_key = FLAGS_session_ticket_key;
+    FLAGS_session_ticket_key = "test_ticket_key";
+    _srv_negotiation->start();
+
+    blob valid_ticket = issue_session_ticket("test_user", _sim_session->remote_address());
+    ASSERT_FALSE(valid_ticket.empty());
+    blob other_host_ticket = issue_session_ticket("test_user", rpc_address("10.0.0.1", 10086));
+    std::string tampered = valid_ticket.to_string();
+    tampered[tampered.length() - 1] ^= 1;
+
+    struct
+    {
+        blob ticket;
+        negotiation_status::type resp_status;
+        negotiation_status::type nego_status;
+    } tests[] = {
+        {blob(),
+         negotiation_status::type::SASL_RESUME_REJECTED,
+         negotiation_status::type::SASL_LIST_MECHANISMS},
+        {blob::create_from_bytes(std::move(tampered)),
+         negotiation_status::type::SASL_RESUME_REJECTED,
+         negotiation_status::type::SASL_LIST_MECHANISMS},
+        {other_host_ticket,
+         negotiation_status::type::SASL_RESUME_REJECTED,
+         negotiation_status::type::SASL_LIST_MECHANISMS},
+        {valid_ticket, negotiation_status::type::SASL_SUCC, negotiation_status::type::SASL_SUCC},
+    };
+
+    RPC_MOCKING(negotiation_rpc)
+    {
+        for (const auto &test : tests) {
+            auto request = make_unique<negotiation_request>();
+            request->status = negotiation_status::type::SASL_RESUME;
+            request->msg = test.ticket;
+            negotiation_rpc rpc(std::move(request), RPC_NEGOTIATION);
+            handle_request(rpc);
+
+            ASSERT_EQ(rpc.response().status, test.resp_status);
+            ASSERT_EQ(get_negotiation_status(), test.nego_status);
+        }
+    }
+    ASSERT_EQ(_sim_session->get_client_username(), "test_user");
+
+    FLAGS_session_ticket_key = old_key;
+}
+
 TEST_F(server_negotiation_test, on_select_mechanism)
 {
     struct
@@ -0,0 +1,329 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <boost/lexical_cast.hpp>
+#include <fmt/format.h>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/latency_histogram.h>
+
+// Benchmarks the task engine, e.g.
+//
+//   dsn_task_bench --queue=hpc_concurrent --pool=shared --workers=8 --producers=16
+//   dsn_task_bench --queue=work_stealing --pool=partitioned --timer=timing_wheel --work_ns=500
+//
+// it runs three phases against the pool of `pool`, whose queue, timer service and worker count
+// are given by the options:
+// - lpc: `producers` threads enqueue `tasks` tasks each, keeping at most `max_pending`
+//   outstanding, and every task spins for `work_ns`. the enqueue-to-exec latency and the tasks
+//   per second are measured. in the partitioned pool, the tasks are spread over the workers by
+//   their hash.
+// - timer: `timers` delayed tasks with delays up to `timer_delay_ms`, and a periodic timer of
+//   `timer_interval_ms` for `timer_ticks` ticks, whose lateness to their due time is measured.
+// - tracker: `tracker_tasks` delayed tasks are enqueued with a task_tracker and then cancelled
+//   by it, and the cost per task of both is measured.
+//
+// a single line of json is printed at the end.
+
+namespace dsn {
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_SHARED)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_PARTITIONED)
+DEFINE_TASK_CODE(LPC_BENCH_SHARED, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_SHARED)
+DEFINE_TASK_CODE(LPC_BENCH_PARTITIONED, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_PARTITIONED)
+
+struct bench_options
+{
+    std::string queue = "simple";
+    std::string timer = "simple";
+    std::string pool = "shared";
+    int workers = 4;
+    int producers = 4;
+    int tasks = 1000000;
+    int max_pending = 1024;
+    int work_ns = 0;
+    int timers = 10000;
+    int timer_delay_ms = 100;
+    int timer_interval_ms = 10;
+    int timer_ticks = 200;
+    int tracker_tasks = 100000;
+};
+
+static bench_options s_opts;
+
+static task_code bench_code()
+{
+    return s_opts.pool == "shared" ? LPC_BENCH_SHARED : LPC_BENCH_PARTITIONED;
+}
+
+static void spin_for(int ns)
+{
+    if (ns <= 0) {
+        return;
+    }
+    uint64_t end_ns = dsn_now_ns() + ns;
+    while (dsn_now_ns() < end_ns) {
+    }
+}
+
+static std::string full_name(const std::string &name, const char *suffix)
+{
+    return name.find("::") == std::string::npos ? "dsn::tools::" + name + suffix : name;
+}
+
+struct lpc_result
+{
+    double seconds = 0;
+    latency_histogram latency;
+};
+
+static void run_lpc(lpc_result &result)
+{
+    std::vector<std::atomic<int>> pending(s_opts.producers);
+    std::vector<std::thread> producers;
+    uint64_t start_ns = dsn_now_ns();
+    for (int i = 0; i < s_opts.producers; ++i) {
+        producers.emplace_back([&, i]() {
+            dsn_mimic_app("bench", 1);
+            task_tracker tracker;
+            for (int n = 0; n < s_opts.tasks; ++n) {
+                while (pending[i].load(std::memory_order_relaxed) >= s_opts.max_pending) {
+                    std::this_thread::yield();
+                }
+                pending[i].fetch_add(1, std::memory_order_relaxed);
+                uint64_t enqueue_ns = dsn_now_ns();
+                tasking::enqueue(bench_code(),
+                                 &tracker,
+                                 [&result, &pending, i, enqueue_ns]() {
+                                     result.latency.add(dsn_now_ns() - enqueue_ns);
+                                     spin_for(s_opts.work_ns);
+                                     pending[i].fetch_sub(1, std::memory_order_relaxed);
+                                 },
+                                 i * s_opts.tasks + n);
+            }
+            tracker.wait_outstanding_tasks();
+        });
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    result.seconds = (dsn_now_ns() - start_ns) / 1e9;
+}
+
+struct timer_result
+{
+    latency_histogram delayed_lateness;
+    latency_histogram periodic_lateness;
+};
+
+static void run_timer(timer_result &result)
+{
+    task_tracker tracker;
+    for (int i = 0; i < s_opts.timers; ++i) {
+        int delay_ms = i % s_opts.timer_delay_ms + 1;
+        uint64_t due_ns = dsn_now_ns() + delay_ms * 1000000ULL;
+        tasking::enqueue(bench_code(),
+                         &tracker,
+                         [&result, due_ns]() {
+                             uint64_t now_ns = dsn_now_ns();
+                             result.delayed_lateness.add(now_ns > due_ns ? now_ns - due_ns : 0);
+                         },
+                         i,
+                         std::chrono::milliseconds(delay_ms));
+    }
+    tracker.wait_outstanding_tasks();
+
+    std::atomic<int> ticks{0};
+    uint64_t interval_ns = s_opts.timer_interval_ms * 1000000ULL;
+    uint64_t start_ns = dsn_now_ns();
+    task_tracker timer_tracker;
+    tasking::enqueue_timer(bench_code(),
+                           &timer_tracker,
+                           [&]() {
+                               // the k-th tick is due at `start + k * interval`, so the lateness
+                               // includes the drift of the timer
+                               uint64_t due_ns = start_ns + (ticks.load() + 1) * interval_ns;
+                               uint64_t now_ns = dsn_now_ns();
+                               result.periodic_lateness.add(now_ns > due_ns ? now_ns - due_ns : 0);
+                               ticks.fetch_add(1);
+                           },
+                           std::chrono::milliseconds(s_opts.timer_interval_ms),
+                           0,
+                           std::chrono::milliseconds(s_opts.timer_interval_ms));
+    while (ticks.load() < s_opts.timer_ticks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(s_opts.timer_interval_ms));
+    }
+    timer_tracker.cancel_outstanding_tasks();
+}
+
+struct tracker_result
+{
+    double enqueue_ns_per_task = 0;
+    double cancel_ns_per_task = 0;
+};
+
+static void run_tracker(tracker_result &result)
+{
+    task_tracker tracker;
+    uint64_t start_ns = dsn_now_ns();
+    for (int i = 0; i < s_opts.tracker_tasks; ++i) {
+        tasking::enqueue(bench_code(), &tracker, []() {}, i, std::chrono::hours(1));
+    }
+    uint64_t enqueued_ns = dsn_now_ns();
+    tracker.cancel_outstanding_tasks();
+    uint64_t cancelled_ns = dsn_now_ns();
+    result.enqueue_ns_per_task =
+        (enqueued_ns - start_ns) / static_cast<double>(s_opts.tracker_tasks);
+    result.cancel_ns_per_task =
+        (cancelled_ns - enqueued_ns) / static_cast<double>(s_opts.tracker_tasks);
+}
+
+class bench_app : public service_app
+{
+public:
+    explicit bench_app(const service_app_info *info) : service_app(info) {}
+
+    error_code start(const std::vector<std::string> &args) override { return ERR_OK; }
+
+    error_code stop(bool cleanup) override { return ERR_OK; }
+};
+
+static bool parse_options(int argc, char **argv, /*out*/ bench_options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || value == nullptr) {
+            return false;
+        }
+        std::string key(arg + 2, value - arg - 2);
+        ++value;
+        try {
+            if (key == "queue") {
+                opts.queue = value;
+            } else if (key == "timer") {
+                opts.timer = value;
+            } else if (key == "pool") {
+                opts.pool = value;
+            } else if (key == "workers") {
+                opts.workers = boost::lexical_cast<int>(value);
+            } else if (key == "producers") {
+                opts.producers = boost::lexical_cast<int>(value);
+            } else if (key == "tasks") {
+                opts.tasks = boost::lexical_cast<int>(value);
+            } else if (key == "max_pending") {
+                opts.max_pending = boost::lexical_cast<int>(value);
+            } else if (key == "work_ns") {
+                opts.work_ns = boost::lexical_cast<int>(value);
+            } else if (key == "timers") {
+                opts.timers = boost::lexical_cast<int>(value);
+            } else if (key == "timer_delay_ms") {
+                opts.timer_delay_ms = boost::lexical_cast<int>(value);
+            } else if (key == "timer_interval_ms") {
+                opts.timer_interval_ms = boost::lexical_cast<int>(value);
+            } else if (key == "timer_ticks") {
+                opts.timer_ticks = boost::lexical_cast<int>(value);
+            } else if (key == "tracker_tasks") {
+                opts.tracker_tasks = boost::lexical_cast<int>(value);
+            } else {
+                return false;
+            }
+        } catch (const boost::bad_lexical_cast &) {
+            return false;
+        }
+    }
+    return (opts.pool == "shared" || opts.pool == "partitioned") && opts.workers > 0 &&
+           opts.producers > 0 && opts.tasks > 0 && opts.max_pending > 0 && opts.work_ns >= 0 &&
+           opts.timers >= 0 && opts.timer_delay_ms > 0 && opts.timer_interval_ms > 0 &&
+           opts.timer_ticks > 0 && opts.tracker_tasks > 0;
+}
+
+} // namespace dsn
+
+int main(int argc, char **argv)
+{
+    using namespace dsn;
+    if (!parse_options(argc, argv, s_opts)) {
+        fprintf(stderr,
+                "USAGE: %s [--queue=simple|hpc_concurrent|work_stealing|<full name>] "
+                "[--timer=simple|timing_wheel|<full name>] [--pool=shared|partitioned] "
+                "[--workers=N] [--producers=N] [--tasks=N] [--max_pending=N] [--work_ns=N] "
+                "[--timers=N] [--timer_delay_ms=N] [--timer_interval_ms=N] [--timer_ticks=N] "
+                "[--tracker_tasks=N]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::string cargs = fmt::format("queue={};timer={};workers={}",
+                                    full_name(s_opts.queue, "_task_queue"),
+                                    full_name(s_opts.timer, "_timer_service"),
+                                    s_opts.workers);
+    service_app::register_factory<bench_app>("bench");
+    char *args[] = {argv[0],
+                    const_cast<char *>("config.ini"),
+                    const_cast<char *>("-cargs"),
+                    const_cast<char *>(cargs.c_str())};
+    dsn_run(4, args, false);
+    dsn_mimic_app("bench", 1);
+
+    lpc_result lpc;
+    run_lpc(lpc);
+    timer_result timer;
+    run_timer(timer);
+    tracker_result tracker;
+    run_tracker(tracker);
+
+    uint64_t tasks = static_cast<uint64_t>(s_opts.producers) * s_opts.tasks;
+    printf("{\"queue\":\"%s\",\"timer\":\"%s\",\"pool\":\"%s\",\"workers\":%d,\"producers\":%d,"
+           "\"work_ns\":%d,\"tasks\":%" PRIu64 ",\"tasks_per_second\":%.1f,"
+           "\"exec_latency_p50_us\":%.3f,\"exec_latency_p99_us\":%.3f,"
+           "\"exec_latency_p999_us\":%.3f,\"exec_latency_max_us\":%.3f,"
+           "\"delayed_lateness_p50_us\":%.3f,\"delayed_lateness_p99_us\":%.3f,"
+           "\"delayed_lateness_max_us\":%.3f,\"periodic_lateness_p50_us\":%.3f,"
+           "\"periodic_lateness_p99_us\":%.3f,\"periodic_lateness_max_us\":%.3f,"
+           "\"tracker_enqueue_ns_per_task\":%.1f,\"tracker_cancel_ns_per_task\":%.1f}\n",
+           s_opts.queue.c_str(),
+           s_opts.timer.c_str(),
+           s_opts.pool.c_str(),
+           s_opts.workers,
+           s_opts.producers,
+           s_opts.work_ns,
+           tasks,
+           tasks / std::max(lpc.seconds, 1e-9),
+           lpc.latency.percentile(50) / 1e3,
+           lpc.latency.percentile(99) / 1e3,
+           lpc.latency.percentile(99.9) / 1e3,
+           lpc.latency.max() / 1e3,
+           timer.delayed_lateness.percentile(50) / 1e3,
+           timer.delayed_lateness.percentile(99) / 1e3,
+           timer.delayed_lateness.max() / 1e3,
+           timer.periodic_lateness.percentile(50) / 1e3,
+           timer.periodic_lateness.percentile(99) / 1e3,
+           timer.periodic_lateness.max() / 1e3,
+           tracker.enqueue_ns_per_task,
+           tracker.cancel_ns_per_task);
+    fflush(stdout);
+    dsn_exit(0);
+}
@@ -38,6 +38,11 @@
 #include <dsn/tool_api.h>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <atomic>
+#include <thread>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/command_manager.h>
 
 using namespace ::dsn;
 
@@ -67,6 +72,12 @@ void task_engine_module_init()
 
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_1)
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_2)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_WORK_STEALING)
+DEFINE_TASK_CODE(LPC_TEST_WORK_STEALING, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_WORK_STEALING)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_TIMING_WHEEL)
+DEFINE_TASK_CODE(LPC_TEST_TIMING_WHEEL, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_TIMING_WHEEL)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_ELASTIC)
+DEFINE_TASK_CODE(LPC_TEST_ELASTIC, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_ELASTIC)
 
 TEST(core, task_engine)
 {
@@ -132,6 +143,189 @@ TEST(core, task_engine)
     ASSERT_EQ(nullptr, controllers2[1]);
 }
 
+TEST(core, work_stealing_task_queue)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_WORK_STEALING);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_EQ(2u, pool->queues().size());
+
+    const int task_count = 1000;
+    std::atomic<int> stealable_executed(0);
+    std::atomic<int> affine_executed(0);
+    std::atomic<int> affine_misplaced(0);
+    std::atomic<int> affine_last(-1);
+    std::atomic<int> affine_reordered(0);
+    dsn::task_tracker tracker;
+    for (int i = 0; i < task_count; ++i) {
+        tasking::enqueue(LPC_TEST_WORK_STEALING, &tracker, [&stealable_executed]() {
+            stealable_executed++;
+        });
+        tasking::enqueue(LPC_TEST_WORK_STEALING,
+                         &tracker,
+                         [&, i]() {
+                             if (task::get_current_worker()->index() != 1) {
+                                 affine_misplaced++;
+                             }
+                             if (affine_last.exchange(i) != i - 1) {
+                                 affine_reordered++;
+                             }
+                             affine_executed++;
+                         },
+                         1);
+    }
+    tracker.wait_outstanding_tasks();
+
+    ASSERT_EQ(task_count, stealable_executed.load());
+    ASSERT_EQ(task_count, affine_executed.load());
+    ASSERT_EQ(0, affine_misplaced.load());
+    ASSERT_EQ(0, affine_reordered.load());
+    for (auto q : pool->queues()) {
+        ASSERT_EQ(0, q->count());
+    }
+}
+
+TEST(core, timing_wheel_timer_service)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_TIMING_WHEEL);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_EQ("dsn::tools::timing_wheel_timer_service", pool->spec().timer_factory_name);
+
+    // delays cover the first two levels of the wheel
+    const std::vector<int> delays_ms = {1, 10, 255, 256, 300, 1000};
+    std::atomic<int> fired_early(0);
+    dsn::task_tracker tracker;
+    for (int delay_ms : delays_ms) {
+        for (int hash = 0; hash < 4; ++hash) {
+            uint64_t start_ms = dsn_now_ms();
+            tasking::enqueue(LPC_TEST_TIMING_WHEEL,
+                             &tracker,
+                             [&fired_early, start_ms, delay_ms]() {
+                                 if (dsn_now_ms() < start_ms + delay_ms) {
+                                     fired_early++;
+                                 }
+                             },
+                             hash,
+                             std::chrono::milliseconds(delay_ms));
+        }
+    }
+
+    // cancelled timers are never executed
+    std::atomic<bool> cancelled_executed(false);
+    auto t = tasking::enqueue(LPC_TEST_TIMING_WHEEL,
+                              &tracker,
+                              [&cancelled_executed]() { cancelled_executed = true; },
+                              0,
+                              std::chrono::milliseconds(100));
+    ASSERT_TRUE(t->cancel(false));
+
+    tracker.wait_outstanding_tasks();
+    ASSERT_EQ(0, fired_early.load());
+    ASSERT_FALSE(cancelled_executed.load());
+}
+
+TEST(core, task_worker_stats)
+{
+    ASSERT_EQ(0, task_worker_stats::wait_bucket(0));
+    ASSERT_EQ(0, task_worker_stats::wait_bucket(999));
+    ASSERT_EQ(1, task_worker_stats::wait_bucket(1000));
+    ASSERT_EQ(2, task_worker_stats::wait_bucket(2000));
+    ASSERT_EQ(2, task_worker_stats::wait_bucket(3999));
+    ASSERT_EQ(task_worker_stats::WAIT_BUCKET_COUNT - 1,
+              task_worker_stats::wait_bucket(1000000000000ULL));
+
+    task_worker_stats stats;
+    ASSERT_EQ(0u, stats.wait_percentile_us(99));
+    stats.wait_buckets[0] = 90;
+    stats.wait_buckets[4] = 9;
+    stats.wait_buckets[10] = 1;
+    ASSERT_EQ(1u, stats.wait_percentile_us(50));
+    ASSERT_EQ(16u, stats.wait_percentile_us(95));
+    ASSERT_EQ(1024u, stats.wait_percentile_us(100));
+
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_TIMING_WHEEL);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_TRUE(pool->spec().enable_worker_stats);
+    for (auto wk : pool->workers()) {
+        wk->collect_stats();
+    }
+
+    const int task_count = 100;
+    dsn::task_tracker tracker;
+    for (int i = 0; i < task_count; ++i) {
+        tasking::enqueue(LPC_TEST_TIMING_WHEEL, &tracker, []() {}, i);
+    }
+    tracker.wait_outstanding_tasks();
+
+    // a worker counts a batch after all its tasks are executed, which may be after the tracker
+    // is released, so poll the stats until all are counted
+    task_worker_stats total;
+    uint64_t deadline_ms = dsn_now_ms() + 10000;
+    while (true) {
+        for (auto wk : pool->workers()) {
+            total.merge(wk->collect_stats());
+        }
+        if (total.executed_count >= (uint64_t)task_count || dsn_now_ms() > deadline_ms) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ((uint64_t)task_count, total.executed_count);
+    uint64_t waited = 0;
+    for (auto b : total.wait_buckets) {
+        waited += b;
+    }
+    ASSERT_EQ((uint64_t)task_count, waited);
+    ASSERT_GT(total.duration_ns, 0u);
+
+    std::string output;
+    ASSERT_TRUE(
+        dsn::command_manager::instance().run_command("thread-pool-stats", {"json"}, output));
+    ASSERT_NE(std::string::npos, output.find("THREAD_POOL_FOR_TEST_TIMING_WHEEL"));
+}
+
+TEST(core, elastic_worker_count)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_ELASTIC);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_TRUE(pool->spec().enable_worker_stats);
+    ASSERT_EQ(4u, pool->workers().size());
+    ASSERT_EQ(1, pool->active_worker_count());
+
+    // the tasks wait in the queue of a single worker, so the pool grows
+    std::atomic<int> max_active(1);
+    dsn::task_tracker tracker;
+    for (int i = 0; i < 400; ++i) {
+        tasking::enqueue(LPC_TEST_ELASTIC, &tracker, [&]() {
+            int active = pool->active_worker_count();
+            int last = max_active.load();
+            while (active > last && !max_active.compare_exchange_weak(last, active)) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        });
+    }
+    tracker.wait_outstanding_tasks();
+    ASSERT_GT(max_active.load(), 1);
+    ASSERT_LE(max_active.load(), 4);
+
+    // and shrinks back when it stays idle
+    for (int i = 0; i < 100 && pool->active_worker_count() > 1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(1, pool->active_worker_count());
+}
+
 /*
 TEST(core, task_engine)
 {
@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/task/task_object_pool.h"
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+DSN_DECLARE_bool(enable_task_object_pool);
+
+class task_object_pool_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_enabled = FLAGS_enable_task_object_pool;
+        FLAGS_enable_task_object_pool = true;
+    }
+
+    void TearDown() override { FLAGS_enable_task_object_pool = _old_enabled; }
+
+private:
+    bool _old_enabled;
+};
+
+TEST_F(task_object_pool_test, reuse_in_same_thread)
+{
+    void *p1 = task_object_pool::allocate(100);
+    ASSERT_NE(nullptr, p1);
+    task_object_pool::deallocate(p1);
+
+    // a block of the same size class is reused
+    void *p2 = task_object_pool::allocate(90);
+    ASSERT_EQ(p1, p2);
+    task_object_pool::deallocate(p2);
+
+    // large objects are not pooled, but still work
+    void *p3 = task_object_pool::allocate(task_object_pool::max_pooled_size() + 1);
+    ASSERT_NE(nullptr, p3);
+    memset(p3, 0, task_object_pool::max_pooled_size() + 1);
+    task_object_pool::deallocate(p3);
+}
+
+TEST_F(task_object_pool_test, free_by_other_thread)
+{
+    const int count = 100;
+    std::vector<void *> blocks;
+    for (int i = 0; i < count; ++i) {
+        blocks.push_back(task_object_pool::allocate(200));
+    }
+
+    std::thread t([&blocks]() {
+        for (void *p : blocks) {
+            task_object_pool::deallocate(p);
+        }
+    });
+    t.join();
+
+    // the blocks freed by the other thread are reclaimed by the owner
+    void *p = task_object_pool::allocate(200);
+    ASSERT_NE(blocks.end(), std::find(blocks.begin(), blocks.end(), p));
+    task_object_pool::deallocate(p);
+}
+
+TEST_F(task_object_pool_test, free_after_owner_exits)
+{
+    std::vector<void *> blocks;
+    std::thread t([&blocks]() {
+        for (int i = 0; i < 10; ++i) {
+            blocks.push_back(task_object_pool::allocate(300));
+        }
+    });
+    t.join();
+
+    for (void *p : blocks) {
+        task_object_pool::deallocate(p);
+    }
+}
+
+TEST_F(task_object_pool_test, disabled)
+{
+    void *p1 = task_object_pool::allocate(100);
+    FLAGS_enable_task_object_pool = false;
+    void *p2 = task_object_pool::allocate(100);
+    FLAGS_enable_task_object_pool = true;
+
+    // blocks allocated before and after the switch are both freed correctly
+    task_object_pool::deallocate(p2);
+    task_object_pool::deallocate(p1);
+}
+} // namespace dsn
@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/serialization_helper/thrift_helper.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/utility/binary_writer.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace dsn {
+
+static bool in_buffer(const blob &bb, const blob &buffer)
+{
+    return bb.data() >= buffer.data() && bb.data() + bb.length() <= buffer.data() + buffer.length();
+}
+
+TEST(thrift_helper, zero_copy_blob_decode)
+{
+    std::vector<blob> values = {blob::create_from_bytes(std::string(1000, 'a')),
+                                blob(),
+                                blob::create_from_bytes(std::string("hello"))};
+    binary_writer writer;
+    marshall_thrift_binary(writer, values);
+    blob buffer = writer.get_buffer();
+
+    bool old_value = FLAGS_thrift_zero_copy_blob_decode;
+    for (bool zero_copy : {true, false}) {
+        FLAGS_thrift_zero_copy_blob_decode = zero_copy;
+
+        std::vector<blob> decoded;
+        binary_reader reader(buffer);
+        unmarshall_thrift_binary(reader, decoded);
+        ASSERT_TRUE(reader.is_eof());
+
+        ASSERT_EQ(values.size(), decoded.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            ASSERT_EQ(values[i].to_string(), decoded[i].to_string());
+            if (decoded[i].length() > 0) {
+                ASSERT_EQ(zero_copy, in_buffer(decoded[i], buffer));
+            }
+        }
+    }
+    FLAGS_thrift_zero_copy_blob_decode = old_value;
+}
+
+TEST(thrift_helper, zero_copy_blob_decode_truncated)
+{
+    blob value = blob::create_from_bytes(std::string(100, 'a'));
+    binary_writer writer;
+    marshall_thrift_binary(writer, value);
+    blob buffer = writer.get_buffer();
+
+    blob decoded;
+    binary_reader reader(buffer.range(0, buffer.length() - 10));
+    ASSERT_ANY_THROW(unmarshall_thrift_binary(reader, decoded));
+}
+
+TEST(thrift_helper, blob_in_all_formats)
+{
+    std::vector<blob> values = {blob::create_from_bytes(std::string(1000, 'a')),
+                                blob(),
+                                blob::create_from_bytes(std::string("hello\0world", 11))};
+    for (dsn_msg_serialize_format fmt : {DSF_THRIFT_BINARY, DSF_THRIFT_COMPACT, DSF_THRIFT_JSON}) {
+        binary_writer writer;
+        marshall(writer, values, fmt);
+
+        std::vector<blob> decoded;
+        binary_reader reader(writer.get_buffer());
+        unmarshall(reader, decoded, fmt);
+        ASSERT_TRUE(reader.is_eof()) << fmt;
+
+        ASSERT_EQ(values.size(), decoded.size()) << fmt;
+        for (size_t i = 0; i < values.size(); i++) {
+            ASSERT_EQ(values[i].to_string(), decoded[i].to_string()) << fmt;
+        }
+    }
+}
+
+TEST(thrift_helper, compact_blob_decode)
+{
+    std::vector<blob> values = {blob::create_from_bytes(std::string(1000, 'a')),
+                                blob(),
+                                blob::create_from_bytes(std::string("hello"))};
+    binary_writer writer;
+    marshall_thrift_compact(writer, values);
+    blob buffer = writer.get_buffer();
+
+    // the same as the compact encoding through a generic transport, as of the old versions
+    boost::shared_ptr<apache::thrift::transport::TMemoryBuffer> mem(
+        new apache::thrift::transport::TMemoryBuffer());
+    apache::thrift::protocol::TCompactProtocol proto(mem);
+    marshall_thrift_internal(values, &proto);
+    ASSERT_EQ(mem->getBufferAsString(), buffer.to_string());
+
+    bool old_value = FLAGS_thrift_zero_copy_blob_decode;
+    for (bool zero_copy : {true, false}) {
+        FLAGS_thrift_zero_copy_blob_decode = zero_copy;
+
+        std::vector<blob> decoded;
+        binary_reader reader(buffer);
+        unmarshall_thrift_compact(reader, decoded);
+        ASSERT_TRUE(reader.is_eof());
+
+        ASSERT_EQ(values.size(), decoded.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            ASSERT_EQ(values[i].to_string(), decoded[i].to_string());
+            if (decoded[i].length() > 0) {
+                ASSERT_EQ(zero_copy, in_buffer(decoded[i], buffer));
+            }
+        }
+    }
+    FLAGS_thrift_zero_copy_blob_decode = old_value;
+
+    blob truncated;
+    binary_reader reader(buffer.range(0, buffer.length() - 10));
+    ASSERT_ANY_THROW(unmarshall_thrift_compact(reader, truncated));
+}
+
+} // namespace dsn
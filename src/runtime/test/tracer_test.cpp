@@ -0,0 +1,65 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <fstream>
+#include <sstream>
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/filesystem.h>
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+namespace dsn {
+
+DEFINE_TASK_CODE(LPC_TRACER_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(tracer_test, dump_chrome_trace)
+{
+    // [tracer] output = ring by config-test.ini
+    auto t = tasking::enqueue(LPC_TRACER_TEST, nullptr, []() {});
+    t->wait();
+
+    const std::string path = "./tracer_test.json";
+    std::string output;
+    ASSERT_TRUE(
+        command_manager::instance().run_command("tracer.dump_chrome_trace", {path}, output));
+    ASSERT_NE(std::string::npos, output.find("dumped")) << output;
+
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    nlohmann::json trace = nlohmann::json::parse(content.str());
+
+    int begin_count = 0;
+    int end_count = 0;
+    for (const auto &event : trace["traceEvents"]) {
+        if (event["name"] != "LPC_TRACER_TEST") {
+            continue;
+        }
+        if (event["ph"] == "B") {
+            ++begin_count;
+        } else if (event["ph"] == "E") {
+            ++end_count;
+        }
+    }
+    ASSERT_EQ(1, begin_count);
+    ASSERT_EQ(1, end_count);
+    utils::filesystem::remove_path(path);
+}
+
+} // namespace dsn
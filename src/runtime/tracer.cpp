@@ -35,14 +35,209 @@
 
 #include <dsn/toollet/tracer.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/process_utils.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+#include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/aio_task.h>
+#include <dsn/tool-api/task_worker.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <mutex>
+#include <unordered_set>
 
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_string("tracer",
+                  output,
+                  "log",
+                  "where the traced events go, log: as the debug logs, ring: kept in memory by "
+                  "the recent ones of each thread, dumped by tracer.dump_chrome_trace");
+DSN_DEFINE_validator(output, [](const char *value) -> bool {
+    return strcmp(value, "log") == 0 || strcmp(value, "ring") == 0;
+});
+
+DSN_DEFINE_uint32("tracer",
+                  ring_size_per_thread,
+                  16384,
+                  "the number of the recent events kept by each thread for output = ring");
+DSN_DEFINE_validator(ring_size_per_thread, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("tracer",
+                  sampling_one_in,
+                  1,
+                  "trace one in every sampling_one_in tasks, chosen by the hash of the trace id "
+                  "for rpcs and the task id for the others, so the events of one are all traced");
+DSN_DEFINE_validator(sampling_one_in, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_string("tracer",
+                  gpids,
+                  "",
+                  "only trace the rpcs of these partitions if not empty, e.g. \"1.0,1.3,2\" in "
+                  "which \"2\" is all the partitions of app 2, the other tasks are not filtered");
+
+enum traced_event_t : uint8_t
+{
+    TET_TASK_CREATE,
+    TET_TASK_ENQUEUE,
+    TET_TASK_BEGIN,
+    TET_TASK_END,
+    TET_TASK_CANCELLED,
+    TET_AIO_CALL,
+    TET_AIO_ENQUEUE,
+    TET_RPC_CALL,
+    TET_RPC_REQUEST_ENQUEUE,
+    TET_RPC_REPLY,
+    TET_RPC_RESPONSE_ENQUEUE,
+    TET_RPC_CREATE_RESPONSE,
+};
+
+static const char *traced_event_name(traced_event_t type)
+{
+    static const char *names[] = {"CREATE",
+                                  "ENQUEUE",
+                                  "EXEC",
+                                  "EXEC",
+                                  "CANCELLED",
+                                  "AIO.CALL",
+                                  "AIO.ENQUEUE",
+                                  "RPC.CALL",
+                                  "RPC.REQUEST.ENQUEUE",
+                                  "RPC.REPLY",
+                                  "RPC.RESPONSE.ENQUEUE",
+                                  "RPC.CREATE.RESPONSE"};
+    return names[type];
+}
+
+struct traced_event
+{
+    uint64_t ts_ns;
+    uint64_t id; // task id, or 0 for the rpc messages
+    uint64_t trace_id;
+    gpid pid;
+    int code;
+    traced_event_t type;
+};
+
+// the recent events of a thread for output = ring, the lock is only contended by dumping
+struct traced_event_ring
+{
+    std::mutex lock;
+    std::vector<traced_event> events;
+    uint64_t next = 0;
+    int tid;
+    std::string thread_name;
+};
+
+static bool s_ring_output = false;
+static std::unordered_set<uint64_t> s_traced_gpids;
+static std::unordered_set<int32_t> s_traced_apps;
+static std::mutex s_rings_lock;
+static std::vector<std::shared_ptr<traced_event_ring>> s_rings;
+
+static bool tracer_sampled(uint64_t id)
+{
+    if (FLAGS_sampling_one_in <= 1) {
+        return true;
+    }
+    // the finalizer of splitmix64, as the ids are mostly sequential
+    id = (id ^ (id >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    id = (id ^ (id >> 27)) * 0x94d049bb133111ebULL;
+    return (id ^ (id >> 31)) % FLAGS_sampling_one_in == 0;
+}
+
+// the filters are evaluated before anything is formatted
+static bool tracer_filter_message(const message_ex *msg, uint64_t task_id)
+{
+    if (!s_traced_apps.empty() || !s_traced_gpids.empty()) {
+        const gpid &pid = msg->header->gpid;
+        if (s_traced_apps.count(pid.get_app_id()) == 0 &&
+            s_traced_gpids.count(pid.value()) == 0) {
+            return false;
+        }
+    }
+    uint64_t trace_id = msg->header->trace_id;
+    return tracer_sampled(trace_id != 0 ? trace_id : task_id);
+}
+
+static bool tracer_filter(task *t)
+{
+    switch (t->spec().type) {
+    case dsn_task_type_t::TASK_TYPE_RPC_REQUEST:
+        return tracer_filter_message(static_cast<rpc_request_task *>(t)->get_request(), t->id());
+    case dsn_task_type_t::TASK_TYPE_RPC_RESPONSE:
+        return tracer_filter_message(static_cast<rpc_response_task *>(t)->get_request(),
+                                     t->id());
+    default:
+        return tracer_sampled(t->id());
+    }
+}
+
+static traced_event_ring *tracer_ring()
+{
+    static thread_local std::shared_ptr<traced_event_ring> ring;
+    if (dsn_unlikely(ring == nullptr)) {
+        ring = std::make_shared<traced_event_ring>();
+        ring->events.resize(FLAGS_ring_size_per_thread);
+        ring->tid = utils::get_current_tid();
+        task_worker *worker = task_worker::current();
+        ring->thread_name = worker != nullptr ? worker->name() : "non-worker";
+        std::lock_guard<std::mutex> l(s_rings_lock);
+        s_rings.push_back(ring);
+    }
+    return ring.get();
+}
+
+static void tracer_record(traced_event_t type, int code, uint64_t id, const message_ex *msg)
+{
+    traced_event_ring *ring = tracer_ring();
+    std::lock_guard<std::mutex> l(ring->lock);
+    traced_event &e = ring->events[ring->next++ % ring->events.size()];
+    e.ts_ns = dsn_now_ns();
+    e.id = id;
+    e.trace_id = msg != nullptr ? msg->header->trace_id : 0;
+    e.pid = msg != nullptr ? msg->header->gpid : gpid();
+    e.code = code;
+    e.type = type;
+}
+
+static void tracer_record(traced_event_t type, task *t)
+{
+    const message_ex *msg = nullptr;
+    if (t->spec().type == dsn_task_type_t::TASK_TYPE_RPC_REQUEST) {
+        msg = static_cast<rpc_request_task *>(t)->get_request();
+    } else if (t->spec().type == dsn_task_type_t::TASK_TYPE_RPC_RESPONSE) {
+        msg = static_cast<rpc_response_task *>(t)->get_request();
+    }
+    tracer_record(type, t->code(), t->id(), msg);
+}
+
+#define TRACE_TASK(type, t)                                                                        \
+    do {                                                                                           \
+        if (!tracer_filter(t))                                                                     \
+            return;                                                                                \
+        if (s_ring_output) {                                                                       \
+            tracer_record(type, t);                                                                \
+            return;                                                                                \
+        }                                                                                          \
+    } while (false)
+
+#define TRACE_MESSAGE(type, msg)                                                                   \
+    do {                                                                                           \
+        if (!tracer_filter_message(msg, 0))                                                        \
+            return;                                                                                \
+        if (s_ring_output) {                                                                       \
+            tracer_record(type, (msg)->local_rpc_code, 0, msg);                                    \
+            return;                                                                                \
+        }                                                                                          \
+    } while (false)
+
 static void tracer_on_task_create(task *caller, task *callee)
 {
+    TRACE_TASK(TET_TASK_CREATE, callee);
     dsn_task_type_t type = callee->spec().type;
     if (TASK_TYPE_RPC_REQUEST == type) {
         rpc_request_task *tsk = (rpc_request_task *)callee;
@@ -72,6 +267,7 @@ static void tracer_on_task_create(task *caller, task *callee)
 
 static void tracer_on_task_enqueue(task *caller, task *callee)
 {
+    TRACE_TASK(TET_TASK_ENQUEUE, callee);
     ddebug("%s ENQUEUE, task_id = %016" PRIx64 ", delay = %d ms, queue size = %d",
            callee->spec().name.c_str(),
            callee->id(),
@@ -81,6 +277,7 @@ static void tracer_on_task_enqueue(task *caller, task *callee)
 
 static void tracer_on_task_begin(task *this_)
 {
+    TRACE_TASK(TET_TASK_BEGIN, this_);
     switch (this_->spec().type) {
     case dsn_task_type_t::TASK_TYPE_COMPUTE:
     case dsn_task_type_t::TASK_TYPE_AIO:
@@ -111,6 +308,7 @@ static void tracer_on_task_begin(task *this_)
 
 static void tracer_on_task_end(task *this_)
 {
+    TRACE_TASK(TET_TASK_END, this_);
     ddebug("%s EXEC END, task_id = %016" PRIx64 ", err = %s",
            this_->spec().name.c_str(),
            this_->id(),
@@ -119,6 +317,7 @@ static void tracer_on_task_end(task *this_)
 
 static void tracer_on_task_cancelled(task *this_)
 {
+    TRACE_TASK(TET_TASK_CANCELLED, this_);
     ddebug("%s CANCELLED, task_id = %016" PRIx64 "", this_->spec().name.c_str(), this_->id());
 }
 
@@ -131,6 +330,7 @@ static void tracer_on_task_cancel_post(task *caller, task *callee, bool succ) {}
 // return true means continue, otherwise early terminate with task::set_error_code
 static void tracer_on_aio_call(task *caller, aio_task *callee)
 {
+    TRACE_TASK(TET_AIO_CALL, callee);
     ddebug("%s AIO.CALL, task_id = %016" PRIx64 ", offset = %" PRIu64 ", size = %d",
            callee->spec().name.c_str(),
            callee->id(),
@@ -140,6 +340,7 @@ static void tracer_on_aio_call(task *caller, aio_task *callee)
 
 static void tracer_on_aio_enqueue(aio_task *this_)
 {
+    TRACE_TASK(TET_AIO_ENQUEUE, this_);
     ddebug("%s AIO.ENQUEUE, task_id = %016" PRIx64 ", queue size = %d",
            this_->spec().name.c_str(),
            this_->id(),
@@ -149,6 +350,7 @@ static void tracer_on_aio_enqueue(aio_task *this_)
 // return true means continue, otherwise early terminate with task::set_error_code
 static void tracer_on_rpc_call(task *caller, message_ex *req, rpc_response_task *callee)
 {
+    TRACE_MESSAGE(TET_RPC_CALL, req);
     message_header &hdr = *req->header;
     ddebug("%s RPC.CALL: %s => %s, trace_id = %016" PRIx64 ", callback_task = %016" PRIx64
            ", timeout = %d ms",
@@ -162,6 +364,7 @@ static void tracer_on_rpc_call(task *caller, message_ex *req, rpc_response_task
 
 static void tracer_on_rpc_request_enqueue(rpc_request_task *callee)
 {
+    TRACE_TASK(TET_RPC_REQUEST_ENQUEUE, callee);
     ddebug("%s RPC.REQUEST.ENQUEUE (0x%p), task_id = %016" PRIx64
            ", %s => %s, trace_id = %016" PRIx64 ", queue size = %d",
            callee->spec().name.c_str(),
@@ -176,6 +379,7 @@ static void tracer_on_rpc_request_enqueue(rpc_request_task *callee)
 // return true means continue, otherwise early terminate with task::set_error_code
 static void tracer_on_rpc_reply(task *caller, message_ex *msg)
 {
+    TRACE_MESSAGE(TET_RPC_REPLY, msg);
     message_header &hdr = *msg->header;
 
     ddebug("%s RPC.REPLY: %s => %s, trace_id = %016" PRIx64 "",
@@ -187,6 +391,7 @@ static void tracer_on_rpc_reply(task *caller, message_ex *msg)
 
 static void tracer_on_rpc_response_enqueue(rpc_response_task *resp)
 {
+    TRACE_TASK(TET_RPC_RESPONSE_ENQUEUE, resp);
     ddebug("%s RPC.RESPONSE.ENQUEUE, task_id = %016" PRIx64 ", %s => %s, trace_id = %016" PRIx64
            ", queue size = %d",
            resp->spec().name.c_str(),
@@ -199,6 +404,7 @@ static void tracer_on_rpc_response_enqueue(rpc_response_task *resp)
 
 static void tracer_on_rpc_create_response(message_ex *req, message_ex *resp)
 {
+    TRACE_MESSAGE(TET_RPC_CREATE_RESPONSE, req);
     ddebug("%s RPC.CREATE.RESPONSE, trace_id = %016" PRIx64 "",
            resp->header->rpc_name,
            resp->header->trace_id);
@@ -242,6 +448,87 @@ struct logged_task
     std::vector<logged_event> events;
 };
 
+// dump the events of output = ring as a chrome trace, which is opened by chrome://tracing
+static std::string tracer_dump_chrome_trace(const std::vector<std::string> &args)
+{
+    if (!s_ring_output) {
+        return "tracer.dump_chrome_trace is only for [tracer] output = ring";
+    }
+    std::string path = args.empty() ? utils::filesystem::path_combine(
+                                          tools::spec().data_dir,
+                                          fmt::format("tracer.{}.json", dsn_now_ms()))
+                                    : args[0];
+
+    std::vector<std::shared_ptr<traced_event_ring>> rings;
+    {
+        std::lock_guard<std::mutex> l(s_rings_lock);
+        rings = s_rings;
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    size_t event_count = 0;
+    std::vector<traced_event> events;
+    for (const auto &ring : rings) {
+        int tid;
+        std::string thread_name;
+        {
+            std::lock_guard<std::mutex> l(ring->lock);
+            tid = ring->tid;
+            thread_name = ring->thread_name;
+            size_t size = ring->events.size();
+            size_t count = std::min<uint64_t>(ring->next, size);
+            events.clear();
+            for (uint64_t i = ring->next - count; i < ring->next; ++i) {
+                events.push_back(ring->events[i % size]);
+            }
+        }
+
+        fmt::format_to(std::back_inserter(out),
+                       "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},"
+                       "\"args\":{{\"name\":\"{}\"}}}}",
+                       event_count++ == 0 ? "" : ",",
+                       tid,
+                       thread_name);
+        for (const traced_event &e : events) {
+            const char *phase =
+                e.type == TET_TASK_BEGIN ? "B" : (e.type == TET_TASK_END ? "E" : "i");
+            fmt::format_to(std::back_inserter(out),
+                           ",{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"{}\",\"ts\":{}.{:03},"
+                           "\"pid\":0,\"tid\":{},\"s\":\"t\",\"args\":{{\"task_id\":\"{:016x}\"",
+                           dsn::task_code(e.code).to_string(),
+                           traced_event_name(e.type),
+                           phase,
+                           e.ts_ns / 1000,
+                           e.ts_ns % 1000,
+                           tid,
+                           e.id);
+            if (e.trace_id != 0) {
+                fmt::format_to(std::back_inserter(out), ",\"trace_id\":\"{:016x}\"", e.trace_id);
+            }
+            if (e.pid.value() != 0) {
+                fmt::format_to(std::back_inserter(out),
+                               ",\"gpid\":\"{}.{}\"",
+                               e.pid.get_app_id(),
+                               e.pid.get_partition_index());
+            }
+            out.append("}}");
+            ++event_count;
+        }
+    }
+    out.append("]}");
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return "failed to open " + path;
+    }
+    file << out;
+    file.close();
+    if (!file) {
+        return "failed to write " + path;
+    }
+    return fmt::format("dumped {} events of {} threads to {}", event_count, rings.size(), path);
+}
+
 static std::string tracer_log_flow_error(const char *msg)
 {
     return std::string("invalid arguments for tracer.find: ") + msg;
@@ -288,6 +575,21 @@ static std::string tracer_log_flow(const std::vector<std::string> &args)
 
 void tracer::install(service_spec &spec)
 {
+    s_ring_output = strcmp(FLAGS_output, "ring") == 0;
+    std::vector<std::string> gpids;
+    utils::split_args(FLAGS_gpids, gpids, ',');
+    for (const std::string &str : gpids) {
+        gpid pid;
+        int32_t app_id;
+        if (pid.parse_from(str.c_str())) {
+            s_traced_gpids.insert(pid.value());
+        } else if (buf2int32(str, app_id)) {
+            s_traced_apps.insert(app_id);
+        } else {
+            dassert_f(false, "invalid [tracer] gpids: {}", FLAGS_gpids);
+        }
+    }
+
     auto trace = dsn_config_get_value_bool(
         "task..default", "is_trace", false, "whether to trace tasks by default");
 
@@ -401,6 +703,13 @@ void tracer::install(service_spec &spec)
         "tracer.find forward|f|backward|b rpc|r|task|t trace_id|task_id(e.g., "
         "a023003920302390) log_file_name(log.xx.txt)",
         tracer_log_flow);
+
+    command_manager::instance().register_command(
+        {"tracer.dump_chrome_trace"},
+        "tracer.dump_chrome_trace - dump the recent traced events kept in memory by [tracer] "
+        "output = ring as a chrome trace file",
+        "tracer.dump_chrome_trace [file_path], the default is <data_dir>/tracer.<ts>.json",
+        tracer_dump_chrome_trace);
 }
 
 tracer::tracer(const char *name) : toollet(name) {}
@@ -35,6 +35,7 @@
 
 #include <dsn/utility/factory_store.h>
 #include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/lock_contention_profiler.h>
 #include "utils/zlock_provider.h"
 #include "runtime/service_engine.h"
 
@@ -65,7 +66,38 @@ void check_dangling_lock()
 }
 } // namespace lock_checker
 
-zlock::zlock(bool recursive)
+namespace {
+
+typedef utils::lock_contention_profiler contention_profiler;
+
+// acquire a lock and record the wait time if contended
+template <typename TTryAcquire, typename TAcquire>
+void acquire_tracked(const void *site, TTryAcquire &&try_acquire, TAcquire &&acquire)
+{
+    if (!try_acquire()) {
+        uint64_t start = contention_profiler::now_ns();
+        acquire();
+        contention_profiler::record_wait(site, contention_profiler::now_ns() - start);
+    }
+}
+
+void sample_hold(const void *site, const void *&hold_site, uint64_t &hold_start_ns)
+{
+    if (contention_profiler::should_sample_hold()) {
+        hold_site = site;
+        hold_start_ns = contention_profiler::now_ns();
+    }
+}
+
+void record_hold(const void *&hold_site, uint64_t hold_start_ns)
+{
+    contention_profiler::record_hold(hold_site, contention_profiler::now_ns() - hold_start_ns);
+    hold_site = nullptr;
+}
+
+} // anonymous namespace
+
+zlock::zlock(bool recursive) : _recursive(recursive), _hold_site(nullptr), _hold_start_ns(0)
 {
     if (recursive) {
         lock_provider *last = utils::factory_store<lock_provider>::create(
@@ -86,7 +118,16 @@ zlock::~zlock() { delete _h; }
 
 void zlock::lock()
 {
-    _h->lock();
+    if (dsn_unlikely(contention_profiler::enabled())) {
+        const void *site = __builtin_return_address(0);
+        acquire_tracked(site, [this]() { return _h->try_lock(); }, [this]() { _h->lock(); });
+        // the hold time of a recursive lock is hard to tell, so skip it
+        if (!_recursive) {
+            sample_hold(site, _hold_site, _hold_start_ns);
+        }
+    } else {
+        _h->lock();
+    }
     ++lock_checker::zlock_exclusive_count;
 }
 
@@ -102,10 +143,13 @@ bool zlock::try_lock()
 void zlock::unlock()
 {
     --lock_checker::zlock_exclusive_count;
+    if (dsn_unlikely(_hold_site != nullptr)) {
+        record_hold(_hold_site, _hold_start_ns);
+    }
     _h->unlock();
 }
 
-zrwlock_nr::zrwlock_nr()
+zrwlock_nr::zrwlock_nr() : _hold_site(nullptr), _hold_start_ns(0)
 {
     rwlock_nr_provider *last = utils::factory_store<rwlock_nr_provider>::create(
         service_engine::instance().spec().rwlock_nr_factory_name.c_str(),
@@ -118,7 +162,13 @@ zrwlock_nr::~zrwlock_nr() { delete _h; }
 
 void zrwlock_nr::lock_read()
 {
-    _h->lock_read();
+    if (dsn_unlikely(contention_profiler::enabled())) {
+        acquire_tracked(__builtin_return_address(0),
+                        [this]() { return _h->try_lock_read(); },
+                        [this]() { _h->lock_read(); });
+    } else {
+        _h->lock_read();
+    }
     ++lock_checker::zlock_shared_count;
 }
 
@@ -138,13 +188,23 @@ bool zrwlock_nr::try_lock_read()
 
 void zrwlock_nr::lock_write()
 {
-    _h->lock_write();
+    if (dsn_unlikely(contention_profiler::enabled())) {
+        const void *site = __builtin_return_address(0);
+        acquire_tracked(
+            site, [this]() { return _h->try_lock_write(); }, [this]() { _h->lock_write(); });
+        sample_hold(site, _hold_site, _hold_start_ns);
+    } else {
+        _h->lock_write();
+    }
     ++lock_checker::zlock_exclusive_count;
 }
 
 void zrwlock_nr::unlock_write()
 {
     --lock_checker::zlock_exclusive_count;
+    if (dsn_unlikely(_hold_site != nullptr)) {
+        record_hold(_hold_site, _hold_start_ns);
+    }
     _h->unlock_write();
 }
 
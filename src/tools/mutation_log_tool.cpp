@@ -25,12 +25,378 @@
  */
 
 #include <dsn/dist/replication/mutation_log_tool.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/output_utils.h>
 #include <dsn/utils/time_utils.h>
 #include "replica/mutation_log.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <queue>
+#include <thread>
+
 namespace dsn {
 namespace replication {
 
+namespace {
+
+const int kSizeBucketCount = 40;
+
+// the bucket of the sizes in (2^(i-1), 2^i]
+int size_bucket(int64_t bytes)
+{
+    int i = 0;
+    while (i < kSizeBucketCount - 1 && (int64_t(1) << i) < bytes) {
+        ++i;
+    }
+    return i;
+}
+
+struct code_stat
+{
+    int64_t count = 0;
+    int64_t bytes = 0;
+    int64_t max_bytes = 0;
+    std::array<int64_t, kSizeBucketCount> size_buckets{};
+
+    // the upper bound of the bucket where the percentile falls in
+    int64_t percentile(double p) const
+    {
+        int64_t target = std::max<int64_t>(1, static_cast<int64_t>(count * p));
+        int64_t seen = 0;
+        for (int i = 0; i < kSizeBucketCount; ++i) {
+            seen += size_buckets[i];
+            if (seen >= target) {
+                return std::min(int64_t(1) << i, max_bytes);
+            }
+        }
+        return max_bytes;
+    }
+};
+
+struct partition_stat
+{
+    int64_t mutations = 0;
+    int64_t updates = 0;
+    int64_t bytes = 0;
+    int64_t min_decree = std::numeric_limits<int64_t>::max();
+    int64_t max_decree = 0;
+};
+
+struct interval_stat
+{
+    int64_t mutations = 0;
+    int64_t bytes = 0;
+};
+
+struct mutation_entry
+{
+    int64_t log_length;
+    gpid pid;
+    int64_t ballot;
+    int64_t decree;
+    int64_t timestamp_us;
+    size_t update_count;
+    std::string file;
+
+    bool operator>(const mutation_entry &o) const { return log_length > o.log_length; }
+};
+
+// the statistics of the log files replayed by one thread, which are merged after all the
+// threads are done
+struct scan_stats
+{
+    int64_t files = 0;
+    int64_t failed_files = 0;
+    int64_t mutations = 0;
+    int64_t updates = 0;
+    int64_t bytes = 0;
+    int64_t min_timestamp_us = std::numeric_limits<int64_t>::max();
+    int64_t max_timestamp_us = 0;
+    std::map<int64_t, interval_stat> intervals;
+    std::map<std::string, code_stat> codes;
+    std::map<gpid, partition_stat> partitions;
+    // a min-heap of the largest mutations
+    std::priority_queue<mutation_entry, std::vector<mutation_entry>, std::greater<mutation_entry>>
+        largest;
+
+    void add_largest(mutation_entry &&e, uint32_t top_count)
+    {
+        if (largest.size() < top_count) {
+            largest.push(std::move(e));
+        } else if (top_count > 0 && e.log_length > largest.top().log_length) {
+            largest.pop();
+            largest.push(std::move(e));
+        }
+    }
+
+    void add(int log_length,
+             const mutation_ptr &mu,
+             const std::string &file,
+             const mutation_log_tool::scan_options &options)
+    {
+        const mutation_header &header = mu->data.header;
+        ++mutations;
+        updates += mu->data.updates.size();
+        bytes += log_length;
+        min_timestamp_us = std::min(min_timestamp_us, header.timestamp);
+        max_timestamp_us = std::max(max_timestamp_us, header.timestamp);
+
+        interval_stat &interval =
+            intervals[header.timestamp / (options.interval_seconds * 1000000LL)];
+        ++interval.mutations;
+        interval.bytes += log_length;
+
+        for (const mutation_update &update : mu->data.updates) {
+            code_stat &code = codes[update.code.to_string()];
+            int64_t size = update.data.length();
+            ++code.count;
+            code.bytes += size;
+            code.max_bytes = std::max(code.max_bytes, size);
+            ++code.size_buckets[size_bucket(size)];
+        }
+
+        partition_stat &partition = partitions[header.pid];
+        ++partition.mutations;
+        partition.updates += mu->data.updates.size();
+        partition.bytes += log_length;
+        partition.min_decree = std::min(partition.min_decree, header.decree);
+        partition.max_decree = std::max(partition.max_decree, header.decree);
+
+        add_largest({log_length,
+                     header.pid,
+                     header.ballot,
+                     header.decree,
+                     header.timestamp,
+                     mu->data.updates.size(),
+                     file},
+                    options.top_count);
+    }
+
+    void merge(scan_stats &&o, uint32_t top_count)
+    {
+        files += o.files;
+        failed_files += o.failed_files;
+        mutations += o.mutations;
+        updates += o.updates;
+        bytes += o.bytes;
+        min_timestamp_us = std::min(min_timestamp_us, o.min_timestamp_us);
+        max_timestamp_us = std::max(max_timestamp_us, o.max_timestamp_us);
+        for (const auto &kv : o.intervals) {
+            interval_stat &interval = intervals[kv.first];
+            interval.mutations += kv.second.mutations;
+            interval.bytes += kv.second.bytes;
+        }
+        for (const auto &kv : o.codes) {
+            code_stat &code = codes[kv.first];
+            code.count += kv.second.count;
+            code.bytes += kv.second.bytes;
+            code.max_bytes = std::max(code.max_bytes, kv.second.max_bytes);
+            for (int i = 0; i < kSizeBucketCount; ++i) {
+                code.size_buckets[i] += kv.second.size_buckets[i];
+            }
+        }
+        for (const auto &kv : o.partitions) {
+            partition_stat &partition = partitions[kv.first];
+            partition.mutations += kv.second.mutations;
+            partition.updates += kv.second.updates;
+            partition.bytes += kv.second.bytes;
+            partition.min_decree = std::min(partition.min_decree, kv.second.min_decree);
+            partition.max_decree = std::max(partition.max_decree, kv.second.max_decree);
+        }
+        while (!o.largest.empty()) {
+            add_largest(mutation_entry(o.largest.top()), top_count);
+            o.largest.pop();
+        }
+    }
+};
+
+std::string format_time_us(int64_t timestamp_us)
+{
+    char buf[32];
+    utils::time_ms_to_string(timestamp_us / 1000, buf);
+    return buf;
+}
+
+void output_stats(scan_stats &stats,
+                  const mutation_log_tool::scan_options &options,
+                  std::ostream &output)
+{
+    utils::multi_table_printer mtp;
+
+    utils::table_printer tp_summary("summary");
+    tp_summary.add_row_name_and_data("file_count", stats.files);
+    tp_summary.add_row_name_and_data("failed_file_count", stats.failed_files);
+    tp_summary.add_row_name_and_data("mutation_count", stats.mutations);
+    tp_summary.add_row_name_and_data("update_count", stats.updates);
+    tp_summary.add_row_name_and_data("total_bytes", stats.bytes);
+    if (stats.mutations > 0) {
+        tp_summary.add_row_name_and_data("first_timestamp", format_time_us(stats.min_timestamp_us));
+        tp_summary.add_row_name_and_data("last_timestamp", format_time_us(stats.max_timestamp_us));
+    }
+    mtp.add(std::move(tp_summary));
+
+    utils::table_printer tp_throughput("throughput");
+    tp_throughput.add_title("interval_start");
+    tp_throughput.add_column("mutations", utils::table_printer::alignment::kRight);
+    tp_throughput.add_column("mutations_per_sec", utils::table_printer::alignment::kRight);
+    tp_throughput.add_column("bytes_per_sec", utils::table_printer::alignment::kRight);
+    for (const auto &kv : stats.intervals) {
+        tp_throughput.add_row(format_time_us(kv.first * options.interval_seconds * 1000000LL));
+        tp_throughput.append_data(kv.second.mutations);
+        tp_throughput.append_data(static_cast<double>(kv.second.mutations) /
+                                  options.interval_seconds);
+        tp_throughput.append_data(static_cast<double>(kv.second.bytes) / options.interval_seconds);
+    }
+    mtp.add(std::move(tp_throughput));
+
+    utils::table_printer tp_codes("task_codes");
+    tp_codes.add_title("task_code");
+    tp_codes.add_column("updates", utils::table_printer::alignment::kRight);
+    tp_codes.add_column("total_bytes", utils::table_printer::alignment::kRight);
+    tp_codes.add_column("avg_bytes", utils::table_printer::alignment::kRight);
+    tp_codes.add_column("p50_bytes", utils::table_printer::alignment::kRight);
+    tp_codes.add_column("p99_bytes", utils::table_printer::alignment::kRight);
+    tp_codes.add_column("max_bytes", utils::table_printer::alignment::kRight);
+    for (const auto &kv : stats.codes) {
+        tp_codes.add_row(kv.first);
+        tp_codes.append_data(kv.second.count);
+        tp_codes.append_data(kv.second.bytes);
+        tp_codes.append_data(kv.second.bytes / std::max<int64_t>(1, kv.second.count));
+        tp_codes.append_data(kv.second.percentile(0.5));
+        tp_codes.append_data(kv.second.percentile(0.99));
+        tp_codes.append_data(kv.second.max_bytes);
+    }
+    mtp.add(std::move(tp_codes));
+
+    // the partitions written the most come first
+    std::vector<std::pair<gpid, partition_stat>> partitions(stats.partitions.begin(),
+                                                            stats.partitions.end());
+    std::sort(partitions.begin(), partitions.end(), [](const auto &l, const auto &r) {
+        return l.second.bytes > r.second.bytes;
+    });
+    utils::table_printer tp_partitions("partitions");
+    tp_partitions.add_title("gpid");
+    tp_partitions.add_column("mutations", utils::table_printer::alignment::kRight);
+    tp_partitions.add_column("updates", utils::table_printer::alignment::kRight);
+    tp_partitions.add_column("total_bytes", utils::table_printer::alignment::kRight);
+    tp_partitions.add_column("bytes_ratio", utils::table_printer::alignment::kRight);
+    tp_partitions.add_column("min_decree", utils::table_printer::alignment::kRight);
+    tp_partitions.add_column("max_decree", utils::table_printer::alignment::kRight);
+    for (const auto &kv : partitions) {
+        tp_partitions.add_row(kv.first.to_string());
+        tp_partitions.append_data(kv.second.mutations);
+        tp_partitions.append_data(kv.second.updates);
+        tp_partitions.append_data(kv.second.bytes);
+        tp_partitions.append_data(static_cast<double>(kv.second.bytes) /
+                                  std::max<int64_t>(1, stats.bytes));
+        tp_partitions.append_data(kv.second.min_decree);
+        tp_partitions.append_data(kv.second.max_decree);
+    }
+    mtp.add(std::move(tp_partitions));
+
+    std::vector<mutation_entry> largest;
+    while (!stats.largest.empty()) {
+        largest.push_back(stats.largest.top());
+        stats.largest.pop();
+    }
+    std::reverse(largest.begin(), largest.end());
+    utils::table_printer tp_largest("largest_mutations");
+    tp_largest.add_title("gpid");
+    tp_largest.add_column("ballot", utils::table_printer::alignment::kRight);
+    tp_largest.add_column("decree", utils::table_printer::alignment::kRight);
+    tp_largest.add_column("timestamp");
+    tp_largest.add_column("updates", utils::table_printer::alignment::kRight);
+    tp_largest.add_column("log_length", utils::table_printer::alignment::kRight);
+    tp_largest.add_column("file");
+    for (const mutation_entry &e : largest) {
+        tp_largest.add_row(e.pid.to_string());
+        tp_largest.append_data(e.ballot);
+        tp_largest.append_data(e.decree);
+        tp_largest.append_data(format_time_us(e.timestamp_us));
+        tp_largest.append_data(e.update_count);
+        tp_largest.append_data(e.log_length);
+        tp_largest.append_data(e.file);
+    }
+    mtp.add(std::move(tp_largest));
+
+    mtp.output(output,
+               options.json ? utils::table_printer::output_format::kJsonPretty
+                            : utils::table_printer::output_format::kTabular);
+}
+
+} // anonymous namespace
+
+bool mutation_log_tool::scan(const std::string &log_dir,
+                             const scan_options &options,
+                             std::ostream &output)
+{
+    if (options.interval_seconds == 0) {
+        output << "ERROR: interval_seconds should be positive" << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> files;
+    if (!utils::filesystem::get_subfiles(log_dir, files, false)) {
+        output << "ERROR: list files of " << log_dir << " failed" << std::endl;
+        return false;
+    }
+    // only the log files, the others (e.g. the spare files) are skipped
+    files.erase(std::remove_if(files.begin(),
+                               files.end(),
+                               [](const std::string &f) {
+                                   return utils::filesystem::get_file_name(f).compare(
+                                              0, 4, "log.") != 0;
+                               }),
+                files.end());
+    std::sort(files.begin(), files.end());
+
+    uint32_t thread_count = options.thread_count;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min<uint32_t>(thread_count, std::max<size_t>(1, files.size()));
+
+    // each thread replays the next file not taken yet, one file at a time
+    std::atomic<size_t> next_file{0};
+    std::vector<scan_stats> stats(thread_count);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i]() {
+            scan_stats &s = stats[i];
+            for (size_t f = next_file++; f < files.size(); f = next_file++) {
+                const std::string &file = files[f];
+                std::vector<std::string> one_file({file});
+                int64_t end_offset = 0;
+                error_code err = mutation_log::replay(
+                    one_file,
+                    [&](int log_length, mutation_ptr &mu) -> bool {
+                        s.add(log_length, mu, file, options);
+                        return true;
+                    },
+                    end_offset);
+                ++s.files;
+                if (err != ERR_OK && err != ERR_HANDLE_EOF && err != ERR_INCOMPLETE_DATA) {
+                    derror_f("scan log file {} failed: {}", file, err);
+                    ++s.failed_files;
+                }
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    scan_stats total;
+    for (scan_stats &s : stats) {
+        total.merge(std::move(s), options.top_count);
+    }
+    output_stats(total, options, output);
+    return total.failed_files == 0;
+}
+
 bool mutation_log_tool::dump(
     const std::string &log_dir,
     std::ostream &output,
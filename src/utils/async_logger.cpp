@@ -0,0 +1,539 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "async_logger.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <sstream>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/process_utils.h>
+#include <dsn/utils/binary_log.h>
+#include <dsn/utils/time_utils.h>
+#include <fmt/format.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("tools.async_logger",
+                  buffer_size_kb_per_thread,
+                  256,
+                  "the size of the log buffer of each thread, the records are dropped if it is "
+                  "full, rounded up to a power of two");
+DSN_DEFINE_validator(buffer_size_kb_per_thread, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("tools.async_logger",
+                  flush_interval_ms,
+                  100,
+                  "the interval the buffered records are written to the log file");
+DSN_DEFINE_validator(flush_interval_ms, [](uint32_t value) -> bool { return value > 0; });
+
+DSN_DEFINE_uint32("tools.async_logger",
+                  max_lines_per_log_file,
+                  200000,
+                  "the max number of lines in a log file before it is rotated");
+
+DSN_DEFINE_bool("tools.async_logger",
+                binary_format,
+                false,
+                "whether to write the binary log, in which the format strings and the arguments "
+                "are recorded instead of the text, as log.<index>.bin decoded by "
+                "dsn::utils::decode_binary_log_file()");
+
+// shared with simple_logger
+DSN_DECLARE_bool(short_header);
+DSN_DECLARE_uint64(max_number_of_log_files_on_disk);
+DSN_DECLARE_string(stderr_start_level);
+
+namespace {
+
+std::atomic<uint64_t> s_next_logger_id{1};
+
+size_t round_up_to_power_of_two(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void append_vformat(std::string &out, const char *fmt, va_list args)
+{
+    char buf[1024];
+    va_list args2;
+    va_copy(args2, args);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    if (len < 0) {
+        va_end(args2);
+        return;
+    }
+    if (static_cast<size_t>(len) < sizeof(buf)) {
+        out.append(buf, len);
+    } else {
+        size_t offset = out.size();
+        out.resize(offset + len + 1);
+        vsnprintf(&out[offset], len + 1, fmt, args2);
+        out.resize(offset + len);
+    }
+    va_end(args2);
+}
+
+} // anonymous namespace
+
+async_logger::thread_buffer::thread_buffer(size_t cap) : data(new char[cap]), capacity(cap) {}
+
+void async_logger::thread_buffer::copy_in(uint64_t pos, const void *src, size_t len)
+{
+    size_t offset = pos & (capacity - 1);
+    size_t first = std::min(len, capacity - offset);
+    memcpy(data.get() + offset, src, first);
+    memcpy(data.get(), static_cast<const char *>(src) + first, len - first);
+}
+
+void async_logger::thread_buffer::copy_out(uint64_t pos, void *dst, size_t len) const
+{
+    size_t offset = pos & (capacity - 1);
+    size_t first = std::min(len, capacity - offset);
+    memcpy(dst, data.get() + offset, first);
+    memcpy(static_cast<char *>(dst) + first, data.get(), len - first);
+}
+
+bool async_logger::thread_buffer::push(dsn_log_level_t log_level, const char *str, uint32_t len)
+{
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t size = sizeof(record_header) + len;
+    if (size > capacity - (h - tail.load(std::memory_order_acquire))) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    record_header header{len, static_cast<uint32_t>(log_level)};
+    copy_in(h, &header, sizeof(header));
+    copy_in(h + sizeof(header), str, len);
+    head.store(h + size, std::memory_order_release);
+    return true;
+}
+
+async_logger::async_logger(const char *log_dir)
+    : logging_provider(log_dir),
+      _id(s_next_logger_id.fetch_add(1)),
+      _log_dir(log_dir),
+      _binary(FLAGS_binary_format),
+      _suffix(_binary ? ".bin" : ".txt"),
+      _log(nullptr),
+      _start_index(0),
+      _index(1),
+      _lines(0),
+      _stdout_decoder(FLAGS_short_header)
+{
+    _stderr_start_level = enum_from_string(FLAGS_stderr_start_level, LOG_LEVEL_INVALID);
+
+    // check existing log files, which are named as simple_logger does
+    std::string pattern = "log.%d" + _suffix;
+    std::vector<std::string> sub_list;
+    if (!dsn::utils::filesystem::get_subfiles(_log_dir, sub_list, false)) {
+        dassert(false, "Fail to get subfiles in %s.", _log_dir.c_str());
+    }
+    for (auto &fpath : sub_list) {
+        auto &&name = dsn::utils::filesystem::get_file_name(fpath);
+        int index;
+        if (name.length() <= 8 || name.substr(0, 4) != "log." ||
+            1 != sscanf(name.c_str(), pattern.c_str(), &index) || index <= 0 ||
+            name != fmt::format("log.{}{}", index, _suffix)) {
+            continue;
+        }
+        _index = std::max(_index, index);
+        if (_start_index == 0 || index < _start_index) {
+            _start_index = index;
+        }
+    }
+    if (_start_index == 0) {
+        _start_index = _index;
+    } else {
+        ++_index;
+    }
+    create_log_file();
+
+    _drainer = std::thread(&async_logger::drain_thread, this);
+}
+
+async_logger::~async_logger()
+{
+    {
+        std::lock_guard<std::mutex> l(_wakeup_lock);
+        _stopped = true;
+    }
+    _wakeup.notify_one();
+    _drainer.join();
+
+    std::lock_guard<std::mutex> l(_write_lock);
+    drain();
+    ::fclose(_log);
+}
+
+async_logger::thread_buffer *async_logger::get_thread_buffer()
+{
+    struct thread_buffer_holder
+    {
+        ~thread_buffer_holder()
+        {
+            if (buffer != nullptr) {
+                buffer->closed.store(true, std::memory_order_release);
+            }
+        }
+
+        uint64_t logger_id{0};
+        std::shared_ptr<thread_buffer> buffer;
+    };
+    static thread_local thread_buffer_holder holder;
+
+    if (dsn_unlikely(holder.logger_id != _id)) {
+        if (holder.buffer != nullptr) {
+            holder.buffer->closed.store(true, std::memory_order_release);
+        }
+        holder.logger_id = _id;
+        holder.buffer = std::make_shared<thread_buffer>(
+            round_up_to_power_of_two(FLAGS_buffer_size_kb_per_thread * 1024ULL));
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        _buffers.push_back(holder.buffer);
+    }
+    return holder.buffer.get();
+}
+
+void async_logger::dsn_logv(const char *file,
+                            const char *function,
+                            const int line,
+                            dsn_log_level_t log_level,
+                            const char *fmt,
+                            va_list args)
+{
+    // reused by the records of the thread to avoid allocations
+    static thread_local std::string s_record;
+    s_record.clear();
+
+    if (!_binary) {
+        format_header(file, function, line, log_level, s_record);
+        append_vformat(s_record, fmt, args);
+        s_record.push_back('\n');
+    } else if (!utils::binary_log::encode_event(get_format_id(file, function, line, fmt),
+                                         log_level,
+                                         dsn_now_ns(),
+                                         dsn::utils::get_current_tid(),
+                                         log_prefixed_message_func(),
+                                         fmt,
+                                         args,
+                                         s_record)) {
+        static thread_local std::string s_text;
+        s_text.clear();
+        append_vformat(s_text, fmt, args);
+        encode_text(file, function, line, log_level, s_text, s_record);
+    }
+    submit(log_level, s_record);
+}
+
+void async_logger::dsn_log(const char *file,
+                           const char *function,
+                           const int line,
+                           dsn_log_level_t log_level,
+                           const char *str)
+{
+    static thread_local std::string s_record;
+    s_record.clear();
+
+    if (!_binary) {
+        format_header(file, function, line, log_level, s_record);
+        s_record.append(str);
+        s_record.push_back('\n');
+    } else {
+        encode_text(file, function, line, log_level, str, s_record);
+    }
+    submit(log_level, s_record);
+}
+
+/*static*/ void async_logger::format_header(const char *file,
+                                            const char *function,
+                                            const int line,
+                                            dsn_log_level_t log_level,
+                                            std::string &record)
+{
+    static thread_local std::string s_time;
+    static const char s_level_char[] = "IDWEF";
+
+    uint64_t ts = dsn_now_ns();
+    dsn::utils::time_ms_to_string(ts / 1000000, s_time);
+    fmt::format_to(std::back_inserter(record),
+                   "{}{} ({} {}) {}",
+                   s_level_char[log_level],
+                   s_time,
+                   ts,
+                   dsn::utils::get_current_tid(),
+                   log_prefixed_message_func());
+    if (!FLAGS_short_header) {
+        fmt::format_to(std::back_inserter(record), "{}:{}:{}(): ", file, line, function);
+    }
+}
+
+/*static*/ void async_logger::encode_text(const char *file,
+                                          const char *function,
+                                          const int line,
+                                          dsn_log_level_t log_level,
+                                          string_view text,
+                                          std::string &record)
+{
+    utils::binary_log::encode_text(log_level,
+                            dsn_now_ns(),
+                            dsn::utils::get_current_tid(),
+                            log_prefixed_message_func(),
+                            file,
+                            function,
+                            line,
+                            text,
+                            record);
+}
+
+uint32_t async_logger::get_format_id(const char *file,
+                                     const char *function,
+                                     int line,
+                                     const char *fmt)
+{
+    struct format_id_cache
+    {
+        uint64_t logger_id{0};
+        std::unordered_map<format_key, uint32_t, format_key_hash> ids;
+    };
+    static thread_local format_id_cache cache;
+
+    if (dsn_unlikely(cache.logger_id != _id)) {
+        cache.logger_id = _id;
+        cache.ids.clear();
+    }
+    format_key key{fmt, file, line};
+    auto it = cache.ids.find(key);
+    if (dsn_likely(it != cache.ids.end())) {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> l(_formats_lock);
+    auto iter = _format_ids.find(key);
+    if (iter == _format_ids.end()) {
+        uint32_t id = static_cast<uint32_t>(_formats.size());
+        _formats.push_back(utils::binary_log::format_info{
+            id, static_cast<uint32_t>(line), file, function, fmt});
+        iter = _format_ids.emplace(key, id).first;
+    }
+    cache.ids.emplace(key, iter->second);
+    return iter->second;
+}
+
+void async_logger::submit(dsn_log_level_t log_level, std::string &record)
+{
+    // the fatal records are followed by a coredump, they are written with all the buffered
+    // ones at once
+    if (dsn_unlikely(log_level >= LOG_LEVEL_FATAL)) {
+        std::lock_guard<std::mutex> l(_write_lock);
+        drain();
+        write_record(log_level, record.data(), record.size());
+        commit_batch();
+        return;
+    }
+
+    // the text records longer than half of the buffer are truncated, while the binary ones
+    // are dropped as they can not be cut
+    thread_buffer *buffer = get_thread_buffer();
+    size_t max_len = buffer->capacity / 2 - sizeof(record_header);
+    if (dsn_unlikely(record.size() > max_len)) {
+        if (_binary) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record.resize(max_len - 1);
+        record.push_back('\n');
+    }
+    if (buffer->push(log_level, record.data(), static_cast<uint32_t>(record.size())) &&
+        log_level >= LOG_LEVEL_ERROR) {
+        // the errors are written soon, as simple_logger flushes them immediately
+        if (!_urgent.exchange(true, std::memory_order_relaxed)) {
+            _wakeup.notify_one();
+        }
+    }
+}
+
+void async_logger::flush()
+{
+    // flush() may be called by the signal handler of a crash in the drainer, which holds the
+    // lock already
+    if (std::this_thread::get_id() != _drainer.get_id()) {
+        std::lock_guard<std::mutex> l(_write_lock);
+        drain();
+    }
+    ::fflush(stdout);
+}
+
+void async_logger::drain_thread()
+{
+    std::unique_lock<std::mutex> wl(_wakeup_lock);
+    while (!_stopped) {
+        _wakeup.wait_for(wl, std::chrono::milliseconds(FLAGS_flush_interval_ms), [this]() {
+            return _stopped || _urgent.load(std::memory_order_relaxed);
+        });
+        _urgent.store(false, std::memory_order_relaxed);
+        wl.unlock();
+        {
+            std::lock_guard<std::mutex> l(_write_lock);
+            drain();
+        }
+        wl.lock();
+    }
+}
+
+void async_logger::drain()
+{
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        buffers = _buffers;
+    }
+
+    uint64_t dropped = 0;
+    bool has_closed = false;
+    for (const auto &buffer : buffers) {
+        // the records pushed after the closed flag is seen are drained in the next round
+        has_closed |= buffer->closed.load(std::memory_order_acquire);
+        uint64_t t = buffer->tail.load(std::memory_order_relaxed);
+        uint64_t h = buffer->head.load(std::memory_order_acquire);
+        while (t < h) {
+            record_header header;
+            buffer->copy_out(t, &header, sizeof(header));
+            _record.resize(header.length);
+            buffer->copy_out(t + sizeof(header), &_record[0], header.length);
+            write_record(static_cast<dsn_log_level_t>(header.log_level),
+                         _record.data(),
+                         header.length);
+            t += sizeof(header) + header.length;
+        }
+        buffer->tail.store(t, std::memory_order_release);
+        dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (dropped > 0) {
+        _dropped_lines.fetch_add(dropped, std::memory_order_relaxed);
+        std::string message =
+            fmt::format("async_logger: dropped {} log lines as the buffers are full", dropped);
+        std::string record;
+        if (_binary) {
+            encode_text(__FILENAME__, __FUNCTION__, __LINE__, LOG_LEVEL_WARNING, message, record);
+        } else {
+            format_header(__FILENAME__, __FUNCTION__, __LINE__, LOG_LEVEL_WARNING, record);
+            record.append(message);
+            record.push_back('\n');
+        }
+        write_record(LOG_LEVEL_WARNING, record.data(), record.size());
+    }
+    commit_batch();
+
+    if (has_closed) {
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        _buffers.erase(std::remove_if(_buffers.begin(),
+                                      _buffers.end(),
+                                      [](const std::shared_ptr<thread_buffer> &buffer) {
+                                          return buffer->closed.load(std::memory_order_acquire) &&
+                                                 buffer->tail.load(std::memory_order_relaxed) ==
+                                                     buffer->head.load(std::memory_order_acquire);
+                                      }),
+                       _buffers.end());
+    }
+}
+
+void async_logger::write_record(dsn_log_level_t log_level, const char *str, uint32_t len)
+{
+    if (!_binary) {
+        _batch.append(str, len);
+        if (log_level >= _stderr_start_level) {
+            _stdout_batch.append(str, len);
+        }
+    } else {
+        // the format of an event is written before the first one referring to it in the file
+        if (str[0] == utils::binary_log::kEvent) {
+            uint32_t id;
+            memcpy(&id, str + 1, sizeof(id));
+            if (id >= _formats_written.size()) {
+                _formats_written.resize(id + 1, false);
+            }
+            if (!_formats_written[id]) {
+                std::string format;
+                {
+                    std::lock_guard<std::mutex> l(_formats_lock);
+                    utils::binary_log::encode_format(_formats[id], format);
+                }
+                _batch.append(format);
+                _stdout_decoder.decode(format, _stdout_batch);
+                _formats_written[id] = true;
+            }
+        }
+        _batch.append(str, len);
+        if (log_level >= _stderr_start_level) {
+            _stdout_decoder.decode(string_view(str, len), _stdout_batch);
+        }
+    }
+    if (++_lines >= static_cast<int>(FLAGS_max_lines_per_log_file)) {
+        commit_batch();
+        create_log_file();
+    }
+}
+
+void async_logger::commit_batch()
+{
+    if (!_batch.empty()) {
+        ::fwrite(_batch.data(), 1, _batch.size(), _log);
+        ::fflush(_log);
+        _batch.clear();
+    }
+    if (!_stdout_batch.empty()) {
+        ::fwrite(_stdout_batch.data(), 1, _stdout_batch.size(), stdout);
+        _stdout_batch.clear();
+    }
+}
+
+void async_logger::create_log_file()
+{
+    if (_log != nullptr) {
+        ::fclose(_log);
+    }
+    _lines = 0;
+
+    std::stringstream str;
+    str << _log_dir << "/log." << _index++ << _suffix;
+    _log = ::fopen(str.str().c_str(), "w+");
+    if (_binary) {
+        ::fwrite(utils::binary_log::kMagic, 1, sizeof(utils::binary_log::kMagic), _log);
+        _formats_written.clear();
+    }
+
+    while (_index - _start_index > FLAGS_max_number_of_log_files_on_disk) {
+        std::stringstream str2;
+        str2 << "log." << _start_index++ << _suffix;
+        auto dp = utils::filesystem::path_combine(_log_dir, str2.str());
+        if (utils::filesystem::file_exists(dp) && ::remove(dp.c_str()) != 0) {
+            printf("Failed to remove garbage log file %s\n", dp.c_str());
+        }
+    }
+}
+
+} // namespace tools
+} // namespace dsn
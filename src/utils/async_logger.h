@@ -0,0 +1,178 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <dsn/tool_api.h>
+#include <dsn/utility/string_view.h>
+#include <dsn/utils/binary_log.h>
+
+namespace dsn {
+namespace tools {
+
+/*
+ * async_logger provides a logger which writes to file without blocking the logging threads.
+ *
+ * Each thread formats its records into its own lock-free ring buffer, and a background thread
+ * drains the buffers of all threads every `flush_interval_ms`, writing the records in one batch
+ * and rotating the log files as simple_logger does. When the buffer of a thread is full, the
+ * records are dropped and counted, the count is reported in the log when it is drained. The
+ * fatal records are written synchronously along with all the ones buffered, as the process is
+ * going to abort.
+ *
+ * With [tools.async_logger] binary_format, the cost of formatting is saved: the records hold
+ * the ids of the format strings and the raw arguments, see dsn/utils/binary_log.h.
+ */
+class async_logger : public logging_provider
+{
+public:
+    async_logger(const char *log_dir);
+    ~async_logger() override;
+
+    void dsn_logv(const char *file,
+                  const char *function,
+                  const int line,
+                  dsn_log_level_t log_level,
+                  const char *fmt,
+                  va_list args) override;
+
+    void dsn_log(const char *file,
+                 const char *function,
+                 const int line,
+                 dsn_log_level_t log_level,
+                 const char *str) override;
+
+    // write all the buffered records to the file
+    void flush() override;
+
+    // the number of records dropped as the buffers are full
+    uint64_t dropped_lines() const { return _dropped_lines.load(std::memory_order_relaxed); }
+
+private:
+    // a single-producer single-consumer ring of records, each is a record_header followed by
+    // the text, the producer is the thread owning it and the consumer is who holds _write_lock
+    struct thread_buffer
+    {
+        explicit thread_buffer(size_t capacity);
+
+        bool push(dsn_log_level_t log_level, const char *str, uint32_t len);
+        void copy_in(uint64_t pos, const void *src, size_t len);
+        void copy_out(uint64_t pos, void *dst, size_t len) const;
+
+        std::unique_ptr<char[]> data;
+        const size_t capacity;
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        // the owning thread has exited, the buffer is released once it is drained
+        std::atomic<bool> closed{false};
+    };
+
+    struct record_header
+    {
+        uint32_t length;
+        uint32_t log_level;
+    };
+
+    struct format_key
+    {
+        const char *fmt;
+        const char *file;
+        int line;
+        bool operator==(const format_key &other) const
+        {
+            return fmt == other.fmt && file == other.file && line == other.line;
+        }
+    };
+    struct format_key_hash
+    {
+        size_t operator()(const format_key &key) const
+        {
+            return std::hash<const char *>()(key.fmt) ^ std::hash<const char *>()(key.file) ^
+                   std::hash<int>()(key.line);
+        }
+    };
+
+    static void format_header(const char *file,
+                              const char *function,
+                              int line,
+                              dsn_log_level_t log_level,
+                              std::string &record);
+    static void encode_text(const char *file,
+                            const char *function,
+                            int line,
+                            dsn_log_level_t log_level,
+                            string_view text,
+                            std::string &record);
+    uint32_t get_format_id(const char *file, const char *function, int line, const char *fmt);
+    void submit(dsn_log_level_t log_level, std::string &record);
+    thread_buffer *get_thread_buffer();
+
+    void drain_thread();
+    // drain the buffers of all threads and write the records, _write_lock must be held
+    void drain();
+    void write_record(dsn_log_level_t log_level, const char *str, uint32_t len);
+    // write the records batched to the file and stdout
+    void commit_batch();
+    void create_log_file();
+
+private:
+    const uint64_t _id;
+    std::string _log_dir;
+    const bool _binary;
+    const std::string _suffix;
+    dsn_log_level_t _stderr_start_level;
+
+    std::mutex _formats_lock; // protects _format_ids and _formats
+    std::unordered_map<format_key, uint32_t, format_key_hash> _format_ids;
+    std::vector<utils::binary_log::format_info> _formats;
+
+    std::mutex _buffers_lock; // protects _buffers
+    std::vector<std::shared_ptr<thread_buffer>> _buffers;
+
+    std::mutex _write_lock; // protects the members below
+    FILE *_log;
+    int _start_index;
+    int _index;
+    int _lines;
+    std::string _batch;
+    std::string _stdout_batch;
+    std::string _record;
+    // the formats written into the current file
+    std::vector<bool> _formats_written;
+    // decodes the binary records copied to stdout
+    utils::binary_log_decoder _stdout_decoder;
+    std::atomic<uint64_t> _dropped_lines{0};
+
+    std::mutex _wakeup_lock;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _urgent{false};
+    bool _stopped{false};
+    std::thread _drainer;
+};
+} // namespace tools
+} // namespace dsn
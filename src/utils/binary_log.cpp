@@ -0,0 +1,567 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utils/binary_log.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <dsn/utils/time_utils.h>
+#include <fmt/format.h>
+
+namespace dsn {
+namespace utils {
+namespace binary_log {
+
+const char kMagic[8] = {'D', 'S', 'N', 'B', 'L', 'O', 'G', '1'};
+
+} // namespace binary_log
+
+namespace {
+
+// a printf conversion like "%-08.3llx", "*" of the width and the precision are taken from the
+// arguments
+struct conversion
+{
+    std::string flags;
+    std::string width;
+    std::string precision; // with the leading '.'
+    std::string length;
+    char specifier = 0;
+};
+
+// parse the conversion following '%' at `p`, returns the position after it
+const char *parse_conversion(const char *p, conversion &c)
+{
+    while (*p != '\0' && strchr("-+ #0'", *p) != nullptr) {
+        c.flags.push_back(*p++);
+    }
+    while (*p == '*' || (*p >= '0' && *p <= '9')) {
+        c.width.push_back(*p++);
+    }
+    if (*p == '.') {
+        c.precision.push_back(*p++);
+        while (*p == '*' || (*p >= '0' && *p <= '9')) {
+            c.precision.push_back(*p++);
+        }
+    }
+    while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) {
+        c.length.push_back(*p++);
+    }
+    c.specifier = *p;
+    return *p == '\0' ? p : p + 1;
+}
+
+enum class arg_kind
+{
+    kSigned,
+    kUnsigned,
+    kChar,
+    kFloat,
+    kString,
+    kPointer,
+    kUnsupported,
+};
+
+arg_kind kind_of(const conversion &c)
+{
+    switch (c.specifier) {
+    case 'd':
+    case 'i':
+        return arg_kind::kSigned;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        return arg_kind::kUnsigned;
+    case 'c':
+        return c.length.empty() ? arg_kind::kChar : arg_kind::kUnsupported;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        return arg_kind::kFloat;
+    case 's':
+        return c.length.empty() ? arg_kind::kString : arg_kind::kUnsupported;
+    case 'p':
+        return arg_kind::kPointer;
+    default:
+        return arg_kind::kUnsupported;
+    }
+}
+
+template <typename T>
+void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void put_string(std::string &out, string_view str)
+{
+    put<uint32_t>(out, static_cast<uint32_t>(str.size()));
+    out.append(str.data(), str.size());
+}
+
+int64_t get_signed(const std::string &length, va_list &args)
+{
+    if (length == "hh") {
+        return static_cast<signed char>(va_arg(args, int));
+    } else if (length == "h") {
+        return static_cast<short>(va_arg(args, int));
+    } else if (length == "l") {
+        return va_arg(args, long);
+    } else if (length == "ll" || length == "q") {
+        return va_arg(args, long long);
+    } else if (length == "j") {
+        return va_arg(args, intmax_t);
+    } else if (length == "z") {
+        return va_arg(args, ssize_t);
+    } else if (length == "t") {
+        return va_arg(args, ptrdiff_t);
+    }
+    return va_arg(args, int);
+}
+
+uint64_t get_unsigned(const std::string &length, va_list &args)
+{
+    if (length == "hh") {
+        return static_cast<unsigned char>(va_arg(args, unsigned int));
+    } else if (length == "h") {
+        return static_cast<unsigned short>(va_arg(args, unsigned int));
+    } else if (length == "l") {
+        return va_arg(args, unsigned long);
+    } else if (length == "ll" || length == "q") {
+        return va_arg(args, unsigned long long);
+    } else if (length == "j") {
+        return va_arg(args, uintmax_t);
+    } else if (length == "z") {
+        return va_arg(args, size_t);
+    } else if (length == "t") {
+        return static_cast<uint64_t>(va_arg(args, ptrdiff_t));
+    }
+    return va_arg(args, unsigned int);
+}
+
+bool encode_args(const char *fmt, va_list &args, std::string &out)
+{
+    const char *p = fmt;
+    while ((p = strchr(p, '%')) != nullptr) {
+        if (*++p == '%') {
+            ++p;
+            continue;
+        }
+        conversion c;
+        p = parse_conversion(p, c);
+        if (c.width == "*") {
+            put<int64_t>(out, va_arg(args, int));
+        }
+        if (c.precision == ".*") {
+            put<int64_t>(out, va_arg(args, int));
+        }
+        switch (kind_of(c)) {
+        case arg_kind::kSigned:
+            put<int64_t>(out, get_signed(c.length, args));
+            break;
+        case arg_kind::kUnsigned:
+            put<uint64_t>(out, get_unsigned(c.length, args));
+            break;
+        case arg_kind::kChar:
+            put<int64_t>(out, va_arg(args, int));
+            break;
+        case arg_kind::kFloat:
+            put<double>(out,
+                        c.length == "L" ? static_cast<double>(va_arg(args, long double))
+                                        : va_arg(args, double));
+            break;
+        case arg_kind::kString: {
+            const char *str = va_arg(args, const char *);
+            put_string(out, str == nullptr ? "(null)" : str);
+            break;
+        }
+        case arg_kind::kPointer:
+            put<uint64_t>(out, reinterpret_cast<uintptr_t>(va_arg(args, void *)));
+            break;
+        case arg_kind::kUnsupported:
+            return false;
+        }
+    }
+    return true;
+}
+
+class reader
+{
+public:
+    reader(const char *data, size_t size) : _p(data), _end(data + size) {}
+
+    template <typename T>
+    bool get(T &value)
+    {
+        if (static_cast<size_t>(_end - _p) < sizeof(T)) {
+            return false;
+        }
+        memcpy(&value, _p, sizeof(T));
+        _p += sizeof(T);
+        return true;
+    }
+
+    bool get_string(std::string &str)
+    {
+        uint32_t len = 0;
+        if (!get(len) || static_cast<size_t>(_end - _p) < len) {
+            return false;
+        }
+        str.assign(_p, len);
+        _p += len;
+        return true;
+    }
+
+    const char *position() const { return _p; }
+
+private:
+    const char *_p;
+    const char *_end;
+};
+
+template <typename T>
+void append_snprintf(std::string &out, const std::string &spec, T value)
+{
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+    if (len < 0) {
+        return;
+    }
+    if (static_cast<size_t>(len) < sizeof(buf)) {
+        out.append(buf, len);
+    } else {
+        size_t offset = out.size();
+        out.resize(offset + len + 1);
+        snprintf(&out[offset], len + 1, spec.c_str(), value);
+        out.resize(offset + len);
+    }
+}
+
+// the reverse of encode_args()
+bool format_args(const std::string &fmt, reader &args, std::string &out)
+{
+    const char *p = fmt.c_str();
+    while (*p != '\0') {
+        const char *percent = strchr(p, '%');
+        if (percent == nullptr) {
+            out.append(p);
+            break;
+        }
+        out.append(p, percent - p);
+        p = percent + 1;
+        if (*p == '%') {
+            out.push_back('%');
+            ++p;
+            continue;
+        }
+        conversion c;
+        p = parse_conversion(p, c);
+        int64_t star = 0;
+        if (c.width == "*") {
+            if (!args.get(star)) {
+                return false;
+            }
+            c.width = std::to_string(star);
+        }
+        if (c.precision == ".*") {
+            if (!args.get(star)) {
+                return false;
+            }
+            c.precision = "." + std::to_string(star);
+        }
+        std::string spec = "%" + c.flags + c.width + c.precision;
+        switch (kind_of(c)) {
+        case arg_kind::kSigned: {
+            int64_t value;
+            if (!args.get(value)) {
+                return false;
+            }
+            append_snprintf(out, spec + "ll" + c.specifier, static_cast<long long>(value));
+            break;
+        }
+        case arg_kind::kUnsigned: {
+            uint64_t value;
+            if (!args.get(value)) {
+                return false;
+            }
+            append_snprintf(
+                out, spec + "ll" + c.specifier, static_cast<unsigned long long>(value));
+            break;
+        }
+        case arg_kind::kChar: {
+            int64_t value;
+            if (!args.get(value)) {
+                return false;
+            }
+            append_snprintf(out, spec + c.specifier, static_cast<int>(value));
+            break;
+        }
+        case arg_kind::kFloat: {
+            double value;
+            if (!args.get(value)) {
+                return false;
+            }
+            append_snprintf(out, spec + c.specifier, value);
+            break;
+        }
+        case arg_kind::kString: {
+            std::string value;
+            if (!args.get_string(value)) {
+                return false;
+            }
+            append_snprintf(out, spec + c.specifier, value.c_str());
+            break;
+        }
+        case arg_kind::kPointer: {
+            uint64_t value;
+            if (!args.get(value)) {
+                return false;
+            }
+            append_snprintf(out, spec + c.specifier, reinterpret_cast<void *>(value));
+            break;
+        }
+        case arg_kind::kUnsupported:
+            return false;
+        }
+    }
+    return true;
+}
+
+void append_line_header(dsn_log_level_t log_level,
+                        uint64_t ts_ns,
+                        int32_t tid,
+                        const std::string &prefix,
+                        std::string &out)
+{
+    static const char s_level_char[] = "IDWEF";
+    std::string time_str;
+    time_ms_to_string(ts_ns / 1000000, time_str);
+    fmt::format_to(std::back_inserter(out),
+                   "{}{} ({} {}) {}",
+                   log_level < LOG_LEVEL_COUNT ? s_level_char[log_level] : '?',
+                   time_str,
+                   ts_ns,
+                   tid,
+                   prefix);
+}
+
+} // anonymous namespace
+
+namespace binary_log {
+
+void encode_format(const format_info &format, std::string &out)
+{
+    put<uint8_t>(out, kFormat);
+    put<uint32_t>(out, format.id);
+    put<uint32_t>(out, format.line);
+    put_string(out, format.file);
+    put_string(out, format.function);
+    put_string(out, format.fmt);
+}
+
+bool encode_event(uint32_t id,
+                  dsn_log_level_t log_level,
+                  uint64_t ts_ns,
+                  int tid,
+                  const std::string &prefix,
+                  const char *fmt,
+                  va_list args,
+                  std::string &out)
+{
+    size_t start = out.size();
+    put<uint8_t>(out, kEvent);
+    put<uint32_t>(out, id);
+    put<uint8_t>(out, static_cast<uint8_t>(log_level));
+    put<uint64_t>(out, ts_ns);
+    put<int32_t>(out, tid);
+    put_string(out, prefix);
+    size_t args_start = out.size();
+    put<uint32_t>(out, 0);
+
+    va_list args2;
+    va_copy(args2, args);
+    bool ok = encode_args(fmt, args2, out);
+    va_end(args2);
+    if (!ok) {
+        out.resize(start);
+        return false;
+    }
+    uint32_t args_len = static_cast<uint32_t>(out.size() - args_start - sizeof(uint32_t));
+    memcpy(&out[args_start], &args_len, sizeof(args_len));
+    return true;
+}
+
+void encode_text(dsn_log_level_t log_level,
+                 uint64_t ts_ns,
+                 int tid,
+                 const std::string &prefix,
+                 const char *file,
+                 const char *function,
+                 int line,
+                 string_view text,
+                 std::string &out)
+{
+    put<uint8_t>(out, kText);
+    put<uint8_t>(out, static_cast<uint8_t>(log_level));
+    put<uint64_t>(out, ts_ns);
+    put<int32_t>(out, tid);
+    put<uint32_t>(out, static_cast<uint32_t>(line));
+    put_string(out, prefix);
+    put_string(out, file);
+    put_string(out, function);
+    put_string(out, text);
+}
+
+} // namespace binary_log
+
+size_t binary_log_decoder::decode(string_view data, std::string &out)
+{
+    reader r(data.data(), data.size());
+    uint8_t type = 0;
+    if (!r.get(type)) {
+        return 0;
+    }
+
+    switch (type) {
+    case binary_log::kFormat: {
+        binary_log::format_info format;
+        if (!r.get(format.id) || !r.get(format.line) || !r.get_string(format.file) ||
+            !r.get_string(format.function) || !r.get_string(format.fmt)) {
+            return 0;
+        }
+        if (format.id >= _formats.size()) {
+            _formats.resize(format.id + 1);
+        }
+        _formats[format.id] = std::move(format);
+        break;
+    }
+    case binary_log::kEvent: {
+        uint32_t id;
+        uint8_t log_level;
+        uint64_t ts_ns;
+        int32_t tid;
+        std::string prefix;
+        uint32_t args_len;
+        if (!r.get(id) || !r.get(log_level) || !r.get(ts_ns) || !r.get(tid) ||
+            !r.get_string(prefix) || !r.get(args_len) ||
+            data.size() - (r.position() - data.data()) < args_len) {
+            return 0;
+        }
+        if (id >= _formats.size() || _formats[id].fmt.empty()) {
+            return 0;
+        }
+        const binary_log::format_info &format = _formats[id];
+        reader args(r.position(), args_len);
+        size_t line_start = out.size();
+        append_line_header(static_cast<dsn_log_level_t>(log_level), ts_ns, tid, prefix, out);
+        if (!_short_header) {
+            fmt::format_to(
+                std::back_inserter(out), "{}:{}:{}(): ", format.file, format.line, format.function);
+        }
+        if (!format_args(format.fmt, args, out)) {
+            out.resize(line_start);
+            return 0;
+        }
+        out.push_back('\n');
+        return r.position() - data.data() + args_len;
+    }
+    case binary_log::kText: {
+        uint8_t log_level;
+        uint64_t ts_ns;
+        int32_t tid;
+        uint32_t line;
+        std::string prefix, file, function, text;
+        if (!r.get(log_level) || !r.get(ts_ns) || !r.get(tid) || !r.get(line) ||
+            !r.get_string(prefix) || !r.get_string(file) || !r.get_string(function) ||
+            !r.get_string(text)) {
+            return 0;
+        }
+        append_line_header(static_cast<dsn_log_level_t>(log_level), ts_ns, tid, prefix, out);
+        if (!_short_header) {
+            fmt::format_to(std::back_inserter(out), "{}:{}:{}(): ", file, line, function);
+        }
+        out.append(text);
+        out.push_back('\n');
+        break;
+    }
+    default:
+        return 0;
+    }
+    return r.position() - data.data();
+}
+
+/*static*/ bool binary_log_decoder::peek_level(string_view data, dsn_log_level_t &log_level)
+{
+    size_t offset;
+    if (data.size() > 0 && data[0] == binary_log::kEvent) {
+        offset = sizeof(uint8_t) + sizeof(uint32_t);
+    } else if (data.size() > 0 && data[0] == binary_log::kText) {
+        offset = sizeof(uint8_t);
+    } else {
+        return false;
+    }
+    if (data.size() <= offset) {
+        return false;
+    }
+    log_level = static_cast<dsn_log_level_t>(static_cast<uint8_t>(data[offset]));
+    return true;
+}
+
+error_s decode_binary_log_file(const std::string &path, std::ostream &out, bool short_header)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return error_s::make(ERR_FILE_OPERATION_FAILED, "failed to open " + path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string data = buffer.str();
+    if (data.size() < sizeof(binary_log::kMagic) ||
+        memcmp(data.data(), binary_log::kMagic, sizeof(binary_log::kMagic)) != 0) {
+        return error_s::make(ERR_INVALID_DATA, path + " is not a binary log");
+    }
+
+    binary_log_decoder decoder(short_header);
+    std::string lines;
+    size_t offset = sizeof(binary_log::kMagic);
+    while (offset < data.size()) {
+        size_t len = decoder.decode(string_view(data.data() + offset, data.size() - offset), lines);
+        if (len == 0) {
+            // the tail may be incomplete if the process crashed while writing it
+            out << lines;
+            return error_s::make(ERR_INVALID_DATA,
+                                 fmt::format("{} is corrupted at offset {}", path, offset));
+        }
+        offset += len;
+        if (lines.size() >= 1 << 20) {
+            out << lines;
+            lines.clear();
+        }
+    }
+    out << lines;
+    return error_s::ok();
+}
+
+} // namespace utils
+} // namespace dsn
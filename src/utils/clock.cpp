@@ -2,23 +2,130 @@
 // This source code is licensed under the Apache License Version 2.0, which
 // can be found in the LICENSE file in the root directory of this source tree.
 
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
 #include <dsn/utility/clock.h>
 #include <dsn/utils/time_utils.h>
 #include <dsn/utility/dlib.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/ports.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/c/api_utilities.h>
 
 DSN_API uint64_t dsn_now_ns() { return dsn::utils::clock::instance()->now_ns(); }
 
+DSN_API uint64_t dsn_now_coarse_ns() { return dsn::utils::clock::instance()->coarse_now_ns(); }
+
 namespace dsn {
 namespace utils {
 
+DSN_DEFINE_string("core",
+                  clock_source,
+                  "system",
+                  "the clock for dsn_now_ns: system or tsc, the latter is cheaper but only "
+                  "available on the cpus with an invariant tsc");
+
+static uint64_t clock_gettime_ns(clockid_t id)
+{
+    timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 std::unique_ptr<clock> clock::_clock = make_unique<clock>();
 
 const clock *clock::instance() { return _clock.get(); }
 
 uint64_t clock::now_ns() const { return get_current_physical_time_ns(); }
 
+uint64_t clock::coarse_now_ns() const { return clock_gettime_ns(CLOCK_REALTIME_COARSE); }
+
 void clock::mock(clock *mock_clock) { _clock.reset(mock_clock); }
 
+/*static*/ bool clock::select(const std::string &source)
+{
+    if (source == "system") {
+        mock(new clock());
+    } else if (source == "tsc") {
+        if (tsc_clock::supported()) {
+            mock(new tsc_clock());
+        } else {
+            dwarn("the tsc is not invariant on this cpu, use the system clock instead");
+            mock(new clock());
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#if defined(__x86_64__)
+
+static inline uint64_t read_tsc() { return __rdtsc(); }
+
+/*static*/ bool tsc_clock::supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    // the "invariant tsc" bit of the advanced power management leaf
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8)) != 0;
+}
+
+#else
+
+static inline uint64_t read_tsc() { return 0; }
+
+/*static*/ bool tsc_clock::supported() { return false; }
+
+#endif
+
+tsc_clock::tsc_clock()
+{
+    dassert(supported(), "the tsc is not invariant on this cpu");
+
+    uint64_t start_ns = clock_gettime_ns(CLOCK_MONOTONIC_RAW);
+    uint64_t start_tsc = read_tsc();
+    usleep(20000);
+    uint64_t end_ns = clock_gettime_ns(CLOCK_MONOTONIC_RAW);
+    uint64_t end_tsc = read_tsc();
+
+    _ns_per_tick_q32 = ((end_ns - start_ns) << 32) / (end_tsc - start_tsc);
+    _rebase_ticks = (100000000ULL << 32) / _ns_per_tick_q32;
+}
+
+namespace {
+struct tsc_base
+{
+    uint64_t tsc;
+    uint64_t ns;
+    uint64_t last_ns;
+};
+thread_local tsc_base t_tsc_base = {0, 0, 0};
+} // anonymous namespace
+
+uint64_t tsc_clock::now_ns() const
+{
+    tsc_base &base = t_tsc_base;
+    uint64_t tsc = read_tsc();
+    // also retakes the base if the thread has none, or the tsc goes back
+    if (dsn_unlikely(tsc - base.tsc >= _rebase_ticks)) {
+        base.ns = clock_gettime_ns(CLOCK_REALTIME);
+        base.tsc = read_tsc();
+        tsc = base.tsc;
+    }
+
+    uint64_t ns = base.ns + (((tsc - base.tsc) * _ns_per_tick_q32) >> 32);
+    // the base may be retaken behind the time converted before
+    if (dsn_unlikely(ns < base.last_ns)) {
+        ns = base.last_ns;
+    }
+    base.last_ns = ns;
+    return ns;
+}
+
 } // namespace utils
 } // namespace dsn
@@ -0,0 +1,150 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/compression.h>
+
+#ifdef DSN_HAS_LZ4
+#include <lz4.h>
+#endif
+#ifdef DSN_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace dsn {
+namespace utils {
+
+#ifdef DSN_HAS_ZSTD
+// a low level, the compression of rpc messages is done on the critical path
+static const int ZSTD_COMPRESSION_LEVEL = 1;
+#endif
+
+const char *compression_type_to_string(compression_type type)
+{
+    switch (type) {
+    case compression_type::none:
+        return "none";
+    case compression_type::lz4:
+        return "lz4";
+    case compression_type::zstd:
+        return "zstd";
+    }
+    return "unknown";
+}
+
+bool compression_type_from_string(const char *name, /*out*/ compression_type &type)
+{
+    for (auto t : {compression_type::none, compression_type::lz4, compression_type::zstd}) {
+        if (strcmp(name, compression_type_to_string(t)) == 0) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool compression_supported(compression_type type)
+{
+    switch (type) {
+    case compression_type::none:
+        return true;
+#ifdef DSN_HAS_LZ4
+    case compression_type::lz4:
+        return true;
+#endif
+#ifdef DSN_HAS_ZSTD
+    case compression_type::zstd:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+size_t compress_bound(compression_type type, size_t src_len)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case compression_type::lz4:
+        if (src_len > LZ4_MAX_INPUT_SIZE) {
+            return 0;
+        }
+        return LZ4_compressBound(static_cast<int>(src_len));
+#endif
+#ifdef DSN_HAS_ZSTD
+    case compression_type::zstd:
+        return ZSTD_compressBound(src_len);
+#endif
+    default:
+        return 0;
+    }
+}
+
+size_t compress(compression_type type, const char *src, size_t src_len, char *dst, size_t dst_cap)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case compression_type::lz4: {
+        if (src_len > LZ4_MAX_INPUT_SIZE) {
+            return 0;
+        }
+        int cap = static_cast<int>(std::min(dst_cap, (size_t)std::numeric_limits<int>::max()));
+        int sz = LZ4_compress_default(src, dst, static_cast<int>(src_len), cap);
+        return sz > 0 ? static_cast<size_t>(sz) : 0;
+    }
+#endif
+#ifdef DSN_HAS_ZSTD
+    case compression_type::zstd: {
+        size_t sz = ZSTD_compress(dst, dst_cap, src, src_len, ZSTD_COMPRESSION_LEVEL);
+        return ZSTD_isError(sz) ? 0 : sz;
+    }
+#endif
+    default:
+        return 0;
+    }
+}
+
+bool decompress(compression_type type, const char *src, size_t src_len, char *dst, size_t dst_len)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case compression_type::lz4: {
+        if (src_len > (size_t)std::numeric_limits<int>::max() ||
+            dst_len > (size_t)std::numeric_limits<int>::max()) {
+            return false;
+        }
+        int sz = LZ4_decompress_safe(
+            src, dst, static_cast<int>(src_len), static_cast<int>(dst_len));
+        return sz >= 0 && static_cast<size_t>(sz) == dst_len;
+    }
+#endif
+#ifdef DSN_HAS_ZSTD
+    case compression_type::zstd: {
+        size_t sz = ZSTD_decompress(dst, dst_len, src, src_len);
+        return !ZSTD_isError(sz) && sz == dst_len;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+} // namespace utils
+} // namespace dsn
@@ -1,6 +1,16 @@
 #include <cstdio>
+#include <cstring>
 #include <dsn/utility/crc.h>
 
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 namespace dsn {
 namespace utils {
 
@@ -413,16 +423,235 @@ uint64_t crc64::_crc_table[sizeof(crc64::_crc_table) / sizeof(crc64::_crc_table[
 #undef crc64_POLY
 #undef BIT64
 #undef BIT32
+
+//
+// Faster implementations of crc32 (CRC-32C, Castagnoli polynomial) and crc64, selected by the
+// cpu features detected at runtime:
+//   - crc32: SSE4.2 `crc32` instruction on x86-64, the CRC32 extension on ARMv8
+//   - crc64: PCLMULQDQ folding on x86-64
+//   - otherwise slicing-by-8, or byte by byte on big-endian hosts
+// All of them run on the "raw" crc state, i.e. the inversions are done by the callers.
+//
+namespace {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define DSN_CRC_LITTLE_ENDIAN 1
+#endif
+
+inline uint64_t load_u64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <typename generator>
+class slice8
+{
+public:
+    typedef typename generator::uint uintxx_t;
+
+    static uintxx_t update(const uint8_t *p, size_t size, uintxx_t crc)
+    {
+#ifdef DSN_CRC_LITTLE_ENDIAN
+        const auto &t = tables();
+        for (; size >= 8; size -= 8, p += 8) {
+            // the crc state takes the low bytes of the 8-byte word
+            uint64_t v = load_u64(p) ^ static_cast<uint64_t>(crc);
+            crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^ t[5][(v >> 16) & 0xff] ^
+                  t[4][(v >> 24) & 0xff] ^ t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^
+                  t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+        }
+#endif
+        for (; size > 0; --size, ++p) {
+            crc = generator::_crc_table[(uint8_t)(crc ^ *p)] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+private:
+    typedef uintxx_t table_t[8][256];
+
+    // built on first use, so that it is also safe to be called during static initialization
+    static const table_t &tables()
+    {
+        static const struct holder
+        {
+            holder()
+            {
+                for (int i = 0; i < 256; ++i) {
+                    t[0][i] = generator::_crc_table[i];
+                }
+                for (int k = 1; k < 8; ++k) {
+                    for (int i = 0; i < 256; ++i) {
+                        uintxx_t c = t[k - 1][i];
+                        t[k][i] = generator::_crc_table[c & 0xff] ^ (c >> 8);
+                    }
+                }
+            }
+            table_t t;
+        } h;
+        return h.t;
+    }
+};
+
+uint32_t crc32_update_slice8(const uint8_t *p, size_t size, uint32_t crc)
+{
+    return slice8<crc32>::update(p, size, crc);
+}
+
+uint64_t crc64_update_slice8(const uint8_t *p, size_t size, uint64_t crc)
+{
+    return slice8<crc64>::update(p, size, crc);
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2"))) uint32_t
+crc32_update_sse42(const uint8_t *p, size_t size, uint32_t crc)
+{
+    uint64_t c = crc;
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p) {
+        c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        c = _mm_crc32_u64(c, load_u64(p));
+    }
+    for (; size > 0; --size, ++p) {
+        c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+    }
+    return static_cast<uint32_t>(c);
+}
+
+// x^n mod POLY of crc64, in the reversed representation of crc_generator
+uint64_t crc64_x_pow(uint64_t n)
+{
+    return crc64::MulPoly(crc64::ComputeX_N(n / 8), crc64::MSB >> (n % 8));
+}
+
+// The 128-bit state R = lo * x^64 + hi (reversed, lo is the first 8 bytes) is folded over a
+// distance of d bits with
+//      R * x^d = lo * x^(64 + d) + hi * x^d (mod POLY)
+// The carry-less product of two reversed 64-bit values is one bit short of a reversed 128-bit
+// value, hence the constants x^(63 + d) and x^(d - 1).
+struct crc64_fold_constants
+{
+    crc64_fold_constants()
+        : by_128{crc64_x_pow(191), crc64_x_pow(127)}, by_512{crc64_x_pow(575), crc64_x_pow(511)}
+    {
+    }
+    uint64_t by_128[2];
+    uint64_t by_512[2];
+};
+
+__attribute__((target("pclmul,sse4.1"))) inline __m128i
+crc64_fold(__m128i x, __m128i k, __m128i data)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                       _mm_clmulepi64_si128(x, k, 0x11)),
+                         data);
 }
+
+__attribute__((target("pclmul,sse4.1"))) uint64_t
+crc64_update_pclmul(const uint8_t *p, size_t size, uint64_t crc)
+{
+    if (size < 64) {
+        return crc64_update_slice8(p, size, crc);
+    }
+
+    static const crc64_fold_constants c;
+    const __m128i k512 = _mm_set_epi64x(c.by_512[1], c.by_512[0]);
+    const __m128i k128 = _mm_set_epi64x(c.by_128[1], c.by_128[0]);
+    auto load = [](const uint8_t *q) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(q));
+    };
+
+    // 4 lanes of 128 bits hide the latency of pclmulqdq
+    __m128i x0 = _mm_xor_si128(load(p), _mm_cvtsi64_si128(static_cast<int64_t>(crc)));
+    __m128i x1 = load(p + 16);
+    __m128i x2 = load(p + 32);
+    __m128i x3 = load(p + 48);
+    p += 64;
+    size -= 64;
+    for (; size >= 64; size -= 64, p += 64) {
+        x0 = crc64_fold(x0, k512, load(p));
+        x1 = crc64_fold(x1, k512, load(p + 16));
+        x2 = crc64_fold(x2, k512, load(p + 32));
+        x3 = crc64_fold(x3, k512, load(p + 48));
+    }
+
+    __m128i x = crc64_fold(x0, k128, x1);
+    x = crc64_fold(x, k128, x2);
+    x = crc64_fold(x, k128, x3);
+    for (; size >= 16; size -= 16, p += 16) {
+        x = crc64_fold(x, k128, load(p));
+    }
+
+    // the folded 128 bits have the same crc as everything before them
+    uint8_t folded[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(folded), x);
+    return crc64_update_slice8(p, size, crc64_update_slice8(folded, sizeof(folded), 0));
 }
 
+#elif defined(__aarch64__)
+
+__attribute__((target("+crc"))) uint32_t
+crc32_update_armv8(const uint8_t *p, size_t size, uint32_t crc)
+{
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p) {
+        crc = __crc32cb(crc, *p);
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        crc = __crc32cd(crc, load_u64(p));
+    }
+    for (; size > 0; --size, ++p) {
+        crc = __crc32cb(crc, *p);
+    }
+    return crc;
+}
+
+#endif
+
+typedef uint32_t (*crc32_update_fn)(const uint8_t *, size_t, uint32_t);
+typedef uint64_t (*crc64_update_fn)(const uint8_t *, size_t, uint64_t);
+
+crc32_update_fn select_crc32_update()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) {
+        return crc32_update_sse42;
+    }
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        return crc32_update_armv8;
+    }
+#endif
+    return crc32_update_slice8;
+}
+
+crc64_update_fn select_crc64_update()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        return crc64_update_pclmul;
+    }
+#endif
+    return crc64_update_slice8;
+}
+
+} // anonymous namespace
+} // namespace utils
+} // namespace dsn
+
 namespace dsn {
 namespace utils {
 uint32_t crc32_calc(const void *ptr, size_t size, uint32_t init_crc)
 {
-    return dsn::utils::crc32::compute(ptr, size, init_crc);
+    static const crc32_update_fn update = select_crc32_update();
+    return ~update(static_cast<const uint8_t *>(ptr), size, ~init_crc);
 }
 
+
 uint32_t crc32_concat(uint32_t xy_init,
                       uint32_t x_init,
                       uint32_t x_final,
@@ -437,7 +666,8 @@ uint32_t crc32_concat(uint32_t xy_init,
 
 uint64_t crc64_calc(const void *ptr, size_t size, uint64_t init_crc)
 {
-    return dsn::utils::crc64::compute(ptr, size, init_crc);
+    static const crc64_update_fn update = select_crc64_update();
+    return ~update(static_cast<const uint8_t *>(ptr), size, ~init_crc);
 }
 
 uint64_t crc64_concat(uint32_t xy_init,
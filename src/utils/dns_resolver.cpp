@@ -0,0 +1,185 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <future>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/dns_resolver.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace utils {
+
+DSN_DEFINE_uint32("network",
+                  dns_cache_ttl_seconds,
+                  60,
+                  "how long a resolved host name is cached before it is refreshed in background");
+DSN_DEFINE_uint32("network",
+                  dns_negative_cache_ttl_seconds,
+                  5,
+                  "how long a failed host name resolution is cached before it is retried");
+DSN_DEFINE_uint32("network",
+                  dns_resolve_timeout_ms,
+                  5000,
+                  "how long to wait for a host name never resolved before, 0 if not to wait");
+DSN_DEFINE_uint32("network",
+                  dns_resolver_thread_count,
+                  2,
+                  "the number of threads resolving the host names in background");
+DSN_DEFINE_validator(dns_resolver_thread_count, [](uint32_t value) -> bool { return value > 0; });
+
+static uint64_t steady_now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/*static*/ dns_resolver &dns_resolver::instance()
+{
+    // never destroyed, as the workers may be blocked in a resolution at exit
+    static dns_resolver *resolver = new dns_resolver();
+    return *resolver;
+}
+
+dns_resolver::dns_resolver()
+{
+    for (uint32_t i = 0; i < FLAGS_dns_resolver_thread_count; ++i) {
+        _workers.emplace_back([this]() { worker_loop(); });
+        _workers.back().detach();
+    }
+}
+
+/*static*/ uint32_t dns_resolver::resolve_uncached(const char *host)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *result = nullptr;
+    int err = ::getaddrinfo(host, nullptr, &hints, &result);
+    if (err != 0) {
+        derror("getaddrinfo failed, name = %s, err = %s.", host, gai_strerror(err));
+        return 0;
+    }
+
+    // converts from network byte order to host byte order
+    uint32_t ip = ntohl(reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(result);
+    return ip;
+}
+
+uint32_t dns_resolver::resolve(const std::string &host)
+{
+    auto result = std::make_shared<std::promise<uint32_t>>();
+    std::future<uint32_t> f = result->get_future();
+    resolve_async(host, [result](uint32_t ip) { result->set_value(ip); });
+    if (f.wait_for(std::chrono::milliseconds(FLAGS_dns_resolve_timeout_ms)) !=
+        std::future_status::ready) {
+        derror("resolve %s timeout after %u ms, it's still being resolved in background",
+               host.c_str(),
+               FLAGS_dns_resolve_timeout_ms);
+        return 0;
+    }
+    return f.get();
+}
+
+void dns_resolver::resolve_async(const std::string &host, resolve_callback callback)
+{
+    uint32_t ip = 0;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        cache_entry &entry = _cache[host];
+        if (!entry.resolved) {
+            entry.callbacks.push_back(std::move(callback));
+            schedule(host, entry);
+            return;
+        }
+
+        ip = entry.ip;
+        if (steady_now_ms() >= entry.expire_ms) {
+            schedule(host, entry);
+        }
+    }
+    callback(ip);
+}
+
+void dns_resolver::clear_cache()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    for (auto it = _cache.begin(); it != _cache.end();) {
+        if (it->second.resolving) {
+            ++it;
+        } else {
+            it = _cache.erase(it);
+        }
+    }
+}
+
+void dns_resolver::schedule(const std::string &host, cache_entry &entry)
+{
+    if (!entry.resolving) {
+        entry.resolving = true;
+        _pending_hosts.push_back(host);
+        _cond.notify_one();
+    }
+}
+
+void dns_resolver::worker_loop()
+{
+    while (true) {
+        std::string host;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _cond.wait(l, [this]() { return !_pending_hosts.empty(); });
+            host = std::move(_pending_hosts.front());
+            _pending_hosts.pop_front();
+        }
+
+        uint32_t ip = resolve_uncached(host.c_str());
+
+        std::vector<resolve_callback> callbacks;
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            cache_entry &entry = _cache[host];
+            entry.resolving = false;
+            // keep the last good address if the refresh fails
+            if (ip != 0 || !entry.resolved) {
+                entry.ip = ip;
+            }
+            entry.resolved = true;
+            uint32_t ttl_seconds =
+                ip != 0 ? FLAGS_dns_cache_ttl_seconds : FLAGS_dns_negative_cache_ttl_seconds;
+            entry.expire_ms = steady_now_ms() + ttl_seconds * 1000ULL;
+            ip = entry.ip;
+            callbacks.swap(entry.callbacks);
+        }
+        for (auto &callback : callbacks) {
+            callback(ip);
+        }
+    }
+}
+
+} // namespace utils
+} // namespace dsn
@@ -33,17 +33,28 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
 
 #include <dsn/c/api_utilities.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/safe_strerror_posix.h>
 
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <boost/filesystem.hpp>
 #include <openssl/md5.h>
 
@@ -57,6 +68,12 @@ namespace dsn {
 namespace utils {
 namespace filesystem {
 
+DSN_DEFINE_uint32("core",
+                  filesystem_io_parallelism,
+                  4,
+                  "the default count of threads by which the files are copied or checksummed "
+                  "in parallel, see copy_files and md5sum_files");
+
 #define _FS_COLON ':'
 #define _FS_PERIOD '.'
 #define _FS_SLASH '/'
@@ -701,6 +718,42 @@ bool link_file(const std::string &src, const std::string &target)
     return (err == 0);
 }
 
+namespace {
+
+// the buffer of the sequential reads and writes, which is aligned so as to be usable by O_DIRECT
+constexpr size_t IO_BUFFER_SIZE = 1024 * 1024;
+
+std::unique_ptr<char, decltype(&free)> allocate_io_buffer()
+{
+    void *buf = nullptr;
+    int err = posix_memalign(&buf, 4096, IO_BUFFER_SIZE);
+    dcheck_eq(err, 0);
+    return std::unique_ptr<char, decltype(&free)>(static_cast<char *>(buf), &free);
+}
+
+// Runs fn(0), ..., fn(count - 1) by up to `parallelism` threads including the calling one.
+void run_in_parallel(size_t count, int parallelism, const std::function<void(size_t)> &fn)
+{
+    size_t threads = parallelism > 0 ? parallelism : FLAGS_filesystem_io_parallelism;
+    threads = std::max<size_t>(1, std::min(threads, count));
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : workers) {
+        t.join();
+    }
+}
+
+} // anonymous namespace
+
 error_code md5sum(const std::string &file_path, /*out*/ std::string &result)
 {
     result.clear();
@@ -710,38 +763,35 @@ error_code md5sum(const std::string &file_path, /*out*/ std::string &result)
         return ERR_OBJECT_NOT_FOUND;
     }
 
-    FILE *fp = fopen(file_path.c_str(), "rb");
-    if (fp == nullptr) {
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         derror("md5sum error: open file %s failed", file_path.c_str());
         return ERR_FILE_OPERATION_FAILED;
     }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    char buf[4096];
+    auto buf = allocate_io_buffer();
     unsigned char out[MD5_DIGEST_LENGTH];
     MD5_CTX c;
     MD5_Init(&c);
     while (true) {
-        size_t ret_code = fread(buf, sizeof(char), 4096, fp);
-        if (ret_code == 4096) {
-            MD5_Update(&c, buf, 4096);
-        } else {
-            if (feof(fp)) {
-                if (ret_code > 0)
-                    MD5_Update(&c, buf, ret_code);
-                break;
-            } else {
-                int err = ferror(fp);
-                derror("md5sum error: read file %s failed: errno = %d (%s)",
-                       file_path.c_str(),
-                       err,
-                       safe_strerror(err).c_str());
-                fclose(fp);
-                MD5_Final(out, &c);
-                return ERR_FILE_OPERATION_FAILED;
-            }
+        ssize_t ret_code = ::read(fd, buf.get(), IO_BUFFER_SIZE);
+        if (ret_code > 0) {
+            MD5_Update(&c, buf.get(), ret_code);
+        } else if (ret_code == 0) {
+            break;
+        } else if (errno != EINTR) {
+            int err = errno;
+            derror("md5sum error: read file %s failed: errno = %d (%s)",
+                   file_path.c_str(),
+                   err,
+                   safe_strerror(err).c_str());
+            ::close(fd);
+            MD5_Final(out, &c);
+            return ERR_FILE_OPERATION_FAILED;
         }
     }
-    fclose(fp);
+    ::close(fd);
     MD5_Final(out, &c);
 
     char str[MD5_DIGEST_LENGTH * 2 + 1];
@@ -753,6 +803,195 @@ error_code md5sum(const std::string &file_path, /*out*/ std::string &result)
     return ERR_OK;
 }
 
+error_code md5sum_files(const std::vector<std::string> &file_paths,
+                        /*out*/ std::vector<std::string> &results,
+                        int parallelism)
+{
+    results.clear();
+    results.resize(file_paths.size());
+    std::vector<error_code> errors(file_paths.size(), ERR_OK);
+    run_in_parallel(file_paths.size(), parallelism, [&](size_t i) {
+        errors[i] = md5sum(file_paths[i], results[i]);
+    });
+    for (const auto &err : errors) {
+        if (err != ERR_OK) {
+            return err;
+        }
+    }
+    return ERR_OK;
+}
+
+namespace {
+
+// Copies the rest of `in` to `out` in the kernel, returns false if it's not supported
+// between the two files, in which case nothing is copied.
+bool copy_file_range_all(int in, int out, int64_t size, /*out*/ int &err)
+{
+    err = 0;
+#ifdef __NR_copy_file_range
+    int64_t copied = 0;
+    while (copied < size) {
+        ssize_t n = ::syscall(__NR_copy_file_range, in, nullptr, out, nullptr, size - copied, 0);
+        if (n > 0) {
+            copied += n;
+        } else if (n == 0) {
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (copied == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                                   errno == EOPNOTSUPP || errno == EPERM)) {
+            return false;
+        } else {
+            err = errno;
+            break;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+error_code copy_file_content(const std::string &src, const std::string &dst)
+{
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        derror_f("copy file: open {} failed, err = {}", src, safe_strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        derror_f("copy file: stat {} failed, err = {}", src, safe_strerror(errno));
+        ::close(in);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+    if (out < 0) {
+        derror_f("copy file: create {} failed, err = {}", dst, safe_strerror(errno));
+        ::close(in);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    int err = 0;
+#ifdef FICLONE
+    // shares the extents with the source by reflink, on the filesystems like xfs and btrfs
+    bool done = ::ioctl(out, FICLONE, in) == 0;
+#else
+    bool done = false;
+#endif
+    if (!done) {
+        done = copy_file_range_all(in, out, st.st_size, err);
+    }
+    if (!done) {
+        ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+        auto buf = allocate_io_buffer();
+        while (err == 0) {
+            ssize_t n = ::read(in, buf.get(), IO_BUFFER_SIZE);
+            if (n == 0) {
+                break;
+            }
+            if (n < 0) {
+                if (errno != EINTR) {
+                    err = errno;
+                }
+                continue;
+            }
+            for (ssize_t written = 0; written < n && err == 0;) {
+                ssize_t w = ::write(out, buf.get() + written, n - written);
+                if (w >= 0) {
+                    written += w;
+                } else if (errno != EINTR) {
+                    err = errno;
+                }
+            }
+        }
+    }
+    ::close(in);
+    if (::close(out) != 0 && err == 0) {
+        err = errno;
+    }
+
+    if (err != 0) {
+        derror_f("copy file {} to {} failed, err = {}", src, dst, safe_strerror(err));
+        ::unlink(dst.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return ERR_OK;
+}
+
+} // anonymous namespace
+
+error_code copy_file(const std::string &src, const std::string &dst, bool allow_link)
+{
+    if (allow_link) {
+        if (::link(src.c_str(), dst.c_str()) == 0) {
+            return ERR_OK;
+        }
+        // fall back to copying across the filesystems, or where links are not permitted
+        if (errno != EXDEV && errno != EPERM && errno != EMLINK && errno != ENOTSUP) {
+            derror_f("link {} to {} failed, err = {}", src, dst, safe_strerror(errno));
+            return ERR_FILE_OPERATION_FAILED;
+        }
+    }
+    return copy_file_content(src, dst);
+}
+
+error_code copy_files(const std::string &src_dir,
+                      const std::vector<std::string> &files,
+                      const std::string &dst_dir,
+                      bool allow_link,
+                      int parallelism)
+{
+    // the directories are created ahead, as they may be shared by the files
+    for (const auto &file : files) {
+        std::string dir = remove_file_name(path_combine(dst_dir, file));
+        if (!directory_exists(dir) && !create_directory(dir)) {
+            derror_f("copy files: create directory {} failed", dir);
+            return ERR_FILE_OPERATION_FAILED;
+        }
+    }
+
+    std::vector<error_code> errors(files.size(), ERR_OK);
+    run_in_parallel(files.size(), parallelism, [&](size_t i) {
+        errors[i] =
+            copy_file(path_combine(src_dir, files[i]), path_combine(dst_dir, files[i]), allow_link);
+    });
+    for (const auto &err : errors) {
+        if (err != ERR_OK) {
+            return err;
+        }
+    }
+    return ERR_OK;
+}
+
+error_code copy_directory(const std::string &src_dir,
+                          const std::string &dst_dir,
+                          bool allow_link,
+                          int parallelism)
+{
+    std::vector<std::string> paths;
+    if (!get_subfiles(src_dir, paths, true)) {
+        derror_f("copy directory: list files of {} failed", src_dir);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    if (!directory_exists(dst_dir) && !create_directory(dst_dir)) {
+        derror_f("copy directory: create directory {} failed", dst_dir);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    std::vector<std::string> files;
+    files.reserve(paths.size());
+    for (const auto &path : paths) {
+        dcheck_eq(path.compare(0, src_dir.length(), src_dir), 0);
+        size_t start = src_dir.length();
+        while (start < path.length() && path[start] == '/') {
+            ++start;
+        }
+        files.emplace_back(path.substr(start));
+    }
+    return copy_files(src_dir, files, dst_dir, allow_link, parallelism);
+}
+
 std::pair<error_code, bool> is_directory_empty(const std::string &dirname)
 {
     std::pair<error_code, bool> res;
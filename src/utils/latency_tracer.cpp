@@ -16,26 +16,126 @@
 // under the License.
 
 #include <dsn/utils/latency_tracer.h>
+#include <dsn/utils/slow_request_recorder.h>
 #include <dsn/service_api_c.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
 
 namespace dsn {
 namespace utils {
 
 DSN_DEFINE_bool("replication", enable_latency_tracer, false, "whether enable the latency tracer");
+DSN_DEFINE_double("replication",
+                  trace_sample_ratio,
+                  0,
+                  "the ratio of the rpc requests which start a trace across the nodes, "
+                  "it works only if enable_latency_tracer is true");
+
+namespace {
+
+thread_local trace_context tls_trace_context;
+
+class log_trace_span_exporter : public trace_span_exporter
+{
+public:
+    void export_span(const trace_span &span) override
+    {
+        std::string points;
+        for (const auto &point : span.points) {
+            if (!points.empty()) {
+                points.append(",");
+            }
+            points.append(fmt::format("{{\"ts\":{},\"name\":\"{}\"}}", point.first, point.second));
+        }
+        ddebug_f("TRACE_SPAN:{{\"trace_id\":\"{:016x}\",\"span_id\":\"{:08x}\","
+                 "\"parent_span_id\":\"{:08x}\",\"name\":\"{}\",\"node\":\"{}\","
+                 "\"start_ns\":{},\"end_ns\":{},\"points\":[{}]}}",
+                 span.context.trace_id,
+                 span.context.span_id,
+                 span.context.parent_span_id,
+                 span.name,
+                 span.node,
+                 span.start_ns,
+                 span.end_ns,
+                 points);
+    }
+};
+
+utils::rw_lock_nr s_exporter_lock;
+std::unique_ptr<trace_span_exporter> s_exporter(new log_trace_span_exporter());
+
+} // anonymous namespace
+
+/*static*/ const trace_context &trace_context::current() { return tls_trace_context; }
+
+/*static*/ bool trace_context::should_sample()
+{
+    return FLAGS_enable_latency_tracer && FLAGS_trace_sample_ratio > 0 &&
+           rand::next_double01() < FLAGS_trace_sample_ratio;
+}
+
+/*static*/ uint32_t trace_context::new_span_id() { return rand::next_u32(1, UINT32_MAX); }
+
+trace_context_scope::trace_context_scope(const trace_context &context) : _saved(tls_trace_context)
+{
+    tls_trace_context = context;
+}
+
+trace_context_scope::~trace_context_scope() { tls_trace_context = _saved; }
+
+void set_trace_span_exporter(std::unique_ptr<trace_span_exporter> exporter)
+{
+    if (exporter == nullptr) {
+        exporter.reset(new log_trace_span_exporter());
+    }
+    utils::auto_write_lock l(s_exporter_lock);
+    s_exporter = std::move(exporter);
+}
+
+void export_trace_span(const trace_span &span)
+{
+    utils::auto_read_lock l(s_exporter_lock);
+    s_exporter->export_span(span);
+}
 
 latency_tracer::latency_tracer(const std::string &name, bool is_sub, uint64_t threshold)
-    : _name(name), _threshold(threshold), _is_sub(is_sub), _start_time(dsn_now_ns())
+    : _name(name),
+      _category(name.substr(0, name.find('['))),
+      _threshold(threshold),
+      _is_sub(is_sub),
+      _start_time(dsn_now_ns())
 {
+    const trace_context &parent = trace_context::current();
+    if (FLAGS_enable_latency_tracer && parent.sampled) {
+        _context.trace_id = parent.trace_id;
+        _context.span_id = trace_context::new_span_id();
+        _context.parent_span_id = parent.span_id;
+        _context.sampled = true;
+    }
 }
 
 latency_tracer::~latency_tracer()
 {
+    if (_context.sampled) {
+        trace_span span;
+        span.context = _context;
+        span.name = _name;
+        span.start_ns = _start_time;
+        span.end_ns = dsn_now_ns();
+        {
+            utils::auto_read_lock read(_lock);
+            span.points.assign(_points.begin(), _points.end());
+        }
+        export_trace_span(span);
+    }
+
     if (_is_sub) {
         return;
     }
 
+    record_slow_request();
+
     std::string traces;
     dump_trace_points(traces);
 }
@@ -60,6 +160,46 @@ void latency_tracer::set_sub_tracer(const std::shared_ptr<latency_tracer> &trace
     _sub_tracer = tracer;
 }
 
+void latency_tracer::set_category(const std::string &category)
+{
+    utils::auto_write_lock write(_lock);
+    _category = category;
+}
+
+void latency_tracer::record_slow_request()
+{
+    if (!FLAGS_enable_latency_tracer) {
+        return;
+    }
+
+    uint64_t end_ns;
+    std::string category;
+    {
+        utils::auto_read_lock read(_lock);
+        if (_points.empty()) {
+            return;
+        }
+        end_ns = _points.rbegin()->first;
+        category = _category;
+    }
+
+    slow_request_recorder::instance().try_record(
+        category, end_ns, end_ns - _start_time, [this](slow_request &request) {
+            request.name = _name;
+            request.start_ns = _start_time;
+            // the spans are counted from the start of each tracer, like dump_trace_points
+            for (latency_tracer *tracer = this; tracer != nullptr;
+                 tracer = tracer->_sub_tracer.get()) {
+                utils::auto_read_lock read(tracer->_lock);
+                uint64_t previous_time = tracer->_start_time;
+                for (const auto &point : tracer->_points) {
+                    request.stages.emplace_back(point.first - previous_time, point.second);
+                    previous_time = point.first;
+                }
+            }
+        });
+}
+
 void latency_tracer::dump_trace_points(/*out*/ std::string &traces)
 {
     if (!FLAGS_enable_latency_tracer || _threshold < 0 || _points.empty()) {
@@ -74,7 +214,15 @@ void latency_tracer::dump_trace_points(/*out*/ std::string &traces)
         return;
     }
 
-    traces.append(fmt::format("\t***************[TRACE:{}]***************\n", _name));
+    if (_context.sampled) {
+        traces.append(fmt::format("\t***************[TRACE:{}, trace_id={:016x}, span_id={:08x}]"
+                                  "***************\n",
+                                  _name,
+                                  _context.trace_id,
+                                  _context.span_id));
+    } else {
+        traces.append(fmt::format("\t***************[TRACE:{}]***************\n", _name));
+    }
     uint64_t previous_time = _start_time;
     for (const auto &point : _points) {
         std::string trace = fmt::format("\tTRACE:name={:<70}, span={:>20}, total={:>20}, "
@@ -0,0 +1,222 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/lock_contention_profiler.h>
+#include <dsn/utility/synchronize.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <fmt/format.h>
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+// the slots are never freed, so the size bounds the distinct call sites that can be tracked
+const int kMaxSiteCount = 4096;
+const int kMaxProbeCount = 64;
+
+struct site_slot
+{
+    std::atomic<const void *> site{nullptr};
+    std::atomic<uint64_t> contended_count{0};
+    std::atomic<uint64_t> total_wait_ns{0};
+    std::atomic<uint64_t> max_wait_ns{0};
+    std::atomic<uint64_t> sampled_hold_count{0};
+    std::atomic<uint64_t> total_sampled_hold_ns{0};
+    std::atomic<uint64_t> max_hold_ns{0};
+};
+
+site_slot s_slots[kMaxSiteCount];
+std::atomic<uint64_t> s_dropped_count{0};
+std::atomic<uint32_t> s_hold_sample_interval{100};
+
+void update_max(std::atomic<uint64_t> &max, uint64_t value)
+{
+    uint64_t old = max.load(std::memory_order_relaxed);
+    while (value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+    }
+}
+
+// open addressing without deletion, so a lookup never needs a lock
+site_slot *find_slot(const void *site)
+{
+    uint64_t h = reinterpret_cast<uintptr_t>(site) * 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < kMaxProbeCount; ++i) {
+        site_slot &slot = s_slots[(h + i) % kMaxSiteCount];
+        const void *current = slot.site.load(std::memory_order_acquire);
+        if (current == site) {
+            return &slot;
+        }
+        if (current == nullptr) {
+            if (slot.site.compare_exchange_strong(current, site, std::memory_order_acq_rel) ||
+                current == site) {
+                return &slot;
+            }
+        }
+    }
+    s_dropped_count.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+std::string symbolize(const void *site)
+{
+    Dl_info info;
+    if (dladdr(site, &info) == 0 || info.dli_sname == nullptr) {
+        return fmt::format("{}", site);
+    }
+
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = (status == 0 && demangled != nullptr) ? demangled : info.dli_sname;
+    free(demangled);
+    return fmt::format("{}+{:#x}",
+                       name,
+                       reinterpret_cast<uintptr_t>(site) -
+                           reinterpret_cast<uintptr_t>(info.dli_saddr));
+}
+
+} // anonymous namespace
+
+std::atomic<bool> lock_contention_profiler::s_enabled{false};
+
+/*static*/ void lock_contention_profiler::start(uint32_t hold_sample_interval)
+{
+    // the records of the acquisitions in flight may be mixed into the new round, which
+    // is acceptable for statistics
+    for (auto &slot : s_slots) {
+        slot.contended_count.store(0, std::memory_order_relaxed);
+        slot.total_wait_ns.store(0, std::memory_order_relaxed);
+        slot.max_wait_ns.store(0, std::memory_order_relaxed);
+        slot.sampled_hold_count.store(0, std::memory_order_relaxed);
+        slot.total_sampled_hold_ns.store(0, std::memory_order_relaxed);
+        slot.max_hold_ns.store(0, std::memory_order_relaxed);
+    }
+    s_dropped_count.store(0, std::memory_order_relaxed);
+    s_hold_sample_interval.store(std::max(hold_sample_interval, 1u), std::memory_order_relaxed);
+    s_enabled.store(true, std::memory_order_release);
+}
+
+/*static*/ void lock_contention_profiler::stop()
+{
+    s_enabled.store(false, std::memory_order_release);
+}
+
+/*static*/ std::vector<lock_contention_profiler::site_stats>
+lock_contention_profiler::top_sites(int count)
+{
+    std::vector<site_stats> result;
+    for (auto &slot : s_slots) {
+        const void *site = slot.site.load(std::memory_order_acquire);
+        if (site == nullptr) {
+            continue;
+        }
+        site_stats stats;
+        stats.site = site;
+        stats.contended_count = slot.contended_count.load(std::memory_order_relaxed);
+        stats.total_wait_ns = slot.total_wait_ns.load(std::memory_order_relaxed);
+        stats.max_wait_ns = slot.max_wait_ns.load(std::memory_order_relaxed);
+        stats.sampled_hold_count = slot.sampled_hold_count.load(std::memory_order_relaxed);
+        stats.total_sampled_hold_ns = slot.total_sampled_hold_ns.load(std::memory_order_relaxed);
+        stats.max_hold_ns = slot.max_hold_ns.load(std::memory_order_relaxed);
+        if (stats.contended_count == 0 && stats.sampled_hold_count == 0) {
+            continue;
+        }
+        result.emplace_back(std::move(stats));
+    }
+
+    std::sort(result.begin(), result.end(), [](const site_stats &l, const site_stats &r) {
+        if (l.total_wait_ns != r.total_wait_ns) {
+            return l.total_wait_ns > r.total_wait_ns;
+        }
+        return l.total_sampled_hold_ns > r.total_sampled_hold_ns;
+    });
+    if (count >= 0 && result.size() > static_cast<size_t>(count)) {
+        result.resize(count);
+    }
+
+    // symbolization is slow, so only do it for the returned sites
+    for (auto &stats : result) {
+        stats.symbol = symbolize(stats.site);
+    }
+    return result;
+}
+
+/*static*/ uint64_t lock_contention_profiler::dropped_count()
+{
+    return s_dropped_count.load(std::memory_order_relaxed);
+}
+
+/*static*/ bool lock_contention_profiler::should_sample_hold()
+{
+    static thread_local uint32_t acquire_count = 0;
+    return ++acquire_count % s_hold_sample_interval.load(std::memory_order_relaxed) == 0;
+}
+
+/*static*/ void lock_contention_profiler::record_wait(const void *site, uint64_t wait_ns)
+{
+    site_slot *slot = find_slot(site);
+    if (slot != nullptr) {
+        slot->contended_count.fetch_add(1, std::memory_order_relaxed);
+        slot->total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        update_max(slot->max_wait_ns, wait_ns);
+    }
+}
+
+/*static*/ void lock_contention_profiler::record_hold(const void *site, uint64_t hold_ns)
+{
+    site_slot *slot = find_slot(site);
+    if (slot != nullptr) {
+        slot->sampled_hold_count.fetch_add(1, std::memory_order_relaxed);
+        slot->total_sampled_hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+        update_max(slot->max_hold_ns, hold_ns);
+    }
+}
+
+/*static*/ uint64_t lock_contention_profiler::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void ex_lock_nr_spin::lock_tracked()
+{
+    const void *site = __builtin_return_address(0);
+    if (!try_lock()) {
+        uint64_t start = lock_contention_profiler::now_ns();
+        lock_untracked();
+        lock_contention_profiler::record_wait(site, lock_contention_profiler::now_ns() - start);
+    }
+    if (lock_contention_profiler::should_sample_hold()) {
+        _hold_site = site;
+        _hold_start_ns = lock_contention_profiler::now_ns();
+    }
+}
+
+void ex_lock_nr_spin::unlock_tracked()
+{
+    lock_contention_profiler::record_hold(_hold_site,
+                                          lock_contention_profiler::now_ns() - _hold_start_ns);
+    _hold_site = nullptr;
+}
+
+} // namespace utils
+} // namespace dsn
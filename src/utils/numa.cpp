@@ -0,0 +1,130 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <thread>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/numa.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+namespace dsn {
+namespace utils {
+namespace numa {
+
+// from <numaif.h>, so that libnuma is not required
+static const int MPOL_PREFERRED = 1;
+
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::vector<std::string> ranges;
+    split_args(list.c_str(), ranges, ',');
+    for (const std::string &range : ranges) {
+        std::vector<std::string> bounds;
+        split_args(range.c_str(), bounds, '-');
+        int first = 0, last = 0;
+        if (bounds.empty() || bounds.size() > 2 || !buf2int32(bounds[0], first)) {
+            return {};
+        }
+        last = first;
+        if (bounds.size() == 2 && !buf2int32(bounds[1], last)) {
+            return {};
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static std::vector<std::vector<int>> load_node_cpus()
+{
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            break;
+        }
+        nodes.push_back(parse_cpu_list(list));
+    }
+
+    if (nodes.empty()) {
+        std::vector<int> cpus;
+        for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        nodes.push_back(std::move(cpus));
+    }
+    return nodes;
+}
+
+const std::vector<std::vector<int>> &node_cpus()
+{
+    static const std::vector<std::vector<int>> nodes = load_node_cpus();
+    return nodes;
+}
+
+int current_node()
+{
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return 0;
+    }
+    return static_cast<int>(node);
+}
+
+bool bind_current_thread(int node)
+{
+    const auto &nodes = node_cpus();
+    if (node < 0 || node >= static_cast<int>(nodes.size()) || nodes[node].empty()) {
+        derror("invalid numa node %d, there are %d nodes", node, node_count());
+        return false;
+    }
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : nodes[node]) {
+        CPU_SET(cpu, &cpuset);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+        dwarn("fail to bind thread to numa node %d, err = %d", node, err);
+        return false;
+    }
+
+    // the memory policy is advisory, it fails if the kernel has no numa support
+    if (nodes.size() > 1 && node < 64) {
+        unsigned long mask = 1UL << node;
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) != 0) {
+            dwarn("fail to prefer the memory of numa node %d, errno = %d", node, errno);
+        }
+    }
+    return true;
+}
+
+} // namespace numa
+} // namespace utils
+} // namespace dsn
@@ -184,5 +184,58 @@ void multi_table_printer::output_in_tabular(std::ostream &out) const
     }
 }
 
+json_table_writer::json_table_writer(std::string &out, int precision)
+    : _stream{out},
+      _writer(_stream),
+      _formatter("", 2, precision),
+      _table_started(false),
+      _in_row(false),
+      _column(0)
+{
+    _writer.StartObject();
+}
+
+void json_table_writer::start_table(const std::string &name, std::vector<std::string> columns)
+{
+    dassert(!_table_started && _columns.empty(), "the last table is not ended");
+    _table_name = name;
+    _columns = std::move(columns);
+    if (!_columns.empty()) {
+        start_table_object();
+    }
+}
+
+void json_table_writer::start_table_object()
+{
+    if (_table_started) {
+        return;
+    }
+    _table_started = true;
+    if (!_table_name.empty()) {
+        json::json_encode(_writer, _table_name);
+        _writer.StartObject();
+    }
+}
+
+void json_table_writer::end_table()
+{
+    if (_in_row) {
+        _writer.EndObject();
+        _in_row = false;
+    }
+    if (_table_started && !_table_name.empty()) {
+        _writer.EndObject();
+    }
+    _table_started = false;
+    _columns.clear();
+}
+
+void json_table_writer::finish()
+{
+    end_table();
+    _writer.EndObject();
+    _stream.out.push_back('\n');
+}
+
 } // namespace utils
 } // namespace dsn
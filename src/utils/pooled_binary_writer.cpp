@@ -0,0 +1,128 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <vector>
+
+#include <dsn/utility/flags.h>
+#include <dsn/utility/pooled_binary_writer.h>
+#include <dsn/utility/utils.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("core",
+                  binary_writer_pool_chunks_per_class,
+                  64,
+                  "the max count of the chunks of each size class cached by each thread for the "
+                  "pooled binary writers and rpc messages, 0 disables the cache");
+
+namespace {
+
+constexpr int SIZE_CLASS_COUNT = 9; // 256B, 512B, ..., 64KB
+
+static_assert((binary_writer_chunk_pool::MIN_CHUNK_SIZE << (SIZE_CLASS_COUNT - 1)) ==
+                  binary_writer_chunk_pool::MAX_CHUNK_SIZE,
+              "the size classes must cover MIN_CHUNK_SIZE to MAX_CHUNK_SIZE");
+
+int size_class_of(size_t size)
+{
+    int cls = 0;
+    for (size_t cap = binary_writer_chunk_pool::MIN_CHUNK_SIZE; cap < size; cap <<= 1) {
+        ++cls;
+    }
+    return cls;
+}
+
+// the blobs may be released while the thread is exiting, after its cache is destroyed
+thread_local bool t_cache_destroyed = false;
+
+struct chunk_cache
+{
+    std::vector<char *> free_chunks[SIZE_CLASS_COUNT];
+
+    ~chunk_cache()
+    {
+        t_cache_destroyed = true;
+        for (auto &chunks : free_chunks) {
+            for (char *chunk : chunks) {
+                delete[] chunk;
+            }
+        }
+    }
+};
+
+chunk_cache *local_cache()
+{
+    if (t_cache_destroyed) {
+        return nullptr;
+    }
+    static thread_local chunk_cache cache;
+    return &cache;
+}
+
+struct chunk_deleter
+{
+    int cls;
+
+    void operator()(char *chunk) const
+    {
+        chunk_cache *cache = local_cache();
+        if (cache != nullptr &&
+            cache->free_chunks[cls].size() < FLAGS_binary_writer_pool_chunks_per_class) {
+            cache->free_chunks[cls].push_back(chunk);
+        } else {
+            delete[] chunk;
+        }
+    }
+};
+
+} // anonymous namespace
+
+/*static*/ blob binary_writer_chunk_pool::allocate(size_t size)
+{
+    if (size > MAX_CHUNK_SIZE) {
+        return blob(utils::make_shared_array<char>(size), static_cast<unsigned int>(size));
+    }
+
+    int cls = size_class_of(size);
+    char *chunk = nullptr;
+    chunk_cache *cache = local_cache();
+    if (cache != nullptr && !cache->free_chunks[cls].empty()) {
+        chunk = cache->free_chunks[cls].back();
+        cache->free_chunks[cls].pop_back();
+    }
+    size_t capacity = MIN_CHUNK_SIZE << cls;
+    if (chunk == nullptr) {
+        chunk = new char[capacity];
+    }
+    std::shared_ptr<char> buffer(chunk, chunk_deleter{cls});
+    return blob(std::move(buffer), static_cast<unsigned int>(capacity));
+}
+
+/*static*/ size_t binary_writer_chunk_pool::cached_chunk_count()
+{
+    chunk_cache *cache = local_cache();
+    if (cache == nullptr) {
+        return 0;
+    }
+    size_t count = 0;
+    for (const auto &chunks : cache->free_chunks) {
+        count += chunks.size();
+    }
+    return count;
+}
+
+} // namespace dsn
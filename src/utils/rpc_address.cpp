@@ -33,6 +33,7 @@
 #include <dsn/utility/ports.h>
 #include <dsn/utility/string_view.h>
 #include <dsn/utility/fixed_size_buffer_pool.h>
+#include <dsn/utility/dns_resolver.h>
 
 #include <dsn/c/api_utilities.h>
 
@@ -46,24 +47,14 @@ const rpc_address rpc_address::s_invalid_address;
 /*static*/
 uint32_t rpc_address::ipv4_from_host(const char *name)
 {
-    sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-
-    addr.sin_family = AF_INET;
-    if ((addr.sin_addr.s_addr = inet_addr(name)) == (unsigned int)(-1)) {
-        hostent *hp = ::gethostbyname(name);
-        int err = h_errno;
-
-        if (hp == nullptr) {
-            derror("gethostbyname failed, name = %s, err = %d.", name, err);
-            return 0;
-        } else {
-            memcpy((void *)&(addr.sin_addr.s_addr), (const void *)hp->h_addr, (size_t)hp->h_length);
-        }
+    in_addr addr;
+    if (inet_pton(AF_INET, name, &addr) == 1) {
+        // converts from network byte order to host byte order
+        return (uint32_t)ntohl(addr.s_addr);
     }
 
-    // converts from network byte order to host byte order
-    return (uint32_t)ntohl(addr.sin_addr.s_addr);
+    // the host names are resolved by the cache, to avoid blocking on the dns servers
+    return utils::dns_resolver::instance().resolve(name);
 }
 
 /*static*/
@@ -0,0 +1,231 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/slab_allocator.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+// 16, 32, ..., 128 by the step of 16, then 256, 512 and 1024
+constexpr int CLASS_COUNT = 11;
+constexpr size_t SLAB_SIZE = 64 * 1024;
+
+int class_of(size_t size)
+{
+    if (size <= 128) {
+        return size == 0 ? 0 : static_cast<int>((size + 15) / 16 - 1);
+    }
+    return size <= 256 ? 8 : (size <= 512 ? 9 : 10);
+}
+
+size_t object_size_of(int cls) { return cls < 8 ? (cls + 1) * 16 : (size_t)256 << (cls - 8); }
+
+// the objects moved between a thread cache and the depot at a time
+size_t batch_size_of(int cls) { return std::max<size_t>(8, 4096 / object_size_of(cls)); }
+
+struct free_object
+{
+    free_object *next;
+};
+
+struct object_list
+{
+    free_object *head{nullptr};
+    size_t count{0};
+
+    void push(void *p)
+    {
+        auto obj = static_cast<free_object *>(p);
+        obj->next = head;
+        head = obj;
+        ++count;
+    }
+
+    void *pop()
+    {
+        free_object *obj = head;
+        head = obj->next;
+        --count;
+        return obj;
+    }
+
+    // keeps the first (most recently freed) `n` objects, and moves the others out
+    object_list split(size_t n)
+    {
+        free_object *last = head;
+        for (size_t i = 1; i < n; ++i) {
+            last = last->next;
+        }
+        object_list rest;
+        rest.head = last->next;
+        rest.count = count - n;
+        last->next = nullptr;
+        count = n;
+        return rest;
+    }
+};
+
+struct depot
+{
+    ex_lock_nr_spin lock;
+    std::vector<object_list> batches;
+    uint64_t objects{0};
+    std::atomic<uint64_t> slab_bytes{0};
+    std::atomic<uint64_t> refills{0};
+
+    void push(const object_list &batch)
+    {
+        if (batch.count == 0) {
+            return;
+        }
+        std::lock_guard<ex_lock_nr_spin> l(lock);
+        batches.push_back(batch);
+        objects += batch.count;
+    }
+
+    // takes a batch, or carves a new slab into the batches if there is none
+    object_list pop(int cls)
+    {
+        refills.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<ex_lock_nr_spin> l(lock);
+            if (!batches.empty()) {
+                object_list batch = batches.back();
+                batches.pop_back();
+                objects -= batch.count;
+                return batch;
+            }
+        }
+
+        size_t object_size = object_size_of(cls);
+        size_t batch_size = batch_size_of(cls);
+        char *slab = static_cast<char *>(aligned_alloc(16, SLAB_SIZE));
+        dassert(slab != nullptr, "allocate slab failed");
+        slab_bytes.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+        object_list batch;
+        for (size_t offset = SLAB_SIZE / object_size * object_size; offset > 0;) {
+            offset -= object_size;
+            batch.push(slab + offset);
+            if (batch.count == batch_size && offset > 0) {
+                push(batch);
+                batch = object_list();
+            }
+        }
+        return batch;
+    }
+};
+
+depot s_depots[CLASS_COUNT];
+
+// the objects may be freed while the thread is exiting, after its cache is destroyed
+thread_local bool t_cache_destroyed = false;
+
+struct thread_cache
+{
+    object_list lists[CLASS_COUNT];
+
+    ~thread_cache()
+    {
+        t_cache_destroyed = true;
+        for (int cls = 0; cls < CLASS_COUNT; ++cls) {
+            s_depots[cls].push(lists[cls]);
+        }
+    }
+};
+
+thread_cache *local_cache()
+{
+    if (t_cache_destroyed) {
+        return nullptr;
+    }
+    static thread_local thread_cache cache;
+    return &cache;
+}
+
+} // anonymous namespace
+
+/*static*/ void *slab_allocator::allocate(size_t size)
+{
+    dassert(size <= MAX_SIZE, "size %zu is larger than %zu", size, MAX_SIZE);
+    int cls = class_of(size);
+    thread_cache *cache = local_cache();
+    if (dsn_unlikely(cache == nullptr)) {
+        object_list batch = s_depots[cls].pop(cls);
+        void *p = batch.pop();
+        s_depots[cls].push(batch);
+        return p;
+    }
+
+    object_list &list = cache->lists[cls];
+    if (dsn_unlikely(list.head == nullptr)) {
+        list = s_depots[cls].pop(cls);
+    }
+    return list.pop();
+}
+
+/*static*/ void slab_allocator::deallocate(void *p, size_t size)
+{
+    if (p == nullptr) {
+        return;
+    }
+    int cls = class_of(size);
+    thread_cache *cache = local_cache();
+    if (dsn_unlikely(cache == nullptr)) {
+        object_list single;
+        single.push(p);
+        s_depots[cls].push(single);
+        return;
+    }
+
+    object_list &list = cache->lists[cls];
+    list.push(p);
+    // keep a batch in the cache, and give the surplus back
+    size_t batch_size = batch_size_of(cls);
+    if (dsn_unlikely(list.count >= 2 * batch_size)) {
+        s_depots[cls].push(list.split(batch_size));
+    }
+}
+
+/*static*/ std::vector<slab_allocator::class_stats> slab_allocator::stats()
+{
+    std::vector<class_stats> result;
+    for (int cls = 0; cls < CLASS_COUNT; ++cls) {
+        depot &d = s_depots[cls];
+        class_stats s;
+        s.object_size = object_size_of(cls);
+        s.slab_bytes = d.slab_bytes.load(std::memory_order_relaxed);
+        s.thread_refills = d.refills.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<ex_lock_nr_spin> l(d.lock);
+            s.depot_objects = d.objects;
+        }
+        result.push_back(s);
+    }
+    return result;
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,183 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utils/slow_request_recorder.h>
+
+#include <algorithm>
+
+#include <dsn/dist/fmt_logging.h>
+
+namespace dsn {
+namespace utils {
+
+DSN_DEFINE_uint32("replication",
+                  slow_request_recorder_size,
+                  10,
+                  "how many slowest requests of each category are kept in a window by the slow "
+                  "request recorder, 0 to disable it, it works only if enable_latency_tracer is "
+                  "true");
+DSN_TAG_VARIABLE(slow_request_recorder_size, FT_MUTABLE);
+
+DSN_DEFINE_uint32("replication",
+                  slow_request_window_seconds,
+                  300,
+                  "the length of the windows in which the slowest requests are kept");
+DSN_TAG_VARIABLE(slow_request_window_seconds, FT_MUTABLE);
+DSN_DEFINE_validator(slow_request_window_seconds, [](uint32_t value) -> bool { return value > 0; });
+
+slow_request_recorder::slow_request_recorder()
+    : _slots(new category_slot[kMaxCategories]), _dropped_count(0)
+{
+}
+
+slow_request_recorder::category_slot *
+slow_request_recorder::find_or_add_slot(const std::string &category)
+{
+    // 0 is reserved for the unused slots
+    uint64_t hash = std::hash<std::string>()(category) | 1;
+    for (int i = 0; i < kMaxCategories; ++i) {
+        category_slot &slot = _slots[(hash + i) % kMaxCategories];
+        uint64_t current = slot.hash.load(std::memory_order_acquire);
+        if (current == 0 && slot.hash.compare_exchange_strong(current, hash)) {
+            return &slot;
+        }
+        if (current == hash) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool slow_request_recorder::try_record(const std::string &category,
+                                       uint64_t end_ns,
+                                       uint64_t latency_ns,
+                                       const std::function<void(slow_request &)> &fill)
+{
+    uint32_t size = FLAGS_slow_request_recorder_size;
+    if (size == 0) {
+        return false;
+    }
+
+    category_slot *slot = find_or_add_slot(category);
+    if (slot == nullptr) {
+        if (_dropped_count.fetch_add(1, std::memory_order_relaxed) % 10000 == 0) {
+            dwarn_f("the slow requests of category {} are not recorded for there are already {} "
+                    "categories",
+                    category,
+                    kMaxCategories);
+        }
+        return false;
+    }
+
+    // the fast path of most requests
+    if (end_ns < slot->window_end_ns.load(std::memory_order_relaxed) &&
+        latency_ns <= slot->threshold_ns.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    slow_request request;
+    request.latency_ns = latency_ns;
+    fill(request);
+
+    std::lock_guard<std::mutex> l(slot->lock);
+    if (slot->category.empty()) {
+        slot->category = category;
+    }
+
+    uint64_t window_ns = FLAGS_slow_request_window_seconds * 1000000000ULL;
+    uint64_t window_end_ns = slot->window_end_ns.load(std::memory_order_relaxed);
+    if (end_ns >= window_end_ns) {
+        // the windows are aligned to the multiples of window_ns, and the previous one is empty
+        // if no request is recorded in it
+        if (window_end_ns != 0 && end_ns < window_end_ns + window_ns) {
+            slot->previous_start_ns = slot->current_start_ns;
+            slot->previous = std::move(slot->current);
+        } else {
+            slot->previous_start_ns = 0;
+            slot->previous.clear();
+        }
+        slot->current.clear();
+        slot->current_start_ns = end_ns / window_ns * window_ns;
+        slot->window_end_ns.store(slot->current_start_ns + window_ns, std::memory_order_relaxed);
+        slot->threshold_ns.store(0, std::memory_order_relaxed);
+    }
+
+    std::vector<slow_request> &current = slot->current;
+    if (current.size() >= size && latency_ns <= current.back().latency_ns) {
+        return false;
+    }
+    auto it = std::upper_bound(
+        current.begin(),
+        current.end(),
+        latency_ns,
+        [](uint64_t latency, const slow_request &r) { return latency > r.latency_ns; });
+    current.insert(it, std::move(request));
+    if (current.size() > size) {
+        current.resize(size);
+    }
+    if (current.size() >= size) {
+        slot->threshold_ns.store(current.back().latency_ns, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+std::vector<slow_request_window>
+slow_request_recorder::get_windows(const std::string &category) const
+{
+    std::vector<slow_request_window> windows;
+    for (int i = 0; i < kMaxCategories; ++i) {
+        const category_slot &slot = _slots[i];
+        if (slot.hash.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> l(slot.lock);
+        if (slot.category.empty() || (!category.empty() && slot.category != category)) {
+            continue;
+        }
+        if (!slot.previous.empty()) {
+            windows.emplace_back();
+            windows.back().category = slot.category;
+            windows.back().window_start_ms = slot.previous_start_ns / 1000000;
+            windows.back().requests = slot.previous;
+        }
+        windows.emplace_back();
+        windows.back().category = slot.category;
+        windows.back().window_start_ms = slot.current_start_ns / 1000000;
+        windows.back().requests = slot.current;
+    }
+    return windows;
+}
+
+void slow_request_recorder::clear()
+{
+    for (int i = 0; i < kMaxCategories; ++i) {
+        category_slot &slot = _slots[i];
+        std::lock_guard<std::mutex> l(slot.lock);
+        slot.hash.store(0);
+        slot.window_end_ns.store(0);
+        slot.threshold_ns.store(0);
+        slot.category.clear();
+        slot.current_start_ns = 0;
+        slot.current.clear();
+        slot.previous_start_ns = 0;
+        slot.previous.clear();
+    }
+}
+
+} // namespace utils
+} // namespace dsn
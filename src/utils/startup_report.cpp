@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/startup_report.h>
+
+#include <algorithm>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/process_utils.h>
+#include <dsn/utils/time_utils.h>
+#include <fmt/format.h>
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+uint64_t now_ms() { return get_current_physical_time_ns() / 1000000; }
+
+} // anonymous namespace
+
+void startup_report::add_phase(std::string name, uint64_t start_ms, uint64_t duration_ms)
+{
+    uint64_t process_start_ms = process_start_millis();
+    phase p;
+    p.name = std::move(name);
+    p.start_offset_ms = start_ms > process_start_ms ? start_ms - process_start_ms : 0;
+    p.duration_ms = duration_ms;
+
+    std::lock_guard<std::mutex> l(_lock);
+    _phases.emplace_back(std::move(p));
+}
+
+void startup_report::complete()
+{
+    uint64_t process_start_ms = process_start_millis();
+    uint64_t now = now_ms();
+
+    std::string phases_str;
+    uint64_t total_ms = 0;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_total_ms != 0) {
+            return;
+        }
+        // never 0 once completed
+        _total_ms = std::max<uint64_t>(now > process_start_ms ? now - process_start_ms : 0, 1);
+        total_ms = _total_ms;
+        for (const auto &p : _phases) {
+            phases_str += fmt::format(
+                "{}{}={}ms", phases_str.empty() ? "" : ", ", p.name, p.duration_ms);
+        }
+    }
+    ddebug_f("process started in {} ms, phases: [{}]", total_ms, phases_str);
+}
+
+std::vector<startup_report::phase> startup_report::phases() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _phases;
+}
+
+uint64_t startup_report::total_ms() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _total_ms;
+}
+
+void startup_report::get_report(table_printer &tp) const
+{
+    std::vector<phase> all_phases;
+    uint64_t total = 0;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        all_phases = _phases;
+        total = _total_ms;
+    }
+
+    tp.add_title("phase");
+    tp.add_column("start_offset_ms", table_printer::alignment::kRight);
+    tp.add_column("duration_ms", table_printer::alignment::kRight);
+    for (const auto &p : all_phases) {
+        tp.add_row(p.name);
+        tp.append_data(p.start_offset_ms);
+        tp.append_data(p.duration_ms);
+    }
+    // the total row is there only after the start completes
+    if (total != 0) {
+        tp.add_row("total");
+        tp.append_data(0);
+        tp.append_data(total);
+    }
+}
+
+startup_phase_timer::startup_phase_timer(std::string name)
+    : _name(std::move(name)), _start_ms(now_ms())
+{
+}
+
+startup_phase_timer::~startup_phase_timer()
+{
+    uint64_t end_ms = now_ms();
+    startup_report::instance().add_phase(
+        std::move(_name), _start_ms, end_ms > _start_ms ? end_ms - _start_ms : 0);
+}
+
+} // namespace utils
+} // namespace dsn
@@ -168,20 +168,25 @@ char *trim_string(char *s)
 }
 
 std::string string_md5(const char *buffer, unsigned length)
+{
+    md5_calculator md5;
+    md5.update(buffer, length);
+    return md5.digest();
+}
+
+md5_calculator::md5_calculator() : _ctx(new MD5_CTX()) { MD5_Init(_ctx.get()); }
+
+md5_calculator::~md5_calculator() = default;
+
+void md5_calculator::update(const char *buffer, size_t length)
+{
+    MD5_Update(_ctx.get(), buffer, length);
+}
+
+std::string md5_calculator::digest()
 {
     unsigned char out[MD5_DIGEST_LENGTH];
-    MD5_CTX c;
-    MD5_Init(&c);
-
-    int offset = 0;
-    while (offset < length) {
-        int block = length - offset;
-        if (block > 4096)
-            block = 4096;
-        MD5_Update(&c, buffer, block);
-        offset += block;
-    }
-    MD5_Final(out, &c);
+    MD5_Final(out, _ctx.get());
 
     char str[MD5_DIGEST_LENGTH * 2 + 1];
     str[MD5_DIGEST_LENGTH * 2] = 0;
@@ -0,0 +1,57 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <dsn/utility/blob.h>
+
+namespace dsn {
+
+TEST(blob, create_from_bytes)
+{
+    std::string value(1000, 'a');
+    blob copied = blob::create_from_bytes(value.data(), value.size());
+    ASSERT_EQ(value, copied.to_string());
+    ASSERT_EQ(copied.data(), copied.buffer_ptr());
+
+    const char *data = value.data();
+    blob moved = blob::create_from_bytes(std::move(value));
+    ASSERT_EQ(std::string(1000, 'a'), moved.to_string());
+    // the bytes of the string are not copied
+    ASSERT_EQ(data, moved.data());
+
+    ASSERT_EQ("", blob::create_from_bytes("", 0).to_string());
+    ASSERT_EQ("hi", blob::create_from_bytes(std::string("hi")).to_string());
+}
+
+TEST(blob, shared_buffer)
+{
+    for (size_t size : {0, 1, 15, 16, 4096}) {
+        std::shared_ptr<char> buffer = utils::make_shared_buffer(size);
+        ASSERT_NE(nullptr, buffer.get());
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(buffer.get()) % alignof(std::max_align_t));
+        memset(buffer.get(), 'x', size);
+
+        blob bb(buffer, static_cast<unsigned int>(size));
+        ASSERT_EQ(2, buffer.use_count());
+        buffer.reset();
+        ASSERT_EQ(std::string(size, 'x'), bb.to_string());
+    }
+}
+
+} // namespace dsn
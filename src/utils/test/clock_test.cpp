@@ -0,0 +1,56 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/clock.h>
+
+#include <cstdlib>
+#include <thread>
+
+namespace dsn {
+namespace utils {
+
+TEST(clock, coarse_clock)
+{
+    clock c;
+    uint64_t coarse = c.coarse_now_ns();
+    // the coarse clock ticks at least every 10ms
+    ASSERT_LE(c.now_ns() - coarse, 50000000);
+}
+
+TEST(clock, tsc_clock)
+{
+    if (!tsc_clock::supported()) {
+        return;
+    }
+
+    clock system;
+    tsc_clock tsc;
+    std::thread([&]() {
+        uint64_t last = 0;
+        for (int i = 0; i < 100; ++i) {
+            uint64_t now = tsc.now_ns();
+            ASSERT_LE(last, now);
+            ASSERT_LE(std::abs(static_cast<int64_t>(now - system.now_ns())), 1000000);
+            last = now;
+            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        }
+    }).join();
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/compression.h>
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+using namespace dsn::utils;
+
+TEST(compression, round_trip)
+{
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data += "rdsn compression test " + std::to_string(i % 10);
+    }
+
+    for (auto type : {compression_type::lz4, compression_type::zstd}) {
+        if (!compression_supported(type)) {
+            std::cout << compression_type_to_string(type) << " is not supported, skip it"
+                      << std::endl;
+            continue;
+        }
+
+        size_t bound = compress_bound(type, data.size());
+        ASSERT_GT(bound, 0);
+        std::string compressed(bound, '\0');
+        size_t sz = compress(type, data.data(), data.size(), &compressed[0], bound);
+        ASSERT_GT(sz, 0);
+        ASSERT_LT(sz, data.size());
+
+        std::string raw(data.size(), '\0');
+        ASSERT_TRUE(decompress(type, compressed.data(), sz, &raw[0], raw.size()));
+        ASSERT_EQ(data, raw);
+
+        // the original size must match exactly
+        std::string shorter(data.size() - 1, '\0');
+        ASSERT_FALSE(decompress(type, compressed.data(), sz, &shorter[0], shorter.size()));
+
+        // corrupted data
+        ASSERT_FALSE(decompress(type, compressed.data(), sz / 2, &raw[0], raw.size()));
+    }
+}
+
+TEST(compression, not_supported)
+{
+    ASSERT_TRUE(compression_supported(compression_type::none));
+    ASSERT_EQ(0, compress_bound(compression_type::none, 100));
+
+    char buf[16];
+    ASSERT_EQ(0, compress(compression_type::none, "abc", 3, buf, sizeof(buf)));
+    ASSERT_FALSE(decompress(compression_type::none, "abc", 3, buf, sizeof(buf)));
+}
@@ -0,0 +1,54 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/dns_resolver.h>
+#include <dsn/tool-api/rpc_address.h>
+
+#include <future>
+
+namespace dsn {
+namespace utils {
+
+TEST(dns_resolver, resolve)
+{
+    dns_resolver &resolver = dns_resolver::instance();
+    resolver.clear_cache();
+    ASSERT_EQ(0x7f000001, resolver.resolve("localhost"));
+    // cached
+    ASSERT_EQ(0x7f000001, resolver.resolve("localhost"));
+    ASSERT_EQ(0x7f000001, rpc_address::ipv4_from_host("localhost"));
+    ASSERT_EQ(0x7f000001, rpc_address::ipv4_from_host("127.0.0.1"));
+
+    // the failures are cached too
+    ASSERT_EQ(0, resolver.resolve("host.invalid"));
+    ASSERT_EQ(0, resolver.resolve("host.invalid"));
+}
+
+TEST(dns_resolver, resolve_async)
+{
+    dns_resolver &resolver = dns_resolver::instance();
+    resolver.clear_cache();
+    std::promise<uint32_t> first, second;
+    resolver.resolve_async("localhost", [&first](uint32_t ip) { first.set_value(ip); });
+    resolver.resolve_async("localhost", [&second](uint32_t ip) { second.set_value(ip); });
+    ASSERT_EQ(0x7f000001, first.get_future().get());
+    ASSERT_EQ(0x7f000001, second.get_future().get());
+}
+
+} // namespace utils
+} // namespace dsn
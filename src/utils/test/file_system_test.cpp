@@ -4,6 +4,8 @@
 
 #include <dsn/utility/filesystem.h>
 #include <gtest/gtest.h>
+#include <fstream>
+#include <sys/stat.h>
 
 namespace dsn {
 namespace utils {
@@ -25,6 +27,78 @@ TEST(verify_file, verify_file_test)
     remove_path(fname);
 }
 
+static void write_test_file(const std::string &path, size_t size)
+{
+    std::ofstream out(path, std::ios::binary);
+    for (size_t i = 0; i < size; ++i) {
+        out.put(static_cast<char>(i * 31 % 251));
+    }
+}
+
+static int link_count(const std::string &path)
+{
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? static_cast<int>(st.st_nlink) : -1;
+}
+
+TEST(filesystem, md5sum_files)
+{
+    const std::string dir = "md5sum_files_test";
+    remove_path(dir);
+    ASSERT_TRUE(create_directory(dir));
+    std::vector<std::string> files;
+    for (size_t size : {0, 1, 4096, 1024 * 1024 + 7, 3 * 1024 * 1024}) {
+        files.push_back(path_combine(dir, std::to_string(size)));
+        write_test_file(files.back(), size);
+    }
+
+    std::vector<std::string> md5s;
+    ASSERT_EQ(ERR_OK, md5sum_files(files, md5s, 3));
+    ASSERT_EQ(files.size(), md5s.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string md5;
+        ASSERT_EQ(ERR_OK, md5sum(files[i], md5));
+        ASSERT_EQ(md5, md5s[i]);
+    }
+    ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", md5s[0]);
+
+    files.push_back(path_combine(dir, "not_exist"));
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, md5sum_files(files, md5s));
+    ASSERT_TRUE(md5s.back().empty());
+    ASSERT_FALSE(md5s.front().empty());
+
+    remove_path(dir);
+}
+
+TEST(filesystem, copy_directory)
+{
+    const std::string src = "copy_directory_src";
+    const std::string dst = "copy_directory_dst";
+    remove_path(src);
+    remove_path(dst);
+    ASSERT_TRUE(create_directory(path_combine(src, "sub/dir")));
+    std::vector<std::string> files = {"a", "sub/b", "sub/dir/c"};
+    for (size_t i = 0; i < files.size(); ++i) {
+        write_test_file(path_combine(src, files[i]), i * 1000 * 1000 + 5);
+    }
+
+    for (bool allow_link : {false, true}) {
+        ASSERT_EQ(ERR_OK, copy_directory(src, dst, allow_link, 2));
+        for (const auto &file : files) {
+            std::string expected, actual;
+            ASSERT_EQ(ERR_OK, md5sum(path_combine(src, file), expected));
+            ASSERT_EQ(ERR_OK, md5sum(path_combine(dst, file), actual));
+            ASSERT_EQ(expected, actual);
+            ASSERT_EQ(allow_link ? 2 : 1, link_count(path_combine(dst, file)));
+        }
+        // the target files must not exist
+        ASSERT_NE(ERR_OK, copy_file(path_combine(src, "a"), path_combine(dst, "a"), allow_link));
+        remove_path(dst);
+    }
+
+    remove_path(src);
+}
+
 } // namespace filesystem
 } // namespace utils
 } // namespace dsn
@@ -147,6 +147,25 @@ TEST(json_helper, encode_and_decode)
     ASSERT_EQ(entity, decoded_entity);
 }
 
+TEST(json_helper, large_and_escaped_encode_decode)
+{
+    // larger than the stack buffers to decode in, and with the escapes rewritten in situ
+    for (size_t len : {10, 4095, 4096, 100000}) {
+        struct_type1 t;
+        t.b = true;
+        t.s = std::string(len, 'x') + "\"\\\n\t\u00e9";
+        t.d = 1.5;
+
+        blob encoded = dsn::json::json_forwarder<struct_type1>::encode(t);
+        // the encoded buffer isn't null-terminated
+        encoded = blob::create_from_bytes(encoded.data(), encoded.length());
+
+        struct_type1 decoded;
+        ASSERT_TRUE(dsn::json::json_forwarder<struct_type1>::decode(encoded, decoded));
+        ASSERT_EQ(t, decoded);
+    }
+}
+
 TEST(json_helper, simple_type_encode_decode)
 {
     struct_type1 t1_in, t1_out;
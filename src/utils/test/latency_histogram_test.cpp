@@ -0,0 +1,65 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/latency_histogram.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+TEST(latency_histogram, empty)
+{
+    latency_histogram h;
+    ASSERT_EQ(0, h.count());
+    ASSERT_EQ(0, h.percentile(50));
+    ASSERT_EQ(0, h.max());
+}
+
+TEST(latency_histogram, percentile)
+{
+    latency_histogram h;
+    // the small values are exact
+    for (uint64_t i = 0; i < 16; ++i) {
+        h.add(i);
+    }
+    ASSERT_EQ(16, h.count());
+    ASSERT_EQ(7, h.percentile(50));
+    ASSERT_EQ(15, h.percentile(100));
+
+    h.reset();
+    for (uint64_t i = 1; i <= 100000; ++i) {
+        h.add(i * 1000);
+    }
+    ASSERT_EQ(100000, h.count());
+    ASSERT_EQ(100000000, h.max());
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        uint64_t expected = static_cast<uint64_t>(p * 1000 * 1000);
+        uint64_t actual = h.percentile(p);
+        ASSERT_LE(actual, expected) << p;
+        ASSERT_GE(actual, expected - expected / 16) << p;
+    }
+}
+
+TEST(latency_histogram, large_value)
+{
+    latency_histogram h;
+    h.add(UINT64_MAX);
+    ASSERT_EQ(1, h.count());
+    ASSERT_EQ(UINT64_MAX, h.max());
+    ASSERT_GE(h.percentile(50), UINT64_MAX - UINT64_MAX / 16);
+}
+
+} // namespace dsn
@@ -104,5 +104,59 @@ TEST_F(latency_tracer_test, add_point)
                   fmt::format("latency_tracer_test.cpp:61:init_trace_points[stage{}]", count3++));
     }
 }
+
+class collecting_span_exporter : public trace_span_exporter
+{
+public:
+    explicit collecting_span_exporter(std::vector<trace_span> *spans) : _spans(spans) {}
+    void export_span(const trace_span &span) override { _spans->push_back(span); }
+
+private:
+    std::vector<trace_span> *_spans;
+};
+
+TEST_F(latency_tracer_test, trace_context)
+{
+    std::vector<trace_span> spans;
+    set_trace_span_exporter(
+        std::unique_ptr<trace_span_exporter>(new collecting_span_exporter(&spans)));
+
+    // not in any trace
+    ASSERT_FALSE(trace_context::current().sampled);
+    {
+        latency_tracer tracer("untraced");
+        ADD_POINT(&tracer);
+        ASSERT_FALSE(tracer.context().sampled);
+    }
+    ASSERT_TRUE(spans.empty());
+
+    trace_context ctx;
+    ctx.trace_id = 0x1234;
+    ctx.span_id = 7;
+    ctx.sampled = true;
+    {
+        trace_context_scope scope(ctx);
+        ASSERT_EQ(0x1234, trace_context::current().trace_id);
+
+        latency_tracer tracer("traced");
+        ADD_POINT(&tracer);
+        ASSERT_TRUE(tracer.context().sampled);
+        ASSERT_EQ(0x1234, tracer.context().trace_id);
+        ASSERT_EQ(7, tracer.context().parent_span_id);
+        ASSERT_NE(0, tracer.context().span_id);
+        ASSERT_NE(7, tracer.context().span_id);
+    }
+    ASSERT_FALSE(trace_context::current().sampled);
+
+    ASSERT_EQ(1, spans.size());
+    ASSERT_EQ("traced", spans[0].name);
+    ASSERT_EQ(0x1234, spans[0].context.trace_id);
+    ASSERT_EQ(7, spans[0].context.parent_span_id);
+    ASSERT_EQ(1, spans[0].points.size());
+    ASSERT_LE(spans[0].start_ns, spans[0].points[0].first);
+    ASSERT_LE(spans[0].points[0].first, spans[0].end_ns);
+
+    set_trace_span_exporter(nullptr);
+}
 } // namespace utils
 } // namespace dsn
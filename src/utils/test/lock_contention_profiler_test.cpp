@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/lock_contention_profiler.h>
+#include <dsn/utility/synchronize.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace dsn {
+namespace utils {
+
+TEST(lock_contention_profiler, disabled_by_default)
+{
+    ASSERT_FALSE(lock_contention_profiler::enabled());
+
+    ex_lock_nr_spin l;
+    l.lock();
+    l.unlock();
+    ASSERT_TRUE(lock_contention_profiler::top_sites(10).empty());
+}
+
+TEST(lock_contention_profiler, spin_lock_contention)
+{
+    lock_contention_profiler::start(1);
+    ASSERT_TRUE(lock_contention_profiler::enabled());
+
+    ex_lock_nr_spin l;
+    int value = 0;
+    auto worker = [&l, &value]() {
+        for (int i = 0; i < 100; ++i) {
+            l.lock();
+            ++value;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            l.unlock();
+        }
+    };
+    std::thread t1(worker);
+    std::thread t2(worker);
+    t1.join();
+    t2.join();
+    lock_contention_profiler::stop();
+    ASSERT_EQ(200, value);
+
+    auto sites = lock_contention_profiler::top_sites(10);
+    ASSERT_FALSE(sites.empty());
+    uint64_t contended = 0;
+    uint64_t held = 0;
+    for (const auto &site : sites) {
+        contended += site.contended_count;
+        held += site.sampled_hold_count;
+        ASSERT_FALSE(site.symbol.empty());
+        ASSERT_GE(site.max_wait_ns * site.contended_count, site.total_wait_ns);
+    }
+    ASSERT_GT(contended, 0u);
+    ASSERT_EQ(200u, held);
+
+    ASSERT_EQ(1u, lock_contention_profiler::top_sites(1).size());
+
+    // the stats are cleared when restarted
+    lock_contention_profiler::start();
+    lock_contention_profiler::stop();
+    ASSERT_TRUE(lock_contention_profiler::top_sites(10).empty());
+}
+
+} // namespace utils
+} // namespace dsn
@@ -34,8 +34,14 @@
  */
 
 #include "utils/simple_logger.h"
+#include "utils/async_logger.h"
+#include <fstream>
+#include <sstream>
 #include <gtest/gtest.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utils/binary_log.h>
+#include <fmt/format.h>
 
 using namespace dsn;
 using namespace dsn::tools;
@@ -125,3 +131,88 @@ TEST(tools_common, simple_logger)
     clear_files(index);
     finish_test_dir();
 }
+
+TEST(tools_common, async_logger)
+{
+    prepare_test_dir();
+    {
+        async_logger logger("./");
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&logger]() {
+                for (int j = 0; j < 1000; ++j) {
+                    log_print(&logger, "%s %d", "test_print", j);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        logger.flush();
+        ASSERT_EQ(0, logger.dropped_lines());
+    }
+
+    std::vector<int> index;
+    get_log_file_index(index);
+    ASSERT_EQ(1, index.size());
+    std::ifstream log(fmt::format("log.{}.txt", index[0]));
+    int lines = 0;
+    std::string line;
+    while (std::getline(log, line)) {
+        ASSERT_NE(std::string::npos, line.find("test_print"));
+        ++lines;
+    }
+    ASSERT_EQ(4000, lines);
+    clear_files(index);
+    finish_test_dir();
+}
+
+namespace dsn {
+namespace tools {
+DSN_DECLARE_bool(binary_format);
+} // namespace tools
+} // namespace dsn
+
+TEST(tools_common, async_logger_binary_format)
+{
+    prepare_test_dir();
+    bool old_binary_format = FLAGS_binary_format;
+    FLAGS_binary_format = true;
+    {
+        async_logger logger("./");
+        for (int i = 0; i < 2; ++i) {
+            log_print(&logger,
+                      "%d %5.2f [%-4s] %hhd %llx %" PRId64 " %c %% %*d %.*s %s",
+                      i,
+                      3.14159,
+                      "ab",
+                      300,
+                      255ULL,
+                      int64_t(-7),
+                      'z',
+                      4,
+                      42,
+                      2,
+                      "xyz",
+                      (const char *)nullptr);
+            logger.dsn_log(__FILE__, __FUNCTION__, __LINE__, LOG_LEVEL_INFORMATION, "plain");
+        }
+    }
+    FLAGS_binary_format = old_binary_format;
+
+    std::ostringstream out;
+    ASSERT_TRUE(dsn::utils::decode_binary_log_file("log.1.bin", out, true).is_ok());
+    std::vector<std::string> expected = {"0  3.14 [ab  ] 44 ff -7 z %   42 xy (null)",
+                                         "plain",
+                                         "1  3.14 [ab  ] 44 ff -7 z %   42 xy (null)",
+                                         "plain"};
+    std::istringstream lines(out.str());
+    std::string line;
+    for (const auto &text : expected) {
+        ASSERT_TRUE(std::getline(lines, line));
+        ASSERT_EQ(text, line.substr(line.size() - text.size()));
+    }
+    ASSERT_FALSE(std::getline(lines, line));
+    dsn::utils::filesystem::remove_path("log.1.bin");
+    finish_test_dir();
+}
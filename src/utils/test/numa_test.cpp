@@ -0,0 +1,50 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/numa.h>
+
+#include <thread>
+
+namespace dsn {
+namespace utils {
+namespace numa {
+
+TEST(numa, parse_cpu_list)
+{
+    ASSERT_EQ(std::vector<int>({0}), parse_cpu_list("0"));
+    ASSERT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), parse_cpu_list("0-3,8,10-11"));
+    ASSERT_TRUE(parse_cpu_list("0-a").empty());
+}
+
+TEST(numa, bind_current_thread)
+{
+    ASSERT_GE(node_count(), 1);
+    for (const auto &cpus : node_cpus()) {
+        ASSERT_FALSE(cpus.empty());
+    }
+
+    std::thread([]() {
+        ASSERT_TRUE(bind_current_thread(0));
+        ASSERT_EQ(0, current_node());
+    }).join();
+    ASSERT_FALSE(bind_current_thread(node_count()));
+}
+
+} // namespace numa
+} // namespace utils
+} // namespace dsn
@@ -201,4 +201,43 @@ TEST(multi_table_printer_test, multi_sub_test)
          "{" + single_column_tp_output[1] + "," + multi_columns_tp_output[1] + "}\n",
          "{\n" + single_column_tp_output[2] + ",\n" + multi_columns_tp_output[2] + "\n}\n"}));
 }
+
+TEST(json_table_writer_test, same_as_multi_table_printer)
+{
+    std::string out;
+    utils::json_table_writer writer(out);
+    writer.start_table("tp1");
+    writer.add_row_name_and_data("row1", 1.234);
+    writer.add_row_name_and_data("row2", 2345);
+    writer.add_row_name_and_data("row3", "3456");
+    writer.end_table();
+    // the single column table without any row is omitted like table_printer
+    writer.start_table("empty");
+    writer.end_table();
+    writer.start_table("tp2", {"multi_columns_test", "col0", "col1", "col2"});
+    for (int i = 0; i < 3; i++) {
+        writer.add_row("row" + std::to_string(i));
+        for (int j = 0; j < 3; j++) {
+            writer.append_data("data" + std::to_string(i) + std::to_string(j));
+        }
+    }
+    writer.end_table();
+    writer.finish();
+
+    utils::multi_table_printer mtp;
+    mtp.add(generate_single_column_tp());
+    mtp.add(utils::table_printer("empty"));
+    mtp.add(generate_multi_columns_tp());
+    std::ostringstream expected;
+    mtp.output(expected, table_printer::output_format::kJsonCompact);
+    ASSERT_EQ(expected.str(), out);
+}
+
+TEST(json_table_writer_test, empty_content_test)
+{
+    std::string out;
+    utils::json_table_writer writer(out);
+    writer.finish();
+    ASSERT_EQ("{}\n", out);
+}
 } // namespace dsn
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <dsn/utility/pooled_binary_writer.h>
+
+namespace dsn {
+
+TEST(pooled_binary_writer, chunks_are_reused)
+{
+    std::thread([]() {
+        const char *first_chunk = nullptr;
+        {
+            pooled_binary_writer writer(100);
+            writer.write(std::string(80, 'a'));
+            std::vector<blob> buffers;
+            writer.get_buffers(buffers);
+            ASSERT_EQ(1, buffers.size());
+            ASSERT_EQ(84, buffers[0].length());
+            first_chunk = buffers[0].data();
+            ASSERT_EQ(0, binary_writer_chunk_pool::cached_chunk_count());
+        }
+        // the chunk is back when the blobs die
+        ASSERT_EQ(1, binary_writer_chunk_pool::cached_chunk_count());
+
+        pooled_binary_writer writer(100);
+        writer.write(std::string(10, 'b'));
+        std::vector<blob> buffers;
+        writer.get_buffers(buffers);
+        ASSERT_EQ(first_chunk, buffers[0].data());
+        ASSERT_EQ(0, binary_writer_chunk_pool::cached_chunk_count());
+    }).join();
+}
+
+TEST(pooled_binary_writer, scatter_gather)
+{
+    std::string value(1000, 'x');
+    pooled_binary_writer writer(256);
+    for (int i = 0; i < 10; ++i) {
+        writer.write(value.data(), static_cast<int>(value.size()));
+    }
+
+    std::vector<blob> buffers;
+    writer.get_buffers(buffers);
+    ASSERT_LT(1, buffers.size());
+    std::string content;
+    for (const blob &bb : buffers) {
+        content.append(bb.data(), bb.length());
+    }
+    ASSERT_EQ(10 * value.size(), content.size());
+    ASSERT_EQ(std::string(content.size(), 'x'), content);
+    ASSERT_EQ(content, writer.get_buffer().to_string());
+}
+
+TEST(pooled_binary_writer, chunk_sizes)
+{
+    size_t min_size = binary_writer_chunk_pool::MIN_CHUNK_SIZE;
+    ASSERT_EQ(min_size, binary_writer_chunk_pool::allocate(1).length());
+    ASSERT_EQ(1024, binary_writer_chunk_pool::allocate(513).length());
+    size_t max_size = binary_writer_chunk_pool::MAX_CHUNK_SIZE;
+    ASSERT_EQ(max_size, binary_writer_chunk_pool::allocate(max_size).length());
+    // too large to be cached
+    size_t cached = binary_writer_chunk_pool::cached_chunk_count();
+    ASSERT_EQ(100000, binary_writer_chunk_pool::allocate(100000).length());
+    ASSERT_EQ(cached, binary_writer_chunk_pool::cached_chunk_count());
+}
+
+} // namespace dsn
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/published_snapshot.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+TEST(published_snapshot, set_and_get)
+{
+    published_snapshot<int> s(std::make_shared<int>(1));
+    uint64_t version = 0;
+    ASSERT_EQ(1, s.get(&version));
+    ASSERT_NE(0, version);
+    ASSERT_EQ(version, s.version());
+
+    s.set(std::make_shared<int>(2));
+    uint64_t new_version = 0;
+    ASSERT_EQ(2, s.get(&new_version));
+    ASSERT_NE(version, new_version);
+    ASSERT_EQ(new_version, s.version());
+
+    // the versions are unique among the instances
+    published_snapshot<int> other(std::make_shared<int>(2));
+    ASSERT_NE(other.version(), s.version());
+}
+
+TEST(published_snapshot, instances_sharing_slots)
+{
+    // more instances than the slots of the thread cache
+    std::vector<std::unique_ptr<published_snapshot<int>>> snapshots;
+    for (int i = 0; i < 40; ++i) {
+        snapshots.emplace_back(new published_snapshot<int>(std::make_shared<int>(i)));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 40; ++i) {
+            ASSERT_EQ(i + round, snapshots[i]->get());
+            snapshots[i]->set(std::make_shared<int>(i + round + 1));
+        }
+    }
+}
+
+TEST(published_snapshot, concurrent_get_and_set)
+{
+    struct pair
+    {
+        int first;
+        int second;
+    };
+    published_snapshot<pair> s(std::make_shared<pair>(pair{0, 0}));
+
+    // the readers always see a whole object, never older than the one they saw before
+    std::atomic<bool> stop{false};
+    std::atomic<int> wrong_reads{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            int last = 0;
+            while (!stop.load()) {
+                const pair &p = s.get();
+                if (p.first != p.second || p.first < last) {
+                    wrong_reads.fetch_add(1);
+                }
+                last = p.first;
+            }
+        });
+    }
+    for (int i = 1; i <= 10000; ++i) {
+        s.set(std::make_shared<pair>(pair{i, i}));
+    }
+    stop.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(0, wrong_reads.load());
+    ASSERT_EQ(10000, s.get().first);
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/slab_allocator.h>
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+
+namespace dsn {
+namespace utils {
+
+TEST(slab_allocator, allocate_and_reuse)
+{
+    std::thread([]() {
+        std::set<void *> objects;
+        for (size_t size : {1, 16, 17, 100, 129, 700, 1024}) {
+            void *p = slab_allocator::allocate(size);
+            ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % 16);
+            memset(p, 0xab, size);
+            ASSERT_TRUE(objects.insert(p).second);
+        }
+
+        // the object freed last is given out first
+        void *p = slab_allocator::allocate(40);
+        slab_allocator::deallocate(p, 40);
+        ASSERT_EQ(p, slab_allocator::allocate(33));
+        slab_allocator::deallocate(p, 33);
+    }).join();
+}
+
+TEST(slab_allocator, cross_thread_free)
+{
+    std::vector<void *> objects;
+    std::thread([&objects]() {
+        for (int i = 0; i < 10000; ++i) {
+            objects.push_back(slab_allocator::allocate(64));
+        }
+    }).join();
+
+    uint64_t depot_before = 0;
+    for (const auto &s : slab_allocator::stats()) {
+        if (s.object_size == 64) {
+            depot_before = s.depot_objects;
+            ASSERT_GE(s.slab_bytes, 10000 * 64);
+        }
+    }
+
+    // the frees on another thread are given back to the depot in batches
+    std::thread([&objects]() {
+        for (void *p : objects) {
+            slab_allocator::deallocate(p, 64);
+        }
+    }).join();
+    for (const auto &s : slab_allocator::stats()) {
+        if (s.object_size == 64) {
+            ASSERT_GE(s.depot_objects, depot_before + 10000);
+        }
+    }
+}
+
+TEST(slab_allocator, stl_allocator)
+{
+    using value_type = std::pair<const int, std::string>;
+    std::map<int, std::string, std::less<int>, slab_stl_allocator<value_type>> m;
+    for (int i = 0; i < 1000; ++i) {
+        m.emplace(i, std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        m.erase(i);
+    }
+    ASSERT_EQ(500, m.size());
+    ASSERT_EQ("999", m[999]);
+
+    // the large allocations go to the operator new
+    std::vector<int, slab_stl_allocator<int>> v(10000, 1);
+    ASSERT_EQ(10000, v.size());
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <dsn/utils/latency_tracer.h>
+#include <dsn/utils/slow_request_recorder.h>
+
+namespace dsn {
+namespace utils {
+
+class slow_request_recorder_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_size = FLAGS_slow_request_recorder_size;
+        _old_window_seconds = FLAGS_slow_request_window_seconds;
+        FLAGS_slow_request_recorder_size = 3;
+        FLAGS_slow_request_window_seconds = 10;
+        slow_request_recorder::instance().clear();
+    }
+
+    void TearDown() override
+    {
+        FLAGS_slow_request_recorder_size = _old_size;
+        FLAGS_slow_request_window_seconds = _old_window_seconds;
+        slow_request_recorder::instance().clear();
+    }
+
+    bool record(const std::string &category, uint64_t end_ns, uint64_t latency_ns)
+    {
+        return slow_request_recorder::instance().try_record(
+            category, end_ns, latency_ns, [latency_ns](slow_request &request) {
+                request.name = std::to_string(latency_ns);
+            });
+    }
+
+    std::vector<uint64_t> latencies(const slow_request_window &window)
+    {
+        std::vector<uint64_t> result;
+        for (const auto &request : window.requests) {
+            result.push_back(request.latency_ns);
+        }
+        return result;
+    }
+
+    const uint64_t kSecond = 1000000000;
+
+private:
+    uint32_t _old_size;
+    uint32_t _old_window_seconds;
+};
+
+TEST_F(slow_request_recorder_test, keep_slowest)
+{
+    uint64_t now = 1000 * kSecond;
+    for (uint64_t latency : {5, 1, 9, 3, 7}) {
+        record("RPC_PUT", now, latency);
+    }
+    record("RPC_GET", now, 100);
+
+    // only the faster requests are rejected
+    ASSERT_FALSE(record("RPC_PUT", now, 4));
+    bool filled = false;
+    ASSERT_FALSE(slow_request_recorder::instance().try_record(
+        "RPC_PUT", now, 2, [&filled](slow_request &) { filled = true; }));
+    ASSERT_FALSE(filled);
+
+    auto windows = slow_request_recorder::instance().get_windows("RPC_PUT");
+    ASSERT_EQ(1, windows.size());
+    ASSERT_EQ("RPC_PUT", windows[0].category);
+    ASSERT_EQ(std::vector<uint64_t>({9, 7, 5}), latencies(windows[0]));
+    ASSERT_EQ("9", windows[0].requests[0].name);
+
+    ASSERT_EQ(2, slow_request_recorder::instance().get_windows("").size());
+}
+
+TEST_F(slow_request_recorder_test, rotate_windows)
+{
+    uint64_t now = 1000 * kSecond;
+    record("RPC_PUT", now, 5);
+    record("RPC_PUT", now, 6);
+    record("RPC_PUT", now, 7);
+
+    // a new window keeps the requests faster than the last ones
+    ASSERT_TRUE(record("RPC_PUT", now + 10 * kSecond, 1));
+    auto windows = slow_request_recorder::instance().get_windows("RPC_PUT");
+    ASSERT_EQ(2, windows.size());
+    ASSERT_EQ(std::vector<uint64_t>({7, 6, 5}), latencies(windows[0]));
+    ASSERT_EQ(std::vector<uint64_t>({1}), latencies(windows[1]));
+    ASSERT_EQ(windows[0].window_start_ms + 10000, windows[1].window_start_ms);
+
+    // the windows without any request are empty
+    ASSERT_TRUE(record("RPC_PUT", now + 30 * kSecond, 2));
+    windows = slow_request_recorder::instance().get_windows("RPC_PUT");
+    ASSERT_EQ(1, windows.size());
+    ASSERT_EQ(std::vector<uint64_t>({2}), latencies(windows[0]));
+}
+
+TEST_F(slow_request_recorder_test, record_by_latency_tracer)
+{
+    bool old_enable = FLAGS_enable_latency_tracer;
+    FLAGS_enable_latency_tracer = true;
+    {
+        auto tracer = std::make_shared<latency_tracer>("mutation[1]");
+        auto sub_tracer = std::make_shared<latency_tracer>("sub", true);
+        tracer->set_category("RPC_PUT");
+        tracer->set_sub_tracer(sub_tracer);
+        ADD_CUSTOM_POINT(tracer, "prepare");
+        ADD_CUSTOM_POINT(sub_tracer, "apply");
+        ADD_CUSTOM_POINT(tracer, "completed");
+    }
+    FLAGS_enable_latency_tracer = old_enable;
+
+    auto windows = slow_request_recorder::instance().get_windows("RPC_PUT");
+    ASSERT_EQ(1, windows.size());
+    ASSERT_EQ(1, windows[0].requests.size());
+    const slow_request &request = windows[0].requests[0];
+    ASSERT_EQ("mutation[1]", request.name);
+    ASSERT_EQ(3, request.stages.size());
+    ASSERT_NE(std::string::npos, request.stages[0].second.find("[prepare]"));
+    ASSERT_NE(std::string::npos, request.stages[1].second.find("[completed]"));
+    ASSERT_NE(std::string::npos, request.stages[2].second.find("[apply]"));
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,66 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <dsn/utility/startup_report.h>
+
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/process_utils.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace dsn {
+namespace utils {
+
+TEST(startup_report_test, phases)
+{
+    startup_report &report = startup_report::instance();
+    size_t old_count = report.phases().size();
+
+    {
+        startup_phase_timer t("startup_report_test.sleep");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    report.add_phase("startup_report_test.added", process_start_millis() + 5, 10);
+
+    auto phases = report.phases();
+    ASSERT_EQ(old_count + 2, phases.size());
+    ASSERT_EQ("startup_report_test.sleep", phases[old_count].name);
+    ASSERT_GE(phases[old_count].duration_ms, 20);
+    ASSERT_EQ("startup_report_test.added", phases[old_count + 1].name);
+    ASSERT_EQ(5, phases[old_count + 1].start_offset_ms);
+    ASSERT_EQ(10, phases[old_count + 1].duration_ms);
+
+    report.complete();
+    uint64_t total_ms = report.total_ms();
+    ASSERT_GT(total_ms, 0);
+    // only the first completion takes effect
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    report.complete();
+    ASSERT_EQ(total_ms, report.total_ms());
+
+    table_printer tp("startup_report");
+    report.get_report(tp);
+    std::ostringstream out;
+    tp.output(out, table_printer::output_format::kJsonCompact);
+    ASSERT_NE(std::string::npos, out.str().find("startup_report_test.added"));
+    ASSERT_NE(std::string::npos, out.str().find("\"total\""));
+}
+
+} // namespace utils
+} // namespace dsn
@@ -39,10 +39,12 @@
 #include <dsn/utility/binary_writer.h>
 #include <dsn/utility/link.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/filesystem.h>
 #include <dsn/utility/autoref_ptr.h>
 #include <dsn/c/api_layer1.h>
 #include <gtest/gtest.h>
 #include <dsn/utility/rand.h>
+#include <fstream>
 
 using namespace ::dsn;
 using namespace ::dsn::utils;
@@ -70,6 +72,71 @@ TEST(core, crc)
     EXPECT_TRUE(c3 == c4);
 }
 
+// bit-by-bit reference of the reflected crc, whichever implementation crc*_calc selects
+template <typename T>
+static T crc_bitwise(const uint8_t *p, size_t size, T init, T poly)
+{
+    T crc = ~init;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+TEST(core, crc_implementations)
+{
+    ASSERT_EQ(0xe3069283, dsn::utils::crc32_calc("123456789", 9, 0));
+
+    std::vector<uint8_t> buffer(4096);
+    for (auto &b : buffer) {
+        b = static_cast<uint8_t>(rand::next_u32(0, 255));
+    }
+
+    // cover the unaligned heads, the folded bodies and the tails
+    for (int i = 0; i < 2000; i++) {
+        size_t offset = rand::next_u32(0, 15);
+        size_t size = rand::next_u32(0, buffer.size() - offset);
+        const uint8_t *p = buffer.data() + offset;
+        uint32_t init32 = rand::next_u32();
+        uint64_t init64 = rand::next_u64();
+        ASSERT_EQ(crc_bitwise<uint32_t>(p, size, init32, 0x82f63b78),
+                  dsn::utils::crc32_calc(p, size, init32));
+        ASSERT_EQ(crc_bitwise<uint64_t>(p, size, init64, 0x9a6c9329ac4bc9b5),
+                  dsn::utils::crc64_calc(p, size, init64));
+    }
+}
+
+TEST(core, md5_calculator)
+{
+    ASSERT_EQ("25f9e794323b453885f5181f1b624d0b", string_md5("123456789", 9));
+
+    std::string buffer(10000, '\0');
+    for (auto &c : buffer) {
+        c = static_cast<char>(rand::next_u32(0, 255));
+    }
+    const std::string fname = "md5_calculator_test_file";
+    {
+        std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+        out.write(buffer.data(), buffer.size());
+    }
+    std::string expected_md5;
+    ASSERT_EQ(ERR_OK, filesystem::md5sum(fname, expected_md5));
+    filesystem::remove_path(fname);
+
+    ASSERT_EQ(expected_md5, string_md5(buffer.data(), buffer.size()));
+    md5_calculator md5;
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+        size_t length = std::min<size_t>(rand::next_u32(0, 5000), buffer.size() - offset);
+        md5.update(buffer.data() + offset, length);
+        offset += length;
+    }
+    ASSERT_EQ(expected_md5, md5.digest());
+}
+
 TEST(core, binary_io)
 {
     int value = 0xdeadbeef;
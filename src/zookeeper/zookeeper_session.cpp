@@ -33,6 +33,8 @@
  */
 
 #include <zookeeper/zookeeper.h>
+#include <dsn/tool-api/task.h>
+#include <dsn/utility/flags.h>
 
 #include "zookeeper_session.h"
 #include "zookeeper_session_mgr.h"
@@ -40,6 +42,19 @@
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_uint32("zookeeper",
+                  max_inflight_operations,
+                  1024,
+                  "the max count of operations waiting for response from zookeeper in a session, "
+                  "the exceeded ones are queued, 0 means unlimited");
+
+DSN_DEFINE_uint32("zookeeper",
+                  read_cache_capacity,
+                  0,
+                  "the max count of node values cached by a session for the repeated reads, "
+                  "each cached node is watched, 0 means the reads are not cached");
+DSN_TAG_VARIABLE(read_cache_capacity, FT_MUTABLE);
+
 zookeeper_session::zoo_atomic_packet::zoo_atomic_packet(unsigned int size)
 {
     _capacity = size;
@@ -132,7 +147,8 @@ const char *zookeeper_session::string_zoo_state(int zoo_state)
 
 zookeeper_session::~zookeeper_session() {}
 
-zookeeper_session::zookeeper_session(const service_app_info &node) : _handle(nullptr)
+zookeeper_session::zookeeper_session(const service_app_info &node)
+    : _inflight_count(0), _handle(nullptr)
 {
     _srv_node = node;
 }
@@ -154,6 +170,7 @@ int zookeeper_session::attach(void *callback_owner, const state_callback &cb)
     _watchers.back().watcher_path = "";
     _watchers.back().callback_owner = callback_owner;
     _watchers.back().watcher_callback = cb;
+    _watchers.back().node = task::get_current_node2();
 
     return zoo_state(_handle);
 }
@@ -168,6 +185,17 @@ void zookeeper_session::detach(void *callback_owner)
 
 void zookeeper_session::dispatch_event(int type, int zstate, const char *path)
 {
+    {
+        // the changes may be missed when the session state changes
+        utils::auto_lock<utils::ex_lock_nr> l(_read_cache_lock);
+        if (ZOO_SESSION_EVENT == type) {
+            _read_cache.clear();
+            _read_cache_watches.clear();
+        } else {
+            _read_cache.erase(path);
+            _read_cache_watches.erase(path);
+        }
+    }
     {
         utils::auto_read_lock l(_watcher_lock);
         int ret_code = type;
@@ -175,16 +203,23 @@ void zookeeper_session::dispatch_event(int type, int zstate, const char *path)
             ret_code = zstate;
 
         std::for_each(
-            _watchers.begin(), _watchers.end(), [path, ret_code](const watcher_object &obj) {
-                if (obj.watcher_path == path)
+            _watchers.begin(), _watchers.end(), [this, path, ret_code](const watcher_object &obj) {
+                if (obj.watcher_path == path) {
+                    init_non_dsn_thread(obj.node);
                     obj.watcher_callback(ret_code);
+                }
             });
     }
     {
+        utils::auto_write_lock l(_watcher_lock);
         if (ZOO_SESSION_EVENT != type) {
-            utils::auto_write_lock l(_watcher_lock);
             _watchers.remove_if(
                 [path](const watcher_object &obj) { return obj.watcher_path == path; });
+        } else {
+            // the watches of the read cache are set again by the next gets
+            _watchers.remove_if([this](const watcher_object &obj) {
+                return obj.callback_owner == this && !obj.watcher_path.empty();
+            });
         }
     }
 }
@@ -192,12 +227,54 @@ void zookeeper_session::dispatch_event(int type, int zstate, const char *path)
 void zookeeper_session::visit(zoo_opcontext *ctx)
 {
     ctx->_priv_session_ref = this;
+    ctx->_priv_node = task::get_current_node2();
+    if (get_from_read_cache(ctx)) {
+        return;
+    }
+    invalidate_read_cache(ctx);
+
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_pending_lock);
+        if (FLAGS_max_inflight_operations > 0 &&
+            (_inflight_count >= FLAGS_max_inflight_operations || !_pending_ops.empty())) {
+            _pending_ops.push_back(ctx);
+            return;
+        }
+        ++_inflight_count;
+    }
+
+    if (!issue(ctx)) {
+        on_operation_completed();
+    }
+}
 
+void zookeeper_session::on_operation_completed()
+{
+    while (true) {
+        zoo_opcontext *next = nullptr;
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_pending_lock);
+            if (_pending_ops.empty()) {
+                --_inflight_count;
+                return;
+            }
+            next = _pending_ops.front();
+            _pending_ops.pop_front();
+        }
+        if (issue(next)) {
+            return;
+        }
+        // the next one is completed synchronously, hand the slot over again
+    }
+}
+
+bool zookeeper_session::issue(zoo_opcontext *ctx)
+{
     if (zoo_state(_handle) != ZOO_CONNECTED_STATE) {
         ctx->_output.error = ZINVALIDSTATE;
         ctx->_callback_function(ctx);
         release_ref(ctx);
-        return;
+        return false;
     }
 
     auto add_watch_object = [this, ctx]() {
@@ -206,6 +283,7 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
         _watchers.back().watcher_path = ctx->_input._path;
         _watchers.back().callback_owner = ctx->_input._owner;
         _watchers.back().watcher_callback = std::move(ctx->_input._watcher_callback);
+        _watchers.back().node = ctx->_priv_node;
     };
 
     // TODO: the read ops from zookeeper might get the staled data, need to fix
@@ -233,8 +311,13 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
             _handle, path, input._is_set_watch, global_state_completion, (const void *)ctx);
         break;
     case ZOO_GET:
-        if (1 == input._is_set_watch)
+        if (1 == input._is_set_watch) {
             add_watch_object();
+        } else if (FLAGS_read_cache_capacity > 0 && watch_for_read_cache(input._path)) {
+            // the cached value is dropped by the event of the watch, see dispatch_event
+            ctx->_priv_cache_result = true;
+            input._is_set_watch = 1;
+        }
         ec =
             zoo_aget(_handle, path, input._is_set_watch, global_data_completion, (const void *)ctx);
         break;
@@ -269,11 +352,98 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
         ctx->_output.error = ec;
         ctx->_callback_function(ctx);
         release_ref(ctx);
+        return false;
     }
+    return true;
 }
 
-void zookeeper_session::init_non_dsn_thread()
+bool zookeeper_session::get_from_read_cache(zoo_opcontext *ctx)
 {
+    if (ctx->_optype != ZOO_GET || 1 == ctx->_input._is_set_watch) {
+        return false;
+    }
+
+    std::string value;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_read_cache_lock);
+        auto iter = _read_cache.find(ctx->_input._path);
+        if (iter == _read_cache.end()) {
+            return false;
+        }
+        value = iter->second;
+    }
+    ctx->_output.error = ZOK;
+    ctx->_output.get_op.value = value.data();
+    ctx->_output.get_op.value_length = (int)value.length();
+    ctx->_callback_function(ctx);
+    release_ref(ctx);
+    return true;
+}
+
+bool zookeeper_session::watch_for_read_cache(const std::string &path)
+{
+    // _watcher_lock is taken first, so that the watch object is added along with the path
+    utils::auto_write_lock wl(_watcher_lock);
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_read_cache_lock);
+        if (_read_cache_watches.count(path) != 0) {
+            // watched by a previous get, zookeeper sets the same watch only once as well
+            return true;
+        }
+        if (_read_cache_watches.size() >= FLAGS_read_cache_capacity) {
+            return false;
+        }
+        _read_cache_watches.insert(path);
+    }
+    _watchers.push_back(watcher_object());
+    _watchers.back().watcher_path = path;
+    _watchers.back().callback_owner = this;
+    _watchers.back().watcher_callback = [](int) {};
+    _watchers.back().node = nullptr;
+    return true;
+}
+
+void zookeeper_session::put_to_read_cache(const std::string &path,
+                                          const char *value,
+                                          int value_length)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_read_cache_lock);
+    // the watch may have fired before the get completes, then the value may be stale
+    if (_read_cache_watches.count(path) != 0) {
+        _read_cache[path].assign(value == nullptr ? "" : value,
+                                 value == nullptr ? 0 : value_length);
+    }
+}
+
+void zookeeper_session::invalidate_read_cache(const zoo_opcontext *ctx)
+{
+    if (ctx->_optype != ZOO_SET && ctx->_optype != ZOO_DELETE &&
+        ctx->_optype != ZOO_TRANSACTION) {
+        return;
+    }
+
+    utils::auto_lock<utils::ex_lock_nr> l(_read_cache_lock);
+    if (_read_cache.empty()) {
+        return;
+    }
+    if (ctx->_optype == ZOO_TRANSACTION) {
+        for (unsigned int i = 0; i < ctx->_input._pkt->_count; ++i) {
+            _read_cache.erase(ctx->_input._pkt->_paths[i]);
+        }
+    } else {
+        _read_cache.erase(ctx->_input._path);
+    }
+}
+
+void zookeeper_session::init_non_dsn_thread(service_node *node)
+{
+    // the zookeeper threads of a session shared by the apps of the process run each callback
+    // as the app which issued the operation or set the watch
+    if (node != nullptr && zookeeper_session_mgr::instance().session_shared()) {
+        task::set_tls_dsn_context(node, nullptr);
+        return;
+    }
+
     static __thread int dsn_context_init = 0;
     if (dsn_context_init == 0) {
         dsn_mimic_app(_srv_node.role_name.c_str(), _srv_node.index);
@@ -300,7 +470,8 @@ void zookeeper_session::global_watcher(
 
 #define COMPLETION_INIT(rc, data)                                                                  \
     zoo_opcontext *op_ctx = (zoo_opcontext *)data;                                                 \
-    op_ctx->_priv_session_ref->init_non_dsn_thread();                                              \
+    zookeeper_session *session = op_ctx->_priv_session_ref;                                        \
+    session->init_non_dsn_thread(op_ctx->_priv_node);                                              \
     zoo_output &output = op_ctx->_output;                                                          \
     output.error = rc
 /* static */
@@ -313,6 +484,7 @@ void zookeeper_session::global_string_completion(int rc, const char *name, const
     output.create_op._created_path = name;
     op_ctx->_callback_function(op_ctx);
     release_ref(op_ctx);
+    session->on_operation_completed();
 }
 /* static */
 void zookeeper_session::global_data_completion(
@@ -322,8 +494,12 @@ void zookeeper_session::global_data_completion(
     dinfo("rc(%s), input path(%s)", zerror(rc), op_ctx->_input._path.c_str());
     output.get_op.value_length = value_length;
     output.get_op.value = value;
+    if (ZOK == rc && op_ctx->_priv_cache_result) {
+        session->put_to_read_cache(op_ctx->_input._path, value, value_length);
+    }
     op_ctx->_callback_function(op_ctx);
     release_ref(op_ctx);
+    session->on_operation_completed();
 }
 /* static */
 void zookeeper_session::global_state_completion(int rc, const Stat *stat, const void *data)
@@ -338,6 +514,7 @@ void zookeeper_session::global_state_completion(int rc, const Stat *stat, const
         op_ctx->_callback_function(op_ctx);
     }
     release_ref(op_ctx);
+    session->on_operation_completed();
 }
 /* static */
 void zookeeper_session::global_strings_completion(int rc,
@@ -351,6 +528,7 @@ void zookeeper_session::global_strings_completion(int rc,
     output.getchildren_op.strings = strings;
     op_ctx->_callback_function(op_ctx);
     release_ref(op_ctx);
+    session->on_operation_completed();
 }
 /* static */
 void zookeeper_session::global_void_completion(int rc, const void *data)
@@ -362,6 +540,7 @@ void zookeeper_session::global_void_completion(int rc, const void *data)
         dinfo("rc(%s)", zerror(rc));
     op_ctx->_callback_function(op_ctx);
     release_ref(op_ctx);
+    session->on_operation_completed();
 }
 }
 }
@@ -36,11 +36,16 @@
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 
+#include <deque>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <zookeeper/zookeeper.h>
 #include "zookeeper_session_mgr.h"
 
 namespace dsn {
+class service_node;
+
 namespace dist {
 
 class zookeeper_session
@@ -136,6 +141,10 @@ public:
         // this are for implement usage, user shouldn't modify this directly
         zookeeper_session *_priv_session_ref;
         int32_t _ref_count;
+        // the app which visits the session, the callbacks run as it
+        service_node *_priv_node;
+        // the value got is put into the read cache
+        bool _priv_cache_result;
     };
 
     static zoo_opcontext *create_context()
@@ -151,6 +160,8 @@ public:
         result->_optype = ZOO_OPINVALID;
         result->_callback_function = nullptr;
         result->_priv_session_ref = nullptr;
+        result->_priv_node = nullptr;
+        result->_priv_cache_result = false;
 
         result->add_ref();
         return result;
@@ -171,17 +182,47 @@ public:
 
     int session_state() const { return zoo_state(_handle); }
     void visit(zoo_opcontext *op_context);
-    void init_non_dsn_thread();
+    // `node` is the app the callback runs as, the app of the session if it is null
+    void init_non_dsn_thread(service_node *node = nullptr);
 
 private:
+    // issue the operation to zookeeper, returns false if it is completed synchronously
+    bool issue(zoo_opcontext *op_context);
+    // hand the in-flight slot of a completed operation over to the pending ones
+    void on_operation_completed();
+
+    // completes the get operation with the cached value, returns false if it's not cached
+    bool get_from_read_cache(zoo_opcontext *op_context);
+    // sets the watch of the session on `path` once, returns false if the cache is full, then
+    // the get is neither watched nor cached
+    bool watch_for_read_cache(const std::string &path);
+    void put_to_read_cache(const std::string &path, const char *value, int value_length);
+    // drops the cached values changed by the operation
+    void invalidate_read_cache(const zoo_opcontext *op_context);
+
+    // the operations exceeding the in-flight window wait here, and are issued in order,
+    // so that the operations on the same path complete in the order they are visited
+    utils::ex_lock_nr _pending_lock;
+    std::deque<zoo_opcontext *> _pending_ops;
+    uint32_t _inflight_count;
+
     utils::rw_lock_nr _watcher_lock;
     struct watcher_object
     {
         std::string watcher_path;
         void *callback_owner;
         state_callback watcher_callback;
+        service_node *node;
     };
     std::list<watcher_object> _watchers;
+
+    // the values of the nodes got without a watch of the user, each is watched by the session
+    // and dropped once the node changes or the session state changes, so the repeated reads
+    // are served locally, see [zookeeper] read_cache_capacity
+    utils::ex_lock_nr _read_cache_lock;
+    std::unordered_map<std::string, std::string> _read_cache;
+    // the paths watched by the session, which are at most read_cache_capacity
+    std::unordered_set<std::string> _read_cache_watches;
     service_app_info _srv_node;
     zhandle_t *_handle;
 
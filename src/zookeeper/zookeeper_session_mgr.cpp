@@ -38,10 +38,17 @@
 #include <stdio.h>
 #include <zookeeper/zookeeper.h>
 #include <stdexcept>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_bool("zookeeper",
+                share_session_per_process,
+                false,
+                "whether the apps in a process share one zookeeper session instead of holding "
+                "a session each, the callbacks and watches are still dispatched to each app");
+
 zookeeper_session_mgr::zookeeper_session_mgr()
 {
     _zoo_hosts = dsn_config_get_value_string("zookeeper", "hosts_list", "", "zookeeper_hosts");
@@ -58,12 +65,16 @@ zookeeper_session *zookeeper_session_mgr::get_session(const service_app_info &in
 {
     auto &store = utils::singleton_store<int, zookeeper_session *>::instance();
     zookeeper_session *ans = nullptr;
+    // the entity ids of the apps start from 1
+    int key = session_shared() ? 0 : info.entity_id;
     utils::auto_lock<utils::ex_lock_nr> l(_store_lock);
-    if (!store.get(info.entity_id, ans)) {
+    if (!store.get(key, ans)) {
         ans = new zookeeper_session(info);
-        store.put(info.entity_id, ans);
+        store.put(key, ans);
     }
     return ans;
 }
+
+bool zookeeper_session_mgr::session_shared() const { return FLAGS_share_session_per_process; }
 }
 }
@@ -47,7 +47,10 @@ class zookeeper_session_mgr : public utils::singleton<zookeeper_session_mgr>
 {
 public:
     zookeeper_session_mgr();
+    // the session of the app, or the one shared by all the apps in the process if
+    // [zookeeper] share_session_per_process is true
     zookeeper_session *get_session(const service_app_info &info);
+    bool session_shared() const;
     const char *zoo_hosts() const { return _zoo_hosts.c_str(); }
     int timeout() const { return _timeout_ms; }
     const char *zoo_logfile() const { return _zoo_logfile.c_str(); }